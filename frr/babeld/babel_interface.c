@@ -507,6 +507,26 @@ DEFPY (babel_set_enable_timestamps,
     return CMD_SUCCESS;
 }
 
+DEFPY (babel_set_twamp_rtt,
+       babel_set_twamp_rtt_cmd,
+       "[no] babel rtt-source twamp",
+       NO_STR
+       "Babel interface commands\n"
+       "Where the RTT to the neighbours comes from\n"
+       "Measurements of a TWAMP agent, over the timestamps\n")
+{
+    VTY_DECLVAR_CONTEXT(interface, ifp);
+    babel_interface_nfo *babel_ifp;
+
+    babel_ifp = babel_get_if_nfo(ifp);
+    assert (babel_ifp != NULL);
+    if (!no)
+        SET_FLAG(babel_ifp->flags, BABEL_IF_TWAMP_RTT);
+    else
+        UNSET_FLAG(babel_ifp->flags, BABEL_IF_TWAMP_RTT);
+    return CMD_SUCCESS;
+}
+
 DEFPY (babel_set_channel,
        babel_set_channel_cmd,
        "[no] babel channel <(1-254)$ch|interfering$interfering|"
@@ -813,13 +833,14 @@ static void
 show_babel_neighbour_sub (struct vty *vty, struct neighbour *neigh)
 {
     vty_out (vty,
-             "Neighbour %s dev %s reach %04x rxcost %d txcost %d rtt %s rttcost %d%s.\n",
+             "Neighbour %s dev %s reach %04x rxcost %d txcost %d rtt %s%s rttcost %d%s.\n",
              format_address(neigh->address),
              neigh->ifp->name,
              neigh->reach,
              neighbour_rxcost(neigh),
              neigh->txcost,
              format_thousands(neigh->rtt),
+             neigh->rtt_twamp ? " (twamp)" : "",
              neighbour_rttcost(neigh),
              if_up(neigh->ifp) ? "" : " (down)");
 }
@@ -1182,6 +1203,7 @@ babel_if_init(void)
     install_element(INTERFACE_NODE, &babel_set_rtt_max_cmd);
     install_element(INTERFACE_NODE, &babel_set_max_rtt_penalty_cmd);
     install_element(INTERFACE_NODE, &babel_set_enable_timestamps_cmd);
+    install_element(INTERFACE_NODE, &babel_set_twamp_rtt_cmd);
 
     /* "show babel ..." commands */
     install_element(VIEW_NODE, &show_babel_interface_cmd);
@@ -1246,6 +1268,10 @@ interface_config_write (struct vty *vty)
 		vty_out(vty, " babel enable-timestamps\n");
 		write++;
 	}
+	if (CHECK_FLAG(babel_ifp->flags, BABEL_IF_TWAMP_RTT)) {
+		vty_out(vty, " babel rtt-source twamp\n");
+		write++;
+	}
 	if (babel_ifp->max_rtt_penalty != BABEL_DEFAULT_MAX_RTT_PENALTY) {
 		vty_out(vty, " babel max-rtt-penalty %u\n",
 			babel_ifp->max_rtt_penalty);
@@ -72,6 +72,7 @@ static inline babel_interface_nfo* babel_get_if_nfo(struct interface *ifp)
 #define BABEL_IF_LQ            (1 << 3)
 #define BABEL_IF_FARAWAY       (1 << 4)
 #define BABEL_IF_TIMESTAMPS    (1 << 5)
+#define BABEL_IF_TWAMP_RTT     (1 << 6)
 
 /* Only INTERFERING can appear on the wire. */
 #define BABEL_IF_CHANNEL_UNKNOWN 0
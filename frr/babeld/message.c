@@ -755,8 +755,10 @@ parse_packet(const unsigned char *from, struct interface *ifp,
         goto done;
     }
 
-    /* We can calculate the RTT to this neighbour. */
-    if(have_hello_rtt && hello_send_us && hello_rtt_receive_time) {
+    /* We can calculate the RTT to this neighbour, unless TWAMP measures
+       it for us. */
+    if(have_hello_rtt && hello_send_us && hello_rtt_receive_time &&
+       !neigh->rtt_twamp) {
         int remote_waiting_us, local_waiting_us;
         unsigned int rtt, smoothed_rtt;
         unsigned int old_rttcost;
@@ -26,6 +26,7 @@ Copyright (c) 2007, 2008 by Juliusz Chroboczek
 #include "message.h"
 #include "resend.h"
 #include "babel_errors.h"
+#include "bgpd/bgp_twamp_ipc.h"
 
 struct neighbour *neighs = NULL;
 
@@ -94,6 +95,7 @@ find_neighbour(const unsigned char *address, struct interface *ifp)
     neigh->hello_rtt_receive_time = zero;
     neigh->rtt = 0;
     neigh->rtt_time = zero;
+    neigh->rtt_twamp = 0;
     neigh->ifp = ifp;
     neigh->next = neighs;
     neighs = neigh;
@@ -216,15 +218,83 @@ neighbour_txcost(struct neighbour *neigh)
     return neigh->txcost;
 }
 
+/* RTTs measured by a TWAMP agent, from the segment bgpd publishes.  */
+
+/* A measurement older than this, in seconds, is no measurement. */
+#define TWAMP_RTT_STALE 60
+
+static struct twamp_shm_reader twamp_reader;
+
+/* The RTT to neigh in microseconds, UINT32_MAX if it is lost; 0 if there
+   is no fresh measurement.  Babel only runs in the default VRF. */
+static int
+twamp_rtt(struct neighbour *neigh, unsigned int *rtt)
+{
+    struct in6_addr key;
+    uint32_t latency, jitter;
+    uint16_t loss;
+
+    /* Babel keeps IPv4 addresses v4-mapped, as the segment does. */
+    memcpy(&key, neigh->address, sizeof(key));
+    if(twamp_shm_reader_lookup(&twamp_reader, &key, 0, TWAMP_RTT_STALE,
+                               &latency, &jitter, &loss))
+        return 0;
+
+    *rtt = loss >= 1000 ? UINT32_MAX : latency;
+    return 1;
+}
+
+/* Take the RTT of neigh from TWAMP if it is measured there.  Return true
+   if the cost changed. */
+static int
+update_neighbour_twamp_rtt(struct neighbour *neigh, int attached)
+{
+    babel_interface_nfo *babel_ifp = babel_get_if_nfo(neigh->ifp);
+    unsigned int rtt, old_rttcost;
+
+    if(!(babel_ifp->flags & BABEL_IF_TWAMP_RTT) || !attached ||
+       !twamp_rtt(neigh, &rtt)) {
+        /* Back to the timestamps, if any. */
+        if(neigh->rtt_twamp) {
+            neigh->rtt_twamp = 0;
+            neigh->rtt_time = (struct timeval){0, 0};
+            return 1;
+        }
+        return 0;
+    }
+
+    /* A lost neighbour gets the full penalty, rttcost caps it there. */
+    if(rtt > babel_ifp->rtt_max)
+        rtt = babel_ifp->rtt_max + 1;
+
+    old_rttcost = neighbour_rttcost(neigh);
+    neigh->rtt = rtt;
+    neigh->rtt_time = babel_now;
+    neigh->rtt_twamp = 1;
+    return neighbour_rttcost(neigh) != old_rttcost;
+}
+
 unsigned
 check_neighbours(void)
 {
     struct neighbour *neigh;
     int changed, rc;
     unsigned msecs = 50000;
+    int attached = 0;
+    const char *why;
 
     debugf(BABEL_DEBUG_COMMON,"Checking neighbours.");
 
+    FOR_ALL_NEIGHBOURS(neigh) {
+        if(babel_get_if_nfo(neigh->ifp)->flags & BABEL_IF_TWAMP_RTT) {
+            attached = twamp_shm_reader_attach(&twamp_reader, &why);
+            if(why)
+                debugf(BABEL_DEBUG_COMMON, "Ignoring %s: %s.",
+                       TWAMP_SHM_NAME, why);
+            break;
+        }
+    }
+
     neigh = neighs;
     while(neigh) {
         changed = update_neighbour(neigh, -1, 0);
@@ -240,6 +310,8 @@ check_neighbours(void)
 
         rc = reset_txcost(neigh);
         changed = changed || rc;
+        rc = update_neighbour_twamp_rtt(neigh, attached);
+        changed = changed || rc;
 
         update_neighbour_metric(neigh, changed);
 
@@ -24,6 +24,8 @@ struct neighbour {
     struct timeval hello_rtt_receive_time;
     unsigned int rtt;
     struct timeval rtt_time;
+    /* rtt comes from a TWAMP agent rather than the timestamps. */
+    unsigned char rtt_twamp;
     struct interface *ifp;
 };
 
@@ -386,17 +386,17 @@ void bfd_session_disable(struct bfd_session *bs)
 	if (bs->bdc)
 		return;
 
+	/* Disable all timers, before a worker may send on a closed socket. */
+	bfd_recvtimer_delete(bs);
+	bfd_xmttimer_delete(bs);
+	ptm_bfd_echo_stop(bs);
+
 	/* Free up socket resources. */
 	if (bs->sock != -1) {
 		close(bs->sock);
 		bs->sock = -1;
 	}
 
-	/* Disable all timers. */
-	bfd_recvtimer_delete(bs);
-	bfd_xmttimer_delete(bs);
-	ptm_bfd_echo_stop(bs);
-
 	/* Set session down so it doesn't report UP and disabled. */
 	ptm_bfd_sess_dn(bs, BD_PATH_DOWN);
 }
@@ -417,13 +417,10 @@ static uint32_t ptm_bfd_gen_ID(void)
 	return session_id;
 }
 
-void ptm_bfd_start_xmt_timer(struct bfd_session *bfd, bool is_echo)
+uint64_t ptm_bfd_xmt_jitter(uint64_t xmt_TO, uint8_t detect_mult)
 {
-	uint64_t jitter, xmt_TO;
 	int maxpercent;
 
-	xmt_TO = is_echo ? bfd->echo_xmt_TO : bfd->xmt_TO;
-
 	/*
 	 * From section 6.5.2: trasmit interval should be randomly jittered
 	 * between
@@ -431,9 +428,17 @@ void ptm_bfd_start_xmt_timer(struct bfd_session *bfd, bool is_echo)
 	 * be
 	 * between 75% and 90%.
 	 */
-	maxpercent = (bfd->detect_mult == 1) ? 16 : 26;
-	jitter = (xmt_TO * (75 + (frr_weak_random() % maxpercent))) / 100;
-	/* XXX remove that division above */
+	maxpercent = (detect_mult == 1) ? 16 : 26;
+	/* XXX remove that division below */
+	return (xmt_TO * (75 + (frr_weak_random() % maxpercent))) / 100;
+}
+
+void ptm_bfd_start_xmt_timer(struct bfd_session *bfd, bool is_echo)
+{
+	uint64_t jitter, xmt_TO;
+
+	xmt_TO = is_echo ? bfd->echo_xmt_TO : bfd->xmt_TO;
+	jitter = ptm_bfd_xmt_jitter(xmt_TO, bfd->detect_mult);
 
 	if (is_echo)
 		bfd_echo_xmttimer_update(bfd, jitter);
@@ -477,6 +482,14 @@ void ptm_bfd_echo_stop(struct bfd_session *bfd)
 
 	bfd_echo_xmttimer_delete(bfd);
 	bfd_echo_recvtimer_delete(bfd);
+
+	/* Withdraw the round trip time the clients were told about. */
+	if (bfd->rtt_notified != BFD_RTT_NONE) {
+		bfd_rtt_init(bfd);
+		if (bfd->ses_state == PTM_BFD_UP)
+			ptm_bfd_notify(bfd, bfd->ses_state);
+	} else
+		bfd_rtt_init(bfd);
 }
 
 void ptm_bfd_echo_start(struct bfd_session *bfd)
@@ -802,6 +815,7 @@ void bfd_session_free(struct bfd_session *bs)
 	struct bfd_session_observer *bso;
 
 	bfd_session_disable(bs);
+	bfd_shard_session_free(bs);
 
 	/* Remove session from data plane if any. */
 	bfd_dplane_delete_session(bs);
@@ -2066,4 +2080,51 @@ void bfd_rtt_init(struct bfd_session *bfd)
 	bfd->rtt_index = 0;
 	for (i = 0; i < BFD_RTT_SAMPLE; i++)
 		bfd->rtt[i] = 0;
+	bfd->rtt_notified = BFD_RTT_NONE;
+}
+
+uint32_t bfd_rtt_average(const struct bfd_session *bfd)
+{
+	uint64_t total = 0;
+	uint8_t i;
+
+	if (bfd->rtt_valid == 0)
+		return BFD_RTT_NONE;
+
+	for (i = 0; i < bfd->rtt_valid; i++)
+		total += bfd->rtt[i];
+
+	return MIN(total / bfd->rtt_valid, (uint64_t)BFD_RTT_NONE - 1);
+}
+
+void bfd_rtt_add(struct bfd_session *bfd, uint64_t rtt)
+{
+	uint32_t avg, delta;
+
+	bfd->rtt[bfd->rtt_index] = rtt;
+	bfd->rtt_index++;
+	if (bfd->rtt_index >= BFD_RTT_SAMPLE)
+		bfd->rtt_index = 0;
+	if (bfd->rtt_valid < BFD_RTT_SAMPLE)
+		bfd->rtt_valid++;
+
+	/*
+	 * Report the average to the clients at most once per sample window
+	 * and only when it moved by more than an eighth, so echo does not
+	 * turn into a stream of zebra messages.
+	 */
+	if (bfd->rtt_valid < BFD_RTT_SAMPLE || bfd->rtt_index != 0)
+		return;
+	if (bfd->ses_state != PTM_BFD_UP)
+		return;
+
+	avg = bfd_rtt_average(bfd);
+	if (bfd->rtt_notified != BFD_RTT_NONE) {
+		delta = avg > bfd->rtt_notified ? avg - bfd->rtt_notified
+						: bfd->rtt_notified - avg;
+		if (delta <= bfd->rtt_notified / 8)
+			return;
+	}
+
+	ptm_bfd_notify(bfd, bfd->ses_state);
 }
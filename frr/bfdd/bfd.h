@@ -252,6 +252,8 @@ struct bfd_config_timers {
 };
 
 #define BFD_RTT_SAMPLE 8
+/* No echo round trip time to report, same value as lib's BFD_RTT_UNKNOWN. */
+#define BFD_RTT_NONE UINT32_MAX
 
 /*
  * Session state information
@@ -284,6 +286,8 @@ struct bfd_session {
 	uint64_t xmt_TO;
 	uint64_t echo_xmt_TO;
 	struct event *xmttimer_ev;
+	/* Control packets sent from a worker instead: see bfd_shard.c */
+	struct bfd_shard_tx *tx;
 	struct event *echo_xmttimer_ev;
 	uint64_t echo_detect_TO;
 
@@ -295,6 +299,9 @@ struct bfd_session {
 	struct peer_label *pl;
 
 	struct bfd_dplane_ctx *bdc;
+	/* Waiting for room in the data plane output buffer */
+	bool dplane_pending;
+	TAILQ_ENTRY(bfd_session) dplane_entry;
 	struct sockaddr_any local_address;
 	uint8_t peer_hw_addr[ETH_ALEN];
 	struct interface *ifp;
@@ -319,6 +326,7 @@ struct bfd_session {
 	uint8_t rtt_valid;	    /* number of valid samples */
 	uint8_t rtt_index;	    /* last index added */
 	uint64_t rtt[BFD_RTT_SAMPLE]; /* RRT in usec for echo to be looped */
+	uint32_t rtt_notified;	    /* average last sent to the clients */
 };
 
 struct peer_label {
@@ -563,6 +571,10 @@ int bp_peer_socketv6(const struct bfd_session *bs);
 int bp_echo_socket(const struct vrf *vrf);
 int bp_echov6_socket(const struct vrf *vrf);
 
+socklen_t bp_peer_addr(const struct bfd_session *bs, uint16_t *port,
+		       struct sockaddr_storage *ss);
+void bfd_pkt_build(const struct bfd_session *bfd, struct bfd_pkt *pkt,
+		   int fbit);
 void ptm_bfd_snd(struct bfd_session *bfd, int fbit);
 void ptm_bfd_echo_snd(struct bfd_session *bfd);
 void ptm_bfd_echo_fp_snd(struct bfd_session *bfd);
@@ -577,6 +589,8 @@ void bfd_recv_cb(struct event *t);
  */
 typedef void (*bfd_ev_cb)(struct event *t);
 
+void tv_normalize(struct timeval *tv);
+
 void bfd_recvtimer_update(struct bfd_session *bs);
 void bfd_echo_recvtimer_update(struct bfd_session *bs);
 void bfd_xmttimer_update(struct bfd_session *bs, uint64_t jitter);
@@ -608,6 +622,7 @@ void ptm_bfd_echo_stop(struct bfd_session *bfd);
 void ptm_bfd_echo_start(struct bfd_session *bfd);
 void ptm_bfd_xmt_TO(struct bfd_session *bfd, int fbit);
 void ptm_bfd_start_xmt_timer(struct bfd_session *bfd, bool is_echo);
+uint64_t ptm_bfd_xmt_jitter(uint64_t xmt_TO, uint8_t detect_mult);
 struct bfd_session *ptm_bfd_sess_find(struct bfd_pkt *cp,
 				      struct sockaddr_any *peer,
 				      struct sockaddr_any *local,
@@ -644,6 +659,8 @@ const struct bfd_session *bfd_session_next(const struct bfd_session *bs,
 void bfd_sessions_remove_manual(void);
 void bfd_profiles_remove(void);
 void bfd_rtt_init(struct bfd_session *bfd);
+void bfd_rtt_add(struct bfd_session *bfd, uint64_t rtt);
+uint32_t bfd_rtt_average(const struct bfd_session *bfd);
 
 /**
  * Set the BFD session echo state.
@@ -789,6 +806,20 @@ void bfdd_sessions_disable_vrf(struct vrf *vrf);
 
 int ptm_bfd_notify(struct bfd_session *bs, uint8_t notify_state);
 
+/*
+ * bfd_shard.c
+ *
+ * Periodic control packets sent from worker pthreads.
+ */
+void bfd_shard_init(unsigned int workers);
+void bfd_shard_terminate(void);
+/* Schedule or stop the session's packets on its worker; false if none */
+bool bfd_shard_xmttimer_update(struct bfd_session *bs, uint64_t jitter);
+void bfd_shard_xmttimer_delete(struct bfd_session *bs);
+/* The session changed: rebuild what its worker sends, sync counters */
+void bfd_shard_refresh(struct bfd_session *bs);
+void bfd_shard_session_free(struct bfd_session *bs);
+
 /*
  * dplane.c
  */
@@ -816,9 +847,14 @@ int bfd_dplane_add_session(struct bfd_session *bs);
 /**
  * Send new session settings to data plane.
  *
+ * When the output buffer is full the session is queued and its settings
+ * are sent once there is room again, so bursts of updates (e.g. all the
+ * sessions moving to a newly connected data plane) are not lost and
+ * updates of a queued session are sent only once.
+ *
  * \param bs the BFD session to update.
  */
-int bfd_dplane_update_session(const struct bfd_session *bs);
+int bfd_dplane_update_session(struct bfd_session *bs);
 
 /**
  * Deletes session from data plane.
@@ -67,51 +67,56 @@ static void bp_bind_ipv6(int sd, uint16_t port);
 /*
  * Functions
  */
-int _ptm_bfd_send(struct bfd_session *bs, uint16_t *port, const void *data,
-		  size_t datalen)
+socklen_t bp_peer_addr(const struct bfd_session *bs, uint16_t *port,
+		       struct sockaddr_storage *ss)
 {
-	struct sockaddr *sa;
-	struct sockaddr_in sin;
-	struct sockaddr_in6 sin6;
+	struct sockaddr_in *sin = (struct sockaddr_in *)ss;
+	struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ss;
 	socklen_t slen;
-	ssize_t rv;
-	int sd = -1;
 
+	memset(ss, 0, sizeof(*ss));
 	if (CHECK_FLAG(bs->flags, BFD_SESS_FLAG_IPV6)) {
-		memset(&sin6, 0, sizeof(sin6));
-		sin6.sin6_family = AF_INET6;
-		memcpy(&sin6.sin6_addr, &bs->key.peer, sizeof(sin6.sin6_addr));
-		if (bs->ifp && IN6_IS_ADDR_LINKLOCAL(&sin6.sin6_addr))
-			sin6.sin6_scope_id = bs->ifp->ifindex;
+		sin6->sin6_family = AF_INET6;
+		memcpy(&sin6->sin6_addr, &bs->key.peer,
+		       sizeof(sin6->sin6_addr));
+		if (bs->ifp && IN6_IS_ADDR_LINKLOCAL(&sin6->sin6_addr))
+			sin6->sin6_scope_id = bs->ifp->ifindex;
 
-		sin6.sin6_port =
+		sin6->sin6_port =
 			(port) ? *port
 			       : (CHECK_FLAG(bs->flags, BFD_SESS_FLAG_MH))
 					 ? htons(BFD_DEF_MHOP_DEST_PORT)
 					 : htons(BFD_DEFDESTPORT);
 
-		sd = bs->sock;
-		sa = (struct sockaddr *)&sin6;
-		slen = sizeof(sin6);
+		slen = sizeof(*sin6);
 	} else {
-		memset(&sin, 0, sizeof(sin));
-		sin.sin_family = AF_INET;
-		memcpy(&sin.sin_addr, &bs->key.peer, sizeof(sin.sin_addr));
-		sin.sin_port =
+		sin->sin_family = AF_INET;
+		memcpy(&sin->sin_addr, &bs->key.peer, sizeof(sin->sin_addr));
+		sin->sin_port =
 			(port) ? *port
 			       : (CHECK_FLAG(bs->flags, BFD_SESS_FLAG_MH))
 					 ? htons(BFD_DEF_MHOP_DEST_PORT)
 					 : htons(BFD_DEFDESTPORT);
 
-		sd = bs->sock;
-		sa = (struct sockaddr *)&sin;
-		slen = sizeof(sin);
+		slen = sizeof(*sin);
 	}
 
 #ifdef HAVE_STRUCT_SOCKADDR_SA_LEN
-	sa->sa_len = slen;
+	((struct sockaddr *)ss)->sa_len = slen;
 #endif /* HAVE_STRUCT_SOCKADDR_SA_LEN */
-	rv = sendto(sd, data, datalen, 0, sa, slen);
+	return slen;
+}
+
+int _ptm_bfd_send(struct bfd_session *bs, uint16_t *port, const void *data,
+		  size_t datalen)
+{
+	struct sockaddr_storage ss;
+	socklen_t slen;
+	ssize_t rv;
+	int sd = bs->sock;
+
+	slen = bp_peer_addr(bs, port, &ss);
+	rv = sendto(sd, data, datalen, 0, (struct sockaddr *)&ss, slen);
 	if (rv <= 0) {
 		if (bglobal.debug_network)
 			zlog_debug("packet-send: send failure: %s",
@@ -277,6 +282,7 @@ void ptm_bfd_echo_snd(struct bfd_session *bfd)
 	struct bfd_echo_pkt bep;
 	struct sockaddr_in sin;
 	struct sockaddr_in6 sin6;
+	struct timeval time_sent;
 	struct bfd_vrf_global *bvrf = bfd_vrf_look_by_session(bfd);
 
 	if (!bvrf)
@@ -289,6 +295,11 @@ void ptm_bfd_echo_snd(struct bfd_session *bfd)
 	bep.len = BFD_ECHO_PKT_LEN;
 	bep.my_discr = htonl(bfd->discrs.my_discr);
 
+	/* RTT calculation: add starting time in packet */
+	monotime(&time_sent);
+	bep.time_sent_sec = htobe64(time_sent.tv_sec);
+	bep.time_sent_usec = htobe64(time_sent.tv_usec);
+
 	if (CHECK_FLAG(bfd->flags, BFD_SESS_FLAG_IPV6)) {
 		if (bvrf->bg_echov6 == -1)
 			return;
@@ -355,14 +366,8 @@ static int ptm_bfd_process_echo_pkt(struct bfd_vrf_global *bvrf, int s)
 	}
 
 	/* RTT Calculation: add current RTT to samples */
-	if (my_rtt != 0) {
-		bfd->rtt[bfd->rtt_index] = my_rtt;
-		bfd->rtt_index++;
-		if (bfd->rtt_index >= BFD_RTT_SAMPLE)
-			bfd->rtt_index = 0;
-		if (bfd->rtt_valid < BFD_RTT_SAMPLE)
-			bfd->rtt_valid++;
-	}
+	if (my_rtt != 0)
+		bfd_rtt_add(bfd, my_rtt);
 
 	bfd->stats.rx_echo_pkt++;
 
@@ -376,7 +381,8 @@ static int ptm_bfd_process_echo_pkt(struct bfd_vrf_global *bvrf, int s)
 	return 0;
 }
 
-void ptm_bfd_snd(struct bfd_session *bfd, int fbit)
+void bfd_pkt_build(const struct bfd_session *bfd, struct bfd_pkt *pkt,
+		   int fbit)
 {
 	struct bfd_pkt cp = {};
 
@@ -423,6 +429,17 @@ void ptm_bfd_snd(struct bfd_session *bfd, int fbit)
 	}
 	cp.timers.required_min_echo = htonl(bfd->timers.required_min_echo_rx);
 
+	*pkt = cp;
+}
+
+void ptm_bfd_snd(struct bfd_session *bfd, int fbit)
+{
+	struct bfd_pkt cp;
+
+	bfd_pkt_build(bfd, &cp, fbit);
+	/* The periodic packets from now on, if a worker sends them */
+	bfd_shard_refresh(bfd);
+
 	if (_ptm_bfd_send(bfd, NULL, &cp, BFD_PKT_LEN) != 0)
 		return;
 
@@ -1018,6 +1035,9 @@ void bfd_recv_cb(struct event *t)
 	/* Handle echo timers changes. */
 	bs_echo_timer_handler(bfd);
 
+	/* State, timers and discriminators for the next periodic packets */
+	bfd_shard_refresh(bfd);
+
 	/*
 	 * We've received a packet with the POLL bit set, we must send
 	 * a control packet back with the FINAL bit set.
@@ -1099,16 +1119,17 @@ int bp_bfd_echo_in(struct bfd_vrf_global *bvrf, int sd, uint8_t *ttl,
 		return -1;
 	}
 
-#ifdef BFD_LINUX
-	/* RTT Calculation: determine RTT time of IPv4 echo pkt */
-	if (sd == bvrf->bg_echo) {
+	/*
+	 * RTT Calculation: both the fastpath and the socket senders stamp
+	 * the packet, a zero stamp comes from a sender that did not.
+	 */
+	if (bep->time_sent_sec != 0 || bep->time_sent_usec != 0) {
 		struct timeval time_sent = {0, 0};
 
 		time_sent.tv_sec = be64toh(bep->time_sent_sec);
 		time_sent.tv_usec = be64toh(bep->time_sent_usec);
 		*my_rtt = monotime_since(&time_sent, NULL);
 	}
-#endif
 
 	return 0;
 }
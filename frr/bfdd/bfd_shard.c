@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * BFD control packets sent from worker pthreads.
+ *
+ * With --workers, the periodic control packets of software sessions go
+ * out from worker pthreads, each with its own event loop and timers, the
+ * sessions spread over them by local discriminator. Receiving, detection
+ * timers and the state machine stay on the main pthread, so state changes
+ * remain serialized there.
+ *
+ * Workers never look at a session: the main pthread keeps a copy of the
+ * next packet, its destination and socket for them, rebuilt whenever it
+ * sends or receives for the session.
+ */
+
+#include <zebra.h>
+
+#include "frr_pthread.h"
+#include "frratomic.h"
+#include "memory.h"
+
+#include "bfd.h"
+
+DEFINE_MTYPE_STATIC(BFDD, BFDD_SHARD, "BFD worker");
+DEFINE_MTYPE_STATIC(BFDD, BFDD_SHARD_TX, "BFD worker session");
+
+struct bfd_shard {
+	struct frr_pthread *fpt;
+	/* Protects the packets of the worker's sessions */
+	pthread_mutex_t mtx;
+};
+
+struct bfd_shard_tx {
+	struct bfd_shard *shard;
+	struct event *ev;
+
+	/* Set by the main pthread, under shard->mtx */
+	struct bfd_pkt pkt;
+	struct sockaddr_storage dst;
+	socklen_t dstlen;
+	int sd;
+	uint64_t xmt_TO;
+	uint8_t detect_mult;
+
+	/* Sent since last folded into the session statistics */
+	_Atomic uint64_t sent;
+};
+
+static struct bfd_shard *shards;
+static unsigned int shard_count;
+
+static void bfd_shard_xmt_cb(struct event *t);
+
+static void bfd_shard_timer_add(struct bfd_shard_tx *tx, uint64_t jitter)
+{
+	struct timeval tv = {.tv_sec = 0, .tv_usec = jitter};
+
+	tv_normalize(&tv);
+	event_add_timer_tv(tx->shard->fpt->master, bfd_shard_xmt_cb, tx, &tv,
+			   &tx->ev);
+}
+
+/* Worker pthread: send the packet of a session, schedule the next one */
+static void bfd_shard_xmt_cb(struct event *t)
+{
+	struct bfd_shard_tx *tx = EVENT_ARG(t);
+	struct sockaddr_storage dst;
+	struct bfd_pkt pkt;
+	socklen_t dstlen;
+	uint64_t jitter;
+	int sd;
+
+	frr_with_mutex (&tx->shard->mtx) {
+		pkt = tx->pkt;
+		dst = tx->dst;
+		dstlen = tx->dstlen;
+		sd = tx->sd;
+		jitter = ptm_bfd_xmt_jitter(tx->xmt_TO, tx->detect_mult);
+	}
+	if (sd == -1)
+		return;
+
+	if (sendto(sd, &pkt, BFD_PKT_LEN, 0, (struct sockaddr *)&dst,
+		   dstlen) > 0)
+		atomic_fetch_add_explicit(&tx->sent, 1, memory_order_relaxed);
+	else if (bglobal.debug_network)
+		zlog_debug("packet-send: send failure: %s", strerror(errno));
+
+	bfd_shard_timer_add(tx, jitter);
+}
+
+void bfd_shard_refresh(struct bfd_session *bs)
+{
+	struct bfd_shard_tx *tx = bs->tx;
+
+	if (!tx)
+		return;
+
+	bs->stats.tx_ctrl_pkt += atomic_exchange_explicit(&tx->sent, 0,
+							  memory_order_relaxed);
+
+	frr_with_mutex (&tx->shard->mtx) {
+		bfd_pkt_build(bs, &tx->pkt, 0);
+		tx->dstlen = bp_peer_addr(bs, NULL, &tx->dst);
+		tx->sd = bs->sock;
+		tx->xmt_TO = bs->xmt_TO;
+		tx->detect_mult = bs->detect_mult;
+	}
+}
+
+bool bfd_shard_xmttimer_update(struct bfd_session *bs, uint64_t jitter)
+{
+	struct bfd_shard_tx *tx = bs->tx;
+
+	/* Distributed BFD sends on its own */
+	if (!shard_count || bs->bdc)
+		return false;
+
+	if (!tx) {
+		tx = XCALLOC(MTYPE_BFDD_SHARD_TX, sizeof(*tx));
+		tx->shard = &shards[bs->discrs.my_discr % shard_count];
+		tx->sd = -1;
+		bs->tx = tx;
+	}
+
+	bfd_shard_refresh(bs);
+	bfd_shard_timer_add(tx, jitter);
+	return true;
+}
+
+void bfd_shard_xmttimer_delete(struct bfd_session *bs)
+{
+	struct bfd_shard_tx *tx = bs->tx;
+
+	if (!tx)
+		return;
+
+	frr_with_mutex (&tx->shard->mtx) {
+		tx->sd = -1;
+	}
+	/* Returns once the worker is done with it, even if it was sending */
+	event_cancel_async(tx->shard->fpt->master, &tx->ev, NULL);
+}
+
+void bfd_shard_session_free(struct bfd_session *bs)
+{
+	if (!bs->tx)
+		return;
+
+	bfd_shard_xmttimer_delete(bs);
+	bs->stats.tx_ctrl_pkt += atomic_load_explicit(&bs->tx->sent,
+						      memory_order_relaxed);
+	XFREE(MTYPE_BFDD_SHARD_TX, bs->tx);
+}
+
+void bfd_shard_init(unsigned int workers)
+{
+	struct frr_pthread_attr attr = {
+		.start = frr_pthread_attr_default.start,
+		.stop = frr_pthread_attr_default.stop,
+	};
+	char name[OS_THREAD_NAMELEN];
+	unsigned int i;
+
+	if (!workers)
+		return;
+
+	shards = XCALLOC(MTYPE_BFDD_SHARD, workers * sizeof(*shards));
+	for (i = 0; i < workers; i++) {
+		snprintf(name, sizeof(name), "bfdd_tx%u", i);
+		pthread_mutex_init(&shards[i].mtx, NULL);
+		shards[i].fpt = frr_pthread_new(&attr, name, name);
+		frr_pthread_run(shards[i].fpt, NULL);
+		frr_pthread_wait_running(shards[i].fpt);
+	}
+	shard_count = workers;
+
+	zlog_info("BFD control packets sent from %u workers", workers);
+}
+
+void bfd_shard_terminate(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < shard_count; i++) {
+		frr_pthread_stop(shards[i].fpt, NULL);
+		frr_pthread_destroy(shards[i].fpt);
+		pthread_mutex_destroy(&shards[i].mtx);
+	}
+	shard_count = 0;
+	XFREE(MTYPE_BFDD_SHARD, shards);
+}
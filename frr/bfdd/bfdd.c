@@ -73,6 +73,9 @@ static void sigterm_handler(void)
 	/* Shutdown and free all protocol related memory. */
 	bfd_shutdown();
 
+	/* No sessions left for the workers, stop them. */
+	bfd_shard_terminate();
+
 	bfd_vrf_terminate();
 
 	/* Terminate and free() FRR related memory. */
@@ -125,9 +128,11 @@ FRR_DAEMON_INFO(bfdd, BFD, .vty_port = 2617,
 
 #define OPTION_CTLSOCK 1001
 #define OPTION_DPLANEADDR 2000
+#define OPTION_WORKERS 2001
 static const struct option longopts[] = {
 	{"bfdctl", required_argument, NULL, OPTION_CTLSOCK},
 	{"dplaneaddr", required_argument, NULL, OPTION_DPLANEADDR},
+	{"workers", required_argument, NULL, OPTION_WORKERS},
 	{0}
 };
 
@@ -321,6 +326,7 @@ int main(int argc, char *argv[])
 {
 	char ctl_path[512], dplane_addr[512];
 	bool ctlsockused = false;
+	unsigned int workers = 0;
 	int opt;
 
 	bglobal.bg_use_dplane = false;
@@ -331,7 +337,8 @@ int main(int argc, char *argv[])
 	frr_preinit(&bfdd_di, argc, argv);
 	frr_opt_add("", longopts,
 		    "      --bfdctl       Specify bfdd control socket\n"
-		    "      --dplaneaddr   Specify BFD data plane address\n");
+		    "      --dplaneaddr   Specify BFD data plane address\n"
+		    "      --workers      Send control packets from this many pthreads\n");
 
 	snprintf(ctl_path, sizeof(ctl_path), BFDD_CONTROL_SOCKET,
 		 "", "");
@@ -349,6 +356,14 @@ int main(int argc, char *argv[])
 			strlcpy(dplane_addr, optarg, sizeof(dplane_addr));
 			bglobal.bg_use_dplane = true;
 			break;
+		case OPTION_WORKERS:
+			workers = strtoul(optarg, NULL, 10);
+			if (workers < 1 || workers > 64) {
+				fprintf(stderr, "invalid number of workers: %s\n",
+					optarg);
+				exit(1);
+			}
+			break;
 
 		default:
 			frr_help_exit(1);
@@ -384,6 +399,9 @@ int main(int argc, char *argv[])
 	/* read configuration file and daemonize  */
 	frr_config_fork();
 
+	/* After daemonizing, pthreads do not survive the fork. */
+	bfd_shard_init(workers);
+
 	/* Initialize BFD data plane listening socket. */
 	if (bglobal.bg_use_dplane)
 		distributed_bfd_init(dplane_addr);
@@ -482,6 +482,7 @@ static void _clear_peer_counter(struct bfd_session *bs)
 {
 	/* Clear only pkt stats, intention is not to loose system
 	   events counters */
+	bfd_shard_refresh(bs);
 	bs->stats.rx_ctrl_pkt = 0;
 	bs->stats.tx_ctrl_pkt = 0;
 	bs->stats.rx_echo_pkt = 0;
@@ -617,27 +618,21 @@ _find_peer_or_error(struct vty *vty, int argc, struct cmd_token **argv,
 void _display_rtt(uint32_t *min, uint32_t *avg, uint32_t *max,
 		  struct bfd_session *bs)
 {
-#ifdef BFD_LINUX
 	uint8_t i;
-	uint32_t average = 0;
 
 	if (bs->rtt_valid == 0)
 		return;
 
 	*max = bs->rtt[0];
-	*min = 1000;
-	*avg = 0;
+	*min = bs->rtt[0];
 
 	for (i = 0; i < bs->rtt_valid; i++) {
 		if (bs->rtt[i] < *min)
 			*min = bs->rtt[i];
 		if (bs->rtt[i] > *max)
 			*max = bs->rtt[i];
-		average += bs->rtt[i];
 	}
-	*avg = average / bs->rtt_valid;
-
-#endif
+	*avg = bfd_rtt_average(bs);
 }
 
 /*
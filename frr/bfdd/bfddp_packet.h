@@ -71,6 +71,9 @@ enum bfddp_message_type {
 	DP_REQUEST_SESSION_COUNTERS = 5,
 	/** Tell BFD daemon about counters values. */
 	BFD_SESSION_COUNTERS = 6,
+
+	/** Tell BFD daemon about echo round trip times (asynchronous). */
+	BFD_SESSION_RTT = 7,
 };
 
 /**
@@ -346,6 +349,32 @@ struct bfddp_session_counters {
 	uint64_t echo_output_bytes;
 	/** Echo packets output. */
 	uint64_t echo_output_packets;
+
+	/**
+	 * Last echo round trip time in microseconds, zero when unknown.
+	 *
+	 * Data planes that loop echo in hardware should timestamp the packets
+	 * there, so the value does not include the software path. Data planes
+	 * that predate this field send a shorter message.
+	 */
+	uint32_t echo_rtt_usec;
+};
+
+/**
+ * Echo round trip time report entry.
+ *
+ * Message type: `BFD_SESSION_RTT`.
+ *
+ * The message carries as many entries as its length allows, so a data
+ * plane can report all its sessions in a few messages. It is sent with
+ * ID `0` whenever the data plane has new samples, typically once per
+ * echo interval, without waiting for a counters request.
+ */
+struct bfddp_session_rtt {
+	/** Session local discriminator. */
+	uint32_t lid;
+	/** Echo round trip time in microseconds. */
+	uint32_t rtt_usec;
 };
 
 /**
@@ -363,6 +392,7 @@ struct bfddp_message {
 		struct bfddp_control_packet control;
 		struct bfddp_request_counters counters_req;
 		struct bfddp_session_counters session_counters;
+		struct bfddp_session_rtt session_rtt;
 	} data;
 };
 
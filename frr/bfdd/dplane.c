@@ -86,6 +86,11 @@ struct bfd_dplane_ctx {
 	/** Amount of messages enqueued (maybe written). */
 	uint64_t out_msgs;
 
+	/** Sessions waiting for room in the output buffer. */
+	TAILQ_HEAD(, bfd_session) pending;
+	/** Amount of sessions waiting. */
+	uint64_t pending_count;
+
 	TAILQ_ENTRY(bfd_dplane_ctx) entry;
 };
 
@@ -99,6 +104,9 @@ static bool bfd_dplane_client_connecting(struct bfd_dplane_ctx *bdc);
 static void bfd_dplane_ctx_free(struct bfd_dplane_ctx *bdc);
 static int _bfd_dplane_add_session(struct bfd_dplane_ctx *bdc,
 				   struct bfd_session *bs);
+static void bfd_dplane_pending_del(struct bfd_dplane_ctx *bdc,
+				   struct bfd_session *bs);
+static void bfd_dplane_pending_send(struct bfd_dplane_ctx *bdc);
 
 /*
  * BFD data plane helper functions.
@@ -120,6 +128,8 @@ static const char *bfd_dplane_messagetype2str(enum bfddp_message_type bmt)
 		return "DP_REQUEST_SESSION_COUNTERS";
 	case BFD_SESSION_COUNTERS:
 		return "BFD_SESSION_COUNTERS";
+	case BFD_SESSION_RTT:
+		return "BFD_SESSION_RTT";
 	default:
 		return "UNKNOWN";
 	}
@@ -245,6 +255,14 @@ static void bfd_dplane_debug_message(const struct bfddp_message *msg)
 			be64toh(msg->data.session_counters
 				.echo_output_packets));
 		break;
+
+	case BFD_SESSION_RTT:
+		zlog_debug("  [sessions=%zu first{lid=%u rtt=%uus}]",
+			   (ntohs(msg->header.length) - sizeof(msg->header)) /
+				   sizeof(msg->data.session_rtt),
+			   ntohl(msg->data.session_rtt.lid),
+			   ntohl(msg->data.session_rtt.rtt_usec));
+		break;
 	}
 }
 
@@ -309,6 +327,9 @@ static ssize_t bfd_dplane_flush(struct bfd_dplane_ctx *bdc)
 	/* Disable write ready events. */
 	EVENT_OFF(bdc->outbufev);
 
+	/* Refill with the sessions that did not fit. */
+	bfd_dplane_pending_send(bdc);
+
 	return total;
 }
 
@@ -458,6 +479,29 @@ static void bfd_dplane_echo_request_handle(struct bfd_dplane_ctx *bdc,
 	bfd_dplane_enqueue(bdc, &msg, msglen);
 }
 
+static void bfd_dplane_session_rtt(struct bfd_dplane_ctx *bdc,
+				   const struct bfddp_message *msg)
+{
+	const struct bfddp_session_rtt *rtt = &msg->data.session_rtt;
+	struct bfd_session *bs;
+	size_t count;
+
+	if (ntohs(msg->header.length) < sizeof(msg->header))
+		return;
+
+	count = (ntohs(msg->header.length) - sizeof(msg->header)) /
+		sizeof(*rtt);
+	for (; count > 0; count--, rtt++) {
+		bs = bfd_id_lookup(ntohl(rtt->lid));
+		/* Only the data plane running the session measures it. */
+		if (bs == NULL || bs->bdc != bdc || rtt->rtt_usec == 0)
+			continue;
+
+		/* Same samples, and same client reporting, as software echo */
+		bfd_rtt_add(bs, ntohl(rtt->rtt_usec));
+	}
+}
+
 static void bfd_dplane_handle_message(struct bfddp_message *msg, void *arg)
 {
 	enum bfddp_message_type bmt;
@@ -472,6 +516,9 @@ static void bfd_dplane_handle_message(struct bfddp_message *msg, void *arg)
 	case BFD_STATE_CHANGE:
 		bfd_dplane_session_state_change(bdc, &msg->data.state);
 		break;
+	case BFD_SESSION_RTT:
+		bfd_dplane_session_rtt(bdc, msg);
+		break;
 	case ECHO_REPLY:
 		/* NOTHING: we don't do anything with this information. */
 		break;
@@ -623,8 +670,9 @@ static void _bfd_session_register_dplane(struct hash_bucket *hb, void *arg)
 	/* Disable software session. */
 	bfd_session_disable(bs);
 
-	/* Move session to data plane. */
-	_bfd_dplane_add_session(bdc, bs);
+	/* Move session to data plane, keep it in software if that fails. */
+	if (_bfd_dplane_add_session(bdc, bs) != 0)
+		bfd_session_enable(bs);
 }
 
 static struct bfd_dplane_ctx *bfd_dplane_ctx_new(int sock)
@@ -636,6 +684,7 @@ static struct bfd_dplane_ctx *bfd_dplane_ctx_new(int sock)
 	bdc->sock = sock;
 	bdc->inbuf = stream_new(BFD_DPLANE_CLIENT_BUF_SIZE);
 	bdc->outbuf = stream_new(BFD_DPLANE_CLIENT_BUF_SIZE);
+	TAILQ_INIT(&bdc->pending);
 
 	/* If not socket ready, skip read and session registration. */
 	if (sock == -1)
@@ -657,6 +706,7 @@ static void _bfd_session_unregister_dplane(struct hash_bucket *hb, void *arg)
 	if (bs->bdc != bdc)
 		return;
 
+	bfd_dplane_pending_del(bdc, bs);
 	bs->bdc = NULL;
 
 	/* Fallback to software. */
@@ -691,6 +741,10 @@ free_resources:
 	/* Remove from the list of attached data planes. */
 	TAILQ_REMOVE(&bglobal.bg_dplaneq, bdc, entry);
 
+	/* Sessions still queued must not point to the freed list. */
+	while (!TAILQ_EMPTY(&bdc->pending))
+		bfd_dplane_pending_del(bdc, TAILQ_FIRST(&bdc->pending));
+
 	/* Detach all associated sessions. */
 	if (bglobal.bg_shutdown == false)
 		bfd_key_iterate(_bfd_session_unregister_dplane, bdc);
@@ -749,6 +803,39 @@ static void _bfd_dplane_session_fill(const struct bfd_session *bs,
 	msg->data.session.min_echo_rx = htonl(bs->timers.required_min_echo_rx);
 }
 
+static void bfd_dplane_pending_del(struct bfd_dplane_ctx *bdc,
+				   struct bfd_session *bs)
+{
+	if (!bs->dplane_pending)
+		return;
+
+	TAILQ_REMOVE(&bdc->pending, bs, dplane_entry);
+	bdc->pending_count--;
+	bs->dplane_pending = false;
+}
+
+/**
+ * Sends the settings of the queued sessions, as many as fit in the
+ * output buffer. The rest waits for the next flush.
+ */
+static void bfd_dplane_pending_send(struct bfd_dplane_ctx *bdc)
+{
+	struct bfddp_message msg;
+	struct bfd_session *bs;
+
+	while ((bs = TAILQ_FIRST(&bdc->pending)) != NULL) {
+		if (sizeof(msg.header) + sizeof(msg.data.session) >
+		    STREAM_WRITEABLE(bdc->outbuf))
+			return;
+
+		bfd_dplane_pending_del(bdc, bs);
+
+		memset(&msg, 0, sizeof(msg));
+		_bfd_dplane_session_fill(bs, &msg);
+		bfd_dplane_enqueue(bdc, &msg, ntohs(msg.header.length));
+	}
+}
+
 static int _bfd_dplane_add_session(struct bfd_dplane_ctx *bdc,
 				   struct bfd_session *bs)
 {
@@ -783,6 +870,16 @@ static void _bfd_dplane_update_session_counters(struct bfddp_message *msg,
 		be64toh(msg->data.session_counters.echo_input_packets);
 	bs->stats.tx_echo_pkt =
 		be64toh(msg->data.session_counters.echo_output_bytes);
+
+	/* Data plane echo timestamps feed the same samples as ours. */
+	if (ntohs(msg->header.length) >=
+		    sizeof(msg->header) +
+			    offsetof(struct bfddp_session_counters,
+				     echo_rtt_usec) +
+			    sizeof(msg->data.session_counters.echo_rtt_usec) &&
+	    msg->data.session_counters.echo_rtt_usec != 0)
+		bfd_rtt_add(bs,
+			    ntohl(msg->data.session_counters.echo_rtt_usec));
 }
 
 /**
@@ -1084,17 +1181,37 @@ int bfd_dplane_add_session(struct bfd_session *bs)
 	return -1;
 }
 
-int bfd_dplane_update_session(const struct bfd_session *bs)
+int bfd_dplane_update_session(struct bfd_session *bs)
 {
+	struct bfd_dplane_ctx *bdc = bs->bdc;
 	struct bfddp_message msg = {};
 
-	if (bs->bdc == NULL)
+	if (bdc == NULL)
+		return 0;
+
+	/* Already queued: the latest settings are sent then. */
+	if (bs->dplane_pending)
+		return 0;
+
+	/*
+	 * No room, or others waiting before us: queue the session instead of
+	 * losing the update. Not yet connected clients still fail, so the
+	 * session goes to another data plane or stays in software.
+	 */
+	if (bdc->sock != -1
+	    && (!TAILQ_EMPTY(&bdc->pending)
+		|| sizeof(msg.header) + sizeof(msg.data.session) >
+			   STREAM_WRITEABLE(bdc->outbuf))) {
+		TAILQ_INSERT_TAIL(&bdc->pending, bs, dplane_entry);
+		bdc->pending_count++;
+		bs->dplane_pending = true;
 		return 0;
+	}
 
 	_bfd_dplane_session_fill(bs, &msg);
 
 	/* Enqueue message to data plane client. */
-	return bfd_dplane_enqueue(bs->bdc, &msg, ntohs(msg.header.length));
+	return bfd_dplane_enqueue(bdc, &msg, ntohs(msg.header.length));
 }
 
 int bfd_dplane_delete_session(struct bfd_session *bs)
@@ -1106,6 +1223,9 @@ int bfd_dplane_delete_session(struct bfd_session *bs)
 	if (bs->bdc == NULL)
 		return 0;
 
+	/* Its settings are of no use any more. */
+	bfd_dplane_pending_del(bs->bdc, bs);
+
 	/* Fill most of the common fields. */
 	_bfd_dplane_session_fill(bs, &msg);
 
@@ -1143,6 +1263,8 @@ void bfd_dplane_show_counters(struct vty *vty)
 		SHOW_COUNTER("Output bytes peak", bdc->out_bytes_peak, PRIu64);
 		SHOW_COUNTER("Output messages", bdc->out_msgs, PRIu64);
 		SHOW_COUNTER("Output full events", bdc->out_fullev, PRIu64);
+		SHOW_COUNTER("Output queued sessions", bdc->pending_count,
+			     PRIu64);
 		SHOW_COUNTER("Output current usage",
 			     STREAM_READABLE(bdc->inbuf), "zu");
 		vty_out(vty, "\n");
@@ -13,8 +13,6 @@
 
 #include "bfd.h"
 
-void tv_normalize(struct timeval *tv);
-
 void tv_normalize(struct timeval *tv)
 {
 	/* Remove seconds part from microseconds. */
@@ -70,6 +68,9 @@ void bfd_xmttimer_update(struct bfd_session *bs, uint64_t jitter)
 	    bs->sock == -1)
 		return;
 
+	if (bfd_shard_xmttimer_update(bs, jitter))
+		return;
+
 	tv_normalize(&tv);
 
 	event_add_timer_tv(master, bfd_xmt_cb, bs, &tv, &bs->xmttimer_ev);
@@ -105,6 +106,7 @@ void bfd_echo_recvtimer_delete(struct bfd_session *bs)
 
 void bfd_xmttimer_delete(struct bfd_session *bs)
 {
+	bfd_shard_xmttimer_delete(bs);
 	EVENT_OFF(bs->xmttimer_ev);
 }
 
@@ -201,6 +201,8 @@ int ptm_bfd_notify(struct bfd_session *bs, uint8_t notify_state)
 	 *     - 16 bytes: ipv6
 	 *   - c: prefix length
 	 * - c: cbit
+	 * - l: echo round trip time average in microseconds
+	 *      (UINT32_MAX when not measured)
 	 *
 	 * Commands: ZEBRA_BFD_DEST_REPLAY
 	 *
@@ -252,6 +254,10 @@ int ptm_bfd_notify(struct bfd_session *bs, uint8_t notify_state)
 
 	stream_putc(msg, bs->remote_cbit);
 
+	/* Clients that predate the field stop reading before it. */
+	bs->rtt_notified = bfd_rtt_average(bs);
+	stream_putl(msg, bs->rtt_notified);
+
 	/* Write packet size. */
 	stream_putw_at(msg, 0, stream_get_endp(msg));
 
@@ -33,6 +33,13 @@ static const struct bgp_addpath_strategy_names strat_names[BGP_ADDPATH_MAX] = {
 		.type_json_name = "addpathTxBestSelectedPaths",
 		.id_json_name = "addpathTxIdBestSelected"
 	},
+	{
+		.config_name = "addpath-tx-lowest-latency",
+		.human_name = "Lowest-Latency",
+		.human_description = "Advertise N lowest latency paths via addpath",
+		.type_json_name = "addpathTxLowestLatencyPaths",
+		.id_json_name = "addpathTxIdLowestLatency"
+	},
 };
 
 static const struct bgp_addpath_strategy_names unknown_names = {
@@ -169,6 +176,7 @@ bool bgp_addpath_tx_path(enum bgp_addpath_strat strat, struct bgp_path_info *pi)
 		else
 			return false;
 	case BGP_ADDPATH_BEST_SELECTED:
+	case BGP_ADDPATH_LOWEST_LATENCY:
 		return true;
 	case BGP_ADDPATH_MAX:
 		return false;
@@ -13,6 +13,7 @@ enum bgp_addpath_strat {
 	BGP_ADDPATH_ALL = 0,
 	BGP_ADDPATH_BEST_PER_AS,
 	BGP_ADDPATH_BEST_SELECTED,
+	BGP_ADDPATH_LOWEST_LATENCY,
 	BGP_ADDPATH_MAX,
 	BGP_ADDPATH_NONE,
 };
@@ -9,6 +9,7 @@
 #include "memory.h"
 #include "prefix.h"
 #include "hash.h"
+#include "jhash.h"
 #include "frrevent.h"
 #include "queue.h"
 #include "filter.h"
@@ -18,6 +19,9 @@
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_advertise.h"
 #include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_community.h"
+#include "bgpd/bgp_ecommunity.h"
+#include "bgpd/bgp_lcommunity.h"
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_packet.h"
@@ -132,6 +136,9 @@ bool bgp_adj_out_lookup(struct peer *peer, struct bgp_dest *dest,
 			uint32_t addpath_tx_id)
 {
 	struct bgp_adj_out *adj;
+	struct bgp_adj_out_set *set;
+	struct update_subgroup *subgrp;
+	struct bgp_table *table;
 	struct peer_af *paf;
 	afi_t afi;
 	safi_t safi;
@@ -158,10 +165,225 @@ bool bgp_adj_out_lookup(struct peer *peer, struct bgp_dest *dest,
 						: (adj->attr ? true : false));
 			}
 
+	/* Otherwise it may have been compacted, with nothing pending */
+	table = bgp_dest_table(dest);
+	subgrp = peer_subgroup(peer, table->afi, table->safi);
+	if (!subgrp || !subgrp->adj_compact)
+		return false;
+
+	addpath_capable = bgp_addpath_encode_tx(peer, table->afi, table->safi);
+	for (set = dest->adj_out_sets; set; set = set->next) {
+		if (!bgp_adj_out_set_test(set, subgrp->adj_slot))
+			continue;
+
+		if (addpath_capable && addpath_tx_id &&
+		    set->addpath_tx_id != addpath_tx_id)
+			continue;
+
+		return true;
+	}
+
 	return false;
 }
 
 
+static int bgp_adj_in_delta_cmp(const struct bgp_adj_in_delta *a,
+				const struct bgp_adj_in_delta *b)
+{
+	return memcmp(&a->val, &b->val, sizeof(a->val));
+}
+
+static uint32_t bgp_adj_in_delta_hash(const struct bgp_adj_in_delta *d)
+{
+	return jhash(&d->val, sizeof(d->val), 0x5eed);
+}
+
+DECLARE_HASH(bgp_adj_in_deltas, struct bgp_adj_in_delta, item,
+	     bgp_adj_in_delta_cmp, bgp_adj_in_delta_hash);
+
+static struct bgp_adj_in_deltas_head adj_in_deltas;
+
+/*
+ * The delta taking installed back to received, NULL if the policy changed
+ * more than the fields a delta holds.
+ */
+static struct bgp_adj_in_delta *bgp_adj_in_delta_get(const struct attr *received,
+						     const struct attr *installed)
+{
+	struct bgp_adj_in_delta ref, *delta;
+	struct attr undone = *installed;
+
+	memset(&ref.val, 0, sizeof(ref.val));
+	ref.val.flag = received->flag;
+	ref.val.community = bgp_attr_get_community(received);
+	ref.val.ecommunity = bgp_attr_get_ecommunity(received);
+	ref.val.lcommunity = bgp_attr_get_lcommunity(received);
+	ref.val.nexthop = received->nexthop;
+	ref.val.med = received->med;
+	ref.val.local_pref = received->local_pref;
+	ref.val.weight = received->weight;
+	ref.val.rmap_change_flags = received->rmap_change_flags;
+	ref.val.origin = received->origin;
+
+	undone.flag = ref.val.flag;
+	undone.community = ref.val.community;
+	undone.ecommunity = ref.val.ecommunity;
+	undone.lcommunity = ref.val.lcommunity;
+	undone.nexthop = ref.val.nexthop;
+	undone.med = ref.val.med;
+	undone.local_pref = ref.val.local_pref;
+	undone.weight = ref.val.weight;
+	undone.rmap_change_flags = ref.val.rmap_change_flags;
+	undone.origin = ref.val.origin;
+	if (!attrhash_cmp(&undone, received))
+		return NULL;
+
+	delta = bgp_adj_in_deltas_find(&adj_in_deltas, &ref);
+	if (!delta) {
+		delta = XCALLOC(MTYPE_BGP_ADJ_IN_DELTA, sizeof(*delta));
+		delta->val = ref.val;
+		/* The received attribute is interned, and so are these */
+		if (delta->val.community)
+			delta->val.community->refcnt++;
+		if (delta->val.ecommunity)
+			delta->val.ecommunity->refcnt++;
+		if (delta->val.lcommunity)
+			delta->val.lcommunity->refcnt++;
+		bgp_adj_in_deltas_add(&adj_in_deltas, delta);
+	}
+	delta->refcnt++;
+	return delta;
+}
+
+static void bgp_adj_in_delta_put(struct bgp_adj_in_delta **deltap)
+{
+	struct bgp_adj_in_delta *delta = *deltap;
+
+	*deltap = NULL;
+	if (!delta || --delta->refcnt)
+		return;
+
+	bgp_adj_in_deltas_del(&adj_in_deltas, delta);
+	if (delta->val.community)
+		community_unintern(&delta->val.community);
+	if (delta->val.ecommunity)
+		ecommunity_unintern(&delta->val.ecommunity);
+	if (delta->val.lcommunity)
+		lcommunity_unintern(&delta->val.lcommunity);
+	XFREE(MTYPE_BGP_ADJ_IN_DELTA, delta);
+}
+
+/* The attribute as received, into attr which is not interned */
+void bgp_adj_in_attr(const struct bgp_adj_in *adj, struct attr *attr)
+{
+	const struct bgp_adj_in_delta *delta = adj->delta;
+
+	*attr = *adj->attr;
+	if (!delta)
+		return;
+
+	attr->flag = delta->val.flag;
+	attr->community = delta->val.community;
+	attr->ecommunity = delta->val.ecommunity;
+	attr->lcommunity = delta->val.lcommunity;
+	attr->nexthop = delta->val.nexthop;
+	attr->med = delta->val.med;
+	attr->local_pref = delta->val.local_pref;
+	attr->weight = delta->val.weight;
+	attr->rmap_change_flags = delta->val.rmap_change_flags;
+	attr->origin = delta->val.origin;
+}
+
+static void bgp_adj_in_attr_set(struct bgp_adj_in *adj, struct attr *attr,
+				struct bgp_adj_in_delta *delta)
+{
+	struct attr *old = adj->attr;
+
+	/* Interned first, old may hold the only references to its parts */
+	adj->attr = bgp_attr_intern(attr);
+	bgp_attr_unintern(&old);
+	bgp_adj_in_delta_put(&adj->delta);
+	adj->delta = delta;
+}
+
+/*
+ * Keep the Adj-RIB-In entry of peer as what the inbound policy changed in
+ * the attribute installed for it: received attributes that only differ in
+ * what inbound route-maps set are then not kept each on their own.
+ */
+static void bgp_adj_in_compact_one(struct bgp_adj_in *adj,
+				   struct attr *installed)
+{
+	struct bgp_adj_in_delta *delta;
+	struct attr received;
+
+	if (adj->attr == installed)
+		return;
+
+	bgp_adj_in_attr(adj, &received);
+	if (attrhash_cmp(&received, installed)) {
+		/* Nothing changed by the policy, share the installed one */
+		bgp_adj_in_attr_set(adj, installed, NULL);
+		return;
+	}
+
+	delta = bgp_adj_in_delta_get(&received, installed);
+	if (delta)
+		bgp_adj_in_attr_set(adj, installed, delta);
+}
+
+void bgp_adj_in_compact(struct bgp_dest *dest, struct peer *peer,
+			uint32_t addpath_id, struct attr *installed)
+{
+	struct bgp_adj_in *adj;
+
+	for (adj = dest->adj_in; adj; adj = adj->next)
+		if (adj->peer == peer && adj->addpath_rx_id == addpath_id) {
+			bgp_adj_in_compact_one(adj, installed);
+			return;
+		}
+}
+
+/*
+ * As "bgp adj-in compact" is turned on or off: store every adj-in of the
+ * table against the path installed for it, or as received again.
+ */
+void bgp_adj_in_compact_table(struct bgp *bgp, afi_t afi, safi_t safi,
+			      bool compact)
+{
+	struct bgp_table *table = bgp->rib[afi][safi];
+	struct bgp_path_info *pi;
+	struct bgp_adj_in *adj;
+	struct bgp_dest *dest;
+	struct attr received;
+
+	if (!table)
+		return;
+
+	for (dest = bgp_table_top(table); dest; dest = bgp_route_next(dest)) {
+		for (adj = dest->adj_in; adj; adj = adj->next) {
+			if (!compact) {
+				if (!adj->delta)
+					continue;
+				bgp_adj_in_attr(adj, &received);
+				bgp_adj_in_attr_set(adj, &received, NULL);
+				continue;
+			}
+
+			for (pi = bgp_dest_get_bgp_path_info(dest); pi;
+			     pi = pi->next)
+				if (pi->peer == adj->peer &&
+				    pi->addpath_rx_id == adj->addpath_rx_id &&
+				    pi->type == ZEBRA_ROUTE_BGP &&
+				    pi->sub_type == BGP_ROUTE_NORMAL &&
+				    !CHECK_FLAG(pi->flags, BGP_PATH_REMOVED))
+					break;
+			if (pi)
+				bgp_adj_in_compact_one(adj, pi->attr);
+		}
+	}
+}
+
 void bgp_adj_in_set(struct bgp_dest *dest, struct peer *peer, struct attr *attr,
 		    uint32_t addpath_id)
 {
@@ -169,10 +391,8 @@ void bgp_adj_in_set(struct bgp_dest *dest, struct peer *peer, struct attr *attr,
 
 	for (adj = dest->adj_in; adj; adj = adj->next) {
 		if (adj->peer == peer && adj->addpath_rx_id == addpath_id) {
-			if (adj->attr != attr) {
-				bgp_attr_unintern(&adj->attr);
-				adj->attr = bgp_attr_intern(attr);
-			}
+			if (adj->attr != attr || adj->delta)
+				bgp_adj_in_attr_set(adj, attr, NULL);
 			return;
 		}
 	}
@@ -188,6 +408,7 @@ void bgp_adj_in_set(struct bgp_dest *dest, struct peer *peer, struct attr *attr,
 void bgp_adj_in_remove(struct bgp_dest **dest, struct bgp_adj_in *bai)
 {
 	bgp_attr_unintern(&bai->attr);
+	bgp_adj_in_delta_put(&bai->delta);
 	BGP_ADJ_IN_DEL(*dest, bai);
 	*dest = bgp_dest_unlock_node(*dest);
 	peer_unlock(bai->peer); /* adj_in peer reference */
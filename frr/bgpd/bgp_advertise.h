@@ -83,17 +83,73 @@ RB_HEAD(bgp_adj_out_rb, bgp_adj_out);
 RB_PROTOTYPE(bgp_adj_out_rb, bgp_adj_out, adj_entry,
 	     bgp_adj_out_compare);
 
+/*
+ * Compacted adj-out, for address families with "bgp adj-out compact". Once
+ * a subgroup's advertisement for a prefix has gone out, its bgp_adj_out is
+ * folded into the set of subgroups that advertised the same attribute with
+ * the same addpath ID there: one bit, at the subgroup's adj_slot, instead
+ * of an entry each. It is turned back into a bgp_adj_out when something
+ * is next queued for the subgroup and prefix.
+ */
+struct bgp_adj_out_set {
+	struct bgp_adj_out_set *next;
+
+	/* Advertised attribute and its hash */
+	struct attr *attr;
+	uint32_t attr_hash;
+
+	uint32_t addpath_tx_id;
+
+	/* Subgroups in the set, by adj_slot */
+	uint32_t words;
+	uint64_t slots[];
+};
+
+static inline bool bgp_adj_out_set_test(const struct bgp_adj_out_set *set,
+					uint32_t slot)
+{
+	return slot / 64 < set->words &&
+	       CHECK_FLAG(set->slots[slot / 64], (uint64_t)1 << (slot % 64));
+}
+
+PREDECL_HASH(bgp_adj_in_deltas);
+
+/*
+ * Under "bgp adj-in compact", what the inbound policy changed in a received
+ * attribute: the received values of the fields route-maps usually set.
+ * Shared by all the adj-ins it applies to, whatever their prefix or peer.
+ */
+struct bgp_adj_in_delta {
+	struct bgp_adj_in_deltas_item item;
+	unsigned long refcnt;
+
+	struct {
+		uint64_t flag;
+		struct community *community;
+		struct ecommunity *ecommunity;
+		struct lcommunity *lcommunity;
+		struct in_addr nexthop;
+		uint32_t med;
+		uint32_t local_pref;
+		uint32_t weight;
+		uint32_t rmap_change_flags;
+		uint8_t origin;
+	} val;
+};
+
 /* BGP adjacency in. */
 struct bgp_adj_in {
 	/* Linked list pointer.  */
 	struct bgp_adj_in *next;
-	struct bgp_adj_in *prev;
 
 	/* Received peer.  */
 	struct peer *peer;
 
-	/* Received attribute.  */
+	/* Received attribute, or if delta is set, the attribute installed
+	 * for it and what to undo there; see bgp_adj_in_attr().
+	 */
 	struct attr *attr;
+	struct bgp_adj_in_delta *delta;
 
 	/* timestamp (monotime) */
 	time_t uptime;
@@ -108,29 +164,21 @@ struct bgp_synchronize {
 	struct bgp_adv_fifo_head withdraw;
 };
 
-/* BGP adjacency linked list.  */
-#define BGP_PATH_INFO_ADD(N, A, TYPE)                                          \
+/* Adj-in entries are singly linked, there are few for a dest */
+#define BGP_ADJ_IN_ADD(N, A)                                                   \
 	do {                                                                   \
-		(A)->prev = NULL;                                              \
-		(A)->next = (N)->TYPE;                                         \
-		if ((N)->TYPE)                                                 \
-			(N)->TYPE->prev = (A);                                 \
-		(N)->TYPE = (A);                                               \
+		(A)->next = (N)->adj_in;                                       \
+		(N)->adj_in = (A);                                             \
 	} while (0)
 
-#define BGP_PATH_INFO_DEL(N, A, TYPE)                                          \
+#define BGP_ADJ_IN_DEL(N, A)                                                   \
 	do {                                                                   \
-		if ((A)->next)                                                 \
-			(A)->next->prev = (A)->prev;                           \
-		if ((A)->prev)                                                 \
-			(A)->prev->next = (A)->next;                           \
-		else                                                           \
-			(N)->TYPE = (A)->next;                                 \
+		struct bgp_adj_in **_adjp = &(N)->adj_in;                      \
+		while (*_adjp != (A))                                          \
+			_adjp = &(*_adjp)->next;                               \
+		*_adjp = (A)->next;                                            \
 	} while (0)
 
-#define BGP_ADJ_IN_ADD(N, A) BGP_PATH_INFO_ADD(N, A, adj_in)
-#define BGP_ADJ_IN_DEL(N, A) BGP_PATH_INFO_DEL(N, A, adj_in)
-
 /* Prototypes.  */
 extern bool bgp_adj_out_lookup(struct peer *peer, struct bgp_dest *dest,
 			       uint32_t addpath_tx_id);
@@ -139,6 +187,11 @@ extern void bgp_adj_in_set(struct bgp_dest *dest, struct peer *peer,
 extern bool bgp_adj_in_unset(struct bgp_dest **dest, struct peer *peer,
 			     uint32_t addpath_id);
 extern void bgp_adj_in_remove(struct bgp_dest **dest, struct bgp_adj_in *bai);
+extern void bgp_adj_in_attr(const struct bgp_adj_in *adj, struct attr *attr);
+extern void bgp_adj_in_compact(struct bgp_dest *dest, struct peer *peer,
+			       uint32_t addpath_id, struct attr *installed);
+extern void bgp_adj_in_compact_table(struct bgp *bgp, afi_t afi, safi_t safi,
+				     bool compact);
 
 extern unsigned int bgp_advertise_attr_hash_key(const void *p);
 extern bool bgp_advertise_attr_hash_cmp(const void *p1, const void *p2);
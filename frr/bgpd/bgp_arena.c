@@ -0,0 +1,123 @@
+/*
+ * Fixed-size object arenas.
+ *
+ * Each slot holds a pointer to its chunk followed by the object, so frees
+ * find their chunk without the chunks having to be aligned. Slots past
+ * "fresh" have never been handed out and are not on the free list; a new
+ * chunk is carved lazily rather than touched all at once.
+ */
+#include "zebra.h"
+
+#include "bgpd/bgp_arena.h"
+
+#define BGP_ARENA_CHUNK_SIZE (64 * 1024)
+
+struct bgp_arena_chunk {
+	struct bgp_arena_chunks_item item;
+
+	/* Freed slots, linked through their object space */
+	void *free;
+	unsigned int used;
+	unsigned int fresh;
+
+	char slots[] __attribute__((aligned(8)));
+};
+
+DECLARE_DLIST(bgp_arena_chunks, struct bgp_arena_chunk, item);
+
+static void bgp_arena_setup(struct bgp_arena *arena)
+{
+	arena->slotsize = sizeof(void *) + arena->objsize;
+	arena->slotsize = (arena->slotsize + 7) & ~(size_t)7;
+	arena->per_chunk = (BGP_ARENA_CHUNK_SIZE -
+			    sizeof(struct bgp_arena_chunk)) /
+			   arena->slotsize;
+	assert(arena->per_chunk > 1);
+	bgp_arena_chunks_init(&arena->partial);
+}
+
+static struct bgp_arena_chunk *bgp_arena_chunk_new(struct bgp_arena *arena)
+{
+	struct bgp_arena_chunk *chunk;
+
+	chunk = arena->spare;
+	if (chunk) {
+		arena->spare = NULL;
+	} else {
+		chunk = XMALLOC(arena->mtype, sizeof(*chunk) +
+						      arena->per_chunk *
+							      arena->slotsize);
+		arena->chunks++;
+	}
+
+	chunk->free = NULL;
+	chunk->used = 0;
+	chunk->fresh = 0;
+	bgp_arena_chunks_add_head(&arena->partial, chunk);
+	return chunk;
+}
+
+void *bgp_arena_alloc(struct bgp_arena *arena)
+{
+	struct bgp_arena_chunk *chunk;
+	char *slot;
+
+	if (!arena->slotsize)
+		bgp_arena_setup(arena);
+
+	chunk = bgp_arena_chunks_first(&arena->partial);
+	if (!chunk)
+		chunk = bgp_arena_chunk_new(arena);
+
+	if (chunk->free) {
+		slot = (char *)chunk->free - sizeof(void *);
+		chunk->free = *(void **)chunk->free;
+	} else {
+		slot = chunk->slots + chunk->fresh++ * arena->slotsize;
+		*(struct bgp_arena_chunk **)slot = chunk;
+	}
+
+	if (++chunk->used == arena->per_chunk)
+		bgp_arena_chunks_del(&arena->partial, chunk);
+	arena->count++;
+
+	memset(slot + sizeof(void *), 0, arena->objsize);
+	return slot + sizeof(void *);
+}
+
+void bgp_arena_free(struct bgp_arena *arena, void *obj)
+{
+	struct bgp_arena_chunk *chunk;
+
+	if (!obj)
+		return;
+
+	chunk = *(struct bgp_arena_chunk **)((char *)obj - sizeof(void *));
+
+	/* A full chunk goes to the back, to be filled after the others */
+	if (chunk->used-- == arena->per_chunk)
+		bgp_arena_chunks_add_tail(&arena->partial, chunk);
+	arena->count--;
+
+	if (!chunk->used) {
+		bgp_arena_chunks_del(&arena->partial, chunk);
+		if (!arena->spare) {
+			arena->spare = chunk;
+		} else {
+			XFREE(arena->mtype, chunk);
+			arena->chunks--;
+		}
+		return;
+	}
+
+	*(void **)obj = chunk->free;
+	chunk->free = obj;
+}
+
+void bgp_arena_finish(struct bgp_arena *arena)
+{
+	if (arena->spare) {
+		XFREE(arena->mtype, arena->spare);
+		arena->chunks--;
+	}
+}
@@ -0,0 +1,48 @@
+#ifndef _BGP_ARENA_H
+#define _BGP_ARENA_H
+
+#include "lib/memory.h"
+#include "lib/typesafe.h"
+
+/*
+ * Fixed-size object arenas, for the structures bgpd makes one of per path.
+ * Objects are carved from chunks of about 64K, so a table load is a few
+ * thousand mallocs rather than millions, paths sit next to each other in
+ * memory, and freeing one is a push on its chunk's free list. A chunk goes
+ * back to the system with its last object, keeping one spare.
+ *
+ * Arenas are main pthread only. Objects come back zeroed and aligned for
+ * pointers and 64-bit integers.
+ */
+PREDECL_DLIST(bgp_arena_chunks);
+
+struct bgp_arena {
+	/* What the chunks are accounted to */
+	struct memtype *mtype;
+	size_t objsize;
+
+	/* Set up on first use */
+	size_t slotsize;
+	unsigned int per_chunk;
+
+	/* Chunks with a free slot, fullest first */
+	struct bgp_arena_chunks_head partial;
+	struct bgp_arena_chunk *spare;
+
+	/* Objects handed out, and chunks holding them */
+	size_t count;
+	size_t chunks;
+};
+
+#define BGP_ARENA_INIT(mt, type)                                               \
+	{                                                                      \
+		.mtype = (mt), .objsize = sizeof(type),                        \
+	}
+
+extern void *bgp_arena_alloc(struct bgp_arena *arena);
+extern void bgp_arena_free(struct bgp_arena *arena, void *obj);
+
+/* Release the spare chunk, at exit */
+extern void bgp_arena_finish(struct bgp_arena *arena);
+
+#endif
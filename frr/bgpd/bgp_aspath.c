@@ -384,6 +384,9 @@ unsigned int aspath_count_confeds(struct aspath *aspath)
 	int count = 0;
 	struct assegment *seg = aspath->segments;
 
+	if (aspath->str)
+		return aspath->confeds;
+
 	while (seg) {
 		if (seg->type == AS_CONFED_SEQUENCE)
 			count += seg->length;
@@ -400,6 +403,9 @@ unsigned int aspath_count_hops(const struct aspath *aspath)
 	int count = 0;
 	struct assegment *seg = aspath->segments;
 
+	if (aspath->str)
+		return aspath->hops;
+
 	while (seg) {
 		if (seg->type == AS_SEQUENCE)
 			count += seg->length;
@@ -502,6 +508,42 @@ bool aspath_has_as4(struct aspath *aspath)
 	return false;
 }
 
+static inline uint64_t aspath_as_bit(as_t asno)
+{
+	return 1ULL << ((asno * 0x9e3779b1U) >> 26);
+}
+
+/* The counts and ASN bits kept alongside the string */
+static void aspath_make_summary(struct aspath *as)
+{
+	struct assegment *seg;
+	int i;
+
+	as->hops = 0;
+	as->confeds = 0;
+	as->as_bits = 0;
+
+	for (seg = as->segments; seg; seg = seg->next) {
+		switch (seg->type) {
+		case AS_SEQUENCE:
+			as->hops += seg->length;
+			break;
+		case AS_SET:
+			as->hops++;
+			break;
+		case AS_CONFED_SEQUENCE:
+			as->confeds += seg->length;
+			break;
+		case AS_CONFED_SET:
+			as->confeds++;
+			break;
+		}
+
+		for (i = 0; i < seg->length; i++)
+			as->as_bits |= aspath_as_bit(seg->as[i]);
+	}
+}
+
 /* Convert aspath structure to string expression. */
 static void aspath_make_str_count(struct aspath *as, bool make_json)
 {
@@ -518,6 +560,8 @@ static void aspath_make_str_count(struct aspath *as, bool make_json)
 		jaspath_segments = json_object_new_array();
 	}
 
+	aspath_make_summary(as);
+
 	/* Empty aspath. */
 	if (!as->segments) {
 		if (make_json) {
@@ -698,6 +742,9 @@ struct aspath *aspath_dup(struct aspath *aspath)
 	new->str = XMALLOC(MTYPE_AS_STR, buflen);
 	new->str_len = aspath->str_len;
 	new->asnotation = aspath->asnotation;
+	new->hops = aspath->hops;
+	new->confeds = aspath->confeds;
+	new->as_bits = aspath->as_bits;
 
 	/* copy the string data */
 	if (aspath->str_len > 0)
@@ -724,6 +771,9 @@ static void *aspath_hash_alloc(void *arg)
 	new->segments = aspath->segments;
 	new->str = aspath->str;
 	new->str_len = aspath->str_len;
+	new->hops = aspath->hops;
+	new->confeds = aspath->confeds;
+	new->as_bits = aspath->as_bits;
 	new->json = aspath->json;
 	new->asnotation = aspath->asnotation;
 
@@ -872,6 +922,28 @@ struct aspath *aspath_parse(struct stream *s, size_t length, int use32bit,
 	return find;
 }
 
+/* Same decoding as aspath_parse(), but the result is left for
+ * aspath_intern() and no hash is touched, so this may run off the main
+ * thread.
+ */
+struct aspath *aspath_parse_new(struct stream *s, size_t length, int use32bit,
+				enum asnotation_mode asnotation)
+{
+	struct aspath *as;
+
+	if (length % AS16_VALUE_SIZE)
+		return NULL;
+
+	as = aspath_new(asnotation);
+	if (assegments_parse(s, length, &as->segments, use32bit) < 0) {
+		XFREE(MTYPE_AS_PATH, as);
+		return NULL;
+	}
+	aspath_make_str_count(as, false);
+
+	return as;
+}
+
 static void assegment_data_put(struct stream *s, as_t *as, int num,
 			       int use32bit)
 {
@@ -1166,6 +1238,10 @@ int aspath_loop_check(struct aspath *aspath, as_t asno)
 	if ((aspath == NULL) || (aspath->segments == NULL))
 		return 0;
 
+	/* Most paths do not have it anywhere */
+	if (aspath->str && !(aspath->as_bits & aspath_as_bit(asno)))
+		return 0;
+
 	seg = aspath->segments;
 
 	while (seg) {
@@ -1191,6 +1267,9 @@ int aspath_loop_check_confed(struct aspath *aspath, as_t asno)
 	if (aspath == NULL || aspath->segments == NULL)
 		return 0;
 
+	if (aspath->str && !(aspath->as_bits & aspath_as_bit(asno)))
+		return 0;
+
 	seg = aspath->segments;
 
 	while (seg) {
@@ -2203,6 +2282,16 @@ unsigned int aspath_key_make(const void *p)
 	return key;
 }
 
+static bool aspath_summary_differs(const struct aspath *as1,
+				   const struct aspath *as2)
+{
+	if (!as1->str || !as2->str)
+		return false;
+
+	return as1->str_len != as2->str_len || as1->hops != as2->hops ||
+	       as1->as_bits != as2->as_bits;
+}
+
 /* If two aspath have same value then return 1 else return 0 */
 bool aspath_cmp(const void *arg1, const void *arg2)
 {
@@ -2213,6 +2302,10 @@ bool aspath_cmp(const void *arg1, const void *arg2)
 	    ((const struct aspath *)arg2)->asnotation)
 		return false;
 
+	/* Same segments make the same string, summary and all */
+	if (aspath_summary_differs(arg1, arg2))
+		return false;
+
 	while (seg1 || seg2) {
 		int i;
 		if ((!seg1 && seg2) || (seg1 && !seg2))
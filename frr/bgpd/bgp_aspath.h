@@ -59,6 +59,16 @@ struct aspath {
 	char *str;
 	unsigned short str_len;
 
+	/*
+	 * Summary of the segments, made along with str and valid whenever
+	 * it is: aspath_count_hops(), aspath_count_confeds(), and a bit per
+	 * ASN on the path, by aspath_as_bit(), for the loop checks to skip
+	 * the walk on when theirs is clear.
+	 */
+	unsigned int hops;
+	unsigned int confeds;
+	uint64_t as_bits;
+
 	/* AS notation used by string expression of AS path */
 	enum asnotation_mode asnotation;
 };
@@ -79,6 +89,9 @@ extern void aspath_finish(void);
 extern struct aspath *aspath_parse(struct stream *s, size_t length,
 				   int use32bit,
 				   enum asnotation_mode asnotation);
+extern struct aspath *aspath_parse_new(struct stream *s, size_t length,
+				       int use32bit,
+				       enum asnotation_mode asnotation);
 
 extern struct aspath *aspath_dup(struct aspath *aspath);
 extern struct aspath *aspath_aggregate(struct aspath *as1, struct aspath *as2);
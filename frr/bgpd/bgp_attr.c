@@ -19,6 +19,7 @@
 #include "command.h"
 #include "srv6.h"
 #include "frrstr.h"
+#include "frr_pthread.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_attr.h"
@@ -41,6 +42,7 @@
 #include "bgp_evpn.h"
 #include "bgp_flowspec_private.h"
 #include "bgp_mac.h"
+#include "bgp_preparse.h"
 
 /* Attribute strings for logging. */
 static const struct message attr_str[] = {
@@ -733,12 +735,47 @@ static void transit_finish(void)
 	hash_clean_and_free(&transit_hash, (void (*)(void *))transit_free);
 }
 
-/* Attribute hash routines. */
-static struct hash *attrhash;
+/* Attribute hash routines.
+ *
+ * The table is split in shards, each a hash of its own behind its own lock.
+ * Growing a shard rehashes only its share of the attributes, rather than
+ * all of them at once, and the table can be got at from more than one
+ * pthread; what bgp_attr_intern() does around it still needs the main one.
+ *
+ * Equal attributes have to land in the same shard, so the shard comes from
+ * fields attrhash_cmp() compares as they are, interned pointers included,
+ * which is also far cheaper than attrhash_key_make().
+ */
+#define BGP_ATTR_SHARDS 64
+
+static struct attr_shard {
+	pthread_mutex_t mtx;
+	struct hash *hash;
+} attr_shards[BGP_ATTR_SHARDS];
+
+static struct attr_shard *attr_shard_get(const struct attr *attr)
+{
+	uint32_t key;
+
+	key = jhash_3words((uint32_t)((uintptr_t)attr->aspath >> 4),
+			   (uint32_t)((uintptr_t)bgp_attr_get_community(attr) >>
+				      4),
+			   attr->nexthop.s_addr ^ attr->med, attr->local_pref);
+	key = jhash_2words((uint32_t)((uintptr_t)bgp_attr_get_lcommunity(attr) >>
+				      4),
+			   attr->mp_nexthop_global.s6_addr32[3], key);
+
+	return &attr_shards[key % BGP_ATTR_SHARDS];
+}
 
 unsigned long int attr_count(void)
 {
-	return attrhash->count;
+	unsigned long int count = 0;
+	int i;
+
+	for (i = 0; i < BGP_ATTR_SHARDS; i++)
+		count += attr_shards[i].hash->count;
+	return count;
 }
 
 unsigned long int attr_unknown_count(void)
@@ -869,8 +906,14 @@ bool attrhash_cmp(const void *p1, const void *p2)
 
 static void attrhash_init(void)
 {
-	attrhash =
-		hash_create(attrhash_key_make, attrhash_cmp, "BGP Attributes");
+	int i;
+
+	for (i = 0; i < BGP_ATTR_SHARDS; i++) {
+		pthread_mutex_init(&attr_shards[i].mtx, NULL);
+		attr_shards[i].hash = hash_create(attrhash_key_make,
+						  attrhash_cmp,
+						  "BGP Attributes");
+	}
 }
 
 /*
@@ -883,7 +926,12 @@ static void attr_vfree(void *attr)
 
 static void attrhash_finish(void)
 {
-	hash_clean_and_free(&attrhash, attr_vfree);
+	int i;
+
+	for (i = 0; i < BGP_ATTR_SHARDS; i++) {
+		hash_clean_and_free(&attr_shards[i].hash, attr_vfree);
+		pthread_mutex_destroy(&attr_shards[i].mtx);
+	}
 }
 
 static void attr_show_all_iterator(struct hash_bucket *bucket, struct vty *vty)
@@ -907,9 +955,15 @@ static void attr_show_all_iterator(struct hash_bucket *bucket, struct vty *vty)
 
 void attr_show_all(struct vty *vty)
 {
-	hash_iterate(attrhash, (void (*)(struct hash_bucket *,
-					 void *))attr_show_all_iterator,
-		     vty);
+	int i;
+
+	for (i = 0; i < BGP_ATTR_SHARDS; i++)
+		frr_with_mutex (&attr_shards[i].mtx) {
+			hash_iterate(attr_shards[i].hash,
+				     (void (*)(struct hash_bucket *,
+					       void *))attr_show_all_iterator,
+				     vty);
+		}
 }
 
 static void *bgp_attr_hash_alloc(void *p)
@@ -942,6 +996,7 @@ struct attr *bgp_attr_intern(struct attr *attr)
 	struct ecommunity *ipv6_ecomm = NULL;
 	struct lcommunity *lcomm = NULL;
 	struct community *comm = NULL;
+	struct attr_shard *shard;
 
 	/* Intern referenced structure. */
 	if (attr->aspath) {
@@ -1040,8 +1095,12 @@ struct attr *bgp_attr_intern(struct attr *attr)
 	 * If we don't find it, we need to allocate a one because in all
 	 * cases this returns a new reference to a hashed attr, but the input
 	 * wasn't on hash. */
-	find = (struct attr *)hash_get(attrhash, attr, bgp_attr_hash_alloc);
-	find->refcnt++;
+	shard = attr_shard_get(attr);
+	frr_with_mutex (&shard->mtx) {
+		find = (struct attr *)hash_get(shard->hash, attr,
+					       bgp_attr_hash_alloc);
+		find->refcnt++;
+	}
 
 	return find;
 }
@@ -1244,18 +1303,23 @@ void bgp_attr_unintern_sub(struct attr *attr)
 void bgp_attr_unintern(struct attr **pattr)
 {
 	struct attr *attr = *pattr;
-	struct attr *ret;
+	struct attr_shard *shard = attr_shard_get(attr);
+	struct attr *ret = NULL;
 	struct attr tmp;
 
-	/* Decrement attribute reference. */
-	attr->refcnt--;
-
 	tmp = *attr;
 
-	/* If reference becomes zero then free attribute object. */
-	if (attr->refcnt == 0) {
-		ret = hash_release(attrhash, attr);
-		assert(ret != NULL);
+	frr_with_mutex (&shard->mtx) {
+		/* Decrement attribute reference. */
+		attr->refcnt--;
+
+		/* If reference becomes zero then free attribute object. */
+		if (attr->refcnt == 0) {
+			ret = hash_release(shard->hash, attr);
+			assert(ret != NULL);
+		}
+	}
+	if (ret) {
 		XFREE(MTYPE_ATTR, attr);
 		*pattr = NULL;
 	}
@@ -1330,6 +1394,36 @@ void bgp_attr_flush(struct attr *attr)
 #endif
 }
 
+/* Whether every structure attr refers to is interned, none owned by attr */
+bool bgp_attr_subs_interned(const struct attr *attr)
+{
+	const struct community *comm = bgp_attr_get_community(attr);
+	const struct ecommunity *ecomm = bgp_attr_get_ecommunity(attr);
+	const struct ecommunity *ipv6_ecomm =
+		bgp_attr_get_ipv6_ecommunity(attr);
+	const struct lcommunity *lcomm = bgp_attr_get_lcommunity(attr);
+	const struct cluster_list *cluster = bgp_attr_get_cluster(attr);
+	const struct transit *transit = bgp_attr_get_transit(attr);
+
+	if ((attr->aspath && !attr->aspath->refcnt) ||
+	    (comm && !comm->refcnt) || (ecomm && !ecomm->refcnt) ||
+	    (ipv6_ecomm && !ipv6_ecomm->refcnt) ||
+	    (lcomm && !lcomm->refcnt) || (cluster && !cluster->refcnt) ||
+	    (transit && !transit->refcnt) ||
+	    (attr->encap_subtlvs && !attr->encap_subtlvs->refcnt) ||
+	    (attr->srv6_l3vpn && !attr->srv6_l3vpn->refcnt) ||
+	    (attr->srv6_vpn && !attr->srv6_vpn->refcnt))
+		return false;
+#ifdef ENABLE_BGP_VNC
+	const struct bgp_attr_encap_subtlv *vnc_subtlvs =
+		bgp_attr_get_vnc_subtlvs(attr);
+
+	if (vnc_subtlvs && !vnc_subtlvs->refcnt)
+		return false;
+#endif
+	return true;
+}
+
 /* Implement draft-scudder-idr-optional-transitive behaviour and
  * avoid resetting sessions for malformed attributes which are
  * are partial/optional and hence where the error likely was not
@@ -1618,6 +1712,7 @@ static int bgp_attr_aspath(struct bgp_attr_parser_args *args)
 	struct peer *const peer = args->peer;
 	const bgp_size_t length = args->length;
 	enum asnotation_mode asnotation;
+	bool use32bit;
 
 	asnotation = bgp_get_asnotation(
 		args->peer && args->peer->bgp ? args->peer->bgp : NULL);
@@ -1625,11 +1720,13 @@ static int bgp_attr_aspath(struct bgp_attr_parser_args *args)
 	 * peer with AS4 => will get 4Byte ASnums
 	 * otherwise, will get 16 Bit
 	 */
-	attr->aspath =
-		aspath_parse(peer->curr, length,
-			     CHECK_FLAG(peer->cap, PEER_CAP_AS4_RCV) &&
-				     CHECK_FLAG(peer->cap, PEER_CAP_AS4_ADV),
-			     asnotation);
+	use32bit = CHECK_FLAG(peer->cap, PEER_CAP_AS4_RCV) &&
+		   CHECK_FLAG(peer->cap, PEER_CAP_AS4_ADV);
+	attr->aspath = bgp_preparse_aspath(peer, false, length, use32bit,
+					   asnotation);
+	if (!attr->aspath)
+		attr->aspath = aspath_parse(peer->curr, length, use32bit,
+					    asnotation);
 
 	/* In case of IBGP, length will be zero. */
 	if (!attr->aspath) {
@@ -1734,7 +1831,9 @@ static int bgp_attr_as4_path(struct bgp_attr_parser_args *args,
 
 	asnotation = bgp_get_asnotation(peer->bgp);
 
-	*as4_path = aspath_parse(peer->curr, length, 1, asnotation);
+	*as4_path = bgp_preparse_aspath(peer, true, length, true, asnotation);
+	if (!*as4_path)
+		*as4_path = aspath_parse(peer->curr, length, 1, asnotation);
 
 	/* In case of IBGP, length will be zero. */
 	if (!*as4_path) {
@@ -2127,6 +2226,7 @@ bgp_attr_community(struct bgp_attr_parser_args *args)
 	struct peer *const peer = args->peer;
 	struct attr *const attr = args->attr;
 	const bgp_size_t length = args->length;
+	struct community *comm;
 
 	if (length == 0) {
 		bgp_attr_set_community(attr, NULL);
@@ -2137,12 +2237,14 @@ bgp_attr_community(struct bgp_attr_parser_args *args)
 	if (peer->discard_attrs[args->type] || peer->withdraw_attrs[args->type])
 		goto community_ignore;
 
-	bgp_attr_set_community(
-		attr,
-		community_parse((uint32_t *)stream_pnt(peer->curr), length));
-
-	/* XXX: fix community_parse to use stream API and remove this */
-	stream_forward_getp(peer->curr, length);
+	comm = bgp_preparse_community(peer, length);
+	if (!comm) {
+		comm = community_parse((uint32_t *)stream_pnt(peer->curr),
+				       length);
+		/* XXX: fix community_parse to use stream API and remove this */
+		stream_forward_getp(peer->curr, length);
+	}
+	bgp_attr_set_community(attr, comm);
 
 	/* The Community attribute SHALL be considered malformed if its
 	 * length is not a non-zero multiple of 4.
@@ -2507,6 +2609,7 @@ bgp_attr_large_community(struct bgp_attr_parser_args *args)
 	struct peer *const peer = args->peer;
 	struct attr *const attr = args->attr;
 	const bgp_size_t length = args->length;
+	struct lcommunity *lcomm;
 
 	/*
 	 * Large community follows new attribute format.
@@ -2521,10 +2624,13 @@ bgp_attr_large_community(struct bgp_attr_parser_args *args)
 	if (peer->discard_attrs[args->type] || peer->withdraw_attrs[args->type])
 		goto large_community_ignore;
 
-	bgp_attr_set_lcommunity(
-		attr, lcommunity_parse(stream_pnt(peer->curr), length));
-	/* XXX: fix ecommunity_parse to use stream API */
-	stream_forward_getp(peer->curr, length);
+	lcomm = bgp_preparse_lcommunity(peer, length);
+	if (!lcomm) {
+		lcomm = lcommunity_parse(stream_pnt(peer->curr), length);
+		/* XXX: fix ecommunity_parse to use stream API */
+		stream_forward_getp(peer->curr, length);
+	}
+	bgp_attr_set_lcommunity(attr, lcomm);
 
 	if (!bgp_attr_get_lcommunity(attr))
 		return bgp_attr_malformed(args, BGP_NOTIFY_UPDATE_OPT_ATTR_ERR,
@@ -26,6 +26,7 @@
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_vty.h"
 #include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_twamp.h"
 
 DEFINE_MTYPE_STATIC(BGPD, BFD_CONFIG, "BFD configuration data");
 
@@ -55,6 +56,9 @@ static void bfd_session_status_update(struct bfd_session_params *bsp,
 		}
 		peer->last_reset = PEER_DOWN_BFD_DOWN;
 
+		/* Paths of other peers may still use this nexthop */
+		bgp_twamp_bfd_status(peer, false);
+
 		/* rfc9384 */
 		if (BGP_IS_VALID_STATE_FOR_NOTIF(peer->connection->status))
 			bgp_notify_send(peer->connection, BGP_NOTIFY_CEASE,
@@ -63,6 +67,9 @@ static void bfd_session_status_update(struct bfd_session_params *bsp,
 		BGP_EVENT_ADD(peer->connection, BGP_Stop);
 	}
 
+	if (bss->state == BSS_UP && bss->previous_state != BSS_UP)
+		bgp_twamp_bfd_status(peer, true);
+
 	if (bss->state == BSS_UP && bss->previous_state != BSS_UP &&
 	    !peer_established(peer->connection)) {
 		if (!BGP_PEER_START_SUPPRESSED(peer)) {
@@ -70,6 +77,24 @@ static void bfd_session_status_update(struct bfd_session_params *bsp,
 			BGP_EVENT_ADD(peer->connection, BGP_Start);
 		}
 	}
+
+	/* Latency selection may be using this session's echo. */
+	bgp_twamp_bfd_rtt_changed(peer);
+}
+
+static void bfd_session_rtt_update(struct bfd_session_params *bsp,
+				   const struct bfd_session_status *bss,
+				   void *arg)
+{
+	struct peer *peer = arg;
+
+	if (BGP_DEBUG(bfd, BFD_LIB))
+		zlog_debug("%s: neighbor %s vrf %s(%u) bfd echo rtt %uus",
+			   __func__, peer->conf_if ? peer->conf_if : peer->host,
+			   bfd_sess_vrf(bsp), bfd_sess_vrf_id(bsp),
+			   bss->rtt_us);
+
+	bgp_twamp_bfd_rtt_changed(peer);
 }
 
 void bgp_peer_config_apply(struct peer *p, struct peer_group *pg)
@@ -280,6 +305,7 @@ void bgp_peer_configure_bfd(struct peer *p, bool manual)
 
 	/* Create new session and assign callback. */
 	p->bfd_config->session = bfd_sess_new(bfd_session_status_update, p);
+	bfd_sess_set_rtt_cb(p->bfd_config->session, bfd_session_rtt_update);
 	bgp_peer_bfd_reset(p);
 
 	/* Configure session with basic BGP peer data. */
@@ -29,6 +29,8 @@
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_open.h"
 #include "bgpd/bgp_dump.h"
 #include "bgpd/bgp_errors.h"
 #include "bgpd/bgp_packet.h"
@@ -38,6 +40,7 @@
 #include "bgpd/bgp_vty.h"
 #include "bgpd/bgp_trace.h"
 #include "bgpd/bgp_network.h"
+#include "bgpd/bgp_twamp.h"
 
 static void bmp_close(struct bmp *bmp);
 static struct bmp_bgp *bmp_bgp_find(struct bgp *bgp);
@@ -255,6 +258,7 @@ static void bmp_per_peer_hdr(struct stream *s, struct peer *peer,
 #define BMP_PEER_TYPE_GLOBAL_INSTANCE 0
 #define BMP_PEER_TYPE_RD_INSTANCE     1
 #define BMP_PEER_TYPE_LOCAL_INSTANCE  2
+#define BMP_PEER_TYPE_LOC_RIB_INSTANCE 3
 
 #define BMP_PEER_FLAG_V (1 << 7)
 #define BMP_PEER_FLAG_L (1 << 6)
@@ -305,6 +309,42 @@ static void bmp_per_peer_hdr(struct stream *s, struct peer *peer,
 	}
 }
 
+/* RFC 9069 per-peer header of the instance's own Loc-RIB */
+static void bmp_locrib_peer_hdr(struct stream *s, struct bgp *bgp,
+				const struct timeval *tv)
+{
+	/* Peer Type, Peer Flags */
+	stream_putc(s, BMP_PEER_TYPE_LOC_RIB_INSTANCE);
+	stream_putc(s, 0);
+
+	/* Peer Distinguisher: any locally unique value, zero is the default
+	 * instance
+	 */
+	stream_putl(s, 0);
+	stream_putl(s, bgp->inst_type == BGP_INSTANCE_TYPE_DEFAULT
+			       ? 0
+			       : bgp->vrf_id);
+
+	/* Peer Address: zero */
+	stream_putl(s, 0);
+	stream_putl(s, 0);
+	stream_putl(s, 0);
+	stream_putl(s, 0);
+
+	/* Peer AS, Peer BGP ID */
+	stream_putl(s, bgp->as);
+	stream_put_in_addr(s, &bgp->router_id);
+
+	/* Timestamp */
+	if (tv) {
+		stream_putl(s, tv->tv_sec);
+		stream_putl(s, tv->tv_usec);
+	} else {
+		stream_putl(s, 0);
+		stream_putl(s, 0);
+	}
+}
+
 static void bmp_put_info_tlv(struct stream *s, uint16_t type,
 		const char *string)
 {
@@ -465,12 +505,98 @@ static struct stream *bmp_peerstate(struct peer *peer, bool down)
 }
 
 
+static bool bmp_locrib_monitored(const struct bmp_targets *bt)
+{
+	afi_t afi;
+	safi_t safi;
+
+	FOREACH_AFI_SAFI (afi, safi)
+		if (bt->afimon[afi][safi] & BMP_MON_LOC_RIB)
+			return true;
+	return false;
+}
+
+/*
+ * Loc-RIB instance Peer Up (RFC 9069 5.3): the OPEN messages are made up,
+ * the same one sent and received, with the capabilities needed to parse
+ * the monitored address families.
+ */
+static struct stream *bmp_locrib_peerup(struct bmp_targets *bt)
+{
+	struct bgp *bgp = bt->bgp;
+	struct stream *s;
+	size_t open_pos, optlen_pos;
+	iana_afi_t pkt_afi;
+	iana_safi_t pkt_safi;
+	afi_t afi;
+	safi_t safi;
+
+	s = stream_new(BGP_MAX_PACKET_SIZE);
+
+	bmp_common_hdr(s, BMP_VERSION_3, BMP_TYPE_PEER_UP_NOTIFICATION);
+	bmp_locrib_peer_hdr(s, bgp, NULL);
+
+	/* Local Address, Local Port, Remote Port: zero */
+	stream_put(s, NULL, 16);
+	stream_putw(s, 0);
+	stream_putw(s, 0);
+
+	open_pos = stream_get_endp(s);
+	bgp_packet_set_marker(s, BGP_MSG_OPEN);
+	stream_putc(s, BGP_VERSION_4);
+	stream_putw(s, bgp->as <= BGP_AS_MAX ? bgp->as : BGP_AS_TRANS);
+	stream_putw(s, 0);
+	stream_put_in_addr(s, &bgp->router_id);
+	optlen_pos = stream_get_endp(s);
+	stream_putc(s, 0);
+
+	stream_putc(s, BGP_OPEN_OPT_CAP);
+	stream_putc(s, CAPABILITY_CODE_AS4_LEN + 2);
+	stream_putc(s, CAPABILITY_CODE_AS4);
+	stream_putc(s, CAPABILITY_CODE_AS4_LEN);
+	stream_putl(s, bgp->as);
+
+	FOREACH_AFI_SAFI (afi, safi) {
+		if (!(bt->afimon[afi][safi] & BMP_MON_LOC_RIB))
+			continue;
+
+		bgp_map_afi_safi_int2iana(afi, safi, &pkt_afi, &pkt_safi);
+		stream_putc(s, BGP_OPEN_OPT_CAP);
+		stream_putc(s, CAPABILITY_CODE_MP_LEN + 2);
+		stream_putc(s, CAPABILITY_CODE_MP);
+		stream_putc(s, CAPABILITY_CODE_MP_LEN);
+		stream_putw(s, pkt_afi);
+		stream_putc(s, 0);
+		stream_putc(s, pkt_safi);
+	}
+
+	stream_putc_at(s, optlen_pos, stream_get_endp(s) - optlen_pos - 1);
+	stream_putw_at(s, open_pos + BGP_MARKER_SIZE,
+		       stream_get_endp(s) - open_pos);
+
+	/* Received OPEN: the same */
+	stream_put(s, STREAM_DATA(s) + open_pos, stream_get_endp(s) - open_pos);
+
+#define BMP_INFO_TYPE_VRF_TABLE_NAME 3
+	bmp_put_info_tlv(s, BMP_INFO_TYPE_VRF_TABLE_NAME,
+			 bgp->name ? bgp->name : "global");
+
+	stream_putl_at(s, BMP_LENGTH_POS, stream_get_endp(s));
+	return s;
+}
+
 static int bmp_send_peerup(struct bmp *bmp)
 {
 	struct peer *peer;
 	struct listnode *node;
 	struct stream *s;
 
+	if (bmp_locrib_monitored(bmp->targets)) {
+		s = bmp_locrib_peerup(bmp->targets);
+		pullwr_write_stream(bmp->pullwr, s);
+		stream_free(s);
+	}
+
 	/* Walk down all peers */
 	for (ALL_LIST_ELEMENTS_RO(bmp->targets->bgp->peer, node, peer)) {
 		s = bmp_peerstate(peer, false);
@@ -503,6 +629,12 @@ static void bmp_send_all(struct bmp_bgp *bmpbgp, struct stream *s)
 #define BMP_MIRROR_INFO_CODE_ERRORPDU   0
 #define BMP_MIRROR_INFO_CODE_LOSTMSGS   1
 
+static void bmp_mirrorq_free(struct bmp_mirrorq *bmq)
+{
+	stream_free(bmq->pkt);
+	XFREE(MTYPE_BMP_MIRRORQ, bmq);
+}
+
 static struct bmp_mirrorq *bmp_pull_mirror(struct bmp *bmp)
 {
 	struct bmp_mirrorq *bmq;
@@ -539,8 +671,7 @@ static void bmp_mirror_cull(struct bmp_bgp *bmpbgp)
 
 				while ((inner = bmp_pull_mirror(bmp))) {
 					if (!inner->refcount)
-						XFREE(MTYPE_BMP_MIRRORQ,
-								inner);
+						bmp_mirrorq_free(inner);
 				}
 
 				zlog_warn("bmp[%s] lost mirror messages due to buffer size limit",
@@ -578,11 +709,10 @@ static int bmp_mirror_packet(struct peer *peer, uint8_t type, bgp_size_t size,
 	if (!bmpbgp)
 		return 0;
 
-	qitem = XCALLOC(MTYPE_BMP_MIRRORQ, sizeof(*qitem) + size);
+	qitem = XCALLOC(MTYPE_BMP_MIRRORQ, sizeof(*qitem));
 	qitem->peerid = peer->qobj_node.nid;
 	qitem->tv = tv;
 	qitem->len = size;
-	memcpy(qitem->data, packet->data, size);
 
 	frr_each(bmp_targets, &bmpbgp->targets, bt) {
 		if (!bt->mirror)
@@ -597,6 +727,7 @@ static int bmp_mirror_packet(struct peer *peer, uint8_t type, bgp_size_t size,
 	if (qitem->refcount == 0)
 		XFREE(MTYPE_BMP_MIRRORQ, qitem);
 	else {
+		qitem->pkt = stream_slice(packet, 0, size);
 		bmpbgp->mirror_qsize += sizeof(*qitem) + size;
 		bmp_mirrorq_add_tail(&bmpbgp->mirrorq, qitem);
 
@@ -665,14 +796,14 @@ static bool bmp_wrmirror(struct bmp *bmp, struct pullwr *pullwr)
 
 	bmp->cnt_mirror++;
 	pullwr_write_stream(bmp->pullwr, s);
-	pullwr_write(bmp->pullwr, bmq->data, bmq->len);
+	pullwr_write(bmp->pullwr, STREAM_DATA(bmq->pkt), bmq->len);
 
 	stream_free(s);
 	written = true;
 
 out:
 	if (!bmq->refcount)
-		XFREE(MTYPE_BMP_MIRRORQ, bmq);
+		bmp_mirrorq_free(bmq);
 	return written;
 }
 
@@ -799,6 +930,22 @@ static void bmp_eor(struct bmp *bmp, afi_t afi, safi_t safi, uint8_t flags)
 
 	bgp_packet_set_size(s);
 
+	if (flags & BMP_PEER_FLAG_L &&
+	    bmp->targets->afimon[afi][safi] & BMP_MON_LOC_RIB) {
+		s2 = stream_new(BGP_MAX_PACKET_SIZE);
+
+		bmp_common_hdr(s2, BMP_VERSION_3, BMP_TYPE_ROUTE_MONITORING);
+		bmp_locrib_peer_hdr(s2, bmp->targets->bgp, NULL);
+
+		stream_putl_at(s2, BMP_LENGTH_POS,
+			       stream_get_endp(s) + stream_get_endp(s2));
+
+		bmp->cnt_update++;
+		pullwr_write_stream(bmp->pullwr, s2);
+		pullwr_write_stream(bmp->pullwr, s);
+		stream_free(s2);
+	}
+
 	for (ALL_LIST_ELEMENTS_RO(bmp->targets->bgp->peer, node, peer)) {
 		if (!peer->afc_nego[afi][safi])
 			continue;
@@ -911,12 +1058,13 @@ static struct stream *bmp_withdraw(const struct prefix *p,
 	return s;
 }
 
-static void bmp_monitor(struct bmp *bmp, struct peer *peer, uint8_t flags,
-			const struct prefix *p, struct prefix_rd *prd,
-			struct attr *attr, afi_t afi, safi_t safi,
-			time_t uptime)
+/* Route monitoring message, BMP headers and BGP UPDATE in one stream */
+static struct stream *bmp_monitor_msg(struct peer *peer, uint8_t flags,
+				      const struct prefix *p,
+				      struct prefix_rd *prd, struct attr *attr,
+				      afi_t afi, safi_t safi, time_t uptime)
 {
-	struct stream *hdr, *msg;
+	struct stream *hdr, *msg, *s;
 	struct timeval tv = { .tv_sec = uptime, .tv_usec = 0 };
 	struct timeval uptime_real;
 
@@ -933,11 +1081,94 @@ static void bmp_monitor(struct bmp *bmp, struct peer *peer, uint8_t flags,
 	stream_putl_at(hdr, BMP_LENGTH_POS,
 			stream_get_endp(hdr) + stream_get_endp(msg));
 
+	s = stream_dupcat(hdr, msg, stream_get_endp(hdr));
+	stream_free(hdr);
+	stream_free(msg);
+	return s;
+}
+
+static void bmp_monitor(struct bmp *bmp, struct peer *peer, uint8_t flags,
+			const struct prefix *p, struct prefix_rd *prd,
+			struct attr *attr, afi_t afi, safi_t safi,
+			time_t uptime)
+{
+	struct stream *s;
+
+	s = bmp_monitor_msg(peer, flags, p, prd, attr, afi, safi, uptime);
+
 	bmp->cnt_update++;
-	pullwr_write_stream(bmp->pullwr, hdr);
-	pullwr_write_stream(bmp->pullwr, msg);
+	pullwr_write_stream(bmp->pullwr, s);
+	stream_free(s);
+}
+
+/*
+ * Trailing TLVs of Loc-RIB route monitoring messages, after the BGP PDU
+ * and covered by the BMP message length. Not standardized: only sent when
+ * configured, for collectors that know to look for them.
+ */
+#define BMP_LOCRIB_TLV_LATENCY		0x8001	/* u32 us, u16 loss permille */
+#define BMP_LOCRIB_TLV_SELECTION	0x8002	/* u8 step, step name */
+
+static void bmp_locrib_tlvs(struct stream *s, struct bgp_dest *bn,
+			    struct bgp_path_info *bpi)
+{
+	const char *reason = bgp_path_selection_reason2str(bn->reason);
+
+	stream_putw(s, BMP_LOCRIB_TLV_LATENCY);
+	stream_putw(s, 6);
+	stream_putl(s, bgp_twamp_path_latency(bpi));
+	stream_putw(s, bgp_twamp_path_loss(bpi));
+
+	stream_putw(s, BMP_LOCRIB_TLV_SELECTION);
+	stream_putw(s, 1 + strlen(reason));
+	stream_putc(s, bn->reason);
+	stream_put(s, reason, strlen(reason));
+}
+
+/* Loc-RIB route monitoring message (RFC 9069) for the best path of bn */
+static struct stream *bmp_locrib_msg(struct bmp_targets *bt,
+				     const struct prefix *p,
+				     struct prefix_rd *prd, struct bgp_dest *bn,
+				     struct bgp_path_info *bpi, afi_t afi,
+				     safi_t safi)
+{
+	struct stream *hdr, *msg, *s;
+	struct timeval tv = {
+		.tv_sec = bpi ? bpi->uptime : monotime(NULL),
+	};
+	struct timeval uptime_real;
+
+	monotime_to_realtime(&tv, &uptime_real);
+	if (bpi)
+		msg = bmp_update(p, prd, bpi->peer, bpi->attr, afi, safi);
+	else
+		msg = bmp_withdraw(p, prd, afi, safi);
+
+	hdr = stream_new(BGP_MAX_PACKET_SIZE);
+	bmp_common_hdr(hdr, BMP_VERSION_3, BMP_TYPE_ROUTE_MONITORING);
+	bmp_locrib_peer_hdr(hdr, bt->bgp, &uptime_real);
+
+	s = stream_new(stream_get_endp(hdr) + stream_get_endp(msg) + 64);
+	stream_put(s, STREAM_DATA(hdr), stream_get_endp(hdr));
+	stream_put(s, STREAM_DATA(msg), stream_get_endp(msg));
+	if (bpi && bt->locrib_latency)
+		bmp_locrib_tlvs(s, bn, bpi);
+	stream_putl_at(s, BMP_LENGTH_POS, stream_get_endp(s));
+
 	stream_free(hdr);
 	stream_free(msg);
+	return s;
+}
+
+static struct bgp_path_info *bmp_locrib_selected(struct bgp_dest *bn)
+{
+	struct bgp_path_info *bpi;
+
+	for (bpi = bn ? bgp_dest_get_bgp_path_info(bn) : NULL; bpi;
+	     bpi = bpi->next)
+		if (CHECK_FLAG(bpi->flags, BGP_PATH_SELECTED))
+			return bpi;
+	return NULL;
 }
 
 static bool bmp_wrsync(struct bmp *bmp, struct pullwr *pullwr)
@@ -955,6 +1186,7 @@ static bool bmp_wrsync(struct bmp *bmp, struct pullwr *pullwr)
 			bmp->syncafi = afi;
 			bmp->syncsafi = safi;
 			bmp->syncpeerid = 0;
+			bmp->synclocrib = false;
 			memset(&bmp->syncpos, 0, sizeof(bmp->syncpos));
 			bmp->syncpos.family = afi2family(afi);
 			bmp->syncrdpos = NULL;
@@ -1048,9 +1280,36 @@ afibreak:
 				return true;
 			}
 			bmp->syncpeerid = 0;
+			bmp->synclocrib = false;
 			prefix_copy(&bmp->syncpos, bgp_dest_get_prefix(bn));
 		}
 
+		/* The Loc-RIB route goes ahead of the peers' */
+		if (bmp->targets->afimon[afi][safi] & BMP_MON_LOC_RIB &&
+		    !bmp->synclocrib) {
+			struct prefix_rd *prd = NULL;
+			struct stream *s;
+
+			bmp->synclocrib = true;
+			bpi = bmp_locrib_selected(bn);
+			if (bpi) {
+				if ((afi == AFI_L2VPN && safi == SAFI_EVPN) ||
+				    safi == SAFI_MPLS_VPN)
+					prd = (struct prefix_rd *)
+						bgp_dest_get_prefix(
+							bmp->syncrdpos);
+
+				s = bmp_locrib_msg(bmp->targets,
+						   bgp_dest_get_prefix(bn), prd,
+						   bn, bpi, afi, safi);
+				bmp->cnt_update++;
+				pullwr_write_stream(bmp->pullwr, s);
+				stream_free(s);
+				bgp_dest_unlock_node(bn);
+				return true;
+			}
+		}
+
 		if (bmp->targets->afimon[afi][safi] & BMP_MON_POSTPOLICY) {
 			for (bpiter = bgp_dest_get_bgp_path_info(bn); bpiter;
 			     bpiter = bpiter->next) {
@@ -1106,9 +1365,13 @@ afibreak:
 	if (bpi)
 		bmp_monitor(bmp, bpi->peer, BMP_PEER_FLAG_L, bn_p, prd,
 			    bpi->attr, afi, safi, bpi->uptime);
-	if (adjin)
-		bmp_monitor(bmp, adjin->peer, 0, bn_p, prd, adjin->attr, afi,
-			    safi, adjin->uptime);
+	if (adjin) {
+		struct attr attr;
+
+		bgp_adj_in_attr(adjin, &attr);
+		bmp_monitor(bmp, adjin->peer, 0, bn_p, prd, &attr, afi, safi,
+			    adjin->uptime);
+	}
 
 	if (bn)
 		bgp_dest_unlock_node(bn);
@@ -1134,6 +1397,47 @@ static struct bmp_queue_entry *bmp_pull(struct bmp *bmp)
 	return bqe;
 }
 
+static void bmp_qentry_uncache(struct bmp_queue_entry *bqe)
+{
+	stream_free(bqe->msg_pre);
+	stream_free(bqe->msg_post);
+	bqe->msg_pre = bqe->msg_post = NULL;
+}
+
+static void bmp_qentry_free(struct bmp_queue_entry *bqe)
+{
+	bmp_qentry_uncache(bqe);
+	XFREE(MTYPE_BMP_QUEUE, bqe);
+}
+
+static bool bmp_wrqueue_locrib(struct bmp *bmp, struct bmp_queue_entry *bqe)
+{
+	struct bmp_targets *bt = bmp->targets;
+	struct prefix_rd *prd = NULL;
+	struct bgp_dest *bn;
+
+	if (!(bt->afimon[bqe->afi][bqe->safi] & BMP_MON_LOC_RIB))
+		return false;
+
+	if ((bqe->afi == AFI_L2VPN && bqe->safi == SAFI_EVPN) ||
+	    bqe->safi == SAFI_MPLS_VPN)
+		prd = &bqe->rd;
+
+	if (!bqe->msg_post) {
+		bn = bgp_safi_node_lookup(bt->bgp->rib[bqe->afi][bqe->safi],
+					  bqe->safi, &bqe->p, prd);
+		bqe->msg_post = bmp_locrib_msg(bt, &bqe->p, prd, bn,
+					       bmp_locrib_selected(bn),
+					       bqe->afi, bqe->safi);
+		if (bn)
+			bgp_dest_unlock_node(bn);
+	}
+
+	bmp->cnt_update++;
+	pullwr_write_stream(bmp->pullwr, bqe->msg_post);
+	return true;
+}
+
 static bool bmp_wrqueue(struct bmp *bmp, struct pullwr *pullwr)
 {
 	struct bmp_queue_entry *bqe;
@@ -1165,6 +1469,11 @@ static bool bmp_wrqueue(struct bmp *bmp, struct pullwr *pullwr)
 		break;
 	}
 
+	if (!bqe->peerid) {
+		written = bmp_wrqueue_locrib(bmp, bqe);
+		goto out;
+	}
+
 	peer = QOBJ_GET_TYPESAFE(bqe->peerid, peer);
 	if (!peer) {
 		zlog_info("bmp: skipping queued item for deleted peer");
@@ -1177,44 +1486,61 @@ static bool bmp_wrqueue(struct bmp *bmp, struct pullwr *pullwr)
 		      (bqe->safi == SAFI_MPLS_VPN);
 
 	struct prefix_rd *prd = is_vpn ? &bqe->rd : NULL;
-	bn = bgp_safi_node_lookup(bmp->targets->bgp->rib[afi][safi], safi,
-				  &bqe->p, prd);
+	bool post = bmp->targets->afimon[afi][safi] & BMP_MON_POSTPOLICY;
+	bool pre = bmp->targets->afimon[afi][safi] & BMP_MON_PREPOLICY;
 
+	/* Another session of the targets already encoded the route */
+	if ((post && !bqe->msg_post) || (pre && !bqe->msg_pre))
+		bn = bgp_safi_node_lookup(bmp->targets->bgp->rib[afi][safi],
+					  safi, &bqe->p, prd);
 
-	if (bmp->targets->afimon[afi][safi] & BMP_MON_POSTPOLICY) {
+	if (post) {
 		struct bgp_path_info *bpi;
 
-		for (bpi = bn ? bgp_dest_get_bgp_path_info(bn) : NULL; bpi;
-		     bpi = bpi->next) {
+		for (bpi = bn && !bqe->msg_post ? bgp_dest_get_bgp_path_info(bn)
+						: NULL;
+		     bpi; bpi = bpi->next) {
 			if (!CHECK_FLAG(bpi->flags, BGP_PATH_VALID))
 				continue;
 			if (bpi->peer == peer)
 				break;
 		}
 
-		bmp_monitor(bmp, peer, BMP_PEER_FLAG_L, &bqe->p, prd,
-			    bpi ? bpi->attr : NULL, afi, safi,
-			    bpi ? bpi->uptime : monotime(NULL));
+		if (!bqe->msg_post)
+			bqe->msg_post = bmp_monitor_msg(
+				peer, BMP_PEER_FLAG_L, &bqe->p, prd,
+				bpi ? bpi->attr : NULL, afi, safi,
+				bpi ? bpi->uptime : monotime(NULL));
+		bmp->cnt_update++;
+		pullwr_write_stream(bmp->pullwr, bqe->msg_post);
 		written = true;
 	}
 
-	if (bmp->targets->afimon[afi][safi] & BMP_MON_PREPOLICY) {
+	if (pre) {
 		struct bgp_adj_in *adjin;
+		struct attr attr;
 
-		for (adjin = bn ? bn->adj_in : NULL; adjin;
+		for (adjin = bn && !bqe->msg_pre ? bn->adj_in : NULL; adjin;
 		     adjin = adjin->next) {
 			if (adjin->peer == peer)
 				break;
 		}
-		bmp_monitor(bmp, peer, 0, &bqe->p, prd,
-			    adjin ? adjin->attr : NULL, afi, safi,
-			    adjin ? adjin->uptime : monotime(NULL));
+
+		if (adjin)
+			bgp_adj_in_attr(adjin, &attr);
+		if (!bqe->msg_pre)
+			bqe->msg_pre = bmp_monitor_msg(
+				peer, 0, &bqe->p, prd, adjin ? &attr : NULL,
+				afi, safi,
+				adjin ? adjin->uptime : monotime(NULL));
+		bmp->cnt_update++;
+		pullwr_write_stream(bmp->pullwr, bqe->msg_pre);
 		written = true;
 	}
 
 out:
 	if (!bqe->refcount)
-		XFREE(MTYPE_BMP_QUEUE, bqe);
+		bmp_qentry_free(bqe);
 
 	if (bn)
 		bgp_dest_unlock_node(bn);
@@ -1253,30 +1579,38 @@ static void bmp_wrerr(struct bmp *bmp, struct pullwr *pullwr, bool eof)
 	bmp_free(bmp);
 }
 
-static void bmp_process_one(struct bmp_targets *bt, struct bgp *bgp, afi_t afi,
-			    safi_t safi, struct bgp_dest *bn, struct peer *peer)
+static void bmp_qentry_ref(struct bmp_queue_entry *bqeref, afi_t afi,
+			   safi_t safi, struct bgp_dest *bn, struct peer *peer)
+{
+	memset(bqeref, 0, sizeof(*bqeref));
+	prefix_copy(&bqeref->p, bgp_dest_get_prefix(bn));
+	bqeref->peerid = peer ? peer->qobj_node.nid : 0;
+	bqeref->afi = afi;
+	bqeref->safi = safi;
+
+	if ((afi == AFI_L2VPN && safi == SAFI_EVPN && bn->pdest) ||
+	    (safi == SAFI_MPLS_VPN))
+		prefix_copy(&bqeref->rd,
+			    (struct prefix_rd *)bgp_dest_get_prefix(bn->pdest));
+}
+
+/* Queue a route for the sessions of bt, peer NULL for the Loc-RIB */
+static void bmp_queue_add(struct bmp_targets *bt,
+			  const struct bmp_queue_entry *bqeref)
 {
 	struct bmp *bmp;
-	struct bmp_queue_entry *bqe, bqeref;
+	struct bmp_queue_entry *bqe;
 	size_t refcount;
 
 	refcount = bmp_session_count(&bt->sessions);
 	if (refcount == 0)
 		return;
 
-	memset(&bqeref, 0, sizeof(bqeref));
-	prefix_copy(&bqeref.p, bgp_dest_get_prefix(bn));
-	bqeref.peerid = peer->qobj_node.nid;
-	bqeref.afi = afi;
-	bqeref.safi = safi;
-
-	if ((afi == AFI_L2VPN && safi == SAFI_EVPN && bn->pdest) ||
-	    (safi == SAFI_MPLS_VPN))
-		prefix_copy(&bqeref.rd,
-			    (struct prefix_rd *)bgp_dest_get_prefix(bn->pdest));
-
-	bqe = bmp_qhash_find(&bt->updhash, &bqeref);
+	bqe = bmp_qhash_find(&bt->updhash, bqeref);
 	if (bqe) {
+		/* The route moved on from what was encoded */
+		bmp_qentry_uncache(bqe);
+
 		if (bqe->refcount >= refcount)
 			/* nothing to do here */
 			return;
@@ -1284,7 +1618,8 @@ static void bmp_process_one(struct bmp_targets *bt, struct bgp *bgp, afi_t afi,
 		bmp_qlist_del(&bt->updlist, bqe);
 	} else {
 		bqe = XMALLOC(MTYPE_BMP_QUEUE, sizeof(*bqe));
-		memcpy(bqe, &bqeref, sizeof(*bqe));
+		memcpy(bqe, bqeref, sizeof(*bqe));
+		bqe->msg_pre = bqe->msg_post = NULL;
 
 		bmp_qhash_add(&bt->updhash, bqe);
 	}
@@ -1297,6 +1632,15 @@ static void bmp_process_one(struct bmp_targets *bt, struct bgp *bgp, afi_t afi,
 			bmp->queuepos = bqe;
 }
 
+static void bmp_process_one(struct bmp_targets *bt, struct bgp *bgp, afi_t afi,
+			    safi_t safi, struct bgp_dest *bn, struct peer *peer)
+{
+	struct bmp_queue_entry bqeref;
+
+	bmp_qentry_ref(&bqeref, afi, safi, bn, peer);
+	bmp_queue_add(bt, &bqeref);
+}
+
 static int bmp_process(struct bgp *bgp, afi_t afi, safi_t safi,
 		       struct bgp_dest *bn, struct peer *peer, bool withdraw)
 {
@@ -1316,7 +1660,8 @@ static int bmp_process(struct bgp *bgp, afi_t afi, safi_t safi,
 		return 0;
 
 	frr_each(bmp_targets, &bmpbgp->targets, bt) {
-		if (!bt->afimon[afi][safi])
+		if (!(bt->afimon[afi][safi] &
+		      (BMP_MON_PREPOLICY | BMP_MON_POSTPOLICY)))
 			continue;
 
 		bmp_process_one(bt, bgp, afi, safi, bn, peer);
@@ -1328,6 +1673,77 @@ static int bmp_process(struct bgp *bgp, afi_t afi, safi_t safi,
 	return 0;
 }
 
+/* Release the Loc-RIB changes held back, each prefix in its last state */
+static void bmp_locrib_release(struct event *thread)
+{
+	struct bmp_targets *bt = EVENT_ARG(thread);
+	struct bmp_queue_entry *bqe;
+	struct bmp *bmp;
+
+	while ((bqe = bmp_qlist_pop(&bt->loclist))) {
+		bmp_qhash_del(&bt->lochash, bqe);
+		bmp_queue_add(bt, bqe);
+		XFREE(MTYPE_BMP_QUEUE, bqe);
+	}
+
+	frr_each (bmp_session, &bt->sessions, bmp)
+		pullwr_bump(bmp->pullwr);
+}
+
+static void bmp_locrib_flush(struct bmp_targets *bt)
+{
+	struct bmp_queue_entry *bqe;
+
+	EVENT_OFF(bt->t_locrib);
+	while ((bqe = bmp_qlist_pop(&bt->loclist))) {
+		bmp_qhash_del(&bt->lochash, bqe);
+		XFREE(MTYPE_BMP_QUEUE, bqe);
+	}
+}
+
+static int bmp_route_update(struct bgp *bgp, afi_t afi, safi_t safi,
+			    struct bgp_dest *bn,
+			    struct bgp_path_info *old_route,
+			    struct bgp_path_info *new_route)
+{
+	struct bmp_bgp *bmpbgp = bmp_bgp_find(bgp);
+	struct bmp_queue_entry *bqe, bqeref;
+	struct bmp_targets *bt;
+	struct bmp *bmp;
+
+	if (!bmpbgp)
+		return 0;
+
+	frr_each (bmp_targets, &bmpbgp->targets, bt) {
+		if (!(bt->afimon[afi][safi] & BMP_MON_LOC_RIB) ||
+		    !bmp_session_count(&bt->sessions))
+			continue;
+
+		bmp_qentry_ref(&bqeref, afi, safi, bn, NULL);
+
+		if (!bt->locrib_msec) {
+			bmp_queue_add(bt, &bqeref);
+			frr_each (bmp_session, &bt->sessions, bmp)
+				pullwr_bump(bmp->pullwr);
+			continue;
+		}
+
+		/* Flaps within the interval collapse into one message */
+		if (bmp_qhash_find(&bt->lochash, &bqeref))
+			continue;
+
+		bqe = XMALLOC(MTYPE_BMP_QUEUE, sizeof(*bqe));
+		memcpy(bqe, &bqeref, sizeof(*bqe));
+		bmp_qhash_add(&bt->lochash, bqe);
+		bmp_qlist_add_tail(&bt->loclist, bqe);
+
+		if (!bt->t_locrib)
+			event_add_timer_msec(bm->master, bmp_locrib_release, bt,
+					     bt->locrib_msec, &bt->t_locrib);
+	}
+	return 0;
+}
+
 static void bmp_stat_put_u32(struct stream *s, size_t *cnt, uint16_t type,
 		uint32_t value)
 {
@@ -1526,10 +1942,10 @@ static void bmp_close(struct bmp *bmp)
 
 	while ((bmq = bmp_pull_mirror(bmp)))
 		if (!bmq->refcount)
-			XFREE(MTYPE_BMP_MIRRORQ, bmq);
+			bmp_mirrorq_free(bmq);
 	while ((bqe = bmp_pull(bmp)))
 		if (!bqe->refcount)
-			XFREE(MTYPE_BMP_QUEUE, bqe);
+			bmp_qentry_free(bqe);
 
 	EVENT_OFF(bmp->t_read);
 	pullwr_del(bmp->pullwr);
@@ -1633,6 +2049,9 @@ static struct bmp_targets *bmp_targets_get(struct bgp *bgp, const char *name)
 	bmp_session_init(&bt->sessions);
 	bmp_qhash_init(&bt->updhash);
 	bmp_qlist_init(&bt->updlist);
+	bmp_qhash_init(&bt->lochash);
+	bmp_qlist_init(&bt->loclist);
+	bt->locrib_msec = BMP_LOCRIB_DEFAULT_MSEC;
 	bmp_actives_init(&bt->actives);
 	bmp_listeners_init(&bt->listeners);
 
@@ -1647,6 +2066,7 @@ static void bmp_targets_put(struct bmp_targets *bt)
 	struct bmp_active *ba;
 
 	EVENT_OFF(bt->t_stats);
+	bmp_locrib_flush(bt);
 
 	frr_each_safe (bmp_actives, &bt->actives, ba)
 		bmp_active_put(ba);
@@ -1663,6 +2083,8 @@ static void bmp_targets_put(struct bmp_targets *bt)
 	bmp_actives_fini(&bt->actives);
 	bmp_qhash_fini(&bt->updhash);
 	bmp_qlist_fini(&bt->updlist);
+	bmp_qhash_fini(&bt->lochash);
+	bmp_qlist_fini(&bt->loclist);
 
 	XFREE(MTYPE_BMP_ACLNAME, bt->acl_name);
 	XFREE(MTYPE_BMP_ACLNAME, bt->acl6_name);
@@ -2211,7 +2633,7 @@ DEFPY(bmp_stats_cfg,
 
 DEFPY(bmp_monitor_cfg,
       bmp_monitor_cmd,
-      "[no] bmp monitor <ipv4|ipv6|l2vpn> <unicast|multicast|evpn|vpn> <pre-policy|post-policy>$policy",
+      "[no] bmp monitor <ipv4|ipv6|l2vpn> <unicast|multicast|evpn|vpn> <pre-policy|post-policy|loc-rib>$policy",
       NO_STR
       BMP_STR
       "Send BMP route monitoring messages\n"
@@ -2223,10 +2645,12 @@ DEFPY(bmp_monitor_cfg,
       BGP_AF_STR
       BGP_AF_STR
       "Send state before policy and filter processing\n"
-      "Send state with policy and filters applied\n")
+      "Send state with policy and filters applied\n"
+      "Send the selected best paths (RFC 9069)\n")
 {
 	int index = 0;
 	uint8_t flag, prev;
+	bool locrib;
 	afi_t afi;
 	safi_t safi;
 
@@ -2236,11 +2660,14 @@ DEFPY(bmp_monitor_cfg,
 	argv_find_and_parse_afi(argv, argc, &index, &afi);
 	argv_find_and_parse_safi(argv, argc, &index, &safi);
 
-	if (policy[1] == 'r')
+	if (policy[0] == 'l')
+		flag = BMP_MON_LOC_RIB;
+	else if (policy[1] == 'r')
 		flag = BMP_MON_PREPOLICY;
 	else
 		flag = BMP_MON_POSTPOLICY;
 
+	locrib = bmp_locrib_monitored(bt);
 	prev = bt->afimon[afi][safi];
 	if (no)
 		bt->afimon[afi][safi] &= ~flag;
@@ -2250,7 +2677,19 @@ DEFPY(bmp_monitor_cfg,
 	if (prev == bt->afimon[afi][safi])
 		return CMD_SUCCESS;
 
+	if (!bmp_locrib_monitored(bt))
+		bmp_locrib_flush(bt);
+
 	frr_each (bmp_session, &bt->sessions, bmp) {
+		/* Collectors learn about the Loc-RIB instance first */
+		if (!locrib && bmp_locrib_monitored(bt) &&
+		    bmp->state == BMP_Run) {
+			struct stream *s = bmp_locrib_peerup(bt);
+
+			pullwr_write_stream(bmp->pullwr, s);
+			stream_free(s);
+		}
+
 		if (bmp->syncafi == afi && bmp->syncsafi == safi) {
 			bmp->syncafi = AFI_MAX;
 			bmp->syncsafi = SAFI_MAX;
@@ -2267,6 +2706,50 @@ DEFPY(bmp_monitor_cfg,
 	return CMD_SUCCESS;
 }
 
+DEFPY(bmp_locrib_interval_cfg,
+      bmp_locrib_interval_cmd,
+      "[no] bmp loc-rib interval ![(0-60000)$interval]",
+      NO_STR
+      BMP_STR
+      "Loc-RIB route monitoring settings\n"
+      "Hold changes back and send them together\n"
+      "Interval in milliseconds, 0 to send every change\n")
+{
+	VTY_DECLVAR_CONTEXT_SUB(bmp_targets, bt);
+
+	bt->locrib_msec = no ? BMP_LOCRIB_DEFAULT_MSEC : interval;
+
+	/* Whatever is held back goes out now, at the old rate */
+	if (bt->t_locrib) {
+		EVENT_OFF(bt->t_locrib);
+		event_add_timer_msec(bm->master, bmp_locrib_release, bt, 0,
+				     &bt->t_locrib);
+	}
+	return CMD_SUCCESS;
+}
+
+DEFPY(bmp_locrib_latency_cfg,
+      bmp_locrib_latency_cmd,
+      "[no] bmp loc-rib latency",
+      NO_STR
+      BMP_STR
+      "Loc-RIB route monitoring settings\n"
+      "Add the latency and the selection step of the best path\n")
+{
+	VTY_DECLVAR_CONTEXT_SUB(bmp_targets, bt);
+	struct bmp_queue_entry *bqe;
+
+	if (bt->locrib_latency == !no)
+		return CMD_SUCCESS;
+	bt->locrib_latency = !no;
+
+	/* Queued messages were encoded the other way */
+	frr_each (bmp_qlist, &bt->updlist, bqe)
+		if (!bqe->peerid)
+			bmp_qentry_uncache(bqe);
+	return CMD_SUCCESS;
+}
+
 DEFPY(bmp_mirror_cfg,
       bmp_mirror_cmd,
       "[no] bmp mirror",
@@ -2289,7 +2772,7 @@ DEFPY(bmp_mirror_cfg,
 
 		while ((bmq = bmp_pull_mirror(bmp)))
 			if (!bmq->refcount)
-				XFREE(MTYPE_BMP_MIRRORQ, bmq);
+				bmp_mirrorq_free(bmq);
 	}
 	return CMD_SUCCESS;
 }
@@ -2367,24 +2850,26 @@ DEFPY(show_bmp,
 			safi_t safi;
 
 			FOREACH_AFI_SAFI (afi, safi) {
-				const char *str = NULL;
-
-				switch (bt->afimon[afi][safi]) {
-				case BMP_MON_PREPOLICY:
-					str = "pre-policy";
-					break;
-				case BMP_MON_POSTPOLICY:
-					str = "post-policy";
-					break;
-				case BMP_MON_PREPOLICY | BMP_MON_POSTPOLICY:
-					str = "pre-policy and post-policy";
-					break;
-				}
-				if (!str)
+				uint8_t mon = bt->afimon[afi][safi];
+
+				if (!mon)
 					continue;
-				vty_out(vty, "    Route Monitoring %s %s %s\n",
-					afi2str(afi), safi2str(safi), str);
+				vty_out(vty, "    Route Monitoring %s %s%s%s%s\n",
+					afi2str(afi), safi2str(safi),
+					mon & BMP_MON_PREPOLICY ? " pre-policy"
+								: "",
+					mon & BMP_MON_POSTPOLICY ? " post-policy"
+								 : "",
+					mon & BMP_MON_LOC_RIB ? " loc-rib" : "");
 			}
+			if (bmp_locrib_monitored(bt))
+				vty_out(vty,
+					"    Loc-RIB interval %dms, %zu changes held back%s\n",
+					bt->locrib_msec,
+					bmp_qlist_count(&bt->loclist),
+					bt->locrib_latency
+						? ", with latency"
+						: "");
 
 			vty_out(vty, "    Listeners:\n");
 			frr_each (bmp_listeners, &bt->listeners, bl)
@@ -2510,7 +2995,15 @@ static int bmp_config_write(struct bgp *bgp, struct vty *vty)
 				vty_out(vty,
 					"  bmp monitor %s %s post-policy\n",
 					afi2str_lower(afi), safi2str(safi));
+			if (bt->afimon[afi][safi] & BMP_MON_LOC_RIB)
+				vty_out(vty, "  bmp monitor %s %s loc-rib\n",
+					afi2str_lower(afi), safi2str(safi));
 		}
+		if (bt->locrib_msec != BMP_LOCRIB_DEFAULT_MSEC)
+			vty_out(vty, "  bmp loc-rib interval %d\n",
+				bt->locrib_msec);
+		if (bt->locrib_latency)
+			vty_out(vty, "  bmp loc-rib latency\n");
 		frr_each (bmp_listeners, &bt->listeners, bl)
 			vty_out(vty, "   bmp listener %pSU port %d\n", &bl->addr, bl->port);
 
@@ -2546,6 +3039,8 @@ static int bgp_bmp_init(struct event_loop *tm)
 	install_element(BMP_NODE, &bmp_acl_cmd);
 	install_element(BMP_NODE, &bmp_stats_cmd);
 	install_element(BMP_NODE, &bmp_monitor_cmd);
+	install_element(BMP_NODE, &bmp_locrib_interval_cmd);
+	install_element(BMP_NODE, &bmp_locrib_latency_cmd);
 	install_element(BMP_NODE, &bmp_mirror_cmd);
 
 	install_element(BGP_NODE, &bmp_mirror_limit_cmd);
@@ -2564,6 +3059,7 @@ static int bgp_bmp_module_init(void)
 	hook_register(peer_status_changed, bmp_peer_status_changed);
 	hook_register(peer_backward_transition, bmp_peer_backward);
 	hook_register(bgp_process, bmp_process);
+	hook_register(bgp_route_update, bmp_route_update);
 	hook_register(bgp_inst_config_write, bmp_config_write);
 	hook_register(bgp_inst_delete, bmp_bgp_del);
 	hook_register(frr_late_init, bgp_bmp_init);
@@ -69,6 +69,14 @@ struct bmp_queue_entry {
 
 	/* initialized only for L2VPN/EVPN (S)AFIs */
 	struct prefix_rd rd;
+
+	/* Route monitoring messages as the first session of the targets to
+	 * pull this entry encoded them, for the other sessions to send as
+	 * they are.  Dropped when the route changes again.  Loc-RIB entries,
+	 * the ones with peerid 0, keep their message in msg_post.
+	 */
+	struct stream *msg_pre;
+	struct stream *msg_post;
 };
 
 /* This is for BMP Route Mirroring, which feeds fully raw BGP PDUs out to BMP
@@ -89,7 +97,8 @@ struct bmp_mirrorq {
 	struct timeval tv;
 
 	size_t len;
-	uint8_t data[0];
+	/* The received packet, shared with the peer */
+	struct stream *pkt;
 };
 
 enum {
@@ -145,6 +154,8 @@ struct bmp {
 	struct prefix syncpos;
 	struct bgp_dest *syncrdpos;
 	uint64_t syncpeerid;
+	/* the Loc-RIB route of syncpos went out already */
+	bool synclocrib;
 	afi_t syncafi;
 	safi_t syncsafi;
 };
@@ -221,9 +232,21 @@ struct bmp_targets {
 	 */
 #define BMP_MON_PREPOLICY	(1 << 0)
 #define BMP_MON_POSTPOLICY	(1 << 1)
+#define BMP_MON_LOC_RIB		(1 << 2)
 	uint8_t afimon[AFI_MAX][SAFI_MAX];
 	bool mirror;
 
+	/* Loc-RIB changes are held back for locrib_msec and go out together,
+	 * the last state of each prefix once.  With locrib_latency the
+	 * messages carry the latency and selection step of the best path.
+	 */
+#define BMP_LOCRIB_DEFAULT_MSEC	1000
+	int locrib_msec;
+	bool locrib_latency;
+	struct event *t_locrib;
+	struct bmp_qhash_head lochash;
+	struct bmp_qlist_head loclist;
+
 	struct bmp_actives_head actives;
 
 	struct event *t_stats;
@@ -23,6 +23,206 @@
 #include "bgpd/bgp_regex.h"
 #include "bgpd/bgp_clist.h"
 
+DEFINE_MTYPE_STATIC(BGPD, COMMUNITY_LIST_MEMO, "Community-list match result");
+
+/*
+ * Matching a list walks its entries, each expanded one a regexec over the
+ * attribute's string. Attributes are interned and shared by many paths, so
+ * the result is remembered per interned value and kind of match, holding a
+ * reference so that the pointer stays that value. A list forgets all of it
+ * on any change to its entries.
+ */
+enum clist_memo_kind {
+	CLIST_MEMO_COMMUNITY,
+	CLIST_MEMO_COMMUNITY_EXACT,
+	CLIST_MEMO_COMMUNITY_ANY,
+	CLIST_MEMO_LCOMMUNITY,
+	CLIST_MEMO_LCOMMUNITY_EXACT,
+	CLIST_MEMO_LCOMMUNITY_ANY,
+	CLIST_MEMO_ECOMMUNITY,
+};
+
+struct clist_memo_entry {
+	struct clist_memo_item item;
+
+	const void *val;
+	uint8_t kind;
+	bool result;
+};
+
+static int clist_memo_cmp(const struct clist_memo_entry *a,
+			  const struct clist_memo_entry *b)
+{
+	if (a->val != b->val)
+		return a->val < b->val ? -1 : 1;
+	return numcmp(a->kind, b->kind);
+}
+
+static uint32_t clist_memo_hash(const struct clist_memo_entry *e)
+{
+	uint64_t val = (uintptr_t)e->val;
+
+	return jhash_2words(val, val >> 32, e->kind);
+}
+
+DECLARE_HASH(clist_memo, struct clist_memo_entry, item, clist_memo_cmp,
+	     clist_memo_hash);
+
+/* Past this, a list starts over rather than grow */
+#define CLIST_MEMO_MAX 4096
+
+/* A standard entry of one community value, at pos in the list */
+struct clist_value {
+	uint32_t val;
+	unsigned int pos;
+	uint8_t direct;
+};
+
+static void clist_memo_flush(struct community_list *list)
+{
+	struct clist_memo_entry *e;
+	struct community *com;
+	struct lcommunity *lcom;
+	struct ecommunity *ecom;
+
+	while ((e = clist_memo_pop(&list->memo))) {
+		switch ((enum clist_memo_kind)e->kind) {
+		case CLIST_MEMO_COMMUNITY:
+		case CLIST_MEMO_COMMUNITY_EXACT:
+		case CLIST_MEMO_COMMUNITY_ANY:
+			com = (struct community *)e->val;
+			community_unintern(&com);
+			break;
+		case CLIST_MEMO_LCOMMUNITY:
+		case CLIST_MEMO_LCOMMUNITY_EXACT:
+		case CLIST_MEMO_LCOMMUNITY_ANY:
+			lcom = (struct lcommunity *)e->val;
+			lcommunity_unintern(&lcom);
+			break;
+		case CLIST_MEMO_ECOMMUNITY:
+			ecom = (struct ecommunity *)e->val;
+			ecommunity_unintern(&ecom);
+			break;
+		}
+		XFREE(MTYPE_COMMUNITY_LIST_MEMO, e);
+	}
+}
+
+/* Found in the memo; values not interned never are */
+static bool clist_memo_get(struct community_list *list, const void *val,
+			   unsigned long refcnt, enum clist_memo_kind kind,
+			   bool *result)
+{
+	struct clist_memo_entry ref, *e;
+
+	if (!val || !refcnt)
+		return false;
+
+	ref.val = val;
+	ref.kind = kind;
+	e = clist_memo_find(&list->memo, &ref);
+	if (!e)
+		return false;
+
+	*result = e->result;
+	return true;
+}
+
+static void clist_memo_put(struct community_list *list, const void *val,
+			   unsigned long *refcnt, enum clist_memo_kind kind,
+			   bool result)
+{
+	struct clist_memo_entry *e;
+
+	if (!val || !*refcnt)
+		return;
+
+	if (clist_memo_count(&list->memo) >= CLIST_MEMO_MAX)
+		clist_memo_flush(list);
+
+	e = XCALLOC(MTYPE_COMMUNITY_LIST_MEMO, sizeof(*e));
+	e->val = val;
+	e->kind = kind;
+	e->result = result;
+	(*refcnt)++;
+	clist_memo_add(&list->memo, e);
+}
+
+static int clist_value_cmp(const void *a, const void *b)
+{
+	const struct clist_value *va = a, *vb = b;
+
+	if (va->val != vb->val)
+		return va->val < vb->val ? -1 : 1;
+	return numcmp(va->pos, vb->pos);
+}
+
+/*
+ * A community-list of nothing but standard entries of one value each is
+ * matched by looking each of the attribute's values up, rather than each
+ * entry's up in the attribute. Returns whether the list is one.
+ */
+static bool community_list_compile(struct community_list *list)
+{
+	struct community_entry *entry;
+	unsigned int count = 0, i, j;
+
+	if (list->compiled)
+		return list->values != NULL;
+	list->compiled = true;
+
+	for (entry = list->head; entry; entry = entry->next) {
+		if (entry->style != COMMUNITY_LIST_STANDARD || !entry->u.com ||
+		    entry->u.com->size != 1)
+			return false;
+		count++;
+	}
+	if (!count)
+		return false;
+
+	list->values = XMALLOC(MTYPE_COMMUNITY_LIST_MEMO,
+			       count * sizeof(*list->values));
+	for (entry = list->head, i = 0; entry; entry = entry->next, i++) {
+		list->values[i].val = community_val_get(entry->u.com, 0);
+		list->values[i].pos = i;
+		list->values[i].direct = entry->direct;
+	}
+	qsort(list->values, count, sizeof(*list->values), clist_value_cmp);
+
+	/* The first entry of a value is the one that matches */
+	for (i = 1, j = 0; i < count; i++)
+		if (list->values[i].val != list->values[j].val)
+			list->values[++j] = list->values[i];
+	list->values_count = j + 1;
+	return true;
+}
+
+static const struct clist_value *community_list_value(struct community_list *list,
+						      uint32_t val)
+{
+	unsigned int lo = 0, hi = list->values_count, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (list->values[mid].val == val)
+			return &list->values[mid];
+		if (list->values[mid].val < val)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return NULL;
+}
+
+/* Forget what was compiled from the entries, as they change */
+static void community_list_uncompile(struct community_list *list)
+{
+	clist_memo_flush(list);
+	XFREE(MTYPE_COMMUNITY_LIST_MEMO, list->values);
+	list->values_count = 0;
+	list->compiled = false;
+}
+
 /* Calculate new sequential number. */
 static int64_t bgp_clist_new_seq_get(struct community_list *list)
 {
@@ -137,12 +337,18 @@ static void community_entry_free(struct community_entry *entry)
 /* Allocate a new community-list.  */
 static struct community_list *community_list_new(void)
 {
-	return XCALLOC(MTYPE_COMMUNITY_LIST, sizeof(struct community_list));
+	struct community_list *list;
+
+	list = XCALLOC(MTYPE_COMMUNITY_LIST, sizeof(struct community_list));
+	clist_memo_init(&list->memo);
+	return list;
 }
 
 /* Free community-list.  */
 static void community_list_free(struct community_list *list)
 {
+	community_list_uncompile(list);
+	clist_memo_fini(&list->memo);
 	XFREE(MTYPE_COMMUNITY_LIST_NAME, list->name);
 	XFREE(MTYPE_COMMUNITY_LIST, list);
 }
@@ -307,6 +513,8 @@ static void community_list_entry_delete(struct community_list_master *cm,
 					struct community_list *list,
 					struct community_entry *entry)
 {
+	community_list_uncompile(list);
+
 	if (entry->next)
 		entry->next->prev = entry->prev;
 	else
@@ -359,6 +567,8 @@ static void community_list_entry_add(struct community_list *list,
 	struct community_entry *replace;
 	struct community_entry *point;
 
+	community_list_uncompile(list);
+
 	/* Automatic assignment of seq no. */
 	if (entry->seq == COMMUNITY_SEQ_NUMBER_AUTO)
 		entry->seq = bgp_clist_new_seq_get(list);
@@ -645,11 +855,21 @@ static bool ecommunity_regexp_match(struct ecommunity *ecom, regex_t *reg)
 	return false;
 }
 
-/* When given community attribute matches to the community-list return
-   1 else return 0.  */
-bool community_list_match(struct community *com, struct community_list *list)
+static bool community_list_match_entries(struct community *com,
+					 struct community_list *list)
 {
 	struct community_entry *entry;
+	const struct clist_value *v, *first = NULL;
+	int i;
+
+	if (community_list_compile(list)) {
+		for (i = 0; com && i < com->size; i++) {
+			v = community_list_value(list, community_val_get(com, i));
+			if (v && (!first || v->pos < first->pos))
+				first = v;
+		}
+		return first && first->direct == COMMUNITY_PERMIT;
+	}
 
 	for (entry = list->head; entry; entry = entry->next) {
 		if (entry->style == COMMUNITY_LIST_STANDARD) {
@@ -663,7 +883,23 @@ bool community_list_match(struct community *com, struct community_list *list)
 	return false;
 }
 
-bool lcommunity_list_match(struct lcommunity *lcom, struct community_list *list)
+/* When given community attribute matches to the community-list return
+   1 else return 0.  */
+bool community_list_match(struct community *com, struct community_list *list)
+{
+	bool ret;
+
+	if (clist_memo_get(list, com, com ? com->refcnt : 0,
+			   CLIST_MEMO_COMMUNITY, &ret))
+		return ret;
+	ret = community_list_match_entries(com, list);
+	clist_memo_put(list, com, com ? &com->refcnt : NULL,
+		       CLIST_MEMO_COMMUNITY, ret);
+	return ret;
+}
+
+static bool lcommunity_list_match_entries(struct lcommunity *lcom,
+					  struct community_list *list)
 {
 	struct community_entry *entry;
 
@@ -679,12 +915,21 @@ bool lcommunity_list_match(struct lcommunity *lcom, struct community_list *list)
 	return false;
 }
 
+bool lcommunity_list_match(struct lcommunity *lcom, struct community_list *list)
+{
+	bool ret;
+
+	if (clist_memo_get(list, lcom, lcom ? lcom->refcnt : 0,
+			   CLIST_MEMO_LCOMMUNITY, &ret))
+		return ret;
+	ret = lcommunity_list_match_entries(lcom, list);
+	clist_memo_put(list, lcom, lcom ? &lcom->refcnt : NULL,
+		       CLIST_MEMO_LCOMMUNITY, ret);
+	return ret;
+}
 
-/* Perform exact matching.  In case of expanded large-community-list, do
- * same thing as lcommunity_list_match().
- */
-bool lcommunity_list_exact_match(struct lcommunity *lcom,
-				 struct community_list *list)
+static bool lcommunity_list_exact_match_entries(struct lcommunity *lcom,
+						struct community_list *list)
 {
 	struct community_entry *entry;
 
@@ -700,7 +945,25 @@ bool lcommunity_list_exact_match(struct lcommunity *lcom,
 	return false;
 }
 
-bool ecommunity_list_match(struct ecommunity *ecom, struct community_list *list)
+/* Perform exact matching.  In case of expanded large-community-list, do
+ * same thing as lcommunity_list_match().
+ */
+bool lcommunity_list_exact_match(struct lcommunity *lcom,
+				 struct community_list *list)
+{
+	bool ret;
+
+	if (clist_memo_get(list, lcom, lcom ? lcom->refcnt : 0,
+			   CLIST_MEMO_LCOMMUNITY_EXACT, &ret))
+		return ret;
+	ret = lcommunity_list_exact_match_entries(lcom, list);
+	clist_memo_put(list, lcom, lcom ? &lcom->refcnt : NULL,
+		       CLIST_MEMO_LCOMMUNITY_EXACT, ret);
+	return ret;
+}
+
+static bool ecommunity_list_match_entries(struct ecommunity *ecom,
+					  struct community_list *list)
 {
 	struct community_entry *entry;
 
@@ -716,12 +979,31 @@ bool ecommunity_list_match(struct ecommunity *ecom, struct community_list *list)
 	return false;
 }
 
-/* Perform exact matching.  In case of expanded community-list, do
-   same thing as community_list_match().  */
-bool community_list_exact_match(struct community *com,
-				struct community_list *list)
+bool ecommunity_list_match(struct ecommunity *ecom, struct community_list *list)
+{
+	bool ret;
+
+	if (clist_memo_get(list, ecom, ecom ? ecom->refcnt : 0,
+			   CLIST_MEMO_ECOMMUNITY, &ret))
+		return ret;
+	ret = ecommunity_list_match_entries(ecom, list);
+	clist_memo_put(list, ecom, ecom ? &ecom->refcnt : NULL,
+		       CLIST_MEMO_ECOMMUNITY, ret);
+	return ret;
+}
+
+static bool community_list_exact_match_entries(struct community *com,
+					       struct community_list *list)
 {
 	struct community_entry *entry;
+	const struct clist_value *v;
+
+	if (community_list_compile(list)) {
+		if (!com || com->size != 1)
+			return false;
+		v = community_list_value(list, community_val_get(com, 0));
+		return v && v->direct == COMMUNITY_PERMIT;
+	}
 
 	for (entry = list->head; entry; entry = entry->next) {
 		if (entry->style == COMMUNITY_LIST_STANDARD) {
@@ -735,15 +1017,41 @@ bool community_list_exact_match(struct community *com,
 	return false;
 }
 
-bool community_list_any_match(struct community *com, struct community_list *list)
+/* Perform exact matching.  In case of expanded community-list, do
+   same thing as community_list_match().  */
+bool community_list_exact_match(struct community *com,
+				struct community_list *list)
+{
+	bool ret;
+
+	if (clist_memo_get(list, com, com ? com->refcnt : 0,
+			   CLIST_MEMO_COMMUNITY_EXACT, &ret))
+		return ret;
+	ret = community_list_exact_match_entries(com, list);
+	clist_memo_put(list, com, com ? &com->refcnt : NULL,
+		       CLIST_MEMO_COMMUNITY_EXACT, ret);
+	return ret;
+}
+
+static bool community_list_any_match_entries(struct community *com,
+					     struct community_list *list)
 {
 	struct community_entry *entry;
+	const struct clist_value *v;
 	uint32_t val;
 	int i;
+	bool compiled = community_list_compile(list);
 
 	for (i = 0; i < com->size; i++) {
 		val = community_val_get(com, i);
 
+		if (compiled) {
+			v = community_list_value(list, val);
+			if (v)
+				return v->direct == COMMUNITY_PERMIT;
+			continue;
+		}
+
 		for (entry = list->head; entry; entry = entry->next) {
 			if (entry->style == COMMUNITY_LIST_STANDARD &&
 			    community_include(entry->u.com, val))
@@ -756,6 +1064,18 @@ bool community_list_any_match(struct community *com, struct community_list *list
 	return false;
 }
 
+bool community_list_any_match(struct community *com, struct community_list *list)
+{
+	bool ret;
+
+	if (clist_memo_get(list, com, com->refcnt, CLIST_MEMO_COMMUNITY_ANY,
+			   &ret))
+		return ret;
+	ret = community_list_any_match_entries(com, list);
+	clist_memo_put(list, com, &com->refcnt, CLIST_MEMO_COMMUNITY_ANY, ret);
+	return ret;
+}
+
 /* Delete all permitted communities in the list from com.  */
 struct community *community_list_match_delete(struct community *com,
 					      struct community_list *list)
@@ -943,8 +1263,8 @@ int community_list_unset(struct community_list_handler *ch, const char *name,
 	return 0;
 }
 
-bool lcommunity_list_any_match(struct lcommunity *lcom,
-			       struct community_list *list)
+static bool lcommunity_list_any_match_entries(struct lcommunity *lcom,
+					      struct community_list *list)
 {
 	struct community_entry *entry;
 	uint8_t *ptr;
@@ -965,6 +1285,20 @@ bool lcommunity_list_any_match(struct lcommunity *lcom,
 	return false;
 }
 
+bool lcommunity_list_any_match(struct lcommunity *lcom,
+			       struct community_list *list)
+{
+	bool ret;
+
+	if (clist_memo_get(list, lcom, lcom->refcnt,
+			   CLIST_MEMO_LCOMMUNITY_ANY, &ret))
+		return ret;
+	ret = lcommunity_list_any_match_entries(lcom, list);
+	clist_memo_put(list, lcom, &lcom->refcnt, CLIST_MEMO_LCOMMUNITY_ANY,
+		       ret);
+	return ret;
+}
+
 /* Delete all permitted large communities in the list from com.  */
 struct lcommunity *lcommunity_list_match_delete(struct lcommunity *lcom,
 						struct community_list *list)
@@ -1363,6 +1697,23 @@ struct community_list_handler *community_list_init(void)
 	return ch;
 }
 
+static void community_list_master_uncompile(struct community_list_master *cm)
+{
+	struct community_list *list;
+
+	for (list = cm->num.head; list; list = list->next)
+		community_list_uncompile(list);
+	for (list = cm->str.head; list; list = list->next)
+		community_list_uncompile(list);
+}
+
+void community_list_flush_compiled(struct community_list_handler *ch)
+{
+	community_list_master_uncompile(&ch->community_list);
+	community_list_master_uncompile(&ch->extcommunity_list);
+	community_list_master_uncompile(&ch->lcommunity_list);
+}
+
 /* Terminate community-list.  */
 void community_list_terminate(struct community_list_handler *ch)
 {
@@ -7,6 +7,7 @@
 #define _QUAGGA_BGP_CLIST_H
 
 #include "jhash.h"
+#include "typesafe.h"
 
 /* Master Community-list. */
 #define COMMUNITY_LIST_MASTER          0
@@ -35,6 +36,10 @@
 #define LARGE_COMMUNITY_LIST_STANDARD  4 /* Standard Large community-list.  */
 #define LARGE_COMMUNITY_LIST_EXPANDED  5 /* Expanded Large community-list.  */
 
+PREDECL_HASH(clist_memo);
+
+struct clist_value;
+
 /* Community-list.  */
 struct community_list {
 	/* Name of the community-list.  */
@@ -56,6 +61,16 @@ struct community_list {
 	/* Community-list entry in this community-list.  */
 	struct community_entry *head;
 	struct community_entry *tail;
+
+	/*
+	 * Compiled on first match, dropped on any change to the entries:
+	 * results by interned attribute, and for a standard community-list
+	 * of single values, the values sorted.
+	 */
+	struct clist_memo_head memo;
+	struct clist_value *values;
+	unsigned int values_count;
+	bool compiled;
 };
 
 /* Each entry in community-list.  */
@@ -145,6 +160,9 @@ extern int lcommunity_list_unset(struct community_list_handler *ch,
 				 const char *name, const char *str,
 				 const char *seq, int direct, int style);
 
+/* Forget the compiled results of every list, e.g. as aliases change */
+extern void community_list_flush_compiled(struct community_list_handler *ch);
+
 extern struct community_list_master *
 community_list_master_lookup(struct community_list_handler *ch, int master);
 
@@ -12,6 +12,7 @@
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_community_alias.h"
+#include "bgpd/bgp_clist.h"
 
 static struct hash *bgp_ca_alias_hash;
 static struct hash *bgp_ca_community_hash;
@@ -97,11 +98,15 @@ int bgp_community_alias_write(struct vty *vty)
 
 void bgp_ca_community_insert(struct community_alias *ca)
 {
+	/* Expanded lists match against the aliases */
+	community_list_flush_compiled(bgp_clist);
 	(void)hash_get(bgp_ca_community_hash, ca, bgp_community_alias_alloc);
 }
 
 void bgp_ca_alias_insert(struct community_alias *ca)
 {
+	/* Expanded lists match against the aliases */
+	community_list_flush_compiled(bgp_clist);
 	(void)hash_get(bgp_ca_alias_hash, ca, bgp_community_alias_alloc);
 }
 
@@ -109,6 +114,7 @@ void bgp_ca_community_delete(struct community_alias *ca)
 {
 	struct community_alias *data = hash_release(bgp_ca_community_hash, ca);
 
+	community_list_flush_compiled(bgp_clist);
 	XFREE(MTYPE_COMMUNITY_ALIAS, data);
 }
 
@@ -116,6 +122,7 @@ void bgp_ca_alias_delete(struct community_alias *ca)
 {
 	struct community_alias *data = hash_release(bgp_ca_alias_hash, ca);
 
+	community_list_flush_compiled(bgp_clist);
 	XFREE(MTYPE_COMMUNITY_ALIAS, data);
 }
 
@@ -10,66 +10,270 @@
 #include "bgpd/bgp_conditional_adv.h"
 #include "bgpd/bgp_vty.h"
 
-static route_map_result_t
-bgp_check_rmap_prefixes_in_bgp_table(struct bgp_table *table,
-				     struct route_map *rmap)
+DEFINE_MTYPE_STATIC(BGPD, BGP_COND_ADV, "BGP conditional advertisement");
+DEFINE_MTYPE_STATIC(BGPD, BGP_COND_ADV_DEST,
+		    "BGP conditional advertisement prefix");
+
+static int bgp_cond_adv_dest_cmp(const struct bgp_cond_adv_dest *a,
+				 const struct bgp_cond_adv_dest *b)
+{
+	return numcmp((uintptr_t)a->dest, (uintptr_t)b->dest);
+}
+
+static uint32_t bgp_cond_adv_dest_hash(const struct bgp_cond_adv_dest *d)
+{
+	return prefix_hash_key(bgp_dest_get_prefix(d->dest));
+}
+
+DECLARE_HASH(bgp_cond_adv_dests, struct bgp_cond_adv_dest, item,
+	     bgp_cond_adv_dest_cmp, bgp_cond_adv_dest_hash);
+
+static void bgp_conditional_adv_timer(struct event *t);
+
+/* Returns true if dest was not in the set yet */
+static bool bgp_cond_adv_dest_add(struct bgp_cond_adv_dests_head *head,
+				  struct bgp_dest *dest)
+{
+	struct bgp_cond_adv_dest ref = {.dest = dest};
+	struct bgp_cond_adv_dest *entry;
+
+	if (bgp_cond_adv_dests_find(head, &ref))
+		return false;
+
+	entry = XCALLOC(MTYPE_BGP_COND_ADV_DEST, sizeof(*entry));
+	entry->dest = bgp_dest_lock_node(dest);
+	bgp_cond_adv_dests_add(head, entry);
+	return true;
+}
+
+static void bgp_cond_adv_dest_del(struct bgp_cond_adv_dests_head *head,
+				  struct bgp_dest *dest)
+{
+	struct bgp_cond_adv_dest ref = {.dest = dest};
+	struct bgp_cond_adv_dest *entry;
+
+	entry = bgp_cond_adv_dests_find(head, &ref);
+	if (!entry)
+		return;
+
+	bgp_cond_adv_dests_del(head, entry);
+	bgp_dest_unlock_node(entry->dest);
+	XFREE(MTYPE_BGP_COND_ADV_DEST, entry);
+}
+
+static void bgp_cond_adv_dests_flush(struct bgp_cond_adv_dests_head *head)
+{
+	struct bgp_cond_adv_dest *entry;
+
+	while ((entry = bgp_cond_adv_dests_pop(head))) {
+		bgp_dest_unlock_node(entry->dest);
+		XFREE(MTYPE_BGP_COND_ADV_DEST, entry);
+	}
+}
+
+static struct bgp_table *bgp_cond_adv_table(const struct bgp_cond_adv *cond)
+{
+	/* labeled-unicast routes are installed in the unicast table */
+	safi_t safi = (cond->safi == SAFI_LABELED_UNICAST) ? SAFI_UNICAST
+							   : cond->safi;
+
+	return cond->peer->bgp->rib[cond->afi][safi];
+}
+
+/* Whether rmap permits one of the paths of dest */
+static bool bgp_check_rmap_prefix_in_dest(struct bgp_dest *dest,
+					  struct route_map *rmap)
 {
 	struct attr dummy_attr = {0};
-	struct bgp_dest *dest;
 	struct bgp_path_info *pi;
 	struct bgp_path_info path = {0};
 	struct bgp_path_info_extra path_extra = {0};
 	const struct prefix *dest_p;
-	route_map_result_t ret = RMAP_DENYMATCH;
+	route_map_result_t ret;
 
-	for (dest = bgp_table_top(table); dest; dest = bgp_route_next(dest)) {
-		dest_p = bgp_dest_get_prefix(dest);
-		assert(dest_p);
+	dest_p = bgp_dest_get_prefix(dest);
+	assert(dest_p);
 
-		for (pi = bgp_dest_get_bgp_path_info(dest); pi; pi = pi->next) {
-			dummy_attr = *pi->attr;
+	for (pi = bgp_dest_get_bgp_path_info(dest); pi; pi = pi->next) {
+		if (CHECK_FLAG(pi->flags, BGP_PATH_REMOVED))
+			continue;
 
-			/* Fill temp path_info */
-			prep_for_rmap_apply(&path, &path_extra, dest, pi,
-					    pi->peer, &dummy_attr);
+		dummy_attr = *pi->attr;
 
-			RESET_FLAG(dummy_attr.rmap_change_flags);
+		/* Fill temp path_info */
+		prep_for_rmap_apply(&path, &path_extra, dest, pi, pi->peer,
+				    &dummy_attr);
 
-			ret = route_map_apply(rmap, dest_p, &path);
-			bgp_attr_flush(&dummy_attr);
+		RESET_FLAG(dummy_attr.rmap_change_flags);
 
-			if (ret == RMAP_PERMITMATCH) {
-				bgp_dest_unlock_node(dest);
-				bgp_cond_adv_debug(
-					"%s: Condition map routes present in BGP table",
-					__func__);
+		ret = route_map_apply(rmap, dest_p, &path);
+		bgp_attr_flush(&dummy_attr);
 
-				return ret;
-			}
+		if (ret == RMAP_PERMITMATCH)
+			return true;
+	}
+
+	return false;
+}
+
+/* Index the condition-map routes of the whole table */
+static void bgp_check_rmap_prefixes_in_bgp_table(struct bgp_cond_adv *cond,
+						 struct bgp_table *table,
+						 struct route_map *rmap)
+{
+	struct bgp_dest *dest;
+
+	bgp_cond_adv_dests_flush(&cond->present);
+
+	for (dest = bgp_table_top(table); dest; dest = bgp_route_next(dest))
+		if (bgp_check_rmap_prefix_in_dest(dest, rmap))
+			bgp_cond_adv_dest_add(&cond->present, dest);
+
+	cond->rebuild = false;
+
+	bgp_cond_adv_debug("%s: %zu condition map routes present in BGP table for %s",
+			   __func__, bgp_cond_adv_dests_count(&cond->present),
+			   cond->peer->host);
+}
+
+/* Run the scanner, but not more often than every condition_check_period */
+static void bgp_conditional_adv_schedule(struct bgp *bgp)
+{
+	time_t elapsed;
+
+	if (event_is_scheduled(bgp->t_condition_check))
+		return;
+
+	elapsed = monotime(NULL) - bgp->condition_check_last;
+	event_add_timer(bm->master, bgp_conditional_adv_timer, bgp,
+			elapsed < bgp->condition_check_period
+				? bgp->condition_check_period - elapsed
+				: 0,
+			&bgp->t_condition_check);
+}
+
+void bgp_conditional_adv_process(struct bgp *bgp, struct bgp_dest *dest)
+{
+	struct bgp_table *table = bgp_dest_table(dest);
+	struct bgp_filter *filter;
+	struct bgp_cond_adv *cond;
+	bool present, schedule = false;
+
+	frr_each (bgp_cond_adv_list, &bgp->cond_adv, cond) {
+		/* The whole table is looked at anyway */
+		if (cond->rebuild || bgp_cond_adv_table(cond) != table)
+			continue;
+
+		filter = &cond->peer->filter[cond->afi][cond->safi];
+		if (!filter->advmap.amap || !filter->advmap.cmap)
+			continue;
+
+		present = bgp_cond_adv_dests_count(&cond->present) != 0;
+		if (bgp_check_rmap_prefix_in_dest(dest, filter->advmap.cmap))
+			bgp_cond_adv_dest_add(&cond->present, dest);
+		else
+			bgp_cond_adv_dest_del(&cond->present, dest);
+
+		if (present != (bgp_cond_adv_dests_count(&cond->present) != 0)) {
+			bgp_cond_adv_debug("%s: %s - condition map routes %s BGP table due to %pBD",
+					   __func__, cond->peer->host,
+					   present ? "left" : "entered", dest);
+			schedule = true;
 		}
+
+		if (peer_established(cond->peer->connection) &&
+		    bgp_check_rmap_prefix_in_dest(dest, filter->advmap.amap) &&
+		    bgp_cond_adv_dest_add(&cond->changed, dest))
+			schedule = true;
 	}
 
-	bgp_cond_adv_debug("%s: Condition map routes not present in BGP table",
-			   __func__);
+	if (schedule)
+		bgp_conditional_adv_schedule(bgp);
+}
+
+/* Advertise or withdraw the advertise-map routes of dest */
+static void bgp_conditional_adv_dest(struct bgp_dest *dest, struct peer *peer,
+				     struct update_subgroup *subgrp,
+				     struct route_map *rmap,
+				     enum update_type update_type,
+				     bool addpath_capable)
+{
+	afi_t afi = SUBGRP_AFI(subgrp);
+	safi_t safi = SUBGRP_SAFI(subgrp);
+	struct bgp_path_info *pi;
+	struct bgp_path_info path;
+	const struct prefix *dest_p;
+	struct attr advmap_attr = {0}, attr = {0};
+	struct bgp_path_info_extra path_extra = {0};
+	route_map_result_t ret;
 
-	return ret;
+	dest_p = bgp_dest_get_prefix(dest);
+	assert(dest_p);
+
+	for (pi = bgp_dest_get_bgp_path_info(dest); pi; pi = pi->next) {
+		advmap_attr = *pi->attr;
+
+		/* Fill temp path_info */
+		prep_for_rmap_apply(&path, &path_extra, dest, pi, pi->peer,
+				    &advmap_attr);
+
+		RESET_FLAG(advmap_attr.rmap_change_flags);
+
+		ret = route_map_apply(rmap, dest_p, &path);
+		if (ret != RMAP_PERMITMATCH ||
+		    !bgp_check_selected(pi, peer, addpath_capable, afi, safi)) {
+			bgp_attr_flush(&advmap_attr);
+			continue;
+		}
+
+		/* Skip route-map checks in
+		 * subgroup_announce_check while executing from
+		 * the conditional advertise scanner process.
+		 * otherwise when route-map is also configured
+		 * on same peer, routes in advertise-map may not
+		 * be advertised as expected.
+		 */
+		if (update_type == UPDATE_TYPE_ADVERTISE &&
+		    subgroup_announce_check(dest, pi, subgrp, dest_p, &attr,
+					    &advmap_attr)) {
+			if (!bgp_adj_out_set_subgroup(dest, subgrp, &attr, pi))
+				bgp_attr_flush(&attr);
+		} else {
+			/* If default originate is enabled for
+			 * the peer, do not send explicit
+			 * withdraw. This will prevent deletion
+			 * of default route advertised through
+			 * default originate.
+			 */
+			if (CHECK_FLAG(peer->af_flags[afi][safi],
+				       PEER_FLAG_DEFAULT_ORIGINATE) &&
+			    is_default_prefix(dest_p))
+				break;
+
+			bgp_adj_out_unset_subgroup(
+				dest, subgrp, 1,
+				bgp_addpath_id_for_peer(peer, afi, safi,
+							&pi->tx_addpath));
+
+			bgp_attr_flush(&advmap_attr);
+		}
+	}
 }
 
-static void bgp_conditional_adv_routes(struct peer *peer, afi_t afi,
-				       safi_t safi, struct bgp_table *table,
+/* All the advertise-map routes of table, or only the changed ones if NULL */
+static void bgp_conditional_adv_routes(struct bgp_cond_adv *cond,
+				       struct bgp_table *table,
 				       struct route_map *rmap,
 				       enum update_type update_type)
 {
+	struct peer *peer = cond->peer;
+	afi_t afi = cond->afi;
+	safi_t safi = cond->safi;
 	bool addpath_capable;
 	struct bgp_dest *dest;
-	struct bgp_path_info *pi;
-	struct bgp_path_info path;
+	struct bgp_cond_adv_dest *entry;
 	struct peer_af *paf;
-	const struct prefix *dest_p;
 	struct update_subgroup *subgrp;
-	struct attr advmap_attr = {0}, attr = {0};
-	struct bgp_path_info_extra path_extra = {0};
-	route_map_result_t ret;
 
 	paf = peer_af_find(peer, afi, safi);
 	if (!paf)
@@ -83,229 +287,232 @@ static void bgp_conditional_adv_routes(struct peer *peer, afi_t afi,
 	subgrp->pscount = 0;
 	SET_FLAG(subgrp->sflags, SUBGRP_STATUS_TABLE_REPARSING);
 
-	bgp_cond_adv_debug("%s: %s routes to/from %s for %s", __func__,
+	bgp_cond_adv_debug("%s: %s %s routes to/from %s for %s", __func__,
 			   update_type == UPDATE_TYPE_ADVERTISE ? "Advertise"
 								: "Withdraw",
-			   peer->host, get_afi_safi_str(afi, safi, false));
+			   table ? "all" : "changed", peer->host,
+			   get_afi_safi_str(afi, safi, false));
 
 	addpath_capable = bgp_addpath_encode_tx(peer, afi, safi);
 
 	SET_FLAG(subgrp->sflags, SUBGRP_STATUS_FORCE_UPDATES);
-	for (dest = bgp_table_top(table); dest; dest = bgp_route_next(dest)) {
-		dest_p = bgp_dest_get_prefix(dest);
-		assert(dest_p);
-
-		for (pi = bgp_dest_get_bgp_path_info(dest); pi; pi = pi->next) {
-			advmap_attr = *pi->attr;
-
-			/* Fill temp path_info */
-			prep_for_rmap_apply(&path, &path_extra, dest, pi,
-					    pi->peer, &advmap_attr);
-
-			RESET_FLAG(advmap_attr.rmap_change_flags);
-
-			ret = route_map_apply(rmap, dest_p, &path);
-			if (ret != RMAP_PERMITMATCH ||
-			    !bgp_check_selected(pi, peer, addpath_capable, afi,
-						safi)) {
-				bgp_attr_flush(&advmap_attr);
-				continue;
-			}
-
-			/* Skip route-map checks in
-			 * subgroup_announce_check while executing from
-			 * the conditional advertise scanner process.
-			 * otherwise when route-map is also configured
-			 * on same peer, routes in advertise-map may not
-			 * be advertised as expected.
-			 */
-			if (update_type == UPDATE_TYPE_ADVERTISE &&
-			    subgroup_announce_check(dest, pi, subgrp, dest_p,
-						    &attr, &advmap_attr)) {
-				if (!bgp_adj_out_set_subgroup(dest, subgrp,
-							      &attr, pi))
-					bgp_attr_flush(&attr);
-			} else {
-				/* If default originate is enabled for
-				 * the peer, do not send explicit
-				 * withdraw. This will prevent deletion
-				 * of default route advertised through
-				 * default originate.
-				 */
-				if (CHECK_FLAG(peer->af_flags[afi][safi],
-					       PEER_FLAG_DEFAULT_ORIGINATE) &&
-				    is_default_prefix(dest_p))
-					break;
-
-				bgp_adj_out_unset_subgroup(
-					dest, subgrp, 1,
-					bgp_addpath_id_for_peer(
-						peer, afi, safi,
-						&pi->tx_addpath));
-
-				bgp_attr_flush(&advmap_attr);
-			}
-		}
+	if (table) {
+		for (dest = bgp_table_top(table); dest;
+		     dest = bgp_route_next(dest))
+			bgp_conditional_adv_dest(dest, peer, subgrp, rmap,
+						 update_type, addpath_capable);
+	} else {
+		frr_each (bgp_cond_adv_dests, &cond->changed, entry)
+			bgp_conditional_adv_dest(entry->dest, peer, subgrp,
+						 rmap, update_type,
+						 addpath_capable);
 	}
 	UNSET_FLAG(subgrp->sflags, SUBGRP_STATUS_TABLE_REPARSING);
 }
 
 /* Handler of conditional advertisement timer event.
- * Each route in the condition-map is evaluated.
+ * Only the peers whose condition or advertise-map routes changed since
+ * the last run are looked at.
  */
 static void bgp_conditional_adv_timer(struct event *t)
 {
 	afi_t afi;
 	safi_t safi;
-	int pfx_rcd_safi;
 	struct bgp *bgp = NULL;
 	struct peer *peer = NULL;
 	struct peer_af *paf = NULL;
 	struct bgp_table *table = NULL;
 	struct bgp_filter *filter = NULL;
-	struct listnode *node, *nnode = NULL;
+	struct bgp_cond_adv *cond;
 	struct update_subgroup *subgrp = NULL;
-	route_map_result_t ret;
-	bool advmap_table_changed = false;
+	enum update_type update_type;
+	bool present, config_change;
 
 	bgp = EVENT_ARG(t);
 	assert(bgp);
 
-	event_add_timer(bm->master, bgp_conditional_adv_timer, bgp,
-			bgp->condition_check_period, &bgp->t_condition_check);
-
-	/* loop through each peer and check if we have peers with
-	 * advmap_table_change attribute set, to make sure we send
-	 * conditional advertisements properly below.
-	 * peer->advmap_table_change is added on incoming BGP UPDATES,
-	 * but here it's used for outgoing UPDATES, hence we need to
-	 * check if at least one peer got advmap_table_change.
-	 */
-	for (ALL_LIST_ELEMENTS_RO(bgp->peer, node, peer)) {
-		if (peer->advmap_table_change) {
-			advmap_table_changed = true;
-			break;
-		}
-	}
+	bgp->condition_check_last = monotime(NULL);
 
 	/* loop through each peer and advertise or withdraw routes if
 	 * advertise-map is configured and prefix(es) in condition-map
 	 * does exist(exist-map)/not exist(non-exist-map) in BGP table
 	 * based on condition(exist-map or non-exist map)
 	 */
-	for (ALL_LIST_ELEMENTS(bgp->peer, node, nnode, peer)) {
-		if (!CHECK_FLAG(peer->flags, PEER_FLAG_CONFIG_NODE))
+	frr_each (bgp_cond_adv_list, &bgp->cond_adv, cond) {
+		peer = cond->peer;
+		afi = cond->afi;
+		safi = cond->safi;
+		filter = &peer->filter[afi][safi];
+		table = bgp_cond_adv_table(cond);
+
+		if (!table || !filter->advmap.aname || !filter->advmap.cname ||
+		    !filter->advmap.amap || !filter->advmap.cmap) {
+			bgp_cond_adv_dests_flush(&cond->changed);
 			continue;
+		}
 
-		if (!peer_established(peer->connection))
+		/* cmap (route-map attached to exist-map or
+		 * non-exist-map) map validation
+		 */
+		if (cond->rebuild)
+			bgp_check_rmap_prefixes_in_bgp_table(
+				cond, table, filter->advmap.cmap);
+
+		if (!CHECK_FLAG(peer->flags, PEER_FLAG_CONFIG_NODE) ||
+		    !peer_established(peer->connection) ||
+		    !peer->afc_nego[afi][safi]) {
+			bgp_cond_adv_dests_flush(&cond->changed);
 			continue;
+		}
 
-		FOREACH_AFI_SAFI (afi, safi) {
-			if (!peer->afc_nego[afi][safi])
-				continue;
+		/* Derive conditional advertisement status from
+		 * condition and whether condition-map routes are present.
+		 */
+		present = bgp_cond_adv_dests_count(&cond->present) != 0;
+		if (filter->advmap.condition == CONDITION_EXIST)
+			update_type = present ? UPDATE_TYPE_ADVERTISE
+					      : UPDATE_TYPE_WITHDRAW;
+		else
+			update_type = present ? UPDATE_TYPE_WITHDRAW
+					      : UPDATE_TYPE_ADVERTISE;
+
+		config_change = peer->advmap_config_change[afi][safi];
+		if (!config_change &&
+		    update_type == filter->advmap.update_type &&
+		    !bgp_cond_adv_dests_count(&cond->changed))
+			continue;
 
-			/* labeled-unicast routes are installed in the unicast
-			 * table so in order to display the correct PfxRcd value
-			 * we must look at SAFI_UNICAST
-			 */
-			pfx_rcd_safi = (safi == SAFI_LABELED_UNICAST)
-					       ? SAFI_UNICAST
-					       : safi;
-
-			table = bgp->rib[afi][pfx_rcd_safi];
-			if (!table)
-				continue;
-
-			filter = &peer->filter[afi][safi];
-
-			if (!filter->advmap.aname || !filter->advmap.cname
-			    || !filter->advmap.amap || !filter->advmap.cmap)
-				continue;
-
-			if (!peer->advmap_config_change[afi][safi] &&
-			    !advmap_table_changed)
-				continue;
-
-			if (BGP_DEBUG(cond_adv, COND_ADV)) {
-				if (peer->advmap_table_change)
-					zlog_debug(
-						"%s: %s - routes changed in BGP table.",
-						__func__, peer->host);
-				if (peer->advmap_config_change[afi][safi])
-					zlog_debug(
-						"%s: %s for %s - advertise/condition map configuration is changed.",
-						__func__, peer->host,
-						get_afi_safi_str(afi, safi,
-								 false));
-			}
+		if (BGP_DEBUG(cond_adv, COND_ADV)) {
+			if (update_type != filter->advmap.update_type)
+				zlog_debug("%s: %s - condition map routes %s in BGP table.",
+					   __func__, peer->host,
+					   present ? "present" : "not present");
+			if (config_change)
+				zlog_debug(
+					"%s: %s for %s - advertise/condition map configuration is changed.",
+					__func__, peer->host,
+					get_afi_safi_str(afi, safi, false));
+		}
 
-			/* cmap (route-map attached to exist-map or
-			 * non-exist-map) map validation
-			 */
-			ret = bgp_check_rmap_prefixes_in_bgp_table(
-				table, filter->advmap.cmap);
+		/* A new status is sent for the whole advertise-map */
+		if (update_type != filter->advmap.update_type)
+			config_change = true;
+		filter->advmap.update_type = update_type;
 
-			/* Derive conditional advertisement status from
-			 * condition and return value of condition-map
-			 * validation.
-			 */
-			if (filter->advmap.condition == CONDITION_EXIST)
-				filter->advmap.update_type =
-					(ret == RMAP_PERMITMATCH)
-						? UPDATE_TYPE_ADVERTISE
-						: UPDATE_TYPE_WITHDRAW;
-			else
-				filter->advmap.update_type =
-					(ret == RMAP_PERMITMATCH)
-						? UPDATE_TYPE_WITHDRAW
-						: UPDATE_TYPE_ADVERTISE;
-
-			/*
-			 * Update condadv update type so
-			 * subgroup_announce_check() can properly apply
-			 * outbound policy according to advertisement state
-			 */
-			paf = peer_af_find(peer, afi, safi);
-			if (paf && (SUBGRP_PEER(PAF_SUBGRP(paf))
-					    ->filter[afi][safi]
-					    .advmap.update_type !=
-				    filter->advmap.update_type)) {
-				/* Handle change to peer advmap */
-				bgp_cond_adv_debug(
-					"%s: advmap.update_type changed for peer %s, adjusting update_group.",
-					__func__, peer->host);
-
-				update_group_adjust_peer(paf);
+		/*
+		 * Update condadv update type so
+		 * subgroup_announce_check() can properly apply
+		 * outbound policy according to advertisement state
+		 */
+		paf = peer_af_find(peer, afi, safi);
+		if (paf && (SUBGRP_PEER(PAF_SUBGRP(paf))
+				    ->filter[afi][safi]
+				    .advmap.update_type !=
+			    filter->advmap.update_type)) {
+			/* Handle change to peer advmap */
+			bgp_cond_adv_debug(
+				"%s: advmap.update_type changed for peer %s, adjusting update_group.",
+				__func__, peer->host);
+
+			update_group_adjust_peer(paf);
+		}
+
+		/* Send regular update as per the existing policy.
+		 * There is a change in route-map, match-rule, ACLs,
+		 * or route-map filter configuration on the same peer.
+		 */
+		if (peer->advmap_config_change[afi][safi]) {
+
+			bgp_cond_adv_debug(
+				"%s: Configuration is changed on peer %s for %s, send the normal update first.",
+				__func__, peer->host,
+				get_afi_safi_str(afi, safi, false));
+			if (paf) {
+				update_subgroup_split_peer(paf, NULL);
+				subgrp = paf->subgroup;
+
+				if (subgrp && subgrp->update_group)
+					subgroup_announce_table(paf->subgroup,
+								NULL);
 			}
+			peer->advmap_config_change[afi][safi] = false;
+		}
 
-			/* Send regular update as per the existing policy.
-			 * There is a change in route-map, match-rule, ACLs,
-			 * or route-map filter configuration on the same peer.
-			 */
-			if (peer->advmap_config_change[afi][safi]) {
+		/* Send update as per the conditional advertisement */
+		bgp_conditional_adv_routes(cond, config_change ? table : NULL,
+					   filter->advmap.amap,
+					   filter->advmap.update_type);
+		bgp_cond_adv_dests_flush(&cond->changed);
+	}
+}
 
-				bgp_cond_adv_debug(
-					"%s: Configuration is changed on peer %s for %s, send the normal update first.",
-					__func__, peer->host,
-					get_afi_safi_str(afi, safi, false));
-				if (paf) {
-					update_subgroup_split_peer(paf, NULL);
-					subgrp = paf->subgroup;
-
-					if (subgrp && subgrp->update_group)
-						subgroup_announce_table(
-							paf->subgroup, NULL);
-				}
-				peer->advmap_config_change[afi][safi] = false;
-			}
+static void bgp_cond_adv_free(struct bgp *bgp, struct bgp_filter *filter)
+{
+	struct bgp_cond_adv *cond = filter->advmap.cond;
 
-			/* Send update as per the conditional advertisement */
-			bgp_conditional_adv_routes(peer, afi, safi, table,
-						   filter->advmap.amap,
-						   filter->advmap.update_type);
-		}
-		peer->advmap_table_change = false;
+	if (!cond)
+		return;
+
+	bgp_cond_adv_list_del(&bgp->cond_adv, cond);
+	bgp_cond_adv_dests_flush(&cond->present);
+	bgp_cond_adv_dests_fini(&cond->present);
+	bgp_cond_adv_dests_flush(&cond->changed);
+	bgp_cond_adv_dests_fini(&cond->changed);
+	XFREE(MTYPE_BGP_COND_ADV, cond);
+	filter->advmap.cond = NULL;
+}
+
+void bgp_conditional_adv_config_change(struct peer *peer, afi_t afi,
+				       safi_t safi)
+{
+	struct bgp_cond_adv *cond = peer->filter[afi][safi].advmap.cond;
+
+	peer->advmap_config_change[afi][safi] = true;
+
+	if (!cond)
+		return;
+
+	/* The condition-map may be another one, or have other rules */
+	cond->rebuild = true;
+	bgp_conditional_adv_schedule(peer->bgp);
+}
+
+void bgp_conditional_adv_peer_update(struct peer *peer, afi_t afi,
+				     safi_t safi)
+{
+	struct bgp_filter *filter = &peer->filter[afi][safi];
+	struct bgp_cond_adv *cond;
+
+	/* Peer-groups only hold the configuration of their members */
+	if (CHECK_FLAG(peer->sflags, PEER_STATUS_GROUP))
+		return;
+
+	if (!filter->advmap.aname) {
+		bgp_cond_adv_free(peer->bgp, filter);
+		return;
 	}
+
+	if (!filter->advmap.cond) {
+		cond = XCALLOC(MTYPE_BGP_COND_ADV, sizeof(*cond));
+		cond->peer = peer;
+		cond->afi = afi;
+		cond->safi = safi;
+		bgp_cond_adv_dests_init(&cond->present);
+		bgp_cond_adv_dests_init(&cond->changed);
+		bgp_cond_adv_list_add_tail(&peer->bgp->cond_adv, cond);
+		filter->advmap.cond = cond;
+	}
+
+	bgp_conditional_adv_config_change(peer, afi, safi);
+}
+
+void bgp_conditional_adv_peer_delete(struct peer *peer)
+{
+	afi_t afi;
+	safi_t safi;
+
+	FOREACH_AFI_SAFI (afi, safi)
+		bgp_cond_adv_free(peer->bgp, &peer->filter[afi][safi]);
 }
 
 void bgp_conditional_adv_enable(struct peer *peer, afi_t afi, safi_t safi)
@@ -330,10 +537,8 @@ void bgp_conditional_adv_enable(struct peer *peer, afi_t afi, safi_t safi)
 		return;
 	}
 
-	/* Register for conditional routes polling timer */
-	if (!event_is_scheduled(bgp->t_condition_check))
-		event_add_timer(bm->master, bgp_conditional_adv_timer, bgp, 0,
-				&bgp->t_condition_check);
+	/* Run the scanner for the first condition */
+	bgp_conditional_adv_schedule(bgp);
 }
 
 void bgp_conditional_adv_disable(struct peer *peer, afi_t afi, safi_t safi)
@@ -353,7 +558,7 @@ void bgp_conditional_adv_disable(struct peer *peer, afi_t afi, safi_t safi)
 		return;
 	}
 
-	/* Last filter removed. So cancel conditional routes polling thread. */
+	/* Last filter removed. So cancel the pending scanner run. */
 	EVENT_OFF(bgp->t_condition_check);
 }
 
@@ -380,6 +585,7 @@ static void peer_advertise_map_filter_update(struct peer *peer, afi_t afi,
 
 	/* Removed advertise-map configuration */
 	if (!set) {
+		bgp_conditional_adv_peer_update(peer, afi, safi);
 		memset(&filter->advmap, 0, sizeof(filter->advmap));
 
 		/* decrement condition_filter_count delete timer if
@@ -401,7 +607,7 @@ static void peer_advertise_map_filter_update(struct peer *peer, afi_t afi,
 	filter->advmap.cmap = cmap;
 	filter->advmap.condition = condition;
 	route_map_counter_increment(filter->advmap.amap);
-	peer->advmap_config_change[afi][safi] = true;
+	bgp_conditional_adv_peer_update(peer, afi, safi);
 
 	/* Increment condition_filter_count and/or create timer. */
 	if (!filter_exists) {
@@ -480,6 +686,7 @@ int peer_advertise_map_unset(struct peer *peer, afi_t afi, safi_t safi,
 				      MTYPE_BGP_FILTER_NAME);
 		PEER_ATTR_INHERIT(peer, peer->group,
 				  filter[afi][safi].advmap.amap);
+		bgp_conditional_adv_peer_update(peer, afi, safi);
 	} else
 		peer_advertise_map_filter_update(
 			peer, afi, safi, advertise_name, advertise_map,
@@ -27,9 +27,52 @@ extern "C" {
 			zlog_debug("" __VA_ARGS__);                            \
 	} while (0)
 
-/* Polling time for monitoring condition-map routes in route table */
+/* Shortest time between two runs of the conditional advertisement scanner */
 #define DEFAULT_CONDITIONAL_ROUTES_POLL_TIME 60
 
+PREDECL_HASH(bgp_cond_adv_dests);
+
+struct bgp_cond_adv_dest {
+	struct bgp_cond_adv_dests_item item;
+	struct bgp_dest *dest;
+};
+
+/*
+ * Advertise-map state of a peer AFI/SAFI. It is kept up to date as the
+ * routes of the table are processed, so the scanner only runs when the
+ * condition changes or routes of the advertise-map do.
+ */
+struct bgp_cond_adv {
+	struct bgp_cond_adv_list_item item;
+
+	struct peer *peer;
+	afi_t afi;
+	safi_t safi;
+
+	/* Dests with a path the condition-map permits */
+	struct bgp_cond_adv_dests_head present;
+	/* Dests with a path the advertise-map permits, changed since the
+	 * scanner last ran
+	 */
+	struct bgp_cond_adv_dests_head changed;
+
+	/* The condition-map changed, present is to be rebuilt */
+	bool rebuild;
+};
+
+DECLARE_DLIST(bgp_cond_adv_list, struct bgp_cond_adv, item);
+
+/* A route of dest has been added, changed or removed */
+extern void bgp_conditional_adv_process(struct bgp *bgp,
+					struct bgp_dest *dest);
+/* The advertise-map configuration or its route-maps changed */
+extern void bgp_conditional_adv_config_change(struct peer *peer, afi_t afi,
+					      safi_t safi);
+/* Create or free the condition index after the filter of peer changed */
+extern void bgp_conditional_adv_peer_update(struct peer *peer, afi_t afi,
+					    safi_t safi);
+extern void bgp_conditional_adv_peer_delete(struct peer *peer);
+
 extern void bgp_conditional_adv_enable(struct peer *peer, afi_t afi,
 				       safi_t safi);
 extern void bgp_conditional_adv_disable(struct peer *peer, afi_t afi,
@@ -25,15 +25,12 @@
 /* Global variable to access damping configuration */
 static struct bgp_damp_config damp[AFI_MAX][SAFI_MAX];
 
-/* Utility macro to add and delete BGP dampening information to no
-   used list.  */
-#define BGP_DAMP_LIST_ADD(N, A) BGP_PATH_INFO_ADD(N, A, no_reuse_list)
-#define BGP_DAMP_LIST_DEL(N, A) BGP_PATH_INFO_DEL(N, A, no_reuse_list)
+static void bgp_reuse_timer(struct event *t);
 
 /* Calculate reuse list index by penalty value.  */
-static int bgp_reuse_index(int penalty, struct bgp_damp_config *bdc)
+static int bgp_reuse_index(unsigned int penalty, struct bgp_damp_config *bdc)
 {
-	unsigned int i;
+	unsigned int i = 0;
 	int index;
 
 	/*
@@ -42,8 +39,9 @@ static int bgp_reuse_index(int penalty, struct bgp_damp_config *bdc)
 	 */
 	assert(bdc->reuse_limit);
 
-	i = (int)(((double)penalty / bdc->reuse_limit - 1.0)
-		  * bdc->scale_factor);
+	if (penalty > bdc->reuse_limit)
+		i = (int)(((double)penalty / bdc->reuse_limit - 1.0)
+			  * bdc->scale_factor);
 
 	if (i >= bdc->reuse_index_size)
 		i = bdc->reuse_index_size - 1;
@@ -53,31 +51,49 @@ static int bgp_reuse_index(int penalty, struct bgp_damp_config *bdc)
 	return (bdc->reuse_offset + index) % bdc->reuse_list_size;
 }
 
-/* Add BGP dampening information to reuse list.  */
+/*
+ * Add BGP dampening information to the reuse list of when it is next due:
+ * a suppressed route when its penalty is below the reuse limit, any other
+ * when it is below half of it and can be forgotten. The reuse timer then
+ * only ever looks at what is due, and only runs while there is any.
+ */
 static void bgp_reuse_list_add(struct bgp_damp_info *bdi,
 			       struct bgp_damp_config *bdc)
 {
+	unsigned int penalty = bdi->penalty;
 	int index;
 
-	index = bdi->index = bgp_reuse_index(bdi->penalty, bdc);
+	/* Halving the reuse limit takes as long as doubling the penalty */
+	if (!CHECK_FLAG(bdi->path->flags, BGP_PATH_DAMPED))
+		penalty *= 2;
+	index = bdi->index = bgp_reuse_index(penalty, bdc);
 
 	bdi->prev = NULL;
 	bdi->next = bdc->reuse_list[index];
 	if (bdc->reuse_list[index])
 		bdc->reuse_list[index]->prev = bdi;
 	bdc->reuse_list[index] = bdi;
+
+	if (!bdc->reuse_count++)
+		event_add_timer(bm->master, bgp_reuse_timer, bdc, DELTA_REUSE,
+				&bdc->t_reuse);
 }
 
 /* Delete BGP dampening information from reuse list.  */
 static void bgp_reuse_list_delete(struct bgp_damp_info *bdi,
 				  struct bgp_damp_config *bdc)
 {
+	if (bdi->index < 0)
+		return;
+
 	if (bdi->next)
 		bdi->next->prev = bdi->prev;
 	if (bdi->prev)
 		bdi->prev->next = bdi->next;
 	else
 		bdc->reuse_list[bdi->index] = bdi->next;
+	bdi->index = -1;
+	bdc->reuse_count--;
 }
 
 /* Return decayed penalty value.  */
@@ -106,10 +122,6 @@ static void bgp_reuse_timer(struct event *t)
 
 	struct bgp_damp_config *bdc = EVENT_ARG(t);
 
-	bdc->t_reuse = NULL;
-	event_add_timer(bm->master, bgp_reuse_timer, bdc, DELTA_REUSE,
-			&bdc->t_reuse);
-
 	t_now = monotime(NULL);
 
 	/* 1.  save a pointer to the current zeroth queue head and zero the
@@ -123,9 +135,12 @@ static void bgp_reuse_timer(struct event *t)
 
 	/* 3. if ( the saved list head pointer is non-empty ) */
 	for (; bdi; bdi = next) {
+		struct bgp_dest *dest = bdi->path->net;
 		struct bgp *bgp = bdi->path->peer->bgp;
 
 		next = bdi->next;
+		bdi->index = -1;
+		bdc->reuse_count--;
 
 		/* Set t-diff = t-now - t-updated.  */
 		t_diff = t_now - bdi->t_updated;
@@ -137,32 +152,39 @@ static void bgp_reuse_timer(struct event *t)
 		/* Set t-updated = t-now.  */
 		bdi->t_updated = t_now;
 
-		/* if (figure-of-merit < reuse).  */
-		if (bdi->penalty < bdc->reuse_limit) {
+		if (!CHECK_FLAG(bdi->path->flags, BGP_PATH_DAMPED)) {
+			/* Not suppressed, forget about it once stable */
+			if (bdi->penalty <= bdc->reuse_limit / 2.0)
+				bgp_damp_info_free(bdi, 1, bdc->afi, bdc->safi);
+			else
+				bgp_reuse_list_add(bdi, bdc);
+		} else if (bdi->penalty < bdc->reuse_limit) {
 			/* Reuse the route.  */
-			bgp_path_info_unset_flag(bdi->dest, bdi->path,
+			bgp_path_info_unset_flag(dest, bdi->path,
 						 BGP_PATH_DAMPED);
-			bdi->suppress_time = 0;
 
 			if (bdi->lastrecord == BGP_RECORD_UPDATE) {
-				bgp_path_info_unset_flag(bdi->dest, bdi->path,
+				bgp_path_info_unset_flag(dest, bdi->path,
 							 BGP_PATH_HISTORY);
 				bgp_aggregate_increment(
-					bgp, bgp_dest_get_prefix(bdi->dest),
-					bdi->path, bdi->afi, bdi->safi);
-				bgp_process(bgp, bdi->dest, bdi->afi,
-					    bdi->safi);
+					bgp, bgp_dest_get_prefix(dest),
+					bdi->path, bdc->afi, bdc->safi);
+				bgp_process(bgp, dest, bdc->afi, bdc->safi);
 			}
 
 			if (bdi->penalty <= bdc->reuse_limit / 2.0)
 				bgp_damp_info_free(bdi, 1, bdc->afi, bdc->safi);
 			else
-				BGP_DAMP_LIST_ADD(bdc, bdi);
+				bgp_reuse_list_add(bdi, bdc);
 		} else
 			/* Re-insert into another list (See RFC2439 Section
 			 * 4.8.6).  */
 			bgp_reuse_list_add(bdi, bdc);
 	}
+
+	if (bdc->reuse_count)
+		event_add_timer(bm->master, bgp_reuse_timer, bdc, DELTA_REUSE,
+				&bdc->t_reuse);
 }
 
 /* A route becomes unreachable (RFC2439 Section 4.8.2).  */
@@ -171,7 +193,7 @@ int bgp_damp_withdraw(struct bgp_path_info *path, struct bgp_dest *dest,
 {
 	time_t t_now;
 	struct bgp_damp_info *bdi = NULL;
-	unsigned int last_penalty = 0;
+	bool suppressed;
 	struct bgp_damp_config *bdc = &damp[afi][safi];
 
 	t_now = monotime(NULL);
@@ -191,20 +213,13 @@ int bgp_damp_withdraw(struct bgp_path_info *path, struct bgp_dest *dest,
 		bdi = XCALLOC(MTYPE_BGP_DAMP_INFO,
 			      sizeof(struct bgp_damp_info));
 		bdi->path = path;
-		bdi->dest = dest;
 		bdi->penalty =
 			(attr_change ? DEFAULT_PENALTY / 2 : DEFAULT_PENALTY);
 		bdi->flap = 1;
 		bdi->start_time = t_now;
-		bdi->suppress_time = 0;
 		bdi->index = -1;
-		bdi->afi = afi;
-		bdi->safi = safi;
 		(bgp_path_info_extra_get(path))->damp_info = bdi;
-		BGP_DAMP_LIST_ADD(bdc, bdi);
 	} else {
-		last_penalty = bdi->penalty;
-
 		/* 1. Set t-diff = t-now - t-updated.  */
 		bdi->penalty = (bgp_damp_decay(t_now - bdi->t_updated,
 					       bdi->penalty, bdc)
@@ -217,7 +232,7 @@ int bgp_damp_withdraw(struct bgp_path_info *path, struct bgp_dest *dest,
 		bdi->flap++;
 	}
 
-	assert((dest == bdi->dest) && (path == bdi->path));
+	assert((dest == path->net) && (path == bdi->path));
 
 	bdi->lastrecord = BGP_RECORD_WITHDRAW;
 	bdi->t_updated = t_now;
@@ -225,26 +240,16 @@ int bgp_damp_withdraw(struct bgp_path_info *path, struct bgp_dest *dest,
 	/* Make this route as historical status.  */
 	bgp_path_info_set_flag(dest, path, BGP_PATH_HISTORY);
 
-	/* Remove the route from a reuse list if it is on one.  */
-	if (CHECK_FLAG(bdi->path->flags, BGP_PATH_DAMPED)) {
-		/* If decay rate isn't equal to 0, reinsert brn. */
-		if (bdi->penalty != last_penalty && bdi->index >= 0) {
-			bgp_reuse_list_delete(bdi, bdc);
-			bgp_reuse_list_add(bdi, bdc);
-		}
-		return BGP_DAMP_SUPPRESSED;
-	}
-
-	/* If not suppressed before, do annonunce this withdraw and
-	   insert into reuse_list.  */
-	if (bdi->penalty >= bdc->suppress_value) {
+	/* If not suppressed before, do annonunce this withdraw.  */
+	suppressed = CHECK_FLAG(path->flags, BGP_PATH_DAMPED);
+	if (!suppressed && bdi->penalty >= bdc->suppress_value)
 		bgp_path_info_set_flag(dest, path, BGP_PATH_DAMPED);
-		bdi->suppress_time = t_now;
-		BGP_DAMP_LIST_DEL(bdc, bdi);
-		bgp_reuse_list_add(bdi, bdc);
-	}
 
-	return BGP_DAMP_USED;
+	/* The penalty moved, and so did when it is due.  */
+	bgp_reuse_list_delete(bdi, bdc);
+	bgp_reuse_list_add(bdi, bdc);
+
+	return suppressed ? BGP_DAMP_SUPPRESSED : BGP_DAMP_USED;
 }
 
 int bgp_damp_update(struct bgp_path_info *path, struct bgp_dest *dest,
@@ -272,15 +277,15 @@ int bgp_damp_update(struct bgp_path_info *path, struct bgp_dest *dest,
 		 && (bdi->penalty < bdc->reuse_limit)) {
 		bgp_path_info_unset_flag(dest, path, BGP_PATH_DAMPED);
 		bgp_reuse_list_delete(bdi, bdc);
-		BGP_DAMP_LIST_ADD(bdc, bdi);
-		bdi->suppress_time = 0;
 		status = BGP_DAMP_USED;
 	} else
 		status = BGP_DAMP_SUPPRESSED;
 
-	if (bdi->penalty > bdc->reuse_limit / 2.0)
+	if (bdi->penalty > bdc->reuse_limit / 2.0) {
 		bdi->t_updated = t_now;
-	else
+		if (bdi->index < 0)
+			bgp_reuse_list_add(bdi, bdc);
+	} else
 		bgp_damp_info_free(bdi, 0, afi, safi);
 
 	return status;
@@ -298,16 +303,13 @@ void bgp_damp_info_free(struct bgp_damp_info *bdi, int withdraw, afi_t afi,
 	path = bdi->path;
 	path->extra->damp_info = NULL;
 
-	if (CHECK_FLAG(path->flags, BGP_PATH_DAMPED))
-		bgp_reuse_list_delete(bdi, bdc);
-	else
-		BGP_DAMP_LIST_DEL(bdc, bdi);
+	bgp_reuse_list_delete(bdi, bdc);
 
-	bgp_path_info_unset_flag(bdi->dest, path,
+	bgp_path_info_unset_flag(path->net, path,
 				 BGP_PATH_HISTORY | BGP_PATH_DAMPED);
 
 	if (bdi->lastrecord == BGP_RECORD_WITHDRAW && withdraw)
-		bgp_path_info_delete(bdi->dest, path);
+		bgp_path_info_delete(path->net, path);
 
 	XFREE(MTYPE_BGP_DAMP_INFO, bdi);
 }
@@ -392,12 +394,10 @@ int bgp_damp_enable(struct bgp *bgp, afi_t afi, safi_t safi, time_t half,
 	}
 
 	SET_FLAG(bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING);
+	bdc->afi = afi;
+	bdc->safi = safi;
 	bgp_damp_parameter_set(half, reuse, suppress, max, bdc);
 
-	/* Register reuse timer.  */
-	event_add_timer(bm->master, bgp_reuse_timer, bdc, DELTA_REUSE,
-			&bdc->t_reuse);
-
 	return 0;
 }
 
@@ -435,12 +435,7 @@ void bgp_damp_info_clean(afi_t afi, safi_t safi)
 		}
 		bdc->reuse_list[i] = NULL;
 	}
-
-	for (bdi = bdc->no_reuse_list; bdi; bdi = next) {
-		next = bdi->next;
-		bgp_damp_info_free(bdi, 1, afi, safi);
-	}
-	bdc->no_reuse_list = NULL;
+	bdc->reuse_count = 0;
 }
 
 int bgp_damp_disable(struct bgp *bgp, afi_t afi, safi_t safi)
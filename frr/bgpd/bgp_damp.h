@@ -10,42 +10,31 @@
 
 /* Structure maintained on a per-route basis. */
 struct bgp_damp_info {
-	/* Doubly linked list.  This information must be linked to
-	   reuse_list or no_reuse_list.  */
+	/* Doubly linked list.  This information is linked to the reuse_list
+	   of when it is next due, see bgp_reuse_list_add().  */
 	struct bgp_damp_info *next;
 	struct bgp_damp_info *prev;
 
+	/* Back reference to bgp_path_info, in the dest path->net. */
+	struct bgp_path_info *path;
+
 	/* Figure-of-merit.  */
-	unsigned int penalty;
+	uint32_t penalty;
 
 	/* Number of flapping.  */
-	unsigned int flap;
-
-	/* First flap time  */
-	time_t start_time;
+	uint32_t flap;
 
-	/* Last time penalty was updated.  */
-	time_t t_updated;
-
-	/* Time of route start to be suppressed.  */
-	time_t suppress_time;
-
-	/* Back reference to bgp_path_info. */
-	struct bgp_path_info *path;
+	/* First flap time, and last time penalty was updated, monotime.  */
+	uint32_t start_time;
+	uint32_t t_updated;
 
-	/* Back reference to bgp_node. */
-	struct bgp_dest *dest;
-
-	/* Current index in the reuse_list. */
-	int index;
+	/* Current index in the reuse_list, -1 when on none. */
+	int16_t index;
 
 	/* Last time message type. */
 	uint8_t lastrecord;
 #define BGP_RECORD_UPDATE	1U
 #define BGP_RECORD_WITHDRAW	2U
-
-	afi_t afi;
-	safi_t safi;
 };
 
 /* Specified parameter set configuration. */
@@ -84,14 +73,12 @@ struct bgp_damp_config {
 	/* Reuse index array per-set based. */
 	int *reuse_index;
 
-	/* Reuse list array per-set based. */
+	/* Reuse list array per-set based, holding all dampening information. */
 	struct bgp_damp_info **reuse_list;
 	int reuse_offset;
+	unsigned int reuse_count;
 
-	/* All dampening information which is not on reuse list.  */
-	struct bgp_damp_info *no_reuse_list;
-
-	/* Reuse timer thread per-set base. */
+	/* Reuse timer thread per-set base, running while reuse_count. */
 	struct event *t_reuse;
 
 	afi_t afi;
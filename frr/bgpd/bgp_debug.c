@@ -57,6 +57,7 @@ unsigned long conf_bgp_debug_graceful_restart;
 unsigned long conf_bgp_debug_evpn_mh;
 unsigned long conf_bgp_debug_bfd;
 unsigned long conf_bgp_debug_cond_adv;
+unsigned long conf_bgp_debug_twamp;
 
 unsigned long term_bgp_debug_as4;
 unsigned long term_bgp_debug_neighbor_events;
@@ -78,6 +79,7 @@ unsigned long term_bgp_debug_graceful_restart;
 unsigned long term_bgp_debug_evpn_mh;
 unsigned long term_bgp_debug_bfd;
 unsigned long term_bgp_debug_cond_adv;
+unsigned long term_bgp_debug_twamp;
 
 struct list *bgp_debug_neighbor_events_peers = NULL;
 struct list *bgp_debug_keepalive_peers = NULL;
@@ -2063,6 +2065,31 @@ DEFPY (debug_bgp_cond_adv,
 	return CMD_SUCCESS;
 }
 
+DEFPY (debug_bgp_twamp,
+       debug_bgp_twamp_cmd,
+       "[no$no] debug bgp twamp",
+       NO_STR
+       DEBUG_STR
+       BGP_STR
+       "BGP TWAMP latency measurements\n")
+{
+	if (vty->node == CONFIG_NODE) {
+		if (no)
+			DEBUG_OFF(twamp, TWAMP);
+		else
+			DEBUG_ON(twamp, TWAMP);
+	} else {
+		if (no) {
+			TERM_DEBUG_OFF(twamp, TWAMP);
+			vty_out(vty, "BGP TWAMP debugging is off\n");
+		} else {
+			TERM_DEBUG_ON(twamp, TWAMP);
+			vty_out(vty, "BGP TWAMP debugging is on\n");
+		}
+	}
+	return CMD_SUCCESS;
+}
+
 DEFUN (no_debug_bgp,
        no_debug_bgp_cmd,
        "no debug bgp",
@@ -2108,6 +2135,7 @@ DEFUN (no_debug_bgp,
 	TERM_DEBUG_OFF(evpn_mh, EVPN_MH_RT);
 	TERM_DEBUG_OFF(bfd, BFD_LIB);
 	TERM_DEBUG_OFF(cond_adv, COND_ADV);
+	TERM_DEBUG_OFF(twamp, TWAMP);
 
 	vty_out(vty, "All possible debugging has been turned off\n");
 
@@ -2204,6 +2232,9 @@ DEFUN_NOSH (show_debugging_bgp,
 		vty_out(vty,
 			"  BGP conditional advertisement debugging is on\n");
 
+	if (BGP_DEBUG(twamp, TWAMP))
+		vty_out(vty, "  BGP TWAMP debugging is on\n");
+
 	cmd_show_lib_debugs(vty);
 
 	return CMD_SUCCESS;
@@ -2340,6 +2371,11 @@ static int bgp_config_write_debug(struct vty *vty)
 		write++;
 	}
 
+	if (CONF_BGP_DEBUG(twamp, TWAMP)) {
+		vty_out(vty, "debug bgp twamp\n");
+		write++;
+	}
+
 	return write;
 }
 
@@ -2472,6 +2508,10 @@ void bgp_debug_init(void)
 	/* debug bgp conditional advertisement */
 	install_element(ENABLE_NODE, &debug_bgp_cond_adv_cmd);
 	install_element(CONFIG_NODE, &debug_bgp_cond_adv_cmd);
+
+	/* debug bgp twamp */
+	install_element(ENABLE_NODE, &debug_bgp_twamp_cmd);
+	install_element(CONFIG_NODE, &debug_bgp_twamp_cmd);
 }
 
 /* Return true if this prefix is on the per_prefix_list of prefixes to debug
@@ -15,6 +15,11 @@
 #include "queue.h"
 #include "memory.h"
 #include "filter.h"
+#include "frr_pthread.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 #include "bgpd/bgp_table.h"
 #include "bgpd/bgpd.h"
@@ -87,6 +92,42 @@ struct bgp_dump bgp_dump_updates;
 /* BGP dump structure for 'dump bgp routes' */
 struct bgp_dump bgp_dump_routes;
 
+/*
+ * Route dumps are serialized on the main pthread a slice of the table at
+ * a time, so each prefix is as it was when it got its turn, and written
+ * (compressed for a file name ending in .gz) by a writer pthread.
+ */
+
+/* Records queued for the writer before the walk waits for it */
+#define BGP_DUMP_ROUTES_QUEUE_MAX 4096
+/* How long the walk waits for the writer, in milliseconds */
+#define BGP_DUMP_ROUTES_WAIT 10
+
+static struct {
+	struct frr_pthread *fpt;
+	struct event *t_write;
+	struct stream_fifo fifo;
+
+	/* Set from the first record on until the writer closed the file */
+	_Atomic bool busy;
+	/* The last record is queued */
+	_Atomic bool queued_all;
+
+	/* Owned by the writer while busy */
+	FILE *fp;
+#ifdef HAVE_ZLIB
+	gzFile gz;
+#endif
+
+	/* The walk, on the main pthread */
+	struct event *t_walk;
+	struct bgp_table *table[AFI_MAX];
+	afi_t afi;
+	/* Next to serialize, locked */
+	struct bgp_dest *dest;
+	unsigned int seq;
+} dump_rt;
+
 static FILE *bgp_dump_open_file(struct bgp_dump *bgp_dump)
 {
 	int ret;
@@ -204,6 +245,45 @@ static void bgp_dump_set_size(struct stream *s, int type)
 	stream_putl_at(s, 8, stream_get_endp(s) - BGP_DUMP_HEADER_SIZE);
 }
 
+/* Writer pthread: write what is queued, close the file after the last */
+static void bgp_dump_routes_write(struct event *t)
+{
+	bool queued_all = atomic_load_explicit(&dump_rt.queued_all,
+					       memory_order_acquire);
+	struct stream *s;
+
+	while ((s = stream_fifo_pop_safe(&dump_rt.fifo))) {
+#ifdef HAVE_ZLIB
+		if (dump_rt.gz)
+			gzwrite(dump_rt.gz, STREAM_DATA(s), stream_get_endp(s));
+		else
+#endif
+			fwrite(STREAM_DATA(s), stream_get_endp(s), 1,
+			       dump_rt.fp);
+		stream_free(s);
+	}
+
+	if (!queued_all)
+		return;
+
+#ifdef HAVE_ZLIB
+	if (dump_rt.gz) {
+		gzclose(dump_rt.gz);
+		dump_rt.gz = NULL;
+	}
+#endif
+	fclose(dump_rt.fp);
+	dump_rt.fp = NULL;
+	atomic_store_explicit(&dump_rt.busy, false, memory_order_release);
+}
+
+static void bgp_dump_routes_queue(struct stream *obuf)
+{
+	stream_fifo_push_safe(&dump_rt.fifo, stream_dup(obuf));
+	event_add_event(dump_rt.fpt->master, bgp_dump_routes_write, NULL, 0,
+			&dump_rt.t_write);
+}
+
 static void bgp_dump_routes_index_table(struct bgp *bgp)
 {
 	struct peer *peer;
@@ -286,9 +366,7 @@ static void bgp_dump_routes_index_table(struct bgp *bgp)
 	}
 
 	bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
-
-	fwrite(STREAM_DATA(obuf), stream_get_endp(obuf), 1, bgp_dump_routes.fp);
-	fflush(bgp_dump_routes.fp);
+	bgp_dump_routes_queue(obuf);
 }
 
 static struct bgp_path_info *
@@ -387,49 +465,124 @@ bgp_dump_route_node_record(int afi, struct bgp_dest *dest,
 	stream_putw_at(obuf, sizep, entry_count);
 
 	bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
-	fwrite(STREAM_DATA(obuf), stream_get_endp(obuf), 1, bgp_dump_routes.fp);
+	bgp_dump_routes_queue(obuf);
 
 	return path;
 }
 
 
-/* Runs under child process. */
-static unsigned int bgp_dump_routes_func(int afi, int first_run,
-					 unsigned int seq)
+/* The walk is over, or given up: let the writer close the file */
+static void bgp_dump_routes_done(void)
 {
-	struct bgp_path_info *path;
-	struct bgp_dest *dest;
-	struct bgp *bgp;
-	struct bgp_table *table;
-
-	bgp = bgp_get_default();
-	if (!bgp)
-		return seq;
+	afi_t afi;
+
+	EVENT_OFF(dump_rt.t_walk);
+	if (dump_rt.dest)
+		bgp_dest_unlock_node(dump_rt.dest);
+	dump_rt.dest = NULL;
+	for (afi = AFI_IP; afi < AFI_MAX; afi++) {
+		if (dump_rt.table[afi])
+			bgp_table_unlock(dump_rt.table[afi]);
+		dump_rt.table[afi] = NULL;
+	}
 
-	if (bgp_dump_routes.fp == NULL)
-		return seq;
+	atomic_store_explicit(&dump_rt.queued_all, true, memory_order_release);
+	event_add_event(dump_rt.fpt->master, bgp_dump_routes_write, NULL, 0,
+			&dump_rt.t_write);
+}
 
-	/* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers,
-	   so this should only be done on the first call to
-	   bgp_dump_routes_func.
-	   ( this function will be called once for ipv4 and once for ipv6 ) */
-	if (first_run)
-		bgp_dump_routes_index_table(bgp);
+static void bgp_dump_routes_walk(struct event *t)
+{
+	struct bgp_path_info *path;
+	struct bgp_dest *dest = dump_rt.dest;
+
+	for (;;) {
+		if (!dest) {
+			if (dump_rt.afi == AFI_IP6) {
+				bgp_dump_routes_done();
+				return;
+			}
+			dump_rt.afi = AFI_IP6;
+			dest = bgp_table_top(dump_rt.table[AFI_IP6]);
+			continue;
+		}
 
-	/* Walk down each BGP route. */
-	table = bgp->rib[afi][SAFI_UNICAST];
+		if (stream_fifo_count_safe(&dump_rt.fifo) >=
+		    BGP_DUMP_ROUTES_QUEUE_MAX) {
+			dump_rt.dest = dest;
+			event_add_timer_msec(bm->master, bgp_dump_routes_walk,
+					     NULL, BGP_DUMP_ROUTES_WAIT,
+					     &dump_rt.t_walk);
+			return;
+		}
 
-	for (dest = bgp_table_top(table); dest; dest = bgp_route_next(dest)) {
 		path = bgp_dest_get_bgp_path_info(dest);
 		while (path) {
-			path = bgp_dump_route_node_record(afi, dest, path, seq);
-			seq++;
+			path = bgp_dump_route_node_record(dump_rt.afi, dest,
+							  path, dump_rt.seq);
+			dump_rt.seq++;
+		}
+		dest = bgp_route_next(dest);
+
+		if (dest && event_should_yield(t)) {
+			dump_rt.dest = dest;
+			event_add_event(bm->master, bgp_dump_routes_walk, NULL,
+					0, &dump_rt.t_walk);
+			return;
 		}
 	}
+}
+
+/* Start dumping the default instance's unicast tables to fp */
+static void bgp_dump_routes_start(struct bgp_dump *bgp_dump, FILE *fp)
+{
+	struct frr_pthread_attr attr = {
+		.start = frr_pthread_attr_default.start,
+		.stop = frr_pthread_attr_default.stop,
+	};
+	struct bgp *bgp = bgp_get_default();
+	size_t len = strlen(bgp_dump->filename);
+	afi_t afi;
+
+	if (!bgp) {
+		fclose(fp);
+		return;
+	}
 
-	fflush(bgp_dump_routes.fp);
+	if (!dump_rt.fpt) {
+		dump_rt.fpt = frr_pthread_new(&attr, "BGP MRT dump writer",
+					      "bgpd_dump");
+		frr_pthread_run(dump_rt.fpt, NULL);
+		frr_pthread_wait_running(dump_rt.fpt);
+	}
 
-	return seq;
+	dump_rt.fp = fp;
+	if (len > 3 && strmatch(bgp_dump->filename + len - 3, ".gz")) {
+#ifdef HAVE_ZLIB
+		dump_rt.gz = gzdopen(dup(fileno(fp)), "wb");
+#else
+		flog_warn(EC_BGP_DUMP,
+			  "%s: built without zlib, writing %s uncompressed",
+			  __func__, bgp_dump->filename);
+#endif
+	}
+
+	atomic_store_explicit(&dump_rt.queued_all, false, memory_order_relaxed);
+	atomic_store_explicit(&dump_rt.busy, true, memory_order_release);
+
+	/* Note that this does ipv4 and ipv6 peers alike */
+	bgp_dump_routes_index_table(bgp);
+
+	for (afi = AFI_IP; afi <= AFI_IP6; afi++) {
+		dump_rt.table[afi] = bgp->rib[afi][SAFI_UNICAST];
+		bgp_table_lock(dump_rt.table[afi]);
+	}
+	dump_rt.afi = AFI_IP;
+	dump_rt.seq = 0;
+	dump_rt.dest = bgp_table_top(dump_rt.table[AFI_IP]);
+
+	event_add_event(bm->master, bgp_dump_routes_walk, NULL, 0,
+			&dump_rt.t_walk);
 }
 
 static void bgp_dump_interval_func(struct event *t)
@@ -437,17 +590,17 @@ static void bgp_dump_interval_func(struct event *t)
 	struct bgp_dump *bgp_dump;
 	bgp_dump = EVENT_ARG(t);
 
-	/* Reschedule dump even if file couldn't be opened this time... */
-	if (bgp_dump_open_file(bgp_dump) != NULL) {
-		/* In case of bgp_dump_routes, we need special route dump
-		 * function. */
+	if (bgp_dump->type == BGP_DUMP_ROUTES &&
+	    atomic_load_explicit(&dump_rt.busy, memory_order_acquire)) {
+		flog_warn(EC_BGP_DUMP,
+			  "%s: previous route dump still running, skipping this one",
+			  __func__);
+	} else if (bgp_dump_open_file(bgp_dump) != NULL) {
+		/* Reschedule dump even if file couldn't be opened this time...
+		 * In case of bgp_dump_routes, the file goes to the writer,
+		 * which closes it once the dump is written. */
 		if (bgp_dump->type == BGP_DUMP_ROUTES) {
-			unsigned int seq = bgp_dump_routes_func(AFI_IP, 1, 0);
-			bgp_dump_routes_func(AFI_IP6, 0, seq);
-			/* Close the file now. For a RIB dump there's no point
-			 * in leaving
-			 * it open until the next scheduled dump starts. */
-			fclose(bgp_dump->fp);
+			bgp_dump_routes_start(bgp_dump, bgp_dump->fp);
 			bgp_dump->fp = NULL;
 		}
 	}
@@ -566,14 +719,14 @@ static void bgp_dump_packet_func(struct bgp_dump *bgp_dump, struct peer *peer,
 	}
 	bgp_dump_common(obuf, peer, 0);
 
-	/* Packet contents. */
-	stream_put(obuf, STREAM_DATA(packet), stream_get_endp(packet));
+	/* Set length, packet contents included. */
+	stream_putl_at(obuf, 8,
+		       stream_get_endp(obuf) - BGP_DUMP_HEADER_SIZE +
+			       stream_get_endp(packet));
 
-	/* Set length. */
-	bgp_dump_set_size(obuf, MSG_PROTOCOL_BGP4MP);
-
-	/* Write to the stream. */
+	/* Write to the stream, the packet straight from its own. */
 	fwrite(STREAM_DATA(obuf), stream_get_endp(obuf), 1, bgp_dump->fp);
+	fwrite(STREAM_DATA(packet), stream_get_endp(packet), 1, bgp_dump->fp);
 	fflush(bgp_dump->fp);
 }
 
@@ -849,6 +1002,7 @@ void bgp_dump_init(void)
 	memset(&bgp_dump_all, 0, sizeof(bgp_dump_all));
 	memset(&bgp_dump_updates, 0, sizeof(bgp_dump_updates));
 	memset(&bgp_dump_routes, 0, sizeof(bgp_dump_routes));
+	stream_fifo_init(&dump_rt.fifo);
 
 	bgp_dump_obuf =
 		stream_new(BGP_MAX_PACKET_SIZE + BGP_MAX_PACKET_SIZE_OVERFLOW);
@@ -868,6 +1022,21 @@ void bgp_dump_finish(void)
 	bgp_dump_unset(&bgp_dump_updates);
 	bgp_dump_unset(&bgp_dump_routes);
 
+	/* Give up on a route dump still running, write what is queued */
+	if (atomic_load_explicit(&dump_rt.busy, memory_order_acquire) &&
+	    !atomic_load_explicit(&dump_rt.queued_all, memory_order_relaxed))
+		bgp_dump_routes_done();
+	if (dump_rt.fpt) {
+		if (atomic_load_explicit(&dump_rt.fpt->running,
+					 memory_order_relaxed))
+			frr_pthread_stop(dump_rt.fpt, NULL);
+		if (atomic_load_explicit(&dump_rt.busy, memory_order_acquire))
+			bgp_dump_routes_write(NULL);
+		frr_pthread_destroy(dump_rt.fpt);
+		dump_rt.fpt = NULL;
+	}
+	stream_fifo_deinit(&dump_rt.fifo);
+
 	stream_free(bgp_dump_obuf);
 	bgp_dump_obuf = NULL;
 	hook_unregister(bgp_packet_dump, bgp_dump_packet);
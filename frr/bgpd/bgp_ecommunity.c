@@ -371,6 +371,19 @@ static void ecommunity_color_str(char *buf, size_t bufsz, uint8_t *ptr)
 	snprintf(buf, bufsz, "Color:%d", colorid);
 }
 
+static void ecommunity_latency_str(char *buf, size_t bufsz, const uint8_t *ptr)
+{
+	uint16_t loss = (ptr[1] << 8) | ptr[2];
+	uint32_t latency;
+
+	(void)ptr_get_be32(ptr + 3, &latency);
+	if (loss)
+		snprintf(buf, bufsz, "LAT:%uus,loss:%u.%u%%", latency,
+			 loss / 10, loss % 10);
+	else
+		snprintf(buf, bufsz, "LAT:%uus", latency);
+}
+
 /* Initialize Extended Comminities related hash. */
 void ecommunity_init(void)
 {
@@ -1142,6 +1155,9 @@ char *ecommunity_ecom2str(struct ecommunity *ecom, int format, int filter)
 			} else if (*pnt == ECOMMUNITY_COLOR) {
 				ecommunity_color_str(encbuf, sizeof(encbuf),
 						     pnt);
+			} else if (*pnt == ECOMMUNITY_OPAQUE_SUBTYPE_LATENCY) {
+				ecommunity_latency_str(encbuf, sizeof(encbuf),
+						       pnt);
 			} else {
 				unk_ecom = 1;
 			}
@@ -1845,6 +1861,52 @@ struct ecommunity *ecommunity_replace_linkbw(as_t as, struct ecommunity *ecom,
 	return new;
 }
 
+const uint8_t *ecommunity_latency_present(struct ecommunity *ecom,
+					  uint32_t *latency_us, uint16_t *loss)
+{
+	const uint8_t *eval;
+	uint32_t i;
+
+	if (!ecom || !ecom->size || ecom->unit_size != ECOMMUNITY_SIZE)
+		return NULL;
+
+	for (i = 0; i < ecom->size; i++) {
+		const uint8_t *pnt;
+
+		eval = pnt = (ecom->val + (i * ECOMMUNITY_SIZE));
+		if (pnt[0] != ECOMMUNITY_ENCODE_OPAQUE ||
+		    pnt[1] != ECOMMUNITY_OPAQUE_SUBTYPE_LATENCY)
+			continue;
+
+		if (loss)
+			*loss = (pnt[2] << 8) | pnt[3];
+		if (latency_us)
+			(void)ptr_get_be32(pnt + 4, latency_us);
+		return eval;
+	}
+
+	return NULL;
+}
+
+/*
+ * Copy of ecom carrying latency_us and loss in its latency extended
+ * community, added if there was none. ecom itself is left alone, it may
+ * be interned.
+ */
+struct ecommunity *ecommunity_replace_latency(struct ecommunity *ecom,
+					      uint32_t latency_us,
+					      uint16_t loss)
+{
+	struct ecommunity *new;
+	struct ecommunity_val eval;
+
+	encode_latency_extcomm(latency_us, loss, &eval);
+	new = ecom ? ecommunity_dup(ecom) : ecommunity_new();
+	ecommunity_add_val(new, &eval, true, true);
+
+	return new;
+}
+
 bool soo_in_ecom(struct ecommunity *ecom, struct ecommunity *soo)
 {
 	if (ecom && soo) {
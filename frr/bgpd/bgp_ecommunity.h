@@ -79,6 +79,8 @@
 
 /* Low-order octet of the Extended Communities type field for OPAQUE types */
 #define ECOMMUNITY_OPAQUE_SUBTYPE_ENCAP     0x0c
+/* Measured latency (bgp_twamp), no IANA allocation: both ends must agree */
+#define ECOMMUNITY_OPAQUE_SUBTYPE_LATENCY   0x1a
 
 /* Extended communities attribute string format.  */
 #define ECOMMUNITY_FORMAT_ROUTE_MAP            0
@@ -246,6 +248,28 @@ static inline void encode_lb_extcomm(as_t as, uint32_t bw, bool non_trans,
 	eval->val[7] = bandwidth & 0xff;
 }
 
+/*
+ * Encode the latency extended community
+ *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *  | 0x03         | Sub-Type(0x1a) |    Loss (permille)            |
+ *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *  |                    Latency (microseconds)                     |
+ *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ */
+static inline void encode_latency_extcomm(uint32_t latency_us, uint16_t loss,
+					  struct ecommunity_val *eval)
+{
+	memset(eval, 0, sizeof(*eval));
+	eval->val[0] = ECOMMUNITY_ENCODE_OPAQUE;
+	eval->val[1] = ECOMMUNITY_OPAQUE_SUBTYPE_LATENCY;
+	eval->val[2] = (loss >> 8) & 0xff;
+	eval->val[3] = loss & 0xff;
+	eval->val[4] = (latency_us >> 24) & 0xff;
+	eval->val[5] = (latency_us >> 16) & 0xff;
+	eval->val[6] = (latency_us >> 8) & 0xff;
+	eval->val[7] = latency_us & 0xff;
+}
+
 static inline void encode_origin_validation_state(enum rpki_states state,
 						  struct ecommunity_val *eval)
 {
@@ -392,6 +416,13 @@ extern struct ecommunity *ecommunity_replace_linkbw(as_t as,
 						    uint64_t cum_bw,
 						    bool disable_ieee_floating);
 
+extern const uint8_t *ecommunity_latency_present(struct ecommunity *ecom,
+						 uint32_t *latency_us,
+						 uint16_t *loss);
+extern struct ecommunity *ecommunity_replace_latency(struct ecommunity *ecom,
+						     uint32_t latency_us,
+						     uint16_t loss);
+
 extern bool soo_in_ecom(struct ecommunity *ecom, struct ecommunity *soo);
 
 static inline void ecommunity_strip_rts(struct ecommunity *ecom)
@@ -879,6 +879,11 @@ struct bgp_dest *bgp_evpn_vni_node_lookup(const struct bgpevpn *vpn,
 	return bgp_evpn_vni_ip_node_lookup(vpn->ip_table, p, parent_pi);
 }
 
+/* VNI, MAC, IP length and address, VTEP, flags, seq and ESI */
+#define BGP_EVPN_MACIP_ENTRY_MAX                                               \
+	(4 + ETH_ALEN + 2 + IPV6_MAX_BYTELEN + IPV4_MAX_BYTELEN + 1 + 4 +      \
+	 sizeof(esi_t))
+
 /*
  * Add (update) or delete MACIP from zebra.
  */
@@ -908,12 +913,18 @@ static int bgp_zebra_send_remote_macip(struct bgp *bgp, struct bgpevpn *vpn,
 
 	if (!esi)
 		esi = zero_esi;
-	s = zclient->obuf;
-	stream_reset(s);
 
-	zclient_create_header(
-		s, add ? ZEBRA_REMOTE_MACIP_ADD : ZEBRA_REMOTE_MACIP_DEL,
-		bgp->vrf_id);
+	/*
+	 * zebra takes any number of MACIPs in a message: those sent from the
+	 * same event, e.g. a VTEP's routes, go together.
+	 */
+	s = zclient_msg_bulk_entry(zclient,
+				   add ? ZEBRA_REMOTE_MACIP_ADD
+				       : ZEBRA_REMOTE_MACIP_DEL,
+				   bgp->vrf_id, BGP_EVPN_MACIP_ENTRY_MAX);
+	if (!s)
+		return -1;
+
 	stream_putl(s, vpn->vni);
 
 	if (mac) /* Mac Addr */
@@ -949,8 +960,6 @@ static int bgp_zebra_send_remote_macip(struct bgp *bgp, struct bgpevpn *vpn,
 		stream_put(s, esi, sizeof(esi_t));
 	}
 
-	stream_putw_at(s, 0, stream_get_endp(s));
-
 	if (bgp_debug_zebra(NULL)) {
 		char esi_buf[ESI_STR_LEN];
 
@@ -969,10 +978,7 @@ static int bgp_zebra_send_remote_macip(struct bgp *bgp, struct bgpevpn *vpn,
 	frrtrace(5, frr_bgp, evpn_mac_ip_zsend, add, vpn, p, remote_vtep_ip,
 		 esi);
 
-        if (zclient_send_message(zclient) == ZCLIENT_SEND_FAILURE)
-          return -1;
-
-        return 0;
+	return 0;
 }
 
 /*
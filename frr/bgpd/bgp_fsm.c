@@ -40,6 +40,7 @@
 #include "bgpd/bgp_memory.h"
 #include "bgpd/bgp_keepalives.h"
 #include "bgpd/bgp_io.h"
+#include "bgpd/bgp_preparse.h"
 #include "bgpd/bgp_zebra.h"
 #include "bgpd/bgp_twamp.h"
 #include "bgpd/bgp_vty.h"
@@ -521,6 +522,8 @@ static void bgp_holdtime_timer(struct event *thread)
 	 * reason or another.
 	 */
 	inq_count = atomic_load_explicit(&connection->ibuf->count,
+					 memory_order_relaxed) +
+		    atomic_load_explicit(&connection->ibuf_parse->count,
 					 memory_order_relaxed);
 	if (inq_count)
 		BGP_TIMER_ON(connection->t_holdtime, bgp_holdtime_timer,
@@ -1226,7 +1229,9 @@ void bgp_fsm_change_status(struct peer_connection *connection,
 
 		/* Trigger TWAMP peer collection when peer becomes established */
 		if (bgp->import_latency_cfg.enabled) {
-			fprintf(stderr, "*** Peer established, re-collecting for TWAMP\n"); fflush(stderr);
+			if (BGP_DEBUG(twamp, TWAMP))
+				zlog_debug("%s established, re-collecting TWAMP nexthops",
+					   peer->host);
 			bgp_twamp_collect_nexthops(bgp);
 		}
 	} else if ((peer_established(connection)) && (status != Established))
@@ -1370,9 +1375,6 @@ enum bgp_fsm_state_progress bgp_stop(struct peer_connection *connection)
 	if (peer_established(connection)) {
 		peer->dropped++;
 
-		/* Notify BGP conditional advertisement process */
-		peer->advmap_table_change = true;
-
 		/* bgp log-neighbor-changes of neighbor Down */
 		if (CHECK_FLAG(peer->bgp->flags,
 			       BGP_FLAG_LOG_NEIGHBOR_CHANGES)) {
@@ -1499,14 +1501,18 @@ enum bgp_fsm_state_progress bgp_stop(struct peer_connection *connection)
 			stream_fifo_clean(connection->ibuf);
 		if (connection->obuf)
 			stream_fifo_clean(connection->obuf);
+		if (connection->ibuf_parse)
+			stream_fifo_clean(connection->ibuf_parse);
+		bgp_preparse_clean(connection);
 
 		if (connection->ibuf_work)
 			ringbuf_wipe(connection->ibuf_work);
 
 		if (peer->curr) {
-			stream_free(peer->curr);
+			bgp_pkt_stream_free(peer->curr);
 			peer->curr = NULL;
 		}
+		bgp_preparse_free(&peer->curr_prep);
 	}
 
 	/* Close of file descriptor. */
@@ -2114,9 +2120,9 @@ bgp_establish(struct peer_connection *connection)
 	struct peer *orig = peer;
 
 	other = peer->doppelganger;
-	hash_release(peer->bgp->peerhash, peer);
+	bgp_peerhash_del(&peer->bgp->peerhash, peer);
 	if (other)
-		hash_release(peer->bgp->peerhash, other);
+		bgp_peerhash_del(&peer->bgp->peerhash, other);
 
 	peer = peer_xfer_conn(peer);
 	if (!peer) {
@@ -2128,10 +2134,9 @@ bgp_establish(struct peer_connection *connection)
 		 * connections are rejected, as that the peer is not found
 		 * when a lookup is done
 		 */
-		(void)hash_get(orig->bgp->peerhash, orig, hash_alloc_intern);
+		bgp_peerhash_add(&orig->bgp->peerhash, orig);
 		if (other)
-			(void)hash_get(other->bgp->peerhash, other,
-				       hash_alloc_intern);
+			bgp_peerhash_add(&other->bgp->peerhash, other);
 		return BGP_FSM_FAILURE;
 	}
 	/*
@@ -2330,9 +2335,9 @@ bgp_establish(struct peer_connection *connection)
 	 * If we are replacing the old peer for a doppelganger
 	 * then switch it around in the bgp->peerhash
 	 * the doppelgangers su and this peer's su are the same
-	 * so the hash_release is the same for either.
+	 * so the lookup finds either.
 	 */
-	(void)hash_get(peer->bgp->peerhash, peer, hash_alloc_intern);
+	bgp_peerhash_add(&peer->bgp->peerhash, peer);
 
 	/* Start BFD peer if not already running. */
 	if (peer->bfd_config)
@@ -26,6 +26,7 @@
 #include "bgpd/bgp_packet.h"	// for bgp_notify_io_invalid...
 #include "bgpd/bgp_trace.h"	// for frrtraces
 #include "bgpd/bgpd.h"		// for peer, BGP_MARKER_SIZE, bgp_master, bm
+#include "bgpd/bgp_preparse.h"	// for bgp_preparse_kick, bgp_preparse_off
 /* clang-format on */
 
 /* forward declarations */
@@ -99,7 +100,8 @@ void bgp_reads_off(struct peer_connection *connection)
 	assert(fpt->running);
 
 	event_cancel_async(fpt->master, &connection->t_read, NULL);
-	EVENT_OFF(connection->t_process_packet);
+	bgp_preparse_off(connection);
+	event_inject_cancel(bm->master, &connection->process_inject);
 	EVENT_OFF(connection->t_process_packet_error);
 
 	UNSET_FLAG(connection->thread_flags, PEER_THREAD_READS_ON);
@@ -154,7 +156,102 @@ static void bgp_process_writes(struct event *thread)
 	}
 }
 
-static int read_ibuf_work(struct peer_connection *connection)
+/*
+ * Packet streams, recycled by size class so that a full table does not go
+ * through malloc and free once per UPDATE in either direction. Received
+ * packets are taken by the I/O pthread and mostly given back by the main
+ * pthread; sent ones the other way around. Classes are powers of two from
+ * 512 bytes up to the extended message size.
+ */
+#define BGP_PKT_POOL_MIN_SHIFT 9
+#define BGP_PKT_POOL_CLASSES   8
+#define BGP_PKT_POOL_DEPTH     256
+
+static struct {
+	pthread_mutex_t mtx;
+	struct stream *free[BGP_PKT_POOL_CLASSES];
+	unsigned int count[BGP_PKT_POOL_CLASSES];
+	bool closed;
+} pkt_pool = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static unsigned int bgp_pkt_pool_class(size_t size)
+{
+	unsigned int class = 0;
+
+	while ((size_t)1 << (BGP_PKT_POOL_MIN_SHIFT + class) < size)
+		class++;
+	return class;
+}
+
+struct stream *bgp_pkt_stream_new(size_t size)
+{
+	unsigned int class = bgp_pkt_pool_class(size);
+	struct stream *s = NULL;
+
+	if (class >= BGP_PKT_POOL_CLASSES)
+		return stream_new(size);
+
+	frr_with_mutex (&pkt_pool.mtx) {
+		s = pkt_pool.free[class];
+		if (s) {
+			pkt_pool.free[class] = s->next;
+			pkt_pool.count[class]--;
+		}
+	}
+	if (!s)
+		return stream_new((size_t)1 << (BGP_PKT_POOL_MIN_SHIFT + class));
+
+	s->next = NULL;
+	stream_reset(s);
+	return s;
+}
+
+void bgp_pkt_stream_free(struct stream *s)
+{
+	size_t size;
+	unsigned int class;
+
+	if (!s)
+		return;
+
+	size = STREAM_SIZE(s);
+	class = bgp_pkt_pool_class(size);
+	/* Views, and data still viewed elsewhere, cannot be reused */
+	if (!stream_is_shared(s) && class < BGP_PKT_POOL_CLASSES &&
+	    size == (size_t)1 << (BGP_PKT_POOL_MIN_SHIFT + class)) {
+		frr_with_mutex (&pkt_pool.mtx) {
+			if (!pkt_pool.closed &&
+			    pkt_pool.count[class] < BGP_PKT_POOL_DEPTH) {
+				s->next = pkt_pool.free[class];
+				pkt_pool.free[class] = s;
+				pkt_pool.count[class]++;
+				s = NULL;
+			}
+		}
+	}
+	stream_free(s);
+}
+
+void bgp_pkt_pool_finish(void)
+{
+	struct stream *s;
+	unsigned int class;
+
+	frr_with_mutex (&pkt_pool.mtx) {
+		pkt_pool.closed = true;
+		for (class = 0; class < BGP_PKT_POOL_CLASSES; class++) {
+			while ((s = pkt_pool.free[class])) {
+				pkt_pool.free[class] = s->next;
+				stream_free(s);
+			}
+			pkt_pool.count[class] = 0;
+		}
+	}
+}
+
+static int read_ibuf_work(struct peer_connection *connection, bool preparse)
 {
 	/* static buffer for transferring packets */
 	/* shorter alias to peer's input buffer */
@@ -162,10 +259,12 @@ static int read_ibuf_work(struct peer_connection *connection)
 	/* packet size as given by header */
 	uint16_t pktsize = 0;
 	struct stream *pkt;
+	const uint8_t *view;
 
 	/* ============================================== */
 	frr_with_mutex (&connection->io_mtx) {
-		if (connection->ibuf->count >= bm->inq_limit)
+		if (connection->ibuf->count + connection->ibuf_parse->count >=
+		    bm->inq_limit)
 			return -ENOMEM;
 	}
 
@@ -194,14 +293,24 @@ static int read_ibuf_work(struct peer_connection *connection)
 	if (ringbuf_remain(ibw) < pktsize)
 		return 0;
 
-	pkt = stream_new(pktsize);
-	assert(STREAM_WRITEABLE(pkt) == pktsize);
-	assert(ringbuf_get(ibw, pkt->data, pktsize) == pktsize);
-	stream_set_endp(pkt, pktsize);
+	pkt = bgp_pkt_stream_new(pktsize);
+	assert(STREAM_WRITEABLE(pkt) >= pktsize);
+
+	/* one copy straight out of the ring unless the packet wraps */
+	view = ringbuf_view(ibw, 0, pktsize);
+	if (view) {
+		stream_put(pkt, view, pktsize);
+		ringbuf_skip(ibw, pktsize);
+	} else {
+		assert(ringbuf_get(ibw, pkt->data, pktsize) == pktsize);
+		stream_set_endp(pkt, pktsize);
+	}
 
 	frrtrace(2, frr_bgp, packet_read, connection->peer, pkt);
 	frr_with_mutex (&connection->io_mtx) {
-		stream_fifo_push(connection->ibuf, pkt);
+		stream_fifo_push(preparse ? connection->ibuf_parse
+					  : connection->ibuf,
+				 pkt);
 	}
 
 	return pktsize;
@@ -226,6 +335,7 @@ static void bgp_process_reads(struct event *thread)
 	int code = 0;                   /* FSM code if error occurred */
 	static bool ibuf_full_logged;   /* Have we logged full already */
 	int ret = 1;
+	bool preparse = false;          /* whether parse workers take them */
 	/* clang-format on */
 
 	peer = connection->peer;
@@ -257,8 +367,9 @@ static void bgp_process_reads(struct event *thread)
 		goto done;
 	}
 
+	preparse = bgp_preparse_enabled();
 	while (true) {
-		ret = read_ibuf_work(connection);
+		ret = read_ibuf_work(connection, preparse);
 		if (ret <= 0)
 			break;
 
@@ -294,9 +405,10 @@ done:
 
 	event_add_read(fpt->master, bgp_process_reads, connection,
 		       connection->fd, &connection->t_read);
-	if (added_pkt)
-		event_add_event(bm->master, bgp_process_packet, connection, 0,
-				&connection->t_process_packet);
+	if (added_pkt && preparse)
+		bgp_preparse_kick(connection);
+	else if (added_pkt)
+		event_inject(bm->master, &connection->process_inject);
 }
 
 /*
@@ -455,7 +567,7 @@ static uint16_t bgp_write(struct peer_connection *connection)
 			break;
 		}
 
-		stream_free(s);
+		bgp_pkt_stream_free(s);
 		ostreams[i] = NULL;
 		update_last_write = 1;
 	}
@@ -482,7 +594,6 @@ done : {
 	return status;
 }
 
-uint8_t ibuf_scratch[BGP_EXTENDED_MESSAGE_MAX_PACKET_SIZE * BGP_READ_PACKET_MAX];
 /*
  * Reads a chunk of data from peer->connection.fd into
  * peer->connection.ibuf_work.
@@ -492,9 +603,8 @@ uint8_t ibuf_scratch[BGP_EXTENDED_MESSAGE_MAX_PACKET_SIZE * BGP_READ_PACKET_MAX]
  *
  * @return status flag (see top-of-file)
  *
- * PLEASE NOTE:  If we ever transform the bgp_read to be a pthread
- * per peer then we need to rethink the global ibuf_scratch
- * data structure above.
+ * The data goes straight into the free space of ibuf_work, wrapping or not,
+ * rather than through a scratch buffer.
  */
 static uint16_t bgp_read(struct peer_connection *connection, int *code_p)
 {
@@ -510,9 +620,10 @@ static uint16_t bgp_read(struct peer_connection *connection, int *code_p)
 		return status;
 	}
 
-	readsize = MIN(ibuf_work_space, sizeof(ibuf_scratch));
+	readsize = MIN(ibuf_work_space,
+		       BGP_EXTENDED_MESSAGE_MAX_PACKET_SIZE * BGP_READ_PACKET_MAX);
 
-	nbytes = read(connection->fd, ibuf_scratch, readsize);
+	nbytes = ringbuf_read(connection->ibuf_work, connection->fd, readsize);
 
 	/* EAGAIN or EWOULDBLOCK; come back later */
 	if (nbytes < 0 && ERRNO_IO_RETRY(errno)) {
@@ -540,9 +651,6 @@ static uint16_t bgp_read(struct peer_connection *connection, int *code_p)
 			*code_p = TCP_connection_closed;
 
 		SET_FLAG(status, BGP_IO_FATAL_ERR);
-	} else {
-		assert(ringbuf_put(connection->ibuf_work, ibuf_scratch,
-				   nbytes) == (size_t)nbytes);
 	}
 
 	return status;
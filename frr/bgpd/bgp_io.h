@@ -88,4 +88,28 @@ extern void bgp_reads_on(struct peer_connection *connection);
  */
 extern void bgp_reads_off(struct peer_connection *connection);
 
+/**
+ * Allocates a stream for a packet of size bytes, received or to be sent.
+ *
+ * These come from a pool and may be larger than asked for; give them back
+ * with bgp_pkt_stream_free(), though stream_free() is fine too.
+ *
+ * Safe to call from any pthread.
+ *
+ * @param size - packet size
+ */
+extern struct stream *bgp_pkt_stream_new(size_t size);
+
+/**
+ * Returns a stream from bgp_pkt_stream_new() to the pool, or frees it.
+ *
+ * @param s - stream to give back, may be NULL
+ */
+extern void bgp_pkt_stream_free(struct stream *s);
+
+/**
+ * Frees the pooled streams; any given back later are freed right away.
+ */
+extern void bgp_pkt_pool_finish(void);
+
 #endif /* _FRR_BGP_IO_H */
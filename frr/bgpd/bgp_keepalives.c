@@ -29,23 +29,51 @@ DEFINE_MTYPE_STATIC(BGPD, BGP_MUTEX, "BGP Peer pthread Mutex");
  * Peer KeepAlive Timer.
  * Associates a peer with the time of its last keepalive.
  */
+PREDECL_HEAP(pkat_heap);
+
 struct pkat {
 	/* the peer to send keepalives to */
 	struct peer *peer;
 	/* absolute time of last keepalive sent */
 	struct timeval last;
+	/* absolute time the next keepalive is due, the heap is ordered by */
+	struct timeval due;
+
+	struct pkat_heap_item item;
 };
 
-/* List of peers we are sending keepalives for, and associated mutex. */
+static int pkat_cmp(const struct pkat *a, const struct pkat *b)
+{
+	if (timercmp(&a->due, &b->due, <))
+		return -1;
+	return timercmp(&a->due, &b->due, >);
+}
+
+DECLARE_HEAP(pkat_heap, struct pkat, item, pkat_cmp);
+
+/*
+ * Peers we are sending keepalives for, and associated mutex. The hash finds
+ * them by peer, the heap by when their next keepalive is due.
+ */
 static pthread_mutex_t *peerhash_mtx;
 static pthread_cond_t *peerhash_cond;
 static struct hash *peerhash;
+static struct pkat_heap_head pkat_heap;
+
+/*
+ * Keepalives due within this tolerance are sent together with those already
+ * due, which helps alleviate nanosecond sleeps between ticks by grouping
+ * together peers who are due at roughly the same time. It is arbitrarily
+ * chosen to be 100ms.
+ */
+static const struct timeval tolerance = {0, 100000};
 
 static struct pkat *pkat_new(struct peer *peer)
 {
-	struct pkat *pkat = XMALLOC(MTYPE_BGP_PKAT, sizeof(struct pkat));
+	struct pkat *pkat = XCALLOC(MTYPE_BGP_PKAT, sizeof(struct pkat));
 	pkat->peer = peer;
 	monotime(&pkat->last);
+	pkat->due = pkat->last;
 	return pkat;
 }
 
@@ -56,67 +84,43 @@ static void pkat_del(void *pkat)
 
 
 /*
- * Callback for hash_iterate. Determines if a peer needs a keepalive and if so,
- * generates and sends it.
+ * Sends the keepalive of a peer that came up first in the heap if it is due
+ * and puts the peer back in for its next one.
  *
- * For any given peer, if the elapsed time since its last keepalive exceeds its
- * configured keepalive timer, a keepalive is sent to the peer and its
- * last-sent time is reset. Additionally, If the elapsed time does not exceed
- * the configured keepalive timer, but the time until the next keepalive is due
- * is within a hardcoded tolerance, a keepalive is sent as if the configured
- * timer was exceeded. Doing this helps alleviate nanosecond sleeps between
- * ticks by grouping together peers who are due for keepalives at roughly the
- * same time. This tolerance value is arbitrarily chosen to be 100ms.
- *
- * In addition, this function calculates the maximum amount of time that the
- * keepalive thread can sleep before another tick needs to take place. This is
- * equivalent to shortest time until a keepalive is due for any one peer.
- *
- * @return maximum time to wait until next update (0 if infinity)
+ * The peer's keepalive timer is looked at anew every time, so a change of it
+ * shows at the latest when the keepalive due by the former one would go.
  */
-static void peer_process(struct hash_bucket *hb, void *arg)
+static void peer_process(struct pkat *pkat, const struct timeval *now)
 {
-	struct pkat *pkat = hb->data;
-
-	struct timeval *next_update = arg;
-
-	static struct timeval elapsed;  // elapsed time since keepalive
-	static struct timeval ka = {0}; // peer->v_keepalive as a timeval
-	static struct timeval diff;     // ka - elapsed
-
-	static const struct timeval tolerance = {0, 100000};
+	struct timeval limit; // now, plus the tolerance
+	struct timeval ka = {0}; // peer->v_keepalive as a timeval
 
 	uint32_t v_ka = atomic_load_explicit(&pkat->peer->v_keepalive,
 					     memory_order_relaxed);
 
-	/* 0 keepalive timer means no keepalives */
-	if (v_ka == 0)
+	/* 0 keepalive timer means no keepalives, look again in a while */
+	if (v_ka == 0) {
+		ka.tv_sec = 1;
+		timeradd(now, &ka, &pkat->due);
+		pkat_heap_add(&pkat_heap, pkat);
 		return;
+	}
 
-	/* calculate elapsed time since last keepalive */
-	monotime_since(&pkat->last, &elapsed);
-
-	/* calculate difference between elapsed time and configured time */
 	ka.tv_sec = v_ka;
-	timersub(&ka, &elapsed, &diff);
-
-	int send_keepalive =
-		elapsed.tv_sec >= ka.tv_sec || timercmp(&diff, &tolerance, <);
+	timeradd(&pkat->last, &ka, &pkat->due);
+	timeradd(now, &tolerance, &limit);
 
-	if (send_keepalive) {
+	if (timercmp(&pkat->due, &limit, <=)) {
 		if (bgp_debug_keepalive(pkat->peer))
 			zlog_debug("%s [FSM] Timer (keepalive timer expire)",
 				   pkat->peer->host);
 
 		bgp_keepalive_send(pkat->peer);
-		monotime(&pkat->last);
-		memset(&elapsed, 0, sizeof(elapsed));
-		diff = ka;
+		pkat->last = *now;
+		timeradd(now, &ka, &pkat->due);
 	}
 
-	/* if calculated next update for this peer < current delay, use it */
-	if (next_update->tv_sec < 0 || timercmp(&diff, next_update, <))
-		*next_update = diff;
+	pkat_heap_add(&pkat_heap, pkat);
 }
 
 static bool peer_hash_cmp(const void *f, const void *s)
@@ -136,6 +140,9 @@ static unsigned int peer_hash_key(const void *arg)
 /* Cleanup handler / deinitializer. */
 static void bgp_keepalives_finish(void *arg)
 {
+	while (pkat_heap_pop(&pkat_heap))
+		;
+	pkat_heap_fini(&pkat_heap);
 	hash_clean_and_free(&peerhash, pkat_del);
 
 	pthread_mutex_unlock(peerhash_mtx);
@@ -155,9 +162,9 @@ void *bgp_keepalives_start(void *arg)
 	fpt->master->owner = pthread_self();
 
 	struct timeval currtime = {0, 0};
-	struct timeval aftertime = {0, 0};
-	struct timeval next_update = {0, 0};
+	struct timeval limit = {0, 0};
 	struct timespec next_update_ts = {0, 0};
+	struct pkat *pkat;
 
 	/*
 	 * The RCU mechanism for each pthread is initialized in a "locked"
@@ -189,6 +196,7 @@ void *bgp_keepalives_start(void *arg)
 
 	/* initialize peer hashtable */
 	peerhash = hash_create_size(2048, peer_hash_key, peer_hash_cmp, NULL);
+	pkat_heap_init(&pkat_heap);
 	pthread_mutex_lock(peerhash_mtx);
 
 	/* register cleanup handler */
@@ -198,27 +206,28 @@ void *bgp_keepalives_start(void *arg)
 	frr_pthread_notify_running(fpt);
 
 	while (atomic_load_explicit(&fpt->running, memory_order_relaxed)) {
-		if (peerhash->count > 0)
+		if (pkat_heap_count(&pkat_heap) > 0)
 			pthread_cond_timedwait(peerhash_cond, peerhash_mtx,
 					       &next_update_ts);
 		else
-			while (peerhash->count == 0
+			while (pkat_heap_count(&pkat_heap) == 0
 			       && atomic_load_explicit(&fpt->running,
 						       memory_order_relaxed))
 				pthread_cond_wait(peerhash_cond, peerhash_mtx);
 
 		monotime(&currtime);
+		timeradd(&currtime, &tolerance, &limit);
 
-		next_update.tv_sec = -1;
-
-		hash_iterate(peerhash, peer_process, &next_update);
-		if (next_update.tv_sec == -1)
-			memset(&next_update, 0, sizeof(next_update));
-
-		monotime_since(&currtime, &aftertime);
+		/* Only the peers that are due, not a walk over all of them */
+		while ((pkat = pkat_heap_first(&pkat_heap)) &&
+		       timercmp(&pkat->due, &limit, <=)) {
+			pkat_heap_pop(&pkat_heap);
+			peer_process(pkat, &currtime);
+		}
 
-		timeradd(&currtime, &next_update, &next_update);
-		TIMEVAL_TO_TIMESPEC(&next_update, &next_update_ts);
+		pkat = pkat_heap_first(&pkat_heap);
+		if (pkat)
+			TIMEVAL_TO_TIMESPEC(&pkat->due, &next_update_ts);
 	}
 
 	/* clean up */
@@ -252,6 +261,8 @@ void bgp_keepalives_on(struct peer_connection *connection)
 		if (!hash_lookup(peerhash, &holder)) {
 			struct pkat *pkat = pkat_new(peer);
 			(void)hash_get(peerhash, pkat, hash_alloc_intern);
+			/* Due now, the keepalive pthread works out when */
+			pkat_heap_add(&pkat_heap, pkat);
 			peer_lock(peer);
 		}
 		SET_FLAG(peer->thread_flags, PEER_THREAD_KEEPALIVES_ON);
@@ -282,6 +293,7 @@ void bgp_keepalives_off(struct peer_connection *connection)
 		holder.peer = peer;
 		struct pkat *res = hash_release(peerhash, &holder);
 		if (res) {
+			pkat_heap_del(&pkat_heap, res);
 			pkat_del(res);
 			peer_unlock(peer);
 		}
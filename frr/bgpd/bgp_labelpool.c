@@ -55,6 +55,15 @@ static struct labelpool *lp;
 #define LP_CHUNK_SIZE_MIN 128
 #define LP_CHUNK_SIZE_MAX (1 << (20 - 4))
 
+/*
+ * The next chunk is requested before the pool runs out, when the labels
+ * left and already requested would last less than this many seconds at
+ * the recent rate of requests, or fall below the minimum. Requestors then
+ * do not wait on a round trip to the label manager during route churn.
+ */
+#define LP_PREFETCH_SECS 2
+#define LP_PREFETCH_MIN 32
+
 DEFINE_MTYPE_STATIC(BGPD, BGP_LABEL_CHUNK, "BGP Label Chunk");
 DEFINE_MTYPE_STATIC(BGPD, BGP_LABEL_FIFO, "BGP Label FIFO item");
 DEFINE_MTYPE_STATIC(BGPD, BGP_LABEL_CB, "BGP Dynamic Label Assignment");
@@ -308,6 +317,7 @@ static mpls_label_t get_label_from_pool(void *labelid)
 		bf_set_bit(chunk->allocated_map, index);
 		chunk->idx_last_allocated = index;
 		chunk->nfree -= 1;
+		lp->nfree -= 1;
 
 		return lbl;
 	}
@@ -315,6 +325,44 @@ static mpls_label_t get_label_from_pool(void *labelid)
 	return MPLS_LABEL_NONE;
 }
 
+/*
+ * Size of the next chunk to request, for at least "want" labels: the
+ * request size doubles each time as before, and catches up with want.
+ */
+static uint32_t lp_chunksize_next(uint32_t want)
+{
+	uint32_t size = lp->next_chunksize;
+
+	while (size < want && (size << 1) <= LP_CHUNK_SIZE_MAX)
+		size <<= 1;
+
+	lp->next_chunksize = size;
+	if ((lp->next_chunksize << 1) <= LP_CHUNK_SIZE_MAX)
+		lp->next_chunksize <<= 1;
+	return size;
+}
+
+static void lp_chunk_prefetch(void)
+{
+	uint32_t low = MAX(lp->alloc_rate * LP_PREFETCH_SECS, LP_PREFETCH_MIN);
+	uint32_t size;
+
+	if (lp->nfree + lp->pending_count >= low)
+		return;
+
+	/* Sized to last about as long again */
+	size = lp_chunksize_next(low);
+	if (BGP_DEBUG(labelpool, LABELPOOL))
+		zlog_debug("%s: %u free, %u pending, rate %u/s: requesting %u",
+			   __func__, lp->nfree, lp->pending_count,
+			   lp->alloc_rate, size);
+
+	if (!bgp_zebra_request_label_range(MPLS_LABEL_BASE_ANY, size))
+		return;
+
+	lp->pending_count += size;
+}
+
 /*
  * Success indicated by value of "label" field in returned LCB
  */
@@ -395,6 +443,7 @@ void bgp_lp_get(
 			XFREE(MTYPE_BGP_LABEL_CB, lcb);
 			return;
 		}
+		lp->alloc_count++;
 	}
 
 	if (lcb->label != MPLS_LABEL_NONE) {
@@ -418,6 +467,8 @@ void bgp_lp_get(
 
 		work_queue_add(lp->callback_q, q);
 
+		if (!requested)
+			lp_chunk_prefetch();
 		return;
 	}
 
@@ -447,13 +498,14 @@ void bgp_lp_get(
 	lp_fifo_add_tail(&lp->requests, lf);
 
 	if (lp_fifo_count(&lp->requests) > lp->pending_count) {
-		if (!bgp_zebra_request_label_range(MPLS_LABEL_BASE_ANY,
-						   lp->next_chunksize))
+		uint32_t size = lp_chunksize_next(
+			MAX(lp->alloc_rate * LP_PREFETCH_SECS,
+			    lp_fifo_count(&lp->requests) - lp->pending_count));
+
+		if (!bgp_zebra_request_label_range(MPLS_LABEL_BASE_ANY, size))
 			return;
 
-		lp->pending_count += lp->next_chunksize;
-		if ((lp->next_chunksize << 1) <= LP_CHUNK_SIZE_MAX)
-			lp->next_chunksize <<= 1;
+		lp->pending_count += size;
 	}
 }
 
@@ -493,6 +545,7 @@ void bgp_lp_release(
 						     index));
 				bf_release_index(chunk->allocated_map, index);
 				chunk->nfree += 1;
+				lp->nfree += 1;
 				deallocated = true;
 			}
 			assert(deallocated);
@@ -573,6 +626,12 @@ finishedrequest:
 		XFREE(MTYPE_BGP_LABEL_FIFO, lf);
 	}
 
+	/* Once a second: fold the requests of the last one into the rate */
+	lp->alloc_rate = (lp->alloc_rate + lp->alloc_count) / 2;
+	lp->alloc_count = 0;
+	if (lp->alloc_rate)
+		lp_chunk_prefetch();
+
 	event_add_timer(bm->master, bgp_sync_label_manager, NULL, 1,
 			&bm->t_bgp_sync_label_manager);
 }
@@ -597,6 +656,7 @@ void bgp_lp_event_chunk(uint32_t first, uint32_t last)
 	chunk->last = last;
 	chunk->nfree = labelcount;
 	bf_init(chunk->allocated_map, labelcount);
+	lp->nfree += labelcount;
 
 	/*
 	 * Optimize for allocation by adding the new (presumably larger)
@@ -649,6 +709,7 @@ void bgp_lp_event_zebra_up(void)
 	 * Invalidate current list of chunks
 	 */
 	list_delete_all_node(lp->chunks);
+	lp->nfree = 0;
 
 	if (!bgp_zebra_request_label_range(MPLS_LABEL_BASE_ANY, labels_needed))
 		return;
@@ -727,6 +788,8 @@ DEFUN(show_bgp_labelpool_summary, show_bgp_labelpool_summary_cmd,
 				    lp_fifo_count(&lp->requests));
 		json_object_int_add(json, "labelChunks", listcount(lp->chunks));
 		json_object_int_add(json, "pending", lp->pending_count);
+		json_object_int_add(json, "free", lp->nfree);
+		json_object_int_add(json, "allocationRate", lp->alloc_rate);
 		json_object_int_add(json, "reconnects", lp->reconnect_count);
 		vty_json(vty, json);
 	} else {
@@ -740,6 +803,8 @@ DEFUN(show_bgp_labelpool_summary, show_bgp_labelpool_summary_cmd,
 		vty_out(vty, "%-13s %d\n",
 			"LabelChunks:", listcount(lp->chunks));
 		vty_out(vty, "%-13s %d\n", "Pending:", lp->pending_count);
+		vty_out(vty, "%-13s %u\n", "Free:", lp->nfree);
+		vty_out(vty, "%-13s %u/s\n", "Rate:", lp->alloc_rate);
 		vty_out(vty, "%-13s %d\n", "Reconnects:", lp->reconnect_count);
 	}
 	return CMD_SUCCESS;
@@ -31,6 +31,9 @@ struct labelpool {
 	uint32_t		pending_count;	/* requested from zebra */
 	uint32_t reconnect_count;		/* zebra reconnections */
 	uint32_t next_chunksize;		/* request this many labels */
+	uint32_t nfree;			/* unallocated in chunks */
+	uint32_t alloc_count;		/* new requests this second */
+	uint32_t alloc_rate;		/* smoothed, requests per second */
 };
 
 extern void bgp_lp_init(struct event_loop *master, struct labelpool *pool);
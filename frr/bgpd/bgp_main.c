@@ -49,6 +49,8 @@
 #include "bgpd/bgp_evpn_mh.h"
 #include "bgpd/bgp_nht.h"
 #include "bgpd/bgp_routemap_nb.h"
+#include "bgpd/bgp_twamp.h"
+#include "bgpd/bgp_state_export.h"
 #include "bgpd/bgp_community_alias.h"
 
 #ifdef ENABLE_BGP_VNC
@@ -180,6 +182,7 @@ static __attribute__((__noreturn__)) void bgp_exit(int status)
 
 	frr_early_fini();
 
+	bgp_state_export_finish();
 	bgp_close();
 
 	bgp_default = bgp_get_default();
@@ -211,6 +214,9 @@ static __attribute__((__noreturn__)) void bgp_exit(int status)
 	/* cleanup route maps */
 	bgp_route_map_terminate();
 
+	/* community-lists hold on to attributes they matched */
+	community_list_flush_compiled(bgp_clist);
+
 	/* reverse bgp_attr_init */
 	bgp_attr_finish();
 
@@ -353,6 +359,7 @@ static const struct frr_yang_module_info *const bgpd_yang_modules[] = {
 	&frr_route_map_info,
 	&frr_vrf_info,
 	&frr_bgp_route_map_info,
+	&frr_bgp_latency_info,
 };
 
 FRR_DAEMON_INFO(bgpd, BGP, .vty_port = BGP_VTY_PORT,
@@ -388,6 +395,12 @@ int main(int argc, char **argv)
 
 	addresses->cmp = (int (*)(void *, void *))strcmp;
 
+	/*
+	 * Paths and table nodes come from bgpd's own arenas; attributes are
+	 * the other small object there is one of per distinct route.
+	 */
+	qmem_pool_enable(MTYPE_ATTR);
+
 	frr_preinit(&bgpd_di, argc, argv);
 	fprintf(stderr, "========================================\n");
 	fprintf(stderr, "CUSTOM BGP BUILD - Hello from Gokul!\n");
@@ -506,6 +519,7 @@ int main(int argc, char **argv)
 	}
 
 	bgp_if_init();
+	bgp_state_export_init();
 
 	frr_config_fork();
 	/* must be called after fork() */
@@ -47,7 +47,10 @@ DEFINE_MTYPE(BGPD, BGP_ADVERTISE_ATTR, "BGP adv attr");
 DEFINE_MTYPE(BGPD, BGP_ADVERTISE, "BGP adv");
 DEFINE_MTYPE(BGPD, BGP_SYNCHRONISE, "BGP synchronise");
 DEFINE_MTYPE(BGPD, BGP_ADJ_IN, "BGP adj in");
+DEFINE_MTYPE(BGPD, BGP_ADJ_IN_DELTA, "BGP adj in delta");
 DEFINE_MTYPE(BGPD, BGP_ADJ_OUT, "BGP adj out");
+DEFINE_MTYPE(BGPD, BGP_ADJ_OUT_SET, "BGP adj out set");
+DEFINE_MTYPE(BGPD, BGP_ADJ_SLOTS, "BGP adj out slots");
 DEFINE_MTYPE(BGPD, BGP_MPATH_INFO, "BGP multipath info");
 
 DEFINE_MTYPE(BGPD, AS_LIST, "BGP AS list");
@@ -75,6 +78,7 @@ DEFINE_MTYPE(BGPD, CLUSTER_VAL, "Cluster list val");
 
 DEFINE_MTYPE(BGPD, BGP_PROCESS_QUEUE, "BGP Process queue");
 DEFINE_MTYPE(BGPD, BGP_CLEAR_NODE_QUEUE, "BGP node clear queue");
+DEFINE_MTYPE(BGPD, BGP_STALE_SWEEP, "BGP stale path sweep");
 
 DEFINE_MTYPE(BGPD, TRANSIT, "BGP transit attr");
 DEFINE_MTYPE(BGPD, TRANSIT_VAL, "BGP transit val");
@@ -43,7 +43,10 @@ DECLARE_MTYPE(BGP_ADVERTISE_ATTR);
 DECLARE_MTYPE(BGP_ADVERTISE);
 DECLARE_MTYPE(BGP_SYNCHRONISE);
 DECLARE_MTYPE(BGP_ADJ_IN);
+DECLARE_MTYPE(BGP_ADJ_IN_DELTA);
 DECLARE_MTYPE(BGP_ADJ_OUT);
+DECLARE_MTYPE(BGP_ADJ_OUT_SET);
+DECLARE_MTYPE(BGP_ADJ_SLOTS);
 DECLARE_MTYPE(BGP_MPATH_INFO);
 
 DECLARE_MTYPE(AS_LIST);
@@ -71,6 +74,7 @@ DECLARE_MTYPE(CLUSTER_VAL);
 
 DECLARE_MTYPE(BGP_PROCESS_QUEUE);
 DECLARE_MTYPE(BGP_CLEAR_NODE_QUEUE);
+DECLARE_MTYPE(BGP_STALE_SWEEP);
 
 DECLARE_MTYPE(TRANSIT);
 DECLARE_MTYPE(TRANSIT_VAL);
@@ -26,6 +26,7 @@
 #include "bgpd/bgp_ecommunity.h"
 #include "bgpd/bgp_lcommunity.h"
 #include "bgpd/bgp_mpath.h"
+#include "bgpd/bgp_twamp.h"
 
 /*
  * bgp_maximum_paths_set
@@ -435,6 +436,54 @@ static void bgp_path_info_mpath_lb_update(struct bgp_path_info *path, bool set,
 	} else {
 		mpath->mp_flags = 0;
 		mpath->cum_bw = 0;
+		mpath->cum_lat_wt = 0;
+	}
+}
+
+/*
+ * bgp_path_info_mpath_lat_set
+ *
+ * Record the latency weight of a path going into the multipath being
+ * built. Returns true if it differs from the one recorded last time.
+ */
+static bool bgp_path_info_mpath_lat_set(struct bgp_path_info *path,
+					uint64_t lat_wt)
+{
+	struct bgp_path_info_mpath *mpath;
+
+	mpath = bgp_path_info_mpath_get(path);
+	if (!mpath || mpath->lat_wt == lat_wt)
+		return false;
+	mpath->lat_wt = lat_wt;
+	return true;
+}
+
+/*
+ * bgp_path_info_mpath_lat_update
+ *
+ * Update cumulative info related to latency weights on the bestpath
+ */
+static void bgp_path_info_mpath_lat_update(struct bgp_path_info *path,
+					   bool all_paths_lat,
+					   uint64_t cum_lat_wt)
+{
+	struct bgp_path_info_mpath *mpath;
+
+	mpath = path->mpath;
+	if (mpath == NULL) {
+		if (!all_paths_lat)
+			return;
+
+		mpath = bgp_path_info_mpath_get(path);
+		if (!mpath)
+			return;
+	}
+	if (all_paths_lat) {
+		SET_FLAG(mpath->mp_flags, BGP_MP_LAT_ALL);
+		mpath->cum_lat_wt = cum_lat_wt;
+	} else {
+		UNSET_FLAG(mpath->mp_flags, BGP_MP_LAT_ALL);
+		mpath->cum_lat_wt = 0;
 	}
 }
 
@@ -487,6 +536,51 @@ uint64_t bgp_path_info_mpath_cumbw(struct bgp_path_info *path)
 	return path->mpath->cum_bw;
 }
 
+/*
+ * bgp_path_info_mpath_chklat
+ *
+ * Return if we should do latency-weighted ECMP. Link-bandwidth, when in
+ * use, takes precedence; a multipath with an unmeasured path falls back
+ * to plain ECMP. The path passed in is the bestpath.
+ */
+bool bgp_path_info_mpath_chklat(struct bgp *bgp, struct bgp_path_info *path)
+{
+	if (!bgp->import_latency_cfg.enabled ||
+	    !bgp->import_latency_cfg.weighted_ecmp || !path->mpath)
+		return false;
+
+	if (bgp_path_info_mpath_chkwtd(bgp, path))
+		return false;
+
+	return CHECK_FLAG(path->mpath->mp_flags, BGP_MP_LAT_ALL);
+}
+
+/*
+ * bgp_path_info_mpath_cumlat
+ *
+ * Given bestpath bgp_path_info, return the cumulative latency weight of
+ * all its multipaths
+ */
+uint64_t bgp_path_info_mpath_cumlat(struct bgp_path_info *path)
+{
+	if (!path->mpath)
+		return 0;
+	return path->mpath->cum_lat_wt;
+}
+
+/*
+ * bgp_path_info_mpath_latwt
+ *
+ * Latency weight of a path (bestpath or multipath) as of the last
+ * multipath update, consistent with bgp_path_info_mpath_cumlat()
+ */
+uint64_t bgp_path_info_mpath_latwt(struct bgp_path_info *path)
+{
+	if (!path->mpath)
+		return 0;
+	return path->mpath->lat_wt;
+}
+
 /*
  * bgp_path_info_mpath_attr_set
  *
@@ -519,10 +613,11 @@ void bgp_path_info_mpath_update(struct bgp *bgp, struct bgp_dest *dest,
 	uint16_t maxpaths, mpath_count, old_mpath_count;
 	uint32_t bwval;
 	uint64_t cum_bw, old_cum_bw;
+	uint64_t lat_wt, cum_lat_wt, old_cum_lat_wt;
 	struct listnode *mp_node, *mp_next_node;
 	struct bgp_path_info *cur_mpath, *new_mpath, *next_mpath, *prev_mpath;
 	int mpath_changed, debug;
-	bool all_paths_lb;
+	bool all_paths_lb, all_paths_lat, lat_wt_changed, lat_ecmp;
 	char path_buf[PATH_ADDPATH_STR_BUFFER];
 
 	mpath_changed = 0;
@@ -531,6 +626,10 @@ void bgp_path_info_mpath_update(struct bgp *bgp, struct bgp_dest *dest,
 	cur_mpath = NULL;
 	old_mpath_count = 0;
 	old_cum_bw = cum_bw = 0;
+	old_cum_lat_wt = cum_lat_wt = 0;
+	lat_wt_changed = false;
+	lat_ecmp = bgp->import_latency_cfg.enabled &&
+		   bgp->import_latency_cfg.weighted_ecmp;
 	prev_mpath = new_best;
 	mp_node = listhead(mp_list);
 	debug = bgp_debug_bestpath(dest);
@@ -548,6 +647,7 @@ void bgp_path_info_mpath_update(struct bgp *bgp, struct bgp_dest *dest,
 		cur_mpath = bgp_path_info_mpath_first(old_best);
 		old_mpath_count = bgp_path_info_mpath_count(old_best);
 		old_cum_bw = bgp_path_info_mpath_cumbw(old_best);
+		old_cum_lat_wt = bgp_path_info_mpath_cumlat(old_best);
 		bgp_path_info_mpath_count_set(old_best, 0);
 		bgp_path_info_mpath_lb_update(old_best, false, false, 0);
 		bgp_path_info_mpath_dequeue(old_best);
@@ -573,6 +673,7 @@ void bgp_path_info_mpath_update(struct bgp *bgp, struct bgp_dest *dest,
 	 * to skip over it
 	 */
 	all_paths_lb = true; /* We'll reset if any path doesn't have LB. */
+	all_paths_lat = lat_ecmp; /* Reset if any path is not measured. */
 	while (mp_node || cur_mpath) {
 		struct bgp_path_info *tmp_info;
 
@@ -618,6 +719,15 @@ void bgp_path_info_mpath_update(struct bgp *bgp, struct bgp_dest *dest,
 					cum_bw += bwval;
 				else
 					all_paths_lb = false;
+				if (lat_ecmp) {
+					lat_wt = bgp_twamp_path_weight(cur_mpath);
+					if (!lat_wt)
+						all_paths_lat = false;
+					if (bgp_path_info_mpath_lat_set(cur_mpath,
+									lat_wt))
+						lat_wt_changed = true;
+					cum_lat_wt += lat_wt;
+				}
 				if (debug) {
 					bgp_path_info_path_with_addpath_rx_str(
 						cur_mpath, path_buf,
@@ -709,6 +819,14 @@ void bgp_path_info_mpath_update(struct bgp *bgp, struct bgp_dest *dest,
 					cum_bw += bwval;
 				else
 					all_paths_lb = false;
+				if (lat_ecmp) {
+					lat_wt = bgp_twamp_path_weight(new_mpath);
+					if (!lat_wt)
+						all_paths_lat = false;
+					bgp_path_info_mpath_lat_set(new_mpath,
+								    lat_wt);
+					cum_lat_wt += lat_wt;
+				}
 				if (debug) {
 					bgp_path_info_path_with_addpath_rx_str(
 						new_mpath, path_buf,
@@ -736,12 +854,29 @@ void bgp_path_info_mpath_update(struct bgp *bgp, struct bgp_dest *dest,
 		bgp_path_info_mpath_lb_update(new_best, true,
 					      all_paths_lb, cum_bw);
 
+		if (mpath_count <= 1)
+			all_paths_lat = false;
+		else if (all_paths_lat) {
+			lat_wt = bgp_twamp_path_weight(new_best);
+			if (!lat_wt)
+				all_paths_lat = false;
+			if (bgp_path_info_mpath_lat_set(new_best, lat_wt))
+				lat_wt_changed = true;
+			cum_lat_wt += lat_wt;
+		}
+		if (!all_paths_lat)
+			cum_lat_wt = 0;
+		bgp_path_info_mpath_lat_update(new_best, all_paths_lat,
+					       cum_lat_wt);
+
 		if (debug)
 			zlog_debug(
-				"%pRN(%s): New mpath count (incl newbest) %d mpath-change %s all_paths_lb %d cum_bw %" PRIu64,
+				"%pRN(%s): New mpath count (incl newbest) %d mpath-change %s all_paths_lb %d cum_bw %" PRIu64
+				" all_paths_lat %d cum_lat_wt %" PRIu64,
 				bgp_dest_to_rnode(dest), bgp->name_pretty,
 				mpath_count, mpath_changed ? "YES" : "NO",
-				all_paths_lb, cum_bw);
+				all_paths_lb, cum_bw, all_paths_lat,
+				cum_lat_wt);
 
 		if (mpath_changed
 		    || (bgp_path_info_mpath_count(new_best) != old_mpath_count))
@@ -749,6 +884,10 @@ void bgp_path_info_mpath_update(struct bgp *bgp, struct bgp_dest *dest,
 		if ((mpath_count - 1) != old_mpath_count ||
 		    old_cum_bw != cum_bw)
 			SET_FLAG(new_best->flags, BGP_PATH_LINK_BW_CHG);
+		/* Only the RIB cares about latency weights, not our peers */
+		if (old_cum_lat_wt != cum_lat_wt ||
+		    (all_paths_lat && lat_wt_changed))
+			SET_FLAG(new_best->flags, BGP_PATH_LATENCY_WT_CHG);
 	}
 }
 
@@ -774,6 +913,7 @@ void bgp_mp_dmed_deselect(struct bgp_path_info *dmed_best)
 	bgp_path_info_mpath_count_set(dmed_best, 0);
 	UNSET_FLAG(dmed_best->flags, BGP_PATH_MULTIPATH_CHG);
 	UNSET_FLAG(dmed_best->flags, BGP_PATH_LINK_BW_CHG);
+	UNSET_FLAG(dmed_best->flags, BGP_PATH_LATENCY_WT_CHG);
 	assert(bgp_path_info_mpath_first(dmed_best) == NULL);
 }
 
@@ -29,12 +29,19 @@ struct bgp_path_info_mpath {
 	uint16_t mp_flags;
 #define BGP_MP_LB_PRESENT 0x1 /* Link-bandwidth present for >= 1 path */
 #define BGP_MP_LB_ALL 0x2 /* Link-bandwidth present for all multipaths */
+#define BGP_MP_LAT_ALL 0x4 /* Latency measured for all multipaths */
 
 	/* Aggregated attribute for advertising multipath route */
 	struct attr *mp_attr;
 
 	/* Cumulative bandiwdth of all multipaths - attached to best path. */
 	uint64_t cum_bw;
+
+	/* Latency weight of this path as of the last multipath update */
+	uint64_t lat_wt;
+
+	/* Cumulative latency weight of all multipaths - attached to best path */
+	uint64_t cum_lat_wt;
 };
 
 /* Functions to support maximum-paths configuration */
@@ -78,5 +85,9 @@ extern struct attr *bgp_path_info_mpath_attr(struct bgp_path_info *path);
 extern bool bgp_path_info_mpath_chkwtd(struct bgp *bgp,
 				       struct bgp_path_info *path);
 extern uint64_t bgp_path_info_mpath_cumbw(struct bgp_path_info *path);
+extern bool bgp_path_info_mpath_chklat(struct bgp *bgp,
+				       struct bgp_path_info *path);
+extern uint64_t bgp_path_info_mpath_cumlat(struct bgp_path_info *path);
+extern uint64_t bgp_path_info_mpath_latwt(struct bgp_path_info *path);
 
 #endif /* _FRR_BGP_MPATH_H */
@@ -15,9 +15,12 @@
 #include "mpls.h"
 #include "json.h"
 #include "zclient.h"
+#include "jhash.h"
+#include "typesafe.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_trace.h"
 #include "bgpd/bgp_errors.h"
 #include "bgpd/bgp_table.h"
 #include "bgpd/bgp_route.h"
@@ -42,6 +45,7 @@
 
 DEFINE_MTYPE_STATIC(BGPD, MPLSVPN_NH_LABEL_BIND_CACHE,
 		    "BGP MPLSVPN nexthop label bind cache");
+DEFINE_MTYPE_STATIC(BGPD, VPN_IMPORT_INDEX, "BGP VPN import RT index");
 
 /*
  * Definitions and external declarations.
@@ -293,7 +297,7 @@ void vpn_leak_zebra_vrf_label_update(struct bgp *bgp, afi_t afi)
 	int debug = BGP_DEBUG(vpn, VPN_LEAK_LABEL);
 
 	if (bgp->vrf_id == VRF_UNKNOWN) {
-		if (1) {
+		if (debug) {
 			zlog_debug(
 				"%s: vrf %s: afi %s: vrf_id not set, can't set zebra vrf label",
 				__func__, bgp->name_pretty, afi2str(afi));
@@ -305,7 +309,7 @@ void vpn_leak_zebra_vrf_label_update(struct bgp *bgp, afi_t afi)
 		label = bgp->vpn_policy[afi].tovpn_label;
 	}
 
-	if (1) {
+	if (debug) {
 		zlog_debug("%s: vrf %s: afi %s: setting label %d for vrf id %d",
 			   __func__, bgp->name_pretty, afi2str(afi), label,
 			   bgp->vrf_id);
@@ -327,7 +331,7 @@ void vpn_leak_zebra_vrf_label_withdraw(struct bgp *bgp, afi_t afi)
 	int debug = BGP_DEBUG(vpn, VPN_LEAK_LABEL);
 
 	if (bgp->vrf_id == VRF_UNKNOWN) {
-		if (1) {
+		if (debug) {
 			zlog_debug(
 				"%s: vrf_id not set, can't delete zebra vrf label",
 				__func__);
@@ -335,7 +339,7 @@ void vpn_leak_zebra_vrf_label_withdraw(struct bgp *bgp, afi_t afi)
 		return;
 	}
 
-	if (1) {
+	if (debug) {
 		zlog_debug("%s: deleting label for vrf %s (id=%d)", __func__,
 			   bgp->name_pretty, bgp->vrf_id);
 	}
@@ -359,7 +363,7 @@ void vpn_leak_zebra_vrf_sid_update_per_af(struct bgp *bgp, afi_t afi)
 	struct vrf *vrf;
 
 	if (bgp->vrf_id == VRF_UNKNOWN) {
-		if (1)
+		if (debug)
 			zlog_debug("%s: vrf %s: afi %s: vrf_id not set, can't set zebra vrf label",
 				   __func__, bgp->name_pretty, afi2str(afi));
 		return;
@@ -367,13 +371,13 @@ void vpn_leak_zebra_vrf_sid_update_per_af(struct bgp *bgp, afi_t afi)
 
 	tovpn_sid = bgp->vpn_policy[afi].tovpn_sid;
 	if (!tovpn_sid) {
-		if (1)
+		if (debug)
 			zlog_debug("%s: vrf %s: afi %s: sid not set", __func__,
 				   bgp->name_pretty, afi2str(afi));
 		return;
 	}
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: vrf %s: afi %s: setting sid %pI6 for vrf id %d",
 			   __func__, bgp->name_pretty, afi2str(afi), tovpn_sid,
 			   bgp->vrf_id);
@@ -416,7 +420,7 @@ void vpn_leak_zebra_vrf_sid_update_per_vrf(struct bgp *bgp)
 	struct vrf *vrf;
 
 	if (bgp->vrf_id == VRF_UNKNOWN) {
-		if (1)
+		if (debug)
 			zlog_debug(
 				"%s: vrf %s: vrf_id not set, can't set zebra vrf label",
 				__func__, bgp->name_pretty);
@@ -425,13 +429,13 @@ void vpn_leak_zebra_vrf_sid_update_per_vrf(struct bgp *bgp)
 
 	tovpn_sid = bgp->tovpn_sid;
 	if (!tovpn_sid) {
-		if (1)
+		if (debug)
 			zlog_debug("%s: vrf %s: sid not set", __func__,
 				   bgp->name_pretty);
 		return;
 	}
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: vrf %s: setting sid %pI6 for vrf id %d",
 			   __func__, bgp->name_pretty, tovpn_sid, bgp->vrf_id);
 
@@ -471,7 +475,7 @@ void vpn_leak_zebra_vrf_sid_update(struct bgp *bgp, afi_t afi)
 	if (bgp->tovpn_sid)
 		return vpn_leak_zebra_vrf_sid_update_per_vrf(bgp);
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: vrf %s: afi %s: sid not set", __func__,
 			   bgp->name_pretty, afi2str(afi));
 }
@@ -486,13 +490,13 @@ void vpn_leak_zebra_vrf_sid_withdraw_per_af(struct bgp *bgp, afi_t afi)
 	struct seg6local_context seg6localctx = {};
 
 	if (bgp->vrf_id == VRF_UNKNOWN) {
-		if (1)
+		if (debug)
 			zlog_debug("%s: vrf %s: afi %s: vrf_id not set, can't set zebra vrf label",
 				   __func__, bgp->name_pretty, afi2str(afi));
 		return;
 	}
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: deleting sid for vrf %s afi (id=%d)", __func__,
 			   bgp->name_pretty, bgp->vrf_id);
 
@@ -521,14 +525,14 @@ void vpn_leak_zebra_vrf_sid_withdraw_per_vrf(struct bgp *bgp)
 	struct seg6local_context seg6localctx = {};
 
 	if (bgp->vrf_id == VRF_UNKNOWN) {
-		if (1)
+		if (debug)
 			zlog_debug(
 				"%s: vrf %s: vrf_id not set, can't set zebra vrf label",
 				__func__, bgp->name_pretty);
 		return;
 	}
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: deleting sid for vrf %s (id=%d)", __func__,
 			   bgp->name_pretty, bgp->vrf_id);
 
@@ -565,7 +569,7 @@ int vpn_leak_label_callback(
 	struct vpn_policy *vp = (struct vpn_policy *)labelid;
 	int debug = BGP_DEBUG(vpn, VPN_LEAK_LABEL);
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: label=%u, allocated=%d",
 			__func__, label, allocated);
 
@@ -685,7 +689,7 @@ static uint32_t alloc_new_sid(struct bgp *bgp, uint32_t index,
 	for (ALL_LIST_ELEMENTS_RO(bgp->srv6_locator_chunks, node, chunk)) {
 		if (chunk->function_bits_length >
 		    BGP_PREFIX_SID_SRV6_MAX_FUNCTION_LENGTH) {
-			if (1)
+			if (debug)
 				zlog_debug(
 					"%s: invalid SRv6 Locator chunk (%pFX): Function Length must be less or equal to %d",
 					__func__, &chunk->prefix,
@@ -696,7 +700,7 @@ static uint32_t alloc_new_sid(struct bgp *bgp, uint32_t index,
 		index_max = (1 << chunk->function_bits_length) - 1;
 
 		if (index > index_max) {
-			if (1)
+			if (debug)
 				zlog_debug(
 					"%s: skipped SRv6 Locator chunk (%pFX): Function Length is too short to support specified index (%u)",
 					__func__, &chunk->prefix, index);
@@ -712,7 +716,7 @@ static uint32_t alloc_new_sid(struct bgp *bgp, uint32_t index,
 		if (index != 0) {
 			label = index << shift_len;
 			if (label < MPLS_LABEL_UNRESERVED_MIN) {
-				if (1)
+				if (debug)
 					zlog_debug(
 						"%s: skipped to allocate SRv6 SID (%pFX): Label (%u) is too small to use",
 						__func__, &chunk->prefix,
@@ -730,7 +734,7 @@ static uint32_t alloc_new_sid(struct bgp *bgp, uint32_t index,
 		for (uint32_t i = 1; i < index_max; i++) {
 			label = i << shift_len;
 			if (label < MPLS_LABEL_UNRESERVED_MIN) {
-				if (1)
+				if (debug)
 					zlog_debug(
 						"%s: skipped to allocate SRv6 SID (%pFX): Label (%u) is too small to use",
 						__func__, &chunk->prefix,
@@ -761,7 +765,7 @@ void ensure_vrf_tovpn_sid_per_af(struct bgp *bgp_vpn, struct bgp *bgp_vrf,
 	uint32_t tovpn_sid_index = 0, tovpn_sid_transpose_label;
 	bool tovpn_sid_auto = false;
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: try to allocate new SID for vrf %s: afi %s",
 			   __func__, bgp_vrf->name_pretty, afi2str(afi));
 
@@ -798,7 +802,7 @@ void ensure_vrf_tovpn_sid_per_af(struct bgp *bgp_vpn, struct bgp *bgp_vrf,
 						  tovpn_sid_locator, tovpn_sid);
 
 	if (tovpn_sid_transpose_label == 0) {
-		if (1)
+		if (debug)
 			zlog_debug(
 				"%s: not allocated new sid for vrf %s: afi %s",
 				__func__, bgp_vrf->name_pretty, afi2str(afi));
@@ -807,7 +811,7 @@ void ensure_vrf_tovpn_sid_per_af(struct bgp *bgp_vpn, struct bgp *bgp_vrf,
 		return;
 	}
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: new sid %pI6 allocated for vrf %s: afi %s",
 			   __func__, tovpn_sid, bgp_vrf->name_pretty,
 			   afi2str(afi));
@@ -826,7 +830,7 @@ void ensure_vrf_tovpn_sid_per_vrf(struct bgp *bgp_vpn, struct bgp *bgp_vrf)
 	uint32_t tovpn_sid_index = 0, tovpn_sid_transpose_label;
 	bool tovpn_sid_auto = false;
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: try to allocate new SID for vrf %s", __func__,
 			   bgp_vrf->name_pretty);
 
@@ -862,7 +866,7 @@ void ensure_vrf_tovpn_sid_per_vrf(struct bgp *bgp_vpn, struct bgp *bgp_vrf)
 						  tovpn_sid_locator, tovpn_sid);
 
 	if (tovpn_sid_transpose_label == 0) {
-		if (1)
+		if (debug)
 			zlog_debug("%s: not allocated new sid for vrf %s",
 				   __func__, bgp_vrf->name_pretty);
 		srv6_locator_chunk_free(&tovpn_sid_locator);
@@ -870,7 +874,7 @@ void ensure_vrf_tovpn_sid_per_vrf(struct bgp *bgp_vpn, struct bgp *bgp_vrf)
 		return;
 	}
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: new sid %pI6 allocated for vrf %s", __func__,
 			   tovpn_sid, bgp_vrf->name_pretty);
 
@@ -900,7 +904,7 @@ void delete_vrf_tovpn_sid_per_af(struct bgp *bgp_vpn, struct bgp *bgp_vrf,
 	uint32_t tovpn_sid_index = 0;
 	bool tovpn_sid_auto = false;
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: try to remove SID for vrf %s: afi %s", __func__,
 			   bgp_vrf->name_pretty, afi2str(afi));
 
@@ -927,7 +931,7 @@ void delete_vrf_tovpn_sid_per_vrf(struct bgp *bgp_vpn, struct bgp *bgp_vrf)
 	uint32_t tovpn_sid_index = 0;
 	bool tovpn_sid_auto = false;
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: try to remove SID for vrf %s", __func__,
 			   bgp_vrf->name_pretty);
 
@@ -1093,7 +1097,7 @@ static bool leak_update_nexthop_valid(struct bgp *to_bgp, struct bgp_dest *bn,
 		nh_valid = false;
 	}
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: %pFX nexthop is %svalid (in %s)", __func__, p,
 			   (nh_valid ? "" : "not "), bgp_nexthop->name_pretty);
 
@@ -1116,7 +1120,7 @@ leak_update(struct bgp *to_bgp, struct bgp_dest *bn,
 	struct bgp_path_info_extra *extra;
 	struct bgp_path_info *parent = source_bpi;
 
-	if (1)
+	if (debug)
 		zlog_debug(
 			"%s: entry: leak-to=%s, p=%pBD, type=%d, sub_type=%d",
 			__func__, to_bgp->name_pretty, bn, source_bpi->type,
@@ -1154,7 +1158,7 @@ leak_update(struct bgp *to_bgp, struct bgp_dest *bn,
 
 		if (CHECK_FLAG(source_bpi->flags, BGP_PATH_REMOVED)
 		    && CHECK_FLAG(bpi->flags, BGP_PATH_REMOVED)) {
-			if (1) {
+			if (debug) {
 				zlog_debug(
 					"%s: ->%s(s_flags: 0x%x b_flags: 0x%x): %pFX: Found route, being removed, not leaking",
 					__func__, to_bgp->name_pretty,
@@ -1167,7 +1171,7 @@ leak_update(struct bgp *to_bgp, struct bgp_dest *bn,
 		    && !CHECK_FLAG(bpi->flags, BGP_PATH_REMOVED)) {
 
 			bgp_attr_unintern(&new_attr);
-			if (1)
+			if (debug)
 				zlog_debug(
 					"%s: ->%s: %pBD: Found route, no change",
 					__func__, to_bgp->name_pretty, bn);
@@ -1231,7 +1235,7 @@ leak_update(struct bgp *to_bgp, struct bgp_dest *bn,
 		bgp_aggregate_increment(to_bgp, p, bpi, afi, safi);
 		bgp_process(to_bgp, bn, afi, safi);
 
-		if (1)
+		if (debug)
 			zlog_debug("%s: ->%s: %pBD Found route, changed attr",
 				   __func__, to_bgp->name_pretty, bn);
 
@@ -1241,7 +1245,7 @@ leak_update(struct bgp *to_bgp, struct bgp_dest *bn,
 	}
 
 	if (CHECK_FLAG(source_bpi->flags, BGP_PATH_REMOVED)) {
-		if (1) {
+		if (debug) {
 			zlog_debug(
 				"%s: ->%s(s_flags: 0x%x): %pFX: New route, being removed, not leaking",
 				__func__, to_bgp->name_pretty,
@@ -1292,7 +1296,7 @@ leak_update(struct bgp *to_bgp, struct bgp_dest *bn,
 
 	bgp_process(to_bgp, bn, afi, safi);
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: ->%s: %pBD: Added new route", __func__,
 			   to_bgp->name_pretty, bn);
 
@@ -1339,7 +1343,7 @@ static int bgp_mplsvpn_get_label_per_nexthop_cb(mpls_label_t label,
 
 	old_label = blnc->label;
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: label=%u, allocated=%d, nexthop=%pFX", __func__,
 			   label, allocated, &blnc->nexthop);
 	if (allocated)
@@ -1584,7 +1588,7 @@ void vpn_leak_from_vrf_update(struct bgp *to_bgp,	     /* to */
 	const char *debugmsg;
 	int nexthop_self_flag = 0;
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: from vrf %s", __func__, from_bgp->name_pretty);
 
 	if (debug && bgp_attr_get_ecommunity(path_vrf->attr)) {
@@ -1601,7 +1605,7 @@ void vpn_leak_from_vrf_update(struct bgp *to_bgp,	     /* to */
 		return;
 
 	if (!afi) {
-		if (1)
+		if (debug)
 			zlog_debug("%s: can't get afi of prefix", __func__);
 		return;
 	}
@@ -1611,7 +1615,7 @@ void vpn_leak_from_vrf_update(struct bgp *to_bgp,	     /* to */
 		return;
 
 	if (!vpn_leak_to_vpn_active(from_bgp, afi, &debugmsg)) {
-		if (1)
+		if (debug)
 			zlog_debug("%s: %s skipping: %s", __func__,
 				   from_bgp->name, debugmsg);
 		return;
@@ -1630,12 +1634,12 @@ void vpn_leak_from_vrf_update(struct bgp *to_bgp,	     /* to */
 		memset(&info, 0, sizeof(info));
 		info.peer = to_bgp->peer_self;
 		info.attr = &static_attr;
-		ret = route_map_apply(from_bgp->vpn_policy[afi]
-					      .rmap[BGP_VPN_POLICY_DIR_TOVPN],
-				      p, &info);
+		ret = bgp_route_map_apply_cached(
+			from_bgp->vpn_policy[afi].rmap[BGP_VPN_POLICY_DIR_TOVPN],
+			p, &info);
 		if (RMAP_DENYMATCH == ret) {
 			bgp_attr_flush(&static_attr); /* free any added parts */
-			if (1)
+			if (debug)
 				zlog_debug(
 					"%s: vrf %s route map \"%s\" says DENY, returning",
 					__func__, from_bgp->name_pretty,
@@ -1775,7 +1779,7 @@ void vpn_leak_from_vrf_update(struct bgp *to_bgp,	     /* to */
 		 * when the 'bgp_mplsvpn_get_label_per_nexthop_cb' callback gets
 		 * a valid label value, it will call the current function again.
 		 */
-		if (1)
+		if (debug)
 			zlog_debug(
 				"%s: %s skipping: waiting for a valid per-label nexthop.",
 				__func__, from_bgp->name_pretty);
@@ -1915,7 +1919,7 @@ void vpn_leak_from_vrf_withdraw(struct bgp *to_bgp,		/* to */
 	struct bgp_dest *bn;
 	const char *debugmsg;
 
-	if (1) {
+	if (debug) {
 		zlog_debug(
 			"%s: entry: leak-from=%s, p=%pBD, type=%d, sub_type=%d",
 			__func__, from_bgp->name_pretty, path_vrf->net,
@@ -1926,7 +1930,7 @@ void vpn_leak_from_vrf_withdraw(struct bgp *to_bgp,		/* to */
 		return;
 
 	if (!afi) {
-		if (1)
+		if (debug)
 			zlog_debug("%s: can't get afi of prefix", __func__);
 		return;
 	}
@@ -1936,12 +1940,12 @@ void vpn_leak_from_vrf_withdraw(struct bgp *to_bgp,		/* to */
 		return;
 
 	if (!vpn_leak_to_vpn_active(from_bgp, afi, &debugmsg)) {
-		if (1)
+		if (debug)
 			zlog_debug("%s: skipping: %s", __func__, debugmsg);
 		return;
 	}
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: withdrawing (path_vrf=%p)", __func__, path_vrf);
 
 	bn = bgp_afi_node_get(to_bgp->rib[afi][safi], afi, safi, p,
@@ -2002,7 +2006,7 @@ void vpn_leak_from_vrf_withdraw_all(struct bgp *to_bgp, struct bgp *from_bgp,
 			}
 
 			for (; bpi; bpi = bpi->next) {
-				if (1)
+				if (debug)
 					zlog_debug("%s: type %d, sub_type %d",
 						   __func__, bpi->type,
 						   bpi->sub_type);
@@ -2013,7 +2017,7 @@ void vpn_leak_from_vrf_withdraw_all(struct bgp *to_bgp, struct bgp *from_bgp,
 				if ((struct bgp *)bpi->extra->vrfleak->bgp_orig ==
 				    from_bgp) {
 					/* delete route */
-					if (1)
+					if (debug)
 						zlog_debug("%s: deleting it",
 							   __func__);
 					/* withdraw from leak-to vrfs as well */
@@ -2038,19 +2042,19 @@ void vpn_leak_from_vrf_update_all(struct bgp *to_bgp, struct bgp *from_bgp,
 	struct bgp_path_info *bpi;
 	int debug = BGP_DEBUG(vpn, VPN_LEAK_FROM_VRF);
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: entry, afi=%d, vrf=%s", __func__, afi,
 			   from_bgp->name_pretty);
 
 	for (bn = bgp_table_top(from_bgp->rib[afi][SAFI_UNICAST]); bn;
 	     bn = bgp_route_next(bn)) {
 
-		if (1)
+		if (debug)
 			zlog_debug("%s: node=%p", __func__, bn);
 
 		for (bpi = bgp_dest_get_bgp_path_info(bn); bpi;
 		     bpi = bpi->next) {
-			if (1)
+			if (debug)
 				zlog_debug(
 					"%s: calling vpn_leak_from_vrf_update",
 					__func__);
@@ -2114,7 +2118,7 @@ static void vpn_leak_to_vrf_update_onevrf(struct bgp *to_bgp,   /* to */
 	int debug = BGP_DEBUG(vpn, VPN_LEAK_TO_VRF);
 
 	if (!vpn_leak_from_vpn_active(to_bgp, afi, &debugmsg)) {
-		if (1)
+		if (debug)
 			zlog_debug(
 				"%s: from vpn (%s) to vrf (%s), skipping: %s",
 				__func__, from_bgp->name_pretty,
@@ -2143,7 +2147,7 @@ static void vpn_leak_to_vrf_update_onevrf(struct bgp *to_bgp,   /* to */
 	if (!ecommunity_include(
 		    to_bgp->vpn_policy[afi].rtlist[BGP_VPN_POLICY_DIR_FROMVPN],
 		    bgp_attr_get_ecommunity(path_vpn->attr))) {
-		if (1)
+		if (debug)
 			zlog_debug(
 				"from vpn (%s) to vrf (%s), skipping after no intersection of route targets",
 				from_bgp->name_pretty, to_bgp->name_pretty);
@@ -2160,14 +2164,14 @@ static void vpn_leak_to_vrf_update_onevrf(struct bgp *to_bgp,   /* to */
 	if (CHECK_FLAG(path_vpn->flags, BGP_PATH_ACCEPT_OWN) && prd &&
 	    memcmp(&prd->val, &to_bgp->vpn_policy[afi].tovpn_rd.val,
 		   ECOMMUNITY_SIZE) == 0) {
-		if (1)
+		if (debug)
 			zlog_debug(
 				"%s: skipping import, match RD (%s) of src VRF (%s) and the prefix (%pFX)",
 				__func__, rd_buf, to_bgp->name_pretty, p);
 		return;
 	}
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: updating RD %s, %pFX to %s", __func__, rd_buf,
 			   p, to_bgp->name_pretty);
 
@@ -2263,12 +2267,13 @@ static void vpn_leak_to_vrf_update_onevrf(struct bgp *to_bgp,   /* to */
 		info.peer = to_bgp->peer_self;
 		info.attr = &static_attr;
 		info.extra = path_vpn->extra; /* Used for source-vrf filter */
-		ret = route_map_apply(to_bgp->vpn_policy[afi]
-					      .rmap[BGP_VPN_POLICY_DIR_FROMVPN],
-				      p, &info);
+		info.nexthop = path_vpn->nexthop; /* Used for latency policy */
+		ret = bgp_route_map_apply_cached(
+			to_bgp->vpn_policy[afi].rmap[BGP_VPN_POLICY_DIR_FROMVPN],
+			p, &info);
 		if (RMAP_DENYMATCH == ret) {
 			bgp_attr_flush(&static_attr); /* free any added parts */
-			if (1)
+			if (debug)
 				zlog_debug(
 					"%s: vrf %s vpn-policy route map \"%s\" says DENY, returning",
 					__func__, to_bgp->name_pretty,
@@ -2287,38 +2292,28 @@ static void vpn_leak_to_vrf_update_onevrf(struct bgp *to_bgp,   /* to */
 
 
 	/* TWAMP: Set weight based on latency measurements */
-		fprintf(stderr, "*** TWAMP WEIGHT: Checking latency for import, enabled=%d\n", to_bgp->import_latency_cfg.enabled); fflush(stderr);
-	if (to_bgp->import_latency_cfg.enabled && path_vpn->peer && 
+	if (to_bgp->import_latency_cfg.enabled && path_vpn->peer &&
 	    path_vpn->peer->sort == BGP_PEER_IBGP) {
-		fprintf(stderr, "*** TWAMP WEIGHT: path_vpn->peer=%p, sort=%d\n", (void*)path_vpn->peer, path_vpn->peer->sort); fflush(stderr);
-		struct bgp_path_info *path_ultimate = bgp_get_imported_bpi_ultimate(path_vpn);
-		fprintf(stderr, "*** TWAMP WEIGHT: path_ultimate=%p, path_ultimate->peer=%p\n", (void*)path_ultimate, path_ultimate ? (void*)path_ultimate->peer : NULL); fflush(stderr);
-		if (path_ultimate->peer && path_ultimate->peer->connection && 
-		    path_ultimate->peer->connection->su.sa.sa_family == AF_INET) {
-			fprintf(stderr, "*** TWAMP WEIGHT: Inside AF_INET check, getting peer IP\n"); fflush(stderr);
-			struct in_addr peer_ip;
-			peer_ip.s_addr = path_ultimate->peer->connection->su.sin.sin_addr.s_addr;
-			char ip_str[INET_ADDRSTRLEN];
-			inet_ntop(AF_INET, &peer_ip, ip_str, sizeof(ip_str));
-			fprintf(stderr, "*** TWAMP WEIGHT: Calling bgp_twamp_get_latency for %s\n", ip_str); fflush(stderr);
-			uint32_t latency = bgp_twamp_get_latency(&peer_ip);
-			fprintf(stderr, "*** TWAMP WEIGHT: Got latency=%u (UINT32_MAX=%u)\n", latency, UINT32_MAX); fflush(stderr);
-			
-			if (latency != UINT32_MAX) {
-				/* Set weight based on latency */
-				if (latency <= to_bgp->import_latency_cfg.damping_threshold) {
-					/* Low latency - set high weight */
-					static_attr.weight = 32768;
-					fprintf(stderr, "TWAMP: Setting weight=32768 for low latency (%ums <= %ums threshold)\n", latency, to_bgp->import_latency_cfg.damping_threshold); fflush(stderr);
-				} else {
-					/* High latency - set low weight */
-					static_attr.weight = 0;
-					fprintf(stderr, "TWAMP: Setting weight=0 for high latency (%ums > %ums threshold)\n", latency, to_bgp->import_latency_cfg.damping_threshold); fflush(stderr);
-				}
-			} else {
-				fprintf(stderr, "TWAMP: Peer latency not measured, using default weight\n"); fflush(stderr);
-                }
-        }
+		uint32_t latency = bgp_twamp_import_latency(path_vpn);
+
+		/* Low latency gets a high weight; unmeasured paths keep theirs */
+		if (latency != UINT32_MAX)
+			static_attr.weight =
+				latency <= to_bgp->import_latency_cfg
+						   .damping_threshold_us
+					? 32768
+					: 0;
+
+		frrtrace(4, frr_bgp, twamp_import_weight, to_bgp, p, latency,
+			 static_attr.weight);
+		if (BGP_DEBUG(twamp, TWAMP))
+			zlog_debug("%s: vrf %s %pFX latency %uus (threshold %uus), weight %u",
+				   __func__, to_bgp->name_pretty, p, latency,
+				   to_bgp->import_latency_cfg
+					   .damping_threshold_us,
+				   static_attr.weight);
+	}
+
 	new_attr = bgp_attr_intern(&static_attr);
 	bgp_attr_flush(&static_attr);
 
@@ -2363,7 +2358,7 @@ static void vpn_leak_to_vrf_update_onevrf(struct bgp *to_bgp,   /* to */
 		}
 	}
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: pfx %pBD: num_labels %d", __func__,
 			   path_vpn->net, num_labels);
 
@@ -2372,6 +2367,205 @@ static void vpn_leak_to_vrf_update_onevrf(struct bgp *to_bgp,   /* to */
 			 debug))
 		bgp_dest_unlock_node(bn);
 }
+
+/*
+ * Which VRFs import which route targets from VPN, so a VPN path only visits
+ * the VRFs it could be imported into instead of every instance. Built on
+ * first use and dropped whenever an import RT list or the set of instances
+ * changes. Import lists of anything but plain 8-byte RTs are not indexed;
+ * their VRFs are tried for every path, as before.
+ */
+PREDECL_HASH(vpn_import_rts);
+
+struct vpn_import_rt {
+	struct vpn_import_rts_item item;
+
+	uint8_t val[ECOMMUNITY_SIZE];
+
+	unsigned int count, max;
+	struct bgp **vrfs;
+};
+
+static int vpn_import_rt_cmp(const struct vpn_import_rt *a,
+			     const struct vpn_import_rt *b)
+{
+	return memcmp(a->val, b->val, ECOMMUNITY_SIZE);
+}
+
+static uint32_t vpn_import_rt_hash(const struct vpn_import_rt *rt)
+{
+	return jhash(rt->val, ECOMMUNITY_SIZE, 0x5197a3e1);
+}
+
+DECLARE_HASH(vpn_import_rts, struct vpn_import_rt, item, vpn_import_rt_cmp,
+	     vpn_import_rt_hash);
+
+static struct {
+	bool valid;
+
+	struct vpn_import_rts_head rts[AFI_MAX];
+	/* VRFs with import RTs the hash can't key on */
+	struct vpn_import_rt others[AFI_MAX];
+} vpn_import_index;
+
+static void vpn_import_rt_add(struct vpn_import_rt *rt, struct bgp *bgp)
+{
+	/* An import list may name the same RT twice */
+	if (rt->count && rt->vrfs[rt->count - 1] == bgp)
+		return;
+
+	if (rt->count == rt->max) {
+		rt->max = rt->max ? rt->max * 2 : 4;
+		rt->vrfs = XREALLOC(MTYPE_VPN_IMPORT_INDEX, rt->vrfs,
+				    rt->max * sizeof(*rt->vrfs));
+	}
+	rt->vrfs[rt->count++] = bgp;
+}
+
+void vpn_leak_import_index_invalidate(void)
+{
+	struct vpn_import_rt *rt;
+	afi_t afi;
+
+	if (!vpn_import_index.valid)
+		return;
+
+	for (afi = 0; afi < AFI_MAX; afi++) {
+		while ((rt = vpn_import_rts_pop(&vpn_import_index.rts[afi]))) {
+			XFREE(MTYPE_VPN_IMPORT_INDEX, rt->vrfs);
+			XFREE(MTYPE_VPN_IMPORT_INDEX, rt);
+		}
+		vpn_import_rts_fini(&vpn_import_index.rts[afi]);
+
+		XFREE(MTYPE_VPN_IMPORT_INDEX, vpn_import_index.others[afi].vrfs);
+		vpn_import_index.others[afi].count = 0;
+		vpn_import_index.others[afi].max = 0;
+	}
+	vpn_import_index.valid = false;
+}
+
+static void vpn_import_index_build(void)
+{
+	struct vpn_import_rt ref, *rt;
+	struct ecommunity *ecom;
+	struct listnode *node;
+	struct bgp *bgp;
+	uint32_t i;
+	afi_t afi;
+
+	for (afi = 0; afi < AFI_MAX; afi++)
+		vpn_import_rts_init(&vpn_import_index.rts[afi]);
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp)) {
+		for (afi = 0; afi < AFI_MAX; afi++) {
+			ecom = bgp->vpn_policy[afi]
+				       .rtlist[BGP_VPN_POLICY_DIR_FROMVPN];
+			if (!ecom || !ecom->size)
+				continue;
+
+			if (ecom->unit_size != ECOMMUNITY_SIZE) {
+				vpn_import_rt_add(&vpn_import_index.others[afi],
+						  bgp);
+				continue;
+			}
+
+			for (i = 0; i < ecom->size; i++) {
+				memcpy(ref.val, ecom->val + i * ECOMMUNITY_SIZE,
+				       ECOMMUNITY_SIZE);
+				rt = vpn_import_rts_find(
+					&vpn_import_index.rts[afi], &ref);
+				if (!rt) {
+					rt = XCALLOC(MTYPE_VPN_IMPORT_INDEX,
+						     sizeof(*rt));
+					memcpy(rt->val, ref.val,
+					       ECOMMUNITY_SIZE);
+					vpn_import_rts_add(
+						&vpn_import_index.rts[afi], rt);
+				}
+				vpn_import_rt_add(rt, bgp);
+			}
+		}
+	}
+	vpn_import_index.valid = true;
+}
+
+/*
+ * The instances a path carrying ecom may be imported into, each once, to
+ * be checked further by the caller. Filled into a buffer of the caller's,
+ * since importing into one VRF may come back here.
+ */
+#define VPN_IMPORT_SET_LOCAL 32
+
+struct vpn_import_set {
+	unsigned int count, max;
+	struct bgp **vrfs;
+	struct bgp *local[VPN_IMPORT_SET_LOCAL];
+};
+
+static void vpn_import_set_add(struct vpn_import_set *set, struct bgp *bgp)
+{
+	unsigned int i;
+
+	for (i = 0; i < set->count; i++)
+		if (set->vrfs[i] == bgp)
+			return;
+
+	if (set->count == set->max) {
+		set->max *= 2;
+		if (set->vrfs == set->local) {
+			set->vrfs = XMALLOC(MTYPE_VPN_IMPORT_INDEX,
+					    set->max * sizeof(*set->vrfs));
+			memcpy(set->vrfs, set->local, sizeof(set->local));
+		} else
+			set->vrfs = XREALLOC(MTYPE_VPN_IMPORT_INDEX, set->vrfs,
+					     set->max * sizeof(*set->vrfs));
+	}
+	set->vrfs[set->count++] = bgp;
+}
+
+static void vpn_import_set_get(struct vpn_import_set *set, afi_t afi,
+			       struct ecommunity *ecom)
+{
+	struct vpn_import_rt ref, *rt;
+	struct listnode *node;
+	struct bgp *bgp;
+	uint32_t i, j;
+
+	set->count = 0;
+	set->max = VPN_IMPORT_SET_LOCAL;
+	set->vrfs = set->local;
+
+	/* Nothing carrying no RT is ever imported */
+	if (!ecom || !ecom->size)
+		return;
+
+	if (ecom->unit_size != ECOMMUNITY_SIZE) {
+		for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+			vpn_import_set_add(set, bgp);
+		return;
+	}
+
+	if (!vpn_import_index.valid)
+		vpn_import_index_build();
+
+	for (i = 0; i < vpn_import_index.others[afi].count; i++)
+		vpn_import_set_add(set, vpn_import_index.others[afi].vrfs[i]);
+
+	for (i = 0; i < ecom->size; i++) {
+		memcpy(ref.val, ecom->val + i * ECOMMUNITY_SIZE,
+		       ECOMMUNITY_SIZE);
+		rt = vpn_import_rts_find(&vpn_import_index.rts[afi], &ref);
+		if (!rt)
+			continue;
+		for (j = 0; j < rt->count; j++)
+			vpn_import_set_add(set, rt->vrfs[j]);
+	}
+}
+
+static void vpn_import_set_done(struct vpn_import_set *set)
+{
+	if (set->vrfs != set->local)
+		XFREE(MTYPE_VPN_IMPORT_INDEX, set->vrfs);
 }
 
 bool vpn_leak_to_vrf_no_retain_filter_check(struct bgp *from_bgp,
@@ -2379,14 +2573,17 @@ bool vpn_leak_to_vrf_no_retain_filter_check(struct bgp *from_bgp,
 {
 	struct ecommunity *ecom_route_target = bgp_attr_get_ecommunity(attr);
 	int debug = BGP_DEBUG(vpn, VPN_LEAK_TO_VRF);
-	struct listnode *node;
+	struct vpn_import_set set;
 	const char *debugmsg;
 	struct bgp *to_bgp;
+	unsigned int i;
 
-	/* Loop over BGP instances */
-	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, to_bgp)) {
+	/* Loop over the BGP instances importing any of the RTs */
+	vpn_import_set_get(&set, afi, ecom_route_target);
+	for (i = 0; i < set.count; i++) {
+		to_bgp = set.vrfs[i];
 		if (!vpn_leak_from_vpn_active(to_bgp, afi, &debugmsg)) {
-			if (1)
+			if (debug)
 				zlog_debug(
 					"%s: from vpn (%s) to vrf (%s) afi %s, skipping: %s",
 					__func__, from_bgp->name_pretty,
@@ -2400,7 +2597,7 @@ bool vpn_leak_to_vrf_no_retain_filter_check(struct bgp *from_bgp,
 			    to_bgp->vpn_policy[afi]
 				    .rtlist[BGP_VPN_POLICY_DIR_FROMVPN],
 			    ecom_route_target)) {
-			if (1)
+			if (debug)
 				zlog_debug(
 					"%s: from vpn (%s) to vrf (%s) afi %s %s, skipping after no intersection of route targets",
 					__func__, from_bgp->name_pretty,
@@ -2408,10 +2605,12 @@ bool vpn_leak_to_vrf_no_retain_filter_check(struct bgp *from_bgp,
 					ecommunity_str(ecom_route_target));
 			continue;
 		}
+		vpn_import_set_done(&set);
 		return false;
 	}
+	vpn_import_set_done(&set);
 
-	if (1)
+	if (debug)
 		zlog_debug(
 			"%s: from vpn (%s) afi %s %s, no import - must be filtered",
 			__func__, from_bgp->name_pretty, afi2str(afi),
@@ -2424,22 +2623,28 @@ void vpn_leak_to_vrf_update(struct bgp *from_bgp,
 			    struct bgp_path_info *path_vpn,
 			    struct prefix_rd *prd)
 {
-	struct listnode *mnode, *mnnode;
+	const struct prefix *p = bgp_dest_get_prefix(path_vpn->net);
+	struct vpn_import_set set;
 	struct bgp *bgp;
+	unsigned int i;
 
 	int debug = BGP_DEBUG(vpn, VPN_LEAK_TO_VRF);
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: start (path_vpn=%p)", __func__, path_vpn);
 
-	/* Loop over VRFs */
-	for (ALL_LIST_ELEMENTS(bm->bgp, mnode, mnnode, bgp)) {
+	/* Loop over the VRFs importing any of the RTs */
+	vpn_import_set_get(&set, family2afi(p->family),
+			   bgp_attr_get_ecommunity(path_vpn->attr));
+	for (i = 0; i < set.count; i++) {
+		bgp = set.vrfs[i];
 		if (!path_vpn->extra || !path_vpn->extra->vrfleak ||
 		    path_vpn->extra->vrfleak->bgp_orig != bgp) { /* no loop */
 			vpn_leak_to_vrf_update_onevrf(bgp, from_bgp, path_vpn,
 						      prd);
 		}
 	}
+	vpn_import_set_done(&set);
 }
 
 void vpn_leak_to_vrf_withdraw(struct bgp_path_info *path_vpn)
@@ -2448,18 +2653,19 @@ void vpn_leak_to_vrf_withdraw(struct bgp_path_info *path_vpn)
 	afi_t afi;
 	safi_t safi = SAFI_UNICAST;
 	struct bgp *bgp;
-	struct listnode *mnode, *mnnode;
+	struct vpn_import_set set;
+	unsigned int i;
 	struct bgp_dest *bn;
 	struct bgp_path_info *bpi;
 	const char *debugmsg;
 
 	int debug = BGP_DEBUG(vpn, VPN_LEAK_TO_VRF);
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: entry: p=%pBD, type=%d, sub_type=%d", __func__,
 			   path_vpn->net, path_vpn->type, path_vpn->sub_type);
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: start (path_vpn=%p)", __func__, path_vpn);
 
 	if (!path_vpn->net) {
@@ -2471,7 +2677,7 @@ void vpn_leak_to_vrf_withdraw(struct bgp_path_info *path_vpn)
 			return;
 		}
 #endif
-		if (1)
+		if (debug)
 			zlog_debug(
 				"%s: path_vpn->net unexpectedly NULL, no prefix, bailing",
 				__func__);
@@ -2481,10 +2687,12 @@ void vpn_leak_to_vrf_withdraw(struct bgp_path_info *path_vpn)
 	p = bgp_dest_get_prefix(path_vpn->net);
 	afi = family2afi(p->family);
 
-	/* Loop over VRFs */
-	for (ALL_LIST_ELEMENTS(bm->bgp, mnode, mnnode, bgp)) {
+	/* Loop over the VRFs importing any of the RTs */
+	vpn_import_set_get(&set, afi, bgp_attr_get_ecommunity(path_vpn->attr));
+	for (i = 0; i < set.count; i++) {
+		bgp = set.vrfs[i];
 		if (!vpn_leak_from_vpn_active(bgp, afi, &debugmsg)) {
-			if (1)
+			if (debug)
 				zlog_debug("%s: from %s, skipping: %s",
 					   __func__, bgp->name_pretty,
 					   debugmsg);
@@ -2500,7 +2708,7 @@ void vpn_leak_to_vrf_withdraw(struct bgp_path_info *path_vpn)
 			continue;
 		}
 
-		if (1)
+		if (debug)
 			zlog_debug("%s: withdrawing from vrf %s", __func__,
 				   bgp->name_pretty);
 
@@ -2516,7 +2724,7 @@ void vpn_leak_to_vrf_withdraw(struct bgp_path_info *path_vpn)
 		}
 
 		if (bpi) {
-			if (1)
+			if (debug)
 				zlog_debug("%s: deleting bpi %p", __func__,
 					   bpi);
 			bgp_aggregate_decrement(bgp, p, bpi, afi, safi);
@@ -2525,6 +2733,63 @@ void vpn_leak_to_vrf_withdraw(struct bgp_path_info *path_vpn)
 		}
 		bgp_dest_unlock_node(bn);
 	}
+	vpn_import_set_done(&set);
+}
+
+/*
+ * Re-import a VPN path and re-run best path selection on every VRF dest
+ * holding a copy of it. leak_update() skips bgp_process() when the leaked
+ * attribute did not change, yet the comparison may still move because it
+ * also depends on state kept outside the attribute (the TWAMP latency of
+ * the ultimate peer).
+ */
+void vpn_leak_to_vrf_reevaluate(struct bgp *from_bgp,
+				struct bgp_path_info *path_vpn)
+{
+	const struct prefix *p;
+	afi_t afi;
+	safi_t safi = SAFI_UNICAST;
+	struct bgp *bgp;
+	struct listnode *mnode, *mnnode;
+	struct bgp_dest *bn;
+	struct bgp_path_info *bpi;
+
+	int debug = BGP_DEBUG(vpn, VPN_LEAK_TO_VRF);
+
+	if (!path_vpn->net)
+		return;
+
+	vpn_leak_to_vrf_update(from_bgp, path_vpn, NULL);
+
+	p = bgp_dest_get_prefix(path_vpn->net);
+	afi = family2afi(p->family);
+
+	for (ALL_LIST_ELEMENTS(bm->bgp, mnode, mnnode, bgp)) {
+		if (!vpn_leak_from_vpn_active(bgp, afi, NULL))
+			continue;
+
+		bn = bgp_node_lookup(bgp->rib[afi][safi], p);
+		if (!bn)
+			continue;
+
+		for (bpi = bgp_dest_get_bgp_path_info(bn); bpi;
+		     bpi = bpi->next) {
+			if (bpi->extra && bpi->extra->vrfleak &&
+			    (struct bgp_path_info *)bpi->extra->vrfleak->parent ==
+				    path_vpn)
+				break;
+		}
+
+		if (bpi) {
+			if (debug)
+				zlog_debug("%s: re-selecting %pBD in vrf %s",
+					   __func__, bn, bgp->name_pretty);
+			frrtrace(3, frr_bgp, vpn_leak_reimport, from_bgp, bgp,
+				 bn);
+			bgp_process(bgp, bn, afi, safi);
+		}
+		bgp_dest_unlock_node(bn);
+	}
 }
 
 void vpn_leak_to_vrf_withdraw_all(struct bgp *to_bgp, afi_t afi)
@@ -2534,7 +2799,7 @@ void vpn_leak_to_vrf_withdraw_all(struct bgp *to_bgp, afi_t afi)
 	safi_t safi = SAFI_UNICAST;
 	int debug = BGP_DEBUG(vpn, VPN_LEAK_TO_VRF);
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: entry", __func__);
 	/*
 	 * Walk vrf table, delete bpi with bgp_orig in a different vrf
@@ -2557,6 +2822,8 @@ void vpn_leak_to_vrf_withdraw_all(struct bgp *to_bgp, afi_t afi)
 			}
 		}
 	}
+
+	bgp_twamp_import_changed();
 }
 
 void vpn_leak_no_retain(struct bgp *to_bgp, struct bgp *vpn_from, afi_t afi)
@@ -2639,6 +2906,65 @@ void vpn_leak_to_vrf_update_all(struct bgp *to_bgp, struct bgp *vpn_from,
 			}
 		}
 	}
+
+	bgp_twamp_import_changed();
+}
+
+/*
+ * vpn_leak_to_vrf_update_all() for every VRF instance at once, as
+ * vpn_leak_postchange() would do it for each.
+ */
+static void vpn_leak_to_vrfs_update_all(struct bgp *vpn_from, afi_t afi)
+{
+	struct bgp_dest *pdest;
+	safi_t safi = SAFI_MPLS_VPN;
+	struct vpn_import_set set;
+	struct bgp *to_bgp;
+	unsigned int i;
+
+	/* trigger a flush to re-sync with ADJ-RIB-in */
+	if (!CHECK_FLAG(vpn_from->af_flags[afi][safi],
+			BGP_VPNVX_RETAIN_ROUTE_TARGET_ALL))
+		bgp_clear_soft_in(vpn_from, afi, safi);
+
+	for (pdest = bgp_table_top(vpn_from->rib[afi][safi]); pdest;
+	     pdest = bgp_route_next(pdest)) {
+		struct bgp_table *table;
+		struct bgp_dest *bn;
+		struct bgp_path_info *bpi;
+
+		/* This is the per-RD table of prefixes */
+		table = bgp_dest_get_bgp_table_info(pdest);
+
+		if (!table)
+			continue;
+
+		for (bn = bgp_table_top(table); bn; bn = bgp_route_next(bn)) {
+
+			for (bpi = bgp_dest_get_bgp_path_info(bn); bpi;
+			     bpi = bpi->next) {
+				vpn_import_set_get(&set, afi,
+						   bgp_attr_get_ecommunity(
+							   bpi->attr));
+				for (i = 0; i < set.count; i++) {
+					to_bgp = set.vrfs[i];
+					if (to_bgp->inst_type !=
+					    BGP_INSTANCE_TYPE_VRF)
+						continue;
+					if (bpi->extra && bpi->extra->vrfleak &&
+					    bpi->extra->vrfleak->bgp_orig ==
+						    to_bgp)
+						continue;
+
+					vpn_leak_to_vrf_update_onevrf(
+						to_bgp, vpn_from, bpi, NULL);
+				}
+				vpn_import_set_done(&set);
+			}
+		}
+	}
+
+	bgp_twamp_import_changed();
 }
 
 /*
@@ -2665,7 +2991,7 @@ static void vpn_policy_routemap_update(struct bgp *bgp, const char *rmap_name)
 			       bgp->vpn_policy[afi]
 				       .rmap_name[BGP_VPN_POLICY_DIR_TOVPN])) {
 
-			if (1)
+			if (debug)
 				zlog_debug(
 					"%s: rmap \"%s\" matches vrf-policy tovpn for as %d afi %s",
 					__func__, rmap_name, bgp->as,
@@ -2673,7 +2999,7 @@ static void vpn_policy_routemap_update(struct bgp *bgp, const char *rmap_name)
 
 			vpn_leak_prechange(BGP_VPN_POLICY_DIR_TOVPN, afi,
 					   bgp_get_default(), bgp);
-			if (1)
+			if (debug)
 				zlog_debug("%s: after vpn_leak_prechange",
 					   __func__);
 
@@ -2684,7 +3010,7 @@ static void vpn_policy_routemap_update(struct bgp *bgp, const char *rmap_name)
 			vpn_leak_postchange(BGP_VPN_POLICY_DIR_TOVPN, afi,
 					    bgp_get_default(), bgp);
 
-			if (1)
+			if (debug)
 				zlog_debug("%s: after vpn_leak_postchange",
 					   __func__);
 		}
@@ -2694,7 +3020,7 @@ static void vpn_policy_routemap_update(struct bgp *bgp, const char *rmap_name)
 				bgp->vpn_policy[afi]
 				.rmap_name[BGP_VPN_POLICY_DIR_FROMVPN]))  {
 
-			if (1) {
+			if (debug) {
 				zlog_debug("%s: rmap \"%s\" matches vrf-policy fromvpn for as %d afi %s",
 					__func__, rmap_name, bgp->as,
 					afi2str(afi));
@@ -2736,7 +3062,7 @@ void vpn_handle_router_id_update(struct bgp *bgp, bool withdraw,
 	 * should not replace a configured vpn RD/RT.
 	 */
 	if (!is_config) {
-		if (1)
+		if (debug)
 			zlog_debug("%s: skipping non explicit router-id change",
 				   __func__);
 		return;
@@ -2757,7 +3083,7 @@ void vpn_handle_router_id_update(struct bgp *bgp, bool withdraw,
 		if (withdraw) {
 			vpn_leak_prechange(BGP_VPN_POLICY_DIR_TOVPN,
 					   afi, bgp_get_default(), bgp);
-			if (1)
+			if (debug)
 				zlog_debug("%s: %s after to_vpn vpn_leak_prechange",
 					   __func__, export_name);
 
@@ -2777,6 +3103,7 @@ void vpn_handle_router_id_update(struct bgp *bgp, bool withdraw,
 						.rtlist[idir],
 					(struct ecommunity_val *)ecom->val);
 			}
+			vpn_leak_import_index_invalidate();
 		} else {
 			/* New router-id derive auto RD and RT and export
 			 * to VPN
@@ -2815,12 +3142,13 @@ void vpn_handle_router_id_update(struct bgp *bgp, bool withdraw,
 					bgp_import->vpn_policy[afi].rtlist[idir]
 						= ecommunity_dup(ecom);
 			}
+			vpn_leak_import_index_invalidate();
 
 			/* Update routes to VPN */
 			vpn_leak_postchange(BGP_VPN_POLICY_DIR_TOVPN,
 					    afi, bgp_get_default(),
 					    bgp);
-			if (1)
+			if (debug)
 				zlog_debug("%s: %s after to_vpn vpn_leak_postchange",
 					   __func__, export_name);
 		}
@@ -2833,7 +3161,7 @@ void vpn_policy_routemap_event(const char *rmap_name)
 	struct listnode *mnode, *mnnode;
 	struct bgp *bgp;
 
-	if (1)
+	if (debug)
 		zlog_debug("%s: entry", __func__);
 
 	if (bm->bgp == NULL) /* may be called during cleanup */
@@ -2936,9 +3264,10 @@ void vrf_import_from_vrf(struct bgp *to_bgp, struct bgp *from_bgp,
 					 .rtlist[idir], ecom);
 	else
 		to_bgp->vpn_policy[afi].rtlist[idir] = ecommunity_dup(ecom);
+	vpn_leak_import_index_invalidate();
 	SET_FLAG(to_bgp->af_flags[afi][safi], BGP_CONFIG_VRF_TO_VRF_IMPORT);
 
-	if (1) {
+	if (debug) {
 		const char *from_name;
 		char *ecom1, *ecom2;
 
@@ -3007,7 +3336,7 @@ void vrf_unimport_from_vrf(struct bgp *to_bgp, struct bgp *from_bgp,
 	if (!vname)
 		return;
 
-	if (1)
+	if (debug)
 		zlog_debug("%s from %s to %s", __func__, tmp_name, export_name);
 
 	/* Remove "import_vrf" from our import list. */
@@ -3026,11 +3355,13 @@ void vrf_unimport_from_vrf(struct bgp *to_bgp, struct bgp *from_bgp,
 				   BGP_CONFIG_VRF_TO_VRF_IMPORT);
 		if (to_bgp->vpn_policy[afi].rtlist[idir])
 			ecommunity_free(&to_bgp->vpn_policy[afi].rtlist[idir]);
+		vpn_leak_import_index_invalidate();
 	} else {
 		ecom = from_bgp->vpn_policy[afi].rtlist[edir];
 		if (ecom)
 			ecommunity_del_val(to_bgp->vpn_policy[afi].rtlist[idir],
 				   (struct ecommunity_val *)ecom->val);
+		vpn_leak_import_index_invalidate();
 		vpn_leak_postchange(idir, afi, bgp_get_default(), to_bgp);
 	}
 
@@ -3783,24 +4114,19 @@ void vpn_leak_postchange_all(void)
 			bgp);
 	}
 
-	/* Now, do any importing to VRFs from the single VPN RIB */
-	for (ALL_LIST_ELEMENTS_RO(bm->bgp, next, bgp)) {
-
-		if (bgp->inst_type != BGP_INSTANCE_TYPE_VRF)
-			continue;
-
-		vpn_leak_postchange(
-			BGP_VPN_POLICY_DIR_FROMVPN,
-			AFI_IP,
-			bgp_default,
-			bgp);
+	/*
+	 * Now, do any importing to VRFs from the single VPN RIB. All VRFs
+	 * are done in one walk of it, rather than a walk and a soft-in
+	 * refresh per VRF.
+	 */
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, next, bgp))
+		if (bgp->inst_type == BGP_INSTANCE_TYPE_VRF)
+			break;
+	if (!next)
+		return;
 
-		vpn_leak_postchange(
-			BGP_VPN_POLICY_DIR_FROMVPN,
-			AFI_IP6,
-			bgp_default,
-			bgp);
-	}
+	vpn_leak_to_vrfs_update_all(bgp_default, AFI_IP);
+	vpn_leak_to_vrfs_update_all(bgp_default, AFI_IP6);
 }
 
 /* When a bgp vrf instance is unconfigured, remove its routes
@@ -3860,7 +4186,7 @@ void bgp_vpn_leak_unimport(struct bgp *from_bgp)
 			if (!is_vrf_leak_bind)
 				continue;
 
-			if (1)
+			if (debug)
 				zlog_debug("%s: unimport routes from %s to_bgp %s afi %s import vrfs count %u",
 					   __func__, from_bgp->name_pretty,
 					   to_bgp->name_pretty, afi2str(afi),
@@ -3955,7 +4281,7 @@ void bgp_vpn_leak_export(struct bgp *from_bgp)
 				if (strcmp(vname, export_name) != 0)
 					continue;
 
-				if (1)
+				if (debug)
 					zlog_debug("%s: found from_bgp %s in to_bgp %s import list, import routes.",
 					   __func__,
 					   export_name, to_bgp->name_pretty);
@@ -3964,11 +4290,13 @@ void bgp_vpn_leak_export(struct bgp *from_bgp)
 				/* remove import rt, it will be readded
 				 * as part of import from vrf.
 				 */
-				if (ecom)
+				if (ecom) {
 					ecommunity_del_val(
 						to_vpolicy->rtlist[idir],
 						(struct ecommunity_val *)
 							ecom->val);
+					vpn_leak_import_index_invalidate();
+				}
 				vrf_import_from_vrf(to_bgp, from_bgp,
 						    afi, safi);
 				break;
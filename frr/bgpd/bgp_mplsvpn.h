@@ -70,8 +70,14 @@ extern void vpn_leak_to_vrf_update(struct bgp *from_bgp,
 				   struct bgp_path_info *path_vpn,
 				   struct prefix_rd *prd);
 
+/* After changing an import RT list, or adding or removing an instance */
+extern void vpn_leak_import_index_invalidate(void);
+
 extern void vpn_leak_to_vrf_withdraw(struct bgp_path_info *path_vpn);
 
+extern void vpn_leak_to_vrf_reevaluate(struct bgp *from_bgp,
+				       struct bgp_path_info *path_vpn);
+
 extern void vpn_leak_zebra_vrf_label_update(struct bgp *bgp, afi_t afi);
 extern void vpn_leak_zebra_vrf_label_withdraw(struct bgp *bgp, afi_t afi);
 extern void vpn_leak_zebra_vrf_sid_update(struct bgp *bgp, afi_t afi);
@@ -32,6 +32,7 @@
 #include "bgpd/bgp_vty.h"
 #include "bgpd/bgp_rd.h"
 #include "bgpd/bgp_mplsvpn.h"
+#include "bgpd/bgp_twamp.h"
 
 DEFINE_MTYPE_STATIC(BGPD, MARTIAN_STRING, "BGP Martian Addr Intf String");
 
@@ -68,6 +69,9 @@ struct bgp_nexthop_cache *bnc_new(struct bgp_nexthop_cache_head *tree,
 	bnc->ifindex_ipv6_ll = ifindex;
 	bnc->srte_color = srte_color;
 	bnc->tree = tree;
+	bnc->twamp_latency = UINT32_MAX;
+	bnc->twamp_igp_latency = UINT32_MAX;
+	bnc->twamp_advertised = UINT32_MAX;
 	LIST_INIT(&(bnc->paths));
 	bgp_nexthop_cache_add(tree, bnc);
 
@@ -89,6 +93,8 @@ bool bnc_existing_for_prefix(struct bgp_nexthop_cache *bnc)
 
 void bnc_free(struct bgp_nexthop_cache *bnc)
 {
+	bgp_twamp_bnc_free(bnc);
+	bgp_nht_eval_cancel(bnc);
 	bnc_nexthop_free(bnc);
 	bgp_nexthop_cache_del(bnc->tree, bnc);
 	XFREE(MTYPE_BGP_NEXTHOP_CACHE, bnc);
@@ -731,9 +737,11 @@ bool bgp_subgrp_multiaccess_check_v4(struct in_addr nexthop,
 	return false;
 }
 
-static void bgp_show_bgp_path_info_flags(uint32_t flags, json_object *json)
+static void bgp_show_bgp_path_info_flags(const struct bgp_path_info *path,
+					 json_object *json)
 {
 	json_object *json_flags = NULL;
+	uint32_t flags = path->flags;
 
 	if (!json)
 		return;
@@ -756,7 +764,7 @@ static void bgp_show_bgp_path_info_flags(uint32_t flags, json_object *json)
 	json_object_boolean_add(json_flags, "deterministicMedSelected",
 				CHECK_FLAG(flags, BGP_PATH_DMED_SELECTED));
 	json_object_boolean_add(json_flags, "stale",
-				CHECK_FLAG(flags, BGP_PATH_STALE));
+				bgp_path_info_stale(path));
 	json_object_boolean_add(json_flags, "removed",
 				CHECK_FLAG(flags, BGP_PATH_REMOVED));
 	json_object_boolean_add(json_flags, "counted",
@@ -818,7 +826,7 @@ static void bgp_show_nexthop_paths(struct vty *vty, struct bgp *bgp,
 			json_object_string_add(
 				json_path, "vrf",
 				vrf_id_to_name(bgp_path->vrf_id));
-			bgp_show_bgp_path_info_flags(path->flags, json_path);
+			bgp_show_bgp_path_info_flags(path, json_path);
 			json_object_array_add(paths, json_path);
 			continue;
 		}
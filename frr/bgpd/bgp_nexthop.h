@@ -22,7 +22,10 @@
 
 #define BGP_MP_NEXTHOP_FAMILY NEXTHOP_FAMILY
 
+struct ringbuf;
+
 PREDECL_RBTREE_UNIQ(bgp_nexthop_cache);
+PREDECL_DLIST(bgp_nht_eval);
 
 /* BGP nexthop cache value structure. */
 struct bgp_nexthop_cache {
@@ -34,6 +37,10 @@ struct bgp_nexthop_cache {
 	/* RB-tree entry. */
 	struct bgp_nexthop_cache_item entry;
 
+	/* Waiting for evaluate_paths() after updates from zebra */
+	struct bgp_nht_eval_item eval_entry;
+	bool eval_queued;
+
 	/* IGP route's metric. */
 	uint32_t metric;
 
@@ -93,6 +100,62 @@ struct bgp_nexthop_cache {
 	 * nexthop.
 	 */
 	bool is_evpn_gwip_nexthop;
+
+	/* TWAMP latency to this nexthop in us, UINT32_MAX if not measured.
+	 * Snapshot of the shared segment, refreshed by bgp_twamp so that
+	 * best-path never has to look at shared memory.
+	 */
+	uint32_t twamp_latency;
+	/* Probe loss in permille as of the last refresh, 1000 if the last
+	 * round got no reply, 0 if not measured
+	 */
+	uint16_t twamp_loss;
+	/* Carries iBGP paths, so its address is in the shared segment */
+	bool twamp_registered;
+	/* twamp_latency moved in the current refresh pass */
+	bool twamp_changed;
+	/* twamp_latency was measured before bgpd restarted, nothing newer yet */
+	bool twamp_restored;
+	/* BFD to this nexthop went down at this time_t and is not back up:
+	 * measurements up to then are stale, 0 if not
+	 */
+	time_t twamp_invalidated;
+	/* twamp_latency frozen while the hold-down penalty decays */
+	bool twamp_held;
+	/* Measurement not adopted yet, and since when it has been away */
+	uint32_t twamp_pending;
+	time_t twamp_pending_since;
+	/* Hold-down figure of merit, as in bgp_damp.c, and its last update */
+	int twamp_penalty;
+	time_t twamp_penalty_updated;
+	/* Round trip estimate from IGP TE delay, UINT32_MAX if unknown, and
+	 * whether it was worked out against the current link-state database
+	 */
+	uint32_t twamp_igp_latency;
+	bool twamp_igp_current;
+	/* The IGP estimate and the last measurement agree, probe sparsely */
+	bool twamp_hybrid_sparse;
+	/* Latency and loss to put into announcements, rate limited copy of
+	 * twamp_latency and twamp_loss, and when they last moved
+	 */
+	uint32_t twamp_advertised;
+	uint16_t twamp_advertised_loss;
+	time_t twamp_advertised_time;
+	/* A move is held back by the advertise interval */
+	bool twamp_advertise_pending;
+	/* The advertised value moved in the current refresh pass */
+	bool twamp_readvertise;
+	/* Last measurements published by the agent, oldest first */
+	struct ringbuf *twamp_history;
+	/* SR policy colour of the latency class the routes are steered by */
+	uint32_t twamp_color;
+	/* DSCP the nexthop is measured with, as of the last collect */
+	uint8_t twamp_dscp;
+	/*
+	 * Measured delay towards the nexthop and back in microseconds, 0 if
+	 * not measured one way
+	 */
+	uint32_t twamp_forward, twamp_reverse;
 };
 
 extern int bgp_nexthop_cache_compare(const struct bgp_nexthop_cache *a,
@@ -0,0 +1,265 @@
+/*
+ * BGP nexthop groups.
+ *
+ * A route imported from a VPN goes to zebra with the nexthops of the PEs
+ * it was learned from, which zebra resolves over the core and hashes to
+ * find the group for, route after route. Here bgpd resolves them itself
+ * from its nexthop cache, stacking the VPN label under the transport
+ * labels the same way zebra would, and sends each distinct result once,
+ * as a group with an id. The routes refer to the id only.
+ *
+ * Groups are refcounted by the destinations installed with them, and
+ * deleted in zebra with the last one. A nexthop moving in the core moves
+ * the routes onto another group as they are sent again.
+ */
+#include "zebra.h"
+
+#include "lib/jhash.h"
+#include "lib/nexthop.h"
+#include "lib/typesafe.h"
+#include "lib/zclient.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_nexthop.h"
+#include "bgpd/bgp_nht.h"
+#include "bgpd/bgp_mplsvpn.h"
+#include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_memory.h"
+#include "bgpd/bgp_nhg.h"
+
+DEFINE_MTYPE_STATIC(BGPD, BGP_NHG, "BGP nexthop group");
+
+extern struct zclient *zclient;
+
+PREDECL_HASH(bgp_nhg_cache);
+
+struct bgp_nhg {
+	struct bgp_nhg_cache_item item;
+
+	uint32_t id;
+	/* Destinations installed with the group */
+	uint32_t refcnt;
+
+	/* Sorted, and zeroed but for what is set, so they compare bytewise */
+	unsigned int count;
+	struct zapi_nexthop nexthops[];
+};
+
+static int bgp_nhg_cmp(const struct bgp_nhg *a, const struct bgp_nhg *b)
+{
+	if (a->count != b->count)
+		return numcmp(a->count, b->count);
+	return memcmp(a->nexthops, b->nexthops,
+		      a->count * sizeof(a->nexthops[0]));
+}
+
+static uint32_t bgp_nhg_hash(const struct bgp_nhg *nhg)
+{
+	return jhash(nhg->nexthops, nhg->count * sizeof(nhg->nexthops[0]),
+		     0x6e686773);
+}
+
+DECLARE_HASH(bgp_nhg_cache, struct bgp_nhg, item, bgp_nhg_cmp, bgp_nhg_hash);
+
+static struct bgp_nhg_cache_head nhg_cache = INIT_HASH(nhg_cache);
+
+static int bgp_nhg_nexthop_order(const void *a, const void *b)
+{
+	return memcmp(a, b, sizeof(struct zapi_nexthop));
+}
+
+static void bgp_nhg_send(const struct bgp_nhg *nhg)
+{
+	struct zapi_nhg api_nhg = {};
+
+	if (!zclient || zclient->sock < 0)
+		return;
+
+	api_nhg.id = nhg->id;
+	api_nhg.nexthop_num = nhg->count;
+	memcpy(api_nhg.nexthops, nhg->nexthops,
+	       nhg->count * sizeof(nhg->nexthops[0]));
+
+	if (BGP_DEBUG(zebra, ZEBRA))
+		zlog_debug("%s: nexthop group %u, %u nexthops", __func__,
+			   nhg->id, nhg->count);
+
+	zclient_nhg_send(zclient, ZEBRA_NHG_ADD, &api_nhg);
+}
+
+static void bgp_nhg_release(struct bgp_nhg *nhg)
+{
+	struct zapi_nhg api_nhg = {};
+
+	if (--nhg->refcnt)
+		return;
+
+	if (zclient && zclient->sock >= 0) {
+		api_nhg.id = nhg->id;
+		zclient_nhg_send(zclient, ZEBRA_NHG_DEL, &api_nhg);
+	}
+
+	bgp_nhg_cache_del(&nhg_cache, nhg);
+	bgp_l3nhg_id_free(nhg->id);
+	XFREE(MTYPE_BGP_NHG, nhg);
+}
+
+/* Only VPN imports, with a label and nothing more to them */
+static bool bgp_nhg_path_wanted(struct bgp_path_info *path,
+				const struct zapi_nexthop *api_nh)
+{
+	struct bgp_path_info *parent;
+
+	if (!path->extra || !path->extra->vrfleak ||
+	    !path->extra->vrfleak->parent)
+		return false;
+	parent = path->extra->vrfleak->parent;
+	if (!is_pi_family_vpn(parent))
+		return false;
+
+	if (CHECK_FLAG(api_nh->flags, ZAPI_NEXTHOP_FLAG_EVPN |
+					      ZAPI_NEXTHOP_FLAG_SEG6 |
+					      ZAPI_NEXTHOP_FLAG_SEG6LOCAL) ||
+	    api_nh->srte_color || api_nh->label_num > 1)
+		return false;
+	return true;
+}
+
+/*
+ * api_nh resolved over bnc, as zebra would: on each of the nexthops that
+ * resolve it, with its labels under theirs. Zebra takes gateways on an
+ * interface only, so one reached straight on an interface is its own
+ * gateway there.
+ */
+static bool bgp_nhg_resolve(const struct zapi_nexthop *api_nh,
+			    const struct bgp_nexthop_cache *bnc,
+			    struct zapi_nexthop *nhs, unsigned int *count)
+{
+	const struct nexthop *res;
+	struct zapi_nexthop *znh;
+	bool v6 = api_nh->type == NEXTHOP_TYPE_IPV6 ||
+		  api_nh->type == NEXTHOP_TYPE_IPV6_IFINDEX;
+
+	if (!CHECK_FLAG(bnc->flags, BGP_NEXTHOP_VALID) || !bnc->nexthop)
+		return false;
+
+	for (res = bnc->nexthop; res; res = res->next) {
+		if (res->type == NEXTHOP_TYPE_BLACKHOLE || !res->ifindex ||
+		    res->nh_srv6)
+			return false;
+		/* zapi_nhg_encode() takes one less than MULTIPATH_NUM */
+		if (*count + 1 >= MULTIPATH_NUM)
+			return false;
+
+		znh = &nhs[*count];
+		if (zapi_nexthop_from_nexthop(znh, res) < 0)
+			return false;
+		UNSET_FLAG(znh->flags, ZAPI_NEXTHOP_FLAG_HAS_BACKUP);
+		znh->backup_num = 0;
+
+		if (res->type == NEXTHOP_TYPE_IFINDEX) {
+			znh->type = v6 ? NEXTHOP_TYPE_IPV6_IFINDEX
+				       : NEXTHOP_TYPE_IPV4_IFINDEX;
+			znh->gate = api_nh->gate;
+			SET_FLAG(znh->flags, ZAPI_NEXTHOP_FLAG_ONLINK);
+		}
+
+		if (CHECK_FLAG(api_nh->flags, ZAPI_NEXTHOP_FLAG_LABEL)) {
+			if (znh->label_num >= MPLS_MAX_LABELS)
+				return false;
+			if (!znh->label_num)
+				znh->label_type = api_nh->label_type;
+			znh->labels[znh->label_num++] = api_nh->labels[0];
+			SET_FLAG(znh->flags, ZAPI_NEXTHOP_FLAG_LABEL);
+		}
+
+		znh->weight = api_nh->weight;
+		(*count)++;
+	}
+	return true;
+}
+
+static struct bgp_nhg *bgp_nhg_get(const struct zapi_route *api,
+				   struct bgp_path_info *const *paths)
+{
+	struct zapi_nexthop nhs[MULTIPATH_NUM];
+	struct bgp_nhg *nhg, *key;
+	unsigned int i, count = 0;
+	uint32_t id;
+
+	for (i = 0; i < api->nexthop_num; i++) {
+		if (!paths[i]->nexthop ||
+		    !bgp_nhg_path_wanted(paths[i], &api->nexthops[i]) ||
+		    !bgp_nhg_resolve(&api->nexthops[i], paths[i]->nexthop, nhs,
+				     &count))
+			return NULL;
+	}
+	if (!count)
+		return NULL;
+	qsort(nhs, count, sizeof(nhs[0]), bgp_nhg_nexthop_order);
+
+	key = XCALLOC(MTYPE_BGP_NHG,
+		      sizeof(*key) + count * sizeof(key->nexthops[0]));
+	key->count = count;
+	memcpy(key->nexthops, nhs, count * sizeof(nhs[0]));
+
+	nhg = bgp_nhg_cache_find(&nhg_cache, key);
+	if (nhg) {
+		XFREE(MTYPE_BGP_NHG, key);
+		nhg->refcnt++;
+		return nhg;
+	}
+
+	id = bgp_l3nhg_id_alloc();
+	if (!id) {
+		XFREE(MTYPE_BGP_NHG, key);
+		return NULL;
+	}
+
+	nhg = key;
+	nhg->id = id;
+	nhg->refcnt = 1;
+	bgp_nhg_cache_add(&nhg_cache, nhg);
+	bgp_nhg_send(nhg);
+	return nhg;
+}
+
+void bgp_nhg_route_install(struct bgp_dest *dest, struct zapi_route *api,
+			   struct bgp_path_info *const *paths)
+{
+	struct bgp_nhg *nhg = NULL;
+
+	if (CHECK_FLAG(bm->flags, BM_FLAG_INSTALL_NHG) && api->nexthop_num &&
+	    !CHECK_FLAG(api->message, ZAPI_MESSAGE_NHG) &&
+	    !CHECK_FLAG(api->message, ZAPI_MESSAGE_BACKUP_NEXTHOPS))
+		nhg = bgp_nhg_get(api, paths);
+
+	/* Taken before the old one goes, in case they are the same */
+	if (dest->nhg)
+		bgp_nhg_release(dest->nhg);
+	dest->nhg = nhg;
+	if (!nhg)
+		return;
+
+	api->nhgid = nhg->id;
+	SET_FLAG(api->message, ZAPI_MESSAGE_NHG);
+	api->nexthop_num = 0;
+}
+
+void bgp_nhg_route_uninstall(struct bgp_dest *dest)
+{
+	if (!dest->nhg)
+		return;
+	bgp_nhg_release(dest->nhg);
+	dest->nhg = NULL;
+}
+
+void bgp_nhg_zebra_connected(void)
+{
+	struct bgp_nhg *nhg;
+
+	frr_each (bgp_nhg_cache, &nhg_cache, nhg)
+		bgp_nhg_send(nhg);
+}
@@ -0,0 +1,30 @@
+#ifndef _BGP_NHG_H
+#define _BGP_NHG_H
+
+/*
+ * Nexthop groups bgpd owns in zebra, one per distinct set of resolved
+ * nexthops. Routes imported from VPNs are installed by the group's id
+ * rather than with their nexthops, which zebra would otherwise resolve
+ * and hash again for every route.
+ */
+
+struct bgp_dest;
+struct bgp_path_info;
+struct zapi_route;
+
+/*
+ * api is about to be sent for dest, the nexthops in it from paths, one
+ * each: move it onto the group for them if it can go by one, and drop
+ * the group dest was on before otherwise
+ */
+extern void bgp_nhg_route_install(struct bgp_dest *dest,
+				  struct zapi_route *api,
+				  struct bgp_path_info *const *paths);
+
+/* dest is being withdrawn from zebra */
+extern void bgp_nhg_route_uninstall(struct bgp_dest *dest);
+
+/* (Re)connected to zebra, which knows none of the groups */
+extern void bgp_nhg_zebra_connected(void);
+
+#endif
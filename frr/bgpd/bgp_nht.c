@@ -33,6 +33,8 @@
 #include "bgpd/bgp_rd.h"
 #include "bgpd/bgp_mplsvpn.h"
 #include "bgpd/bgp_ecommunity.h"
+#include "bgpd/bgp_twamp.h"
+#include "bgpd/bgp_twamp_nhg.h"
 
 extern struct zclient *zclient;
 
@@ -161,6 +163,7 @@ void bgp_unlink_nexthop(struct bgp_path_info *path)
 		return;
 
 	path_nh_map(path, NULL, false);
+	bgp_twamp_bnc_path_del(bnc, path);
 
 	bgp_unlink_nexthop_check(bnc);
 }
@@ -486,6 +489,10 @@ int bgp_find_or_add_nexthop(struct bgp *bgp_route, struct bgp *bgp_nexthop,
 			bnc->nht_info = (void *)peer; /* NHT peer reference */
 	}
 
+	/* An update may have brought route targets some VRF imports */
+	if (pi)
+		bgp_twamp_bnc_path_add(bnc, pi);
+
 	/*
 	 * We are cheating here.  Views have no associated underlying
 	 * ability to detect nexthops.  So when we have a view
@@ -564,6 +571,45 @@ void bgp_delete_connected_nexthop(afi_t afi, struct peer *peer)
 	}
 }
 
+DECLARE_DLIST(bgp_nht_eval, struct bgp_nexthop_cache, eval_entry);
+
+static struct bgp_nht_eval_head bgp_nht_eval_queue =
+	INIT_DLIST(bgp_nht_eval_queue);
+static struct event *t_nht_eval;
+
+static void bgp_nht_eval_run(struct event *thread)
+{
+	struct bgp_nexthop_cache *bnc;
+
+	/* Evaluating a nexthop can free others, they leave the queue */
+	while ((bnc = bgp_nht_eval_pop(&bgp_nht_eval_queue))) {
+		bnc->eval_queued = false;
+		evaluate_paths(bnc);
+	}
+}
+
+static void bgp_nht_eval_add(struct bgp_nexthop_cache *bnc)
+{
+	if (bnc->eval_queued)
+		return;
+
+	bnc->eval_queued = true;
+	bgp_nht_eval_add_tail(&bgp_nht_eval_queue, bnc);
+	event_add_timer_msec(bm->master, bgp_nht_eval_run, NULL,
+			     BGP_NHT_EVAL_MSEC, &t_nht_eval);
+}
+
+void bgp_nht_eval_cancel(struct bgp_nexthop_cache *bnc)
+{
+	if (!bnc->eval_queued)
+		return;
+
+	bnc->eval_queued = false;
+	bgp_nht_eval_del(&bgp_nht_eval_queue, bnc);
+	if (!bgp_nht_eval_count(&bgp_nht_eval_queue))
+		EVENT_OFF(t_nht_eval);
+}
+
 static void bgp_process_nexthop_update(struct bgp_nexthop_cache *bnc,
 				       struct zapi_route *nhr,
 				       bool import_check)
@@ -576,7 +622,9 @@ static void bgp_process_nexthop_update(struct bgp_nexthop_cache *bnc,
 	bool evpn_resolved = false;
 
 	bnc->last_update = monotime(NULL);
-	bnc->change_flags = 0;
+	/* What changed since the evaluation was queued is still to see */
+	if (!bnc->eval_queued)
+		bnc->change_flags = 0;
 
 	/* debug print the input */
 	if (BGP_DEBUG(nht, NHT)) {
@@ -732,7 +780,7 @@ static void bgp_process_nexthop_update(struct bgp_nexthop_cache *bnc,
 		bnc->nexthop = NULL;
 	}
 
-	evaluate_paths(bnc);
+	bgp_nht_eval_add(bnc);
 }
 
 static void bgp_nht_ifp_table_handle(struct bgp *bgp,
@@ -1235,6 +1283,9 @@ void evaluate_paths(struct bgp_nexthop_cache *bnc)
 							  sizeof(bnc_buf)));
 	}
 
+	/* Latency groups switch to their backups before any route moves */
+	bgp_twamp_nhg_bnc_update(bnc);
+
 	LIST_FOREACH (path, &(bnc->paths), nh_thread) {
 		if (path->type == ZEBRA_ROUTE_BGP &&
 		    (path->sub_type == BGP_ROUTE_NORMAL ||
@@ -11,6 +11,16 @@
  */
 extern void bgp_parse_nexthop_update(int command, vrf_id_t vrf_id);
 
+/*
+ * Nexthop updates from zebra come in bursts, e.g. on an IGP change. The
+ * paths of the nexthops updated are evaluated together, at most this long
+ * after the first update, and once for a nexthop updated many times.
+ */
+#define BGP_NHT_EVAL_MSEC 10
+
+/* Drop bnc from the nexthops waiting for evaluation, it is going away */
+extern void bgp_nht_eval_cancel(struct bgp_nexthop_cache *bnc);
+
 /**
  * bgp_find_or_add_nexthop() - lookup the nexthop cache table for the bnc
  *  object. If not found, create a new object and register with ZEBRA for
@@ -49,6 +49,8 @@
 #include "bgpd/bgp_keepalives.h"
 #include "bgpd/bgp_flowspec.h"
 #include "bgpd/bgp_trace.h"
+#include "bgpd/bgp_preparse.h"
+#include "bgpd/bgp_twamp.h"
 
 DEFINE_HOOK(bgp_packet_dump,
 		(struct peer *peer, uint8_t type, bgp_size_t size,
@@ -239,6 +241,14 @@ void bgp_check_update_delay(struct bgp *bgp)
 				}
 			}
 
+		/* Best-path runs once, with the latencies it selects by */
+		if (bgp_twamp_initial_pending(bgp)) {
+			if (bgp_debug_neighbor_events(NULL))
+				zlog_debug(
+					" Nexthop latencies pending, continuing read-only mode");
+			return;
+		}
+
 		zlog_info(
 			"Update delay ended, restarted: %d, EORs implicit: %d, explicit: %d",
 			bgp->restarted_peers, bgp->implicit_eors,
@@ -622,7 +632,8 @@ void bgp_keepalive_send(struct peer *peer)
 {
 	struct stream *s;
 
-	s = stream_new(BGP_STANDARD_MESSAGE_MAX_PACKET_SIZE);
+	/* Only the header, sent from the keepalive pthread for every peer */
+	s = stream_new(BGP_HEADER_SIZE);
 
 	/* Make keepalive packet. */
 	bgp_packet_set_marker(s, BGP_MSG_KEEPALIVE);
@@ -2327,9 +2338,6 @@ static int bgp_update_receive(struct peer_connection *connection,
 
 	peer->update_time = monotime(NULL);
 
-	/* Notify BGP Conditional advertisement scanner process */
-	peer->advmap_table_change = true;
-
 	return Receive_UPDATE_message;
 }
 
@@ -3364,6 +3372,8 @@ void bgp_process_packet(struct event *thread)
 
 		frr_with_mutex (&connection->io_mtx) {
 			peer->curr = stream_fifo_pop(connection->ibuf);
+			peer->curr_prep = bgp_preparse_take(connection,
+							    peer->curr);
 		}
 
 		if (peer->curr == NULL) // no packets to process, hmm...
@@ -3468,8 +3478,9 @@ void bgp_process_packet(struct event *thread)
 		}
 
 		/* delete processed packet */
-		stream_free(peer->curr);
+		bgp_pkt_stream_free(peer->curr);
 		peer->curr = NULL;
+		bgp_preparse_free(&peer->curr_prep);
 		processed++;
 
 		/* Update FSM */
@@ -0,0 +1,483 @@
+/*
+ * UPDATE pre-parse workers.
+ *
+ * The workers are frr_pthreads running their own loop on a condition, like
+ * the keepalives pthread, taking connections off a shared queue. A worker
+ * holds a connection for at most BGP_PREPARSE_QUANTA packets before putting
+ * it back at the tail, so one busy full feed does not starve the others.
+ */
+#include "zebra.h"
+
+#include "lib/frr_pthread.h"
+#include "lib/frrcu.h"
+#include "lib/memory.h"
+#include "lib/stream.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_community.h"
+#include "bgpd/bgp_lcommunity.h"
+#include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_preparse.h"
+
+DEFINE_MTYPE_STATIC(BGPD, BGP_PREPARSE, "BGP pre-parsed UPDATE");
+DEFINE_MTYPE_STATIC(BGPD, BGP_PREPARSE_POOL, "BGP UPDATE parse workers");
+
+#define BGP_PREPARSE_QUANTA 64
+
+/* connection->preparse_flags, requires pool.mtx */
+#define BGP_PREPARSE_QUEUED  (1 << 0)
+#define BGP_PREPARSE_RUNNING (1 << 1)
+/* More packets arrived while RUNNING */
+#define BGP_PREPARSE_KICKED  (1 << 2)
+
+DECLARE_DLIST(bgp_preparse_queue, struct peer_connection, preparse_item);
+
+static struct {
+	struct frr_pthread **workers;
+	/* Running workers; requires mtx to change */
+	_Atomic unsigned int count;
+
+	pthread_mutex_t mtx;
+	/* Work was queued, or a worker is to stop */
+	pthread_cond_t wake;
+	/* A connection was released by whoever was working it */
+	pthread_cond_t idle;
+	/* Connections waiting for a worker; requires mtx */
+	struct bgp_preparse_queue_head queue;
+} pool = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.wake = PTHREAD_COND_INITIALIZER,
+	.idle = PTHREAD_COND_INITIALIZER,
+	.queue = INIT_DLIST(pool.queue),
+};
+
+bool bgp_preparse_enabled(void)
+{
+	return atomic_load_explicit(&pool.count, memory_order_relaxed) > 0;
+}
+
+void bgp_preparse_free(struct bgp_preparse **prep)
+{
+	if (!*prep)
+		return;
+
+	if ((*prep)->aspath)
+		aspath_free((*prep)->aspath);
+	if ((*prep)->as4_path)
+		aspath_free((*prep)->as4_path);
+	community_free(&(*prep)->community);
+	lcommunity_free(&(*prep)->lcommunity);
+
+	XFREE(MTYPE_BGP_PREPARSE, *prep);
+}
+
+void bgp_preparse_clean(struct peer_connection *connection)
+{
+	struct bgp_preparse *prep;
+
+	while ((prep = bgp_preparse_list_pop(&connection->ibuf_prep)))
+		bgp_preparse_free(&prep);
+}
+
+struct bgp_preparse *bgp_preparse_take(struct peer_connection *connection,
+				       const struct stream *pkt)
+{
+	struct bgp_preparse *prep = bgp_preparse_list_first(&connection->ibuf_prep);
+
+	/* Packets and their values are queued in the same order */
+	if (!pkt || !prep || prep->pkt != pkt)
+		return NULL;
+
+	return bgp_preparse_list_pop(&connection->ibuf_prep);
+}
+
+/*
+ * Walk the attributes of an UPDATE and decode the ones worth it. Anything
+ * that does not add up is left alone, for bgp_attr_parse() to find and
+ * report. The worker owns pkt until it is pushed to ibuf, so moving its
+ * getp around is fine as long as it is put back.
+ */
+static struct bgp_preparse *bgp_preparse_update(struct peer *peer,
+						struct stream *pkt)
+{
+	struct bgp_preparse *prep;
+	size_t end = stream_get_endp(pkt);
+	size_t at = BGP_HEADER_SIZE;
+	uint64_t seen = 0;
+
+	if (stream_getc_from(pkt, BGP_MARKER_SIZE + 2) != BGP_MSG_UPDATE)
+		return NULL;
+
+	if (at + 2 > end)
+		return NULL;
+	at += 2 + stream_getw_from(pkt, at);
+	if (at + 2 > end)
+		return NULL;
+	end = at + 2 + stream_getw_from(pkt, at);
+	at += 2;
+	if (end > stream_get_endp(pkt) || at == end)
+		return NULL;
+
+	prep = XCALLOC(MTYPE_BGP_PREPARSE, sizeof(*prep));
+	prep->pkt = pkt;
+	prep->as4 = CHECK_FLAG(peer->cap, PEER_CAP_AS4_RCV) &&
+		    CHECK_FLAG(peer->cap, PEER_CAP_AS4_ADV);
+	prep->asnotation = bgp_get_asnotation(peer->bgp);
+
+	while (at + 3 <= end) {
+		uint8_t flag = stream_getc_from(pkt, at);
+		uint8_t type = stream_getc_from(pkt, at + 1);
+		size_t headersz = CHECK_FLAG(flag, BGP_ATTR_FLAG_EXTLEN) ? 4
+									  : 3;
+		bgp_size_t length;
+
+		if (at + headersz > end)
+			break;
+		length = headersz == 4 ? stream_getw_from(pkt, at + 2)
+				       : stream_getc_from(pkt, at + 2);
+		at += headersz;
+		if (at + length > end)
+			break;
+
+		/* Duplicates are bgp_attr_parse()'s to deal with */
+		if (type < 64 && CHECK_FLAG(seen, (uint64_t)1 << type)) {
+			at += length;
+			continue;
+		}
+		if (type < 64)
+			SET_FLAG(seen, (uint64_t)1 << type);
+
+		switch (type) {
+		case BGP_ATTR_AS_PATH:
+			stream_set_getp(pkt, at);
+			prep->aspath = aspath_parse_new(pkt, length, prep->as4,
+							prep->asnotation);
+			prep->aspath_at = at;
+			prep->aspath_len = length;
+			break;
+		case BGP_ATTR_AS4_PATH:
+			stream_set_getp(pkt, at);
+			prep->as4_path = aspath_parse_new(pkt, length, 1,
+							  prep->asnotation);
+			prep->as4_path_at = at;
+			prep->as4_path_len = length;
+			break;
+		case BGP_ATTR_COMMUNITIES:
+			if (length && !(length % COMMUNITY_SIZE)) {
+				struct community tmp = {
+					.size = length / COMMUNITY_SIZE,
+					.val = (uint32_t *)(STREAM_DATA(pkt) +
+							    at),
+				};
+
+				prep->community = community_uniq_sort(&tmp);
+				prep->community_at = at;
+				prep->community_len = length;
+			}
+			break;
+		case BGP_ATTR_LARGE_COMMUNITIES:
+			if (length && !(length % LCOMMUNITY_SIZE)) {
+				struct lcommunity tmp = {
+					.size = length / LCOMMUNITY_SIZE,
+					.val = STREAM_DATA(pkt) + at,
+				};
+
+				prep->lcommunity = lcommunity_uniq_sort(&tmp);
+				prep->lcommunity_at = at;
+				prep->lcommunity_len = length;
+			}
+			break;
+		default:
+			break;
+		}
+
+		at += length;
+	}
+	stream_set_getp(pkt, 0);
+
+	if (!prep->aspath && !prep->as4_path && !prep->community &&
+	    !prep->lcommunity)
+		XFREE(MTYPE_BGP_PREPARSE, prep);
+
+	return prep;
+}
+
+/*
+ * Move up to BGP_PREPARSE_QUANTA packets from ibuf_parse to ibuf, decoding
+ * them on the way if asked to. Returns whether some were left.
+ */
+static bool bgp_preparse_drain(struct peer_connection *connection, bool parse)
+{
+	struct bgp_preparse *prep;
+	struct stream *pkt;
+	unsigned int moved;
+	bool more = false;
+
+	for (moved = 0; moved < BGP_PREPARSE_QUANTA; moved++) {
+		frr_with_mutex (&connection->io_mtx) {
+			pkt = stream_fifo_pop(connection->ibuf_parse);
+		}
+		if (!pkt)
+			break;
+
+		prep = parse ? bgp_preparse_update(connection->peer, pkt)
+			     : NULL;
+
+		frr_with_mutex (&connection->io_mtx) {
+			stream_fifo_push(connection->ibuf, pkt);
+			if (prep)
+				bgp_preparse_list_add_tail(&connection->ibuf_prep,
+							   prep);
+			more = connection->ibuf_parse->count > 0;
+		}
+	}
+
+	if (moved)
+		event_inject(bm->master, &connection->process_inject);
+
+	return more;
+}
+
+/* Done working connection; requires pool.mtx */
+static void bgp_preparse_release(struct peer_connection *connection,
+				 bool requeue)
+{
+	UNSET_FLAG(connection->preparse_flags, BGP_PREPARSE_RUNNING);
+	if (CHECK_FLAG(connection->preparse_flags, BGP_PREPARSE_KICKED))
+		requeue = true;
+	UNSET_FLAG(connection->preparse_flags, BGP_PREPARSE_KICKED);
+
+	if (requeue) {
+		SET_FLAG(connection->preparse_flags, BGP_PREPARSE_QUEUED);
+		bgp_preparse_queue_add_tail(&pool.queue, connection);
+		pthread_cond_signal(&pool.wake);
+	}
+	pthread_cond_broadcast(&pool.idle);
+}
+
+/* Move everything on ibuf_parse undecoded; requires pool.mtx */
+static void bgp_preparse_flush(struct peer_connection *connection)
+{
+	while (CHECK_FLAG(connection->preparse_flags, BGP_PREPARSE_RUNNING))
+		pthread_cond_wait(&pool.idle, &pool.mtx);
+
+	/* A worker may have put it back on its way out */
+	if (CHECK_FLAG(connection->preparse_flags, BGP_PREPARSE_QUEUED)) {
+		bgp_preparse_queue_del(&pool.queue, connection);
+		UNSET_FLAG(connection->preparse_flags, BGP_PREPARSE_QUEUED);
+	}
+
+	SET_FLAG(connection->preparse_flags, BGP_PREPARSE_RUNNING);
+	pthread_mutex_unlock(&pool.mtx);
+	while (bgp_preparse_drain(connection, false))
+		;
+	pthread_mutex_lock(&pool.mtx);
+	UNSET_FLAG(connection->preparse_flags,
+		   BGP_PREPARSE_RUNNING | BGP_PREPARSE_KICKED);
+	pthread_cond_broadcast(&pool.idle);
+}
+
+void bgp_preparse_kick(struct peer_connection *connection)
+{
+	frr_with_mutex (&pool.mtx) {
+		if (CHECK_FLAG(connection->preparse_flags,
+			       BGP_PREPARSE_QUEUED))
+			break;
+		if (!pool.count) {
+			/* The pool went away since these were queued */
+			bgp_preparse_flush(connection);
+			break;
+		}
+		if (CHECK_FLAG(connection->preparse_flags,
+			       BGP_PREPARSE_RUNNING)) {
+			SET_FLAG(connection->preparse_flags,
+				 BGP_PREPARSE_KICKED);
+			break;
+		}
+		SET_FLAG(connection->preparse_flags, BGP_PREPARSE_QUEUED);
+		bgp_preparse_queue_add_tail(&pool.queue, connection);
+		pthread_cond_signal(&pool.wake);
+	}
+}
+
+void bgp_preparse_off(struct peer_connection *connection)
+{
+	frr_with_mutex (&pool.mtx) {
+		bgp_preparse_flush(connection);
+	}
+}
+
+static void *bgp_preparse_worker(void *arg)
+{
+	struct frr_pthread *fpt = arg;
+	struct peer_connection *connection;
+	bool more;
+
+	fpt->master->owner = pthread_self();
+
+	/* Not in an event loop, see bgp_keepalives_start() */
+	rcu_read_unlock();
+	frr_pthread_set_name(fpt);
+	frr_pthread_notify_running(fpt);
+
+	pthread_mutex_lock(&pool.mtx);
+	while (atomic_load_explicit(&fpt->running, memory_order_relaxed)) {
+		connection = bgp_preparse_queue_pop(&pool.queue);
+		if (!connection) {
+			pthread_cond_wait(&pool.wake, &pool.mtx);
+			continue;
+		}
+
+		UNSET_FLAG(connection->preparse_flags, BGP_PREPARSE_QUEUED);
+		SET_FLAG(connection->preparse_flags, BGP_PREPARSE_RUNNING);
+		pthread_mutex_unlock(&pool.mtx);
+
+		more = bgp_preparse_drain(connection, true);
+
+		pthread_mutex_lock(&pool.mtx);
+		bgp_preparse_release(connection, more);
+	}
+	pthread_mutex_unlock(&pool.mtx);
+
+	return NULL;
+}
+
+static int bgp_preparse_worker_stop(struct frr_pthread *fpt, void **result)
+{
+	frr_with_mutex (&pool.mtx) {
+		atomic_store_explicit(&fpt->running, false,
+				      memory_order_relaxed);
+		pthread_cond_broadcast(&pool.wake);
+	}
+
+	pthread_join(fpt->thread, result);
+	return 0;
+}
+
+void bgp_preparse_workers_set(unsigned int threads)
+{
+	struct frr_pthread_attr attr = {
+		.start = bgp_preparse_worker,
+		.stop = bgp_preparse_worker_stop,
+	};
+	struct peer_connection *connection;
+	unsigned int count = pool.count;
+	char name[64], os_name[16];
+
+	while (count > threads) {
+		struct frr_pthread *fpt = pool.workers[--count];
+
+		frr_pthread_stop(fpt, NULL);
+		frr_pthread_destroy(fpt);
+		frr_with_mutex (&pool.mtx) {
+			pool.count = count;
+		}
+	}
+
+	if (threads > count) {
+		pool.workers = XREALLOC(MTYPE_BGP_PREPARSE_POOL, pool.workers,
+					threads * sizeof(*pool.workers));
+		while (count < threads) {
+			struct frr_pthread *fpt;
+
+			snprintf(name, sizeof(name), "BGP UPDATE parser %u",
+				 count + 1);
+			snprintf(os_name, sizeof(os_name), "bgpd_parse%u",
+				 count + 1);
+			fpt = frr_pthread_new(&attr, name, os_name);
+			frr_pthread_run(fpt, NULL);
+			frr_pthread_wait_running(fpt);
+			pool.workers[count++] = fpt;
+			frr_with_mutex (&pool.mtx) {
+				pool.count = count;
+			}
+		}
+	}
+
+	if (!count) {
+		XFREE(MTYPE_BGP_PREPARSE_POOL, pool.workers);
+
+		/* Nobody is left to take these */
+		frr_with_mutex (&pool.mtx) {
+			while ((connection = bgp_preparse_queue_first(
+					&pool.queue)))
+				bgp_preparse_flush(connection);
+		}
+	}
+
+	zlog_info("BGP UPDATE decoding on %u worker(s)", count);
+}
+
+static bool bgp_preparse_match(struct peer *peer, const void *val, size_t at,
+			       bgp_size_t len, bgp_size_t length)
+{
+	return val && at == stream_get_getp(peer->curr) && len == length;
+}
+
+struct aspath *bgp_preparse_aspath(struct peer *peer, bool as4_path,
+				   bgp_size_t length, bool use32bit,
+				   enum asnotation_mode asnotation)
+{
+	struct bgp_preparse *prep = peer->curr_prep;
+	struct aspath **aspath, *found;
+
+	if (!prep || prep->asnotation != asnotation)
+		return NULL;
+
+	if (as4_path) {
+		if (!bgp_preparse_match(peer, prep->as4_path,
+					prep->as4_path_at, prep->as4_path_len,
+					length))
+			return NULL;
+		aspath = &prep->as4_path;
+	} else {
+		if (prep->as4 != use32bit ||
+		    !bgp_preparse_match(peer, prep->aspath, prep->aspath_at,
+					prep->aspath_len, length))
+			return NULL;
+		aspath = &prep->aspath;
+	}
+
+	stream_forward_getp(peer->curr, length);
+	found = aspath_intern(*aspath);
+	*aspath = NULL;
+
+	return found;
+}
+
+struct community *bgp_preparse_community(struct peer *peer, bgp_size_t length)
+{
+	struct bgp_preparse *prep = peer->curr_prep;
+	struct community *comm;
+
+	if (!prep || !bgp_preparse_match(peer, prep->community,
+					 prep->community_at,
+					 prep->community_len, length))
+		return NULL;
+
+	stream_forward_getp(peer->curr, length);
+	comm = community_intern(prep->community);
+	prep->community = NULL;
+
+	return comm;
+}
+
+struct lcommunity *bgp_preparse_lcommunity(struct peer *peer,
+					   bgp_size_t length)
+{
+	struct bgp_preparse *prep = peer->curr_prep;
+	struct lcommunity *lcomm;
+
+	if (!prep || !bgp_preparse_match(peer, prep->lcommunity,
+					 prep->lcommunity_at,
+					 prep->lcommunity_len, length))
+		return NULL;
+
+	stream_forward_getp(peer->curr, length);
+	lcomm = lcommunity_intern(prep->lcommunity);
+	prep->lcommunity = NULL;
+
+	return lcomm;
+}
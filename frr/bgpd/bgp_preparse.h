@@ -0,0 +1,74 @@
+#ifndef _BGP_PREPARSE_H
+#define _BGP_PREPARSE_H
+
+/*
+ * UPDATE decoding off the main thread. With workers configured, the I/O
+ * pthread queues what it reads on connection->ibuf_parse instead of ibuf,
+ * and a worker walks each UPDATE there, building its AS_PATH, AS4_PATH,
+ * COMMUNITY and LARGE_COMMUNITY values before moving it on to ibuf. The
+ * values are not interned, since the attribute hashes belong to the main
+ * thread; bgp_attr_parse() interns the prepared value for the attribute at
+ * hand instead of decoding it, and decodes as before when there is none.
+ *
+ * A connection is worked by one worker at a time, so its packets reach
+ * ibuf in the order they were read.
+ */
+
+struct bgp_preparse {
+	struct bgp_preparse_list_item item;
+
+	/* The packet these were decoded from */
+	const struct stream *pkt;
+
+	/* What the AS paths were decoded with */
+	bool as4;
+	enum asnotation_mode asnotation;
+
+	/* Offset of each value in pkt, with its length; unset if NULL */
+	size_t aspath_at, as4_path_at, community_at, lcommunity_at;
+	bgp_size_t aspath_len, as4_path_len, community_len, lcommunity_len;
+
+	struct aspath *aspath;
+	struct aspath *as4_path;
+	struct community *community;
+	struct lcommunity *lcommunity;
+};
+
+DECLARE_LIST(bgp_preparse_list, struct bgp_preparse, item);
+
+/* Whether the I/O pthread should queue packets on ibuf_parse */
+extern bool bgp_preparse_enabled(void);
+
+/* From the I/O pthread, after pushing to connection->ibuf_parse */
+extern void bgp_preparse_kick(struct peer_connection *connection);
+
+/*
+ * Wait for the workers to be done with the connection and move what is
+ * still on its ibuf_parse to ibuf, undecoded. Called as reads go off.
+ */
+extern void bgp_preparse_off(struct peer_connection *connection);
+
+/* The prepared values of pkt, just popped from ibuf; requires io_mtx */
+extern struct bgp_preparse *bgp_preparse_take(struct peer_connection *connection,
+					      const struct stream *pkt);
+extern void bgp_preparse_free(struct bgp_preparse **prep);
+/* Free everything on ibuf_prep, as ibuf is cleaned; requires io_mtx */
+extern void bgp_preparse_clean(struct peer_connection *connection);
+
+/*
+ * Lookups for bgp_attr_parse(): the interned value prepared for the
+ * attribute of this length at the getp of peer->curr, which is moved past
+ * it, or NULL to decode it as usual.
+ */
+extern struct aspath *bgp_preparse_aspath(struct peer *peer, bool as4_path,
+					  bgp_size_t length, bool use32bit,
+					  enum asnotation_mode asnotation);
+extern struct community *bgp_preparse_community(struct peer *peer,
+					       bgp_size_t length);
+extern struct lcommunity *bgp_preparse_lcommunity(struct peer *peer,
+						 bgp_size_t length);
+
+/* Resize the pool, 0 turning the decoding off */
+extern void bgp_preparse_workers_set(unsigned int threads);
+
+#endif
@@ -74,6 +74,8 @@
 #include "bgpd/bgp_flowspec_util.h"
 #include "bgpd/bgp_pbr.h"
 #include "bgpd/bgp_twamp.h"
+#include "bgpd/bgp_conditional_adv.h"
+#include "bgpd/bgp_select.h"
 
 #include "bgpd/bgp_route_clippy.c"
 
@@ -113,6 +115,12 @@ DEFINE_HOOK(bgp_process,
 	     struct peer *peer, bool withdraw),
 	    (bgp, afi, safi, bn, peer, withdraw));
 
+DEFINE_HOOK(bgp_route_update,
+	    (struct bgp *bgp, afi_t afi, safi_t safi, struct bgp_dest *bn,
+	     struct bgp_path_info *old_route,
+	     struct bgp_path_info *new_route),
+	    (bgp, afi, safi, bn, old_route, new_route));
+
 /** Test if path is suppressed. */
 bool bgp_path_suppressed(struct bgp_path_info *pi)
 {
@@ -183,12 +191,16 @@ struct bgp_dest *bgp_safi_node_lookup(struct bgp_table *table, safi_t safi,
 	return dest;
 }
 
+struct bgp_arena bgp_path_info_arena =
+	BGP_ARENA_INIT(MTYPE_BGP_ROUTE, struct bgp_path_info);
+struct bgp_arena bgp_path_info_extra_arena =
+	BGP_ARENA_INIT(MTYPE_BGP_ROUTE_EXTRA, struct bgp_path_info_extra);
+
 /* Allocate bgp_path_info_extra */
 static struct bgp_path_info_extra *bgp_path_info_extra_new(void)
 {
 	struct bgp_path_info_extra *new;
-	new = XCALLOC(MTYPE_BGP_ROUTE_EXTRA,
-		      sizeof(struct bgp_path_info_extra));
+	new = bgp_arena_alloc(&bgp_path_info_extra_arena);
 	new->label[0] = MPLS_INVALID_LABEL;
 	new->num_labels = 0;
 	new->flowspec = NULL;
@@ -203,9 +215,12 @@ void bgp_path_info_extra_free(struct bgp_path_info_extra **extra)
 		return;
 
 	e = *extra;
-	if (e->damp_info)
-		bgp_damp_info_free(e->damp_info, 0, e->damp_info->afi,
-				   e->damp_info->safi);
+	if (e->damp_info) {
+		struct bgp_table *table =
+			bgp_dest_table(e->damp_info->path->net);
+
+		bgp_damp_info_free(e->damp_info, 0, table->afi, table->safi);
+	}
 
 	e->damp_info = NULL;
 	if (e->vrfleak && e->vrfleak->parent) {
@@ -258,7 +273,8 @@ void bgp_path_info_extra_free(struct bgp_path_info_extra **extra)
 	if (e->vrfleak)
 		XFREE(MTYPE_BGP_ROUTE_EXTRA_VRFLEAK, e->vrfleak);
 
-	XFREE(MTYPE_BGP_ROUTE_EXTRA, *extra);
+	bgp_arena_free(&bgp_path_info_extra_arena, *extra);
+	*extra = NULL;
 }
 
 /* Get bgp_path_info extra information for the given bgp_path_info, lazy
@@ -291,7 +307,7 @@ void bgp_path_info_free_with_caller(const char *name,
 
 	peer_unlock(path->peer); /* bgp_path_info peer reference */
 
-	XFREE(MTYPE_BGP_ROUTE, path);
+	bgp_arena_free(&bgp_path_info_arena, path);
 }
 
 struct bgp_path_info *bgp_path_info_lock(struct bgp_path_info *path)
@@ -382,7 +398,7 @@ static int bgp_dest_set_defer_flag(struct bgp_dest *dest, bool delete)
 		/* Route selection is deferred if there is a stale path which
 		 * which indicates peer is in restart mode
 		 */
-		if (CHECK_FLAG(old_pi->flags, BGP_PATH_STALE)
+		if (bgp_path_info_stale(old_pi)
 		    && (old_pi->sub_type == BGP_ROUTE_NORMAL)) {
 			set_flag = true;
 		} else {
@@ -418,6 +434,43 @@ static int bgp_dest_set_defer_flag(struct bgp_dest *dest, bool delete)
 	return -1;
 }
 
+/*
+ * Stale epoch of peer for the table of dest, NULL when the table is not one
+ * of the peer's instance, e.g. for paths leaked into a VRF.
+ */
+static uint32_t *bgp_stale_epoch(struct peer *peer, struct bgp_dest *dest)
+{
+	struct bgp_table *table = bgp_dest_table(dest);
+
+	if (!peer || !table || table->bgp != peer->bgp)
+		return NULL;
+	return &peer->stale_epoch[table->afi][table->safi];
+}
+
+/* Take pi as received in the current stale epoch of its peer */
+static void bgp_path_info_refresh_epoch(struct bgp_dest *dest,
+					struct bgp_path_info *pi)
+{
+	uint32_t *epoch = bgp_stale_epoch(pi->peer, dest);
+
+	if (epoch)
+		pi->stale_epoch = *epoch;
+}
+
+/*
+ * A path is stale when it was not received again since its peer was last
+ * marked stale; damped and removed paths are never stale.
+ */
+bool bgp_path_info_stale(const struct bgp_path_info *pi)
+{
+	const uint32_t *epoch;
+
+	if (!pi->net || CHECK_FLAG(pi->flags, BGP_PATH_UNUSEABLE))
+		return false;
+	epoch = bgp_stale_epoch(pi->peer, pi->net);
+	return epoch && *epoch != pi->stale_epoch;
+}
+
 void bgp_path_info_add_with_caller(const char *name, struct bgp_dest *dest,
 				   struct bgp_path_info *pi)
 {
@@ -435,6 +488,7 @@ void bgp_path_info_add_with_caller(const char *name, struct bgp_dest *dest,
 	bgp_path_info_lock(pi);
 	bgp_dest_lock_node(dest);
 	peer_lock(pi->peer); /* bgp_path_info peer reference */
+	bgp_path_info_refresh_epoch(dest, pi);
 	bgp_dest_set_defer_flag(dest, false);
 	hook_call(bgp_snmp_update_stats, dest, pi, true);
 }
@@ -605,12 +659,18 @@ struct bgp_path_info *bgp_get_imported_bpi_ultimate(struct bgp_path_info *info)
 }
 
 /* Compare two bgp route entity.  If 'new' is preferable over 'exist' return 1.
+ *
+ * Only the optional steps set in steps are taken.  Inlined into each of
+ * the comparators below, where steps is a constant for all but the
+ * generic one, so the steps an instance has not enabled cost nothing.
  */
-int bgp_path_info_cmp(struct bgp *bgp, struct bgp_path_info *new,
-		      struct bgp_path_info *exist, int *paths_eq,
-		      struct bgp_maxpaths_cfg *mpath_cfg, bool debug,
-		      char *pfx_buf, afi_t afi, safi_t safi,
-		      enum bgp_path_selection_reason *reason)
+static inline __attribute__((always_inline)) int
+bgp_path_info_cmp_steps(struct bgp *bgp, struct bgp_path_info *new,
+			struct bgp_path_info *exist, int *paths_eq,
+			struct bgp_maxpaths_cfg *mpath_cfg, bool debug,
+			char *pfx_buf, afi_t afi, safi_t safi,
+			enum bgp_path_selection_reason *reason,
+			const uint32_t steps)
 {
 	const struct prefix *new_p;
 	struct attr *newattr, *existattr;
@@ -622,13 +682,22 @@ int bgp_path_info_cmp(struct bgp *bgp, struct bgp_path_info *new,
 	uint32_t exist_med;
 	uint32_t new_weight;
 	uint32_t exist_weight;
+	uint32_t new_latency;
+	uint32_t exist_latency;
+	uint16_t new_loss;
+	uint16_t exist_loss;
+	uint16_t loss_threshold;
+	uint32_t new_margin;
+	uint32_t exist_margin;
 	uint32_t newm, existm;
 	struct in_addr new_id;
 	struct in_addr exist_id;
 	int new_cluster;
 	int exist_cluster;
+	int new_hops = 0, exist_hops = 0;
 	int internal_as_route;
 	int confed_as_route;
+	bool compare_med;
 	int ret = 0;
 	int igp_metric_ret = 0;
 	int peer_sort_ret = -1;
@@ -860,85 +929,109 @@ int bgp_path_info_cmp(struct bgp *bgp, struct bgp_path_info *new,
 			return 0;
 		}
 	}
-/* 0.5. Latency-based weight adjustment (before weight check) */
-	if (bgp->import_latency_cfg.enabled) {
-		fprintf(stderr, "*** TWAMP DEBUG: Weight adjustment called\n"); fflush(stderr);
-		/* Get ultimate peer for imported routes */
-		struct bgp_path_info *new_ultimate = bgp_get_imported_bpi_ultimate(new);
-		struct bgp_path_info *exist_ultimate = bgp_get_imported_bpi_ultimate(exist);
-		fprintf(stderr, "*** TWAMP: Got ultimate peers, new=%p exist=%p\n", (void*)new_ultimate, (void*)exist_ultimate); fflush(stderr);
-		/* Only apply to IBGP peers */
-		if (new_ultimate->peer && exist_ultimate->peer &&
-		    new_ultimate->peer->sort == BGP_PEER_IBGP && 
-		    exist_ultimate->peer->sort == BGP_PEER_IBGP) {
-			fprintf(stderr, "*** TWAMP: Inside IBGP check\n"); fflush(stderr);
-			
-			struct in_addr new_peer_ip, exist_peer_ip;
-			uint32_t new_latency = UINT32_MAX;
-			uint32_t exist_latency = UINT32_MAX;
-			
-			/* Get peer IPs */
-			if (new_ultimate->peer->connection && 
-			    new_ultimate->peer->connection->su.sa.sa_family == AF_INET) {
-				new_peer_ip.s_addr = new_ultimate->peer->connection->su.sin.sin_addr.s_addr;
-					{ char buf[INET_ADDRSTRLEN]; inet_ntop(AF_INET, &new_peer_ip, buf, sizeof(buf)); fprintf(stderr, "*** TWAMP: Looking up new peer IP: %s\n", buf); fflush(stderr); }
-				new_latency = bgp_twamp_get_latency(&new_peer_ip);
-					fprintf(stderr, "*** TWAMP: new_latency=%u\n", new_latency); fflush(stderr);
-			}
-			
-			if (exist_ultimate->peer->connection && 
-			    exist_ultimate->peer->connection->su.sa.sa_family == AF_INET) {
-				exist_peer_ip.s_addr = exist_ultimate->peer->connection->su.sin.sin_addr.s_addr;
-					{ char buf[INET_ADDRSTRLEN]; inet_ntop(AF_INET, &exist_peer_ip, buf, sizeof(buf)); fprintf(stderr, "*** TWAMP: Looking up exist peer IP: %s\n", buf); fflush(stderr); }
-				exist_latency = bgp_twamp_get_latency(&exist_peer_ip);
-					fprintf(stderr, "*** TWAMP: exist_latency=%u\n", exist_latency); fflush(stderr);
+	/*
+	 * 0.5. Measured latency to the nexthops of the (ultimate) iBGP
+	 * paths. Only a difference beyond the damping threshold decides;
+	 * closer paths, or one without a measurement, go on to the usual
+	 * steps and stay
+	 * multipath candidates. The selected path keeps a latency win down
+	 * to the smaller switch-back threshold, so a difference hovering
+	 * around the damping threshold does not flip the route each cycle.
+	 * The attributes are never written: they are interned and shared
+	 * with unrelated paths.
+	 *
+	 * Before that, with a loss threshold set, a path via a nexthop losing
+	 * that many probes loses to one that is not: the PE is as good as
+	 * gone, whatever the other steps say.
+	 *
+	 * Steering by colour, the latency is left to the SR policies and only
+	 * the loss step applies here.
+	 */
+	if (CHECK_FLAG(steps, BGP_BESTPATH_STEP_LATENCY)) {
+		struct bgp_path_info *new_ultimate;
+		struct bgp_path_info *exist_ultimate;
+
+		loss_threshold = bgp->import_latency_cfg.loss_threshold_permille;
+		new_loss = bgp_twamp_path_loss(new);
+		exist_loss = bgp_twamp_path_loss(exist);
+
+		if (loss_threshold && (new_loss >= loss_threshold) !=
+					      (exist_loss >= loss_threshold)) {
+			*reason = bgp_path_selection_loss;
+			if (debug)
+				zlog_debug("%s: %s %s %s due to probe loss %u.%u%% vs %u.%u%%",
+					   pfx_buf, new_buf,
+					   new_loss < loss_threshold
+						   ? "wins over"
+						   : "loses to",
+					   exist_buf, new_loss / 10,
+					   new_loss % 10, exist_loss / 10,
+					   exist_loss % 10);
+			return new_loss < loss_threshold;
+		}
+
+		new_ultimate = bgp_get_imported_bpi_ultimate(new);
+		exist_ultimate = bgp_get_imported_bpi_ultimate(exist);
+
+		if (!bgp->import_latency_cfg.color_steering &&
+		    new_ultimate->peer && exist_ultimate->peer &&
+		    new_ultimate->peer->sort == exist_ultimate->peer->sort &&
+		    (new_ultimate->peer->sort == BGP_PEER_IBGP ||
+		     new_ultimate->peer->sort == BGP_PEER_EBGP)) {
+			/*
+			 * Per-nexthop snapshot, refreshed by bgp_twamp: the
+			 * egress PE, not the session, so paths reflected by
+			 * the same RR still differ. Unmeasured nexthops go by
+			 * the latency their paths were advertised with.
+			 * Between eBGP paths it is the latency through their
+			 * exit towards the destination, see bgp_twamp_egress.c.
+			 */
+			new_latency = bgp_twamp_path_latency(new);
+			exist_latency = bgp_twamp_path_latency(exist);
+
+			/* Margin each path needs to win by */
+			new_margin = exist_margin =
+				bgp->import_latency_cfg.damping_threshold_us;
+			if (CHECK_FLAG(new->flags, BGP_PATH_SELECTED))
+				new_margin = MIN(bgp->import_latency_cfg
+							 .switch_back_threshold_us,
+						 new_margin);
+			if (CHECK_FLAG(exist->flags, BGP_PATH_SELECTED))
+				exist_margin = MIN(bgp->import_latency_cfg
+							   .switch_back_threshold_us,
+						   exist_margin);
+
+			if (new_latency != UINT32_MAX &&
+			    exist_latency != UINT32_MAX &&
+			    new_latency < exist_latency &&
+			    exist_latency - new_latency > new_margin) {
+				*reason = bgp_path_selection_latency;
+				frrtrace(5, frr_bgp, twamp_bestpath, new,
+					 new_latency, exist_latency,
+					 new_margin, true);
+				if (debug)
+					zlog_debug("%s: %s wins over %s due to latency %uus < %uus (threshold %uus)",
+						   pfx_buf, new_buf, exist_buf,
+						   new_latency, exist_latency,
+						   new_margin);
+				return 1;
 			}
-			
-			/* Apply latency-based weight adjustment */
-			fprintf(stderr, "*** WEIGHT: new_lat=%u exist_lat=%u (UINT32_MAX=%u)\n", new_latency, exist_latency, UINT32_MAX); fflush(stderr);
-			if (new_latency != UINT32_MAX && exist_latency != UINT32_MAX) {
-				uint32_t latency_diff = (new_latency > exist_latency) ? 
-				                        (new_latency - exist_latency) : 
-				                        (exist_latency - new_latency);
-				
-				if (latency_diff <= bgp->import_latency_cfg.damping_threshold) {
-					fprintf(stderr, "*** WEIGHT: Within threshold, setting both to 32768\n"); fflush(stderr);
-					/* Both paths within threshold - set both to max/2 for ECMP */
-					newattr->weight = 32768;
-						fprintf(stderr, "*** TWAMP: SET newattr->weight=32768\n"); fflush(stderr);
-					existattr->weight = 32768;
-						fprintf(stderr, "*** TWAMP: SET existattr->weight=32768\n"); fflush(stderr);
-					if (debug)
-						zlog_debug("%s: Both paths set to weight 32768 (latency diff %ums <= threshold %ums, new=%ums, exist=%ums)",
-						           pfx_buf, latency_diff, 
-						           bgp->import_latency_cfg.damping_threshold,
-						           new_latency, exist_latency);
-				} else {
-					/* Latency difference exceeds threshold */
-					if (new_latency < exist_latency) {
-						/* New path has lower latency */
-						newattr->weight = 32768;
-						fprintf(stderr, "*** TWAMP: SET newattr->weight=32768\n"); fflush(stderr);
-						existattr->weight = 0;
-						if (debug)
-							zlog_debug("%s: %s weight=32768, %s weight=0 (latency %ums < %ums, diff %ums > threshold %ums)",
-							           pfx_buf, new_buf, exist_buf,
-							           new_latency, exist_latency, latency_diff,
-							           bgp->import_latency_cfg.damping_threshold);
-					} else {
-						/* Exist path has lower latency */
-						newattr->weight = 0;
-						existattr->weight = 32768;
-						fprintf(stderr, "*** TWAMP: SET existattr->weight=32768\n"); fflush(stderr);
-						if (debug)
-							zlog_debug("%s: %s weight=0, %s weight=32768 (latency %ums > %ums, diff %ums > threshold %ums)",
-							           pfx_buf, new_buf, exist_buf,
-							           new_latency, exist_latency, latency_diff,
-							           bgp->import_latency_cfg.damping_threshold);
-					}
-				}
+
+			if (new_latency != UINT32_MAX &&
+			    exist_latency != UINT32_MAX &&
+			    new_latency > exist_latency &&
+			    new_latency - exist_latency > exist_margin) {
+				*reason = bgp_path_selection_latency;
+				frrtrace(5, frr_bgp, twamp_bestpath, new,
+					 new_latency, exist_latency,
+					 exist_margin, false);
+				if (debug)
+					zlog_debug("%s: %s loses to %s due to latency %uus > %uus (threshold %uus)",
+						   pfx_buf, new_buf, exist_buf,
+						   new_latency, exist_latency,
+						   exist_margin);
+				return 0;
 			}
-			/* If either peer unreachable, don't touch weights - use default BGP behavior */
 		}
 	}
 
@@ -1061,9 +1154,9 @@ int bgp_path_info_cmp(struct bgp *bgp, struct bgp_path_info *new,
 	}
 
 	/* 3.5. Tie-breaker - AIGP (Metric TLV) attribute */
-	if (CHECK_FLAG(newattr->flag, ATTR_FLAG_BIT(BGP_ATTR_AIGP)) &&
-	    CHECK_FLAG(existattr->flag, ATTR_FLAG_BIT(BGP_ATTR_AIGP)) &&
-	    CHECK_FLAG(bgp->flags, BGP_FLAG_COMPARE_AIGP)) {
+	if (CHECK_FLAG(steps, BGP_BESTPATH_STEP_AIGP) &&
+	    CHECK_FLAG(newattr->flag, ATTR_FLAG_BIT(BGP_ATTR_AIGP)) &&
+	    CHECK_FLAG(existattr->flag, ATTR_FLAG_BIT(BGP_ATTR_AIGP))) {
 		uint64_t new_aigp = bgp_aigp_metric_total(new);
 		uint64_t exist_aigp = bgp_aigp_metric_total(exist);
 
@@ -1098,15 +1191,20 @@ int bgp_path_info_cmp(struct bgp *bgp, struct bgp_path_info *new,
 	newattr = new->attr;
 	existattr = exist->attr;
 
-	/* 4. AS path length check. */
-	if (!CHECK_FLAG(bgp->flags, BGP_FLAG_ASPATH_IGNORE)) {
-		int exist_hops = aspath_count_hops(existattr->aspath);
-		int exist_confeds = aspath_count_confeds(existattr->aspath);
+	/* Hop counts walk the AS paths, count them once for steps 4 and 6 */
+	if (!CHECK_FLAG(steps, BGP_BESTPATH_STEP_ASPATH_IGNORE) ||
+	    !CHECK_FLAG(steps, BGP_BESTPATH_STEP_ALWAYS_MED)) {
+		new_hops = aspath_count_hops(newattr->aspath);
+		exist_hops = aspath_count_hops(existattr->aspath);
+	}
 
-		if (CHECK_FLAG(bgp->flags, BGP_FLAG_ASPATH_CONFED)) {
+	/* 4. AS path length check. */
+	if (!CHECK_FLAG(steps, BGP_BESTPATH_STEP_ASPATH_IGNORE)) {
+		if (CHECK_FLAG(steps, BGP_BESTPATH_STEP_ASPATH_CONFED)) {
+			int exist_confeds = aspath_count_confeds(existattr->aspath);
 			int aspath_hops;
 
-			aspath_hops = aspath_count_hops(newattr->aspath);
+			aspath_hops = new_hops;
 			aspath_hops += aspath_count_confeds(newattr->aspath);
 
 			if (aspath_hops < (exist_hops + exist_confeds)) {
@@ -1131,25 +1229,23 @@ int bgp_path_info_cmp(struct bgp *bgp, struct bgp_path_info *new,
 				return 0;
 			}
 		} else {
-			int newhops = aspath_count_hops(newattr->aspath);
-
-			if (newhops < exist_hops) {
+			if (new_hops < exist_hops) {
 				*reason = bgp_path_selection_as_path;
 				if (debug)
 					zlog_debug(
 						"%s: %s wins over %s due to aspath hopcount %d < %d",
 						pfx_buf, new_buf, exist_buf,
-						newhops, exist_hops);
+						new_hops, exist_hops);
 				return 1;
 			}
 
-			if (newhops > exist_hops) {
+			if (new_hops > exist_hops) {
 				*reason = bgp_path_selection_as_path;
 				if (debug)
 					zlog_debug(
 						"%s: %s loses to %s due to aspath hopcount %d > %d",
 						pfx_buf, new_buf, exist_buf,
-						newhops, exist_hops);
+						new_hops, exist_hops);
 				return 0;
 			}
 		}
@@ -1177,18 +1273,23 @@ int bgp_path_info_cmp(struct bgp *bgp, struct bgp_path_info *new,
 	}
 
 	/* 6. MED check. */
-	internal_as_route = (aspath_count_hops(newattr->aspath) == 0
-			     && aspath_count_hops(existattr->aspath) == 0);
-	confed_as_route = (aspath_count_confeds(newattr->aspath) > 0
-			   && aspath_count_confeds(existattr->aspath) > 0
-			   && aspath_count_hops(newattr->aspath) == 0
-			   && aspath_count_hops(existattr->aspath) == 0);
-
-	if (CHECK_FLAG(bgp->flags, BGP_FLAG_ALWAYS_COMPARE_MED)
-	    || (CHECK_FLAG(bgp->flags, BGP_FLAG_MED_CONFED) && confed_as_route)
-	    || aspath_cmp_left(newattr->aspath, existattr->aspath)
-	    || aspath_cmp_left_confed(newattr->aspath, existattr->aspath)
-	    || internal_as_route) {
+	if (CHECK_FLAG(steps, BGP_BESTPATH_STEP_ALWAYS_MED))
+		compare_med = true;
+	else {
+		internal_as_route = (new_hops == 0 && exist_hops == 0);
+		confed_as_route =
+			(CHECK_FLAG(steps, BGP_BESTPATH_STEP_MED_CONFED) &&
+			 internal_as_route &&
+			 aspath_count_confeds(newattr->aspath) > 0 &&
+			 aspath_count_confeds(existattr->aspath) > 0);
+		compare_med =
+			internal_as_route || confed_as_route ||
+			aspath_cmp_left(newattr->aspath, existattr->aspath) ||
+			aspath_cmp_left_confed(newattr->aspath,
+					       existattr->aspath);
+	}
+
+	if (compare_med) {
 		new_med = bgp_med_value(new->attr, bgp);
 		exist_med = bgp_med_value(exist->attr, bgp);
 
@@ -1522,7 +1623,7 @@ int bgp_path_info_cmp(struct bgp *bgp, struct bgp_path_info *new,
 	/* Do this only if neither path is "stale" as stale paths do not have
 	 * valid peer information (as the connection may or may not be up).
 	 */
-	if (CHECK_FLAG(exist->flags, BGP_PATH_STALE)) {
+	if (bgp_path_info_stale(exist)) {
 		*reason = bgp_path_selection_stale;
 		if (debug)
 			zlog_debug(
@@ -1531,7 +1632,7 @@ int bgp_path_info_cmp(struct bgp *bgp, struct bgp_path_info *new,
 		return 1;
 	}
 
-	if (CHECK_FLAG(new->flags, BGP_PATH_STALE)) {
+	if (bgp_path_info_stale(new)) {
 		*reason = bgp_path_selection_stale;
 		if (debug)
 			zlog_debug(
@@ -1579,6 +1680,114 @@ int bgp_path_info_cmp(struct bgp *bgp, struct bgp_path_info *new,
 	return 1;
 }
 
+/*
+ * Comparators for the step sets instances mostly run with: the default
+ * configuration, with or without latency-based selection.  Anything
+ * else takes the generic one, which tests bgp->bestpath_steps as it goes.
+ */
+enum bgp_bestpath_cmp {
+	BGP_BESTPATH_CMP_GENERIC = 0,
+	BGP_BESTPATH_CMP_DEFAULT,
+	BGP_BESTPATH_CMP_LATENCY,
+};
+
+typedef int (*bgp_path_info_cmp_fn)(struct bgp *bgp, struct bgp_path_info *new,
+				    struct bgp_path_info *exist, int *paths_eq,
+				    struct bgp_maxpaths_cfg *mpath_cfg,
+				    bool debug, char *pfx_buf, afi_t afi,
+				    safi_t safi,
+				    enum bgp_path_selection_reason *reason);
+
+static int bgp_path_info_cmp_generic(struct bgp *bgp, struct bgp_path_info *new,
+				     struct bgp_path_info *exist, int *paths_eq,
+				     struct bgp_maxpaths_cfg *mpath_cfg,
+				     bool debug, char *pfx_buf, afi_t afi,
+				     safi_t safi,
+				     enum bgp_path_selection_reason *reason)
+{
+	return bgp_path_info_cmp_steps(bgp, new, exist, paths_eq, mpath_cfg,
+				       debug, pfx_buf, afi, safi, reason,
+				       bgp->bestpath_steps);
+}
+
+static int bgp_path_info_cmp_default(struct bgp *bgp, struct bgp_path_info *new,
+				     struct bgp_path_info *exist, int *paths_eq,
+				     struct bgp_maxpaths_cfg *mpath_cfg,
+				     bool debug, char *pfx_buf, afi_t afi,
+				     safi_t safi,
+				     enum bgp_path_selection_reason *reason)
+{
+	return bgp_path_info_cmp_steps(bgp, new, exist, paths_eq, mpath_cfg,
+				       debug, pfx_buf, afi, safi, reason, 0);
+}
+
+static int bgp_path_info_cmp_latency(struct bgp *bgp, struct bgp_path_info *new,
+				     struct bgp_path_info *exist, int *paths_eq,
+				     struct bgp_maxpaths_cfg *mpath_cfg,
+				     bool debug, char *pfx_buf, afi_t afi,
+				     safi_t safi,
+				     enum bgp_path_selection_reason *reason)
+{
+	return bgp_path_info_cmp_steps(bgp, new, exist, paths_eq, mpath_cfg,
+				       debug, pfx_buf, afi, safi, reason,
+				       BGP_BESTPATH_STEP_LATENCY);
+}
+
+static const bgp_path_info_cmp_fn bgp_path_info_cmp_variants[] = {
+	[BGP_BESTPATH_CMP_GENERIC] = bgp_path_info_cmp_generic,
+	[BGP_BESTPATH_CMP_DEFAULT] = bgp_path_info_cmp_default,
+	[BGP_BESTPATH_CMP_LATENCY] = bgp_path_info_cmp_latency,
+};
+
+/*
+ * Work out the best-path steps from the configuration and pick the
+ * comparator for them.  Called whenever a setting they depend on
+ * changes, which all re-run best-path anyway.
+ */
+void bgp_bestpath_steps_update(struct bgp *bgp)
+{
+	uint32_t steps = 0;
+
+	if (bgp->import_latency_cfg.enabled)
+		SET_FLAG(steps, BGP_BESTPATH_STEP_LATENCY);
+	if (CHECK_FLAG(bgp->flags, BGP_FLAG_COMPARE_AIGP))
+		SET_FLAG(steps, BGP_BESTPATH_STEP_AIGP);
+	if (CHECK_FLAG(bgp->flags, BGP_FLAG_ASPATH_IGNORE))
+		SET_FLAG(steps, BGP_BESTPATH_STEP_ASPATH_IGNORE);
+	if (CHECK_FLAG(bgp->flags, BGP_FLAG_ASPATH_CONFED))
+		SET_FLAG(steps, BGP_BESTPATH_STEP_ASPATH_CONFED);
+	if (CHECK_FLAG(bgp->flags, BGP_FLAG_ALWAYS_COMPARE_MED))
+		SET_FLAG(steps, BGP_BESTPATH_STEP_ALWAYS_MED);
+	if (CHECK_FLAG(bgp->flags, BGP_FLAG_MED_CONFED))
+		SET_FLAG(steps, BGP_BESTPATH_STEP_MED_CONFED);
+
+	bgp->bestpath_steps = steps;
+	switch (steps) {
+	case 0:
+		bgp->bestpath_cmp = BGP_BESTPATH_CMP_DEFAULT;
+		break;
+	case BGP_BESTPATH_STEP_LATENCY:
+		bgp->bestpath_cmp = BGP_BESTPATH_CMP_LATENCY;
+		break;
+	default:
+		bgp->bestpath_cmp = BGP_BESTPATH_CMP_GENERIC;
+		break;
+	}
+}
+
+int bgp_path_info_cmp(struct bgp *bgp, struct bgp_path_info *new,
+		      struct bgp_path_info *exist, int *paths_eq,
+		      struct bgp_maxpaths_cfg *mpath_cfg, bool debug,
+		      char *pfx_buf, afi_t afi, safi_t safi,
+		      enum bgp_path_selection_reason *reason)
+{
+	return bgp_path_info_cmp_variants[bgp->bestpath_cmp](bgp, new, exist,
+							     paths_eq,
+							     mpath_cfg, debug,
+							     pfx_buf, afi, safi,
+							     reason);
+}
+
 
 int bgp_evpn_path_info_cmp(struct bgp *bgp, struct bgp_path_info *new,
 			   struct bgp_path_info *exist, int *paths_eq,
@@ -1871,7 +2080,7 @@ static int bgp_input_modifier(struct peer *peer, const struct prefix *p,
 		SET_FLAG(peer->rmap_type, PEER_RMAP_TYPE_IN);
 
 		/* Apply BGP route map to the attribute. */
-		ret = route_map_apply(rmap, p, &rmap_path);
+		ret = bgp_route_map_apply_cached(rmap, p, &rmap_path);
 
 		peer->rmap_type = 0;
 
@@ -2072,23 +2281,6 @@ void bgp_attr_add_gshut_community(struct attr *attr)
 }
 
 
-/* Notify BGP Conditional advertisement scanner process. */
-void bgp_notify_conditional_adv_scanner(struct update_subgroup *subgrp)
-{
-	struct peer *peer = SUBGRP_PEER(subgrp);
-	afi_t afi = SUBGRP_AFI(subgrp);
-	safi_t safi = SUBGRP_SAFI(subgrp);
-	struct bgp_filter *filter = &peer->filter[afi][safi];
-
-	if (!ADVERTISE_MAP_NAME(filter))
-		return;
-
-	if (!CHECK_FLAG(peer->flags, PEER_FLAG_CONFIG_NODE))
-		return;
-
-	peer->advmap_table_change = true;
-}
-
 
 void subgroup_announce_reset_nhop(uint8_t family, struct attr *attr)
 {
@@ -2517,8 +2709,8 @@ bool subgroup_announce_check(struct bgp_dest *dest, struct bgp_path_info *pi,
 			ret = route_map_apply(UNSUPPRESS_MAP(filter), p,
 					      &rmap_path);
 		else
-			ret = route_map_apply(ROUTE_MAP_OUT(filter), p,
-					      &rmap_path);
+			ret = bgp_route_map_apply_cached(ROUTE_MAP_OUT(filter),
+							 p, &rmap_path);
 
 		bgp_attr_flush(&dummy_attr);
 		peer->rmap_type = 0;
@@ -2744,6 +2936,9 @@ bool subgroup_announce_check(struct bgp_dest *dest, struct bgp_path_info *pi,
 					      bgp_attr_get_ecommunity(attr)));
 	}
 
+	/* Measured latency for routers that do not measure themselves */
+	bgp_twamp_announce(bgp, pi, attr);
+
 	/*
 	 * When the next hop is set to ourselves, if all multipaths have
 	 * link-bandwidth announce the cumulative bandwidth as that makes
@@ -2784,24 +2979,68 @@ static void bgp_route_select_timer_expire(struct event *thread)
 	bgp_best_path_select_defer(bgp, afi, safi);
 }
 
-void bgp_best_selection(struct bgp *bgp, struct bgp_dest *dest,
+/*
+ * Time spent per destination in best-path selection and in the whole of
+ * its processing, split by the step that decided. Buckets are powers of
+ * two of nanoseconds, the first one holding everything under 256ns.
+ */
+#define BGP_SELECT_TIMING_REASONS (bgp_path_selection_default + 1)
+#define BGP_SELECT_TIMING_BUCKETS 24
+#define BGP_SELECT_TIMING_SHIFT 8
+
+struct bgp_select_timing {
+	uint64_t count;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint64_t bucket[BGP_SELECT_TIMING_BUCKETS];
+};
+
+static struct bgp_select_timing select_timing[BGP_SELECT_TIMING_REASONS];
+static struct bgp_select_timing process_timing[BGP_SELECT_TIMING_REASONS];
+
+static inline uint64_t bgp_select_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void bgp_select_timing_add(struct bgp_select_timing *timing,
+				  uint64_t start)
+{
+	uint64_t ns = bgp_select_clock() - start;
+	unsigned int bucket = 0;
+
+	if (ns >> BGP_SELECT_TIMING_SHIFT)
+		bucket = 64 - __builtin_clzll(ns) - BGP_SELECT_TIMING_SHIFT;
+
+	timing->count++;
+	timing->total_ns += ns;
+	timing->max_ns = MAX(timing->max_ns, ns);
+	timing->bucket[MIN(bucket, BGP_SELECT_TIMING_BUCKETS - 1)]++;
+}
+
+/*
+ * The comparisons of best-path selection: the new best path and, with
+ * multipath, the paths equal to it onto mp_list. Writes nothing but the
+ * deterministic-med marks on the dest's paths and dest->reason, so dests
+ * can be picked in parallel; bgp_best_selection_apply() does the rest.
+ */
+static struct bgp_path_info *
+bgp_best_selection_pick(struct bgp *bgp, struct bgp_dest *dest,
 			struct bgp_maxpaths_cfg *mpath_cfg,
-			struct bgp_path_info_pair *result, afi_t afi,
-			safi_t safi)
+			struct list *mp_list, afi_t afi, safi_t safi)
 {
 	struct bgp_path_info *new_select;
-	struct bgp_path_info *old_select;
 	struct bgp_path_info *pi;
 	struct bgp_path_info *pi1;
 	struct bgp_path_info *pi2;
-	struct bgp_path_info *nextpi = NULL;
 	int paths_eq, do_mpath;
 	bool debug;
-	struct list mp_list;
 	char pfx_buf[PREFIX2STR_BUFFER] = {};
 	char path_buf[PATH_ADDPATH_STR_BUFFER];
 
-	bgp_mp_list_init(&mp_list);
 	do_mpath =
 		(mpath_cfg->maxpaths_ebgp > 1 || mpath_cfg->maxpaths_ibgp > 1);
 
@@ -2889,31 +3128,17 @@ void bgp_best_selection(struct bgp *bgp, struct bgp_dest *dest,
 	}
 
 	/* Check old selected route and new selected route. */
-	old_select = NULL;
 	new_select = NULL;
-	for (pi = bgp_dest_get_bgp_path_info(dest);
-	     (pi != NULL) && (nextpi = pi->next, 1); pi = nextpi) {
+	for (pi = bgp_dest_get_bgp_path_info(dest); pi; pi = pi->next) {
 		enum bgp_path_selection_reason reason;
 
-		if (CHECK_FLAG(pi->flags, BGP_PATH_SELECTED))
-			old_select = pi;
-
+		/* removed ones are reaped once the selection is applied */
 		if (BGP_PATH_HOLDDOWN(pi)) {
-			/* reap REMOVED routes, if needs be
-			 * selected route must stay for a while longer though
-			 */
 			if (debug)
 				zlog_debug(
 					"%s: %pBD(%s) pi from %s in holddown",
 					__func__, dest, bgp->name_pretty,
 					pi->peer->host);
-
-			if (CHECK_FLAG(pi->flags, BGP_PATH_REMOVED) &&
-			    (pi != old_select)) {
-				dest = bgp_path_info_reap(dest, pi);
-				assert(dest);
-			}
-
 			continue;
 		}
 
@@ -2957,21 +3182,8 @@ void bgp_best_selection(struct bgp *bgp, struct bgp_dest *dest,
 	 * paths
 	 * qualify as multipaths
 	 */
-	if (debug) {
-		if (new_select)
-			bgp_path_info_path_with_addpath_rx_str(
-				new_select, path_buf, sizeof(path_buf));
-		else
-			snprintf(path_buf, sizeof(path_buf), "NONE");
-		zlog_debug(
-			"%pBD(%s): After path selection, newbest is %s oldbest was %s",
-			dest, bgp->name_pretty, path_buf,
-			old_select ? old_select->peer->host : "NONE");
-	}
-
 	if (do_mpath && new_select) {
-		for (pi = bgp_dest_get_bgp_path_info(dest);
-		     (pi != NULL) && (nextpi = pi->next, 1); pi = nextpi) {
+		for (pi = bgp_dest_get_bgp_path_info(dest); pi; pi = pi->next) {
 
 			if (debug)
 				bgp_path_info_path_with_addpath_rx_str(
@@ -2983,7 +3195,7 @@ void bgp_best_selection(struct bgp *bgp, struct bgp_dest *dest,
 						"%pBD(%s): %s is the bestpath, add to the multipath list",
 						dest, bgp->name_pretty,
 						path_buf);
-				bgp_mp_list_add(&mp_list, pi);
+				bgp_mp_list_add(mp_list, pi);
 				continue;
 			}
 
@@ -3015,22 +3227,88 @@ void bgp_best_selection(struct bgp *bgp, struct bgp_dest *dest,
 						"%pBD(%s): %s is equivalent to the bestpath, add to the multipath list",
 						dest, bgp->name_pretty,
 						path_buf);
-				bgp_mp_list_add(&mp_list, pi);
+				bgp_mp_list_add(mp_list, pi);
 			}
 		}
 	}
 
-	bgp_path_info_mpath_update(bgp, dest, new_select, old_select, &mp_list,
+	return new_select;
+}
+
+/*
+ * Make what bgp_best_selection_pick() found the outcome: reap removed
+ * paths, update the multipath set and addpath IDs and fill in result.
+ * start is when the selection began, for its timing.
+ */
+static void bgp_best_selection_apply(struct bgp *bgp, struct bgp_dest *dest,
+				     struct bgp_maxpaths_cfg *mpath_cfg,
+				     struct bgp_path_info *new_select,
+				     struct list *mp_list,
+				     struct bgp_path_info_pair *result,
+				     afi_t afi, safi_t safi, uint64_t start)
+{
+	struct bgp_path_info *old_select = NULL;
+	struct bgp_path_info *pi;
+	struct bgp_path_info *nextpi = NULL;
+	char path_buf[PATH_ADDPATH_STR_BUFFER];
+
+	for (pi = bgp_dest_get_bgp_path_info(dest);
+	     (pi != NULL) && (nextpi = pi->next, 1); pi = nextpi) {
+		if (CHECK_FLAG(pi->flags, BGP_PATH_SELECTED)) {
+			old_select = pi;
+			continue;
+		}
+
+		/* reap REMOVED routes, if needs be
+		 * selected route must stay for a while longer though
+		 */
+		if (BGP_PATH_HOLDDOWN(pi) &&
+		    CHECK_FLAG(pi->flags, BGP_PATH_REMOVED)) {
+			dest = bgp_path_info_reap(dest, pi);
+			assert(dest);
+		}
+	}
+
+	if (bgp_debug_bestpath(dest)) {
+		if (new_select)
+			bgp_path_info_path_with_addpath_rx_str(
+				new_select, path_buf, sizeof(path_buf));
+		else
+			snprintf(path_buf, sizeof(path_buf), "NONE");
+		zlog_debug(
+			"%pBD(%s): After path selection, newbest is %s oldbest was %s",
+			dest, bgp->name_pretty, path_buf,
+			old_select ? old_select->peer->host : "NONE");
+	}
+
+	bgp_path_info_mpath_update(bgp, dest, new_select, old_select, mp_list,
 				   mpath_cfg);
 	bgp_path_info_mpath_aggregate_update(new_select, old_select);
-	bgp_mp_list_clear(&mp_list);
+	bgp_mp_list_clear(mp_list);
 
 	bgp_addpath_update_ids(bgp, dest, afi, safi);
 
 	result->old = old_select;
 	result->new = new_select;
 
-	return;
+	bgp_select_timing_add(&select_timing[dest->reason], start);
+}
+
+void bgp_best_selection(struct bgp *bgp, struct bgp_dest *dest,
+			struct bgp_maxpaths_cfg *mpath_cfg,
+			struct bgp_path_info_pair *result, afi_t afi,
+			safi_t safi)
+{
+	struct bgp_path_info *new_select;
+	struct list mp_list;
+	uint64_t start;
+
+	bgp_mp_list_init(&mp_list);
+	start = bgp_select_clock();
+	new_select = bgp_best_selection_pick(bgp, dest, mpath_cfg, &mp_list,
+					     afi, safi);
+	bgp_best_selection_apply(bgp, dest, mpath_cfg, new_select, &mp_list,
+				 result, afi, safi, start);
 }
 
 /*
@@ -3137,7 +3415,8 @@ bool bgp_zebra_has_route_changed(struct bgp_path_info *selected)
 	 */
 	if (CHECK_FLAG(selected->flags, BGP_PATH_IGP_CHANGED)
 	    || CHECK_FLAG(selected->flags, BGP_PATH_MULTIPATH_CHG)
-	    || CHECK_FLAG(selected->flags, BGP_PATH_LINK_BW_CHG))
+	    || CHECK_FLAG(selected->flags, BGP_PATH_LINK_BW_CHG)
+	    || CHECK_FLAG(selected->flags, BGP_PATH_LATENCY_WT_CHG))
 		return true;
 
 	/*
@@ -3162,6 +3441,92 @@ struct bgp_process_queue {
 	unsigned int queued;
 };
 
+/*
+ * Parallel best-path selection. With "bgp best-path workers" a batch of
+ * the process queue is split by prefix hash into one shard per selection
+ * thread and bgp_best_selection_pick() runs for each shard's dests on the
+ * worker pool. The picks are then applied in queue order on the main
+ * thread as before, so zebra, the update groups, labels and counters are
+ * only ever touched from there. A dest scheduled again while the batch
+ * is applied, by an import or a leak from an earlier dest, drops its pick
+ * and is selected the usual way.
+ */
+#define BGP_SELECT_PARALLEL_MIN 256
+
+struct bgp_select_job {
+	struct bgp_dest *dest;
+	struct bgp_path_info *new_select;
+	struct list mp_list;
+	uint64_t select_ns;
+	unsigned int hash;
+};
+
+struct bgp_select_batch {
+	struct bgp *bgp;
+	struct bgp_select_job *jobs;
+	unsigned int count;
+};
+
+static uint64_t select_parallel_batches;
+static uint64_t select_parallel_picks;
+static uint64_t select_parallel_dropped;
+
+static void bgp_select_batch_shard(void *arg, unsigned int shard,
+				   unsigned int shards)
+{
+	struct bgp_select_batch *batch = arg;
+	struct bgp_select_job *job;
+	struct bgp_table *table;
+	uint64_t start;
+	unsigned int i;
+
+	for (i = 0; i < batch->count; i++) {
+		job = &batch->jobs[i];
+		if (!job->dest || job->hash % shards != shard)
+			continue;
+
+		table = bgp_dest_table(job->dest);
+		start = bgp_select_clock();
+		job->new_select = bgp_best_selection_pick(
+			batch->bgp, job->dest,
+			&batch->bgp->maxpaths[table->afi][table->safi],
+			&job->mp_list, table->afi, table->safi);
+		job->select_ns = bgp_select_clock() - start;
+	}
+}
+
+/* Pick the best paths of the dests queued on pqnode on the worker pool */
+static struct bgp_select_job *
+bgp_select_batch_pick(struct bgp *bgp, struct bgp_process_queue *pqnode,
+		      unsigned int *count)
+{
+	struct bgp_select_batch batch = { .bgp = bgp };
+	struct bgp_select_job *job;
+	struct bgp_dest *dest;
+
+	batch.jobs = XCALLOC(MTYPE_TMP, pqnode->queued * sizeof(*batch.jobs));
+	STAILQ_FOREACH (dest, &pqnode->pqueue, pq) {
+		if (batch.count == pqnode->queued)
+			break;
+		job = &batch.jobs[batch.count++];
+		bgp_mp_list_init(&job->mp_list);
+		/* bgp_process_main_one() passes on these untouched */
+		if (CHECK_FLAG(dest->flags, BGP_NODE_SELECT_DEFER))
+			continue;
+		job->dest = dest;
+		job->hash = prefix_hash_key(bgp_dest_get_prefix(dest));
+		SET_FLAG(dest->flags, BGP_NODE_PRESELECTED);
+	}
+
+	bgp_select_run(bgp_select_batch_shard, &batch);
+
+	select_parallel_batches++;
+	select_parallel_picks += batch.count;
+	*count = batch.count;
+	return batch.jobs;
+}
+
+
 static void bgp_process_evpn_route_injection(struct bgp *bgp, afi_t afi,
 					     safi_t safi, struct bgp_dest *dest,
 					     struct bgp_path_info *new_select,
@@ -3372,12 +3737,14 @@ bgp_mplsvpn_handle_label_allocation(struct bgp *bgp, struct bgp_dest *dest,
  *     is being removed.
  */
 static void bgp_process_main_one(struct bgp *bgp, struct bgp_dest *dest,
-				 afi_t afi, safi_t safi)
+				 afi_t afi, safi_t safi,
+				 struct bgp_select_job *job)
 {
 	struct bgp_path_info *new_select;
 	struct bgp_path_info *old_select;
 	struct bgp_path_info_pair old_and_new;
 	int debug = 0;
+	uint64_t start;
 
 	if (CHECK_FLAG(bgp->flags, BGP_FLAG_DELETE_IN_PROGRESS)) {
 		if (dest)
@@ -3422,12 +3789,38 @@ static void bgp_process_main_one(struct bgp *bgp, struct bgp_dest *dest,
 		return;
 	}
 
-	/* Best path selection. */
-	bgp_best_selection(bgp, dest, &bgp->maxpaths[afi][safi], &old_and_new,
-			   afi, safi);
+	/* Best path selection, unless picked in parallel and still valid */
+	start = bgp_select_clock();
+	if (job && CHECK_FLAG(dest->flags, BGP_NODE_PRESELECTED)) {
+		UNSET_FLAG(dest->flags, BGP_NODE_PRESELECTED);
+		start -= job->select_ns;
+		bgp_best_selection_apply(bgp, dest, &bgp->maxpaths[afi][safi],
+					 job->new_select, &job->mp_list,
+					 &old_and_new, afi, safi, start);
+	} else
+		bgp_best_selection(bgp, dest, &bgp->maxpaths[afi][safi],
+				   &old_and_new, afi, safi);
 	old_select = old_and_new.old;
 	new_select = old_and_new.new;
 
+	bgp_conditional_adv_process(bgp, dest);
+
+	/* Route changes the latency step is responsible for, for monitoring */
+	if (old_select && new_select && old_select != new_select) {
+		frrtrace(4, frr_bgp, bestpath_flip, bgp, dest, old_select,
+			 new_select);
+		if (dest->reason == bgp_path_selection_latency)
+			bgp->twamp_latency_changes++;
+		else if (dest->reason == bgp_path_selection_loss)
+			bgp->twamp_loss_changes++;
+	}
+
+	if (old_select != new_select ||
+	    (new_select &&
+	     CHECK_FLAG(new_select->flags, BGP_PATH_ATTR_CHANGED)))
+		hook_call(bgp_route_update, bgp, afi, safi, dest, old_select,
+			  new_select);
+
 	if (safi == SAFI_UNICAST || safi == SAFI_LABELED_UNICAST)
 		/* label unicast path :
 		 * Do we need to allocate or free labels?
@@ -3499,8 +3892,10 @@ static void bgp_process_main_one(struct bgp *bgp, struct bgp_dest *dest,
 
 		UNSET_FLAG(old_select->flags, BGP_PATH_MULTIPATH_CHG);
 		UNSET_FLAG(old_select->flags, BGP_PATH_LINK_BW_CHG);
+		UNSET_FLAG(old_select->flags, BGP_PATH_LATENCY_WT_CHG);
 		bgp_zebra_clear_route_change_flags(dest);
 		UNSET_FLAG(dest->flags, BGP_NODE_PROCESS_SCHEDULED);
+		bgp_select_timing_add(&process_timing[dest->reason], start);
 		return;
 	}
 
@@ -3534,6 +3929,7 @@ static void bgp_process_main_one(struct bgp *bgp, struct bgp_dest *dest,
 					 BGP_PATH_ATTR_CHANGED);
 		UNSET_FLAG(new_select->flags, BGP_PATH_MULTIPATH_CHG);
 		UNSET_FLAG(new_select->flags, BGP_PATH_LINK_BW_CHG);
+		UNSET_FLAG(new_select->flags, BGP_PATH_LATENCY_WT_CHG);
 	}
 
 #ifdef ENABLE_BGP_VNC
@@ -3599,11 +3995,11 @@ static void bgp_process_main_one(struct bgp *bgp, struct bgp_dest *dest,
 
 	UNSET_FLAG(dest->flags, BGP_NODE_PROCESS_SCHEDULED);
 
+	bgp_select_timing_add(&process_timing[dest->reason], start);
+
 	/* Reap old select bgp_path_info, if it has been removed */
 	if (old_select && CHECK_FLAG(old_select->flags, BGP_PATH_REMOVED))
 		bgp_path_info_reap(dest, old_select);
-
-	return;
 }
 
 /* Process the routes with the flag BGP_NODE_SELECT_DEFER set */
@@ -3637,7 +4033,7 @@ void bgp_best_path_select_defer(struct bgp *bgp, afi_t afi, safi_t safi)
 
 		UNSET_FLAG(dest->flags, BGP_NODE_SELECT_DEFER);
 		bgp->gr_info[afi][safi].gr_deferred--;
-		bgp_process_main_one(bgp, dest, afi, safi);
+		bgp_process_main_one(bgp, dest, afi, safi, NULL);
 		cnt++;
 	}
 	/* If iteration stopped before the entire table was traversed then the
@@ -3677,26 +4073,43 @@ static wq_item_status bgp_process_wq(struct work_queue *wq, void *data)
 	struct bgp *bgp = pqnode->bgp;
 	struct bgp_table *table;
 	struct bgp_dest *dest;
+	struct bgp_select_job *jobs = NULL, *job;
+	unsigned int count = 0, next = 0;
 
 	/* eoiu marker */
 	if (CHECK_FLAG(pqnode->flags, BGP_PROCESS_QUEUE_EOIU_MARKER)) {
-		bgp_process_main_one(bgp, NULL, 0, 0);
+		bgp_process_main_one(bgp, NULL, 0, 0, NULL);
 		/* should always have dedicated wq call */
 		assert(STAILQ_FIRST(&pqnode->pqueue) == NULL);
 		return WQ_SUCCESS;
 	}
 
+	if (bgp_select_shards() > 1 &&
+	    pqnode->queued >= BGP_SELECT_PARALLEL_MIN &&
+	    !CHECK_FLAG(bgp->flags, BGP_FLAG_DELETE_IN_PROGRESS))
+		jobs = bgp_select_batch_pick(bgp, pqnode, &count);
+
 	while (!STAILQ_EMPTY(&pqnode->pqueue)) {
 		dest = STAILQ_FIRST(&pqnode->pqueue);
 		STAILQ_REMOVE_HEAD(&pqnode->pqueue, pq);
 		STAILQ_NEXT(dest, pq) = NULL; /* complete unlink */
 		table = bgp_dest_table(dest);
+		/* the batch is in queue order, dests added since come after */
+		job = next < count ? &jobs[next++] : NULL;
 		/* note, new DESTs may be added as part of processing */
-		bgp_process_main_one(bgp, dest, table->afi, table->safi);
+		bgp_process_main_one(bgp, dest, table->afi, table->safi, job);
+		if (job) {
+			if (CHECK_FLAG(dest->flags, BGP_NODE_PRESELECTED)) {
+				UNSET_FLAG(dest->flags, BGP_NODE_PRESELECTED);
+				select_parallel_dropped++;
+			}
+			bgp_mp_list_clear(&job->mp_list);
+		}
 
 		bgp_dest_unlock_node(dest);
 		bgp_table_unlock(table);
 	}
+	XFREE(MTYPE_TMP, jobs);
 
 	return WQ_SUCCESS;
 }
@@ -3748,6 +4161,9 @@ void bgp_process(struct bgp *bgp, struct bgp_dest *dest, afi_t afi, safi_t safi)
 	struct bgp_process_queue *pqnode;
 	int pqnode_reuse = 0;
 
+	/* Changed since its parallel pick, which is no good any more */
+	UNSET_FLAG(dest->flags, BGP_NODE_PRESELECTED);
+
 	/* already scheduled for processing? */
 	if (CHECK_FLAG(dest->flags, BGP_NODE_PROCESS_SCHEDULED))
 		return;
@@ -3846,7 +4262,7 @@ static uint32_t bgp_filtered_routes_count(struct peer *peer, afi_t afi,
 		for (ain = dest->adj_in; ain; ain = ain->next) {
 			const struct prefix *rn_p = bgp_dest_get_prefix(dest);
 
-			attr = *ain->attr;
+			bgp_adj_in_attr(ain, &attr);
 
 			if (bgp_input_filter(peer, rn_p, &attr, afi, safi)
 			    == FILTER_DENY)
@@ -4055,7 +4471,7 @@ struct bgp_path_info *info_make(int type, int sub_type, unsigned short instance,
 	struct bgp_path_info *new;
 
 	/* Make new BGP info. */
-	new = XCALLOC(MTYPE_BGP_ROUTE, sizeof(struct bgp_path_info));
+	new = bgp_arena_alloc(&bgp_path_info_arena);
 	new->type = type;
 	new->instance = instance;
 	new->sub_type = sub_type;
@@ -4567,6 +4983,11 @@ void bgp_update(struct peer *peer, const struct prefix *p, uint32_t addpath_id,
 
 	attr_new = bgp_attr_intern(&new_attr);
 
+	/* Keep the Adj-RIB-In entry as a change to what is installed */
+	if (CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG) &&
+	    CHECK_FLAG(bgp->af_flags[afi][safi], BGP_CONFIG_ADJ_IN_COMPACT))
+		bgp_adj_in_compact(dest, peer, addpath_id, attr_new);
+
 	/* If the update is implicit withdraw. */
 	if (pi) {
 		pi->uptime = monotime(NULL);
@@ -4622,10 +5043,9 @@ void bgp_update(struct peer *peer, const struct prefix *p, uint32_t addpath_id,
 						peer, pfx_buf);
 				}
 
-				/* graceful restart STALE flag unset. */
-				if (CHECK_FLAG(pi->flags, BGP_PATH_STALE)) {
-					bgp_path_info_unset_flag(
-						dest, pi, BGP_PATH_STALE);
+				/* graceful restart: no longer stale. */
+				if (bgp_path_info_stale(pi)) {
+					bgp_path_info_refresh_epoch(dest, pi);
 					bgp_dest_set_defer_flag(dest, false);
 					bgp_process(bgp, dest, afi, safi);
 				}
@@ -4675,11 +5095,12 @@ void bgp_update(struct peer *peer, const struct prefix *p, uint32_t addpath_id,
 			zlog_debug("%pBP rcvd %s", peer, pfx_buf);
 		}
 
-		/* graceful restart STALE flag unset. */
-		if (CHECK_FLAG(pi->flags, BGP_PATH_STALE)) {
-			bgp_path_info_unset_flag(dest, pi, BGP_PATH_STALE);
+		/* graceful restart: received again, no longer stale. */
+		bool stale = bgp_path_info_stale(pi);
+
+		bgp_path_info_refresh_epoch(dest, pi);
+		if (stale)
 			bgp_dest_set_defer_flag(dest, false);
-		}
 
 		/* The attribute is changed. */
 		bgp_path_info_set_flag(dest, pi, BGP_PATH_ATTR_CHANGED);
@@ -5078,7 +5499,7 @@ filtered:
 		bgp_unlink_nexthop(new);
 		bgp_path_info_delete(dest, new);
 		bgp_path_info_extra_free(&new->extra);
-		XFREE(MTYPE_BGP_ROUTE, new);
+		bgp_arena_free(&bgp_path_info_arena, new);
 	}
 
 	hook_call(bgp_process, bgp, afi, safi, dest, peer, true);
@@ -5273,7 +5694,7 @@ static void bgp_announce_route_timer_expired(struct event *t)
 	peer_af_announce_route(paf, 1);
 
 	/* Notify BGP conditional advertisement scanner percess */
-	peer->advmap_config_change[paf->afi][paf->safi] = true;
+	bgp_conditional_adv_config_change(peer, paf->afi, paf->safi);
 }
 
 /*
@@ -5368,6 +5789,7 @@ static void bgp_soft_reconfig_table_update(struct peer *peer,
 	uint32_t num_labels = 0;
 	mpls_label_t *label_pnt = NULL;
 	struct bgp_route_evpn evpn;
+	struct attr attr;
 
 	for (pi = bgp_dest_get_bgp_path_info(dest); pi; pi = pi->next)
 		if (pi->peer == peer)
@@ -5383,22 +5805,25 @@ static void bgp_soft_reconfig_table_update(struct peer *peer,
 	else
 		memset(&evpn, 0, sizeof(evpn));
 
-	bgp_update(peer, bgp_dest_get_prefix(dest), ain->addpath_rx_id,
-		   ain->attr, afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd,
-		   label_pnt, num_labels, 1, &evpn);
+	bgp_adj_in_attr(ain, &attr);
+	bgp_update(peer, bgp_dest_get_prefix(dest), ain->addpath_rx_id, &attr,
+		   afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, prd, label_pnt,
+		   num_labels, 1, &evpn);
 }
 
 static void bgp_soft_reconfig_table(struct peer *peer, afi_t afi, safi_t safi,
 				    struct bgp_table *table,
 				    struct prefix_rd *prd)
 {
+	struct bgp_dest_batch batch;
 	struct bgp_dest *dest;
 	struct bgp_adj_in *ain;
 
 	if (!table)
 		table = peer->bgp->rib[afi][safi];
 
-	for (dest = bgp_table_top(table); dest; dest = bgp_route_next(dest))
+	for (dest = bgp_dest_batch_first(&batch, table); dest;
+	     dest = bgp_dest_batch_next(&batch))
 		for (ain = dest->adj_in; ain; ain = ain->next) {
 			if (ain->peer != peer)
 				continue;
@@ -5607,15 +6032,60 @@ bool bgp_soft_reconfig_in(struct peer *peer, afi_t afi, safi_t safi)
 }
 
 
+/*
+ * Dests are queued for clearing in runs of up to BGP_CLEAR_BATCH, in table
+ * order, so a full table costs a few thousand queue items rather than one
+ * per prefix. The bgp_process() calls they lead to are batched in turn by
+ * the process queue.
+ */
+#define BGP_CLEAR_BATCH 256
+
 struct bgp_clear_node_queue {
-	struct bgp_dest *dest;
+	struct bgp_table *table;
+	unsigned int count;
+	struct bgp_dest *dests[BGP_CLEAR_BATCH];
 };
 
-static wq_item_status bgp_clear_route_node(struct work_queue *wq, void *data)
+/*
+ * Mark all the peer's paths stale: they are stale until received again,
+ * without visiting any of them. Stale paths still waiting for removal stay
+ * so, for the sweep to come.
+ */
+static void bgp_mark_stale_route(struct peer *peer, afi_t afi, safi_t safi)
+{
+	bgp_stale_sweep_cancel(peer, afi, safi);
+	peer->stale_epoch[afi][safi]++;
+}
+
+/* Whether clearing the peer marks its paths stale rather than removing them */
+static bool bgp_clear_route_marks_stale(struct peer *peer, afi_t afi,
+					safi_t safi)
+{
+	return (CHECK_FLAG(peer->sflags, PEER_STATUS_NSF_WAIT) &&
+		peer->nsf[afi][safi]) ||
+	       CHECK_FLAG(peer->af_sflags[afi][safi],
+			  PEER_STATUS_ENHANCED_REFRESH);
+}
+
+/*
+ * Whether clearing the peer leaves pi in place, stale: bgp_clear_route()
+ * bumped the stale epoch, and pi was not stale already before.
+ */
+static bool bgp_clear_route_keeps(struct peer *peer, struct bgp_dest *dest,
+				  const struct bgp_path_info *pi)
+{
+	struct bgp_table *table = bgp_dest_table(dest);
+	uint32_t *epoch;
+
+	if (!bgp_clear_route_marks_stale(peer, table->afi, table->safi) ||
+	    CHECK_FLAG(pi->flags, BGP_PATH_UNUSEABLE))
+		return false;
+	epoch = bgp_stale_epoch(peer, dest);
+	return epoch && *epoch - pi->stale_epoch <= 1;
+}
+
+static void bgp_clear_route_dest(struct peer *peer, struct bgp_dest *dest)
 {
-	struct bgp_clear_node_queue *cnq = data;
-	struct bgp_dest *dest = cnq->dest;
-	struct peer *peer = wq->spec.data;
 	struct bgp_path_info *pi;
 	struct bgp *bgp;
 	afi_t afi = bgp_dest_table(dest)->afi;
@@ -5631,47 +6101,48 @@ static wq_item_status bgp_clear_route_node(struct work_queue *wq, void *data)
 		if (pi->peer != peer)
 			continue;
 
-		/* graceful restart STALE flag set. */
-		if (((CHECK_FLAG(peer->sflags, PEER_STATUS_NSF_WAIT)
-		      && peer->nsf[afi][safi])
-		     || CHECK_FLAG(peer->af_sflags[afi][safi],
-				   PEER_STATUS_ENHANCED_REFRESH))
-		    && !CHECK_FLAG(pi->flags, BGP_PATH_STALE)
-		    && !CHECK_FLAG(pi->flags, BGP_PATH_UNUSEABLE))
-			bgp_path_info_set_flag(dest, pi, BGP_PATH_STALE);
-		else {
-			/* If this is an EVPN route, process for
-			 * un-import. */
-			if (safi == SAFI_EVPN)
-				bgp_evpn_unimport_route(
-					bgp, afi, safi,
-					bgp_dest_get_prefix(dest), pi);
-			/* Handle withdraw for VRF route-leaking and L3VPN */
-			if (SAFI_UNICAST == safi
-			    && (bgp->inst_type == BGP_INSTANCE_TYPE_VRF ||
-				bgp->inst_type == BGP_INSTANCE_TYPE_DEFAULT)) {
-				vpn_leak_from_vrf_withdraw(bgp_get_default(),
-							   bgp, pi);
-			}
-			if (SAFI_MPLS_VPN == safi &&
-			    bgp->inst_type == BGP_INSTANCE_TYPE_DEFAULT) {
-				vpn_leak_to_vrf_withdraw(pi);
-			}
+		/* graceful restart: kept, stale. */
+		if (bgp_clear_route_keeps(peer, dest, pi))
+			continue;
 
-			bgp_rib_remove(dest, pi, peer, afi, safi);
+		/* If this is an EVPN route, process for un-import. */
+		if (safi == SAFI_EVPN)
+			bgp_evpn_unimport_route(bgp, afi, safi,
+						bgp_dest_get_prefix(dest), pi);
+		/* Handle withdraw for VRF route-leaking and L3VPN */
+		if (SAFI_UNICAST == safi &&
+		    (bgp->inst_type == BGP_INSTANCE_TYPE_VRF ||
+		     bgp->inst_type == BGP_INSTANCE_TYPE_DEFAULT)) {
+			vpn_leak_from_vrf_withdraw(bgp_get_default(), bgp, pi);
+		}
+		if (SAFI_MPLS_VPN == safi &&
+		    bgp->inst_type == BGP_INSTANCE_TYPE_DEFAULT) {
+			vpn_leak_to_vrf_withdraw(pi);
 		}
+
+		bgp_rib_remove(dest, pi, peer, afi, safi);
 	}
+}
+
+static wq_item_status bgp_clear_route_node(struct work_queue *wq, void *data)
+{
+	struct bgp_clear_node_queue *cnq = data;
+	struct peer *peer = wq->spec.data;
+	unsigned int i;
+
+	for (i = 0; i < cnq->count; i++)
+		bgp_clear_route_dest(peer, cnq->dests[i]);
 	return WQ_SUCCESS;
 }
 
 static void bgp_clear_node_queue_del(struct work_queue *wq, void *data)
 {
 	struct bgp_clear_node_queue *cnq = data;
-	struct bgp_dest *dest = cnq->dest;
-	struct bgp_table *table = bgp_dest_table(dest);
+	unsigned int i;
 
-	bgp_dest_unlock_node(dest);
-	bgp_table_unlock(table);
+	for (i = 0; i < cnq->count; i++)
+		bgp_dest_unlock_node(cnq->dests[i]);
+	bgp_table_unlock(cnq->table);
 	XFREE(MTYPE_BGP_CLEAR_NODE_QUEUE, cnq);
 }
 
@@ -5707,7 +6178,9 @@ static void bgp_clear_node_queue_init(struct peer *peer)
 static void bgp_clear_route_table(struct peer *peer, afi_t afi, safi_t safi,
 				  struct bgp_table *table)
 {
+	struct bgp_dest_batch batch;
 	struct bgp_dest *dest;
+	struct bgp_clear_node_queue *cnq = NULL;
 	int force = peer->bgp->process_queue ? 0 : 1;
 
 	if (!table)
@@ -5717,7 +6190,8 @@ static void bgp_clear_route_table(struct peer *peer, afi_t afi, safi_t safi,
 	if (!table)
 		return;
 
-	for (dest = bgp_table_top(table); dest; dest = bgp_route_next(dest)) {
+	for (dest = bgp_dest_batch_first(&batch, table); dest;
+	     dest = bgp_dest_batch_next(&batch)) {
 		struct bgp_path_info *pi, *next;
 		struct bgp_adj_in *ain;
 		struct bgp_adj_in *ain_next;
@@ -5777,22 +6251,28 @@ static void bgp_clear_route_table(struct peer *peer, afi_t afi, safi_t safi,
 			if (force) {
 				dest = bgp_path_info_reap(dest, pi);
 				assert(dest);
-			} else {
-				struct bgp_clear_node_queue *cnq;
-
+			} else if (!bgp_clear_route_keeps(peer, dest, pi)) {
 				/* both unlocked in bgp_clear_node_queue_del */
-				bgp_table_lock(bgp_dest_table(dest));
+				if (!cnq) {
+					cnq = XCALLOC(MTYPE_BGP_CLEAR_NODE_QUEUE,
+						      sizeof(*cnq));
+					cnq->table = table;
+					bgp_table_lock(table);
+				}
 				bgp_dest_lock_node(dest);
-				cnq = XCALLOC(
-					MTYPE_BGP_CLEAR_NODE_QUEUE,
-					sizeof(struct bgp_clear_node_queue));
-				cnq->dest = dest;
-				work_queue_add(peer->clear_node_queue, cnq);
+				cnq->dests[cnq->count++] = dest;
+				if (cnq->count == BGP_CLEAR_BATCH) {
+					work_queue_add(peer->clear_node_queue,
+						       cnq);
+					cnq = NULL;
+				}
 				break;
 			}
 		}
 	}
-	return;
+
+	if (cnq)
+		work_queue_add(peer->clear_node_queue, cnq);
 }
 
 void bgp_clear_route(struct peer *peer, afi_t afi, safi_t safi)
@@ -5823,6 +6303,15 @@ void bgp_clear_route(struct peer *peer, afi_t afi, safi_t safi)
 	if (!peer->clear_node_queue->thread)
 		peer_lock(peer);
 
+	/*
+	 * On graceful restart the paths are marked stale all at once, only
+	 * those which cannot be kept need visiting.
+	 */
+	if (bgp_clear_route_marks_stale(peer, afi, safi))
+		bgp_mark_stale_route(peer, afi, safi);
+	else
+		bgp_stale_sweep_cancel(peer, afi, safi);
+
 	if (safi != SAFI_MPLS_VPN && safi != SAFI_ENCAP && safi != SAFI_EVPN)
 		bgp_clear_route_table(peer, afi, safi, NULL);
 	else
@@ -5881,161 +6370,166 @@ void bgp_clear_adj_in(struct peer *peer, afi_t afi, safi_t safi)
 	}
 }
 
+/*
+ * Stale paths of a peer are removed in the background, BGP_STALE_SWEEP_BATCH
+ * dests at a time, the sweep keeping its place locked in between.
+ */
+#define BGP_STALE_SWEEP_BATCH 1024
+
+struct bgp_stale_sweep {
+	struct peer *peer;
+	afi_t afi;
+	safi_t safi;
+	/* Keep the stale paths not marked NO_LLGR */
+	bool llgr;
+
+	struct event *t_sweep;
+	bool started;
+	/* Next dest, and its table's in the RIB for two-level tables */
+	struct bgp_dest *outer;
+	struct bgp_dest *dest;
+};
+
+static bool bgp_stale_sweep_two_level(safi_t safi)
+{
+	return safi == SAFI_MPLS_VPN || safi == SAFI_ENCAP ||
+	       safi == SAFI_EVPN;
+}
+
+/* Move the sweep to the top of its next table, false past the last one */
+static bool bgp_stale_sweep_next_table(struct bgp_stale_sweep *sweep)
+{
+	struct bgp_table *rib = sweep->peer->bgp->rib[sweep->afi][sweep->safi];
+	struct bgp_table *table;
+
+	if (!bgp_stale_sweep_two_level(sweep->safi)) {
+		if (sweep->started)
+			return false;
+		sweep->started = true;
+		sweep->dest = bgp_table_top(rib);
+		return sweep->dest != NULL;
+	}
+
+	do {
+		sweep->outer = sweep->started ? bgp_route_next(sweep->outer)
+					      : bgp_table_top(rib);
+		sweep->started = true;
+		if (!sweep->outer)
+			return false;
+		table = bgp_dest_get_bgp_table_info(sweep->outer);
+	} while (!table || !(sweep->dest = bgp_table_top(table)));
+	return true;
+}
+
 /* If any of the routes from the peer have been marked with the NO_LLGR
  * community, either as sent by the peer, or as the result of a configured
  * policy, they MUST NOT be retained, but MUST be removed as per the normal
  * operation of [RFC4271].
  */
-void bgp_clear_stale_route(struct peer *peer, afi_t afi, safi_t safi)
+static void bgp_stale_sweep_dest(struct bgp_stale_sweep *sweep,
+				 struct bgp_dest *dest)
 {
-	struct bgp_dest *dest;
+	struct peer *peer = sweep->peer;
+	struct bgp *bgp = peer->bgp;
 	struct bgp_path_info *pi;
-	struct bgp_table *table;
 
-	if (safi == SAFI_MPLS_VPN || safi == SAFI_ENCAP || safi == SAFI_EVPN) {
-		for (dest = bgp_table_top(peer->bgp->rib[afi][safi]); dest;
-		     dest = bgp_route_next(dest)) {
-			struct bgp_dest *rm;
+	for (pi = bgp_dest_get_bgp_path_info(dest); pi; pi = pi->next) {
+		if (pi->peer != peer)
+			continue;
+		if (sweep->llgr && bgp_attr_get_community(pi->attr) &&
+		    !community_include(bgp_attr_get_community(pi->attr),
+				       COMMUNITY_NO_LLGR))
+			continue;
+		if (!bgp_path_info_stale(pi))
+			continue;
 
-			/* look for neighbor in tables */
-			table = bgp_dest_get_bgp_table_info(dest);
-			if (!table)
-				continue;
+		if (bgp_stale_sweep_two_level(sweep->safi)) {
+			/* If this is VRF leaked route process for withdraw. */
+			if (pi->sub_type == BGP_ROUTE_IMPORTED &&
+			    bgp->inst_type == BGP_INSTANCE_TYPE_DEFAULT)
+				vpn_leak_to_vrf_withdraw(pi);
+		} else if (sweep->safi == SAFI_UNICAST &&
+			   (bgp->inst_type == BGP_INSTANCE_TYPE_VRF ||
+			    bgp->inst_type == BGP_INSTANCE_TYPE_DEFAULT))
+			vpn_leak_from_vrf_withdraw(bgp_get_default(), bgp, pi);
 
-			for (rm = bgp_table_top(table); rm;
-			     rm = bgp_route_next(rm))
-				for (pi = bgp_dest_get_bgp_path_info(rm); pi;
-				     pi = pi->next) {
-					if (pi->peer != peer)
-						continue;
-					if (CHECK_FLAG(
-						    peer->af_sflags[afi][safi],
-						    PEER_STATUS_LLGR_WAIT) &&
-					    bgp_attr_get_community(pi->attr) &&
-					    !community_include(
-						    bgp_attr_get_community(
-							    pi->attr),
-						    COMMUNITY_NO_LLGR))
-						continue;
-					if (!CHECK_FLAG(pi->flags,
-							BGP_PATH_STALE))
-						continue;
+		bgp_rib_remove(dest, pi, peer, sweep->afi, sweep->safi);
+	}
+}
 
-					/*
-					 * If this is VRF leaked route
-					 * process for withdraw.
-					 */
-					if (pi->sub_type ==
-						    BGP_ROUTE_IMPORTED &&
-					    peer->bgp->inst_type ==
-						    BGP_INSTANCE_TYPE_DEFAULT)
-						vpn_leak_to_vrf_withdraw(pi);
+static void bgp_stale_sweep_run(struct event *t)
+{
+	struct bgp_stale_sweep *sweep = EVENT_ARG(t);
+	unsigned int count = 0;
 
-					bgp_rib_remove(rm, pi, peer, afi, safi);
-				}
+	while (sweep->dest || bgp_stale_sweep_next_table(sweep)) {
+		if (count++ == BGP_STALE_SWEEP_BATCH) {
+			event_add_event(bm->master, bgp_stale_sweep_run, sweep,
+					0, &sweep->t_sweep);
+			return;
 		}
-	} else {
-		for (dest = bgp_table_top(peer->bgp->rib[afi][safi]); dest;
-		     dest = bgp_route_next(dest))
-			for (pi = bgp_dest_get_bgp_path_info(dest); pi;
-			     pi = pi->next) {
-				if (pi->peer != peer)
-					continue;
-				if (CHECK_FLAG(peer->af_sflags[afi][safi],
-					       PEER_STATUS_LLGR_WAIT) &&
-				    bgp_attr_get_community(pi->attr) &&
-				    !community_include(
-					    bgp_attr_get_community(pi->attr),
-					    COMMUNITY_NO_LLGR))
-					continue;
-				if (!CHECK_FLAG(pi->flags, BGP_PATH_STALE))
-					continue;
-				if (safi == SAFI_UNICAST &&
-				    (peer->bgp->inst_type ==
-					     BGP_INSTANCE_TYPE_VRF ||
-				     peer->bgp->inst_type ==
-					     BGP_INSTANCE_TYPE_DEFAULT))
-					vpn_leak_from_vrf_withdraw(
-						bgp_get_default(), peer->bgp,
-						pi);
-
-				bgp_rib_remove(dest, pi, peer, afi, safi);
-			}
+		bgp_stale_sweep_dest(sweep, sweep->dest);
+		sweep->dest = bgp_route_next(sweep->dest);
 	}
+
+	if (bgp_debug_neighbor_events(sweep->peer))
+		zlog_debug("%pBP %s/%s stale paths removed", sweep->peer,
+			   afi2str(sweep->afi), safi2str(sweep->safi));
+	bgp_stale_sweep_cancel(sweep->peer, sweep->afi, sweep->safi);
 }
 
-void bgp_set_stale_route(struct peer *peer, afi_t afi, safi_t safi)
+void bgp_stale_sweep_cancel(struct peer *peer, afi_t afi, safi_t safi)
 {
-	struct bgp_dest *dest, *ndest;
-	struct bgp_path_info *pi;
-	struct bgp_table *table;
+	struct bgp_stale_sweep *sweep = peer->stale_sweep[afi][safi];
 
-	if (safi == SAFI_MPLS_VPN || safi == SAFI_ENCAP || safi == SAFI_EVPN) {
-		for (dest = bgp_table_top(peer->bgp->rib[afi][safi]); dest;
-		     dest = bgp_route_next(dest)) {
-			table = bgp_dest_get_bgp_table_info(dest);
-			if (!table)
-				continue;
+	if (!sweep)
+		return;
 
-			for (ndest = bgp_table_top(table); ndest;
-			     ndest = bgp_route_next(ndest)) {
-				for (pi = bgp_dest_get_bgp_path_info(ndest); pi;
-				     pi = pi->next) {
-					if (pi->peer != peer)
-						continue;
+	EVENT_OFF(sweep->t_sweep);
+	if (sweep->dest)
+		bgp_dest_unlock_node(sweep->dest);
+	if (sweep->outer)
+		bgp_dest_unlock_node(sweep->outer);
+	XFREE(MTYPE_BGP_STALE_SWEEP, sweep);
+	peer->stale_sweep[afi][safi] = NULL;
+}
 
-					if ((CHECK_FLAG(
-						    peer->af_sflags[afi][safi],
-						    PEER_STATUS_ENHANCED_REFRESH))
-					    && !CHECK_FLAG(pi->flags,
-							   BGP_PATH_STALE)
-					    && !CHECK_FLAG(
-						       pi->flags,
-						       BGP_PATH_UNUSEABLE)) {
-						if (bgp_debug_neighbor_events(
-							    peer))
-							zlog_debug(
-								"%pBP route-refresh for %s/%s, marking prefix %pFX as stale",
-								peer,
-								afi2str(afi),
-								safi2str(safi),
-								bgp_dest_get_prefix(
-									ndest));
-
-						bgp_path_info_set_flag(
-							ndest, pi,
-							BGP_PATH_STALE);
-					}
-				}
-			}
-		}
-	} else {
-		for (dest = bgp_table_top(peer->bgp->rib[afi][safi]); dest;
-		     dest = bgp_route_next(dest)) {
-			for (pi = bgp_dest_get_bgp_path_info(dest); pi;
-			     pi = pi->next) {
-				if (pi->peer != peer)
-					continue;
+/*
+ * Remove the peer's stale paths. This starts over a sweep already under
+ * way, whose conditions may have changed.
+ */
+void bgp_clear_stale_route(struct peer *peer, afi_t afi, safi_t safi)
+{
+	struct bgp_stale_sweep *sweep;
 
-				if ((CHECK_FLAG(peer->af_sflags[afi][safi],
-						PEER_STATUS_ENHANCED_REFRESH))
-				    && !CHECK_FLAG(pi->flags, BGP_PATH_STALE)
-				    && !CHECK_FLAG(pi->flags,
-						   BGP_PATH_UNUSEABLE)) {
-					if (bgp_debug_neighbor_events(peer))
-						zlog_debug(
-							"%pBP route-refresh for %s/%s, marking prefix %pFX as stale",
-							peer, afi2str(afi),
-							safi2str(safi),
-							bgp_dest_get_prefix(
-								dest));
+	if (!peer->bgp->rib[afi][safi])
+		return;
 
-					bgp_path_info_set_flag(dest, pi,
-							       BGP_PATH_STALE);
-				}
-			}
-		}
-	}
+	bgp_stale_sweep_cancel(peer, afi, safi);
+
+	sweep = XCALLOC(MTYPE_BGP_STALE_SWEEP, sizeof(*sweep));
+	sweep->peer = peer;
+	sweep->afi = afi;
+	sweep->safi = safi;
+	sweep->llgr = CHECK_FLAG(peer->af_sflags[afi][safi],
+				 PEER_STATUS_LLGR_WAIT);
+	peer->stale_sweep[afi][safi] = sweep;
+
+	event_add_event(bm->master, bgp_stale_sweep_run, sweep, 0,
+			&sweep->t_sweep);
+}
+
+void bgp_set_stale_route(struct peer *peer, afi_t afi, safi_t safi)
+{
+	if (!CHECK_FLAG(peer->af_sflags[afi][safi],
+			PEER_STATUS_ENHANCED_REFRESH))
+		return;
+
+	if (bgp_debug_neighbor_events(peer))
+		zlog_debug("%pBP route-refresh for %s/%s, marking paths as stale",
+			   peer, afi2str(afi), safi2str(safi));
+
+	bgp_mark_stale_route(peer, afi, safi);
 }
 
 bool bgp_outbound_policy_exists(struct peer *peer, struct bgp_filter *filter)
@@ -8918,6 +9412,10 @@ const char *bgp_path_selection_reason2str(enum bgp_path_selection_reason reason)
 		return "EVPN local ES path";
 	case bgp_path_selection_evpn_non_proxy:
 		return "EVPN non proxy";
+	case bgp_path_selection_loss:
+		return "Probe Loss";
+	case bgp_path_selection_latency:
+		return "Peer Latency";
 	case bgp_path_selection_weight:
 		return "Weight";
 	case bgp_path_selection_local_pref:
@@ -8974,7 +9472,7 @@ static void route_vty_short_status_out(struct vty *vty,
 		if (CHECK_FLAG(path->flags, BGP_PATH_REMOVED))
 			json_object_boolean_true_add(json_path, "removed");
 
-		if (CHECK_FLAG(path->flags, BGP_PATH_STALE))
+		if (bgp_path_info_stale(path))
 			json_object_boolean_true_add(json_path, "stale");
 
 		if (path->extra && bgp_path_suppressed(path))
@@ -9029,7 +9527,7 @@ static void route_vty_short_status_out(struct vty *vty,
 	/* Route status display. */
 	if (CHECK_FLAG(path->flags, BGP_PATH_REMOVED))
 		vty_out(vty, "R");
-	else if (CHECK_FLAG(path->flags, BGP_PATH_STALE))
+	else if (bgp_path_info_stale(path))
 		vty_out(vty, "S");
 	else if (bgp_path_suppressed(path))
 		vty_out(vty, "s");
@@ -10313,7 +10811,7 @@ void route_vty_out_detail(struct vty *vty, struct bgp *bgp, struct bgp_dest *bn,
 			vty_out(vty, ", (removed)");
 	}
 
-	if (CHECK_FLAG(path->flags, BGP_PATH_STALE)) {
+	if (bgp_path_info_stale(path)) {
 		if (json_paths)
 			json_object_boolean_true_add(json_path, "stale");
 		else
@@ -11076,25 +11574,44 @@ void route_vty_out_detail(struct vty *vty, struct bgp *bgp, struct bgp_dest *bn,
 		/* Get ultimate peer for imported routes */
 		struct bgp_path_info *path_ultimate = bgp_get_imported_bpi_ultimate(path);
 		
-		if (path_ultimate->peer && path_ultimate->peer->sort == BGP_PEER_IBGP &&
-		    path_ultimate->peer->connection && 
-		    path_ultimate->peer->connection->su.sa.sa_family == AF_INET) {
-			struct in_addr peer_ip;
-			peer_ip.s_addr = path_ultimate->peer->connection->su.sin.sin_addr.s_addr;
-			uint32_t latency = bgp_twamp_get_latency(&peer_ip);
+		if (path_ultimate->peer && path_ultimate->peer->sort == BGP_PEER_IBGP) {
+			/*
+			 * What best-path uses: the nexthop's snapshot. Never
+			 * the segment itself, a full table dump must not hold
+			 * up the agent.
+			 */
+			uint32_t latency = bgp_twamp_path_latency(path);
+			uint16_t loss = bgp_twamp_path_loss(path);
+			uint16_t threshold =
+				bgp->import_latency_cfg.loss_threshold_permille;
 			
 			if (json_paths) {
 				if (latency != UINT32_MAX) {
-					json_object_int_add(json_path, "twampLatencyMs", latency);
+					json_object_int_add(json_path, "twampLatencyMs",
+							    latency / 1000);
+					json_object_int_add(json_path, "twampLatencyUs",
+							    latency);
 				} else {
 					json_object_string_add(json_path, "twampLatency", "unreachable");
 				}
+				json_object_int_add(json_path, "twampLossPermille",
+						    loss);
+				if (threshold && loss >= threshold)
+					json_object_boolean_true_add(json_path,
+								     "twampLossDemoted");
 			} else {
 				if (latency != UINT32_MAX) {
-					vty_out(vty, "      TWAMP Latency: %u ms\n", latency);
+					vty_out(vty, "      TWAMP Latency: %u.%03u ms\n",
+						latency / 1000, latency % 1000);
 				} else {
 					vty_out(vty, "      TWAMP Latency: unreachable\n");
 				}
+				if (loss)
+					vty_out(vty, "      TWAMP Loss: %u.%u%%%s\n",
+						loss / 10, loss % 10,
+						threshold && loss >= threshold
+							? ", demoted"
+							: "");
 			}
 		}
 	}
@@ -11117,7 +11634,7 @@ void route_vty_out_detail(struct vty *vty, struct bgp *bgp, struct bgp_dest *bn,
 	}
 
 	if (path->peer->connection->t_gr_restart &&
-	    CHECK_FLAG(path->flags, BGP_PATH_STALE)) {
+	    bgp_path_info_stale(path)) {
 		unsigned long gr_remaining = event_timer_remain_second(
 			path->peer->connection->t_gr_restart);
 
@@ -11676,6 +12193,10 @@ static int bgp_show_table(struct vty *vty, struct bgp *bgp, afi_t afi, safi_t sa
 
 			json_paths = NULL;
 			first = 0;
+
+			/* Don't hold a whole table's worth of output */
+			if (output_count % 256 == 0)
+				vty_out_drain(vty);
 		} else
 			json_object_free(json_paths);
 	}
@@ -12648,6 +13169,151 @@ DEFUN(show_ip_bgp_afi_safi_statistics, show_ip_bgp_afi_safi_statistics_cmd,
 	return ret;
 }
 
+static void bgp_select_timing_vty(struct vty *vty, const char *what,
+				  const struct bgp_select_timing *timing)
+{
+	uint64_t bucket[BGP_SELECT_TIMING_BUCKETS] = {};
+	unsigned int r, i;
+
+	for (r = 0; r < BGP_SELECT_TIMING_REASONS; r++)
+		for (i = 0; i < BGP_SELECT_TIMING_BUCKETS; i++)
+			bucket[i] += timing[r].bucket[i];
+
+	vty_out(vty, "\n%s time, all steps:\n", what);
+	for (i = 0; i < BGP_SELECT_TIMING_BUCKETS; i++) {
+		if (!bucket[i])
+			continue;
+		if (i == BGP_SELECT_TIMING_BUCKETS - 1)
+			vty_out(vty, "  %12s %11" PRIu64 "\n", "longer",
+				bucket[i]);
+		else
+			vty_out(vty, "  < %8" PRIu64 "ns %11" PRIu64 "\n",
+				1ULL << (i + BGP_SELECT_TIMING_SHIFT),
+				bucket[i]);
+	}
+}
+
+static json_object *
+bgp_select_timing_json(const struct bgp_select_timing *timing)
+{
+	json_object *json = json_object_new_object();
+	json_object *json_buckets = json_object_new_array();
+	unsigned int i;
+
+	json_object_int_add(json, "count", timing->count);
+	json_object_int_add(json, "totalNs", timing->total_ns);
+	json_object_int_add(json, "maxNs", timing->max_ns);
+	for (i = 0; i < BGP_SELECT_TIMING_BUCKETS; i++)
+		json_object_array_add(json_buckets,
+				      json_object_new_int64(timing->bucket[i]));
+	json_object_object_add(json, "histogram", json_buckets);
+
+	return json;
+}
+
+DEFUN (show_bgp_best_path_timing,
+       show_bgp_best_path_timing_cmd,
+       "show bgp best-path timing [json]",
+       SHOW_STR
+       BGP_STR
+       "Best-path selection\n"
+       "Time spent per destination, by deciding step\n"
+       JSON_STR)
+{
+	bool uj = use_json(argc, argv);
+	json_object *json = NULL, *json_steps = NULL, *json_step, *json_bounds;
+	const struct bgp_select_timing *sel, *proc;
+	unsigned int r, i;
+
+	if (uj) {
+		json = json_object_new_object();
+		json_steps = json_object_new_object();
+		json_bounds = json_object_new_array();
+
+		for (i = 0; i < BGP_SELECT_TIMING_BUCKETS - 1; i++)
+			json_object_array_add(
+				json_bounds,
+				json_object_new_int64(
+					1ULL << (i + BGP_SELECT_TIMING_SHIFT)));
+		json_object_object_add(json, "histogramUpperNs", json_bounds);
+		json_object_object_add(json, "steps", json_steps);
+		json_object_int_add(json, "selectionThreads",
+				    bgp_select_shards());
+		json_object_int_add(json, "parallelBatches",
+				    select_parallel_batches);
+		json_object_int_add(json, "parallelPicks",
+				    select_parallel_picks);
+		json_object_int_add(json, "parallelPicksDropped",
+				    select_parallel_dropped);
+	} else
+		vty_out(vty, "%-28s %10s %8s %9s %10s %8s %9s\n", "Step",
+			"Selected", "Avg(ns)", "Max(ns)", "Processed",
+			"Avg(ns)", "Max(ns)");
+
+	for (r = 0; r < BGP_SELECT_TIMING_REASONS; r++) {
+		sel = &select_timing[r];
+		proc = &process_timing[r];
+		if (!sel->count && !proc->count)
+			continue;
+
+		if (uj) {
+			json_step = json_object_new_object();
+			json_object_object_add(json_step, "selection",
+					       bgp_select_timing_json(sel));
+			json_object_object_add(json_step, "processing",
+					       bgp_select_timing_json(proc));
+			json_object_object_add(
+				json_steps, bgp_path_selection_reason2str(r),
+				json_step);
+			continue;
+		}
+
+		vty_out(vty,
+			"%-28s %10" PRIu64 " %8" PRIu64 " %9" PRIu64
+			" %10" PRIu64 " %8" PRIu64 " %9" PRIu64 "\n",
+			bgp_path_selection_reason2str(r), sel->count,
+			sel->count ? sel->total_ns / sel->count : 0,
+			sel->max_ns, proc->count,
+			proc->count ? proc->total_ns / proc->count : 0,
+			proc->max_ns);
+	}
+
+	if (uj) {
+		vty_json(vty, json);
+		return CMD_SUCCESS;
+	}
+
+	bgp_select_timing_vty(vty, "Selection", select_timing);
+	bgp_select_timing_vty(vty, "Processing", process_timing);
+
+	if (select_parallel_batches)
+		vty_out(vty,
+			"\nParallel selection on %u threads: %" PRIu64
+			" batches, %" PRIu64 " dests picked, %" PRIu64
+			" picked again after a change\n",
+			bgp_select_shards(), select_parallel_batches,
+			select_parallel_picks, select_parallel_dropped);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN (clear_bgp_best_path_timing,
+       clear_bgp_best_path_timing_cmd,
+       "clear bgp best-path timing",
+       CLEAR_STR
+       BGP_STR
+       "Best-path selection\n"
+       "Time spent per destination, by deciding step\n")
+{
+	memset(select_timing, 0, sizeof(select_timing));
+	memset(process_timing, 0, sizeof(process_timing));
+	select_parallel_batches = 0;
+	select_parallel_picks = 0;
+	select_parallel_dropped = 0;
+
+	return CMD_SUCCESS;
+}
+
 DEFPY(show_ip_bgp_dampening_params, show_ip_bgp_dampening_params_cmd,
       "show [ip] bgp [<view|vrf> VIEWVRFNAME] [" BGP_AFI_CMD_STR
       " [" BGP_SAFI_WITH_LABEL_CMD_STR
@@ -13764,7 +14430,7 @@ static void bgp_peer_count_proc(struct bgp_dest *rn, struct peer_pcounts *pc)
 			pc->count[PCOUNT_HISTORY]++;
 		if (CHECK_FLAG(pi->flags, BGP_PATH_REMOVED))
 			pc->count[PCOUNT_REMOVED]++;
-		if (CHECK_FLAG(pi->flags, BGP_PATH_STALE))
+		if (bgp_path_info_stale(pi))
 			pc->count[PCOUNT_STALE]++;
 		if (CHECK_FLAG(pi->flags, BGP_PATH_VALID))
 			pc->count[PCOUNT_VALID]++;
@@ -14099,13 +14765,13 @@ show_adj_route(struct vty *vty, struct peer *peer, struct bgp_table *table,
 	       unsigned long *filtered_count)
 {
 	struct bgp_adj_in *ain = NULL;
-	struct bgp_adj_out *adj = NULL;
+	struct bgp_adj_out_walk walk;
+	struct attr *adv_attr;
 	struct bgp_dest *dest;
 	struct bgp *bgp;
 	struct attr attr;
 	int ret;
 	struct update_subgroup *subgrp;
-	struct peer_af *paf = NULL;
 	bool route_filtered;
 	bool detail = CHECK_FLAG(show_flags, BGP_SHOW_OPT_ROUTES_DETAIL);
 	bool use_json = CHECK_FLAG(show_flags, BGP_SHOW_OPT_JSON);
@@ -14143,7 +14809,7 @@ show_adj_route(struct vty *vty, struct peer *peer, struct bgp_table *table,
 		    type == bgp_show_adj_route_filtered) {
 			for (ain = dest->adj_in; ain; ain = ain->next) {
 				if (ain->peer == peer) {
-					attr = *ain->attr;
+					bgp_adj_in_attr(ain, &attr);
 					break;
 				}
 			}
@@ -14160,22 +14826,17 @@ show_adj_route(struct vty *vty, struct peer *peer, struct bgp_table *table,
 		} else if (type == bgp_show_adj_route_advertised) {
 			bool peer_found = false;
 
-			RB_FOREACH (adj, bgp_adj_out_rb, &dest->adj_out) {
-				SUBGRP_FOREACH_PEER (adj->subgroup, paf) {
-					if (paf->peer == peer && adj->attr) {
-						attr = *adj->attr;
-						peer_found = true;
-						break;
-					}
-				}
-				if (peer_found)
-					break;
+			subgrp = peer_subgroup(peer, afi, safi);
+			SUBGRP_FOREACH_ADVERTISED (subgrp, dest, walk, adv_attr) {
+				attr = *adv_attr;
+				peer_found = true;
+				break;
 			}
 			/* bail out if if adj_out is empty, or
 			 * if the prefix isn't in this peer's
 			 * adj_out
 			 */
-			if (!paf || !peer_found) {
+			if (!peer_found) {
 				if (!use_json)
 					vty_out(vty, "Network not in table\n");
 				bgp_dest_unlock_node(dest);
@@ -14286,7 +14947,7 @@ show_adj_route(struct vty *vty, struct peer *peer, struct bgp_table *table,
 					}
 				}
 
-				attr = *ain->attr;
+				bgp_adj_in_attr(ain, &attr);
 				route_filtered = false;
 
 				/* Filter prefix using distribute list,
@@ -14349,78 +15010,75 @@ show_adj_route(struct vty *vty, struct peer *peer, struct bgp_table *table,
 				(*output_count)++;
 			}
 		} else if (type == bgp_show_adj_route_advertised) {
-			RB_FOREACH (adj, bgp_adj_out_rb, &dest->adj_out)
-				SUBGRP_FOREACH_PEER (adj->subgroup, paf) {
-					if (paf->peer != peer || !adj->attr)
-						continue;
+			SUBGRP_FOREACH_ADVERTISED (subgrp, dest, walk,
+						   adv_attr) {
+				show_adj_route_header(
+					vty, peer, table, header1,
+					header2, json, json_scode,
+					json_ocode, wide, detail);
+
+				const struct prefix *rn_p =
+					bgp_dest_get_prefix(dest);
 
-					show_adj_route_header(
-						vty, peer, table, header1,
-						header2, json, json_scode,
-						json_ocode, wide, detail);
-
-					const struct prefix *rn_p =
-						bgp_dest_get_prefix(dest);
-
-					attr = *adj->attr;
-					ret = bgp_output_modifier(
-						peer, rn_p, &attr, afi, safi,
-						rmap_name);
-
-					if (ret != RMAP_DENY) {
-						if ((safi == SAFI_MPLS_VPN)
-						    || (safi == SAFI_ENCAP)
-						    || (safi == SAFI_EVPN)) {
-							if (use_json)
-								json_object_string_add(
-									json_ar,
-									"rd",
-									rd_str);
-							else if (show_rd
-								 && rd_str) {
-								vty_out(vty,
-									"Route Distinguisher: %s\n",
-									rd_str);
-								show_rd = false;
-							}
+				attr = *adv_attr;
+				ret = bgp_output_modifier(
+					peer, rn_p, &attr, afi, safi,
+					rmap_name);
+
+				if (ret != RMAP_DENY) {
+					if ((safi == SAFI_MPLS_VPN)
+					    || (safi == SAFI_ENCAP)
+					    || (safi == SAFI_EVPN)) {
+						if (use_json)
+							json_object_string_add(
+								json_ar,
+								"rd",
+								rd_str);
+						else if (show_rd
+							 && rd_str) {
+							vty_out(vty,
+								"Route Distinguisher: %s\n",
+								rd_str);
+							show_rd = false;
 						}
-						if (detail) {
-							if (use_json)
-								json_net =
-									json_object_new_object();
-							bgp_show_path_info(
-								NULL /* prefix_rd
-								      */
-								,
-								dest, vty, bgp,
-								afi, safi,
-								json_net,
-								BGP_PATH_SHOW_ALL,
-								&display,
-								RPKI_NOT_BEING_USED);
-							if (use_json)
-								json_object_object_addf(
-									json_ar,
-									json_net,
-									"%pFX",
-									rn_p);
-						} else
-							route_vty_out_tmp(vty,
-									  bgp,
-									  dest,
-									  rn_p,
-									  &attr,
-									  safi,
-									  use_json,
-									  json_ar,
-									  wide);
-						(*output_count)++;
-					} else {
-						(*filtered_count)++;
 					}
-
-					bgp_attr_flush(&attr);
+					if (detail) {
+						if (use_json)
+							json_net =
+								json_object_new_object();
+						bgp_show_path_info(
+							NULL /* prefix_rd
+							      */
+							,
+							dest, vty, bgp,
+							afi, safi,
+							json_net,
+							BGP_PATH_SHOW_ALL,
+							&display,
+							RPKI_NOT_BEING_USED);
+						if (use_json)
+							json_object_object_addf(
+								json_ar,
+								json_net,
+								"%pFX",
+								rn_p);
+					} else
+						route_vty_out_tmp(vty,
+								  bgp,
+								  dest,
+								  rn_p,
+								  &attr,
+								  safi,
+								  use_json,
+								  json_ar,
+								  wide);
+					(*output_count)++;
+				} else {
+					(*filtered_count)++;
 				}
+
+				bgp_attr_flush(&attr);
+			}
 		} else if (type == bgp_show_adj_route_bestpath) {
 			struct bgp_path_info *pi;
 
@@ -15683,14 +16341,6 @@ DEFUN (clear_ip_bgp_dampening_address_mask,
 				    NULL, 0);
 }
 
-static void show_bgp_peerhash_entry(struct hash_bucket *bucket, void *arg)
-{
-       struct vty *vty = arg;
-       struct peer *peer = bucket->data;
-
-       vty_out(vty, "\tPeer: %s %pSU\n", peer->host, &peer->connection->su);
-}
-
 DEFUN (show_bgp_listeners,
        show_bgp_listeners_cmd,
        "show bgp listeners",
@@ -15713,11 +16363,13 @@ DEFUN (show_bgp_peerhash,
        struct list *instances = bm->bgp;
        struct listnode *node;
        struct bgp *bgp;
+       struct peer *peer;
 
        for (ALL_LIST_ELEMENTS_RO(instances, node, bgp)) {
 	       vty_out(vty, "BGP: %s\n", bgp->name_pretty);
-	       hash_iterate(bgp->peerhash, show_bgp_peerhash_entry,
-                            vty);
+	       frr_each (bgp_peerhash, &bgp->peerhash, peer)
+		       vty_out(vty, "\tPeer: %s %pSU\n", peer->host,
+			       &peer->connection->su);
        }
 
        return CMD_SUCCESS;
@@ -15986,6 +16638,8 @@ void bgp_route_init(void)
 	install_element(VIEW_NODE, &show_ip_bgp_instance_all_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_afi_safi_statistics_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_l2vpn_evpn_statistics_cmd);
+	install_element(VIEW_NODE, &show_bgp_best_path_timing_cmd);
+	install_element(ENABLE_NODE, &clear_bgp_best_path_timing_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_dampening_params_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_cmd);
 	install_element(VIEW_NODE, &show_ip_bgp_route_cmd);
@@ -16107,4 +16761,9 @@ void bgp_route_finish(void)
 		bgp_table_unlock(bgp_distance_table[afi][safi]);
 		bgp_distance_table[afi][safi] = NULL;
 	}
+
+	bgp_arena_finish(&bgp_path_info_arena);
+	bgp_arena_finish(&bgp_path_info_extra_arena);
+	bgp_arena_finish(&bgp_dest_arena);
+	bgp_arena_finish(&bgp_rnode_arena);
 }
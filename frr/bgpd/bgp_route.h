@@ -14,6 +14,7 @@
 #include "bgp_table.h"
 #include "bgp_addpath_types.h"
 #include "bgp_rpki.h"
+#include "bgp_arena.h"
 
 struct bgp_nexthop_cache;
 struct bgp_route_evpn;
@@ -309,7 +310,6 @@ struct bgp_path_info {
 #define BGP_PATH_ATTR_CHANGED (1 << 5)
 #define BGP_PATH_DMED_CHECK (1 << 6)
 #define BGP_PATH_DMED_SELECTED (1 << 7)
-#define BGP_PATH_STALE (1 << 8)
 #define BGP_PATH_REMOVED (1 << 9)
 #define BGP_PATH_COUNTED (1 << 10)
 #define BGP_PATH_MULTIPATH (1 << 11)
@@ -320,6 +320,7 @@ struct bgp_path_info {
 #define BGP_PATH_ACCEPT_OWN (1 << 16)
 #define BGP_PATH_MPLSVPN_LABEL_NH (1 << 17)
 #define BGP_PATH_MPLSVPN_NH_LABEL_BIND (1 << 18)
+#define BGP_PATH_LATENCY_WT_CHG (1 << 19)
 
 	/* BGP route type.  This can be static, RIP, OSPF, BGP etc.  */
 	uint8_t type;
@@ -340,6 +341,12 @@ struct bgp_path_info {
 
 	/* Addpath identifiers */
 	uint32_t addpath_rx_id;
+
+	/*
+	 * Stale epoch of the peer when the path was last received, the path
+	 * is stale once the peer's has moved on; see bgp_path_info_stale().
+	 */
+	uint32_t stale_epoch;
 	struct bgp_addpath_info_data tx_addpath;
 
 	union {
@@ -674,6 +681,15 @@ DECLARE_HOOK(bgp_process,
 	      struct peer *peer, bool withdraw),
 	     (bgp, afi, safi, bn, peer, withdraw));
 
+/* called when best path selection changed the selected path of bn, or
+ * the selected path's attributes; new_route is NULL when there is none
+ */
+DECLARE_HOOK(bgp_route_update,
+	     (struct bgp *bgp, afi_t afi, safi_t safi, struct bgp_dest *bn,
+	      struct bgp_path_info *old_route,
+	      struct bgp_path_info *new_route),
+	     (bgp, afi, safi, bn, old_route, new_route));
+
 /* BGP show options */
 #define BGP_SHOW_OPT_JSON (1 << 0)
 #define BGP_SHOW_OPT_WIDE (1 << 1)
@@ -713,6 +729,8 @@ extern void bgp_clear_route_all(struct peer *);
 extern void bgp_clear_adj_in(struct peer *, afi_t, safi_t);
 extern void bgp_clear_stale_route(struct peer *, afi_t, safi_t);
 extern void bgp_set_stale_route(struct peer *peer, afi_t afi, safi_t safi);
+extern void bgp_stale_sweep_cancel(struct peer *peer, afi_t afi, safi_t safi);
+extern bool bgp_path_info_stale(const struct bgp_path_info *pi);
 extern bool bgp_outbound_policy_exists(struct peer *, struct bgp_filter *);
 extern bool bgp_inbound_policy_exists(struct peer *, struct bgp_filter *);
 
@@ -727,6 +745,9 @@ extern struct bgp_path_info *
 bgp_get_imported_bpi_ultimate(struct bgp_path_info *info);
 extern void bgp_path_info_add(struct bgp_dest *dest, struct bgp_path_info *pi);
 extern void bgp_path_info_extra_free(struct bgp_path_info_extra **extra);
+/* Where bgp_path_infos and their extras are allocated */
+extern struct bgp_arena bgp_path_info_arena;
+extern struct bgp_arena bgp_path_info_extra_arena;
 extern struct bgp_dest *bgp_path_info_reap(struct bgp_dest *dest,
 					   struct bgp_path_info *pi);
 extern void bgp_path_info_delete(struct bgp_dest *dest,
@@ -836,8 +857,6 @@ extern void route_vty_out_overlay(struct vty *vty, const struct prefix *p,
 				  struct bgp_path_info *path, int display,
 				  json_object *json);
 
-extern void bgp_notify_conditional_adv_scanner(struct update_subgroup *subgrp);
-
 extern void subgroup_process_announce_selected(struct update_subgroup *subgrp,
 					       struct bgp_path_info *selected,
 					       struct bgp_dest *dest, afi_t afi,
@@ -920,6 +939,7 @@ extern int bgp_path_info_cmp(struct bgp *bgp, struct bgp_path_info *new,
 			     struct bgp_maxpaths_cfg *mpath_cfg, bool debug,
 			     char *pfx_buf, afi_t afi, safi_t safi,
 			     enum bgp_path_selection_reason *reason);
+extern void bgp_bestpath_steps_update(struct bgp *bgp);
 #define bgp_path_info_add(A, B)                                                \
 	bgp_path_info_add_with_caller(__func__, (A), (B))
 #define bgp_path_info_free(B) bgp_path_info_free_with_caller(__func__, (B))
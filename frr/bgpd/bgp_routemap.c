@@ -28,6 +28,8 @@
 #include "buffer.h"
 #include "sockunion.h"
 #include "hash.h"
+#include "jhash.h"
+#include "typesafe.h"
 #include "queue.h"
 #include "frrstr.h"
 #include "network.h"
@@ -59,6 +61,8 @@
 #include "bgpd/bgp_encap_types.h"
 #include "bgpd/bgp_mpath.h"
 #include "bgpd/bgp_script.h"
+#include "bgpd/bgp_twamp.h"
+#include "bgpd/bgp_conditional_adv.h"
 
 #ifdef ENABLE_BGP_VNC
 #include "bgpd/rfapi/bgp_rfapi_cfg.h"
@@ -66,6 +70,8 @@
 
 #include "bgpd/bgp_routemap_clippy.c"
 
+DEFINE_MTYPE_STATIC(BGPD, BGP_RMAP_CACHE, "BGP route-map result cache");
+
 /* Memo of route-map commands.
 
 o Cisco route-map
@@ -2189,6 +2195,73 @@ static const struct route_map_rule_cmd route_set_weight_cmd = {
 	route_value_free,
 };
 
+/* `set weight from-latency' and `set local-preference from-latency' */
+
+/*
+ * Latency of the nexthop a path resolves over, as cached on the nexthop
+ * by bgp_twamp; UINT32_MAX when it is not measured, so a route-map
+ * never reads the shared segment itself.
+ */
+static uint32_t route_path_latency(struct bgp_path_info *path)
+{
+	struct bgp_path_info *ultimate = bgp_get_imported_bpi_ultimate(path);
+
+	return ultimate->nexthop ? ultimate->nexthop->twamp_latency
+				 : UINT32_MAX;
+}
+
+static enum route_map_cmd_result_t
+route_set_weight_from_latency(void *rule, const struct prefix *prefix,
+			      void *object)
+{
+	struct bgp_path_info *path = object;
+	uint32_t latency = route_path_latency(path);
+
+	/* Unmeasured paths keep the weight they have */
+	if (latency != UINT32_MAX)
+		path->attr->weight = bgp_twamp_latency_preference(latency);
+
+	return RMAP_OKAY;
+}
+
+static enum route_map_cmd_result_t
+route_set_local_pref_from_latency(void *rule, const struct prefix *prefix,
+				  void *object)
+{
+	struct bgp_path_info *path = object;
+	uint32_t latency = route_path_latency(path);
+
+	if (latency != UINT32_MAX) {
+		path->attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_LOCAL_PREF);
+		path->attr->local_pref = bgp_twamp_latency_preference(latency);
+	}
+
+	return RMAP_OKAY;
+}
+
+static void *route_set_from_latency_compile(const char *arg)
+{
+	return (void *)1;
+}
+
+static void route_set_from_latency_free(void *rule)
+{
+}
+
+static const struct route_map_rule_cmd route_set_weight_from_latency_cmd = {
+	"weight-from-latency",
+	route_set_weight_from_latency,
+	route_set_from_latency_compile,
+	route_set_from_latency_free,
+};
+
+static const struct route_map_rule_cmd route_set_local_pref_from_latency_cmd = {
+	"local-preference-from-latency",
+	route_set_local_pref_from_latency,
+	route_set_from_latency_compile,
+	route_set_from_latency_free,
+};
+
 /* `set distance DISTANCE */
 static enum route_map_cmd_result_t
 route_set_distance(void *rule, const struct prefix *prefix, void *object)
@@ -4355,6 +4428,100 @@ static const struct route_map_rule_cmd route_match_rpki_extcommunity_cmd = {
 	route_value_free
 };
 
+/* `match latency <lt|le|eq|ge|gt> MICROSECONDS' */
+
+enum route_latency_op {
+	ROUTE_LATENCY_LT,
+	ROUTE_LATENCY_LE,
+	ROUTE_LATENCY_EQ,
+	ROUTE_LATENCY_GE,
+	ROUTE_LATENCY_GT,
+};
+
+struct route_latency_rule {
+	enum route_latency_op op;
+	uint32_t latency_us;
+};
+
+static enum route_map_cmd_result_t
+route_match_latency(void *rule, const struct prefix *prefix, void *object)
+{
+	struct route_latency_rule *rl = rule;
+	uint32_t latency = route_path_latency(object);
+	bool match = false;
+
+	if (latency == UINT32_MAX)
+		return RMAP_NOMATCH;
+
+	switch (rl->op) {
+	case ROUTE_LATENCY_LT:
+		match = latency < rl->latency_us;
+		break;
+	case ROUTE_LATENCY_LE:
+		match = latency <= rl->latency_us;
+		break;
+	case ROUTE_LATENCY_EQ:
+		match = latency == rl->latency_us;
+		break;
+	case ROUTE_LATENCY_GE:
+		match = latency >= rl->latency_us;
+		break;
+	case ROUTE_LATENCY_GT:
+		match = latency > rl->latency_us;
+		break;
+	}
+
+	return match ? RMAP_MATCH : RMAP_NOMATCH;
+}
+
+/* Compile "<op> <microseconds>" once, so matching is two compares. */
+static void *route_match_latency_compile(const char *arg)
+{
+	static const char *const ops[] = {
+		[ROUTE_LATENCY_LT] = "lt", [ROUTE_LATENCY_LE] = "le",
+		[ROUTE_LATENCY_EQ] = "eq", [ROUTE_LATENCY_GE] = "ge",
+		[ROUTE_LATENCY_GT] = "gt",
+	};
+	struct route_latency_rule *rl;
+	char op[3];
+	unsigned long latency_us;
+	char *endptr;
+	size_t i;
+
+	if (strlen(arg) < 4 || arg[2] != ' ')
+		return NULL;
+	strlcpy(op, arg, sizeof(op));
+
+	errno = 0;
+	latency_us = strtoul(arg + 3, &endptr, 10);
+	if (*endptr != '\0' || errno || latency_us > UINT32_MAX)
+		return NULL;
+
+	for (i = 0; i < array_size(ops); i++)
+		if (strmatch(op, ops[i]))
+			break;
+	if (i == array_size(ops))
+		return NULL;
+
+	rl = XMALLOC(MTYPE_ROUTE_MAP_COMPILED, sizeof(*rl));
+	rl->op = i;
+	rl->latency_us = latency_us;
+
+	return rl;
+}
+
+static void route_match_latency_free(void *rule)
+{
+	XFREE(MTYPE_ROUTE_MAP_COMPILED, rule);
+}
+
+static const struct route_map_rule_cmd route_match_latency_cmd = {
+	"latency",
+	route_match_latency,
+	route_match_latency_compile,
+	route_match_latency_free
+};
+
 /*
  * This is the workhorse routine for processing in/out routemap
  * modifications.
@@ -4427,7 +4594,7 @@ static void bgp_route_map_process_peer(const char *rmap_name,
 		peer->default_rmap[afi][safi].map = map;
 
 	/* Notify BGP conditional advertisement scanner percess */
-	peer->advmap_config_change[afi][safi] = true;
+	bgp_conditional_adv_config_change(peer, afi, safi);
 }
 
 static void bgp_route_map_update_peer_group(const char *rmap_name,
@@ -4748,8 +4915,161 @@ static void bgp_route_map_mark_update(const char *rmap_name)
 	}
 }
 
+/*
+ * Route-map results by input attribute. Many paths share an attribute, and
+ * a route-map that looks at nothing but the attribute gives them all the
+ * same answer, so that is remembered: the result, and for a permit the
+ * attribute it was turned into. Only route-maps made entirely of the rules
+ * below are cached, and the whole cache is dropped on any route-map or
+ * filter list event. "show route-map" counts evaluations, not cache hits.
+ */
+PREDECL_HASH(bgp_rmap_cache);
+
+struct bgp_rmap_cache_entry {
+	struct bgp_rmap_cache_item item;
+
+	const struct route_map *map;
+	struct attr *in;
+
+	route_map_result_t ret;
+	/* For a permit: out holds the references, copy is what to hand out */
+	struct attr *out;
+	struct attr copy;
+};
+
+static int bgp_rmap_cache_cmp(const struct bgp_rmap_cache_entry *a,
+			      const struct bgp_rmap_cache_entry *b)
+{
+	if (a->map != b->map)
+		return a->map < b->map ? -1 : 1;
+	return !attrhash_cmp(a->in, b->in);
+}
+
+static uint32_t bgp_rmap_cache_hash(const struct bgp_rmap_cache_entry *e)
+{
+	return jhash_1word(attrhash_key_make(e->in), (uintptr_t)e->map);
+}
+
+DECLARE_HASH(bgp_rmap_cache, struct bgp_rmap_cache_entry, item,
+	     bgp_rmap_cache_cmp, bgp_rmap_cache_hash);
+
+/* Past this, start over rather than grow */
+#define BGP_RMAP_CACHE_MAX 16384
+
+static struct bgp_rmap_cache_head bgp_rmap_cache =
+	INIT_HASH(bgp_rmap_cache);
+
+static void bgp_rmap_cache_flush(void)
+{
+	struct bgp_rmap_cache_entry *e;
+
+	while ((e = bgp_rmap_cache_pop(&bgp_rmap_cache))) {
+		bgp_attr_unintern(&e->in);
+		if (e->out)
+			bgp_attr_unintern(&e->out);
+		XFREE(MTYPE_BGP_RMAP_CACHE, e);
+	}
+}
+
+static bool bgp_rmap_rule_cacheable(const struct route_map_rule *rule)
+{
+	const struct route_map_rule_cmd *cmd = rule->cmd;
+	const struct rmap_value *rv;
+
+	/* Values that may be taken from the peer's rtt */
+	if (cmd == &route_match_local_pref_cmd ||
+	    cmd == &route_match_metric_cmd || cmd == &route_set_local_pref_cmd ||
+	    cmd == &route_set_weight_cmd || cmd == &route_set_metric_cmd) {
+		rv = rule->value;
+		return rv && !rv->variable;
+	}
+
+	return cmd == &route_match_aspath_cmd ||
+	       cmd == &route_match_community_cmd ||
+	       cmd == &route_match_lcommunity_cmd ||
+	       cmd == &route_match_ecommunity_cmd ||
+	       cmd == &route_match_origin_cmd || cmd == &route_match_tag_cmd ||
+	       cmd == &route_set_aspath_prepend_cmd ||
+	       cmd == &route_set_community_cmd ||
+	       cmd == &route_set_community_delete_cmd ||
+	       cmd == &route_set_lcommunity_cmd ||
+	       cmd == &route_set_lcommunity_delete_cmd ||
+	       cmd == &route_set_ecommunity_rt_cmd ||
+	       cmd == &route_set_ecommunity_soo_cmd ||
+	       cmd == &route_set_ecommunity_none_cmd ||
+	       cmd == &route_set_ecommunity_delete_cmd ||
+	       cmd == &route_set_origin_cmd ||
+	       cmd == &route_set_atomic_aggregate_cmd ||
+	       cmd == &route_set_tag_cmd || cmd == &route_set_originator_id_cmd;
+}
+
+static bool bgp_rmap_cacheable(const struct route_map *map)
+{
+	const struct route_map_index *index;
+	const struct route_map_rule *rule;
+
+	for (index = map->head; index; index = index->next) {
+		if (index->nextrm)
+			return false;
+		for (rule = index->match_list.head; rule; rule = rule->next)
+			if (!bgp_rmap_rule_cacheable(rule))
+				return false;
+		for (rule = index->set_list.head; rule; rule = rule->next)
+			if (!bgp_rmap_rule_cacheable(rule))
+				return false;
+	}
+	return true;
+}
+
+route_map_result_t bgp_route_map_apply_cached(struct route_map *map,
+					      const struct prefix *p,
+					      struct bgp_path_info *path)
+{
+	struct bgp_rmap_cache_entry ref, *e;
+	route_map_result_t ret;
+
+	/*
+	 * What the attribute owns would be lost when it is overwritten with
+	 * a cached result, so only attributes without are looked up.
+	 */
+	if (!map || !bgp_attr_subs_interned(path->attr) ||
+	    !bgp_rmap_cacheable(map))
+		return route_map_apply(map, p, path);
+
+	ref.map = map;
+	ref.in = path->attr;
+	e = bgp_rmap_cache_find(&bgp_rmap_cache, &ref);
+	if (e) {
+		map->applied++;
+		if (e->out)
+			*path->attr = e->copy;
+		return e->ret;
+	}
+
+	if (bgp_rmap_cache_count(&bgp_rmap_cache) >= BGP_RMAP_CACHE_MAX)
+		bgp_rmap_cache_flush();
+
+	e = XCALLOC(MTYPE_BGP_RMAP_CACHE, sizeof(*e));
+	e->map = map;
+	e->in = bgp_attr_intern(path->attr);
+
+	ret = route_map_apply(map, p, path);
+
+	e->ret = ret;
+	if (ret != RMAP_DENYMATCH) {
+		/* Interns whatever the set clauses added in place as well */
+		e->out = bgp_attr_intern(path->attr);
+		e->copy = *path->attr;
+	}
+	bgp_rmap_cache_add(&bgp_rmap_cache, e);
+
+	return ret;
+}
+
 static void bgp_route_map_add(const char *rmap_name)
 {
+	bgp_rmap_cache_flush();
+
 	if (route_map_mark_updated(rmap_name) == 0)
 		bgp_route_map_mark_update(rmap_name);
 
@@ -4758,6 +5078,8 @@ static void bgp_route_map_add(const char *rmap_name)
 
 static void bgp_route_map_delete(const char *rmap_name)
 {
+	bgp_rmap_cache_flush();
+
 	if (route_map_mark_updated(rmap_name) == 0)
 		bgp_route_map_mark_update(rmap_name);
 
@@ -4766,6 +5088,8 @@ static void bgp_route_map_delete(const char *rmap_name)
 
 static void bgp_route_map_event(const char *rmap_name)
 {
+	bgp_rmap_cache_flush();
+
 	if (route_map_mark_updated(rmap_name) == 0)
 		bgp_route_map_mark_update(rmap_name);
 
@@ -6046,6 +6370,56 @@ DEFUN_YANG (no_set_weight,
 	return nb_cli_apply_changes(vty, NULL);
 }
 
+DEFPY_YANG (set_weight_from_latency,
+	    set_weight_from_latency_cmd,
+	    "[no$no] set weight from-latency",
+	    NO_STR
+	    SET_STR
+	    "BGP weight for routing table\n"
+	    "Derive the weight from the measured nexthop latency\n")
+{
+	const char *xpath =
+		"./set-action[action='frr-bgp-route-map:weight-from-latency']";
+	char xpath_value[XPATH_MAXLEN];
+
+	if (no) {
+		nb_cli_enqueue_change(vty, xpath, NB_OP_DESTROY, NULL);
+		return nb_cli_apply_changes(vty, NULL);
+	}
+
+	nb_cli_enqueue_change(vty, xpath, NB_OP_CREATE, NULL);
+	snprintf(xpath_value, sizeof(xpath_value),
+		 "%s/rmap-set-action/frr-bgp-route-map:weight-from-latency",
+		 xpath);
+	nb_cli_enqueue_change(vty, xpath_value, NB_OP_MODIFY, NULL);
+	return nb_cli_apply_changes(vty, NULL);
+}
+
+DEFPY_YANG (set_local_pref_from_latency,
+	    set_local_pref_from_latency_cmd,
+	    "[no$no] set local-preference from-latency",
+	    NO_STR
+	    SET_STR
+	    "BGP local preference path attribute\n"
+	    "Derive the local preference from the measured nexthop latency\n")
+{
+	const char *xpath =
+		"./set-action[action='frr-bgp-route-map:local-preference-from-latency']";
+	char xpath_value[XPATH_MAXLEN];
+
+	if (no) {
+		nb_cli_enqueue_change(vty, xpath, NB_OP_DESTROY, NULL);
+		return nb_cli_apply_changes(vty, NULL);
+	}
+
+	nb_cli_enqueue_change(vty, xpath, NB_OP_CREATE, NULL);
+	snprintf(xpath_value, sizeof(xpath_value),
+		 "%s/rmap-set-action/frr-bgp-route-map:local-preference-from-latency",
+		 xpath);
+	nb_cli_enqueue_change(vty, xpath_value, NB_OP_MODIFY, NULL);
+	return nb_cli_apply_changes(vty, NULL);
+}
+
 DEFUN_YANG (set_label_index,
 	    set_label_index_cmd,
 	    "set label-index (0-1048560)",
@@ -7647,6 +8021,65 @@ DEFPY_YANG (match_rpki_extcommunity,
 	return nb_cli_apply_changes(vty, NULL);
 }
 
+DEFPY_YANG (match_latency,
+       match_latency_cmd,
+       "match latency <lt|le|eq|ge|gt>$op (0-1000000)$value [<milliseconds|microseconds>$unit]",
+       MATCH_STR
+       "Measured latency of the path's nexthop\n"
+       "Less than\n"
+       "Less than or equal to\n"
+       "Equal to\n"
+       "Greater than or equal to\n"
+       "Greater than\n"
+       "Latency\n"
+       "Latency in milliseconds\n"
+       "Latency in microseconds\n")
+{
+	const char *xpath =
+		"./match-condition[condition='frr-bgp-route-map:latency']";
+	char xpath_value[XPATH_MAXLEN];
+	char latency[32];
+
+	if (!unit || strmatch(unit, "milliseconds")) {
+		if (value > 1000) {
+			vty_out(vty,
+				"%% Latency must be at most 1000 milliseconds\n");
+			return CMD_WARNING_CONFIG_FAILED;
+		}
+		value *= 1000;
+	}
+	snprintf(latency, sizeof(latency), "%s %ld", op, value);
+
+	nb_cli_enqueue_change(vty, xpath, NB_OP_CREATE, NULL);
+	snprintf(xpath_value, sizeof(xpath_value),
+		 "%s/rmap-match-condition/frr-bgp-route-map:latency", xpath);
+	nb_cli_enqueue_change(vty, xpath_value, NB_OP_MODIFY, latency);
+
+	return nb_cli_apply_changes(vty, NULL);
+}
+
+DEFPY_YANG (no_match_latency,
+       no_match_latency_cmd,
+       "no match latency [<lt|le|eq|ge|gt> (0-1000000) [<milliseconds|microseconds>]]",
+       NO_STR
+       MATCH_STR
+       "Measured latency of the path's nexthop\n"
+       "Less than\n"
+       "Less than or equal to\n"
+       "Equal to\n"
+       "Greater than or equal to\n"
+       "Greater than\n"
+       "Latency\n"
+       "Latency in milliseconds\n"
+       "Latency in microseconds\n")
+{
+	const char *xpath =
+		"./match-condition[condition='frr-bgp-route-map:latency']";
+
+	nb_cli_enqueue_change(vty, xpath, NB_OP_DESTROY, NULL);
+	return nb_cli_apply_changes(vty, NULL);
+}
+
 DEFPY_YANG (match_source_protocol,
             match_source_protocol_cmd,
 	    "match source-protocol " FRR_REDIST_STR_ZEBRA "$proto",
@@ -7784,6 +8217,8 @@ void bgp_route_map_init(void)
 	route_map_install_set(&route_set_ip_nexthop_cmd);
 	route_map_install_set(&route_set_local_pref_cmd);
 	route_map_install_set(&route_set_weight_cmd);
+	route_map_install_set(&route_set_weight_from_latency_cmd);
+	route_map_install_set(&route_set_local_pref_from_latency_cmd);
 	route_map_install_set(&route_set_label_index_cmd);
 	route_map_install_set(&route_set_metric_cmd);
 	route_map_install_set(&route_set_distance_cmd);
@@ -7864,6 +8299,8 @@ void bgp_route_map_init(void)
 	install_element(RMAP_NODE, &set_weight_cmd);
 	install_element(RMAP_NODE, &set_label_index_cmd);
 	install_element(RMAP_NODE, &no_set_weight_cmd);
+	install_element(RMAP_NODE, &set_weight_from_latency_cmd);
+	install_element(RMAP_NODE, &set_local_pref_from_latency_cmd);
 	install_element(RMAP_NODE, &no_set_label_index_cmd);
 	install_element(RMAP_NODE, &set_aspath_prepend_asn_cmd);
 	install_element(RMAP_NODE, &set_aspath_prepend_lastas_cmd);
@@ -7942,6 +8379,7 @@ void bgp_route_map_init(void)
 	route_map_install_set(&route_set_ipv6_nexthop_local_cmd);
 	route_map_install_set(&route_set_ipv6_nexthop_peer_cmd);
 	route_map_install_match(&route_match_rpki_extcommunity_cmd);
+	route_map_install_match(&route_match_latency_cmd);
 
 	install_element(RMAP_NODE, &match_ipv6_next_hop_address_cmd);
 	install_element(RMAP_NODE, &no_match_ipv6_next_hop_address_cmd);
@@ -7956,6 +8394,8 @@ void bgp_route_map_init(void)
 	install_element(RMAP_NODE, &set_ipv6_nexthop_peer_cmd);
 	install_element(RMAP_NODE, &no_set_ipv6_nexthop_peer_cmd);
 	install_element(RMAP_NODE, &match_rpki_extcommunity_cmd);
+	install_element(RMAP_NODE, &match_latency_cmd);
+	install_element(RMAP_NODE, &no_match_latency_cmd);
 	install_element(RMAP_NODE, &match_source_protocol_cmd);
 	install_element(RMAP_NODE, &no_match_source_protocol_cmd);
 #ifdef HAVE_SCRIPTING
@@ -7966,5 +8406,6 @@ void bgp_route_map_init(void)
 void bgp_route_map_terminate(void)
 {
 	/* ToDo: Cleanup all the used memory */
+	bgp_rmap_cache_flush();
 	route_map_finish();
 }
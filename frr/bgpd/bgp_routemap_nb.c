@@ -60,6 +60,13 @@ const struct frr_yang_module_info frr_bgp_route_map_info = {
 				.destroy = lib_route_map_entry_match_condition_rmap_match_condition_rpki_extcommunity_destroy,
 			}
 		},
+		{
+			.xpath = "/frr-route-map:lib/route-map/entry/match-condition/rmap-match-condition/frr-bgp-route-map:latency",
+			.cbs = {
+				.modify = lib_route_map_entry_match_condition_rmap_match_condition_latency_modify,
+				.destroy = lib_route_map_entry_match_condition_rmap_match_condition_latency_destroy,
+			}
+		},
 		{
 			.xpath = "/frr-route-map:lib/route-map/entry/match-condition/rmap-match-condition/frr-bgp-route-map:probability",
 			.cbs = {
@@ -290,6 +297,20 @@ const struct frr_yang_module_info frr_bgp_route_map_info = {
 				.destroy = lib_route_map_entry_set_action_rmap_set_action_atomic_aggregate_destroy,
 			}
 		},
+		{
+			.xpath = "/frr-route-map:lib/route-map/entry/set-action/rmap-set-action/frr-bgp-route-map:weight-from-latency",
+			.cbs = {
+				.create = lib_route_map_entry_set_action_rmap_set_action_weight_from_latency_create,
+				.destroy = lib_route_map_entry_set_action_rmap_set_action_weight_from_latency_destroy,
+			}
+		},
+		{
+			.xpath = "/frr-route-map:lib/route-map/entry/set-action/rmap-set-action/frr-bgp-route-map:local-preference-from-latency",
+			.cbs = {
+				.create = lib_route_map_entry_set_action_rmap_set_action_local_preference_from_latency_create,
+				.destroy = lib_route_map_entry_set_action_rmap_set_action_local_preference_from_latency_destroy,
+			}
+		},
 		{
 			.xpath = "/frr-route-map:lib/route-map/entry/set-action/rmap-set-action/frr-bgp-route-map:aigp-metric",
 			.cbs = {
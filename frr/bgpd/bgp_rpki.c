@@ -25,6 +25,7 @@
 #include "memory.h"
 #include "frrevent.h"
 #include "filter.h"
+#include "table.h"
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
 #include "bgp_advertise.h"
@@ -47,11 +48,16 @@ DEFINE_MTYPE_STATIC(BGPD, BGP_RPKI_CACHE, "BGP RPKI Cache server");
 DEFINE_MTYPE_STATIC(BGPD, BGP_RPKI_CACHE_GROUP, "BGP RPKI Cache server group");
 DEFINE_MTYPE_STATIC(BGPD, BGP_RPKI_RTRLIB, "BGP RPKI RTRLib");
 DEFINE_MTYPE_STATIC(BGPD, BGP_RPKI_REVALIDATE, "BGP RPKI Revalidation");
+DEFINE_MTYPE_STATIC(BGPD, BGP_RPKI_ROA, "BGP RPKI ROA index");
 
 #define POLLING_PERIOD_DEFAULT 3600
 #define EXPIRE_INTERVAL_DEFAULT 7200
 #define RETRY_INTERVAL_DEFAULT 600
 #define BGP_RPKI_CACHE_SERVER_SYNC_RETRY_TIMEOUT 3
+/* Updates of the prefix table read from the sync socket in one go */
+#define RPKI_SYNC_BATCH 1000
+/* Routes revalidated before yielding to other events */
+#define RPKI_REVALIDATE_BATCH 1000
 
 static struct event *t_rpki_sync;
 
@@ -360,7 +366,7 @@ inline bool is_stopping(void)
 	return rtr_is_stopping;
 }
 
-static void pfx_record_to_prefix(struct pfx_record *record,
+static void pfx_record_to_prefix(const struct pfx_record *record,
 				 struct prefix *prefix)
 {
 	prefix->prefixlen = record->min_len;
@@ -375,32 +381,267 @@ static void pfx_record_to_prefix(struct pfx_record *record,
 	}
 }
 
+/*
+ * bgpd's own index of the ROAs in rtrlib's prefix table, kept from the
+ * updates on the sync socket. Validating a route walks up the covering
+ * nodes from its longest match, without going through rtrlib and its lock.
+ */
+struct rpki_roa {
+	struct rpki_roa *next;
+
+	/* Cache the record came from, only compared */
+	const struct rtr_socket *socket;
+	as_t asn;
+	uint8_t max_len;
+};
+
+static struct route_table *roa_index[AFI_MAX];
+
+/* A change of the prefix table, from the rtrlib pthread to bgpd's */
+struct rpki_sync_msg {
+	struct pfx_record rec;
+	bool added;
+};
+
+static void rpki_roa_update(const struct pfx_record *rec, bool added)
+{
+	afi_t afi = (rec->prefix.ver == LRTR_IPV4) ? AFI_IP : AFI_IP6;
+	struct rpki_roa *roa, *prev = NULL;
+	struct route_node *rn;
+	struct prefix prefix;
+
+	pfx_record_to_prefix(rec, &prefix);
+	if (added)
+		rn = route_node_get(roa_index[afi], &prefix);
+	else
+		rn = route_node_lookup(roa_index[afi], &prefix);
+	if (!rn)
+		return;
+
+	for (roa = rn->info; roa; prev = roa, roa = roa->next)
+		if (roa->socket == rec->socket && roa->asn == rec->asn &&
+		    roa->max_len == rec->max_len)
+			break;
+
+	if (added) {
+		if (roa) {
+			route_unlock_node(rn);
+			return;
+		}
+		roa = XCALLOC(MTYPE_BGP_RPKI_ROA, sizeof(*roa));
+		roa->socket = rec->socket;
+		roa->asn = rec->asn;
+		roa->max_len = rec->max_len;
+		roa->next = rn->info;
+		/* The first ROA of the node keeps the lock of route_node_get */
+		if (rn->info)
+			route_unlock_node(rn);
+		rn->info = roa;
+		return;
+	}
+
+	if (roa) {
+		if (prev)
+			prev->next = roa->next;
+		else
+			rn->info = roa->next;
+		XFREE(MTYPE_BGP_RPKI_ROA, roa);
+		if (!rn->info)
+			route_unlock_node(rn);
+	}
+	route_unlock_node(rn);
+}
+
+static void rpki_roa_clear(void)
+{
+	struct route_node *rn;
+	struct rpki_roa *roa;
+	afi_t afi;
+
+	for (afi = AFI_IP; afi < AFI_MAX; afi++) {
+		if (!roa_index[afi])
+			continue;
+
+		for (rn = route_top(roa_index[afi]); rn; rn = route_next(rn)) {
+			if (!rn->info)
+				continue;
+
+			while ((roa = rn->info)) {
+				rn->info = roa->next;
+				XFREE(MTYPE_BGP_RPKI_ROA, roa);
+			}
+			route_unlock_node(rn);
+		}
+	}
+}
+
+static void rpki_roa_rebuild_cb(const struct pfx_record *rec, void *data)
+{
+	rpki_roa_update(rec, true);
+}
+
+/* After updates were lost, take the whole prefix table again */
+static void rpki_roa_rebuild(void)
+{
+	rpki_roa_clear();
+	if (!is_running())
+		return;
+
+	pfx_table_for_each_ipv4_record(rtr_config->pfx_table,
+				       rpki_roa_rebuild_cb, NULL);
+	pfx_table_for_each_ipv6_record(rtr_config->pfx_table,
+				       rpki_roa_rebuild_cb, NULL);
+}
+
+/* RFC 6811 origin validation of prefix, against the ROA index */
+static enum pfxv_state rpki_roa_validate(afi_t afi, const struct prefix *prefix,
+					 as_t asn)
+{
+	enum pfxv_state result = BGP_PFXV_STATE_NOT_FOUND;
+	const struct route_node *rn;
+	struct route_node *match;
+	struct rpki_roa *roa;
+
+	match = route_node_match(roa_index[afi], prefix);
+	for (rn = match; rn; rn = rn->parent) {
+		for (roa = rn->info; roa; roa = roa->next) {
+			if (roa->asn == asn && prefix->prefixlen <= roa->max_len) {
+				result = BGP_PFXV_STATE_VALID;
+				goto done;
+			}
+			result = BGP_PFXV_STATE_INVALID;
+		}
+	}
+done:
+	if (match)
+		route_unlock_node(match);
+	return result;
+}
+
+/*
+ * A ROA change revalidates the routes under its prefix. The subtrees to
+ * walk are queued and walked a batch of routes at a time, so that a large
+ * churn of ROAs does not hold up the other events of bgpd.
+ */
+PREDECL_DLIST(rpki_revalidate_queue);
+
 struct rpki_revalidate_prefix {
+	struct rpki_revalidate_queue_item item;
+
 	struct bgp *bgp;
 	struct prefix prefix;
 	afi_t afi;
 	safi_t safi;
+
+	/* Once the walk has begun: its limit and next dest, both locked */
+	struct bgp_dest *top;
+	struct bgp_dest *next;
 };
 
+DECLARE_DLIST(rpki_revalidate_queue, struct rpki_revalidate_prefix, item);
+
+static struct rpki_revalidate_queue_head rpki_revalidate_queue;
+static struct event *t_rpki_revalidate;
+
+static void rpki_revalidate_prefix_free(struct rpki_revalidate_prefix *rrp)
+{
+	if (rrp->next)
+		bgp_dest_unlock_node(rrp->next);
+	if (rrp->top)
+		bgp_dest_unlock_node(rrp->top);
+	XFREE(MTYPE_BGP_RPKI_REVALIDATE, rrp);
+}
+
 static void rpki_revalidate_prefix(struct event *thread)
 {
-	struct rpki_revalidate_prefix *rrp = EVENT_ARG(thread);
-	struct bgp_dest *match, *node;
+	struct rpki_revalidate_prefix *rrp;
+	unsigned int budget = RPKI_REVALIDATE_BATCH;
+
+	while (budget &&
+	       (rrp = rpki_revalidate_queue_first(&rpki_revalidate_queue))) {
+		if (!rrp->top) {
+			rrp->top = bgp_table_subtree_lookup(
+				rrp->bgp->rib[rrp->afi][rrp->safi],
+				&rrp->prefix);
+			if (!rrp->top) {
+				rpki_revalidate_queue_pop(&rpki_revalidate_queue);
+				rpki_revalidate_prefix_free(rrp);
+				continue;
+			}
+			/* The lookup's lock goes with the walk */
+			rrp->next = rrp->top;
+			bgp_dest_lock_node(rrp->top);
+		}
 
-	match = bgp_table_subtree_lookup(rrp->bgp->rib[rrp->afi][rrp->safi],
-					 &rrp->prefix);
+		while (rrp->next && budget) {
+			if (bgp_dest_has_bgp_path_info_data(rrp->next)) {
+				revalidate_bgp_node(rrp->next, rrp->afi,
+						    rrp->safi);
+				budget--;
+			}
+			rrp->next = bgp_route_next_until(rrp->next, rrp->top);
+		}
+		if (rrp->next)
+			break;
 
-	node = match;
+		rpki_revalidate_queue_pop(&rpki_revalidate_queue);
+		rpki_revalidate_prefix_free(rrp);
+	}
 
-	while (node) {
-		if (bgp_dest_has_bgp_path_info_data(node)) {
-			revalidate_bgp_node(node, rrp->afi, rrp->safi);
-		}
+	if (rpki_revalidate_queue_count(&rpki_revalidate_queue))
+		event_add_event(bm->master, rpki_revalidate_prefix, NULL, 0,
+				&t_rpki_revalidate);
+}
+
+static void rpki_revalidate_add(struct bgp *bgp, afi_t afi, safi_t safi,
+				const struct prefix *prefix)
+{
+	struct rpki_revalidate_prefix *rrp;
+
+	/* The ROAs of a prefix come in a row, e.g. one per origin */
+	rrp = rpki_revalidate_queue_last(&rpki_revalidate_queue);
+	if (rrp && !rrp->top && rrp->bgp == bgp && rrp->afi == afi &&
+	    rrp->safi == safi && prefix_match(&rrp->prefix, prefix))
+		return;
+
+	rrp = XCALLOC(MTYPE_BGP_RPKI_REVALIDATE, sizeof(*rrp));
+	rrp->bgp = bgp;
+	rrp->prefix = *prefix;
+	rrp->afi = afi;
+	rrp->safi = safi;
+	rpki_revalidate_queue_add_tail(&rpki_revalidate_queue, rrp);
+
+	event_add_event(bm->master, rpki_revalidate_prefix, NULL, 0,
+			&t_rpki_revalidate);
+}
+
+static void rpki_revalidate_flush(struct bgp *bgp)
+{
+	struct rpki_revalidate_prefix *rrp;
+
+	frr_each_safe (rpki_revalidate_queue, &rpki_revalidate_queue, rrp) {
+		if (bgp && rrp->bgp != bgp)
+			continue;
 
-		node = bgp_route_next_until(node, match);
+		rpki_revalidate_queue_del(&rpki_revalidate_queue, rrp);
+		rpki_revalidate_prefix_free(rrp);
 	}
+	if (!rpki_revalidate_queue_count(&rpki_revalidate_queue))
+		EVENT_OFF(t_rpki_revalidate);
+}
 
-	XFREE(MTYPE_BGP_RPKI_REVALIDATE, rrp);
+static int rpki_bgp_del(struct bgp *bgp)
+{
+	rpki_revalidate_flush(bgp);
+	return 0;
+}
+
+static void rpki_sync_drain(void)
+{
+	struct rpki_sync_msg msg;
+
+	while (read(rpki_sync_socket_bgpd, &msg, sizeof(msg)) != -1)
+		;
 }
 
 static void bgpd_sync_callback(struct event *thread)
@@ -408,49 +649,46 @@ static void bgpd_sync_callback(struct event *thread)
 	struct bgp *bgp;
 	struct listnode *node;
 	struct prefix prefix;
-	struct pfx_record rec;
+	struct rpki_sync_msg msg;
+	unsigned int count;
+	ssize_t retval;
+	afi_t afi;
 
 	event_add_read(bm->master, bgpd_sync_callback, NULL,
 		       rpki_sync_socket_bgpd, NULL);
 
 	if (atomic_load_explicit(&rtr_update_overflow, memory_order_seq_cst)) {
-		while (read(rpki_sync_socket_bgpd, &rec,
-			    sizeof(struct pfx_record)) != -1)
-			;
+		rpki_sync_drain();
 
 		atomic_store_explicit(&rtr_update_overflow, 0,
 				      memory_order_seq_cst);
+		rpki_roa_rebuild();
 		revalidate_all_routes();
 		return;
 	}
 
-	int retval =
-		read(rpki_sync_socket_bgpd, &rec, sizeof(struct pfx_record));
-	if (retval != sizeof(struct pfx_record)) {
-		RPKI_DEBUG("Could not read from rpki_sync_socket_bgpd");
-		return;
-	}
-	pfx_record_to_prefix(&rec, &prefix);
-
-	afi_t afi = (rec.prefix.ver == LRTR_IPV4) ? AFI_IP : AFI_IP6;
+	for (count = 0; count < RPKI_SYNC_BATCH; count++) {
+		retval = read(rpki_sync_socket_bgpd, &msg, sizeof(msg));
+		if (retval == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (retval != sizeof(msg)) {
+			RPKI_DEBUG("Could not read from rpki_sync_socket_bgpd");
+			break;
+		}
 
-	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp)) {
-		safi_t safi;
+		rpki_roa_update(&msg.rec, msg.added);
+		pfx_record_to_prefix(&msg.rec, &prefix);
+		afi = (msg.rec.prefix.ver == LRTR_IPV4) ? AFI_IP : AFI_IP6;
 
-		for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
-			struct bgp_table *table = bgp->rib[afi][safi];
-			struct rpki_revalidate_prefix *rrp;
+		for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp)) {
+			safi_t safi;
 
-			if (!table)
-				continue;
+			for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
+				if (!bgp->rib[afi][safi])
+					continue;
 
-			rrp = XCALLOC(MTYPE_BGP_RPKI_REVALIDATE, sizeof(*rrp));
-			rrp->bgp = bgp;
-			rrp->prefix = prefix;
-			rrp->afi = afi;
-			rrp->safi = safi;
-			event_add_event(bm->master, rpki_revalidate_prefix, rrp,
-					0, &bgp->t_revalidate[afi][safi]);
+				rpki_revalidate_add(bgp, afi, safi, &prefix);
+			}
 		}
 	}
 }
@@ -465,13 +703,15 @@ static void revalidate_bgp_node(struct bgp_dest *bgp_dest, afi_t afi,
 			bgp_dest_get_bgp_path_info(bgp_dest);
 		mpls_label_t *label = NULL;
 		uint32_t num_labels = 0;
+		struct attr attr;
 
 		if (path && path->extra) {
 			label = path->extra->label;
 			num_labels = path->extra->num_labels;
 		}
+		bgp_adj_in_attr(ain, &attr);
 		(void)bgp_update(ain->peer, bgp_dest_get_prefix(bgp_dest),
-				 ain->addpath_rx_id, ain->attr, afi, safi,
+				 ain->addpath_rx_id, &attr, afi, safi,
 				 ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, label,
 				 num_labels, 1, NULL);
 	}
@@ -541,19 +781,20 @@ static void revalidate_all_routes(void)
 
 static void rpki_update_cb_sync_rtr(struct pfx_table *p __attribute__((unused)),
 				    const struct pfx_record rec,
-				    const bool added __attribute__((unused)))
+				    const bool added)
 {
+	struct rpki_sync_msg msg = { .rec = rec, .added = added };
+
 	if (is_stopping() ||
 	    atomic_load_explicit(&rtr_update_overflow, memory_order_seq_cst))
 		return;
 
-	int retval =
-		write(rpki_sync_socket_rtr, &rec, sizeof(struct pfx_record));
+	int retval = write(rpki_sync_socket_rtr, &msg, sizeof(msg));
 	if (retval == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
 		atomic_store_explicit(&rtr_update_overflow, 1,
 				      memory_order_seq_cst);
 
-	else if (retval != sizeof(struct pfx_record))
+	else if (retval != sizeof(msg))
 		RPKI_DEBUG("Could not write to rpki_sync_socket_rtr");
 }
 
@@ -602,6 +843,10 @@ static int bgp_rpki_init(struct event_loop *master)
 	cache_list = list_new();
 	cache_list->del = (void (*)(void *)) & free_cache;
 
+	roa_index[AFI_IP] = route_table_init();
+	roa_index[AFI_IP6] = route_table_init();
+	rpki_revalidate_queue_init(&rpki_revalidate_queue);
+
 	polling_period = POLLING_PERIOD_DEFAULT;
 	expire_interval = EXPIRE_INTERVAL_DEFAULT;
 	retry_interval = RETRY_INTERVAL_DEFAULT;
@@ -615,6 +860,11 @@ static int bgp_rpki_fini(void)
 	stop();
 	list_delete(&cache_list);
 
+	rpki_revalidate_flush(NULL);
+	rpki_revalidate_queue_fini(&rpki_revalidate_queue);
+	route_table_finish(roa_index[AFI_IP]);
+	route_table_finish(roa_index[AFI_IP6]);
+
 	close(rpki_sync_socket_rtr);
 	close(rpki_sync_socket_bgpd);
 
@@ -628,6 +878,7 @@ static int bgp_rpki_module_init(void)
 	hook_register(bgp_rpki_prefix_status, rpki_validate_prefix);
 	hook_register(frr_late_init, bgp_rpki_init);
 	hook_register(frr_early_fini, bgp_rpki_fini);
+	hook_register(bgp_inst_delete, rpki_bgp_del);
 
 	return 0;
 }
@@ -698,6 +949,10 @@ static void stop(void)
 		rtr_mgr_stop(rtr_config);
 		rtr_mgr_free(rtr_config);
 		rtr_is_running = false;
+
+		/* What is left on the socket is of the caches just freed */
+		rpki_sync_drain();
+		rpki_roa_clear();
 	}
 }
 
@@ -831,8 +1086,8 @@ static int rpki_validate_prefix(struct peer *peer, struct attr *attr,
 {
 	struct assegment *as_segment;
 	as_t as_number = 0;
-	struct lrtr_ip_addr ip_addr_prefix;
 	enum pfxv_state result;
+	afi_t afi;
 
 	if (!is_synchronized())
 		return RPKI_NOT_BEING_USED;
@@ -861,17 +1116,13 @@ static int rpki_validate_prefix(struct peer *peer, struct attr *attr,
 		}
 	}
 
-	// Get the prefix in requested format
 	switch (prefix->family) {
 	case AF_INET:
-		ip_addr_prefix.ver = LRTR_IPV4;
-		ip_addr_prefix.u.addr4.addr = ntohl(prefix->u.prefix4.s_addr);
+		afi = AFI_IP;
 		break;
 
 	case AF_INET6:
-		ip_addr_prefix.ver = LRTR_IPV6;
-		ipv6_addr_to_host_byte_order(prefix->u.prefix6.s6_addr32,
-					     ip_addr_prefix.u.addr6.addr);
+		afi = AFI_IP6;
 		break;
 
 	default:
@@ -879,8 +1130,7 @@ static int rpki_validate_prefix(struct peer *peer, struct attr *attr,
 	}
 
 	// Do the actual validation
-	rtr_mgr_validate(rtr_config, as_number, &ip_addr_prefix,
-			 prefix->prefixlen, &result);
+	result = rpki_roa_validate(afi, prefix, as_number);
 
 	// Print Debug output
 	switch (result) {
@@ -0,0 +1,115 @@
+/*
+ * Best-path selection worker pool.
+ *
+ * The workers are frr_pthreads sitting in their event loop. A batch is
+ * dispatched as one event per worker and the caller works its own shard
+ * before waiting for the rest, so with N threads configured a batch costs
+ * the main thread about 1/N of its selection time.
+ */
+#include "zebra.h"
+
+#include "lib/frr_pthread.h"
+#include "lib/memory.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_select.h"
+
+DEFINE_MTYPE_STATIC(BGPD, BGP_SELECT_POOL, "BGP best-path workers");
+
+static struct {
+	struct frr_pthread **workers;
+	unsigned int count;
+
+	pthread_mutex_t mtx;
+	pthread_cond_t done;
+	/* Shards of the running batch not finished yet; requires mtx */
+	unsigned int pending;
+
+	/* The running batch, set before its events are queued */
+	bgp_select_fn fn;
+	void *arg;
+} pool = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+};
+
+unsigned int bgp_select_shards(void)
+{
+	return pool.count + 1;
+}
+
+static void bgp_select_shard(struct event *thread)
+{
+	unsigned int shard = EVENT_VAL(thread);
+
+	pool.fn(pool.arg, shard, pool.count + 1);
+
+	frr_with_mutex (&pool.mtx) {
+		if (--pool.pending == 0)
+			pthread_cond_signal(&pool.done);
+	}
+}
+
+void bgp_select_run(bgp_select_fn fn, void *arg)
+{
+	unsigned int i;
+
+	if (!pool.count) {
+		fn(arg, 0, 1);
+		return;
+	}
+
+	pool.fn = fn;
+	pool.arg = arg;
+	frr_with_mutex (&pool.mtx) {
+		pool.pending = pool.count;
+	}
+	for (i = 0; i < pool.count; i++)
+		event_add_event(pool.workers[i]->master, bgp_select_shard, NULL,
+				i + 1, NULL);
+
+	fn(arg, 0, pool.count + 1);
+
+	frr_with_mutex (&pool.mtx) {
+		while (pool.pending)
+			pthread_cond_wait(&pool.done, &pool.mtx);
+	}
+}
+
+void bgp_select_workers_set(unsigned int threads)
+{
+	struct frr_pthread_attr attr = {
+		.start = frr_pthread_attr_default.start,
+		.stop = frr_pthread_attr_default.stop,
+	};
+	unsigned int count = threads > 1 ? threads - 1 : 0;
+	char name[64], os_name[16];
+
+	while (pool.count > count) {
+		struct frr_pthread *fpt = pool.workers[--pool.count];
+
+		frr_pthread_stop(fpt, NULL);
+		frr_pthread_destroy(fpt);
+	}
+
+	if (count > pool.count) {
+		pool.workers = XREALLOC(MTYPE_BGP_SELECT_POOL, pool.workers,
+					count * sizeof(*pool.workers));
+		while (pool.count < count) {
+			struct frr_pthread *fpt;
+
+			snprintf(name, sizeof(name), "BGP best-path worker %u",
+				 pool.count + 1);
+			snprintf(os_name, sizeof(os_name), "bgpd_sel%u",
+				 pool.count + 1);
+			fpt = frr_pthread_new(&attr, name, os_name);
+			frr_pthread_run(fpt, NULL);
+			frr_pthread_wait_running(fpt);
+			pool.workers[pool.count++] = fpt;
+		}
+	}
+	if (!count)
+		XFREE(MTYPE_BGP_SELECT_POOL, pool.workers);
+
+	zlog_info("BGP best-path selection on %u thread(s)", count + 1);
+}
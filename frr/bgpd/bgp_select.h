@@ -0,0 +1,21 @@
+#ifndef _BGP_SELECT_H
+#define _BGP_SELECT_H
+
+/*
+ * Worker pool for best-path selection. bgp_select_run() calls fn once per
+ * shard, 0 to bgp_select_shards() - 1, shard 0 on the calling thread and
+ * the others on the workers, and returns when all are done. fn must only
+ * read shared state: the main thread is blocked meanwhile, and nothing
+ * else changes the RIB.
+ */
+typedef void (*bgp_select_fn)(void *arg, unsigned int shard,
+			      unsigned int shards);
+
+/* Selection threads including the main one, 1 with no workers */
+extern unsigned int bgp_select_shards(void);
+extern void bgp_select_run(bgp_select_fn fn, void *arg);
+
+/* Resize the pool to threads - 1 workers, none for 0 or 1 */
+extern void bgp_select_workers_set(unsigned int threads);
+
+#endif
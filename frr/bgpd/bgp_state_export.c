@@ -0,0 +1,196 @@
+/*
+ * BGP tables on the state export socket. A page ends on a destination
+ * boundary, so that the cursor, the prefix of the last destination sent,
+ * says all that is needed to go on from it.
+ */
+#include "zebra.h"
+
+#include "lib/state_export.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_twamp.h"
+#include "bgpd/bgp_state_export.h"
+
+DEFINE_MTYPE_STATIC(BGPD, BGP_STATE_EXPORT, "BGP state export page");
+
+struct bgp_state_path {
+	Mgmtd__BgpPathState msg;
+	uint8_t prefix[STATE_EXPORT_PREFIX_LEN];
+	uint8_t peer[IPV6_MAX_BYTELEN];
+	uint8_t nexthop[IPV6_MAX_BYTELEN];
+};
+
+static void bgp_state_path_fill(struct bgp_state_path *sp,
+				const struct bgp_dest *dest,
+				struct bgp_path_info *pi, time_t now)
+{
+	Mgmtd__BgpPathState *msg = &sp->msg;
+	const struct attr *attr = pi->attr;
+	const union sockunion *su = &pi->peer->connection->su;
+	uint32_t latency;
+
+	mgmtd__bgp_path_state__init(msg);
+	state_export_prefix(&msg->prefix, sp->prefix,
+			    bgp_dest_get_prefix(dest));
+
+	if (pi->peer != pi->peer->bgp->peer_self) {
+		if (su->sa.sa_family == AF_INET)
+			state_export_addr(&msg->peer, sp->peer, AF_INET,
+					  &su->sin.sin_addr);
+		else if (su->sa.sa_family == AF_INET6)
+			state_export_addr(&msg->peer, sp->peer, AF_INET6,
+					  &su->sin6.sin6_addr);
+	}
+
+	if (BGP_ATTR_NEXTHOP_AFI_IP6(attr))
+		state_export_addr(&msg->nexthop, sp->nexthop, AF_INET6,
+				  &attr->mp_nexthop_global);
+	else if (CHECK_FLAG(attr->flag, ATTR_FLAG_BIT(BGP_ATTR_NEXT_HOP)))
+		state_export_addr(&msg->nexthop, sp->nexthop, AF_INET,
+				  &attr->nexthop);
+	else
+		state_export_addr(&msg->nexthop, sp->nexthop, AF_INET,
+				  &attr->mp_nexthop_global_in);
+	msg->has_nexthop = true;
+
+	if (attr->aspath)
+		msg->as_path = (char *)aspath_print(attr->aspath);
+	if (CHECK_FLAG(attr->flag, ATTR_FLAG_BIT(BGP_ATTR_LOCAL_PREF))) {
+		msg->has_local_pref = true;
+		msg->local_pref = attr->local_pref;
+	}
+	if (CHECK_FLAG(attr->flag, ATTR_FLAG_BIT(BGP_ATTR_MULTI_EXIT_DISC))) {
+		msg->has_med = true;
+		msg->med = attr->med;
+	}
+	msg->origin = attr->origin;
+	msg->flags = pi->flags;
+
+	latency = bgp_twamp_path_latency(pi);
+	if (latency != UINT32_MAX) {
+		msg->has_latency_us = true;
+		msg->latency_us = latency;
+		msg->has_loss_permille = true;
+		msg->loss_permille = bgp_twamp_path_loss(pi);
+	}
+
+	if (CHECK_FLAG(pi->flags, BGP_PATH_SELECTED)) {
+		msg->has_best_reason = true;
+		msg->best_reason = dest->reason;
+		msg->best_reason_str =
+			(char *)bgp_path_selection_reason2str(dest->reason);
+	}
+
+	msg->uptime = now - pi->uptime;
+}
+
+static const char *bgp_state_export_table(const Mgmtd__StateExportReq *req,
+					  struct bgp_table **table)
+{
+	struct bgp *bgp;
+	afi_t afi = req->afi;
+	safi_t safi = req->safi;
+
+	bgp = req->vrf ? bgp_lookup_by_name(req->vrf) : bgp_get_default();
+	if (!bgp)
+		return "No such BGP instance";
+
+	/* Flat, IP prefixed tables only: no RD level, no flowspec */
+	if ((afi != AFI_IP && afi != AFI_IP6) ||
+	    (safi != SAFI_UNICAST && safi != SAFI_MULTICAST &&
+	     safi != SAFI_LABELED_UNICAST))
+		return "Address family not exported";
+
+	*table = bgp->rib[afi][safi];
+	return NULL;
+}
+
+static void bgp_state_export(struct msg_conn *conn,
+			     const Mgmtd__StateExportReq *req)
+{
+	Mgmtd__StateExportReply reply;
+	struct bgp_state_path *paths;
+	Mgmtd__BgpPathState **msgs;
+	struct bgp_table *table;
+	struct bgp_dest *dest;
+	struct bgp_path_info *pi;
+	struct prefix cursor;
+	uint8_t next[STATE_EXPORT_PREFIX_LEN];
+	unsigned int max, cap, n = 0, count, i;
+	const char *error;
+	time_t now = monotime(NULL);
+
+	if (req->table != MGMTD__STATE_TABLE__BGP_PATHS) {
+		state_export_error(conn, req, "Table not exported by bgpd");
+		return;
+	}
+	error = bgp_state_export_table(req, &table);
+	if (error) {
+		state_export_error(conn, req, error);
+		return;
+	}
+
+	mgmtd__state_export_reply__init(&reply);
+	reply.req_id = req->req_id;
+	reply.success = true;
+
+	cap = max = state_export_page_size(req);
+	paths = XCALLOC(MTYPE_BGP_STATE_EXPORT, cap * sizeof(*paths));
+
+	if (state_export_cursor(req, afi2family(table->afi), &cursor))
+		dest = bgp_table_get_next(table, &cursor);
+	else
+		dest = bgp_table_top(table);
+
+	for (; dest; dest = bgp_route_next(dest)) {
+		count = 0;
+		for (pi = bgp_dest_get_bgp_path_info(dest); pi; pi = pi->next)
+			count++;
+		if (!count)
+			continue;
+
+		if (n + count > max) {
+			if (n) {
+				bgp_dest_unlock_node(dest);
+				break;
+			}
+			/* More paths than a page: send them all the same */
+			cap = count;
+			paths = XREALLOC(MTYPE_BGP_STATE_EXPORT, paths,
+					 cap * sizeof(*paths));
+		}
+
+		for (pi = bgp_dest_get_bgp_path_info(dest); pi; pi = pi->next)
+			bgp_state_path_fill(&paths[n++], dest, pi, now);
+		state_export_prefix(&reply.next_cursor, next,
+				    bgp_dest_get_prefix(dest));
+	}
+	/* Stopped short of the end */
+	reply.has_next_cursor = dest != NULL;
+
+	msgs = XCALLOC(MTYPE_BGP_STATE_EXPORT, (n ? n : 1) * sizeof(*msgs));
+	for (i = 0; i < n; i++)
+		msgs[i] = &paths[i].msg;
+	reply.n_bgp_paths = n;
+	reply.bgp_paths = msgs;
+
+	if (state_export_reply(conn, &reply))
+		zlog_warn("%s: failed to send a page of %u paths", __func__, n);
+
+	XFREE(MTYPE_BGP_STATE_EXPORT, msgs);
+	XFREE(MTYPE_BGP_STATE_EXPORT, paths);
+}
+
+void bgp_state_export_init(void)
+{
+	state_export_init(bm->master, bgp_state_export);
+}
+
+void bgp_state_export_finish(void)
+{
+	state_export_fini();
+}
@@ -0,0 +1,12 @@
+#ifndef _BGP_STATE_EXPORT_H
+#define _BGP_STATE_EXPORT_H
+
+/*
+ * Paged dumps of the BGP tables for collectors, one BgpPathState per path
+ * with its latency and, on the best path, why it won. See state_export.h.
+ */
+
+extern void bgp_state_export_init(void);
+extern void bgp_state_export_finish(void);
+
+#endif
@@ -17,6 +17,12 @@
 #include "bgpd/bgp_table.h"
 #include "bgp_addpath.h"
 #include "bgp_trace.h"
+#include "bgp_nhg.h"
+
+struct bgp_arena bgp_rnode_arena =
+	BGP_ARENA_INIT(MTYPE_ROUTE_NODE, struct route_node);
+struct bgp_arena bgp_dest_arena =
+	BGP_ARENA_INIT(MTYPE_BGP_NODE, struct bgp_dest);
 
 void bgp_table_lock(struct bgp_table *rt)
 {
@@ -88,7 +94,7 @@ inline struct bgp_dest *bgp_dest_unlock_node(struct bgp_dest *dest)
 						   &dest->tx_addpath, rt->afi,
 						   rt->safi);
 		}
-		XFREE(MTYPE_BGP_NODE, dest);
+		bgp_arena_free(&bgp_dest_arena, dest);
 		dest = NULL;
 		rn->info = NULL;
 	}
@@ -113,18 +119,29 @@ static void bgp_node_destroy(route_table_delegate_t *delegate,
 										&dest->tx_addpath,
 										rt->afi, rt->safi);
 		}
-		XFREE(MTYPE_BGP_NODE, dest);
+		/* Left on a nexthop group if never withdrawn, as on shutdown */
+		bgp_nhg_route_uninstall(dest);
+		bgp_arena_free(&bgp_dest_arena, dest);
 		node->info = NULL;
 	}
 
-	XFREE(MTYPE_ROUTE_NODE, node);
+	bgp_arena_free(&bgp_rnode_arena, node);
+}
+
+/*
+ * bgp_node_create
+ */
+static struct route_node *bgp_node_create(route_table_delegate_t *delegate,
+					  struct route_table *table)
+{
+	return bgp_arena_alloc(&bgp_rnode_arena);
 }
 
 /*
  * Function vector to customize the behavior of the route table
  * library for BGP route tables.
  */
-route_table_delegate_t bgp_table_delegate = { .create_node = route_node_create,
+route_table_delegate_t bgp_table_delegate = { .create_node = bgp_node_create,
 					      .destroy_node = bgp_node_destroy };
 
 /*
@@ -228,6 +245,60 @@ struct bgp_dest *bgp_table_subtree_lookup(const struct bgp_table *table,
 	return matched;
 }
 
+static void bgp_dest_batch_release(struct bgp_dest_batch *batch)
+{
+	unsigned int i;
+
+	for (i = 0; i < batch->count; i++)
+		bgp_dest_unlock_node(batch->dests[i]);
+	batch->count = 0;
+	batch->at = 0;
+}
+
+struct bgp_dest *bgp_dest_batch_fill(struct bgp_dest_batch *batch)
+{
+	struct route_node *rn;
+	unsigned int i;
+
+	bgp_dest_batch_release(batch);
+
+	while (batch->walk && batch->count < BGP_DEST_BATCH) {
+		rn = batch->walk;
+		if (rn->info) {
+			batch->dests[batch->count++] = bgp_dest_lock_node(
+				bgp_dest_from_rnode(rn));
+			__builtin_prefetch(rn->info);
+		}
+		batch->walk = route_next(rn);
+	}
+
+	/* The dests should have arrived by now; go for what they point at */
+	for (i = 0; i < batch->count; i++) {
+		__builtin_prefetch(batch->dests[i]->info);
+		__builtin_prefetch(batch->dests[i]->adj_in);
+	}
+
+	return batch->count ? batch->dests[0] : NULL;
+}
+
+struct bgp_dest *bgp_dest_batch_first(struct bgp_dest_batch *batch,
+				      const struct bgp_table *table)
+{
+	batch->walk = route_top(table->route_table);
+	batch->count = 0;
+	batch->at = 0;
+	return bgp_dest_batch_fill(batch);
+}
+
+void bgp_dest_batch_done(struct bgp_dest_batch *batch)
+{
+	bgp_dest_batch_release(batch);
+	if (batch->walk) {
+		route_unlock_node(batch->walk);
+		batch->walk = NULL;
+	}
+}
+
 printfrr_ext_autoreg_p("BD", printfrr_bd);
 static ssize_t printfrr_bd(struct fbuf *buf, struct printfrr_eargs *ea,
 			   const void *ptr)
@@ -12,6 +12,7 @@
 #include "linklist.h"
 #include "bgpd.h"
 #include "bgp_advertise.h"
+#include "bgp_arena.h"
 
 struct bgp_table {
 	/* table belongs to this instance */
@@ -42,6 +43,8 @@ enum bgp_path_selection_reason {
 	bgp_path_selection_evpn_local_path,
 	bgp_path_selection_evpn_non_proxy,
 	bgp_path_selection_evpn_lower_ip,
+	bgp_path_selection_loss,
+	bgp_path_selection_latency,
 	bgp_path_selection_weight,
 	bgp_path_selection_local_pref,
 	bgp_path_selection_accept_own,
@@ -69,6 +72,7 @@ struct bgp_dest {
 	void *info;
 
 	struct bgp_adj_out_rb adj_out;
+	struct bgp_adj_out_set *adj_out_sets;
 
 	struct bgp_adj_in *adj_in;
 
@@ -91,10 +95,19 @@ struct bgp_dest {
 #define BGP_NODE_LABEL_REQUESTED        (1 << 7)
 #define BGP_NODE_SOFT_RECONFIG (1 << 8)
 #define BGP_NODE_PROCESS_CLEAR (1 << 9)
+/* Best path picked on the worker pool, see bgp_select_batch_pick() */
+#define BGP_NODE_PRESELECTED (1 << 10)
 
 	struct bgp_addpath_node_data tx_addpath;
 
 	enum bgp_path_selection_reason reason;
+
+	/* Nexthop group installed with, see bgp_nhg.c */
+	struct bgp_nhg *nhg;
+
+	/* Latency nexthop group installed with, see bgp_twamp_nhg.c */
+	uint32_t twamp_nhg_id;
+	uint32_t twamp_nhg_key;
 };
 
 extern void bgp_delete_listnode(struct bgp_dest *dest);
@@ -108,6 +121,13 @@ typedef struct bgp_table_iter_t_ {
 	route_table_iter_t rt_iter;
 } bgp_table_iter_t;
 
+/*
+ * The route_nodes of BGP tables, and the dests hanging off them, are
+ * carved from arenas rather than allocated one by one.
+ */
+extern struct bgp_arena bgp_rnode_arena;
+extern struct bgp_arena bgp_dest_arena;
+
 extern struct bgp_table *bgp_table_init(struct bgp *bgp, afi_t, safi_t);
 extern void bgp_table_lock(struct bgp_table *);
 extern void bgp_table_unlock(struct bgp_table *);
@@ -227,6 +247,44 @@ static inline struct bgp_dest *bgp_route_next_until(struct bgp_dest *dest,
 	return bgp_dest_from_rnode(rnode);
 }
 
+/*
+ * Walking a table a block of dests at a time. Each block is gathered in
+ * one go and the dests, their paths and adj-ins are prefetched, so the
+ * caller works on data that is in cache while the trie is chased in bulk.
+ *
+ *	struct bgp_dest_batch batch;
+ *
+ *	for (dest = bgp_dest_batch_first(&batch, table); dest;
+ *	     dest = bgp_dest_batch_next(&batch))
+ *
+ * The dests of the block at hand are locked, so the caller may strip them
+ * as with bgp_route_next(). Leaving the loop early needs a
+ * bgp_dest_batch_done(). Dests added to the table while a block is out
+ * may not be seen.
+ */
+#define BGP_DEST_BATCH 32
+
+struct bgp_dest_batch {
+	/* Where the walk stands, locked; NULL past the end */
+	struct route_node *walk;
+
+	unsigned int count;
+	unsigned int at;
+	struct bgp_dest *dests[BGP_DEST_BATCH];
+};
+
+extern struct bgp_dest *bgp_dest_batch_first(struct bgp_dest_batch *batch,
+					     const struct bgp_table *table);
+extern struct bgp_dest *bgp_dest_batch_fill(struct bgp_dest_batch *batch);
+extern void bgp_dest_batch_done(struct bgp_dest_batch *batch);
+
+static inline struct bgp_dest *bgp_dest_batch_next(struct bgp_dest_batch *batch)
+{
+	if (++batch->at < batch->count)
+		return batch->dests[batch->at];
+	return bgp_dest_batch_fill(batch);
+}
+
 /*
  * bgp_node_get
  */
@@ -236,8 +294,7 @@ static inline struct bgp_dest *bgp_node_get(struct bgp_table *const table,
 	struct route_node *rn = route_node_get(table->route_table, p);
 
 	if (!rn->info) {
-		struct bgp_dest *dest = XCALLOC(MTYPE_BGP_NODE,
-						sizeof(struct bgp_dest));
+		struct bgp_dest *dest = bgp_arena_alloc(&bgp_dest_arena);
 
 		RB_INIT(bgp_adj_out_rb, &dest->adj_out);
 		rn->info = dest;
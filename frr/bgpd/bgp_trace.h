@@ -613,6 +613,156 @@ TRACEPOINT_EVENT(
 	)
 )
 TRACEPOINT_LOGLEVEL(frr_bgp, evpn_local_l3vni_del_zrecv, TRACE_INFO)
+
+/*
+ * TWAMP latency: bestpath decisions, vrf import weights, agent updates
+ * and loss-triggered reroutes
+ */
+TRACEPOINT_EVENT(
+	frr_bgp,
+	twamp_bestpath,
+	TP_ARGS(struct bgp_path_info *, new, uint32_t, new_latency,
+		uint32_t, exist_latency, uint32_t, margin, bool, win),
+	TP_FIELDS(
+		ctf_string(prefix, bgp_dest_get_prefix_str(new->net))
+		ctf_string(peer, PEER_HOSTNAME(new->peer))
+		ctf_integer(uint32_t, new_latency_us, new_latency)
+		ctf_integer(uint32_t, exist_latency_us, exist_latency)
+		ctf_integer(uint32_t, margin_us, margin)
+		ctf_string(result, win ? "win" : "lose")
+	)
+)
+TRACEPOINT_LOGLEVEL(frr_bgp, twamp_bestpath, TRACE_INFO)
+
+TRACEPOINT_EVENT(
+	frr_bgp,
+	twamp_import_weight,
+	TP_ARGS(struct bgp *, bgp, const struct prefix *, pfx,
+		uint32_t, latency, uint32_t, weight),
+	TP_FIELDS(
+		ctf_string(vrf, bgp->name_pretty)
+		ctf_array(unsigned char, prefix, pfx, sizeof(struct prefix))
+		ctf_integer(uint32_t, latency_us, latency)
+		ctf_integer(uint32_t, weight, weight)
+	)
+)
+TRACEPOINT_LOGLEVEL(frr_bgp, twamp_import_weight, TRACE_INFO)
+
+TRACEPOINT_EVENT(
+	frr_bgp,
+	twamp_measurements,
+	TP_ARGS(uint32_t, sequence, bool, dirty, unsigned int, changed),
+	TP_FIELDS(
+		ctf_integer(uint32_t, sequence, sequence)
+		ctf_string(dirty, dirty ? "y" : "n")
+		ctf_integer(unsigned int, changed, changed)
+	)
+)
+TRACEPOINT_LOGLEVEL(frr_bgp, twamp_measurements, TRACE_DEBUG)
+
+TRACEPOINT_EVENT(
+	frr_bgp,
+	twamp_nexthop_sync,
+	TP_ARGS(unsigned int, added, unsigned int, removed,
+		unsigned int, monitored),
+	TP_FIELDS(
+		ctf_integer(unsigned int, added, added)
+		ctf_integer(unsigned int, removed, removed)
+		ctf_integer(unsigned int, monitored, monitored)
+	)
+)
+TRACEPOINT_LOGLEVEL(frr_bgp, twamp_nexthop_sync, TRACE_INFO)
+
+TRACEPOINT_EVENT(
+	frr_bgp,
+	twamp_loss_reroute,
+	TP_ARGS(const struct prefix *, nexthop, uint16_t, from, uint16_t, to),
+	TP_FIELDS(
+		ctf_array(unsigned char, nexthop, nexthop,
+			  sizeof(struct prefix))
+		ctf_integer(uint16_t, from_loss_permille, from)
+		ctf_integer(uint16_t, to_loss_permille, to)
+	)
+)
+TRACEPOINT_LOGLEVEL(frr_bgp, twamp_loss_reroute, TRACE_INFO)
+
+/*
+ * Convergence of the latency path, see tools/frr_twamp_convergence.py:
+ * a nexthop read from the segment, its latency moving, the re-evaluation
+ * pass that follows, the VPN routes it re-imports and the best paths it
+ * flips.
+ */
+TRACEPOINT_EVENT(
+	frr_bgp,
+	twamp_latency_read,
+	TP_ARGS(const struct prefix *, nexthop, uint32_t, vrf_ifindex,
+		uint32_t, latency, uint16_t, loss, int64_t, updated),
+	TP_FIELDS(
+		ctf_array(unsigned char, nexthop, nexthop,
+			  sizeof(struct prefix))
+		ctf_integer(uint32_t, vrf_ifindex, vrf_ifindex)
+		ctf_integer(uint32_t, latency_us, latency)
+		ctf_integer(uint16_t, loss_permille, loss)
+		ctf_integer(int64_t, updated, updated)
+	)
+)
+TRACEPOINT_LOGLEVEL(frr_bgp, twamp_latency_read, TRACE_DEBUG)
+
+TRACEPOINT_EVENT(
+	frr_bgp,
+	twamp_latency_change,
+	TP_ARGS(struct bgp *, bgp, const struct prefix *, nexthop,
+		uint32_t, from, uint32_t, to),
+	TP_FIELDS(
+		ctf_string(vrf, bgp->name_pretty)
+		ctf_array(unsigned char, nexthop, nexthop,
+			  sizeof(struct prefix))
+		ctf_integer(uint32_t, from_latency_us, from)
+		ctf_integer(uint32_t, to_latency_us, to)
+	)
+)
+TRACEPOINT_LOGLEVEL(frr_bgp, twamp_latency_change, TRACE_INFO)
+
+TRACEPOINT_EVENT(
+	frr_bgp,
+	twamp_reevaluate,
+	TP_ARGS(unsigned int, paths, unsigned int, dests, int64_t, elapsed),
+	TP_FIELDS(
+		ctf_integer(unsigned int, paths, paths)
+		ctf_integer(unsigned int, dests, dests)
+		ctf_integer(int64_t, elapsed_us, elapsed)
+	)
+)
+TRACEPOINT_LOGLEVEL(frr_bgp, twamp_reevaluate, TRACE_INFO)
+
+TRACEPOINT_EVENT(
+	frr_bgp,
+	vpn_leak_reimport,
+	TP_ARGS(struct bgp *, from, struct bgp *, to, struct bgp_dest *, dest),
+	TP_FIELDS(
+		ctf_string(from_vrf, from->name_pretty)
+		ctf_string(to_vrf, to->name_pretty)
+		ctf_string(prefix, bgp_dest_get_prefix_str(dest))
+	)
+)
+TRACEPOINT_LOGLEVEL(frr_bgp, vpn_leak_reimport, TRACE_INFO)
+
+TRACEPOINT_EVENT(
+	frr_bgp,
+	bestpath_flip,
+	TP_ARGS(struct bgp *, bgp, struct bgp_dest *, dest,
+		struct bgp_path_info *, old, struct bgp_path_info *, new),
+	TP_FIELDS(
+		ctf_string(vrf, bgp->name_pretty)
+		ctf_string(prefix, bgp_dest_get_prefix_str(dest))
+		ctf_string(old_peer, PEER_HOSTNAME(old->peer))
+		ctf_string(new_peer, PEER_HOSTNAME(new->peer))
+		ctf_string(reason,
+			   bgp_path_selection_reason2str(dest->reason))
+	)
+)
+TRACEPOINT_LOGLEVEL(frr_bgp, bestpath_flip, TRACE_INFO)
+
 /* clang-format on */
 
 #include <lttng/tracepoint-event.h>
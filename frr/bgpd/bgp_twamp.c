@@ -1,320 +1,2961 @@
 #include "zebra.h"
+#include <math.h>
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_nexthop.h"
+#include "bgpd/bgp_mplsvpn.h"
+#include "bgpd/bgp_ecommunity.h"
+#include "bgpd/bgp_damp.h"
+#include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_trace.h"
+#include "bgpd/bgp_zebra.h"
+#include "bfd.h"
+#include "json.h"
 #include "log.h"
-#include "bgp_twamp_ipc.h"
+#include "network.h"
+#include "ringbuf.h"
+#include "sockunion.h"
+#include "vty.h"
+#include "bgpd/bgp_twamp.h"
+#include "bgpd/bgp_twamp_ted.h"
+#include "bgpd/bgp_twamp_nhg.h"
+#include "bgpd/bgp_twamp_egress.h"
 
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <errno.h>
 #include <string.h>
 
-/* Global shared memory pointer */
+DEFINE_MGROUP(BGP_TWAMP, "BGP latency");
+DEFINE_MTYPE(BGP_TWAMP, BGP_TWAMP_SLOTS, "BGP latency slot bitmap");
+DEFINE_MTYPE(BGP_TWAMP, BGP_TWAMP_SHOW, "BGP latency show snapshot");
+DEFINE_MTYPE_STATIC(BGP_TWAMP, BGP_TWAMP_TARGETS, "BGP latency probe targets");
+DEFINE_MTYPE_STATIC(BGP_TWAMP, BGP_TWAMP_REEVAL, "BGP latency re-evaluation");
+
+/*
+ * Global shared memory pointer. There is one segment for all instances,
+ * each enabled instance holding a reference (bgp->twamp_attached), so a
+ * nexthop several VRFs rely on is probed once.
+ */
 static struct twamp_shm *shm = NULL;
+static size_t shm_size;
+static unsigned int shm_refs;
+/* bgpd-private snapshot of the dirty bitmap, sized for shm's capacity */
+static uint64_t *dirty_snap;
+/* bgpd-private: free slots below nh_count, one bit per slot */
+static uint64_t *free_map;
+/* Removed buckets in shm's index, rebuilt once they are a quarter of it */
+static uint32_t index_tombstones;
+/*
+ * Slots carried over from the segment of a previous bgpd that no nexthop
+ * has claimed yet. They are kept, measurements and all, until the restart
+ * hold ends, so the routes coming back find them; see
+ * bgp_twamp_shm_adopt(). Measurements older than shm_adopted are stale
+ * but still used.
+ */
+static uint64_t *restored_map;
+static time_t shm_adopted;
+static struct event *restore_ev;
+/* Nexthops with a measurement waiting on dwell time or hold-down */
+static unsigned int pending_nexthops;
+static struct event *collect_ev;
+/* Closes the window changed nexthops are merged over, see below */
+static struct event *reevaluate_ev;
 static struct event *measurement_check_timer = NULL;
-static uint32_t last_sequence = 0;
+/* A re-evaluation pass, done up to next when it ran out of time */
+static struct {
+	struct bgp_path_info **paths;
+	unsigned int count, alloc, next, dests;
+	struct bgp_dest *last;
+	/* When the pass began, for tracing */
+	struct timeval started;
+} reeval;
+
+/* Calls of one handler and the time they spent on the event loop */
+struct bgp_twamp_timing {
+	uint64_t runs;
+	uint64_t total_us, max_us;
+};
+
+/*
+ * What the feature costs, for "show bgp twamp statistics". The paths
+ * it flipped are counted per instance, see twamp_latency_changes.
+ */
+static struct {
+	/* Checks that found new measurements, and nexthops that moved */
+	uint64_t rounds, nexthops_changed, egress_changed;
+	/* Completed re-evaluation passes and what they went over */
+	uint64_t passes, paths, dests, reimports;
+	/* Longest pass from start to end, yields included */
+	uint64_t pass_max_us;
+	struct bgp_twamp_timing refresh, reevaluate, collect;
+} stats;
+
+static void bgp_twamp_timing_add(struct bgp_twamp_timing *timing,
+				 const struct timeval *start)
+{
+	uint64_t us = monotime_since(start, NULL);
+
+	timing->runs++;
+	timing->total_us += us;
+	timing->max_us = MAX(timing->max_us, us);
+}
 
 /* Forward declaration */
 static void bgp_twamp_check_measurements(struct event *thread);
+static void bgp_twamp_schedule_collect(void);
+static void bgp_twamp_index_rebuild(void);
 static int shm_fd = -1;
 
+/*
+ * Agents signal notify_fd (an eventfd) after each batch, and get hold of it
+ * by connecting to notify_sock. The timer stays as a fallback and only
+ * polls quickly if the notification channel could not be set up.
+ */
+#define BGP_TWAMP_POLL_INTERVAL 5
+#define BGP_TWAMP_FALLBACK_INTERVAL 60
+
+/*
+ * A bigger segment is built under a name of its own and renamed over
+ * TWAMP_SHM_NAME once complete; renaming goes through the directory
+ * shm_open() keeps its objects in
+ */
+#define BGP_TWAMP_SHM_DIR "/dev/shm"
+#define BGP_TWAMP_SHM_NEW_NAME TWAMP_SHM_NAME ".new"
+
+static int notify_fd = -1;
+static int notify_sock = -1;
+static struct event *notify_read_ev;
+static struct event *notify_accept_ev;
+
+static void bgp_twamp_schedule_check(void)
+{
+	event_add_timer(bm->master, bgp_twamp_check_measurements, NULL,
+			notify_fd >= 0 ? BGP_TWAMP_FALLBACK_INTERVAL
+				       : BGP_TWAMP_POLL_INTERVAL,
+			&measurement_check_timer);
+}
+
+/* Hand notify_fd to a connecting agent and hang up */
+static void bgp_twamp_notify_accept(struct event *thread)
+{
+	uint8_t byte = 0;
+	struct iovec iov = { .iov_base = &byte, .iov_len = sizeof(byte) };
+	union {
+		uint8_t buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} u;
+	struct msghdr mh = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = u.buf,
+		.msg_controllen = sizeof(u.buf),
+	};
+	struct cmsghdr *cmh;
+	int fd;
+
+	event_add_read(bm->master, bgp_twamp_notify_accept, NULL, notify_sock,
+		       &notify_accept_ev);
+
+	fd = accept(notify_sock, NULL, NULL);
+	if (fd < 0) {
+		if (!ERRNO_IO_RETRY(errno))
+			zlog_warn("BGP TWAMP: notify accept failed: %s",
+				  safe_strerror(errno));
+		return;
+	}
+
+	memset(&u.buf, 0, sizeof(u.buf));
+	cmh = CMSG_FIRSTHDR(&mh);
+	cmh->cmsg_level = SOL_SOCKET;
+	cmh->cmsg_type = SCM_RIGHTS;
+	cmh->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmh), &notify_fd, sizeof(int));
+
+	if (sendmsg(fd, &mh, MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+		zlog_warn("BGP TWAMP: failed to pass notify fd to agent: %s",
+			  safe_strerror(errno));
+	close(fd);
+}
+
+/* An agent published a batch */
+static void bgp_twamp_notify_read(struct event *thread)
+{
+	uint64_t count;
+
+	event_add_read(bm->master, bgp_twamp_notify_read, NULL, notify_fd,
+		       &notify_read_ev);
+
+	if (read(notify_fd, &count, sizeof(count)) != sizeof(count))
+		return;
+
+	/* Run the check now, it reschedules the fallback timer itself */
+	EVENT_OFF(measurement_check_timer);
+	event_execute(bm->master, bgp_twamp_check_measurements, NULL, 0, NULL);
+}
+
+static void bgp_twamp_notify_fini(void)
+{
+	EVENT_OFF(notify_read_ev);
+	EVENT_OFF(notify_accept_ev);
+
+	if (notify_sock >= 0) {
+		close(notify_sock);
+		notify_sock = -1;
+	}
+	if (notify_fd >= 0) {
+		close(notify_fd);
+		notify_fd = -1;
+	}
+}
+
+static void bgp_twamp_notify_init(void)
+{
+	struct sockaddr_un sa = { .sun_family = AF_UNIX };
+	socklen_t len;
+
+	if (notify_fd >= 0)
+		return;
+
+	notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (notify_fd < 0) {
+		zlog_warn("BGP TWAMP: eventfd failed, polling every %ds: %s",
+			  BGP_TWAMP_POLL_INTERVAL, safe_strerror(errno));
+		return;
+	}
+
+	/* Abstract namespace: leading NUL, nothing to unlink on exit */
+	strlcpy(sa.sun_path + 1, TWAMP_NOTIFY_SOCK, sizeof(sa.sun_path) - 1);
+	len = offsetof(struct sockaddr_un, sun_path) + 1 +
+	      strlen(TWAMP_NOTIFY_SOCK);
+
+	notify_sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (notify_sock < 0 || bind(notify_sock, (struct sockaddr *)&sa, len) ||
+	    listen(notify_sock, 8)) {
+		zlog_warn("BGP TWAMP: notify socket setup failed, polling every %ds: %s",
+			  BGP_TWAMP_POLL_INTERVAL, safe_strerror(errno));
+		bgp_twamp_notify_fini();
+		return;
+	}
+	set_nonblocking(notify_sock);
+	set_cloexec(notify_sock);
+
+	event_add_read(bm->master, bgp_twamp_notify_accept, NULL, notify_sock,
+		       &notify_accept_ev);
+	event_add_read(bm->master, bgp_twamp_notify_read, NULL, notify_fd,
+		       &notify_read_ev);
+}
+
+/*
+ * Take whatever segment is currently published under TWAMP_SHM_NAME out of
+ * service: agents still mapping it are told to re-open (or, for a layout
+ * they cannot parse anyway, lose the magic), and the name is freed.
+ */
+static void bgp_twamp_shm_retire_stale(void)
+{
+	struct twamp_shm *old;
+	struct stat st;
+	int fd;
+
+	fd = shm_open(TWAMP_SHM_NAME, O_RDWR, 0);
+	if (fd < 0)
+		return;
+
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(*old)) {
+		old = mmap(NULL, sizeof(*old), PROT_READ | PROT_WRITE,
+			   MAP_SHARED, fd, 0);
+		if (old != MAP_FAILED) {
+			if (old->hdr.magic == TWAMP_SHM_MAGIC &&
+			    old->hdr.version == TWAMP_SHM_VERSION)
+				__atomic_fetch_or(&old->hdr.flags,
+						  TWAMP_SHM_F_SUPERSEDED,
+						  __ATOMIC_RELEASE);
+			else
+				__atomic_store_n(&old->hdr.magic, 0,
+						 __ATOMIC_RELEASE);
+			munmap(old, sizeof(*old));
+		}
+	}
+	close(fd);
+	shm_unlink(TWAMP_SHM_NAME);
+}
+
+/*
+ * Create and map an empty segment for capacity entries under name, which
+ * must be free. The header is left unpublished: the caller fills the
+ * segment and then calls twamp_shm_hdr_init().
+ */
+static struct twamp_shm *bgp_twamp_shm_create(const char *name,
+					      uint32_t capacity, int *fdp,
+					      size_t *sizep)
+{
+	struct twamp_shm_hdr layout;
+	struct twamp_shm *seg;
+	pthread_mutexattr_t attr;
+	int fd;
+
+	twamp_shm_layout(&layout, capacity);
+
+	fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
+	if (fd == -1) {
+		zlog_err("BGP TWAMP: Failed to create shared memory: %s",
+			 safe_strerror(errno));
+		return NULL;
+	}
+
+	/* A fresh object reads as zeroes, which is a valid empty table */
+	if (ftruncate(fd, layout.total_size) == -1) {
+		zlog_err("BGP TWAMP: Failed to size shared memory: %s",
+			 safe_strerror(errno));
+		goto fail;
+	}
+
+	seg = mmap(NULL, layout.total_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   fd, 0);
+	if (seg == MAP_FAILED) {
+		zlog_err("BGP TWAMP: Failed to map shared memory: %s",
+			 safe_strerror(errno));
+		goto fail;
+	}
+
+	/*
+	 * Writer-side mutex for measurement agents.  bgpd itself never takes
+	 * it; it is robust so an agent dying while holding it cannot wedge
+	 * the next.
+	 */
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(&seg->writer_lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	/* Accessors work off the offsets, so lay them out before use */
+	seg->hdr = layout;
+	seg->hdr.magic = 0;
+	seg->hdr.flags = 0;
+
+	*fdp = fd;
+	*sizep = layout.total_size;
+	return seg;
+
+fail:
+	close(fd);
+	shm_unlink(name);
+	return NULL;
+}
+
+static void bgp_twamp_restore_end(struct event *thread)
+{
+	uint32_t words = TWAMP_DIRTY_WORDS(shm->hdr.capacity), w, n = 0;
+
+	for (w = 0; w < words; w++)
+		n += __builtin_popcountll(restored_map[w]);
+	memset(restored_map, 0, words * sizeof(uint64_t));
+
+	zlog_info("BGP TWAMP: Restart hold over, releasing %u unclaimed nexthops",
+		  n);
+	bgp_twamp_schedule_collect();
+}
+
+/*
+ * Take over the segment a previous bgpd left behind, if its layout is
+ * this build's. Slots, epochs and measurements stay as they are, so
+ * running agents carry on publishing into it and nexthops coming back
+ * after the restart have a latency before their first best-path run.
+ * The carried slots are held for the restart: the graceful restart
+ * selection deferral if bgp is restarting gracefully, else its restart
+ * time, which is as long as peers keep our routes.
+ */
+static bool bgp_twamp_shm_adopt(struct bgp *bgp)
+{
+	struct twamp_shm *seg;
+	struct stat st;
+	const char *why;
+	uint32_t words, count, kept = 0, i, hold;
+	int fd;
+
+	fd = shm_open(TWAMP_SHM_NAME, O_RDWR, 0);
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(*seg)) {
+		close(fd);
+		return false;
+	}
+
+	seg = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (seg == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	why = twamp_shm_hdr_check(seg, st.st_size);
+	if (!why && twamp_shm_superseded(seg))
+		why = "superseded";
+	if (why) {
+		zlog_info("BGP TWAMP: Not reusing the previous shared memory: %s",
+			  why);
+		munmap(seg, st.st_size);
+		close(fd);
+		return false;
+	}
+
+	shm = seg;
+	shm_fd = fd;
+	shm_size = st.st_size;
+
+	words = TWAMP_DIRTY_WORDS(seg->hdr.capacity);
+	dirty_snap = XCALLOC(MTYPE_BGP_TWAMP_SLOTS, words * sizeof(uint64_t));
+	free_map = XCALLOC(MTYPE_BGP_TWAMP_SLOTS, words * sizeof(uint64_t));
+	restored_map = XCALLOC(MTYPE_BGP_TWAMP_SLOTS,
+			       words * sizeof(uint64_t));
+
+	/* Left odd by a bgpd that died mid-update, ended by the rebuild */
+	if (!(seg->nh_gen & 1))
+		twamp_seq_write_begin(&seg->nh_gen);
+
+	count = MIN(seg->nh_count, seg->hdr.capacity);
+	while (count > 0 && !twamp_shm_nexthops(seg)[count - 1].active)
+		count--;
+	for (i = 0; i < count; i++) {
+		if (twamp_shm_nexthops(seg)[i].active) {
+			restored_map[i / 64] |= 1ULL << (i % 64);
+			kept++;
+		} else
+			free_map[i / 64] |= 1ULL << (i % 64);
+	}
+	__atomic_store_n(&seg->nh_count, count, __ATOMIC_RELEASE);
+	bgp_twamp_index_rebuild();
+
+	twamp_seq_write_end(&seg->nh_gen);
+
+	shm_adopted = time(NULL);
+	hold = bgp_global_gr_mode_get(bgp) == GLOBAL_GR ? bgp->select_defer_time
+							: bgp->restart_time;
+	if (kept)
+		event_add_timer(bm->master, bgp_twamp_restore_end, NULL, hold,
+				&restore_ev);
+
+	zlog_info("BGP TWAMP: Reusing shared memory at %s (%u slots), holding %u nexthops for %us",
+		  TWAMP_SHM_NAME, seg->hdr.capacity, kept, hold);
+	return true;
+}
+
 /* Initialize shared memory */
 void bgp_twamp_init(struct bgp *bgp)
 {
-    fprintf(stderr, "*** bgp_twamp_init CALLED, enabled=%d\n", bgp->import_latency_cfg.enabled); fflush(stderr);
-    pthread_mutexattr_t attr;
+    uint32_t capacity;
     
     if (!bgp->import_latency_cfg.enabled) {
         zlog_info("BGP TWAMP: Not enabled, skipping initialization");
         return;
     }
+
+    if (!bgp->twamp_attached) {
+        bgp->twamp_attached = true;
+        shm_refs++;
+    }
     
     /* Check if already initialized */
     if (shm != NULL) {
-        zlog_info("BGP TWAMP: Already initialized, collecting next-hops");
+        if (BGP_DEBUG(twamp, TWAMP))
+            zlog_debug("BGP TWAMP: Already initialized, collecting next-hops for %s",
+                       bgp->name_pretty);
         bgp_twamp_collect_nexthops(bgp);
 
-	/* Start periodic measurement check timer */
-	event_add_timer(bm->master, bgp_twamp_check_measurements, bgp, 5, &measurement_check_timer);
-	fprintf(stderr, "*** TWAMP: Started measurement check timer\n"); fflush(stderr);
-        return;
-    }
-    
-    /* Create/open shared memory */
-    shm_fd = shm_open(TWAMP_SHM_NAME, O_CREAT | O_RDWR, 0666);
-    if (shm_fd == -1) {
-        zlog_err("BGP TWAMP: Failed to create shared memory: %s", 
-                 strerror(errno));
+	/* Wait for agent notifications, with a slow poll as fallback */
+	bgp_twamp_notify_init();
+	bgp_twamp_schedule_check();
         return;
     }
     
-    /* Size it */
-    if (ftruncate(shm_fd, sizeof(struct twamp_shm)) == -1) {
-        zlog_err("BGP TWAMP: Failed to size shared memory: %s", 
-                 strerror(errno));
-        close(shm_fd);
-        shm_fd = -1;
+    /* Measurements survive a restart in the previous bgpd's segment */
+    if (bgp_twamp_shm_adopt(bgp)) {
+        bgp_twamp_collect_nexthops(bgp);
+        bgp_twamp_notify_init();
+        bgp_twamp_schedule_check();
         return;
     }
-    
-    /* Map it */
-    shm = mmap(NULL, sizeof(struct twamp_shm), 
-               PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    
-    if (shm == MAP_FAILED) {
-        zlog_err("BGP TWAMP: Failed to map shared memory: %s", 
-                 strerror(errno));
-        close(shm_fd);
-        shm_fd = -1;
-        shm = NULL;
+
+    capacity = twamp_capacity_for(listcount(bgp->peer) * 2);
+    if (!capacity)
+        capacity = TWAMP_MAX_CAPACITY;
+
+    /* A segment this build cannot use is retired, not reused */
+    bgp_twamp_shm_retire_stale();
+
+    shm = bgp_twamp_shm_create(TWAMP_SHM_NAME, capacity, &shm_fd,
+                               &shm_size);
+    if (!shm)
         return;
-    }
-    
-    /* Initialize mutex for cross-process synchronization */
-    pthread_mutexattr_init(&attr);
-    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
-    pthread_mutex_init(&shm->lock, &attr);
-    pthread_mutexattr_destroy(&attr);
-    
-    shm->nh_count = 0;
-    shm->sequence = 0;
-    shm->padding = 0;
+
+    dirty_snap = XCALLOC(MTYPE_BGP_TWAMP_SLOTS,
+                         TWAMP_DIRTY_WORDS(capacity) * sizeof(uint64_t));
+    free_map = XCALLOC(MTYPE_BGP_TWAMP_SLOTS,
+                       TWAMP_DIRTY_WORDS(capacity) * sizeof(uint64_t));
+    restored_map = XCALLOC(MTYPE_BGP_TWAMP_SLOTS,
+                           TWAMP_DIRTY_WORDS(capacity) * sizeof(uint64_t));
+    index_tombstones = 0;
+    twamp_shm_hdr_init(shm, capacity);
     
-    zlog_info("BGP TWAMP: Shared memory initialized at %s", TWAMP_SHM_NAME);
+    zlog_info("BGP TWAMP: Shared memory initialized at %s (%u slots)",
+              TWAMP_SHM_NAME, capacity);
     
     /* Collect existing next-hops */
     bgp_twamp_collect_nexthops(bgp);
 
-	/* Start periodic measurement check timer */
-	event_add_timer(bm->master, bgp_twamp_check_measurements, bgp, 5, &measurement_check_timer);
-	fprintf(stderr, "*** TWAMP: Started measurement check timer\n"); fflush(stderr);
+	/* Wait for agent notifications, with a slow poll as fallback */
+	bgp_twamp_notify_init();
+	bgp_twamp_schedule_check();
 }
 
-/* Add next-hop to monitoring list */
-void bgp_twamp_add_nexthop(struct in_addr *nh)
+/*
+ * Insert nexthops[slot] into seg's address index, reusing the first
+ * tombstone on the probe path; caller bumped nh_gen, checked that the
+ * entry's key is not present and stored it in the entry.
+ */
+static void bgp_twamp_index_insert(struct twamp_shm *seg, int slot)
 {
-    int i;
-    fprintf(stderr, "*** ADD_NEXTHOP: Adding peer, shm=%p\n", (void*)shm); fflush(stderr);
-    
-    if (!shm) {
-        zlog_warn("BGP TWAMP: Shared memory not initialized");
-        return;
-    }
-    
-    pthread_mutex_lock(&shm->lock);
-    
-    /* Check if already exists */
-    for (i = 0; i < (int)shm->nh_count; i++) {
-        if (shm->nexthops[i].addr.s_addr == nh->s_addr) {
-            shm->nexthops[i].active = 1;
-            pthread_mutex_unlock(&shm->lock);
-            return;
-        }
-    }
-    
-    /* Add new entry */
-    if (shm->nh_count < MAX_NEXTHOPS) {
-        shm->nexthops[shm->nh_count].addr.s_addr = nh->s_addr;
-        shm->nexthops[shm->nh_count].active = 1;
-        shm->nexthops[shm->nh_count].measured = 0;
-        shm->nexthops[shm->nh_count].padding[0] = 0;
-        shm->nexthops[shm->nh_count].padding[1] = 0;
-        shm->nexthops[shm->nh_count].latency_ms = UINT32_MAX;  /* Max = not measured */
-        shm->nexthops[shm->nh_count].last_updated = 0;
-        shm->nh_count++;
-        shm->sequence++;  /* Signal change to TWAMP */
-        
-        char buf[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, nh, buf, sizeof(buf));
-        zlog_info("BGP TWAMP: Added next-hop %s for monitoring", buf);
-    } else {
-        zlog_warn("BGP TWAMP: Max next-hops (%d) reached, cannot add more", 
-                  MAX_NEXTHOPS);
-    }
-    
-    pthread_mutex_unlock(&shm->lock);
+	const struct twamp_nexthop *ent = &twamp_shm_nexthops_c(seg)[slot];
+	struct twamp_hash_bucket *index = twamp_shm_index(seg);
+	uint32_t mask = seg->hdr.hash_size - 1;
+	uint32_t tag = twamp_addr_tag_class(&ent->addr, ent->vrf_ifindex,
+					    ent->dscp);
+	uint32_t b = twamp_hash_tag(tag, seg->hdr.hash_size);
+
+	while (index[b].slot != 0 && index[b].slot != TWAMP_SLOT_TOMBSTONE)
+		b = (b + 1) & mask;
+
+	if (index[b].slot == TWAMP_SLOT_TOMBSTONE)
+		index_tombstones--;
+
+	index[b].tag = tag;
+	index[b].slot = slot + 1;
 }
 
-/* Remove next-hop from monitoring */
-void bgp_twamp_remove_nexthop(struct in_addr *nh)
+/* Re-insert the live entries into an empty index; caller bumped nh_gen */
+static void bgp_twamp_index_rebuild(void)
 {
-    int i;
-    
-    if (!shm)
-        return;
-    
-    pthread_mutex_lock(&shm->lock);
-    
-    for (i = 0; i < (int)shm->nh_count; i++) {
-        if (shm->nexthops[i].addr.s_addr == nh->s_addr) {
-            shm->nexthops[i].active = 0;  /* Mark inactive */
-            shm->sequence++;
-            
-            char buf[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, nh, buf, sizeof(buf));
-            zlog_info("BGP TWAMP: Removed next-hop %s from monitoring", buf);
-            break;
-        }
-    }
-    
-    pthread_mutex_unlock(&shm->lock);
+	const struct twamp_nexthop *ent = twamp_shm_nexthops_c(shm);
+	uint32_t i;
+
+	memset(twamp_shm_index(shm), 0,
+	       shm->hdr.hash_size * sizeof(struct twamp_hash_bucket));
+	index_tombstones = 0;
+
+	for (i = 0; i < shm->nh_count; i++)
+		if (ent[i].active)
+			bgp_twamp_index_insert(shm, i);
 }
 
+/* Drop the bucket of nexthops[slot] from the index; caller bumped nh_gen */
+static void bgp_twamp_index_remove(int slot)
+{
+	const struct twamp_nexthop *ent = &twamp_shm_nexthops_c(shm)[slot];
+	struct twamp_hash_bucket *index = twamp_shm_index(shm);
+	uint32_t mask = shm->hdr.hash_size - 1;
+	uint32_t tag = twamp_addr_tag_class(&ent->addr, ent->vrf_ifindex,
+					    ent->dscp);
+	uint32_t b = twamp_hash_tag(tag, shm->hdr.hash_size);
+	uint32_t n;
+
+	for (n = 0; n <= mask; n++, b = (b + 1) & mask) {
+		if (index[b].slot == 0)
+			return;
+		if (index[b].slot == (uint32_t)slot + 1)
+			break;
+	}
+	if (n > mask)
+		return;
+
+	index[b].slot = TWAMP_SLOT_TOMBSTONE;
+	index_tombstones++;
 
-/* Get latency for a next-hop */
-uint32_t bgp_twamp_get_latency(struct in_addr *nh)
+	/* Long probe chains through dead buckets: start over clean */
+	if (index_tombstones > shm->hdr.hash_size / 4)
+		bgp_twamp_index_rebuild();
+}
+
+/*
+ * Move to a segment with twice the capacity. The new one is built aside
+ * with the membership and the latest measurements, and replaces the old
+ * one under TWAMP_SHM_NAME in a single rename. Pending dirty bits follow
+ * and only then is the old one flagged superseded, so agents re-open
+ * straight into a complete table. Until the rename nothing is given up:
+ * on failure the old segment stays in place, name and all.
+ */
+static bool bgp_twamp_grow(void)
 {
-    int i;
-    uint32_t latency;
-    char buf[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, nh, buf, sizeof(buf));
-    
-    if (!shm) {
-        fprintf(stderr, "*** GET_LATENCY: shm is NULL for %s\n", buf); fflush(stderr);
-        return UINT32_MAX;
-    }
-    
-    pthread_mutex_lock(&shm->lock);
-    
-    fprintf(stderr, "*** GET_LATENCY: shm=%p, shm->nh_count=%d\n", (void*)shm, shm ? shm->nh_count : -1); fflush(stderr);
-    fprintf(stderr, "*** GET_LATENCY: Looking for %s, nh_count=%d\n", buf, shm->nh_count); fflush(stderr);
-    
-    for (i = 0; i < (int)shm->nh_count; i++) {
-        char stored_ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &shm->nexthops[i].addr, stored_ip, sizeof(stored_ip));
-        fprintf(stderr, "*** RAW BYTES: addr=%08x lat=%u act=%u meas=%u\n", 
-                ntohl(shm->nexthops[i].addr.s_addr), 
-                shm->nexthops[i].latency_ms, 
-                shm->nexthops[i].active, 
-                shm->nexthops[i].measured); fflush(stderr);
-        fprintf(stderr, "*** GET_LATENCY:   [%d] %s: latency=%u active=%d measured=%d\n", 
-                i, stored_ip, shm->nexthops[i].latency_ms, 
-                shm->nexthops[i].active, shm->nexthops[i].measured); 
-        fflush(stderr);
-        
-        if (shm->nexthops[i].addr.s_addr == nh->s_addr && 
-            shm->nexthops[i].measured &&
-            shm->nexthops[i].active) {
-            latency = shm->nexthops[i].latency_ms;
-            fprintf(stderr, "*** GET_LATENCY: FOUND! Returning %u ms\n", latency); fflush(stderr);
-            pthread_mutex_unlock(&shm->lock);
-            return latency;
-        }
-    }
-    
-    fprintf(stderr, "*** GET_LATENCY: NOT FOUND, returning UINT32_MAX\n"); fflush(stderr);
-    pthread_mutex_unlock(&shm->lock);
-    return UINT32_MAX;
+	struct twamp_shm *old = shm, *seg;
+	const struct twamp_nexthop *from;
+	struct twamp_nexthop *to;
+	uint32_t capacity = old->hdr.capacity * 2;
+	uint32_t words, i;
+	size_t size;
+	int fd;
+
+	if (old->hdr.capacity >= TWAMP_MAX_CAPACITY)
+		return false;
+
+	/* Left over by a bgpd that died while growing */
+	shm_unlink(BGP_TWAMP_SHM_NEW_NAME);
+	seg = bgp_twamp_shm_create(BGP_TWAMP_SHM_NEW_NAME, capacity, &fd,
+				   &size);
+	if (!seg)
+		return false;
+
+	from = twamp_shm_nexthops_c(old);
+	to = twamp_shm_nexthops(seg);
+	for (i = 0; i < old->nh_count; i++) {
+		to[i].addr = from[i].addr;
+		to[i].vrf_ifindex = from[i].vrf_ifindex;
+		to[i].dscp = from[i].dscp;
+		to[i].probe_cycle_sec = from[i].probe_cycle_sec;
+		to[i].packet_count = from[i].packet_count;
+		to[i].active = from[i].active;
+		to[i].epoch = from[i].epoch;
+		to[i].gen = __atomic_load_n(&from[i].gen, __ATOMIC_RELAXED);
+		if (twamp_nexthop_read(&from[i], &to[i].latency_us,
+				       &to[i].measured, &to[i].last_updated) ||
+		    !to[i].measured) {
+			to[i].latency_us = UINT32_MAX;
+			to[i].measured = 0;
+		}
+		/* What was read is current, including the loss of a dead slot */
+		to[i].meas_epoch = from[i].epoch;
+		if (twamp_nexthop_read_quality(&from[i], &to[i].jitter_us,
+					       &to[i].loss_permille)) {
+			to[i].jitter_us = 0;
+			to[i].loss_permille = 0;
+		}
+		if (twamp_nexthop_read_forward(&from[i], &to[i].forward_us))
+			to[i].forward_us = 0;
+		if (to[i].active)
+			bgp_twamp_index_insert(seg, i);
+	}
+	seg->nh_count = old->nh_count;
+	seg->sequence = __atomic_load_n(&old->sequence, __ATOMIC_RELAXED);
+	/* bgpd is the only writer of the block, a plain copy is current */
+	seg->config = old->config;
+
+	/* Old mappings stay valid, only the name moves to the new segment */
+	if (rename(BGP_TWAMP_SHM_DIR BGP_TWAMP_SHM_NEW_NAME,
+		   BGP_TWAMP_SHM_DIR TWAMP_SHM_NAME) == -1) {
+		zlog_err("BGP TWAMP: Failed to replace shared memory: %s",
+			 safe_strerror(errno));
+		pthread_mutex_destroy(&seg->writer_lock);
+		munmap(seg, size);
+		close(fd);
+		shm_unlink(BGP_TWAMP_SHM_NEW_NAME);
+		return false;
+	}
+
+	words = TWAMP_DIRTY_WORDS(old->hdr.capacity);
+	for (i = 0; i < words; i++)
+		twamp_shm_dirty(seg)[i] = __atomic_exchange_n(
+			&twamp_shm_dirty(old)[i], 0, __ATOMIC_ACQ_REL);
+
+	twamp_shm_hdr_init(seg, capacity);
+	__atomic_fetch_or(&old->hdr.flags, TWAMP_SHM_F_SUPERSEDED,
+			  __ATOMIC_RELEASE);
+
+	munmap(old, shm_size);
+	close(shm_fd);
+	shm = seg;
+	shm_fd = fd;
+	shm_size = size;
+
+	index_tombstones = 0;
+
+	XFREE(MTYPE_BGP_TWAMP_SLOTS, dirty_snap);
+	dirty_snap = XCALLOC(MTYPE_BGP_TWAMP_SLOTS,
+			     TWAMP_DIRTY_WORDS(capacity) * sizeof(uint64_t));
+	free_map = XREALLOC(MTYPE_BGP_TWAMP_SLOTS, free_map,
+			    TWAMP_DIRTY_WORDS(capacity) * sizeof(uint64_t));
+	memset(free_map + words, 0,
+	       (TWAMP_DIRTY_WORDS(capacity) - words) * sizeof(uint64_t));
+	restored_map = XREALLOC(MTYPE_BGP_TWAMP_SLOTS, restored_map,
+				TWAMP_DIRTY_WORDS(capacity) * sizeof(uint64_t));
+	memset(restored_map + words, 0,
+	       (TWAMP_DIRTY_WORDS(capacity) - words) * sizeof(uint64_t));
+
+	zlog_info("BGP TWAMP: Grew shared memory to %u slots", capacity);
+	return true;
 }
-void bgp_twamp_collect_nexthops(struct bgp *bgp)
+
+/* Free slots that would be handed out before growing the table */
+static uint32_t bgp_twamp_free_slots(void)
 {
-    struct peer *peer;
-    struct listnode *node, *nnode;
-    struct in_addr peer_ip;
-    int count = 0;
-    
-    if (!bgp || !bgp->import_latency_cfg.enabled) {
-        zlog_info("BGP TWAMP: Feature not enabled or BGP instance invalid");
-        return;
-    }
-    
-    if (!shm) {
-        zlog_warn("BGP TWAMP: Shared memory not initialized");
-        return;
-    }
-    
-    zlog_info("BGP TWAMP: Starting peer IP collection from peer list");
-    
-    /* Iterate through all BGP peers */
-    for (ALL_LIST_ELEMENTS(bgp->peer, node, nnode, peer)) {
-        
-        /* Skip if not IBGP */
-        if (peer->sort != BGP_PEER_IBGP)
-            continue;
-            
-        /* Skip if not established */
-        if (peer->connection->status != Established)
-            continue;
-        
-        /* Skip if no connection */
-        if (!peer->connection)
-            continue;
-            
-        /* Get peer IPv4 address */
-        if (peer->connection->su.sa.sa_family == AF_INET) {
-            peer_ip.s_addr = peer->connection->su.sin.sin_addr.s_addr;
-            
-            char buf[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, &peer_ip, buf, sizeof(buf));
-            zlog_info("BGP TWAMP: Found IBGP peer %s", buf);
-            
-            /* Add to shared memory */
-            bgp_twamp_add_nexthop(&peer_ip);
-            count++;
-        }
-    }
-    
-    fprintf(stderr, "*** COLLECTED %d peers!\n", count); fflush(stderr);
-    fprintf(stderr, "*** COLLECTED %d peers!\n", count); fflush(stderr);
-    zlog_info("BGP TWAMP: Collected %d IBGP peer IPs", count);
+	uint32_t words = TWAMP_DIRTY_WORDS(shm->nh_count);
+	uint32_t w, n = shm->hdr.capacity - shm->nh_count;
+
+	for (w = 0; w < words; w++)
+		n += __builtin_popcountll(free_map[w]);
+	return n;
 }
-    
 
-/* Cleanup shared memory */
-/* Check if measurements have been updated */
-static void bgp_twamp_check_measurements(struct event *thread)
+/*
+ * Make room for n more entries up front, so the segment never has to be
+ * replaced in the middle of a membership update. Returns false if the
+ * table cannot grow that far; whatever room there is stays usable.
+ */
+static bool bgp_twamp_reserve(uint32_t n)
 {
-	struct bgp *bgp = EVENT_ARG(thread);
-	
-	if (!shm || !bgp->import_latency_cfg.enabled) {
-		measurement_check_timer = NULL;
+	while (bgp_twamp_free_slots() < n)
+		if (!bgp_twamp_grow())
+			return false;
+	return true;
+}
+
+/*
+ * Pick a slot for a new entry: the lowest free one below nh_count, so the
+ * table stays dense, else the next one past it. Returns -1 if the table
+ * is full; callers reserve room first.
+ */
+static int bgp_twamp_slot_alloc(void)
+{
+	uint32_t words = TWAMP_DIRTY_WORDS(shm->nh_count);
+	uint32_t w;
+
+	for (w = 0; w < words; w++)
+		if (free_map[w]) {
+			int bit = __builtin_ctzll(free_map[w]);
+
+			free_map[w] &= ~(1ULL << bit);
+			return w * 64 + bit;
+		}
+
+	if (shm->nh_count >= shm->hdr.capacity)
+		return -1;
+
+	return shm->nh_count;
+}
+
+/*
+ * Put key into a fresh slot of vrf_ifindex; caller bumped nh_gen and
+ * checked that it is not present. The measurement fields of a reused slot
+ * belong to the agent and are left alone: bumping epoch is what makes an
+ * old measurement stop counting. Returns the slot, or -1 if the table is
+ * full.
+ */
+static int bgp_twamp_nexthop_insert(const struct in6_addr *key,
+				    uint32_t vrf_ifindex, uint8_t dscp)
+{
+	struct twamp_nexthop *ent;
+	int i;
+
+	i = bgp_twamp_slot_alloc();
+	if (i < 0)
+		return -1;
+
+	ent = &twamp_shm_nexthops(shm)[i];
+	ent->addr = *key;
+	ent->vrf_ifindex = vrf_ifindex;
+	ent->dscp = dscp;
+	ent->probe_cycle_sec = 0;
+	ent->packet_count = 0;
+	if (++ent->epoch == 0)
+		ent->epoch = 1;
+	ent->active = 1;
+	bgp_twamp_index_insert(shm, i);
+	if ((uint32_t)i == shm->nh_count)
+		__atomic_store_n(&shm->nh_count, i + 1, __ATOMIC_RELEASE);
+
+	return i;
+}
+
+/*
+ * Release slot i; caller bumped nh_gen. The slot goes on the free list,
+ * or, if it was the last one, nh_count shrinks past it and any free slots
+ * right below it so agents never scan a dead tail.
+ */
+static void bgp_twamp_nexthop_delete(int i)
+{
+	struct twamp_nexthop *ent = twamp_shm_nexthops(shm);
+	uint32_t count;
+
+	ent[i].active = 0;
+	bgp_twamp_index_remove(i);
+
+	free_map[i / 64] |= 1ULL << (i % 64);
+	count = shm->nh_count;
+	while (count > 0 && !ent[count - 1].active) {
+		count--;
+		free_map[count / 64] &= ~(1ULL << (count % 64));
+	}
+	__atomic_store_n(&shm->nh_count, count, __ATOMIC_RELEASE);
+}
+
+/*
+ * Segment key of a transport address: IPv4 is stored v4-mapped, so both
+ * families share the index. False for anything without an IP address.
+ */
+static bool bgp_twamp_su_key(const union sockunion *su, struct in6_addr *key)
+{
+	switch (su->sa.sa_family) {
+	case AF_INET:
+		twamp_addr_from_ipv4(key, su->sin.sin_addr.s_addr);
+		return true;
+	case AF_INET6:
+		*key = su->sin6.sin6_addr;
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Add next-hop to monitoring list.  Membership is owned by bgpd, so no lock
+ * is needed; nh_gen lets the agent detect that it raced with us.
+ */
+void bgp_twamp_add_nexthop(const union sockunion *nh)
+{
+	struct in6_addr key;
+	int i;
+
+	if (!shm) {
+		zlog_warn("BGP TWAMP: Shared memory not initialized");
 		return;
 	}
-	
-	pthread_mutex_lock(&shm->lock);
-	uint32_t current_seq = shm->sequence;
-	pthread_mutex_unlock(&shm->lock);
-	
-	/* If sequence changed, measurements were updated */
-	if (current_seq != last_sequence) {
-		fprintf(stderr, "*** TWAMP: Measurements updated (seq %u -> %u), triggering BGP refresh\n", 
-		        last_sequence, current_seq); fflush(stderr);
-		last_sequence = current_seq;
 
-		/* Trigger VPN route re-import to update weights */
-		vpn_leak_postchange_all();
+	if (!bgp_twamp_su_key(nh, &key))
+		return;
+
+	/* Only live entries are indexed */
+	if (twamp_shm_find(shm, &key, 0) >= 0)
+		return;
+
+	bgp_twamp_reserve(1);
+
+	twamp_seq_write_begin(&shm->nh_gen);
+	i = bgp_twamp_nexthop_insert(&key, 0, 0);
+	twamp_seq_write_end(&shm->nh_gen);
+
+	if (i < 0) {
+		zlog_warn("BGP TWAMP: Max next-hops (%u) reached, cannot add more",
+			  shm->hdr.capacity);
+		return;
 	}
-	
-	/* Re-schedule timer for next check (every 5 seconds) */
-	event_add_timer(bm->master, bgp_twamp_check_measurements, bgp, 5, &measurement_check_timer);
+
+	if (BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: Added next-hop %pSU for monitoring", nh);
+}
+
+/* Remove next-hop from monitoring */
+void bgp_twamp_remove_nexthop(const union sockunion *nh)
+{
+	struct in6_addr key;
+	int i;
+
+	if (!shm || !bgp_twamp_su_key(nh, &key))
+		return;
+
+	i = twamp_shm_find(shm, &key, 0);
+	if (i < 0)
+		return;
+
+	twamp_seq_write_begin(&shm->nh_gen);
+	bgp_twamp_nexthop_delete(i);
+	twamp_seq_write_end(&shm->nh_gen);
+
+	if (BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: Removed next-hop %pSU from monitoring",
+			   nh);
 }
 
+/*
+ * Probe profile of an entry that several targets share: the fastest
+ * cycle and the most packets any of them asks for, 0 meaning no opinion
+ */
+static void bgp_twamp_profile_merge(uint16_t *cycle_sec, uint8_t *packets,
+				    uint16_t want_cycle_sec,
+				    uint8_t want_packets)
+{
+	if (want_cycle_sec && (!*cycle_sec || want_cycle_sec < *cycle_sec))
+		*cycle_sec = want_cycle_sec;
+	if (want_packets > *packets)
+		*packets = want_packets;
+}
 
-void bgp_twamp_cleanup(void)
+/*
+ * Make the monitored set exactly targets[0..n). The whole diff is applied
+ * in one membership update (a single nh_gen bump), room for the new
+ * entries is reserved before it starts, and each address costs one hash
+ * probe, so a mass session bring-up stays linear. Duplicates are fine,
+ * their profiles are merged.
+ */
+void bgp_twamp_sync_nexthops(const struct bgp_twamp_target *targets,
+			     unsigned int n)
 {
-    /* Check if not initialized */
-    if (!shm && shm_fd < 0) {
-        zlog_info("BGP TWAMP: Nothing to cleanup");
-        return;
-    }
-    
-    if (shm) {
-        pthread_mutex_destroy(&shm->lock);
-        munmap(shm, sizeof(struct twamp_shm));
-        shm = NULL;
-    }
-    
-    if (shm_fd >= 0) {
-        close(shm_fd);
-        shm_unlink(TWAMP_SHM_NAME);
-        shm_fd = -1;
-    }
-    
-    zlog_info("BGP TWAMP: Cleaned up shared memory");
-}
\ No newline at end of file
+	struct twamp_nexthop *ent;
+	uint64_t *keep;
+	unsigned int k, missing = 0, added = 0, removed = 0, dropped = 0;
+	int i;
+
+	if (!shm)
+		return;
+
+	for (k = 0; k < n; k++)
+		if (twamp_shm_find_class(shm, &targets[k].key,
+					 targets[k].vrf_ifindex,
+					 targets[k].dscp) < 0)
+			missing++;
+	if (missing)
+		bgp_twamp_reserve(missing);
+
+	keep = XCALLOC(MTYPE_BGP_TWAMP_SLOTS,
+		       TWAMP_DIRTY_WORDS(shm->hdr.capacity) * sizeof(uint64_t));
+
+	twamp_seq_write_begin(&shm->nh_gen);
+
+	for (k = 0; k < n; k++) {
+		i = twamp_shm_find_class(shm, &targets[k].key,
+					 targets[k].vrf_ifindex,
+					 targets[k].dscp);
+		if (i < 0) {
+			i = bgp_twamp_nexthop_insert(&targets[k].key,
+						     targets[k].vrf_ifindex,
+						     targets[k].dscp);
+			if (i < 0) {
+				dropped++;
+				continue;
+			}
+			added++;
+		}
+		/* A nexthop back after the restart claims its old slot */
+		restored_map[i / 64] &= ~(1ULL << (i % 64));
+		ent = &twamp_shm_nexthops(shm)[i];
+		if (!twamp_dirty_test(keep, i)) {
+			ent->probe_cycle_sec = targets[k].probe_cycle_sec;
+			ent->packet_count = targets[k].packet_count;
+		} else
+			bgp_twamp_profile_merge(&ent->probe_cycle_sec,
+						&ent->packet_count,
+						targets[k].probe_cycle_sec,
+						targets[k].packet_count);
+		keep[i / 64] |= 1ULL << (i % 64);
+	}
+
+	/* Top down, so the tail shrinks as soon as it is dead */
+	for (i = (int)shm->nh_count - 1; i >= 0; i--)
+		if (twamp_shm_nexthops(shm)[i].active &&
+		    !twamp_dirty_test(keep, i) &&
+		    !twamp_dirty_test(restored_map, i)) {
+			bgp_twamp_nexthop_delete(i);
+			removed++;
+		}
+
+	twamp_seq_write_end(&shm->nh_gen);
+
+	XFREE(MTYPE_BGP_TWAMP_SLOTS, keep);
+
+	frrtrace(3, frr_bgp, twamp_nexthop_sync, added, removed, n - dropped);
+	if ((added || removed) && BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: Next-hop sync: %u added, %u removed, %u monitored",
+			   added, removed, n - dropped);
+	if (dropped)
+		zlog_warn("BGP TWAMP: Max next-hops (%u) reached, %u not monitored",
+			  shm->hdr.capacity, dropped);
+}
+
+
+/*
+ * Far ends of the point-to-point links of the default VRF whose TE delays
+ * zebra takes from the measurements, with the agent's own probe profile.
+ * Only counts them if targets is NULL. zebra finds them the same way,
+ * with connected_get_link_peer().
+ */
+static unsigned int bgp_twamp_collect_links(struct bgp_twamp_target *targets)
+{
+	struct vrf *vrf = vrf_lookup_by_id(VRF_DEFAULT);
+	struct interface *ifp;
+	struct in_addr peer;
+	unsigned int n = 0;
+
+	if (!vrf)
+		return 0;
+
+	FOR_ALL_INTERFACES (vrf, ifp) {
+		if (!HAS_LINK_PARAMS(ifp) ||
+		    !IS_PARAM_SET(ifp->link_params, LP_DELAY_MEASURED) ||
+		    !connected_get_link_peer(ifp, &peer))
+			continue;
+		if (targets) {
+			memset(&targets[n], 0, sizeof(targets[n]));
+			twamp_addr_from_ipv4(&targets[n].key, peer.s_addr);
+		}
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * Get latency for a next-hop.  Never blocks: the entry is read under its
+ * seq counter, and an entry stuck mid-update counts as not measured.
+ */
+static uint32_t bgp_twamp_key_latency(const struct in6_addr *key,
+				      uint32_t vrf_ifindex, uint8_t dscp,
+				      int64_t *last_updated)
+{
+	const struct twamp_nexthop *ent;
+	uint32_t latency;
+	uint8_t measured;
+	int i;
+
+	if (!shm)
+		return UINT32_MAX;
+
+	i = twamp_shm_find_class(shm, key, vrf_ifindex, dscp);
+	if (i < 0)
+		return UINT32_MAX;
+
+	ent = &twamp_shm_nexthops_c(shm)[i];
+	if (!ent->active)
+		return UINT32_MAX;
+
+	if (twamp_nexthop_read(ent, &latency, &measured, last_updated) < 0 ||
+	    !measured)
+		return UINT32_MAX;
+
+	return latency;
+}
+
+/* Probe loss of a nexthop in permille, 0 if it has no measurement */
+static uint16_t bgp_twamp_key_loss(const struct in6_addr *key,
+				   uint32_t vrf_ifindex, uint8_t dscp)
+{
+	uint32_t jitter;
+	uint16_t loss;
+	int i;
+
+	if (!shm)
+		return 0;
+
+	i = twamp_shm_find_class(shm, key, vrf_ifindex, dscp);
+	if (i < 0 ||
+	    twamp_nexthop_read_quality(&twamp_shm_nexthops_c(shm)[i], &jitter,
+				       &loss) < 0)
+		return 0;
+
+	return MIN(loss, 1000);
+}
+
+/* Forward delay of a nexthop in microseconds, 0 if not measured one way */
+static uint32_t bgp_twamp_key_forward(const struct in6_addr *key,
+				      uint32_t vrf_ifindex, uint8_t dscp)
+{
+	uint32_t forward;
+	int i;
+
+	if (!shm)
+		return 0;
+
+	i = twamp_shm_find_class(shm, key, vrf_ifindex, dscp);
+	if (i < 0 ||
+	    twamp_nexthop_read_forward(&twamp_shm_nexthops_c(shm)[i],
+				       &forward) < 0)
+		return 0;
+
+	return forward;
+}
+
+/*
+ * Segment key and VRF of a nexthop cache entry. The nexthop is resolved
+ * in the VRF of the instance owning the cache, which the agent reaches
+ * through the VRF device: with the VRF-lite backend a vrf_id is that
+ * device's ifindex. An instance whose VRF is not up yet, or a netns
+ * backend, has no device to bind to and is not measured.
+ */
+static bool bgp_twamp_bnc_key(const struct bgp_nexthop_cache *bnc,
+			      struct in6_addr *key, uint32_t *vrf_ifindex)
+{
+	vrf_id_t vrf_id = bnc->bgp->vrf_id;
+
+	if (vrf_id == VRF_DEFAULT)
+		*vrf_ifindex = 0;
+	else if (vrf_id != VRF_UNKNOWN && !vrf_is_backend_netns())
+		*vrf_ifindex = vrf_id;
+	else
+		return false;
+
+	switch (bnc->prefix.family) {
+	case AF_INET:
+		twamp_addr_from_ipv4(key, bnc->prefix.u.prefix4.s_addr);
+		return true;
+	case AF_INET6:
+		*key = bnc->prefix.u.prefix6;
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Only iBGP nexthops are measured: they are the egress PEs. A VPN path
+ * only counts once some VRF imports its route targets, any other path
+ * only in an instance that selects on latency, so PEs whose routes
+ * never reach a latency decision are not probed.
+ */
+static bool bgp_twamp_path_wanted(struct bgp_path_info *path)
+{
+	struct bgp_table *table;
+
+	if (!path->peer || path->peer->sort != BGP_PEER_IBGP ||
+	    CHECK_FLAG(path->flags, BGP_PATH_REMOVED) || !path->net)
+		return false;
+
+	table = bgp_dest_table(path->net);
+	if (table->safi == SAFI_MPLS_VPN)
+		return !vpn_leak_to_vrf_no_retain_filter_check(table->bgp,
+							       path->attr,
+							       table->afi);
+
+	return table->bgp->import_latency_cfg.enabled;
+}
+
+/* Does the instance take its latency, or part of it, from the agent? */
+static bool bgp_twamp_probes(const struct bgp *bgp)
+{
+	return bgp->import_latency_cfg.enabled &&
+	       bgp->import_latency_cfg.source != BGP_LATENCY_SOURCE_IGP_TE;
+}
+
+/*
+ * A wanted path only asks for probes where the latency comes from the
+ * agent, even if only in part; instances on IGP TE delay do without.
+ * VPN paths are probed as soon as some VRF imports them.
+ */
+static bool bgp_twamp_path_probed(struct bgp_path_info *path)
+{
+	struct bgp_table *table;
+
+	if (!bgp_twamp_path_wanted(path))
+		return false;
+
+	table = bgp_dest_table(path->net);
+	return table->safi == SAFI_MPLS_VPN || bgp_twamp_probes(table->bgp);
+}
+
+/*
+ * Merge in the probe profile configured in an instance. A hybrid instance
+ * probes a nexthop whose IGP estimate agrees with its measurement on the
+ * slow hybrid cycle. A nexthop is measured in a single traffic class, the
+ * highest any of the instances relying on it asks for.
+ */
+static void bgp_twamp_target_merge(struct bgp_twamp_target *t,
+				   const struct bgp *bgp, bool sparse)
+{
+	const struct bgp_import_latency_config *cfg = &bgp->import_latency_cfg;
+
+	if (!bgp_twamp_probes(bgp))
+		return;
+
+	bgp_twamp_profile_merge(&t->probe_cycle_sec, &t->packet_count,
+				sparse && cfg->source == BGP_LATENCY_SOURCE_HYBRID
+					? cfg->hybrid_probe_cycle_sec
+					: cfg->probe_cycle_sec,
+				cfg->packet_count);
+	t->dscp = MAX(t->dscp, cfg->dscp);
+}
+
+/*
+ * Merge in the profiles of the instances a wanted path serves: every VRF
+ * importing a VPN path, or the instance holding any other path.
+ */
+static void bgp_twamp_path_profile(struct bgp_path_info *path,
+				   struct bgp_twamp_target *t, bool sparse)
+{
+	struct bgp_table *table = bgp_dest_table(path->net);
+	struct ecommunity *ecom = bgp_attr_get_ecommunity(path->attr);
+	struct listnode *node;
+	struct bgp *to_bgp;
+
+	if (table->safi != SAFI_MPLS_VPN) {
+		bgp_twamp_target_merge(t, table->bgp, sparse);
+		return;
+	}
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, to_bgp))
+		if (to_bgp->import_latency_cfg.enabled &&
+		    vpn_leak_from_vpn_active(to_bgp, table->afi, NULL) &&
+		    ecommunity_include(to_bgp->vpn_policy[table->afi]
+					       .rtlist[BGP_VPN_POLICY_DIR_FROMVPN],
+				       ecom))
+			bgp_twamp_target_merge(t, to_bgp, sparse);
+}
+
+/*
+ * Is bnc to be measured, and with which profile? Paths are looked at
+ * until the profile is as strict as the strictest one configured, which
+ * with the same profile everywhere is the first wanted path.
+ */
+static bool bgp_twamp_bnc_wanted(const struct bgp_nexthop_cache *bnc,
+				 struct bgp_twamp_target *t,
+				 const struct bgp_twamp_target *strictest)
+{
+	struct bgp_path_info *path;
+	bool wanted = false;
+
+	LIST_FOREACH (path, &bnc->paths, nh_thread) {
+		if (!bgp_twamp_path_probed(path))
+			continue;
+		wanted = true;
+		bgp_twamp_path_profile(path, t, bnc->twamp_hybrid_sparse);
+		if (t->probe_cycle_sec == strictest->probe_cycle_sec &&
+		    t->packet_count == strictest->packet_count &&
+		    t->dscp == strictest->dscp)
+			break;
+	}
+	return wanted;
+}
+
+/*
+ * Hold-down penalty of a nexthop, decayed to now. Same figure of merit
+ * as route-flap dampening in bgp_damp.c: every adopted flip adds
+ * DEFAULT_PENALTY, halving each half-life, and the ceiling keeps a
+ * flapping nexthop from staying held for more than four half-lives.
+ */
+#define BGP_TWAMP_PENALTY_CEILING (DEFAULT_REUSE * 16)
+
+static int bgp_twamp_penalty_decay(struct bgp_nexthop_cache *bnc,
+				   uint32_t half_life, time_t now)
+{
+	time_t t_diff = now - bnc->twamp_penalty_updated;
+
+	if (!half_life) {
+		bnc->twamp_penalty = 0;
+		bnc->twamp_held = false;
+	} else if (bnc->twamp_penalty && t_diff > 0)
+		bnc->twamp_penalty =
+			(int)(bnc->twamp_penalty *
+			      pow(0.5, (double)t_diff / half_life));
+
+	bnc->twamp_penalty_updated = now;
+	if (bnc->twamp_held && bnc->twamp_penalty < DEFAULT_REUSE)
+		bnc->twamp_held = false;
+
+	return bnc->twamp_penalty;
+}
+
+/*
+ * Did a nexthop's loss move across the loss threshold of any instance?
+ * Only then can it change a best-path decision.
+ */
+static bool bgp_twamp_loss_crossed(uint16_t from, uint16_t to)
+{
+	struct listnode *node;
+	struct bgp *bgp;
+	uint16_t threshold;
+
+	if (from == to)
+		return false;
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp)) {
+		threshold = bgp->import_latency_cfg.loss_threshold_permille;
+		if (bgp->import_latency_cfg.enabled && threshold &&
+		    (from >= threshold) != (to >= threshold))
+			return true;
+	}
+	return false;
+}
+
+/* Does any instance stamp its announcements with measured latency? */
+static bool bgp_twamp_advertising(void)
+{
+	struct listnode *node;
+	struct bgp *bgp;
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		if (bgp->import_latency_cfg.enabled &&
+		    bgp->import_latency_cfg.advertise)
+			return true;
+	return false;
+}
+
+/*
+ * The advertised copy of a nexthop's latency follows twamp_latency, but
+ * only on a move beyond the damping threshold, a loss threshold crossing
+ * or a change in reachability, and at most once per advertise interval.
+ * Every update group holding its paths re-sends them on each move, so a
+ * jittery nexthop must not cause one per measurement. Returns true if
+ * the value to advertise changed.
+ */
+static bool bgp_twamp_advertise_update(struct bgp_nexthop_cache *bnc)
+{
+	struct bgp_import_latency_config *cfg = &bnc->bgp->import_latency_cfg;
+	uint32_t latency = bnc->twamp_latency, delta;
+	bool reachability;
+	time_t now;
+
+	bnc->twamp_advertise_pending = false;
+	if (latency == bnc->twamp_advertised &&
+	    bnc->twamp_loss == bnc->twamp_advertised_loss)
+		return false;
+
+	reachability = (latency == UINT32_MAX) !=
+		       (bnc->twamp_advertised == UINT32_MAX);
+	delta = latency > bnc->twamp_advertised
+			? latency - bnc->twamp_advertised
+			: bnc->twamp_advertised - latency;
+	if (!reachability && delta <= cfg->damping_threshold_us &&
+	    !bgp_twamp_loss_crossed(bnc->twamp_advertised_loss,
+				    bnc->twamp_loss))
+		return false;
+
+	/* Losing the measurement withdraws the stamp at once */
+	now = monotime(NULL);
+	if (latency != UINT32_MAX && bnc->twamp_advertised_time &&
+	    now - bnc->twamp_advertised_time <
+		    (time_t)cfg->advertise_interval_sec) {
+		bnc->twamp_advertise_pending = true;
+		return false;
+	}
+
+	bnc->twamp_advertised = latency;
+	bnc->twamp_advertised_loss = bnc->twamp_loss;
+	bnc->twamp_advertised_time = now;
+	return bgp_twamp_advertising();
+}
+
+/*
+ * BFD echo round trip time of a nexthop that is a single-hop BFD peer of
+ * its instance, for instances taking BFD echo as a fallback source. bfdd
+ * already loops echo to such peers, so no second probe is needed.
+ */
+static uint32_t bgp_twamp_bnc_bfd_rtt(const struct bgp_nexthop_cache *bnc)
+{
+	union sockunion su;
+	struct peer *peer;
+
+	if (!bnc->bgp->import_latency_cfg.bfd_echo)
+		return UINT32_MAX;
+
+	prefix2sockunion(&bnc->prefix, &su);
+	peer = peer_lookup(bnc->bgp, &su);
+	if (!peer || !peer->bfd_config ||
+	    bfd_sess_status(peer->bfd_config->session) != BSS_UP)
+		return UINT32_MAX;
+
+	return bfd_sess_rtt(peer->bfd_config->session);
+}
+
+/*
+ * Adopt a nexthop's new latency; returns true if it changed.
+ *
+ * Losing or gaining a measurement, and moves within the switch-back
+ * threshold, are taken as they come: neither can flip a path on its own.
+ * A larger move has to persist for min-dwell seconds before best-path
+ * sees it, and with hold-down configured a nexthop that keeps flipping
+ * is frozen at its last value until its penalty decays below the reuse
+ * limit.
+ */
+static bool bgp_twamp_bnc_adopt(struct bgp_nexthop_cache *bnc,
+				uint32_t latency)
+{
+	struct bgp_import_latency_config *cfg = &bnc->bgp->import_latency_cfg;
+	uint32_t delta;
+	time_t since, now;
+
+	since = bnc->twamp_pending_since;
+	bnc->twamp_pending_since = 0;
+
+	if (latency == bnc->twamp_latency)
+		return false;
+
+	delta = latency > bnc->twamp_latency ? latency - bnc->twamp_latency
+					     : bnc->twamp_latency - latency;
+	if (latency == UINT32_MAX || bnc->twamp_latency == UINT32_MAX ||
+	    delta <= MIN(cfg->switch_back_threshold_us,
+			 cfg->damping_threshold_us)) {
+		bnc->twamp_latency = latency;
+		return true;
+	}
+
+	now = monotime(NULL);
+	bnc->twamp_pending_since = since ? since : now;
+	bnc->twamp_pending = latency;
+	if (now - bnc->twamp_pending_since < (time_t)cfg->min_dwell_sec)
+		return false;
+
+	if (bgp_twamp_penalty_decay(bnc, cfg->hold_down_half_life, now) &&
+	    bnc->twamp_held)
+		return false;
+
+	if (cfg->hold_down_half_life) {
+		bnc->twamp_penalty = MIN(bnc->twamp_penalty + DEFAULT_PENALTY,
+					 BGP_TWAMP_PENALTY_CEILING);
+		if (bnc->twamp_penalty > DEFAULT_SUPPRESS) {
+			bnc->twamp_held = true;
+			zlog_info("BGP TWAMP: nexthop %pFX latency flapping, held at %uus",
+				  &bnc->prefix, bnc->twamp_latency);
+			return false;
+		}
+	}
+
+	bnc->twamp_pending_since = 0;
+	bnc->twamp_latency = latency;
+	return true;
+}
+
+/*
+ * Hybrid source: while a nexthop's measurement is within tolerance of
+ * its IGP estimate, the estimate stands in for it and the agent only
+ * checks back on the slow hybrid cycle; once they disagree the nexthop
+ * is probed at the normal rate again. The tightest tolerance of the
+ * hybrid instances applies; without any, nothing is probed sparsely.
+ */
+static void bgp_twamp_hybrid_update(struct bgp_nexthop_cache *bnc,
+				    uint32_t measured)
+{
+	struct listnode *node;
+	struct bgp *bgp;
+	uint32_t tolerance = UINT32_MAX, igp = bnc->twamp_igp_latency;
+	bool sparse = false;
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		if (bgp->import_latency_cfg.enabled &&
+		    bgp->import_latency_cfg.source == BGP_LATENCY_SOURCE_HYBRID)
+			tolerance = MIN(tolerance,
+					bgp->import_latency_cfg.hybrid_tolerance_us);
+
+	if (tolerance != UINT32_MAX && measured != UINT32_MAX &&
+	    igp != UINT32_MAX)
+		sparse = (measured > igp ? measured - igp : igp - measured) <=
+			 tolerance;
+
+	if (sparse == bnc->twamp_hybrid_sparse)
+		return;
+	bnc->twamp_hybrid_sparse = sparse;
+
+	if (BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: nexthop %pFX IGP estimate %uus, measured %uus, probing %s",
+			   &bnc->prefix, igp, measured,
+			   sparse ? "sparsely" : "at the normal rate");
+	if (bnc->twamp_registered)
+		bgp_twamp_schedule_collect();
+}
+
+/*
+ * Per-nexthop history of what the agent published, kept in bgpd so the
+ * show commands never touch the segment: operators may poll them as
+ * often as they like without getting in the agent's way.
+ */
+#define BGP_TWAMP_HISTORY_LEN 64
+
+struct bgp_twamp_sample {
+	/* Wall clock time bgpd picked the measurement up */
+	time_t time;
+	/* UINT32_MAX if the round got no reply */
+	uint32_t latency_us;
+	uint16_t loss;
+};
+
+static void bgp_twamp_history_add(struct bgp_nexthop_cache *bnc,
+				  uint32_t latency, uint16_t loss)
+{
+	struct bgp_twamp_sample sample = {
+		.time = time(NULL),
+		.latency_us = latency,
+		.loss = loss,
+	};
+	struct bgp_twamp_sample oldest;
+
+	if (!bnc->twamp_history)
+		bnc->twamp_history = ringbuf_new(BGP_TWAMP_HISTORY_LEN *
+						 sizeof(sample));
+	if (ringbuf_space(bnc->twamp_history) < sizeof(sample))
+		ringbuf_get(bnc->twamp_history, &oldest, sizeof(oldest));
+	ringbuf_put(bnc->twamp_history, &sample, sizeof(sample));
+}
+
+static unsigned int bgp_twamp_history_count(const struct bgp_nexthop_cache *bnc)
+{
+	if (!bnc->twamp_history)
+		return 0;
+	return ringbuf_remain(bnc->twamp_history) /
+	       sizeof(struct bgp_twamp_sample);
+}
+
+/*
+ * Refresh one nexthop's cached latency and loss; returns true if either
+ * changed in a way best-path cares about. Loss crossing a loss threshold
+ * is fast reroute and skips min-dwell and hold-down: a nexthop that has
+ * gone dark is demoted by the very next measurement.
+ */
+static bool bgp_twamp_bnc_refresh(struct bgp_nexthop_cache *bnc, bool fresh)
+{
+	struct in6_addr key;
+	uint32_t vrf_ifindex;
+	uint32_t latency = UINT32_MAX;
+	int64_t last_updated = 0;
+	/* Only traced */
+	uint32_t old_latency __attribute__((unused)) = bnc->twamp_latency;
+	uint16_t loss = 0;
+	bool changed, crossed;
+
+	bnc->twamp_forward = bnc->twamp_reverse = 0;
+	if (bnc->twamp_registered && bgp_twamp_bnc_key(bnc, &key, &vrf_ifindex)) {
+		latency = bgp_twamp_key_latency(&key, vrf_ifindex,
+						bnc->twamp_dscp, &last_updated);
+		loss = bgp_twamp_key_loss(&key, vrf_ifindex, bnc->twamp_dscp);
+		if (latency != UINT32_MAX)
+			bnc->twamp_forward = bgp_twamp_key_forward(&key,
+								   vrf_ifindex,
+								   bnc->twamp_dscp);
+		if (bnc->twamp_forward && latency > bnc->twamp_forward)
+			bnc->twamp_reverse = latency - bnc->twamp_forward;
+		/*
+		 * Twice the forward delay stays comparable with the round
+		 * trips of nexthops measured the old way, and with the
+		 * thresholds
+		 */
+		if (bnc->twamp_forward && bnc->bgp->import_latency_cfg.one_way)
+			latency = MIN((uint64_t)bnc->twamp_forward * 2,
+				      UINT32_MAX - 1);
+		frrtrace(5, frr_bgp, twamp_latency_read, &bnc->prefix,
+			 vrf_ifindex, latency, loss, last_updated);
+		if (fresh)
+			bgp_twamp_history_add(bnc, latency, loss);
+	}
+	/* Down as far as BFD can tell: no fallback, only newer measurements */
+	if (bnc->twamp_invalidated) {
+		if (latency == UINT32_MAX ||
+		    last_updated <= (int64_t)bnc->twamp_invalidated) {
+			bnc->twamp_restored = false;
+			latency = UINT32_MAX;
+			loss = 1000;
+			goto skip_fallback;
+		}
+		bnc->twamp_invalidated = 0;
+	}
+	/* Measured before the restart and nothing newer yet */
+	bnc->twamp_restored = latency != UINT32_MAX &&
+			      last_updated < (int64_t)shm_adopted;
+	/* Agreeing with the last sparse sample, the baseline is the fresher */
+	bgp_twamp_hybrid_update(bnc, latency);
+	if (bnc->twamp_hybrid_sparse)
+		latency = bnc->twamp_igp_latency;
+
+	if (latency == UINT32_MAX)
+		latency = bgp_twamp_bnc_bfd_rtt(bnc);
+	if (latency == UINT32_MAX)
+		latency = bnc->twamp_igp_latency;
+
+skip_fallback:
+	crossed = bgp_twamp_loss_crossed(bnc->twamp_loss, loss);
+	if (crossed) {
+		frrtrace(3, frr_bgp, twamp_loss_reroute, &bnc->prefix,
+			 bnc->twamp_loss, loss);
+		if (BGP_DEBUG(twamp, TWAMP))
+			zlog_debug("BGP TWAMP: nexthop %pFX probe loss %u -> %u permille, re-running best-path",
+				   &bnc->prefix, bnc->twamp_loss, loss);
+	}
+	bnc->twamp_loss = loss;
+
+	changed = bgp_twamp_bnc_adopt(bnc, latency);
+	if (changed)
+		frrtrace(4, frr_bgp, twamp_latency_change, bnc->bgp,
+			 &bnc->prefix, old_latency, bnc->twamp_latency);
+	bnc->twamp_readvertise = bgp_twamp_advertise_update(bnc);
+	return changed || crossed || bnc->twamp_readvertise;
+}
+
+/* Was the slot measuring this nexthop flagged in the dirty snapshot? */
+static bool bgp_twamp_bnc_dirty(const struct bgp_nexthop_cache *bnc,
+				const uint64_t *dirty)
+{
+	struct in6_addr key;
+	uint32_t vrf_ifindex;
+	int i;
+
+	if (!shm || !bnc->twamp_registered ||
+	    !bgp_twamp_bnc_key(bnc, &key, &vrf_ifindex))
+		return false;
+
+	i = twamp_shm_find_class(shm, &key, vrf_ifindex, bnc->twamp_dscp);
+	return i >= 0 && twamp_dirty_test(dirty, i);
+}
+
+/*
+ * Without a measurement of its own, a path goes by the latency and loss
+ * its advertiser measured, if it carries them: an edge router behind a
+ * route reflector then needs no probes to the egress PEs.
+ */
+static bool bgp_twamp_path_advertised(const struct bgp_path_info *ultimate,
+				      uint32_t *latency, uint16_t *loss)
+{
+	const struct bgp_nexthop_cache *bnc = ultimate->nexthop;
+
+	if (bnc && (bnc->twamp_latency != UINT32_MAX || bnc->twamp_loss))
+		return false;
+
+	return ecommunity_latency_present(bgp_attr_get_ecommunity(
+						  ultimate->attr),
+					  latency, loss) != NULL;
+}
+
+uint16_t bgp_twamp_path_loss(struct bgp_path_info *path)
+{
+	struct bgp_path_info *ultimate = bgp_get_imported_bpi_ultimate(path);
+	uint32_t latency;
+	uint16_t loss;
+
+	if (ultimate->peer && ultimate->peer->sort == BGP_PEER_EBGP)
+		return bgp_twamp_egress_loss(ultimate);
+	if (!ultimate->peer || ultimate->peer->sort != BGP_PEER_IBGP)
+		return 0;
+	if (bgp_twamp_path_advertised(ultimate, &latency, &loss))
+		return loss;
+	if (!ultimate->nexthop)
+		return 0;
+
+	return ultimate->nexthop->twamp_loss;
+}
+
+/* The ORR root best-path takes the latency from, if not this router */
+static const struct in_addr *viewpoint;
+
+void bgp_twamp_viewpoint(const struct in_addr *root)
+{
+	viewpoint = root;
+}
+
+uint32_t bgp_twamp_path_latency(struct bgp_path_info *path)
+{
+	struct bgp_path_info *ultimate = bgp_get_imported_bpi_ultimate(path);
+	uint32_t latency;
+	uint16_t loss;
+
+	/* Internet exits, measured towards the destination itself */
+	if (ultimate->peer && ultimate->peer->sort == BGP_PEER_EBGP)
+		return bgp_twamp_egress_latency(ultimate);
+	if (!ultimate->peer || ultimate->peer->sort != BGP_PEER_IBGP)
+		return UINT32_MAX;
+	if (viewpoint)
+		return ultimate->nexthop
+			       ? bgp_twamp_ted_orr_latency(viewpoint,
+							   ultimate->nexthop)
+			       : UINT32_MAX;
+	if (bgp_twamp_path_advertised(ultimate, &latency, &loss))
+		return latency;
+	if (!ultimate->nexthop)
+		return UINT32_MAX;
+
+	return ultimate->nexthop->twamp_latency;
+}
+
+/*
+ * Nothing to resolve for a path the VPN table got from a peer: it is its
+ * own ultimate path and a measurement on its nexthop wins over what it
+ * was advertised with. The rest, unmeasured or leaked in from a local
+ * VRF, takes the long way.
+ */
+uint32_t bgp_twamp_import_latency(struct bgp_path_info *path_vpn)
+{
+	const struct bgp_nexthop_cache *bnc = path_vpn->nexthop;
+
+	if (bnc && bnc->twamp_latency != UINT32_MAX && !viewpoint &&
+	    path_vpn->sub_type != BGP_ROUTE_IMPORTED)
+		return bnc->twamp_latency;
+
+	return bgp_twamp_path_latency(path_vpn);
+}
+
+uint32_t bgp_twamp_path_color(struct bgp *bgp, struct bgp_path_info *path)
+{
+	if (!bgp->import_latency_cfg.enabled ||
+	    !bgp->import_latency_cfg.color_steering)
+		return 0;
+	/* Leaked routes resolve in the instance they came from */
+	if (!path->peer || path->peer->sort != BGP_PEER_IBGP ||
+	    bgp_get_imported_bpi_ultimate(path) != path || !path->nexthop)
+		return 0;
+
+	return path->nexthop->twamp_color;
+}
+
+/* Colour of the first class a latency is within, 0 if beyond them all */
+static uint32_t bgp_twamp_class_color(const struct bgp *bgp,
+				      uint32_t latency)
+{
+	const struct bgp_import_latency_config *cfg = &bgp->import_latency_cfg;
+	unsigned int i;
+
+	if (!cfg->enabled || !cfg->color_steering || latency == UINT32_MAX)
+		return 0;
+
+	for (i = 0; i < cfg->color_class_count; i++)
+		if (latency <= cfg->color_classes[i].upto_us)
+			return cfg->color_classes[i].color;
+	return 0;
+}
+
+/*
+ * Move a nexthop to the policy of its latency class. Only the routes
+ * over it are sent to zebra again, with the new colour on the nexthop:
+ * best-path does not run and nothing goes out to the peers.
+ */
+static void bgp_twamp_color_update(struct bgp_nexthop_cache *bnc)
+{
+	struct bgp_path_info *path, *pi;
+	struct bgp_table *table;
+	uint32_t color;
+	unsigned int count = 0;
+
+	color = bgp_twamp_class_color(bnc->bgp, bnc->twamp_latency);
+	if (color == bnc->twamp_color)
+		return;
+
+	if (BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: nexthop %pFX steered from color %u to %u",
+			   &bnc->prefix, bnc->twamp_color, color);
+	bnc->twamp_color = color;
+
+	LIST_FOREACH (path, &bnc->paths, nh_thread) {
+		if (!path->net || CHECK_FLAG(path->flags, BGP_PATH_REMOVED) ||
+		    !CHECK_FLAG(path->flags,
+				BGP_PATH_SELECTED | BGP_PATH_MULTIPATH))
+			continue;
+		table = bgp_dest_table(path->net);
+		if (table->safi != SAFI_UNICAST)
+			continue;
+
+		/* A multipath goes to zebra with the route it is part of */
+		for (pi = bgp_dest_get_bgp_path_info(path->net); pi;
+		     pi = pi->next)
+			if (CHECK_FLAG(pi->flags, BGP_PATH_SELECTED))
+				break;
+		if (!pi || pi->type != ZEBRA_ROUTE_BGP ||
+		    (pi->sub_type != BGP_ROUTE_NORMAL &&
+		     pi->sub_type != BGP_ROUTE_IMPORTED))
+			continue;
+
+		bgp_zebra_announce(path->net, bgp_dest_get_prefix(path->net),
+				   pi, table->bgp, table->afi, table->safi);
+		count++;
+	}
+
+	if (count && BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: Re-installed %u routes over nexthop %pFX",
+			   count, &bnc->prefix);
+}
+
+void bgp_twamp_color_refresh(struct bgp *bgp)
+{
+	struct bgp_nexthop_cache *bnc;
+	afi_t afi;
+
+	for (afi = AFI_IP; afi < AFI_MAX; afi++)
+		frr_each (bgp_nexthop_cache, &bgp->nexthop_cache_table[afi],
+			  bnc)
+			bgp_twamp_color_update(bnc);
+}
+
+/*
+ * Outbound: stamp an announcement of path with the latency extended
+ * community. The value is what an edge router would see taking this
+ * path from here: the advertised copy of the latency to its nexthop,
+ * plus whatever the path already carried from further downstream, so
+ * it accumulates across next-hop-self ASBRs. Paths without a
+ * measurement are passed on as they came. The value depends on the
+ * nexthop only, so update groups share it and the adj-out duplicate
+ * check drops unchanged re-sends.
+ */
+void bgp_twamp_announce(struct bgp *bgp, struct bgp_path_info *path,
+			struct attr *attr)
+{
+	struct bgp_path_info *ultimate;
+	struct bgp_nexthop_cache *bnc;
+	uint32_t carried = 0;
+	uint16_t carried_loss = 0, loss;
+	uint64_t latency;
+
+	if (!bgp->import_latency_cfg.enabled ||
+	    !bgp->import_latency_cfg.advertise)
+		return;
+
+	ultimate = bgp_get_imported_bpi_ultimate(path);
+	bnc = ultimate->nexthop;
+	if (!bnc || !ultimate->peer || ultimate->peer->sort != BGP_PEER_IBGP ||
+	    bnc->twamp_advertised == UINT32_MAX)
+		return;
+
+	ecommunity_latency_present(bgp_attr_get_ecommunity(attr), &carried,
+				   &carried_loss);
+	latency = MIN((uint64_t)bnc->twamp_advertised + carried,
+		      (uint64_t)UINT32_MAX - 1);
+	/* Independent losses: 1 - (1 - a)(1 - b), in permille */
+	loss = bnc->twamp_advertised_loss + carried_loss -
+	       bnc->twamp_advertised_loss * carried_loss / 1000;
+
+	bgp_attr_set_ecommunity(attr, ecommunity_replace_latency(
+					      bgp_attr_get_ecommunity(attr),
+					      latency, MIN(loss, 1000)));
+}
+
+/*
+ * Paths share a multipath in inverse proportion to the latency of their
+ * nexthop. Nexthops under a microsecond count as 1us, so a measurement
+ * of 0 still has a weight.
+ */
+#define BGP_TWAMP_WEIGHT_SCALE 1000000000ULL
+
+uint64_t bgp_twamp_path_weight(struct bgp_path_info *path)
+{
+	uint32_t latency = bgp_twamp_path_latency(path);
+
+	if (latency == UINT32_MAX)
+		return 0;
+
+	return BGP_TWAMP_WEIGHT_SCALE / MAX(latency, 1U);
+}
+
+/*
+ * Refresh the per-nexthop latency snapshot, so bgp_path_info_cmp() only
+ * ever reads bnc->twamp_latency. With a dirty snapshot only nexthops
+ * whose slot was flagged are re-read, NULL re-reads all of them;
+ * nexthops still sitting on a pending measurement or advertisement are
+ * re-read either way, so dwell time, hold-down and the advertise
+ * interval expire without a new measurement. Nexthops
+ * whose value moved are flagged with twamp_changed, which stays set until
+ * the next re-selection; returns how many moved.
+ */
+static unsigned int bgp_twamp_refresh(const uint64_t *dirty)
+{
+	struct listnode *bnode;
+	struct bgp *bgp;
+	struct bgp_nexthop_cache *bnc;
+	unsigned int changed = 0;
+	bool fresh;
+	afi_t afi;
+
+	pending_nexthops = 0;
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, bnode, bgp))
+		for (afi = AFI_IP; afi < AFI_MAX; afi++)
+			frr_each (bgp_nexthop_cache,
+				  &bgp->nexthop_cache_table[afi], bnc) {
+				/* Flagged: the agent published a new round */
+				fresh = dirty && bgp_twamp_bnc_dirty(bnc, dirty);
+				if (dirty && !fresh && !bnc->twamp_pending_since &&
+				    !bnc->twamp_advertise_pending)
+					continue;
+				if (bgp_twamp_bnc_refresh(bnc, fresh)) {
+					bnc->twamp_changed = true;
+					changed++;
+				}
+				if (bnc->twamp_pending_since ||
+				    bnc->twamp_advertise_pending)
+					pending_nexthops++;
+			}
+
+	stats.nexthops_changed += changed;
+	return changed;
+}
+
+unsigned int bgp_twamp_refresh_nexthops(void)
+{
+	return bgp_twamp_refresh(NULL);
+}
+
+/*
+ * Order of two destinations in their table's walk: a prefix before the
+ * ones it covers, then by address. Nearby destinations then go through
+ * the process queue together.
+ */
+static int bgp_twamp_dest_order(const struct bgp_dest *a,
+				const struct bgp_dest *b)
+{
+	const struct prefix *pa = bgp_dest_get_prefix(a);
+	const struct prefix *pb = bgp_dest_get_prefix(b);
+	uint8_t len, mask;
+	unsigned int bytes;
+	int cmp;
+
+	/* Only IP tables are walked as a trie */
+	if (pa->family != pb->family ||
+	    (pa->family != AF_INET && pa->family != AF_INET6))
+		return prefix_cmp(pa, pb);
+
+	len = MIN(pa->prefixlen, pb->prefixlen);
+	bytes = len / 8;
+	mask = 0xff << (8 - len % 8);
+	cmp = memcmp(pa->u.val, pb->u.val, bytes);
+	if (cmp)
+		return cmp;
+	if (len % 8 && (pa->u.val[bytes] & mask) != (pb->u.val[bytes] & mask))
+		return (pa->u.val[bytes] & mask) < (pb->u.val[bytes] & mask)
+			       ? -1
+			       : 1;
+	return numcmp(pa->prefixlen, pb->prefixlen);
+}
+
+static int bgp_twamp_path_order(const void *a, const void *b)
+{
+	const struct bgp_path_info *pa = *(struct bgp_path_info *const *)a;
+	const struct bgp_path_info *pb = *(struct bgp_path_info *const *)b;
+	const struct bgp_table *ta = bgp_dest_table(pa->net);
+	const struct bgp_table *tb = bgp_dest_table(pb->net);
+
+	if (ta != tb)
+		return ta < tb ? -1 : 1;
+	if (pa->net != pb->net)
+		return bgp_twamp_dest_order(pa->net, pb->net);
+	return 0;
+}
+
+/* Drop what is left of a pass, unlocking its paths */
+static void bgp_twamp_reevaluate_flush(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < reeval.count; i++)
+		bgp_path_info_unlock(reeval.paths[i]);
+	XFREE(MTYPE_BGP_TWAMP_REEVAL, reeval.paths);
+	memset(&reeval, 0, sizeof(reeval));
+}
+
+static void bgp_twamp_reevaluate_event(struct event *thread);
+
+/*
+ * Re-run selection only for paths hung off the nexthops flagged since
+ * the last pass, without touching the rest of the RIB. VPN paths are
+ * re-imported into the VRFs; other paths are re-processed in place where
+ * the latency step is enabled.
+ *
+ * Re-importing can add/remove leaked paths on the same nexthop lists, so
+ * the candidates are collected first and processed afterwards, sorted
+ * into table order with each destination queued once.
+ *
+ * Where the advertised latency moved, the selected paths are flagged as
+ * changed so the route goes out again even if best-path stays put.
+ *
+ * A pass over a large part of the RIB is time-sliced, picking up from an
+ * event so keepalives are not held up. Nexthops flagged in between join
+ * the rest of the pass.
+ *
+ * Latency nexthop groups are replaced up front, see bgp_twamp_nhg.c.
+ *
+ * An instance steering by colour moves the nexthop to the policy of its
+ * class instead; best-path only runs again for loss and readvertising.
+ */
+static void bgp_twamp_reevaluate_changed(void)
+{
+	struct listnode *bnode;
+	struct bgp *bgp;
+	struct bgp_nexthop_cache *bnc;
+	struct bgp_path_info *path;
+	struct bgp_table *table;
+	struct timeval slice;
+	unsigned int added;
+	afi_t afi;
+
+	EVENT_OFF(reevaluate_ev);
+	monotime(&slice);
+
+	/* The FIB moves with the groups first, the routes follow */
+	bgp_twamp_nhg_reselect();
+
+	if (!reeval.count)
+		monotime(&reeval.started);
+	added = reeval.count;
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, bnode, bgp)) {
+		for (afi = AFI_IP; afi < AFI_MAX; afi++) {
+			frr_each (bgp_nexthop_cache,
+				  &bgp->nexthop_cache_table[afi], bnc) {
+				if (!bnc->twamp_changed)
+					continue;
+				bnc->twamp_changed = false;
+				if (bgp->import_latency_cfg.color_steering) {
+					bgp_twamp_color_update(bnc);
+					if (!bnc->twamp_readvertise &&
+					    !bgp->import_latency_cfg
+						     .loss_threshold_permille)
+						continue;
+				}
+				LIST_FOREACH (path, &bnc->paths, nh_thread) {
+					if (!path->net ||
+					    !bgp_twamp_path_wanted(path))
+						continue;
+					if (bnc->twamp_readvertise &&
+					    CHECK_FLAG(path->flags,
+						       BGP_PATH_SELECTED))
+						bgp_path_info_set_flag(
+							path->net, path,
+							BGP_PATH_ATTR_CHANGED);
+					if (reeval.count == reeval.alloc) {
+						reeval.alloc =
+							MAX(2 * reeval.alloc,
+							    64U);
+						reeval.paths = XREALLOC(
+							MTYPE_BGP_TWAMP_REEVAL,
+							reeval.paths,
+							reeval.alloc *
+								sizeof(*reeval.paths));
+					}
+					reeval.paths[reeval.count++] =
+						bgp_path_info_lock(path);
+				}
+				bnc->twamp_readvertise = false;
+			}
+		}
+	}
+
+	/* What was flagged while paused is sorted in with what is left */
+	if (reeval.count > added) {
+		reeval.last = NULL;
+		if (reeval.count - reeval.next > 1)
+			qsort(reeval.paths + reeval.next,
+			      reeval.count - reeval.next,
+			      sizeof(*reeval.paths), bgp_twamp_path_order);
+	}
+
+	for (; reeval.next < reeval.count; reeval.next++) {
+		if (event_yield(bm->master, bgp_twamp_reevaluate_event, NULL,
+				&reevaluate_ev)) {
+			bgp_twamp_timing_add(&stats.reevaluate, &slice);
+			return;
+		}
+
+		path = reeval.paths[reeval.next];
+		table = bgp_dest_table(path->net);
+		bgp = table->bgp;
+
+		if (table->safi == SAFI_MPLS_VPN) {
+			vpn_leak_to_vrf_reevaluate(bgp, path);
+			stats.reimports++;
+		}
+		if (path->net != reeval.last &&
+		    bgp->import_latency_cfg.enabled &&
+		    (table->safi != SAFI_MPLS_VPN ||
+		     CHECK_FLAG(path->flags, BGP_PATH_ATTR_CHANGED))) {
+			bgp_process(bgp, path->net, table->afi, table->safi);
+			reeval.last = path->net;
+			reeval.dests++;
+		}
+	}
+
+	if (reeval.count && BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: Re-ran selection for %u paths, %u destinations",
+			   reeval.count, reeval.dests);
+	bgp_twamp_timing_add(&stats.reevaluate, &slice);
+	if (reeval.count) {
+		frrtrace(3, frr_bgp, twamp_reevaluate, reeval.count,
+			 reeval.dests, monotime_since(&reeval.started, NULL));
+		stats.passes++;
+		stats.paths += reeval.count;
+		stats.dests += reeval.dests;
+		stats.pass_max_us =
+			MAX(stats.pass_max_us,
+			    (uint64_t)monotime_since(&reeval.started, NULL));
+	}
+	bgp_twamp_reevaluate_flush();
+}
+
+static void bgp_twamp_reevaluate_event(struct event *thread)
+{
+	bgp_twamp_reevaluate_changed();
+}
+
+/*
+ * Latency moves trickle in a few nexthops at a time. Instances can ask
+ * for them to be merged over a window before best-path runs again; with
+ * several, the shortest window wins.
+ */
+static void bgp_twamp_reevaluate_schedule(void)
+{
+	struct listnode *node;
+	struct bgp *bgp;
+	uint32_t window = UINT32_MAX;
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		if (bgp->import_latency_cfg.enabled)
+			window = MIN(window,
+				     bgp->import_latency_cfg.coalesce_msec);
+
+	if (window == 0 || window == UINT32_MAX) {
+		bgp_twamp_reevaluate_changed();
+		return;
+	}
+
+	event_add_timer_msec(bm->master, bgp_twamp_reevaluate_event, NULL,
+			     window, &reevaluate_ev);
+}
+
+/*
+ * Push the agent-wide settings of the enabled instances into the segment.
+ * Only settings moved off their defaults are pushed, so agents keep their
+ * command line until bgpd is told otherwise. Several instances merge to
+ * the strictest: the shortest cycle and damping threshold, the most
+ * packets. There is one reflector port per agent; the default instance's
+ * wins, else the first instance setting one.
+ */
+static void bgp_twamp_config_push(void)
+{
+	struct twamp_shm_config cfg = {};
+	struct listnode *bnode;
+	struct bgp *bgp;
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, bnode, bgp)) {
+		const struct bgp_import_latency_config *c =
+			&bgp->import_latency_cfg;
+
+		if (!c->enabled)
+			continue;
+		if (c->probe_cycle_sec != 60 &&
+		    (!(cfg.present & TWAMP_CFG_PROBE_CYCLE) ||
+		     c->probe_cycle_sec < cfg.probe_cycle_sec)) {
+			cfg.present |= TWAMP_CFG_PROBE_CYCLE;
+			cfg.probe_cycle_sec = c->probe_cycle_sec;
+		}
+		if (c->packet_count != 3 &&
+		    (!(cfg.present & TWAMP_CFG_PACKET_COUNT) ||
+		     c->packet_count > cfg.packet_count)) {
+			cfg.present |= TWAMP_CFG_PACKET_COUNT;
+			cfg.packet_count = c->packet_count;
+		}
+		if (c->damping_threshold_us != 50000 &&
+		    (!(cfg.present & TWAMP_CFG_DAMPING) ||
+		     c->damping_threshold_us < cfg.damping_threshold_us)) {
+			cfg.present |= TWAMP_CFG_DAMPING;
+			cfg.damping_threshold_us = c->damping_threshold_us;
+		}
+		if (c->port != 862 &&
+		    (!(cfg.present & TWAMP_CFG_PORT) ||
+		     bgp->inst_type == BGP_INSTANCE_TYPE_DEFAULT)) {
+			cfg.present |= TWAMP_CFG_PORT;
+			cfg.port = c->port;
+		}
+	}
+
+	if (cfg.present == shm->config.present &&
+	    cfg.probe_cycle_sec == shm->config.probe_cycle_sec &&
+	    cfg.packet_count == shm->config.packet_count &&
+	    cfg.damping_threshold_us == shm->config.damping_threshold_us &&
+	    cfg.port == shm->config.port)
+		return;
+
+	twamp_shm_config_write(shm, &cfg);
+	if (BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: Pushed agent config: cycle %us, %u packets, damping %uus, port %u (set 0x%x)",
+			   cfg.probe_cycle_sec, cfg.packet_count,
+			   cfg.damping_threshold_us, cfg.port, cfg.present);
+}
+
+/* New measurements: instances in read-only mode may have waited for them */
+static void bgp_twamp_update_delay_check(void)
+{
+	struct listnode *node;
+	struct bgp *bgp;
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		if (bgp_update_delay_active(bgp))
+			bgp_check_update_delay(bgp);
+}
+
+/*
+ * Register the address of every nexthop cache entry that carries an
+ * iBGP path, in every instance: with route reflectors and VPN leaking
+ * the nexthops of interest live in whichever instance holds the paths,
+ * not necessarily the one the feature is configured in. The segment is
+ * shared by all instances, so the diff is always taken against the
+ * full set. Each nexthop is registered in the VRF it is resolved in,
+ * once, with the merged profile of the instances relying on it.
+ */
+static void bgp_twamp_collect(void)
+{
+	struct listnode *bnode;
+	struct bgp *bgp;
+	struct bgp_nexthop_cache *bnc;
+	struct bgp_twamp_target *targets, strictest = {};
+	struct timeval start;
+	unsigned int n = 0, max = 0, links;
+	afi_t afi;
+
+	/* Shutting down: the membership stays for the next bgpd */
+	if (bm->terminating)
+		return;
+
+	monotime(&start);
+
+	bgp_twamp_config_push();
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, bnode, bgp)) {
+		bgp_twamp_target_merge(&strictest, bgp, false);
+		for (afi = AFI_IP; afi < AFI_MAX; afi++)
+			max += bgp_nexthop_cache_count(
+				&bgp->nexthop_cache_table[afi]);
+	}
+
+	max += bgp_twamp_collect_links(NULL);
+
+	targets = XCALLOC(MTYPE_BGP_TWAMP_TARGETS,
+			  MAX(max, 1U) * sizeof(*targets));
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, bnode, bgp))
+		for (afi = AFI_IP; afi < AFI_MAX; afi++)
+			frr_each (bgp_nexthop_cache,
+				  &bgp->nexthop_cache_table[afi], bnc) {
+				bnc->twamp_registered =
+					bgp_twamp_bnc_key(bnc, &targets[n].key,
+							  &targets[n]
+								   .vrf_ifindex) &&
+					bgp_twamp_bnc_wanted(bnc, &targets[n],
+							     &strictest);
+				if (bnc->twamp_registered)
+					bnc->twamp_dscp = targets[n++].dscp;
+				else
+					memset(&targets[n], 0,
+					       sizeof(targets[n]));
+			}
+
+	links = bgp_twamp_collect_links(&targets[n]);
+
+	bgp_twamp_sync_nexthops(targets, n + links);
+	XFREE(MTYPE_BGP_TWAMP_TARGETS, targets);
+
+	if (bgp_twamp_refresh_nexthops())
+		bgp_twamp_reevaluate_schedule();
+	/* What read-only mode was waiting on is registered now */
+	bgp_twamp_update_delay_check();
+	bgp_twamp_timing_add(&stats.collect, &start);
+
+	if (BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: Collected %u iBGP nexthops, %u links", n,
+			   links);
+}
+
+static void bgp_twamp_collect_event(struct event *thread)
+{
+	bgp_twamp_collect();
+}
+
+/* Re-collect once the current burst of nexthop changes is processed */
+static void bgp_twamp_schedule_collect(void)
+{
+	if (shm)
+		event_add_event(bm->master, bgp_twamp_collect_event, NULL, 0,
+				&collect_ev);
+}
+
+void bgp_twamp_links_changed(void)
+{
+	bgp_twamp_schedule_collect();
+}
+
+void bgp_twamp_bnc_path_add(struct bgp_nexthop_cache *bnc,
+			    struct bgp_path_info *path)
+{
+	if (path->peer && path->peer->sort == BGP_PEER_IBGP)
+		bgp_twamp_ted_bnc_add(bnc);
+
+	if (bnc->twamp_registered || !bgp_twamp_path_probed(path))
+		return;
+	bnc->twamp_registered = true;
+	/*
+	 * Back after a restart: the latency carried over is there before
+	 * the path's first best-path run, not one collect later
+	 */
+	if (restore_ev)
+		bgp_twamp_bnc_refresh(bnc, false);
+	bgp_twamp_schedule_collect();
+}
+
+/*
+ * The path may already be flagged removed, so any iBGP path leaving a
+ * monitored nexthop may have been its last wanted one
+ */
+void bgp_twamp_bnc_path_del(struct bgp_nexthop_cache *bnc,
+			    struct bgp_path_info *path)
+{
+	if (bnc->twamp_registered && path->peer &&
+	    path->peer->sort == BGP_PEER_IBGP)
+		bgp_twamp_schedule_collect();
+}
+
+void bgp_twamp_bnc_free(struct bgp_nexthop_cache *bnc)
+{
+	if (bnc->twamp_history)
+		ringbuf_del(bnc->twamp_history);
+	bnc->twamp_history = NULL;
+	bgp_twamp_nhg_bnc_free(bnc);
+	if (bnc->twamp_registered)
+		bgp_twamp_schedule_collect();
+}
+
+void bgp_twamp_import_changed(void)
+{
+	bgp_twamp_schedule_collect();
+}
+
+void bgp_twamp_source_changed(void)
+{
+	if (bgp_twamp_refresh_nexthops())
+		bgp_twamp_reevaluate_schedule();
+}
+
+/* Only the nexthops that are the peer's own address can use its session */
+void bgp_twamp_bfd_rtt_changed(struct peer *peer)
+{
+	struct bgp_nexthop_cache *bnc;
+	struct prefix p;
+	unsigned int changed = 0;
+
+	if (!peer->bgp || !peer->bgp->import_latency_cfg.bfd_echo ||
+	    !sockunion2hostprefix(&peer->connection->su, &p))
+		return;
+
+	frr_each (bgp_nexthop_cache,
+		  &peer->bgp->nexthop_cache_table[family2afi(p.family)], bnc) {
+		if (!prefix_same(&bnc->prefix, &p))
+			continue;
+		if (bgp_twamp_bnc_refresh(bnc, false)) {
+			bnc->twamp_changed = true;
+			changed++;
+		}
+	}
+
+	if (changed)
+		bgp_twamp_reevaluate_schedule();
+}
+
+void bgp_twamp_bfd_status(struct peer *peer, bool up)
+{
+	struct bgp_nexthop_cache *bnc;
+	struct prefix p;
+	unsigned int changed = 0;
+	time_t now = time(NULL);
+
+	if (!peer->bgp || !peer->bgp->import_latency_cfg.enabled ||
+	    !sockunion2hostprefix(&peer->connection->su, &p))
+		return;
+
+	frr_each (bgp_nexthop_cache,
+		  &peer->bgp->nexthop_cache_table[family2afi(p.family)], bnc) {
+		if (!prefix_same(&bnc->prefix, &p))
+			continue;
+		if (up ? !bnc->twamp_invalidated : bnc->twamp_invalidated)
+			continue;
+
+		bnc->twamp_invalidated = up ? 0 : now;
+		if (bgp_twamp_bnc_refresh(bnc, false)) {
+			bnc->twamp_changed = true;
+			changed++;
+		}
+	}
+	if (!changed)
+		return;
+
+	if (BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: peer %s BFD %s, %u nexthops %s", peer->host,
+			   up ? "up" : "down", changed,
+			   up ? "measured again" : "invalidated");
+
+	/* Failover runs at BFD detection time, not at the coalesce window */
+	if (up)
+		bgp_twamp_reevaluate_schedule();
+	else
+		bgp_twamp_reevaluate_changed();
+}
+
+void bgp_twamp_collect_nexthops(struct bgp *bgp)
+{
+	if (!bgp || !bgp->import_latency_cfg.enabled) {
+		if (BGP_DEBUG(twamp, TWAMP))
+			zlog_debug("BGP TWAMP: Feature not enabled or BGP instance invalid");
+		return;
+	}
+
+	if (!shm) {
+		zlog_warn("BGP TWAMP: Shared memory not initialized");
+		return;
+	}
+
+	bgp_twamp_collect();
+}
+
+bool bgp_twamp_initial_pending(struct bgp *bgp)
+{
+	struct bgp_nexthop_cache *bnc;
+	afi_t afi;
+
+	if (!shm || !bgp_twamp_probes(bgp))
+		return false;
+
+	/* Nexthops came in that are not registered with the agent yet */
+	if (collect_ev)
+		return true;
+
+	for (afi = AFI_IP; afi < AFI_MAX; afi++)
+		frr_each (bgp_nexthop_cache, &bgp->nexthop_cache_table[afi],
+			  bnc)
+			if (bnc->twamp_registered &&
+			    bnc->twamp_latency == UINT32_MAX &&
+			    CHECK_FLAG(bnc->flags, BGP_NEXTHOP_VALID))
+				return true;
+	return false;
+}
+    
+
+/* Cleanup shared memory */
+/* Check if measurements have been updated */
+static void bgp_twamp_check_measurements(struct event *thread)
+{
+	bool dirty;
+	unsigned int changed = 0;
+	struct timeval start;
+	
+	if (!shm)
+		return;
+
+	monotime(&start);
+	
+	/*
+	 * Only slots the agent flagged since the last check need a look,
+	 * plus peers waiting out dwell time or hold-down.
+	 */
+	dirty = twamp_shm_take_dirty(shm, dirty_snap);
+
+	/* Only paths via peers whose latency moved need a new pass */
+	if (dirty || pending_nexthops)
+		changed = bgp_twamp_refresh(dirty_snap);
+	/* The egress segment shares the notification, best-path runs from it */
+	stats.egress_changed += bgp_twamp_egress_refresh();
+	if (dirty)
+		stats.rounds++;
+	bgp_twamp_timing_add(&stats.refresh, &start);
+
+	frrtrace(3, frr_bgp, twamp_measurements,
+		 __atomic_load_n(&shm->sequence, __ATOMIC_RELAXED), dirty,
+		 changed);
+	if (changed) {
+		if (BGP_DEBUG(twamp, TWAMP))
+			zlog_debug("BGP TWAMP: Measurements updated (seq %u), %u nexthops changed",
+				   __atomic_load_n(&shm->sequence,
+						   __ATOMIC_RELAXED),
+				   changed);
+		bgp_twamp_reevaluate_schedule();
+		bgp_twamp_update_delay_check();
+	}
+	
+	bgp_twamp_schedule_check();
+}
+
+
+void bgp_twamp_cleanup(struct bgp *bgp)
+{
+    if (!bgp->twamp_attached)
+        return;
+    bgp->twamp_attached = false;
+
+    /* Other instances still use the segment: just drop what was ours */
+    if (--shm_refs) {
+        bgp_twamp_schedule_collect();
+        return;
+    }
+
+    /* Check if not initialized */
+    if (!shm && shm_fd < 0) {
+        zlog_info("BGP TWAMP: Nothing to cleanup");
+        return;
+    }
+    
+    EVENT_OFF(measurement_check_timer);
+    EVENT_OFF(collect_ev);
+    EVENT_OFF(restore_ev);
+    EVENT_OFF(reevaluate_ev);
+    bgp_twamp_reevaluate_flush();
+    bgp_twamp_notify_fini();
+
+    /*
+     * Shutting down, the segment is left for the next bgpd to adopt;
+     * only unconfiguring the feature removes it
+     */
+    if (bm->terminating && shm) {
+        munmap(shm, shm_size);
+        shm = NULL;
+        close(shm_fd);
+        shm_fd = -1;
+        XFREE(MTYPE_BGP_TWAMP_SLOTS, dirty_snap);
+        XFREE(MTYPE_BGP_TWAMP_SLOTS, free_map);
+        XFREE(MTYPE_BGP_TWAMP_SLOTS, restored_map);
+        zlog_info("BGP TWAMP: Kept shared memory for the next start");
+        return;
+    }
+
+    if (shm) {
+        pthread_mutex_destroy(&shm->writer_lock);
+        munmap(shm, shm_size);
+        shm = NULL;
+        XFREE(MTYPE_BGP_TWAMP_SLOTS, dirty_snap);
+        XFREE(MTYPE_BGP_TWAMP_SLOTS, free_map);
+        XFREE(MTYPE_BGP_TWAMP_SLOTS, restored_map);
+
+        /* Drop the per-nexthop snapshots now that there is no data */
+        bgp_twamp_refresh_nexthops();
+    }
+    
+    if (shm_fd >= 0) {
+        close(shm_fd);
+        shm_unlink(TWAMP_SHM_NAME);
+        shm_fd = -1;
+    }
+    
+    zlog_info("BGP TWAMP: Cleaned up shared memory");
+}
+/* Nexthops worth listing: measured, or carrying a figure from any source */
+static bool bgp_twamp_bnc_shown(const struct bgp_nexthop_cache *bnc)
+{
+	return bnc->twamp_registered || bnc->twamp_latency != UINT32_MAX ||
+	       bnc->twamp_igp_latency != UINT32_MAX || bnc->twamp_history;
+}
+
+static void bgp_twamp_latency_str(char *buf, size_t len, uint32_t latency)
+{
+	if (latency == UINT32_MAX)
+		strlcpy(buf, "-", len);
+	else
+		snprintf(buf, len, "%u.%03ums", latency / 1000, latency % 1000);
+}
+
+static const char *bgp_twamp_bnc_state(const struct bgp_nexthop_cache *bnc)
+{
+	if (bnc->twamp_invalidated)
+		return "bfd-down";
+	if (bnc->twamp_held)
+		return "held";
+	if (bnc->twamp_pending_since)
+		return "pending";
+	if (bnc->twamp_hybrid_sparse)
+		return "sparse";
+	if (bnc->twamp_restored)
+		return "restored";
+	return bnc->twamp_registered ? "probed" : "-";
+}
+
+/*
+ * What "show bgp twamp" prints, copied out on the main thread so that
+ * the output can be formatted on the vty worker while bgpd goes on.
+ */
+struct bgp_twamp_show_nh {
+	struct prefix prefix;
+	char vrf[VRF_NAMSIZ + 1];
+	uint32_t latency, igp, advertised, pending, color, forward, reverse;
+	uint16_t loss;
+	uint8_t dscp;
+	bool probed, pending_set, held, sparse, restored, bfd_down;
+	const char *state;
+	unsigned int samples;
+};
+
+struct bgp_twamp_show {
+	bool json;
+	bool attached, notify;
+	uint32_t capacity, nh_count, sequence;
+
+	unsigned int count;
+	struct bgp_twamp_show_nh nh[];
+};
+
+static void bgp_twamp_show_nh_json(json_object *json_nexthops,
+				   const struct bgp_twamp_show_nh *nh)
+{
+	json_object *json = json_object_new_object();
+
+	json_object_string_addf(json, "nexthop", "%pFX", &nh->prefix);
+	json_object_string_add(json, "vrf", nh->vrf);
+	json_object_boolean_add(json, "probed", nh->probed);
+	json_object_int_add(json, "dscp", nh->dscp);
+	if (nh->latency != UINT32_MAX)
+		json_object_int_add(json, "latencyUs", nh->latency);
+	if (nh->forward) {
+		json_object_int_add(json, "forwardLatencyUs", nh->forward);
+		json_object_int_add(json, "reverseLatencyUs", nh->reverse);
+	}
+	json_object_int_add(json, "lossPermille", nh->loss);
+	if (nh->igp != UINT32_MAX)
+		json_object_int_add(json, "igpLatencyUs", nh->igp);
+	if (nh->advertised != UINT32_MAX)
+		json_object_int_add(json, "advertisedLatencyUs",
+				    nh->advertised);
+	if (nh->pending_set)
+		json_object_int_add(json, "pendingLatencyUs", nh->pending);
+	json_object_boolean_add(json, "held", nh->held);
+	json_object_boolean_add(json, "sparse", nh->sparse);
+	json_object_boolean_add(json, "restored", nh->restored);
+	json_object_boolean_add(json, "bfdDown", nh->bfd_down);
+	if (nh->color)
+		json_object_int_add(json, "steeringColor", nh->color);
+	json_object_int_add(json, "samples", nh->samples);
+	json_object_array_add(json_nexthops, json);
+}
+
+/* On the vty worker: only the snapshot is looked at */
+static void bgp_twamp_show_output(struct vty *vty, void *arg)
+{
+	const struct bgp_twamp_show *show = arg;
+	const struct bgp_twamp_show_nh *nh;
+	json_object *json, *json_nexthops;
+	char latency[16], igp[16];
+	unsigned int i;
+
+	if (show->json) {
+		json = json_object_new_object();
+		json_nexthops = json_object_new_array();
+		json_object_boolean_add(json, "attached", show->attached);
+		if (show->attached) {
+			json_object_int_add(json, "capacity", show->capacity);
+			json_object_int_add(json, "nexthops", show->nh_count);
+			json_object_int_add(json, "sequence", show->sequence);
+			json_object_boolean_add(json, "agentNotify",
+						show->notify);
+		}
+		for (i = 0; i < show->count; i++)
+			bgp_twamp_show_nh_json(json_nexthops, &show->nh[i]);
+		json_object_object_add(json, "nexthopList", json_nexthops);
+		vty_json(vty, json);
+		return;
+	}
+
+	if (show->attached)
+		vty_out(vty,
+			"Shared segment: %u of %u slots in use, sequence %u, agent notification %s\n",
+			show->nh_count, show->capacity, show->sequence,
+			show->notify ? "on" : "off");
+	else
+		vty_out(vty, "Shared segment: not attached\n");
+
+	vty_out(vty, "\n%-39s %-16s %-4s %-12s %-7s %-12s %-8s %s\n",
+		"Nexthop", "VRF", "DSCP", "Latency", "Loss", "IGP", "State",
+		"Samples");
+
+	for (i = 0; i < show->count; i++) {
+		nh = &show->nh[i];
+		bgp_twamp_latency_str(latency, sizeof(latency), nh->latency);
+		bgp_twamp_latency_str(igp, sizeof(igp), nh->igp);
+		vty_out(vty, "%-39pFX %-16s %-4u %-12s %3u.%u%%  %-12s %-8s %u\n",
+			&nh->prefix, nh->vrf, nh->dscp, latency, nh->loss / 10,
+			nh->loss % 10, igp, nh->state, nh->samples);
+	}
+}
+
+static void bgp_twamp_show_free(void *arg)
+{
+	XFREE(MTYPE_BGP_TWAMP_SHOW, arg);
+}
+
+DEFUN(show_bgp_twamp, show_bgp_twamp_cmd,
+      "show bgp twamp [json]",
+      SHOW_STR
+      BGP_STR
+      "Latency measurement of nexthops\n"
+      JSON_STR)
+{
+	struct bgp_twamp_show *show;
+	struct bgp_twamp_show_nh *nh;
+	struct listnode *node;
+	struct bgp *bgp;
+	struct bgp_nexthop_cache *bnc;
+	unsigned int count = 0;
+	afi_t afi;
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		for (afi = AFI_IP; afi < AFI_MAX; afi++)
+			frr_each (bgp_nexthop_cache,
+				  &bgp->nexthop_cache_table[afi], bnc)
+				if (bgp_twamp_bnc_shown(bnc))
+					count++;
+
+	show = XCALLOC(MTYPE_BGP_TWAMP_SHOW,
+		       sizeof(*show) + count * sizeof(show->nh[0]));
+	show->json = use_json(argc, argv);
+	show->attached = shm != NULL;
+	show->notify = notify_fd >= 0;
+
+	/* Header fields only, read as the agent's own readers do */
+	if (shm) {
+		show->capacity = shm->hdr.capacity;
+		show->nh_count = __atomic_load_n(&shm->nh_count,
+						 __ATOMIC_RELAXED);
+		show->sequence = __atomic_load_n(&shm->sequence,
+						 __ATOMIC_RELAXED);
+	}
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		for (afi = AFI_IP; afi < AFI_MAX; afi++)
+			frr_each (bgp_nexthop_cache,
+				  &bgp->nexthop_cache_table[afi], bnc) {
+				if (!bgp_twamp_bnc_shown(bnc))
+					continue;
+				nh = &show->nh[show->count++];
+				prefix_copy(&nh->prefix, &bnc->prefix);
+				strlcpy(nh->vrf, bgp->name_pretty,
+					sizeof(nh->vrf));
+				nh->latency = bnc->twamp_latency;
+				nh->igp = bnc->twamp_igp_latency;
+				nh->advertised = bnc->twamp_advertised;
+				nh->pending = bnc->twamp_pending;
+				nh->color = bnc->twamp_color;
+				nh->loss = bnc->twamp_loss;
+				nh->dscp = bnc->twamp_dscp;
+				nh->forward = bnc->twamp_forward;
+				nh->reverse = bnc->twamp_reverse;
+				nh->probed = bnc->twamp_registered;
+				nh->pending_set = !!bnc->twamp_pending_since;
+				nh->held = bnc->twamp_held;
+				nh->sparse = bnc->twamp_hybrid_sparse;
+				nh->restored = bnc->twamp_restored;
+				nh->bfd_down = !!bnc->twamp_invalidated;
+				nh->state = bgp_twamp_bnc_state(bnc);
+				nh->samples = bgp_twamp_history_count(bnc);
+			}
+
+	return vty_defer(vty, bgp_twamp_show_output, show,
+			 bgp_twamp_show_free);
+}
+
+static void bgp_twamp_show_history(struct vty *vty, json_object *json_vrfs,
+				   const struct bgp_nexthop_cache *bnc)
+{
+	json_object *json = NULL, *json_samples = NULL, *json_sample;
+	struct bgp_twamp_sample sample;
+	unsigned int i, n = bgp_twamp_history_count(bnc);
+	char timebuf[32], latency[16];
+	struct tm tm;
+
+	if (json_vrfs) {
+		json = json_object_new_object();
+		json_samples = json_object_new_array();
+	} else {
+		vty_out(vty, "Nexthop %pFX, VRF %s, %u samples\n", &bnc->prefix,
+			bnc->bgp->name_pretty, n);
+		if (n)
+			vty_out(vty, "  %-20s %-12s %s\n", "Time", "Latency",
+				"Loss");
+	}
+
+	for (i = 0; i < n; i++) {
+		ringbuf_peek(bnc->twamp_history, i * sizeof(sample), &sample,
+			     sizeof(sample));
+		if (json) {
+			json_sample = json_object_new_object();
+			json_object_int_add(json_sample, "time", sample.time);
+			if (sample.latency_us != UINT32_MAX)
+				json_object_int_add(json_sample, "latencyUs",
+						    sample.latency_us);
+			json_object_int_add(json_sample, "lossPermille",
+					    sample.loss);
+			json_object_array_add(json_samples, json_sample);
+			continue;
+		}
+		localtime_r(&sample.time, &tm);
+		strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M:%S", &tm);
+		if (sample.latency_us == UINT32_MAX)
+			strlcpy(latency, "no reply", sizeof(latency));
+		else
+			bgp_twamp_latency_str(latency, sizeof(latency),
+					      sample.latency_us);
+		vty_out(vty, "  %-20s %-12s %u.%u%%\n", timebuf, latency,
+			sample.loss / 10, sample.loss % 10);
+	}
+
+	if (json) {
+		json_object_object_add(json, "samples", json_samples);
+		json_object_object_add(json_vrfs, bnc->bgp->name_pretty, json);
+	}
+}
+
+DEFUN(show_bgp_twamp_nexthop_history, show_bgp_twamp_nexthop_history_cmd,
+      "show bgp twamp nexthop <A.B.C.D|X:X::X:X> history [json]",
+      SHOW_STR
+      BGP_STR
+      "Latency measurement of nexthops\n"
+      "A single nexthop\n"
+      "IPv4 nexthop address\n"
+      "IPv6 nexthop address\n"
+      "Last measurements published by the agent\n"
+      JSON_STR)
+{
+	bool uj = use_json(argc, argv);
+	json_object *json = NULL;
+	struct listnode *node;
+	struct bgp *bgp;
+	struct bgp_nexthop_cache *bnc;
+	struct prefix p;
+	bool found = false;
+	afi_t afi;
+
+	if (!str2prefix(argv[4]->arg, &p)) {
+		vty_out(vty, "%% Malformed address: %s\n", argv[4]->arg);
+		return CMD_WARNING;
+	}
+
+	if (uj)
+		json = json_object_new_object();
+
+	/* The same address may be a nexthop in several VRFs */
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		for (afi = AFI_IP; afi < AFI_MAX; afi++)
+			frr_each (bgp_nexthop_cache,
+				  &bgp->nexthop_cache_table[afi], bnc) {
+				if (!prefix_same(&p, &bnc->prefix))
+					continue;
+				if (found && !uj)
+					vty_out(vty, "\n");
+				bgp_twamp_show_history(vty, json, bnc);
+				found = true;
+			}
+
+	if (uj)
+		vty_json(vty, json);
+	else if (!found)
+		vty_out(vty, "%% No such nexthop: %s\n", argv[4]->arg);
+	return CMD_SUCCESS;
+}
+
+static void bgp_twamp_timing_show(struct vty *vty, json_object *json,
+				   const char *name,
+				   const struct bgp_twamp_timing *timing)
+{
+	json_object *json_timing;
+
+	if (json) {
+		json_timing = json_object_new_object();
+		json_object_int_add(json_timing, "runs", timing->runs);
+		json_object_int_add(json_timing, "totalUs", timing->total_us);
+		json_object_int_add(json_timing, "maxUs", timing->max_us);
+		json_object_object_add(json, name, json_timing);
+		return;
+	}
+	vty_out(vty, "  %-22s %10" PRIu64 " runs, %" PRIu64 " ms total, %" PRIu64 " us longest\n",
+		name, timing->runs, timing->total_us / 1000, timing->max_us);
+}
+
+DEFUN(show_bgp_twamp_statistics, show_bgp_twamp_statistics_cmd,
+      "show bgp twamp statistics [json]",
+      SHOW_STR
+      BGP_STR
+      "Latency measurement of nexthops\n"
+      "What the feature costs in work and memory\n"
+      JSON_STR)
+{
+	bool uj = use_json(argc, argv);
+	json_object *json = NULL, *json_work = NULL, *json_vrfs = NULL;
+	json_object *json_vrf, *json_mtypes = NULL, *json_mtype;
+	struct listnode *node;
+	struct bgp *bgp;
+	struct memtype *mt;
+
+	if (uj) {
+		json = json_object_new_object();
+		json_work = json_object_new_object();
+		json_vrfs = json_object_new_object();
+		json_mtypes = json_object_new_object();
+		json_object_int_add(json, "measurementRounds", stats.rounds);
+		json_object_int_add(json, "nexthopsChanged",
+				    stats.nexthops_changed);
+		json_object_int_add(json, "egressDestinationsChanged",
+				    stats.egress_changed);
+		json_object_int_add(json, "reevaluationPasses", stats.passes);
+		json_object_int_add(json, "pathsReevaluated", stats.paths);
+		json_object_int_add(json, "destinationsReprocessed",
+				    stats.dests);
+		json_object_int_add(json, "vpnReimports", stats.reimports);
+		json_object_int_add(json, "longestPassUs", stats.pass_max_us);
+	} else {
+		vty_out(vty, "Measurements:\n");
+		vty_out(vty, "  Rounds read:           %10" PRIu64 "\n",
+			stats.rounds);
+		vty_out(vty, "  Nexthops changed:      %10" PRIu64 "\n",
+			stats.nexthops_changed);
+		vty_out(vty, "  Egress changed:        %10" PRIu64 "\n",
+			stats.egress_changed);
+		vty_out(vty, "Re-evaluation:\n");
+		vty_out(vty, "  Passes:                %10" PRIu64 "\n",
+			stats.passes);
+		vty_out(vty, "  Paths:                 %10" PRIu64 "\n",
+			stats.paths);
+		vty_out(vty, "  Destinations:          %10" PRIu64 "\n",
+			stats.dests);
+		vty_out(vty, "  VPN re-imports:        %10" PRIu64 "\n",
+			stats.reimports);
+		vty_out(vty, "  Longest pass:          %10" PRIu64 " us\n",
+			stats.pass_max_us);
+		vty_out(vty, "Event loop:\n");
+	}
+
+	bgp_twamp_timing_show(vty, json_work, "refresh", &stats.refresh);
+	bgp_twamp_timing_show(vty, json_work, "reevaluate",
+			      &stats.reevaluate);
+	bgp_twamp_timing_show(vty, json_work, "collect", &stats.collect);
+
+	/* Where best-path went another way because of a measurement */
+	if (!uj)
+		vty_out(vty, "Paths flipped:\n");
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp)) {
+		if (!bgp->import_latency_cfg.enabled)
+			continue;
+		if (uj) {
+			json_vrf = json_object_new_object();
+			json_object_int_add(json_vrf, "latency",
+					    bgp->twamp_latency_changes);
+			json_object_int_add(json_vrf, "loss",
+					    bgp->twamp_loss_changes);
+			json_object_object_add(json_vrfs, bgp->name_pretty,
+					       json_vrf);
+			continue;
+		}
+		vty_out(vty, "  %-22s %10" PRIu64 " on latency, %" PRIu64 " on loss\n",
+			bgp->name_pretty, bgp->twamp_latency_changes,
+			bgp->twamp_loss_changes);
+	}
+
+	if (!uj)
+		vty_out(vty, "Memory:\n");
+	for (mt = _mg_BGP_TWAMP.types; mt; mt = mt->next) {
+		if (uj) {
+			json_mtype = json_object_new_object();
+			json_object_int_add(json_mtype, "allocations",
+					    mt->n_alloc);
+#ifdef HAVE_MALLOC_USABLE_SIZE
+			json_object_int_add(json_mtype, "bytes", mt->total);
+#endif
+			json_object_object_add(json_mtypes, mt->name,
+					       json_mtype);
+			continue;
+		}
+#ifdef HAVE_MALLOC_USABLE_SIZE
+		vty_out(vty, "  %-34s %8zu %10zu bytes\n", mt->name,
+			(size_t)mt->n_alloc, (size_t)mt->total);
+#else
+		vty_out(vty, "  %-34s %8zu\n", mt->name, (size_t)mt->n_alloc);
+#endif
+	}
+
+	if (uj) {
+		json_object_object_add(json, "eventLoop", json_work);
+		json_object_object_add(json, "pathsFlipped", json_vrfs);
+		json_object_object_add(json, "memory", json_mtypes);
+		vty_json(vty, json);
+	}
+	return CMD_SUCCESS;
+}
+
+void bgp_twamp_vty_init(void)
+{
+	install_element(VIEW_NODE, &show_bgp_twamp_cmd);
+	install_element(VIEW_NODE, &show_bgp_twamp_nexthop_history_cmd);
+	install_element(VIEW_NODE, &show_bgp_twamp_statistics_cmd);
+	bgp_twamp_egress_vty_init();
+}
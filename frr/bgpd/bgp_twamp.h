@@ -1,28 +1,174 @@
 #ifndef _BGP_TWAMP_H
 #define _BGP_TWAMP_H
 
+#include "memory.h"
 #include "bgp_twamp_ipc.h"
 
+/*
+ * Everything the feature allocates, so "show memory" tells what it costs
+ * apart from the rest of bgpd
+ */
+DECLARE_MGROUP(BGP_TWAMP);
+/* Per-slot bitmaps and slot tables sized for a shared segment */
+DECLARE_MTYPE(BGP_TWAMP_SLOTS);
+/* Snapshots taken for deferred show output */
+DECLARE_MTYPE(BGP_TWAMP_SHOW);
+
 
 struct bgp;
-struct in_addr;
+struct bgp_path_info;
+struct bgp_nexthop_cache;
+struct attr;
+union sockunion;
 
 
+/*
+ * Attach an instance with the feature enabled to the shared segment,
+ * creating it for the first one
+ */
 extern void bgp_twamp_init(struct bgp *bgp);
 
 
-extern void bgp_twamp_add_nexthop(struct in_addr *nh);
-
-
-extern void bgp_twamp_remove_nexthop(struct in_addr *nh);
-
-
-extern uint32_t bgp_twamp_get_latency(struct in_addr *nh);
+/* Next-hops are transport addresses of either family, in the default VRF */
+extern void bgp_twamp_add_nexthop(const union sockunion *nh);
+
+
+extern void bgp_twamp_remove_nexthop(const union sockunion *nh);
+
+/* Latency-weighted multipath: weight of one path, 0 if not measured */
+extern uint64_t bgp_twamp_path_weight(struct bgp_path_info *path);
+
+/* Latency of the nexthop of a path's ultimate iBGP path, UINT32_MAX if
+ * not measured; without a measurement, what the path was advertised with.
+ * For an eBGP path, through its exit to the destination where measured.
+ */
+extern uint32_t bgp_twamp_path_latency(struct bgp_path_info *path);
+
+/* Probe loss to the same nexthop in permille, 0 if not measured */
+extern uint16_t bgp_twamp_path_loss(struct bgp_path_info *path);
+
+/*
+ * bgp_twamp_path_latency() of a path in the VPN table received over an
+ * iBGP session, as importing into each VRF weighs it: the figure kept
+ * on its nexthop for all the paths and VRFs that use it, read without
+ * going through the rest
+ */
+extern uint32_t bgp_twamp_import_latency(struct bgp_path_info *path_vpn);
+
+/*
+ * Optimal route reflection: until set back to NULL, path latencies are
+ * the IGP delay from root instead, for best-path run over for its clients
+ */
+extern void bgp_twamp_viewpoint(const struct in_addr *root);
+
+/*
+ * Colour steering: the SR policy colour the nexthop of path is in the
+ * latency class of, 0 to install the path as it is
+ */
+extern uint32_t bgp_twamp_path_color(struct bgp *bgp,
+				     struct bgp_path_info *path);
+/* Classes or steering changed: move every nexthop of bgp to its class */
+extern void bgp_twamp_color_refresh(struct bgp *bgp);
+
+/*
+ * Outbound attributes of path: add the latency extended community where
+ * the instance advertises latency
+ */
+extern void bgp_twamp_announce(struct bgp *bgp, struct bgp_path_info *path,
+			       struct attr *attr);
+
+/*
+ * Route-map "from-latency" value of a measured latency: microseconds
+ * below BGP_TWAMP_LATENCY_MAX_US, so nearer nexthops are preferred and
+ * anything a second or more away gets 0
+ */
+#define BGP_TWAMP_LATENCY_MAX_US 1000000U
+
+static inline uint32_t bgp_twamp_latency_preference(uint32_t latency_us)
+{
+	return latency_us < BGP_TWAMP_LATENCY_MAX_US
+		       ? BGP_TWAMP_LATENCY_MAX_US - latency_us
+		       : 0;
+}
+
+/* Reload bnc->twamp_latency for all nexthops from the shared segment,
+ * returns the number of nexthops whose value changed
+ */
+extern unsigned int bgp_twamp_refresh_nexthops(void);
+
+/*
+ * Nexthop cache hooks: a path was attached to or detached from bnc, bnc
+ * is being freed
+ */
+extern void bgp_twamp_bnc_path_add(struct bgp_nexthop_cache *bnc,
+				   struct bgp_path_info *path);
+extern void bgp_twamp_bnc_path_del(struct bgp_nexthop_cache *bnc,
+				   struct bgp_path_info *path);
+extern void bgp_twamp_bnc_free(struct bgp_nexthop_cache *bnc);
 
 
 extern void bgp_twamp_collect_nexthops(struct bgp *bgp);
 
-
-extern void bgp_twamp_cleanup(void);
+/*
+ * Update-delay is over but for latency: some reachable nexthop of bgp is
+ * being probed without a measurement yet. Read-only mode carries on until
+ * there is one for all of them, or as long as max-delay allows.
+ */
+extern bool bgp_twamp_initial_pending(struct bgp *bgp);
+
+/*
+ * VRF import policy or a probe profile changed: re-decide which nexthops
+ * are measured, and how
+ */
+extern void bgp_twamp_import_changed(void);
+
+/* A latency source other than the segment changed: reload every nexthop */
+extern void bgp_twamp_source_changed(void);
+
+/* The BFD echo round trip time or state of a peer's session changed */
+extern void bgp_twamp_bfd_rtt_changed(struct peer *peer);
+
+/*
+ * A peer's BFD session went down or came back up. Down, the nexthops at
+ * the peer's address lose their latency and go to full loss at once,
+ * without waiting for the agent or the coalesce window.
+ */
+extern void bgp_twamp_bfd_status(struct peer *peer, bool up);
+
+/* A nexthop to monitor, as bgp_twamp_sync_nexthops() takes it */
+struct bgp_twamp_target {
+	/* Segment key, IPv4 addresses v4-mapped (twamp_addr_from_ipv4()) */
+	struct in6_addr key;
+	/* VRF device the nexthop is reached through, 0 for the default VRF */
+	uint32_t vrf_ifindex;
+	/* Probe profile, 0 for the agent's own setting */
+	uint16_t probe_cycle_sec;
+	uint8_t packet_count;
+	/* Traffic class probed, part of the key like vrf_ifindex */
+	uint8_t dscp;
+};
+
+/*
+ * Link-params or addresses of a default VRF interface changed: the far
+ * ends of the links zebra takes measured TE delays for ("delay measured")
+ * are probed along with the nexthops
+ */
+extern void bgp_twamp_links_changed(void);
+
+/* Replace the monitored set with targets[0..n) in a single update */
+extern void bgp_twamp_sync_nexthops(const struct bgp_twamp_target *targets,
+				    unsigned int n);
+
+/* "show bgp twamp" commands, read from bgpd's own copy of the data only */
+extern void bgp_twamp_vty_init(void);
+
+/* Operational state for the northbound, see bgp_twamp_nb.c */
+extern const struct frr_yang_module_info frr_bgp_latency_info;
+
+/*
+ * Drop the instance's reference on the segment, which is only torn down
+ * once no instance uses it any more
+ */
+extern void bgp_twamp_cleanup(struct bgp *bgp);
 
 #endif 
\ No newline at end of file
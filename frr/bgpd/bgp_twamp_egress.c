@@ -0,0 +1,737 @@
+/*
+ * Internet egress performance routing.
+ *
+ * An exit is an eBGP transit, known by the nexthop of its paths and the
+ * fwmark policy routing sends traffic out of it with. Every collect walks
+ * the IPv4 unicast table of the instances that have exits configured up
+ * to their prefix limit, taking the prefixes their prefix-list permits
+ * that have eBGP paths via at least two exits: there is nothing to rank
+ * for the others. Each (prefix, exit) pair becomes an entry of the egress
+ * segment, the destination being the first host of the prefix and the
+ * mark that of the exit; the agent times TCP handshakes to it without the
+ * host taking part in anything.
+ *
+ * bgpd does not see traffic, so which prefixes matter is up to the
+ * operator: the prefix-list is meant to hold the top destinations by
+ * volume, and the limit bounds both the probing and the memory for
+ * whatever it lets through.
+ *
+ * The entries are kept in a hash keyed by instance, prefix and exit, so
+ * best-path gets the latency of an eBGP path with one lookup and no walk.
+ * When measurements come in only the slots the agent flagged are read,
+ * and best-path only runs for a destination once an exit moved by as
+ * much as the latency step could react to.
+ */
+#include "zebra.h"
+
+#include "lib/jhash.h"
+#include "lib/json.h"
+#include "lib/plist.h"
+#include "lib/typesafe.h"
+#include "lib/vty.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_memory.h"
+#include "bgpd/bgp_twamp.h"
+#include "bgpd/bgp_twamp_egress.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+DEFINE_MTYPE_STATIC(BGP_TWAMP, BGP_TWAMP_EGRESS, "BGP latency egress destination");
+
+/* Collect every so often, for prefixes and paths coming and going */
+#define BGP_TWAMP_EGRESS_COLLECT_INTERVAL 60
+/* After a configuration change, once the burst of commands is over */
+#define BGP_TWAMP_EGRESS_SETTLE 1
+
+PREDECL_HASH(bgp_twamp_egress_entries);
+
+struct bgp_twamp_egress {
+	struct bgp_twamp_egress_entries_item item;
+
+	/* The key */
+	struct bgp *bgp;
+	struct in_addr network;
+	uint8_t prefixlen;
+	struct in_addr exit;
+
+	uint32_t mark;
+	/* entries[] index in the segment, -1 while it has none */
+	int slot;
+	/* Last collect the prefix was still wanted in */
+	uint32_t collect_gen;
+
+	/* As last read, UINT32_MAX if not measured */
+	uint32_t rtt_us;
+	uint16_t loss;
+	/* What best-path last ran with for the destination */
+	uint32_t decided_us;
+	uint16_t decided_loss;
+};
+
+static int bgp_twamp_egress_cmp(const struct bgp_twamp_egress *a,
+				const struct bgp_twamp_egress *b)
+{
+	if (a->bgp != b->bgp)
+		return a->bgp < b->bgp ? -1 : 1;
+	if (a->prefixlen != b->prefixlen)
+		return numcmp(a->prefixlen, b->prefixlen);
+	if (a->network.s_addr != b->network.s_addr)
+		return numcmp(ntohl(a->network.s_addr),
+			      ntohl(b->network.s_addr));
+	return numcmp(ntohl(a->exit.s_addr), ntohl(b->exit.s_addr));
+}
+
+static uint32_t bgp_twamp_egress_hash(const struct bgp_twamp_egress *e)
+{
+	return jhash_3words(e->network.s_addr, e->exit.s_addr,
+			    e->prefixlen ^ (uint32_t)(uintptr_t)e->bgp,
+			    0x65677273);
+}
+
+DECLARE_HASH(bgp_twamp_egress_entries, struct bgp_twamp_egress, item,
+	     bgp_twamp_egress_cmp, bgp_twamp_egress_hash);
+
+static struct bgp_twamp_egress_entries_head egress_entries =
+	INIT_HASH(egress_entries);
+
+static struct twamp_egress_shm *egress_shm;
+static size_t egress_size;
+static int egress_fd = -1;
+/* bgpd-private, sized for egress_shm's capacity */
+static struct bgp_twamp_egress **slot_owner;
+static uint32_t *free_slots;
+static uint32_t free_count;
+static uint64_t *dirty_snap;
+
+static uint32_t collect_gen;
+static struct event *collect_ev;
+
+static void bgp_twamp_egress_collect_event(struct event *thread);
+
+/* Let go of the segment; agents see the name gone and re-open */
+static void bgp_twamp_egress_shm_close(void)
+{
+	struct bgp_twamp_egress *e;
+
+	if (egress_shm) {
+		__atomic_fetch_or(&egress_shm->hdr.flags,
+				  TWAMP_SHM_F_SUPERSEDED, __ATOMIC_RELEASE);
+		munmap(egress_shm, egress_size);
+		egress_shm = NULL;
+	}
+	if (egress_fd >= 0) {
+		close(egress_fd);
+		egress_fd = -1;
+	}
+	shm_unlink(TWAMP_EGRESS_SHM_NAME);
+
+	XFREE(MTYPE_BGP_TWAMP_SLOTS, slot_owner);
+	XFREE(MTYPE_BGP_TWAMP_SLOTS, free_slots);
+	XFREE(MTYPE_BGP_TWAMP_SLOTS, dirty_snap);
+	free_count = 0;
+
+	frr_each (bgp_twamp_egress_entries, &egress_entries, e)
+		e->slot = -1;
+}
+
+/*
+ * Replace the segment by an empty one for capacity entries. Whatever was
+ * measured in the old one is lost, the entries are placed again and the
+ * agent starts over on them.
+ */
+static bool bgp_twamp_egress_shm_open(uint32_t capacity)
+{
+	struct twamp_egress_hdr layout;
+	struct twamp_egress_shm *seg;
+	int fd;
+
+	bgp_twamp_egress_shm_close();
+	twamp_egress_layout(&layout, capacity);
+
+	fd = shm_open(TWAMP_EGRESS_SHM_NAME, O_CREAT | O_EXCL | O_RDWR, 0666);
+	if (fd == -1) {
+		zlog_err("BGP TWAMP: Failed to create egress shared memory: %s",
+			 safe_strerror(errno));
+		return false;
+	}
+	if (ftruncate(fd, layout.total_size) == -1) {
+		zlog_err("BGP TWAMP: Failed to size egress shared memory: %s",
+			 safe_strerror(errno));
+		goto fail;
+	}
+	seg = mmap(NULL, layout.total_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   fd, 0);
+	if (seg == MAP_FAILED) {
+		zlog_err("BGP TWAMP: Failed to map egress shared memory: %s",
+			 safe_strerror(errno));
+		goto fail;
+	}
+
+	/* Empty reads as zeroes, the header can go out right away */
+	twamp_egress_hdr_init(seg, capacity);
+
+	egress_shm = seg;
+	egress_fd = fd;
+	egress_size = layout.total_size;
+	slot_owner = XCALLOC(MTYPE_BGP_TWAMP_SLOTS,
+			     capacity * sizeof(*slot_owner));
+	free_slots = XCALLOC(MTYPE_BGP_TWAMP_SLOTS,
+			     capacity * sizeof(*free_slots));
+	dirty_snap = XCALLOC(MTYPE_BGP_TWAMP_SLOTS,
+			     TWAMP_DIRTY_WORDS(capacity) * sizeof(uint64_t));
+
+	zlog_info("BGP TWAMP: Egress shared memory holds %u destinations",
+		  capacity);
+	return true;
+
+fail:
+	close(fd);
+	shm_unlink(TWAMP_EGRESS_SHM_NAME);
+	return false;
+}
+
+/* The address probed for a prefix: its first host, the prefix if a host */
+static void bgp_twamp_egress_dest(const struct bgp_twamp_egress *e,
+				  struct in6_addr *dest)
+{
+	uint32_t addr = ntohl(e->network.s_addr);
+
+	if (e->prefixlen <= 30)
+		addr++;
+	twamp_addr_from_ipv4(dest, htonl(addr));
+}
+
+/* Give e a slot; caller bumped gen. False if the segment is full. */
+static bool bgp_twamp_egress_place(struct bgp_twamp_egress *e)
+{
+	struct twamp_egress *ent;
+	uint32_t i;
+
+	if (free_count)
+		i = free_slots[--free_count];
+	else if (egress_shm->count < egress_shm->hdr.capacity)
+		i = egress_shm->count;
+	else
+		return false;
+
+	ent = &twamp_egress_entries(egress_shm)[i];
+	bgp_twamp_egress_dest(e, &ent->dest);
+	ent->mark = e->mark;
+	if (++ent->epoch == 0)
+		ent->epoch = 1;
+	ent->active = 1;
+	if (i == egress_shm->count)
+		__atomic_store_n(&egress_shm->count, i + 1, __ATOMIC_RELEASE);
+
+	slot_owner[i] = e;
+	e->slot = i;
+	return true;
+}
+
+/* Take e's slot back; caller bumped gen */
+static void bgp_twamp_egress_unplace(struct bgp_twamp_egress *e)
+{
+	if (e->slot < 0)
+		return;
+
+	twamp_egress_entries(egress_shm)[e->slot].active = 0;
+	slot_owner[e->slot] = NULL;
+	free_slots[free_count++] = e->slot;
+	e->slot = -1;
+}
+
+static void bgp_twamp_egress_process(struct bgp_twamp_egress *e)
+{
+	struct bgp_table *table = e->bgp->rib[AFI_IP][SAFI_UNICAST];
+	struct prefix p = {};
+	struct bgp_dest *dest;
+
+	if (!table)
+		return;
+
+	p.family = AF_INET;
+	p.prefixlen = e->prefixlen;
+	p.u.prefix4 = e->network;
+	dest = bgp_node_lookup(table, &p);
+	if (!dest)
+		return;
+	bgp_process(e->bgp, dest, AFI_IP, SAFI_UNICAST);
+	bgp_dest_unlock_node(dest);
+}
+
+/* Index of the exit a path via nexthop leaves by, -1 if none */
+static int bgp_twamp_egress_exit(const struct bgp_import_latency_config *cfg,
+				 struct in_addr nexthop)
+{
+	unsigned int i;
+
+	for (i = 0; i < cfg->egress_exit_count; i++)
+		if (cfg->egress_exits[i].nexthop.s_addr == nexthop.s_addr)
+			return i;
+	return -1;
+}
+
+static bool bgp_twamp_egress_enabled(const struct bgp *bgp)
+{
+	return bgp->import_latency_cfg.enabled &&
+	       bgp->import_latency_cfg.egress_exit_count >= 2 &&
+	       bgp->rib[AFI_IP][SAFI_UNICAST];
+}
+
+/* Mark the prefixes bgp wants measured, returns how many entries */
+static unsigned int bgp_twamp_egress_collect_bgp(struct bgp *bgp)
+{
+	const struct bgp_import_latency_config *cfg = &bgp->import_latency_cfg;
+	struct prefix_list *plist = NULL;
+	struct bgp_twamp_egress key = {}, *e;
+	struct bgp_path_info *pi;
+	struct bgp_dest *dest;
+	const struct prefix *p;
+	unsigned int prefixes = 0, entries = 0, i;
+	uint32_t exits;
+	int idx;
+
+	if (cfg->egress_plist) {
+		plist = prefix_list_lookup(AFI_IP, cfg->egress_plist);
+		/* Nothing is picked by a list that is not there (yet) */
+		if (!plist)
+			return 0;
+	}
+
+	key.bgp = bgp;
+	for (dest = bgp_table_top(bgp->rib[AFI_IP][SAFI_UNICAST]); dest;
+	     dest = bgp_route_next(dest)) {
+		p = bgp_dest_get_prefix(dest);
+		if (plist && prefix_list_apply(plist, p) != PREFIX_PERMIT)
+			continue;
+
+		exits = 0;
+		for (pi = bgp_dest_get_bgp_path_info(dest); pi; pi = pi->next) {
+			if (!pi->peer || pi->peer->sort != BGP_PEER_EBGP ||
+			    CHECK_FLAG(pi->flags, BGP_PATH_REMOVED) ||
+			    !CHECK_FLAG(pi->flags, BGP_PATH_VALID))
+				continue;
+			idx = bgp_twamp_egress_exit(cfg, pi->attr->nexthop);
+			if (idx >= 0)
+				exits |= 1U << idx;
+		}
+		if (__builtin_popcount(exits) < 2)
+			continue;
+
+		key.network = p->u.prefix4;
+		key.prefixlen = p->prefixlen;
+		for (i = 0; i < cfg->egress_exit_count; i++) {
+			if (!(exits & (1U << i)))
+				continue;
+			key.exit = cfg->egress_exits[i].nexthop;
+			e = bgp_twamp_egress_entries_find(&egress_entries, &key);
+			if (!e) {
+				e = XCALLOC(MTYPE_BGP_TWAMP_EGRESS, sizeof(*e));
+				*e = key;
+				e->slot = -1;
+				e->rtt_us = e->decided_us = UINT32_MAX;
+				bgp_twamp_egress_entries_add(&egress_entries, e);
+			}
+			/* A new mark needs a new slot, its figures are someone else's */
+			if (e->mark != cfg->egress_exits[i].mark) {
+				if (e->slot >= 0 && egress_shm) {
+					twamp_seq_write_begin(&egress_shm->gen);
+					bgp_twamp_egress_unplace(e);
+					twamp_seq_write_end(&egress_shm->gen);
+				}
+				e->mark = cfg->egress_exits[i].mark;
+			}
+			e->collect_gen = collect_gen;
+			entries++;
+		}
+
+		if (++prefixes >= cfg->egress_max_prefixes) {
+			bgp_dest_unlock_node(dest);
+			break;
+		}
+	}
+
+	return entries;
+}
+
+/*
+ * Make the segment hold exactly the pairs wanted now. Those no longer
+ * wanted go first, best-path running again where they took part in it,
+ * so their slots are there for the new ones.
+ */
+static void bgp_twamp_egress_collect(void)
+{
+	struct bgp_twamp_egress *e;
+	struct listnode *node;
+	struct bgp *bgp;
+	unsigned int wanted = 0, added = 0, removed = 0, unplaced = 0;
+	uint32_t capacity;
+	bool any = false;
+
+	EVENT_OFF(collect_ev);
+	/* Shutting down, nothing is worth measuring any more */
+	if (bm->terminating)
+		return;
+
+	collect_gen++;
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		if (bgp_twamp_egress_enabled(bgp)) {
+			wanted += bgp_twamp_egress_collect_bgp(bgp);
+			any = true;
+		}
+
+	capacity = twamp_egress_capacity_for(
+		MIN(wanted, TWAMP_EGRESS_MAX_CAPACITY));
+	if (wanted && (!egress_shm || egress_shm->hdr.capacity < capacity))
+		bgp_twamp_egress_shm_open(capacity);
+
+	if (egress_shm)
+		twamp_seq_write_begin(&egress_shm->gen);
+	frr_each_safe (bgp_twamp_egress_entries, &egress_entries, e) {
+		if (e->collect_gen == collect_gen)
+			continue;
+		if (egress_shm)
+			bgp_twamp_egress_unplace(e);
+		if (e->decided_us != UINT32_MAX || e->decided_loss)
+			bgp_twamp_egress_process(e);
+		bgp_twamp_egress_entries_del(&egress_entries, e);
+		XFREE(MTYPE_BGP_TWAMP_EGRESS, e);
+		removed++;
+	}
+	if (egress_shm) {
+		frr_each (bgp_twamp_egress_entries, &egress_entries, e) {
+			if (e->slot >= 0)
+				continue;
+			if (bgp_twamp_egress_place(e))
+				added++;
+			else
+				unplaced++;
+		}
+		twamp_seq_write_end(&egress_shm->gen);
+	}
+
+	if (!wanted && egress_shm) {
+		bgp_twamp_egress_shm_close();
+		zlog_info("BGP TWAMP: No egress destinations, removed their shared memory");
+	}
+
+	if (BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: Egress collect: %u destinations, %u added, %u removed",
+			   wanted, added, removed);
+	if (unplaced)
+		zlog_warn("BGP TWAMP: Max egress destinations (%u) reached, %u not measured",
+			  TWAMP_EGRESS_MAX_CAPACITY, unplaced);
+
+	if (any)
+		event_add_timer(bm->master, bgp_twamp_egress_collect_event,
+				NULL, BGP_TWAMP_EGRESS_COLLECT_INTERVAL,
+				&collect_ev);
+}
+
+static void bgp_twamp_egress_collect_event(struct event *thread)
+{
+	bgp_twamp_egress_collect();
+}
+
+void bgp_twamp_egress_config_changed(struct bgp *bgp)
+{
+	EVENT_OFF(collect_ev);
+	event_add_timer(bm->master, bgp_twamp_egress_collect_event, NULL,
+			BGP_TWAMP_EGRESS_SETTLE, &collect_ev);
+}
+
+void bgp_twamp_egress_plist_changed(const char *name)
+{
+	struct listnode *node;
+	struct bgp *bgp;
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		if (bgp->import_latency_cfg.egress_plist &&
+		    (!name ||
+		     strmatch(bgp->import_latency_cfg.egress_plist, name))) {
+			bgp_twamp_egress_config_changed(bgp);
+			return;
+		}
+}
+
+void bgp_twamp_egress_finish(struct bgp *bgp)
+{
+	struct bgp_twamp_egress *e;
+
+	XFREE(MTYPE_BGP_FILTER_NAME, bgp->import_latency_cfg.egress_plist);
+	bgp->import_latency_cfg.egress_exit_count = 0;
+
+	if (egress_shm)
+		twamp_seq_write_begin(&egress_shm->gen);
+	frr_each_safe (bgp_twamp_egress_entries, &egress_entries, e) {
+		if (e->bgp != bgp)
+			continue;
+		if (egress_shm)
+			bgp_twamp_egress_unplace(e);
+		bgp_twamp_egress_entries_del(&egress_entries, e);
+		XFREE(MTYPE_BGP_TWAMP_EGRESS, e);
+	}
+	if (egress_shm)
+		twamp_seq_write_end(&egress_shm->gen);
+
+	if (!bgp_twamp_egress_entries_count(&egress_entries)) {
+		EVENT_OFF(collect_ev);
+		if (egress_shm || egress_fd >= 0)
+			bgp_twamp_egress_shm_close();
+	}
+}
+
+/*
+ * Has e moved by as much as the latency step can react to? The smaller
+ * margin is the one a selected path keeps its win by, and gaining or
+ * losing a measurement, or crossing the loss threshold, always counts.
+ */
+static bool bgp_twamp_egress_moved(const struct bgp_twamp_egress *e)
+{
+	const struct bgp_import_latency_config *cfg =
+		&e->bgp->import_latency_cfg;
+	uint32_t margin = MIN(cfg->damping_threshold_us,
+			      cfg->switch_back_threshold_us);
+	uint16_t threshold = cfg->loss_threshold_permille;
+
+	if ((e->rtt_us == UINT32_MAX) != (e->decided_us == UINT32_MAX))
+		return true;
+	if (threshold &&
+	    (e->loss >= threshold) != (e->decided_loss >= threshold))
+		return true;
+	if (e->rtt_us == UINT32_MAX)
+		return false;
+
+	return (e->rtt_us > e->decided_us ? e->rtt_us - e->decided_us
+					  : e->decided_us - e->rtt_us) >=
+	       MAX(margin, 1U);
+}
+
+unsigned int bgp_twamp_egress_refresh(void)
+{
+	const struct twamp_egress *entries;
+	struct bgp_twamp_egress *e;
+	uint32_t words, w, i, rtt;
+	uint64_t bits;
+	uint16_t loss;
+	uint8_t measured;
+	int64_t last_updated;
+	unsigned int moved = 0;
+
+	if (!egress_shm || !twamp_egress_take_dirty(egress_shm, dirty_snap))
+		return 0;
+
+	entries = twamp_egress_entries_c(egress_shm);
+	words = TWAMP_DIRTY_WORDS(egress_shm->hdr.capacity);
+	for (w = 0; w < words; w++)
+		for (bits = dirty_snap[w]; bits; bits &= bits - 1) {
+			i = w * 64 + __builtin_ctzll(bits);
+			e = slot_owner[i];
+			if (!e)
+				continue;
+			if (twamp_egress_read(&entries[i], &rtt, &loss,
+					      &measured, &last_updated) < 0) {
+				rtt = UINT32_MAX;
+				loss = 0;
+			} else if (!measured)
+				rtt = UINT32_MAX;
+			e->rtt_us = rtt;
+			e->loss = MIN(loss, 1000);
+			if (!bgp_twamp_egress_moved(e))
+				continue;
+			e->decided_us = e->rtt_us;
+			e->decided_loss = e->loss;
+			bgp_twamp_egress_process(e);
+			moved++;
+		}
+
+	if (moved && BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: Egress measurements updated (seq %u), %u exits moved",
+			   __atomic_load_n(&egress_shm->sequence,
+					   __ATOMIC_RELAXED),
+			   moved);
+	return moved;
+}
+
+static const struct bgp_twamp_egress *
+bgp_twamp_egress_path_entry(const struct bgp_path_info *path)
+{
+	const struct prefix *p;
+	struct bgp_table *table;
+	struct bgp_twamp_egress key;
+
+	if (!bgp_twamp_egress_entries_count(&egress_entries) || !path->net ||
+	    !path->attr)
+		return NULL;
+
+	table = bgp_dest_table(path->net);
+	if (table->afi != AFI_IP || table->safi != SAFI_UNICAST)
+		return NULL;
+
+	p = bgp_dest_get_prefix(path->net);
+	key.bgp = table->bgp;
+	key.network = p->u.prefix4;
+	key.prefixlen = p->prefixlen;
+	key.exit = path->attr->nexthop;
+	return bgp_twamp_egress_entries_find(&egress_entries, &key);
+}
+
+/*
+ * What best-path compares is what it ran with last, so a path's figure
+ * only changes together with a new pass for its destination
+ */
+uint32_t bgp_twamp_egress_latency(const struct bgp_path_info *path)
+{
+	const struct bgp_twamp_egress *e = bgp_twamp_egress_path_entry(path);
+
+	return e ? e->decided_us : UINT32_MAX;
+}
+
+uint16_t bgp_twamp_egress_loss(const struct bgp_path_info *path)
+{
+	const struct bgp_twamp_egress *e = bgp_twamp_egress_path_entry(path);
+
+	return e ? e->decided_loss : 0;
+}
+
+struct bgp_twamp_egress_show_entry {
+	struct prefix prefix;
+	struct in_addr exit;
+	uint32_t mark;
+	uint32_t rtt_us;
+	uint16_t loss;
+	int slot;
+	char vrf[VRF_NAMSIZ];
+};
+
+struct bgp_twamp_egress_show {
+	bool json;
+	bool attached;
+	uint32_t capacity, count, sequence;
+	unsigned int entries;
+	struct bgp_twamp_egress_show_entry entry[];
+};
+
+static void bgp_twamp_egress_show_output(struct vty *vty, void *arg)
+{
+	const struct bgp_twamp_egress_show *show = arg;
+	const struct bgp_twamp_egress_show_entry *s;
+	json_object *json, *json_list, *json_entry;
+	char rtt[16];
+	unsigned int i;
+
+	if (show->json) {
+		json = json_object_new_object();
+		json_list = json_object_new_array();
+		json_object_boolean_add(json, "attached", show->attached);
+		if (show->attached) {
+			json_object_int_add(json, "capacity", show->capacity);
+			json_object_int_add(json, "slots", show->count);
+			json_object_int_add(json, "sequence", show->sequence);
+		}
+		for (i = 0; i < show->entries; i++) {
+			s = &show->entry[i];
+			json_entry = json_object_new_object();
+			json_object_string_addf(json_entry, "prefix", "%pFX",
+						&s->prefix);
+			json_object_string_add(json_entry, "vrf", s->vrf);
+			json_object_string_addf(json_entry, "exit", "%pI4",
+						&s->exit);
+			json_object_int_add(json_entry, "mark", s->mark);
+			json_object_boolean_add(json_entry, "probed",
+						s->slot >= 0);
+			if (s->rtt_us != UINT32_MAX)
+				json_object_int_add(json_entry, "latencyUs",
+						    s->rtt_us);
+			json_object_int_add(json_entry, "lossPermille",
+					    s->loss);
+			json_object_array_add(json_list, json_entry);
+		}
+		json_object_object_add(json, "destinationList", json_list);
+		vty_json(vty, json);
+		return;
+	}
+
+	if (show->attached)
+		vty_out(vty,
+			"Egress segment: %u of %u slots in use, sequence %u\n",
+			show->count, show->capacity, show->sequence);
+	else
+		vty_out(vty, "Egress segment: not attached\n");
+
+	vty_out(vty, "\n%-18s %-16s %-15s %-10s %-12s %s\n", "Prefix", "VRF",
+		"Exit", "Mark", "Latency", "Loss");
+	for (i = 0; i < show->entries; i++) {
+		s = &show->entry[i];
+		if (s->slot < 0)
+			strlcpy(rtt, "unprobed", sizeof(rtt));
+		else if (s->rtt_us == UINT32_MAX)
+			strlcpy(rtt, "-", sizeof(rtt));
+		else
+			snprintf(rtt, sizeof(rtt), "%u.%03ums", s->rtt_us / 1000,
+				 s->rtt_us % 1000);
+		vty_out(vty, "%-18pFX %-16s %-15pI4 %-10u %-12s %3u.%u%%\n",
+			&s->prefix, s->vrf, &s->exit, s->mark, rtt,
+			s->loss / 10, s->loss % 10);
+	}
+}
+
+static void bgp_twamp_egress_show_free(void *arg)
+{
+	XFREE(MTYPE_BGP_TWAMP_SHOW, arg);
+}
+
+DEFUN(show_bgp_twamp_egress, show_bgp_twamp_egress_cmd,
+      "show bgp twamp egress [json]",
+      SHOW_STR
+      BGP_STR
+      "Latency measurement of nexthops\n"
+      "Destinations measured through each internet exit\n"
+      JSON_STR)
+{
+	struct bgp_twamp_egress_show *show;
+	struct bgp_twamp_egress_show_entry *s;
+	struct bgp_twamp_egress *e;
+	unsigned int count = bgp_twamp_egress_entries_count(&egress_entries);
+
+	show = XCALLOC(MTYPE_BGP_TWAMP_SHOW,
+		       sizeof(*show) + count * sizeof(show->entry[0]));
+	show->json = use_json(argc, argv);
+	show->attached = egress_shm != NULL;
+	if (egress_shm) {
+		show->capacity = egress_shm->hdr.capacity;
+		show->count = __atomic_load_n(&egress_shm->count,
+					      __ATOMIC_RELAXED);
+		show->sequence = __atomic_load_n(&egress_shm->sequence,
+						 __ATOMIC_RELAXED);
+	}
+
+	frr_each (bgp_twamp_egress_entries, &egress_entries, e) {
+		s = &show->entry[show->entries++];
+		s->prefix.family = AF_INET;
+		s->prefix.prefixlen = e->prefixlen;
+		s->prefix.u.prefix4 = e->network;
+		s->exit = e->exit;
+		s->mark = e->mark;
+		s->rtt_us = e->rtt_us;
+		s->loss = e->loss;
+		s->slot = e->slot;
+		strlcpy(s->vrf, e->bgp->name_pretty, sizeof(s->vrf));
+	}
+
+	return vty_defer(vty, bgp_twamp_egress_show_output, show,
+			 bgp_twamp_egress_show_free);
+}
+
+void bgp_twamp_egress_vty_init(void)
+{
+	install_element(VIEW_NODE, &show_bgp_twamp_egress_cmd);
+}
@@ -0,0 +1,43 @@
+#ifndef _BGP_TWAMP_EGRESS_H
+#define _BGP_TWAMP_EGRESS_H
+
+/*
+ * Internet egress performance routing. For the prefixes an operator
+ * picks, reachable through two or more configured eBGP exits, the agent
+ * measures the round trip towards a host of the prefix through each exit.
+ * The latency step of best-path then ranks the eBGP paths of the prefix
+ * by the figure of their exit, the same way it ranks iBGP paths by the
+ * latency of their nexthop.
+ */
+
+struct bgp;
+struct bgp_path_info;
+
+/*
+ * Latency through the exit of an eBGP path towards its destination,
+ * UINT32_MAX if not measured; one hash lookup
+ */
+extern uint32_t bgp_twamp_egress_latency(const struct bgp_path_info *path);
+
+/* Handshake loss through the same exit in permille, 0 if not measured */
+extern uint16_t bgp_twamp_egress_loss(const struct bgp_path_info *path);
+
+/*
+ * Take the measurements the agent flagged and run best-path for the
+ * destinations whose exits moved; returns the number of those
+ */
+extern unsigned int bgp_twamp_egress_refresh(void);
+
+/* Exits, prefix-list or prefix limit of bgp changed: collect again soon */
+extern void bgp_twamp_egress_config_changed(struct bgp *bgp);
+
+/* The prefix-list named name was changed */
+extern void bgp_twamp_egress_plist_changed(const char *name);
+
+/* The instance is going away: drop its destinations and configuration */
+extern void bgp_twamp_egress_finish(struct bgp *bgp);
+
+/* "show bgp twamp egress" */
+extern void bgp_twamp_egress_vty_init(void);
+
+#endif
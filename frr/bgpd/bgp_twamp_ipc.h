@@ -19,43 +19,1084 @@
 
 
 #include <stddef.h>
+#include <string.h>
+#include <errno.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define TWAMP_SHM_NAME "/bgp_twamp_shm"
-#define MAX_NEXTHOPS 1024
 
+/*
+ * Change notification.  bgpd listens on this abstract-namespace unix
+ * socket (the name is prefixed with a NUL byte on the wire).  An agent
+ * connects, receives a single byte carrying an eventfd as SCM_RIGHTS, and
+ * from then on writes a non-zero uint64_t to that eventfd after each batch
+ * it publishes (after setting the dirty bits).  bgpd falls back to polling
+ * the dirty bitmap slowly, so agents that never connect still work.
+ */
+#define TWAMP_NOTIFY_SOCK "bgp_twamp_notify"
 
+/*
+ * The number of nexthops[] slots is chosen by bgpd when it creates the
+ * segment and is always a power of two in [TWAMP_MIN_CAPACITY,
+ * TWAMP_MAX_CAPACITY].  The open-addressing index over nexthops[] has twice
+ * as many buckets, so its load factor stays at or below 1/2 and a lookup
+ * needs only a couple of probes.  Buckets are 8 bytes, so one 64-byte cache
+ * line holds 8 of them, and each entry is exactly one cache line.
+ */
+#define TWAMP_MIN_CAPACITY 64
+#define TWAMP_MAX_CAPACITY 65536
+#define TWAMP_CACHELINE 64
+
+/* Words in the dirty bitmap, one bit per nexthops[] slot */
+#define TWAMP_DIRTY_WORDS(capacity) (((capacity) + 63) / 64)
+
+#ifdef __cplusplus
+#define TWAMP_STATIC_ASSERT(cond, msg) static_assert(cond, msg)
+#else
+#define TWAMP_STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)
+#endif
+
+/*
+ * Every segment starts with this header.  bgpd fills it in last and
+ * publishes magic with a release store, so an agent that sees the magic
+ * also sees an initialized segment.  Agents must check magic, version and
+ * entry_size, then locate everything through the offsets rather than
+ * assuming this build's struct layout (pthread_mutex_t differs between
+ * libcs).  All fields are native-endian and use only fixed-width types.
+ * Apart from flags they are never written after publication.
+ *
+ * The segment never grows in place.  When it fills up bgpd builds a larger
+ * one under the same name, carries the entries over, and then sets
+ * TWAMP_SHM_F_SUPERSEDED in the old header.  Agents check the flag before
+ * each batch and re-open by name when they see it; anything they write to
+ * the old mapping in the meantime is simply lost.
+ */
+#define TWAMP_SHM_MAGIC 0x504d5754U /* "TWMP" in little-endian memory */
+#define TWAMP_SHM_VERSION 9
+
+#define TWAMP_SHM_F_SUPERSEDED 0x1
+
+struct twamp_shm_hdr {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t hdr_size;        /* sizeof(struct twamp_shm_hdr) */
+    uint32_t entry_size;      /* sizeof(struct twamp_nexthop) */
+    uint32_t capacity;        /* entries in nexthops[] */
+    uint32_t hash_size;       /* buckets in index[] */
+    uint32_t off_writer_lock;
+    uint32_t off_nh_count;
+    uint32_t off_sequence;
+    uint32_t off_nh_gen;
+    uint32_t off_dirty;
+    uint32_t off_nexthops;
+    uint32_t off_index;
+    uint32_t total_size;      /* bytes the segment must be mapped with */
+    uint32_t flags;           /* TWAMP_SHM_F_* */
+    uint32_t off_config;
+    uint32_t reserved;
+};
+
+
+/*
+ * Ownership of the segment is split so that every field has exactly one
+ * writer and nobody ever blocks a reader:
+ *
+ * - bgpd owns the membership: nh_count, nh_gen, index[] and the addr,
+ *   vrf_ifindex, dscp, active, epoch and probe profile fields of each entry.  nh_gen is a sequence counter
+ *   (odd while bgpd is changing the membership) that the agent uses to get
+ *   a consistent view.  Slots below nh_count with active clear are free and
+ *   may be reassigned to another address; bgpd bumps epoch every time it
+ *   assigns a slot.  It also owns the configuration block (config).
+ *
+ * - the measurement agent owns latency_us, jitter_us, loss_permille,
+ *   measured, last_updated and meas_epoch of each entry, published under
+ *   the entry's own seq counter,
+ *   and bumps sequence once it has written a batch.  meas_epoch is the epoch
+ *   the agent read together with the address it probed; a measurement only
+ *   counts while it matches epoch, so one that lands after its slot was
+ *   reassigned is ignored rather than credited to the new address.  Multiple agent processes serialize through
+ *   writer_lock, a robust mutex; bgpd never takes it.
+ *
+ * After publishing an entry the agent sets its bit in dirty[]; bgpd swaps
+ * each word with zero and only revisits the slots it found set.  The agent
+ * may set bits with a plain read-modify-write of the word: racing with
+ * bgpd's swap can only leave extra bits set, never lose one, because the
+ * bit is set after the entry is published and cleared before it is read.
+ * gen counts completed publishes of a slot, for agents and diagnostics.
+ *
+ * If a writer dies half-way through an update its entry is left with an odd
+ * seq.  Readers give up after TWAMP_SEQ_RETRIES and treat the entry as not
+ * measured; the next writer to take writer_lock sees EOWNERDEAD and repairs
+ * the entry (twamp_shm_writer_lock()).
+ *
+ * Addresses of both families share one key space: an IPv4 nexthop is
+ * stored as its v4-mapped IPv6 address (::ffff:a.b.c.d), see
+ * twamp_addr_from_ipv4().
+ *
+ * An entry is keyed by its address together with vrf_ifindex, the
+ * ifindex of the VRF device the nexthop is reached through, 0 for the
+ * default VRF.  Agents probe it from a socket bound to that device
+ * (SO_BINDTODEVICE), so the same address in two VRFs is two entries, and a
+ * nexthop used by many VRFs over the same underlay is one.
+ *
+ * dscp is the traffic class the entry is measured in, and is part of the
+ * key as well: agents send its probes with that DSCP (IP_TOS or
+ * IPV6_TCLASS), so that they queue like the traffic of the class.  0 is
+ * the default class, the only one other daemons look up
+ * (twamp_shm_find()).
+ *
+ * probe_cycle_sec and packet_count are the probe profile bgpd wants for
+ * the entry, the strictest of the instances relying on it; 0 leaves the
+ * agent's own setting.  They may change without the slot being reassigned,
+ * always under nh_gen.
+ */
 struct twamp_nexthop {
-    struct in_addr addr;    
-    uint32_t latency_ms;     
-    uint8_t active;          
-    uint8_t measured;        
-    uint8_t padding[2];    
-    time_t last_updated;     
+    struct in6_addr addr;
+    uint32_t latency_us;      /* RTT in microseconds, UINT32_MAX if none */
+    uint8_t active;
+    uint8_t measured;
+    uint16_t epoch;
+    uint32_t seq;
+    uint32_t gen;
+    uint32_t meas_epoch;
+    uint32_t vrf_ifindex;
+    int64_t last_updated;     /* time_t seconds */
+    /*
+     * latency_us is the agent's smoothed RTT (median, p90 or EWMA of the
+     * probes), not a plain mean.  Jitter and loss come from the same probe
+     * round; agents predating them leave both 0.  forward_us is the
+     * one-way delay towards the nexthop, measured with STAMP (RFC 8762)
+     * while the clocks of both ends are synchronized; 0 if it was not,
+     * the reverse delay is latency_us minus forward_us.
+     */
+    uint32_t jitter_us;
+    uint16_t loss_permille;
+    uint16_t pad2;
+    uint16_t probe_cycle_sec;
+    uint8_t packet_count;
+    uint8_t dscp;             /* 0-63 */
+    uint32_t forward_us;
 };
 
 
+/*
+ * Agent-wide settings bgpd pushes, from the check-latency configuration
+ * of the instances using the segment.  Only the fields whose bit is set in
+ * present carry a setting; the agent keeps its own (command line) value
+ * for the others, so an unconfigured bgpd changes nothing.  bgpd is the
+ * only writer and updates the block under gen, a sequence counter like
+ * nh_gen; agents poll gen and re-read the block when it moves, so a change
+ * takes effect without restarting anything.
+ *
+ * probe_cycle_sec and packet_count are the agent's defaults, for peers
+ * without a profile of their own in their entry.  damping_threshold_us is
+ * the smallest latency move best-path reacts to; agents probe peers whose
+ * latency sits near it more often.  port is the UDP port of the
+ * reflectors.
+ */
+#define TWAMP_CFG_PORT 0x1
+#define TWAMP_CFG_PROBE_CYCLE 0x2
+#define TWAMP_CFG_PACKET_COUNT 0x4
+#define TWAMP_CFG_DAMPING 0x8
+
+struct twamp_shm_config {
+    uint32_t gen;
+    uint32_t present;         /* TWAMP_CFG_* */
+    uint32_t damping_threshold_us;
+    uint16_t port;
+    uint16_t probe_cycle_sec;
+    uint8_t packet_count;
+    uint8_t pad[3];
+    uint32_t reserved[11];
+};
+
+
+/*
+ * slot is the nexthops[] index plus one; 0 marks a never used bucket, which
+ * ends a probe sequence, and TWAMP_SLOT_TOMBSTONE a removed one, which
+ * does not.  tag is twamp_addr_tag() of the entry's key, so a probe
+ * only touches an entry whose tag already matches.
+ */
+#define TWAMP_SLOT_TOMBSTONE UINT32_MAX
+
+struct twamp_hash_bucket {
+    uint32_t tag;
+    uint32_t slot;
+};
+
+
+/*
+ * Fixed head of the segment.  It is followed, each at a cache-line aligned
+ * offset recorded in hdr, by uint64_t dirty[TWAMP_DIRTY_WORDS(capacity)],
+ * struct twamp_nexthop nexthops[capacity] and
+ * struct twamp_hash_bucket index[hash_size].  Use the accessors below.
+ */
 struct twamp_shm {
-    pthread_mutex_t lock;           
+    struct twamp_shm_hdr hdr;
+    pthread_mutex_t writer_lock;
     uint32_t nh_count;                
     uint32_t sequence;                 
-    uint32_t padding;                
-    struct twamp_nexthop nexthops[MAX_NEXTHOPS];
+    uint32_t nh_gen;
+    struct twamp_shm_config config;
+};
+
+
+/* The entry layout is part of the ABI, pin it down */
+TWAMP_STATIC_ASSERT(sizeof(struct twamp_shm_hdr) == 64,
+                    "twamp_shm_hdr must be 64 bytes");
+TWAMP_STATIC_ASSERT(offsetof(struct twamp_shm, hdr) == 0,
+                    "twamp_shm_hdr must start the segment");
+TWAMP_STATIC_ASSERT(sizeof(struct twamp_nexthop) == TWAMP_CACHELINE,
+                    "twamp_nexthop must be one cache line");
+TWAMP_STATIC_ASSERT(offsetof(struct twamp_nexthop, latency_us) == 16 &&
+                    offsetof(struct twamp_nexthop, active) == 20 &&
+                    offsetof(struct twamp_nexthop, measured) == 21 &&
+                    offsetof(struct twamp_nexthop, epoch) == 22 &&
+                    offsetof(struct twamp_nexthop, seq) == 24 &&
+                    offsetof(struct twamp_nexthop, gen) == 28 &&
+                    offsetof(struct twamp_nexthop, meas_epoch) == 32 &&
+                    offsetof(struct twamp_nexthop, vrf_ifindex) == 36 &&
+                    offsetof(struct twamp_nexthop, last_updated) == 40 &&
+                    offsetof(struct twamp_nexthop, jitter_us) == 48 &&
+                    offsetof(struct twamp_nexthop, loss_permille) == 52 &&
+                    offsetof(struct twamp_nexthop, probe_cycle_sec) == 56 &&
+                    offsetof(struct twamp_nexthop, packet_count) == 58 &&
+                    offsetof(struct twamp_nexthop, dscp) == 59 &&
+                    offsetof(struct twamp_nexthop, forward_us) == 60,
+                    "twamp_nexthop field offsets changed");
+TWAMP_STATIC_ASSERT(sizeof(struct twamp_shm_config) == 64,
+                    "twamp_shm_config must be 64 bytes");
+TWAMP_STATIC_ASSERT(sizeof(struct twamp_hash_bucket) == 8,
+                    "twamp_hash_bucket must be 8 bytes");
+
+/* Smallest valid capacity holding at least n entries, 0 if too many */
+static inline uint32_t twamp_capacity_for(uint32_t n)
+{
+    uint32_t cap = TWAMP_MIN_CAPACITY;
+
+    while (cap < n && cap < TWAMP_MAX_CAPACITY)
+        cap <<= 1;
+    return cap >= n ? cap : 0;
+}
+
+static inline uint32_t twamp_align_up(uint32_t off)
+{
+    return (off + TWAMP_CACHELINE - 1) & ~(uint32_t)(TWAMP_CACHELINE - 1);
+}
+
+/*
+ * Work out the layout of a segment with the given capacity into everything
+ * but hdr->magic and hdr->flags.  Used both to build a header and, on the
+ * reading side, to check one.
+ */
+static inline void twamp_shm_layout(struct twamp_shm_hdr *hdr,
+                                    uint32_t capacity)
+{
+    uint32_t off;
+
+    hdr->version = TWAMP_SHM_VERSION;
+    hdr->hdr_size = sizeof(struct twamp_shm_hdr);
+    hdr->entry_size = sizeof(struct twamp_nexthop);
+    hdr->capacity = capacity;
+    hdr->hash_size = capacity * 2;
+    hdr->off_writer_lock = offsetof(struct twamp_shm, writer_lock);
+    hdr->off_nh_count = offsetof(struct twamp_shm, nh_count);
+    hdr->off_sequence = offsetof(struct twamp_shm, sequence);
+    hdr->off_nh_gen = offsetof(struct twamp_shm, nh_gen);
+    hdr->off_config = offsetof(struct twamp_shm, config);
+
+    off = twamp_align_up(sizeof(struct twamp_shm));
+    hdr->off_dirty = off;
+    off = twamp_align_up(off + TWAMP_DIRTY_WORDS(capacity) * 8);
+    hdr->off_nexthops = off;
+    off = twamp_align_up(off + capacity * sizeof(struct twamp_nexthop));
+    hdr->off_index = off;
+    hdr->total_size = off + hdr->hash_size * sizeof(struct twamp_hash_bucket);
+    hdr->reserved = 0;
+}
+
+/* Fill in the header of a fresh segment; magic is published last */
+static inline void twamp_shm_hdr_init(struct twamp_shm *shm, uint32_t capacity)
+{
+    twamp_shm_layout(&shm->hdr, capacity);
+    shm->hdr.flags = 0;
+    __atomic_store_n(&shm->hdr.magic, TWAMP_SHM_MAGIC, __ATOMIC_RELEASE);
+}
+
+/*
+ * Check that a mapped segment of map_size bytes has a layout this build
+ * can use through struct twamp_shm and the accessors below.  Returns NULL
+ * if so, otherwise a short reason.
+ */
+static inline const char *twamp_shm_hdr_check(const struct twamp_shm *shm,
+                                              size_t map_size)
+{
+    const struct twamp_shm_hdr *hdr = &shm->hdr;
+    struct twamp_shm_hdr want;
+
+    if (map_size < sizeof(struct twamp_shm))
+        return "segment too small";
+    if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != TWAMP_SHM_MAGIC)
+        return "bad magic (not initialized or foreign endianness)";
+    if (hdr->version != TWAMP_SHM_VERSION)
+        return "unsupported version";
+    if (hdr->hdr_size != sizeof(struct twamp_shm_hdr) ||
+        hdr->entry_size != sizeof(struct twamp_nexthop))
+        return "record size mismatch";
+    if (twamp_capacity_for(hdr->capacity) != hdr->capacity)
+        return "invalid capacity";
+
+    twamp_shm_layout(&want, hdr->capacity);
+    if (hdr->hash_size != want.hash_size ||
+        hdr->off_writer_lock != want.off_writer_lock ||
+        hdr->off_nh_count != want.off_nh_count ||
+        hdr->off_sequence != want.off_sequence ||
+        hdr->off_nh_gen != want.off_nh_gen ||
+        hdr->off_config != want.off_config ||
+        hdr->off_dirty != want.off_dirty ||
+        hdr->off_nexthops != want.off_nexthops ||
+        hdr->off_index != want.off_index)
+        return "field offset mismatch";
+    if (hdr->total_size != want.total_size || map_size < hdr->total_size)
+        return "segment size mismatch";
+    return NULL;
+}
+
+static inline int twamp_shm_superseded(const struct twamp_shm *shm)
+{
+    return __atomic_load_n(&shm->hdr.flags, __ATOMIC_ACQUIRE) &
+           TWAMP_SHM_F_SUPERSEDED;
+}
+
+static inline struct twamp_nexthop *twamp_shm_nexthops(struct twamp_shm *shm)
+{
+    return (struct twamp_nexthop *)((char *)shm + shm->hdr.off_nexthops);
+}
+
+static inline const struct twamp_nexthop *
+twamp_shm_nexthops_c(const struct twamp_shm *shm)
+{
+    return (const struct twamp_nexthop *)((const char *)shm +
+                                          shm->hdr.off_nexthops);
+}
+
+static inline uint64_t *twamp_shm_dirty(struct twamp_shm *shm)
+{
+    return (uint64_t *)((char *)shm + shm->hdr.off_dirty);
+}
+
+static inline struct twamp_hash_bucket *twamp_shm_index(struct twamp_shm *shm)
+{
+    return (struct twamp_hash_bucket *)((char *)shm + shm->hdr.off_index);
+}
+
+static inline const struct twamp_hash_bucket *
+twamp_shm_index_c(const struct twamp_shm *shm)
+{
+    return (const struct twamp_hash_bucket *)((const char *)shm +
+                                              shm->hdr.off_index);
+}
+
+/* The segment key of an IPv4 address (network byte order) */
+static inline void twamp_addr_from_ipv4(struct in6_addr *key, uint32_t addr)
+{
+    memset(key, 0, sizeof(*key));
+    key->s6_addr[10] = 0xff;
+    key->s6_addr[11] = 0xff;
+    memcpy(&key->s6_addr[12], &addr, sizeof(addr));
+}
+
+static inline int twamp_addr_is_ipv4(const struct in6_addr *key)
+{
+    static const uint8_t prefix[12] = { 0, 0, 0, 0, 0, 0, 0, 0,
+                                        0, 0, 0xff, 0xff };
+
+    return memcmp(key->s6_addr, prefix, sizeof(prefix)) == 0;
+}
+
+static inline int twamp_addr_equal(const struct in6_addr *a,
+                                   const struct in6_addr *b)
+{
+    return memcmp(a, b, sizeof(*a)) == 0;
+}
+
+/*
+ * Copy an entry's address word by word.  Agents read it concurrently with
+ * bgpd's membership updates and rely on nh_gen to discard a torn copy.
+ */
+static inline void twamp_addr_load(const struct in6_addr *src,
+                                   struct in6_addr *dst)
+{
+    const uint32_t *from = (const uint32_t *)(const void *)src;
+    uint32_t w[4];
+    int n;
+
+    for (n = 0; n < 4; n++)
+        w[n] = __atomic_load_n(&from[n], __ATOMIC_RELAXED);
+    memcpy(dst, w, sizeof(w));
+}
+
+/* Fold an address and VRF into the 32-bit tag kept in its index bucket */
+static inline uint32_t twamp_addr_tag(const struct in6_addr *key,
+                                      uint32_t vrf_ifindex)
+{
+    uint32_t w[4];
+
+    memcpy(w, key, sizeof(w));
+    return (((w[0] * 2654435761U ^ w[1]) * 2654435761U ^ w[2]) *
+                2654435761U ^ w[3]) * 2654435761U ^ vrf_ifindex;
+}
+
+/* The tag of an entry of any class, the same as above for the default one */
+static inline uint32_t twamp_addr_tag_class(const struct in6_addr *key,
+                                            uint32_t vrf_ifindex, uint8_t dscp)
+{
+    return twamp_addr_tag(key, vrf_ifindex) ^ (uint32_t)dscp * 2654435761U;
+}
+
+/* Fibonacci hash of a tag to a bucket */
+static inline uint32_t twamp_hash_tag(uint32_t tag, uint32_t hash_size)
+{
+    return (tag * 2654435761U) >> (32 - __builtin_ctz(hash_size));
+}
+
+/*
+ * Find the nexthops[] index for key in the given VRF and traffic class,
+ * or -1.  bgpd can call this directly; other processes must bracket it
+ * with twamp_seq_read_begin/retry on nh_gen and load the address with
+ * twamp_addr_load() if they need it.
+ */
+static inline int twamp_shm_find_class(const struct twamp_shm *shm,
+                                       const struct in6_addr *key,
+                                       uint32_t vrf_ifindex, uint8_t dscp)
+{
+    const struct twamp_hash_bucket *index = twamp_shm_index_c(shm);
+    const struct twamp_nexthop *ent = twamp_shm_nexthops_c(shm);
+    uint32_t mask = shm->hdr.hash_size - 1;
+    uint32_t tag = twamp_addr_tag_class(key, vrf_ifindex, dscp);
+    uint32_t b = twamp_hash_tag(tag, shm->hdr.hash_size);
+    uint32_t n;
+
+    for (n = 0; n <= mask; n++, b = (b + 1) & mask) {
+        const struct twamp_hash_bucket *bkt = &index[b];
+
+        if (bkt->slot == 0)
+            return -1;
+        if (bkt->slot != TWAMP_SLOT_TOMBSTONE && bkt->tag == tag &&
+            bkt->slot <= shm->hdr.capacity &&
+            ent[bkt->slot - 1].vrf_ifindex == vrf_ifindex &&
+            ent[bkt->slot - 1].dscp == dscp &&
+            twamp_addr_equal(&ent[bkt->slot - 1].addr, key))
+            return (int)bkt->slot - 1;
+    }
+    return -1;
+}
+
+/* The same in the default traffic class */
+static inline int twamp_shm_find(const struct twamp_shm *shm,
+                                 const struct in6_addr *key,
+                                 uint32_t vrf_ifindex)
+{
+    return twamp_shm_find_class(shm, key, vrf_ifindex, 0);
+}
+
+/*
+ * Sequence counter helpers.  These use the GCC/clang __atomic builtins so
+ * the same code works from bgpd (C11) and from the C++ agent.
+ */
+#define TWAMP_SEQ_RETRIES 64
+
+static inline uint32_t twamp_seq_read_begin(const uint32_t *seq)
+{
+    return __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+}
+
+static inline int twamp_seq_read_retry(const uint32_t *seq, uint32_t start)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (start & 1) || __atomic_load_n(seq, __ATOMIC_RELAXED) != start;
+}
+
+static inline void twamp_seq_write_begin(uint32_t *seq)
+{
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void twamp_seq_write_end(uint32_t *seq)
+{
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Lock-free read of an entry's measurement.  Returns 0 on success, -1 if a
+ * writer kept the entry busy for TWAMP_SEQ_RETRIES attempts (most likely it
+ * died mid-update).  A measurement taken for an earlier occupant of the
+ * slot reads as not measured.
+ */
+static inline int twamp_nexthop_read(const struct twamp_nexthop *nh,
+                                     uint32_t *latency_us, uint8_t *measured,
+                                     int64_t *last_updated)
+{
+    uint32_t start, meas_epoch;
+    int n;
+
+    for (n = 0; n < TWAMP_SEQ_RETRIES; n++) {
+        start = twamp_seq_read_begin(&nh->seq);
+        *latency_us = __atomic_load_n(&nh->latency_us, __ATOMIC_RELAXED);
+        *measured = __atomic_load_n(&nh->measured, __ATOMIC_RELAXED);
+        *last_updated = __atomic_load_n(&nh->last_updated, __ATOMIC_RELAXED);
+        meas_epoch = __atomic_load_n(&nh->meas_epoch, __ATOMIC_RELAXED);
+        if (!twamp_seq_read_retry(&nh->seq, start)) {
+            if (meas_epoch != __atomic_load_n(&nh->epoch, __ATOMIC_RELAXED))
+                *measured = 0;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Jitter and loss of the last measurement of an entry, read the same way.
+ * They are kept when a round gets no reply at all (loss_permille is 1000
+ * then), and read as 0 for an earlier occupant of the slot.  Returns 0 on
+ * success, -1 if it kept changing.
+ */
+static inline int twamp_nexthop_read_quality(const struct twamp_nexthop *nh,
+                                             uint32_t *jitter_us,
+                                             uint16_t *loss_permille)
+{
+    uint32_t start, meas_epoch;
+    int n;
+
+    for (n = 0; n < TWAMP_SEQ_RETRIES; n++) {
+        start = twamp_seq_read_begin(&nh->seq);
+        *jitter_us = __atomic_load_n(&nh->jitter_us, __ATOMIC_RELAXED);
+        *loss_permille = __atomic_load_n(&nh->loss_permille, __ATOMIC_RELAXED);
+        meas_epoch = __atomic_load_n(&nh->meas_epoch, __ATOMIC_RELAXED);
+        if (!twamp_seq_read_retry(&nh->seq, start)) {
+            if (meas_epoch != __atomic_load_n(&nh->epoch, __ATOMIC_RELAXED)) {
+                *jitter_us = 0;
+                *loss_permille = 0;
+            }
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * One-way delay towards the nexthop of the last measurement, 0 if it was
+ * not taken one way or was for an earlier occupant of the slot.  Returns
+ * 0 on success, -1 if it kept changing.
+ */
+static inline int twamp_nexthop_read_forward(const struct twamp_nexthop *nh,
+                                             uint32_t *forward_us)
+{
+    uint32_t start, meas_epoch;
+    int n;
+
+    for (n = 0; n < TWAMP_SEQ_RETRIES; n++) {
+        start = twamp_seq_read_begin(&nh->seq);
+        *forward_us = __atomic_load_n(&nh->forward_us, __ATOMIC_RELAXED);
+        meas_epoch = __atomic_load_n(&nh->meas_epoch, __ATOMIC_RELAXED);
+        if (!twamp_seq_read_retry(&nh->seq, start)) {
+            if (meas_epoch != __atomic_load_n(&nh->epoch, __ATOMIC_RELAXED))
+                *forward_us = 0;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * A read-only mapping of the segment, for daemons that only look
+ * measurements up (babeld, vrrpd, zebra).  Zero-initialized when detached.
+ */
+struct twamp_shm_reader {
+    const struct twamp_shm *shm;
+    size_t size;
+    ino_t ino;
 };
 
+static inline void twamp_shm_reader_detach(struct twamp_shm_reader *r)
+{
+    if (!r->shm)
+        return;
+    munmap((void *)r->shm, r->size);
+    r->shm = NULL;
+    r->size = 0;
+}
+
+/*
+ * Map whatever bgpd currently publishes; meant to be called once per
+ * polling pass.  Returns non-zero while attached.  *why is set when a
+ * segment is there but unusable, NULL otherwise.
+ */
+static inline int twamp_shm_reader_attach(struct twamp_shm_reader *r,
+                                          const char **why)
+{
+    struct stat st;
+    void *seg;
+    int fd;
+
+    *why = NULL;
+    fd = shm_open(TWAMP_SHM_NAME, O_RDONLY, 0);
+    if (fd < 0) {
+        twamp_shm_reader_detach(r);
+        return 0;
+    }
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        twamp_shm_reader_detach(r);
+        return 0;
+    }
+
+    /* bgpd grew the segment, or restarted and made a new one */
+    if (r->shm && (twamp_shm_superseded(r->shm) || st.st_ino != r->ino))
+        twamp_shm_reader_detach(r);
+    if (r->shm) {
+        close(fd);
+        return 1;
+    }
+
+    if (st.st_size < (off_t)sizeof(struct twamp_shm)) {
+        close(fd);
+        return 0;
+    }
+    seg = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (seg == MAP_FAILED)
+        return 0;
+
+    *why = twamp_shm_hdr_check((const struct twamp_shm *)seg, st.st_size);
+    if (*why) {
+        munmap(seg, st.st_size);
+        return 0;
+    }
+
+    r->shm = (const struct twamp_shm *)seg;
+    r->size = st.st_size;
+    r->ino = st.st_ino;
+    return 1;
+}
+
+/*
+ * The last measurement of key in the given VRF, in the default traffic
+ * class.  Returns 0 on success, -1 if bgpd does not list it, it has no
+ * measurement older than max_age seconds, or it kept changing.  A lost
+ * nexthop comes back with loss_permille 1000.
+ */
+static inline int twamp_shm_reader_lookup(const struct twamp_shm_reader *r,
+                                          const struct in6_addr *key,
+                                          uint32_t vrf_ifindex, int max_age,
+                                          uint32_t *latency_us,
+                                          uint32_t *jitter_us,
+                                          uint16_t *loss_permille)
+{
+    const struct twamp_shm *shm = r->shm;
+    const struct twamp_nexthop *ent;
+    uint32_t start;
+    uint8_t measured;
+    int64_t updated;
+    int i = -1, n;
 
-struct bgp;
+    if (!shm)
+        return -1;
 
+    /* Membership is bgpd's, read under its counter */
+    for (n = 0; n < TWAMP_SEQ_RETRIES; n++) {
+        start = twamp_seq_read_begin(&shm->nh_gen);
+        i = twamp_shm_find(shm, key, vrf_ifindex);
+        if (!twamp_seq_read_retry(&shm->nh_gen, start))
+            break;
+    }
+    if (n == TWAMP_SEQ_RETRIES || i < 0)
+        return -1;
 
-void bgp_twamp_init(struct bgp *bgp);
-void bgp_twamp_add_nexthop(struct in_addr *nh);
-void bgp_twamp_remove_nexthop(struct in_addr *nh);
-uint32_t bgp_twamp_get_latency(struct in_addr *nh);
-void bgp_twamp_cleanup(void);
-void bgp_twamp_collect_nexthops(struct bgp *bgp);
+    ent = &twamp_shm_nexthops_c(shm)[i];
+    if (twamp_nexthop_read(ent, latency_us, &measured, &updated) ||
+        twamp_nexthop_read_quality(ent, jitter_us, loss_permille))
+        return -1;
+    if (!measured || updated + max_age < (int64_t)time(NULL))
+        return -1;
+    return 0;
+}
+
+/*
+ * Publish a measurement for nexthops[i], taken against the occupant that
+ * had the given epoch, and flag the slot dirty.  Caller holds writer_lock.
+ */
+static inline void twamp_shm_publish(struct twamp_shm *shm, uint32_t i,
+                                     uint16_t epoch, uint32_t latency_us,
+                                     uint32_t jitter_us, uint16_t loss_permille,
+                                     uint32_t forward_us, uint8_t measured,
+                                     int64_t last_updated)
+{
+    struct twamp_nexthop *nh = &twamp_shm_nexthops(shm)[i];
+
+    twamp_seq_write_begin(&nh->seq);
+    __atomic_store_n(&nh->latency_us, latency_us, __ATOMIC_RELAXED);
+    __atomic_store_n(&nh->jitter_us, jitter_us, __ATOMIC_RELAXED);
+    __atomic_store_n(&nh->loss_permille, loss_permille, __ATOMIC_RELAXED);
+    __atomic_store_n(&nh->forward_us, forward_us, __ATOMIC_RELAXED);
+    __atomic_store_n(&nh->measured, measured, __ATOMIC_RELAXED);
+    __atomic_store_n(&nh->last_updated, last_updated, __ATOMIC_RELAXED);
+    __atomic_store_n(&nh->meas_epoch, epoch, __ATOMIC_RELAXED);
+    __atomic_store_n(&nh->gen, nh->gen + 1, __ATOMIC_RELAXED);
+    twamp_seq_write_end(&nh->seq);
+
+    __atomic_fetch_or(&twamp_shm_dirty(shm)[i / 64], 1ULL << (i % 64),
+                      __ATOMIC_RELEASE);
+}
+
+/*
+ * Collect and clear the dirty bitmap into out[], which must hold
+ * TWAMP_DIRTY_WORDS(capacity) words.  Returns non-zero if any slot was
+ * flagged.
+ */
+static inline int twamp_shm_take_dirty(struct twamp_shm *shm, uint64_t *out)
+{
+    uint64_t *dirty = twamp_shm_dirty(shm);
+    uint32_t words = TWAMP_DIRTY_WORDS(shm->hdr.capacity);
+    uint64_t any = 0;
+    uint32_t w;
+
+    for (w = 0; w < words; w++) {
+        out[w] = __atomic_load_n(&dirty[w], __ATOMIC_RELAXED)
+                     ? __atomic_exchange_n(&dirty[w], 0, __ATOMIC_ACQ_REL)
+                     : 0;
+        any |= out[w];
+    }
+    return any != 0;
+}
+
+static inline int twamp_dirty_test(const uint64_t *dirty, uint32_t i)
+{
+    return (dirty[i / 64] >> (i % 64)) & 1;
+}
+
+/*
+ * Lock-free copy of the configuration block.  Returns 0 on success, -1 if
+ * bgpd kept changing it for TWAMP_SEQ_RETRIES attempts.
+ */
+static inline int twamp_shm_config_read(const struct twamp_shm *shm,
+                                        struct twamp_shm_config *cfg)
+{
+    const struct twamp_shm_config *from = &shm->config;
+    uint32_t start;
+    int n;
+
+    for (n = 0; n < TWAMP_SEQ_RETRIES; n++) {
+        start = twamp_seq_read_begin(&from->gen);
+        memset(cfg, 0, sizeof(*cfg));
+        cfg->present = __atomic_load_n(&from->present, __ATOMIC_RELAXED);
+        cfg->damping_threshold_us =
+            __atomic_load_n(&from->damping_threshold_us, __ATOMIC_RELAXED);
+        cfg->port = __atomic_load_n(&from->port, __ATOMIC_RELAXED);
+        cfg->probe_cycle_sec =
+            __atomic_load_n(&from->probe_cycle_sec, __ATOMIC_RELAXED);
+        cfg->packet_count =
+            __atomic_load_n(&from->packet_count, __ATOMIC_RELAXED);
+        if (!twamp_seq_read_retry(&from->gen, start)) {
+            cfg->gen = start;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* bgpd's side: replace the configuration block, readers retry meanwhile */
+static inline void twamp_shm_config_write(struct twamp_shm *shm,
+                                          const struct twamp_shm_config *cfg)
+{
+    struct twamp_shm_config *to = &shm->config;
+
+    twamp_seq_write_begin(&to->gen);
+    __atomic_store_n(&to->present, cfg->present, __ATOMIC_RELAXED);
+    __atomic_store_n(&to->damping_threshold_us, cfg->damping_threshold_us,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&to->port, cfg->port, __ATOMIC_RELAXED);
+    __atomic_store_n(&to->probe_cycle_sec, cfg->probe_cycle_sec,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&to->packet_count, cfg->packet_count, __ATOMIC_RELAXED);
+    twamp_seq_write_end(&to->gen);
+}
+
+/*
+ * Take the measurement writer lock.  If the previous holder died, close out
+ * any update it left half-done (odd seq): the entry is marked unmeasured and
+ * its seq made even again before the mutex is declared consistent.
+ */
+static inline int twamp_shm_writer_lock(struct twamp_shm *shm)
+{
+    uint32_t i;
+    int ret;
+
+    ret = pthread_mutex_lock(&shm->writer_lock);
+    if (ret == EOWNERDEAD) {
+        for (i = 0; i < shm->nh_count && i < shm->hdr.capacity; i++) {
+            struct twamp_nexthop *nh = &twamp_shm_nexthops(shm)[i];
+
+            if (nh->seq & 1) {
+                nh->measured = 0;
+                nh->latency_us = UINT32_MAX;
+                nh->forward_us = 0;
+                twamp_seq_write_end(&nh->seq);
+                __atomic_fetch_or(&twamp_shm_dirty(shm)[i / 64],
+                                  1ULL << (i % 64), __ATOMIC_RELEASE);
+            }
+        }
+        ret = pthread_mutex_consistent(&shm->writer_lock);
+    }
+    return ret;
+}
+
+static inline void twamp_shm_writer_unlock(struct twamp_shm *shm)
+{
+    pthread_mutex_unlock(&shm->writer_lock);
+}
+
+/*
+ * Internet egress.  A second, independent segment lists destinations to
+ * be measured through each of several exits (eBGP transits) rather than
+ * nexthops: bgpd picks a representative host address in each prefix it
+ * ranks by latency, and the fwmark that policy routing sends traffic out
+ * of the exit with.  Internet hosts run no TWAMP reflector, so agents
+ * time a TCP handshake towards the host from a socket carrying the mark
+ * (SO_MARK), a RST counting as an answer as much as a SYN-ACK.
+ *
+ * The layout follows twamp_shm's: a 64-byte header published with magic,
+ * the dirty bitmap, then entries[capacity], each at a cache-line aligned
+ * offset recorded in hdr.  There is no index, agents walk entries[0..count)
+ * and bgpd keeps its own lookup.  capacity is a power of two up to
+ * TWAMP_EGRESS_MAX_CAPACITY; a segment that is too small is replaced
+ * under the same name and the old one flagged TWAMP_SHM_F_SUPERSEDED,
+ * empty, since bgpd re-adds every destination anyway.
+ *
+ * Ownership is as in twamp_shm: bgpd owns count, gen and dest, mark,
+ * active and epoch of every entry, changed under gen; the agent owns
+ * rtt_us, loss_permille, measured, last_updated and meas_epoch, published
+ * under the entry's seq, bumps sequence after a batch and signals the same
+ * eventfd as for nexthops.  There is a single egress agent, so there is
+ * no writer lock.
+ */
+#define TWAMP_EGRESS_SHM_NAME "/bgp_twamp_egress"
+#define TWAMP_EGRESS_MAGIC 0x47455754U /* "TWEG" in little-endian memory */
+#define TWAMP_EGRESS_VERSION 1
+#define TWAMP_EGRESS_MAX_CAPACITY (1U << 20)
+
+struct twamp_egress_hdr {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t hdr_size;        /* sizeof(struct twamp_egress_hdr) */
+    uint32_t entry_size;      /* sizeof(struct twamp_egress) */
+    uint32_t capacity;        /* entries in entries[] */
+    uint32_t off_dirty;
+    uint32_t off_entries;
+    uint32_t total_size;      /* bytes the segment must be mapped with */
+    uint32_t flags;           /* TWAMP_SHM_F_* */
+    uint32_t reserved[8];
+};
+
+/*
+ * dest is stored like a nexthop address, IPv4 v4-mapped.  rtt_us is the
+ * median handshake time of the last round, UINT32_MAX if none answered,
+ * and loss_permille the share of handshakes that did not.
+ */
+struct twamp_egress {
+    struct in6_addr dest;
+    uint32_t mark;            /* SO_MARK of the exit */
+    uint32_t rtt_us;
+    uint32_t seq;
+    uint16_t epoch;
+    uint16_t meas_epoch;
+    uint16_t loss_permille;
+    uint8_t active;
+    uint8_t measured;
+    uint32_t gen;
+    int64_t last_updated;     /* time_t seconds */
+};
+
+/* Fixed head of the egress segment, see above */
+struct twamp_egress_shm {
+    struct twamp_egress_hdr hdr;
+    uint32_t count;
+    uint32_t gen;
+    uint32_t sequence;
+    uint32_t pad;
+};
+
+TWAMP_STATIC_ASSERT(sizeof(struct twamp_egress_hdr) == 64,
+                    "twamp_egress_hdr must be 64 bytes");
+TWAMP_STATIC_ASSERT(sizeof(struct twamp_egress) == 48 &&
+                    offsetof(struct twamp_egress, mark) == 16 &&
+                    offsetof(struct twamp_egress, rtt_us) == 20 &&
+                    offsetof(struct twamp_egress, seq) == 24 &&
+                    offsetof(struct twamp_egress, epoch) == 28 &&
+                    offsetof(struct twamp_egress, meas_epoch) == 30 &&
+                    offsetof(struct twamp_egress, loss_permille) == 32 &&
+                    offsetof(struct twamp_egress, active) == 34 &&
+                    offsetof(struct twamp_egress, measured) == 35 &&
+                    offsetof(struct twamp_egress, gen) == 36 &&
+                    offsetof(struct twamp_egress, last_updated) == 40,
+                    "twamp_egress field offsets changed");
+
+/* Smallest valid egress capacity holding at least n entries, 0 if too many */
+static inline uint32_t twamp_egress_capacity_for(uint32_t n)
+{
+    uint32_t cap = TWAMP_MIN_CAPACITY;
+
+    while (cap < n && cap < TWAMP_EGRESS_MAX_CAPACITY)
+        cap <<= 1;
+    return cap >= n ? cap : 0;
+}
+
+static inline void twamp_egress_layout(struct twamp_egress_hdr *hdr,
+                                       uint32_t capacity)
+{
+    uint32_t off;
+
+    memset(hdr->reserved, 0, sizeof(hdr->reserved));
+    hdr->version = TWAMP_EGRESS_VERSION;
+    hdr->hdr_size = sizeof(struct twamp_egress_hdr);
+    hdr->entry_size = sizeof(struct twamp_egress);
+    hdr->capacity = capacity;
+
+    off = twamp_align_up(sizeof(struct twamp_egress_shm));
+    hdr->off_dirty = off;
+    off = twamp_align_up(off + TWAMP_DIRTY_WORDS(capacity) * 8);
+    hdr->off_entries = off;
+    hdr->total_size = off + capacity * sizeof(struct twamp_egress);
+}
+
+static inline void twamp_egress_hdr_init(struct twamp_egress_shm *shm,
+                                         uint32_t capacity)
+{
+    twamp_egress_layout(&shm->hdr, capacity);
+    shm->hdr.flags = 0;
+    __atomic_store_n(&shm->hdr.magic, TWAMP_EGRESS_MAGIC, __ATOMIC_RELEASE);
+}
+
+/* As twamp_shm_hdr_check(), for the egress segment */
+static inline const char *
+twamp_egress_hdr_check(const struct twamp_egress_shm *shm, size_t map_size)
+{
+    const struct twamp_egress_hdr *hdr = &shm->hdr;
+    struct twamp_egress_hdr want;
+
+    if (map_size < sizeof(struct twamp_egress_shm))
+        return "segment too small";
+    if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != TWAMP_EGRESS_MAGIC)
+        return "bad magic (not initialized or foreign endianness)";
+    if (hdr->version != TWAMP_EGRESS_VERSION)
+        return "unsupported version";
+    if (hdr->hdr_size != sizeof(struct twamp_egress_hdr) ||
+        hdr->entry_size != sizeof(struct twamp_egress))
+        return "record size mismatch";
+    if (twamp_egress_capacity_for(hdr->capacity) != hdr->capacity)
+        return "invalid capacity";
+
+    twamp_egress_layout(&want, hdr->capacity);
+    if (hdr->off_dirty != want.off_dirty ||
+        hdr->off_entries != want.off_entries)
+        return "field offset mismatch";
+    if (hdr->total_size != want.total_size || map_size < hdr->total_size)
+        return "segment size mismatch";
+    return NULL;
+}
+
+static inline struct twamp_egress *
+twamp_egress_entries(struct twamp_egress_shm *shm)
+{
+    return (struct twamp_egress *)((char *)shm + shm->hdr.off_entries);
+}
+
+static inline const struct twamp_egress *
+twamp_egress_entries_c(const struct twamp_egress_shm *shm)
+{
+    return (const struct twamp_egress *)((const char *)shm +
+                                         shm->hdr.off_entries);
+}
+
+static inline uint64_t *twamp_egress_dirty(struct twamp_egress_shm *shm)
+{
+    return (uint64_t *)((char *)shm + shm->hdr.off_dirty);
+}
+
+/*
+ * Lock-free read of an entry's measurement, as twamp_nexthop_read().  A
+ * measurement taken for an earlier occupant of the slot reads as not
+ * measured, without loss.
+ */
+static inline int twamp_egress_read(const struct twamp_egress *ent,
+                                    uint32_t *rtt_us, uint16_t *loss_permille,
+                                    uint8_t *measured, int64_t *last_updated)
+{
+    uint32_t start, meas_epoch;
+    int n;
+
+    for (n = 0; n < TWAMP_SEQ_RETRIES; n++) {
+        start = twamp_seq_read_begin(&ent->seq);
+        *rtt_us = __atomic_load_n(&ent->rtt_us, __ATOMIC_RELAXED);
+        *loss_permille = __atomic_load_n(&ent->loss_permille,
+                                         __ATOMIC_RELAXED);
+        *measured = __atomic_load_n(&ent->measured, __ATOMIC_RELAXED);
+        *last_updated = __atomic_load_n(&ent->last_updated, __ATOMIC_RELAXED);
+        meas_epoch = __atomic_load_n(&ent->meas_epoch, __ATOMIC_RELAXED);
+        if (!twamp_seq_read_retry(&ent->seq, start)) {
+            if (meas_epoch != __atomic_load_n(&ent->epoch, __ATOMIC_RELAXED)) {
+                *measured = 0;
+                *loss_permille = 0;
+            }
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* The agent's side: publish a round for entries[i] and flag it dirty */
+static inline void twamp_egress_publish(struct twamp_egress_shm *shm,
+                                        uint32_t i, uint16_t epoch,
+                                        uint32_t rtt_us,
+                                        uint16_t loss_permille,
+                                        uint8_t measured, int64_t last_updated)
+{
+    struct twamp_egress *ent = &twamp_egress_entries(shm)[i];
+
+    twamp_seq_write_begin(&ent->seq);
+    __atomic_store_n(&ent->rtt_us, rtt_us, __ATOMIC_RELAXED);
+    __atomic_store_n(&ent->loss_permille, loss_permille, __ATOMIC_RELAXED);
+    __atomic_store_n(&ent->measured, measured, __ATOMIC_RELAXED);
+    __atomic_store_n(&ent->last_updated, last_updated, __ATOMIC_RELAXED);
+    __atomic_store_n(&ent->meas_epoch, epoch, __ATOMIC_RELAXED);
+    __atomic_store_n(&ent->gen, ent->gen + 1, __ATOMIC_RELAXED);
+    twamp_seq_write_end(&ent->seq);
+
+    __atomic_fetch_or(&twamp_egress_dirty(shm)[i / 64], 1ULL << (i % 64),
+                      __ATOMIC_RELEASE);
+}
+
+/* As twamp_shm_take_dirty() */
+static inline int twamp_egress_take_dirty(struct twamp_egress_shm *shm,
+                                          uint64_t *out)
+{
+    uint64_t *dirty = twamp_egress_dirty(shm);
+    uint32_t words = TWAMP_DIRTY_WORDS(shm->hdr.capacity);
+    uint64_t any = 0;
+    uint32_t w;
+
+    for (w = 0; w < words; w++) {
+        out[w] = __atomic_load_n(&dirty[w], __ATOMIC_RELAXED)
+                     ? __atomic_exchange_n(&dirty[w], 0, __ATOMIC_ACQ_REL)
+                     : 0;
+        any |= out[w];
+    }
+    return any != 0;
+}
 
 #ifdef __cplusplus
 }
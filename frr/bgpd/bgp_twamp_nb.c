@@ -0,0 +1,167 @@
+/*
+ * Operational state of latency-based path selection (frr-bgp-latency),
+ * so monitoring can poll the best-path change counters through the
+ * northbound instead of scraping vtysh.
+ */
+#include <zebra.h>
+
+#include "lib/northbound.h"
+#include "lib/vrf.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_nexthop.h"
+#include "bgpd/bgp_twamp.h"
+
+static const struct bgp *bgp_twamp_nb_instance(const void *list_entry)
+{
+	return listgetdata((const struct listnode *)list_entry);
+}
+
+/*
+ * XPath: /frr-bgp-latency:latency/instance
+ */
+static const void *latency_instance_get_next(struct nb_cb_get_next_args *args)
+{
+	if (args->list_entry == NULL)
+		return listhead(bm->bgp);
+	return listnextnode((struct listnode *)args->list_entry);
+}
+
+static int latency_instance_get_keys(struct nb_cb_get_keys_args *args)
+{
+	const struct bgp *bgp = bgp_twamp_nb_instance(args->list_entry);
+
+	args->keys->num = 1;
+	strlcpy(args->keys->key[0], bgp->name ? bgp->name : VRF_DEFAULT_NAME,
+		sizeof(args->keys->key[0]));
+
+	return NB_OK;
+}
+
+static const void *
+latency_instance_lookup_entry(struct nb_cb_lookup_entry_args *args)
+{
+	const char *name = args->keys->key[0];
+	struct listnode *node;
+	struct bgp *bgp;
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		if (strmatch(bgp->name ? bgp->name : VRF_DEFAULT_NAME, name))
+			return node;
+
+	return NULL;
+}
+
+/*
+ * XPath: /frr-bgp-latency:latency/instance/name
+ */
+static struct yang_data *
+latency_instance_name_get_elem(struct nb_cb_get_elem_args *args)
+{
+	const struct bgp *bgp = bgp_twamp_nb_instance(args->list_entry);
+
+	return yang_data_new_string(args->xpath,
+				    bgp->name ? bgp->name : VRF_DEFAULT_NAME);
+}
+
+/*
+ * XPath: /frr-bgp-latency:latency/instance/enabled
+ */
+static struct yang_data *
+latency_instance_enabled_get_elem(struct nb_cb_get_elem_args *args)
+{
+	const struct bgp *bgp = bgp_twamp_nb_instance(args->list_entry);
+
+	return yang_data_new_bool(args->xpath,
+				  bgp->import_latency_cfg.enabled);
+}
+
+/*
+ * XPath: /frr-bgp-latency:latency/instance/latency-best-path-changes
+ */
+static struct yang_data *
+latency_instance_latency_changes_get_elem(struct nb_cb_get_elem_args *args)
+{
+	const struct bgp *bgp = bgp_twamp_nb_instance(args->list_entry);
+
+	return yang_data_new_uint64(args->xpath, bgp->twamp_latency_changes);
+}
+
+/*
+ * XPath: /frr-bgp-latency:latency/instance/loss-best-path-changes
+ */
+static struct yang_data *
+latency_instance_loss_changes_get_elem(struct nb_cb_get_elem_args *args)
+{
+	const struct bgp *bgp = bgp_twamp_nb_instance(args->list_entry);
+
+	return yang_data_new_uint64(args->xpath, bgp->twamp_loss_changes);
+}
+
+/*
+ * XPath: /frr-bgp-latency:latency/instance/measured-nexthops
+ */
+static struct yang_data *
+latency_instance_measured_nexthops_get_elem(struct nb_cb_get_elem_args *args)
+{
+	const struct bgp *bgp = bgp_twamp_nb_instance(args->list_entry);
+	const struct bgp_nexthop_cache *bnc;
+	uint32_t measured = 0;
+	afi_t afi;
+
+	for (afi = AFI_IP; afi < AFI_MAX; afi++)
+		frr_each (bgp_nexthop_cache_const,
+			  &bgp->nexthop_cache_table[afi], bnc)
+			if (bnc->twamp_latency != UINT32_MAX)
+				measured++;
+
+	return yang_data_new_uint32(args->xpath, measured);
+}
+
+/* clang-format off */
+const struct frr_yang_module_info frr_bgp_latency_info = {
+	.name = "frr-bgp-latency",
+	.nodes = {
+		{
+			.xpath = "/frr-bgp-latency:latency/instance",
+			.cbs = {
+				.get_next = latency_instance_get_next,
+				.get_keys = latency_instance_get_keys,
+				.lookup_entry = latency_instance_lookup_entry,
+			}
+		},
+		{
+			.xpath = "/frr-bgp-latency:latency/instance/name",
+			.cbs = {
+				.get_elem = latency_instance_name_get_elem,
+			}
+		},
+		{
+			.xpath = "/frr-bgp-latency:latency/instance/enabled",
+			.cbs = {
+				.get_elem = latency_instance_enabled_get_elem,
+			}
+		},
+		{
+			.xpath = "/frr-bgp-latency:latency/instance/latency-best-path-changes",
+			.cbs = {
+				.get_elem = latency_instance_latency_changes_get_elem,
+			}
+		},
+		{
+			.xpath = "/frr-bgp-latency:latency/instance/loss-best-path-changes",
+			.cbs = {
+				.get_elem = latency_instance_loss_changes_get_elem,
+			}
+		},
+		{
+			.xpath = "/frr-bgp-latency:latency/instance/measured-nexthops",
+			.cbs = {
+				.get_elem = latency_instance_measured_nexthops_get_elem,
+			}
+		},
+		{
+			.xpath = NULL,
+		},
+	}
+};
@@ -0,0 +1,655 @@
+/*
+ * Latency nexthop groups.
+ *
+ * A group is keyed by the nexthops contending at the latency step for a
+ * destination: those of its valid, measured iBGP paths. Destinations
+ * with the same set, whose best path was decided by latency, all end up
+ * on the same winner, so they are installed with the group's id instead
+ * of nexthops of their own. The group holds the winner's resolved
+ * nexthops, as zebra takes them for protocol groups.
+ *
+ * When the latency snapshots move, bgp_twamp_nhg_reselect() picks each
+ * group's winner again, by the same damping threshold best-path goes by,
+ * and replaces the group in zebra: one nexthop update in the kernel for
+ * however many routes. Best-path then runs for the routes as usual, and
+ * their zebra updates, unchanged but for the path behind them, are not
+ * sent. A destination landing elsewhere is installed with its own
+ * nexthops again, leaving the group.
+ *
+ * With backups, each group also carries the nexthops of the next-best
+ * contender, the lowest latency PE but the winner. When the winner goes
+ * unreachable, or past the loss threshold, the backup takes the group
+ * over in a single replace, before best-path gets to any of the routes.
+ * Paths down for their PE only keep contending, so the routes stay on
+ * the group rather than each moving to one without it.
+ */
+#include "zebra.h"
+
+#include "lib/jhash.h"
+#include "lib/nexthop.h"
+#include "lib/typesafe.h"
+#include "lib/zclient.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_label.h"
+#include "bgpd/bgp_mpath.h"
+#include "bgpd/bgp_nexthop.h"
+#include "bgpd/bgp_nht.h"
+#include "bgpd/bgp_evpn.h"
+#include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_memory.h"
+#include "bgpd/bgp_twamp.h"
+#include "bgpd/bgp_twamp_nhg.h"
+
+DEFINE_MTYPE_STATIC(BGP_TWAMP, BGP_TWAMP_NHG, "BGP latency nexthop group");
+
+extern struct zclient *zclient;
+
+/* Contenders past this make for groups too rare to be worth it */
+#define BGP_TWAMP_NHG_CANDIDATES 8
+
+PREDECL_HASH(bgp_twamp_nhg_sets);
+PREDECL_HASH(bgp_twamp_nhg_ids);
+
+struct bgp_twamp_nhg {
+	struct bgp_twamp_nhg_sets_item set_item;
+	struct bgp_twamp_nhg_ids_item id_item;
+
+	struct bgp *bgp;
+	uint32_t id;
+	afi_t afi;
+
+	/* Destinations installed with the group */
+	uint32_t refcnt;
+
+	/*
+	 * The contending nexthops, sorted. A freed one leaves the group off
+	 * the sets hash, to be released by the routes still on it.
+	 */
+	unsigned int count;
+	struct bgp_nexthop_cache *candidates[BGP_TWAMP_NHG_CANDIDATES];
+	bool linked;
+
+	struct bgp_nexthop_cache *winner;
+	/* Next in line, see bgp_twamp_nhg_backup_pick() */
+	struct bgp_nexthop_cache *backup;
+	/* What zebra has, see bgp_twamp_nhg_content(); 0 for nothing */
+	uint32_t sent;
+};
+
+static int bgp_twamp_nhg_set_cmp(const struct bgp_twamp_nhg *a,
+				 const struct bgp_twamp_nhg *b)
+{
+	if (a->count != b->count)
+		return numcmp(a->count, b->count);
+	return memcmp(a->candidates, b->candidates,
+		      a->count * sizeof(a->candidates[0]));
+}
+
+static uint32_t bgp_twamp_nhg_set_hash(const struct bgp_twamp_nhg *nhg)
+{
+	return jhash(nhg->candidates, nhg->count * sizeof(nhg->candidates[0]),
+		     0x6c61746e);
+}
+
+DECLARE_HASH(bgp_twamp_nhg_sets, struct bgp_twamp_nhg, set_item,
+	     bgp_twamp_nhg_set_cmp, bgp_twamp_nhg_set_hash);
+
+static int bgp_twamp_nhg_id_cmp(const struct bgp_twamp_nhg *a,
+				const struct bgp_twamp_nhg *b)
+{
+	return numcmp(a->id, b->id);
+}
+
+static uint32_t bgp_twamp_nhg_id_hash(const struct bgp_twamp_nhg *nhg)
+{
+	return jhash_1word(nhg->id, 0);
+}
+
+DECLARE_HASH(bgp_twamp_nhg_ids, struct bgp_twamp_nhg, id_item,
+	     bgp_twamp_nhg_id_cmp, bgp_twamp_nhg_id_hash);
+
+static struct bgp_twamp_nhg_sets_head nhg_sets = INIT_HASH(nhg_sets);
+static struct bgp_twamp_nhg_ids_head nhg_ids = INIT_HASH(nhg_ids);
+
+/* Bumped as zebra restarts, so routes and groups are all sent again */
+static uint32_t nhg_epoch = 1;
+
+static int bgp_twamp_nhg_bnc_order(const void *a, const void *b)
+{
+	const struct bgp_nexthop_cache *ba = *(const void *const *)a;
+	const struct bgp_nexthop_cache *bb = *(const void *const *)b;
+
+	if (ba == bb)
+		return 0;
+	return ba < bb ? -1 : 1;
+}
+
+/* Installed with its nexthops as they are: no labels, SIDs or leaking */
+static bool bgp_twamp_nhg_path_plain(struct bgp *bgp,
+				     struct bgp_path_info *info, afi_t afi,
+				     safi_t safi)
+{
+	struct attr *attr = info->attr;
+
+	if (info->sub_type == BGP_ROUTE_AGGREGATE || !info->peer ||
+	    info->peer->sort != BGP_PEER_IBGP || is_route_parent_evpn(info))
+		return false;
+	if (info->extra && info->extra->vrfleak &&
+	    (info->extra->vrfleak->bgp_orig || info->extra->vrfleak->parent))
+		return false;
+	if (info->extra && info->extra->num_labels &&
+	    bgp_is_valid_label(&info->extra->label[0]))
+		return false;
+	if (attr->srv6_l3vpn || attr->srv6_vpn ||
+	    CHECK_FLAG(attr->flag, ATTR_FLAG_BIT(BGP_ATTR_SRTE_COLOR)) ||
+	    bgp_twamp_path_color(bgp, info))
+		return false;
+
+	/* A route-map may set the metric and tag, one route at a time */
+	if (bgp->table_map[afi][safi].name)
+		return false;
+
+	/* Multipaths are spread over several PEs, not won by one */
+	return !bgp_path_info_mpath_count(info);
+}
+
+/* A nexthop zebra takes in a protocol group: a gateway, on an interface */
+static bool bgp_twamp_nhg_bnc_usable(const struct bgp_nexthop_cache *bnc,
+				     afi_t afi)
+{
+	const struct nexthop *nh;
+
+	if (!bnc || !CHECK_FLAG(bnc->flags, BGP_NEXTHOP_VALID) ||
+	    !bnc->nexthop || bnc->nexthop_num >= MULTIPATH_NUM ||
+	    bnc->twamp_latency == UINT32_MAX)
+		return false;
+
+	/* No IPv6 nexthops for IPv4 routes, which zebra does on its own */
+	if (afi != bnc->afi)
+		return false;
+
+	for (nh = bnc->nexthop; nh; nh = nh->next)
+		if (nh->type == NEXTHOP_TYPE_BLACKHOLE || !nh->ifindex)
+			return false;
+	return true;
+}
+
+/* The contending nexthops of dest, into key; false if too many or few */
+static bool bgp_twamp_nhg_candidates(struct bgp_dest *dest,
+				     struct bgp_twamp_nhg *key)
+{
+	struct bgp_path_info *pi;
+	struct bgp_nexthop_cache *bnc;
+	unsigned int i;
+
+	key->count = 0;
+	for (pi = bgp_dest_get_bgp_path_info(dest); pi; pi = pi->next) {
+		if (CHECK_FLAG(pi->flags, BGP_PATH_REMOVED) || !pi->peer ||
+		    pi->peer->sort != BGP_PEER_IBGP)
+			continue;
+		bnc = pi->nexthop;
+		if (!bnc || bnc->twamp_latency == UINT32_MAX)
+			continue;
+		/* Down for its PE is still a contender, see above */
+		if (!CHECK_FLAG(pi->flags, BGP_PATH_VALID) &&
+		    CHECK_FLAG(bnc->flags, BGP_NEXTHOP_VALID))
+			continue;
+
+		for (i = 0; i < key->count; i++)
+			if (key->candidates[i] == bnc)
+				break;
+		if (i < key->count)
+			continue;
+		if (key->count == BGP_TWAMP_NHG_CANDIDATES)
+			return false;
+		key->candidates[key->count++] = bnc;
+	}
+
+	if (key->count < 2)
+		return false;
+
+	qsort(key->candidates, key->count, sizeof(key->candidates[0]),
+	      bgp_twamp_nhg_bnc_order);
+	return true;
+}
+
+static bool bgp_twamp_nhg_lossy(const struct bgp_twamp_nhg *nhg,
+				const struct bgp_nexthop_cache *bnc)
+{
+	uint16_t loss = nhg->bgp->import_latency_cfg.loss_threshold_permille;
+
+	return loss && bnc->twamp_loss >= loss;
+}
+
+/*
+ * The backup of the group: the lowest latency contender but the winner,
+ * not lost to the loss threshold. Best-path would go to it next, unless
+ * the damping threshold keeps the winner, which a failed winner is not.
+ */
+static struct bgp_nexthop_cache *
+bgp_twamp_nhg_backup_pick(const struct bgp_twamp_nhg *nhg)
+{
+	struct bgp_nexthop_cache *best = NULL, *bnc;
+	unsigned int i;
+
+	if (!nhg->bgp->import_latency_cfg.nexthop_group_backup)
+		return NULL;
+
+	for (i = 0; i < nhg->count; i++) {
+		bnc = nhg->candidates[i];
+		if (bnc == nhg->winner ||
+		    !bgp_twamp_nhg_bnc_usable(bnc, nhg->afi) ||
+		    bgp_twamp_nhg_lossy(nhg, bnc))
+			continue;
+		if (!best || bnc->twamp_latency < best->twamp_latency)
+			best = bnc;
+	}
+	return best;
+}
+
+/* The backup to send, if it can still be */
+static const struct bgp_nexthop_cache *
+bgp_twamp_nhg_backup(const struct bgp_twamp_nhg *nhg)
+{
+	if (!nhg->backup || !bgp_twamp_nhg_bnc_usable(nhg->backup, nhg->afi))
+		return NULL;
+	return nhg->backup;
+}
+
+static uint32_t bgp_twamp_nhg_content_bnc(const struct bgp_nexthop_cache *bnc,
+					  uint32_t key)
+{
+	const struct nexthop *nh;
+	unsigned int i;
+
+	for (nh = bnc->nexthop; nh; nh = nh->next) {
+		key = jhash_3words(nh->type, nh->ifindex, nh->vrf_id, key);
+		key = jhash(&nh->gate, sizeof(nh->gate), key);
+		if (nh->nh_label)
+			for (i = 0; i < nh->nh_label->num_labels; i++)
+				key = jhash_1word(nh->nh_label->label[i], key);
+	}
+	return key;
+}
+
+/* What the group holds: its winner's resolved nexthops, its backup's */
+static uint32_t bgp_twamp_nhg_content(const struct bgp_twamp_nhg *nhg)
+{
+	const struct bgp_nexthop_cache *backup = bgp_twamp_nhg_backup(nhg);
+	uint32_t key = jhash_1word(nhg_epoch, 0);
+
+	key = bgp_twamp_nhg_content_bnc(nhg->winner, key);
+	if (backup)
+		key = bgp_twamp_nhg_content_bnc(backup, key ^ 0x6261636b);
+
+	/* Never 0, which stands for nothing sent */
+	return key ? key : 1;
+}
+
+/* The resolved nexthops of bnc into api_nh, as zebra has them in groups */
+static uint16_t bgp_twamp_nhg_encode(struct zapi_nexthop *api_nh,
+				     const struct bgp_nexthop_cache *bnc)
+{
+	struct nexthop *nh, copy;
+	uint16_t num = 0;
+
+	for (nh = bnc->nexthop; nh; nh = nh->next) {
+		copy = *nh;
+		copy.next = copy.prev = NULL;
+
+		/* A connected PE is its own gateway */
+		if (copy.type == NEXTHOP_TYPE_IFINDEX) {
+			if (bnc->afi == AFI_IP) {
+				copy.type = NEXTHOP_TYPE_IPV4_IFINDEX;
+				copy.gate.ipv4 = bnc->prefix.u.prefix4;
+			} else {
+				copy.type = NEXTHOP_TYPE_IPV6_IFINDEX;
+				copy.gate.ipv6 = bnc->prefix.u.prefix6;
+			}
+		}
+
+		zapi_nexthop_from_nexthop(&api_nh[num++], &copy);
+	}
+	return num;
+}
+
+/* Send the group to zebra if it does not have its winner as is */
+static bool bgp_twamp_nhg_send(struct bgp_twamp_nhg *nhg)
+{
+	struct zapi_nhg api_nhg = {};
+	const struct bgp_nexthop_cache *backup;
+	struct zapi_nexthop *api_nh;
+	uint32_t content;
+	unsigned int i, j;
+
+	content = bgp_twamp_nhg_content(nhg);
+	if (content == nhg->sent)
+		return true;
+
+	if (!zclient || zclient->sock < 0)
+		return false;
+
+	api_nhg.id = nhg->id;
+	api_nhg.nexthop_num = bgp_twamp_nhg_encode(api_nhg.nexthops,
+						   nhg->winner);
+
+	/* Every primary nexthop falls back on all of the backup's */
+	backup = bgp_twamp_nhg_backup(nhg);
+	if (backup) {
+		api_nhg.backup_nexthop_num =
+			bgp_twamp_nhg_encode(api_nhg.backup_nexthops, backup);
+		for (i = 0; i < api_nhg.nexthop_num; i++) {
+			api_nh = &api_nhg.nexthops[i];
+			SET_FLAG(api_nh->flags, ZAPI_NEXTHOP_FLAG_HAS_BACKUP);
+			api_nh->backup_num = MIN(api_nhg.backup_nexthop_num,
+						 NEXTHOP_MAX_BACKUPS);
+			for (j = 0; j < api_nh->backup_num; j++)
+				api_nh->backup_idx[j] = j;
+		}
+	}
+
+	if (BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: Nexthop group %u via %pFX, backup %pFX, %u routes",
+			   nhg->id, &nhg->winner->prefix,
+			   backup ? &backup->prefix : NULL, nhg->refcnt);
+
+	zclient_nhg_send(zclient, ZEBRA_NHG_ADD, &api_nhg);
+	nhg->sent = content;
+	return true;
+}
+
+static void bgp_twamp_nhg_free(struct bgp_twamp_nhg *nhg)
+{
+	struct zapi_nhg api_nhg = {};
+
+	if (nhg->sent && zclient && zclient->sock >= 0) {
+		api_nhg.id = nhg->id;
+		zclient_nhg_send(zclient, ZEBRA_NHG_DEL, &api_nhg);
+	}
+
+	if (nhg->linked)
+		bgp_twamp_nhg_sets_del(&nhg_sets, nhg);
+	bgp_twamp_nhg_ids_del(&nhg_ids, nhg);
+	bgp_l3nhg_id_free(nhg->id);
+	XFREE(MTYPE_BGP_TWAMP_NHG, nhg);
+}
+
+static struct bgp_twamp_nhg *bgp_twamp_nhg_find_id(uint32_t id)
+{
+	struct bgp_twamp_nhg key = { .id = id };
+
+	if (!id)
+		return NULL;
+	return bgp_twamp_nhg_ids_find(&nhg_ids, &key);
+}
+
+uint32_t bgp_twamp_nhg_lookup(struct bgp *bgp, struct bgp_dest *dest,
+			      struct bgp_path_info *info, afi_t afi,
+			      safi_t safi)
+{
+	struct bgp_twamp_nhg key, *nhg;
+	struct bgp_nexthop_cache *bnc = info->nexthop;
+	const struct prefix *p = bgp_dest_get_prefix(dest);
+
+	if (!bgp->import_latency_cfg.enabled ||
+	    !bgp->import_latency_cfg.nexthop_group || safi != SAFI_UNICAST ||
+	    dest->reason != bgp_path_selection_latency)
+		return 0;
+	if (!bgp_twamp_nhg_path_plain(bgp, info, afi, safi) ||
+	    !bgp_twamp_nhg_bnc_usable(bnc, family2afi(p->family)) ||
+	    !bgp_twamp_nhg_candidates(dest, &key))
+		return 0;
+
+	nhg = bgp_twamp_nhg_sets_find(&nhg_sets, &key);
+	if (!nhg) {
+		uint32_t id = bgp_l3nhg_id_alloc();
+
+		if (!id)
+			return 0;
+
+		nhg = XCALLOC(MTYPE_BGP_TWAMP_NHG, sizeof(*nhg));
+		nhg->bgp = bgp;
+		nhg->id = id;
+		nhg->afi = family2afi(p->family);
+		nhg->count = key.count;
+		memcpy(nhg->candidates, key.candidates,
+		       key.count * sizeof(key.candidates[0]));
+		nhg->winner = bnc;
+		nhg->linked = true;
+		bgp_twamp_nhg_sets_add(&nhg_sets, nhg);
+		bgp_twamp_nhg_ids_add(&nhg_ids, nhg);
+	} else if (nhg->winner != bnc) {
+		/*
+		 * The others stay with the winner they were installed with;
+		 * this one can take the group along only if it is alone.
+		 */
+		if (nhg->refcnt > 1 ||
+		    (nhg->refcnt == 1 && dest->twamp_nhg_id != nhg->id))
+			return 0;
+		nhg->winner = bnc;
+	}
+
+	nhg->backup = bgp_twamp_nhg_backup_pick(nhg);
+	if (!bgp_twamp_nhg_send(nhg))
+		return 0;
+	return nhg->id;
+}
+
+/* Everything but the nexthops the route goes to zebra with */
+static uint32_t bgp_twamp_nhg_route_key(const struct zapi_route *api)
+{
+	uint32_t key;
+
+	key = jhash_3words(api->nhgid, api->metric, api->distance, nhg_epoch);
+	key = jhash_3words(api->message, api->flags, api->tableid, key);
+	key = jhash_1word(api->tag, key);
+	return key ? key : 1;
+}
+
+static void bgp_twamp_nhg_release(uint32_t id)
+{
+	struct bgp_twamp_nhg *nhg = bgp_twamp_nhg_find_id(id);
+
+	if (nhg && !--nhg->refcnt)
+		bgp_twamp_nhg_free(nhg);
+}
+
+bool bgp_twamp_nhg_route_send(struct bgp_dest *dest,
+			      const struct zapi_route *api, bool is_add)
+{
+	struct bgp_twamp_nhg *nhg = NULL;
+	uint32_t key;
+
+	/* EVPN groups come from the same id space, and are not found */
+	if (is_add && CHECK_FLAG(api->message, ZAPI_MESSAGE_NHG))
+		nhg = bgp_twamp_nhg_find_id(api->nhgid);
+
+	if (!nhg) {
+		if (dest->twamp_nhg_id) {
+			bgp_twamp_nhg_release(dest->twamp_nhg_id);
+			dest->twamp_nhg_id = 0;
+			dest->twamp_nhg_key = 0;
+		}
+		return true;
+	}
+
+	key = bgp_twamp_nhg_route_key(api);
+	if (dest->twamp_nhg_id == nhg->id) {
+		if (dest->twamp_nhg_key == key)
+			return false;
+		dest->twamp_nhg_key = key;
+		return true;
+	}
+
+	nhg->refcnt++;
+	bgp_twamp_nhg_release(dest->twamp_nhg_id);
+	dest->twamp_nhg_id = nhg->id;
+	dest->twamp_nhg_key = key;
+	return true;
+}
+
+/* The winner cannot be forwarded to any more, or not without loss */
+static bool bgp_twamp_nhg_winner_down(const struct bgp_twamp_nhg *nhg)
+{
+	return !CHECK_FLAG(nhg->winner->flags, BGP_NEXTHOP_VALID) ||
+	       bgp_twamp_nhg_lossy(nhg, nhg->winner);
+}
+
+/* The backup takes the group over from its failed winner */
+static bool bgp_twamp_nhg_failover(struct bgp_twamp_nhg *nhg)
+{
+	if (!bgp_twamp_nhg_backup(nhg))
+		return false;
+
+	if (BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: Nexthop group %u fails over from %pFX to %pFX",
+			   nhg->id, &nhg->winner->prefix, &nhg->backup->prefix);
+
+	nhg->winner = nhg->backup;
+	nhg->backup = bgp_twamp_nhg_backup_pick(nhg);
+	return bgp_twamp_nhg_send(nhg);
+}
+
+/* Send the group again if what it holds moved, true if it was */
+static bool bgp_twamp_nhg_refresh(struct bgp_twamp_nhg *nhg)
+{
+	uint32_t sent = nhg->sent;
+
+	nhg->backup = bgp_twamp_nhg_backup_pick(nhg);
+	if (!bgp_twamp_nhg_bnc_usable(nhg->winner, nhg->afi))
+		return false;
+	return bgp_twamp_nhg_send(nhg) && nhg->sent != sent;
+}
+
+void bgp_twamp_nhg_reselect(void)
+{
+	struct bgp_twamp_nhg *nhg;
+	struct bgp_nexthop_cache *best, *bnc;
+	uint32_t damping;
+	unsigned int i, moved = 0;
+
+	frr_each (bgp_twamp_nhg_ids, &nhg_ids, nhg) {
+		if (!nhg->refcnt || !nhg->winner)
+			continue;
+
+		/* Probes to the winner get lost: no point waiting for best-path */
+		if (bgp_twamp_nhg_winner_down(nhg)) {
+			if (bgp_twamp_nhg_failover(nhg))
+				moved++;
+			continue;
+		}
+		if (nhg->winner->twamp_latency == UINT32_MAX)
+			continue;
+
+		/*
+		 * A challenger has to beat the winner by the threshold, as
+		 * in best-path, and not be lost to the loss threshold first
+		 */
+		damping = nhg->bgp->import_latency_cfg.damping_threshold_us;
+		best = nhg->winner;
+		for (i = 0; i < nhg->count; i++) {
+			bnc = nhg->candidates[i];
+			if (!bnc || bnc == nhg->winner ||
+			    bnc->twamp_latency == UINT32_MAX ||
+			    bnc->twamp_latency >= best->twamp_latency ||
+			    bgp_twamp_nhg_lossy(nhg, bnc))
+				continue;
+			if (nhg->winner->twamp_latency - bnc->twamp_latency >
+			    damping)
+				best = bnc;
+		}
+		if (best != nhg->winner &&
+		    bgp_twamp_nhg_bnc_usable(best, nhg->afi))
+			nhg->winner = best;
+
+		/* The backup may have moved along, without the winner */
+		if (bgp_twamp_nhg_refresh(nhg))
+			moved++;
+	}
+
+	if (moved && BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: Replaced %u nexthop groups", moved);
+}
+
+static bool bgp_twamp_nhg_member(const struct bgp_twamp_nhg *nhg,
+				 const struct bgp_nexthop_cache *bnc)
+{
+	unsigned int i;
+
+	for (i = 0; i < nhg->count; i++)
+		if (nhg->candidates[i] == bnc)
+			return true;
+	return false;
+}
+
+void bgp_twamp_nhg_bnc_update(struct bgp_nexthop_cache *bnc)
+{
+	struct bgp_twamp_nhg *nhg;
+
+	frr_each (bgp_twamp_nhg_ids, &nhg_ids, nhg) {
+		if (!nhg->refcnt || !nhg->winner ||
+		    !bgp_twamp_nhg_member(nhg, bnc))
+			continue;
+
+		if (nhg->winner == bnc && bgp_twamp_nhg_winner_down(nhg))
+			bgp_twamp_nhg_failover(nhg);
+		else
+			bgp_twamp_nhg_refresh(nhg);
+	}
+}
+
+void bgp_twamp_nhg_backup_update(struct bgp *bgp)
+{
+	struct bgp_twamp_nhg *nhg;
+
+	frr_each (bgp_twamp_nhg_ids, &nhg_ids, nhg)
+		if (nhg->bgp == bgp && nhg->refcnt && nhg->winner)
+			bgp_twamp_nhg_refresh(nhg);
+}
+
+void bgp_twamp_nhg_bnc_free(struct bgp_nexthop_cache *bnc)
+{
+	struct bgp_twamp_nhg *nhg;
+	unsigned int i;
+
+	frr_each (bgp_twamp_nhg_ids, &nhg_ids, nhg) {
+		for (i = 0; i < nhg->count; i++)
+			if (nhg->candidates[i] == bnc)
+				break;
+		if (i == nhg->count)
+			continue;
+
+		nhg->candidates[i] = NULL;
+		if (nhg->winner == bnc)
+			nhg->winner = NULL;
+		if (nhg->backup == bnc)
+			nhg->backup = NULL;
+		if (nhg->linked) {
+			bgp_twamp_nhg_sets_del(&nhg_sets, nhg);
+			nhg->linked = false;
+		}
+	}
+}
+
+void bgp_twamp_nhg_zebra_connected(void)
+{
+	struct bgp_twamp_nhg *nhg;
+
+	if (!++nhg_epoch)
+		nhg_epoch++;
+	frr_each (bgp_twamp_nhg_ids, &nhg_ids, nhg)
+		nhg->sent = 0;
+}
+
+void bgp_twamp_nhg_finish(struct bgp *bgp)
+{
+	struct bgp_twamp_nhg *nhg;
+
+	frr_each_safe (bgp_twamp_nhg_ids, &nhg_ids, nhg)
+		if (nhg->bgp == bgp)
+			bgp_twamp_nhg_free(nhg);
+}
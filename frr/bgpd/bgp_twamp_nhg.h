@@ -0,0 +1,60 @@
+#ifndef _BGP_TWAMP_NHG_H
+#define _BGP_TWAMP_NHG_H
+
+/*
+ * Latency nexthop groups. Destinations whose best path was picked by the
+ * latency step among the same set of egress PEs share one zebra nexthop
+ * group, holding the resolved nexthops of the PE that won. When latency
+ * moves the win to another PE, the group is replaced once and every route
+ * using it follows in the FIB; the routes themselves are not sent again.
+ * With backups on, the next-best PE is in the group too, and takes over
+ * the same way as soon as the winner fails.
+ */
+
+struct bgp;
+struct bgp_dest;
+struct bgp_path_info;
+struct bgp_nexthop_cache;
+struct zapi_route;
+
+/*
+ * The group to install dest's selected path info with, sent to zebra
+ * first if need be; 0 to install its nexthops as usual
+ */
+extern uint32_t bgp_twamp_nhg_lookup(struct bgp *bgp, struct bgp_dest *dest,
+				     struct bgp_path_info *info, afi_t afi,
+				     safi_t safi);
+
+/*
+ * api is about to go to zebra for dest, as a withdrawal unless is_add:
+ * account for the group it uses. False if zebra has the route as is
+ * already and the send can be skipped.
+ */
+extern bool bgp_twamp_nhg_route_send(struct bgp_dest *dest,
+				     const struct zapi_route *api, bool is_add);
+
+/*
+ * Latency snapshots moved: replace the groups whose PE lost the latency
+ * win, ahead of best-path running again for their destinations
+ */
+extern void bgp_twamp_nhg_reselect(void);
+
+/*
+ * The reachability or resolved nexthops of bnc moved, ahead of its paths
+ * being evaluated: a group it won fails over to its backup
+ */
+extern void bgp_twamp_nhg_bnc_update(struct bgp_nexthop_cache *bnc);
+
+/* Backups were turned on or off for the groups of bgp */
+extern void bgp_twamp_nhg_backup_update(struct bgp *bgp);
+
+/* bnc is being freed: groups stop taking new routes if it was a member */
+extern void bgp_twamp_nhg_bnc_free(struct bgp_nexthop_cache *bnc);
+
+/* (Re)connected to zebra, which knows none of the groups */
+extern void bgp_twamp_nhg_zebra_connected(void);
+
+/* The instance is going away: drop its groups */
+extern void bgp_twamp_nhg_finish(struct bgp *bgp);
+
+#endif
@@ -0,0 +1,450 @@
+/*
+ * IGP TE delay as a latency source (RFC 7471, RFC 8570).
+ *
+ * ospfd and isisd export their link-state database through zebra with
+ * the unidirectional delay of every link. The latency to a nexthop is
+ * then the delay summed along the IGP shortest path to it, so instances
+ * using this source need no probe traffic at all. The figures land in
+ * bnc->twamp_igp_latency and bgp_twamp picks them up when it has no
+ * measurement of its own for the nexthop.
+ *
+ * The same database places the roots of optimal route reflection (RFC
+ * 9107) clients. The delay from a root to each egress PE is worked out
+ * the first time one of its update groups asks, and kept per root next to
+ * the database; all the groups and clients of a root share it.
+ */
+#include "zebra.h"
+
+#include "lib/if.h"
+#include "lib/prefix.h"
+#include "lib/stream.h"
+#include "lib/link_state.h"
+#include "lib/cspf.h"
+#include "lib/zclient.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_nexthop.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_twamp.h"
+#include "bgpd/bgp_twamp_ted.h"
+
+DEFINE_MTYPE_STATIC(BGP_TWAMP, BGP_ORR_ROOT, "BGP ORR root");
+DEFINE_MTYPE_STATIC(BGP_TWAMP, BGP_ORR_PE, "BGP ORR root latency");
+
+extern struct zclient *zclient;
+
+PREDECL_HASH(bgp_orr_pes);
+
+/* Round trip estimate from a root to an egress PE */
+struct bgp_orr_pe {
+	struct bgp_orr_pes_item item;
+	struct prefix pe;
+	uint32_t latency;
+};
+
+static int bgp_orr_pe_cmp(const struct bgp_orr_pe *a,
+			  const struct bgp_orr_pe *b)
+{
+	return prefix_cmp(&a->pe, &b->pe);
+}
+
+static uint32_t bgp_orr_pe_hash(const struct bgp_orr_pe *pe)
+{
+	return prefix_hash_key(&pe->pe);
+}
+
+DECLARE_HASH(bgp_orr_pes, struct bgp_orr_pe, item, bgp_orr_pe_cmp,
+	     bgp_orr_pe_hash);
+
+PREDECL_DLIST(bgp_orr_roots);
+
+struct bgp_orr_root {
+	struct bgp_orr_roots_item item;
+	struct in_addr addr;
+	struct bgp_orr_pes_head pes;
+};
+
+DECLARE_DLIST(bgp_orr_roots, struct bgp_orr_root, item);
+
+static struct bgp_orr_roots_head orr_roots = INIT_DLIST(orr_roots);
+
+/* Link-state database, only kept while some instance uses it */
+static struct ls_ted *ted;
+static struct event *ted_ev;
+/* The database changed since the last pass, so every nexthop is redone */
+static bool ted_changed;
+
+/* Let a burst of flooding settle before running the shortest paths */
+#define BGP_TWAMP_TED_DELAY_MSEC 1000
+
+/* Is root the optimal route reflection root of some client? */
+static bool bgp_twamp_ted_orr_used(const struct in_addr *root)
+{
+	struct listnode *node, *pnode;
+	struct bgp *bgp;
+	struct peer *peer;
+	afi_t afi;
+	safi_t safi;
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp)) {
+		if (CHECK_FLAG(bgp->flags, BGP_FLAG_DELETE_IN_PROGRESS))
+			continue;
+		for (ALL_LIST_ELEMENTS_RO(bgp->peer, pnode, peer))
+			FOREACH_AFI_SAFI (afi, safi)
+				if (peer->orr_root[afi][safi].s_addr !=
+					    INADDR_ANY &&
+				    (!root ||
+				     IPV4_ADDR_SAME(&peer->orr_root[afi][safi],
+						    root)))
+					return true;
+	}
+	return false;
+}
+
+static bool bgp_twamp_ted_wanted(void)
+{
+	struct listnode *node;
+	struct bgp *bgp;
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		if (bgp->import_latency_cfg.enabled &&
+		    bgp->import_latency_cfg.source !=
+			    BGP_LATENCY_SOURCE_TWAMP &&
+		    !CHECK_FLAG(bgp->flags, BGP_FLAG_DELETE_IN_PROGRESS))
+			return true;
+	return bgp_twamp_ted_orr_used(NULL);
+}
+
+/* Only nexthops of iBGP paths are egress PEs worth a shortest path */
+static bool bgp_twamp_ted_bnc_wanted(const struct bgp_nexthop_cache *bnc)
+{
+	struct bgp_path_info *path;
+
+	if (bnc->bgp->vrf_id != VRF_DEFAULT)
+		return false;
+
+	LIST_FOREACH (path, &bnc->paths, nh_thread)
+		if (path->peer && path->peer->sort == BGP_PEER_IBGP)
+			return true;
+	return false;
+}
+
+/* The vertex advertising a host address, e.g. a PE loopback */
+static struct ls_vertex *bgp_twamp_ted_vertex(const struct prefix *host)
+{
+	struct ls_subnet *subnet = ls_find_subnet(ted, host);
+
+	return subnet ? subnet->vertex : NULL;
+}
+
+/* One-way delay of a path, UINT32_MAX if a link has none or an anomalous one */
+static uint32_t bgp_twamp_ted_path_delay(const struct c_path *path)
+{
+	struct listnode *node;
+	struct ls_edge *edge;
+	uint64_t total = 0;
+
+	for (ALL_LIST_ELEMENTS_RO(path->edges, node, edge)) {
+		if (!CHECK_FLAG(edge->attributes->flags, LS_ATTR_DELAY) ||
+		    CHECK_FLAG(edge->attributes->extended.delay,
+			       TE_EXT_ANORMAL))
+			return UINT32_MAX;
+		total += edge->attributes->extended.delay & TE_EXT_MASK;
+	}
+
+	return MIN(total, (uint64_t)UINT32_MAX - 1);
+}
+
+/*
+ * Round trip estimate from the router with address from to a nexthop,
+ * along the IGP shortest path. The reverse path is taken to be
+ * symmetric, so the one-way delay counts twice, which puts it on the same
+ * scale as a TWAMP round trip.
+ */
+static uint32_t bgp_twamp_ted_latency(struct cspf *algo, struct in_addr from,
+				      const struct prefix *nexthop)
+{
+	struct constraints csts = {};
+	struct ls_vertex *src, *dst;
+	struct c_path *path;
+	struct prefix rid;
+	uint32_t delay = UINT32_MAX;
+
+	if (nexthop->family != AF_INET && nexthop->family != AF_INET6)
+		return UINT32_MAX;
+
+	rid.family = AF_INET;
+	rid.prefixlen = IPV4_MAX_BITLEN;
+	rid.u.prefix4 = from;
+	src = bgp_twamp_ted_vertex(&rid);
+	dst = bgp_twamp_ted_vertex(nexthop);
+	if (!src || !dst)
+		return UINT32_MAX;
+	/* A root sitting on the PE, as opposed to this router, is 0 away */
+	if (src == dst)
+		return 0;
+
+	csts.ctype = CSPF_METRIC;
+	csts.cost = MAX_COST;
+	csts.type = RSVP_TE;
+	csts.family = nexthop->family;
+	cspf_init(algo, src, dst, &csts);
+
+	path = compute_p2p_path(algo, ted);
+	if (path->status == SUCCESS) {
+		delay = bgp_twamp_ted_path_delay(path);
+		if (delay != UINT32_MAX)
+			delay = MIN(2ULL * delay, (uint64_t)UINT32_MAX - 1);
+	}
+	cpath_del(path);
+
+	return delay;
+}
+
+/* From the local router, the instance's router-id */
+static uint32_t bgp_twamp_ted_bnc_latency(struct cspf *algo,
+					  const struct bgp_nexthop_cache *bnc)
+{
+	struct ls_vertex *local;
+	struct prefix rid;
+
+	rid.family = AF_INET;
+	rid.prefixlen = IPV4_MAX_BITLEN;
+	rid.u.prefix4 = bnc->bgp->router_id;
+	local = bgp_twamp_ted_vertex(&rid);
+	if (local && local == bgp_twamp_ted_vertex(&bnc->prefix))
+		return UINT32_MAX;
+
+	return bgp_twamp_ted_latency(algo, bnc->bgp->router_id, &bnc->prefix);
+}
+
+static void bgp_twamp_ted_orr_free(struct bgp_orr_root *root)
+{
+	struct bgp_orr_pe *pe;
+
+	while ((pe = bgp_orr_pes_pop(&root->pes)))
+		XFREE(MTYPE_BGP_ORR_PE, pe);
+	bgp_orr_pes_fini(&root->pes);
+	bgp_orr_roots_del(&orr_roots, root);
+	XFREE(MTYPE_BGP_ORR_ROOT, root);
+}
+
+/* The clients of root have their routes picked again */
+static void bgp_twamp_ted_orr_announce(const struct in_addr *root)
+{
+	struct listnode *node, *pnode;
+	struct bgp *bgp;
+	struct peer *peer;
+	afi_t afi;
+	safi_t safi;
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		for (ALL_LIST_ELEMENTS_RO(bgp->peer, pnode, peer))
+			FOREACH_AFI_SAFI (afi, safi)
+				if (IPV4_ADDR_SAME(&peer->orr_root[afi][safi],
+						   root) &&
+				    peer_established(peer->connection))
+					bgp_announce_route(peer, afi, safi,
+							   false);
+}
+
+/*
+ * After a change to the database, redo what the roots still in use have
+ * cached; the clients of those whose PEs moved get their routes again.
+ */
+static void bgp_twamp_ted_orr_compute(struct cspf *algo)
+{
+	struct bgp_orr_root *root;
+	struct bgp_orr_pe *pe;
+	uint32_t latency;
+	bool changed;
+
+	frr_each_safe (bgp_orr_roots, &orr_roots, root) {
+		if (!bgp_twamp_ted_orr_used(&root->addr)) {
+			bgp_twamp_ted_orr_free(root);
+			continue;
+		}
+
+		changed = false;
+		frr_each (bgp_orr_pes, &root->pes, pe) {
+			latency = bgp_twamp_ted_latency(algo, root->addr,
+							&pe->pe);
+			if (latency == pe->latency)
+				continue;
+			pe->latency = latency;
+			changed = true;
+		}
+		if (changed)
+			bgp_twamp_ted_orr_announce(&root->addr);
+	}
+}
+
+uint32_t bgp_twamp_ted_orr_latency(const struct in_addr *addr,
+				   const struct bgp_nexthop_cache *bnc)
+{
+	struct bgp_orr_root *root;
+	struct bgp_orr_pe *pe, ref;
+	struct cspf *algo;
+
+	if (!ted)
+		return UINT32_MAX;
+
+	frr_each (bgp_orr_roots, &orr_roots, root)
+		if (IPV4_ADDR_SAME(&root->addr, addr))
+			break;
+	if (!root) {
+		root = XCALLOC(MTYPE_BGP_ORR_ROOT, sizeof(*root));
+		root->addr = *addr;
+		bgp_orr_pes_init(&root->pes);
+		bgp_orr_roots_add_tail(&orr_roots, root);
+	}
+
+	prefix_copy(&ref.pe, &bnc->prefix);
+	pe = bgp_orr_pes_find(&root->pes, &ref);
+	if (pe)
+		return pe->latency;
+
+	pe = XCALLOC(MTYPE_BGP_ORR_PE, sizeof(*pe));
+	prefix_copy(&pe->pe, &bnc->prefix);
+	algo = cspf_new();
+	pe->latency = bgp_twamp_ted_latency(algo, root->addr, &pe->pe);
+	cspf_del(algo);
+	bgp_orr_pes_add(&root->pes, pe);
+
+	return pe->latency;
+}
+
+/*
+ * Bring the nexthops up to date with the database: all of them after a
+ * change to it, otherwise only the ones added since the last pass.
+ */
+static void bgp_twamp_ted_compute(struct event *thread)
+{
+	struct listnode *node;
+	struct bgp *bgp;
+	struct bgp_nexthop_cache *bnc;
+	struct cspf *algo;
+	unsigned int computed = 0, changed = 0;
+	uint32_t latency;
+	afi_t afi;
+
+	if (!ted)
+		return;
+
+	algo = cspf_new();
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		for (afi = AFI_IP; afi < AFI_MAX; afi++)
+			frr_each (bgp_nexthop_cache,
+				  &bgp->nexthop_cache_table[afi], bnc) {
+				if (bnc->twamp_igp_current && !ted_changed)
+					continue;
+				bnc->twamp_igp_current = true;
+
+				latency = UINT32_MAX;
+				if (bgp_twamp_ted_bnc_wanted(bnc)) {
+					latency = bgp_twamp_ted_bnc_latency(algo,
+									    bnc);
+					computed++;
+				}
+				if (latency == bnc->twamp_igp_latency)
+					continue;
+				bnc->twamp_igp_latency = latency;
+				changed++;
+			}
+	if (ted_changed)
+		bgp_twamp_ted_orr_compute(algo);
+	cspf_del(algo);
+	ted_changed = false;
+
+	if (BGP_DEBUG(twamp, TWAMP))
+		zlog_debug("BGP TWAMP: IGP delay computed for %u nexthops, %u changed",
+			   computed, changed);
+
+	if (changed)
+		bgp_twamp_source_changed();
+}
+
+static void bgp_twamp_ted_schedule(void)
+{
+	if (ted)
+		event_add_timer_msec(bm->master, bgp_twamp_ted_compute, NULL,
+				     BGP_TWAMP_TED_DELAY_MSEC, &ted_ev);
+}
+
+static void bgp_twamp_ted_register(void)
+{
+	if (!zclient || zclient->sock < 0)
+		return;
+
+	if (ls_register(zclient, false) != 0 || ls_request_sync(zclient) < 0)
+		zlog_warn("BGP TWAMP: Unable to import the IGP link-state database");
+}
+
+void bgp_twamp_ted_update(void)
+{
+	struct listnode *node;
+	struct bgp *bgp;
+	struct bgp_nexthop_cache *bnc;
+	afi_t afi;
+	bool wanted = bgp_twamp_ted_wanted();
+
+	if (wanted && !ted) {
+		ted = ls_ted_new(1, "BGP latency", 0);
+		ted_changed = true;
+		bgp_twamp_ted_register();
+		zlog_info("BGP TWAMP: Importing IGP TE delay");
+		return;
+	}
+
+	if (wanted || !ted)
+		return;
+
+	if (zclient && zclient->sock >= 0)
+		ls_unregister(zclient, false);
+	EVENT_OFF(ted_ev);
+	ls_ted_del_all(&ted);
+	while (bgp_orr_roots_count(&orr_roots))
+		bgp_twamp_ted_orr_free(bgp_orr_roots_first(&orr_roots));
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		for (afi = AFI_IP; afi < AFI_MAX; afi++)
+			frr_each (bgp_nexthop_cache,
+				  &bgp->nexthop_cache_table[afi], bnc) {
+				bnc->twamp_igp_latency = UINT32_MAX;
+				bnc->twamp_igp_current = false;
+			}
+	bgp_twamp_source_changed();
+	zlog_info("BGP TWAMP: Stopped importing IGP TE delay");
+}
+
+void bgp_twamp_ted_zebra_connected(void)
+{
+	if (!ted)
+		return;
+
+	/* Whatever zebra sends from now on is a fresh copy */
+	ls_ted_del_all(&ted);
+	ted = ls_ted_new(1, "BGP latency", 0);
+	ted_changed = true;
+	bgp_twamp_ted_register();
+}
+
+void bgp_twamp_ted_message(struct stream *s)
+{
+	if (!ted)
+		return;
+
+	ls_stream2ted(ted, s, true);
+	ted_changed = true;
+	bgp_twamp_ted_schedule();
+}
+
+void bgp_twamp_ted_bnc_add(struct bgp_nexthop_cache *bnc)
+{
+	if (!ted || (bnc->twamp_igp_current &&
+		     bnc->twamp_igp_latency != UINT32_MAX))
+		return;
+	bnc->twamp_igp_current = false;
+	bgp_twamp_ted_schedule();
+}
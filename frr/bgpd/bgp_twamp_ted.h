@@ -0,0 +1,29 @@
+#ifndef _BGP_TWAMP_TED_H
+#define _BGP_TWAMP_TED_H
+
+struct stream;
+struct bgp_nexthop_cache;
+
+/*
+ * An instance's latency source changed: start or stop importing the IGP
+ * link-state database depending on whether any instance still uses it
+ */
+extern void bgp_twamp_ted_update(void);
+
+/* (Re)connected to zebra: register for link-state again and resync */
+extern void bgp_twamp_ted_zebra_connected(void);
+
+/* A link-state message from ospfd or isisd, as relayed by zebra */
+extern void bgp_twamp_ted_message(struct stream *s);
+
+/*
+ * Round trip estimate from an optimal route reflection root to the
+ * nexthop of bnc, UINT32_MAX if either is not in the database
+ */
+extern uint32_t bgp_twamp_ted_orr_latency(const struct in_addr *root,
+					  const struct bgp_nexthop_cache *bnc);
+
+/* bnc got an iBGP path: work out its IGP delay if not known yet */
+extern void bgp_twamp_ted_bnc_add(struct bgp_nexthop_cache *bnc);
+
+#endif
@@ -144,6 +144,7 @@ static void conf_copy(struct peer *dst, struct peer *src, afi_t afi,
 	dst->addpath_type[afi][safi] = src->addpath_type[afi][safi];
 	dst->addpath_best_selected[afi][safi] =
 		src->addpath_best_selected[afi][safi];
+	dst->orr_root[afi][safi] = src->orr_root[afi][safi];
 	dst->local_as = src->local_as;
 	dst->change_local_as = src->change_local_as;
 	dst->shared_network = src->shared_network;
@@ -353,6 +354,7 @@ static unsigned int updgrp_hash_key_make(const void *p)
 	key = jhash_1word(peer->change_local_as, key);
 	key = jhash_1word(peer->max_packet_size, key);
 	key = jhash_1word(peer->pmax_out[afi][safi], key);
+	key = jhash_1word(peer->orr_root[afi][safi].s_addr, key);
 
 	if (peer->as_path_loop_detection)
 		key = jhash_2words(peer->as, peer->as_path_loop_detection, key);
@@ -461,8 +463,9 @@ static unsigned int updgrp_hash_key_make(const void *p)
 			peer->v_routeadv, peer->change_local_as,
 			peer->as_path_loop_detection);
 		zlog_debug(
-			"%pBP Update Group Hash: max packet size: %u pmax_out: %u Peer Group: %s rmap out: %s",
+			"%pBP Update Group Hash: max packet size: %u pmax_out: %u orr root: %pI4 Peer Group: %s rmap out: %s",
 			peer, peer->max_packet_size, peer->pmax_out[afi][safi],
+			&peer->orr_root[afi][safi],
 			peer->group ? peer->group->name : "(NONE)",
 			ROUTE_MAP_OUT_NAME(filter) ? ROUTE_MAP_OUT_NAME(filter)
 						   : "(NONE)");
@@ -553,6 +556,11 @@ static bool updgrp_hash_cmp(const void *p1, const void *p2)
 	if (pe1->pmax_out[afi][safi] != pe2->pmax_out[afi][safi])
 		return false;
 
+	/* ORR clients share a group only with those of the same root */
+	if (!IPV4_ADDR_SAME(&pe1->orr_root[afi][safi],
+			    &pe2->orr_root[afi][safi]))
+		return false;
+
 	/* flags like route reflector client */
 	if ((flags1 & PEER_UPDGRP_AF_FLAGS) != (flags2 & PEER_UPDGRP_AF_FLAGS))
 		return false;
@@ -846,6 +854,9 @@ static int update_group_show_walkcb(struct update_group *updgrp, void *arg)
 			json_object_int_add(json_subgrp_event,
 					    "mergeCheckEvents",
 					    subgrp->merge_checks_triggered);
+			json_object_int_add(json_subgrp_event,
+					    "updatesCoalesced",
+					    subgrp->updates_coalesced);
 			json_object_object_add(json_subgrp, "statistics",
 					       json_subgrp_event);
 			json_object_int_add(json_subgrp, "coalesceTime",
@@ -889,6 +900,8 @@ static int update_group_show_walkcb(struct update_group *updgrp, void *arg)
 				subgrp->peer_refreshes_combined);
 			vty_out(vty, "    Merge checks triggered: %u\n",
 				subgrp->merge_checks_triggered);
+			vty_out(vty, "    Updates coalesced: %u\n",
+				subgrp->updates_coalesced);
 			vty_out(vty, "    Coalesce Time: %u%s\n",
 				(UPDGRP_INST(subgrp->update_group))
 					->coalesce_time,
@@ -1079,6 +1092,32 @@ static void update_group_remove_subgroup(struct update_group *updgrp,
 		update_group_delete(updgrp);
 }
 
+/*
+ * Give subgrp the lowest free adj-out slot of its instance, keeping the
+ * adj-out set bitmaps as short as the number of subgroups allows.
+ */
+static void update_subgroup_slot_get(struct bgp *bgp,
+				     struct update_subgroup *subgrp)
+{
+	uint32_t slot, max;
+
+	for (slot = 0; slot < bgp->adj_slots_max; slot++)
+		if (!bgp->adj_slots[slot])
+			break;
+
+	if (slot == bgp->adj_slots_max) {
+		max = MAX(bgp->adj_slots_max * 2, 64);
+		bgp->adj_slots = XREALLOC(MTYPE_BGP_ADJ_SLOTS, bgp->adj_slots,
+					  max * sizeof(*bgp->adj_slots));
+		memset(&bgp->adj_slots[bgp->adj_slots_max], 0,
+		       (max - bgp->adj_slots_max) * sizeof(*bgp->adj_slots));
+		bgp->adj_slots_max = max;
+	}
+
+	bgp->adj_slots[slot] = subgrp;
+	subgrp->adj_slot = slot;
+}
+
 static struct update_subgroup *
 update_subgroup_create(struct update_group *updgrp)
 {
@@ -1086,6 +1125,7 @@ update_subgroup_create(struct update_group *updgrp)
 
 	subgrp = XCALLOC(MTYPE_BGP_UPD_SUBGRP, sizeof(struct update_subgroup));
 	update_subgroup_checkin(subgrp, updgrp);
+	update_subgroup_slot_get(UPDGRP_INST(updgrp), subgrp);
 	subgrp->v_coalesce = (UPDGRP_INST(updgrp))->coalesce_time;
 	sync_init(subgrp, updgrp);
 	bpacket_queue_init(SUBGRP_PKTQ(subgrp));
@@ -1122,6 +1162,10 @@ static void update_subgroup_delete(struct update_subgroup *subgrp)
 		zlog_debug("delete subgroup u%" PRIu64 ":s%" PRIu64,
 			   subgrp->update_group->id, subgrp->id);
 
+	/* The slot is in no set any more, subgroup_clear_table saw to that */
+	if (subgrp->update_group)
+		SUBGRP_INST(subgrp)->adj_slots[subgrp->adj_slot] = NULL;
+
 	update_group_remove_subgroup(subgrp->update_group, subgrp);
 
 	XFREE(MTYPE_BGP_UPD_SUBGRP, subgrp);
@@ -1489,6 +1533,7 @@ static void update_subgroup_copy_adj_out(struct update_subgroup *source,
 		aout_copy->attr =
 			aout->attr ? bgp_attr_intern(aout->attr) : NULL;
 	}
+	subgroup_copy_adj_out_sets(source, dest);
 
 	dest->scount = source->scount;
 }
@@ -1883,6 +1928,9 @@ void update_bgp_group_free(struct bgp *bgp)
 			bgp->update_groups[afid] = NULL;
 		}
 	}
+
+	XFREE(MTYPE_BGP_ADJ_SLOTS, bgp->adj_slots);
+	bgp->adj_slots_max = 0;
 }
 
 void update_group_show(struct bgp *bgp, afi_t afi, safi_t safi, struct vty *vty,
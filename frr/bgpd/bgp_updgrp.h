@@ -89,6 +89,9 @@ struct bpacket {
 	struct stream *buffer;
 	bpacket_attr_vec_arr arr;
 
+	/* buffer was handed to the last peer to send it; not ours to free */
+	bool buffer_given;
+
 	unsigned int ver;
 };
 
@@ -231,9 +234,15 @@ struct update_subgroup {
 	uint32_t adj_count;
 	uint32_t split_events;
 	uint32_t merge_checks_triggered;
+	/* Queued changes undone before they were sent */
+	uint32_t updates_coalesced;
 
 	uint64_t id;
 
+	/* Bit in the adj-out sets, and in how many sets it is set */
+	uint32_t adj_slot;
+	uint32_t adj_compact;
+
 	uint16_t sflags;
 #define SUBGRP_STATUS_DEFAULT_ORIGINATE (1 << 0)
 #define SUBGRP_STATUS_FORCE_UPDATES (1 << 1)
@@ -345,6 +354,20 @@ struct updwalk_context {
 #define SUBGRP_FOREACH_ADJ_SAFE(subgrp, adj, adj_temp)                         \
 	TAILQ_FOREACH_SAFE (adj, &(subgrp->adjq), subgrp_adj_train, adj_temp)
 
+/*
+ * The attributes a subgroup has advertised for a destination, from its
+ * bgp_adj_outs there and then from the sets it was compacted into.
+ */
+struct bgp_adj_out_walk {
+	struct bgp_adj_out *adj;
+	struct bgp_adj_out_set *set;
+	bool sets;
+};
+
+#define SUBGRP_FOREACH_ADVERTISED(subgrp, dest, walk, attr)                    \
+	for (memset(&(walk), 0, sizeof(walk));                                 \
+	     ((attr) = bgp_adj_out_walk_next((subgrp), (dest), &(walk)));)
+
 /* Prototypes.  */
 /* bgp_updgrp.c */
 extern void update_bgp_group_init(struct bgp *);
@@ -449,6 +472,14 @@ extern bool bgp_adj_out_set_subgroup(struct bgp_dest *dest,
 extern void bgp_adj_out_unset_subgroup(struct bgp_dest *dest,
 				       struct update_subgroup *subgrp,
 				       char withdraw, uint32_t addpath_tx_id);
+extern void bgp_adj_out_compact(struct bgp_adj_out *adj);
+extern void bgp_adj_out_compact_table(struct bgp *bgp, afi_t afi, safi_t safi,
+				      bool compact);
+extern void subgroup_copy_adj_out_sets(struct update_subgroup *source,
+				       struct update_subgroup *target);
+extern struct attr *bgp_adj_out_walk_next(struct update_subgroup *subgrp,
+					  struct bgp_dest *dest,
+					  struct bgp_adj_out_walk *walk);
 void subgroup_announce_table(struct update_subgroup *subgrp,
 			     struct bgp_table *table);
 extern void subgroup_trigger_write(struct update_subgroup *subgrp);
@@ -35,6 +35,7 @@
 #include "bgpd/bgp_updgrp.h"
 #include "bgpd/bgp_advertise.h"
 #include "bgpd/bgp_addpath.h"
+#include "bgpd/bgp_twamp.h"
 
 
 /********************
@@ -76,10 +77,31 @@ static inline struct bgp_adj_out *adj_lookup(struct bgp_dest *dest,
 	return RB_FIND(bgp_adj_out_rb, &dest->adj_out, &lookup);
 }
 
-static void adj_free(struct bgp_adj_out *adj)
+/*
+ * Link and unlink an adj-out without counting it in or out of adj_count,
+ * which also covers the compacted ones.
+ */
+static struct bgp_adj_out *adj_insert(struct update_subgroup *subgrp,
+				      struct bgp_dest *dest,
+				      uint32_t addpath_tx_id)
+{
+	struct bgp_adj_out *adj;
+
+	adj = XCALLOC(MTYPE_BGP_ADJ_OUT, sizeof(struct bgp_adj_out));
+	adj->subgroup = subgrp;
+	adj->addpath_tx_id = addpath_tx_id;
+
+	RB_INSERT(bgp_adj_out_rb, &dest->adj_out, adj);
+	bgp_dest_lock_node(dest);
+	adj->dest = dest;
+
+	TAILQ_INSERT_TAIL(&(subgrp->adjq), adj, subgrp_adj_train);
+	return adj;
+}
+
+static void adj_remove(struct bgp_adj_out *adj)
 {
 	TAILQ_REMOVE(&(adj->subgroup->adjq), adj, subgrp_adj_train);
-	SUBGRP_DECR_STAT(adj->subgroup, adj_count);
 
 	RB_REMOVE(bgp_adj_out_rb, &adj->dest->adj_out, adj);
 	bgp_dest_unlock_node(adj->dest);
@@ -87,6 +109,218 @@ static void adj_free(struct bgp_adj_out *adj)
 	XFREE(MTYPE_BGP_ADJ_OUT, adj);
 }
 
+static void adj_free(struct bgp_adj_out *adj)
+{
+	SUBGRP_DECR_STAT(adj->subgroup, adj_count);
+	adj_remove(adj);
+}
+
+static bool adj_compact_enabled(struct update_subgroup *subgrp)
+{
+	return CHECK_FLAG(SUBGRP_INST(subgrp)->af_flags[SUBGRP_AFI(subgrp)]
+						       [SUBGRP_SAFI(subgrp)],
+			  BGP_CONFIG_ADJ_OUT_COMPACT);
+}
+
+static struct bgp_adj_out_set *adj_set_lookup(struct bgp_dest *dest,
+					      struct update_subgroup *subgrp,
+					      uint32_t addpath_tx_id)
+{
+	struct bgp_adj_out_set *set;
+
+	if (!dest || !subgrp || !subgrp->adj_compact)
+		return NULL;
+
+	for (set = dest->adj_out_sets; set; set = set->next)
+		if (set->addpath_tx_id == addpath_tx_id &&
+		    bgp_adj_out_set_test(set, subgrp->adj_slot))
+			return set;
+
+	return NULL;
+}
+
+/* Add subgrp to the set at *setp, moving the set if it has to grow */
+static void adj_set_add(struct bgp_adj_out_set **setp,
+			struct update_subgroup *subgrp)
+{
+	struct bgp_adj_out_set *set = *setp;
+	uint32_t words = subgrp->adj_slot / 64 + 1;
+
+	if (words > set->words) {
+		set = XREALLOC(MTYPE_BGP_ADJ_OUT_SET, set,
+			       sizeof(*set) + words * sizeof(set->slots[0]));
+		memset(&set->slots[set->words], 0,
+		       (words - set->words) * sizeof(set->slots[0]));
+		set->words = words;
+		*setp = set;
+	}
+
+	SET_FLAG(set->slots[subgrp->adj_slot / 64],
+		 (uint64_t)1 << (subgrp->adj_slot % 64));
+	subgrp->adj_compact++;
+}
+
+/* Take subgrp out of the set, freeing the set if it was the last one */
+static void adj_set_clear(struct bgp_dest *dest, struct bgp_adj_out_set *set,
+			  struct update_subgroup *subgrp)
+{
+	struct bgp_adj_out_set **setp;
+	uint32_t w;
+
+	UNSET_FLAG(set->slots[subgrp->adj_slot / 64],
+		   (uint64_t)1 << (subgrp->adj_slot % 64));
+	subgrp->adj_compact--;
+
+	for (w = 0; w < set->words; w++)
+		if (set->slots[w])
+			return;
+
+	for (setp = &dest->adj_out_sets; *setp != set; setp = &(*setp)->next)
+		;
+	*setp = set->next;
+
+	bgp_attr_unintern(&set->attr);
+	XFREE(MTYPE_BGP_ADJ_OUT_SET, set);
+	bgp_dest_unlock_node(dest);
+}
+
+/* Turn subgrp's bit in the set back into a bgp_adj_out */
+static struct bgp_adj_out *adj_set_inflate(struct bgp_dest *dest,
+					   struct bgp_adj_out_set *set,
+					   struct update_subgroup *subgrp)
+{
+	struct bgp_adj_out *adj;
+
+	adj = adj_insert(subgrp, dest, set->addpath_tx_id);
+	adj->attr = bgp_attr_intern(set->attr);
+	adj->attr_hash = set->attr_hash;
+
+	adj_set_clear(dest, set, subgrp);
+	return adj;
+}
+
+static struct bgp_adj_out *adj_lookup_inflate(struct bgp_dest *dest,
+					      struct update_subgroup *subgrp,
+					      uint32_t addpath_tx_id)
+{
+	struct bgp_adj_out *adj;
+	struct bgp_adj_out_set *set;
+
+	adj = adj_lookup(dest, subgrp, addpath_tx_id);
+	if (adj)
+		return adj;
+
+	set = adj_set_lookup(dest, subgrp, addpath_tx_id);
+	return set ? adj_set_inflate(dest, set, subgrp) : NULL;
+}
+
+/* Fold an adj-out with nothing left to send into the matching set */
+static void adj_compact(struct bgp_adj_out *adj)
+{
+	struct bgp_dest *dest = adj->dest;
+	struct update_subgroup *subgrp = adj->subgroup;
+	struct bgp_adj_out_set **setp, *set;
+	uint32_t words;
+
+	for (setp = &dest->adj_out_sets; *setp; setp = &(*setp)->next)
+		if ((*setp)->attr == adj->attr &&
+		    (*setp)->addpath_tx_id == adj->addpath_tx_id)
+			break;
+
+	if (*setp) {
+		bgp_attr_unintern(&adj->attr);
+	} else {
+		words = subgrp->adj_slot / 64 + 1;
+		set = XCALLOC(MTYPE_BGP_ADJ_OUT_SET,
+			      sizeof(*set) + words * sizeof(set->slots[0]));
+		set->words = words;
+		set->attr = adj->attr;
+		adj->attr = NULL;
+		set->attr_hash = adj->attr_hash;
+		set->addpath_tx_id = adj->addpath_tx_id;
+		bgp_dest_lock_node(dest);
+		*setp = set;
+	}
+
+	adj_set_add(setp, subgrp);
+	adj_remove(adj);
+}
+
+/*
+ * Optimal route reflection (RFC 9107): the path a client group gets is
+ * best-path run over from its root, whose IGP delay to the egress PEs
+ * stands in for ours at the latency step. Where the latency step is off
+ * or the root is not in the IGP, that is the path selected here.
+ */
+static struct bgp_path_info *subgrp_orr_select(struct update_subgroup *subgrp,
+					       struct bgp_dest *dest,
+					       struct bgp_path_info *selected)
+{
+	afi_t afi = SUBGRP_AFI(subgrp);
+	safi_t safi = SUBGRP_SAFI(subgrp);
+	struct peer *peer = SUBGRP_PEER(subgrp);
+	enum bgp_path_selection_reason reason;
+	char pfx_buf[PREFIX2STR_BUFFER] = {};
+	struct bgp_path_info *pi, *best = selected;
+	int paths_eq = 0;
+
+	if (!selected || peer->orr_root[afi][safi].s_addr == INADDR_ANY ||
+	    !peer->bgp->import_latency_cfg.enabled)
+		return selected;
+
+	bgp_twamp_viewpoint(&peer->orr_root[afi][safi]);
+	for (pi = bgp_dest_get_bgp_path_info(dest); pi; pi = pi->next) {
+		if (pi == selected || !CHECK_FLAG(pi->flags, BGP_PATH_VALID) ||
+		    CHECK_FLAG(pi->flags, BGP_PATH_REMOVED))
+			continue;
+
+		if (bgp_path_info_cmp(peer->bgp, pi, best, &paths_eq, NULL, 0,
+				      pfx_buf, afi, safi, &reason))
+			best = pi;
+	}
+	bgp_twamp_viewpoint(NULL);
+
+	return best;
+}
+
+/*
+ * Does pi take a lowest-latency slot ahead of exist? The measured latency
+ * and loss of their nexthops come first, best-path settles the rest, so
+ * unmeasured paths are ranked as with addpath-tx-best-selected.
+ */
+static bool subgrp_addpath_lower_latency(struct bgp *bgp,
+					 struct bgp_path_info *pi,
+					 struct bgp_path_info *exist,
+					 afi_t afi, safi_t safi)
+{
+	enum bgp_path_selection_reason reason;
+	char pfx_buf[PREFIX2STR_BUFFER] = {};
+	int paths_eq = 0;
+	uint32_t latency, exist_latency;
+	uint16_t loss, exist_loss;
+
+	if (!exist)
+		return true;
+
+	latency = bgp_twamp_path_latency(pi);
+	exist_latency = bgp_twamp_path_latency(exist);
+	if (latency != exist_latency)
+		return latency < exist_latency;
+
+	loss = bgp_twamp_path_loss(pi);
+	exist_loss = bgp_twamp_path_loss(exist);
+	if (loss != exist_loss)
+		return loss < exist_loss;
+
+	return bgp_path_info_cmp(bgp, pi, exist, &paths_eq, NULL, 0, pfx_buf,
+				 afi, safi, &reason);
+}
+
+/*
+ * Every path holds an ID for these strategies, so when the ranking moves
+ * only the paths entering or leaving the N picked are announced or
+ * withdrawn; the others match what the adj-out already has.
+ */
 static void
 subgrp_announce_addpath_best_selected(struct bgp_dest *dest,
 				      struct update_subgroup *subgrp)
@@ -100,8 +334,9 @@ subgrp_announce_addpath_best_selected(struct bgp_dest *dest,
 	int best_path_count = 0;
 	struct list *list = list_new();
 	struct bgp_path_info *pi = NULL;
+	enum bgp_addpath_strat type = peer->addpath_type[afi][safi];
 
-	if (peer->addpath_type[afi][safi] == BGP_ADDPATH_BEST_SELECTED) {
+	if (type == BGP_ADDPATH_BEST_SELECTED) {
 		while (best_path_count++ <
 		       peer->addpath_best_selected[afi][safi]) {
 			struct bgp_path_info *exist = NULL;
@@ -121,6 +356,30 @@ subgrp_announce_addpath_best_selected(struct bgp_dest *dest,
 					exist = pi;
 			}
 
+			if (exist)
+				listnode_add(list, exist);
+		}
+	} else if (type == BGP_ADDPATH_LOWEST_LATENCY) {
+		while (best_path_count++ <
+		       peer->addpath_best_selected[afi][safi]) {
+			struct bgp_path_info *exist = NULL;
+
+			for (pi = bgp_dest_get_bgp_path_info(dest); pi;
+			     pi = pi->next) {
+				if (!CHECK_FLAG(pi->flags, BGP_PATH_VALID) ||
+				    CHECK_FLAG(pi->flags, BGP_PATH_REMOVED |
+								  BGP_PATH_SELECTED))
+					continue;
+
+				if (listnode_lookup(list, pi))
+					continue;
+
+				if (subgrp_addpath_lower_latency(peer->bgp, pi,
+								 exist, afi,
+								 safi))
+					exist = pi;
+			}
+
 			if (exist)
 				listnode_add(list, exist);
 		}
@@ -130,8 +389,8 @@ subgrp_announce_addpath_best_selected(struct bgp_dest *dest,
 		uint32_t id = bgp_addpath_id_for_peer(peer, afi, safi,
 						      &pi->tx_addpath);
 
-		if (peer->addpath_type[afi][safi] ==
-		    BGP_ADDPATH_BEST_SELECTED) {
+		if (type == BGP_ADDPATH_BEST_SELECTED ||
+		    type == BGP_ADDPATH_LOWEST_LATENCY) {
 			if (listnode_lookup(list, pi))
 				subgroup_process_announce_selected(
 					subgrp, pi, dest, afi, safi, id);
@@ -152,6 +411,7 @@ static void subgrp_withdraw_stale_addpath(struct updwalk_context *ctx,
 					  struct update_subgroup *subgrp)
 {
 	struct bgp_adj_out *adj, *adj_next;
+	struct bgp_adj_out_set *set, *set_next;
 	uint32_t id;
 	struct bgp_path_info *pi;
 	afi_t afi = SUBGRP_AFI(subgrp);
@@ -180,6 +440,27 @@ static void subgrp_withdraw_stale_addpath(struct updwalk_context *ctx,
 							   adj->addpath_tx_id);
 		}
 	}
+
+	/* And the same for what went into sets */
+	for (set = ctx->dest->adj_out_sets; set; set = set_next) {
+		set_next = set->next;
+		if (!bgp_adj_out_set_test(set, subgrp->adj_slot))
+			continue;
+
+		for (pi = bgp_dest_get_bgp_path_info(ctx->dest); pi;
+		     pi = pi->next) {
+			id = bgp_addpath_id_for_peer(peer, afi, safi,
+						     &pi->tx_addpath);
+
+			if (id == set->addpath_tx_id)
+				break;
+		}
+
+		if (!pi)
+			subgroup_process_announce_selected(subgrp, NULL,
+							   ctx->dest, afi, safi,
+							   set->addpath_tx_id);
+	}
 }
 
 static int group_announce_route_walkcb(struct update_group *updgrp, void *arg)
@@ -190,6 +471,7 @@ static int group_announce_route_walkcb(struct update_group *updgrp, void *arg)
 	safi_t safi;
 	struct peer *peer;
 	struct bgp_adj_out *adj, *adj_next;
+	struct bgp_adj_out_set *set, *set_next;
 	bool addpath_capable;
 
 	afi = UPDGRP_AFI(updgrp);
@@ -232,12 +514,17 @@ static int group_announce_route_walkcb(struct update_group *updgrp, void *arg)
 			/* An update-group that does not use addpath */
 			else {
 				if (ctx->pi) {
+					struct bgp_path_info *pi;
+
+					pi = subgrp_orr_select(subgrp,
+							       ctx->dest,
+							       ctx->pi);
 					subgroup_process_announce_selected(
-						subgrp, ctx->pi, ctx->dest, afi,
+						subgrp, pi, ctx->dest, afi,
 						safi,
 						bgp_addpath_id_for_peer(
 							peer, afi, safi,
-							&ctx->pi->tx_addpath));
+							&pi->tx_addpath));
 				} else {
 					/* Find the addpath_tx_id of the path we
 					 * had advertised and
@@ -253,22 +540,51 @@ static int group_announce_route_walkcb(struct update_group *updgrp, void *arg)
 								adj->addpath_tx_id);
 						}
 					}
+					for (set = ctx->dest->adj_out_sets; set;
+					     set = set_next) {
+						set_next = set->next;
+						if (bgp_adj_out_set_test(
+							    set,
+							    subgrp->adj_slot))
+							subgroup_process_announce_selected(
+								subgrp, NULL,
+								ctx->dest, afi,
+								safi,
+								set->addpath_tx_id);
+					}
 				}
 			}
 		}
-
-		/* Notify BGP Conditional advertisement */
-		bgp_notify_conditional_adv_scanner(subgrp);
 	}
 
 	return UPDWALK_CONTINUE;
 }
 
+static void subgrp_show_adjq_header(struct vty *vty, struct bgp *bgp,
+				    struct bgp_table *table, int *header1,
+				    int *header2)
+{
+	if (*header1) {
+		vty_out(vty,
+			"BGP table version is %" PRIu64
+			", local router ID is %pI4\n",
+			table->version, &bgp->router_id);
+		vty_out(vty, BGP_SHOW_SCODE_HEADER);
+		vty_out(vty, BGP_SHOW_OCODE_HEADER);
+		*header1 = 0;
+	}
+	if (*header2) {
+		vty_out(vty, BGP_SHOW_HEADER);
+		*header2 = 0;
+	}
+}
+
 static void subgrp_show_adjq_vty(struct update_subgroup *subgrp,
 				 struct vty *vty, uint8_t flags)
 {
 	struct bgp_table *table;
 	struct bgp_adj_out *adj;
+	struct bgp_adj_out_set *set;
 	unsigned long output_count;
 	struct bgp_dest *dest;
 	int header1 = 1;
@@ -290,19 +606,8 @@ static void subgrp_show_adjq_vty(struct update_subgroup *subgrp,
 			if (adj->subgroup != subgrp)
 				continue;
 
-			if (header1) {
-				vty_out(vty,
-					"BGP table version is %" PRIu64
-					", local router ID is %pI4\n",
-					table->version, &bgp->router_id);
-				vty_out(vty, BGP_SHOW_SCODE_HEADER);
-				vty_out(vty, BGP_SHOW_OCODE_HEADER);
-				header1 = 0;
-			}
-			if (header2) {
-				vty_out(vty, BGP_SHOW_HEADER);
-				header2 = 0;
-			}
+			subgrp_show_adjq_header(vty, bgp, table, &header1,
+						&header2);
 			if ((flags & UPDWALK_FLAGS_ADVQUEUE) && adj->adv &&
 			    adj->adv->baa) {
 				route_vty_out_tmp(vty, bgp, dest, dest_p,
@@ -318,6 +623,20 @@ static void subgrp_show_adjq_vty(struct update_subgroup *subgrp,
 				output_count++;
 			}
 		}
+
+		if (!(flags & UPDWALK_FLAGS_ADVERTISED))
+			continue;
+
+		for (set = dest->adj_out_sets; set; set = set->next) {
+			if (!bgp_adj_out_set_test(set, subgrp->adj_slot))
+				continue;
+
+			subgrp_show_adjq_header(vty, bgp, table, &header1,
+						&header2);
+			route_vty_out_tmp(vty, bgp, dest, dest_p, set->attr,
+					  SUBGRP_SAFI(subgrp), 0, NULL, false);
+			output_count++;
+		}
 	}
 	if (output_count != 0)
 		vty_out(vty, "\nTotal number of prefixes %ld\n", output_count);
@@ -446,15 +765,7 @@ struct bgp_adj_out *bgp_adj_out_alloc(struct update_subgroup *subgrp,
 {
 	struct bgp_adj_out *adj;
 
-	adj = XCALLOC(MTYPE_BGP_ADJ_OUT, sizeof(struct bgp_adj_out));
-	adj->subgroup = subgrp;
-	adj->addpath_tx_id = addpath_tx_id;
-
-	RB_INSERT(bgp_adj_out_rb, &dest->adj_out, adj);
-	bgp_dest_lock_node(dest);
-	adj->dest = dest;
-
-	TAILQ_INSERT_TAIL(&(subgrp->adjq), adj, subgrp_adj_train);
+	adj = adj_insert(subgrp, dest, addpath_tx_id);
 	SUBGRP_INCR_STAT(subgrp, adj_count);
 	return adj;
 }
@@ -503,6 +814,7 @@ bool bgp_adj_out_set_subgroup(struct bgp_dest *dest,
 			      struct bgp_path_info *path)
 {
 	struct bgp_adj_out *adj = NULL;
+	struct bgp_adj_out_set *set = NULL;
 	struct bgp_advertise *adv;
 	struct peer *peer;
 	afi_t afi;
@@ -511,6 +823,7 @@ bool bgp_adj_out_set_subgroup(struct bgp_dest *dest,
 	struct peer_af *paf;
 	struct bgp *bgp;
 	uint32_t attr_hash = attrhash_key_make(attr);
+	uint32_t addpath_tx_id;
 
 	peer = SUBGRP_PEER(subgrp);
 	afi = SUBGRP_AFI(subgrp);
@@ -521,18 +834,17 @@ bool bgp_adj_out_set_subgroup(struct bgp_dest *dest,
 		return false;
 
 	/* Look for adjacency information. */
-	adj = adj_lookup(
-		dest, subgrp,
-		bgp_addpath_id_for_peer(peer, afi, safi, &path->tx_addpath));
+	addpath_tx_id =
+		bgp_addpath_id_for_peer(peer, afi, safi, &path->tx_addpath);
+	adj = adj_lookup(dest, subgrp, addpath_tx_id);
+	if (!adj)
+		set = adj_set_lookup(dest, subgrp, addpath_tx_id);
 
-	if (adj) {
+	if (adj || set) {
 		if (CHECK_FLAG(subgrp->sflags, SUBGRP_STATUS_TABLE_REPARSING))
 			subgrp->pscount++;
 	} else {
-		adj = bgp_adj_out_alloc(
-			subgrp, dest,
-			bgp_addpath_id_for_peer(peer, afi, safi,
-						&path->tx_addpath));
+		adj = bgp_adj_out_alloc(subgrp, dest, addpath_tx_id);
 		if (!adj)
 			return false;
 
@@ -547,7 +859,7 @@ bool bgp_adj_out_set_subgroup(struct bgp_dest *dest,
 	 */
 	if (CHECK_FLAG(bgp->flags, BGP_FLAG_SUPPRESS_DUPLICATES)
 	    && !CHECK_FLAG(subgrp->sflags, SUBGRP_STATUS_FORCE_UPDATES)
-	    && adj->attr_hash == attr_hash) {
+	    && (adj ? adj->attr_hash : set->attr_hash) == attr_hash) {
 		if (BGP_DEBUG(update, UPDATE_OUT)) {
 			char attr_str[BUFSIZ] = {0};
 
@@ -576,6 +888,32 @@ bool bgp_adj_out_set_subgroup(struct bgp_dest *dest,
 		return false;
 	}
 
+	/*
+	 * The route flapped back, e.g. on latency churn, before what was
+	 * queued since it was last sent went out: the peer already has it,
+	 * so the changes collapse to nothing. Labels are not part of the
+	 * attributes, so only for unlabeled routes.
+	 */
+	if (adj && adj->adv && adj->attr &&
+	    (safi == SAFI_UNICAST || safi == SAFI_MULTICAST) &&
+	    CHECK_FLAG(bgp->flags, BGP_FLAG_SUPPRESS_DUPLICATES) &&
+	    !CHECK_FLAG(subgrp->sflags, SUBGRP_STATUS_FORCE_UPDATES) &&
+	    attrhash_cmp(adj->attr, attr)) {
+		if (BGP_DEBUG(update, UPDATE_OUT))
+			zlog_debug("u%" PRIu64 ":s%" PRIu64
+				   " %pBD unchanged since sent, dropping queued change",
+				   subgrp->update_group->id, subgrp->id, dest);
+
+		bgp_advertise_clean_subgroup(subgrp, adj);
+		adj->attr_hash = attr_hash;
+		subgrp->updates_coalesced++;
+		subgrp->version = MAX(subgrp->version, dest->version);
+		return false;
+	}
+
+	if (set)
+		adj = adj_set_inflate(dest, set, subgrp);
+
 	if (adj->adv)
 		bgp_advertise_clean_subgroup(subgrp, adj);
 	adj->adv = bgp_advertise_new();
@@ -641,7 +979,7 @@ void bgp_adj_out_unset_subgroup(struct bgp_dest *dest,
 		return;
 
 	/* Lookup existing adjacency */
-	adj = adj_lookup(dest, subgrp, addpath_tx_id);
+	adj = adj_lookup_inflate(dest, subgrp, addpath_tx_id);
 	if (adj != NULL) {
 		/* Clean up previous advertisement.  */
 		if (adj->adv)
@@ -702,9 +1040,138 @@ void bgp_adj_out_remove_subgroup(struct bgp_dest *dest, struct bgp_adj_out *adj,
 void subgroup_clear_table(struct update_subgroup *subgrp)
 {
 	struct bgp_adj_out *aout, *taout;
+	struct bgp_adj_out_set *set, *set_next;
+	struct bgp_table *table;
+	struct bgp_dest *dest;
 
 	SUBGRP_FOREACH_ADJ_SAFE (subgrp, aout, taout)
 		bgp_adj_out_remove_subgroup(aout->dest, aout, subgrp);
+
+	if (!subgrp->adj_compact)
+		return;
+
+	table = SUBGRP_INST(subgrp)->rib[SUBGRP_AFI(subgrp)][SUBGRP_SAFI(subgrp)];
+	for (dest = bgp_table_top(table); dest; dest = bgp_route_next(dest)) {
+		for (set = dest->adj_out_sets; set; set = set_next) {
+			set_next = set->next;
+			if (!bgp_adj_out_set_test(set, subgrp->adj_slot))
+				continue;
+
+			adj_set_clear(dest, set, subgrp);
+			SUBGRP_DECR_STAT(subgrp, adj_count);
+		}
+
+		if (!subgrp->adj_compact) {
+			bgp_dest_unlock_node(dest);
+			break;
+		}
+	}
+}
+
+/*
+ * Called as an advertisement goes out; folds the adj-out into a set if
+ * its address family compacts them.
+ */
+void bgp_adj_out_compact(struct bgp_adj_out *adj)
+{
+	if (adj->adv || !adj->attr || !adj_compact_enabled(adj->subgroup))
+		return;
+
+	adj_compact(adj);
+}
+
+/*
+ * As "bgp adj-out compact" is turned on or off: fold every settled adj-out
+ * of the table into sets, or turn every set back into adj-outs.
+ */
+void bgp_adj_out_compact_table(struct bgp *bgp, afi_t afi, safi_t safi,
+			       bool compact)
+{
+	struct bgp_table *table = bgp->rib[afi][safi];
+	struct bgp_adj_out *adj, *adj_next;
+	struct bgp_adj_out_set *set;
+	struct bgp_dest *dest;
+	uint32_t slot;
+
+	if (!table)
+		return;
+
+	for (dest = bgp_table_top(table); dest; dest = bgp_route_next(dest)) {
+		if (compact) {
+			RB_FOREACH_SAFE (adj, bgp_adj_out_rb, &dest->adj_out,
+					 adj_next)
+				if (!adj->adv && adj->attr)
+					adj_compact(adj);
+			continue;
+		}
+
+		/* A set is freed as its last bit goes, so this ends */
+		while ((set = dest->adj_out_sets)) {
+			for (slot = 0; !bgp_adj_out_set_test(set, slot); slot++)
+				;
+			adj_set_inflate(dest, set, bgp->adj_slots[slot]);
+		}
+	}
+}
+
+/*
+ * Put target in every set source is in, as update_subgroup_copy_adj_out()
+ * does for the adj-outs.
+ */
+void subgroup_copy_adj_out_sets(struct update_subgroup *source,
+				struct update_subgroup *target)
+{
+	struct bgp_adj_out_set **setp;
+	struct bgp_table *table;
+	struct bgp_dest *dest;
+	uint32_t left = source->adj_compact;
+
+	if (!left)
+		return;
+
+	table = SUBGRP_INST(source)->rib[SUBGRP_AFI(source)][SUBGRP_SAFI(source)];
+	for (dest = bgp_table_top(table); dest; dest = bgp_route_next(dest)) {
+		for (setp = &dest->adj_out_sets; *setp; setp = &(*setp)->next) {
+			if (!bgp_adj_out_set_test(*setp, source->adj_slot))
+				continue;
+
+			adj_set_add(setp, target);
+			SUBGRP_INCR_STAT(target, adj_count);
+			left--;
+		}
+
+		if (!left) {
+			bgp_dest_unlock_node(dest);
+			break;
+		}
+	}
+}
+
+struct attr *bgp_adj_out_walk_next(struct update_subgroup *subgrp,
+				   struct bgp_dest *dest,
+				   struct bgp_adj_out_walk *walk)
+{
+	if (!subgrp || !dest)
+		return NULL;
+
+	if (!walk->sets) {
+		walk->adj = walk->adj ? RB_NEXT(bgp_adj_out_rb, walk->adj)
+				      : RB_MIN(bgp_adj_out_rb, &dest->adj_out);
+		for (; walk->adj; walk->adj = RB_NEXT(bgp_adj_out_rb, walk->adj))
+			if (walk->adj->subgroup == subgrp && walk->adj->attr)
+				return walk->adj->attr;
+
+		walk->sets = true;
+		walk->set = dest->adj_out_sets;
+	} else {
+		walk->set = walk->set->next;
+	}
+
+	for (; walk->set; walk->set = walk->set->next)
+		if (bgp_adj_out_set_test(walk->set, subgrp->adj_slot))
+			return walk->set->attr;
+
+	return NULL;
 }
 
 /*
@@ -714,7 +1181,7 @@ void subgroup_announce_table(struct update_subgroup *subgrp,
 			     struct bgp_table *table)
 {
 	struct bgp_dest *dest;
-	struct bgp_path_info *ri;
+	struct bgp_path_info *ri, *pi;
 	struct peer *peer;
 	afi_t afi;
 	safi_t safi;
@@ -764,12 +1231,17 @@ void subgroup_announce_table(struct update_subgroup *subgrp,
 			    is_default_prefix(bgp_dest_get_prefix(dest)))
 				break;
 
-			if (CHECK_FLAG(ri->flags, BGP_PATH_SELECTED))
+			if (CHECK_FLAG(ri->flags, BGP_PATH_SELECTED)) {
+				pi = addpath_capable
+					     ? ri
+					     : subgrp_orr_select(subgrp, dest,
+								 ri);
 				subgroup_process_announce_selected(
-					subgrp, ri, dest, afi, safi_rib,
+					subgrp, pi, dest, afi, safi_rib,
 					bgp_addpath_id_for_peer(
 						peer, afi, safi_rib,
-						&ri->tx_addpath));
+						&pi->tx_addpath));
+			}
 		}
 	}
 	UNSET_FLAG(subgrp->sflags, SUBGRP_STATUS_TABLE_REPARSING);
@@ -1004,7 +1476,7 @@ void subgroup_default_originate(struct update_subgroup *subgrp, int withdraw)
 				/* Remove the adjacency for the previously
 				 * advertised default route
 				 */
-				adj = adj_lookup(
+				adj = adj_lookup_inflate(
 				       dest, subgrp,
 				       BGP_ADDPATH_TX_ID_FOR_DEFAULT_ORIGINATE);
 				if (adj != NULL) {
@@ -33,6 +33,7 @@
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_errors.h"
 #include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_io.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_packet.h"
 #include "bgpd/bgp_advertise.h"
@@ -61,7 +62,7 @@ struct bpacket *bpacket_alloc(void)
 
 void bpacket_free(struct bpacket *pkt)
 {
-	if (pkt->buffer)
+	if (pkt->buffer && !pkt->buffer_given)
 		stream_free(pkt->buffer);
 	pkt->buffer = NULL;
 	XFREE(MTYPE_BGP_PACKET, pkt);
@@ -329,6 +330,24 @@ void bpacket_queue_show_vty(struct bpacket_queue *q, struct vty *vty)
 	return;
 }
 
+/*
+ * Whether paf is the last peer waiting on pkt at the head of its queue, in
+ * which case the packet is freed as soon as paf is advanced past it.
+ */
+static bool bpacket_last_peer(struct bpacket *pkt, struct peer_af *paf)
+{
+	return LIST_FIRST(&(pkt->peers)) == paf &&
+	       LIST_NEXT(paf, pkt_train) == NULL &&
+	       bpacket_queue_first(PAF_PKTQ(paf)) == pkt;
+}
+
+/*
+ * The caller must advance paf past pkt right after this, since the last
+ * peer to send a packet gets its buffer rather than a copy of it.
+ *
+ * Unless the nexthop is rewritten per peer, the others get views of the
+ * buffer, so an UPDATE is only ever built once per subgroup.
+ */
 struct stream *bpacket_reformat_for_peer(struct bpacket *pkt,
 					 struct peer_af *paf)
 {
@@ -336,12 +355,22 @@ struct stream *bpacket_reformat_for_peer(struct bpacket *pkt,
 	bpacket_attr_vec *vec;
 	struct peer *peer;
 	struct bgp_filter *filter;
-
-	s = stream_dup(pkt->buffer);
-	peer = PAF_PEER(paf);
+	size_t len;
 
 	vec = &pkt->arr.entries[BGP_ATTR_VEC_NH];
 
+	if (bpacket_last_peer(pkt, paf)) {
+		s = pkt->buffer;
+		pkt->buffer_given = true;
+	} else if (!CHECK_FLAG(vec->flags, BPKT_ATTRVEC_FLAGS_UPDATED)) {
+		return stream_share(pkt->buffer);
+	} else {
+		len = stream_get_endp(pkt->buffer);
+		s = bgp_pkt_stream_new(len);
+		stream_put(s, STREAM_DATA(pkt->buffer), len);
+	}
+	peer = PAF_PEER(paf);
+
 	if (!CHECK_FLAG(vec->flags, BPKT_ATTRVEC_FLAGS_UPDATED))
 		return s;
 
@@ -382,7 +411,7 @@ struct stream *bpacket_reformat_for_peer(struct bpacket *pkt,
 				EC_BGP_INVALID_NEXTHOP_LENGTH,
 				"%s: %s: invalid MP nexthop length (AFI IP): %u",
 				__func__, peer->host, nhlen);
-			stream_free(s);
+			bgp_pkt_stream_free(s);
 			return NULL;
 		}
 
@@ -486,7 +515,7 @@ struct stream *bpacket_reformat_for_peer(struct bpacket *pkt,
 				EC_BGP_INVALID_NEXTHOP_LENGTH,
 				"%s: %s: invalid MP nexthop length (AFI IP6): %u",
 				__func__, peer->host, nhlen);
-			stream_free(s);
+			bgp_pkt_stream_free(s);
 			return NULL;
 		}
 
@@ -873,6 +902,7 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 
 		adj->attr = bgp_attr_intern(adv->baa->attr);
 		adv = bgp_advertise_clean_subgroup(subgrp, adj);
+		bgp_adj_out_compact(adj);
 	}
 
 	if (!stream_empty(s)) {
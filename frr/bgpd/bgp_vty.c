@@ -61,12 +61,31 @@
 #include "bgpd/bgp_mac.h"
 #include "bgpd/bgp_flowspec.h"
 #include "bgpd/bgp_conditional_adv.h"
+#include "bgpd/bgp_twamp.h"
+#include "bgpd/bgp_twamp_nhg.h"
+#include "bgpd/bgp_twamp_ted.h"
+#include "bgpd/bgp_twamp_egress.h"
+#include "bgpd/bgp_select.h"
+#include "bgpd/bgp_preparse.h"
 #ifdef ENABLE_BGP_VNC
 #include "bgpd/rfapi/bgp_rfapi_cfg.h"
 #endif
 
+/* Thresholds are kept in microseconds; whole milliseconds are written as such */
+static void bgp_config_write_latency_threshold(struct vty *vty,
+                                               const char *name, uint32_t us)
+{
+    if (us % 1000)
+        vty_out(vty, "  bgp import check-latency %s %u microseconds\n", name, us);
+    else
+        vty_out(vty, "  bgp import check-latency %s %u\n", name, us / 1000);
+}
+
 static int bgp_config_write_import_latency(struct vty *vty, struct bgp *bgp)
 {
+    char name[64];
+    unsigned int i;
+
     if (bgp->import_latency_cfg.enabled) {
         vty_out(vty, "  bgp import check-latency\n");
         
@@ -79,9 +98,95 @@ static int bgp_config_write_import_latency(struct vty *vty, struct bgp *bgp)
             vty_out(vty, "  bgp import check-latency packet-count %d\n",
                     bgp->import_latency_cfg.packet_count);
         
-        if (bgp->import_latency_cfg.damping_threshold != 50)
-            vty_out(vty, "  bgp import check-latency damping-threshold %u\n",
-                    bgp->import_latency_cfg.damping_threshold);
+        if (bgp->import_latency_cfg.damping_threshold_us != 50000)
+            bgp_config_write_latency_threshold(vty, "damping-threshold",
+                    bgp->import_latency_cfg.damping_threshold_us);
+
+        if (bgp->import_latency_cfg.port != 862)
+            vty_out(vty, "  bgp import check-latency port %d\n",
+                    bgp->import_latency_cfg.port);
+
+        if (bgp->import_latency_cfg.dscp)
+            vty_out(vty, "  bgp import check-latency dscp %u\n",
+                    bgp->import_latency_cfg.dscp);
+
+        if (bgp->import_latency_cfg.one_way)
+            vty_out(vty, "  bgp import check-latency one-way\n");
+
+        if (bgp->import_latency_cfg.switch_back_threshold_us != 25000)
+            bgp_config_write_latency_threshold(vty, "switch-back-threshold",
+                    bgp->import_latency_cfg.switch_back_threshold_us);
+
+        if (bgp->import_latency_cfg.min_dwell_sec)
+            vty_out(vty, "  bgp import check-latency min-dwell %u\n",
+                    bgp->import_latency_cfg.min_dwell_sec);
+
+        if (bgp->import_latency_cfg.hold_down_half_life)
+            vty_out(vty, "  bgp import check-latency hold-down %u\n",
+                    bgp->import_latency_cfg.hold_down_half_life / 60);
+
+        if (bgp->import_latency_cfg.loss_threshold_permille)
+            vty_out(vty, "  bgp import check-latency loss-threshold %u\n",
+                    bgp->import_latency_cfg.loss_threshold_permille / 10);
+
+        if (bgp->import_latency_cfg.weighted_ecmp)
+            vty_out(vty, "  bgp import check-latency weighted-ecmp\n");
+
+        if (bgp->import_latency_cfg.nexthop_group)
+            vty_out(vty, "  bgp import check-latency nexthop-group%s\n",
+                    bgp->import_latency_cfg.nexthop_group_backup
+                            ? " backup" : "");
+
+        if (bgp->import_latency_cfg.bfd_echo)
+            vty_out(vty, "  bgp import check-latency bfd-echo\n");
+
+        if (bgp->import_latency_cfg.source == BGP_LATENCY_SOURCE_IGP_TE)
+            vty_out(vty, "  bgp import check-latency source igp-te\n");
+        else if (bgp->import_latency_cfg.source == BGP_LATENCY_SOURCE_HYBRID)
+            vty_out(vty, "  bgp import check-latency source hybrid\n");
+
+        if (bgp->import_latency_cfg.hybrid_tolerance_us != 5000)
+            bgp_config_write_latency_threshold(vty, "hybrid-tolerance",
+                    bgp->import_latency_cfg.hybrid_tolerance_us);
+
+        if (bgp->import_latency_cfg.hybrid_probe_cycle_sec != 600)
+            vty_out(vty, "  bgp import check-latency hybrid-probe-cycle %u\n",
+                    bgp->import_latency_cfg.hybrid_probe_cycle_sec);
+
+        if (bgp->import_latency_cfg.advertise &&
+            bgp->import_latency_cfg.advertise_interval_sec != 30)
+            vty_out(vty, "  bgp import check-latency advertise interval %u\n",
+                    bgp->import_latency_cfg.advertise_interval_sec);
+        else if (bgp->import_latency_cfg.advertise)
+            vty_out(vty, "  bgp import check-latency advertise\n");
+
+        if (bgp->import_latency_cfg.coalesce_msec)
+            vty_out(vty, "  bgp import check-latency coalesce %u\n",
+                    bgp->import_latency_cfg.coalesce_msec);
+
+        for (i = 0; i < bgp->import_latency_cfg.color_class_count; i++) {
+            snprintf(name, sizeof(name), "color-class %u upto",
+                     bgp->import_latency_cfg.color_classes[i].color);
+            bgp_config_write_latency_threshold(vty, name,
+                    bgp->import_latency_cfg.color_classes[i].upto_us);
+        }
+
+        if (bgp->import_latency_cfg.color_steering)
+            vty_out(vty, "  bgp import check-latency color-steering\n");
+
+        for (i = 0; i < bgp->import_latency_cfg.egress_exit_count; i++)
+            vty_out(vty, "  bgp import check-latency egress exit %pI4 mark %u\n",
+                    &bgp->import_latency_cfg.egress_exits[i].nexthop,
+                    bgp->import_latency_cfg.egress_exits[i].mark);
+
+        if (bgp->import_latency_cfg.egress_plist)
+            vty_out(vty, "  bgp import check-latency egress prefix-list %s\n",
+                    bgp->import_latency_cfg.egress_plist);
+
+        if (bgp->import_latency_cfg.egress_max_prefixes !=
+            BGP_LATENCY_EGRESS_MAX_PREFIXES_DEFAULT)
+            vty_out(vty, "  bgp import check-latency egress max-prefixes %u\n",
+                    bgp->import_latency_cfg.egress_max_prefixes);
     }
     
     return 0;
@@ -2018,6 +2123,34 @@ DEFPY (no_bgp_send_extra_data,
 	return CMD_SUCCESS;
 }
 
+DEFPY (bgp_send_nexthop_groups,
+       bgp_send_nexthop_groups_cmd,
+       "[no] bgp send-nexthop-groups zebra",
+       NO_STR
+       BGP_STR
+       "Install VPN imports through nexthop groups sent ahead\n"
+       "To zebra\n")
+{
+	struct listnode *node;
+	struct bgp *bgp;
+
+	if (!no == !!CHECK_FLAG(bm->flags, BM_FLAG_INSTALL_NHG))
+		return CMD_SUCCESS;
+
+	if (no)
+		UNSET_FLAG(bm->flags, BM_FLAG_INSTALL_NHG);
+	else
+		SET_FLAG(bm->flags, BM_FLAG_INSTALL_NHG);
+
+	/* The routes go out again, onto the groups or off them */
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp)) {
+		bgp_zebra_announce_table(bgp, AFI_IP, SAFI_UNICAST);
+		bgp_zebra_announce_table(bgp, AFI_IP6, SAFI_UNICAST);
+	}
+
+	return CMD_SUCCESS;
+}
+
 DEFUN (bgp_confederation_identifier,
        bgp_confederation_identifier_cmd,
        "bgp confederation identifier ASNUM",
@@ -2239,178 +2372,1230 @@ DEFUN (no_bgp_maxmed_onstartup,
 {
 	VTY_DECLVAR_CONTEXT(bgp, bgp);
 
-	/* Cancel max-med onstartup if its on */
-	if (bgp->t_maxmed_onstartup) {
-		EVENT_OFF(bgp->t_maxmed_onstartup);
-		bgp->maxmed_onstartup_over = 1;
-	}
+	/* Cancel max-med onstartup if its on */
+	if (bgp->t_maxmed_onstartup) {
+		EVENT_OFF(bgp->t_maxmed_onstartup);
+		bgp->maxmed_onstartup_over = 1;
+	}
+
+	bgp->v_maxmed_onstartup = BGP_MAXMED_ONSTARTUP_UNCONFIGURED;
+	bgp->maxmed_onstartup_value = BGP_MAXMED_VALUE_DEFAULT;
+
+	bgp_maxmed_update(bgp);
+
+	return CMD_SUCCESS;
+}
+
+//FOR BGP TWAMP-LIGHT PROJECT
+//Cli
+/* Main enable/disable */
+DEFUN(bgp_import_check_latency,
+      bgp_import_check_latency_cmd,
+      "bgp import check-latency",
+      BGP_STR
+      "Import configuration\n"
+      "Enable latency-based path selection for imported routes\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    
+    /* Only allow in IPv4 unicast */
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    bgp->import_latency_cfg.enabled = true;
+	bgp_bestpath_steps_update(bgp);
+	bgp_twamp_init(bgp);
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency,
+      no_bgp_import_check_latency_cmd,
+      "no bgp import check-latency",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Disable latency-based path selection\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    
+    bgp->import_latency_cfg.enabled = false;
+    bgp_bestpath_steps_update(bgp);
+    /* Steered routes go back to zebra without a colour */
+    if (bgp->import_latency_cfg.color_steering) {
+        bgp_twamp_color_refresh(bgp);
+    }
+	bgp_twamp_cleanup(bgp);
+    
+    /* Reset to defaults */
+    bgp->import_latency_cfg.probe_cycle_sec = 60;
+    bgp->import_latency_cfg.packet_count = 3;
+    bgp->import_latency_cfg.damping_threshold_us = 50000;
+    bgp->import_latency_cfg.port = 862;
+    bgp->import_latency_cfg.dscp = 0;
+    bgp->import_latency_cfg.one_way = false;
+    bgp->import_latency_cfg.switch_back_threshold_us = 25000;
+    bgp->import_latency_cfg.min_dwell_sec = 0;
+    bgp->import_latency_cfg.hold_down_half_life = 0;
+    bgp->import_latency_cfg.loss_threshold_permille = 0;
+    bgp->import_latency_cfg.weighted_ecmp = false;
+    bgp->import_latency_cfg.nexthop_group = false;
+    bgp->import_latency_cfg.nexthop_group_backup = false;
+    bgp->import_latency_cfg.bfd_echo = false;
+    bgp->import_latency_cfg.source = BGP_LATENCY_SOURCE_TWAMP;
+    bgp->import_latency_cfg.hybrid_tolerance_us = 5000;
+    bgp->import_latency_cfg.hybrid_probe_cycle_sec = 600;
+    bgp->import_latency_cfg.advertise_interval_sec = 30;
+    bgp->import_latency_cfg.coalesce_msec = 0;
+    bgp->import_latency_cfg.color_steering = false;
+    bgp->import_latency_cfg.color_class_count = 0;
+    /* Drops the exits and prefix-list along with the destinations */
+    bgp_twamp_egress_finish(bgp);
+    bgp->import_latency_cfg.egress_max_prefixes =
+        BGP_LATENCY_EGRESS_MAX_PREFIXES_DEFAULT;
+    bgp_twamp_ted_update();
+    if (bgp->import_latency_cfg.advertise) {
+        bgp->import_latency_cfg.advertise = false;
+        update_group_announce(bgp);
+    }
+    
+    return CMD_SUCCESS;
+}
+
+/* Probe cycle */
+DEFUN(bgp_import_check_latency_probe_cycle,
+      bgp_import_check_latency_probe_cycle_cmd,
+      "bgp import check-latency probe-cycle (10-300)",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Probe cycle interval (default: 60 seconds)\n"
+      "Interval in seconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    int idx = 0;
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    argv_find(argv, argc, "(10-300)", &idx);
+    bgp->import_latency_cfg.probe_cycle_sec = strtol(argv[idx]->arg, NULL, 10);
+    bgp_twamp_import_changed();
+    
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_probe_cycle,
+      no_bgp_import_check_latency_probe_cycle_cmd,
+      "no bgp import check-latency probe-cycle [(10-300)]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Probe cycle interval\n"
+      "Interval in seconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    bgp->import_latency_cfg.probe_cycle_sec = 60;
+    bgp_twamp_import_changed();
+    return CMD_SUCCESS;
+}
+
+/* Packet count */
+DEFUN(bgp_import_check_latency_packet_count,
+      bgp_import_check_latency_packet_count_cmd,
+      "bgp import check-latency packet-count (1-10)",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Number of probe packets per cycle (default: 3)\n"
+      "Packet count\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    int idx = 0;
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    argv_find(argv, argc, "(1-10)", &idx);
+    bgp->import_latency_cfg.packet_count = strtol(argv[idx]->arg, NULL, 10);
+    bgp_twamp_import_changed();
+    
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_packet_count,
+      no_bgp_import_check_latency_packet_count_cmd,
+      "no bgp import check-latency packet-count [(1-10)]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Packet count\n"
+      "Packet count\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    bgp->import_latency_cfg.packet_count = 3;
+    bgp_twamp_import_changed();
+    return CMD_SUCCESS;
+}
+
+/* Reflector port the agent probes */
+DEFUN(bgp_import_check_latency_port,
+      bgp_import_check_latency_port_cmd,
+      "bgp import check-latency port (1-65535)",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "UDP port of the TWAMP reflectors (default: 862)\n"
+      "Port number\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    int idx = 0;
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    argv_find(argv, argc, "(1-65535)", &idx);
+    bgp->import_latency_cfg.port = strtol(argv[idx]->arg, NULL, 10);
+    bgp_twamp_import_changed();
+    
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_port,
+      no_bgp_import_check_latency_port_cmd,
+      "no bgp import check-latency port [(1-65535)]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "UDP port of the TWAMP reflectors\n"
+      "Port number\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    bgp->import_latency_cfg.port = 862;
+    bgp_twamp_import_changed();
+    return CMD_SUCCESS;
+}
+
+/*
+ * Threshold argument in microseconds: milliseconds (up to a second)
+ * unless the microseconds keyword follows. False if out of range.
+ */
+static bool bgp_import_latency_threshold_arg(struct vty *vty, int argc,
+                                             struct cmd_token **argv,
+                                             uint32_t *us)
+{
+    int idx = 0;
+    unsigned long val;
+
+    argv_find(argv, argc, "(0-1000000)", &idx);
+    val = strtoul(argv[idx]->arg, NULL, 10);
+    if (argv_find(argv, argc, "microseconds", &idx)) {
+        *us = val;
+        return true;
+    }
+    if (val > 1000) {
+        vty_out(vty, "%% Threshold must be at most 1000 milliseconds\n");
+        return false;
+    }
+    *us = val * 1000;
+    return true;
+}
+
+/* Damping threshold */
+DEFUN(bgp_import_check_latency_damping_threshold,
+      bgp_import_check_latency_damping_threshold_cmd,
+      "bgp import check-latency damping-threshold (0-1000000) [<milliseconds|microseconds>]",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Minimum latency change (default: 50ms)\n"
+      "Threshold\n"
+      "Threshold in milliseconds (default)\n"
+      "Threshold in microseconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    uint32_t us;
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    if (!bgp_import_latency_threshold_arg(vty, argc, argv, &us))
+        return CMD_WARNING_CONFIG_FAILED;
+    bgp->import_latency_cfg.damping_threshold_us = us;
+    /* Agents probe peers near the threshold more often */
+    bgp_twamp_import_changed();
+    
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_damping_threshold,
+      no_bgp_import_check_latency_damping_threshold_cmd,
+      "no bgp import check-latency damping-threshold [(0-1000000) [<milliseconds|microseconds>]]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Damping threshold\n"
+      "Threshold\n"
+      "Threshold in milliseconds\n"
+      "Threshold in microseconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    bgp->import_latency_cfg.damping_threshold_us = 50000;
+    bgp_twamp_import_changed();
+    return CMD_SUCCESS;
+}
+
+/* Switch-back threshold */
+DEFUN(bgp_import_check_latency_switch_back_threshold,
+      bgp_import_check_latency_switch_back_threshold_cmd,
+      "bgp import check-latency switch-back-threshold (0-1000000) [<milliseconds|microseconds>]",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Latency margin the selected path keeps its win by (default: 25ms)\n"
+      "Threshold\n"
+      "Threshold in milliseconds (default)\n"
+      "Threshold in microseconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    uint32_t us;
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    if (!bgp_import_latency_threshold_arg(vty, argc, argv, &us))
+        return CMD_WARNING_CONFIG_FAILED;
+    bgp->import_latency_cfg.switch_back_threshold_us = us;
+    
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_switch_back_threshold,
+      no_bgp_import_check_latency_switch_back_threshold_cmd,
+      "no bgp import check-latency switch-back-threshold [(0-1000000) [<milliseconds|microseconds>]]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Switch-back threshold\n"
+      "Threshold\n"
+      "Threshold in milliseconds\n"
+      "Threshold in microseconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    bgp->import_latency_cfg.switch_back_threshold_us = 25000;
+    return CMD_SUCCESS;
+}
+
+/* Minimum dwell time */
+DEFUN(bgp_import_check_latency_min_dwell,
+      bgp_import_check_latency_min_dwell_cmd,
+      "bgp import check-latency min-dwell (1-3600)",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Time a latency change must persist before it is used\n"
+      "Dwell time in seconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    int idx = 0;
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    argv_find(argv, argc, "(1-3600)", &idx);
+    bgp->import_latency_cfg.min_dwell_sec = strtoul(argv[idx]->arg, NULL, 10);
+    
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_min_dwell,
+      no_bgp_import_check_latency_min_dwell_cmd,
+      "no bgp import check-latency min-dwell [(1-3600)]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Time a latency change must persist before it is used\n"
+      "Dwell time in seconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    bgp->import_latency_cfg.min_dwell_sec = 0;
+    return CMD_SUCCESS;
+}
+
+/* Hold-down of peers whose latency keeps flipping */
+DEFUN(bgp_import_check_latency_hold_down,
+      bgp_import_check_latency_hold_down_cmd,
+      "bgp import check-latency hold-down [(1-45)]",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Hold down peers whose latency keeps flipping, as in route-flap dampening\n"
+      "Half-life in minutes (default: 15)\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    int idx = 0;
+    uint32_t half = DEFAULT_HALF_LIFE;
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    if (argv_find(argv, argc, "(1-45)", &idx))
+        half = strtoul(argv[idx]->arg, NULL, 10);
+    bgp->import_latency_cfg.hold_down_half_life = half * 60;
+    
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_hold_down,
+      no_bgp_import_check_latency_hold_down_cmd,
+      "no bgp import check-latency hold-down [(1-45)]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Hold down peers whose latency keeps flipping, as in route-flap dampening\n"
+      "Half-life in minutes\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    bgp->import_latency_cfg.hold_down_half_life = 0;
+    return CMD_SUCCESS;
+}
+
+/* Fast reroute on probe loss */
+DEFUN(bgp_import_check_latency_loss_threshold,
+      bgp_import_check_latency_loss_threshold_cmd,
+      "bgp import check-latency loss-threshold (1-100)",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Demote paths via a nexthop losing this many probes, without waiting for hold-down or min-dwell\n"
+      "Probe loss in percent\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    int idx = 0;
+    uint16_t permille;
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    argv_find(argv, argc, "(1-100)", &idx);
+    permille = strtoul(argv[idx]->arg, NULL, 10) * 10;
+    if (bgp->import_latency_cfg.loss_threshold_permille == permille)
+        return CMD_SUCCESS;
+    bgp->import_latency_cfg.loss_threshold_permille = permille;
+    /* Nexthops already past the new threshold are demoted right away */
+    bgp_recalculate_all_bestpaths(bgp);
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_loss_threshold,
+      no_bgp_import_check_latency_loss_threshold_cmd,
+      "no bgp import check-latency loss-threshold [(1-100)]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Demote paths via a nexthop losing this many probes, without waiting for hold-down or min-dwell\n"
+      "Probe loss in percent\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    
+    if (!bgp->import_latency_cfg.loss_threshold_permille)
+        return CMD_SUCCESS;
+    bgp->import_latency_cfg.loss_threshold_permille = 0;
+    bgp_recalculate_all_bestpaths(bgp);
+    return CMD_SUCCESS;
+}
+
+/* Latency-weighted multipath */
+DEFUN(bgp_import_check_latency_weighted_ecmp,
+      bgp_import_check_latency_weighted_ecmp_cmd,
+      "bgp import check-latency weighted-ecmp",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Weight multipaths inversely to their measured latency\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    if (bgp->import_latency_cfg.weighted_ecmp)
+        return CMD_SUCCESS;
+    bgp->import_latency_cfg.weighted_ecmp = true;
+    /* Weights are worked out with the multipath set, so redo that */
+    bgp_recalculate_all_bestpaths(bgp);
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_weighted_ecmp,
+      no_bgp_import_check_latency_weighted_ecmp_cmd,
+      "no bgp import check-latency weighted-ecmp",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Weight multipaths inversely to their measured latency\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    
+    if (!bgp->import_latency_cfg.weighted_ecmp)
+        return CMD_SUCCESS;
+    bgp->import_latency_cfg.weighted_ecmp = false;
+    bgp_recalculate_all_bestpaths(bgp);
+    return CMD_SUCCESS;
+}
+
+/* Latency-decided routes through shared nexthop groups */
+DEFUN(bgp_import_check_latency_nexthop_group,
+      bgp_import_check_latency_nexthop_group_cmd,
+      "bgp import check-latency nexthop-group [backup]",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Install routes won on latency through nexthop groups shared per egress PE set\n"
+      "Precompute the next-lowest latency PE as the backup of each group\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    bool backup = argc > 4;
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    if (bgp->import_latency_cfg.nexthop_group &&
+        bgp->import_latency_cfg.nexthop_group_backup == backup)
+        return CMD_SUCCESS;
+    bgp->import_latency_cfg.nexthop_group = true;
+    bgp->import_latency_cfg.nexthop_group_backup = backup;
+    bgp_twamp_nhg_backup_update(bgp);
+    /* Best paths are the same, only the way they are installed moves */
+    bgp_zebra_announce_table(bgp, AFI_IP, SAFI_UNICAST);
+    bgp_zebra_announce_table(bgp, AFI_IP6, SAFI_UNICAST);
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_nexthop_group,
+      no_bgp_import_check_latency_nexthop_group_cmd,
+      "no bgp import check-latency nexthop-group [backup]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Install routes won on latency through nexthop groups shared per egress PE set\n"
+      "Precompute the next-lowest latency PE as the backup of each group\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    
+    /* Only the backups go, the groups stay */
+    if (argc > 5) {
+        if (bgp->import_latency_cfg.nexthop_group_backup) {
+            bgp->import_latency_cfg.nexthop_group_backup = false;
+            bgp_twamp_nhg_backup_update(bgp);
+        }
+        return CMD_SUCCESS;
+    }
+
+    if (!bgp->import_latency_cfg.nexthop_group)
+        return CMD_SUCCESS;
+    bgp->import_latency_cfg.nexthop_group = false;
+    bgp->import_latency_cfg.nexthop_group_backup = false;
+    bgp_zebra_announce_table(bgp, AFI_IP, SAFI_UNICAST);
+    bgp_zebra_announce_table(bgp, AFI_IP6, SAFI_UNICAST);
+    return CMD_SUCCESS;
+}
+
+/* BFD echo as a fallback latency source */
+DEFUN(bgp_import_check_latency_bfd_echo,
+      bgp_import_check_latency_bfd_echo_cmd,
+      "bgp import check-latency bfd-echo",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Use the BFD echo round trip time of nexthops TWAMP does not measure\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    if (bgp->import_latency_cfg.bfd_echo)
+        return CMD_SUCCESS;
+    bgp->import_latency_cfg.bfd_echo = true;
+    bgp_twamp_source_changed();
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_bfd_echo,
+      no_bgp_import_check_latency_bfd_echo_cmd,
+      "no bgp import check-latency bfd-echo",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Use the BFD echo round trip time of nexthops TWAMP does not measure\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    
+    if (!bgp->import_latency_cfg.bfd_echo)
+        return CMD_SUCCESS;
+    bgp->import_latency_cfg.bfd_echo = false;
+    bgp_twamp_source_changed();
+    return CMD_SUCCESS;
+}
+
+/*
+ * Latency source: active probing, IGP TE delay without any probes, or
+ * IGP TE delay checked by sparse probes
+ */
+static int bgp_import_check_latency_source_set(struct bgp *bgp,
+                                               enum bgp_latency_source source)
+{
+    if (bgp->import_latency_cfg.source == source)
+        return CMD_SUCCESS;
+    bgp->import_latency_cfg.source = source;
+    bgp_twamp_ted_update();
+    /* Nexthops only this instance relied on may not need probing now */
+    bgp_twamp_import_changed();
+    return CMD_SUCCESS;
+}
+
+DEFUN(bgp_import_check_latency_source,
+      bgp_import_check_latency_source_cmd,
+      "bgp import check-latency source <twamp|igp-te|hybrid>",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Where nexthop latency comes from\n"
+      "Active TWAMP probing by the measurement agent (default)\n"
+      "IGP TE link delay summed over the IGP shortest path, no probing\n"
+      "IGP TE link delay, probing sparsely while measurements agree with it\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    enum bgp_latency_source source = BGP_LATENCY_SOURCE_TWAMP;
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    if (strmatch(argv[4]->text, "igp-te"))
+        source = BGP_LATENCY_SOURCE_IGP_TE;
+    else if (strmatch(argv[4]->text, "hybrid"))
+        source = BGP_LATENCY_SOURCE_HYBRID;
+    return bgp_import_check_latency_source_set(bgp, source);
+}
+
+DEFUN(no_bgp_import_check_latency_source,
+      no_bgp_import_check_latency_source_cmd,
+      "no bgp import check-latency source [<twamp|igp-te|hybrid>]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Where nexthop latency comes from\n"
+      "Active TWAMP probing by the measurement agent (default)\n"
+      "IGP TE link delay summed over the IGP shortest path, no probing\n"
+      "IGP TE link delay, probing sparsely while measurements agree with it\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    
+    return bgp_import_check_latency_source_set(bgp, BGP_LATENCY_SOURCE_TWAMP);
+}
+
+/* Hybrid source: how close a measurement must stay to the IGP estimate */
+DEFUN(bgp_import_check_latency_hybrid_tolerance,
+      bgp_import_check_latency_hybrid_tolerance_cmd,
+      "bgp import check-latency hybrid-tolerance (0-1000000) [<milliseconds|microseconds>]",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Largest gap between IGP estimate and measurement that still agrees (default: 5ms)\n"
+      "Tolerance\n"
+      "Tolerance in milliseconds (default)\n"
+      "Tolerance in microseconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    uint32_t us;
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    if (!bgp_import_latency_threshold_arg(vty, argc, argv, &us))
+        return CMD_WARNING_CONFIG_FAILED;
+    if (bgp->import_latency_cfg.hybrid_tolerance_us == us)
+        return CMD_SUCCESS;
+    bgp->import_latency_cfg.hybrid_tolerance_us = us;
+    bgp_twamp_source_changed();
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_hybrid_tolerance,
+      no_bgp_import_check_latency_hybrid_tolerance_cmd,
+      "no bgp import check-latency hybrid-tolerance [(0-1000000) [<milliseconds|microseconds>]]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Hybrid tolerance\n"
+      "Tolerance\n"
+      "Tolerance in milliseconds\n"
+      "Tolerance in microseconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    
+    if (bgp->import_latency_cfg.hybrid_tolerance_us == 5000)
+        return CMD_SUCCESS;
+    bgp->import_latency_cfg.hybrid_tolerance_us = 5000;
+    bgp_twamp_source_changed();
+    return CMD_SUCCESS;
+}
+
+/* Hybrid source: probe cycle of nexthops whose estimate agrees */
+DEFUN(bgp_import_check_latency_hybrid_probe_cycle,
+      bgp_import_check_latency_hybrid_probe_cycle_cmd,
+      "bgp import check-latency hybrid-probe-cycle (60-3600)",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Probe cycle while the IGP estimate agrees with the measurement (default: 600s)\n"
+      "Cycle in seconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    bgp->import_latency_cfg.hybrid_probe_cycle_sec = atoi(argv[4]->arg);
+    bgp_twamp_import_changed();
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_hybrid_probe_cycle,
+      no_bgp_import_check_latency_hybrid_probe_cycle_cmd,
+      "no bgp import check-latency hybrid-probe-cycle [(60-3600)]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Hybrid probe cycle\n"
+      "Cycle in seconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    bgp->import_latency_cfg.hybrid_probe_cycle_sec = 600;
+    bgp_twamp_import_changed();
+    return CMD_SUCCESS;
+}
+
+/*
+ * Traffic class to measure: the probes carry this DSCP, so that they take
+ * the queues, and with class-based forwarding the paths, of that class
+ */
+DEFUN(bgp_import_check_latency_dscp,
+      bgp_import_check_latency_dscp_cmd,
+      "bgp import check-latency dscp (0-63)",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "DSCP to probe with (default: 0)\n"
+      "DSCP value\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    bgp->import_latency_cfg.dscp = atoi(argv[4]->arg);
+    bgp_twamp_import_changed();
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_dscp,
+      no_bgp_import_check_latency_dscp_cmd,
+      "no bgp import check-latency dscp [(0-63)]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "DSCP to probe with\n"
+      "DSCP value\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    bgp->import_latency_cfg.dscp = 0;
+    bgp_twamp_import_changed();
+    return CMD_SUCCESS;
+}
+
+/*
+ * Traffic to a nexthop only takes the forward direction: where the agent
+ * has measured it one way, rank by that rather than the round trip
+ */
+DEFUN(bgp_import_check_latency_one_way,
+      bgp_import_check_latency_one_way_cmd,
+      "bgp import check-latency one-way",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Use the forward delay of nexthops measured one way\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    bgp->import_latency_cfg.one_way = true;
+    bgp_twamp_source_changed();
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_one_way,
+      no_bgp_import_check_latency_one_way_cmd,
+      "no bgp import check-latency one-way",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Use the forward delay of nexthops measured one way\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    bgp->import_latency_cfg.one_way = false;
+    bgp_twamp_source_changed();
+    return CMD_SUCCESS;
+}
+
+/*
+ * Hand measured latency on in the latency extended community, so routers
+ * behind a route reflector or ASBR can select by it without probing
+ */
+DEFUN(bgp_import_check_latency_advertise,
+      bgp_import_check_latency_advertise_cmd,
+      "bgp import check-latency advertise [interval (1-3600)]",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Advertise measured latency in an extended community\n"
+      "Least time between two changes of a nexthop's advertised latency (default: 30 seconds)\n"
+      "Interval in seconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    int idx = 0;
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    bgp->import_latency_cfg.advertise_interval_sec =
+        argv_find(argv, argc, "(1-3600)", &idx) ? atoi(argv[idx]->arg) : 30;
+    if (bgp->import_latency_cfg.advertise)
+        return CMD_SUCCESS;
+    bgp->import_latency_cfg.advertise = true;
+    update_group_announce(bgp);
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_advertise,
+      no_bgp_import_check_latency_advertise_cmd,
+      "no bgp import check-latency advertise [interval (1-3600)]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Advertise measured latency in an extended community\n"
+      "Least time between two changes of a nexthop's advertised latency\n"
+      "Interval in seconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    
+    bgp->import_latency_cfg.advertise_interval_sec = 30;
+    if (!bgp->import_latency_cfg.advertise)
+        return CMD_SUCCESS;
+    bgp->import_latency_cfg.advertise = false;
+    update_group_announce(bgp);
+    return CMD_SUCCESS;
+}
+
+/* Merge latency changes arriving within a window into one best-path run */
+DEFUN(bgp_import_check_latency_coalesce,
+      bgp_import_check_latency_coalesce_cmd,
+      "bgp import check-latency coalesce (1-60000)",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Merge latency changes before re-running best-path (default: off)\n"
+      "Window in milliseconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    bgp->import_latency_cfg.coalesce_msec = strtoul(argv[4]->arg, NULL, 10);
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_coalesce,
+      no_bgp_import_check_latency_coalesce_cmd,
+      "no bgp import check-latency coalesce [(1-60000)]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Merge latency changes before re-running best-path\n"
+      "Window in milliseconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    bgp->import_latency_cfg.coalesce_msec = 0;
+    return CMD_SUCCESS;
+}
+
+/* Latency classes, kept by increasing upto_us; one per colour */
+DEFUN(bgp_import_check_latency_color_class,
+      bgp_import_check_latency_color_class_cmd,
+      "bgp import check-latency color-class (1-4294967295) upto (0-1000000) [<milliseconds|microseconds>]",
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Steer nexthops within a latency into the SR policies of a colour\n"
+      "SR policy colour\n"
+      "Highest latency of the class\n"
+      "Latency\n"
+      "Latency in milliseconds (default)\n"
+      "Latency in microseconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    struct bgp_import_latency_config *cfg = &bgp->import_latency_cfg;
+    struct bgp_latency_color_class class;
+    unsigned int i;
+    
+    if (vty->node != BGP_IPV4_NODE) {
+        vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    
+    class.color = strtoul(argv[4]->arg, NULL, 10);
+    if (!bgp_import_latency_threshold_arg(vty, argc, argv, &class.upto_us))
+        return CMD_WARNING_CONFIG_FAILED;
+
+    for (i = 0; i < cfg->color_class_count; i++)
+        if (cfg->color_classes[i].color == class.color)
+            break;
+    if (i == cfg->color_class_count) {
+        if (i == BGP_LATENCY_COLOR_CLASSES) {
+            vty_out(vty, "%% At most %u latency classes\n",
+                    BGP_LATENCY_COLOR_CLASSES);
+            return CMD_WARNING_CONFIG_FAILED;
+        }
+        cfg->color_class_count++;
+    } else if (cfg->color_classes[i].upto_us == class.upto_us) {
+        return CMD_SUCCESS;
+    }
+
+    /* Close the gap the class leaves and sort it back in */
+    for (; i + 1 < cfg->color_class_count; i++)
+        cfg->color_classes[i] = cfg->color_classes[i + 1];
+    for (; i > 0 && cfg->color_classes[i - 1].upto_us > class.upto_us; i--)
+        cfg->color_classes[i] = cfg->color_classes[i - 1];
+    cfg->color_classes[i] = class;
+
+    bgp_twamp_color_refresh(bgp);
+    return CMD_SUCCESS;
+}
+
+DEFUN(no_bgp_import_check_latency_color_class,
+      no_bgp_import_check_latency_color_class_cmd,
+      "no bgp import check-latency color-class (1-4294967295) [upto (0-1000000) [<milliseconds|microseconds>]]",
+      NO_STR
+      BGP_STR
+      "Import configuration\n"
+      "Latency-based path selection\n"
+      "Steer nexthops within a latency into the SR policies of a colour\n"
+      "SR policy colour\n"
+      "Highest latency of the class\n"
+      "Latency\n"
+      "Latency in milliseconds\n"
+      "Latency in microseconds\n")
+{
+    VTY_DECLVAR_CONTEXT(bgp, bgp);
+    struct bgp_import_latency_config *cfg = &bgp->import_latency_cfg;
+    uint32_t color = strtoul(argv[5]->arg, NULL, 10);
+    unsigned int i;
 
-	bgp->v_maxmed_onstartup = BGP_MAXMED_ONSTARTUP_UNCONFIGURED;
-	bgp->maxmed_onstartup_value = BGP_MAXMED_VALUE_DEFAULT;
+    for (i = 0; i < cfg->color_class_count; i++)
+        if (cfg->color_classes[i].color == color)
+            break;
+    if (i == cfg->color_class_count)
+        return CMD_SUCCESS;
 
-	bgp_maxmed_update(bgp);
+    cfg->color_class_count--;
+    for (; i < cfg->color_class_count; i++)
+        cfg->color_classes[i] = cfg->color_classes[i + 1];
 
-	return CMD_SUCCESS;
+    bgp_twamp_color_refresh(bgp);
+    return CMD_SUCCESS;
 }
 
-//FOR BGP TWAMP-LIGHT PROJECT
-//Cli
-/* Main enable/disable */
-DEFUN(bgp_import_check_latency,
-      bgp_import_check_latency_cmd,
-      "bgp import check-latency",
+/*
+ * Leave latency to the SR policies: no latency step in best-path, a
+ * change moves the nexthop to the policy of its class instead
+ */
+DEFUN(bgp_import_check_latency_color_steering,
+      bgp_import_check_latency_color_steering_cmd,
+      "bgp import check-latency color-steering",
       BGP_STR
       "Import configuration\n"
-      "Enable latency-based path selection for imported routes\n")
+      "Latency-based path selection\n"
+      "Steer routes into SR policies by the latency class of their nexthop\n")
 {
     VTY_DECLVAR_CONTEXT(bgp, bgp);
     
-    /* Only allow in IPv4 unicast */
     if (vty->node != BGP_IPV4_NODE) {
         vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
         return CMD_WARNING_CONFIG_FAILED;
     }
     
-    bgp->import_latency_cfg.enabled = true;
-	bgp_twamp_init(bgp);
+    if (bgp->import_latency_cfg.color_steering)
+        return CMD_SUCCESS;
+    bgp->import_latency_cfg.color_steering = true;
+    bgp_twamp_color_refresh(bgp);
+    bgp_recalculate_all_bestpaths(bgp);
     return CMD_SUCCESS;
 }
 
-DEFUN(no_bgp_import_check_latency,
-      no_bgp_import_check_latency_cmd,
-      "no bgp import check-latency",
+DEFUN(no_bgp_import_check_latency_color_steering,
+      no_bgp_import_check_latency_color_steering_cmd,
+      "no bgp import check-latency color-steering",
       NO_STR
       BGP_STR
       "Import configuration\n"
-      "Disable latency-based path selection\n")
+      "Latency-based path selection\n"
+      "Steer routes into SR policies by the latency class of their nexthop\n")
 {
     VTY_DECLVAR_CONTEXT(bgp, bgp);
     
-    bgp->import_latency_cfg.enabled = false;
-	bgp_twamp_cleanup();
-    
-    /* Reset to defaults */
-    bgp->import_latency_cfg.probe_cycle_sec = 60;
-    bgp->import_latency_cfg.packet_count = 3;
-    bgp->import_latency_cfg.damping_threshold = 50;
-    
+    if (!bgp->import_latency_cfg.color_steering)
+        return CMD_SUCCESS;
+    bgp->import_latency_cfg.color_steering = false;
+    bgp_twamp_color_refresh(bgp);
+    bgp_recalculate_all_bestpaths(bgp);
     return CMD_SUCCESS;
 }
 
-/* Probe cycle */
-DEFUN(bgp_import_check_latency_probe_cycle,
-      bgp_import_check_latency_probe_cycle_cmd,
-      "bgp import check-latency probe-cycle (10-300)",
+/*
+ * Internet egress: eBGP paths via these nexthops are ranked by the
+ * latency the agent measures through each, out of the exit by its fwmark
+ */
+DEFUN(bgp_import_check_latency_egress_exit,
+      bgp_import_check_latency_egress_exit_cmd,
+      "bgp import check-latency egress exit A.B.C.D mark (1-4294967295)",
       BGP_STR
       "Import configuration\n"
       "Latency-based path selection\n"
-      "Probe cycle interval (default: 60 seconds)\n"
-      "Interval in seconds\n")
+      "Rank eBGP paths by the latency towards their destination\n"
+      "An internet exit\n"
+      "Nexthop of the eBGP paths through the exit\n"
+      "Firewall mark policy routing sends traffic out of the exit with\n"
+      "Mark\n")
 {
     VTY_DECLVAR_CONTEXT(bgp, bgp);
-    int idx = 0;
-    
+    struct bgp_import_latency_config *cfg = &bgp->import_latency_cfg;
+    struct bgp_latency_egress_exit egress;
+    unsigned int i;
+
     if (vty->node != BGP_IPV4_NODE) {
         vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
         return CMD_WARNING_CONFIG_FAILED;
     }
-    
-    argv_find(argv, argc, "(10-300)", &idx);
-    bgp->import_latency_cfg.probe_cycle_sec = strtol(argv[idx]->arg, NULL, 10);
-    
+
+    if (!inet_aton(argv[5]->arg, &egress.nexthop)) {
+        vty_out(vty, "%% Malformed exit address\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+    egress.mark = strtoul(argv[7]->arg, NULL, 10);
+
+    for (i = 0; i < cfg->egress_exit_count; i++)
+        if (cfg->egress_exits[i].nexthop.s_addr == egress.nexthop.s_addr)
+            break;
+    if (i == cfg->egress_exit_count) {
+        if (i == BGP_LATENCY_EGRESS_EXITS) {
+            vty_out(vty, "%% At most %u internet exits\n",
+                    BGP_LATENCY_EGRESS_EXITS);
+            return CMD_WARNING_CONFIG_FAILED;
+        }
+        cfg->egress_exit_count++;
+    } else if (cfg->egress_exits[i].mark == egress.mark) {
+        return CMD_SUCCESS;
+    }
+    cfg->egress_exits[i] = egress;
+
+    bgp_twamp_egress_config_changed(bgp);
     return CMD_SUCCESS;
 }
 
-DEFUN(no_bgp_import_check_latency_probe_cycle,
-      no_bgp_import_check_latency_probe_cycle_cmd,
-      "no bgp import check-latency probe-cycle [(10-300)]",
+DEFUN(no_bgp_import_check_latency_egress_exit,
+      no_bgp_import_check_latency_egress_exit_cmd,
+      "no bgp import check-latency egress exit A.B.C.D [mark (1-4294967295)]",
       NO_STR
       BGP_STR
       "Import configuration\n"
       "Latency-based path selection\n"
-      "Probe cycle interval\n"
-      "Interval in seconds\n")
+      "Rank eBGP paths by the latency towards their destination\n"
+      "An internet exit\n"
+      "Nexthop of the eBGP paths through the exit\n"
+      "Firewall mark policy routing sends traffic out of the exit with\n"
+      "Mark\n")
 {
     VTY_DECLVAR_CONTEXT(bgp, bgp);
-    bgp->import_latency_cfg.probe_cycle_sec = 60;
+    struct bgp_import_latency_config *cfg = &bgp->import_latency_cfg;
+    struct in_addr nexthop;
+    unsigned int i;
+
+    if (!inet_aton(argv[6]->arg, &nexthop)) {
+        vty_out(vty, "%% Malformed exit address\n");
+        return CMD_WARNING_CONFIG_FAILED;
+    }
+
+    for (i = 0; i < cfg->egress_exit_count; i++)
+        if (cfg->egress_exits[i].nexthop.s_addr == nexthop.s_addr)
+            break;
+    if (i == cfg->egress_exit_count)
+        return CMD_SUCCESS;
+
+    cfg->egress_exit_count--;
+    for (; i < cfg->egress_exit_count; i++)
+        cfg->egress_exits[i] = cfg->egress_exits[i + 1];
+
+    bgp_twamp_egress_config_changed(bgp);
     return CMD_SUCCESS;
 }
 
-/* Packet count */
-DEFUN(bgp_import_check_latency_packet_count,
-      bgp_import_check_latency_packet_count_cmd,
-      "bgp import check-latency packet-count (1-10)",
+/* The prefixes worth measuring, the top destinations by traffic */
+DEFUN(bgp_import_check_latency_egress_prefix_list,
+      bgp_import_check_latency_egress_prefix_list_cmd,
+      "bgp import check-latency egress prefix-list WORD",
       BGP_STR
       "Import configuration\n"
       "Latency-based path selection\n"
-      "Number of probe packets per cycle (default: 3)\n"
-      "Packet count\n")
+      "Rank eBGP paths by the latency towards their destination\n"
+      "Measure the prefixes a prefix-list permits\n"
+      "Name of the prefix-list\n")
 {
     VTY_DECLVAR_CONTEXT(bgp, bgp);
-    int idx = 0;
-    
+    struct bgp_import_latency_config *cfg = &bgp->import_latency_cfg;
+
     if (vty->node != BGP_IPV4_NODE) {
         vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
         return CMD_WARNING_CONFIG_FAILED;
     }
-    
-    argv_find(argv, argc, "(1-10)", &idx);
-    bgp->import_latency_cfg.packet_count = strtol(argv[idx]->arg, NULL, 10);
-    
+
+    if (cfg->egress_plist && strmatch(cfg->egress_plist, argv[5]->arg))
+        return CMD_SUCCESS;
+    XFREE(MTYPE_BGP_FILTER_NAME, cfg->egress_plist);
+    cfg->egress_plist = XSTRDUP(MTYPE_BGP_FILTER_NAME, argv[5]->arg);
+
+    bgp_twamp_egress_config_changed(bgp);
     return CMD_SUCCESS;
 }
 
-DEFUN(no_bgp_import_check_latency_packet_count,
-      no_bgp_import_check_latency_packet_count_cmd,
-      "no bgp import check-latency packet-count [(1-10)]",
+DEFUN(no_bgp_import_check_latency_egress_prefix_list,
+      no_bgp_import_check_latency_egress_prefix_list_cmd,
+      "no bgp import check-latency egress prefix-list [WORD]",
       NO_STR
       BGP_STR
       "Import configuration\n"
       "Latency-based path selection\n"
-      "Packet count\n"
-      "Packet count\n")
+      "Rank eBGP paths by the latency towards their destination\n"
+      "Measure the prefixes a prefix-list permits\n"
+      "Name of the prefix-list\n")
 {
     VTY_DECLVAR_CONTEXT(bgp, bgp);
-    bgp->import_latency_cfg.packet_count = 3;
+
+    if (!bgp->import_latency_cfg.egress_plist)
+        return CMD_SUCCESS;
+    XFREE(MTYPE_BGP_FILTER_NAME, bgp->import_latency_cfg.egress_plist);
+
+    bgp_twamp_egress_config_changed(bgp);
     return CMD_SUCCESS;
 }
 
-/* Damping threshold */
-DEFUN(bgp_import_check_latency_damping_threshold,
-      bgp_import_check_latency_damping_threshold_cmd,
-      "bgp import check-latency damping-threshold (0-1000)",
+DEFUN(bgp_import_check_latency_egress_max_prefixes,
+      bgp_import_check_latency_egress_max_prefixes_cmd,
+      "bgp import check-latency egress max-prefixes (1-1000000)",
       BGP_STR
       "Import configuration\n"
       "Latency-based path selection\n"
-      "Minimum latency change in milliseconds (default: 50ms)\n"
-      "Threshold in milliseconds\n")
+      "Rank eBGP paths by the latency towards their destination\n"
+      "Most prefixes measured, first in the table first\n"
+      "Prefixes\n")
 {
     VTY_DECLVAR_CONTEXT(bgp, bgp);
-    int idx = 0;
-    
+
     if (vty->node != BGP_IPV4_NODE) {
         vty_out(vty, "%% This command is only valid in IPv4 unicast address-family\n");
         return CMD_WARNING_CONFIG_FAILED;
     }
-    
-    argv_find(argv, argc, "(0-1000)", &idx);
-    bgp->import_latency_cfg.damping_threshold = strtoul(argv[idx]->arg, NULL, 10);
-    
+
+    bgp->import_latency_cfg.egress_max_prefixes =
+        strtoul(argv[5]->arg, NULL, 10);
+    bgp_twamp_egress_config_changed(bgp);
     return CMD_SUCCESS;
 }
 
-DEFUN(no_bgp_import_check_latency_damping_threshold,
-      no_bgp_import_check_latency_damping_threshold_cmd,
-      "no bgp import check-latency damping-threshold [(0-1000)]",
+DEFUN(no_bgp_import_check_latency_egress_max_prefixes,
+      no_bgp_import_check_latency_egress_max_prefixes_cmd,
+      "no bgp import check-latency egress max-prefixes [(1-1000000)]",
       NO_STR
       BGP_STR
       "Import configuration\n"
       "Latency-based path selection\n"
-      "Damping threshold\n"
-      "Threshold in milliseconds\n")
+      "Rank eBGP paths by the latency towards their destination\n"
+      "Most prefixes measured, first in the table first\n"
+      "Prefixes\n")
 {
     VTY_DECLVAR_CONTEXT(bgp, bgp);
-    bgp->import_latency_cfg.damping_threshold = 50;
+
+    bgp->import_latency_cfg.egress_max_prefixes =
+        BGP_LATENCY_EGRESS_MAX_PREFIXES_DEFAULT;
+    bgp_twamp_egress_config_changed(bgp);
     return CMD_SUCCESS;
 }
 
@@ -8234,8 +9419,8 @@ DEFPY (bgp_condadv_period,
        NO_STR
        BGP_STR
        "Conditional advertisement settings\n"
-       "Set period to rescan BGP table to check if condition is met\n"
-       "Period between BGP table scans, in seconds; default 60\n")
+       "Set shortest period between two checks of the condition\n"
+       "Period between condition checks, in seconds; default 60\n")
 {
 	VTY_DECLVAR_CONTEXT(bgp, bgp);
 
@@ -9174,6 +10359,83 @@ DEFPY (no_neighbor_addpath_tx_best_selected_paths,
 	return CMD_SUCCESS;
 }
 
+DEFPY (neighbor_addpath_tx_lowest_latency_paths,
+       neighbor_addpath_tx_lowest_latency_paths_cmd,
+       "neighbor <A.B.C.D|X:X::X:X|WORD>$neighbor addpath-tx-lowest-latency (1-6)$paths",
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Use addpath to advertise the lowest latency paths to a neighbor\n"
+       "The number of paths besides the bestpath\n")
+{
+	struct peer *peer;
+
+	peer = peer_and_group_lookup_vty(vty, neighbor);
+	if (!peer)
+		return CMD_WARNING_CONFIG_FAILED;
+
+	bgp_addpath_set_peer_type(peer, bgp_node_afi(vty), bgp_node_safi(vty),
+				  BGP_ADDPATH_LOWEST_LATENCY, paths);
+	return CMD_SUCCESS;
+}
+
+DEFPY (no_neighbor_addpath_tx_lowest_latency_paths,
+       no_neighbor_addpath_tx_lowest_latency_paths_cmd,
+       "no neighbor <A.B.C.D|X:X::X:X|WORD>$neighbor addpath-tx-lowest-latency [(1-6)]",
+       NO_STR
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Use addpath to advertise the lowest latency paths to a neighbor\n"
+       "The number of paths besides the bestpath\n")
+{
+	struct peer *peer;
+
+	peer = peer_and_group_lookup_vty(vty, neighbor);
+	if (!peer)
+		return CMD_WARNING_CONFIG_FAILED;
+
+	if (peer->addpath_type[bgp_node_afi(vty)][bgp_node_safi(vty)] !=
+	    BGP_ADDPATH_LOWEST_LATENCY) {
+		vty_out(vty,
+			"%% Peer not currently configured to transmit lowest latency paths.");
+		return CMD_WARNING_CONFIG_FAILED;
+	}
+
+	bgp_addpath_set_peer_type(peer, bgp_node_afi(vty), bgp_node_safi(vty),
+				  BGP_ADDPATH_NONE, 0);
+	return CMD_SUCCESS;
+}
+
+DEFPY (neighbor_orr_root,
+       neighbor_orr_root_cmd,
+       "[no] neighbor <A.B.C.D|X:X::X:X|WORD>$neighbor optimal-route-reflection root A.B.C.D$root",
+       NO_STR
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Pick the paths reflected to a client as seen from elsewhere\n"
+       "Router the latency to the egress PEs is taken from\n"
+       "Its address in the IGP link-state database\n")
+{
+	struct peer *peer;
+
+	peer = peer_and_group_lookup_vty(vty, neighbor);
+	if (!peer)
+		return CMD_WARNING_CONFIG_FAILED;
+
+	if (no) {
+		if (!IPV4_ADDR_SAME(
+			    &peer->orr_root[bgp_node_afi(vty)][bgp_node_safi(vty)],
+			    &root)) {
+			vty_out(vty,
+				"%% Peer not currently configured with this root\n");
+			return CMD_WARNING_CONFIG_FAILED;
+		}
+		root.s_addr = INADDR_ANY;
+	}
+
+	peer_orr_root_set(peer, bgp_node_afi(vty), bgp_node_safi(vty), root);
+	return CMD_SUCCESS;
+}
+
 DEFUN (neighbor_addpath_tx_bestpath_per_as,
        neighbor_addpath_tx_bestpath_per_as_cmd,
        "neighbor <A.B.C.D|X:X::X:X|WORD> addpath-tx-bestpath-per-AS",
@@ -9996,6 +11258,7 @@ DEFPY (af_rt_vpn_imexport,
 						&bgp->vpn_policy[afi].rtlist[dir]);
 			bgp->vpn_policy[afi].rtlist[dir] = NULL;
 		}
+		vpn_leak_import_index_invalidate();
 
 		vpn_leak_postchange(dir, afi, bgp_get_default(), bgp);
 	}
@@ -11204,16 +12467,16 @@ DEFUN (show_bgp_memory,
 	unsigned long count;
 
 	/* RIB related usage stats */
-	count = mtype_stats_alloc(MTYPE_BGP_NODE);
+	count = bgp_dest_arena.count;
 	vty_out(vty, "%ld RIB nodes, using %s of memory\n", count,
 		mtype_memstr(memstrbuf, sizeof(memstrbuf),
 			     count * sizeof(struct bgp_dest)));
 
-	count = mtype_stats_alloc(MTYPE_BGP_ROUTE);
+	count = bgp_path_info_arena.count;
 	vty_out(vty, "%ld BGP routes, using %s of memory\n", count,
 		mtype_memstr(memstrbuf, sizeof(memstrbuf),
 			     count * sizeof(struct bgp_path_info)));
-	if ((count = mtype_stats_alloc(MTYPE_BGP_ROUTE_EXTRA)))
+	if ((count = bgp_path_info_extra_arena.count))
 		vty_out(vty, "%ld BGP route ancillaries, using %s of memory\n",
 			count,
 			mtype_memstr(
@@ -11258,10 +12521,19 @@ DEFUN (show_bgp_memory,
 		vty_out(vty, "%ld Adj-In entries, using %s of memory\n", count,
 			mtype_memstr(memstrbuf, sizeof(memstrbuf),
 				     count * sizeof(struct bgp_adj_in)));
+	if ((count = mtype_stats_alloc(MTYPE_BGP_ADJ_IN_DELTA)))
+		vty_out(vty, "%ld Adj-In deltas, using %s of memory\n", count,
+			mtype_memstr(memstrbuf, sizeof(memstrbuf),
+				     count * sizeof(struct bgp_adj_in_delta)));
 	if ((count = mtype_stats_alloc(MTYPE_BGP_ADJ_OUT)))
 		vty_out(vty, "%ld Adj-Out entries, using %s of memory\n", count,
 			mtype_memstr(memstrbuf, sizeof(memstrbuf),
 				     count * sizeof(struct bgp_adj_out)));
+	if ((count = mtype_stats_alloc(MTYPE_BGP_ADJ_OUT_SET)))
+		vty_out(vty, "%ld Adj-Out sets, using %s of memory\n", count,
+			mtype_memstr(memstrbuf, sizeof(memstrbuf),
+				     count * (sizeof(struct bgp_adj_out_set) +
+					      sizeof(uint64_t))));
 
 	if ((count = mtype_stats_alloc(MTYPE_BGP_NEXTHOP_CACHE)))
 		vty_out(vty, "%ld Nexthop cache entries, using %s of memory\n",
@@ -14980,7 +16252,10 @@ static void bgp_show_peer(struct vty *vty, struct peer *p, bool use_json,
 		outq_count = atomic_load_explicit(&p->connection->obuf->count,
 						  memory_order_relaxed);
 		inq_count = atomic_load_explicit(&p->connection->ibuf->count,
-						 memory_order_relaxed);
+						 memory_order_relaxed) +
+			    atomic_load_explicit(
+				    &p->connection->ibuf_parse->count,
+				    memory_order_relaxed);
 
 		json_object_int_add(json_stat, "depthInq",
 				    (unsigned long)inq_count);
@@ -15033,7 +16308,10 @@ static void bgp_show_peer(struct vty *vty, struct peer *p, bool use_json,
 		outq_count = atomic_load_explicit(&p->connection->obuf->count,
 						  memory_order_relaxed);
 		inq_count = atomic_load_explicit(&p->connection->ibuf->count,
-						 memory_order_relaxed);
+						 memory_order_relaxed) +
+			    atomic_load_explicit(
+				    &p->connection->ibuf_parse->count,
+				    memory_order_relaxed);
 		open_out = atomic_load_explicit(&p->open_out,
 						memory_order_relaxed);
 		open_in =
@@ -17580,6 +18858,55 @@ DEFPY(bgp_retain_route_target, bgp_retain_route_target_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFPY(bgp_af_adj_out_compact, bgp_af_adj_out_compact_cmd,
+      "[no$no] bgp adj-out compact",
+      NO_STR BGP_STR
+      "Adj-RIB-Out\n"
+      "Share adj-out state between update subgroups advertising the same attributes\n")
+{
+	struct bgp *bgp = VTY_GET_CONTEXT(bgp);
+	afi_t afi = bgp_node_afi(vty);
+	safi_t safi = bgp_node_safi(vty);
+	bool check;
+
+	check = CHECK_FLAG(bgp->af_flags[afi][safi],
+			   BGP_CONFIG_ADJ_OUT_COMPACT);
+	if (check == !no)
+		return CMD_SUCCESS;
+
+	if (!no)
+		SET_FLAG(bgp->af_flags[afi][safi], BGP_CONFIG_ADJ_OUT_COMPACT);
+	else
+		UNSET_FLAG(bgp->af_flags[afi][safi], BGP_CONFIG_ADJ_OUT_COMPACT);
+
+	bgp_adj_out_compact_table(bgp, afi, safi, !no);
+	return CMD_SUCCESS;
+}
+
+DEFPY(bgp_af_adj_in_compact, bgp_af_adj_in_compact_cmd,
+      "[no$no] bgp adj-in compact",
+      NO_STR BGP_STR
+      "Adj-RIB-In of soft-reconfiguration inbound\n"
+      "Keep received attributes as what the inbound policy changed\n")
+{
+	struct bgp *bgp = VTY_GET_CONTEXT(bgp);
+	afi_t afi = bgp_node_afi(vty);
+	safi_t safi = bgp_node_safi(vty);
+	bool check;
+
+	check = CHECK_FLAG(bgp->af_flags[afi][safi], BGP_CONFIG_ADJ_IN_COMPACT);
+	if (check == !no)
+		return CMD_SUCCESS;
+
+	if (!no)
+		SET_FLAG(bgp->af_flags[afi][safi], BGP_CONFIG_ADJ_IN_COMPACT);
+	else
+		UNSET_FLAG(bgp->af_flags[afi][safi], BGP_CONFIG_ADJ_IN_COMPACT);
+
+	bgp_adj_in_compact_table(bgp, afi, safi, !no);
+	return CMD_SUCCESS;
+}
+
 static void bgp_config_write_redistribute(struct vty *vty, struct bgp *bgp,
 					  afi_t afi, safi_t safi)
 {
@@ -18301,6 +19628,11 @@ static void bgp_config_write_peer_af(struct vty *vty, struct bgp *bgp,
 					addr,
 					peer->addpath_best_selected[afi][safi]);
 			break;
+		case BGP_ADDPATH_LOWEST_LATENCY:
+			vty_out(vty,
+				"  neighbor %s addpath-tx-lowest-latency %u\n",
+				addr, peer->addpath_best_selected[afi][safi]);
+			break;
 		case BGP_ADDPATH_MAX:
 		case BGP_ADDPATH_NONE:
 			break;
@@ -18310,6 +19642,14 @@ static void bgp_config_write_peer_af(struct vty *vty, struct bgp *bgp,
 	if (CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_DISABLE_ADDPATH_RX))
 		vty_out(vty, "  neighbor %s disable-addpath-rx\n", addr);
 
+	if (peer->orr_root[afi][safi].s_addr != INADDR_ANY &&
+	    (!peer_group_active(peer) ||
+	     !IPV4_ADDR_SAME(&peer->orr_root[afi][safi],
+			     &peer->group->conf->orr_root[afi][safi])))
+		vty_out(vty,
+			"  neighbor %s optimal-route-reflection root %pI4\n",
+			addr, &peer->orr_root[afi][safi]);
+
 	/* ORF capability.  */
 	if (peergroup_af_flag_check(peer, afi, safi, PEER_FLAG_ORF_PREFIX_SM)
 	    || peergroup_af_flag_check(peer, afi, safi,
@@ -18581,6 +19921,12 @@ static void bgp_config_write_family(struct vty *vty, struct bgp *bgp, afi_t afi,
 	if (CHECK_FLAG(bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING))
 		bgp_config_write_damp(vty, afi, safi);
 
+	if (CHECK_FLAG(bgp->af_flags[afi][safi], BGP_CONFIG_ADJ_OUT_COMPACT))
+		vty_out(vty, "  bgp adj-out compact\n");
+
+	if (CHECK_FLAG(bgp->af_flags[afi][safi], BGP_CONFIG_ADJ_IN_COMPACT))
+		vty_out(vty, "  bgp adj-in compact\n");
+
 	for (ALL_LIST_ELEMENTS(bgp->group, node, nnode, group))
 		bgp_config_write_peer_af(vty, bgp, group->conf, afi, safi);
 
@@ -18666,6 +20012,9 @@ int bgp_config_write(struct vty *vty)
 	if (CHECK_FLAG(bm->flags, BM_FLAG_SEND_EXTRA_DATA_TO_ZEBRA))
 		vty_out(vty, "bgp send-extra-data zebra\n");
 
+	if (CHECK_FLAG(bm->flags, BM_FLAG_INSTALL_NHG))
+		vty_out(vty, "bgp send-nexthop-groups zebra\n");
+
 	/* BGP session DSCP value */
 	if (bm->tcp_dscp != IPTOS_PREC_INTERNETCONTROL)
 		vty_out(vty, "bgp session-dscp %u\n", bm->tcp_dscp >> 2);
@@ -18680,6 +20029,12 @@ int bgp_config_write(struct vty *vty)
 	if (bm->outq_limit != BM_DEFAULT_Q_LIMIT)
 		vty_out(vty, "bgp output-queue-limit %u\n", bm->outq_limit);
 
+	if (bm->select_threads)
+		vty_out(vty, "bgp best-path workers %u\n", bm->select_threads);
+
+	if (bm->parse_threads)
+		vty_out(vty, "bgp update-parse workers %u\n", bm->parse_threads);
+
 	/* BGP configuration. */
 	for (ALL_LIST_ELEMENTS(bm->bgp, mnode, mnnode, bgp)) {
 
@@ -19500,6 +20855,64 @@ DEFPY (no_bgp_inq_limit,
 	return CMD_SUCCESS;
 }
 
+DEFPY (bgp_select_workers,
+       bgp_select_workers_cmd,
+       "bgp best-path workers (2-64)$threads",
+       BGP_STR
+       "Best-path selection\n"
+       "Run the selection of large batches on this many threads\n"
+       "Threads, the main one included\n")
+{
+	bm->select_threads = threads;
+	bgp_select_workers_set(threads);
+
+	return CMD_SUCCESS;
+}
+
+DEFPY (no_bgp_select_workers,
+       no_bgp_select_workers_cmd,
+       "no bgp best-path workers [(2-64)]",
+       NO_STR
+       BGP_STR
+       "Best-path selection\n"
+       "Run the selection of large batches on this many threads\n"
+       "Threads, the main one included\n")
+{
+	bm->select_threads = 0;
+	bgp_select_workers_set(0);
+
+	return CMD_SUCCESS;
+}
+
+DEFPY (bgp_parse_workers,
+       bgp_parse_workers_cmd,
+       "bgp update-parse workers (1-64)$threads",
+       BGP_STR
+       "Received UPDATE parsing\n"
+       "Decode path attributes on this many threads besides the main one\n"
+       "Threads\n")
+{
+	bm->parse_threads = threads;
+	bgp_preparse_workers_set(threads);
+
+	return CMD_SUCCESS;
+}
+
+DEFPY (no_bgp_parse_workers,
+       no_bgp_parse_workers_cmd,
+       "no bgp update-parse workers [(1-64)]",
+       NO_STR
+       BGP_STR
+       "Received UPDATE parsing\n"
+       "Decode path attributes on this many threads besides the main one\n"
+       "Threads\n")
+{
+	bm->parse_threads = 0;
+	bgp_preparse_workers_set(0);
+
+	return CMD_SUCCESS;
+}
+
 DEFPY (bgp_outq_limit,
        bgp_outq_limit_cmd,
        "bgp output-queue-limit (1-4294967295)$limit",
@@ -19582,6 +20995,10 @@ void bgp_vty_init(void)
 	install_element(CONFIG_NODE, &no_bgp_inq_limit_cmd);
 	install_element(CONFIG_NODE, &bgp_outq_limit_cmd);
 	install_element(CONFIG_NODE, &no_bgp_outq_limit_cmd);
+	install_element(CONFIG_NODE, &bgp_select_workers_cmd);
+	install_element(CONFIG_NODE, &no_bgp_select_workers_cmd);
+	install_element(CONFIG_NODE, &bgp_parse_workers_cmd);
+	install_element(CONFIG_NODE, &no_bgp_parse_workers_cmd);
 
 	/* "bgp local-mac" hidden commands. */
 	install_element(CONFIG_NODE, &bgp_local_mac_cmd);
@@ -19644,6 +21061,7 @@ void bgp_vty_init(void)
 	install_element(CONFIG_NODE, &no_bgp_norib_cmd);
 
 	install_element(CONFIG_NODE, &no_bgp_send_extra_data_cmd);
+	install_element(CONFIG_NODE, &bgp_send_nexthop_groups_cmd);
 
 	/* "bgp confederation" commands. */
 	install_element(BGP_NODE, &bgp_confederation_identifier_cmd);
@@ -20418,6 +21836,50 @@ void bgp_vty_init(void)
 	install_element(BGP_VPNV6_NODE,
 			&no_neighbor_addpath_tx_best_selected_paths_cmd);
 
+	/* "neighbor optimal-route-reflection root" commands.*/
+	install_element(BGP_IPV4_NODE, &neighbor_orr_root_cmd);
+	install_element(BGP_IPV4M_NODE, &neighbor_orr_root_cmd);
+	install_element(BGP_IPV4L_NODE, &neighbor_orr_root_cmd);
+	install_element(BGP_IPV6_NODE, &neighbor_orr_root_cmd);
+	install_element(BGP_IPV6M_NODE, &neighbor_orr_root_cmd);
+	install_element(BGP_IPV6L_NODE, &neighbor_orr_root_cmd);
+	install_element(BGP_VPNV4_NODE, &neighbor_orr_root_cmd);
+	install_element(BGP_VPNV6_NODE, &neighbor_orr_root_cmd);
+
+	/* "neighbor addpath-tx-lowest-latency" commands.*/
+	install_element(BGP_IPV4_NODE,
+			&neighbor_addpath_tx_lowest_latency_paths_cmd);
+	install_element(BGP_IPV4_NODE,
+			&no_neighbor_addpath_tx_lowest_latency_paths_cmd);
+	install_element(BGP_IPV4M_NODE,
+			&neighbor_addpath_tx_lowest_latency_paths_cmd);
+	install_element(BGP_IPV4M_NODE,
+			&no_neighbor_addpath_tx_lowest_latency_paths_cmd);
+	install_element(BGP_IPV4L_NODE,
+			&neighbor_addpath_tx_lowest_latency_paths_cmd);
+	install_element(BGP_IPV4L_NODE,
+			&no_neighbor_addpath_tx_lowest_latency_paths_cmd);
+	install_element(BGP_IPV6_NODE,
+			&neighbor_addpath_tx_lowest_latency_paths_cmd);
+	install_element(BGP_IPV6_NODE,
+			&no_neighbor_addpath_tx_lowest_latency_paths_cmd);
+	install_element(BGP_IPV6M_NODE,
+			&neighbor_addpath_tx_lowest_latency_paths_cmd);
+	install_element(BGP_IPV6M_NODE,
+			&no_neighbor_addpath_tx_lowest_latency_paths_cmd);
+	install_element(BGP_IPV6L_NODE,
+			&neighbor_addpath_tx_lowest_latency_paths_cmd);
+	install_element(BGP_IPV6L_NODE,
+			&no_neighbor_addpath_tx_lowest_latency_paths_cmd);
+	install_element(BGP_VPNV4_NODE,
+			&neighbor_addpath_tx_lowest_latency_paths_cmd);
+	install_element(BGP_VPNV4_NODE,
+			&no_neighbor_addpath_tx_lowest_latency_paths_cmd);
+	install_element(BGP_VPNV6_NODE,
+			&neighbor_addpath_tx_lowest_latency_paths_cmd);
+	install_element(BGP_VPNV6_NODE,
+			&no_neighbor_addpath_tx_lowest_latency_paths_cmd);
+
 	/* "neighbor addpath-tx-bestpath-per-AS" commands.*/
 	install_element(BGP_NODE,
 			&neighbor_addpath_tx_bestpath_per_as_hidden_cmd);
@@ -20929,6 +22391,20 @@ void bgp_vty_init(void)
 	install_element(BGP_VPNV4_NODE, &bgp_retain_route_target_cmd);
 	install_element(BGP_VPNV6_NODE, &bgp_retain_route_target_cmd);
 
+	install_element(BGP_IPV4_NODE, &bgp_af_adj_out_compact_cmd);
+	install_element(BGP_IPV4M_NODE, &bgp_af_adj_out_compact_cmd);
+	install_element(BGP_IPV4L_NODE, &bgp_af_adj_out_compact_cmd);
+	install_element(BGP_IPV6_NODE, &bgp_af_adj_out_compact_cmd);
+	install_element(BGP_IPV6M_NODE, &bgp_af_adj_out_compact_cmd);
+	install_element(BGP_IPV6L_NODE, &bgp_af_adj_out_compact_cmd);
+
+	install_element(BGP_IPV4_NODE, &bgp_af_adj_in_compact_cmd);
+	install_element(BGP_IPV4M_NODE, &bgp_af_adj_in_compact_cmd);
+	install_element(BGP_IPV4L_NODE, &bgp_af_adj_in_compact_cmd);
+	install_element(BGP_IPV6_NODE, &bgp_af_adj_in_compact_cmd);
+	install_element(BGP_IPV6M_NODE, &bgp_af_adj_in_compact_cmd);
+	install_element(BGP_IPV6L_NODE, &bgp_af_adj_in_compact_cmd);
+
 	/* "clear ip bgp commands" */
 	install_element(ENABLE_NODE, &clear_ip_bgp_all_cmd);
 
@@ -21095,8 +22571,57 @@ void bgp_vty_init(void)
 	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_probe_cycle_cmd);
 	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_packet_count_cmd);
 	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_packet_count_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_port_cmd);
+	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_port_cmd);
 	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_damping_threshold_cmd);
 	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_damping_threshold_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_switch_back_threshold_cmd);
+	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_switch_back_threshold_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_min_dwell_cmd);
+	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_min_dwell_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_hold_down_cmd);
+	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_hold_down_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_loss_threshold_cmd);
+	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_loss_threshold_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_weighted_ecmp_cmd);
+	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_weighted_ecmp_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_nexthop_group_cmd);
+	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_nexthop_group_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_bfd_echo_cmd);
+	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_bfd_echo_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_source_cmd);
+	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_source_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_hybrid_tolerance_cmd);
+	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_hybrid_tolerance_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_hybrid_probe_cycle_cmd);
+	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_hybrid_probe_cycle_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_dscp_cmd);
+	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_dscp_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_one_way_cmd);
+	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_one_way_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_advertise_cmd);
+	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_advertise_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_coalesce_cmd);
+	install_element(BGP_IPV4_NODE, &no_bgp_import_check_latency_coalesce_cmd);
+	install_element(BGP_IPV4_NODE, &bgp_import_check_latency_color_class_cmd);
+	install_element(BGP_IPV4_NODE,
+			&no_bgp_import_check_latency_color_class_cmd);
+	install_element(BGP_IPV4_NODE,
+			&bgp_import_check_latency_color_steering_cmd);
+	install_element(BGP_IPV4_NODE,
+			&no_bgp_import_check_latency_color_steering_cmd);
+	install_element(BGP_IPV4_NODE,
+			&bgp_import_check_latency_egress_exit_cmd);
+	install_element(BGP_IPV4_NODE,
+			&no_bgp_import_check_latency_egress_exit_cmd);
+	install_element(BGP_IPV4_NODE,
+			&bgp_import_check_latency_egress_prefix_list_cmd);
+	install_element(BGP_IPV4_NODE,
+			&no_bgp_import_check_latency_egress_prefix_list_cmd);
+	install_element(BGP_IPV4_NODE,
+			&bgp_import_check_latency_egress_max_prefixes_cmd);
+	install_element(BGP_IPV4_NODE,
+			&no_bgp_import_check_latency_egress_max_prefixes_cmd);
 	bgp_vty_if_init();
 }
 
@@ -53,12 +53,22 @@
 #include "bgpd/bgp_trace.h"
 #include "bgpd/bgp_community.h"
 #include "bgpd/bgp_lcommunity.h"
+#include "bgpd/bgp_twamp.h"
+#include "bgpd/bgp_twamp_ted.h"
+#include "bgpd/bgp_twamp_nhg.h"
+#include "bgpd/bgp_nhg.h"
 
 /* All information about zebra. */
 struct zclient *zclient = NULL;
 struct zclient *zclient_sync;
 static bool bgp_zebra_label_manager_connect(void);
 
+/* Ipset messages not sent yet, see bgp_pbr_batch_get() */
+static struct stream *pbr_batch;
+static uint16_t pbr_batch_cmd;
+static uint32_t pbr_batch_count;
+static struct event *t_pbr_batch;
+
 /* hook to indicate vrf status change for SNMP */
 DEFINE_HOOK(bgp_vrf_status_changed, (struct bgp *bgp, struct interface *ifp),
 	    (bgp, ifp));
@@ -312,6 +322,10 @@ static int bgp_interface_address_add(ZAPI_CALLBACK_ARGS)
 		zlog_debug("Rx Intf address add VRF %u IF %s addr %pFX", vrf_id,
 			   ifc->ifp->name, ifc->address);
 
+	/* May give a link zebra wants measured its far end */
+	if (vrf_id == VRF_DEFAULT && HAS_LINK_PARAMS(ifc->ifp))
+		bgp_twamp_links_changed();
+
 	if (!bgp)
 		return 0;
 
@@ -391,6 +405,9 @@ static int bgp_interface_address_delete(ZAPI_CALLBACK_ARGS)
 		zlog_debug("Rx Intf address del VRF %u IF %s addr %pFX", vrf_id,
 			   ifc->ifp->name, ifc->address);
 
+	if (vrf_id == VRF_DEFAULT && HAS_LINK_PARAMS(ifc->ifp))
+		bgp_twamp_links_changed();
+
 	if (bgp && if_is_operative(ifc->ifp)) {
 		bgp_connected_delete(bgp, ifc);
 	}
@@ -1232,6 +1249,15 @@ static bool bgp_zebra_use_nhop_weighted(struct bgp *bgp, struct attr *attr,
 	return true;
 }
 
+/* Share of the multipath, in percent like link-bandwidth, never 0 */
+static uint32_t bgp_zebra_nhop_latency_weight(struct bgp_path_info *mpinfo,
+					      uint64_t tot_lat_wt)
+{
+	uint64_t tmp = bgp_path_info_mpath_latwt(mpinfo) * 100;
+
+	return MAX((uint32_t)(tmp / tot_lat_wt), 1U);
+}
+
 void bgp_zebra_announce(struct bgp_dest *dest, const struct prefix *p,
 			struct bgp_path_info *info, struct bgp *bgp, afi_t afi,
 			safi_t safi)
@@ -1244,6 +1270,7 @@ void bgp_zebra_announce(struct bgp_dest *dest, const struct prefix *p,
 	uint8_t distance;
 	struct peer *peer;
 	struct bgp_path_info *mpinfo;
+	struct bgp_path_info *nh_paths[MULTIPATH_NUM];
 	struct bgp *bgp_orig;
 	uint32_t metric;
 	struct attr local_attr;
@@ -1255,8 +1282,9 @@ void bgp_zebra_announce(struct bgp_dest *dest, const struct prefix *p,
 	mpls_label_t nh_label;
 	int nh_othervrf = 0;
 	bool nh_updated = false;
-	bool do_wt_ecmp;
+	bool do_wt_ecmp, do_lat_ecmp;
 	uint64_t cum_bw = 0;
+	uint64_t cum_lat_wt = 0;
 	uint32_t nhg_id = 0;
 	bool is_add;
 	uint32_t ttl = 0;
@@ -1334,6 +1362,9 @@ void bgp_zebra_announce(struct bgp_dest *dest, const struct prefix *p,
 
 	if (CHECK_FLAG(info->attr->flag, ATTR_FLAG_BIT(BGP_ATTR_SRTE_COLOR)))
 		SET_FLAG(api.message, ZAPI_MESSAGE_SRTE);
+	else if (bgp->import_latency_cfg.color_steering)
+		/* Nexthops of the route may be in a latency class */
+		SET_FLAG(api.message, ZAPI_MESSAGE_SRTE);
 
 	/* Metric is currently based on the best-path only */
 	metric = info->attr->med;
@@ -1343,12 +1374,23 @@ void bgp_zebra_announce(struct bgp_dest *dest, const struct prefix *p,
 	if (do_wt_ecmp)
 		cum_bw = bgp_path_info_mpath_cumbw(info);
 
+	/* Or weighted by the measured latency of each path */
+	do_lat_ecmp = bgp_path_info_mpath_chklat(bgp, info);
+	if (do_lat_ecmp)
+		cum_lat_wt = bgp_path_info_mpath_cumlat(info);
+
 	/* EVPN MAC-IP routes are installed with a L3 NHG id */
 	if (bgp_evpn_path_es_use_nhg(bgp, info, &nhg_id)) {
 		mpinfo = NULL;
 		api.nhgid = nhg_id;
 		if (nhg_id)
 			SET_FLAG(api.message, ZAPI_MESSAGE_NHG);
+	} else if ((nhg_id = bgp_twamp_nhg_lookup(bgp, dest, info, afi,
+						  safi))) {
+		/* Or won on latency, through the group of its contenders */
+		mpinfo = NULL;
+		api.nhgid = nhg_id;
+		SET_FLAG(api.message, ZAPI_MESSAGE_NHG);
 	} else {
 		mpinfo = info;
 	}
@@ -1385,12 +1427,17 @@ void bgp_zebra_announce(struct bgp_dest *dest, const struct prefix *p,
 			if (!bgp_zebra_use_nhop_weighted(bgp, mpinfo->attr,
 							 cum_bw, &nh_weight))
 				continue;
+		} else if (do_lat_ecmp) {
+			nh_weight = bgp_zebra_nhop_latency_weight(mpinfo,
+								  cum_lat_wt);
 		}
 		api_nh = &api.nexthops[valid_nh_count];
 
 		if (CHECK_FLAG(info->attr->flag,
 			       ATTR_FLAG_BIT(BGP_ATTR_SRTE_COLOR)))
 			api_nh->srte_color = bgp_attr_get_color(info->attr);
+		else
+			api_nh->srte_color = bgp_twamp_path_color(bgp, mpinfo);
 
 		if (bgp_debug_zebra(&api.prefix)) {
 			if (mpinfo->extra) {
@@ -1533,7 +1580,7 @@ void bgp_zebra_announce(struct bgp_dest *dest, const struct prefix *p,
 			SET_FLAG(api_nh->flags, ZAPI_NEXTHOP_FLAG_SEG6);
 		}
 
-		valid_nh_count++;
+		nh_paths[valid_nh_count++] = mpinfo;
 	}
 
 	is_add = (valid_nh_count || nhg_id) ? true : false;
@@ -1593,6 +1640,25 @@ void bgp_zebra_announce(struct bgp_dest *dest, const struct prefix *p,
 		api.distance = distance;
 	}
 
+	/* VPN imports go by the id of a group bgpd resolved for them */
+	if (is_add && info->sub_type != BGP_ROUTE_AGGREGATE) {
+		bgp_nhg_route_install(dest, &api, nh_paths);
+		if (CHECK_FLAG(api.message, ZAPI_MESSAGE_NHG))
+			nhg_id = api.nhgid;
+	} else {
+		bgp_nhg_route_uninstall(dest);
+	}
+
+	/*
+	 * A route on a latency group that zebra has as is already: the group
+	 * took it along. Sent anyway if zebra is to tell us it installed it,
+	 * or keeps the details of the path.
+	 */
+	if (!bgp_twamp_nhg_route_send(dest, &api, is_add) &&
+	    !BGP_SUPPRESS_FIB_ENABLED(bgp) &&
+	    !CHECK_FLAG(api.message, ZAPI_MESSAGE_OPAQUE))
+		return;
+
 	if (bgp_debug_zebra(p)) {
 		char nh_buf[INET6_ADDRSTRLEN];
 		char eth_buf[ETHER_ADDR_STRLEN + 7] = {'\0'};
@@ -1763,6 +1829,9 @@ void bgp_zebra_withdraw(const struct prefix *p, struct bgp_path_info *info,
 		api.tableid = info->attr->rmap_table_id;
 	}
 
+	bgp_twamp_nhg_route_send(info->net, &api, false);
+	bgp_nhg_route_uninstall(info->net);
+
 	if (bgp_debug_zebra(p))
 		zlog_debug("Tx route delete VRF %u %pFX", bgp->vrf_id,
 			   &api.prefix);
@@ -2830,6 +2899,13 @@ static void bgp_zebra_connected(struct zclient *zclient)
 	/* Send the client registration */
 	bfd_client_sendmsg(zclient, ZEBRA_BFD_CLIENT_REGISTER, VRF_DEFAULT);
 
+	/* Link-state registrations do not survive a zebra restart */
+	bgp_twamp_ted_zebra_connected();
+	/* Nor do the latency nexthop groups */
+	bgp_twamp_nhg_zebra_connected();
+	/* Our nexthop groups go ahead of the routes using them */
+	bgp_nhg_zebra_connected();
+
 	/* At this point, we may or may not have BGP instances configured, but
 	 * we're only interested in the default VRF (others wouldn't have learnt
 	 * the VRF from Zebra yet.)
@@ -3342,12 +3418,47 @@ static int bgp_zebra_process_srv6_locator_delete(ZAPI_CALLBACK_ARGS)
 	return 0;
 }
 
+/* Link-state database updates, for IGP TE delay as a latency source */
+static int bgp_zebra_opaque_msg_handler(ZAPI_CALLBACK_ARGS)
+{
+	struct stream *s = zclient->ibuf;
+	struct zapi_opaque_msg info;
+
+	if (zclient_opaque_decode(s, &info) != 0)
+		return -1;
+
+	switch (info.type) {
+	case LINK_STATE_UPDATE:
+	case LINK_STATE_SYNC:
+		bgp_twamp_ted_message(s);
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+/* Only "delay measured" matters to bgpd, see bgp_twamp_links_changed() */
+static int bgp_interface_link_params(ZAPI_CALLBACK_ARGS)
+{
+	struct interface *ifp;
+	bool changed = false;
+
+	ifp = zebra_interface_link_params_read(zclient->ibuf, vrf_id, &changed);
+	if (ifp && changed && vrf_id == VRF_DEFAULT)
+		bgp_twamp_links_changed();
+
+	return 0;
+}
+
 static zclient_handler *const bgp_handlers[] = {
 	[ZEBRA_ROUTER_ID_UPDATE] = bgp_router_id_update,
 	[ZEBRA_INTERFACE_ADDRESS_ADD] = bgp_interface_address_add,
 	[ZEBRA_INTERFACE_ADDRESS_DELETE] = bgp_interface_address_delete,
 	[ZEBRA_INTERFACE_NBR_ADDRESS_ADD] = bgp_interface_nbr_address_add,
 	[ZEBRA_INTERFACE_NBR_ADDRESS_DELETE] = bgp_interface_nbr_address_delete,
+	[ZEBRA_INTERFACE_LINK_PARAMS] = bgp_interface_link_params,
 	[ZEBRA_REDISTRIBUTE_ROUTE_ADD] = zebra_read_route,
 	[ZEBRA_REDISTRIBUTE_ROUTE_DEL] = zebra_read_route,
 	[ZEBRA_NEXTHOP_UPDATE] = bgp_read_nexthop_update,
@@ -3373,6 +3484,7 @@ static zclient_handler *const bgp_handlers[] = {
 	[ZEBRA_SRV6_LOCATOR_DELETE] = bgp_zebra_process_srv6_locator_delete,
 	[ZEBRA_SRV6_MANAGER_GET_LOCATOR_CHUNK] =
 		bgp_zebra_process_srv6_locator_chunk,
+	[ZEBRA_OPAQUE_MESSAGE] = bgp_zebra_opaque_msg_handler,
 };
 
 static int bgp_if_new_hook(struct interface *ifp)
@@ -3468,6 +3580,10 @@ void bgp_zebra_init(struct event_loop *master, unsigned short instance)
 	zclient->zebra_connected = bgp_zebra_connected;
 	zclient->zebra_capabilities = bgp_zebra_capabilities;
 	zclient->instance = instance;
+	/* Routes installed by group id go to zebra many to a message */
+	zclient->route_bulk = true;
+	/* So do nexthop registrations, e.g. after a restart */
+	zclient->nexthop_bulk = true;
 
 	/* Initialize special zclient for synchronous message exchanges. */
 	zclient_sync = zclient_new(master, &options, NULL, 0);
@@ -3484,6 +3600,11 @@ void bgp_zebra_init(struct event_loop *master, unsigned short instance)
 
 void bgp_zebra_destroy(void)
 {
+	EVENT_OFF(t_pbr_batch);
+	stream_free(pbr_batch);
+	pbr_batch = NULL;
+	pbr_batch_count = 0;
+
 	if (zclient == NULL)
 		return;
 	zclient_stop(zclient);
@@ -3502,6 +3623,67 @@ int bgp_zebra_num_connects(void)
 	return zclient_num_connects;
 }
 
+/*
+ * Ipset and ipset entry messages carry a count of objects: those sent back
+ * to back with the same command share a message. The batch goes out when
+ * full, ahead of any other PBR message so zebra sees them in order, and at
+ * the latest once the current event is done.
+ */
+#define BGP_PBR_BATCH_ITEM_MAX 256
+
+static void bgp_pbr_batch_flush(void)
+{
+	struct stream *s;
+
+	if (!pbr_batch_count)
+		return;
+
+	EVENT_OFF(t_pbr_batch);
+	stream_putl_at(pbr_batch, ZEBRA_HEADER_SIZE, pbr_batch_count);
+	stream_putw_at(pbr_batch, 0, stream_get_endp(pbr_batch));
+
+	s = zclient->obuf;
+	stream_reset(s);
+	stream_put(s, STREAM_DATA(pbr_batch), stream_get_endp(pbr_batch));
+
+	if (BGP_DEBUG(zebra, ZEBRA))
+		zlog_debug("%s: %s for %u objects", __func__,
+			   zserv_command_string(pbr_batch_cmd),
+			   pbr_batch_count);
+	if (zclient_send_message(zclient) == ZCLIENT_SEND_FAILURE)
+		zlog_warn("%s: failed to send %s for %u objects", __func__,
+			  zserv_command_string(pbr_batch_cmd),
+			  pbr_batch_count);
+	pbr_batch_count = 0;
+}
+
+static void bgp_pbr_batch_send(struct event *t)
+{
+	bgp_pbr_batch_flush();
+}
+
+/* Stream to encode one more object of command cmd into */
+static struct stream *bgp_pbr_batch_get(uint16_t cmd)
+{
+	if (pbr_batch_count &&
+	    (pbr_batch_cmd != cmd ||
+	     STREAM_WRITEABLE(pbr_batch) < BGP_PBR_BATCH_ITEM_MAX))
+		bgp_pbr_batch_flush();
+
+	if (!pbr_batch_count) {
+		if (!pbr_batch)
+			pbr_batch = stream_new(ZEBRA_MAX_PACKET_SIZ);
+		stream_reset(pbr_batch);
+		zclient_create_header(pbr_batch, cmd, VRF_DEFAULT);
+		stream_putl(pbr_batch, 0); /* count, set on flush */
+		pbr_batch_cmd = cmd;
+		event_add_event(bm->master, bgp_pbr_batch_send, NULL, 0,
+				&t_pbr_batch);
+	}
+	pbr_batch_count++;
+	return pbr_batch;
+}
+
 void bgp_send_pbr_rule_action(struct bgp_pbr_action *pbra,
 			      struct bgp_pbr_rule *pbr,
 			      bool install)
@@ -3520,6 +3702,7 @@ void bgp_send_pbr_rule_action(struct bgp_pbr_action *pbra,
 			zlog_debug("%s: table %d fwmark %d %d", __func__,
 				   pbra->table_id, pbra->fwmark, install);
 	}
+	bgp_pbr_batch_flush();
 	s = zclient->obuf;
 	stream_reset(s);
 
@@ -3548,20 +3731,10 @@ void bgp_send_pbr_ipset_match(struct bgp_pbr_match *pbrim, bool install)
 		zlog_debug("%s: name %s type %d %d, ID %u", __func__,
 			   pbrim->ipset_name, pbrim->type, install,
 			   pbrim->unique);
-	s = zclient->obuf;
-	stream_reset(s);
-
-	zclient_create_header(s,
-			      install ? ZEBRA_IPSET_CREATE :
-			      ZEBRA_IPSET_DESTROY,
-			      VRF_DEFAULT);
-
-	stream_putl(s, 1); /* send one pbr action */
-
+	s = bgp_pbr_batch_get(install ? ZEBRA_IPSET_CREATE
+				      : ZEBRA_IPSET_DESTROY);
 	bgp_encode_pbr_ipset_match(s, pbrim);
-
-	stream_putw_at(s, 0, stream_get_endp(s));
-	if ((zclient_send_message(zclient) != ZCLIENT_SEND_FAILURE) && install)
+	if (install)
 		pbrim->install_in_progress = true;
 }
 
@@ -3576,20 +3749,10 @@ void bgp_send_pbr_ipset_entry_match(struct bgp_pbr_match_entry *pbrime,
 		zlog_debug("%s: name %s %d %d, ID %u", __func__,
 			   pbrime->backpointer->ipset_name, pbrime->unique,
 			   install, pbrime->unique);
-	s = zclient->obuf;
-	stream_reset(s);
-
-	zclient_create_header(s,
-			      install ? ZEBRA_IPSET_ENTRY_ADD :
-			      ZEBRA_IPSET_ENTRY_DELETE,
-			      VRF_DEFAULT);
-
-	stream_putl(s, 1); /* send one pbr action */
-
+	s = bgp_pbr_batch_get(install ? ZEBRA_IPSET_ENTRY_ADD
+				      : ZEBRA_IPSET_ENTRY_DELETE);
 	bgp_encode_pbr_ipset_entry_match(s, pbrime);
-
-	stream_putw_at(s, 0, stream_get_endp(s));
-	if ((zclient_send_message(zclient) != ZCLIENT_SEND_FAILURE) && install)
+	if (install)
 		pbrime->install_in_progress = true;
 }
 
@@ -3648,6 +3811,7 @@ void bgp_send_pbr_iptable(struct bgp_pbr_action *pba,
 		zlog_debug("%s: name %s type %d mark %d %d, ID %u", __func__,
 			   pbm->ipset_name, pbm->type, pba->fwmark, install,
 			   pbm->unique2);
+	bgp_pbr_batch_flush();
 	s = zclient->obuf;
 	stream_reset(s);
 
@@ -77,8 +77,13 @@
 #include "bgpd/bgp_evpn_private.h"
 #include "bgpd/bgp_evpn_mh.h"
 #include "bgpd/bgp_mac.h"
+#include "bgpd/bgp_select.h"
+#include "bgpd/bgp_preparse.h"
 #include "bgp_trace.h"
 #include "bgp_twamp.h"
+#include "bgp_twamp_nhg.h"
+#include "bgp_twamp_ted.h"
+#include "bgp_twamp_egress.h"
 
 DEFINE_MTYPE_STATIC(BGPD, PEER_TX_SHUTDOWN_MSG, "Peer shutdown message (TX)");
 DEFINE_QOBJ_TYPE(bgp_master);
@@ -147,12 +152,33 @@ void bgp_session_reset(struct peer *peer)
 static void bgp_import_latency_config_init(struct bgp *bgp)
 {
     bgp->import_latency_cfg.enabled = false;
-    bgp->import_latency_cfg.damping_threshold = 50;
+    bgp->import_latency_cfg.weighted_ecmp = false;
+    bgp->import_latency_cfg.nexthop_group = false;
+    bgp->import_latency_cfg.bfd_echo = false;
+    bgp->import_latency_cfg.source = BGP_LATENCY_SOURCE_TWAMP;
+    bgp->import_latency_cfg.hybrid_tolerance_us = 5000;
+    bgp->import_latency_cfg.hybrid_probe_cycle_sec = 600;
+    bgp->import_latency_cfg.advertise = false;
+    bgp->import_latency_cfg.advertise_interval_sec = 30;
+    bgp->import_latency_cfg.coalesce_msec = 0;
+    bgp->import_latency_cfg.color_steering = false;
+    bgp->import_latency_cfg.color_class_count = 0;
+    bgp->import_latency_cfg.damping_threshold_us = 50000;
+    bgp->import_latency_cfg.switch_back_threshold_us = 25000;
+    bgp->import_latency_cfg.min_dwell_sec = 0;
+    bgp->import_latency_cfg.hold_down_half_life = 0;
+    bgp->import_latency_cfg.loss_threshold_permille = 0;
     bgp->import_latency_cfg.packet_count = 3;
     bgp->import_latency_cfg.interval_ms = 10;
     bgp->import_latency_cfg.timeout_ms = 100;
     bgp->import_latency_cfg.probe_cycle_sec = 60;
     bgp->import_latency_cfg.port = 862;
+    bgp->import_latency_cfg.dscp = 0;
+    bgp->import_latency_cfg.one_way = false;
+    bgp->import_latency_cfg.egress_exit_count = 0;
+    bgp->import_latency_cfg.egress_plist = NULL;
+    bgp->import_latency_cfg.egress_max_prefixes =
+        BGP_LATENCY_EGRESS_MAX_PREFIXES_DEFAULT;
 }
 
 /*
@@ -1001,20 +1027,18 @@ int peer_cmp(struct peer *p1, struct peer *p2)
 	return sockunion_cmp(&p1->connection->su, &p2->connection->su);
 }
 
-static unsigned int peer_hash_key_make(const void *p)
+uint32_t bgp_peerhash_key(const struct peer *peer)
 {
-	const struct peer *peer = p;
 	return sockunion_hash(&peer->connection->su);
 }
 
-static bool peer_hash_same(const void *p1, const void *p2)
+int bgp_peerhash_cmp(const struct peer *p1, const struct peer *p2)
 {
-	const struct peer *peer1 = p1;
-	const struct peer *peer2 = p2;
+	if (CHECK_FLAG(p1->flags, PEER_FLAG_CONFIG_NODE) !=
+	    CHECK_FLAG(p2->flags, PEER_FLAG_CONFIG_NODE))
+		return CHECK_FLAG(p1->flags, PEER_FLAG_CONFIG_NODE) ? 1 : -1;
 
-	return (sockunion_same(&peer1->connection->su, &peer2->connection->su) &&
-		CHECK_FLAG(peer1->flags, PEER_FLAG_CONFIG_NODE) ==
-			CHECK_FLAG(peer2->flags, PEER_FLAG_CONFIG_NODE));
+	return !sockunion_same(&p1->connection->su, &p2->connection->su);
 }
 
 void peer_flag_inherit(struct peer *peer, uint64_t flag)
@@ -1187,6 +1211,12 @@ void bgp_peer_connection_buffers_free(struct peer_connection *connection)
 			connection->ibuf = NULL;
 		}
 
+		if (connection->ibuf_parse) {
+			stream_fifo_free(connection->ibuf_parse);
+			connection->ibuf_parse = NULL;
+		}
+		bgp_preparse_clean(connection);
+
 		if (connection->obuf) {
 			stream_fifo_free(connection->obuf);
 			connection->obuf = NULL;
@@ -1222,7 +1252,11 @@ struct peer_connection *bgp_peer_connection_new(struct peer *peer)
 
 	connection->ibuf = stream_fifo_new();
 	connection->obuf = stream_fifo_new();
+	connection->ibuf_parse = stream_fifo_new();
+	bgp_preparse_list_init(&connection->ibuf_prep);
 	pthread_mutex_init(&connection->io_mtx, NULL);
+	event_inject_init(&connection->process_inject, bgp_process_packet,
+			  connection, 0, &connection->t_process_packet);
 
 	/* We use a larger buffer for peer->obuf_work in the event that:
 	 * - We RX a BGP_UPDATE where the attributes alone are just
@@ -1827,19 +1861,15 @@ void bgp_peer_conf_if_to_su_update(struct peer_connection *connection)
 		node = listnode_lookup(bgp->peer, peer);
 		if (node) {
 			/*
-			 * Let's reset the peer->su release and
-			 * reset it and put it back.  We have to
-			 * do this because hash_release will
-			 * scan through looking for a matching
-			 * su if needed.
+			 * Let's reset the peer->su, take it out
+			 * and put it back, the list is sorted by su.
 			 */
 			connection->su = old_su;
-			hash_release(peer->bgp->peerhash, peer);
+			bgp_peerhash_del(&peer->bgp->peerhash, peer);
 			listnode_delete(peer->bgp->peer, peer);
 
 			connection->su = new_su;
-			(void)hash_get(peer->bgp->peerhash, peer,
-				       hash_alloc_intern);
+			bgp_peerhash_add(&peer->bgp->peerhash, peer);
 			listnode_add_sort(peer->bgp->peer, peer);
 		}
 	}
@@ -1850,6 +1880,9 @@ void bgp_recalculate_afi_safi_bestpaths(struct bgp *bgp, afi_t afi, safi_t safi)
 	struct bgp_dest *dest, *ndest;
 	struct bgp_table *table;
 
+	/* Best-path settings changed, pick the comparator for them */
+	bgp_bestpath_steps_update(bgp);
+
 	for (dest = bgp_table_top(bgp->rib[afi][safi]); dest;
 	     dest = bgp_route_next(dest)) {
 		table = bgp_dest_get_bgp_table_info(dest);
@@ -1937,7 +1970,7 @@ struct peer *peer_create(union sockunion *su, const char *conf_if,
 	if (config_node)
 		SET_FLAG(peer->flags, PEER_FLAG_CONFIG_NODE);
 
-	(void)hash_get(bgp->peerhash, peer, hash_alloc_intern);
+	bgp_peerhash_add(&bgp->peerhash, peer);
 
 	/* Adjust update-group coalesce timer heuristics for # peers. */
 	if (bgp->heuristic_coalesce) {
@@ -1998,7 +2031,7 @@ struct peer *peer_create_accept(struct bgp *bgp)
 
 	peer = peer_lock(peer); /* bgp peer list reference */
 	listnode_add_sort(bgp->peer, peer);
-	(void)hash_get(bgp->peerhash, peer, hash_alloc_intern);
+	bgp_peerhash_add(&bgp->peerhash, peer);
 
 	return peer;
 }
@@ -2344,12 +2377,16 @@ static void peer_group2peer_config_copy_af(struct peer_group *group,
 		PEER_ATTR_INHERIT(peer, group, filter[afi][safi].advmap.cmap);
 		PEER_ATTR_INHERIT(peer, group,
 				  filter[afi][safi].advmap.condition);
+		bgp_conditional_adv_peer_update(peer, afi, safi);
 	}
 
 	if (peer->addpath_type[afi][safi] == BGP_ADDPATH_NONE) {
 		peer->addpath_type[afi][safi] = conf->addpath_type[afi][safi];
 		bgp_addpath_type_changed(conf->bgp);
 	}
+
+	if (peer->orr_root[afi][safi].s_addr == INADDR_ANY)
+		peer->orr_root[afi][safi] = conf->orr_root[afi][safi];
 }
 
 static int peer_activate_af(struct peer *peer, afi_t afi, safi_t safi)
@@ -2653,8 +2690,10 @@ int peer_delete(struct peer *peer)
 	bgp_reads_off(peer->connection);
 	bgp_writes_off(peer->connection);
 	event_cancel_event_ready(bm->master, peer->connection);
-	FOREACH_AFI_SAFI (afi, safi)
+	FOREACH_AFI_SAFI (afi, safi) {
 		EVENT_OFF(peer->t_revalidate_all[afi][safi]);
+		bgp_stale_sweep_cancel(peer, afi, safi);
+	}
 	assert(!CHECK_FLAG(peer->connection->thread_flags,
 			   PEER_THREAD_WRITES_ON));
 	assert(!CHECK_FLAG(peer->connection->thread_flags,
@@ -2727,7 +2766,7 @@ int peer_delete(struct peer *peer)
 		 * it's in there or not.
 		 */
 		list_delete_node(bgp->peer, pn);
-		hash_release(bgp->peerhash, peer);
+		bgp_peerhash_del(&bgp->peerhash, peer);
 		peer_unlock(peer); /* bgp peer list reference */
 	}
 
@@ -2761,6 +2800,8 @@ int peer_delete(struct peer *peer)
 		ecommunity_free(&peer->soo[afi][safi]);
 	}
 
+	bgp_conditional_adv_peer_delete(peer);
+
 	FOREACH_AFI_SAFI (afi, safi)
 		peer_af_delete(peer, afi, safi);
 
@@ -3394,9 +3435,7 @@ static struct bgp *bgp_create(as_t *as, const char *name,
 			XSTRDUP(MTYPE_BGP_PEER_HOST, cmd_domainname_get());
 	bgp->peer = list_new();
 	bgp->peer->cmp = (int (*)(void *, void *))peer_cmp;
-	bgp->peerhash = hash_create(peer_hash_key_make, peer_hash_same,
-				    "BGP Peer Hash");
-	bgp->peerhash->max_size = BGP_PEER_MAX_HASH_SIZE;
+	bgp_peerhash_init(&bgp->peerhash);
 
 	bgp->group = list_new();
 	bgp->group->cmp = (int (*)(void *, void *))peer_group_cmp;
@@ -3472,6 +3511,7 @@ static struct bgp *bgp_create(as_t *as, const char *name,
 			&bgp->mpls_labels_per_nexthop[afi]);
 
 	bgp_mplsvpn_nh_label_bind_cache_init(&bgp->mplsvpn_nh_label_bind);
+	bgp_cond_adv_list_init(&bgp->cond_adv);
 
 	if (name)
 		bgp->name = XSTRDUP(MTYPE_BGP, name);
@@ -3529,6 +3569,7 @@ static struct bgp *bgp_create(as_t *as, const char *name,
 	//For BGP TWAMP-LIGHT PROJECT
 	bgp_import_latency_config_init(bgp);
 	bgp_twamp_init(bgp);
+	bgp_bestpath_steps_update(bgp);
 	return bgp;
 }
 
@@ -3733,6 +3774,7 @@ int bgp_get(struct bgp **bgp_val, as_t *as, const char *name,
 	 */
 	bgp_handle_socket(bgp, vrf, VRF_UNKNOWN, true);
 	listnode_add(bm->bgp, bgp);
+	vpn_leak_import_index_invalidate();
 
 	if (IS_BGP_INST_KNOWN_TO_ZEBRA(bgp)) {
 		if (BGP_DEBUG(zebra, ZEBRA))
@@ -3866,6 +3908,12 @@ int bgp_delete(struct bgp *bgp)
 
 	bgp_vpn_leak_unimport(bgp);
 
+	/* Let go of the shared latency segment, freed with its last user */
+	bgp_twamp_cleanup(bgp);
+	bgp_twamp_ted_update();
+	bgp_twamp_nhg_finish(bgp);
+	bgp_twamp_egress_finish(bgp);
+
 	hook_call(bgp_inst_delete, bgp);
 
 	FOREACH_AFI_SAFI (afi, safi)
@@ -4012,6 +4060,7 @@ int bgp_delete(struct bgp *bgp)
 	 * routes to be processed still referencing the struct bgp.
 	 */
 	listnode_delete(bm->bgp, bgp);
+	vpn_leak_import_index_invalidate();
 
 	/* Free interfaces in this instance. */
 	bgp_if_finish(bgp);
@@ -4050,11 +4099,12 @@ void bgp_free(struct bgp *bgp)
 
 	list_delete(&bgp->group);
 	list_delete(&bgp->peer);
+	bgp_cond_adv_list_fini(&bgp->cond_adv);
 
-	if (bgp->peerhash) {
-		hash_free(bgp->peerhash);
-		bgp->peerhash = NULL;
-	}
+	/* The peers are gone, they went with the peer list */
+	while (bgp_peerhash_pop(&bgp->peerhash))
+		;
+	bgp_peerhash_fini(&bgp->peerhash);
 
 	FOREACH_AFI_SAFI (afi, safi) {
 		/* Special handling for 2-level routing tables. */
@@ -4202,12 +4252,12 @@ struct peer *peer_lookup(struct bgp *bgp, union sockunion *su)
 	connection.su = *su;
 
 	if (bgp != NULL) {
-		peer = hash_lookup(bgp->peerhash, &tmp_peer);
+		peer = bgp_peerhash_find(&bgp->peerhash, &tmp_peer);
 	} else if (bm->bgp != NULL) {
 		struct listnode *bgpnode, *nbgpnode;
 
 		for (ALL_LIST_ELEMENTS(bm->bgp, bgpnode, nbgpnode, bgp)) {
-			peer = hash_lookup(bgp->peerhash, &tmp_peer);
+			peer = bgp_peerhash_find(&bgp->peerhash, &tmp_peer);
 			if (peer)
 				break;
 		}
@@ -7160,6 +7210,9 @@ static void peer_prefix_list_update(struct prefix_list *plist)
 			}
 		}
 	}
+
+	/* The egress prefixes are picked by name, on the next collect */
+	bgp_twamp_egress_plist_changed(plist ? prefix_list_name(plist) : NULL);
 }
 
 int peer_aslist_set(struct peer *peer, afi_t afi, safi_t safi, int direct,
@@ -7867,6 +7920,50 @@ int peer_maximum_prefix_out_unset(struct peer *peer, afi_t afi, safi_t safi)
 	return 0;
 }
 
+static void peer_orr_root_refresh_routes(struct peer *peer, afi_t afi,
+					 safi_t safi)
+{
+	update_group_adjust_peer(peer_af_find(peer, afi, safi));
+
+	if (peer_established(peer->connection))
+		bgp_announce_route(peer, afi, safi, false);
+}
+
+/*
+ * Set the optimal route reflection root of a client, or clear it with
+ * INADDR_ANY; a group member then goes back to the group's. Members of a
+ * group follow it unless they have a root of their own.
+ */
+int peer_orr_root_set(struct peer *peer, afi_t afi, safi_t safi,
+		      struct in_addr root)
+{
+	struct in_addr old = peer->orr_root[afi][safi];
+	struct peer *member;
+	struct listnode *node;
+
+	if (root.s_addr == INADDR_ANY && peer_group_active(peer))
+		root = peer->group->conf->orr_root[afi][safi];
+	if (IPV4_ADDR_SAME(&root, &old))
+		return 0;
+	peer->orr_root[afi][safi] = root;
+
+	if (!CHECK_FLAG(peer->sflags, PEER_STATUS_GROUP)) {
+		peer_orr_root_refresh_routes(peer, afi, safi);
+	} else {
+		for (ALL_LIST_ELEMENTS_RO(peer->group->peer, node, member)) {
+			if (!IPV4_ADDR_SAME(&member->orr_root[afi][safi],
+					    &old))
+				continue;
+			member->orr_root[afi][safi] = root;
+			peer_orr_root_refresh_routes(member, afi, safi);
+		}
+	}
+
+	/* The roots are placed in the IGP link-state database */
+	bgp_twamp_ted_update();
+	return 0;
+}
+
 int is_ebgp_multihop_configured(struct peer *peer)
 {
 	struct peer_group *group;
@@ -8398,7 +8495,10 @@ void bgp_pthreads_run(void)
 
 void bgp_pthreads_finish(void)
 {
+	bgp_select_workers_set(0);
+	bgp_preparse_workers_set(0);
 	frr_pthread_stop_all();
+	bgp_pkt_pool_finish();
 }
 
 static int peer_unshut_after_cfg(struct bgp *bgp)
@@ -8482,6 +8582,8 @@ void bgp_init(unsigned short instance)
 	/* BFD init */
 	bgp_bfd_init(bm->master);
 
+	bgp_twamp_vty_init();
+
 	bgp_lp_vty_init();
 
 	bgp_label_per_nexthop_init();
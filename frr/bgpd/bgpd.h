@@ -35,7 +35,6 @@
 #include "lib/bfd.h"
 
 #define BGP_MAX_HOSTNAME 64	/* Linux max, is larger than most other sys */
-#define BGP_PEER_MAX_HASH_SIZE 16384
 
 /* Default interval for IPv6 RAs when triggered by BGP unnumbered neighbor. */
 #define BGP_UNNUM_DEFAULT_RA_INTERVAL 10
@@ -155,6 +154,7 @@ struct bgp_master {
 	uint32_t flags;
 #define BM_FLAG_GRACEFUL_SHUTDOWN        (1 << 0)
 #define BM_FLAG_SEND_EXTRA_DATA_TO_ZEBRA (1 << 1)
+#define BM_FLAG_INSTALL_NHG              (1 << 2)
 #define BM_FLAG_IPV6_NO_AUTO_RA		 (1 << 8)
 
 	bool terminating;	/* global flag that sigint terminate seen */
@@ -166,6 +166,12 @@ struct bgp_master {
 	uint32_t inq_limit;
 	uint32_t outq_limit;
 
+	/* Threads running best-path selection, 0 for the main one only */
+	uint8_t select_threads;
+
+	/* UPDATE parse workers, 0 to parse on the main thread only */
+	uint8_t parse_threads;
+
 	struct event *t_bgp_sync_label_manager;
 	struct event *t_bgp_start_label_manager;
 
@@ -340,15 +346,120 @@ struct as_confed {
 struct bgp_mplsvpn_nh_label_bind_cache;
 PREDECL_RBTREE_UNIQ(bgp_mplsvpn_nh_label_bind_cache);
 
+struct bgp_cond_adv;
+PREDECL_DLIST(bgp_cond_adv_list);
+
+/* Peers of an instance by address, see peer_lookup() */
+PREDECL_HASH(bgp_peerhash);
+
 //FOR BGP TWAMP-LIGHT PROJECT
+/* Where nexthop latency comes from */
+enum bgp_latency_source {
+    /* Active probing by the TWAMP agent, through the shared segment */
+    BGP_LATENCY_SOURCE_TWAMP = 0,
+    /* IGP TE link delay summed over the shortest path, see bgp_twamp_ted.c */
+    BGP_LATENCY_SOURCE_IGP_TE,
+    /*
+     * IGP TE delay as the baseline, with TWAMP probing sparsely while the
+     * two agree and at the normal rate while they do not
+     */
+    BGP_LATENCY_SOURCE_HYBRID,
+};
+
+/* Nexthops within upto_us are steered into the SR policies of color */
+struct bgp_latency_color_class {
+    uint32_t upto_us;
+    uint32_t color;
+};
+#define BGP_LATENCY_COLOR_CLASSES 8
+
+/* An internet exit: the nexthop of its eBGP paths and its policy route */
+struct bgp_latency_egress_exit {
+    struct in_addr nexthop;
+    uint32_t mark;
+};
+#define BGP_LATENCY_EGRESS_EXITS 8
+#define BGP_LATENCY_EGRESS_MAX_PREFIXES_DEFAULT 50000
+
 struct bgp_import_latency_config {
     bool enabled;
-    uint32_t damping_threshold;
+    enum bgp_latency_source source;
+    /* Spread multipaths by inverse latency, see bgp_twamp_path_weight() */
+    bool weighted_ecmp;
+    /* Install latency-decided routes through shared nexthop groups */
+    bool nexthop_group;
+    /* Precompute the next-best PE of each group as its backup */
+    bool nexthop_group_backup;
+    /*
+     * Margins in microseconds: the one a challenger must beat the
+     * selected path by (switch-to), and the one the selected path keeps
+     * its latency win by (switch-back). Configured in ms unless told
+     * otherwise.
+     */
+    uint32_t damping_threshold_us;
+    uint32_t switch_back_threshold_us;
+    /* A latency move must hold this long before best-path sees it */
+    uint32_t min_dwell_sec;
+    /* Per-peer hold-down half-life in seconds, 0 to disable */
+    uint32_t hold_down_half_life;
+    /*
+     * Fast reroute: paths via a nexthop losing at least this share of
+     * its probes (permille) lose to any other path, 0 to disable
+     */
+    uint16_t loss_threshold_permille;
+    /*
+     * Fall back to the BFD echo round trip time of nexthops that are
+     * single-hop BFD peers when TWAMP has no measurement for them
+     */
+    bool bfd_echo;
     int packet_count;
     int interval_ms;
     int timeout_ms;
     int probe_cycle_sec;
     int port;
+    /* DSCP the nexthops are probed with, to measure that traffic class */
+    uint8_t dscp;
+    /*
+     * Rank nexthops the agent measures one way (STAMP, both clocks
+     * synchronized) by their forward delay rather than the round trip
+     */
+    bool one_way;
+    /*
+     * Hybrid source: how far apart (us) the IGP estimate and the last
+     * measurement may be and still agree, and the probe cycle of
+     * nexthops where they do
+     */
+    uint32_t hybrid_tolerance_us;
+    uint16_t hybrid_probe_cycle_sec;
+    /*
+     * Stamp announcements with the latency extended community, and the
+     * least time in seconds between two changes of a nexthop's value
+     */
+    bool advertise;
+    uint16_t advertise_interval_sec;
+    /*
+     * Merge latency changes over this many milliseconds before best-path
+     * runs again, 0 to run it on every change
+     */
+    uint32_t coalesce_msec;
+    /*
+     * Steer by colour instead of selecting by latency: routes resolve
+     * through the SR policy of the first class, by increasing upto_us,
+     * the latency of their nexthop is within
+     */
+    bool color_steering;
+    unsigned int color_class_count;
+    struct bgp_latency_color_class color_classes[BGP_LATENCY_COLOR_CLASSES];
+    /*
+     * Internet egress: eBGP paths via these exits are ranked by the
+     * latency measured through each of them towards the destination,
+     * for up to egress_max_prefixes of the prefixes egress_plist
+     * permits, see bgp_twamp_egress.c
+     */
+    unsigned int egress_exit_count;
+    struct bgp_latency_egress_exit egress_exits[BGP_LATENCY_EGRESS_EXITS];
+    char *egress_plist;
+    uint32_t egress_max_prefixes;
 };
 
 /* BGP instance structure.  */
@@ -373,7 +484,7 @@ struct bgp {
 
 	/* BGP peer. */
 	struct list *peer;
-	struct hash *peerhash;
+	struct bgp_peerhash_head peerhash;
 
 	/* BGP peer group.  */
 	struct list *group;
@@ -386,6 +497,10 @@ struct bgp {
 
 	struct hash *update_groups[BGP_AF_MAX];
 
+	/* Update subgroups by adj_slot, NULL for a free slot */
+	struct update_subgroup **adj_slots;
+	uint32_t adj_slots_max;
+
 	/*
 	 * Global statistics for update groups.
 	 */
@@ -529,6 +644,19 @@ struct bgp {
 /* Prohibit BGP from enabling IPv6 RA on interfaces */
 #define BGP_FLAG_IPV6_NO_AUTO_RA (1ULL << 40)
 
+	/* The optional best-path steps the flags above and the latency
+	 * configuration enable, and the comparator specialised for them;
+	 * see bgp_bestpath_steps_update().  0 is the default configuration.
+	 */
+	uint32_t bestpath_steps;
+#define BGP_BESTPATH_STEP_LATENCY (1 << 0)
+#define BGP_BESTPATH_STEP_AIGP (1 << 1)
+#define BGP_BESTPATH_STEP_ASPATH_IGNORE (1 << 2)
+#define BGP_BESTPATH_STEP_ASPATH_CONFED (1 << 3)
+#define BGP_BESTPATH_STEP_ALWAYS_MED (1 << 4)
+#define BGP_BESTPATH_STEP_MED_CONFED (1 << 5)
+	uint8_t bestpath_cmp;
+
 	/* BGP default address-families.
 	 * New peers inherit enabled afi/safis from bgp instance.
 	 */
@@ -561,6 +689,10 @@ struct bgp {
 #define BGP_CONFIG_VRF_TO_VRF_EXPORT (1 << 10)
 /* vpnvx retain flag */
 #define BGP_VPNVX_RETAIN_ROUTE_TARGET_ALL (1 << 11)
+/* fold settled adj-outs into per-prefix sets */
+#define BGP_CONFIG_ADJ_OUT_COMPACT (1 << 12)
+/* keep adj-ins as what the inbound policy changed */
+#define BGP_CONFIG_ADJ_IN_COMPACT (1 << 13)
 
 	/* BGP per AF peer count */
 	uint32_t af_peer_count[AFI_MAX][SAFI_MAX];
@@ -807,6 +939,9 @@ struct bgp {
 	uint32_t condition_check_period;
 	uint32_t condition_filter_count;
 	struct event *t_condition_check;
+	/* Condition-map indexes of the peers, and when last evaluated */
+	struct bgp_cond_adv_list_head cond_adv;
+	time_t condition_check_last;
 
 	/* BGP VPN SRv6 backend */
 	bool srv6_enabled;
@@ -835,6 +970,11 @@ struct bgp {
 
 //FOR BGP TWAMP-LIGHT PROJECT
 struct bgp_import_latency_config import_latency_cfg; 
+/* Holds a reference on the shared latency segment */
+bool twamp_attached;
+/* Best-path changes decided by the latency step and by probe loss */
+uint64_t twamp_latency_changes;
+uint64_t twamp_loss_changes;
 
 };
 DECLARE_QOBJ_TYPE(bgp);
@@ -976,6 +1116,9 @@ struct bgp_filter {
 		struct route_map *cmap;
 
 		enum update_type update_type;
+
+		/* Prefixes in the table of the condition, config peers only */
+		struct bgp_cond_adv *cond;
 	} advmap;
 };
 
@@ -1139,6 +1282,9 @@ struct llgr_info {
 	uint8_t flags;
 };
 
+PREDECL_LIST(bgp_preparse_list);
+PREDECL_DLIST(bgp_preparse_queue);
+
 struct peer_connection {
 	struct peer *peer;
 
@@ -1149,10 +1295,17 @@ struct peer_connection {
 	int fd;
 
 	/* Packet receive and send buffer. */
-	pthread_mutex_t io_mtx;	  // guards ibuf, obuf
+	pthread_mutex_t io_mtx;	  // guards ibuf, obuf, ibuf_parse, ibuf_prep
 	struct stream_fifo *ibuf; // packets waiting to be processed
 	struct stream_fifo *obuf; // packets waiting to be written
 
+	/* packets waiting for a parse worker, and what they found */
+	struct stream_fifo *ibuf_parse;
+	struct bgp_preparse_list_head ibuf_prep;
+	/* bgp_preparse.c's, protected by its pool mutex */
+	struct bgp_preparse_queue_item preparse_item;
+	uint8_t preparse_flags;
+
 	struct ringbuf *ibuf_work; // WiP buffer used by bgp_read() only
 
 	struct event *t_read;
@@ -1174,6 +1327,8 @@ struct peer_connection {
 	struct event *t_routeadv;
 	struct event *t_process_packet;
 	struct event *t_process_packet_error;
+	/* t_process_packet, from the I/O pthread and preparse workers */
+	struct event_inject process_inject;
 
 	union sockunion su;
 #define BGP_CONNECTION_SU_UNSPEC(connection)                                   \
@@ -1193,6 +1348,9 @@ struct peer {
 	/* BGP structure.  */
 	struct bgp *bgp;
 
+	/* Member of bgp->peerhash */
+	struct bgp_peerhash_item peerhash_item;
+
 	/* reference count, primarily to allow bgp_process'ing of route_node's
 	 * to be done after a struct peer is deleted.
 	 *
@@ -1229,6 +1387,7 @@ struct peer {
 	struct in_addr local_id;
 
 	struct stream *curr; // the current packet being parsed
+	struct bgp_preparse *curr_prep; // and its values decoded by a worker
 
 	/* the doppelganger peer structure, due to dual TCP conn setup */
 	struct peer *doppelganger;
@@ -1551,6 +1710,12 @@ struct peer {
 
 	/* Peer status af flags (reset in bgp_stop) */
 	uint16_t af_sflags[AFI_MAX][SAFI_MAX];
+
+	/*
+	 * Bumped to mark all the peer's paths stale at once, for graceful
+	 * restart and enhanced route refresh.
+	 */
+	uint32_t stale_epoch[AFI_MAX][SAFI_MAX];
 #define PEER_STATUS_ORF_PREFIX_SEND   (1U << 0) /* prefix-list send peer */
 #define PEER_STATUS_ORF_WAIT_REFRESH  (1U << 1) /* wait refresh received peer */
 #define PEER_STATUS_PREFIX_THRESHOLD  (1U << 2) /* exceed prefix-threshold */
@@ -1587,6 +1752,7 @@ struct peer {
 	/* Threads. */
 	struct event *t_llgr_stale[AFI_MAX][SAFI_MAX];
 	struct event *t_revalidate_all[AFI_MAX][SAFI_MAX];
+	struct bgp_stale_sweep *stale_sweep[AFI_MAX][SAFI_MAX];
 	struct event *t_refresh_stalepath;
 
 	/* Thread flags. */
@@ -1817,7 +1983,6 @@ struct peer {
 
 	/* Conditional advertisement */
 	bool advmap_config_change[AFI_MAX][SAFI_MAX];
-	bool advmap_table_change;
 
 	/* set TCP max segment size */
 	uint32_t tcp_mss;
@@ -1841,10 +2006,19 @@ struct peer {
 	/* Add-Path Best selected paths number to advertise */
 	uint8_t addpath_best_selected[AFI_MAX][SAFI_MAX];
 
+	/* Optimal route reflection root (RFC 9107), INADDR_ANY if none */
+	struct in_addr orr_root[AFI_MAX][SAFI_MAX];
+
 	QOBJ_FIELDS;
 };
 DECLARE_QOBJ_TYPE(peer);
 
+extern int bgp_peerhash_cmp(const struct peer *p1, const struct peer *p2);
+extern uint32_t bgp_peerhash_key(const struct peer *peer);
+
+DECLARE_HASH(bgp_peerhash, struct peer, peerhash_item, bgp_peerhash_cmp,
+	     bgp_peerhash_key);
+
 /* Inherit peer attribute from peer-group. */
 #define PEER_ATTR_INHERIT(peer, group, attr)                                   \
 	((peer)->attr = (group)->conf->attr)
@@ -2242,6 +2416,11 @@ extern void bgp_init(unsigned short instance);
 extern void bgp_pthreads_run(void);
 extern void bgp_pthreads_finish(void);
 extern void bgp_route_map_init(void);
+/* route_map_apply(), remembering results of attribute-only route-maps */
+struct bgp_path_info;
+extern route_map_result_t bgp_route_map_apply_cached(struct route_map *map,
+						     const struct prefix *p,
+						     struct bgp_path_info *path);
 extern void bgp_session_reset(struct peer *);
 
 extern int bgp_option_set(int);
@@ -2432,6 +2611,8 @@ extern void peer_maximum_prefix_out_refresh_routes(struct peer *peer, afi_t afi,
 						   safi_t safi);
 extern int peer_maximum_prefix_out_set(struct peer *peer, afi_t afi,
 				       safi_t safi, uint32_t max);
+extern int peer_orr_root_set(struct peer *peer, afi_t afi, safi_t safi,
+			     struct in_addr root);
 extern int peer_maximum_prefix_out_unset(struct peer *peer, afi_t afi,
 					 safi_t safi);
 
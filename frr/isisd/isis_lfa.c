@@ -6,6 +6,7 @@
 
 #include <zebra.h>
 
+#include "jhash.h"
 #include "linklist.h"
 #include "log.h"
 #include "memory.h"
@@ -1231,16 +1232,119 @@ struct isis_spftree *isis_tilfa_compute(struct isis_area *area,
  *
  * @return		0 on success, -1 otherwise
  */
+/*
+ * Digest of everything in the LSPDB the neighbor SPTs depend on: which LSPs
+ * are there, their LSP bits and their TLVs. Sequence numbers, lifetimes and
+ * checksums are left out, so that refreshing an LSP, which schedules an SPF
+ * run of its own, does not change it.
+ */
+static uint64_t isis_lfa_lspdb_digest(const struct isis_spftree *spftree)
+{
+	size_t hdr_len = ISIS_FIXED_HDR_LEN + ISIS_LSP_HDR_LEN;
+	uint32_t hi = spftree->mtid, lo = spftree->area->srdb.enabled;
+	struct isis_lsp *lsp;
+	uint32_t bits;
+
+	frr_each (lspdb, spftree->lspdb, lsp) {
+		bits = lsp->hdr.lsp_bits;
+		if (lsp->hdr.rem_lifetime)
+			bits |= 0x100;
+		if (lsp->hdr.seqno)
+			bits |= 0x200;
+
+		hi = jhash_1word(bits, jhash(lsp->hdr.lsp_id,
+					     sizeof(lsp->hdr.lsp_id), hi));
+		lo = jhash_1word(bits, jhash(lsp->hdr.lsp_id,
+					     sizeof(lsp->hdr.lsp_id), ~lo));
+		if (lsp->pdu && stream_get_endp(lsp->pdu) > hdr_len) {
+			hi = jhash(STREAM_DATA(lsp->pdu) + hdr_len,
+				   stream_get_endp(lsp->pdu) - hdr_len, hi);
+			lo = jhash(STREAM_DATA(lsp->pdu) + hdr_len,
+				   stream_get_endp(lsp->pdu) - hdr_len, ~lo);
+		}
+	}
+
+	return ((uint64_t)hi << 32) | lo;
+}
+
+/* The LSPs these point into may be updated in place before the next run */
+static void isis_lfa_cache_detach(struct isis_spftree *spftree)
+{
+	struct isis_spf_adj *sadj;
+	struct listnode *node;
+
+	if (!spftree)
+		return;
+
+	for (ALL_LIST_ELEMENTS_RO(spftree->sadj_list, node, sadj)) {
+		sadj->lsp = NULL;
+		sadj->subtlvs = NULL;
+	}
+}
+
+/**
+ * Keep the neighbor SPTs of the run that is over, so that the next run can
+ * reuse them if the LSPDB has not changed in the meantime.
+ *
+ * @param spftree	IS-IS SPF tree
+ */
+void isis_lfa_cache_save(struct isis_spftree *spftree)
+{
+	struct isis_spf_node *adj_node, *node;
+
+	isis_spf_node_list_clear(&spftree->lfa.cache.nodes);
+
+	RB_FOREACH (adj_node, isis_spf_nodes, &spftree->adj_nodes) {
+		if (!adj_node->lfa.spftree)
+			continue;
+
+		node = isis_spf_node_new(&spftree->lfa.cache.nodes,
+					 adj_node->sysid);
+		node->lfa.spftree = adj_node->lfa.spftree;
+		node->lfa.spftree_reverse = adj_node->lfa.spftree_reverse;
+		adj_node->lfa.spftree = NULL;
+		adj_node->lfa.spftree_reverse = NULL;
+
+		isis_lfa_cache_detach(node->lfa.spftree);
+		isis_lfa_cache_detach(node->lfa.spftree_reverse);
+	}
+}
+
 int isis_spf_run_neighbors(struct isis_spftree *spftree)
 {
 	struct isis_lsp *lsp;
-	struct isis_spf_node *adj_node;
+	struct isis_spf_node *adj_node, *cached;
+	uint64_t digest;
+	bool reuse;
 
 	lsp = isis_root_system_lsp(spftree->lspdb, spftree->sysid);
 	if (!lsp)
 		return -1;
 
+	/* Flex-algo SPTs also depend on the algorithm definitions */
+	digest = isis_lfa_lspdb_digest(spftree);
+	reuse = spftree->algorithm == SR_ALGORITHM_SPF &&
+		digest == spftree->lfa.cache.digest;
+
 	RB_FOREACH (adj_node, isis_spf_nodes, &spftree->adj_nodes) {
+		cached = reuse ? isis_spf_node_find(&spftree->lfa.cache.nodes,
+						    adj_node->sysid)
+			       : NULL;
+		if (cached && cached->lfa.spftree) {
+			if (IS_DEBUG_LFA)
+				zlog_debug(
+					"ISIS-LFA: reusing the SPTs of neighbor %s",
+					print_sys_hostname(adj_node->sysid));
+
+			/* Reverse SPT too, if the last run computed it */
+			adj_node->lfa.spftree = cached->lfa.spftree;
+			adj_node->lfa.spftree_reverse =
+				cached->lfa.spftree_reverse;
+			cached->lfa.spftree = NULL;
+			cached->lfa.spftree_reverse = NULL;
+			continue;
+		}
+
 		if (IS_DEBUG_LFA)
 			zlog_debug("ISIS-LFA: running SPF on neighbor %s",
 				   print_sys_hostname(adj_node->sysid));
@@ -1254,6 +1358,10 @@ int isis_spf_run_neighbors(struct isis_spftree *spftree)
 		isis_run_spf(adj_node->lfa.spftree);
 	}
 
+	/* What is left belongs to routers that are no longer adjacent */
+	isis_spf_node_list_clear(&spftree->lfa.cache.nodes);
+	spftree->lfa.cache.digest = digest;
+
 	return 0;
 }
 
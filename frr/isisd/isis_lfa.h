@@ -146,6 +146,7 @@ bool isis_lfa_excise_node_check(const struct isis_spftree *spftree,
 				const uint8_t *id);
 struct isis_spftree *isis_spf_reverse_run(const struct isis_spftree *spftree);
 int isis_spf_run_neighbors(struct isis_spftree *spftree);
+void isis_lfa_cache_save(struct isis_spftree *spftree);
 int isis_rlfa_activate(struct isis_spftree *spftree, struct rlfa *rlfa,
 		       struct zapi_rlfa_response *response);
 void isis_rlfa_deactivate(struct isis_spftree *spftree, struct rlfa *rlfa);
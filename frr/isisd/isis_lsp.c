@@ -288,7 +288,8 @@ static void lsp_add_auth(struct isis_lsp *lsp)
 	isis_tlvs_add_auth(lsp->tlvs, passwd);
 }
 
-static void lsp_pack_pdu(struct isis_lsp *lsp)
+/* Serialize the header and TLVs, leaving the checksum as it was */
+static void lsp_pack_tlvs(struct isis_lsp *lsp)
 {
 	if (!lsp->tlvs)
 		lsp->tlvs = isis_alloc_tlvs();
@@ -300,6 +301,11 @@ static void lsp_pack_pdu(struct isis_lsp *lsp)
 	isis_pack_tlvs(lsp->tlvs, lsp->pdu, len_pointer, false, true);
 
 	lsp->hdr.pdu_len = stream_get_endp(lsp->pdu);
+}
+
+static void lsp_pack_pdu(struct isis_lsp *lsp)
+{
+	lsp_pack_tlvs(lsp);
 	lsp->hdr.checksum =
 		ntohs(fletcher_checksum(STREAM_DATA(lsp->pdu) + 12,
 					stream_get_endp(lsp->pdu) - 12, 12));
@@ -1443,7 +1449,8 @@ static void lsp_build(struct isis_lsp *lsp, struct isis_area *area)
 	lsp->tlvs = NULL;
 
 	lsp_adjust_stream(lsp);
-	lsp_pack_pdu(lsp);
+	/* Only measured: the checksum is of the LSP as last sent */
+	lsp_pack_tlvs(lsp);
 	size_t tlv_space = STREAM_WRITEABLE(lsp->pdu) - LLC_LEN;
 	lsp_clear_data(lsp);
 
@@ -1572,16 +1579,111 @@ int lsp_generate(struct isis_area *area, int level)
 	return ISIS_OK;
 }
 
+/* Own fragments as last sent, from the LSP ID on: what the checksum covers */
+struct lsp_snapshot {
+	uint8_t *data[256];
+	size_t len[256];
+};
+
+static void lsp_snapshot_add(struct lsp_snapshot *snap, struct isis_lsp *lsp)
+{
+	uint8_t frag = LSP_FRAGMENT(lsp->hdr.lsp_id);
+	size_t len = stream_get_endp(lsp->pdu);
+
+	if (!lsp->tlvs || len <= 12)
+		return;
+
+	snap->len[frag] = len - 12;
+	snap->data[frag] = XMALLOC(MTYPE_TMP, len - 12);
+	memcpy(snap->data[frag], STREAM_DATA(lsp->pdu) + 12, len - 12);
+}
+
+static struct lsp_snapshot *lsp_snapshot_take(struct isis_lsp *lsp0)
+{
+	struct lsp_snapshot *snap = XCALLOC(MTYPE_TMP, sizeof(*snap));
+	struct isis_lsp *frag;
+	struct listnode *node;
+
+	lsp_snapshot_add(snap, lsp0);
+	for (ALL_LIST_ELEMENTS_RO(lsp0->lspu.frags, node, frag))
+		lsp_snapshot_add(snap, frag);
+	return snap;
+}
+
+static void lsp_snapshot_free(struct lsp_snapshot **snap)
+{
+	unsigned int i;
+
+	if (!*snap)
+		return;
+	for (i = 0; i < array_size((*snap)->data); i++)
+		XFREE(MTYPE_TMP, (*snap)->data[i]);
+	XFREE(MTYPE_TMP, *snap);
+}
+
+/*
+ * Pack a rebuilt fragment with its current sequence number: unchanged, it
+ * comes out byte for byte as sent, checksum included
+ */
+static bool lsp_snapshot_same(struct lsp_snapshot *snap, struct isis_lsp *lsp)
+{
+	uint8_t frag = LSP_FRAGMENT(lsp->hdr.lsp_id);
+
+	if (!snap || !snap->data[frag])
+		return false;
+
+	lsp_pack_tlvs(lsp);
+	return stream_get_endp(lsp->pdu) == snap->len[frag] + 12 &&
+	       !memcmp(STREAM_DATA(lsp->pdu) + 12, snap->data[frag],
+		       snap->len[frag]);
+}
+
+/*
+ * A fragment is sent again with a new sequence number if its content
+ * changed or if it would not last until the next regeneration with half
+ * the margin a refresh leaves; otherwise it stays as it is, in the LSPDB
+ * and at the neighbors. Returns true if sent again.
+ */
+static bool lsp_regenerate_frag(struct isis_lsp *lsp,
+				struct lsp_snapshot *snap,
+				uint16_t rem_lifetime, uint16_t refresh_time)
+{
+	struct isis_area *area = lsp->area;
+
+	lsp->hdr.lsp_bits = lsp_bits_generate(lsp->level, area->overload_bit,
+					      area->attached_bit_send, area);
+
+	if (lsp->hdr.rem_lifetime >=
+		    refresh_time + (rem_lifetime - refresh_time) / 2 &&
+	    lsp_snapshot_same(snap, lsp))
+		return false;
+
+	/* Set the lifetime values of all the fragments to the same value, so
+	 * that no fragment expires before the lsp is refreshed.
+	 */
+	lsp->hdr.rem_lifetime = rem_lifetime;
+	lsp->age_out = ZERO_AGE_LIFETIME;
+	lsp_inc_seqno(lsp, 0);
+	lsp_flood(lsp, NULL);
+	return true;
+}
+
 /*
  * Search own LSPs, update holding time and flood
+ *
+ * Unless full, for a periodic refresh, only the fragments whose content
+ * changed are sent again: a metric moving on one link floods one
+ * fragment, not the whole LSP.
  */
-static int lsp_regenerate(struct isis_area *area, int level)
+static int lsp_regenerate(struct isis_area *area, int level, bool full)
 {
 	struct lspdb_head *head;
 	struct isis_lsp *lsp, *frag;
 	struct listnode *node;
+	struct lsp_snapshot *snap = NULL;
 	uint8_t lspid[ISIS_SYS_ID_LEN + 2];
 	uint16_t rem_lifetime, refresh_time;
+	unsigned int sent = 0, kept = 0;
 
 	if ((area == NULL) || (area->is_type & level) != level)
 		return ISIS_ERROR;
@@ -1599,45 +1701,46 @@ static int lsp_regenerate(struct isis_area *area, int level)
 		return ISIS_ERROR;
 	}
 
+	rem_lifetime = lsp_rem_lifetime(area, level);
+	refresh_time = lsp_refresh_time(lsp, rem_lifetime);
+	if (!full)
+		snap = lsp_snapshot_take(lsp);
+
 	lsp_clear_data(lsp);
 	lsp_build(lsp, area);
-	rem_lifetime = lsp_rem_lifetime(area, level);
-	lsp->hdr.rem_lifetime = rem_lifetime;
 	lsp->last_generated = time(NULL);
-	lsp_flood(lsp, NULL);
 	area->lsp_gen_count[level - 1]++;
+
+	if (lsp_regenerate_frag(lsp, snap, rem_lifetime, refresh_time))
+		sent++;
+	else
+		kept++;
 	for (ALL_LIST_ELEMENTS_RO(lsp->lspu.frags, node, frag)) {
-		if (!frag->tlvs) {
-			/* Updating and flooding should only affect fragments
-			 * carrying data
+		if (frag->tlvs) {
+			if (lsp_regenerate_frag(frag, snap, rem_lifetime,
+						refresh_time))
+				sent++;
+			else
+				kept++;
+		} else if (frag->hdr.rem_lifetime) {
+			/* Purge should only be applied when the fragment has
+			 * non-zero remaining lifetime.
 			 */
-			continue;
+			lsp_purge(frag, level, NULL);
 		}
-
-		frag->hdr.lsp_bits =
-			lsp_bits_generate(level, area->overload_bit,
-					  area->attached_bit_send, area);
-		/* Set the lifetime values of all the fragments to the same
-		 * value,
-		 * so that no fragment expires before the lsp is refreshed.
-		 */
-		frag->hdr.rem_lifetime = rem_lifetime;
-		frag->age_out = ZERO_AGE_LIFETIME;
-		lsp_flood(frag, NULL);
 	}
-	lsp_seqno_update(lsp);
+	lsp_snapshot_free(&snap);
 
-	refresh_time = lsp_refresh_time(lsp, rem_lifetime);
 	event_add_timer(master, lsp_refresh, &area->lsp_refresh_arg[level - 1],
 			refresh_time, &area->t_lsp_refresh[level - 1]);
 	area->lsp_regenerate_pending[level - 1] = 0;
 
 	if (IS_DEBUG_UPDATE_PACKETS) {
 		zlog_debug(
-			"ISIS-Upd (%s): Refreshed our L%d LSP %pLS, len %hu, seq 0x%08x, cksum 0x%04hx, lifetime %hus refresh %hus",
+			"ISIS-Upd (%s): Refreshed our L%d LSP %pLS, len %hu, seq 0x%08x, cksum 0x%04hx, lifetime %hus refresh %hus, %u fragments sent, %u unchanged",
 			area->area_tag, level, lsp->hdr.lsp_id,
 			lsp->hdr.pdu_len, lsp->hdr.seqno, lsp->hdr.checksum,
-			lsp->hdr.rem_lifetime, refresh_time);
+			lsp->hdr.rem_lifetime, refresh_time, sent, kept);
 	}
 	sched_debug(
 		"ISIS (%s): Rebuilt L%d LSP. Set triggered regenerate to non-pending.",
@@ -1660,6 +1763,8 @@ static void lsp_refresh(struct event *thread)
 	assert(area);
 
 	int level = arg->level;
+	/* Not scheduled by a change: the refresh timer */
+	bool full = !area->lsp_regenerate_pending[level - 1];
 
 	area->t_lsp_refresh[level - 1] = NULL;
 	area->lsp_regenerate_pending[level - 1] = 0;
@@ -1684,7 +1789,7 @@ static void lsp_refresh(struct event *thread)
 	sched_debug(
 		"ISIS (%s): LSP L%d refresh timer expired. Refreshing LSP...",
 		area->area_tag, level);
-	lsp_regenerate(area, level);
+	lsp_regenerate(area, level, full);
 }
 
 int _lsp_regenerate_schedule(struct isis_area *area, int level,
@@ -27,6 +27,7 @@
 #include "srcdest_table.h"
 #include "vrf.h"
 #include "lib/json.h"
+#include "frrcu.h"
 
 #include "isis_errors.h"
 #include "isis_constants.h"
@@ -54,6 +55,7 @@ DEFINE_MTYPE_STATIC(ISISD, ISIS_SPF_RUN,    "ISIS SPF Run Info");
 DEFINE_MTYPE_STATIC(ISISD, ISIS_SPF_ADJ,    "ISIS SPF Adjacency");
 DEFINE_MTYPE_STATIC(ISISD, ISIS_VERTEX,     "ISIS vertex");
 DEFINE_MTYPE_STATIC(ISISD, ISIS_VERTEX_ADJ, "ISIS SPF Vertex Adjacency");
+DEFINE_MTYPE_STATIC(ISISD, ISIS_VERTEX_HEAP, "ISIS SPF TENT heap");
 
 static void spf_adj_list_parse_lsp(struct isis_spftree *spftree,
 				   struct list *adj_list, struct isis_lsp *lsp,
@@ -249,6 +251,21 @@ void isis_vertex_del(struct isis_vertex *vertex)
 	XFREE(MTYPE_ISIS_VERTEX, vertex);
 }
 
+/* A size of zero releases the array; the heap must be empty by then */
+void isis_vertex_heap_resize(struct isis_vertex_heap *heap, uint32_t size)
+{
+	if (!size) {
+		XFREE(MTYPE_ISIS_VERTEX_HEAP, heap->array);
+		heap->count = heap->size = 0;
+		return;
+	}
+
+	assert(size >= heap->count);
+	heap->array = XREALLOC(MTYPE_ISIS_VERTEX_HEAP, heap->array,
+			       size * sizeof(*heap->array));
+	heap->size = size;
+}
+
 struct isis_vertex_adj *
 isis_vertex_adj_add(struct isis_spftree *spftree, struct isis_vertex *vertex,
 		    struct list *vadj_list, struct isis_spf_adj *sadj,
@@ -390,6 +407,7 @@ static void _isis_spftree_del(struct isis_spftree *spftree)
 		isis_spf_node_list_clear(&spftree->lfa.p_space);
 	}
 	isis_spf_node_list_clear(&spftree->adj_nodes);
+	isis_spf_node_list_clear(&spftree->lfa.cache.nodes);
 	list_delete(&spftree->sadj_list);
 	isis_vertex_queue_free(&spftree->tents);
 	isis_vertex_queue_free(&spftree->paths);
@@ -1628,16 +1646,25 @@ static void add_to_paths(struct isis_spftree *spftree,
 #endif /* EXTREME_DEBUG */
 }
 
-static void init_spt(struct isis_spftree *spftree, int mtid)
+/* Talks to zebra, so it is for the main thread only */
+static void isis_spf_release_rlfas(struct isis_spftree *spftree)
+{
+	isis_zebra_rlfa_unregister_all(spftree);
+	isis_rlfa_list_clear(spftree);
+}
+
+static void init_spt(struct isis_spftree *spftree, int mtid,
+		     bool rlfas_released)
 {
 	/* Clear data from previous run. */
 	hash_clean(spftree->prefix_sids, NULL);
+	isis_lfa_cache_save(spftree);
 	isis_spf_node_list_clear(&spftree->adj_nodes);
 	list_delete_all_node(spftree->sadj_list);
 	isis_vertex_queue_clear(&spftree->tents);
 	isis_vertex_queue_clear(&spftree->paths);
-	isis_zebra_rlfa_unregister_all(spftree);
-	isis_rlfa_list_clear(spftree);
+	if (!rlfas_released)
+		isis_spf_release_rlfas(spftree);
 	list_delete_all_node(spftree->lfa.remote.pc_spftrees);
 	memset(&spftree->lfa.protection_counters, 0,
 	       sizeof(spftree->lfa.protection_counters));
@@ -1862,7 +1889,7 @@ struct isis_spftree *isis_run_hopcount_spf(struct isis_area *area,
 			SPFTREE_IPV4, SPF_TYPE_FORWARD,
 			F_SPFTREE_HOPCOUNT_METRIC, SR_ALGORITHM_SPF);
 
-	init_spt(spftree, ISIS_MT_IPV4_UNICAST);
+	init_spt(spftree, ISIS_MT_IPV4_UNICAST, false);
 	if (!memcmp(sysid, area->isis->sysid, ISIS_SYS_ID_LEN)) {
 		struct isis_lsp *root_lsp;
 		struct isis_vertex *root_vertex;
@@ -1889,7 +1916,8 @@ struct isis_spftree *isis_run_hopcount_spf(struct isis_area *area,
 	return spftree;
 }
 
-void isis_run_spf(struct isis_spftree *spftree)
+static void isis_run_spf_tree(struct isis_spftree *spftree,
+			      bool rlfas_released)
 {
 	struct isis_lsp *root_lsp;
 	struct isis_vertex *root_vertex;
@@ -1969,7 +1997,7 @@ void isis_run_spf(struct isis_spftree *spftree)
 	/*
 	 * C.2.5 Step 0
 	 */
-	init_spt(spftree, mtid);
+	init_spt(spftree, mtid, rlfas_released);
 	/*              a) */
 	root_vertex = isis_spf_add_root(spftree);
 	/*              b) */
@@ -2006,6 +2034,20 @@ out:
 		+ (time_end.tv_usec - time_start.tv_usec);
 }
 
+void isis_run_spf(struct isis_spftree *spftree)
+{
+	isis_run_spf_tree(spftree, false);
+}
+
+static void isis_spf_protect(struct isis_area *area,
+			     struct isis_spftree *spftree)
+{
+	/* Run LFA protection if configured. */
+	if (area->lfa_protected_links[spftree->level - 1] > 0
+	    || area->tilfa_protected_links[spftree->level - 1] > 0)
+		isis_spf_run_lfa(area, spftree);
+}
+
 static void isis_run_spf_with_protection(struct isis_area *area,
 					 struct isis_spftree *spftree)
 {
@@ -2013,10 +2055,80 @@ static void isis_run_spf_with_protection(struct isis_area *area,
 	memcpy(spftree->sysid, area->isis->sysid, ISIS_SYS_ID_LEN);
 	isis_run_spf(spftree);
 
-	/* Run LFA protection if configured. */
-	if (area->lfa_protected_links[spftree->level - 1] > 0
-	    || area->tilfa_protected_links[spftree->level - 1] > 0)
-		isis_spf_run_lfa(area, spftree);
+	isis_spf_protect(area, spftree);
+}
+
+/*
+ * The IPv4, IPv6 and dst-src trees of a level only read the LSPDB and each
+ * fills its own route table, so they can be computed side by side. What
+ * follows them, route verification, LFA and everything that talks to zebra,
+ * stays on the main thread. Flex-algo trees may reschedule LSP generation
+ * from within isis_run_spf(), and are left out.
+ */
+struct isis_spf_worker {
+	pthread_t thread;
+	struct rcu_thread *rcu_thread;
+	struct isis_spftree *spftree;
+	bool started;
+};
+
+static void *isis_spf_worker_run(void *arg)
+{
+	struct isis_spf_worker *worker = arg;
+
+	rcu_thread_start(worker->rcu_thread);
+	/* rcu_thread_start() leaves us in RCU-held state */
+	rcu_read_unlock();
+
+	isis_run_spf_tree(worker->spftree, true);
+	return NULL;
+}
+
+static void isis_run_spf_parallel(struct isis_area *area,
+				  struct isis_spftree **trees, int count)
+{
+	struct isis_spf_worker workers[SPFTREE_COUNT] = {};
+	sigset_t oldsigs, blocksigs;
+	bool parallel;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		memcpy(trees[i]->sysid, area->isis->sysid, ISIS_SYS_ID_LEN);
+		isis_spf_release_rlfas(trees[i]);
+	}
+
+	/* Debug output shares static buffers, keep it in order */
+	parallel = count > 1 && !IS_DEBUG_SPF_EVENTS;
+
+	/* signals are for the main thread to handle */
+	if (parallel) {
+		sigfillset(&blocksigs);
+		pthread_sigmask(SIG_BLOCK, &blocksigs, &oldsigs);
+	}
+
+	/* The first tree is computed here while the others are on workers */
+	for (i = 1; parallel && i < count; i++) {
+		workers[i].spftree = trees[i];
+		workers[i].rcu_thread = rcu_thread_prepare();
+		if (pthread_create(&workers[i].thread, NULL,
+				   isis_spf_worker_run, &workers[i])) {
+			rcu_thread_unprepare(workers[i].rcu_thread);
+			continue;
+		}
+		workers[i].started = true;
+	}
+
+	if (parallel)
+		pthread_sigmask(SIG_SETMASK, &oldsigs, NULL);
+
+	for (i = 0; i < count; i++) {
+		if (i == 0 || !workers[i].started)
+			isis_run_spf_tree(trees[i], true);
+	}
+
+	for (i = 1; i < count; i++)
+		if (workers[i].started)
+			pthread_join(workers[i].thread, NULL);
 }
 
 void isis_spf_verify_routes(struct isis_area *area, struct isis_spftree **trees,
@@ -2068,6 +2180,8 @@ static void isis_run_spf_cb(struct event *thread)
 	struct isis_area *area = run->area;
 	int level = run->level;
 	int have_run = 0;
+	struct isis_spftree *trees[SPFTREE_COUNT];
+	int ntrees = 0;
 	struct listnode *node;
 	struct isis_circuit *circuit;
 #ifndef FABRICD
@@ -2091,37 +2205,30 @@ static void isis_run_spf_cb(struct event *thread)
 		zlog_debug("ISIS-SPF (%s) L%d SPF needed, periodic SPF",
 			   area->area_tag, level);
 
-	if (area->ip_circuits) {
-		isis_run_spf_with_protection(
-			area, area->spftree[SPFTREE_IPV4][level - 1]);
+	if (area->ip_circuits)
+		trees[ntrees++] = area->spftree[SPFTREE_IPV4][level - 1];
+	if (area->ipv6_circuits)
+		trees[ntrees++] = area->spftree[SPFTREE_IPV6][level - 1];
+	if (area->ipv6_circuits && isis_area_ipv6_dstsrc_enabled(area))
+		trees[ntrees++] = area->spftree[SPFTREE_DSTSRC][level - 1];
+
+	isis_run_spf_parallel(area, trees, ntrees);
+	for (int i = 0; i < ntrees; i++)
+		isis_spf_protect(area, trees[i]);
+	if (ntrees)
+		have_run = 1;
+
 #ifndef FABRICD
-		for (ALL_LIST_ELEMENTS_RO(area->flex_algos->flex_algos, node,
-					  fa)) {
-			data = fa->data;
+	for (ALL_LIST_ELEMENTS_RO(area->flex_algos->flex_algos, node, fa)) {
+		data = fa->data;
+		if (area->ip_circuits)
 			isis_run_spf_with_protection(
 				area, data->spftree[SPFTREE_IPV4][level - 1]);
-		}
-#endif /* ifndef FABRICD */
-		have_run = 1;
-	}
-	if (area->ipv6_circuits) {
-		isis_run_spf_with_protection(
-			area, area->spftree[SPFTREE_IPV6][level - 1]);
-#ifndef FABRICD
-		for (ALL_LIST_ELEMENTS_RO(area->flex_algos->flex_algos, node,
-					  fa)) {
-			data = fa->data;
+		if (area->ipv6_circuits)
 			isis_run_spf_with_protection(
 				area, data->spftree[SPFTREE_IPV6][level - 1]);
-		}
-#endif /* ifndef FABRICD */
-		have_run = 1;
-	}
-	if (area->ipv6_circuits && isis_area_ipv6_dstsrc_enabled(area)) {
-		isis_run_spf_with_protection(
-			area, area->spftree[SPFTREE_DSTSRC][level - 1]);
-		have_run = 1;
 	}
+#endif /* ifndef FABRICD */
 
 	if (have_run)
 		area->spf_run_count[level]++;
@@ -12,7 +12,6 @@
 
 #include "hash.h"
 #include "jhash.h"
-#include "skiplist.h"
 #include "lib_errors.h"
 
 enum vertextype {
@@ -63,15 +62,30 @@ struct isis_vertex {
 	struct list *parents;  /* list of parents for ECMP */
 	struct hash *firsthops; /* first two hops to neighbor */
 	uint64_t insert_counter;
+	uint32_t heap_index;	/* Position in an ordered queue */
 	uint8_t flags;
 };
 #define F_ISIS_VERTEX_LFA_PROTECTED	0x01
 
 /* Vertex Queue and associated functions */
 
+/*
+ * Ordered queues (TENT) are a 4-ary min-heap kept in an array, with every
+ * vertex knowing its position so that it can be moved or removed without a
+ * search. Four children to a node keep the heap shallow and the children
+ * of a node within one or two cache lines.
+ */
+#define ISIS_VERTEX_HEAP_ARITY 4
+
+struct isis_vertex_heap {
+	struct isis_vertex **array;
+	uint32_t count;
+	uint32_t size;
+};
+
 struct isis_vertex_queue {
 	union {
-		struct skiplist *slist;
+		struct isis_vertex_heap heap;
 		struct list *list;
 	} l;
 	struct hash *hash;
@@ -145,10 +159,55 @@ __attribute__((__unused__)) static int isis_vertex_queue_tent_cmp(const void *a,
 	return 0;
 }
 
+void isis_vertex_heap_resize(struct isis_vertex_heap *heap, uint32_t size);
+
 __attribute__((__unused__))
-static struct skiplist *isis_vertex_queue_skiplist(void)
+static void isis_vertex_heap_set(struct isis_vertex_heap *heap, uint32_t i,
+				 struct isis_vertex *vertex)
 {
-	return skiplist_new(0, isis_vertex_queue_tent_cmp, NULL);
+	heap->array[i] = vertex;
+	vertex->heap_index = i;
+}
+
+__attribute__((__unused__))
+static void isis_vertex_heap_up(struct isis_vertex_heap *heap, uint32_t i)
+{
+	struct isis_vertex *vertex = heap->array[i];
+	uint32_t parent;
+
+	while (i) {
+		parent = (i - 1) / ISIS_VERTEX_HEAP_ARITY;
+		if (isis_vertex_queue_tent_cmp(vertex, heap->array[parent]) >= 0)
+			break;
+		isis_vertex_heap_set(heap, i, heap->array[parent]);
+		i = parent;
+	}
+	isis_vertex_heap_set(heap, i, vertex);
+}
+
+__attribute__((__unused__))
+static void isis_vertex_heap_down(struct isis_vertex_heap *heap, uint32_t i)
+{
+	struct isis_vertex *vertex = heap->array[i];
+	uint32_t child, last, min;
+
+	for (;;) {
+		child = i * ISIS_VERTEX_HEAP_ARITY + 1;
+		if (child >= heap->count)
+			break;
+
+		last = MIN(child + ISIS_VERTEX_HEAP_ARITY, heap->count);
+		for (min = child++; child < last; child++)
+			if (isis_vertex_queue_tent_cmp(heap->array[child],
+						       heap->array[min]) < 0)
+				min = child;
+
+		if (isis_vertex_queue_tent_cmp(heap->array[min], vertex) >= 0)
+			break;
+		isis_vertex_heap_set(heap, i, heap->array[min]);
+		i = min;
+	}
+	isis_vertex_heap_set(heap, i, vertex);
 }
 
 __attribute__((__unused__))
@@ -157,7 +216,7 @@ static void isis_vertex_queue_init(struct isis_vertex_queue *queue,
 {
 	if (ordered) {
 		queue->insert_counter = 1;
-		queue->l.slist = isis_vertex_queue_skiplist();
+		memset(&queue->l.heap, 0, sizeof(queue->l.heap));
 	} else {
 		queue->insert_counter = 0;
 		queue->l.list = list_new();
@@ -183,12 +242,10 @@ static void isis_vertex_queue_clear(struct isis_vertex_queue *queue)
 	hash_clean(queue->hash, NULL);
 
 	if (queue->insert_counter) {
-		struct isis_vertex *vertex;
-		while (0 == skiplist_first(queue->l.slist, NULL,
-					   (void **)&vertex)) {
-			isis_vertex_del(vertex);
-			skiplist_delete_first(queue->l.slist);
-		}
+		struct isis_vertex_heap *heap = &queue->l.heap;
+
+		while (heap->count)
+			isis_vertex_del(heap->array[--heap->count]);
 		queue->insert_counter = 1;
 	} else {
 		queue->l.list->del = (void (*)(void *))isis_vertex_del;
@@ -205,10 +262,9 @@ static void isis_vertex_queue_free(struct isis_vertex_queue *queue)
 	hash_free(queue->hash);
 	queue->hash = NULL;
 
-	if (queue->insert_counter) {
-		skiplist_free(queue->l.slist);
-		queue->l.slist = NULL;
-	} else
+	if (queue->insert_counter)
+		isis_vertex_heap_resize(&queue->l.heap, 0);
+	else
 		list_delete(&queue->l.list);
 }
 
@@ -247,11 +303,16 @@ __attribute__((__unused__))
 static void isis_vertex_queue_insert(struct isis_vertex_queue *queue,
 				     struct isis_vertex *vertex)
 {
+	struct isis_vertex_heap *heap = &queue->l.heap;
+
 	assert(queue->insert_counter);
 	vertex->insert_counter = queue->insert_counter++;
 	assert(queue->insert_counter != (uint64_t)-1);
 
-	skiplist_insert(queue->l.slist, vertex, vertex);
+	if (heap->count == heap->size)
+		isis_vertex_heap_resize(heap, heap->size ? heap->size * 2 : 64);
+	heap->array[heap->count] = vertex;
+	isis_vertex_heap_up(heap, heap->count++);
 
 	struct isis_vertex *inserted;
 	inserted = hash_get(queue->hash, vertex, hash_alloc_intern);
@@ -264,12 +325,17 @@ isis_vertex_queue_pop(struct isis_vertex_queue *queue)
 {
 	assert(queue->insert_counter);
 
+	struct isis_vertex_heap *heap = &queue->l.heap;
 	struct isis_vertex *rv;
 
-	if (skiplist_first(queue->l.slist, NULL, (void **)&rv))
+	if (!heap->count)
 		return NULL;
 
-	skiplist_delete_first(queue->l.slist);
+	rv = heap->array[0];
+	if (--heap->count) {
+		heap->array[0] = heap->array[heap->count];
+		isis_vertex_heap_down(heap, 0);
+	}
 	hash_release(queue->hash, rv);
 
 	return rv;
@@ -279,9 +345,19 @@ __attribute__((__unused__))
 static void isis_vertex_queue_delete(struct isis_vertex_queue *queue,
 				     struct isis_vertex *vertex)
 {
+	struct isis_vertex_heap *heap = &queue->l.heap;
+	uint32_t i = vertex->heap_index;
+
 	assert(queue->insert_counter);
+	assert(i < heap->count && heap->array[i] == vertex);
+
+	if (i != --heap->count) {
+		struct isis_vertex *moved = heap->array[heap->count];
 
-	skiplist_delete(queue->l.slist, vertex, vertex);
+		heap->array[i] = moved;
+		isis_vertex_heap_up(heap, i);
+		isis_vertex_heap_down(heap, moved->heap_index);
+	}
 	hash_release(queue->hash, vertex);
 }
 
@@ -340,6 +416,15 @@ struct isis_spftree {
 			uint32_t max_metric;
 		} remote;
 
+		/*
+		 * Forward and reverse SPTs of the neighbors from the previous
+		 * run, and a digest of the LSPDB they were computed from.
+		 */
+		struct {
+			struct isis_spf_nodes nodes;
+			uint64_t digest;
+		} cache;
+
 		/* Protection counters. */
 		struct {
 			uint32_t lfa[SPF_PREFIX_PRIO_MAX];
@@ -55,6 +55,7 @@ static bool		 lde_fec_connected(const struct fec_node *);
 static bool		 lde_fec_outside_mpls_network(const struct fec_node *);
 static void		 lde_check_filter_af(int, struct ldpd_af_conf *,
 			     const char *);
+static void		 lde_map_batch_flush(struct lde_nbr *);
 
 RB_GENERATE(nbr_tree, lde_nbr, entry, lde_nbr_compare)
 RB_GENERATE(lde_map_head, lde_map, entry, lde_map_compare)
@@ -65,6 +66,11 @@ struct nbr_tree		 lde_nbrs = RB_INITIALIZER(&lde_nbrs);
 static struct imsgev	*iev_ldpe;
 static struct imsgev    iev_main_sync_data;
 static struct imsgev	*iev_main, *iev_main_sync;
+static struct event	*lde_map_batch_ev;
+
+/* label messages that fit in one imsg */
+#define LDE_MAP_BATCH_MAX \
+	((MAX_IMSGSIZE - IMSG_HEADER_SIZE) / sizeof(struct map))
 
 /* lde privileges */
 static zebra_capabilities_t _caps_p [] =
@@ -188,6 +194,7 @@ lde_shutdown(void)
 	iev_main_sync->ibuf.fd = -1;
 
 	lde_gc_stop_timer();
+	EVENT_OFF(lde_map_batch_ev);
 	lde_nbr_clear();
 	fec_tree_clear();
 
@@ -221,12 +228,107 @@ lde_imsg_compose_parent_sync(int type, pid_t pid, void *data, uint16_t datalen)
 	imsg_flush(&iev_main_sync->ibuf);
 }
 
+static int
+lde_map_batch_end_type(int type)
+{
+	switch (type) {
+	case IMSG_MAPPING_ADD:
+		return (IMSG_MAPPING_ADD_END);
+	case IMSG_RELEASE_ADD:
+		return (IMSG_RELEASE_ADD_END);
+	case IMSG_REQUEST_ADD:
+		return (IMSG_REQUEST_ADD_END);
+	case IMSG_WITHDRAW_ADD:
+		return (IMSG_WITHDRAW_ADD_END);
+	default:
+		return (-1);
+	}
+}
+
+static void
+lde_map_batch_flush(struct lde_nbr *ln)
+{
+	if (ln->batch_cnt) {
+		imsg_compose_event(iev_ldpe, ln->batch_type, ln->peerid, 0,
+		    -1, ln->batch, ln->batch_cnt * sizeof(struct map));
+		ln->batch_cnt = 0;
+	}
+	if (ln->batch_end) {
+		imsg_compose_event(iev_ldpe,
+		    lde_map_batch_end_type(ln->batch_type), ln->peerid, 0,
+		    -1, NULL, 0);
+		ln->batch_end = false;
+	}
+}
+
+static void
+lde_map_batch_flush_all(struct event *thread)
+{
+	struct lde_nbr		*ln;
+
+	RB_FOREACH(ln, nbr_tree, &lde_nbrs)
+		lde_map_batch_flush(ln);
+}
+
+/*
+ * Label mappings, withdraws, releases and requests to a neighbor are held
+ * back until the end of the event, or until another kind of message is
+ * sent to it, and go to ldpe as a few imsgs of many maps. The *_ADD_END
+ * that each FEC's update would send is held back as well, so ldpe packs
+ * the messages of a burst of FEC changes into full PDUs instead of
+ * sending one PDU per FEC.
+ */
 int
 lde_imsg_compose_ldpe(int type, uint32_t peerid, pid_t pid, void *data,
     uint16_t datalen)
 {
+	struct lde_nbr		*ln = NULL;
+
 	if (iev_ldpe->ibuf.fd == -1)
 		return (0);
+
+	if (peerid)
+		ln = lde_nbr_find(peerid);
+	if (ln == NULL)
+		return (imsg_compose_event(iev_ldpe, type, peerid, pid,
+		     -1, data, datalen));
+
+	switch (type) {
+	case IMSG_MAPPING_ADD:
+	case IMSG_RELEASE_ADD:
+	case IMSG_REQUEST_ADD:
+	case IMSG_WITHDRAW_ADD:
+		if ((ln->batch_cnt || ln->batch_end) && ln->batch_type != type)
+			lde_map_batch_flush(ln);
+		if (ln->batch == NULL &&
+		    (ln->batch = calloc(LDE_MAP_BATCH_MAX,
+		    sizeof(struct map))) == NULL)
+			fatal(__func__);
+
+		ln->batch_type = type;
+		memcpy(&ln->batch[ln->batch_cnt++], data, sizeof(struct map));
+		if (ln->batch_cnt == LDE_MAP_BATCH_MAX)
+			lde_map_batch_flush(ln);
+
+		event_add_event(master, lde_map_batch_flush_all, NULL, 0,
+		    &lde_map_batch_ev);
+		return (0);
+	case IMSG_MAPPING_ADD_END:
+	case IMSG_RELEASE_ADD_END:
+	case IMSG_REQUEST_ADD_END:
+	case IMSG_WITHDRAW_ADD_END:
+		if (ln->batch_cnt &&
+		    lde_map_batch_end_type(ln->batch_type) == type) {
+			ln->batch_end = true;
+			return (0);
+		}
+		break;
+	default:
+		break;
+	}
+
+	/* anything else to the neighbor goes after what is held back */
+	lde_map_batch_flush(ln);
 	return (imsg_compose_event(iev_ldpe, type, peerid, pid,
 	     -1, data, datalen));
 }
@@ -1503,6 +1605,7 @@ lde_nbr_del(struct lde_nbr *ln)
 
 	RB_REMOVE(nbr_tree, &lde_nbrs, ln);
 
+	free(ln->batch);
 	free(ln);
 }
 
@@ -87,6 +87,12 @@ struct lde_nbr {
 	struct fec_tree		 sent_map_pending;
 	struct fec_tree		 sent_wdraw;
 	TAILQ_HEAD(, lde_addr)	 addr_list;
+
+	/* label messages held back for ldpe, see lde_imsg_compose_ldpe() */
+	struct map		*batch;
+	uint16_t		 batch_cnt;
+	int			 batch_type;
+	bool			 batch_end;
 };
 RB_HEAD(nbr_tree, lde_nbr);
 RB_PROTOTYPE(nbr_tree, lde_nbr, entry, lde_nbr_compare)
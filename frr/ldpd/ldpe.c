@@ -614,6 +614,7 @@ static void ldpe_dispatch_lde(struct event *thread)
 	struct map		*map;
 	struct notify_msg	*nm;
 	struct nbr		*nbr;
+	size_t			 len;
 	int			 n, shut = 0;
 
 	iev->ev_read = NULL;
@@ -634,9 +635,10 @@ static void ldpe_dispatch_lde(struct event *thread)
 		case IMSG_RELEASE_ADD:
 		case IMSG_REQUEST_ADD:
 		case IMSG_WITHDRAW_ADD:
-			if (imsg.hdr.len - IMSG_HEADER_SIZE != sizeof(struct map))
+			/* lde sends any number of maps in one imsg */
+			len = imsg.hdr.len - IMSG_HEADER_SIZE;
+			if (len == 0 || len % sizeof(struct map) != 0)
 				fatalx("invalid size of map request");
-			map = imsg.data;
 
 			nbr = nbr_find_peerid(imsg.hdr.peerid);
 			if (nbr == NULL)
@@ -644,19 +646,25 @@ static void ldpe_dispatch_lde(struct event *thread)
 			if (nbr->state != NBR_STA_OPER)
 				break;
 
-			switch (imsg.hdr.type) {
-			case IMSG_MAPPING_ADD:
-				mapping_list_add(&nbr->mapping_list, map);
-				break;
-			case IMSG_RELEASE_ADD:
-				mapping_list_add(&nbr->release_list, map);
-				break;
-			case IMSG_REQUEST_ADD:
-				mapping_list_add(&nbr->request_list, map);
-				break;
-			case IMSG_WITHDRAW_ADD:
-				mapping_list_add(&nbr->withdraw_list, map);
-				break;
+			for (map = imsg.data; len; map++, len -= sizeof(*map)) {
+				switch (imsg.hdr.type) {
+				case IMSG_MAPPING_ADD:
+					mapping_list_add(&nbr->mapping_list,
+					    map);
+					break;
+				case IMSG_RELEASE_ADD:
+					mapping_list_add(&nbr->release_list,
+					    map);
+					break;
+				case IMSG_REQUEST_ADD:
+					mapping_list_add(&nbr->request_list,
+					    map);
+					break;
+				case IMSG_WITHDRAW_ADD:
+					mapping_list_add(&nbr->withdraw_list,
+					    map);
+					break;
+				}
 			}
 			break;
 		case IMSG_MAPPING_ADD_END:
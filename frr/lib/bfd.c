@@ -68,6 +68,8 @@ struct bfd_session_params {
 	struct bfd_session_status bss;
 	/** Protocol implementation status update callback. */
 	bsp_status_update updatecb;
+	/** Echo round trip time update callback (optional). */
+	bsp_status_update rttcb;
 	/** Protocol implementation custom data pointer. */
 	void *arg;
 
@@ -140,7 +142,8 @@ static void bfd_source_cache_put(struct bfd_session_params *session);
  */
 static struct interface *bfd_get_peer_info(struct stream *s, struct prefix *dp,
 					   struct prefix *sp, int *status,
-					   int *remote_cbit, vrf_id_t vrf_id)
+					   int *remote_cbit, uint32_t *rtt_us,
+					   vrf_id_t vrf_id)
 {
 	unsigned int ifindex;
 	struct interface *ifp = NULL;
@@ -192,6 +195,11 @@ static struct interface *bfd_get_peer_info(struct stream *s, struct prefix *dp,
 	STREAM_GETC(s, local_remote_cbit);
 	if (remote_cbit)
 		*remote_cbit = local_remote_cbit;
+
+	/* Older BFD daemons do not send the echo round trip time. */
+	*rtt_us = BFD_RTT_UNKNOWN;
+	if (STREAM_READABLE(s) >= sizeof(uint32_t))
+		STREAM_GETL(s, *rtt_us);
 	return ifp;
 
 stream_failure:
@@ -423,6 +431,7 @@ struct bfd_session_params *bfd_sess_new(bsp_status_update updatecb, void *arg)
 	/* Save application data. */
 	bsp->updatecb = updatecb;
 	bsp->arg = arg;
+	bsp->bss.rtt_us = BFD_RTT_UNKNOWN;
 
 	/* Set defaults. */
 	bsp->args.detection_multiplier = BFD_DEF_DETECT_MULT;
@@ -730,6 +739,12 @@ void bfd_sess_set_auto_source(struct bfd_session_params *bsp, bool enable)
 		bfd_source_cache_put(bsp);
 }
 
+void bfd_sess_set_rtt_cb(struct bfd_session_params *bsp,
+			 bsp_status_update rttcb)
+{
+	bsp->rttcb = rttcb;
+}
+
 void bfd_sess_install(struct bfd_session_params *bsp)
 {
 	bsp->lastev = BSE_INSTALL;
@@ -747,6 +762,11 @@ enum bfd_session_state bfd_sess_status(const struct bfd_session_params *bsp)
 	return bsp->bss.state;
 }
 
+uint32_t bfd_sess_rtt(const struct bfd_session_params *bsp)
+{
+	return bsp->bss.rtt_us;
+}
+
 uint8_t bfd_sess_hop_count(const struct bfd_session_params *bsp)
 {
 	return bsp->args.hops;
@@ -907,6 +927,7 @@ int zclient_bfd_session_update(ZAPI_CALLBACK_ARGS)
 	struct interface *ifp;
 	int remote_cbit = false;
 	int state = BFD_STATUS_UNKNOWN;
+	uint32_t rtt_us = BFD_RTT_UNKNOWN;
 	time_t now;
 	size_t addrlen;
 	struct prefix dp;
@@ -921,7 +942,7 @@ int zclient_bfd_session_update(ZAPI_CALLBACK_ARGS)
 		return 0;
 
 	ifp = bfd_get_peer_info(zclient->ibuf, &dp, &sp, &state, &remote_cbit,
-				vrf_id);
+				&rtt_us, vrf_id);
 	/*
 	 * When interface lookup fails or an invalid stream is read, we must
 	 * not proceed otherwise it will trigger an assertion while checking
@@ -989,14 +1010,22 @@ int zclient_bfd_session_update(ZAPI_CALLBACK_ARGS)
 		    && memcmp(&sp.u, &i6a_zero, addrlen) != 0
 		    && memcmp(&bsp->args.src, &sp.u, addrlen) != 0)
 			continue;
-		/* No session state change. */
-		if ((int)bsp->bss.state == state)
+		/* No session state change, maybe a round trip time one. */
+		if ((int)bsp->bss.state == state) {
+			if (bsp->bss.rtt_us == rtt_us)
+				continue;
+
+			bsp->bss.rtt_us = rtt_us;
+			if (bsp->rttcb)
+				bsp->rttcb(bsp, &bsp->bss, bsp->arg);
 			continue;
+		}
 
 		bsp->bss.last_event = now;
 		bsp->bss.previous_state = bsp->bss.state;
 		bsp->bss.state = state;
 		bsp->bss.remote_cbit = remote_cbit;
+		bsp->bss.rtt_us = rtt_us;
 		bsp->updatecb(bsp, &bsp->bss, bsp->arg);
 		sessions_updated++;
 	}
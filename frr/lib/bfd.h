@@ -30,6 +30,8 @@ extern "C" {
 #define BFD_STATUS_UP         (1 << 2) /* BFD session status is up */
 #define BFD_STATUS_ADMIN_DOWN (1 << 3) /* BFD session is admin down */
 
+#define BFD_RTT_UNKNOWN UINT32_MAX /* No echo round trip time measured */
+
 #define BFD_PROFILE_NAME_LEN 64
 
 const char *bfd_get_status_str(int status);
@@ -66,6 +68,10 @@ struct bfd_session_status {
 	bool remote_cbit;
 	/** Last event occurrence. */
 	time_t last_event;
+	/**
+	 * Echo round trip time average in microseconds or `BFD_RTT_UNKNOWN`.
+	 */
+	uint32_t rtt_us;
 };
 
 /**
@@ -218,6 +224,17 @@ void bfd_sess_set_timers(struct bfd_session_params *bsp,
  */
 void bfd_sess_set_auto_source(struct bfd_session_params *bsp, bool enable);
 
+/**
+ * Registers a callback for echo round trip time updates that arrive
+ * without a session state change. State changes carry the round trip
+ * time in `bss->rtt_us` through the status update callback as usual.
+ *
+ * \param bsp BFD session parameters.
+ * \param rttcb round trip time update callback (`NULL` to disable).
+ */
+void bfd_sess_set_rtt_cb(struct bfd_session_params *bsp,
+			 bsp_status_update rttcb);
+
 /**
  * Installs or updates the BFD session based on the saved session arguments.
  *
@@ -249,6 +266,15 @@ void bfd_sess_uninstall(struct bfd_session_params *bsp);
  */
 enum bfd_session_state bfd_sess_status(const struct bfd_session_params *bsp);
 
+/**
+ * Get BFD session echo round trip time.
+ *
+ * \param bsp session parameters.
+ *
+ * \returns average in microseconds or `BFD_RTT_UNKNOWN`.
+ */
+uint32_t bfd_sess_rtt(const struct bfd_session_params *bsp);
+
 /**
  * Get BFD session amount of hops configured value.
  *
@@ -77,6 +77,7 @@ static struct c_path *cpath_copy(struct c_path *dest, const struct c_path *src)
 
 	new_path->dst = src->dst;
 	new_path->weight = src->weight;
+	new_path->delay = src->delay;
 	new_path->edges = list_dup(src->edges);
 	new_path->status = src->status;
 
@@ -370,6 +371,31 @@ void cspf_del(struct cspf *algo)
 	algo = NULL;
 }
 
+/**
+ * Get the delay of an Edge that counts against the delay bound of a path: the
+ * average delay, or the minimum one when only the latter is advertised.
+ * Measured delays reach the TED that way, as the IGPs advertise them.
+ *
+ * @param attr	Edge Attributes
+ *
+ * @return	Delay in micro-seconds, UINT32_MAX if unknown or anomalous
+ */
+static uint32_t edge_delay(const struct ls_attributes *attr)
+{
+	if (CHECK_FLAG(attr->flags, LS_ATTR_DELAY)) {
+		if (CHECK_FLAG(attr->extended.delay, TE_EXT_ANORMAL))
+			return UINT32_MAX;
+		return attr->extended.delay & TE_EXT_MASK;
+	}
+	if (CHECK_FLAG(attr->flags, LS_ATTR_MIN_MAX_DELAY)) {
+		if (CHECK_FLAG(attr->extended.min_delay, TE_EXT_ANORMAL))
+			return UINT32_MAX;
+		return attr->extended.min_delay & TE_EXT_MASK;
+	}
+
+	return UINT32_MAX;
+}
+
 /**
  * Prune Edge if constraints are not met by testing Edge Attributes against
  * given constraints and cumulative cost of the given constrained path.
@@ -385,6 +411,7 @@ static bool prune_edge(const struct c_path *path, const struct ls_edge *edge,
 {
 	struct ls_vertex *dst;
 	struct ls_attributes *attr;
+	uint32_t delay;
 
 	/* Check that Path, Edge and Constraints are valid */
 	if (!path || !edge || !csts)
@@ -443,6 +470,22 @@ static bool prune_edge(const struct c_path *path, const struct ls_edge *edge,
 		if ((attr->extended.delay + path->weight) > csts->cost)
 			return true;
 		break;
+
+	case CSPF_MIN_DELAY:
+		if (!CHECK_FLAG(attr->flags, LS_ATTR_MIN_MAX_DELAY))
+			return true;
+		if (((attr->extended.min_delay & TE_EXT_MASK) + path->weight) >
+		    csts->cost)
+			return true;
+		break;
+	}
+
+	/* If specified, check that Edge keeps the path within the delay bound */
+	if (csts->delay) {
+		delay = edge_delay(attr);
+		if (delay == UINT32_MAX ||
+		    (uint64_t)delay + path->delay > csts->delay)
+			return true;
 	}
 
 	/* If specified, check that Edge meet Bandwidth constraint */
@@ -477,6 +520,7 @@ static bool relax_constraints(struct cspf *algo, struct ls_edge *edge)
 	struct c_path *next_path;
 	struct v_node vnode = {};
 	uint32_t total_cost = MAX_COST;
+	uint32_t total_delay;
 
 	/* Verify that we have a current computed path */
 	if (!algo->path)
@@ -517,10 +561,28 @@ static bool relax_constraints(struct cspf *algo, struct ls_edge *edge)
 		total_cost =
 			edge->attributes->extended.delay + algo->path->weight;
 		break;
+	case CSPF_MIN_DELAY:
+		total_cost = (edge->attributes->extended.min_delay &
+			      TE_EXT_MASK) +
+			     algo->path->weight;
+		break;
 	default:
 		break;
 	}
-	if (total_cost < next_path->weight) {
+	/* Unknown delays only matter to the bound, and then prune the Edge */
+	total_delay = edge_delay(edge->attributes);
+	if (total_delay == UINT32_MAX)
+		total_delay = 0;
+	total_delay = MIN((uint64_t)total_delay + algo->path->delay,
+			  (uint64_t)UINT32_MAX);
+
+	/*
+	 * Between paths of the same cost, keep the faster one: it leaves more
+	 * room under the delay bound for the rest of the path.
+	 */
+	if (total_cost < next_path->weight ||
+	    (total_cost == next_path->weight && total_cost != MAX_COST &&
+	     total_delay < next_path->delay)) {
 		/*
 		 * It is not possible to directly update the q_path in the
 		 * Priority Queue. Indeed, if we modify the path weight, the
@@ -529,14 +591,10 @@ static bool relax_constraints(struct cspf *algo, struct ls_edge *edge)
 		 * update the Path, in particular the Weight, and finally
 		 * (re-)insert it in the Priority Queue.
 		 */
-		struct c_path *path;
-		frr_each_safe (pqueue, &algo->pqueue, path) {
-			if (path->dst == pkey.dst) {
-				pqueue_del(&algo->pqueue, path);
-				break;
-			}
-		}
+		if (pqueue_member(&algo->pqueue, next_path))
+			pqueue_del(&algo->pqueue, next_path);
 		next_path->weight = total_cost;
+		next_path->delay = total_delay;
 		cpath_replace(next_path, algo->path);
 		listnode_add(next_path->edges, edge);
 		pqueue_add(&algo->pqueue, next_path);
@@ -553,7 +611,7 @@ struct c_path *compute_p2p_path(struct cspf *algo, struct ls_ted *ted)
 	struct ls_edge *edge;
 	struct c_path *optim_path;
 	struct v_node *vnode;
-	uint32_t cur_cost;
+	uint32_t cur_cost, cur_delay;
 
 	optim_path = cpath_new(0xFFFFFFFFFFFFFFFF);
 	optim_path->status = FAILED;
@@ -589,10 +647,18 @@ struct c_path *compute_p2p_path(struct cspf *algo, struct ls_ted *ted)
 	 * processing the next Connected Vertex: see relax_constraints()
 	 */
 	cur_cost = MAX_COST;
+	cur_delay = UINT32_MAX;
 	while (pqueue_count(&algo->pqueue) != 0) {
 		/* Got shortest current Path from the Priority Queue */
 		algo->path = pqueue_pop(&algo->pqueue);
 
+		/*
+		 * Costs only grow along a path, so nothing left in the queue
+		 * can lead to a shorter path once the destination is reached.
+		 */
+		if (algo->path == algo->pdst)
+			break;
+
 		/* Add destination Vertex of this path to the visited RB Tree */
 		vertex = ls_find_vertex_by_key(ted, algo->path->dst);
 		if (!vertex)
@@ -615,8 +681,11 @@ struct c_path *compute_p2p_path(struct cspf *algo, struct ls_ted *ted)
 			 * candidate path
 			 */
 			if (relax_constraints(algo, edge) &&
-			    algo->pdst->weight < cur_cost) {
+			    (algo->pdst->weight < cur_cost ||
+			     (algo->pdst->weight == cur_cost &&
+			      algo->pdst->delay < cur_delay))) {
 				cur_cost = algo->pdst->weight;
+				cur_delay = algo->pdst->delay;
 				cpath_copy(optim_path, algo->pdst);
 				optim_path->status = SUCCESS;
 			}
@@ -20,8 +20,9 @@ extern "C" {
 
 /**
  * This file defines the different structure used for Path Computation with
- * various constrained. Up to now, standard metric, TE metric, delay and
- * bandwidth constraints are supported.
+ * various constrained. Up to now, standard metric, TE metric, average or
+ * minimum delay and bandwidth constraints are supported, and the cumulative
+ * delay of the path may be bounded whatever the metric being minimized.
  * All proposed algorithms used the same principle:
  *  - A pruning function that keeps only links that meet constraints
  *  - A priority Queue that keeps the shortest on-going computed path
@@ -40,12 +41,13 @@ enum path_status {
 	SUCCESS
 };
 enum path_type {RSVP_TE = 1, SR_TE, SRV6_TE};
-enum metric_type {CSPF_METRIC = 1, CSPF_TE_METRIC, CSPF_DELAY};
+enum metric_type {CSPF_METRIC = 1, CSPF_TE_METRIC, CSPF_DELAY, CSPF_MIN_DELAY};
 
 /* Constrained metrics structure */
 struct constraints {
 	uint32_t cost;		/* total cost (metric) of the path */
 	enum metric_type ctype;	/* Metric Type: standard, TE or Delay */
+	uint32_t delay;		/* maximum delay of the path, 0 if unbounded */
 	float bw;		/* bandwidth of the path */
 	uint8_t cos;		/* Class of Service of the path */
 	enum path_type type;	/* RSVP-TE or SR-TE path */
@@ -62,6 +64,7 @@ PREDECL_RBTREE_UNIQ(processed);
 struct c_path {
 	struct pqueue_item q_itm;    /* entry in the Priority Queue */
 	uint32_t weight;             /* Weight to sort path in Priority Queue */
+	uint32_t delay;              /* Cumulative (average) delay of the path */
 	struct processed_item p_itm; /* entry in the Processed RB Tree */
 	uint64_t dst;                /* Destination vertex key of this path */
 	struct list *edges;          /* List of Edges that compose this path */
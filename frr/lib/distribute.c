@@ -299,6 +299,9 @@ int config_show_distribute(struct vty *vty, struct distribute_ctx *dist_ctxt)
 	struct hash_bucket *mp;
 	struct distribute *dist;
 
+	/* The index is walked by hand below */
+	hash_rehash_complete(dist_ctxt->disthash);
+
 	/* Output filter configuration. */
 	dist = distribute_lookup(dist_ctxt, NULL);
 	vty_out(vty, "  Outgoing update filter list for all interface is");
@@ -402,6 +405,8 @@ int config_write_distribute(struct vty *vty,
 	struct hash_bucket *mp;
 	int write = 0;
 
+	hash_rehash_complete(dist_ctxt->disthash);
+
 	for (i = 0; i < dist_ctxt->disthash->size; i++)
 		for (mp = dist_ctxt->disthash->index[i]; mp; mp = mp->next) {
 			struct distribute *dist;
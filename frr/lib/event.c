@@ -7,6 +7,12 @@
 
 #include <zebra.h>
 #include <sys/resource.h>
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
 
 #include "frrevent.h"
 #include "memory.h"
@@ -27,6 +33,7 @@ DEFINE_MTYPE_STATIC(LIB, THREAD, "Thread");
 DEFINE_MTYPE_STATIC(LIB, EVENT_MASTER, "Thread master");
 DEFINE_MTYPE_STATIC(LIB, EVENT_POLL, "Thread Poll Info");
 DEFINE_MTYPE_STATIC(LIB, EVENT_STATS, "Thread stats");
+DEFINE_MTYPE_STATIC(LIB, EVENT_WHEEL, "Thread timer wheel");
 
 DECLARE_LIST(event_list, struct event, eventitem);
 
@@ -55,17 +62,319 @@ static int event_timer_cmp(const struct event *a, const struct event *b)
 
 DECLARE_HEAP(event_timer_list, struct event, timeritem, event_timer_cmp);
 
+DECLARE_DLIST(event_wheel_list, struct event, wheelitem);
+DECLARE_ATOMLIST(event_inject_list, struct event_inject, item);
+
+#define EVENT_WHEEL_TICK_USEC 62500ULL
+#define EVENT_WHEEL_MASK      (EVENT_WHEEL_SLOTS - 1)
+#define EVENT_WHEEL_WORDS     (EVENT_WHEEL_SLOTS / 64)
+
+static inline uint64_t event_wheel_usec(const struct timeval *tv)
+{
+	return (uint64_t)tv->tv_sec * 1000000ULL + tv->tv_usec;
+}
+
+static struct event_wheel *event_wheel_new(void)
+{
+	struct event_wheel *w;
+	struct timeval now;
+	unsigned int level, slot;
+
+	w = XCALLOC(MTYPE_EVENT_WHEEL, sizeof(*w));
+	for (level = 0; level < EVENT_WHEEL_LEVELS; level++)
+		for (slot = 0; slot < EVENT_WHEEL_SLOTS; slot++)
+			event_wheel_list_init(&w->slots[level][slot]);
+
+	monotime(&now);
+	w->tick = event_wheel_usec(&now) / EVENT_WHEEL_TICK_USEC;
+	w->wait_tick = UINT64_MAX;
+	return w;
+}
+
+static void event_wheel_set(struct event_wheel *w, unsigned int level,
+			    unsigned int slot, struct event *thread)
+{
+	event_wheel_list_add_tail(&w->slots[level][slot], thread);
+	w->busy[level][slot / 64] |= 1ULL << (slot % 64);
+	thread->wheel_slot = 1 + level * EVENT_WHEEL_SLOTS + slot;
+}
+
+/*
+ * Put a timer on the wheel, if it reaches that far, with the tick the loop
+ * has to wake up at for it.  Returns whether it did.
+ */
+static bool event_wheel_add(struct event_loop *m, struct event *thread,
+			    uint64_t *wake)
+{
+	struct event_wheel *w;
+	uint64_t tick;
+
+	if (!m->wheel)
+		m->wheel = event_wheel_new();
+	w = m->wheel;
+
+	tick = (event_wheel_usec(&thread->u.sands) + EVENT_WHEEL_TICK_USEC - 1) /
+	       EVENT_WHEEL_TICK_USEC;
+	if (tick <= w->tick)
+		tick = w->tick + 1;
+
+	if (tick - w->tick < EVENT_WHEEL_SLOTS) {
+		event_wheel_set(w, 0, tick & EVENT_WHEEL_MASK, thread);
+		*wake = tick;
+	} else if ((tick >> EVENT_WHEEL_BITS) - (w->tick >> EVENT_WHEEL_BITS) <
+		   EVENT_WHEEL_SLOTS) {
+		event_wheel_set(w, 1, (tick >> EVENT_WHEEL_BITS) & EVENT_WHEEL_MASK,
+				thread);
+		*wake = tick & ~(uint64_t)EVENT_WHEEL_MASK;
+	} else
+		return false;
+
+	w->count++;
+	return true;
+}
+
+static void event_wheel_del(struct event_loop *m, struct event *thread)
+{
+	struct event_wheel *w = m->wheel;
+	unsigned int level = (thread->wheel_slot - 1) / EVENT_WHEEL_SLOTS;
+	unsigned int slot = (thread->wheel_slot - 1) % EVENT_WHEEL_SLOTS;
+	struct event_wheel_list_head *head = &w->slots[level][slot];
+
+	event_wheel_list_del(head, thread);
+	if (!event_wheel_list_count(head))
+		w->busy[level][slot / 64] &= ~(1ULL << (slot % 64));
+	thread->wheel_slot = 0;
+	w->count--;
+}
+
+/* First busy slot at or after from, going round; -1 if there is none */
+static int event_wheel_first(const uint64_t *busy, unsigned int from)
+{
+	unsigned int n, word;
+	uint64_t bits;
+
+	for (n = 0; n <= EVENT_WHEEL_WORDS; n++) {
+		word = (from / 64 + n) % EVENT_WHEEL_WORDS;
+		bits = busy[word];
+		if (n == 0)
+			bits &= ~0ULL << (from % 64);
+		else if (n == EVENT_WHEEL_WORDS)
+			bits &= (1ULL << (from % 64)) - 1;
+		if (bits)
+			return word * 64 + __builtin_ctzll(bits);
+	}
+	return -1;
+}
+
+static bool event_wheel_level_busy(const uint64_t *busy)
+{
+	unsigned int word;
+
+	for (word = 0; word < EVENT_WHEEL_WORDS; word++)
+		if (busy[word])
+			return true;
+	return false;
+}
+
+/* The next tick the wheel has something to do at */
+static uint64_t event_wheel_next(const struct event_wheel *w)
+{
+	uint64_t from = w->tick + 1;
+	int slot;
+
+	if (!w->count)
+		return UINT64_MAX;
+
+	slot = event_wheel_first(w->busy[0], from & EVENT_WHEEL_MASK);
+	if (slot >= 0)
+		return from + ((slot - from) & EVENT_WHEEL_MASK);
+
+	/* up to the second level's next slot, to cascade it */
+	return ((w->tick >> EVENT_WHEEL_BITS) + 1) << EVENT_WHEEL_BITS;
+}
+
+static void event_wheel_cascade(struct event_wheel *w)
+{
+	unsigned int slot = (w->tick >> EVENT_WHEEL_BITS) & EVENT_WHEEL_MASK;
+	struct event_wheel_list_head *head = &w->slots[1][slot];
+	struct event *thread;
+	uint64_t tick;
+
+	while ((thread = event_wheel_list_pop(head))) {
+		tick = (event_wheel_usec(&thread->u.sands) +
+			EVENT_WHEEL_TICK_USEC - 1) /
+		       EVENT_WHEEL_TICK_USEC;
+		event_wheel_set(w, 0, tick & EVENT_WHEEL_MASK, thread);
+	}
+	w->busy[1][slot / 64] &= ~(1ULL << (slot % 64));
+}
+
 #if defined(__APPLE__)
 #include <mach/mach.h>
 #include <mach/mach_time.h>
 #endif
 
+/* 8 bytes, as an eventfd wants; a pipe takes them just as well */
 #define AWAKEN(m)                                                              \
 	do {                                                                   \
-		const unsigned char wakebyte = 0x01;                           \
-		write(m->io_pipe[1], &wakebyte, 1);                            \
+		const uint64_t wakeval = 1;                                    \
+		write(m->io_pipe[1], &wakeval, sizeof(wakeval));               \
 	} while (0)
 
+#ifdef HAVE_EPOLL
+/* Events taken per epoll_pwait() */
+#define EVENT_EPOLL_EVENTS 256
+/* epmask: fd is in the epoll set, besides the EPOLLIN/EPOLLOUT it is armed for */
+#define EPMASK_REGISTERED 0x80
+
+static void fd_epoll_init(struct event_loop *m)
+{
+	struct epoll_event ev = { .events = EPOLLIN, .data.fd = m->io_pipe[0] };
+
+	m->handler.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (m->handler.epfd < 0) {
+		flog_err(EC_LIB_SYSTEM_CALL,
+			 "epoll_create1() failed, using poll(): %s",
+			 safe_strerror(errno));
+		return;
+	}
+	/* the pipe poker stays armed */
+	if (epoll_ctl(m->handler.epfd, EPOLL_CTL_ADD, m->io_pipe[0], &ev) < 0) {
+		flog_err(EC_LIB_SYSTEM_CALL,
+			 "epoll_ctl() failed on pipe, using poll(): %s",
+			 safe_strerror(errno));
+		close(m->handler.epfd);
+		m->handler.epfd = -1;
+		return;
+	}
+
+	m->handler.epmask = XCALLOC(MTYPE_EVENT_POLL, m->fd_limit);
+	m->handler.epsize = EVENT_EPOLL_EVENTS;
+	m->handler.epevents = XCALLOC(MTYPE_EVENT_POLL,
+				      sizeof(struct epoll_event) *
+					      m->handler.epsize);
+}
+
+static void fd_epoll_fini(struct event_loop *m)
+{
+	if (m->handler.epfd < 0)
+		return;
+
+	close(m->handler.epfd);
+	XFREE(MTYPE_EVENT_POLL, m->handler.epmask);
+	XFREE(MTYPE_EVENT_POLL, m->handler.epevents);
+}
+
+/*
+ * Arm fd for want, a mix of EPOLLIN and EPOLLOUT.  Registrations are
+ * one-shot, so one that fired is disarmed without a syscall and re-armed
+ * with a single one as a task is added again.  It stays in the set while
+ * it is disarmed, unless its tasks were cancelled.
+ */
+static void fd_epoll_update(struct event_loop *m, int fd, uint8_t want)
+{
+	struct epoll_event ev = { .events = want | EPOLLONESHOT, .data.fd = fd };
+	uint8_t *mask = &m->handler.epmask[fd];
+	int op, rv;
+
+	if (!want) {
+		if (*mask & (EPOLLIN | EPOLLOUT)) {
+			epoll_ctl(m->handler.epfd, EPOLL_CTL_DEL, fd, &ev);
+			*mask = 0;
+		}
+		return;
+	}
+
+	if (*mask == (want | EPMASK_REGISTERED))
+		return;
+
+	op = (*mask & EPMASK_REGISTERED) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	rv = epoll_ctl(m->handler.epfd, op, fd, &ev);
+	/* closed and opened again in the meantime, the kernel forgot it */
+	if (rv < 0 && errno == ENOENT)
+		rv = epoll_ctl(m->handler.epfd, EPOLL_CTL_ADD, fd, &ev);
+	else if (rv < 0 && errno == EEXIST)
+		rv = epoll_ctl(m->handler.epfd, EPOLL_CTL_MOD, fd, &ev);
+	if (rv < 0) {
+		flog_err(EC_LIB_SYSTEM_CALL, "epoll_ctl() failed for fd %d: %s",
+			 fd, safe_strerror(errno));
+		*mask = 0;
+		return;
+	}
+	*mask = want | EPMASK_REGISTERED;
+}
+
+static inline uint8_t fd_epoll_want(struct event_loop *m, int fd)
+{
+	return (m->read[fd] ? EPOLLIN : 0) | (m->write[fd] ? EPOLLOUT : 0);
+}
+
+/* The task for fd in state is going away; the caller clears it */
+static void fd_epoll_cancel(struct event_loop *m, int fd, short state)
+{
+	struct event *self = (state & POLLIN) ? m->read[fd] : m->write[fd];
+	struct event *other = (state & POLLIN) ? m->write[fd] : m->read[fd];
+
+	if (!self)
+		return;
+	if (!other)
+		m->handler.pfdcount--;
+	fd_epoll_update(m, fd, other ? ((state & POLLIN) ? EPOLLOUT : EPOLLIN)
+				     : 0);
+}
+
+static void fd_epoll_ready(struct event_loop *m, struct event **thread_array,
+			   int fd)
+{
+	struct event *thread = thread_array[fd];
+
+	thread_array[fd] = NULL;
+	if (!m->read[fd] && !m->write[fd])
+		m->handler.pfdcount--;
+	event_list_add_tail(&m->ready, thread);
+	thread->type = EVENT_READY;
+}
+
+/* Move the tasks of the fds that fired to the ready list */
+static void thread_process_epoll(struct event_loop *m, int num)
+{
+	struct epoll_event *ev;
+	int i, fd;
+
+	for (i = 0; i < num; i++) {
+		ev = &m->handler.epevents[i];
+		fd = ev->data.fd;
+		if (fd == m->io_pipe[0])
+			continue;
+
+		/* one-shot: the fd is disarmed now */
+		m->handler.epmask[fd] &= EPMASK_REGISTERED;
+
+		/* errors go to the reader, as with poll(), then the writer */
+		if ((ev->events & (EPOLLIN | EPOLLHUP | EPOLLERR)) &&
+		    m->read[fd])
+			fd_epoll_ready(m, m->read, fd);
+		if ((ev->events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) &&
+		    m->write[fd])
+			fd_epoll_ready(m, m->write, fd);
+
+		if (m->read[fd] || m->write[fd])
+			fd_epoll_update(m, fd, fd_epoll_want(m, fd));
+	}
+}
+
+static void fd_epoll_drain(struct event_loop *m, int num)
+{
+	unsigned char trash[64];
+	int i;
+
+	for (i = 0; i < num; i++)
+		if (m->handler.epevents[i].data.fd == m->io_pipe[0])
+			while (read(m->io_pipe[0], &trash, sizeof(trash)) > 0)
+				;
+}
+#endif /* HAVE_EPOLL */
+
 /* control variable for initializer */
 static pthread_once_t init_once = PTHREAD_ONCE_INIT;
 pthread_key_t thread_current;
@@ -267,6 +576,19 @@ static void cpu_record_clear(uint8_t filter)
 				}
 
 				cpu_records_fini(old);
+
+				unsigned int i, kept = 0;
+
+				for (i = 0; i < m->outliers_count; i++)
+					if (!((1 << m->outliers[i].type) &
+					      filter))
+						m->outliers[kept++] =
+							m->outliers[i];
+				m->outliers_count = kept;
+				if (kept < EVENT_OUTLIERS)
+					atomic_store_explicit(&m->outliers_floor,
+							      0,
+							      memory_order_relaxed);
 			}
 		}
 	}
@@ -332,6 +654,178 @@ DEFUN_NOSH (show_thread_cpu,
 	return CMD_SUCCESS;
 }
 
+/* Upper bound of the per-mille'th runtime, from the histogram */
+static unsigned long cpu_record_pct(const size_t *hist, size_t calls,
+				    unsigned long max, unsigned int permille)
+{
+	size_t want = (calls * permille + 999) / 1000, seen = 0;
+	unsigned int bucket;
+
+	for (bucket = 0; bucket < EVENT_HIST_BUCKETS - 1; bucket++) {
+		seen += hist[bucket];
+		if (seen >= want)
+			return MIN(1UL << bucket, max);
+	}
+	return max;
+}
+
+static void cpu_record_latency_print(struct vty *vty, uint8_t filter,
+				     struct event_loop *m)
+{
+	const char *name = m->name ? m->name : "main";
+	struct cpu_event_history *rec;
+	size_t hist[EVENT_HIST_BUCKETS];
+	size_t calls;
+	unsigned long max;
+	uint32_t types;
+	unsigned int i;
+
+	vty_out(vty, "\nLatency for pthread %s (uSec)\n", name);
+	vty_out(vty, "  Invoked       p50       p90       p99     p99.9       Max  Type   Thread\n");
+
+	frr_each (cpu_records, m->cpu_records, rec) {
+		types = atomic_load_explicit(&rec->types, memory_order_seq_cst);
+		calls = atomic_load_explicit(&rec->total_calls,
+					     memory_order_seq_cst);
+		if (!(types & filter) || !calls)
+			continue;
+
+		max = atomic_load_explicit(&rec->real.max,
+					   memory_order_seq_cst);
+		calls = 0;
+		for (i = 0; i < EVENT_HIST_BUCKETS; i++) {
+			hist[i] = atomic_load_explicit(&rec->real_hist[i],
+						       memory_order_relaxed);
+			calls += hist[i];
+		}
+
+		vty_out(vty, "%9zu %9lu %9lu %9lu %9lu %9lu", calls,
+			cpu_record_pct(hist, calls, max, 500),
+			cpu_record_pct(hist, calls, max, 900),
+			cpu_record_pct(hist, calls, max, 990),
+			cpu_record_pct(hist, calls, max, 999), max);
+		vty_out(vty, "  %c%c%c%c%c  %s\n",
+			types & (1 << EVENT_READ) ? 'R' : ' ',
+			types & (1 << EVENT_WRITE) ? 'W' : ' ',
+			types & (1 << EVENT_TIMER) ? 'T' : ' ',
+			types & (1 << EVENT_EVENT) ? 'E' : ' ',
+			types & (1 << EVENT_EXECUTE) ? 'X' : ' ', rec->funcname);
+	}
+}
+
+DEFUN_NOSH (show_thread_latency,
+	    show_thread_latency_cmd,
+	    "show thread latency [FILTER]",
+	    SHOW_STR
+	    "Thread information\n"
+	    "Thread wall-clock runtime percentiles\n"
+	    "Display filter (rwtex)\n")
+{
+	uint8_t filter = (uint8_t)-1U;
+	struct event_loop *m;
+	struct listnode *ln;
+	int idx = 0;
+
+	if (argv_find(argv, argc, "FILTER", &idx)) {
+		filter = parse_filter(argv[idx]->arg);
+		if (!filter) {
+			vty_out(vty,
+				"Invalid filter \"%s\" specified; must contain at least one of 'RWTEX'\n",
+				argv[idx]->arg);
+			return CMD_WARNING;
+		}
+	}
+
+	frr_with_mutex (&masters_mtx) {
+		for (ALL_LIST_ELEMENTS_RO(masters, ln, m))
+			cpu_record_latency_print(vty, filter, m);
+	}
+	return CMD_SUCCESS;
+}
+
+static int cpu_outlier_cmp(const void *a, const void *b)
+{
+	const struct event_outlier *oa = a, *ob = b;
+
+	return numcmp(ob->walltime, oa->walltime);
+}
+
+static void show_thread_outliers_helper(struct vty *vty, struct event_loop *m)
+{
+	const char *name = m->name ? m->name : "main";
+	struct event_outlier copy[EVENT_OUTLIERS];
+	unsigned int i, count;
+	time_t now = monotime(NULL);
+
+	frr_with_mutex (&m->mtx) {
+		count = m->outliers_count;
+		memcpy(copy, m->outliers, count * sizeof(copy[0]));
+	}
+	qsort(copy, count, sizeof(copy[0]), cpu_outlier_cmp);
+
+	vty_out(vty, "\nSlowest tasks of pthread %s\n", name);
+	vty_out(vty, " Wall uSec   CPU uSec   Age(s) Type  Task / scheduled from\n");
+	if (!count)
+		vty_out(vty, "No data to display yet.\n");
+
+	for (i = 0; i < count; i++) {
+		const struct xref_eventsched *xref = copy[i].xref;
+
+		vty_out(vty, "%10lu %10lu %8lld   %c   %s\n", copy[i].walltime,
+			copy[i].cputime, (long long)(now - copy[i].when),
+			"RWTE??X"[copy[i].type], xref->funcname);
+		vty_out(vty, "%36s %s() at %s:%d\n", "", xref->xref.func,
+			xref->xref.file, xref->xref.line);
+	}
+}
+
+DEFUN_NOSH (show_thread_outliers,
+	    show_thread_outliers_cmd,
+	    "show thread outliers",
+	    SHOW_STR
+	    "Thread information\n"
+	    "Slowest tasks run, with where they were scheduled\n")
+{
+	struct event_loop *m;
+	struct listnode *ln;
+
+	frr_with_mutex (&masters_mtx) {
+		for (ALL_LIST_ELEMENTS_RO(masters, ln, m))
+			show_thread_outliers_helper(vty, m);
+	}
+	return CMD_SUCCESS;
+}
+
+DEFPY_NOSH (show_thread_folded,
+	    show_thread_folded_cmd,
+	    "show thread folded [cpu$cpu]",
+	    SHOW_STR
+	    "Thread information\n"
+	    "Runtime per task as folded stacks, for flamegraph.pl\n"
+	    "Weigh by CPU time rather than wall-clock time\n")
+{
+	struct cpu_event_history *rec;
+	struct event_loop *m;
+	struct listnode *ln;
+	size_t usec;
+
+	frr_with_mutex (&masters_mtx) {
+		for (ALL_LIST_ELEMENTS_RO(masters, ln, m)) {
+			const char *name = m->name ? m->name : "main";
+
+			frr_each (cpu_records, m->cpu_records, rec) {
+				usec = atomic_load_explicit(cpu ? &rec->cpu.total
+								: &rec->real.total,
+							    memory_order_seq_cst);
+				if (usec)
+					vty_out(vty, "%s;%s %zu\n", name,
+						rec->funcname, usec);
+			}
+		}
+	}
+	return CMD_SUCCESS;
+}
+
 DEFPY (service_cputime_stats,
        service_cputime_stats_cmd,
        "[no] service cputime-stats",
@@ -387,6 +881,21 @@ static void show_thread_poll_helper(struct vty *vty, struct event_loop *m)
 	vty_out(vty, "----------------------%s\n", underline);
 	vty_out(vty, "Count: %u/%d\n", (uint32_t)m->handler.pfdcount,
 		m->fd_limit);
+
+#ifdef HAVE_EPOLL
+	if (m->handler.epfd >= 0) {
+		for (i = 0; i < (uint32_t)m->handler.fdmax; i++) {
+			if (!m->read[i] && !m->write[i])
+				continue;
+			vty_out(vty, "\t fd:%6d epoll:%2d\t\t%s %s\n", i,
+				m->handler.epmask[i] & ~EPMASK_REGISTERED,
+				m->read[i] ? m->read[i]->xref->funcname : "",
+				m->write[i] ? m->write[i]->xref->funcname : "");
+		}
+		return;
+	}
+#endif
+
 	for (i = 0; i < m->handler.pfdcount; i++) {
 		vty_out(vty, "\t%6d fd:%6d events:%2d revents:%2d\t\t", i,
 			m->handler.pfds[i].fd, m->handler.pfds[i].events,
@@ -463,6 +972,7 @@ static void show_thread_timers_helper(struct vty *vty, struct event_loop *m)
 	const char *name = m->name ? m->name : "main";
 	char underline[strlen(name) + 1];
 	struct event *thread;
+	unsigned int level, slot;
 
 	memset(underline, '-', sizeof(underline));
 	underline[sizeof(underline) - 1] = '\0';
@@ -473,6 +983,16 @@ static void show_thread_timers_helper(struct vty *vty, struct event_loop *m)
 	frr_each (event_timer_list, &m->timer, thread) {
 		vty_out(vty, "  %-50s%pTH\n", thread->hist->funcname, thread);
 	}
+
+	if (!m->wheel)
+		return;
+
+	for (level = 0; level < EVENT_WHEEL_LEVELS; level++)
+		for (slot = 0; slot < EVENT_WHEEL_SLOTS; slot++)
+			frr_each (event_wheel_list, &m->wheel->slots[level][slot],
+				  thread)
+				vty_out(vty, "  %-50s%pTH\n",
+					thread->hist->funcname, thread);
 }
 
 DEFPY_NOSH (show_thread_timers,
@@ -496,6 +1016,9 @@ DEFPY_NOSH (show_thread_timers,
 void event_cmd_init(void)
 {
 	install_element(VIEW_NODE, &show_thread_cpu_cmd);
+	install_element(VIEW_NODE, &show_thread_latency_cmd);
+	install_element(VIEW_NODE, &show_thread_outliers_cmd);
+	install_element(VIEW_NODE, &show_thread_folded_cmd);
 	install_element(VIEW_NODE, &show_thread_poll_cmd);
 	install_element(ENABLE_NODE, &clear_thread_cpu_cmd);
 
@@ -572,10 +1095,17 @@ struct event_loop *event_master_create(const char *name)
 	rv->cancel_req->del = cancelreq_del;
 	rv->canceled = true;
 
-	/* Initialize pipe poker */
-	pipe(rv->io_pipe);
-	set_nonblocking(rv->io_pipe[0]);
-	set_nonblocking(rv->io_pipe[1]);
+	/* Initialize pipe poker; an eventfd is both ends of it */
+#ifdef HAVE_EVENTFD
+	rv->io_pipe[0] = rv->io_pipe[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (rv->io_pipe[0] < 0)
+#endif
+	{
+		pipe(rv->io_pipe);
+		set_nonblocking(rv->io_pipe[0]);
+		set_nonblocking(rv->io_pipe[1]);
+	}
+	event_inject_list_init(&rv->inject);
 
 	/* Initialize data structures for poll() */
 	rv->handler.pfdsize = rv->fd_limit;
@@ -585,6 +1115,12 @@ struct event_loop *event_master_create(const char *name)
 	rv->handler.copy = XCALLOC(MTYPE_EVENT_MASTER,
 				   sizeof(struct pollfd) * rv->handler.pfdsize);
 
+	rv->handler.epfd = -1;
+#ifdef HAVE_EPOLL
+	if (frr_get_use_epoll())
+		fd_epoll_init(rv);
+#endif
+
 	/* add to list of threadmasters */
 	frr_with_mutex (&masters_mtx) {
 		if (!masters)
@@ -675,6 +1211,8 @@ void event_master_free(struct event_loop *m)
 {
 	struct cpu_event_history *record;
 	struct event *t;
+	struct event_inject *inj;
+	unsigned int level, slot;
 
 	frr_with_mutex (&masters_mtx) {
 		listnode_delete(masters, m);
@@ -686,13 +1224,31 @@ void event_master_free(struct event_loop *m)
 	thread_array_free(m, m->write);
 	while ((t = event_timer_list_pop(&m->timer)))
 		thread_free(m, t);
+	if (m->wheel) {
+		for (level = 0; level < EVENT_WHEEL_LEVELS; level++)
+			for (slot = 0; slot < EVENT_WHEEL_SLOTS; slot++)
+				while ((t = event_wheel_list_pop(
+						&m->wheel->slots[level][slot])))
+					thread_free(m, t);
+		XFREE(MTYPE_EVENT_WHEEL, m->wheel);
+	}
 	thread_list_free(m, &m->event);
 	thread_list_free(m, &m->ready);
 	thread_list_free(m, &m->unuse);
 	pthread_mutex_destroy(&m->mtx);
 	pthread_cond_destroy(&m->cancel_cond);
+#ifdef HAVE_EPOLL
+	fd_epoll_fini(m);
+#endif
+	/* Injections belong to their submitters; just let go of them */
+	while ((inj = event_inject_list_pop(&m->inject)))
+		atomic_store_explicit(&inj->queued, false,
+				      memory_order_release);
+	event_inject_list_fini(&m->inject);
+
 	close(m->io_pipe[0]);
-	close(m->io_pipe[1]);
+	if (m->io_pipe[1] != m->io_pipe[0])
+		close(m->io_pipe[1]);
 	list_delete(&m->cancel_req);
 	m->cancel_req = NULL;
 
@@ -891,6 +1447,15 @@ static int fd_poll(struct event_loop *m, const struct timeval *timer_wait,
 		pthread_sigmask(SIG_SETMASK, NULL, &origsigs);
 	}
 
+#ifdef HAVE_EPOLL
+	if (m->handler.epfd >= 0) {
+		num = epoll_pwait(m->handler.epfd, m->handler.epevents,
+				  m->handler.epsize, timeout, &origsigs);
+		pthread_sigmask(SIG_SETMASK, &origsigs, NULL);
+		goto done;
+	}
+#endif
+
 #if defined(HAVE_PPOLL)
 	struct timespec ts, *tsp;
 
@@ -914,6 +1479,11 @@ done:
 	if (num < 0 && errno == EINTR)
 		*eintr_p = true;
 
+#ifdef HAVE_EPOLL
+	if (m->handler.epfd >= 0)
+		fd_epoll_drain(m, num);
+	else
+#endif
 	if (num > 0 && m->handler.copy[count].revents != 0 && num--)
 		while (read(m->io_pipe[0], &trash, sizeof(trash)) > 0)
 			;
@@ -950,6 +1520,34 @@ void _event_add_read_write(const struct xref_eventsched *xref,
 		if (t_ptr && *t_ptr)
 			break;
 
+#ifdef HAVE_EPOLL
+		if (m->handler.epfd >= 0) {
+			thread_array = (dir == EVENT_READ) ? m->read : m->write;
+#ifdef DEV_BUILD
+			if (thread_array[fd])
+				assert(!"Thread already scheduled for file descriptor");
+#endif
+			if (!m->read[fd] && !m->write[fd])
+				m->handler.pfdcount++;
+			if (fd >= m->handler.fdmax)
+				m->handler.fdmax = fd + 1;
+
+			thread = thread_get(m, dir, func, arg, xref);
+			frr_with_mutex (&thread->mtx) {
+				thread->u.fd = fd;
+				thread_array[thread->u.fd] = thread;
+			}
+			if (t_ptr) {
+				*t_ptr = thread;
+				thread->ref = t_ptr;
+			}
+
+			/* a pthread in epoll_pwait() sees this without AWAKEN */
+			fd_epoll_update(m, fd, fd_epoll_want(m, fd));
+			break;
+		}
+#endif
+
 		/* default to a new pollfd */
 		nfds_t queuepos = m->handler.pfdcount;
 
@@ -1009,10 +1607,11 @@ static void _event_add_timer_timeval(const struct xref_eventsched *xref,
 				     struct event_loop *m,
 				     void (*func)(struct event *), void *arg,
 				     struct timeval *time_relative,
-				     struct event **t_ptr)
+				     struct event **t_ptr, bool coarse)
 {
 	struct event *thread;
 	struct timeval t;
+	uint64_t wake;
 
 	assert(m != NULL);
 
@@ -1035,7 +1634,10 @@ static void _event_add_timer_timeval(const struct xref_eventsched *xref,
 
 		frr_with_mutex (&thread->mtx) {
 			thread->u.sands = t;
-			event_timer_list_add(&m->timer, thread);
+			if (coarse)
+				coarse = event_wheel_add(m, thread, &wake);
+			if (!coarse)
+				event_timer_list_add(&m->timer, thread);
 			if (t_ptr) {
 				*t_ptr = thread;
 				thread->ref = t_ptr;
@@ -1046,7 +1648,10 @@ static void _event_add_timer_timeval(const struct xref_eventsched *xref,
 		 * might change the time we'll wait for, give the pthread
 		 * a chance to re-compute.
 		 */
-		if (event_timer_list_first(&m->timer) == thread)
+		if (coarse) {
+			if (wake < m->wheel->wait_tick)
+				AWAKEN(m);
+		} else if (event_timer_list_first(&m->timer) == thread)
 			AWAKEN(m);
 	}
 #define ONEYEAR2SEC (60 * 60 * 24 * 365)
@@ -1070,7 +1675,7 @@ void _event_add_timer(const struct xref_eventsched *xref, struct event_loop *m,
 	trel.tv_sec = timer;
 	trel.tv_usec = 0;
 
-	_event_add_timer_timeval(xref, m, func, arg, &trel, t_ptr);
+	_event_add_timer_timeval(xref, m, func, arg, &trel, t_ptr, timer >= 1);
 }
 
 /* Add timer event thread with "millisecond" resolution */
@@ -1085,7 +1690,7 @@ void _event_add_timer_msec(const struct xref_eventsched *xref,
 	trel.tv_sec = timer / 1000;
 	trel.tv_usec = 1000 * (timer % 1000);
 
-	_event_add_timer_timeval(xref, m, func, arg, &trel, t_ptr);
+	_event_add_timer_timeval(xref, m, func, arg, &trel, t_ptr, false);
 }
 
 /* Add timer event thread with "timeval" resolution */
@@ -1093,7 +1698,7 @@ void _event_add_timer_tv(const struct xref_eventsched *xref,
 			 struct event_loop *m, void (*func)(struct event *),
 			 void *arg, struct timeval *tv, struct event **t_ptr)
 {
-	_event_add_timer_timeval(xref, m, func, arg, tv, t_ptr);
+	_event_add_timer_timeval(xref, m, func, arg, tv, t_ptr, false);
 }
 
 /* Add simple event thread. */
@@ -1129,6 +1734,80 @@ void _event_add_event(const struct xref_eventsched *xref, struct event_loop *m,
 	}
 }
 
+void _event_inject_init(const struct xref_eventsched *xref,
+			struct event_inject *inj, void (*func)(struct event *),
+			void *arg, int val, struct event **tref)
+{
+	memset(inj, 0, sizeof(*inj));
+	inj->xref = xref;
+	inj->func = func;
+	inj->arg = arg;
+	inj->val = val;
+	inj->tref = tref;
+}
+
+void event_inject(struct event_loop *m, struct event_inject *inj)
+{
+	if (atomic_exchange_explicit(&inj->queued, true, memory_order_acq_rel))
+		return;
+
+	frrtrace(9, frr_libfrr, schedule_event, m, inj->xref->funcname,
+		 inj->xref->xref.file, inj->xref->xref.line, inj->tref, 0,
+		 inj->val, inj->arg, 0);
+
+	event_inject_list_add_tail(&m->inject, inj);
+
+	/*
+	 * Only after the add: whoever holds up the queue wakes the loop once
+	 * it is through, so nothing is left on it behind a wakeup.
+	 */
+	if (!atomic_exchange_explicit(&m->inject_wake, true,
+				      memory_order_acq_rel))
+		AWAKEN(m);
+}
+
+/* Turn what was injected into events; requires m->mtx */
+static void event_inject_drain(struct event_loop *m)
+{
+	struct event_inject *inj;
+	struct event *thread;
+
+	while ((inj = event_inject_list_pop(&m->inject))) {
+		atomic_store_explicit(&inj->queued, false,
+				      memory_order_release);
+
+		if (inj->tref && *inj->tref)
+			/* thread is already scheduled; don't reschedule */
+			continue;
+
+		thread = thread_get(m, EVENT_EVENT, inj->func, inj->arg,
+				    inj->xref);
+		frr_with_mutex (&thread->mtx) {
+			thread->u.val = inj->val;
+			event_list_add_tail(&m->event, thread);
+		}
+
+		if (inj->tref) {
+			*inj->tref = thread;
+			thread->ref = inj->tref;
+		}
+	}
+}
+
+void event_inject_cancel(struct event_loop *m, struct event_inject *inj)
+{
+	assert(m->owner == pthread_self());
+
+	frr_with_mutex (&m->mtx) {
+		/* Behind another pthread still adding to the queue, at worst */
+		while (atomic_load_explicit(&inj->queued, memory_order_acquire))
+			event_inject_drain(m);
+	}
+
+	if (inj->tref && *inj->tref)
+		event_cancel(inj->tref);
+}
+
 /* Thread cancellation ------------------------------------------------------ */
 
 /**
@@ -1153,6 +1832,13 @@ static void event_cancel_rw(struct event_loop *master, int fd, short state,
 	/* find the index of corresponding pollfd */
 	nfds_t i;
 
+#ifdef HAVE_EPOLL
+	if (master->handler.epfd >= 0) {
+		fd_epoll_cancel(master, fd, state);
+		return;
+	}
+#endif
+
 	/* Cancel POLLHUP too just in case some bozo set it */
 	state |= POLLHUP;
 
@@ -1220,6 +1906,7 @@ static void cancel_arg_helper(struct event_loop *master,
 	nfds_t i;
 	int fd;
 	struct pollfd *pfd;
+	unsigned int level, slot;
 
 	/* We're only processing arg-based cancellations here. */
 	if (cr->eventobj == NULL)
@@ -1249,7 +1936,28 @@ static void cancel_arg_helper(struct event_loop *master,
 		return;
 
 	/* Check the io tasks */
-	for (i = 0; i < master->handler.pfdcount;) {
+#ifdef HAVE_EPOLL
+	for (fd = 0; master->handler.epfd >= 0 && fd < master->handler.fdmax;
+	     fd++) {
+		t = master->read[fd];
+		if (t && t->arg == cr->eventobj) {
+			fd_epoll_cancel(master, fd, POLLIN);
+			master->read[fd] = NULL;
+			if (t->ref)
+				*t->ref = NULL;
+			thread_add_unuse(master, t);
+		}
+		t = master->write[fd];
+		if (t && t->arg == cr->eventobj) {
+			fd_epoll_cancel(master, fd, POLLOUT);
+			master->write[fd] = NULL;
+			if (t->ref)
+				*t->ref = NULL;
+			thread_add_unuse(master, t);
+		}
+	}
+#endif
+	for (i = 0; i < master->handler.pfdcount && master->handler.epfd < 0;) {
 		pfd = master->handler.pfds + i;
 
 		if (pfd->events & POLLIN)
@@ -1296,6 +2004,21 @@ static void cancel_arg_helper(struct event_loop *master,
 
 		t = t_next;
 	}
+
+	if (!master->wheel)
+		return;
+
+	for (level = 0; level < EVENT_WHEEL_LEVELS; level++)
+		for (slot = 0; slot < EVENT_WHEEL_SLOTS; slot++)
+			frr_each_safe (event_wheel_list,
+				       &master->wheel->slots[level][slot], t) {
+				if (t->arg != cr->eventobj)
+					continue;
+				event_wheel_del(master, t);
+				if (t->ref)
+					*t->ref = NULL;
+				thread_add_unuse(master, t);
+			}
 }
 
 /**
@@ -1350,7 +2073,10 @@ static void do_event_cancel(struct event_loop *master)
 			thread_array = master->write;
 			break;
 		case EVENT_TIMER:
-			event_timer_list_del(&master->timer, thread);
+			if (thread->wheel_slot)
+				event_wheel_del(master, thread);
+			else
+				event_timer_list_del(&master->timer, thread);
 			break;
 		case EVENT_EVENT:
 			list = &master->event;
@@ -1536,13 +2262,30 @@ void event_cancel_async(struct event_loop *master, struct event **thread,
 }
 /* ------------------------------------------------------------------------- */
 
-static struct timeval *thread_timer_wait(struct event_timer_list_head *timers,
+static struct timeval *thread_timer_wait(struct event_loop *m,
 					 struct timeval *timer_val)
 {
-	if (!event_timer_list_count(timers))
-		return NULL;
+	struct event *next_timer = event_timer_list_first(&m->timer);
+	struct timeval wheel_tv;
+	uint64_t tick = UINT64_MAX, usec;
 
-	struct event *next_timer = event_timer_list_first(timers);
+	if (m->wheel) {
+		tick = event_wheel_next(m->wheel);
+		m->wheel->wait_tick = tick;
+	}
+
+	if (tick != UINT64_MAX) {
+		usec = tick * EVENT_WHEEL_TICK_USEC;
+		wheel_tv.tv_sec = usec / 1000000;
+		wheel_tv.tv_usec = usec % 1000000;
+		if (!next_timer || timercmp(&wheel_tv, &next_timer->u.sands, <)) {
+			monotime_until(&wheel_tv, timer_val);
+			return timer_val;
+		}
+	}
+
+	if (!next_timer)
+		return NULL;
 
 	monotime_until(&next_timer->u.sands, timer_val);
 	return timer_val;
@@ -1661,11 +2404,86 @@ static void thread_process_io(struct event_loop *m, unsigned int num)
 	}
 }
 
+static void thread_timer_late(struct event *thread, struct timeval *timenow,
+			      bool *displayed)
+{
+	struct timeval prev;
+
+	prev = thread->u.sands;
+	prev.tv_sec += 4;
+	/*
+	 * If the timer would have popped 4 seconds in the
+	 * past then we are in a situation where we are
+	 * really getting behind on handling of events.
+	 * Let's log it and do the right thing with it.
+	 */
+	if (timercmp(timenow, &prev, >)) {
+		atomic_fetch_add_explicit(&thread->hist->total_starv_warn, 1,
+					  memory_order_seq_cst);
+		if (!*displayed && !thread->ignore_timer_late) {
+			flog_warn(
+				EC_LIB_STARVE_THREAD,
+				"Thread Starvation: %pTHD was scheduled to pop greater than 4s ago",
+				thread);
+			*displayed = true;
+		}
+	}
+}
+
+/* Run the wheel up to timenow, moving what is due to the ready list. */
+static unsigned int event_wheel_run(struct event_loop *m,
+				    struct timeval *timenow, bool *displayed)
+{
+	struct event_wheel *w = m->wheel;
+	struct event_wheel_list_head *head;
+	struct event *thread;
+	uint64_t now_tick, next;
+	unsigned int slot, ready = 0;
+
+	if (!w)
+		return 0;
+
+	now_tick = event_wheel_usec(timenow) / EVENT_WHEEL_TICK_USEC;
+	while (w->tick < now_tick) {
+		if (!w->count) {
+			w->tick = now_tick;
+			break;
+		}
+		/* nothing before the next cascade: skip to it */
+		if (!event_wheel_level_busy(w->busy[0])) {
+			next = ((w->tick >> EVENT_WHEEL_BITS) + 1)
+			       << EVENT_WHEEL_BITS;
+			if (next > now_tick) {
+				w->tick = now_tick;
+				break;
+			}
+			w->tick = next - 1;
+		}
+
+		w->tick++;
+		if (!(w->tick & EVENT_WHEEL_MASK))
+			event_wheel_cascade(w);
+
+		slot = w->tick & EVENT_WHEEL_MASK;
+		head = &w->slots[0][slot];
+		while ((thread = event_wheel_list_pop(head))) {
+			thread_timer_late(thread, timenow, displayed);
+			thread->wheel_slot = 0;
+			w->count--;
+			thread->type = EVENT_READY;
+			event_list_add_tail(&m->ready, thread);
+			ready++;
+		}
+		w->busy[0][slot / 64] &= ~(1ULL << (slot % 64));
+	}
+
+	return ready;
+}
+
 /* Add all timers that have popped to the ready list. */
 static unsigned int thread_process_timers(struct event_loop *m,
 					  struct timeval *timenow)
 {
-	struct timeval prev = *timenow;
 	bool displayed = false;
 	struct event *thread;
 	unsigned int ready = 0;
@@ -1673,34 +2491,14 @@ static unsigned int thread_process_timers(struct event_loop *m,
 	while ((thread = event_timer_list_first(&m->timer))) {
 		if (timercmp(timenow, &thread->u.sands, <))
 			break;
-		prev = thread->u.sands;
-		prev.tv_sec += 4;
-		/*
-		 * If the timer would have popped 4 seconds in the
-		 * past then we are in a situation where we are
-		 * really getting behind on handling of events.
-		 * Let's log it and do the right thing with it.
-		 */
-		if (timercmp(timenow, &prev, >)) {
-			atomic_fetch_add_explicit(
-				&thread->hist->total_starv_warn, 1,
-				memory_order_seq_cst);
-			if (!displayed && !thread->ignore_timer_late) {
-				flog_warn(
-					EC_LIB_STARVE_THREAD,
-					"Thread Starvation: %pTHD was scheduled to pop greater than 4s ago",
-					thread);
-				displayed = true;
-			}
-		}
-
+		thread_timer_late(thread, timenow, &displayed);
 		event_timer_list_pop(&m->timer);
 		thread->type = EVENT_READY;
 		event_list_add_tail(&m->ready, thread);
 		ready++;
 	}
 
-	return ready;
+	return ready + event_wheel_run(m, timenow, &displayed);
 }
 
 /* process a list en masse, e.g. for event thread lists */
@@ -1757,6 +2555,11 @@ struct event *event_fetch(struct event_loop *m, struct event *fetch)
 		m->ready_run_loop = false;
 		/* otherwise, tick through scheduling sequence */
 
+		/* Pick up what other pthreads injected since the last wakeup */
+		if (atomic_exchange_explicit(&m->inject_wake, false,
+					     memory_order_acq_rel))
+			event_inject_drain(m);
+
 		/*
 		 * Post events to ready queue. This must come before the
 		 * following block since events should occur immediately
@@ -1780,7 +2583,7 @@ struct event *event_fetch(struct event_loop *m, struct event *fetch)
 		 * once per loop to avoid starvation by events
 		 */
 		if (!event_list_count(&m->ready))
-			tw = thread_timer_wait(&m->timer, &tv);
+			tw = thread_timer_wait(m, &tv);
 
 		if (event_list_count(&m->ready) ||
 		    (tw && !timercmp(tw, &zerotime, >)))
@@ -1796,9 +2599,11 @@ struct event *event_fetch(struct event_loop *m, struct event *fetch)
 		 * Copy pollfd array + # active pollfds in it. Not necessary to
 		 * copy the array size as this is fixed.
 		 */
-		m->handler.copycount = m->handler.pfdcount;
-		memcpy(m->handler.copy, m->handler.pfds,
-		       m->handler.copycount * sizeof(struct pollfd));
+		if (m->handler.epfd < 0) {
+			m->handler.copycount = m->handler.pfdcount;
+			memcpy(m->handler.copy, m->handler.pfds,
+			       m->handler.copycount * sizeof(struct pollfd));
+		}
 
 		pthread_mutex_unlock(&m->mtx);
 		{
@@ -1828,6 +2633,11 @@ struct event *event_fetch(struct event_loop *m, struct event *fetch)
 		thread_process_timers(m, &now);
 
 		/* Post I/O to ready queue. */
+#ifdef HAVE_EPOLL
+		if (num > 0 && m->handler.epfd >= 0)
+			thread_process_epoll(m, num);
+		else
+#endif
 		if (num > 0)
 			thread_process_io(m, num);
 
@@ -1909,6 +2719,13 @@ void event_set_yield_time(struct event *thread, unsigned long yield_time)
 	}
 }
 
+bool event_budget_expired(void)
+{
+	struct event *current = pthread_getspecific(thread_current);
+
+	return current && event_should_yield(current);
+}
+
 void event_getrusage(RUSAGE_T *r)
 {
 	monotime(&r->real);
@@ -1943,6 +2760,57 @@ void event_getrusage(RUSAGE_T *r)
  * particular, the maximum real and cpu times must be monotonically increasing
  * or this code is not correct.
  */
+static unsigned int thread_hist_bucket(unsigned long usec)
+{
+	unsigned int bucket = 0;
+
+	while (usec && bucket < EVENT_HIST_BUCKETS - 1) {
+		usec >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+/* Keep the task among the loop's slowest, if it is one */
+static void thread_outlier_add(struct event_loop *m, struct event *thread,
+			       unsigned long walltime, unsigned long cputime)
+{
+	struct event_outlier *o = NULL;
+	unsigned int i;
+
+	frr_with_mutex (&m->mtx) {
+		if (m->outliers_count < EVENT_OUTLIERS) {
+			o = &m->outliers[m->outliers_count++];
+		} else {
+			/* Replace the fastest, unless we raced with a slower one */
+			o = &m->outliers[0];
+			for (i = 1; i < EVENT_OUTLIERS; i++)
+				if (m->outliers[i].walltime < o->walltime)
+					o = &m->outliers[i];
+			if (o->walltime >= walltime)
+				o = NULL;
+		}
+
+		if (o) {
+			o->xref = thread->xref;
+			o->walltime = walltime;
+			o->cputime = cputime;
+			o->when = monotime(NULL);
+			o->type = thread->add_type;
+		}
+
+		if (m->outliers_count == EVENT_OUTLIERS) {
+			unsigned long floor = m->outliers[0].walltime;
+
+			for (i = 1; i < EVENT_OUTLIERS; i++)
+				if (m->outliers[i].walltime < floor)
+					floor = m->outliers[i].walltime;
+			atomic_store_explicit(&m->outliers_floor, floor,
+					      memory_order_relaxed);
+		}
+	}
+}
+
 void event_call(struct event *thread)
 {
 	RUSAGE_T before, after;
@@ -1966,9 +2834,12 @@ void event_call(struct event *thread)
 		 thread->xref->xref.line, NULL, thread->u.fd, thread->u.val,
 		 thread->arg, thread->u.sands.tv_sec);
 
+	/* event_execute() can nest; the outer task is current again after */
+	struct event *outer = pthread_getspecific(thread_current);
+
 	pthread_setspecific(thread_current, thread);
 	(*thread->func)(thread);
-	pthread_setspecific(thread_current, NULL);
+	pthread_setspecific(thread_current, outer);
 
 	GETRUSAGE(&after);
 	thread->master->last_getrusage = after;
@@ -1988,6 +2859,9 @@ void event_call(struct event *thread)
 		       &thread->hist->real.max, &exp, walltime,
 		       memory_order_seq_cst, memory_order_seq_cst))
 		;
+	atomic_fetch_add_explicit(
+		&thread->hist->real_hist[thread_hist_bucket(walltime)], 1,
+		memory_order_relaxed);
 
 	if (cputime_enabled_here && cputime_enabled) {
 		/* update cputime */
@@ -2007,6 +2881,11 @@ void event_call(struct event *thread)
 	atomic_fetch_or_explicit(&thread->hist->types, 1 << thread->add_type,
 				 memory_order_seq_cst);
 
+	if (walltime > atomic_load_explicit(&thread->master->outliers_floor,
+					    memory_order_relaxed))
+		thread_outlier_add(thread->master, thread, walltime,
+				   cputime_enabled_here ? cputime : 0);
+
 	if (suppress_warnings)
 		return;
 
@@ -12,6 +12,7 @@
 #include "monotime.h"
 #include "frratomic.h"
 #include "typesafe.h"
+#include "atomlist.h"
 #include "xref.h"
 
 #ifdef __cplusplus
@@ -41,6 +42,8 @@ struct rusage_t {
 
 PREDECL_LIST(event_list);
 PREDECL_HEAP(event_timer_list);
+PREDECL_DLIST(event_wheel_list);
+PREDECL_ATOMLIST(event_inject_list);
 
 struct fd_handler {
 	/* number of pfd that fit in the allocated space of pfds. This is a
@@ -57,6 +60,18 @@ struct fd_handler {
 	struct pollfd *copy;
 	/* number of pollfds stored in copy */
 	nfds_t copycount;
+
+	/*
+	 * epoll backend, in use if epfd >= 0.  The pollfd arrays are then
+	 * left empty: fds stay registered with the kernel as their tasks
+	 * come and go (one-shot, re-armed as a task is added), pfdcount
+	 * counts the fds with a task and fdmax is one past the highest.
+	 */
+	int epfd;
+	uint8_t *epmask;
+	struct epoll_event *epevents;
+	int epsize;
+	int fdmax;
 };
 
 struct xref_eventsched {
@@ -69,6 +84,66 @@ struct xref_eventsched {
 
 PREDECL_HASH(cpu_records);
 
+#define EVENT_HIST_BUCKETS 26
+#define EVENT_OUTLIERS	   16
+
+/* The slowest tasks a loop has run, with where they were scheduled from */
+struct event_outlier {
+	const struct xref_eventsched *xref;
+	unsigned long walltime, cputime;
+	time_t when;
+	uint8_t type;
+};
+
+/*
+ * Timers added with whole-second resolution (event_add_timer() of 1s or
+ * more) are kept in a two-level timer wheel rather than the heap, making
+ * adding and cancelling them O(1).  Ticks are 1/16s of monotonic time;
+ * the first level has a slot per tick, the second per 256 ticks, which is
+ * cascaded into the first as it comes up.  Timers further out than the
+ * second level reaches stay in the heap.  A wheel timer runs within a tick
+ * past its time, never before.
+ */
+#define EVENT_WHEEL_BITS   8
+#define EVENT_WHEEL_SLOTS  (1 << EVENT_WHEEL_BITS)
+#define EVENT_WHEEL_LEVELS 2
+
+struct event_wheel {
+	/* Last tick run, and the tick the loop will next wake up for */
+	uint64_t tick;
+	uint64_t wait_tick;
+	size_t count;
+
+	uint64_t busy[EVENT_WHEEL_LEVELS][EVENT_WHEEL_SLOTS / 64];
+	struct event_wheel_list_head slots[EVENT_WHEEL_LEVELS]
+					  [EVENT_WHEEL_SLOTS];
+};
+
+/*
+ * Scheduling an event from another pthread without the loop's lock, for
+ * work handed over at packet rates.  The submitter keeps one of these per
+ * kind of work it hands over, set up with event_inject_init(), and
+ * event_inject() puts it on the loop's lock-free queue.  The loop turns it
+ * into an event as with event_add_event(), so the task's reference and its
+ * cancelling belong to the loop's pthread alone.  Injecting again before
+ * the loop has picked it up does nothing, and the loop is woken once for
+ * however many injections arrive before it looks.
+ */
+struct event;
+
+struct event_inject {
+	struct event_inject_list_item item;
+
+	const struct xref_eventsched *xref;
+	void (*func)(struct event *e);
+	void *arg;
+	int val;
+	struct event **tref;
+
+	/* On the queue, from event_inject() until the loop picks it up */
+	atomic_bool queued;
+};
+
 /* Master of the theads. */
 struct event_loop {
 	char *name;
@@ -76,6 +151,7 @@ struct event_loop {
 	struct event **read;
 	struct event **write;
 	struct event_timer_list_head timer;
+	struct event_wheel *wheel;
 	struct event_list_head event, ready, unuse;
 	struct list *cancel_req;
 	bool canceled;
@@ -93,6 +169,15 @@ struct event_loop {
 
 	bool ready_run_loop;
 	RUSAGE_T last_getrusage;
+
+	struct event_inject_list_head inject;
+	/* Set once the loop has been woken for what is on inject */
+	atomic_bool inject_wake;
+
+	/* Unordered; the floor is the fastest of them once all are used */
+	struct event_outlier outliers[EVENT_OUTLIERS];
+	unsigned int outliers_count;
+	atomic_size_t outliers_floor;
 };
 
 /* Event types. */
@@ -112,6 +197,9 @@ struct event {
 	enum event_types add_type; /* event type */
 	struct event_list_item eventitem;
 	struct event_timer_list_item timeritem;
+	struct event_wheel_list_item wheelitem;
+	/* 1 + level * EVENT_WHEEL_SLOTS + slot when on the wheel, else 0 */
+	unsigned int wheel_slot;
 	struct event **ref;	      /* external reference (if given) */
 	struct event_loop *master;    /* pointer to the struct event_loop */
 	void (*func)(struct event *e); /* event function */
@@ -148,6 +236,8 @@ struct cpu_event_history {
 	struct time_stats cpu;
 	atomic_uint_fast32_t types;
 	const char *funcname;
+	/* Wall-clock runtimes; bucket n counts those under 2^n usec */
+	atomic_size_t real_hist[EVENT_HIST_BUCKETS];
 };
 
 /* Struct timeval's tv_usec one second value.  */
@@ -201,6 +291,19 @@ struct cpu_event_history {
 	_xref_t_a(timer_tv, TIMER, m, f, a, v, t)
 #define event_add_event(m, f, a, v, t) _xref_t_a(event, EVENT, m, f, a, v, t)
 
+#define event_inject_init(i, f, a, v, t)                                       \
+	({                                                                     \
+		static const struct xref_eventsched _xref __attribute__(       \
+			(used)) = {                                            \
+			.xref = XREF_INIT(XREFT_EVENTSCHED, NULL, __func__),   \
+			.funcname = #f,                                        \
+			.dest = #t,                                            \
+			.event_type = EVENT_EVENT,                             \
+		};                                                             \
+		XREF_LINK(_xref.xref);                                         \
+		_event_inject_init(&_xref, i, f, a, v, t);                     \
+	}) /* end */
+
 #define event_execute(m, f, a, v, p)                                           \
 	({                                                                     \
 		static const struct xref_eventsched _xref __attribute__(       \
@@ -250,6 +353,19 @@ extern void _event_execute(const struct xref_eventsched *xref,
 			   void (*fn)(struct event *), void *arg, int val,
 			   struct event **eref);
 
+extern void _event_inject_init(const struct xref_eventsched *xref,
+			       struct event_inject *inj,
+			       void (*fn)(struct event *), void *arg, int val,
+			       struct event **tref);
+/* From any pthread */
+extern void event_inject(struct event_loop *m, struct event_inject *inj);
+/*
+ * From the loop's pthread, once nothing injects inj any more: wait for a
+ * last injection to be picked up, and cancel the event it became.
+ */
+extern void event_inject_cancel(struct event_loop *m,
+				struct event_inject *inj);
+
 extern void event_cancel(struct event **event);
 extern void event_cancel_async(struct event_loop *m, struct event **eptr,
 			       void *data);
@@ -266,6 +382,27 @@ extern int event_should_yield(struct event *event);
 /* set yield time for thread */
 extern void event_set_yield_time(struct event *event, unsigned long ytime);
 
+/*
+ * event_should_yield() for code that does not have its task at hand, such
+ * as a walk called from several handlers: whether the task running on this
+ * pthread is past its time slice.  Always false outside of a task.
+ */
+extern bool event_budget_expired(void);
+
+/*
+ * For a walk keeping its place in a: if the running task is past its time
+ * slice, schedule f(a) as an event to pick up from there and return true,
+ * for the caller to return.  Ready I/O, keepalives included, gets its turn
+ * before f runs.
+ */
+#define event_yield(m, f, a, t)                                                \
+	({                                                                     \
+		bool _expired = event_budget_expired();                        \
+		if (_expired)                                                  \
+			event_add_event(m, f, a, 0, t);                        \
+		_expired;                                                      \
+	})
+
 /* Internal libfrr exports */
 extern void event_getrusage(RUSAGE_T *r);
 extern void event_cmd_init(void);
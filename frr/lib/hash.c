@@ -35,6 +35,7 @@ struct hash *hash_create_size(unsigned int size,
 	hash->index =
 		XCALLOC(MTYPE_HASH_INDEX, sizeof(struct hash_bucket *) * size);
 	hash->size = size;
+	hash->min_size = size;
 	hash->hash_key = hash_key;
 	hash->hash_cmp = hash_cmp;
 	hash->count = 0;
@@ -78,48 +79,160 @@ void *hash_alloc_intern(void *arg)
 						  memory_order_relaxed);       \
 	} while (0)
 
-/* Expand hash if the chain length exceeds the threshold. */
-static void hash_expand(struct hash *hash)
+/* Put hb at the head of its chain in index, keeping the stats */
+static void hash_link(struct hash *hash, struct hash_bucket **index,
+		      unsigned int size, struct hash_bucket *hb)
 {
-	unsigned int i, new_size;
-	struct hash_bucket *hb, *hbnext, **new_index;
+	unsigned int h = hb->key & (size - 1);
+	int oldlen = index[h] ? index[h]->len : 0;
+	int newlen = oldlen + 1;
 
-	new_size = hash->size * 2;
+	hb->next = index[h];
+	if (newlen == 1)
+		hash->stats.empty--;
+	else
+		hb->next->len = 0;
 
-	if (hash->max_size && new_size > hash->max_size)
-		return;
+	hb->len = newlen;
 
-	new_index = XCALLOC(MTYPE_HASH_INDEX,
-			    sizeof(struct hash_bucket *) * new_size);
+	hash_update_ssq(hash, oldlen, newlen);
 
-	hash->stats.empty = new_size;
-
-	for (i = 0; i < hash->size; i++)
-		for (hb = hash->index[i]; hb; hb = hbnext) {
-			unsigned int h = hb->key & (new_size - 1);
+	index[h] = hb;
+}
 
-			hbnext = hb->next;
-			hb->next = new_index[h];
+/*
+ * Take the bucket holding data out of the chain at *head, keeping the
+ * stats, and return its data; NULL if it is not there
+ */
+static void *hash_unlink(struct hash *hash, struct hash_bucket **head,
+			 unsigned int key, void *data)
+{
+	struct hash_bucket *bucket, *pp;
+	void *ret;
 
-			int oldlen = hb->next ? hb->next->len : 0;
-			int newlen = oldlen + 1;
+	for (bucket = pp = *head; bucket; bucket = bucket->next) {
+		if (bucket->key == key && (*hash->hash_cmp)(bucket->data, data)) {
+			int oldlen = (*head)->len;
+			int newlen = oldlen - 1;
 
-			if (newlen == 1)
-				hash->stats.empty--;
+			if (bucket == pp)
+				*head = bucket->next;
 			else
-				hb->next->len = 0;
+				pp->next = bucket->next;
 
-			hb->len = newlen;
+			if (*head)
+				(*head)->len = newlen;
+			else
+				hash->stats.empty++;
 
 			hash_update_ssq(hash, oldlen, newlen);
 
-			new_index[h] = hb;
+			ret = bucket->data;
+			XFREE(MTYPE_HASH_BUCKET, bucket);
+			return ret;
 		}
+		pp = bucket;
+	}
 
-	/* Switch to new table */
-	XFREE(MTYPE_HASH_INDEX, hash->index);
+	return NULL;
+}
+
+/* The chain key would be on in the index being resized from, if any */
+static struct hash_bucket **hash_old_chain(struct hash *hash, unsigned int key)
+{
+	unsigned int i;
+
+	if (!hash->old_index)
+		return NULL;
+
+	i = key & (hash->old_size - 1);
+	return i >= hash->rehash_pos ? &hash->old_index[i] : NULL;
+}
+
+/* Move up to steps buckets of a resize in progress over */
+static void hash_rehash_step(struct hash *hash, unsigned int steps)
+{
+	struct hash_bucket *hb, *hbnext;
+
+	while (hash->old_index && steps--) {
+		hb = hash->old_index[hash->rehash_pos];
+
+		/* The bucket goes away with whatever it held */
+		if (hb)
+			hash_update_ssq(hash, hb->len, 0);
+		else
+			hash->stats.empty--;
+
+		for (; hb; hb = hbnext) {
+			hbnext = hb->next;
+			hash_link(hash, hash->index, hash->size, hb);
+		}
+
+		if (++hash->rehash_pos == hash->old_size) {
+			XFREE(MTYPE_HASH_INDEX, hash->old_index);
+			hash->old_size = 0;
+			hash->rehash_pos = 0;
+		}
+	}
+}
+
+void hash_rehash_complete(struct hash *hash)
+{
+	hash_rehash_step(hash, UINT_MAX);
+}
+
+/*
+ * Start moving the table over to an index of new_size buckets. The
+ * elements follow a few buckets at a time, with each insert and release,
+ * so that no single one of them pays for rehashing the whole table.
+ */
+static void hash_resize(struct hash *hash, unsigned int new_size)
+{
+	/* A walk sees the index as it was when it started */
+	if (hash->walking)
+		return;
+
+	hash_rehash_complete(hash);
+
+	hash->old_index = hash->index;
+	hash->old_size = hash->size;
+	hash->rehash_pos = 0;
+
+	hash->index = XCALLOC(MTYPE_HASH_INDEX,
+			      sizeof(struct hash_bucket *) * new_size);
 	hash->size = new_size;
-	hash->index = new_index;
+	hash->stats.empty += new_size;
+
+	hash_rehash_step(hash, HASH_REHASH_STEP);
+}
+
+/* Expand hash if the chain length exceeds the threshold. */
+static void hash_expand(struct hash *hash)
+{
+	unsigned int new_size = hash->size * 2;
+
+	if (hash->max_size && new_size > hash->max_size)
+		return;
+
+	hash_resize(hash, new_size);
+}
+
+/* Shrink hash back once it is mostly empty, returning the memory. */
+static void hash_shrink(struct hash *hash)
+{
+	if (hash->size <= hash->min_size)
+		return;
+
+	hash_resize(hash, hash->size / 2);
+}
+
+static struct hash_bucket *hash_find(struct hash *hash, struct hash_bucket *hb,
+				     unsigned int key, void *data)
+{
+	for (; hb; hb = hb->next)
+		if (hb->key == key && (*hash->hash_cmp)(hb->data, data))
+			return hb;
+	return NULL;
 }
 
 void *hash_get(struct hash *hash, void *data, void *(*alloc_func)(void *))
@@ -127,53 +240,42 @@ void *hash_get(struct hash *hash, void *data, void *(*alloc_func)(void *))
 	frrtrace(2, frr_libfrr, hash_get, hash, data);
 
 	unsigned int key;
-	unsigned int index;
 	void *newdata;
-	struct hash_bucket *bucket;
+	struct hash_bucket *bucket, **old;
 
 	if (!alloc_func && !hash->count)
 		return NULL;
 
 	key = (*hash->hash_key)(data);
-	index = key & (hash->size - 1);
 
-	for (bucket = hash->index[index]; bucket != NULL;
-	     bucket = bucket->next) {
-		if (bucket->key == key && (*hash->hash_cmp)(bucket->data, data))
-			return bucket->data;
+	bucket = hash_find(hash, hash->index[key & (hash->size - 1)], key,
+			   data);
+	if (!bucket) {
+		old = hash_old_chain(hash, key);
+		if (old)
+			bucket = hash_find(hash, *old, key, data);
 	}
+	if (bucket)
+		return bucket->data;
 
 	if (alloc_func) {
 		newdata = (*alloc_func)(data);
 		if (newdata == NULL)
 			return NULL;
 
-		if (HASH_THRESHOLD(hash->count + 1, hash->size)) {
+		if (HASH_THRESHOLD(hash->count + 1, hash->size))
 			hash_expand(hash);
-			index = key & (hash->size - 1);
-		}
+		else if (!hash->walking)
+			hash_rehash_step(hash, HASH_REHASH_STEP);
 
 		bucket = XCALLOC(MTYPE_HASH_BUCKET, sizeof(struct hash_bucket));
 		bucket->data = newdata;
 		bucket->key = key;
-		bucket->next = hash->index[index];
-		hash->index[index] = bucket;
+		hash_link(hash, hash->index, hash->size, bucket);
 		hash->count++;
 
 		frrtrace(3, frr_libfrr, hash_insert, hash, data, key);
 
-		int oldlen = bucket->next ? bucket->next->len : 0;
-		int newlen = oldlen + 1;
-
-		if (newlen == 1)
-			hash->stats.empty--;
-		else
-			bucket->next->len = 0;
-
-		bucket->len = newlen;
-
-		hash_update_ssq(hash, oldlen, newlen);
-
 		return bucket->data;
 	}
 	return NULL;
@@ -196,39 +298,27 @@ unsigned int string_hash_make(const char *str)
 
 void *hash_release(struct hash *hash, void *data)
 {
-	void *ret = NULL;
+	void *ret;
 	unsigned int key;
-	unsigned int index;
-	struct hash_bucket *bucket;
-	struct hash_bucket *pp;
+	struct hash_bucket **old;
 
 	key = (*hash->hash_key)(data);
-	index = key & (hash->size - 1);
 
-	for (bucket = pp = hash->index[index]; bucket; bucket = bucket->next) {
-		if (bucket->key == key
-		    && (*hash->hash_cmp)(bucket->data, data)) {
-			int oldlen = hash->index[index]->len;
-			int newlen = oldlen - 1;
-
-			if (bucket == pp)
-				hash->index[index] = bucket->next;
-			else
-				pp->next = bucket->next;
+	ret = hash_unlink(hash, &hash->index[key & (hash->size - 1)], key,
+			  data);
+	if (!ret) {
+		old = hash_old_chain(hash, key);
+		if (old)
+			ret = hash_unlink(hash, old, key, data);
+	}
 
-			if (hash->index[index])
-				hash->index[index]->len = newlen;
-			else
-				hash->stats.empty++;
+	if (ret) {
+		hash->count--;
 
-			hash_update_ssq(hash, oldlen, newlen);
-
-			ret = bucket->data;
-			XFREE(MTYPE_HASH_BUCKET, bucket);
-			hash->count--;
-			break;
-		}
-		pp = bucket;
+		if (HASH_LOW_THRESHOLD(hash->count, hash->size))
+			hash_shrink(hash);
+		else if (!hash->walking)
+			hash_rehash_step(hash, HASH_REHASH_STEP);
 	}
 
 	frrtrace(3, frr_libfrr, hash_release, hash, data, ret);
@@ -243,6 +333,9 @@ void hash_iterate(struct hash *hash, void (*func)(struct hash_bucket *, void *),
 	struct hash_bucket *hb;
 	struct hash_bucket *hbnext;
 
+	hash_rehash_complete(hash);
+	hash->walking++;
+
 	for (i = 0; i < hash->size; i++)
 		for (hb = hash->index[i]; hb; hb = hbnext) {
 			/* get pointer to next hash bucket here, in case (*func)
@@ -251,6 +344,8 @@ void hash_iterate(struct hash *hash, void (*func)(struct hash_bucket *, void *),
 			hbnext = hb->next;
 			(*func)(hb, arg);
 		}
+
+	hash->walking--;
 }
 
 void hash_walk(struct hash *hash, int (*func)(struct hash_bucket *, void *),
@@ -261,6 +356,9 @@ void hash_walk(struct hash *hash, int (*func)(struct hash_bucket *, void *),
 	struct hash_bucket *hbnext;
 	int ret = HASHWALK_CONTINUE;
 
+	hash_rehash_complete(hash);
+	hash->walking++;
+
 	for (i = 0; i < hash->size; i++) {
 		for (hb = hash->index[i]; hb; hb = hbnext) {
 			/* get pointer to next hash bucket here, in case (*func)
@@ -269,9 +367,12 @@ void hash_walk(struct hash *hash, int (*func)(struct hash_bucket *, void *),
 			hbnext = hb->next;
 			ret = (*func)(hb, arg);
 			if (ret == HASHWALK_ABORT)
-				return;
+				goto out;
 		}
 	}
+
+out:
+	hash->walking--;
 }
 
 void hash_clean(struct hash *hash, void (*free_func)(void *))
@@ -280,6 +381,9 @@ void hash_clean(struct hash *hash, void (*free_func)(void *))
 	struct hash_bucket *hb;
 	struct hash_bucket *next;
 
+	hash_rehash_complete(hash);
+	hash->walking++;
+
 	for (i = 0; i < hash->size; i++) {
 		for (hb = hash->index[i]; hb; hb = next) {
 			next = hb->next;
@@ -293,6 +397,8 @@ void hash_clean(struct hash *hash, void (*free_func)(void *))
 		hash->index[i] = NULL;
 	}
 
+	hash->walking--;
+
 	hash->stats.ssq = 0;
 	hash->stats.empty = hash->size;
 }
@@ -335,6 +441,7 @@ void hash_free(struct hash *hash)
 
 	XFREE(MTYPE_HASH, hash->name);
 
+	XFREE(MTYPE_HASH_INDEX, hash->old_index);
 	XFREE(MTYPE_HASH_INDEX, hash->index);
 	XFREE(MTYPE_HASH, hash);
 }
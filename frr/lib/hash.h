@@ -17,6 +17,10 @@ extern "C" {
 #define HASH_INITIAL_SIZE 256
 /* Expansion threshold */
 #define HASH_THRESHOLD(used, size) ((used) > (size))
+/* Shrink threshold, never below the size the table was created with */
+#define HASH_LOW_THRESHOLD(used, size) ((used) < (size) / 8)
+/* Buckets moved to the new index per insert or release while resizing */
+#define HASH_REHASH_STEP 16
 
 #define HASHWALK_CONTINUE 0
 #define HASHWALK_ABORT -1
@@ -55,6 +59,21 @@ struct hash {
 	/* If max_size is 0 there is no limit */
 	unsigned int max_size;
 
+	/* Size the table was created with, which it does not shrink below */
+	unsigned int min_size;
+
+	/*
+	 * While resizing: the previous index, whose buckets from rehash_pos
+	 * up are still to be moved over into index, a few at each insert or
+	 * release. Lookups check both.
+	 */
+	struct hash_bucket **old_index;
+	unsigned int old_size;
+	unsigned int rehash_pos;
+
+	/* Walks in progress, during which the table is not resized */
+	unsigned int walking;
+
 	/* Key make function. */
 	unsigned int (*hash_key)(const void *);
 
@@ -217,6 +236,16 @@ extern void *hash_lookup(struct hash *hash, void *data);
  */
 extern void *hash_release(struct hash *hash, void *data);
 
+/*
+ * Finish moving the elements of a resize in progress over to the new
+ * index. Only needed by code that walks hash->index by hand rather than
+ * with hash_iterate() or hash_walk().
+ *
+ * hash
+ *    hash table to operate on
+ */
+extern void hash_rehash_complete(struct hash *hash);
+
 /*
  * Iterate over the elements in a hash table.
  *
@@ -1018,6 +1018,40 @@ struct connected *connected_get_linklocal(struct interface *ifp)
 	return c;
 }
 
+/*
+ * IPv4 address of the router at the other end of a point-to-point link:
+ * the peer of a peer address, or the other host of a /31 or /30 subnet.
+ */
+bool connected_get_link_peer(const struct interface *ifp, struct in_addr *peer)
+{
+	struct listnode *n;
+	struct connected *c;
+	uint32_t addr;
+
+	for (ALL_LIST_ELEMENTS_RO(ifp->connected, n, c)) {
+		if (c->address->family != AF_INET)
+			continue;
+
+		if (CONNECTED_PEER(c) && c->destination) {
+			*peer = c->destination->u.prefix4;
+			return true;
+		}
+
+		addr = ntohl(c->address->u.prefix4.s_addr);
+		if (c->address->prefixlen == IPV4_MAX_BITLEN - 1)
+			addr ^= 1;
+		else if (c->address->prefixlen == IPV4_MAX_BITLEN - 2 &&
+			 (addr & 3) != 0 && (addr & 3) != 3)
+			addr ^= 3;
+		else
+			continue;
+		peer->s_addr = htonl(addr);
+		return true;
+	}
+
+	return false;
+}
+
 void if_terminate(struct vrf *vrf)
 {
 	struct interface *ifp;
@@ -168,6 +168,7 @@ enum affinity_mode {
 #define LP_AVA_BW               0x0800
 #define LP_USE_BW               0x1000
 #define LP_EXTEND_ADM_GRP 0x2000
+#define LP_DELAY_MEASURED 0x4000 /* delays come from TWAMP measurements */
 
 #define IS_PARAM_UNSET(lp, st) !(lp->lp_status & st)
 #define IS_PARAM_SET(lp, st) (lp->lp_status & st)
@@ -593,6 +594,8 @@ extern struct nbr_connected *nbr_connected_new(void);
 extern void nbr_connected_free(struct nbr_connected *);
 struct nbr_connected *nbr_connected_check(struct interface *, struct prefix *);
 struct connected *connected_get_linklocal(struct interface *ifp);
+extern bool connected_get_link_peer(const struct interface *ifp,
+				    struct in_addr *peer);
 
 /* link parameters */
 bool if_link_params_cmp(struct if_link_params *iflp1,
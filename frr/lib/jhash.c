@@ -55,6 +55,24 @@
 		c ^= (b >> 15);                                                \
 	}
 
+/*
+ * The next four bytes at k, little-endian. Where that is the host's own
+ * order it is one unaligned load rather than four byte loads summed,
+ * which compilers do not fold on their own.
+ */
+static inline uint32_t jhash_get32(const uint8_t *k)
+{
+#if BYTE_ORDER == LITTLE_ENDIAN
+	uint32_t v;
+
+	memcpy(&v, k, sizeof(v));
+	return v;
+#else
+	return k[0] + ((uint32_t)k[1] << 8) + ((uint32_t)k[2] << 16)
+	       + ((uint32_t)k[3] << 24);
+#endif
+}
+
 /* The most generic version, hashes an arbitrary sequence
  * of bytes.  No alignment or length assumptions are made about
  * the input key.
@@ -69,12 +87,9 @@ uint32_t jhash(const void *key, uint32_t length, uint32_t initval)
 	c = initval;
 
 	while (len >= 12) {
-		a += (k[0] + ((uint32_t)k[1] << 8) + ((uint32_t)k[2] << 16)
-		      + ((uint32_t)k[3] << 24));
-		b += (k[4] + ((uint32_t)k[5] << 8) + ((uint32_t)k[6] << 16)
-		      + ((uint32_t)k[7] << 24));
-		c += (k[8] + ((uint32_t)k[9] << 8) + ((uint32_t)k[10] << 16)
-		      + ((uint32_t)k[11] << 24));
+		a += jhash_get32(k);
+		b += jhash_get32(k + 4);
+		c += jhash_get32(k + 8);
 
 		__jhash_mix(a, b, c);
 
@@ -24,6 +24,7 @@
 #include "module.h"
 #include "defaults.h"
 #include "lib_vty.h"
+#include "libfrr.h"
 #include "northbound_cli.h"
 
 /* Looking up memory status from vty interface. */
@@ -119,10 +120,18 @@ DEFUN_NOSH (show_memory,
 	    "Show running system information\n"
 	    "Memory statistics\n")
 {
+	size_t slabs, bytes;
+	char buf[MTYPE_MEMSTR_LEN];
+
 #ifdef HAVE_MALLINFO
 	show_memory_mallinfo(vty);
 #endif /* HAVE_MALLINFO */
 
+	qmem_pool_stats(&slabs, &bytes);
+	if (slabs)
+		vty_out(vty, "Size-class pools: %zu slabs, %s\n", slabs,
+			mtype_memstr(buf, MTYPE_MEMSTR_LEN, bytes));
+
 	qmem_walk(qmem_walker, vty);
 	return CMD_SUCCESS;
 }
@@ -281,6 +290,17 @@ static const struct cmd_variable_handler default_var_handlers[] = {
 	{.completions = NULL},
 };
 
+/* Sent by watchfrr ahead of a warm restart */
+DEFUN_HIDDEN (warm_restart_prepare,
+	      warm_restart_prepare_cmd,
+	      "warm-restart prepare",
+	      "Planned restart coordinated by watchfrr\n"
+	      "Leave state behind for the next instance of this daemon\n")
+{
+	frr_prepare_warm_restart();
+	return CMD_SUCCESS;
+}
+
 void lib_cmd_init(void)
 {
 	cmd_variable_handler_register(default_var_handlers);
@@ -290,6 +310,7 @@ void lib_cmd_init(void)
 
 	install_element(VIEW_NODE, &show_memory_cmd);
 	install_element(VIEW_NODE, &show_modules_cmd);
+	install_element(ENABLE_NODE, &warm_restart_prepare_cmd);
 
 	install_element(CONFIG_NODE, &start_config_cmd);
 	install_element(CONFIG_NODE, &end_config_cmd);
@@ -39,6 +39,7 @@ DEFINE_HOOK(frr_config_pre, (struct event_loop * tm), (tm));
 DEFINE_HOOK(frr_config_post, (struct event_loop * tm), (tm));
 DEFINE_KOOH(frr_early_fini, (), ());
 DEFINE_KOOH(frr_fini, (), ());
+DEFINE_HOOK(frr_warm_restart_prepare, (), ());
 
 const char frr_sysconfdir[] = SYSCONFDIR;
 char frr_vtydir[256];
@@ -63,6 +64,7 @@ static char vtypath_default[512];
 bool frr_is_after_fork = true;
 bool debug_memstats_at_exit = false;
 static bool nodetach_term, nodetach_daemon;
+static bool warm_restart;
 static uint64_t startup_fds;
 
 static char comb_optstr[256];
@@ -96,6 +98,7 @@ static void opt_extend(const struct optspec *os)
 #define OPTION_LOGGING   1007
 #define OPTION_LIMIT_FDS 1008
 #define OPTION_SCRIPTDIR 1009
+#define OPTION_EPOLL     1010
 
 static const struct option lo_always[] = {
 	{"help", no_argument, NULL, 'h'},
@@ -112,6 +115,7 @@ static const struct option lo_always[] = {
 	{"log-level", required_argument, NULL, OPTION_LOGLEVEL},
 	{"command-log-always", no_argument, NULL, OPTION_LOGGING},
 	{"limit-fds", required_argument, NULL, OPTION_LIMIT_FDS},
+	{"epoll", no_argument, NULL, OPTION_EPOLL},
 	{NULL}};
 static const struct optspec os_always = {
 	"hvdM:F:N:o:",
@@ -127,7 +131,8 @@ static const struct optspec os_always = {
 	"      --scriptdir    Override scripts directory\n"
 	"      --log          Set Logging to stdout, syslog, or file:<name>\n"
 	"      --log-level    Set Logging Level to use, debug, info, warn, etc\n"
-	"      --limit-fds    Limit number of fds supported\n",
+	"      --limit-fds    Limit number of fds supported\n"
+	"      --epoll        Wait for I/O with epoll rather than poll\n",
 	lo_always};
 
 static bool logging_to_stdout = false; /* set when --log stdout specified */
@@ -315,6 +320,12 @@ void frr_preinit(struct frr_daemon_info *daemon, int argc, char **argv)
 	di = daemon;
 	frr_is_after_fork = false;
 
+	/* Set by watchfrr for the restart command, not for our own children */
+	if (getenv(FRR_WARM_RESTART_ENV)) {
+		warm_restart = true;
+		unsetenv(FRR_WARM_RESTART_ENV);
+	}
+
 	/* basename(), opencoded. */
 	char *p = strrchr(argv[0], '/');
 	di->progname = p ? p + 1 : argv[0];
@@ -379,6 +390,17 @@ void frr_preinit(struct frr_daemon_info *daemon, int argc, char **argv)
 	systemd_init_env();
 }
 
+bool frr_is_warm_restart(void)
+{
+	return warm_restart;
+}
+
+void frr_prepare_warm_restart(void)
+{
+	zlog_notice("Preparing for a warm restart");
+	hook_call(frr_warm_restart_prepare);
+}
+
 bool frr_is_startup_fd(int fd)
 {
 	return !!(startup_fds & (UINT64_C(0x1) << (uint64_t)fd));
@@ -619,6 +641,9 @@ static int frr_opt(int opt)
 	case OPTION_LIMIT_FDS:
 		di->limit_fds = strtoul(optarg, &err, 0);
 		break;
+	case OPTION_EPOLL:
+		di->use_epoll = true;
+		break;
 	default:
 		return 1;
 	}
@@ -828,6 +853,11 @@ uint32_t frr_get_fd_limit(void)
 	return di ? di->limit_fds : 0;
 }
 
+bool frr_get_use_epoll(void)
+{
+	return di ? di->use_epoll : false;
+}
+
 static int rcvd_signal = 0;
 
 static void rcv_signal(int signum)
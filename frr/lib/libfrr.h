@@ -109,6 +109,9 @@ struct frr_daemon_info {
 
 	/* Optional upper limit on the number of fds used in select/poll */
 	uint32_t limit_fds;
+
+	/* Wait for I/O with epoll rather than poll, where there is epoll */
+	bool use_epoll;
 };
 
 /* execname is the daemon's executable (and pidfile and configfile) name,
@@ -142,8 +145,20 @@ extern struct event_loop *frr_init(void);
 extern const char *frr_get_progname(void);
 extern enum frr_cli_mode frr_get_cli_mode(void);
 extern uint32_t frr_get_fd_limit(void);
+extern bool frr_get_use_epoll(void);
 extern bool frr_is_startup_fd(int fd);
 
+/*
+ * Planned restart coordinated by watchfrr ("watchfrr warm-restart").  The
+ * running daemon gets frr_warm_restart_prepare before it is stopped, to
+ * leave behind what its replacement can pick up (e.g. zebra its kernel
+ * routes); the replacement sees frr_is_warm_restart() true.
+ */
+#define FRR_WARM_RESTART_ENV "FRR_WARM_RESTART"
+DECLARE_HOOK(frr_warm_restart_prepare, (), ());
+extern bool frr_is_warm_restart(void);
+extern void frr_prepare_warm_restart(void);
+
 /* call order of these hooks is as ordered here */
 DECLARE_HOOK(frr_early_init, (struct event_loop * tm), (tm));
 DECLARE_HOOK(frr_late_init, (struct event_loop * tm), (tm));
@@ -457,7 +457,8 @@ static const struct zebra_desc_table command_types[] = {
 	DESC_ENTRY(ZEBRA_TC_CLASS_DELETE),
 	DESC_ENTRY(ZEBRA_TC_FILTER_ADD),
 	DESC_ENTRY(ZEBRA_TC_FILTER_DELETE),
-	DESC_ENTRY(ZEBRA_OPAQUE_NOTIFY)
+	DESC_ENTRY(ZEBRA_OPAQUE_NOTIFY),
+	DESC_ENTRY(ZEBRA_ROUTE_ADD_BULK)
 };
 #undef DESC_ENTRY
 
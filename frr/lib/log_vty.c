@@ -175,6 +175,7 @@ DEFUN_NOSH (show_logging,
 	    "Show current logging configuration\n")
 {
 	int stdout_prio;
+	uint64_t async_queued, async_dropped;
 
 	log_show_syslog(vty);
 
@@ -221,6 +222,14 @@ DEFUN_NOSH (show_logging,
 		(zt_file.record_priority ? "enabled" : "disabled"));
 	vty_out(vty, "Timestamp precision: %d\n", zt_file.ts_subsec);
 
+	zlog_async_stats(&async_queued, &async_dropped);
+	vty_out(vty, "Asynchronous output: %s",
+		zlog_get_async() ? "enabled" : "disabled");
+	if (async_queued || async_dropped)
+		vty_out(vty, ", %" PRIu64 " messages queued, %" PRIu64
+			" dropped", async_queued, async_dropped);
+	vty_out(vty, "\n");
+
 	hook_call(zlog_cli_show, vty);
 	return CMD_SUCCESS;
 }
@@ -758,6 +767,18 @@ DEFPY (log_immediate_mode,
 	return CMD_SUCCESS;
 }
 
+/* Enable/disable writing messages out on a separate pthread */
+DEFPY (log_asynchronous,
+       log_asynchronous_cmd,
+       "[no] log asynchronous",
+       NO_STR
+       "Logging control\n"
+       "Write buffered messages out on a separate thread, dropping debugs it cannot keep up with\n")
+{
+	zlog_set_async(!no);
+	return CMD_SUCCESS;
+}
+
 void log_config_write(struct vty *vty)
 {
 	bool show_cmdline_hint = false;
@@ -837,6 +858,8 @@ void log_config_write(struct vty *vty)
 		vty_out(vty, "no log error-category\n");
 	if (!zlog_get_prefix_xid())
 		vty_out(vty, "no log unique-id\n");
+	if (zlog_get_async())
+		vty_out(vty, "log asynchronous\n");
 
 	if (logmsgs_with_persist_bt) {
 		struct xrefdata *xrd;
@@ -910,6 +933,7 @@ void log_cmd_init(void)
 	install_element(CONFIG_NODE, &config_log_filterfile_cmd);
 	install_element(CONFIG_NODE, &no_config_log_filterfile_cmd);
 	install_element(CONFIG_NODE, &log_immediate_mode_cmd);
+	install_element(CONFIG_NODE, &log_asynchronous_cmd);
 
 	install_element(ENABLE_NODE, &debug_uid_backtrace_cmd);
 	install_element(CONFIG_NODE, &debug_uid_backtrace_cmd);
@@ -6,6 +6,7 @@
 #include <zebra.h>
 
 #include <stdlib.h>
+#include <pthread.h>
 #ifdef HAVE_MALLOC_H
 #include <malloc.h>
 #endif
@@ -27,6 +28,208 @@ DEFINE_MGROUP(LIB, "libfrr");
 DEFINE_MTYPE(LIB, TMP, "Temporary memory");
 DEFINE_MTYPE(LIB, BITFIELD, "Bitfield memory");
 
+/* size-class pools
+ *
+ * Each object is preceded by a header giving its class and usable size,
+ * so that frees (and realloc copies) need nothing else.  Free objects are
+ * linked through their first word.  A pthread keeps up to MT_POOL_TCACHE
+ * objects per class for itself and trades with the shared lists in batches
+ * of MT_POOL_BATCH, under mt_pool_mtx.
+ */
+#define MT_POOL_SLAB	(64 * 1024)
+#define MT_POOL_TCACHE	64
+#define MT_POOL_BATCH	32
+#define MT_POOL_LARGE	UINT32_MAX
+
+struct mt_pool_hdr {
+	size_t size;
+	uint32_t cls;
+} __attribute__((aligned(16)));
+
+static const uint32_t mt_pool_sizes[] = {
+	16,  32,  48,  64,  80,  96,  112, 128, 160, 192,
+	224, 256, 320, 384, 448, 512, 640, 768, 896, 1024,
+};
+#define MT_POOL_CLASSES array_size(mt_pool_sizes)
+
+static pthread_mutex_t mt_pool_mtx = PTHREAD_MUTEX_INITIALIZER;
+static void *mt_pool_free_list[MT_POOL_CLASSES];
+/* chained through their first word, to keep them reachable */
+static void *mt_pool_slabs;
+static size_t mt_pool_slab_count;
+
+struct mt_pool_cache {
+	void *free[MT_POOL_CLASSES];
+	unsigned int count[MT_POOL_CLASSES];
+	bool registered;
+};
+
+#ifndef thread_local
+#define thread_local __thread
+#endif
+
+static thread_local struct mt_pool_cache mt_pool_cache;
+static pthread_key_t mt_pool_key;
+
+static inline unsigned int mt_pool_class(size_t size)
+{
+	unsigned int cls;
+
+	if (size <= 128)
+		return size ? (size - 1) / 16 : 0;
+	for (cls = 8; cls < MT_POOL_CLASSES; cls++)
+		if (size <= mt_pool_sizes[cls])
+			break;
+	return cls;
+}
+
+/* with mt_pool_mtx held */
+static void mt_pool_carve(unsigned int cls)
+{
+	size_t slotsize = sizeof(struct mt_pool_hdr) + mt_pool_sizes[cls];
+	struct mt_pool_hdr *hdr;
+	char *slab, *slot;
+
+	slab = malloc(MT_POOL_SLAB);
+	if (!slab)
+		memory_oom(MT_POOL_SLAB, "size-class pool");
+	*(void **)slab = mt_pool_slabs;
+	mt_pool_slabs = slab;
+	mt_pool_slab_count++;
+
+	for (slot = slab + sizeof(struct mt_pool_hdr);
+	     slot + slotsize <= slab + MT_POOL_SLAB; slot += slotsize) {
+		hdr = (struct mt_pool_hdr *)slot;
+		hdr->cls = cls;
+		hdr->size = mt_pool_sizes[cls];
+		*(void **)(hdr + 1) = mt_pool_free_list[cls];
+		mt_pool_free_list[cls] = hdr + 1;
+	}
+}
+
+static void mt_pool_give(struct mt_pool_cache *pc, unsigned int cls,
+			 unsigned int n)
+{
+	void *obj;
+
+	pthread_mutex_lock(&mt_pool_mtx);
+	while (n-- && (obj = pc->free[cls])) {
+		pc->free[cls] = *(void **)obj;
+		pc->count[cls]--;
+		*(void **)obj = mt_pool_free_list[cls];
+		mt_pool_free_list[cls] = obj;
+	}
+	pthread_mutex_unlock(&mt_pool_mtx);
+}
+
+static void mt_pool_take(struct mt_pool_cache *pc, unsigned int cls)
+{
+	unsigned int n;
+	void *obj;
+
+	if (!pc->registered) {
+		/* so that the cache goes back as the pthread exits */
+		pthread_setspecific(mt_pool_key, pc);
+		pc->registered = true;
+	}
+
+	pthread_mutex_lock(&mt_pool_mtx);
+	if (!mt_pool_free_list[cls])
+		mt_pool_carve(cls);
+	for (n = 0; n < MT_POOL_BATCH && (obj = mt_pool_free_list[cls]); n++) {
+		mt_pool_free_list[cls] = *(void **)obj;
+		*(void **)obj = pc->free[cls];
+		pc->free[cls] = obj;
+		pc->count[cls]++;
+	}
+	pthread_mutex_unlock(&mt_pool_mtx);
+}
+
+static void mt_pool_cache_fini(void *arg)
+{
+	struct mt_pool_cache *pc = arg;
+	unsigned int cls;
+
+	for (cls = 0; cls < MT_POOL_CLASSES; cls++)
+		mt_pool_give(pc, cls, UINT_MAX);
+	pc->registered = false;
+}
+
+static void mt_pool_key_init(void) __attribute__((_CONSTRUCTOR(500)));
+static void mt_pool_key_init(void)
+{
+	pthread_key_create(&mt_pool_key, mt_pool_cache_fini);
+}
+
+static void *mt_pool_alloc(size_t size)
+{
+	struct mt_pool_cache *pc = &mt_pool_cache;
+	struct mt_pool_hdr *hdr;
+	unsigned int cls = mt_pool_class(size);
+	void *obj;
+
+	if (cls == MT_POOL_CLASSES) {
+		hdr = malloc(sizeof(*hdr) + size);
+		if (!hdr)
+			return NULL;
+		hdr->cls = MT_POOL_LARGE;
+		hdr->size = size;
+		return hdr + 1;
+	}
+
+	if (!pc->free[cls])
+		mt_pool_take(pc, cls);
+	obj = pc->free[cls];
+	pc->free[cls] = *(void **)obj;
+	pc->count[cls]--;
+	return obj;
+}
+
+static void mt_pool_free(void *ptr)
+{
+	struct mt_pool_cache *pc = &mt_pool_cache;
+	struct mt_pool_hdr *hdr = (struct mt_pool_hdr *)ptr - 1;
+	unsigned int cls = hdr->cls;
+
+	if (cls == MT_POOL_LARGE) {
+		free(hdr);
+		return;
+	}
+
+	*(void **)ptr = pc->free[cls];
+	pc->free[cls] = ptr;
+	if (++pc->count[cls] > MT_POOL_TCACHE)
+		mt_pool_give(pc, cls, MT_POOL_BATCH);
+}
+
+static inline size_t mt_pool_usable(const void *ptr)
+{
+	return ((const struct mt_pool_hdr *)ptr - 1)->size;
+}
+
+bool qmem_pool_enable(struct memtype *mt)
+{
+	if (atomic_load_explicit(&mt->n_alloc, memory_order_relaxed))
+		return false;
+	mt->pooled = true;
+	return true;
+}
+
+void qmem_pool_stats(size_t *slabs, size_t *bytes)
+{
+	pthread_mutex_lock(&mt_pool_mtx);
+	*slabs = mt_pool_slab_count;
+	pthread_mutex_unlock(&mt_pool_mtx);
+	*bytes = *slabs * MT_POOL_SLAB;
+}
+
+#ifdef HAVE_MALLOC_USABLE_SIZE
+static inline size_t mt_usable_size(struct memtype *mt, void *ptr)
+{
+	return mt->pooled ? mt_pool_usable(ptr) : malloc_usable_size(ptr);
+}
+#endif
+
 static inline void mt_count_alloc(struct memtype *mt, size_t size, void *ptr)
 {
 	size_t current;
@@ -52,7 +255,7 @@ static inline void mt_count_alloc(struct memtype *mt, size_t size, void *ptr)
 				      memory_order_relaxed);
 
 #ifdef HAVE_MALLOC_USABLE_SIZE
-	size_t mallocsz = malloc_usable_size(ptr);
+	size_t mallocsz = mt_usable_size(mt, ptr);
 
 	current = mallocsz + atomic_fetch_add_explicit(&mt->total, mallocsz,
 						       memory_order_relaxed);
@@ -74,7 +277,7 @@ static inline void mt_count_free(struct memtype *mt, void *ptr)
 	atomic_fetch_sub_explicit(&mt->n_alloc, 1, memory_order_relaxed);
 
 #ifdef HAVE_MALLOC_USABLE_SIZE
-	size_t mallocsz = malloc_usable_size(ptr);
+	size_t mallocsz = mt_usable_size(mt, ptr);
 
 	atomic_fetch_sub_explicit(&mt->total, mallocsz, memory_order_relaxed);
 #endif
@@ -97,16 +300,42 @@ static inline void *mt_checkalloc(struct memtype *mt, void *ptr, size_t size)
 
 void *qmalloc(struct memtype *mt, size_t size)
 {
+	if (mt->pooled)
+		return mt_checkalloc(mt, mt_pool_alloc(size), size);
 	return mt_checkalloc(mt, malloc(size), size);
 }
 
 void *qcalloc(struct memtype *mt, size_t size)
 {
+	void *ptr;
+
+	if (mt->pooled) {
+		ptr = mt_pool_alloc(size);
+		if (ptr)
+			memset(ptr, 0, size);
+		return mt_checkalloc(mt, ptr, size);
+	}
 	return mt_checkalloc(mt, calloc(size, 1), size);
 }
 
+static void *qrealloc_pooled(struct memtype *mt, void *ptr, size_t size)
+{
+	void *new;
+
+	new = mt_pool_alloc(size);
+	if (ptr) {
+		if (new)
+			memcpy(new, ptr, MIN(mt_pool_usable(ptr), size));
+		mt_count_free(mt, ptr);
+		mt_pool_free(ptr);
+	}
+	return mt_checkalloc(mt, new, size);
+}
+
 void *qrealloc(struct memtype *mt, void *ptr, size_t size)
 {
+	if (mt->pooled)
+		return qrealloc_pooled(mt, ptr, size);
 	if (ptr)
 		mt_count_free(mt, ptr);
 	return mt_checkalloc(mt, ptr ? realloc(ptr, size) : malloc(size), size);
@@ -114,11 +343,24 @@ void *qrealloc(struct memtype *mt, void *ptr, size_t size)
 
 void *qstrdup(struct memtype *mt, const char *str)
 {
+	size_t len;
+	char *ptr;
+
+	if (str && mt->pooled) {
+		len = strlen(str) + 1;
+		ptr = mt_pool_alloc(len);
+		if (ptr)
+			memcpy(ptr, str, len);
+		return mt_checkalloc(mt, ptr, len);
+	}
 	return str ? mt_checkalloc(mt, strdup(str), strlen(str) + 1) : NULL;
 }
 
 void qcountfree(struct memtype *mt, void *ptr)
 {
+	/* whoever free()s it does not know about the pool */
+	assert(!mt->pooled);
+
 	if (ptr)
 		mt_count_free(mt, ptr);
 }
@@ -127,6 +369,11 @@ void qfree(struct memtype *mt, void *ptr)
 {
 	if (ptr)
 		mt_count_free(mt, ptr);
+	if (mt->pooled) {
+		if (ptr)
+			mt_pool_free(ptr);
+		return;
+	}
 	free(ptr);
 }
 
@@ -32,6 +32,8 @@ struct memtype {
 	atomic_size_t total;
 	atomic_size_t max_size;
 #endif
+	/* served from the size-class pools, see qmem_pool_enable() */
+	bool pooled;
 };
 
 struct memgroup {
@@ -155,6 +157,22 @@ extern void qcountfree(struct memtype *mt, void *ptr)
 	__attribute__((nonnull(1)));
 extern void qfree(struct memtype *mt, void *ptr) __attribute__((nonnull(1)));
 
+/* Size-class pools, for a daemon's hottest small-object memtypes.
+ *
+ * Allocations of a pooled memtype up to 1K are carved from 64K slabs in
+ * size classes and freed through a per-pthread cache, so both are a list
+ * push or pop in the common case; larger ones still go to malloc.  Slabs
+ * are kept for the life of the process.  Accounting is as for any other
+ * memtype, with the class size as the allocation's size.
+ *
+ * Must be called before the first allocation of mt, i.e. early in main();
+ * returns false (and changes nothing) if mt already has allocations.
+ * XCOUNTFREE cannot be used on a pooled memtype.
+ */
+extern bool qmem_pool_enable(struct memtype *mt);
+/* Slabs carved so far, and their total size */
+extern void qmem_pool_stats(size_t *slabs, size_t *bytes);
+
 #define XMALLOC(mtype, size)		qmalloc(mtype, size)
 #define XCALLOC(mtype, size)		qcalloc(mtype, size)
 #define XREALLOC(mtype, ptr, size)	qrealloc(mtype, ptr, size)
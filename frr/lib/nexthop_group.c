@@ -197,11 +197,14 @@ static struct nexthop *nhg_nh_find(const struct nexthop_group *nhg,
 	return NULL;
 }
 
-static bool
-nexthop_group_equal_common(const struct nexthop_group *nhg1,
-			   const struct nexthop_group *nhg2,
-			   uint8_t (*nexthop_group_nexthop_num_func)(
-				   const struct nexthop_group *nhg))
+/*
+ * Only rules out a missing group; the walks below end on the first
+ * nexthop that differs, including one group running out before the
+ * other, so counting the nexthops up front would just walk both groups
+ * once more.
+ */
+static bool nexthop_group_equal_common(const struct nexthop_group *nhg1,
+				       const struct nexthop_group *nhg2)
 {
 	if (nhg1 && !nhg2)
 		return false;
@@ -209,13 +212,6 @@ nexthop_group_equal_common(const struct nexthop_group *nhg1,
 	if (!nhg1 && nhg2)
 		return false;
 
-	if (nhg1 == nhg2)
-		return true;
-
-	if (nexthop_group_nexthop_num_func(nhg1)
-	    != nexthop_group_nexthop_num_func(nhg2))
-		return false;
-
 	return true;
 }
 
@@ -226,9 +222,10 @@ bool nexthop_group_equal_no_recurse(const struct nexthop_group *nhg1,
 	struct nexthop *nh1 = NULL;
 	struct nexthop *nh2 = NULL;
 
-	if (!nexthop_group_equal_common(nhg1, nhg2,
-					&nexthop_group_nexthop_num_no_recurse))
+	if (!nexthop_group_equal_common(nhg1, nhg2))
 		return false;
+	if (nhg1 == nhg2)
+		return true;
 
 	for (nh1 = nhg1->nexthop, nh2 = nhg2->nexthop; nh1 || nh2;
 	     nh1 = nh1->next, nh2 = nh2->next) {
@@ -250,8 +247,10 @@ bool nexthop_group_equal(const struct nexthop_group *nhg1,
 	struct nexthop *nh1 = NULL;
 	struct nexthop *nh2 = NULL;
 
-	if (!nexthop_group_equal_common(nhg1, nhg2, &nexthop_group_nexthop_num))
+	if (!nexthop_group_equal_common(nhg1, nhg2))
 		return false;
+	if (nhg1 == nhg2)
+		return true;
 
 	for (nh1 = nhg1->nexthop, nh2 = nhg2->nexthop; nh1 || nh2;
 	     nh1 = nexthop_next(nh1), nh2 = nexthop_next(nh2)) {
@@ -472,6 +471,54 @@ uint32_t nexthop_group_hash(const struct nexthop_group *nhg)
 	return key;
 }
 
+struct nexthop *nexthop_group_to_array(const struct nexthop_group *nhg)
+{
+	struct nexthop *array = NULL, *nh, *copy;
+
+	darr_ensure_cap(array, nexthop_group_nexthop_num(nhg));
+
+	for (ALL_NEXTHOPS_PTR(nhg, nh)) {
+		copy = darr_append(array);
+		*copy = *nh;
+		/* The links would point back into the group */
+		copy->next = copy->prev = NULL;
+		copy->resolved = copy->rparent = NULL;
+	}
+
+	return array;
+}
+
+void nexthop_array_free(struct nexthop **array)
+{
+	darr_free(*array);
+}
+
+uint32_t nexthop_array_hash(const struct nexthop *array)
+{
+	const struct nexthop *nh;
+	uint32_t key = 0;
+
+	for (ALL_NEXTHOPS_ARRAY(array, nh))
+		key = jhash_1word(nexthop_hash(nh), key);
+
+	return key;
+}
+
+bool nexthop_array_equal(const struct nexthop *array1,
+			 const struct nexthop *array2)
+{
+	uint32_t i;
+
+	if (darr_len(array1) != darr_len(array2))
+		return false;
+
+	darr_foreach_i (array1, i)
+		if (!nexthop_same(&array1[i], &array2[i]))
+			return false;
+
+	return true;
+}
+
 void nexthop_group_mark_duplicates(struct nexthop_group *nhg)
 {
 	struct nexthop *nexthop, *prev;
@@ -9,6 +9,7 @@
 #define __NEXTHOP_GROUP__
 
 #include <vty.h>
+#include "darr.h"
 #include "json.h"
 
 #ifdef __cplusplus
@@ -53,6 +54,21 @@ void copy_nexthops(struct nexthop **tnh, const struct nexthop *nh,
 
 uint32_t nexthop_group_hash_no_recurse(const struct nexthop_group *nhg);
 uint32_t nexthop_group_hash(const struct nexthop_group *nhg);
+
+/*
+ * The nexthops of a group, recursively resolved ones included, flattened
+ * into one contiguous darr in ALL_NEXTHOPS order.  The entries are
+ * shallow copies with their links cleared: they share labels and the
+ * like with the group, so the array must not outlive it.  For comparing
+ * and hashing wide groups over and over, where walking the array beats
+ * chasing the links.  nexthop_array_hash() gives the same value as
+ * nexthop_group_hash() of the group.
+ */
+struct nexthop *nexthop_group_to_array(const struct nexthop_group *nhg);
+void nexthop_array_free(struct nexthop **array);
+uint32_t nexthop_array_hash(const struct nexthop *array);
+bool nexthop_array_equal(const struct nexthop *array1,
+			 const struct nexthop *array2);
 void nexthop_group_mark_duplicates(struct nexthop_group *nhg);
 
 /* Add a nexthop to a list, enforcing the canonical sort order. */
@@ -77,6 +93,12 @@ void nexthop_group_add_sorted(struct nexthop_group *nhg,
 	(nhop);								\
 	(nhop) = nexthop_next(nhop)
 
+/* Same, over the array of nexthop_group_to_array() */
+#define ALL_NEXTHOPS_ARRAY(array, nhop)					\
+	(nhop) = (array);						\
+	(nhop) < (array) + darr_len(array);				\
+	(nhop)++
+
 
 #define NHGC_NAME_SIZE 80
 
@@ -294,6 +294,40 @@ static int nb_node_validate(const struct lysc_node *snode, void *arg)
 	return YANG_ITER_CONTINUE;
 }
 
+static void nb_config_edited_copy(struct nb_config *dst,
+				  const struct nb_config *src)
+{
+	memcpy(dst->edited, src->edited, sizeof(dst->edited));
+	dst->edited_count = src->edited_count;
+	dst->edited_all = src->edited_all;
+}
+
+void nb_config_edited(struct nb_config *config, const struct lysc_node *snode)
+{
+	const struct lys_module *module;
+	unsigned int i;
+
+	if (config->edited_all)
+		return;
+	if (!snode) {
+		config->edited_all = true;
+		return;
+	}
+
+	/* Data is validated by top-level node, augments along with it */
+	while (snode->parent)
+		snode = snode->parent;
+	module = snode->module;
+
+	for (i = 0; i < config->edited_count; i++)
+		if (config->edited[i] == module)
+			return;
+	if (config->edited_count == NB_CONFIG_EDITED_MAX)
+		config->edited_all = true;
+	else
+		config->edited[config->edited_count++] = module;
+}
+
 struct nb_config *nb_config_new(struct lyd_node *dnode)
 {
 	struct nb_config *config;
@@ -304,6 +338,7 @@ struct nb_config *nb_config_new(struct lyd_node *dnode)
 	else
 		config->dnode = yang_dnode_new(ly_native_ctx, true);
 	config->version = 0;
+	config->edited_all = true;
 
 	RB_INIT(nb_config_cbs, &config->cfg_chgs);
 
@@ -325,6 +360,7 @@ struct nb_config *nb_config_dup(const struct nb_config *config)
 	dup = XCALLOC(MTYPE_NB_CONFIG, sizeof(*dup));
 	dup->dnode = yang_dnode_dup(config->dnode);
 	dup->version = config->version;
+	nb_config_edited_copy(dup, config);
 
 	RB_INIT(nb_config_cbs, &dup->cfg_chgs);
 
@@ -339,6 +375,7 @@ int nb_config_merge(struct nb_config *config_dst, struct nb_config *config_src,
 	ret = lyd_merge_siblings(&config_dst->dnode, config_src->dnode, 0);
 	if (ret != 0)
 		flog_warn(EC_LIB_LIBYANG, "%s: lyd_merge() failed", __func__);
+	config_dst->edited_all = true;
 
 	if (!preserve_source)
 		nb_config_free(config_src);
@@ -353,7 +390,8 @@ void nb_config_replace(struct nb_config *config_dst,
 	if (config_src->version != 0)
 		config_dst->version = config_src->version;
 
-	/* Update dnode. */
+	/* Update dnode, and what of it is yet to be validated. */
+	nb_config_edited_copy(config_dst, config_src);
 	if (config_dst->dnode)
 		yang_dnode_free(config_dst->dnode);
 	if (preserve_source) {
@@ -669,6 +707,7 @@ int nb_candidate_edit(struct nb_config *candidate,
 	switch (operation) {
 	case NB_OP_CREATE:
 	case NB_OP_MODIFY:
+		nb_config_edited(candidate, nb_node->snode);
 		err = lyd_new_path(candidate->dnode, ly_native_ctx, xpath_edit,
 				   (void *)data->value, LYD_NEW_PATH_UPDATE,
 				   &dnode);
@@ -702,10 +741,13 @@ int nb_candidate_edit(struct nb_config *candidate,
 						   NULL, LYD_NEW_PATH_UPDATE,
 						   &dep_dnode);
 				/* Create default nodes */
-				if (!err && dep_dnode)
+				if (!err && dep_dnode) {
+					nb_config_edited(candidate,
+							 dep_dnode->schema);
 					err = lyd_new_implicit_tree(
 						dep_dnode,
 						LYD_IMPLICIT_NO_STATE, NULL);
+				}
 				if (err) {
 					flog_warn(
 						EC_LIB_LIBYANG,
@@ -724,13 +766,16 @@ int nb_candidate_edit(struct nb_config *candidate,
 			 * whether to ignore it or not.
 			 */
 			return NB_ERR_NOT_FOUND;
+		nb_config_edited(candidate, dnode->schema);
 		/* destroy dependant */
 		if (nb_node->dep_cbs.get_dependant_xpath) {
 			nb_node->dep_cbs.get_dependant_xpath(dnode, dep_xpath);
 
 			dep_dnode = yang_dnode_get(candidate->dnode, dep_xpath);
-			if (dep_dnode)
+			if (dep_dnode) {
+				nb_config_edited(candidate, dep_dnode->schema);
 				lyd_free_tree(dep_dnode);
+			}
 		}
 		lyd_free_tree(dnode);
 		break;
@@ -940,23 +985,95 @@ int nb_candidate_update(struct nb_config *candidate)
 	return NB_OK;
 }
 
+static bool nb_module_imports(const struct lys_module *module,
+			      const struct lys_module *imported)
+{
+	LY_ARRAY_COUNT_TYPE i;
+
+	LY_ARRAY_FOR (module->parsed->imports, i)
+		if (module->parsed->imports[i].module == imported)
+			return true;
+	return false;
+}
+
+/*
+ * The modules to validate the data of after the edits of candidate: the
+ * edited ones, and those importing them, whose leafrefs and must
+ * expressions may point into them. Returns how many, 0 for all of them.
+ */
+static unsigned int nb_candidate_validate_modules(
+	const struct nb_config *candidate, const struct lys_module **modules,
+	unsigned int max)
+{
+	const struct lys_module *module;
+	unsigned int n, i;
+	uint32_t idx = 0;
+
+	if (candidate->edited_all)
+		return 0;
+
+	n = candidate->edited_count;
+	memcpy(modules, candidate->edited, n * sizeof(modules[0]));
+
+	while ((module = ly_ctx_get_module_iter(ly_native_ctx, &idx))) {
+		if (!module->implemented)
+			continue;
+		if (!module->parsed)
+			return 0;
+
+		for (i = 0; i < candidate->edited_count; i++)
+			if (module == candidate->edited[i] ||
+			    nb_module_imports(module, candidate->edited[i]))
+				break;
+		if (i == candidate->edited_count ||
+		    module == candidate->edited[i])
+			continue;
+		if (n == max)
+			return 0;
+		modules[n++] = module;
+	}
+
+	return n;
+}
+
 /*
  * Perform YANG syntactic and semantic validation.
  *
+ * Only the data of the modules edited since the last validation is
+ * gone over again, with that of the modules depending on them. Pushing
+ * many small changes one commit at a time then costs as much as each
+ * change, not the whole configuration each time.
+ *
  * WARNING: lyd_validate() can change the configuration as part of the
  * validation process.
  */
 int nb_candidate_validate_yang(struct nb_config *candidate, bool no_state,
 			       char *errmsg, size_t errmsg_len)
 {
-	if (lyd_validate_all(&candidate->dnode, ly_native_ctx,
-			     no_state ? LYD_VALIDATE_NO_STATE
-				      : LYD_VALIDATE_PRESENT,
-			     NULL) != 0) {
+	const struct lys_module *modules[NB_CONFIG_EDITED_MAX * 4];
+	uint32_t options = no_state ? LYD_VALIDATE_NO_STATE
+				    : LYD_VALIDATE_PRESENT;
+	unsigned int n, i;
+	LY_ERR err = LY_SUCCESS;
+
+	n = nb_candidate_validate_modules(candidate, modules,
+					  array_size(modules));
+	if (!n && !candidate->edited_all && !candidate->edited_count)
+		return NB_OK;
+
+	if (!n)
+		err = lyd_validate_all(&candidate->dnode, ly_native_ctx,
+				       options, NULL);
+	for (i = 0; i < n && !err; i++)
+		err = lyd_validate_module(&candidate->dnode, modules[i],
+					  options, NULL);
+	if (err) {
 		yang_print_errors(ly_native_ctx, errmsg, errmsg_len);
 		return NB_ERR_VALIDATION;
 	}
 
+	candidate->edited_count = 0;
+	candidate->edited_all = false;
 	return NB_OK;
 }
 
@@ -1008,7 +1125,7 @@ int nb_candidate_diff_and_validate_yang(struct nb_context *context,
 					char *errmsg, size_t errmsg_len)
 {
 	if (nb_candidate_validate_yang(candidate, true, errmsg,
-				       sizeof(errmsg_len)) != NB_OK)
+				       errmsg_len) != NB_OK)
 		return NB_ERR_VALIDATION;
 
 	RB_INIT(nb_config_cbs, changes);
@@ -699,11 +699,24 @@ struct nb_transaction {
 	struct nb_config_cbs changes;
 };
 
+/* Edited modules tracked before YANG validation falls back to all */
+#define NB_CONFIG_EDITED_MAX 8
+
 /* Northbound configuration. */
 struct nb_config {
 	struct lyd_node *dnode;
 	uint32_t version;
 	struct nb_config_cbs cfg_chgs;
+
+	/*
+	 * Modules whose data was edited since dnode last passed YANG
+	 * validation, so only they and the modules importing them are
+	 * validated again. edited_all if that is not known, e.g. for a
+	 * tree that came from elsewhere.
+	 */
+	const struct lys_module *edited[NB_CONFIG_EDITED_MAX];
+	uint8_t edited_count;
+	bool edited_all;
 };
 
 /* Callback function used by nb_oper_data_iterate(). */
@@ -825,6 +838,19 @@ extern struct nb_config *nb_config_dup(const struct nb_config *config);
 extern int nb_config_merge(struct nb_config *config_dst,
 			   struct nb_config *config_src, bool preserve_source);
 
+/*
+ * Record that the data under snode was edited in config other than
+ * through nb_candidate_edit(), for YANG validation to cover it.
+ *
+ * config
+ *    Configuration that was edited.
+ *
+ * snode
+ *    Schema node of the edited data, NULL if unknown.
+ */
+extern void nb_config_edited(struct nb_config *config,
+			     const struct lysc_node *snode);
+
 /*
  * Replace one configuration by another.
  *
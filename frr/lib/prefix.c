@@ -489,6 +489,26 @@ int prefix_cmp(union prefixconstptr up1, union prefixconstptr up2)
 
 	if (p1->prefixlen != p2->prefixlen)
 		return numcmp(p1->prefixlen, p2->prefixlen);
+
+	/*
+	 * Addresses go a host order word at a time, masked to the prefix,
+	 * which orders them the same as the bytes compared below do.
+	 */
+	if ((p1->family == AF_INET && p1->prefixlen <= IPV4_MAX_BITLEN) ||
+	    (p1->family == AF_INET6 && p1->prefixlen <= IPV6_MAX_BITLEN)) {
+		for (i = 0, offset = p1->prefixlen; offset > 0;
+		     i++, offset -= 32) {
+			uint32_t mask = offset >= 32 ? UINT32_MAX
+						     : UINT32_MAX << (32 - offset);
+			uint32_t w1 = ntohl(p1->u.val32[i]) & mask;
+			uint32_t w2 = ntohl(p2->u.val32[i]) & mask;
+
+			if (w1 != w2)
+				return numcmp(w1, w2);
+		}
+		return 0;
+	}
+
 	offset = p1->prefixlen / PNBBY;
 	shift = p1->prefixlen % PNBBY;
 
@@ -1344,8 +1364,17 @@ unsigned prefix_hash_key(const void *pp)
 	/* make sure *all* unused bits are zero, particularly including
 	 * alignment /
 	 * padding and unused prefix bytes. */
-	memset(&copy, 0, sizeof(copy));
-	prefix_copy(&copy, (struct prefix *)pp);
+	if ((((const struct prefix *)pp)->family == AF_INET ||
+	     ((const struct prefix *)pp)->family == AF_INET6) &&
+	    ((const struct prefix *)pp)->prefixlen <= IPV6_MAX_BITLEN) {
+		/* Only the header and the address get hashed */
+		memset(&copy, 0, offsetof(struct prefix, u.prefix) +
+					 sizeof(copy.u.prefix6));
+		prefix_copy(&copy, (struct prefix *)pp);
+	} else {
+		memset(&copy, 0, sizeof(copy));
+		prefix_copy(&copy, (struct prefix *)pp);
+	}
 	return jhash(&copy,
 		     offsetof(struct prefix, u.prefix) + PSIZE(copy.prefixlen),
 		     0x55aa5a5a);
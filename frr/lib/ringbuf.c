@@ -97,6 +97,53 @@ size_t ringbuf_peek(struct ringbuf *buf, size_t offset, void *data, size_t size)
 	return copysize;
 }
 
+const uint8_t *ringbuf_view(struct ringbuf *buf, size_t offset, size_t size)
+{
+	size_t remain = ringbuf_remain(buf);
+	size_t cstart;
+
+	if (offset > remain || size > remain - offset)
+		return NULL;
+	cstart = (buf->start + offset) % buf->size;
+	if (size > buf->size - cstart)
+		return NULL;
+	return buf->data + cstart;
+}
+
+size_t ringbuf_skip(struct ringbuf *buf, size_t size)
+{
+	size_t skipsize = MIN(ringbuf_remain(buf), size);
+
+	buf->start = (buf->start + skipsize) % buf->size;
+	buf->empty = (buf->start == buf->end) && (buf->empty || skipsize);
+	return skipsize;
+}
+
+ssize_t ringbuf_read(struct ringbuf *buf, int fd, size_t size)
+{
+	size_t space = MIN(ringbuf_space(buf), size);
+	size_t tail = buf->size - buf->end;
+	struct iovec iov[2];
+	int iovcnt = 1;
+	ssize_t nbytes;
+
+	assert(space > 0);
+	iov[0].iov_base = buf->data + buf->end;
+	iov[0].iov_len = MIN(space, tail);
+	if (space > tail) {
+		iov[1].iov_base = buf->data;
+		iov[1].iov_len = space - tail;
+		iovcnt = 2;
+	}
+
+	nbytes = readv(fd, iov, iovcnt);
+	if (nbytes > 0) {
+		buf->end = (buf->end + nbytes) % buf->size;
+		buf->empty = false;
+	}
+	return nbytes;
+}
+
 size_t ringbuf_copy(struct ringbuf *to, struct ringbuf *from, size_t size)
 {
 	size_t tocopy = MIN(ringbuf_space(to), size);
@@ -89,6 +89,36 @@ size_t ringbuf_get(struct ringbuf *buf, void *data, size_t size);
 size_t ringbuf_peek(struct ringbuf *buf, size_t offset, void *data,
 		    size_t size);
 
+/*
+ * Get a pointer to data in the ring buffer, without copying it out.
+ *
+ * @param offset	where the data starts, in bytes offset from the
+ *			start of the data
+ * @param size		how much data is wanted
+ * @return		pointer to the data; NULL if there is not that much
+ *			data, or if it wraps around the end of the buffer
+ */
+const uint8_t *ringbuf_view(struct ringbuf *buf, size_t offset, size_t size);
+
+/*
+ * Drop data from the start of the ring buffer, as ringbuf_get() would.
+ *
+ * @param size	how much data to drop
+ * @return number of bytes dropped; will be less than size if there was not
+ * enough data
+ */
+size_t ringbuf_skip(struct ringbuf *buf, size_t size);
+
+/*
+ * Read from a file descriptor straight into the free space of the ring
+ * buffer, with a single readv() in two pieces when the space wraps.
+ *
+ * @param fd	file descriptor to read from
+ * @param size	most to read; capped to the free space, which must not be 0
+ * @return what readv() returned, errno being left as it set it
+ */
+ssize_t ringbuf_read(struct ringbuf *buf, int fd, size_t size);
+
 /*
  * Copy data from one ringbuf to another.
  *
@@ -273,6 +273,7 @@ DECLARE_QOBJ_TYPE(route_map);
 #define IS_MATCH_RPKI(C) (strmatch(C, "frr-bgp-route-map:rpki"))
 #define IS_MATCH_RPKI_EXTCOMMUNITY(C)                                          \
 	(strmatch(C, "frr-bgp-route-map:rpki-extcommunity"))
+#define IS_MATCH_LATENCY(C) (strmatch(C, "frr-bgp-route-map:latency"))
 #define IS_MATCH_PROBABILITY(C)                                                \
 	(strmatch(C, "frr-bgp-route-map:probability"))
 #define IS_MATCH_SRC_VRF(C)                                                    \
@@ -330,9 +331,13 @@ DECLARE_QOBJ_TYPE(route_map);
 /* BGP route-map_set actions */
 #define IS_SET_WEIGHT(A)                                                       \
 	(strmatch(A, "frr-bgp-route-map:weight"))
+#define IS_SET_WEIGHT_FROM_LATENCY(A)                                          \
+	(strmatch(A, "frr-bgp-route-map:weight-from-latency"))
 #define IS_SET_TABLE(A) (strmatch(A, "frr-bgp-route-map:table"))
 #define IS_SET_LOCAL_PREF(A)                                                   \
 	(strmatch(A, "frr-bgp-route-map:set-local-preference"))
+#define IS_SET_LOCAL_PREF_FROM_LATENCY(A)                                      \
+	(strmatch(A, "frr-bgp-route-map:local-preference-from-latency"))
 #define IS_SET_LABEL_INDEX(A)                                                  \
 	(strmatch(A, "frr-bgp-route-map:label-index"))
 #define IS_SET_DISTANCE(A)                                                     \
@@ -710,6 +710,11 @@ void route_map_condition_show(struct vty *vty, const struct lyd_node *dnode,
 			yang_dnode_get_string(
 				dnode,
 				"./rmap-match-condition/frr-bgp-route-map:rpki-extcommunity"));
+	} else if (IS_MATCH_LATENCY(condition)) {
+		vty_out(vty, " match latency %s microseconds\n",
+			yang_dnode_get_string(
+				dnode,
+				"./rmap-match-condition/frr-bgp-route-map:latency"));
 	} else if (IS_MATCH_PROBABILITY(condition)) {
 		vty_out(vty, " match probability %s\n",
 			yang_dnode_get_string(
@@ -1203,6 +1208,8 @@ void route_map_action_show(struct vty *vty, const struct lyd_node *dnode,
 			yang_dnode_get_string(
 				dnode,
 				"./rmap-set-action/frr-bgp-route-map:weight"));
+	} else if (IS_SET_WEIGHT_FROM_LATENCY(action)) {
+		vty_out(vty, " set weight from-latency\n");
 	} else if (IS_SET_TABLE(action)) {
 		vty_out(vty, " set table %s\n",
 			yang_dnode_get_string(
@@ -1213,6 +1220,8 @@ void route_map_action_show(struct vty *vty, const struct lyd_node *dnode,
 			yang_dnode_get_string(
 				dnode,
 				"./rmap-set-action/frr-bgp-route-map:local-pref"));
+	} else if (IS_SET_LOCAL_PREF_FROM_LATENCY(action)) {
+		vty_out(vty, " set local-preference from-latency\n");
 	} else if (IS_SET_LABEL_INDEX(action)) {
 		vty_out(vty, " set label-index %s\n",
 			yang_dnode_get_string(
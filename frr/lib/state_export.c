@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * State export: paged binary table dumps on a daemon's own socket.
+ */
+#include <zebra.h>
+
+#include "debug.h"
+#include "libfrr.h"
+#include "state_export.h"
+
+/* Requests handled, and pages queued, per connection and event */
+#define STATE_EXPORT_MAX_NUM_MSG_PROC 8
+#define STATE_EXPORT_MAX_NUM_MSG_WRITE 8
+
+static struct debug state_export_dbg = {0, "State export"};
+
+static struct msg_server state_export_server = {.fd = -1};
+static state_export_handler state_export_cb;
+static struct event_loop *state_export_loop;
+
+static int state_export_notify_disconnect(struct msg_conn *conn)
+{
+	msg_server_conn_delete(conn);
+	return 0;
+}
+
+static void state_export_process_msg(uint8_t version, uint8_t *data,
+				     size_t len, struct msg_conn *conn)
+{
+	Mgmtd__StateExportReq *req;
+
+	if (version != MGMT_MSG_VERSION_PROTOBUF) {
+		zlog_warn("%s: unexpected message version %u", __func__,
+			  version);
+		return;
+	}
+
+	req = mgmtd__state_export_req__unpack(NULL, len, data);
+	if (!req) {
+		zlog_warn("%s: failed to decode %zu bytes", __func__, len);
+		return;
+	}
+
+	state_export_cb(conn, req);
+	mgmtd__state_export_req__free_unpacked(req, NULL);
+}
+
+static struct msg_conn *state_export_create(int fd, union sockunion *su)
+{
+	return msg_server_conn_create(state_export_loop, fd,
+				      state_export_notify_disconnect,
+				      state_export_process_msg,
+				      STATE_EXPORT_MAX_NUM_MSG_PROC,
+				      STATE_EXPORT_MAX_NUM_MSG_WRITE,
+				      STATE_EXPORT_MSG_MAX_LEN, NULL,
+				      "state-export");
+}
+
+int state_export_reply(struct msg_conn *conn, Mgmtd__StateExportReply *reply)
+{
+	size_t len = mgmtd__state_export_reply__get_packed_size(reply);
+	Mgmtd__StateExportReply error;
+
+	/* Leave the collector something to go on rather than nothing */
+	if (len + sizeof(struct mgmt_msg_hdr) > STATE_EXPORT_MSG_MAX_LEN) {
+		mgmtd__state_export_reply__init(&error);
+		error.req_id = reply->req_id;
+		error.success = false;
+		error.error = (char *)"Page too large, ask for fewer entries";
+		reply = &error;
+		len = mgmtd__state_export_reply__get_packed_size(reply);
+	}
+
+	return msg_conn_send_msg(
+		conn, MGMT_MSG_VERSION_PROTOBUF, reply, len,
+		(size_t(*)(void *, void *))mgmtd__state_export_reply__pack,
+		false);
+}
+
+int state_export_error(struct msg_conn *conn, const Mgmtd__StateExportReq *req,
+		       const char *error)
+{
+	Mgmtd__StateExportReply reply;
+
+	mgmtd__state_export_reply__init(&reply);
+	reply.req_id = req->req_id;
+	reply.success = false;
+	reply.error = (char *)error;
+
+	return state_export_reply(conn, &reply);
+}
+
+unsigned int state_export_page_size(const Mgmtd__StateExportReq *req)
+{
+	if (!req->has_max_entries || !req->max_entries)
+		return STATE_EXPORT_PAGE_DEFAULT;
+	return MIN(req->max_entries, STATE_EXPORT_PAGE_MAX);
+}
+
+bool state_export_cursor(const Mgmtd__StateExportReq *req, int family,
+			 struct prefix *p)
+{
+	const uint8_t *buf = req->cursor.data;
+	unsigned int max = family == AF_INET ? IPV4_MAX_BITLEN
+					     : IPV6_MAX_BITLEN;
+
+	if (!req->has_cursor || !req->cursor.len)
+		return false;
+	if (buf[0] > max || req->cursor.len != 1 + PSIZE(buf[0]))
+		return false;
+
+	memset(p, 0, sizeof(*p));
+	p->family = family;
+	p->prefixlen = buf[0];
+	memcpy(&p->u.prefix, buf + 1, PSIZE(buf[0]));
+	return true;
+}
+
+void state_export_prefix(ProtobufCBinaryData *data, uint8_t *buf,
+			 const struct prefix *p)
+{
+	buf[0] = p->prefixlen;
+	memcpy(buf + 1, &p->u.prefix, PSIZE(p->prefixlen));
+	data->data = buf;
+	data->len = 1 + PSIZE(p->prefixlen);
+}
+
+void state_export_addr(ProtobufCBinaryData *data, uint8_t *buf, int family,
+		       const void *addr)
+{
+	data->len = family == AF_INET ? IPV4_MAX_BYTELEN : IPV6_MAX_BYTELEN;
+	memcpy(buf, addr, data->len);
+	data->data = buf;
+}
+
+void state_export_init(struct event_loop *loop, state_export_handler handler)
+{
+	char path[sizeof(((struct sockaddr_un *)NULL)->sun_path)];
+
+	state_export_loop = loop;
+	state_export_cb = handler;
+
+	snprintf(path, sizeof(path), "%s/%s_state.sock", frr_vtydir,
+		 frr_protonameinst);
+	if (msg_server_init(&state_export_server, path, loop,
+			    state_export_create, "state-export",
+			    &state_export_dbg))
+		zlog_err("cannot initialize state export server on %s", path);
+}
+
+void state_export_fini(void)
+{
+	msg_server_cleanup(&state_export_server);
+}
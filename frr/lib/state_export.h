@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * State export: paged binary table dumps on a daemon's own socket.
+ */
+#ifndef _FRR_STATE_EXPORT_H
+#define _FRR_STATE_EXPORT_H
+
+#include "mgmt_pb.h"
+#include "mgmt_msg.h"
+#include "prefix.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Collectors send a StateExportReq (lib/mgmt.proto) on
+ * <vtydir>/<daemon>_state.sock and get one StateExportReply back, holding
+ * up to max_entries entries and the cursor to continue from. The daemon
+ * builds each page from its live tables when asked and frees it once
+ * sent, so a full table costs it one page of memory however large the
+ * table is, and it does not wait on slow readers between pages.
+ */
+
+/* Entries per page unless asked for fewer */
+#define STATE_EXPORT_PAGE_DEFAULT 256
+#define STATE_EXPORT_PAGE_MAX 1024
+#define STATE_EXPORT_MSG_MAX_LEN (1024 * 1024)
+
+/* Room for a prefix encoded the way the messages carry them */
+#define STATE_EXPORT_PREFIX_LEN (1 + IPV6_MAX_BYTELEN)
+
+/*
+ * Answer req on conn, with state_export_reply() or state_export_error(),
+ * before returning
+ */
+typedef void (*state_export_handler)(struct msg_conn *conn,
+				     const Mgmtd__StateExportReq *req);
+
+extern void state_export_init(struct event_loop *loop,
+			      state_export_handler handler);
+extern void state_export_fini(void);
+
+extern int state_export_reply(struct msg_conn *conn,
+			      Mgmtd__StateExportReply *reply);
+extern int state_export_error(struct msg_conn *conn,
+			      const Mgmtd__StateExportReq *req,
+			      const char *error);
+
+/* How many entries the page for req may hold */
+extern unsigned int state_export_page_size(const Mgmtd__StateExportReq *req);
+
+/*
+ * Where req asks to continue from, in p, if anywhere. False for the first
+ * page, and for a cursor that is not a prefix of family.
+ */
+extern bool state_export_cursor(const Mgmtd__StateExportReq *req, int family,
+				struct prefix *p);
+
+/* Encode p into buf, which data then refers to */
+extern void state_export_prefix(ProtobufCBinaryData *data, uint8_t *buf,
+				const struct prefix *p);
+/* Same for an address of family, into 16 octets at buf */
+extern void state_export_addr(ProtobufCBinaryData *data, uint8_t *buf,
+			      int family, const void *addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FRR_STATE_EXPORT_H */
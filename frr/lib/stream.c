@@ -97,18 +97,64 @@ struct stream *stream_new(size_t size)
 	s->getp = s->endp = 0;
 	s->next = NULL;
 	s->size = size;
+	s->data = s->buf;
+	s->owner = NULL;
+	atomic_store_explicit(&s->refcnt, 1, memory_order_relaxed);
 	return s;
 }
 
-/* Free it now. */
+/* Free it now, or the data once no other stream uses it. */
 void stream_free(struct stream *s)
 {
+	struct stream *owner;
+
 	if (!s)
 		return;
 
+	owner = s->owner;
+	if (owner) {
+		XFREE(MTYPE_STREAM, s);
+		s = owner;
+	}
+
+	if (atomic_fetch_sub_explicit(&s->refcnt, 1, memory_order_acq_rel) > 1)
+		return;
+
 	XFREE(MTYPE_STREAM, s);
 }
 
+struct stream *stream_slice(struct stream *s, size_t from, size_t len)
+{
+	struct stream *owner = s->owner ? s->owner : s;
+	struct stream *view;
+
+	STREAM_VERIFY_SANE(s);
+	assert(from + len <= s->endp);
+
+	view = XMALLOC(MTYPE_STREAM, sizeof(struct stream));
+	view->next = NULL;
+	view->getp = 0;
+	view->endp = view->size = len;
+	view->data = s->data + from;
+	view->owner = owner;
+	atomic_fetch_add_explicit(&owner->refcnt, 1, memory_order_relaxed);
+	return view;
+}
+
+struct stream *stream_share(struct stream *s)
+{
+	struct stream *view = stream_slice(s, 0, s->endp);
+
+	view->getp = s->getp;
+	return view;
+}
+
+bool stream_is_shared(const struct stream *s)
+{
+	return s->owner ||
+	       atomic_load_explicit(&s->refcnt, memory_order_acquire) > 1;
+}
+
 struct stream *stream_copy(struct stream *dest, const struct stream *src)
 {
 	STREAM_VERIFY_SANE(src);
@@ -159,9 +205,11 @@ size_t stream_resize_inplace(struct stream **sptr, size_t newsize)
 	struct stream *orig = *sptr;
 
 	STREAM_VERIFY_SANE(orig);
+	assert(!stream_is_shared(orig));
 
 	orig = XREALLOC(MTYPE_STREAM, orig, sizeof(struct stream) + newsize);
 
+	orig->data = orig->buf;
 	orig->size = newsize;
 
 	if (orig->endp > orig->size)
@@ -1361,6 +1409,8 @@ void stream_pulldown(struct stream *s)
 {
 	size_t rlen = STREAM_READABLE(s);
 
+	assert(!stream_is_shared(s));
+
 	/* No more data, so just move the pointers. */
 	if (rlen == 0) {
 		stream_reset(s);
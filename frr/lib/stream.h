@@ -81,6 +81,15 @@ extern "C" {
  *
  * Best practice is to use stream_put (<stream *>, NULL, <size>) to zero out
  * any part of a stream which isn't otherwise written to.
+ *
+ * Sharing:
+ * stream_slice() and stream_share() return streams which are views into
+ * the data of another one rather than copies of it, each with its own
+ * getp and endp, so the same packet can be queued in several places.
+ * The data is reference counted and freed along with the last of the
+ * streams using it; stream_free() works the same on all of them, from
+ * any pthread. Once shared, the data must no longer be written to,
+ * through any of the streams.
  */
 
 /* Stream buffer. */
@@ -95,7 +104,13 @@ struct stream {
 	size_t getp;	       /* next get position */
 	size_t endp;	       /* last valid data position */
 	size_t size;	       /* size of data segment */
-	unsigned char data[];  /* data pointer */
+	unsigned char *data;   /* data pointer */
+
+	/* Stream whose data this one is a view into, NULL if its own */
+	struct stream *owner;
+	/* References to the data of an owner, its own included */
+	atomic_uint_fast32_t refcnt;
+	unsigned char buf[];
 };
 
 /* First in first out queue structure. */
@@ -140,6 +155,17 @@ extern struct stream *stream_copy(struct stream *dest,
 				  const struct stream *src);
 extern struct stream *stream_dup(const struct stream *s);
 
+/*
+ * Read-only view of len bytes of s from offset from, without copying
+ * them; see "Sharing" above. Free with stream_free().
+ */
+extern struct stream *stream_slice(struct stream *s, size_t from,
+				   size_t len);
+/* View of all of s, up to its endp and from its getp */
+extern struct stream *stream_share(struct stream *s);
+/* The data of s is used by other streams as well */
+extern bool stream_is_shared(const struct stream *s);
+
 extern size_t stream_resize_inplace(struct stream **sptr, size_t newsize);
 
 extern size_t stream_get_getp(const struct stream *s);
@@ -40,6 +40,7 @@
 #include "northbound_cli.h"
 #include "printfrr.h"
 #include "json.h"
+#include "frr_pthread.h"
 
 #include <arpa/telnet.h>
 #include <termios.h>
@@ -50,6 +51,7 @@ DEFINE_MTYPE_STATIC(LIB, VTY, "VTY");
 DEFINE_MTYPE_STATIC(LIB, VTY_SERV, "VTY server");
 DEFINE_MTYPE_STATIC(LIB, VTY_OUT_BUF, "VTY output buffer");
 DEFINE_MTYPE_STATIC(LIB, VTY_HIST, "VTY history");
+DEFINE_MTYPE_STATIC(LIB, VTY_DEFER, "VTY deferred command");
 
 DECLARE_DLIST(vtys, struct vty, itm);
 
@@ -90,6 +92,9 @@ static void vty_event_serv(enum vty_event event, struct vty_serv *);
 static void vty_event(enum vty_event, struct vty *);
 static int vtysh_flush(struct vty *vty);
 
+/* Master of the threads. */
+static struct event_loop *vty_master;
+
 /* Extern host structure from command.c */
 extern struct host host;
 
@@ -198,6 +203,107 @@ void vty_mgmt_resume_response(struct vty *vty, bool success)
 		zlog_err("mgmtd: unexpected resume while reading config file");
 }
 
+struct vty_defer_job {
+	/* Session waiting for the output, NULL once it closed */
+	struct vty *vty;
+	/* Private vty the output is collected in */
+	struct vty *out;
+
+	vty_defer_fn fn;
+	void *arg;
+	void (*arg_free)(void *arg);
+};
+
+/* Started by the first deferred command */
+static struct frr_pthread *vty_defer_pthread;
+
+static void vty_defer_job_free(struct vty_defer_job *job)
+{
+	if (job->arg_free)
+		job->arg_free(job->arg);
+	buffer_free(job->out->obuf);
+	buffer_free(job->out->lbuf);
+	XFREE(MTYPE_VTY, job->out->buf);
+	XFREE(MTYPE_VTY, job->out);
+	XFREE(MTYPE_VTY_DEFER, job);
+}
+
+/* Back on the main thread: hand the output over and resume the session */
+static void vty_defer_done(struct event *event)
+{
+	struct vty_defer_job *job = EVENT_ARG(event);
+	struct vty *vty = job->vty;
+	uint8_t header[4] = {0, 0, 0, CMD_SUCCESS};
+	char *out;
+
+	if (!vty) {
+		vty_defer_job_free(job);
+		return;
+	}
+
+	vty->defer_pending = NULL;
+	out = buffer_getstr(job->out->obuf);
+	buffer_put(vty->obuf, out, strlen(out));
+	XFREE(MTYPE_TMP, out);
+	vty_defer_job_free(job);
+
+	buffer_put(vty->obuf, header, 4);
+	if (!vty->t_write && vtysh_flush(vty) < 0)
+		return;
+
+	if (vty->status == VTY_CLOSE)
+		vty_close(vty);
+	else
+		vty_event(VTYSH_READ, vty);
+}
+
+/* On the worker, which like any event loop holds the RCU read lock */
+static void vty_defer_run(struct event *event)
+{
+	struct vty_defer_job *job = EVENT_ARG(event);
+
+	job->fn(job->out, job->arg);
+	event_add_event(vty_master, vty_defer_done, job, 0, NULL);
+}
+
+int vty_defer(struct vty *vty, vty_defer_fn fn, void *arg,
+	      void (*arg_free)(void *arg))
+{
+	struct frr_pthread_attr attr = {
+		.start = frr_pthread_attr_default.start,
+		.stop = frr_pthread_attr_default.stop,
+	};
+	struct vty_defer_job *job;
+
+	if (vty->type != VTY_SHELL_SERV || vty->filter) {
+		fn(vty, arg);
+		if (arg_free)
+			arg_free(arg);
+		return CMD_SUCCESS;
+	}
+
+	if (!vty_defer_pthread) {
+		vty_defer_pthread = frr_pthread_new(&attr, "VTY worker",
+						    "vtyworker");
+		frr_pthread_run(vty_defer_pthread, NULL);
+		frr_pthread_wait_running(vty_defer_pthread);
+	}
+
+	job = XCALLOC(MTYPE_VTY_DEFER, sizeof(*job));
+	job->vty = vty;
+	job->out = vty_new();
+	job->out->type = VTY_SHELL_SERV;
+	job->fn = fn;
+	job->arg = arg;
+	job->arg_free = arg_free;
+
+	/* vtysh_read() holds back the result until vty_defer_done() */
+	vty->defer_pending = job;
+	event_add_event(vty_defer_pthread->master, vty_defer_run, job, 0,
+			NULL);
+	return CMD_SUCCESS;
+}
+
 void vty_frame(struct vty *vty, const char *format, ...)
 {
 	va_list args;
@@ -390,6 +496,96 @@ void vty_json_empty(struct vty *vty)
 	vty_json(vty, json);
 }
 
+/* Members streamed between attempts to write the output out */
+#define VTY_JSON_STREAM_DRAIN 256
+/* How long to wait for the client to make room, each time */
+#define VTY_DRAIN_WAIT_MSEC 1000
+
+void vty_out_drain(struct vty *vty)
+{
+	struct pollfd pfd = { .fd = vty->wfd, .events = POLLOUT };
+
+	/* Terminals page their output; files have nowhere to go early */
+	if (vty->type != VTY_SHELL_SERV || vty->wfd < 0)
+		return;
+
+	while (buffer_flush_available(vty->obuf, vty->wfd) == BUFFER_PENDING)
+		if (poll(&pfd, 1, VTY_DRAIN_WAIT_MSEC) <= 0)
+			break;
+}
+
+/* Separator and key for the next member at the current depth */
+static void vty_json_stream_member(struct vty_json_stream *js,
+				   const char *key)
+{
+	unsigned int d = js->depth - 1;
+	json_object *jkey;
+
+	if (js->members[d])
+		vty_out(js->vty, ",");
+	js->members[d] = true;
+
+	if (js->array[d])
+		return;
+
+	jkey = json_object_new_string(key);
+	vty_out(js->vty, "%s:",
+		json_object_to_json_string_ext(jkey,
+					       JSON_C_TO_STRING_NOSLASHESCAPE));
+	json_object_free(jkey);
+}
+
+void vty_json_stream_open(struct vty_json_stream *js, struct vty *vty)
+{
+	memset(js, 0, sizeof(*js));
+	js->vty = vty;
+	js->depth = 1;
+	vty_out(vty, "{");
+}
+
+void vty_json_stream_push(struct vty_json_stream *js, const char *key,
+			  bool array)
+{
+	assert(js->depth > 0 && js->depth < VTY_JSON_STREAM_MAXDEPTH);
+
+	vty_json_stream_member(js, key);
+	vty_out(js->vty, array ? "[" : "{");
+
+	js->array[js->depth] = array;
+	js->members[js->depth] = false;
+	js->depth++;
+}
+
+void vty_json_stream_add(struct vty_json_stream *js, const char *key,
+			 struct json_object *json)
+{
+	assert(js->depth > 0);
+
+	vty_json_stream_member(js, key);
+	vty_out(js->vty, "%s",
+		json_object_to_json_string_ext(json,
+					       JSON_C_TO_STRING_NOSLASHESCAPE));
+	json_object_free(json);
+
+	if (++js->added % VTY_JSON_STREAM_DRAIN == 0)
+		vty_out_drain(js->vty);
+}
+
+void vty_json_stream_pop(struct vty_json_stream *js)
+{
+	assert(js->depth > 0);
+
+	js->depth--;
+	vty_out(js->vty, js->array[js->depth] ? "]" : "}");
+}
+
+void vty_json_stream_close(struct vty_json_stream *js)
+{
+	while (js->depth)
+		vty_json_stream_pop(js);
+	vty_out(js->vty, "\n");
+}
+
 /* Output current time to the vty. */
 void vty_time_print(struct vty *vty, int cr)
 {
@@ -2321,7 +2517,8 @@ static void vtysh_read(struct event *thread)
 	 * `CMD_SUSPEND` and finally if a front-end for mgmtd (generally this
 	 * would be mgmtd itself). So these code paths are counting on vtysh not
 	 * sending us more than 1 command line before waiting on the reply to
-	 * that command.
+	 * that command. A pipelined config push (vtysh --pipeline) only sends
+	 * config lines, which take none of them, and holds mgmtd to one.
 	 */
 	assert(vty->type == VTY_SHELL_SERV);
 
@@ -2413,6 +2610,12 @@ static void vtysh_read(struct event *thread)
 					return;
 				}
 
+				/* likewise for output coming from the vty
+				 * worker
+				 */
+				if (vty->defer_pending)
+					return;
+
 				/* warning: watchfrr hardcodes this result write
 				 */
 				header[3] = ret;
@@ -2485,6 +2688,12 @@ void vty_close(struct vty *vty)
 
 	vty->status = VTY_CLOSE;
 
+	/* A deferred command still running drops its output */
+	if (vty->defer_pending) {
+		vty->defer_pending->vty = NULL;
+		vty->defer_pending = NULL;
+	}
+
 	/*
 	 * If we reach here with pending config to commit we will be losing it
 	 * so warn the user.
@@ -2997,9 +3206,6 @@ int vty_config_node_exit(struct vty *vty)
 	return 1;
 }
 
-/* Master of the threads. */
-static struct event_loop *vty_master;
-
 static void vty_event_serv(enum vty_event event, struct vty_serv *vty_serv)
 {
 	switch (event) {
@@ -3927,6 +4133,12 @@ void vty_terminate(void)
 
 	memset(vty_cwd, 0x00, sizeof(vty_cwd));
 
+	if (vty_defer_pthread) {
+		frr_pthread_stop(vty_defer_pthread, NULL);
+		frr_pthread_destroy(vty_defer_pthread);
+		vty_defer_pthread = NULL;
+	}
+
 	vty_reset();
 
 	/* default state of vty_sessions is initialized & empty. */
@@ -235,6 +235,9 @@ struct vty {
 	 * workaround
 	 */
 	bool vtysh_file_locked;
+
+	/* Deferred command whose output the session is waiting for */
+	struct vty_defer_job *defer_pending;
 };
 
 static inline void vty_push_context(struct vty *vty, int node, uint64_t id)
@@ -378,6 +381,43 @@ extern bool vty_set_include(struct vty *vty, const char *regexp);
 extern int vty_json(struct vty *vty, struct json_object *json);
 extern int vty_json_no_pretty(struct vty *vty, struct json_object *json);
 extern void vty_json_empty(struct vty *vty);
+
+/*
+ * Streamed JSON output, for shows too large to build as one json_object:
+ * the object and array structure around the members is printed as it is
+ * opened and closed, and each member is built, printed and freed on its
+ * own. The output is the same as vty_json_no_pretty() would give for the
+ * whole tree.
+ *
+ * vty_json_stream_open() starts the top level object. Keys are required
+ * in objects and ignored in arrays. vty_json_stream_add() takes ownership
+ * of json. vty_json_stream_close() closes whatever is still open.
+ */
+#define VTY_JSON_STREAM_MAXDEPTH 8
+
+struct vty_json_stream {
+	struct vty *vty;
+	unsigned int depth;
+	unsigned int added;
+	bool array[VTY_JSON_STREAM_MAXDEPTH];
+	bool members[VTY_JSON_STREAM_MAXDEPTH];
+};
+
+extern void vty_json_stream_open(struct vty_json_stream *js, struct vty *vty);
+extern void vty_json_stream_push(struct vty_json_stream *js, const char *key,
+				 bool array);
+extern void vty_json_stream_add(struct vty_json_stream *js, const char *key,
+				struct json_object *json);
+extern void vty_json_stream_pop(struct vty_json_stream *js);
+extern void vty_json_stream_close(struct vty_json_stream *js);
+
+/*
+ * Write out what vty_out() has buffered so far to a vtysh client, waiting
+ * for it to take it if need be, so that a long output produced in pieces
+ * is not all held in memory until the command returns.
+ */
+extern void vty_out_drain(struct vty *vty);
+
 /* post fd to be passed to the vtysh client
  * fd is owned by the VTY code after this and will be closed when done
  */
@@ -422,6 +462,21 @@ extern int vty_mgmt_send_lockds_req(struct vty *vty, Mgmtd__DatastoreId ds_id,
 				    bool lock, bool scok);
 extern void vty_mgmt_resume_response(struct vty *vty, bool success);
 
+/*
+ * Show commands off the main thread.  fn(out, arg) is run on the vty
+ * worker pthread, inside its RCU read-side section, and what it prints
+ * to out becomes the command's output; the vtysh session waits for it
+ * while the main thread goes on.  fn must therefore only read what arg
+ * owns or what is RCU-protected, typically a snapshot the command took.
+ * arg_free (may be NULL) releases arg afterwards.
+ *
+ * Where output can't be held back (terminals, config files, "| include")
+ * fn runs right away instead.  Returns what the DEFUN should return.
+ */
+typedef void (*vty_defer_fn)(struct vty *out, void *arg);
+extern int vty_defer(struct vty *vty, vty_defer_fn fn, void *arg,
+		     void (*arg_free)(void *arg));
+
 static inline bool vty_needs_implicit_commit(struct vty *vty)
 {
 	return frr_get_cli_mode() == FRR_CLI_CLASSIC && !vty->pending_allowed;
@@ -50,6 +50,48 @@ socklen_t zclient_addr_len;
 /* This file local debug flag. */
 static int zclient_debug;
 
+/*
+ * Route adds held back to go as one ZEBRA_ROUTE_ADD_BULK: the common
+ * part of them is the key, zeroed but for what the message says is set
+ * so they compare bytewise.
+ */
+struct zapi_route_bulk_key {
+	vrf_id_t vrf_id;
+	uint32_t flags;
+	uint32_t message;
+	uint32_t nhgid;
+	uint32_t metric;
+	route_tag_t tag;
+	uint32_t mtu;
+	uint32_t tableid;
+	safi_t safi;
+	unsigned short instance;
+	uint8_t type;
+	uint8_t distance;
+};
+
+struct zapi_route_bulk {
+	struct zapi_route_bulk_key key;
+
+	struct stream *s;
+	size_t count_pos;
+	uint16_t count;
+};
+
+/*
+ * Entries held back to go as one message, for the commands zebra reads any
+ * number of entries from, like ZEBRA_NEXTHOP_REGISTER
+ */
+struct zapi_msg_bulk {
+	struct stream *s;
+	uint16_t command;
+	vrf_id_t vrf_id;
+	uint16_t count;
+};
+
+/* Largest nexthop entry of a ZEBRA_NEXTHOP_(UN)REGISTER */
+#define ZAPI_RNH_ENTRY_MAX (7 + IPV6_MAX_BYTELEN)
+
 /* Allocate zclient structure. */
 struct zclient *zclient_new(struct event_loop *master,
 			    struct zclient_options *opt,
@@ -88,6 +130,14 @@ void zclient_free(struct zclient *zclient)
 		stream_free(zclient->obuf);
 	if (zclient->wb)
 		buffer_free(zclient->wb);
+	if (zclient->bulk) {
+		stream_free(zclient->bulk->s);
+		XFREE(MTYPE_ZCLIENT, zclient->bulk);
+	}
+	if (zclient->msg_bulk) {
+		stream_free(zclient->msg_bulk->s);
+		XFREE(MTYPE_ZCLIENT, zclient->msg_bulk);
+	}
 
 	XFREE(MTYPE_ZCLIENT, zclient);
 }
@@ -163,10 +213,16 @@ void zclient_stop(struct zclient *zclient)
 	EVENT_OFF(zclient->t_read);
 	EVENT_OFF(zclient->t_connect);
 	EVENT_OFF(zclient->t_write);
+	EVENT_OFF(zclient->t_bulk);
+	EVENT_OFF(zclient->t_msg_bulk);
 
 	/* Reset streams. */
 	stream_reset(zclient->ibuf);
 	stream_reset(zclient->obuf);
+	if (zclient->bulk)
+		zclient->bulk->count = 0;
+	if (zclient->msg_bulk)
+		zclient->msg_bulk->count = 0;
 
 	/* Empty the write buffer. */
 	buffer_reset(zclient->wb);
@@ -282,13 +338,21 @@ static void zclient_flush_data(struct event *thread)
  * ZCLIENT_SEND_SUCCESS  - means we sent data to zebra
  * ZCLIENT_SEND_BUFFERED - means we are buffering
  */
-enum zclient_send_status zclient_send_message(struct zclient *zclient)
+static enum zclient_send_status zclient_send_stream(struct zclient *zclient,
+						    struct stream *s)
 {
 	if (zclient->sock < 0)
 		return ZCLIENT_SEND_FAILURE;
-	switch (buffer_write(zclient->wb, zclient->sock,
-			     STREAM_DATA(zclient->obuf),
-			     stream_get_endp(zclient->obuf))) {
+
+	if (zclient->write_batch) {
+		buffer_put(zclient->wb, STREAM_DATA(s), stream_get_endp(s));
+		event_add_write(zclient->master, zclient_flush_data, zclient,
+				zclient->sock, &zclient->t_write);
+		return ZCLIENT_SEND_BUFFERED;
+	}
+
+	switch (buffer_write(zclient->wb, zclient->sock, STREAM_DATA(s),
+			     stream_get_endp(s))) {
 	case BUFFER_ERROR:
 		flog_err(EC_LIB_ZAPI_SOCKET,
 			 "%s: buffer_write failed to zclient fd %d, closing",
@@ -307,6 +371,16 @@ enum zclient_send_status zclient_send_message(struct zclient *zclient)
 	return ZCLIENT_SEND_SUCCESS;
 }
 
+enum zclient_send_status zclient_send_message(struct zclient *zclient)
+{
+	/* Messages held back go first, to keep the order they were sent in */
+	if (zclient->bulk && zclient->bulk->count)
+		zclient_route_bulk_flush(zclient);
+	if (zclient->msg_bulk && zclient->msg_bulk->count)
+		zclient_msg_bulk_flush(zclient);
+	return zclient_send_stream(zclient, zclient->obuf);
+}
+
 /*
  * If we add more data to this structure please ensure that
  * struct zmsghdr in lib/zclient.h is updated as appropriate.
@@ -762,16 +836,10 @@ static void zclient_connect(struct event *t)
 	zclient_start(zclient);
 }
 
-enum zclient_send_status zclient_send_rnh(struct zclient *zclient, int command,
-					  const struct prefix *p, safi_t safi,
-					  bool connected, bool resolve_via_def,
-					  vrf_id_t vrf_id)
+static void zclient_rnh_encode(struct stream *s, const struct prefix *p,
+			       safi_t safi, bool connected,
+			       bool resolve_via_def)
 {
-	struct stream *s;
-
-	s = zclient->obuf;
-	stream_reset(s);
-	zclient_create_header(s, command, vrf_id);
 	stream_putc(s, (connected) ? 1 : 0);
 	stream_putc(s, (resolve_via_def) ? 1 : 0);
 	stream_putw(s, safi);
@@ -787,11 +855,220 @@ enum zclient_send_status zclient_send_rnh(struct zclient *zclient, int command,
 	default:
 		break;
 	}
+}
+
+void zclient_msg_bulk_flush(struct zclient *zclient)
+{
+	struct zapi_msg_bulk *bulk = zclient->msg_bulk;
+
+	EVENT_OFF(zclient->t_msg_bulk);
+	if (!bulk || !bulk->count)
+		return;
+
+	stream_putw_at(bulk->s, 0, stream_get_endp(bulk->s));
+	bulk->count = 0;
+
+	/* Buffered or failed, it comes up again on the next send */
+	(void)zclient_send_stream(zclient, bulk->s);
+}
+
+static void zclient_msg_bulk_event(struct event *event)
+{
+	zclient_msg_bulk_flush(EVENT_ARG(event));
+}
+
+struct stream *zclient_msg_bulk_entry(struct zclient *zclient,
+				     uint16_t command, vrf_id_t vrf_id,
+				     size_t entry_max)
+{
+	struct zapi_msg_bulk *bulk = zclient->msg_bulk;
+
+	if (zclient->sock < 0)
+		return NULL;
+
+	if (!bulk) {
+		bulk = XCALLOC(MTYPE_ZCLIENT, sizeof(*bulk));
+		bulk->s = stream_new(ZEBRA_MAX_PACKET_SIZ);
+		zclient->msg_bulk = bulk;
+	}
+
+	if (bulk->count &&
+	    (bulk->command != command || bulk->vrf_id != vrf_id ||
+	     STREAM_WRITEABLE(bulk->s) < entry_max))
+		zclient_msg_bulk_flush(zclient);
+
+	if (!bulk->count) {
+		/* Route adds held back were sent before */
+		if (zclient->bulk && zclient->bulk->count)
+			zclient_route_bulk_flush(zclient);
+
+		bulk->command = command;
+		bulk->vrf_id = vrf_id;
+		stream_reset(bulk->s);
+		zclient_create_header(bulk->s, command, vrf_id);
+	}
+	bulk->count++;
+
+	/* Whatever else is sent from the current event goes along */
+	event_add_event(zclient->master, zclient_msg_bulk_event, zclient, 0,
+			&zclient->t_msg_bulk);
+	return bulk->s;
+}
+
+enum zclient_send_status zclient_send_rnh(struct zclient *zclient, int command,
+					  const struct prefix *p, safi_t safi,
+					  bool connected, bool resolve_via_def,
+					  vrf_id_t vrf_id)
+{
+	struct stream *s;
+
+	if (zclient->nexthop_bulk) {
+		s = zclient_msg_bulk_entry(zclient, command, vrf_id,
+					   ZAPI_RNH_ENTRY_MAX);
+		if (!s)
+			return ZCLIENT_SEND_FAILURE;
+
+		zclient_rnh_encode(s, p, safi, connected, resolve_via_def);
+		return ZCLIENT_SEND_SUCCESS;
+	}
+
+	s = zclient->obuf;
+	stream_reset(s);
+	zclient_create_header(s, command, vrf_id);
+	zclient_rnh_encode(s, p, safi, connected, resolve_via_def);
 	stream_putw_at(s, 0, stream_get_endp(s));
 
 	return zclient_send_message(zclient);
 }
 
+static bool zapi_route_bulkable(const struct zapi_route *api)
+{
+	/* bgpd leaves ZAPI_MESSAGE_NEXTHOP set with the nexthops moved out */
+	return CHECK_FLAG(api->message, ZAPI_MESSAGE_NHG) &&
+	       !api->nexthop_num &&
+	       !CHECK_FLAG(api->message, ZAPI_ROUTE_BULK_EXCLUDED &
+						 ~ZAPI_MESSAGE_NEXTHOP) &&
+	       api->type < ZEBRA_ROUTE_MAX && api->safi >= SAFI_UNICAST &&
+	       api->safi < SAFI_MAX;
+}
+
+static void zapi_route_bulk_key_init(struct zapi_route_bulk_key *key,
+				     const struct zapi_route *api)
+{
+	memset(key, 0, sizeof(*key));
+	key->vrf_id = api->vrf_id;
+	key->flags = api->flags;
+	key->message = api->message & ~ZAPI_MESSAGE_NEXTHOP;
+	key->nhgid = api->nhgid;
+	key->safi = api->safi;
+	key->instance = api->instance;
+	key->type = api->type;
+	if (CHECK_FLAG(key->message, ZAPI_MESSAGE_DISTANCE))
+		key->distance = api->distance;
+	if (CHECK_FLAG(key->message, ZAPI_MESSAGE_METRIC))
+		key->metric = api->metric;
+	if (CHECK_FLAG(key->message, ZAPI_MESSAGE_TAG))
+		key->tag = api->tag;
+	if (CHECK_FLAG(key->message, ZAPI_MESSAGE_MTU))
+		key->mtu = api->mtu;
+	if (CHECK_FLAG(key->message, ZAPI_MESSAGE_TABLEID))
+		key->tableid = api->tableid;
+}
+
+static void zapi_route_bulk_start(struct zapi_route_bulk *bulk)
+{
+	const struct zapi_route_bulk_key *key = &bulk->key;
+	struct stream *s = bulk->s;
+
+	stream_reset(s);
+	zclient_create_header(s, ZEBRA_ROUTE_ADD_BULK, key->vrf_id);
+	stream_putc(s, key->type);
+	stream_putw(s, key->instance);
+	stream_putl(s, key->flags);
+	stream_putl(s, key->message);
+	stream_putc(s, key->safi);
+	stream_putl(s, key->nhgid);
+
+	/* Attributes, in the order zapi_route_encode() puts them */
+	if (CHECK_FLAG(key->message, ZAPI_MESSAGE_DISTANCE))
+		stream_putc(s, key->distance);
+	if (CHECK_FLAG(key->message, ZAPI_MESSAGE_METRIC))
+		stream_putl(s, key->metric);
+	if (CHECK_FLAG(key->message, ZAPI_MESSAGE_TAG))
+		stream_putl(s, key->tag);
+	if (CHECK_FLAG(key->message, ZAPI_MESSAGE_MTU))
+		stream_putl(s, key->mtu);
+	if (CHECK_FLAG(key->message, ZAPI_MESSAGE_TABLEID))
+		stream_putl(s, key->tableid);
+
+	bulk->count_pos = stream_get_endp(s);
+	stream_putw(s, 0);
+	bulk->count = 0;
+}
+
+void zclient_route_bulk_flush(struct zclient *zclient)
+{
+	struct zapi_route_bulk *bulk = zclient->bulk;
+
+	EVENT_OFF(zclient->t_bulk);
+	if (!bulk || !bulk->count)
+		return;
+
+	stream_putw_at(bulk->s, bulk->count_pos, bulk->count);
+	stream_putw_at(bulk->s, 0, stream_get_endp(bulk->s));
+	bulk->count = 0;
+
+	/* Buffered or failed, it comes up again on the next send */
+	(void)zclient_send_stream(zclient, bulk->s);
+}
+
+static void zclient_route_bulk_timer(struct event *event)
+{
+	zclient_route_bulk_flush(EVENT_ARG(event));
+}
+
+static enum zclient_send_status
+zclient_route_bulk_add(struct zclient *zclient, const struct zapi_route *api)
+{
+	struct zapi_route_bulk *bulk = zclient->bulk;
+	struct zapi_route_bulk_key key;
+
+	if (zclient->sock < 0)
+		return ZCLIENT_SEND_FAILURE;
+
+	if (!bulk) {
+		bulk = XCALLOC(MTYPE_ZCLIENT, sizeof(*bulk));
+		bulk->s = stream_new(ZEBRA_MAX_PACKET_SIZ);
+		zclient->bulk = bulk;
+	}
+
+	zapi_route_bulk_key_init(&key, api);
+	if (bulk->count &&
+	    (memcmp(&key, &bulk->key, sizeof(key)) || bulk->count == UINT16_MAX ||
+	     STREAM_WRITEABLE(bulk->s) < 2 + sizeof(api->prefix.u.prefix6)))
+		zclient_route_bulk_flush(zclient);
+
+	if (!bulk->count) {
+		/* Entries held back by zclient_msg_bulk_entry() go first */
+		if (zclient->msg_bulk && zclient->msg_bulk->count)
+			zclient_msg_bulk_flush(zclient);
+
+		bulk->key = key;
+		zapi_route_bulk_start(bulk);
+	}
+
+	stream_putc(bulk->s, api->prefix.family);
+	stream_putc(bulk->s, api->prefix.prefixlen);
+	stream_write(bulk->s, &api->prefix.u.prefix,
+		     PSIZE(api->prefix.prefixlen));
+	bulk->count++;
+
+	/* Not pushed back by later routes: at most the window, from the first */
+	event_add_timer_msec(zclient->master, zclient_route_bulk_timer, zclient,
+			     ZAPI_ROUTE_BULK_MSEC, &zclient->t_bulk);
+	return ZCLIENT_SEND_SUCCESS;
+}
+
 /*
  * "xdr_encode"-like interface that allows daemon (client) to send
  * a message to zebra server for a route that needs to be
@@ -817,6 +1094,10 @@ enum zclient_send_status zclient_send_rnh(struct zclient *zclient, int command,
 enum zclient_send_status
 zclient_route_send(uint8_t cmd, struct zclient *zclient, struct zapi_route *api)
 {
+	if (cmd == ZEBRA_ROUTE_ADD && zclient->route_bulk &&
+	    zapi_route_bulkable(api))
+		return zclient_route_bulk_add(zclient, api);
+
 	if (zapi_route_encode(cmd, zclient->obuf, api) < 0)
 		return ZCLIENT_SEND_FAILURE;
 	return zclient_send_message(zclient);
@@ -1452,13 +1733,23 @@ stream_failure:
 	return ret;
 }
 
-int zapi_route_decode(struct stream *s, struct zapi_route *api)
+static void zapi_route_clear(struct zapi_route *api)
 {
-	struct zapi_nexthop *api_nh;
-	int i;
-
-	memset(api, 0, sizeof(*api));
+	/*
+	 * Most of api is nexthop arrays: only the entries decoded into are
+	 * cleared, and the first one, which redistribution readers look at
+	 * without checking the count.
+	 */
+	memset(api, 0, offsetof(struct zapi_route, nexthops));
+	memset(&api->nexthops[0], 0, sizeof(api->nexthops[0]));
+	api->backup_nexthop_num = 0;
+	memset(&api->nhgid, 0,
+	       offsetof(struct zapi_route, opaque.data) -
+		       offsetof(struct zapi_route, nhgid));
+}
 
+static int zapi_route_header_decode(struct stream *s, struct zapi_route *api)
+{
 	/* Type, flags, message. */
 	STREAM_GETC(s, api->type);
 	if (api->type >= ZEBRA_ROUTE_MAX) {
@@ -1479,35 +1770,78 @@ int zapi_route_decode(struct stream *s, struct zapi_route *api)
 		return -1;
 	}
 
-	/* Prefix. */
-	STREAM_GETC(s, api->prefix.family);
-	STREAM_GETC(s, api->prefix.prefixlen);
-	switch (api->prefix.family) {
+	return 0;
+stream_failure:
+	return -1;
+}
+
+static int zapi_route_prefix_decode(struct stream *s, struct prefix *p)
+{
+	STREAM_GETC(s, p->family);
+	STREAM_GETC(s, p->prefixlen);
+	switch (p->family) {
 	case AF_INET:
-		if (api->prefix.prefixlen > IPV4_MAX_BITLEN) {
+		if (p->prefixlen > IPV4_MAX_BITLEN) {
 			flog_err(
 				EC_LIB_ZAPI_ENCODE,
 				"%s: V4 prefixlen is %d which should not be more than 32",
-				__func__, api->prefix.prefixlen);
+				__func__, p->prefixlen);
 			return -1;
 		}
 		break;
 	case AF_INET6:
-		if (api->prefix.prefixlen > IPV6_MAX_BITLEN) {
+		if (p->prefixlen > IPV6_MAX_BITLEN) {
 			flog_err(
 				EC_LIB_ZAPI_ENCODE,
 				"%s: v6 prefixlen is %d which should not be more than 128",
-				__func__, api->prefix.prefixlen);
+				__func__, p->prefixlen);
 			return -1;
 		}
 		break;
 	default:
 		flog_err(EC_LIB_ZAPI_ENCODE,
 			 "%s: Specified family %d is not v4 or v6", __func__,
-			 api->prefix.family);
+			 p->family);
 		return -1;
 	}
-	STREAM_GET(&api->prefix.u.prefix, s, PSIZE(api->prefix.prefixlen));
+	STREAM_GET(&p->u.prefix, s, PSIZE(p->prefixlen));
+
+	return 0;
+stream_failure:
+	return -1;
+}
+
+static int zapi_route_attrs_decode(struct stream *s, struct zapi_route *api)
+{
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_DISTANCE))
+		STREAM_GETC(s, api->distance);
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_METRIC))
+		STREAM_GETL(s, api->metric);
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_TAG))
+		STREAM_GETL(s, api->tag);
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_MTU))
+		STREAM_GETL(s, api->mtu);
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_TABLEID))
+		STREAM_GETL(s, api->tableid);
+
+	return 0;
+stream_failure:
+	return -1;
+}
+
+int zapi_route_decode(struct stream *s, struct zapi_route *api)
+{
+	struct zapi_nexthop *api_nh;
+	int i;
+
+	zapi_route_clear(api);
+
+	if (zapi_route_header_decode(s, api) < 0)
+		return -1;
+
+	/* Prefix. */
+	if (zapi_route_prefix_decode(s, &api->prefix) < 0)
+		return -1;
 
 	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_SRCPFX)) {
 		api->src_prefix.family = AF_INET6;
@@ -1547,6 +1881,7 @@ int zapi_route_decode(struct stream *s, struct zapi_route *api)
 
 		for (i = 0; i < api->nexthop_num; i++) {
 			api_nh = &api->nexthops[i];
+			memset(api_nh, 0, sizeof(*api_nh));
 
 			if (zapi_nexthop_decode(s, api_nh, api->flags,
 						api->message)
@@ -1567,6 +1902,7 @@ int zapi_route_decode(struct stream *s, struct zapi_route *api)
 
 		for (i = 0; i < api->backup_nexthop_num; i++) {
 			api_nh = &api->backup_nexthops[i];
+			memset(api_nh, 0, sizeof(*api_nh));
 
 			if (zapi_nexthop_decode(s, api_nh, api->flags,
 						api->message)
@@ -1576,16 +1912,8 @@ int zapi_route_decode(struct stream *s, struct zapi_route *api)
 	}
 
 	/* Attributes. */
-	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_DISTANCE))
-		STREAM_GETC(s, api->distance);
-	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_METRIC))
-		STREAM_GETL(s, api->metric);
-	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_TAG))
-		STREAM_GETL(s, api->tag);
-	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_MTU))
-		STREAM_GETL(s, api->mtu);
-	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_TABLEID))
-		STREAM_GETL(s, api->tableid);
+	if (zapi_route_attrs_decode(s, api) < 0)
+		return -1;
 
 	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_OPAQUE)) {
 		STREAM_GETW(s, api->opaque.length);
@@ -1605,6 +1933,37 @@ stream_failure:
 	return -1;
 }
 
+int zapi_route_bulk_decode(struct stream *s, struct zapi_route *api,
+			   uint16_t *count)
+{
+	zapi_route_clear(api);
+
+	if (zapi_route_header_decode(s, api) < 0)
+		return -1;
+	if (!CHECK_FLAG(api->message, ZAPI_MESSAGE_NHG) ||
+	    CHECK_FLAG(api->message, ZAPI_ROUTE_BULK_EXCLUDED)) {
+		flog_err(EC_LIB_ZAPI_ENCODE,
+			 "%s: bulk routes carry a group id only (message %#x)",
+			 __func__, api->message);
+		return -1;
+	}
+	STREAM_GETL(s, api->nhgid);
+
+	if (zapi_route_attrs_decode(s, api) < 0)
+		return -1;
+
+	STREAM_GETW(s, *count);
+	return 0;
+stream_failure:
+	return -1;
+}
+
+int zapi_route_bulk_decode_prefix(struct stream *s, struct zapi_route *api)
+{
+	memset(&api->prefix, 0, sizeof(api->prefix));
+	return zapi_route_prefix_decode(s, &api->prefix);
+}
+
 static void zapi_encode_prefix(struct stream *s, struct prefix *p,
 			       uint8_t family)
 {
@@ -4724,13 +5083,10 @@ static int zclient_neigh_ip_read_entry(struct stream *s, struct ipaddr *add)
 	return -1;
 }
 
-int zclient_neigh_ip_encode(struct stream *s, uint16_t cmd, union sockunion *in,
-			    union sockunion *out, struct interface *ifp,
-			    int ndm_state)
+static void zclient_neigh_ip_put_entry(struct stream *s, union sockunion *in,
+				       union sockunion *out,
+				       struct interface *ifp, int ndm_state)
 {
-	int ret = 0;
-
-	zclient_create_header(s, cmd, ifp->vrf->vrf_id);
 	stream_putc(s, sockunion_family(in));
 	stream_write(s, sockunion_get_addr(in), sockunion_get_addrlen(in));
 	if (out && sockunion_family(out) != AF_UNSPEC) {
@@ -4744,7 +5100,32 @@ int zclient_neigh_ip_encode(struct stream *s, uint16_t cmd, union sockunion *in,
 		stream_putl(s, ndm_state);
 	else
 		stream_putl(s, ZEBRA_NEIGH_STATE_FAILED);
-	return ret;
+}
+
+int zclient_neigh_ip_encode(struct stream *s, uint16_t cmd, union sockunion *in,
+			    union sockunion *out, struct interface *ifp,
+			    int ndm_state)
+{
+	zclient_create_header(s, cmd, ifp->vrf->vrf_id);
+	zclient_neigh_ip_put_entry(s, in, out, ifp, ndm_state);
+	return 0;
+}
+
+enum zclient_send_status
+zclient_neigh_ip_send_bulk(struct zclient *zclient, union sockunion *in,
+			   union sockunion *out, struct interface *ifp,
+			   int ndm_state)
+{
+	struct stream *s;
+
+	s = zclient_msg_bulk_entry(zclient,
+				   out ? ZEBRA_NEIGH_IP_ADD : ZEBRA_NEIGH_IP_DEL,
+				   ifp->vrf->vrf_id, ZAPI_NEIGH_IP_ENTRY_MAX);
+	if (!s)
+		return ZCLIENT_SEND_FAILURE;
+
+	zclient_neigh_ip_put_entry(s, in, out, ifp, ndm_state);
+	return ZCLIENT_SEND_BUFFERED;
 }
 
 int zclient_neigh_ip_decode(struct stream *s, struct zapi_neigh_ip *api)
@@ -234,6 +234,7 @@ typedef enum {
 	ZEBRA_TC_FILTER_ADD,
 	ZEBRA_TC_FILTER_DELETE,
 	ZEBRA_OPAQUE_NOTIFY,
+	ZEBRA_ROUTE_ADD_BULK,
 } zebra_message_types_t;
 /* Zebra message types. Please update the corresponding
  * command_types array with any changes!
@@ -335,6 +336,35 @@ struct zclient {
 	/* Thread to write buffered data to zebra. */
 	struct event *t_write;
 
+	/*
+	 * Coalesce route adds that go by a nexthop group id, and share all
+	 * but the prefix, into ZEBRA_ROUTE_ADD_BULK messages. They are held
+	 * for ZAPI_ROUTE_BULK_MSEC at most, and until before any other
+	 * message goes, so zebra sees everything in the order it was sent.
+	 */
+	bool route_bulk;
+	struct zapi_route_bulk *bulk;
+	struct event *t_bulk;
+
+	/*
+	 * Put the nexthop (un)registrations for a VRF into one message, as
+	 * many as come before the end of the current event or until any
+	 * other message goes.
+	 */
+	bool nexthop_bulk;
+
+	/*
+	 * Queue the messages for the next write to zebra instead of writing
+	 * each as it is sent, so a burst of them, like the routes of a config
+	 * load, goes in as few writes as the socket takes.  Send failures then
+	 * only show when the connection is torn down.
+	 */
+	bool write_batch;
+
+	/* See zclient_msg_bulk_entry() */
+	struct zapi_msg_bulk *msg_bulk;
+	struct event *t_msg_bulk;
+
 	/* Redistribute information. */
 	uint8_t redist_default; /* clients protocol */
 	unsigned short instance;
@@ -389,6 +419,12 @@ extern int zclient_bfd_session_update(ZAPI_CALLBACK_ARGS);
 #define ZAPI_MESSAGE_SRTE 0x0200
 #define ZAPI_MESSAGE_OPAQUE 0x0400
 
+/* What a route must not have to go in a ZEBRA_ROUTE_ADD_BULK */
+#define ZAPI_ROUTE_BULK_EXCLUDED                                               \
+	(ZAPI_MESSAGE_NEXTHOP | ZAPI_MESSAGE_SRCPFX |                          \
+	 ZAPI_MESSAGE_BACKUP_NEXTHOPS | ZAPI_MESSAGE_SRTE | ZAPI_MESSAGE_OPAQUE)
+#define ZAPI_ROUTE_BULK_MSEC 10
+
 #define ZSERV_VERSION 6
 /* Zserv protocol message header */
 struct zmsghdr {
@@ -853,6 +889,17 @@ int zclient_neigh_ip_encode(struct stream *s, uint16_t cmd, union sockunion *in,
 			    union sockunion *out, struct interface *ifp,
 			    int ndm_state);
 
+/*
+ * Queue a ZEBRA_NEIGH_IP_ADD, or a ZEBRA_NEIGH_IP_DEL without out, with
+ * zclient_msg_bulk_entry(): the neighbors sent from the same event go to
+ * zebra as one message.
+ */
+#define ZAPI_NEIGH_IP_ENTRY_MAX (2 * (1 + IPV6_MAX_BYTELEN) + 8)
+extern enum zclient_send_status
+zclient_neigh_ip_send_bulk(struct zclient *zclient, union sockunion *in,
+			   union sockunion *out, struct interface *ifp,
+			   int ndm_state);
+
 /*
  * We reserve the top 4 bits for l2-NHG, everything else
  * is for zebra/proto l3-NHG.
@@ -955,6 +1002,21 @@ extern void zclient_redistribute_default(int command, struct zclient *,
  *  1 data was buffered for future usage
  */
 extern enum zclient_send_status zclient_send_message(struct zclient *);
+/* Send what route adds are being coalesced, if any */
+extern void zclient_route_bulk_flush(struct zclient *zclient);
+/* Same for the entries put by zclient_msg_bulk_entry() */
+extern void zclient_msg_bulk_flush(struct zclient *zclient);
+
+/*
+ * For the commands zebra reads any number of entries from, e.g.
+ * ZEBRA_NEXTHOP_REGISTER or ZEBRA_REMOTE_MACIP_ADD: returns the stream to
+ * put one entry of at most entry_max bytes on, NULL if not connected. The
+ * entries for the same command and VRF go as one message, at the end of
+ * the current event, when it is full, or before any other message.
+ */
+extern struct stream *zclient_msg_bulk_entry(struct zclient *zclient,
+					     uint16_t command, vrf_id_t vrf_id,
+					     size_t entry_max);
 
 /* create header for command, length to be filled in by user later */
 extern void zclient_create_header(struct stream *, uint16_t, vrf_id_t);
@@ -1088,6 +1150,14 @@ int zapi_nexthop_encode(struct stream *s, const struct zapi_nexthop *api_nh,
 			uint32_t api_flags, uint32_t api_message);
 extern int zapi_route_encode(uint8_t, struct stream *, struct zapi_route *);
 extern int zapi_route_decode(struct stream *s, struct zapi_route *api);
+/*
+ * A ZEBRA_ROUTE_ADD_BULK: everything but the prefix into api, and how many
+ * prefixes follow, to take one after the other with _decode_prefix
+ */
+extern int zapi_route_bulk_decode(struct stream *s, struct zapi_route *api,
+				  uint16_t *count);
+extern int zapi_route_bulk_decode_prefix(struct stream *s,
+					 struct zapi_route *api);
 extern int zapi_nexthop_decode(struct stream *s, struct zapi_nexthop *api_nh,
 			       uint32_t api_flags, uint32_t api_message);
 bool zapi_nhg_notify_decode(struct stream *s, uint32_t *id,
@@ -52,6 +52,7 @@
 
 DEFINE_MTYPE_STATIC(LIB, LOG_MESSAGE,  "log message");
 DEFINE_MTYPE_STATIC(LIB, LOG_TLSBUF,   "log thread-local buffer");
+DEFINE_MTYPE_STATIC(LIB, LOG_ASYNC,    "log asynchronous ring");
 
 DEFINE_HOOK(zlog_init, (const char *progname, const char *protoname,
 			unsigned short instance, uid_t uid, gid_t gid),
@@ -131,6 +132,9 @@ struct zlog_msg {
 	 */
 	struct fmt_outpos argpos[24];
 	size_t n_argpos;
+
+	/* thread the message was logged on, if not the one writing it */
+	intmax_t tid;
 };
 
 /* thread-local log message buffering
@@ -157,17 +161,23 @@ struct zlog_msg {
 #define TLS_LOG_BUF_SIZE	8192
 #define TLS_LOG_MAXMSG		64
 
+struct zlog_async_ring;
+
 struct zlog_tls {
 	char *mmbuf;
 	size_t bufpos;
 	bool do_unlink;
 
+	/* claimed on first use while asynchronous output is on */
+	struct zlog_async_ring *ring;
+
 	size_t nmsgs;
 	struct zlog_msg msgs[TLS_LOG_MAXMSG];
 	struct zlog_msg *msgp[TLS_LOG_MAXMSG];
 };
 
 static inline void zlog_tls_free(void *arg);
+static void zlog_tls_flush(struct zlog_tls *zlog_tls, bool async);
 
 /* proper ELF TLS is a bit faster than pthread_[gs]etspecific, so if it's
  * available we'll use it here
@@ -330,7 +340,8 @@ void zlog_tls_buffer_fini(void)
 	struct zlog_tls *zlog_tls = zlog_tls_get();
 	bool do_unlink = zlog_tls ? zlog_tls->do_unlink : false;
 
-	zlog_tls_buffer_flush();
+	/* not through the writer: this may be the crash handler */
+	zlog_tls_flush(zlog_tls, false);
 
 	zlog_tls_free(zlog_tls);
 	zlog_tls_set(NULL);
@@ -362,12 +373,319 @@ void zlog_msg_pid(struct zlog_msg *msg, intmax_t *pid, intmax_t *tid)
 	*pid = (intmax_t)getpid();
 #endif
 #ifdef CAN_DO_TLS
-	*tid = zlog_gettid();
+	*tid = msg->tid ? msg->tid : zlog_gettid();
 #else
 	*tid = *pid;
 #endif
 }
 
+/* asynchronous output
+ *
+ * With this on, a thread's buffered messages are not written by the thread
+ * itself on flush.  They are copied, already formatted, into a ring of the
+ * thread's own and written out by a dedicated writer pthread.  The rings
+ * are single-producer single-consumer, so neither side takes a lock; the
+ * writer only needs waking up when it went to sleep on empty rings.
+ *
+ * A thread never waits on a full ring.  Informational and debug messages
+ * that do not fit are dropped and counted, anything more severe (and any
+ * message too long for a slot) is written synchronously as before.  Rings
+ * are kept for the process lifetime and handed on to new threads as the
+ * ones that used them exit.
+ */
+
+#define ZLOG_ASYNC_SLOTS	128
+#define ZLOG_ASYNC_TEXTSZ	1024
+/* how long the writer sleeps on empty rings before checking again */
+#define ZLOG_ASYNC_IDLE_MSEC	100
+
+struct zlog_async_slot {
+	struct zlog_msg msg;
+	char text[ZLOG_ASYNC_TEXTSZ];
+};
+
+PREDECL_ATOMLIST(zlog_async_rings);
+
+struct zlog_async_ring {
+	struct zlog_async_rings_item item;
+
+	atomic_bool owned;
+	/* advanced by the owning thread only */
+	_Atomic uint32_t head;
+	/* advanced by the writer only */
+	_Atomic uint32_t tail;
+
+	struct zlog_async_slot slots[ZLOG_ASYNC_SLOTS];
+};
+
+DECLARE_ATOMLIST(zlog_async_rings, struct zlog_async_ring, item);
+static struct zlog_async_rings_head zlog_async_rings;
+
+static atomic_bool zlog_async_on;
+static atomic_bool zlog_async_sleeping;
+static _Atomic uint64_t zlog_async_queued, zlog_async_dropped;
+
+static bool zlog_async_running;
+static bool zlog_async_stop;
+static pthread_t zlog_async_thread;
+static pthread_mutex_t zlog_async_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t zlog_async_cond = PTHREAD_COND_INITIALIZER;
+
+static struct zlog_async_ring *zlog_async_claim(void)
+{
+	struct zlog_async_ring *ring;
+	bool expect;
+
+	frr_each (zlog_async_rings, &zlog_async_rings, ring) {
+		expect = false;
+		if (atomic_compare_exchange_strong_explicit(
+			    &ring->owned, &expect, true, memory_order_acq_rel,
+			    memory_order_relaxed))
+			return ring;
+	}
+
+	ring = XCALLOC(MTYPE_LOG_ASYNC, sizeof(*ring));
+	atomic_store_explicit(&ring->owned, true, memory_order_relaxed);
+	zlog_async_rings_add_head(&zlog_async_rings, ring);
+	return ring;
+}
+
+static void zlog_async_release(struct zlog_tls *zlog_tls)
+{
+	if (!zlog_tls->ring)
+		return;
+
+	atomic_store_explicit(&zlog_tls->ring->owned, false,
+			      memory_order_release);
+	zlog_tls->ring = NULL;
+}
+
+/* write out msgs ourselves, as without asynchronous output */
+static void zlog_async_sync(struct zlog_msg *msgs[], size_t nmsgs)
+{
+	struct zlog_target *zt;
+
+	rcu_read_lock();
+	frr_each_safe (zlog_targets, &zlog_targets, zt) {
+		if (!zt->logfn)
+			continue;
+
+		zt->logfn(zt, msgs, nmsgs);
+	}
+	rcu_read_unlock();
+}
+
+static void zlog_async_push(struct zlog_tls *zlog_tls)
+{
+	struct zlog_async_ring *ring;
+	struct zlog_async_slot *slot;
+	struct zlog_msg *msg;
+	uint32_t head, tail, queued = 0;
+	intmax_t pid, tid;
+	size_t i, textlen;
+
+	if (!zlog_tls->ring)
+		zlog_tls->ring = zlog_async_claim();
+	ring = zlog_tls->ring;
+
+	head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+	for (i = 0; i < zlog_tls->nmsgs; i++) {
+		msg = zlog_tls->msgp[i];
+
+		/* the message being flushed on may not be formatted yet */
+		zlog_msg_text(msg, &textlen);
+
+		if (head - tail == ZLOG_ASYNC_SLOTS)
+			tail = atomic_load_explicit(&ring->tail,
+						    memory_order_acquire);
+		if (textlen + 2 > ZLOG_ASYNC_TEXTSZ ||
+		    head - tail == ZLOG_ASYNC_SLOTS) {
+			if (msg->prio < LOG_INFO || textlen + 2 >
+							   ZLOG_ASYNC_TEXTSZ)
+				zlog_async_sync(&msg, 1);
+			else
+				atomic_fetch_add_explicit(&zlog_async_dropped,
+							  1,
+							  memory_order_relaxed);
+			continue;
+		}
+
+		slot = &ring->slots[head % ZLOG_ASYNC_SLOTS];
+		memcpy(&slot->msg, msg, sizeof(slot->msg));
+		memcpy(slot->text, msg->text, textlen + 1);
+		slot->text[textlen + 1] = '\0';
+		slot->msg.text = slot->msg.stackbuf = slot->text;
+		slot->msg.stackbufsz = sizeof(slot->text);
+		/* ts_dot points into the original, have it redone */
+		slot->msg.ts_flags = 0;
+		zlog_msg_pid(msg, &pid, &tid);
+		slot->msg.tid = tid;
+
+		head++;
+		queued++;
+	}
+
+	if (!queued)
+		return;
+
+	atomic_store_explicit(&ring->head, head, memory_order_release);
+	atomic_fetch_add_explicit(&zlog_async_queued, queued,
+				  memory_order_relaxed);
+
+	/* either the writer sees the new head before it goes to sleep, or
+	 * we see it is going to and wake it up
+	 */
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&zlog_async_sleeping, memory_order_relaxed)) {
+		pthread_mutex_lock(&zlog_async_mtx);
+		pthread_cond_signal(&zlog_async_cond);
+		pthread_mutex_unlock(&zlog_async_mtx);
+	}
+}
+
+static bool zlog_async_pending(void)
+{
+	struct zlog_async_ring *ring;
+
+	frr_each (zlog_async_rings, &zlog_async_rings, ring)
+		if (atomic_load_explicit(&ring->head, memory_order_relaxed) !=
+		    atomic_load_explicit(&ring->tail, memory_order_relaxed))
+			return true;
+	return false;
+}
+
+/* write out what is in the rings; false if there was nothing */
+static bool zlog_async_drain(void)
+{
+	struct zlog_async_ring *ring;
+	struct zlog_msg *msgp[TLS_LOG_MAXMSG];
+	uint32_t head, tail;
+	size_t n;
+	bool any = false;
+
+	frr_each (zlog_async_rings, &zlog_async_rings, ring) {
+		tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+		head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+		while (tail != head) {
+			for (n = 0; n < array_size(msgp) && tail + n != head;
+			     n++)
+				msgp[n] = &ring->slots[(tail + n) %
+						       ZLOG_ASYNC_SLOTS]
+						   .msg;
+
+			zlog_async_sync(msgp, n);
+
+			tail += n;
+			atomic_store_explicit(&ring->tail, tail,
+					      memory_order_release);
+			any = true;
+		}
+	}
+	return any;
+}
+
+static void *zlog_async_writer(void *arg)
+{
+	struct rcu_thread *rcu_thread = arg;
+	struct timespec until;
+	bool stop = false;
+
+	rcu_thread_start(rcu_thread);
+	/* rcu_thread_start() leaves us in RCU-held state */
+	rcu_read_unlock();
+
+	while (!stop) {
+		if (zlog_async_drain())
+			continue;
+
+		pthread_mutex_lock(&zlog_async_mtx);
+		atomic_store_explicit(&zlog_async_sleeping, true,
+				      memory_order_relaxed);
+		/* pairs with the one in zlog_async_push() */
+		atomic_thread_fence(memory_order_seq_cst);
+
+		if (!zlog_async_stop && !zlog_async_pending()) {
+			clock_gettime(CLOCK_REALTIME, &until);
+			until.tv_nsec += ZLOG_ASYNC_IDLE_MSEC * 1000000L;
+			if (until.tv_nsec >= 1000000000L) {
+				until.tv_sec++;
+				until.tv_nsec -= 1000000000L;
+			}
+			pthread_cond_timedwait(&zlog_async_cond,
+					       &zlog_async_mtx, &until);
+		}
+		stop = zlog_async_stop;
+		atomic_store_explicit(&zlog_async_sleeping, false,
+				      memory_order_relaxed);
+		pthread_mutex_unlock(&zlog_async_mtx);
+	}
+
+	zlog_async_drain();
+	return NULL;
+}
+
+static void zlog_async_start(void)
+{
+	struct rcu_thread *rcu_thread;
+	sigset_t oldsigs, blocksigs;
+
+	if (zlog_async_running) {
+		atomic_store_explicit(&zlog_async_on, true,
+				      memory_order_relaxed);
+		return;
+	}
+
+	/* signals are for the main thread to handle */
+	sigfillset(&blocksigs);
+	pthread_sigmask(SIG_BLOCK, &blocksigs, &oldsigs);
+
+	zlog_async_stop = false;
+	rcu_thread = rcu_thread_prepare();
+	if (pthread_create(&zlog_async_thread, NULL, zlog_async_writer,
+			   rcu_thread)) {
+		rcu_thread_unprepare(rcu_thread);
+		pthread_sigmask(SIG_SETMASK, &oldsigs, NULL);
+		zlog_err("failed to start log writer thread: %s",
+			 strerror(errno));
+		return;
+	}
+	pthread_sigmask(SIG_SETMASK, &oldsigs, NULL);
+
+#ifdef HAVE_PTHREAD_SETNAME_NP
+# ifdef GNU_LINUX
+	pthread_setname_np(zlog_async_thread, "zlog-writer");
+# endif
+#endif
+	zlog_async_running = true;
+	atomic_store_explicit(&zlog_async_on, true, memory_order_relaxed);
+}
+
+static void zlog_async_finish(void)
+{
+	struct zlog_async_ring *ring;
+
+	atomic_store_explicit(&zlog_async_on, false, memory_order_relaxed);
+	if (!zlog_async_running)
+		return;
+
+	pthread_mutex_lock(&zlog_async_mtx);
+	zlog_async_stop = true;
+	pthread_cond_signal(&zlog_async_cond);
+	pthread_mutex_unlock(&zlog_async_mtx);
+
+	pthread_join(zlog_async_thread, NULL);
+	zlog_async_running = false;
+
+	/* anything pushed while the writer was on its way out */
+	zlog_async_drain();
+
+	while ((ring = zlog_async_rings_pop(&zlog_async_rings)))
+		XFREE(MTYPE_LOG_ASYNC, ring);
+}
+
 static inline void zlog_tls_free(void *arg)
 {
 	struct zlog_tls *zlog_tls = arg;
@@ -375,20 +693,28 @@ static inline void zlog_tls_free(void *arg)
 	if (!zlog_tls)
 		return;
 
+	zlog_async_release(zlog_tls);
 	munmap(zlog_tls->mmbuf, TLS_LOG_BUF_SIZE);
 	XFREE(MTYPE_LOG_TLSBUF, zlog_tls);
 }
 
-void zlog_tls_buffer_flush(void)
+static void zlog_tls_flush(struct zlog_tls *zlog_tls, bool async)
 {
 	struct zlog_target *zt;
-	struct zlog_tls *zlog_tls = zlog_tls_get();
 
 	if (!zlog_tls)
 		return;
 	if (!zlog_tls->nmsgs)
 		return;
 
+	if (async &&
+	    atomic_load_explicit(&zlog_async_on, memory_order_relaxed)) {
+		zlog_async_push(zlog_tls);
+		zlog_tls->bufpos = 0;
+		zlog_tls->nmsgs = 0;
+		return;
+	}
+
 	rcu_read_lock();
 	frr_each_safe (zlog_targets, &zlog_targets, zt) {
 		if (!zt->logfn)
@@ -402,6 +728,11 @@ void zlog_tls_buffer_flush(void)
 	zlog_tls->nmsgs = 0;
 }
 
+void zlog_tls_buffer_flush(void)
+{
+	zlog_tls_flush(zlog_tls_get(), true);
+}
+
 
 static void vzlog_notls(const struct xref_logmsg *xref, int prio,
 			const char *fmt, va_list ap)
@@ -966,6 +1297,32 @@ void zlog_set_immediate(bool set_p)
 	default_immediate = set_p;
 }
 
+/*
+ * Turning it off leaves the writer running, to finish what is queued and
+ * since threads may still hold on to their rings; it stops in zlog_fini().
+ */
+void zlog_set_async(bool set_p)
+{
+	if (set_p)
+		zlog_async_start();
+	else
+		atomic_store_explicit(&zlog_async_on, false,
+				      memory_order_relaxed);
+}
+
+bool zlog_get_async(void)
+{
+	return atomic_load_explicit(&zlog_async_on, memory_order_relaxed);
+}
+
+void zlog_async_stats(uint64_t *queued, uint64_t *dropped)
+{
+	*queued = atomic_load_explicit(&zlog_async_queued,
+				       memory_order_relaxed);
+	*dropped = atomic_load_explicit(&zlog_async_dropped,
+					memory_order_relaxed);
+}
+
 /* common init */
 
 #define TMPBASEDIR "/var/tmp/frr"
@@ -1045,6 +1402,8 @@ out_warn:
 
 void zlog_fini(void)
 {
+	zlog_async_finish();
+
 	hook_call(zlog_fini);
 
 	if (zlog_tmpdirfd >= 0) {
@@ -182,9 +182,7 @@ extern void zlog_msg_tsraw(struct zlog_msg *msg, struct timespec *ts);
 extern size_t zlog_msg_ts_3164(struct zlog_msg *msg, struct fbuf *out,
 			       uint32_t flags);
 
-/* currently just returns the current PID/TID since we never write another
- * thread's messages
- */
+/* the current PID, and the TID of the thread the message was logged on */
 extern void zlog_msg_pid(struct zlog_msg *msg, intmax_t *pid, intmax_t *tid);
 
 /* This list & struct implements the actual logging targets.  It is accessed
@@ -277,6 +275,13 @@ extern void zlog_tls_buffer_fini(void);
 /* Enable or disable 'immediate' output - default is to buffer messages. */
 extern void zlog_set_immediate(bool set_p);
 
+/* Enable or disable writing buffered messages out on a separate pthread,
+ * dropping low-priority ones rather than waiting when it falls behind.
+ */
+extern void zlog_set_async(bool set_p);
+extern bool zlog_get_async(void);
+extern void zlog_async_stats(uint64_t *queued, uint64_t *dropped);
+
 extern const char *zlog_priority_str(int priority);
 
 #ifdef __cplusplus
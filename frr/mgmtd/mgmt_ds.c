@@ -164,6 +164,7 @@ void mgmt_ds_reset_candidate(void)
 
 	dnode = yang_dnode_new(ly_native_ctx, true);
 	mm->candidate_ds->root.cfg_root->dnode = dnode;
+	nb_config_edited(mm->candidate_ds->root.cfg_root, NULL);
 }
 
 
@@ -405,9 +406,15 @@ int mgmt_ds_delete_data_nodes(struct mgmt_ds_ctx *ds_ctx, const char *xpath)
 			ds_ctx->config_ds ? ds_ctx->root.cfg_root->dnode
 					  : ds_ctx->root.dnode_root,
 			dep_xpath);
-		if (dep_dnode)
+		if (dep_dnode) {
+			if (ds_ctx->config_ds)
+				nb_config_edited(ds_ctx->root.cfg_root,
+						 dep_dnode->schema);
 			lyd_free_tree(dep_dnode);
+		}
 	}
+	if (ds_ctx->config_ds)
+		nb_config_edited(ds_ctx->root.cfg_root, dnode->schema);
 	lyd_free_tree(dnode);
 
 	return 0;
@@ -450,18 +450,12 @@ void nhrp_send_zebra_nbr(union sockunion *in,
 			 union sockunion *out,
 			 struct interface *ifp)
 {
-	struct stream *s;
-
-	if (!zclient || zclient->sock < 0)
+	if (!zclient)
 		return;
-	s = zclient->obuf;
-	stream_reset(s);
-	zclient_neigh_ip_encode(s, out ? ZEBRA_NEIGH_IP_ADD :
-				ZEBRA_NEIGH_IP_DEL, in, out,
-				ifp, out ? ZEBRA_NEIGH_STATE_REACHABLE
-				: ZEBRA_NEIGH_STATE_FAILED);
-	stream_putw_at(s, 0, stream_get_endp(s));
-	zclient_send_message(zclient);
+	/* A resolution storm programs its neighbors in a few messages */
+	zclient_neigh_ip_send_bulk(zclient, in, out, ifp,
+				   out ? ZEBRA_NEIGH_STATE_REACHABLE
+				       : ZEBRA_NEIGH_STATE_FAILED);
 }
 
 int nhrp_send_zebra_gre_request(struct interface *ifp)
@@ -492,11 +492,6 @@ void nhrp_shortcut_foreach(afi_t afi,
 	route_table_iter_cleanup(&iter);
 }
 
-struct purge_ctx {
-	const struct prefix *p;
-	int deleted;
-};
-
 void nhrp_shortcut_purge(struct nhrp_shortcut *s, int force)
 {
 	EVENT_OFF(s->t_timer);
@@ -521,19 +516,21 @@ void nhrp_shortcut_purge(struct nhrp_shortcut *s, int force)
 	}
 }
 
-static void nhrp_shortcut_purge_prefix(struct nhrp_shortcut *s, void *ctx)
+void nhrp_shortcut_prefix_change(const struct prefix *p, int deleted)
 {
-	struct purge_ctx *pctx = ctx;
+	struct route_table *rt = shortcut_rib[family2afi(PREFIX_FAMILY(p))];
+	struct route_node *top, *rn;
+	struct nhrp_shortcut *s;
 
-	if (prefix_match(pctx->p, s->p))
-		nhrp_shortcut_purge(s, pctx->deleted || !s->cache);
-}
+	if (!rt)
+		return;
 
-void nhrp_shortcut_prefix_change(const struct prefix *p, int deleted)
-{
-	struct purge_ctx pctx = {
-		.p = p, .deleted = deleted,
-	};
-	nhrp_shortcut_foreach(family2afi(PREFIX_FAMILY(p)),
-			      nhrp_shortcut_purge_prefix, &pctx);
+	/* Only the shortcuts within p are affected, walk just that subtree */
+	top = route_node_get(rt, p);
+	for (rn = route_lock_node(top); rn; rn = route_next_until(rn, top)) {
+		s = rn->info;
+		if (s)
+			nhrp_shortcut_purge(s, deleted || !s->cache);
+	}
+	route_unlock_node(top);
 }
@@ -3058,6 +3058,15 @@ struct ospf_lsa *ospf_lsa_install(struct ospf *ospf, struct ospf_interface *oi,
 		}
 	}
 
+	/* Keep the routes saved for partial SPF runs off the old instance */
+	if (old != NULL && (lsa->data->type == OSPF_ROUTER_LSA ||
+			    lsa->data->type == OSPF_NETWORK_LSA)) {
+		if (rt_recalc)
+			ospf_spf_intra_flush(ospf);
+		else
+			ospf_spf_intra_move(ospf, old->data, lsa->data);
+	}
+
 	/* discard old LSA from LSDB */
 	if (old != NULL)
 		ospf_discard_from_db(ospf, lsdb, lsa);
@@ -3244,6 +3253,9 @@ void ospf_maxage_lsa_remover(struct event *thread)
 
 					continue;
 				}
+				if (lsa->data->type == OSPF_ROUTER_LSA ||
+				    lsa->data->type == OSPF_NETWORK_LSA)
+					ospf_spf_intra_flush(ospf);
 				ospf_discard_from_db(ospf, lsa->lsdb, lsa);
 				ospf_lsdb_delete(lsa->lsdb, lsa);
 			} else {
@@ -291,64 +291,156 @@ void ospf_ls_req_event(struct ospf_neighbor *nbr)
 	event_add_event(master, ospf_ls_req_timer, nbr, 0, &nbr->t_ls_req);
 }
 
-/* Cyclic timer function.  Fist registered in ospf_nbr_new () in
-   ospf_neighbor.c  */
-void ospf_ls_upd_timer(struct event *thread)
+/* LSAs on the retransmission list of a neighbor that are due again */
+static struct list *ospf_ls_rxmt_due(struct ospf_neighbor *nbr)
 {
-	struct ospf_neighbor *nbr;
+	struct list *update;
+	struct ospf_lsdb *lsdb;
+	int i;
+	int retransmit_interval;
 
-	nbr = EVENT_ARG(thread);
-	nbr->t_ls_upd = NULL;
-
-	/* Send Link State Update. */
-	if (ospf_ls_retransmit_count(nbr) > 0) {
-		struct list *update;
-		struct ospf_lsdb *lsdb;
-		int i;
-		int retransmit_interval;
-
-		retransmit_interval =
-			OSPF_IF_PARAM(nbr->oi, retransmit_interval);
-
-		lsdb = &nbr->ls_rxmt;
-		update = list_new();
-
-		for (i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++) {
-			struct route_table *table = lsdb->type[i].db;
-			struct route_node *rn;
-
-			for (rn = route_top(table); rn; rn = route_next(rn)) {
-				struct ospf_lsa *lsa;
-
-				if ((lsa = rn->info) != NULL) {
-					/* Don't retransmit an LSA if we
-					  received it within
-					  the last RxmtInterval seconds - this
-					  is to allow the
-					  neighbour a chance to acknowledge the
-					  LSA as it may
-					  have ben just received before the
-					  retransmit timer
-					  fired.  This is a small tweak to what
-					  is in the RFC,
-					  but it will cut out out a lot of
-					  retransmit traffic
-					  - MAG */
-					if (monotime_since(&lsa->tv_recv, NULL)
-					    >= retransmit_interval * 1000000LL)
-						listnode_add(update, rn->info);
-				}
+	retransmit_interval = OSPF_IF_PARAM(nbr->oi, retransmit_interval);
+
+	lsdb = &nbr->ls_rxmt;
+	update = list_new();
+
+	for (i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++) {
+		struct route_table *table = lsdb->type[i].db;
+		struct route_node *rn;
+
+		for (rn = route_top(table); rn; rn = route_next(rn)) {
+			struct ospf_lsa *lsa;
+
+			if ((lsa = rn->info) != NULL) {
+				/* Don't retransmit an LSA if we received it
+				 * within the last RxmtInterval seconds - this
+				 * is to allow the neighbour a chance to
+				 * acknowledge the LSA as it may have ben just
+				 * received before the retransmit timer fired.
+				 * This is a small tweak to what is in the RFC,
+				 * but it will cut out out a lot of retransmit
+				 * traffic - MAG
+				 */
+				if (monotime_since(&lsa->tv_recv, NULL) >=
+				    retransmit_interval * 1000000LL)
+					listnode_add(update, rn->info);
 			}
 		}
+	}
 
-		if (listcount(update) > 0)
-			ospf_ls_upd_send(nbr, update, OSPF_SEND_PACKET_DIRECT,
-					 0);
-		list_delete(&update);
+	return update;
+}
+
+/*
+ * On a broadcast segment, an LSA due to several neighbors goes out once
+ * to the multicast address the flooding would use, rather than once to
+ * each of them. Neighbors that have it already see a duplicate and ack
+ * it. What is left on the neighbor lists is theirs alone.
+ */
+static struct list *ospf_ls_rxmt_share(struct ospf_neighbor **nbrs,
+				       struct list **updates,
+				       unsigned int count)
+{
+	struct list *shared = list_new();
+	struct listnode *node, *nnode;
+	struct ospf_lsa *lsa;
+	unsigned int i, j;
+	bool earlier, later;
+
+	for (i = 0; i < count; i++) {
+		for (ALL_LIST_ELEMENTS(updates[i], node, nnode, lsa)) {
+			earlier = later = false;
+			for (j = 0; j < count && !earlier; j++)
+				if (j != i &&
+				    ospf_ls_retransmit_lookup(nbrs[j], lsa) ==
+					    lsa) {
+					earlier = j < i;
+					later = j > i;
+				}
+			/* Shared by the first neighbor holding it */
+			if (!earlier && later)
+				listnode_add(shared, lsa);
+			if (earlier || later)
+				list_delete_node(updates[i], node);
+		}
+	}
+
+	return shared;
+}
+
+/*
+ * Cyclic timer function. Fist registered in ospf_nbr_new () in
+ * ospf_neighbor.c
+ *
+ * The neighbors of the interface due within half a retransmission
+ * interval are retransmitted to in the same round, and their timers
+ * restarted with the one that fired: a segment retransmits all at once,
+ * in as few packets as the LSAs fit in, instead of one neighbor at a
+ * time.
+ */
+void ospf_ls_upd_timer(struct event *thread)
+{
+	struct ospf_neighbor *fired, *nbr;
+	struct ospf_neighbor **nbrs;
+	struct ospf_interface *oi;
+	struct route_node *rn;
+	struct list **updates;
+	struct list *shared = NULL;
+	unsigned long window;
+	unsigned int count = 0, i;
+
+	fired = EVENT_ARG(thread);
+	fired->t_ls_upd = NULL;
+	oi = fired->oi;
+	window = OSPF_IF_PARAM(oi, retransmit_interval) * 1000 / 2;
+
+	nbrs = XCALLOC(MTYPE_TMP, (oi->nbrs->count + 1) * sizeof(*nbrs));
+	nbrs[count++] = fired;
+	for (rn = route_top(oi->nbrs); rn; rn = route_next(rn)) {
+		nbr = rn->info;
+		if (!nbr || nbr == fired || nbr == oi->nbr_self ||
+		    !nbr->t_ls_upd ||
+		    event_timer_remain_msec(nbr->t_ls_upd) > window)
+			continue;
+		EVENT_OFF(nbr->t_ls_upd);
+		nbrs[count++] = nbr;
+	}
+
+	updates = XCALLOC(MTYPE_TMP, count * sizeof(*updates));
+	for (i = 0; i < count; i++)
+		updates[i] = ospf_ls_retransmit_count(nbrs[i]) > 0
+				     ? ospf_ls_rxmt_due(nbrs[i])
+				     : list_new();
+
+	if (oi->type == OSPF_IFTYPE_BROADCAST && count > 1)
+		shared = ospf_ls_rxmt_share(nbrs, updates, count);
+
+	if (IS_DEBUG_OSPF_EVENT && count > 1)
+		zlog_debug("%s: [%s] retransmitting to %u neighbors, %u LSAs shared",
+			   __func__, IF_NAME(oi), count,
+			   shared ? listcount(shared) : 0);
+
+	for (i = 0; i < count; i++) {
+		nbr = nbrs[i];
+		if (listcount(updates[i]) > 0)
+			ospf_ls_upd_send(nbr, updates[i],
+					 OSPF_SEND_PACKET_DIRECT, 0);
+		list_delete(&updates[i]);
+
+		/* Set LS Update retransmission timer. */
+		OSPF_NSM_TIMER_ON(nbr->t_ls_upd, ospf_ls_upd_timer,
+				  nbr->v_ls_upd);
+	}
+
+	if (shared) {
+		if (listcount(shared) > 0)
+			ospf_ls_upd_send(fired, shared,
+					 OSPF_SEND_PACKET_INDIRECT, 0);
+		list_delete(&shared);
 	}
 
-	/* Set LS Update retransmission timer. */
-	OSPF_NSM_TIMER_ON(nbr->t_ls_upd, ospf_ls_upd_timer, nbr->v_ls_upd);
+	XFREE(MTYPE_TMP, updates);
+	XFREE(MTYPE_TMP, nbrs);
 }
 
 void ospf_ls_ack_timer(struct event *thread)
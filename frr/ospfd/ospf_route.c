@@ -101,6 +101,20 @@ void ospf_path_free(struct ospf_path *op)
 	XFREE(MTYPE_OSPF_PATH, op);
 }
 
+struct ospf_route *ospf_route_dup(struct ospf_route *or)
+{
+	struct ospf_route *new;
+	struct list *paths;
+
+	new = ospf_route_new();
+	paths = new->paths;
+	memcpy(new, or, sizeof(struct ospf_route));
+	new->paths = paths;
+	ospf_route_copy_nexthops(new, or->paths);
+
+	return new;
+}
+
 void ospf_route_delete(struct ospf *ospf, struct route_table *rt)
 {
 	struct route_node *rn;
@@ -133,6 +147,21 @@ void ospf_route_table_free(struct route_table *rt)
 	route_table_finish(rt);
 }
 
+struct route_table *ospf_route_table_dup(struct route_table *rt)
+{
+	struct route_table *new = route_table_init();
+	struct route_node *rn, *new_rn;
+	struct ospf_route * or ;
+
+	for (rn = route_top(rt); rn; rn = route_next(rn))
+		if ((or = rn->info) != NULL) {
+			new_rn = route_node_get(new, &rn->p);
+			new_rn->info = ospf_route_dup(or);
+		}
+
+	return new;
+}
+
 /* If a prefix exists in the new routing table, then return 1,
    otherwise return 0. Since the ZEBRA-RIB does an implicit
    withdraw, it is not necessary to send a delete, an add later
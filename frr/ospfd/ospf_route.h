@@ -123,6 +123,8 @@ extern struct ospf_route *ospf_route_new(void);
 extern void ospf_route_free(struct ospf_route *);
 extern void ospf_route_delete(struct ospf *, struct route_table *);
 extern void ospf_route_table_free(struct route_table *);
+extern struct ospf_route *ospf_route_dup(struct ospf_route *or);
+extern struct route_table *ospf_route_table_dup(struct route_table *rt);
 
 extern void ospf_route_install(struct ospf *, struct route_table *);
 extern void ospf_route_table_dump(struct route_table *);
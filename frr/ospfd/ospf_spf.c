@@ -1675,6 +1675,99 @@ void ospf_rtrs_free(struct route_table *rtrs)
 	route_table_finish(rtrs);
 }
 
+static struct route_table *ospf_rtrs_dup(struct route_table *rtrs)
+{
+	struct route_table *new = route_table_init();
+	struct route_node *rn, *new_rn;
+	struct list *or_list, *new_list;
+	struct ospf_route * or ;
+	struct listnode *node;
+
+	for (rn = route_top(rtrs); rn; rn = route_next(rn))
+		if ((or_list = rn->info) != NULL) {
+			new_list = list_new();
+			for (ALL_LIST_ELEMENTS_RO(or_list, node, or))
+				listnode_add(new_list, ospf_route_dup(or));
+
+			new_rn = route_node_get(new, &rn->p);
+			new_rn->info = new_list;
+		}
+
+	return new;
+}
+
+/*
+ * Forget the intra-area results kept for partial route calculation, so that
+ * the next SPF run is a full one. Needed whenever a router- or network-LSA
+ * goes away, since the routes point at its data.
+ */
+void ospf_spf_intra_flush(struct ospf *ospf)
+{
+	if (ospf->intra_table) {
+		ospf_route_table_free(ospf->intra_table);
+		ospf->intra_table = NULL;
+	}
+	if (ospf->intra_rtrs) {
+		ospf_rtrs_free(ospf->intra_rtrs);
+		ospf->intra_rtrs = NULL;
+	}
+}
+
+static void ospf_spf_intra_move_table(struct route_table *rt, bool rtrs,
+				      struct lsa_header *from,
+				      struct lsa_header *to)
+{
+	struct route_node *rn;
+	struct ospf_route * or ;
+	struct listnode *node;
+
+	for (rn = route_top(rt); rn; rn = route_next(rn)) {
+		if (!rn->info)
+			continue;
+		if (!rtrs) {
+			or = rn->info;
+			if (or->u.std.origin == from)
+				or->u.std.origin = to;
+			continue;
+		}
+		for (ALL_LIST_ELEMENTS_RO((struct list *)rn->info, node, or))
+			if (or->u.std.origin == from)
+				or->u.std.origin = to;
+	}
+}
+
+/*
+ * A router- or network-LSA was refreshed without a change in contents: the
+ * kept routes stay valid but must follow the new instance.
+ */
+void ospf_spf_intra_move(struct ospf *ospf, struct lsa_header *from,
+			 struct lsa_header *to)
+{
+	if (ospf->intra_table)
+		ospf_spf_intra_move_table(ospf->intra_table, false, from, to);
+	if (ospf->intra_rtrs)
+		ospf_spf_intra_move_table(ospf->intra_rtrs, true, from, to);
+}
+
+/*
+ * RFC 2328 16.5: when only summary-LSAs have changed, the shortest-path
+ * trees are as they were and only the inter-area routes need recalculating.
+ */
+static bool ospf_spf_partial(struct ospf *ospf)
+{
+	unsigned int prefix_only = (1 << SPF_FLAG_SUMMARY_LSA_INSTALL) |
+				   (1 << SPF_FLAG_ASBR_SUMMARY_LSA_INSTALL);
+	bool opaque = CHECK_FLAG(ospf->opaque, OPAQUE_OPERATION_READY_BIT);
+
+	if (!ospf->intra_table || !ospf->intra_rtrs)
+		return false;
+	/* Router reachability is only tracked by full runs */
+	if (opaque != (ospf->all_rtrs != NULL))
+		return false;
+
+	return spf_reason_flags && !(spf_reason_flags & ~prefix_only);
+}
+
 void ospf_spf_cleanup(struct vertex *spf, struct list *vertex_list)
 {
 	/*
@@ -1851,27 +1944,47 @@ static void ospf_spf_calculate_schedule_worker(struct event *thread)
 	unsigned long ia_time, prune_time, rt_time;
 	unsigned long abr_time, total_spf_time, spf_time;
 	char rbuf[32]; /* reason_buf */
+	bool partial;
 
 	if (IS_DEBUG_OSPF_EVENT)
 		zlog_debug("SPF: Timer (SPF calculation expire)");
 
 	ospf->t_spf_calc = NULL;
 
-	ospf_vl_unapprove(ospf);
+	partial = ospf_spf_partial(ospf);
 
-	/* Execute SPF for each area including backbone, see RFC 2328 16.1. */
 	monotime(&spf_start_time);
-	new_table = route_table_init(); /* routing table */
-	new_rtrs = route_table_init();  /* ABR/ASBR routing table */
+	if (partial) {
+		/* Start over from the intra-area routes of the last full run */
+		new_table = ospf_route_table_dup(ospf->intra_table);
+		new_rtrs = ospf_rtrs_dup(ospf->intra_rtrs);
+		ospf->spf_partial++;
+		monotime(&ospf->ts_spf);
+	} else {
+		ospf_vl_unapprove(ospf);
 
-	/* If we have opaque enabled then track all router reachability */
-	if (CHECK_FLAG(ospf->opaque, OPAQUE_OPERATION_READY_BIT))
-		all_rtrs = route_table_init();
+		/*
+		 * Execute SPF for each area including backbone, see RFC 2328
+		 * 16.1.
+		 */
+		new_table = route_table_init(); /* routing table */
+		new_rtrs = route_table_init();  /* ABR/ASBR routing table */
+
+		/* If we have opaque enabled then track all router reachability
+		 */
+		if (CHECK_FLAG(ospf->opaque, OPAQUE_OPERATION_READY_BIT))
+			all_rtrs = route_table_init();
 
-	ospf_spf_calculate_areas(ospf, new_table, all_rtrs, new_rtrs);
+		ospf_spf_calculate_areas(ospf, new_table, all_rtrs, new_rtrs);
+
+		ospf_spf_intra_flush(ospf);
+		ospf->intra_table = ospf_route_table_dup(new_table);
+		ospf->intra_rtrs = ospf_rtrs_dup(new_rtrs);
+	}
 	spf_time = monotime_since(&spf_start_time, NULL);
 
-	ospf_vl_shut_unapproved(ospf);
+	if (!partial)
+		ospf_vl_shut_unapproved(ospf);
 
 	/* Calculate inter-area routes, see RFC 2328 16.2. */
 	monotime(&start_time);
@@ -1907,18 +2020,22 @@ static void ospf_spf_calculate_schedule_worker(struct event *thread)
 	ospf_route_install(ospf, new_table);
 	rt_time = monotime_since(&start_time, NULL);
 
-	/* Free old all routers routing table */
-	if (ospf->oall_rtrs) {
-		ospf_rtrs_free(ospf->oall_rtrs);
-		ospf->oall_rtrs = NULL;
-	}
+	/* Router reachability is unchanged by a partial run */
+	if (!partial) {
+		/* Free old all routers routing table */
+		if (ospf->oall_rtrs) {
+			ospf_rtrs_free(ospf->oall_rtrs);
+			ospf->oall_rtrs = NULL;
+		}
 
-	/* Update all routers routing table */
-	ospf->oall_rtrs = ospf->all_rtrs;
-	ospf->all_rtrs = all_rtrs;
+		/* Update all routers routing table */
+		ospf->oall_rtrs = ospf->all_rtrs;
+		ospf->all_rtrs = all_rtrs;
 #ifdef SUPPORT_OSPF_API
-	ospf_apiserver_notify_reachable(ospf->oall_rtrs, ospf->all_rtrs);
+		ospf_apiserver_notify_reachable(ospf->oall_rtrs,
+						ospf->all_rtrs);
 #endif
+	}
 
 	/* Free old ABR/ASBR routing table */
 	if (ospf->old_rtrs) {
@@ -1972,7 +2089,8 @@ static void ospf_spf_calculate_schedule_worker(struct event *thread)
 	}
 
 	if (IS_DEBUG_OSPF_EVENT) {
-		zlog_info("SPF Processing Time(usecs): %ld", total_spf_time);
+		zlog_info("SPF Processing Time(usecs): %ld%s", total_spf_time,
+			  partial ? " (partial)" : "");
 		zlog_info("            SPF Time: %ld", spf_time);
 		zlog_info("           InterArea: %ld", ia_time);
 		zlog_info("               Prune: %ld", prune_time);
@@ -2054,6 +2172,8 @@ void ospf_restart_spf(struct ospf *ospf)
 	if (IS_DEBUG_OSPF_EVENT)
 		zlog_debug("%s: Restart SPF.", __func__);
 
+	ospf_spf_intra_flush(ospf);
+
 	/* Handling inter area and intra area routes*/
 	if (ospf->new_table) {
 		ospf_route_delete(ospf, ospf->new_table);
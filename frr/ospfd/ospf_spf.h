@@ -73,6 +73,9 @@ extern void ospf_spf_calculate_areas(struct ospf *ospf,
 				     struct route_table *all_rtrs,
 				     struct route_table *new_rtrs);
 extern void ospf_rtrs_free(struct route_table *);
+extern void ospf_spf_intra_flush(struct ospf *ospf);
+extern void ospf_spf_intra_move(struct ospf *ospf, struct lsa_header *from,
+				struct lsa_header *to);
 extern void ospf_spf_cleanup(struct vertex *spf, struct list *vertex_list);
 extern void ospf_spf_copy(struct vertex *vertex, struct list *vertex_list);
 extern void ospf_spf_remove_resource(struct vertex *vertex,
@@ -3274,6 +3274,8 @@ static int show_ip_ospf_common(struct vty *vty, struct ospf *ospf,
 				     + (ospf->ts_spf_duration.tv_usec / 1000);
 			json_object_int_add(json_vrf, "spfLastDurationMsecs",
 					    time_store);
+			json_object_int_add(json_vrf, "spfPartialRuns",
+					    ospf->spf_partial);
 		} else
 			json_object_boolean_true_add(json_vrf, "spfHasNotRun");
 	} else {
@@ -3286,6 +3288,8 @@ static int show_ip_ospf_common(struct vty *vty, struct ospf *ospf,
 			vty_out(vty, " Last SPF duration %s\n",
 				ospf_timeval_dump(&ospf->ts_spf_duration,
 						  timebuf, sizeof(timebuf)));
+			vty_out(vty, " Partial route calculations %u\n",
+				ospf->spf_partial);
 		} else
 			vty_out(vty, "has not been run\n");
 	}
@@ -838,6 +838,7 @@ static void ospf_finish_final(struct ospf *ospf)
 		ospf_rtrs_free(ospf->old_rtrs);
 	if (ospf->new_rtrs)
 		ospf_rtrs_free(ospf->new_rtrs);
+	ospf_spf_intra_flush(ospf);
 	if (ospf->new_external_route) {
 		if (!ospf->gr_info.prepare_in_progress)
 			ospf_route_delete(ospf, ospf->new_external_route);
@@ -994,6 +995,8 @@ void ospf_area_lsdb_discard_delete(struct ospf_area *area)
 	struct route_node *rn;
 	struct ospf_lsa *lsa;
 
+	ospf_spf_intra_flush(area->ospf);
+
 	LSDB_LOOP (ROUTER_LSDB(area), rn, lsa)
 		ospf_discard_from_db(area->ospf, area->lsdb, lsa);
 	LSDB_LOOP (NETWORK_LSDB(area), rn, lsa)
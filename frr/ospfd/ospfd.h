@@ -251,6 +251,11 @@ struct ospf {
 	struct route_table *old_rtrs; /* Old ABR/ASBR RT. */
 	struct route_table *new_rtrs; /* New ABR/ASBR RT. */
 
+	/* Intra-area results of the last full SPF, reused by partial runs. */
+	struct route_table *intra_table;
+	struct route_table *intra_rtrs;
+	uint32_t spf_partial; /* Partial route calculation count. */
+
 	struct route_table *new_external_route; /* New External Route. */
 	struct route_table *old_external_route; /* Old External Route. */
 
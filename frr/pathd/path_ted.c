@@ -14,11 +14,15 @@
 #include "log.h"
 #include "command.h"
 #include "prefix.h"
+#include "stream.h"
+#include "link_state.h"
+#include "cspf.h"
 #include <lib/json.h>
 
 #include "pathd.h"
 #include "pathd/path_errors.h"
 #include "pathd/path_ted.h"
+#include "pathd/path_zebra.h"
 
 #include "pathd/path_ted_clippy.c"
 
@@ -32,6 +36,12 @@ static void path_ted_timer_handler_sync(struct event *thread);
 static void path_ted_timer_handler_refresh(struct event *thread);
 static int path_ted_cli_debug_config_write(struct vty *vty);
 static int path_ted_cli_debug_set_all(uint32_t flags, bool set);
+static void path_ted_timer_handler_compute(struct event *thread);
+static void path_ted_compute_edge_free(void *arg);
+static void path_ted_compute_note(struct ls_message *msg);
+static void path_ted_compute_withdraw_all(void);
+
+DEFINE_MTYPE_STATIC(PATHD, PATH_TED_COMPUTE, "PATHD TED changed edge");
 
 extern struct zclient *zclient;
 
@@ -46,6 +56,9 @@ void path_ted_init(struct event_loop *master)
 	ted_state_g.main = master;
 	ted_state_g.link_state_delay_interval = TIMER_RETRY_DELAY;
 	ted_state_g.segment_list_refresh_interval = TIMER_RETRY_DELAY;
+	ted_state_g.compute_hold_down = TED_COMPUTE_HOLD_DOWN;
+	ted_state_g.compute_edges = list_new();
+	ted_state_g.compute_edges->del = path_ted_compute_edge_free;
 	path_ted_register_vty();
 	path_ted_segment_list_refresh();
 }
@@ -58,6 +71,8 @@ uint32_t path_ted_teardown(void)
 	ls_ted_del_all(&ted_state_g.ted);
 	path_ted_timer_sync_cancel();
 	path_ted_timer_refresh_cancel();
+	event_cancel(&ted_state_g.t_compute);
+	list_delete(&ted_state_g.compute_edges);
 	return 0;
 }
 
@@ -180,6 +195,8 @@ uint32_t path_ted_rcvd_message(struct ls_message *msg)
 	if (path_ted_get_current_igp(msg->data.node->adv.origin))
 		return 1;
 
+	path_ted_compute_note(msg);
+
 	switch (msg->type) {
 	case LS_MSG_TYPE_NODE:
 		ls_msg2vertex(ted_state_g.ted, msg, true /*hard delete*/);
@@ -326,6 +343,454 @@ uint32_t path_ted_query_type_e(struct prefix *prefix, uint32_t iface_id)
 	return sid;
 }
 
+/*
+ * Local computation of the dynamic candidate paths
+ */
+
+static void path_ted_compute_edge_free(void *arg)
+{
+	XFREE(MTYPE_PATH_TED_COMPUTE, arg);
+}
+
+static bool path_ted_compute_owns(const struct srte_segment_list *segment_list)
+{
+	return segment_list && segment_list->protocol_origin == SRTE_ORIGIN_LOCAL
+	       && strmatch(segment_list->originator, TED_COMPUTE_ORIGINATOR);
+}
+
+/* Dynamic candidates of the configuration, unless a PCE took them over */
+static bool path_ted_compute_applies(const struct srte_candidate *candidate)
+{
+	struct srte_segment_list *segment_list = candidate->lsp->segment_list;
+
+	if (candidate->type != SRTE_CANDIDATE_TYPE_DYNAMIC
+	    || candidate->protocol_origin != SRTE_ORIGIN_LOCAL)
+		return false;
+
+	return !segment_list || path_ted_compute_owns(segment_list);
+}
+
+/* Arm the hold-down, leaving it alone if it already runs */
+static void path_ted_compute_schedule(void)
+{
+	if (!ted_state_g.compute || !ted_state_g.enabled)
+		return;
+
+	event_add_timer(ted_state_g.main, path_ted_timer_handler_compute,
+			&ted_state_g, ted_state_g.compute_hold_down,
+			&ted_state_g.t_compute);
+}
+
+void path_ted_compute_schedule_all(void)
+{
+	ted_state_g.compute_all = true;
+	path_ted_compute_schedule();
+}
+
+void path_ted_compute_candidate_changed(struct srte_candidate *candidate)
+{
+	if (!path_ted_compute_applies(candidate))
+		return;
+
+	SET_FLAG(candidate->flags, F_CANDIDATE_COMPUTE);
+	path_ted_compute_schedule();
+}
+
+/* Drop the computed segment list of the candidate, true if it had one */
+static bool path_ted_compute_withdraw(struct srte_candidate *candidate)
+{
+	struct srte_segment_list *segment_list = candidate->lsp->segment_list;
+
+	if (!path_ted_compute_owns(segment_list))
+		return false;
+
+	srte_segment_list_del(segment_list);
+	candidate->lsp->segment_list = NULL;
+	return true;
+}
+
+void path_ted_compute_candidate_del(struct srte_candidate *candidate)
+{
+	path_ted_compute_withdraw(candidate);
+}
+
+static void path_ted_compute_withdraw_all(void)
+{
+	struct srte_policy *policy;
+	struct srte_candidate *candidate;
+	bool changed = false;
+
+	event_cancel(&ted_state_g.t_compute);
+	ted_state_g.compute_all = false;
+	list_delete_all_node(ted_state_g.compute_edges);
+
+	RB_FOREACH (policy, srte_policy_head, &srte_policies)
+		RB_FOREACH (candidate, srte_candidate_head,
+			    &policy->candidate_paths)
+			if (path_ted_compute_withdraw(candidate))
+				changed = true;
+
+	if (changed)
+		srte_apply_changes();
+}
+
+/*
+ * True if the new attributes of an edge make it no better than the old ones
+ * for any computation: then the paths that do not go through the edge stay
+ * the shortest ones. The anomalous flag sits above the delay value, so that
+ * an anomalous delay compares as a larger one.
+ */
+static bool path_ted_compute_attr_worse(const struct ls_attributes *old,
+					const struct ls_attributes *new)
+{
+	if (old->flags != new->flags)
+		return false;
+
+	return new->metric >= old->metric
+	       && new->standard.te_metric >= old->standard.te_metric
+	       && new->extended.delay >= old->extended.delay
+	       && new->extended.min_delay >= old->extended.min_delay;
+}
+
+static void path_ted_compute_note_edge(const struct ls_edge_key *key)
+{
+	struct ls_edge_key *changed;
+	struct listnode *node;
+
+	for (ALL_LIST_ELEMENTS_RO(ted_state_g.compute_edges, node, changed))
+		if (!memcmp(changed, key, sizeof(*key)))
+			return;
+
+	changed = XMALLOC(MTYPE_PATH_TED_COMPUTE, sizeof(*changed));
+	memcpy(changed, key, sizeof(*changed));
+	listnode_add(ted_state_g.compute_edges, changed);
+}
+
+/*
+ * Sort out what a message changes for the computed paths before it reaches
+ * the TED: an edge that only gets worse invalidates the paths through it,
+ * anything else may shorten any path.
+ */
+static void path_ted_compute_note(struct ls_message *msg)
+{
+	struct ls_vertex *vertex;
+	struct ls_edge *edge;
+	struct ls_subnet *subnet;
+
+	if (!ted_state_g.compute || ted_state_g.compute_all)
+		return;
+
+	switch (msg->type) {
+	case LS_MSG_TYPE_NODE:
+		vertex = ls_find_vertex_by_id(ted_state_g.ted,
+					      msg->data.node->adv);
+		if (vertex && msg->event != LS_MSG_EVENT_DELETE
+		    && ls_node_same(vertex->node, msg->data.node))
+			return;
+		break;
+
+	case LS_MSG_TYPE_ATTRIBUTES:
+		edge = ls_find_edge_by_source(ted_state_g.ted, msg->data.attr);
+		if (!edge)
+			break;
+		if (msg->event == LS_MSG_EVENT_DELETE) {
+			path_ted_compute_note_edge(&edge->key);
+			path_ted_compute_schedule();
+			return;
+		}
+		if (ls_attributes_same(edge->attributes, msg->data.attr))
+			return;
+		if (path_ted_compute_attr_worse(edge->attributes,
+						msg->data.attr)) {
+			path_ted_compute_note_edge(&edge->key);
+			path_ted_compute_schedule();
+			return;
+		}
+		break;
+
+	case LS_MSG_TYPE_PREFIX:
+		subnet = ls_find_subnet(ted_state_g.ted,
+					&msg->data.prefix->pref);
+		if (subnet && msg->event != LS_MSG_EVENT_DELETE
+		    && ls_prefix_same(subnet->ls_pref, msg->data.prefix))
+			return;
+		break;
+
+	default:
+		return;
+	}
+
+	path_ted_compute_schedule_all();
+}
+
+/* True if the computed path of the candidate uses a changed edge */
+static bool path_ted_compute_stale(const struct srte_candidate *candidate)
+{
+	struct srte_segment_entry *segment;
+	struct ls_edge_key *key;
+	struct listnode *node;
+	const struct ipaddr *local;
+
+	RB_FOREACH (segment, srte_segment_entry_head,
+		    &candidate->lsp->segment_list->segments) {
+		local = &segment->nai_local_addr;
+		/* Don't know which edge it is: take it as changed */
+		if (local->ipa_type == IPADDR_NONE)
+			return true;
+		for (ALL_LIST_ELEMENTS_RO(ted_state_g.compute_edges, node,
+					  key)) {
+			if (key->family == AF_INET && local->ipa_type == IPADDR_V4
+			    && IPV4_ADDR_SAME(&key->k.addr, &local->ipaddr_v4))
+				return true;
+			if (key->family == AF_INET6
+			    && local->ipa_type == IPADDR_V6
+			    && IPV6_ADDR_SAME(&key->k.addr6, &local->ipaddr_v6))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * The unbounded metric is the one to minimise, the delay first, the IGP
+ * metric if there is none. Bounds apply to the delay and to the minimised
+ * metric.
+ */
+static void path_ted_compute_constraints(const struct srte_candidate *candidate,
+					 struct constraints *csts)
+{
+	const struct srte_metric *igp =
+		&candidate->metrics[SRTE_CANDIDATE_METRIC_TYPE_IGP - 1];
+	const struct srte_metric *te =
+		&candidate->metrics[SRTE_CANDIDATE_METRIC_TYPE_TE - 1];
+	const struct srte_metric *pd =
+		&candidate->metrics[SRTE_CANDIDATE_METRIC_TYPE_PD - 1];
+	const struct srte_metric *bound = NULL;
+
+	memset(csts, 0, sizeof(*csts));
+	csts->type = SR_TE;
+	csts->cost = MAX_COST;
+
+	if (CHECK_FLAG(pd->flags, F_METRIC_IS_DEFINED)
+	    && !CHECK_FLAG(pd->flags, F_METRIC_IS_BOUND))
+		csts->ctype = CSPF_DELAY;
+	else if (CHECK_FLAG(te->flags, F_METRIC_IS_DEFINED)
+		 && !CHECK_FLAG(te->flags, F_METRIC_IS_BOUND)) {
+		csts->ctype = CSPF_TE_METRIC;
+		bound = te;
+	} else {
+		csts->ctype = CSPF_METRIC;
+		bound = igp;
+	}
+
+	if (CHECK_FLAG(pd->flags, F_METRIC_IS_DEFINED)
+	    && CHECK_FLAG(pd->flags, F_METRIC_IS_BOUND))
+		csts->delay = MIN(pd->value, TE_EXT_MASK);
+	if (bound && CHECK_FLAG(bound->flags, F_METRIC_IS_DEFINED)
+	    && CHECK_FLAG(bound->flags, F_METRIC_IS_BOUND))
+		csts->cost = bound->value;
+}
+
+static struct c_path *path_ted_compute_path(struct srte_candidate *candidate)
+{
+	struct srte_policy *policy = candidate->policy;
+	struct constraints csts;
+	struct cspf *algo = NULL;
+	struct c_path *path;
+	struct in_addr src4;
+	struct in6_addr src6;
+
+	path_ted_compute_constraints(candidate, &csts);
+
+	switch (policy->endpoint.ipa_type) {
+	case IPADDR_V4:
+		if (get_ipv4_router_id(&src4))
+			algo = cspf_init_v4(NULL, ted_state_g.ted, src4,
+					    policy->endpoint.ipaddr_v4, &csts);
+		break;
+	case IPADDR_V6:
+		if (get_ipv6_router_id(&src6))
+			algo = cspf_init_v6(NULL, ted_state_g.ted, src6,
+					    policy->endpoint.ipaddr_v6, &csts);
+		break;
+	case IPADDR_NONE:
+		break;
+	}
+	if (!algo)
+		return NULL;
+
+	path = compute_p2p_path(algo, ted_state_g.ted);
+	cspf_del(algo);
+	if (path && path->status != SUCCESS) {
+		cpath_del(path);
+		path = NULL;
+	}
+
+	return path;
+}
+
+static mpls_label_t path_ted_compute_sid(const struct ls_edge *edge,
+					 uint8_t family)
+{
+	return edge->attributes
+		->adj_sid[family == AF_INET ? ADJ_PRI_IPV4 : ADJ_PRI_IPV6]
+		.sid;
+}
+
+/* True if the segment list already holds the Adj-SIDs of the path */
+static bool path_ted_compute_same(const struct srte_segment_list *segment_list,
+				  const struct c_path *path, uint8_t family)
+{
+	struct srte_segment_entry *segment;
+	struct listnode *node;
+	struct ls_edge *edge;
+
+	if (!segment_list)
+		return false;
+
+	node = listhead(path->edges);
+	RB_FOREACH (segment, srte_segment_entry_head, &segment_list->segments) {
+		if (!node)
+			return false;
+		edge = listgetdata(node);
+		if (segment->sid_value != path_ted_compute_sid(edge, family))
+			return false;
+		node = listnextnode(node);
+	}
+
+	return node == NULL;
+}
+
+/* A strict path: the Adj-SID of each edge, with the edge as NAI */
+static struct srte_segment_list *
+path_ted_compute_segment_list(struct srte_candidate *candidate,
+			      const struct c_path *path, uint8_t family)
+{
+	struct srte_policy *policy = candidate->policy;
+	struct srte_segment_list *segment_list;
+	struct srte_segment_entry *segment;
+	struct ls_attributes *attr;
+	struct ls_edge *edge;
+	struct listnode *node;
+	struct ipaddr local, remote;
+	char name[64];
+	uint32_t index = 10;
+
+	snprintfrr(name, sizeof(name), "%s-%u-%pIA-%u", TED_COMPUTE_ORIGINATOR,
+		   policy->color, &policy->endpoint, candidate->preference);
+	segment_list = srte_segment_list_add(name);
+	segment_list->protocol_origin = SRTE_ORIGIN_LOCAL;
+	strlcpy(segment_list->originator, TED_COMPUTE_ORIGINATOR,
+		sizeof(segment_list->originator));
+	SET_FLAG(segment_list->flags, F_SEGMENT_LIST_NEW);
+	SET_FLAG(segment_list->flags, F_SEGMENT_LIST_MODIFIED);
+
+	for (ALL_LIST_ELEMENTS_RO(path->edges, node, edge)) {
+		attr = edge->attributes;
+		segment = srte_segment_entry_add(segment_list, index);
+		segment->sid_value = path_ted_compute_sid(edge, family);
+		index += 10;
+
+		if (family == AF_INET
+		    && CHECK_FLAG(attr->flags, LS_ATTR_LOCAL_ADDR)
+		    && CHECK_FLAG(attr->flags, LS_ATTR_NEIGH_ADDR)) {
+			SET_IPADDR_V4(&local);
+			local.ipaddr_v4 = attr->standard.local;
+			SET_IPADDR_V4(&remote);
+			remote.ipaddr_v4 = attr->standard.remote;
+			srte_segment_entry_set_nai(
+				segment, SRTE_SEGMENT_NAI_TYPE_IPV4_ADJACENCY,
+				&local, 0, &remote, 0, 0, 0);
+		} else if (family == AF_INET6
+			   && CHECK_FLAG(attr->flags, LS_ATTR_LOCAL_ADDR6)
+			   && CHECK_FLAG(attr->flags, LS_ATTR_NEIGH_ADDR6)) {
+			SET_IPADDR_V6(&local);
+			local.ipaddr_v6 = attr->standard.local6;
+			SET_IPADDR_V6(&remote);
+			remote.ipaddr_v6 = attr->standard.remote6;
+			srte_segment_entry_set_nai(
+				segment, SRTE_SEGMENT_NAI_TYPE_IPV6_ADJACENCY,
+				&local, 0, &remote, 0, 0, 0);
+		}
+	}
+
+	return segment_list;
+}
+
+/* (Re)compute the candidate, true if its segment list changed */
+static bool path_ted_compute_candidate(struct srte_candidate *candidate)
+{
+	struct srte_policy *policy = candidate->policy;
+	uint8_t family = policy->endpoint.ipa_type == IPADDR_V4 ? AF_INET
+								 : AF_INET6;
+	struct c_path *path;
+	bool changed;
+
+	path = path_ted_compute_path(candidate);
+	if (!path) {
+		PATH_TED_DEBUG("%s: no path for candidate %s of policy %u %pIA",
+			       __func__, candidate->name, policy->color,
+			       &policy->endpoint);
+		return path_ted_compute_withdraw(candidate);
+	}
+
+	PATH_TED_DEBUG("%s: candidate %s of policy %u %pIA: %u hops, cost %u, delay %u",
+		       __func__, candidate->name, policy->color,
+		       &policy->endpoint, listcount(path->edges), path->weight,
+		       path->delay);
+
+	changed = !path_ted_compute_same(candidate->lsp->segment_list, path,
+					 family);
+	if (changed) {
+		path_ted_compute_withdraw(candidate);
+		candidate->lsp->segment_list =
+			path_ted_compute_segment_list(candidate, path, family);
+	}
+	cpath_del(path);
+
+	return changed;
+}
+
+/*
+ * End of the hold-down: compute the candidates that changed, and recompute
+ * the ones the TED changes may have made worse, all of them if a change may
+ * have shortened a path.
+ */
+void path_ted_timer_handler_compute(struct event *thread)
+{
+	struct srte_policy *policy;
+	struct srte_candidate *candidate;
+	bool changed = false;
+	bool compute;
+
+	if (!path_ted_is_initialized())
+		return;
+
+	RB_FOREACH (policy, srte_policy_head, &srte_policies) {
+		RB_FOREACH (candidate, srte_candidate_head,
+			    &policy->candidate_paths) {
+			if (!path_ted_compute_applies(candidate))
+				continue;
+
+			compute = CHECK_FLAG(candidate->flags,
+					     F_CANDIDATE_COMPUTE)
+				  || ted_state_g.compute_all
+				  || (candidate->lsp->segment_list
+				      && path_ted_compute_stale(candidate));
+			UNSET_FLAG(candidate->flags, F_CANDIDATE_COMPUTE);
+			if (compute && path_ted_compute_candidate(candidate))
+				changed = true;
+		}
+	}
+
+	ted_state_g.compute_all = false;
+	list_delete_all_node(ted_state_g.compute_edges);
+
+	if (changed)
+		srte_apply_changes();
+}
+
 DEFPY (debug_path_ted,
        debug_path_ted_cmd,
        "[no] debug pathd mpls-te",
@@ -362,6 +827,7 @@ DEFUN (path_ted_on,
 	ted_state_g.ted = path_ted_create_ted();
 	ted_state_g.enabled = true;
 	PATH_TED_DEBUG("%s: PATHD-TED: Enabled OFF -> ON.", __func__);
+	path_ted_compute_schedule_all();
 
 	return CMD_SUCCESS;
 }
@@ -380,7 +846,8 @@ DEFUN (no_path_ted,
 		return CMD_SUCCESS;
 	}
 
-	/* Remove TED */
+	/* Remove TED, and the paths computed over it */
+	path_ted_compute_withdraw_all();
 	ls_ted_del_all(&ted_state_g.ted);
 	ted_state_g.enabled = false;
 	PATH_TED_DEBUG("%s: PATHD-TED: ON -> OFF", __func__);
@@ -436,6 +903,47 @@ DEFUN (no_path_ted_import,
 	return CMD_SUCCESS;
 }
 
+/* clang-format off */
+DEFPY (path_ted_compute,
+       path_ted_compute_cmd,
+       "mpls-te compute dynamic [hold-down (1-600)$hold_down]",
+       "Configure the TE database (TED) functionality\n"
+       "Compute paths over the TED\n"
+       "The dynamic candidate paths\n"
+       "Batch the recomputations over a hold-down\n"
+       "Hold-down in seconds\n")
+/* clang-format on */
+{
+	ted_state_g.compute = true;
+	ted_state_g.compute_hold_down =
+		hold_down_str ? hold_down : TED_COMPUTE_HOLD_DOWN;
+	path_ted_compute_schedule_all();
+
+	return CMD_SUCCESS;
+}
+
+/* clang-format off */
+DEFPY (no_path_ted_compute,
+       no_path_ted_compute_cmd,
+       "no mpls-te compute dynamic [hold-down (1-600)]",
+       NO_STR
+       "Configure the TE database (TED) functionality\n"
+       "Compute paths over the TED\n"
+       "The dynamic candidate paths\n"
+       "Batch the recomputations over a hold-down\n"
+       "Hold-down in seconds\n")
+/* clang-format on */
+{
+	if (!ted_state_g.compute)
+		return CMD_SUCCESS;
+
+	ted_state_g.compute = false;
+	ted_state_g.compute_hold_down = TED_COMPUTE_HOLD_DOWN;
+	path_ted_compute_withdraw_all();
+
+	return CMD_SUCCESS;
+}
+
 /* clang-format off */
 DEFPY (show_pathd_ted_db,
        show_pathd_ted_db_cmd,
@@ -523,6 +1031,13 @@ uint32_t path_ted_config_write(struct vty *vty)
 			break;
 		}
 	}
+	if (ted_state_g.compute) {
+		vty_out(vty, "  mpls-te compute dynamic");
+		if (ted_state_g.compute_hold_down != TED_COMPUTE_HOLD_DOWN)
+			vty_out(vty, " hold-down %u",
+				ted_state_g.compute_hold_down);
+		vty_out(vty, "\n");
+	}
 	return 0;
 }
 
@@ -539,6 +1054,8 @@ static void path_ted_register_vty(void)
 	install_element(SR_TRAFFIC_ENG_NODE, &no_path_ted_cmd);
 	install_element(SR_TRAFFIC_ENG_NODE, &path_ted_import_cmd);
 	install_element(SR_TRAFFIC_ENG_NODE, &no_path_ted_import_cmd);
+	install_element(SR_TRAFFIC_ENG_NODE, &path_ted_compute_cmd);
+	install_element(SR_TRAFFIC_ENG_NODE, &no_path_ted_compute_cmd);
 
 	install_element(CONFIG_NODE, &debug_path_ted_cmd);
 	install_element(ENABLE_NODE, &debug_path_ted_cmd);
@@ -561,6 +1078,8 @@ static void path_ted_unregister_vty(void)
 	uninstall_element(SR_TRAFFIC_ENG_NODE, &no_path_ted_cmd);
 	uninstall_element(SR_TRAFFIC_ENG_NODE, &path_ted_import_cmd);
 	uninstall_element(SR_TRAFFIC_ENG_NODE, &no_path_ted_import_cmd);
+	uninstall_element(SR_TRAFFIC_ENG_NODE, &path_ted_compute_cmd);
+	uninstall_element(SR_TRAFFIC_ENG_NODE, &no_path_ted_compute_cmd);
 }
 
 /**
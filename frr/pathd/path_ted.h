@@ -33,6 +33,8 @@ extern struct ted_state ted_state_g;
 #define TED_KEY 1
 #define TED_ASN 1
 #define TED_NAME "PATHD TED"
+#define TED_COMPUTE_HOLD_DOWN 2 /* Default hold-down of the computations */
+#define TED_COMPUTE_ORIGINATOR "cspf" /* Originator of the computed paths */
 
 enum igp_import {
 	IMPORT_UNKNOWN = 0,
@@ -56,6 +58,15 @@ struct ted_state {
 	uint32_t link_state_delay_interval;
 	/* delay interval refresh in seconds */
 	uint32_t segment_list_refresh_interval;
+	/* Local computation of the dynamic candidate paths */
+	bool compute;
+	/* Hold-down in seconds batching the recomputations */
+	uint32_t compute_hold_down;
+	struct event *t_compute;
+	/* Some change since the last computation may shorten any path */
+	bool compute_all;
+	/* Keys of the edges that only got worse since then */
+	struct list *compute_edges;
 	struct debug dbg;
 };
 /* Debug flags. */
@@ -90,6 +101,17 @@ void path_ted_timer_sync_cancel(void);
 void path_ted_timer_refresh_cancel(void);
 int path_ted_segment_list_refresh(void);
 
+/*
+ * Local computation of the dynamic candidate paths over the TED: the
+ * candidate is (re)computed within the hold-down after it changed, and the
+ * TED changes are batched over the hold-down before the affected candidates
+ * are recomputed.
+ */
+struct srte_candidate;
+void path_ted_compute_candidate_changed(struct srte_candidate *candidate);
+void path_ted_compute_candidate_del(struct srte_candidate *candidate);
+void path_ted_compute_schedule_all(void);
+
 /* TED configuration functions */
 uint32_t path_ted_config_write(struct vty *vty);
 void path_ted_show_debugging(struct vty *vty);
@@ -152,6 +152,8 @@ static int path_zebra_router_id_update(ZAPI_CALLBACK_ARGS)
 		return 0;
 	}
 	zlog_info("%s Router Id updated for VRF %u: %s", family, vrf_id, buf);
+	/* The computed paths start from the router-id */
+	path_ted_compute_schedule_all();
 	return 0;
 }
 
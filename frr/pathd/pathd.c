@@ -657,8 +657,10 @@ void srte_policy_apply_changes(struct srte_policy *policy)
 			continue;
 		} else if (CHECK_FLAG(candidate->flags, F_CANDIDATE_NEW)) {
 			trigger_pathd_candidate_created(candidate);
+			path_ted_compute_candidate_changed(candidate);
 		} else if (CHECK_FLAG(candidate->flags, F_CANDIDATE_MODIFIED)) {
 			trigger_pathd_candidate_updated(candidate);
+			path_ted_compute_candidate_changed(candidate);
 		} else if (candidate->lsp->segment_list
 			   && CHECK_FLAG(candidate->lsp->segment_list->flags,
 					 F_SEGMENT_LIST_MODIFIED)) {
@@ -727,6 +729,8 @@ void srte_candidate_del(struct srte_candidate *candidate)
 	RB_REMOVE(srte_candidate_head, &srte_policy->candidate_paths,
 		  candidate);
 
+	path_ted_compute_candidate_del(candidate);
+
 	XFREE(MTYPE_PATH_SR_CANDIDATE, candidate->lsp);
 	XFREE(MTYPE_PATH_SR_CANDIDATE, candidate);
 }
@@ -297,6 +297,7 @@ struct srte_candidate {
 #define F_CANDIDATE_HAS_EXCLUDE_ANY 0x1000
 #define F_CANDIDATE_HAS_INCLUDE_ANY 0x2000
 #define F_CANDIDATE_HAS_INCLUDE_ALL 0x4000
+#define F_CANDIDATE_COMPUTE 0x8000
 
 	/* Metrics Configured Values */
 	struct srte_metric metrics[MAX_METRIC_TYPE];
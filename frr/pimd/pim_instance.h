@@ -129,6 +129,10 @@ struct pim_instance {
 	int64_t mroute_del_events;
 	int64_t mroute_del_last;
 
+	struct pim_mfc_queue_head mfc_queue;
+	struct pim_mfc_pending_head mfc_pending;
+	struct event *t_mfc_queue;
+
 	struct interface *regiface;
 
 	// List of static routes;
@@ -175,6 +179,10 @@ struct pim_instance {
 	uint64_t bsm_sent;
 	uint64_t bsm_dropped;
 
+	/* Upstreams with a triggered Join/Prune to send */
+	struct pim_jp_triggers_head jp_triggers;
+	struct event *t_jp_triggers;
+
 	/* If we need to rescan all our upstreams */
 	struct event *rpf_cache_refresher;
 	int64_t rpf_cache_refresh_requests;
@@ -17,6 +17,7 @@
 #include "pim_jp_agg.h"
 #include "pim_join.h"
 #include "pim_iface.h"
+#include "pim_zebra.h"
 
 void pim_jp_agg_group_list_free(struct pim_jp_agg_group *jag)
 {
@@ -320,18 +321,80 @@ void pim_jp_agg_switch_interface(struct pim_rpf *orpf, struct pim_rpf *nrpf,
 }
 
 
+/* Skip JP upstream messages if source is directly connected */
+static bool pim_jp_agg_single_upstream_skip(struct pim_rpf *rpf,
+					    struct pim_upstream *up)
+{
+	return !up || !rpf->source_nexthop.interface ||
+	       pim_if_connected_to_source(rpf->source_nexthop.interface,
+					  up->sg.src) ||
+	       if_is_loopback(rpf->source_nexthop.interface);
+}
+
+static void pim_jp_agg_triggers_send(struct event *t)
+{
+	struct pim_instance *pim = EVENT_ARG(t);
+	struct pim_iface_upstream_switch *pius;
+	struct pim_upstream *up;
+	struct pim_rpf rpf = {};
+
+	/* Sort them out per neighbor, as for an RPF change */
+	while ((up = pim_jp_triggers_pop(&pim->jp_triggers))) {
+		up->jp_trigger_pending = false;
+
+		rpf.source_nexthop.interface =
+			if_lookup_by_index(up->jp_trigger_ifindex,
+					   pim->vrf->vrf_id);
+		rpf.rpf_addr = up->jp_trigger_addr;
+		pius = pim_jp_agg_get_interface_upstream_switch_list(&rpf);
+		if (pius)
+			pim_jp_agg_add_group(pius->us, up, up->jp_trigger_join,
+					     NULL);
+	}
+
+	pim_zebra_update_all_interfaces(pim);
+}
+
 void pim_jp_agg_single_upstream_send(struct pim_rpf *rpf,
 				     struct pim_upstream *up, bool is_join)
+{
+	struct pim_instance *pim;
+
+	if (pim_jp_agg_single_upstream_skip(rpf, up))
+		return;
+
+	pim = up->pim;
+	if (up->jp_trigger_pending)
+		pim_jp_triggers_del(&pim->jp_triggers, up);
+
+	/* The last one triggered is what the neighbor is to be left with */
+	up->jp_trigger_pending = true;
+	up->jp_trigger_join = is_join;
+	up->jp_trigger_ifindex = rpf->source_nexthop.interface->ifindex;
+	up->jp_trigger_addr = rpf->rpf_addr;
+	pim_jp_triggers_add_tail(&pim->jp_triggers, up);
+
+	event_add_event(router->master, pim_jp_agg_triggers_send, pim, 0,
+			&pim->t_jp_triggers);
+}
+
+void pim_jp_agg_single_upstream_cancel(struct pim_upstream *up)
+{
+	if (!up->jp_trigger_pending)
+		return;
+
+	pim_jp_triggers_del(&up->pim->jp_triggers, up);
+	up->jp_trigger_pending = false;
+}
+
+void pim_jp_agg_single_upstream_send_now(struct pim_rpf *rpf,
+					 struct pim_upstream *up, bool is_join)
 {
 	struct list groups, sources;
 	struct pim_jp_agg_group jag;
 	struct pim_jp_sources js;
 
-	/* skip JP upstream messages if source is directly connected */
-	if (!up || !rpf->source_nexthop.interface ||
-		pim_if_connected_to_source(rpf->source_nexthop.interface,
-			up->sg.src) ||
-		if_is_loopback(rpf->source_nexthop.interface))
+	if (pim_jp_agg_single_upstream_skip(rpf, up))
 		return;
 
 	memset(&groups, 0, sizeof(groups));
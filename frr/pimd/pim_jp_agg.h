@@ -35,6 +35,18 @@ void pim_jp_agg_add_group(struct list *group, struct pim_upstream *up,
 void pim_jp_agg_switch_interface(struct pim_rpf *orpf, struct pim_rpf *nrpf,
 				 struct pim_upstream *up);
 
+/*
+ * Triggered Join/Prune of up: queued, and sent along with the others
+ * triggered for the same neighbor once the current event is done, packed
+ * into as few messages as the MTU allows. up must not go before then,
+ * or call pim_jp_agg_single_upstream_cancel() first.
+ */
 void pim_jp_agg_single_upstream_send(struct pim_rpf *rpf,
 				     struct pim_upstream *up, bool is_join);
+/* Forget the queued Join/Prune of up, for one being deleted */
+void pim_jp_agg_single_upstream_cancel(struct pim_upstream *up);
+/* Send a Join/Prune of up right away, in a message of its own */
+void pim_jp_agg_single_upstream_send_now(struct pim_rpf *rpf,
+					 struct pim_upstream *up,
+					 bool is_join);
 #endif
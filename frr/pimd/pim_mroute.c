@@ -33,6 +33,39 @@
 #include "pim_vxlan.h"
 #include "pim_msg.h"
 
+DEFINE_MTYPE_STATIC(PIMD, PIM_MFC_OP, "PIM queued MFC change");
+
+/* MFC changes handed to the kernel per run of the queue */
+#define PIM_MFC_QUEUE_BATCH 256
+
+struct pim_mfc_op {
+	struct pim_mfc_queue_item qitem;
+	struct pim_mfc_pending_item hitem;
+
+	pim_sgaddr sg;
+	bool add;
+	/* Add through pimreg as IIF first, see pim_mroute_add() */
+	bool via_pimreg;
+	/* Added while not in the kernel, so a delete just drops it */
+	bool fresh;
+	pim_mfcctl mfc;
+};
+
+static int pim_mfc_op_cmp(const struct pim_mfc_op *a,
+			  const struct pim_mfc_op *b)
+{
+	return pim_sgaddr_cmp(a->sg, b->sg);
+}
+
+static uint32_t pim_mfc_op_hash(const struct pim_mfc_op *op)
+{
+	return pim_sgaddr_hash(op->sg, 0);
+}
+
+DECLARE_DLIST(pim_mfc_queue, struct pim_mfc_op, qitem);
+DECLARE_HASH(pim_mfc_pending, struct pim_mfc_op, hitem, pim_mfc_op_cmp,
+	     pim_mfc_op_hash);
+
 static void mroute_read_on(struct pim_instance *pim);
 static int pim_upstream_mroute_update(struct channel_oil *c_oil,
 				      const char *name);
@@ -818,10 +851,31 @@ static void mroute_read_off(struct pim_instance *pim)
 	EVENT_OFF(pim->thread);
 }
 
+static void pim_mroute_mfc_init(struct pim_instance *pim)
+{
+	pim_mfc_queue_init(&pim->mfc_queue);
+	pim_mfc_pending_init(&pim->mfc_pending);
+}
+
+static void pim_mroute_mfc_fini(struct pim_instance *pim)
+{
+	struct pim_mfc_op *op;
+
+	EVENT_OFF(pim->t_mfc_queue);
+	while ((op = pim_mfc_queue_pop(&pim->mfc_queue))) {
+		pim_mfc_pending_del(&pim->mfc_pending, op);
+		XFREE(MTYPE_PIM_MFC_OP, op);
+	}
+	pim_mfc_pending_fini(&pim->mfc_pending);
+	pim_mfc_queue_fini(&pim->mfc_queue);
+}
+
 int pim_mroute_socket_enable(struct pim_instance *pim)
 {
 	int fd;
 
+	pim_mroute_mfc_init(pim);
+
 	frr_with_privs(&pimd_privs) {
 
 #if PIM_IPV == 4
@@ -889,6 +943,9 @@ int pim_mroute_socket_enable(struct pim_instance *pim)
 
 int pim_mroute_socket_disable(struct pim_instance *pim)
 {
+	/* The kernel drops the whole MFC along with the socket */
+	pim_mroute_mfc_fini(pim);
+
 	if (pim_mroute_set(pim, 0)) {
 		zlog_warn(
 			"Could not disable mroute on socket fd=%d: errno=%d: %s",
@@ -920,6 +977,9 @@ int pim_mroute_add_vif(struct interface *ifp, pim_addr ifaddr,
 	pim_vifctl vc;
 	int err;
 
+	/* Queued entries refer to the vifs as they are now */
+	pim_mroute_mfc_flush(pim_ifp->pim);
+
 	if (PIM_DEBUG_MROUTE)
 		zlog_debug("%s: Add Vif %d (%s[%s])", __func__,
 			   pim_ifp->mroute_vif_index, ifp->name,
@@ -974,6 +1034,8 @@ int pim_mroute_del_vif(struct interface *ifp)
 	pim_vifctl vc;
 	int err;
 
+	pim_mroute_mfc_flush(pim_ifp->pim);
+
 	if (PIM_DEBUG_MROUTE)
 		zlog_debug("%s: Del Vif %d (%s[%s])", __func__,
 			   pim_ifp->mroute_vif_index, ifp->name,
@@ -1058,6 +1120,128 @@ static inline void pim_mroute_copy(struct channel_oil *out,
 	}
 }
 
+#if PIM_IPV == 4
+#define pim_mfc_parent(mfc) ((mfc)->mfcc_parent)
+#else
+#define pim_mfc_parent(mfc) ((mfc)->mf6cc_parent)
+#endif
+
+static bool pim_mfc_op_apply(struct pim_instance *pim, struct pim_mfc_op *op)
+{
+	unsigned int parent;
+	int err;
+
+	if (!op->add) {
+		err = setsockopt(pim->mroute_socket, PIM_IPPROTO, MRT_DEL_MFC,
+				 &op->mfc, sizeof(op->mfc));
+		if (err && PIM_DEBUG_MROUTE)
+			zlog_warn(
+				"%s: failure: setsockopt(fd=%d,PIM_IPPROTO,MRT_DEL_MFC) for %pSG: errno=%d: %s",
+				__func__, pim->mroute_socket, &op->sg, errno,
+				safe_strerror(errno));
+		return !err;
+	}
+
+	parent = pim_mfc_parent(&op->mfc);
+	if (op->via_pimreg)
+		pim_mfc_parent(&op->mfc) = 0;
+
+	/* For IPv6 MRT_ADD_MFC is defined to MRT6_ADD_MFC */
+	err = setsockopt(pim->mroute_socket, PIM_IPPROTO, MRT_ADD_MFC,
+			 &op->mfc, sizeof(op->mfc));
+	if (!err && op->via_pimreg) {
+		pim_mfc_parent(&op->mfc) = parent;
+		err = setsockopt(pim->mroute_socket, PIM_IPPROTO, MRT_ADD_MFC,
+				 &op->mfc, sizeof(op->mfc));
+	}
+
+	if (err) {
+		zlog_warn(
+			"%s: failure: setsockopt(fd=%d,PIM_IPPROTO,MRT_ADD_MFC) for %pSG: errno=%d: %s",
+			__func__, pim->mroute_socket, &op->sg, errno,
+			safe_strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Hand up to limit queued changes to the kernel, oldest first.  An add the
+ * kernel refused leaves the channel oil uninstalled, as it was before the
+ * changes were queued, so the next update tries again.
+ */
+static void pim_mfc_queue_run(struct pim_instance *pim, unsigned int limit)
+{
+	struct channel_oil *c_oil;
+	struct pim_mfc_op *op;
+
+	while (limit-- && (op = pim_mfc_queue_pop(&pim->mfc_queue))) {
+		pim_mfc_pending_del(&pim->mfc_pending, op);
+
+		if (!pim_mfc_op_apply(pim, op) && op->add) {
+			c_oil = pim_find_channel_oil(pim, &op->sg);
+			if (c_oil)
+				c_oil->installed = 0;
+		}
+		XFREE(MTYPE_PIM_MFC_OP, op);
+	}
+}
+
+static void pim_mfc_queue_cb(struct event *t)
+{
+	struct pim_instance *pim = EVENT_ARG(t);
+
+	pim_mfc_queue_run(pim, PIM_MFC_QUEUE_BATCH);
+
+	if (pim_mfc_queue_count(&pim->mfc_queue))
+		event_add_event(router->master, pim_mfc_queue_cb, pim, 0,
+				&pim->t_mfc_queue);
+}
+
+void pim_mroute_mfc_flush(struct pim_instance *pim)
+{
+	EVENT_OFF(pim->t_mfc_queue);
+	pim_mfc_queue_run(pim, UINT_MAX);
+}
+
+/*
+ * Queue the current image of c_oil for the kernel.  Changes for the same
+ * (S,G) replace each other while queued, so a burst of updates, e.g. after
+ * an RP change, reaches the kernel as one change per entry.
+ */
+static void pim_mfc_enqueue(struct channel_oil *c_oil,
+			    const struct channel_oil *image, bool add,
+			    bool via_pimreg)
+{
+	struct pim_instance *pim = c_oil->pim;
+	struct pim_mfc_op *op, ref = {};
+
+	ref.sg.src = *oil_origin(c_oil);
+	ref.sg.grp = *oil_mcastgrp(c_oil);
+
+	op = pim_mfc_pending_find(&pim->mfc_pending, &ref);
+	if (!op) {
+		op = XCALLOC(MTYPE_PIM_MFC_OP, sizeof(*op));
+		op->sg = ref.sg;
+		op->fresh = add && !c_oil->installed;
+		pim_mfc_pending_add(&pim->mfc_pending, op);
+		pim_mfc_queue_add_tail(&pim->mfc_queue, op);
+	} else if (!add && op->fresh) {
+		/* Never reached the kernel */
+		pim_mfc_pending_del(&pim->mfc_pending, op);
+		pim_mfc_queue_del(&pim->mfc_queue, op);
+		XFREE(MTYPE_PIM_MFC_OP, op);
+		return;
+	}
+
+	op->add = add;
+	op->via_pimreg = add && (via_pimreg || op->via_pimreg);
+	op->mfc = image->oil;
+
+	event_add_event(router->master, pim_mfc_queue_cb, pim, 0,
+			&pim->t_mfc_queue);
+}
+
 /* This function must not be called directly 0
  * use pim_upstream_mroute_add or pim_static_mroute_add instead
  */
@@ -1065,7 +1249,6 @@ static int pim_mroute_add(struct channel_oil *c_oil, const char *name)
 {
 	struct pim_instance *pim = c_oil->pim;
 	struct channel_oil tmp_oil[1] = { };
-	int err;
 
 	pim->mroute_add_last = pim_time_monotonic_sec();
 	++pim->mroute_add_events;
@@ -1089,29 +1272,15 @@ static int pim_mroute_add(struct channel_oil *c_oil, const char *name)
 	 * So set pimreg as the IIF temporarily to cause
 	 * the packets to be forwarded.  Then set it
 	 * to the correct IIF afterwords.
+	 *
+	 * The kernel gets the entry from the MFC queue, where
+	 * the installed flag set below already counts, so a
+	 * failure is only logged from there.
 	 */
-	if (!c_oil->installed && !pim_addr_is_any(*oil_origin(c_oil)) &&
-	    *oil_incoming_vif(c_oil) != 0) {
-		*oil_incoming_vif(tmp_oil) = 0;
-	}
-	/* For IPv6 MRT_ADD_MFC is defined to MRT6_ADD_MFC */
-	err = setsockopt(pim->mroute_socket, PIM_IPPROTO, MRT_ADD_MFC,
-			 &tmp_oil->oil, sizeof(tmp_oil->oil));
-
-	if (!err && !c_oil->installed && !pim_addr_is_any(*oil_origin(c_oil)) &&
-	    *oil_incoming_vif(c_oil) != 0) {
-		*oil_incoming_vif(tmp_oil) = *oil_incoming_vif(c_oil);
-		err = setsockopt(pim->mroute_socket, PIM_IPPROTO, MRT_ADD_MFC,
-				 &tmp_oil->oil, sizeof(tmp_oil->oil));
-	}
-
-	if (err) {
-		zlog_warn(
-			"%s %s: failure: setsockopt(fd=%d,PIM_IPPROTO,MRT_ADD_MFC): errno=%d: %s",
-			__FILE__, __func__, pim->mroute_socket, errno,
-			safe_strerror(errno));
-		return -2;
-	}
+	pim_mfc_enqueue(c_oil, tmp_oil, true,
+			!c_oil->installed &&
+				!pim_addr_is_any(*oil_origin(c_oil)) &&
+				*oil_incoming_vif(c_oil) != 0);
 
 	if (PIM_DEBUG_MROUTE) {
 		char buf[1000];
@@ -1267,7 +1436,6 @@ void pim_static_mroute_iif_update(struct channel_oil *c_oil,
 int pim_mroute_del(struct channel_oil *c_oil, const char *name)
 {
 	struct pim_instance *pim = c_oil->pim;
-	int err;
 
 	pim->mroute_del_last = pim_time_monotonic_sec();
 	++pim->mroute_del_events;
@@ -1288,16 +1456,7 @@ int pim_mroute_del(struct channel_oil *c_oil, const char *name)
 		return -2;
 	}
 
-	err = setsockopt(pim->mroute_socket, PIM_IPPROTO, MRT_DEL_MFC,
-			 &c_oil->oil, sizeof(c_oil->oil));
-	if (err) {
-		if (PIM_DEBUG_MROUTE)
-			zlog_warn(
-				"%s %s: failure: setsockopt(fd=%d,PIM_IPPROTO,MRT_DEL_MFC): errno=%d: %s",
-				__FILE__, __func__, pim->mroute_socket, errno,
-				safe_strerror(errno));
-		return -2;
-	}
+	pim_mfc_enqueue(c_oil, c_oil, false, false);
 
 	if (PIM_DEBUG_MROUTE) {
 		char buf[1000];
@@ -30,6 +30,7 @@
 #endif
 
 typedef struct vifctl pim_vifctl;
+typedef struct mfcctl pim_mfcctl;
 typedef struct igmpmsg kernmsg;
 typedef struct sioc_sg_req pim_sioc_sg_req;
 
@@ -108,6 +109,7 @@ typedef struct sioc_sg_req pim_sioc_sg_req;
 #endif
 
 typedef struct mif6ctl pim_vifctl;
+typedef struct mf6cctl pim_mfcctl;
 typedef struct mrt6msg kernmsg;
 typedef mifi_t vifi_t;
 typedef struct sioc_sg_req6 pim_sioc_sg_req;
@@ -138,9 +140,19 @@ typedef struct sioc_sg_req6 pim_sioc_sg_req;
 struct channel_oil;
 struct pim_instance;
 
+/*
+ * MFC adds and deletes waiting to be handed to the kernel, latest per
+ * (S,G); see pim_mroute_add().
+ */
+PREDECL_DLIST(pim_mfc_queue);
+PREDECL_HASH(pim_mfc_pending);
+
 int pim_mroute_socket_enable(struct pim_instance *pim);
 int pim_mroute_socket_disable(struct pim_instance *pim);
 
+/* Hand all queued MFC changes to the kernel now */
+void pim_mroute_mfc_flush(struct pim_instance *pim);
+
 int pim_mroute_add_vif(struct interface *ifp, pim_addr ifaddr,
 		       unsigned char flags);
 int pim_mroute_del_vif(struct interface *ifp);
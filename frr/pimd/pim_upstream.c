@@ -202,8 +202,10 @@ struct pim_upstream *pim_upstream_del(struct pim_instance *pim,
 
 	pim_upstream_timers_stop(up);
 
+	/* Not queued, as up is about to go */
+	pim_jp_agg_single_upstream_cancel(up);
 	if (up->join_state == PIM_UPSTREAM_JOINED) {
-		pim_jp_agg_single_upstream_send(&up->rpf, up, 0);
+		pim_jp_agg_single_upstream_send_now(&up->rpf, up, 0);
 
 		if (pim_addr_is_any(up->sg.src)) {
 			/* if a (*, G) entry in the joined state is being
@@ -1966,6 +1968,9 @@ void pim_upstream_terminate(struct pim_instance *pim)
 
 	rb_pim_upstream_fini(&pim->upstream_head);
 
+	EVENT_OFF(pim->t_jp_triggers);
+	pim_jp_triggers_fini(&pim->jp_triggers);
+
 	if (pim->upstream_sg_wheel)
 		wheel_delete(pim->upstream_sg_wheel);
 	pim->upstream_sg_wheel = NULL;
@@ -2232,4 +2237,5 @@ void pim_upstream_init(struct pim_instance *pim)
 			   pim_upstream_sg_running, name);
 
 	rb_pim_upstream_init(&pim->upstream_head);
+	pim_jp_triggers_init(&pim->jp_triggers);
 }
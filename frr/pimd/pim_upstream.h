@@ -185,6 +185,7 @@ struct pim_up_mlag {
 };
 
 PREDECL_RBTREE_UNIQ(rb_pim_upstream);
+PREDECL_DLIST(pim_jp_triggers);
 /*
   Upstream (S,G) channel in Joined state
   (S,G) in the "Not Joined" state is not represented
@@ -235,6 +236,16 @@ struct pim_upstream {
 
 	struct pim_rpf rpf;
 
+	/*
+	 * Triggered Join/Prune not sent yet, to the neighbor and on the
+	 * interface the RPF pointed to when it was triggered.
+	 */
+	struct pim_jp_triggers_item jp_trigger_item;
+	bool jp_trigger_pending;
+	bool jp_trigger_join;
+	ifindex_t jp_trigger_ifindex;
+	pim_addr jp_trigger_addr;
+
 	struct pim_up_mlag mlag;
 
 	struct event *t_join_timer;
@@ -360,6 +371,7 @@ int pim_upstream_compare(const struct pim_upstream *up1,
 			 const struct pim_upstream *up2);
 DECLARE_RBTREE_UNIQ(rb_pim_upstream, struct pim_upstream, upstream_rb,
 		    pim_upstream_compare);
+DECLARE_DLIST(pim_jp_triggers, struct pim_upstream, jp_trigger_item);
 
 void pim_upstream_register_reevaluate(struct pim_instance *pim);
 
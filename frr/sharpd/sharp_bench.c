@@ -0,0 +1,317 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * SHARP - route install benchmark
+ *
+ * Runs a fixed sequence of phases over the same routes: install via one
+ * nexthop, replace it by another, move the routes onto a nexthop group,
+ * and delete them. Each route is timed from the moment it is handed to
+ * the zapi stream to zebra's owner notification, which zebra sends once
+ * the dataplane has reported the result, so the figures cover zebra and
+ * the dataplane provider together.
+ */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "log.h"
+#include "memory.h"
+#include "monotime.h"
+#include "nexthop.h"
+#include "nexthop_group.h"
+#include "prefix.h"
+#include "vrf.h"
+#include "vty.h"
+#include "zclient.h"
+
+#include "sharpd/sharp_globals.h"
+#include "sharpd/sharp_nht.h"
+#include "sharpd/sharp_vty.h"
+#include "sharpd/sharp_zebra.h"
+
+DEFINE_MTYPE_STATIC(SHARPD, SHARP_BENCH, "Sharp benchmark");
+
+enum sharp_bench_phase {
+	SHARP_BENCH_INSTALL,
+	SHARP_BENCH_REPLACE,
+	SHARP_BENCH_NHG,
+	SHARP_BENCH_DELETE,
+	SHARP_BENCH_PHASES,
+};
+
+static const char *const sharp_bench_phase_names[] = {
+	[SHARP_BENCH_INSTALL] = "install",
+	[SHARP_BENCH_REPLACE] = "replace-nexthop",
+	[SHARP_BENCH_NHG] = "nexthop-group",
+	[SHARP_BENCH_DELETE] = "delete",
+};
+
+struct sharp_bench_result {
+	bool run;
+	uint32_t routes;
+	uint32_t failed;
+	int64_t elapsed_us;
+	/* Send to notification, in microseconds */
+	uint32_t p50, p90, p99, max;
+};
+
+static struct {
+	bool running;
+	enum sharp_bench_phase phase;
+
+	struct prefix start;
+	uint32_t routes;
+	vrf_id_t vrf_id;
+	uint8_t instance;
+	struct nexthop nh[2];
+	struct nexthop_group nhg[2];
+	/* Group of the nexthop-group phase, 0 to skip it */
+	uint32_t nhgid;
+
+	/* Per route: when it was sent in this phase, 0 once notified */
+	int64_t *sent;
+	/* Latencies of the routes notified so far */
+	uint32_t *latency;
+	uint32_t done, failed;
+	int64_t t_start;
+
+	struct sharp_bench_result results[SHARP_BENCH_PHASES];
+} bench;
+
+static char sharp_bench_opaque[] = "";
+
+static int64_t sharp_bench_now(void)
+{
+	struct timeval tv;
+
+	monotime(&tv);
+	return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static bool sharp_bench_index(const struct prefix *p, uint32_t *idx)
+{
+	uint32_t base, addr;
+
+	if (p->family != bench.start.family ||
+	    p->prefixlen != bench.start.prefixlen)
+		return false;
+
+	if (p->family == AF_INET) {
+		base = ntohl(bench.start.u.prefix4.s_addr);
+		addr = ntohl(p->u.prefix4.s_addr);
+	} else {
+		if (memcmp(&p->u.prefix6, &bench.start.u.prefix6, 12))
+			return false;
+		base = ntohl(bench.start.u.val32[3]);
+		addr = ntohl(p->u.val32[3]);
+	}
+
+	*idx = addr - base;
+	return *idx < bench.routes;
+}
+
+static int sharp_bench_latency_cmp(const void *a, const void *b)
+{
+	uint32_t la = *(const uint32_t *)a, lb = *(const uint32_t *)b;
+
+	return la < lb ? -1 : la > lb;
+}
+
+static uint32_t sharp_bench_percentile(uint32_t n, unsigned int pct)
+{
+	if (!n)
+		return 0;
+	return bench.latency[MIN(n - 1, (uint64_t)n * pct / 100)];
+}
+
+static void sharp_bench_start_phase(enum sharp_bench_phase phase);
+
+static void sharp_bench_end_phase(void)
+{
+	struct sharp_bench_result *res = &bench.results[bench.phase];
+	uint32_t n = bench.done - bench.failed;
+
+	qsort(bench.latency, n, sizeof(bench.latency[0]),
+	      sharp_bench_latency_cmp);
+
+	res->run = true;
+	res->routes = bench.done;
+	res->failed = bench.failed;
+	res->elapsed_us = sharp_bench_now() - bench.t_start;
+	res->p50 = sharp_bench_percentile(n, 50);
+	res->p90 = sharp_bench_percentile(n, 90);
+	res->p99 = sharp_bench_percentile(n, 99);
+	res->max = n ? bench.latency[n - 1] : 0;
+
+	zlog_info("Sharp bench %s: %u routes in %" PRId64
+		  " us, %u failed, latency p50 %u p90 %u p99 %u max %u us",
+		  sharp_bench_phase_names[bench.phase], res->routes,
+		  res->elapsed_us, res->failed, res->p50, res->p90, res->p99,
+		  res->max);
+
+	sharp_bench_start_phase(bench.phase + 1);
+}
+
+static void sharp_bench_start_phase(enum sharp_bench_phase phase)
+{
+	struct prefix p = bench.start;
+
+	/* Without an installed group there is nothing to move onto */
+	if (phase == SHARP_BENCH_NHG &&
+	    (!bench.nhgid || !sharp_nhgroup_id_is_installed(bench.nhgid)))
+		phase++;
+
+	if (phase == SHARP_BENCH_PHASES) {
+		bench.running = false;
+		XFREE(MTYPE_SHARP_BENCH, bench.sent);
+		XFREE(MTYPE_SHARP_BENCH, bench.latency);
+		zlog_info("Sharp bench done");
+		return;
+	}
+
+	bench.phase = phase;
+	bench.done = bench.failed = 0;
+	memset(bench.sent, 0, bench.routes * sizeof(bench.sent[0]));
+	bench.t_start = sharp_bench_now();
+
+	switch (phase) {
+	case SHARP_BENCH_INSTALL:
+		sharp_install_routes_helper(&p, bench.vrf_id, bench.instance, 0,
+					    &bench.nhg[0], NULL, bench.routes,
+					    ZEBRA_FLAG_ALLOW_RECURSION,
+					    sharp_bench_opaque);
+		break;
+	case SHARP_BENCH_REPLACE:
+		sharp_install_routes_helper(&p, bench.vrf_id, bench.instance, 0,
+					    &bench.nhg[1], NULL, bench.routes,
+					    ZEBRA_FLAG_ALLOW_RECURSION,
+					    sharp_bench_opaque);
+		break;
+	case SHARP_BENCH_NHG:
+		sharp_install_routes_helper(&p, bench.vrf_id, bench.instance,
+					    bench.nhgid, &bench.nhg[0], NULL,
+					    bench.routes,
+					    ZEBRA_FLAG_ALLOW_RECURSION,
+					    sharp_bench_opaque);
+		break;
+	case SHARP_BENCH_DELETE:
+		sharp_remove_routes_helper(&p, bench.vrf_id, bench.instance,
+					   bench.routes);
+		break;
+	case SHARP_BENCH_PHASES:
+		break;
+	}
+}
+
+void sharp_bench_sent(const struct prefix *p)
+{
+	uint32_t idx;
+
+	if (bench.running && sharp_bench_index(p, &idx))
+		bench.sent[idx] = sharp_bench_now();
+}
+
+bool sharp_bench_notify(const struct prefix *p,
+			enum zapi_route_notify_owner note)
+{
+	uint32_t idx;
+	int64_t sent;
+
+	if (!bench.running || !sharp_bench_index(p, &idx))
+		return false;
+
+	/* Notified already, or left over from the phase before */
+	sent = bench.sent[idx];
+	if (!sent)
+		return true;
+
+	switch (note) {
+	case ZAPI_ROUTE_INSTALLED:
+		if (bench.phase == SHARP_BENCH_DELETE)
+			return true;
+		break;
+	case ZAPI_ROUTE_REMOVED:
+		if (bench.phase != SHARP_BENCH_DELETE)
+			return true;
+		break;
+	case ZAPI_ROUTE_FAIL_INSTALL:
+	case ZAPI_ROUTE_BETTER_ADMIN_WON:
+	case ZAPI_ROUTE_REMOVE_FAIL:
+		bench.failed++;
+		break;
+	}
+
+	if (note == ZAPI_ROUTE_INSTALLED || note == ZAPI_ROUTE_REMOVED)
+		bench.latency[bench.done - bench.failed] =
+			MIN(sharp_bench_now() - sent, UINT32_MAX);
+	bench.sent[idx] = 0;
+
+	if (++bench.done == bench.routes)
+		sharp_bench_end_phase();
+	return true;
+}
+
+int sharp_bench_run(struct vty *vty, const struct prefix *start,
+		    vrf_id_t vrf_id, const struct nexthop *nh1,
+		    const struct nexthop *nh2, uint32_t nhgid, uint32_t routes,
+		    uint8_t instance)
+{
+	unsigned int i;
+
+	if (bench.running) {
+		vty_out(vty, "%% A benchmark is already running\n");
+		return CMD_WARNING;
+	}
+
+	memset(&bench, 0, sizeof(bench));
+	bench.start = *start;
+	bench.routes = routes;
+	bench.vrf_id = vrf_id;
+	bench.instance = instance;
+	bench.nhgid = nhgid;
+	bench.nh[0] = *nh1;
+	bench.nh[1] = *nh2;
+	for (i = 0; i < array_size(bench.nh); i++) {
+		bench.nh[i].vrf_id = vrf_id;
+		bench.nhg[i].nexthop = &bench.nh[i];
+	}
+
+	bench.sent = XCALLOC(MTYPE_SHARP_BENCH, routes * sizeof(*bench.sent));
+	bench.latency = XCALLOC(MTYPE_SHARP_BENCH,
+				routes * sizeof(*bench.latency));
+	bench.running = true;
+
+	vty_out(vty, "Benchmark started over %u routes, see \"show sharp bench\"\n",
+		routes);
+	sharp_bench_start_phase(SHARP_BENCH_INSTALL);
+	return CMD_SUCCESS;
+}
+
+void sharp_bench_show(struct vty *vty)
+{
+	const struct sharp_bench_result *res;
+	unsigned int i;
+
+	if (bench.running)
+		vty_out(vty, "Running %s: %u of %u routes\n",
+			sharp_bench_phase_names[bench.phase], bench.done,
+			bench.routes);
+
+	vty_out(vty, "%-16s %8s %7s %12s %10s %8s %8s %8s %8s\n", "Phase",
+		"Routes", "Failed", "Elapsed(ms)", "Routes/s", "p50(us)",
+		"p90(us)", "p99(us)", "max(us)");
+
+	for (i = 0; i < SHARP_BENCH_PHASES; i++) {
+		res = &bench.results[i];
+		if (!res->run)
+			continue;
+		vty_out(vty, "%-16s %8u %7u %12" PRId64 " %10" PRIu64
+			     " %8u %8u %8u %8u\n",
+			sharp_bench_phase_names[i], res->routes, res->failed,
+			res->elapsed_us / 1000,
+			res->elapsed_us
+				? (uint64_t)res->routes * 1000000 /
+					  res->elapsed_us
+				: 0,
+			res->p50, res->p90, res->p99, res->max);
+	}
+}
@@ -776,6 +776,97 @@ DEFPY (logpump,
 	return CMD_SUCCESS;
 }
 
+DEFPY (sharp_bench,
+       sharp_bench_cmd,
+       "sharp bench routes [vrf NAME$vrf_name] <A.B.C.D$start4|X:X::X:X$start6> \
+          nexthop <A.B.C.D$nh1_4|X:X::X:X$nh1_6> \
+          nexthop <A.B.C.D$nh2_4|X:X::X:X$nh2_6> \
+          [nexthop-group NHGNAME$nexthop_group] \
+          (1-1000000)$routes [instance (0-255)$instance]",
+       "Sharp Routing Protocol\n"
+       "Benchmark the route install path\n"
+       "Install, replace and remove a set of routes\n"
+       "The vrf we would like to install into if non-default\n"
+       "The NAME of the vrf\n"
+       "v4 Starting spot\n"
+       "v6 Starting spot\n"
+       "Nexthop the routes are installed with\n"
+       "V4 Nexthop address to use\n"
+       "V6 Nexthop address to use\n"
+       "Nexthop the routes are replaced with\n"
+       "V4 Nexthop address to use\n"
+       "V6 Nexthop address to use\n"
+       "Nexthop-Group the routes are moved onto last\n"
+       "The Name of the nexthop-group\n"
+       "How many to create\n"
+       "Instance to use\n"
+       "Instance\n")
+{
+	struct nexthop nh[2] = {};
+	struct prefix prefix = {};
+	uint32_t nhgid = 0;
+	struct vrf *vrf;
+
+	if (start4.s_addr != INADDR_ANY) {
+		prefix.family = AF_INET;
+		prefix.prefixlen = IPV4_MAX_BITLEN;
+		prefix.u.prefix4 = start4;
+	} else {
+		prefix.family = AF_INET6;
+		prefix.prefixlen = IPV6_MAX_BITLEN;
+		prefix.u.prefix6 = start6;
+	}
+
+	if (!vrf_name)
+		vrf_name = VRF_DEFAULT_NAME;
+
+	vrf = vrf_lookup_by_name(vrf_name);
+	if (!vrf) {
+		vty_out(vty, "The vrf NAME specified: %s does not exist\n",
+			vrf_name);
+		return CMD_WARNING;
+	}
+
+	if (nexthop_group) {
+		if (!nhgc_find(nexthop_group)) {
+			vty_out(vty,
+				"Specified Nexthop Group: %s does not exist\n",
+				nexthop_group);
+			return CMD_WARNING;
+		}
+		nhgid = sharp_nhgroup_get_id(nexthop_group);
+	}
+
+	if (nh1_4.s_addr != INADDR_ANY) {
+		nh[0].gate.ipv4 = nh1_4;
+		nh[0].type = NEXTHOP_TYPE_IPV4;
+	} else {
+		nh[0].gate.ipv6 = nh1_6;
+		nh[0].type = NEXTHOP_TYPE_IPV6;
+	}
+	if (nh2_4.s_addr != INADDR_ANY) {
+		nh[1].gate.ipv4 = nh2_4;
+		nh[1].type = NEXTHOP_TYPE_IPV4;
+	} else {
+		nh[1].gate.ipv6 = nh2_6;
+		nh[1].type = NEXTHOP_TYPE_IPV6;
+	}
+
+	return sharp_bench_run(vty, &prefix, vrf->vrf_id, &nh[0], &nh[1], nhgid,
+			       routes, instance);
+}
+
+DEFPY (show_sharp_bench,
+       show_sharp_bench_cmd,
+       "show sharp bench",
+       SHOW_STR
+       SHARP_STR
+       "Results of the last route benchmark\n")
+{
+	sharp_bench_show(vty);
+	return CMD_SUCCESS;
+}
+
 DEFPY (create_session,
        create_session_cmd,
        "sharp create session (1-1024)",
@@ -1194,7 +1285,8 @@ DEFPY (show_sharp_cspf,
        show_sharp_cspf_cmd,
        "show sharp cspf source <A.B.C.D$src4|X:X::X:X$src6> \
         destination <A.B.C.D$dst4|X:X::X:X$dst6> \
-        <metric|te-metric|delay> (0-16777215)$cost \
+        <metric|te-metric|delay|min-delay> (0-16777215)$cost \
+        [max-delay (1-16777215)$max_delay] \
         [rsv-bw (0-7)$cos BANDWIDTH$bw]",
        SHOW_STR
        SHARP_STR
@@ -1208,7 +1300,10 @@ DEFPY (show_sharp_cspf,
        "Maximum Metric\n"
        "Maximum TE Metric\n"
        "Maxim Delay\n"
+       "Maximum Minimum Delay\n"
        "Value of Maximum cost\n"
+       "Bound the delay of the path, whatever the metric\n"
+       "Maximum delay of the path in micro-seconds\n"
        "Reserved Bandwidth of this path\n"
        "Class of Service or Priority level\n"
        "Bytes/second (IEEE floating point format)\n")
@@ -1248,7 +1343,14 @@ DEFPY (show_sharp_cspf,
 		csts.ctype = CSPF_DELAY;
 		csts.cost = cost;
 	}
-	if (argc > 9) {
+	idx = 6;
+	if (argv_find(argv, argc, "min-delay", &idx)) {
+		csts.ctype = CSPF_MIN_DELAY;
+		csts.cost = cost;
+	}
+	if (max_delay_str)
+		csts.delay = max_delay;
+	if (bw) {
 		if (sscanf(bw, "%g", &csts.bw) != 1) {
 			vty_out(vty, "Bandwidth constraints: fscanf: %s\n",
 				safe_strerror(errno));
@@ -1277,6 +1379,8 @@ DEFPY (show_sharp_cspf,
 
 	vty_out(vty, "Path computation success\n");
 	vty_out(vty, "\tCost: %d\n", path->weight);
+	if (csts.delay)
+		vty_out(vty, "\tDelay: %u\n", path->delay);
 	vty_out(vty, "\tEdges:");
 	for (ALL_LIST_ELEMENTS_RO(path->edges, node, edge)) {
 		if (src4.s_addr != INADDR_ANY)
@@ -1425,6 +1529,8 @@ void sharp_vty_init(void)
 	install_element(ENABLE_NODE, &sharp_lsp_prefix_v4_cmd);
 	install_element(ENABLE_NODE, &sharp_remove_lsp_prefix_v4_cmd);
 	install_element(ENABLE_NODE, &logpump_cmd);
+	install_element(ENABLE_NODE, &sharp_bench_cmd);
+	install_element(ENABLE_NODE, &show_sharp_bench_cmd);
 	install_element(ENABLE_NODE, &create_session_cmd);
 	install_element(ENABLE_NODE, &remove_session_cmd);
 	install_element(ENABLE_NODE, &send_opaque_cmd);
@@ -14,4 +14,14 @@ struct vty;
 extern void sharp_logpump_run(struct vty *vty, unsigned duration,
 			      unsigned frequency, unsigned burst);
 
+struct prefix;
+struct nexthop;
+
+/* Route install benchmark, see sharp_bench.c */
+extern int sharp_bench_run(struct vty *vty, const struct prefix *start,
+			   vrf_id_t vrf_id, const struct nexthop *nh1,
+			   const struct nexthop *nh2, uint32_t nhgid,
+			   uint32_t routes, uint8_t instance);
+extern void sharp_bench_show(struct vty *vty);
+
 #endif
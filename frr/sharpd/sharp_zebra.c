@@ -341,8 +341,11 @@ static void sharp_install_routes_restart(struct prefix *p, uint32_t count,
 		temp = ntohl(p->u.val32[3]);
 
 	for (i = count; i < routes; i++) {
-		bool buffered = route_add(p, vrf_id, (uint8_t)instance, nhgid,
-					  nhg, backup_nhg, flags, opaque);
+		bool buffered;
+
+		sharp_bench_sent(p);
+		buffered = route_add(p, vrf_id, (uint8_t)instance, nhgid, nhg,
+				     backup_nhg, flags, opaque);
 		if (v4)
 			p->u.prefix4.s_addr = htonl(++temp);
 		else
@@ -397,7 +400,10 @@ static void sharp_remove_routes_restart(struct prefix *p, uint32_t count,
 		temp = ntohl(p->u.val32[3]);
 
 	for (i = count; i < routes; i++) {
-		bool buffered = route_delete(p, vrf_id, (uint8_t)instance);
+		bool buffered;
+
+		sharp_bench_sent(p);
+		buffered = route_delete(p, vrf_id, (uint8_t)instance);
 
 		if (v4)
 			p->u.prefix4.s_addr = htonl(++temp);
@@ -476,6 +482,9 @@ static int route_notify_owner(ZAPI_CALLBACK_ARGS)
 				      NULL))
 		return -1;
 
+	if (sharp_bench_notify(&p, note))
+		return 0;
+
 	switch (note) {
 	case ZAPI_ROUTE_INSTALLED:
 		sg.r.installed_routes++;
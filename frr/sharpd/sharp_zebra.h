@@ -29,6 +29,14 @@ extern void sharp_install_routes_helper(struct prefix *p, vrf_id_t vrf_id,
 extern void sharp_remove_routes_helper(struct prefix *p, vrf_id_t vrf_id,
 				       uint8_t instance, uint32_t routes);
 
+/*
+ * Benchmark hooks: a route of the running benchmark is sent, or zebra
+ * notified about one; the latter is true if the benchmark consumed it.
+ */
+extern void sharp_bench_sent(const struct prefix *p);
+extern bool sharp_bench_notify(const struct prefix *p,
+			       enum zapi_route_notify_owner note);
+
 int sharp_install_lsps_helper(bool install_p, bool update_p,
 			      const struct prefix *p, uint8_t type,
 			      int instance, uint32_t in_label,
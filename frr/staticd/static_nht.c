@@ -22,6 +22,7 @@ static void static_nht_update_path(struct static_path *pn, struct prefix *nhp,
 				   struct vrf *vrf)
 {
 	struct static_nexthop *nh;
+	bool send = false;
 
 	frr_each(static_nexthop_list, &pn->nexthop_list, nh) {
 		if (nh->nh_vrf_id != nh_vrf_id)
@@ -43,8 +44,12 @@ static void static_nht_update_path(struct static_path *pn, struct prefix *nhp,
 			nh->nh_valid = !!nh_num;
 
 		if (nh->state == STATIC_START)
-			static_zebra_route_add(pn, true);
+			send = true;
 	}
+
+	/* Once for the path, however many of its nexthops changed */
+	if (send)
+		static_zebra_route_add(pn, true);
 }
 
 static void static_nht_update_safi(struct prefix *sp, struct prefix *nhp,
@@ -99,64 +104,62 @@ void static_nht_update(struct prefix *sp, struct prefix *nhp, uint32_t nh_num,
 				       nh_vrf_id);
 }
 
-static void static_nht_reset_start_safi(struct prefix *nhp, afi_t afi,
-					safi_t safi, struct vrf *vrf,
-					vrf_id_t nh_vrf_id)
+static void static_nht_update_changed_table(struct route_table *stable,
+					   safi_t safi)
 {
-	struct static_vrf *svrf;
-	struct route_table *stable;
+	struct static_route_info *si;
 	struct static_nexthop *nh;
 	struct static_path *pn;
 	struct route_node *rn;
-	struct static_route_info *si;
-
-	svrf = vrf->info;
-	if (!svrf)
-		return;
-
-	stable = static_vrf_static_table(afi, safi, svrf);
-	if (!stable)
-		return;
+	uint32_t nh_num;
+	bool send;
 
 	for (rn = route_top(stable); rn; rn = route_next(rn)) {
 		si = static_route_info_from_rnode(rn);
 		if (!si)
 			continue;
 		frr_each(static_path_list, &si->path_list, pn) {
+			send = false;
 			frr_each(static_nexthop_list, &pn->nexthop_list, nh) {
-				if (nh->nh_vrf_id != nh_vrf_id)
-					continue;
-
-				if (nhp->family == AF_INET
-				    && nhp->u.prefix4.s_addr
-					       != nh->addr.ipv4.s_addr)
-					continue;
-
-				if (nhp->family == AF_INET6
-				    && memcmp(&nhp->u.prefix6, &nh->addr.ipv6,
-					      16)
-					       != 0)
-					continue;
-
-				/*
-				 * We've been told that a nexthop we
-				 * depend on has changed in some manner,
-				 * so reset the state machine to allow
-				 * us to start over.
-				 */
-				nh->state = STATIC_START;
+				if (static_zebra_nht_changed(nh, safi,
+							     &nh_num)) {
+					/*
+					 * We've been told that a nexthop we
+					 * depend on has changed in some
+					 * manner, so reset the state machine
+					 * to allow us to start over.
+					 */
+					nh->state = STATIC_START;
+					nh->nh_valid = !!nh_num;
+				}
+				if (nh->state == STATIC_START)
+					send = true;
 			}
+			if (send)
+				static_zebra_route_add(pn, true);
 		}
 	}
 }
 
-void static_nht_reset_start(struct prefix *nhp, afi_t afi, safi_t safi,
-			    vrf_id_t nh_vrf_id)
+void static_nht_update_changed(void)
 {
+	struct route_table *stable;
+	struct static_vrf *svrf;
 	struct vrf *vrf;
+	afi_t afi;
+	safi_t safi;
 
-	RB_FOREACH (vrf, vrf_name_head, &vrfs_by_name)
-		static_nht_reset_start_safi(nhp, afi, safi, vrf, nh_vrf_id);
+	RB_FOREACH (vrf, vrf_name_head, &vrfs_by_name) {
+		svrf = vrf->info;
+		if (!svrf)
+			continue;
+
+		FOREACH_AFI_SAFI (afi, safi) {
+			stable = static_vrf_static_table(afi, safi, svrf);
+			if (stable)
+				static_nht_update_changed_table(stable, safi);
+		}
+	}
 }
 
 static void static_nht_mark_state_safi(struct prefix *sp, afi_t afi,
@@ -28,11 +28,12 @@ extern void static_nht_update(struct prefix *sp, struct prefix *nhp,
 			      vrf_id_t vrf_id);
 
 /*
- * For the given tracked nexthop, nhp, mark all routes that use
- * this route as in starting state again.
+ * Start over with the routes using any of the tracked nexthops zebra
+ * sent an update for since the last call, see static_zebra_nht_changed().
+ * All routes are looked at in one go, however many updates came in, and
+ * each is sent to zebra once.
  */
-extern void static_nht_reset_start(struct prefix *nhp, afi_t afi, safi_t safi,
-				   vrf_id_t nh_vrf_id);
+extern void static_nht_update_changed(void);
 
 /*
  * For the given prefix, sp, mark it as in a particular state
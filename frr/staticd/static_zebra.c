@@ -45,6 +45,8 @@ struct static_nht_data {
 	uint32_t refcount;
 	uint8_t nh_num;
 	bool registered;
+	/* Updated by zebra, the routes are yet to be looked at */
+	bool changed;
 };
 
 static int static_nht_data_cmp(const struct static_nht_data *nhtd1,
@@ -71,6 +73,9 @@ DECLARE_HASH(static_nht_hash, struct static_nht_data, itm, static_nht_data_cmp,
 
 static struct static_nht_hash_head static_nht_hash[1];
 
+/* Looks at the routes of the nexthops that changed, see static_nht.h */
+static struct event *t_nht_changed;
+
 /* Zebra structure to hold current status. */
 struct zclient *zclient;
 uint32_t zebra_ecmp_count = MULTIPATH_NUM;
@@ -186,12 +191,21 @@ static_nexthop_is_local(vrf_id_t vrfid, struct prefix *addr, int family)
 	}
 	return false;
 }
+static void static_zebra_nht_changed_run(struct event *event)
+{
+	struct static_nht_data *nhtd;
+
+	static_nht_update_changed();
+
+	frr_each (static_nht_hash, static_nht_hash, nhtd)
+		nhtd->changed = false;
+}
+
 static int static_zebra_nexthop_update(ZAPI_CALLBACK_ARGS)
 {
 	struct static_nht_data *nhtd, lookup;
 	struct zapi_route nhr;
 	struct prefix matched;
-	afi_t afi = AFI_IP;
 
 	if (!zapi_nexthop_update_decode(zclient->ibuf, &matched, &nhr)) {
 		zlog_err("Failure to decode nexthop update message");
@@ -201,9 +215,6 @@ static int static_zebra_nexthop_update(ZAPI_CALLBACK_ARGS)
 	if (zclient->bfd_integration)
 		bfd_nht_update(&matched, &nhr);
 
-	if (matched.family == AF_INET6)
-		afi = AFI_IP6;
-
 	if (nhr.type == ZEBRA_ROUTE_CONNECT) {
 		if (static_nexthop_is_local(vrf_id, &matched,
 					    nhr.prefix.family))
@@ -219,11 +230,11 @@ static int static_zebra_nexthop_update(ZAPI_CALLBACK_ARGS)
 
 	if (nhtd) {
 		nhtd->nh_num = nhr.nexthop_num;
+		nhtd->changed = true;
 
-		static_nht_reset_start(&matched, afi, nhr.safi,
-				       nhtd->nh_vrf_id);
-		static_nht_update(NULL, &matched, nhr.nexthop_num, afi,
-				  nhr.safi, nhtd->nh_vrf_id);
+		/* Together with whatever else zebra sends in this read */
+		event_add_event(master, static_zebra_nht_changed_run, NULL, 0,
+				&t_nht_changed);
 	} else
 		zlog_err("No nhtd?");
 
@@ -306,6 +317,24 @@ static bool static_zebra_nht_get_prefix(const struct static_nexthop *nh,
 	return false;
 }
 
+bool static_zebra_nht_changed(const struct static_nexthop *nh, safi_t safi,
+			      uint32_t *nh_num)
+{
+	struct static_nht_data *nhtd, lookup = {};
+
+	if (!static_zebra_nht_get_prefix(nh, &lookup.nh))
+		return false;
+	lookup.nh_vrf_id = nh->nh_vrf_id;
+	lookup.safi = safi;
+
+	nhtd = static_nht_hash_find(static_nht_hash, &lookup);
+	if (!nhtd || !nhtd->changed)
+		return false;
+
+	*nh_num = nhtd->nh_num;
+	return true;
+}
+
 void static_zebra_nht_register(struct static_nexthop *nh, bool reg)
 {
 	struct static_path *pn = nh->pn;
@@ -550,6 +579,9 @@ void static_zebra_init(void)
 			      array_size(static_handlers));
 
 	zclient_init(zclient, ZEBRA_ROUTE_STATIC, 0, &static_privs);
+	/* Config loads of many routes go to zebra in few writes */
+	zclient->nexthop_bulk = true;
+	zclient->write_batch = true;
 	zclient->zebra_capabilities = static_zebra_capabilities;
 	zclient->zebra_connected = zebra_connected;
 
@@ -560,6 +592,7 @@ void static_zebra_init(void)
 /* static_zebra_stop used by tests/lib/test_grpc.cpp */
 void static_zebra_stop(void)
 {
+	EVENT_OFF(t_nht_changed);
 	static_nht_hash_clear();
 	static_nht_hash_fini(static_nht_hash);
 
@@ -14,6 +14,12 @@ extern "C" {
 extern struct event_loop *master;
 
 extern void static_zebra_nht_register(struct static_nexthop *nh, bool reg);
+/*
+ * Did zebra update the tracking of nh since the routes were last looked
+ * at; *nh_num is the number of nexthops it resolves over then.
+ */
+extern bool static_zebra_nht_changed(const struct static_nexthop *nh,
+				     safi_t safi, uint32_t *nh_num);
 
 extern void static_zebra_route_add(struct static_path *pn, bool install);
 extern void static_zebra_init(void);
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * BGP object arena tests.
+ *
+ * This file is part of FRRouting
+ */
+
+#include <zebra.h>
+
+#include "memory.h"
+#include "privs.h"
+#include "bgpd/bgp_arena.h"
+
+/* need these to link in libbgp */
+struct zebra_privs_t bgpd_privs = {};
+
+DEFINE_MGROUP(TEST_ARENA, "arena test");
+DEFINE_MTYPE_STATIC(TEST_ARENA, TEST_CHUNK, "arena test chunk");
+
+struct obj {
+	uint64_t a;
+	void *b;
+	char c[37];
+};
+
+#define OBJS 5000
+
+static struct obj *objs[OBJS];
+
+static void test_alloc_free(struct bgp_arena *arena)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < OBJS; i++) {
+		objs[i] = bgp_arena_alloc(arena);
+		assert(((uintptr_t)objs[i] & 7) == 0);
+		assert(objs[i]->a == 0 && objs[i]->b == NULL);
+		for (j = 0; j < sizeof(objs[i]->c); j++)
+			assert(objs[i]->c[j] == 0);
+		memset(objs[i], 0xa5, sizeof(*objs[i]));
+		objs[i]->a = i;
+	}
+	assert(arena->count == OBJS);
+	assert(arena->chunks == (OBJS + arena->per_chunk - 1) /
+					arena->per_chunk);
+
+	/* Nobody overwrote anybody */
+	for (i = 0; i < OBJS; i++)
+		assert(objs[i]->a == i);
+	printf("alloc: OK\n");
+
+	/* Every other one, then the rest; alloc reuses the holes */
+	for (i = 0; i < OBJS; i += 2) {
+		bgp_arena_free(arena, objs[i]);
+		objs[i] = NULL;
+	}
+	assert(arena->count == OBJS / 2);
+	for (i = 0; i < OBJS; i += 2)
+		objs[i] = bgp_arena_alloc(arena);
+	assert(arena->chunks == (OBJS + arena->per_chunk - 1) /
+					arena->per_chunk);
+	printf("reuse: OK\n");
+
+	for (i = 0; i < OBJS; i++)
+		bgp_arena_free(arena, objs[i]);
+	assert(arena->count == 0);
+	/* Only the spare is left */
+	assert(arena->chunks == 1);
+	printf("free: OK\n");
+
+	bgp_arena_finish(arena);
+	assert(arena->chunks == 0);
+	assert(mtype_stats_alloc(MTYPE_TEST_CHUNK) == 0);
+	printf("finish: OK\n");
+}
+
+int main(void)
+{
+	struct bgp_arena arena = BGP_ARENA_INIT(MTYPE_TEST_CHUNK, struct obj);
+
+	test_alloc_free(&arena);
+	/* And again from scratch, with the arena set up already */
+	test_alloc_free(&arena);
+	return 0;
+}
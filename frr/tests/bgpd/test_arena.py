@@ -0,0 +1,12 @@
+import frrtest
+
+
+class TestArena(frrtest.TestMultiOut):
+    program = "./test_arena"
+
+
+for i in range(2):
+    TestArena.onesimple("alloc: OK")
+    TestArena.onesimple("reuse: OK")
+    TestArena.onesimple("free: OK")
+    TestArena.onesimple("finish: OK")
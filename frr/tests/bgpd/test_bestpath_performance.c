@@ -0,0 +1,340 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Measures what latency-based path selection costs best-path: a table of
+ * prefixes each learned from several iBGP peers, via nexthops with a
+ * synthetic latency table, run through bgp_best_selection() with the
+ * latency step off and on.
+ *
+ * Usage: test_bestpath_performance [-j] [prefixes [paths [nexthops]]]
+ * The defaults are small enough for a quick run; the figure to track is
+ * 1000000 prefixes x 4 paths. With -j every result is printed as one
+ * JSON object per line, see tests/run_benchmarks.py.
+ */
+
+#include <zebra.h>
+
+#include "qobj.h"
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "linklist.h"
+#include "memory.h"
+#include "zclient.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_nexthop.h"
+#include "bgpd/bgp_evpn.h"
+#include "bgpd/bgp_network.h"
+
+#define DEFAULT_PREFIXES 100000
+#define DEFAULT_PATHS 4
+#define DEFAULT_NEXTHOPS 64
+
+/* need these to link in libbgp */
+struct event_loop *master = NULL;
+extern struct zclient *zclient;
+struct zebra_privs_t bgpd_privs = {
+	.user = NULL,
+	.group = NULL,
+	.vty_group = NULL,
+};
+
+static struct bgp *bgp;
+static struct bgp_table *rib;
+static unsigned int prefixes = DEFAULT_PREFIXES;
+static unsigned int paths = DEFAULT_PATHS;
+static unsigned int nexthops = DEFAULT_NEXTHOPS;
+static bool json;
+
+/* One iBGP peer per nexthop, as with PEs peering with a route reflector */
+static struct peer *peers;
+static struct peer_connection *connections;
+static struct attr *attrs;
+static struct bgp_nexthop_cache *bncs;
+
+static const struct {
+	const char *desc;
+	/* Benchmark name in the JSON output */
+	const char *name;
+	bool enabled;
+	/* Spread of the synthetic latencies, in microseconds */
+	uint32_t spread_us;
+} scenarios[] = {
+	{ "latency step off", "bestpath_latency_off", false, 0 },
+	{ "latency step on, differences below threshold",
+	  "bestpath_latency_below_threshold", true, 10000 },
+	{ "latency step on, differences decide", "bestpath_latency_decides",
+	  true, 200000 },
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* As in test_mpath.c */
+static struct bgp *bgp_create_fake(as_t *as, const char *name)
+{
+	struct bgp *bgp;
+	afi_t afi;
+	safi_t safi;
+
+	bgp = XCALLOC(MTYPE_BGP, sizeof(struct bgp));
+
+	bgp_lock(bgp);
+	bgp->peer = list_new();
+	bgp->group = list_new();
+
+	bgp_evpn_init(bgp);
+	FOREACH_AFI_SAFI (afi, safi) {
+		bgp->route[afi][safi] = bgp_table_init(bgp, afi, safi);
+		bgp->aggregate[afi][safi] = bgp_table_init(bgp, afi, safi);
+		bgp->rib[afi][safi] = bgp_table_init(bgp, afi, safi);
+		bgp->maxpaths[afi][safi].maxpaths_ebgp = 1;
+		bgp->maxpaths[afi][safi].maxpaths_ibgp = 1;
+	}
+
+	bgp_scan_init(bgp);
+	bgp->default_local_pref = BGP_DEFAULT_LOCAL_PREF;
+	bgp->as = *as;
+	bgp->import_latency_cfg.damping_threshold_us = 50000;
+	bgp->import_latency_cfg.switch_back_threshold_us = 25000;
+
+	if (name)
+		bgp->name = strdup(name);
+
+	return bgp;
+}
+
+static void build_peers(void)
+{
+	char addr[INET_ADDRSTRLEN];
+	unsigned int n;
+
+	peers = XCALLOC(MTYPE_TMP, nexthops * sizeof(*peers));
+	connections = XCALLOC(MTYPE_TMP, nexthops * sizeof(*connections));
+	attrs = XCALLOC(MTYPE_TMP, nexthops * sizeof(*attrs));
+	bncs = XCALLOC(MTYPE_TMP, nexthops * sizeof(*bncs));
+
+	for (n = 0; n < nexthops; n++) {
+		snprintf(addr, sizeof(addr), "10.0.%u.%u", n / 250,
+			 n % 250 + 1);
+
+		connections[n].status = Established;
+		peers[n].connection = &connections[n];
+		peers[n].bgp = bgp;
+		peers[n].as = bgp->as;
+		peers[n].local_as = bgp->as;
+		peers[n].sort = BGP_PEER_IBGP;
+		peers[n].host = XSTRDUP(MTYPE_TMP, addr);
+		peers[n].su_remote = sockunion_str2su(addr);
+		inet_pton(AF_INET, addr, &peers[n].remote_id);
+
+		attrs[n].aspath = aspath_empty(bgp->asnotation);
+		attrs[n].origin = BGP_ORIGIN_IGP;
+		attrs[n].local_pref = BGP_DEFAULT_LOCAL_PREF;
+		attrs[n].flag = ATTR_FLAG_BIT(BGP_ATTR_ORIGIN) |
+				ATTR_FLAG_BIT(BGP_ATTR_AS_PATH) |
+				ATTR_FLAG_BIT(BGP_ATTR_LOCAL_PREF) |
+				ATTR_FLAG_BIT(BGP_ATTR_NEXT_HOP);
+		attrs[n].nexthop = peers[n].remote_id;
+
+		bncs[n].bgp = bgp;
+		bncs[n].flags = BGP_NEXTHOP_VALID;
+		bncs[n].twamp_latency = UINT32_MAX;
+		str2prefix(addr, &bncs[n].prefix);
+	}
+}
+
+/* Each prefix is learned via that many paths, through distinct nexthops */
+static void build_table(void)
+{
+	struct bgp_path_info *pi;
+	struct bgp_dest *dest;
+	struct prefix p = { .family = AF_INET, .prefixlen = 24 };
+	unsigned int d, i, nh;
+
+	for (d = 0; d < prefixes; d++) {
+		p.u.prefix4.s_addr = htonl((1U << 24) + (d << 8));
+		dest = bgp_node_get(rib, &p);
+		for (i = 0; i < paths; i++) {
+			nh = (d + i * (nexthops / paths)) % nexthops;
+			pi = XCALLOC(MTYPE_BGP_ROUTE, sizeof(*pi));
+			pi->type = ZEBRA_ROUTE_BGP;
+			pi->sub_type = BGP_ROUTE_NORMAL;
+			pi->peer = &peers[nh];
+			pi->attr = &attrs[nh];
+			pi->nexthop = &bncs[nh];
+			pi->uptime = d;
+			SET_FLAG(pi->flags, BGP_PATH_VALID);
+			bgp_path_info_add(dest, pi);
+		}
+		bgp_dest_unlock_node(dest);
+	}
+}
+
+/* 1ms plus up to spread_us, by a fixed pattern so runs compare */
+static void set_latencies(uint32_t spread_us, unsigned int shift)
+{
+	unsigned int n;
+
+	for (n = 0; n < nexthops; n++)
+		bncs[n].twamp_latency =
+			spread_us ? 1000 + ((n + shift) * 2654435761U) %
+						   spread_us
+				  : UINT32_MAX;
+}
+
+/*
+ * One pass over the table, marking the winners selected as
+ * bgp_process_main_one() would. Returns the time taken and counts the
+ * routes whose best path moved and those the latency step decided.
+ */
+static uint64_t select_all(unsigned int *moved, unsigned int *by_latency)
+{
+	struct bgp_path_info_pair old_and_new;
+	struct bgp_dest *dest;
+	uint64_t start, elapsed = 0;
+
+	*moved = *by_latency = 0;
+	for (dest = bgp_table_top(rib); dest; dest = bgp_route_next(dest)) {
+		if (!bgp_dest_has_bgp_path_info_data(dest))
+			continue;
+
+		start = now_ns();
+		bgp_best_selection(bgp, dest,
+				   &bgp->maxpaths[AFI_IP][SAFI_UNICAST],
+				   &old_and_new, AFI_IP, SAFI_UNICAST);
+		elapsed += now_ns() - start;
+
+		if (dest->reason == bgp_path_selection_latency)
+			(*by_latency)++;
+		if (old_and_new.old == old_and_new.new)
+			continue;
+		(*moved)++;
+		if (old_and_new.old)
+			bgp_path_info_unset_flag(dest, old_and_new.old,
+						 BGP_PATH_SELECTED);
+		if (old_and_new.new)
+			bgp_path_info_set_flag(dest, old_and_new.new,
+					       BGP_PATH_SELECTED);
+	}
+
+	return elapsed;
+}
+
+static void clear_selection(void)
+{
+	struct bgp_path_info *pi;
+	struct bgp_dest *dest;
+
+	for (dest = bgp_table_top(rib); dest; dest = bgp_route_next(dest))
+		for (pi = bgp_dest_get_bgp_path_info(dest); pi; pi = pi->next)
+			bgp_path_info_unset_flag(dest, pi, BGP_PATH_SELECTED);
+}
+
+static void report(unsigned int s, const char *phase, const char *what,
+		   uint64_t elapsed, unsigned int moved, unsigned int by_latency)
+{
+	if (json) {
+		printf("{\"benchmark\": \"%s_%s\", \"ops\": %u, \"ns\": %" PRIu64
+		       ", \"ns_per_op\": %.1f, \"moved\": %u, \"by_latency\": %u}\n",
+		       scenarios[s].name, phase, prefixes, elapsed,
+		       (double)elapsed / prefixes, moved, by_latency);
+		return;
+	}
+	printf("  %-26s %8.3f s %7.1f ns/prefix  %8u moved  %8u by latency\n",
+	       what, elapsed / 1e9, (double)elapsed / prefixes, moved,
+	       by_latency);
+}
+
+static void run_scenario(unsigned int s, uint64_t *baseline)
+{
+	unsigned int moved, by_latency;
+	uint64_t initial, steady, shifted;
+
+	bgp->import_latency_cfg.enabled = scenarios[s].enabled;
+	bgp_bestpath_steps_update(bgp);
+	set_latencies(scenarios[s].spread_us, 0);
+	clear_selection();
+
+	if (!json)
+		printf("%s:\n", scenarios[s].desc);
+
+	initial = select_all(&moved, &by_latency);
+	report(s, "initial", "initial selection", initial, moved, by_latency);
+
+	steady = select_all(&moved, &by_latency);
+	report(s, "steady", "re-run, nothing changed", steady, moved,
+	       by_latency);
+
+	/* Every nexthop's latency moves, as after a round of measurements */
+	set_latencies(scenarios[s].spread_us, nexthops / 3);
+	shifted = select_all(&moved, &by_latency);
+	report(s, "moved", "re-run, latencies moved", shifted, moved,
+	       by_latency);
+
+	if (s == 0)
+		*baseline = steady;
+	else if (*baseline && !json)
+		printf("  steady-state overhead over off: %+.1f%%\n",
+		       100.0 * ((double)steady - *baseline) / *baseline);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t baseline = 0;
+	unsigned int s;
+	as_t asn = 1;
+	int arg = 1;
+
+	if (argc > arg && !strcmp(argv[arg], "-j")) {
+		json = true;
+		arg++;
+	}
+	if (argc > arg)
+		prefixes = strtoul(argv[arg], NULL, 10);
+	if (argc > arg + 1)
+		paths = strtoul(argv[arg + 1], NULL, 10);
+	if (argc > arg + 2)
+		nexthops = strtoul(argv[arg + 2], NULL, 10);
+	if (!prefixes || !paths || nexthops < paths || prefixes > (1U << 24)) {
+		fprintf(stderr,
+			"usage: %s [-j] [prefixes [paths [nexthops]]], with paths <= nexthops\n",
+			argv[0]);
+		return 1;
+	}
+
+	qobj_init();
+	master = event_master_create(NULL);
+	zclient = zclient_new(master, &zclient_options_default, NULL, 0);
+	bgp_master_init(master, BGP_SOCKET_SNDBUF_SIZE, list_new());
+	vrf_init(NULL, NULL, NULL, NULL);
+	bgp_option_set(BGP_OPT_NO_LISTEN);
+
+	bgp = bgp_create_fake(&asn, NULL);
+	rib = bgp->rib[AFI_IP][SAFI_UNICAST];
+	build_peers();
+	build_table();
+
+	if (!json)
+		printf("Best-path over %u prefixes x %u iBGP paths, %u nexthops\n",
+		       prefixes, paths, nexthops);
+	for (s = 0; s < array_size(scenarios); s++)
+		run_scenario(s, &baseline);
+
+	/*
+	 * The table, peers and attributes are not torn down: this only
+	 * measures, and the process exits right away.
+	 */
+	return 0;
+}
@@ -161,7 +161,58 @@ static void test_range_lookup(void)
 		"1.16.32.0/20", "1.16.32.0/21", "16.0.0.0/16", NULL);
 }
 
+/*
+ * test_batch_walk
+ */
+static void test_batch_walk(void)
+{
+	struct bgp_table *table = bgp_table_init(NULL, AFI_IP, SAFI_UNICAST);
+	struct bgp_dest *walked[3 * BGP_DEST_BATCH + 5];
+	unsigned int locks[array_size(walked)];
+	struct bgp_dest_batch batch;
+	struct bgp_dest *dest;
+	char prefix_str[PREFIX_STRLEN];
+	unsigned int i, n;
+
+	printf("Testing bgp_dest_batch\n");
+
+	for (i = 0; i < array_size(walked); i++) {
+		snprintf(prefix_str, sizeof(prefix_str), "10.%u.0.0/16", i);
+		add_node(table, prefix_str);
+	}
+
+	n = 0;
+	for (dest = bgp_table_top(table); dest; dest = bgp_route_next(dest)) {
+		assert(n < array_size(walked));
+		walked[n++] = dest;
+	}
+	assert(n == array_size(walked));
+	for (i = 0; i < n; i++)
+		locks[i] = bgp_dest_get_lock_count(walked[i]);
+
+	/* Same dests in the same order, across several blocks */
+	n = 0;
+	for (dest = bgp_dest_batch_first(&batch, table); dest;
+	     dest = bgp_dest_batch_next(&batch))
+		assert(walked[n++] == dest);
+	assert(n == array_size(walked));
+
+	/* Leaving early gives back every lock */
+	n = 0;
+	for (dest = bgp_dest_batch_first(&batch, table); dest;
+	     dest = bgp_dest_batch_next(&batch))
+		if (++n == BGP_DEST_BATCH + 3)
+			break;
+	bgp_dest_batch_done(&batch);
+
+	for (i = 0; i < array_size(walked); i++)
+		assert(bgp_dest_get_lock_count(walked[i]) == locks[i]);
+
+	printf("Checks successfull\n");
+}
+
 int main(void)
 {
 	test_range_lookup();
+	test_batch_walk();
 }
@@ -5,5 +5,5 @@ class TestTable(frrtest.TestMultiOut):
     program = "./test_bgp_table"
 
 
-for i in range(7):
+for i in range(8):
     TestTable.onesimple("Checks successfull")
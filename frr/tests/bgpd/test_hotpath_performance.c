@@ -0,0 +1,313 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Standard benchmarks of the bgpd and zebra hot paths, for tracking
+ * performance from one commit to the next: attribute interning, table
+ * insert and lookup, ZAPI route encode and decode, and hashing nexthop
+ * groups as zebra does. Best-path is measured by
+ * test_bestpath_performance; tests/run_benchmarks.py runs both.
+ *
+ * Usage: test_hotpath_performance [-j] [count]
+ * With -j every result is printed as one JSON object per line.
+ */
+
+#include <zebra.h>
+
+#include "hash.h"
+#include "memory.h"
+#include "nexthop.h"
+#include "nexthop_group.h"
+#include "privs.h"
+#include "qobj.h"
+#include "stream.h"
+#include "vrf.h"
+#include "zclient.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_network.h"
+#include "bgpd/bgp_table.h"
+
+#define DEFAULT_COUNT 200000
+/* Nexthops per group in the nexthop-group benchmark */
+#define NHG_WIDTH 4
+
+/* need these to link in libbgp */
+struct event_loop *master = NULL;
+extern struct zclient *zclient;
+struct zebra_privs_t bgpd_privs = {
+	.user = NULL,
+	.group = NULL,
+	.vty_group = NULL,
+};
+
+static unsigned int count = DEFAULT_COUNT;
+static bool json;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void report(const char *name, unsigned int ops, uint64_t elapsed)
+{
+	double per_op = ops ? (double)elapsed / ops : 0;
+
+	if (json)
+		printf("{\"benchmark\": \"%s\", \"ops\": %u, \"ns\": %" PRIu64
+		       ", \"ns_per_op\": %.1f}\n",
+		       name, ops, elapsed, per_op);
+	else
+		printf("  %-22s %9u ops %9.3f ms %9.1f ns/op\n", name, ops,
+		       elapsed / 1e6, per_op);
+	fflush(stdout);
+}
+
+static void prefix_nth(struct prefix *p, unsigned int n)
+{
+	memset(p, 0, sizeof(*p));
+	p->family = AF_INET;
+	p->prefixlen = 24;
+	p->u.prefix4.s_addr = htonl((1U << 24) + (n << 8));
+}
+
+/*
+ * Distinct attributes miss the hash, the same ones again hit it, as
+ * with a full table followed by the same routes from another peer.
+ */
+static void bench_attr_intern(void)
+{
+	struct attr **interned;
+	struct attr attr = {};
+	uint64_t start, miss, hit, unintern;
+	unsigned int n;
+
+	interned = XCALLOC(MTYPE_TMP, 2 * count * sizeof(*interned));
+
+	attr.aspath = aspath_empty(ASNOTATION_PLAIN);
+	attr.origin = BGP_ORIGIN_IGP;
+	attr.local_pref = BGP_DEFAULT_LOCAL_PREF;
+	attr.flag = ATTR_FLAG_BIT(BGP_ATTR_ORIGIN) |
+		    ATTR_FLAG_BIT(BGP_ATTR_AS_PATH) |
+		    ATTR_FLAG_BIT(BGP_ATTR_LOCAL_PREF) |
+		    ATTR_FLAG_BIT(BGP_ATTR_MULTI_EXIT_DISC) |
+		    ATTR_FLAG_BIT(BGP_ATTR_NEXT_HOP);
+
+	start = now_ns();
+	for (n = 0; n < count; n++) {
+		attr.med = n;
+		attr.nexthop.s_addr = htonl(0x0a000000 + n % 1024);
+		interned[n] = bgp_attr_intern(&attr);
+	}
+	miss = now_ns() - start;
+
+	start = now_ns();
+	for (n = 0; n < count; n++) {
+		attr.med = n;
+		attr.nexthop.s_addr = htonl(0x0a000000 + n % 1024);
+		interned[count + n] = bgp_attr_intern(&attr);
+	}
+	hit = now_ns() - start;
+
+	start = now_ns();
+	for (n = 0; n < 2 * count; n++)
+		bgp_attr_unintern(&interned[n]);
+	unintern = now_ns() - start;
+
+	report("attr_intern_new", count, miss);
+	report("attr_intern_existing", count, hit);
+	report("attr_unintern", 2 * count, unintern);
+
+	XFREE(MTYPE_TMP, interned);
+}
+
+static void bench_table(void)
+{
+	struct bgp_table *table = bgp_table_init(NULL, AFI_IP, SAFI_UNICAST);
+	struct bgp_dest *dest;
+	struct prefix p;
+	uint64_t start, insert, lookup, walk;
+	unsigned int n, found = 0;
+
+	start = now_ns();
+	for (n = 0; n < count; n++) {
+		prefix_nth(&p, n);
+		dest = bgp_node_get(table, &p);
+		/* Keep it, as a path would */
+		(void)dest;
+	}
+	insert = now_ns() - start;
+
+	start = now_ns();
+	for (n = 0; n < count; n++) {
+		prefix_nth(&p, (n * 2654435761U) % count);
+		dest = bgp_node_lookup(table, &p);
+		if (dest) {
+			found++;
+			bgp_dest_unlock_node(dest);
+		}
+	}
+	lookup = now_ns() - start;
+	assert(found == count);
+
+	n = 0;
+	start = now_ns();
+	for (dest = bgp_table_top(table); dest; dest = bgp_route_next(dest))
+		n++;
+	walk = now_ns() - start;
+
+	report("table_insert", count, insert);
+	report("table_lookup", count, lookup);
+	report("table_walk", n, walk);
+
+	for (n = 0; n < count; n++) {
+		prefix_nth(&p, n);
+		dest = bgp_node_lookup(table, &p);
+		bgp_dest_unlock_node(dest);
+		bgp_dest_unlock_node(dest);
+	}
+	bgp_table_unlock(table);
+}
+
+/* Routes as bgpd sends them: two labelled nexthops and a metric */
+static void bench_zapi_route(void)
+{
+	struct stream *s = stream_new(ZEBRA_MAX_PACKET_SIZ);
+	struct zapi_route api = {}, out;
+	struct zapi_nexthop *api_nh;
+	uint64_t start, encode = 0, decode = 0;
+	unsigned int n, i;
+	int ret;
+
+	api.vrf_id = VRF_DEFAULT;
+	api.type = ZEBRA_ROUTE_BGP;
+	api.safi = SAFI_UNICAST;
+	api.metric = 20;
+	SET_FLAG(api.message, ZAPI_MESSAGE_NEXTHOP);
+	SET_FLAG(api.message, ZAPI_MESSAGE_METRIC);
+	api.nexthop_num = 2;
+	for (i = 0; i < api.nexthop_num; i++) {
+		api_nh = &api.nexthops[i];
+		api_nh->vrf_id = VRF_DEFAULT;
+		api_nh->type = NEXTHOP_TYPE_IPV4;
+		api_nh->gate.ipv4.s_addr = htonl(0x0a000001 + i);
+		SET_FLAG(api_nh->flags, ZAPI_NEXTHOP_FLAG_LABEL);
+		api_nh->label_num = 1;
+		api_nh->labels[0] = 16 + i;
+	}
+
+	for (n = 0; n < count; n++) {
+		prefix_nth(&api.prefix, n);
+
+		start = now_ns();
+		ret = zapi_route_encode(ZEBRA_ROUTE_ADD, s, &api);
+		encode += now_ns() - start;
+		assert(ret == 0);
+
+		/* zebra decodes what follows the header */
+		stream_set_getp(s, ZEBRA_HEADER_SIZE);
+		start = now_ns();
+		ret = zapi_route_decode(s, &out);
+		decode += now_ns() - start;
+		assert(ret == 0 && out.nexthop_num == api.nexthop_num);
+	}
+
+	report("zapi_route_encode", count, encode);
+	report("zapi_route_decode", count, decode);
+
+	stream_free(s);
+}
+
+static unsigned int bench_nhg_key(const void *data)
+{
+	return nexthop_group_hash(data);
+}
+
+static bool bench_nhg_cmp(const void *a, const void *b)
+{
+	return nexthop_group_equal(a, b);
+}
+
+/*
+ * Groups hashed and compared as zebra's nexthop-group hash does, the
+ * groups overlapping as the ECMP sets of a BGP table do.
+ */
+static void bench_nhg_hash(void)
+{
+	struct nexthop_group *groups, *nhg;
+	struct hash *hash;
+	struct in_addr gw;
+	uint64_t start, insert, lookup;
+	unsigned int n, i, groups_num = count / NHG_WIDTH;
+
+	groups = XCALLOC(MTYPE_TMP, groups_num * sizeof(*groups));
+	for (n = 0; n < groups_num; n++)
+		for (i = 0; i < NHG_WIDTH; i++) {
+			gw.s_addr = htonl(0x0a000000 + n + i * groups_num);
+			nexthop_group_add_sorted(&groups[n],
+						 nexthop_from_ipv4(&gw, NULL,
+								   VRF_DEFAULT));
+		}
+
+	hash = hash_create_size(1024, bench_nhg_key, bench_nhg_cmp,
+				"Benchmark nexthop groups");
+
+	start = now_ns();
+	for (n = 0; n < groups_num; n++)
+		(void)hash_get(hash, &groups[n], hash_alloc_intern);
+	insert = now_ns() - start;
+
+	start = now_ns();
+	for (n = 0; n < groups_num; n++) {
+		nhg = hash_lookup(hash, &groups[(n * 2654435761U) %
+						groups_num]);
+		assert(nhg);
+	}
+	lookup = now_ns() - start;
+
+	report("nhg_hash_insert", groups_num, insert);
+	report("nhg_hash_lookup", groups_num, lookup);
+
+	hash_clean_and_free(&hash, NULL);
+	for (n = 0; n < groups_num; n++)
+		nexthops_free(groups[n].nexthop);
+	XFREE(MTYPE_TMP, groups);
+}
+
+int main(int argc, char **argv)
+{
+	int arg = 1;
+
+	if (argc > arg && !strcmp(argv[arg], "-j")) {
+		json = true;
+		arg++;
+	}
+	if (argc > arg)
+		count = strtoul(argv[arg], NULL, 10);
+	if (!count || count > (1U << 24)) {
+		fprintf(stderr, "usage: %s [-j] [count], count <= %u\n",
+			argv[0], 1U << 24);
+		return 1;
+	}
+
+	qobj_init();
+	bgp_attr_init();
+	master = event_master_create(NULL);
+	zclient = zclient_new(master, &zclient_options_default, NULL, 0);
+	bgp_master_init(master, BGP_SOCKET_SNDBUF_SIZE, list_new());
+	vrf_init(NULL, NULL, NULL, NULL);
+	bgp_option_set(BGP_OPT_NO_LISTEN);
+
+	if (!json)
+		printf("Hot paths over %u items\n", count);
+
+	bench_attr_intern();
+	bench_table();
+	bench_zapi_route();
+	bench_nhg_hash();
+
+	return 0;
+}
@@ -0,0 +1,255 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Measures how fast bgpd reads latencies out of the TWAMP shared-memory
+ * segment: lookups per second and the latency distribution of a single
+ * lookup, for several segment sizes and with agent threads publishing
+ * measurements at the same time.
+ *
+ * The segment lives in ordinary memory here, laid out and filled in the
+ * same way bgpd does it, so only the index and the seqlock are measured.
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "bgpd/bgp_twamp_ipc.h"
+
+#define LOOKUPS 1000000
+#define MAX_WRITERS 4
+
+static const uint32_t sizes[] = { 16, 1024, 8192 };
+
+static const struct {
+	unsigned int writers;
+	/* Publications per second per writer, 0 for as fast as possible */
+	unsigned int rate;
+} loads[] = {
+	{ 0, 0 }, { 1, 1000 }, { 1, 0 }, { MAX_WRITERS, 1000 },
+	{ MAX_WRITERS, 0 },
+};
+
+struct writer {
+	pthread_t thread;
+	struct twamp_shm *shm;
+	uint32_t count;
+	unsigned int rate;
+	unsigned int seed;
+	uint64_t published;
+};
+
+static volatile int stop_writers;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void nexthop_key(uint32_t n, struct in6_addr *key)
+{
+	twamp_addr_from_ipv4(key, htonl(0x0a000000 + n));
+}
+
+/* Same probing as bgp_twamp_index_insert() */
+static void index_insert(struct twamp_shm *shm, uint32_t slot)
+{
+	const struct twamp_nexthop *ent = &twamp_shm_nexthops_c(shm)[slot];
+	struct twamp_hash_bucket *index = twamp_shm_index(shm);
+	uint32_t mask = shm->hdr.hash_size - 1;
+	uint32_t tag = twamp_addr_tag(&ent->addr, ent->vrf_ifindex);
+	uint32_t b = twamp_hash_tag(tag, shm->hdr.hash_size);
+
+	while (index[b].slot != 0)
+		b = (b + 1) & mask;
+	index[b].tag = tag;
+	index[b].slot = slot + 1;
+}
+
+static struct twamp_shm *segment_new(uint32_t count)
+{
+	struct twamp_shm_hdr hdr;
+	struct twamp_nexthop *nexthops;
+	struct twamp_shm *shm;
+	uint32_t n;
+
+	twamp_shm_layout(&hdr, twamp_capacity_for(count));
+	if (posix_memalign((void **)&shm, TWAMP_CACHELINE, hdr.total_size))
+		return NULL;
+	memset(shm, 0, hdr.total_size);
+	twamp_shm_hdr_init(shm, hdr.capacity);
+	pthread_mutex_init(&shm->writer_lock, NULL);
+
+	nexthops = twamp_shm_nexthops(shm);
+	for (n = 0; n < count; n++) {
+		nexthop_key(n, &nexthops[n].addr);
+		nexthops[n].epoch = 1;
+		nexthops[n].active = 1;
+		index_insert(shm, n);
+		twamp_shm_publish(shm, n, 1, 1000 + n, 100, 0, 0, 1, time(NULL));
+	}
+	shm->nh_count = count;
+
+	return shm;
+}
+
+static void segment_free(struct twamp_shm *shm)
+{
+	pthread_mutex_destroy(&shm->writer_lock);
+	free(shm);
+}
+
+/* bgp_twamp_key_latency() without the bgpd state around it */
+static uint32_t key_latency(const struct twamp_shm *shm,
+			    const struct in6_addr *key)
+{
+	const struct twamp_nexthop *ent;
+	uint32_t latency;
+	uint8_t measured;
+	int64_t last_updated;
+	int i;
+
+	i = twamp_shm_find(shm, key, 0);
+	if (i < 0)
+		return UINT32_MAX;
+
+	ent = &twamp_shm_nexthops_c(shm)[i];
+	if (!ent->active ||
+	    twamp_nexthop_read(ent, &latency, &measured, &last_updated) < 0 ||
+	    !measured)
+		return UINT32_MAX;
+
+	return latency;
+}
+
+/* An agent publishing rounds for random slots, one per lock like it does */
+static void *writer_main(void *arg)
+{
+	struct writer *w = arg;
+	uint64_t next = now_ns(), gap = w->rate ? 1000000000ULL / w->rate : 0;
+	struct timespec ts;
+	uint32_t slot;
+
+	while (!stop_writers) {
+		slot = rand_r(&w->seed) % w->count;
+		twamp_shm_writer_lock(w->shm);
+		twamp_shm_publish(w->shm, slot, 1, 1000 + (slot ^ w->published),
+				  100, 0, 0, 1, time(NULL));
+		twamp_shm_writer_unlock(w->shm);
+		w->published++;
+
+		if (!gap)
+			continue;
+		next += gap;
+		ts.tv_sec = next / 1000000000ULL;
+		ts.tv_nsec = next % 1000000000ULL;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	}
+
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void run(uint32_t count, unsigned int writers, unsigned int rate,
+		uint64_t *samples, struct in6_addr *keys)
+{
+	struct writer w[MAX_WRITERS] = {};
+	struct twamp_shm *shm = segment_new(count);
+	uint64_t start, elapsed, sum = 0, published = 0;
+	unsigned int i, gave_up = 0;
+	char load[32];
+
+	if (!shm) {
+		fprintf(stderr, "Cannot allocate a segment for %u nexthops\n",
+			count);
+		exit(1);
+	}
+
+	stop_writers = 0;
+	for (i = 0; i < writers; i++) {
+		w[i].shm = shm;
+		w[i].count = count;
+		w[i].rate = rate;
+		w[i].seed = i + 1;
+		pthread_create(&w[i].thread, NULL, writer_main, &w[i]);
+	}
+
+	/* Lookup order is random, so the index is not read sequentially */
+	for (i = 0; i < LOOKUPS; i++)
+		nexthop_key(random() % count, &keys[i]);
+
+	/* Throughput, without the clock in the loop */
+	start = now_ns();
+	for (i = 0; i < LOOKUPS; i++)
+		sum += key_latency(shm, &keys[i]);
+	elapsed = now_ns() - start;
+
+	/*
+	 * Then each lookup on its own, for the tail. These figures include
+	 * the two clock reads around it.
+	 */
+	for (i = 0; i < LOOKUPS; i++) {
+		start = now_ns();
+		/* Only a seqlock read running out of retries fails here */
+		if (key_latency(shm, &keys[i]) == UINT32_MAX)
+			gave_up++;
+		samples[i] = now_ns() - start;
+	}
+
+	stop_writers = 1;
+	for (i = 0; i < writers; i++) {
+		pthread_join(w[i].thread, NULL);
+		published += w[i].published;
+	}
+	segment_free(shm);
+
+	qsort(samples, LOOKUPS, sizeof(*samples), cmp_u64);
+
+	if (!writers)
+		snprintf(load, sizeof(load), "no writers");
+	else if (rate)
+		snprintf(load, sizeof(load), "%u x %u/s", writers, rate);
+	else
+		snprintf(load, sizeof(load), "%u x unthrottled", writers);
+
+	printf("%5u nexthops, %-16s %6.1f M lookups/s  p50 %4" PRIu64
+	       " ns  p99 %5" PRIu64 " ns  p99.9 %6" PRIu64 " ns  max %8" PRIu64
+	       " ns  (%u gave up, %" PRIu64 " publications)\n",
+	       count, load, LOOKUPS * 1000.0 / MAX(elapsed, 1),
+	       samples[LOOKUPS / 2], samples[LOOKUPS / 100 * 99],
+	       samples[LOOKUPS / 1000 * 999],
+	       samples[LOOKUPS - 1], gave_up, published);
+	fflush(stdout);
+
+	/* Keep the throughput loop from being optimized away */
+	if (sum == 0)
+		printf("no latency read\n");
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t *samples = calloc(LOOKUPS, sizeof(*samples));
+	struct in6_addr *keys = calloc(LOOKUPS, sizeof(*keys));
+	unsigned int s, l;
+
+	srandom(0);
+
+	for (s = 0; s < array_size(sizes); s++)
+		for (l = 0; l < array_size(loads); l++)
+			run(sizes[s], loads[l].writers, loads[l].rate, samples,
+			    keys);
+
+	free(keys);
+	free(samples);
+	return 0;
+}
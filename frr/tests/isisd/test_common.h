@@ -64,6 +64,12 @@ extern int test_topology_load(const struct isis_topology *topology,
 			      struct isis_area *area,
 			      struct lspdb_head lspdb[]);
 
+/* Generated grids, for benchmarking rather than for checking output. */
+#define TEST_GRID_MAX_NODES 65536
+extern void test_topology_grid_sysid(uint8_t *sysid, unsigned int n);
+extern int test_topology_load_grid(unsigned int side, struct isis_area *area,
+				   struct lspdb_head lspdb[]);
+
 /* Global variables. */
 extern struct event_loop *master;
 extern struct zebra_privs_t isisd_privs;
@@ -452,6 +452,74 @@ DEFUN(test_isis, test_isis_cmd,
 			fail_sysid_str, fail_pseudonode_id);
 }
 
+/*
+ * Not part of the reference output, as timings vary from run to run:
+ * "echo 'test isis spf-benchmark grid 32' | ./test_isis_spf" reports the
+ * mean SPF time for a 32x32 grid.
+ */
+DEFUN(test_isis_spf_benchmark, test_isis_spf_benchmark_cmd,
+      "test isis spf-benchmark grid (2-256) [runs (1-10000)]",
+      "Test command\n"
+      "IS-IS routing protocol\n"
+      "Time SPF runs over a generated topology\n"
+      "Square grid of routers\n"
+      "Routers per side\n"
+      "Number of SPF runs\n"
+      "Number of SPF runs\n")
+{
+	unsigned int side, runs = 10;
+	uint8_t root_sysid[ISIS_SYS_ID_LEN];
+	struct isis_spftree *spftree;
+	struct isis_area *area;
+	struct timeval start;
+	uint64_t total = 0, best = UINT64_MAX, elapsed;
+	unsigned long debug_spf = debug_spf_events;
+	int idx = 0;
+
+	argv_find(argv, argc, "grid", &idx);
+	side = strtoul(argv[idx + 1]->arg, NULL, 10);
+	if (argv_find(argv, argc, "runs", &idx))
+		runs = strtoul(argv[idx + 1]->arg, NULL, 10);
+
+	/* Root in a corner, so that the tree is as deep as the grid allows */
+	test_topology_grid_sysid(root_sysid, 0);
+	area = isis_area_create("1", NULL);
+	memcpy(area->isis->sysid, root_sysid, sizeof(area->isis->sysid));
+	area->is_type = IS_LEVEL_1;
+	if (test_topology_load_grid(side, area, area->lspdb) != 0) {
+		vty_out(vty, "%% Failed to load topology\n");
+		isis_area_destroy(area);
+		return CMD_WARNING;
+	}
+
+	/* Leave debug logging out of the timings */
+	debug_spf_events = 0;
+	for (unsigned int i = 0; i < runs; i++) {
+		spftree = isis_spftree_new(area, &area->lspdb[IS_LEVEL_1 - 1],
+					   root_sysid, IS_LEVEL_1,
+					   SPFTREE_IPV4, SPF_TYPE_FORWARD,
+					   F_SPFTREE_NO_ADJACENCIES,
+					   SR_ALGORITHM_SPF);
+		monotime(&start);
+		isis_run_spf(spftree);
+		elapsed = monotime_since(&start, NULL);
+		isis_spftree_del(spftree);
+
+		total += elapsed;
+		best = MIN(best, elapsed);
+	}
+	debug_spf_events = debug_spf;
+
+	vty_out(vty,
+		"grid %ux%u (%u nodes): %" PRIu64 " usec mean, %" PRIu64
+		" usec best over %u runs\n",
+		side, side, side * side, total / runs, best, runs);
+
+	isis_area_destroy(area);
+
+	return CMD_SUCCESS;
+}
+
 static void vty_do_exit(int isexit)
 {
 	printf("\nend.\n");
@@ -548,6 +616,7 @@ int main(int argc, char **argv)
 
 	/* Install test command. */
 	install_element(VIEW_NODE, &test_isis_cmd);
+	install_element(VIEW_NODE, &test_isis_spf_benchmark_cmd);
 
 	/* Read input from .in file. */
 	vty_stdio(vty_do_exit);
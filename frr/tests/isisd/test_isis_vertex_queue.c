@@ -96,11 +96,58 @@ static void test_ordered(void)
 	isis_vertex_queue_free(&q);
 }
 
+/* Enough vertices to grow the heap several levels and resize it */
+static void test_ordered_many(void)
+{
+	struct isis_spftree t = {
+	};
+	struct isis_vertex_queue q;
+	struct isis_vertex *vertex, *prev = NULL;
+	uint8_t node_id[7] = {};
+	size_t count = 1000, popped = 0;
+	struct isis_vertex **many;
+
+	many = XMALLOC(MTYPE_TMP, sizeof(*many) * count);
+	isis_vertex_queue_init(&q, NULL, true);
+	for (size_t i = 0; i < count; i++) {
+		node_id[4] = i >> 8;
+		node_id[5] = i & 0xff;
+		many[i] = isis_vertex_new(&t, node_id, VTYPE_NONPSEUDO_TE_IS);
+		many[i]->d_N = (i * 7919) % 97;
+		isis_vertex_queue_insert(&q, many[i]);
+	}
+
+	/* Take out every third from wherever it sits in the heap */
+	for (size_t i = 0; i < count; i += 3) {
+		isis_vertex_queue_delete(&q, many[i]);
+		isis_vertex_del(many[i]);
+		many[i] = NULL;
+	}
+
+	while ((vertex = isis_vertex_queue_pop(&q))) {
+		if (prev)
+			assert(isis_vertex_queue_tent_cmp(prev, vertex) < 0);
+		if (prev)
+			isis_vertex_del(prev);
+		prev = vertex;
+		popped++;
+	}
+	if (prev)
+		isis_vertex_del(prev);
+
+	assert(popped == count - (count + 2) / 3);
+	assert(isis_vertex_queue_count(&q) == 0);
+
+	isis_vertex_queue_free(&q);
+	XFREE(MTYPE_TMP, many);
+}
+
 int main(int argc, char **argv)
 {
 	setup_test_vertices();
 	test_ordered();
 	cleanup_test_vertices();
+	test_ordered_many();
 
 	return 0;
 }
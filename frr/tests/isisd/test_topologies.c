@@ -7,6 +7,9 @@
 #include <zebra.h>
 
 #include "isisd/isisd.h"
+#include "isisd/isis_lsp.h"
+#include "isisd/isis_mt.h"
+#include "isisd/isis_tlvs.h"
 
 #include "test_common.h"
 
@@ -3472,3 +3475,86 @@ struct isis_topology test_topologies[] = {
 		/* sentinel */
 	},
 };
+
+/*
+ * Square grids of side x side L1 routers, IPv4 only, for the SPF benchmark.
+ * Router N (counting row by row from 0) has System-ID 0000.0001.NNNN and
+ * advertises 10.X.Y.0/24 with X.Y being N. Link metrics are the same in both
+ * directions and vary from link to link, which keeps equal-cost paths rare.
+ * These grids are far larger than struct isis_topology allows, so their LSPs
+ * are built directly.
+ */
+void test_topology_grid_sysid(uint8_t *sysid, unsigned int n)
+{
+	memset(sysid, 0, ISIS_SYS_ID_LEN);
+	sysid[3] = 0x01;
+	sysid[4] = n >> 8;
+	sysid[5] = n & 0xff;
+}
+
+static uint32_t test_topology_grid_metric(unsigned int a, unsigned int b)
+{
+	unsigned int lo = MIN(a, b), hi = MAX(a, b);
+
+	return 10 + (lo * 31 + hi * 17) % 90;
+}
+
+static void test_topology_grid_link(struct isis_lsp *lsp, unsigned int n,
+				    unsigned int neigh)
+{
+	uint8_t nodeid[ISIS_SYS_ID_LEN + 1];
+
+	test_topology_grid_sysid(nodeid, neigh);
+	LSP_PSEUDO_ID(nodeid) = 0;
+	isis_tlvs_add_extended_reach(lsp->tlvs, ISIS_MT_IPV4_UNICAST, nodeid,
+				     test_topology_grid_metric(n, neigh), NULL);
+}
+
+int test_topology_load_grid(unsigned int side, struct isis_area *area,
+			    struct lspdb_head lspdb[])
+{
+	struct sr_prefix_cfg *pcfg_p[SR_ALGORITHM_COUNT] = {NULL};
+	struct nlpids nlpids = {.count = 1, .nlpids = {NLPID_IP}};
+
+	if (!side || side * side > TEST_GRID_MAX_NODES)
+		return -1;
+
+	for (int level = IS_LEVEL_1; level <= IS_LEVEL_2; level++)
+		lsp_db_init(&lspdb[level - 1]);
+
+	for (unsigned int n = 0; n < side * side; n++) {
+		unsigned int row = n / side, col = n % side;
+		uint8_t lspid[ISIS_SYS_ID_LEN + 2];
+		struct prefix_ipv4 prefix = {
+			.family = AF_INET,
+			.prefixlen = 24,
+		};
+		struct isis_lsp *lsp;
+
+		test_topology_grid_sysid(lspid, n);
+		LSP_PSEUDO_ID(lspid) = 0;
+		LSP_FRAGMENT(lspid) = 0;
+		lsp = lsp_new(area, lspid, 6000, 1, 0, 0, NULL, IS_LEVEL_1);
+		lsp->tlvs = isis_alloc_tlvs();
+		lspdb_add(&lspdb[IS_LEVEL_1 - 1], lsp);
+
+		isis_tlvs_add_mt_router_info(lsp->tlvs, ISIS_MT_IPV4_UNICAST, 0,
+					     false);
+		isis_tlvs_set_protocols_supported(lsp->tlvs, &nlpids);
+
+		prefix.prefix.s_addr = htonl(0x0a000000 | (n << 8));
+		isis_tlvs_add_extended_ip_reach(lsp->tlvs, &prefix, 10, false,
+						pcfg_p);
+
+		if (row > 0)
+			test_topology_grid_link(lsp, n, n - side);
+		if (row < side - 1)
+			test_topology_grid_link(lsp, n, n + side);
+		if (col > 0)
+			test_topology_grid_link(lsp, n, n - 1);
+		if (col < side - 1)
+			test_topology_grid_link(lsp, n, n + 1);
+	}
+
+	return 0;
+}
@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Hash table tests: growing and shrinking, with lookups, releases and
+ * walks in the middle of a resize.
+ */
+#include <zebra.h>
+
+#include "hash.h"
+#include "memory.h"
+
+#define ELEMS 4096
+#define MIN_SIZE 8
+
+struct elem {
+	unsigned int val;
+	bool present;
+};
+
+static struct elem elems[ELEMS];
+
+static unsigned int elem_key(const void *arg)
+{
+	const struct elem *e = arg;
+
+	return e->val * 2654435761U;
+}
+
+static bool elem_cmp(const void *a, const void *b)
+{
+	const struct elem *ea = a, *eb = b;
+
+	return ea->val == eb->val;
+}
+
+static void chain_check(struct hash_bucket *hb, unsigned int *n,
+			unsigned int *empty, unsigned int *ssq)
+{
+	struct hash_bucket *head = hb;
+	int len = 0;
+
+	if (!hb) {
+		(*empty)++;
+		return;
+	}
+	for (; hb; hb = hb->next) {
+		assert(((struct elem *)hb->data)->present);
+		len++;
+	}
+	assert(head->len == len);
+	*n += len;
+	*ssq += len * len;
+}
+
+/*
+ * Both indexes together hold exactly the elements present, the count and
+ * the chain statistics agree with them, and each element can be looked up
+ */
+static void check_table(struct hash *hash)
+{
+	unsigned int i, n = 0, empty = 0, ssq = 0;
+
+	for (i = 0; i < hash->size; i++)
+		chain_check(hash->index[i], &n, &empty, &ssq);
+	if (hash->old_index)
+		for (i = hash->rehash_pos; i < hash->old_size; i++)
+			chain_check(hash->old_index[i], &n, &empty, &ssq);
+
+	assert(n == hash->count);
+	assert(empty == hash->stats.empty);
+	assert(ssq == hash->stats.ssq);
+
+	for (i = 0; i < ELEMS; i++)
+		assert((hash_lookup(hash, &elems[i]) == &elems[i]) ==
+		       elems[i].present);
+}
+
+static void insert(struct hash *hash, struct elem *e)
+{
+	assert(hash_get(hash, e, hash_alloc_intern) == e);
+	e->present = true;
+}
+
+static void release(struct hash *hash, struct elem *e)
+{
+	assert(hash_release(hash, e) == e);
+	e->present = false;
+	assert(!hash_lookup(hash, e));
+}
+
+/* An element still waiting on the old index to be moved over */
+static struct elem *old_elem(struct hash *hash)
+{
+	unsigned int i;
+
+	for (i = hash->rehash_pos; i < hash->old_size; i++)
+		if (hash->old_index[i])
+			return hash->old_index[i]->data;
+	return NULL;
+}
+
+static void count_iter(struct hash_bucket *hb, void *arg)
+{
+	(*(unsigned int *)arg)++;
+}
+
+static void release_odd_iter(struct hash_bucket *hb, void *arg)
+{
+	struct hash *hash = arg;
+	struct elem *e = hb->data;
+
+	if (e->val % 2)
+		release(hash, e);
+}
+
+/*
+ * In the middle of a resize: the walk sees every element, and an element
+ * on the old index can be released and put back
+ */
+static void check_resizing(struct hash *hash)
+{
+	unsigned int seen = 0;
+	struct elem *e;
+
+	check_table(hash);
+
+	e = old_elem(hash);
+	if (e) {
+		release(hash, e);
+		check_table(hash);
+		insert(hash, e);
+		check_table(hash);
+	}
+
+	/* The walk finishes the move first and sees every element */
+	if (hash->old_index) {
+		hash_iterate(hash, count_iter, &seen);
+		assert(seen == hash->count);
+		assert(!hash->old_index);
+		check_table(hash);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct hash *hash;
+	unsigned int i, size, grows = 0, shrinks = 0;
+
+	for (i = 0; i < ELEMS; i++)
+		elems[i].val = i;
+
+	printf("Validating growth...\n");
+	hash = hash_create_size(MIN_SIZE, elem_key, elem_cmp, "test");
+	for (i = 0; i < ELEMS; i++) {
+		insert(hash, &elems[i]);
+		if (hash->old_index) {
+			grows++;
+			check_resizing(hash);
+		} else if (i % 61 == 0)
+			check_table(hash);
+	}
+	assert(grows);
+	assert(hash->size > MIN_SIZE);
+	check_table(hash);
+
+	printf("Validating release from a walk...\n");
+	size = hash->size;
+	hash_iterate(hash, release_odd_iter, hash);
+	assert(hash->size == size);
+	assert(hash->count == ELEMS / 2);
+	check_table(hash);
+
+	printf("Validating shrinking...\n");
+	for (i = 0; i < ELEMS; i += 2) {
+		release(hash, &elems[i]);
+		if (hash->old_index) {
+			shrinks++;
+			check_resizing(hash);
+		} else if (i % 61 == 0)
+			check_table(hash);
+	}
+	assert(shrinks);
+	assert(hash->count == 0);
+	hash_rehash_complete(hash);
+	assert(hash->size == MIN_SIZE);
+	check_table(hash);
+	hash_free(hash);
+
+	printf("Validating max_size...\n");
+	hash = hash_create_size(MIN_SIZE, elem_key, elem_cmp, "test max");
+	hash->max_size = 64;
+	for (i = 0; i < ELEMS; i++)
+		insert(hash, &elems[i]);
+	hash_rehash_complete(hash);
+	assert(hash->size == 64);
+	check_table(hash);
+
+	printf("Validating clean during a resize...\n");
+	hash_clean(hash, NULL);
+	for (i = 0; i < ELEMS; i++)
+		elems[i].present = false;
+	hash->max_size = 0;
+	for (i = 0; i < ELEMS && !hash->old_index; i++)
+		insert(hash, &elems[i]);
+	assert(hash->old_index);
+	hash_clean(hash, NULL);
+	for (i = 0; i < ELEMS; i++)
+		elems[i].present = false;
+	assert(!hash->old_index);
+	assert(hash->count == 0);
+	assert(hash->stats.empty == hash->size);
+	assert(hash->stats.ssq == 0);
+	check_table(hash);
+	hash_free(hash);
+
+	printf("Hash test successful.\n");
+	return 0;
+}
@@ -7,6 +7,7 @@
 
 DEFINE_MGROUP(TEST_MEMORY, "memory test");
 DEFINE_MTYPE_STATIC(TEST_MEMORY, TEST, "generic test mtype");
+DEFINE_MTYPE_STATIC(TEST_MEMORY, TEST_POOLED, "pooled test mtype");
 
 /* Memory torture tests
  *
@@ -30,6 +31,84 @@ struct event_loop *master;
 
 #define TIMES 10
 
+#define POOLED 2000
+
+static void *pooled_thread(void *arg)
+{
+	void *a[POOLED];
+	int i;
+
+	for (i = 0; i < POOLED; i++)
+		a[i] = XMALLOC(MTYPE_TEST_POOLED, 24);
+	for (i = 0; i < POOLED; i++)
+		XFREE(MTYPE_TEST_POOLED, a[i]);
+	return NULL;
+}
+
+static void test_pooled(void)
+{
+	static void *a[POOLED];
+	size_t slabs, bytes, slabs2;
+	pthread_t thread;
+	char *s;
+	int i, j;
+
+	printf("pooled\n\n");
+
+	assert(qmem_pool_enable(MTYPE_TEST_POOLED));
+	/* too late for one in use */
+	a[0] = XMALLOC(MTYPE_TEST, 16);
+	assert(!qmem_pool_enable(MTYPE_TEST));
+	XFREE(MTYPE_TEST, a[0]);
+
+	/* all sizes, small to past the largest class */
+	for (i = 0; i < POOLED; i++) {
+		a[i] = XCALLOC(MTYPE_TEST_POOLED, i);
+		assert(((uintptr_t)a[i] & 15) == 0);
+		for (j = 0; j < i; j++)
+			assert(((char *)a[i])[j] == 0);
+		memset(a[i], i & 0xff, i);
+	}
+	assert(mtype_stats_alloc(MTYPE_TEST_POOLED) == POOLED);
+	for (i = 0; i < POOLED; i++)
+		for (j = 0; j < i; j++)
+			assert(((unsigned char *)a[i])[j] == (i & 0xff));
+
+	/* grow and shrink, keeping the contents */
+	for (i = 1; i < POOLED; i += 7) {
+		a[i] = XREALLOC(MTYPE_TEST_POOLED, a[i], i * 2);
+		for (j = 0; j < i; j++)
+			assert(((unsigned char *)a[i])[j] == (i & 0xff));
+		a[i] = XREALLOC(MTYPE_TEST_POOLED, a[i], i / 2);
+		for (j = 0; j < i / 2; j++)
+			assert(((unsigned char *)a[i])[j] == (i & 0xff));
+	}
+	for (i = 0; i < POOLED; i++)
+		XFREE(MTYPE_TEST_POOLED, a[i]);
+	assert(mtype_stats_alloc(MTYPE_TEST_POOLED) == 0);
+
+	s = XSTRDUP(MTYPE_TEST_POOLED, "pooled string");
+	assert(!strcmp(s, "pooled string"));
+	XFREE(MTYPE_TEST_POOLED, s);
+
+	/* freed objects are reused, not carved again */
+	pooled_thread(NULL);
+	qmem_pool_stats(&slabs, &bytes);
+	assert(slabs && bytes);
+	pooled_thread(NULL);
+	qmem_pool_stats(&slabs2, &bytes);
+	assert(slabs2 == slabs);
+
+	/* and a pthread's cache goes back as it exits */
+	pthread_create(&thread, NULL, pooled_thread, NULL);
+	pthread_join(thread, NULL);
+	pthread_create(&thread, NULL, pooled_thread, NULL);
+	pthread_join(thread, NULL);
+	qmem_pool_stats(&slabs2, &bytes);
+	assert(slabs2 == slabs);
+	assert(mtype_stats_alloc(MTYPE_TEST_POOLED) == 0);
+}
+
 int main(int argc, char **argv)
 {
 	void *a[10];
@@ -102,5 +181,7 @@ int main(int argc, char **argv)
 		XFREE(MTYPE_TEST, a[2]);
 		/* alloc == 0, cache valid next request */
 	}
+
+	test_pooled();
 	return 0;
 }
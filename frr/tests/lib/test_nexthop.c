@@ -7,6 +7,7 @@
 
 #include <zebra.h>
 #include <nexthop.h>
+#include <nexthop_group.h>
 
 static bool verbose;
 
@@ -177,10 +178,61 @@ static void test_run_first(void)
 	nexthop_free(nh2);
 }
 
+static void test_run_array(void)
+{
+	struct nexthop_group nhg1 = {}, nhg2 = {};
+	struct nexthop *a1, *a2, *nh;
+	struct in_addr addr;
+	int i, n;
+
+	/* Wide ECMP, as flattened for hashing and compares */
+	addr.s_addr = 0x04030201;
+	for (i = 0; i < 64; i++) {
+		addr.s_addr += htonl(1);
+		nexthop_group_add_sorted(&nhg1,
+					 nexthop_from_ipv4(&addr, NULL, 0));
+		nexthop_group_add_sorted(&nhg2,
+					 nexthop_from_ipv4(&addr, NULL, 0));
+	}
+
+	a1 = nexthop_group_to_array(&nhg1);
+	a2 = nexthop_group_to_array(&nhg2);
+	assert(darr_len(a1) == 64);
+
+	n = 0;
+	for (ALL_NEXTHOPS_ARRAY(a1, nh)) {
+		assert(!nh->next && !nh->prev);
+		n++;
+	}
+	assert(n == 64);
+
+	assert(nexthop_array_hash(a1) == nexthop_group_hash(&nhg1));
+	assert(nexthop_array_equal(a1, a2));
+	assert(nexthop_group_equal(&nhg1, &nhg2));
+
+	/* One more nexthop on one side only */
+	nexthop_array_free(&a2);
+	addr.s_addr += htonl(1);
+	nexthop_group_add_sorted(&nhg2,
+				 nexthop_from_ipv4(&addr, NULL, 0));
+	a2 = nexthop_group_to_array(&nhg2);
+
+	assert(!nexthop_array_equal(a1, a2));
+	assert(!nexthop_group_equal(&nhg1, &nhg2));
+	assert(!nexthop_group_equal(&nhg2, &nhg1));
+
+	nexthop_array_free(&a1);
+	nexthop_array_free(&a2);
+	assert(!a1 && !a2);
+	nexthops_free(nhg1.nexthop);
+	nexthops_free(nhg2.nexthop);
+}
+
 int main(int argc, char **argv)
 {
 	if (argc >= 2 && !strcmp("-v", argv[1]))
 		verbose = true;
 	test_run_first();
+	test_run_array();
 	printf("Simple test passed.\n");
 }
@@ -172,6 +172,43 @@ int main(int argc, char **argv)
 	printf("Deleting...\n");
 	ringbuf_del(soil);
 
+	/* validate views, which only exist for data that does not wrap */
+	printf("Validating view...\n");
+	soil = ringbuf_new(8);
+	soil->start = soil->end = 5;
+	assert(ringbuf_put(soil, "blossoms", 8) == 8);
+	assert(!memcmp(ringbuf_view(soil, 0, 3), "blo", 3));
+	assert(!memcmp(ringbuf_view(soil, 4, 4), "soms", 4));
+	assert(ringbuf_view(soil, 2, 2) == NULL);
+	assert(ringbuf_view(soil, 6, 3) == NULL);
+
+	/* validate skip */
+	printf("Validating skip...\n");
+	assert(ringbuf_skip(soil, 3) == 3);
+	validate_state(soil, 8, 5);
+	assert(!memcmp(ringbuf_view(soil, 0, 5), "ssoms", 5));
+	assert(ringbuf_skip(soil, 10) == 5);
+	validate_state(soil, 8, 0);
+
+	/* validate read from a descriptor across ring boundary */
+	printf("Validating fd read...\n");
+	int fds[2];
+	char bark[9] = {};
+
+	assert(pipe(fds) == 0);
+	soil->start = soil->end = 6;
+	assert(write(fds[1], "cambium", 7) == 7);
+	assert(ringbuf_read(soil, fds[0], 100) == 7);
+	validate_state(soil, 8, 7);
+	assert(soil->end == 5);
+	assert(ringbuf_get(soil, bark, sizeof(bark)) == 7);
+	assert(!strcmp(bark, "cambium"));
+	close(fds[0]);
+	close(fds[1]);
+
+	printf("Deleting...\n");
+	ringbuf_del(soil);
+
 	printf("Done.\n");
 	return 0;
 }
@@ -33,7 +33,7 @@ static void print_stream(struct stream *s)
 
 int main(void)
 {
-	struct stream *s;
+	struct stream *s, *v, *w;
 
 	s = stream_new(1024);
 
@@ -53,5 +53,16 @@ int main(void)
 	printfrr("l: 0x%x\n", stream_getl(s));
 	printfrr("q: 0x%" PRIx64 "\n", stream_getq(s));
 
+	/* Views share the data, which outlives the stream they came from */
+	v = stream_slice(s, 1, 2);
+	w = stream_share(s);
+	printfrr("shared: %d %d\n", stream_is_shared(s), stream_is_shared(v));
+	stream_free(s);
+
+	print_stream(v);
+	print_stream(w);
+	stream_free(w);
+	stream_free(v);
+
 	return 0;
 }
@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+"""
+Usage: run_benchmarks.py [--output FILE] [--baseline FILE] [--threshold PCT]
+                         [--repeat N] program [args]...
+
+Runs the benchmark programs ("make bench" passes the ones built), each
+with -j so that it prints one JSON object per result, and collects the
+results into one JSON document together with the commit they were taken
+at. The document of an earlier run can be given as the baseline: every
+benchmark more than threshold percent slower per operation is reported,
+and the exit status is then 1, so a CI job can keep the document of the
+parent commit around and fail on regressions.
+
+Each program is run repeat times and the fastest run of every benchmark
+kept, which is what is least disturbed by the rest of the machine.
+"""
+
+import argparse
+import datetime
+import json
+import os
+import platform
+import shlex
+import subprocess
+import sys
+
+
+def git_commit():
+    try:
+        return subprocess.check_output(
+            ["git", "rev-parse", "HEAD"],
+            cwd=os.path.dirname(os.path.abspath(__file__)),
+            stderr=subprocess.DEVNULL,
+            text=True,
+        ).strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def run_program(cmdline):
+    """
+    results of one run of a benchmark program, by benchmark name
+    """
+    argv = shlex.split(cmdline)
+    argv.insert(1, "-j")
+    proc = subprocess.run(argv, stdout=subprocess.PIPE, text=True, check=False)
+    if proc.returncode:
+        sys.exit("%s failed with status %d" % (cmdline, proc.returncode))
+
+    results = {}
+    for line in proc.stdout.splitlines():
+        line = line.strip()
+        if not line.startswith("{"):
+            continue
+        result = json.loads(line)
+        result["program"] = os.path.basename(argv[0])
+        results[result.pop("benchmark")] = result
+    return results
+
+
+def compare(results, baseline, threshold, out):
+    """
+    print how every benchmark moved, return the regressed ones
+    """
+    regressed = []
+    print(
+        "%-44s %12s %12s %8s" % ("Benchmark", "Base ns/op", "ns/op", "Change"),
+        file=out,
+    )
+    for name in sorted(results):
+        new = results[name]["ns_per_op"]
+        if name not in baseline or not baseline[name]["ns_per_op"]:
+            print("%-44s %12s %12.1f %8s" % (name, "-", new, "new"), file=out)
+            continue
+        old = baseline[name]["ns_per_op"]
+        change = 100.0 * (new - old) / old
+        mark = ""
+        if change > threshold:
+            regressed.append(name)
+            mark = " <-"
+        print(
+            "%-44s %12.1f %12.1f %+7.1f%%%s" % (name, old, new, change, mark),
+            file=out,
+        )
+    return regressed
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Run the FRR benchmarks")
+    parser.add_argument("--output", help="write the results there")
+    parser.add_argument("--baseline", help="results to compare against")
+    parser.add_argument(
+        "--threshold",
+        type=float,
+        default=10.0,
+        help="slow-down per operation that counts as a regression, in percent",
+    )
+    parser.add_argument(
+        "--repeat", type=int, default=3, help="runs of each program"
+    )
+    parser.add_argument(
+        "programs", nargs="+", help="benchmark programs, with their arguments"
+    )
+    args = parser.parse_args()
+
+    results = {}
+    for program in args.programs:
+        for _ in range(max(1, args.repeat)):
+            for name, result in run_program(program).items():
+                if (
+                    name not in results
+                    or result["ns_per_op"] < results[name]["ns_per_op"]
+                ):
+                    results[name] = result
+
+    document = {
+        "commit": os.environ.get("BENCH_COMMIT") or git_commit(),
+        "date": datetime.datetime.now(datetime.timezone.utc).isoformat(),
+        "host": platform.node(),
+        "machine": platform.machine(),
+        "cpus": os.cpu_count(),
+        "results": results,
+    }
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(document, f, indent=2, sort_keys=True)
+            f.write("\n")
+    else:
+        json.dump(document, sys.stdout, indent=2, sort_keys=True)
+        sys.stdout.write("\n")
+
+    if not args.baseline:
+        return 0
+
+    # the document may have gone to stdout
+    out = sys.stdout if args.output else sys.stderr
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    regressed = compare(results, baseline["results"], args.threshold, out)
+    if regressed:
+        print(
+            "%u benchmarks regressed by more than %.0f%% since %s"
+            % (len(regressed), args.threshold, baseline.get("commit")),
+            file=out,
+        )
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,299 @@
+#!/usr/bin/env python
+# SPDX-License-Identifier: ISC
+
+"""
+How long a latency change on the wire takes to reach the kernel FIB.
+
+r1 learns 192.168.100.0/24 over iBGP from r2 and r3 and picks between
+them by the round trip the twamp_light agent measures to each. netem on
+r2's interface steps its delay across r3's, back and forth, so every step
+moves the best path. Each step is timestamped at:
+
+  wire      tc changes the delay
+  publish   the agent writes the round that saw it to shared memory
+  bgpd      bgp_twamp_check_measurements() picks it up
+  dplane    zebra queues the route update to the dataplane
+  fib       the kernel reports the new route (ip monitor)
+
+and the percentiles of each stage are logged and written to
+convergence.json in the log directory.
+
+The agent binary is taken from TWAMP_LIGHT, or twamp_light in PATH; the
+test is skipped without it.
+"""
+
+import os
+import re
+import sys
+import json
+import time
+import shutil
+import pytest
+import functools
+import subprocess
+from datetime import datetime
+
+CWD = os.path.dirname(os.path.realpath(__file__))
+sys.path.append(os.path.join(CWD, "../"))
+
+# pylint: disable=C0413
+from lib import topotest
+from lib.topogen import Topogen, TopoRouter, get_topogen
+from lib.topolog import logger
+from lib.common_config import step
+
+pytestmark = [pytest.mark.bgpd]
+
+PREFIX = "192.168.100.0/24"
+TWAMP_PORT = "862"
+# r3's link stays at this delay, r2's steps below and above it
+R3_DELAY = "20ms"
+R2_DELAYS = ("5ms", "60ms")
+STEPS = 10
+
+TWAMP_LIGHT = os.environ.get("TWAMP_LIGHT") or shutil.which("twamp_light")
+
+procs = []
+
+
+def build_topo(tgen):
+    for routern in range(1, 4):
+        tgen.add_router("r{}".format(routern))
+
+    switch = tgen.add_switch("s1")
+    switch.add_link(tgen.gears["r1"])
+    switch.add_link(tgen.gears["r2"])
+
+    switch = tgen.add_switch("s2")
+    switch.add_link(tgen.gears["r1"])
+    switch.add_link(tgen.gears["r3"])
+
+
+def spawn(router, args, logname):
+    tgen = get_topogen()
+    out = open(os.path.join(tgen.logdir, router.name, logname), "w")
+    p = router.popen(
+        args, stdin=subprocess.DEVNULL, stdout=out, stderr=subprocess.STDOUT
+    )
+    procs.append(p)
+    return p
+
+
+def setup_module(mod):
+    if not TWAMP_LIGHT:
+        pytest.skip("twamp_light not found, set TWAMP_LIGHT")
+
+    tgen = Topogen(build_topo, mod.__name__)
+    tgen.start_topology()
+
+    router_list = tgen.routers()
+
+    for _, (rname, router) in enumerate(router_list.items(), 1):
+        router.load_frr_config(os.path.join(CWD, "{}/frr.conf".format(rname)))
+
+    tgen.start_router()
+
+    r1 = tgen.gears["r1"]
+    r2 = tgen.gears["r2"]
+    r3 = tgen.gears["r3"]
+
+    r2.cmd_raises(
+        "tc qdisc add dev r2-eth0 root netem delay {}".format(R2_DELAYS[0])
+    )
+    r3.cmd_raises("tc qdisc add dev r3-eth0 root netem delay {}".format(R3_DELAY))
+
+    # r2 and r3 only reflect, r1 probes the nexthops bgpd gives it
+    spawn(r2, [TWAMP_LIGHT, "-p", TWAMP_PORT], "twamp_light.log")
+    spawn(r3, [TWAMP_LIGHT, "-p", TWAMP_PORT], "twamp_light.log")
+    spawn(
+        r1,
+        [TWAMP_LIGHT, "-b", "-d", "-p", TWAMP_PORT, "-t", "200", "-D", "10"],
+        "twamp_light.log",
+    )
+    spawn(r1, ["ip", "-ts", "monitor", "route"], "ip_monitor.log")
+
+
+def teardown_module(mod):
+    for p in procs:
+        p.terminate()
+        p.wait()
+
+    tgen = get_topogen()
+    tgen.stop_topology()
+
+
+def best_nexthop(router):
+    output = json.loads(router.vtysh_cmd("show ip route {} json".format(PREFIX)))
+    for route in output.get(PREFIX, []):
+        if not route.get("installed"):
+            continue
+        for nexthop in route.get("nexthops", []):
+            if nexthop.get("fib"):
+                return nexthop.get("ip")
+    return None
+
+
+# FRR logs "2026/10/14 12:00:00.123456", the agent "2026-10-14 12:00:00.123456"
+# and ip -ts "[2026-10-14T12:00:00.123456]", all in local time
+TS_RE = r"(\d{4}[/-]\d\d[/-]\d\d[ T]\d\d:\d\d:\d\d\.\d{6})"
+
+
+def parse_ts(text):
+    text = text.replace("/", "-").replace("T", " ")
+    return datetime.strptime(text, "%Y-%m-%d %H:%M:%S.%f").timestamp()
+
+
+def read_events(path, pattern):
+    """(time, match) for every line of path matching pattern after a timestamp"""
+    events = []
+    regex = re.compile(TS_RE + r".*?" + pattern)
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = regex.search(line)
+            if m:
+                events.append((parse_ts(m.group(1)), m))
+    return events
+
+
+def last_before(events, t, cond=None):
+    found = None
+    for event in events:
+        if event[0] > t:
+            break
+        if cond is None or cond(event[1]):
+            found = event
+    return found
+
+
+def first_after(events, t):
+    for event in events:
+        if event[0] >= t:
+            return event
+    return None
+
+
+def step_timeline(logdir, t_wire):
+    """Walk back from the first FIB change after t_wire to what caused it"""
+    r1dir = os.path.join(logdir, "r1")
+    fib = first_after(
+        read_events(os.path.join(r1dir, "ip_monitor.log"), re.escape(PREFIX)),
+        t_wire,
+    )
+    if not fib:
+        return None
+    dplane = last_before(
+        read_events(
+            os.path.join(r1dir, "zebra.log"),
+            re.escape(PREFIX) + r" Dplane route ctx \S+ queued",
+        ),
+        fib[0],
+    )
+    bgpd = last_before(
+        read_events(
+            os.path.join(r1dir, "bgpd.log"),
+            r"BGP TWAMP: Measurements updated \(seq (\d+)\)",
+        ),
+        dplane[0] if dplane else fib[0],
+    )
+    if not dplane or not bgpd:
+        return None
+    seq = int(bgpd[1].group(2))
+    publish = last_before(
+        read_events(
+            os.path.join(r1dir, "twamp_light.log"), r"Published seq (\d+)"
+        ),
+        bgpd[0],
+        lambda m: int(m.group(2)) <= seq,
+    )
+    if not publish:
+        return None
+
+    return {
+        "publish": publish[0] - t_wire,
+        "bgpd": bgpd[0] - publish[0],
+        "dplane": dplane[0] - bgpd[0],
+        "fib": fib[0] - dplane[0],
+        "total": fib[0] - t_wire,
+    }
+
+
+def percentile(values, p):
+    values = sorted(values)
+    rank = max(1, min(len(values), int(-(-p * len(values) // 100))))
+    return values[rank - 1]
+
+
+def test_bgp_latency_initial():
+    tgen = get_topogen()
+
+    if tgen.routers_have_failure():
+        pytest.skip(tgen.errors)
+
+    r1 = tgen.gears["r1"]
+
+    step("r1 prefers r2, the lower round trip")
+    test_func = functools.partial(best_nexthop, r1)
+    _, result = topotest.run_and_expect(test_func, "10.0.12.2", count=60, wait=1)
+    assert result == "10.0.12.2", "{} is not installed via r2".format(PREFIX)
+
+
+def test_bgp_latency_convergence():
+    tgen = get_topogen()
+
+    if tgen.routers_have_failure():
+        pytest.skip(tgen.errors)
+
+    r1 = tgen.gears["r1"]
+    r2 = tgen.gears["r2"]
+
+    timelines = []
+    for n in range(1, STEPS + 1):
+        delay = R2_DELAYS[n % 2]
+        expected = "10.0.13.3" if n % 2 else "10.0.12.2"
+
+        step("Step {}: r2 delay to {}, best path to {}".format(n, delay, expected))
+        t_wire = time.time()
+        r2.cmd_raises("tc qdisc change dev r2-eth0 root netem delay {}".format(delay))
+
+        test_func = functools.partial(best_nexthop, r1)
+        _, result = topotest.run_and_expect(test_func, expected, count=120, wait=0.5)
+        assert result == expected, "{} not moved to {} after step {}".format(
+            PREFIX, expected, n
+        )
+
+        # Let the daemons flush their logs
+        time.sleep(1)
+        timeline = step_timeline(tgen.logdir, t_wire)
+        assert timeline, "Cannot line up the logs of step {}".format(n)
+        logger.info(
+            "step %d: %s",
+            n,
+            ", ".join("{} {:.1f} ms".format(k, v * 1000) for k, v in timeline.items()),
+        )
+        timelines.append(timeline)
+
+    report = {}
+    for stage in timelines[0]:
+        values = [t[stage] * 1000 for t in timelines]
+        report[stage] = {
+            "p50": percentile(values, 50),
+            "p90": percentile(values, 90),
+            "p99": percentile(values, 99),
+            "max": max(values),
+        }
+        logger.info(
+            "%-8s p50 %8.1f ms  p90 %8.1f ms  p99 %8.1f ms  max %8.1f ms",
+            stage,
+            report[stage]["p50"],
+            report[stage]["p90"],
+            report[stage]["p99"],
+            report[stage]["max"],
+        )
+
+    with open(os.path.join(tgen.logdir, "convergence.json"), "w") as f:
+        json.dump({"steps": timelines, "percentiles": report}, f, indent=2)
+
+
+if __name__ == "__main__":
+    args = ["-s"] + sys.argv[1:]
+    sys.exit(pytest.main(args))
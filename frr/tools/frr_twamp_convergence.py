@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+"""
+Usage: frr_twamp_convergence.py [--passes] trace_path
+
+Attributes the convergence time of latency-driven route changes from an
+lttng trace of bgpd, without debug logging. Enable at least:
+
+  lttng enable-event -u 'frr_bgp:twamp_*' --loglevel TRACE_INFO
+  lttng enable-event -u frr_bgp:vpn_leak_reimport,frr_bgp:bestpath_flip
+
+Every twamp_latency_change is charged to the twamp_reevaluate pass that
+follows it. For a pass the time is split into the wait before it (the
+coalesce window and the event queue) and the pass itself; the VPN
+re-imports and best-path flips seen while it ran are counted per VRF.
+"""
+
+import argparse
+import collections
+import ipaddress
+import socket
+import sys
+
+import babeltrace
+
+
+def print_prefix(field_val):
+    """
+    pretty print "struct prefix", as dumped by ctf_array
+    """
+    family = field_val[0]
+    plen = field_val[2] | (field_val[3] << 8)
+    if family == socket.AF_INET:
+        addr = ipaddress.IPv4Address(bytes(field_val[8:12]))
+    elif family == socket.AF_INET6:
+        addr = ipaddress.IPv6Address(bytes(field_val[8:24]))
+    else:
+        return str(list(field_val))
+    return "%s/%u" % (addr, plen)
+
+
+def percentile(values, pct):
+    if not values:
+        return 0
+    values = sorted(values)
+    return values[min(len(values) - 1, len(values) * pct // 100)]
+
+
+class Pass:
+    """
+    One re-evaluation pass and the latency changes that led to it
+    """
+
+    def __init__(self, end, elapsed_us, paths, dests):
+        self.end = end
+        self.start = end - elapsed_us * 1000
+        self.paths = paths
+        self.dests = dests
+        self.changes = []
+        self.reimports = collections.Counter()
+        self.flips = collections.Counter()
+        self.latency_flips = collections.Counter()
+
+    def wait_us(self):
+        if not self.changes:
+            return 0
+        return max(0, self.start - self.changes[0][0]) // 1000
+
+    def total_us(self):
+        if not self.changes:
+            return 0
+        return (self.end - self.changes[0][0]) // 1000
+
+
+def analyze(trace_path):
+    trace_collection = babeltrace.TraceCollection()
+    if trace_collection.add_traces_recursive(trace_path, "ctf") is None:
+        sys.exit("No trace found at %s" % trace_path)
+
+    passes = []
+    changes = []
+    # re-imports and flips not yet charged to a pass
+    pending = []
+
+    for event in trace_collection.events:
+        ts = event.timestamp
+        if event.name == "frr_bgp:twamp_latency_change":
+            changes.append(
+                (
+                    ts,
+                    event["vrf"],
+                    print_prefix(event["nexthop"]),
+                    event["from_latency_us"],
+                    event["to_latency_us"],
+                )
+            )
+        elif event.name == "frr_bgp:vpn_leak_reimport":
+            pending.append((ts, "reimport", event["to_vrf"], None))
+        elif event.name == "frr_bgp:bestpath_flip":
+            pending.append((ts, "flip", event["vrf"], event["reason"]))
+        elif event.name == "frr_bgp:twamp_reevaluate":
+            p = Pass(ts, event["elapsed_us"], event["paths"], event["dests"])
+            p.changes = changes
+            changes = []
+            for when, kind, vrf, reason in pending:
+                if when < p.start:
+                    continue
+                if kind == "reimport":
+                    p.reimports[vrf] += 1
+                else:
+                    p.flips[vrf] += 1
+                    if reason in ("Peer Latency", "Probe Loss"):
+                        p.latency_flips[vrf] += 1
+            pending = []
+            passes.append(p)
+
+    return passes, changes
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Convergence of latency-driven route changes"
+    )
+    parser.add_argument(
+        "--passes", action="store_true", help="print every re-evaluation pass"
+    )
+    parser.add_argument("trace_path", help="lttng trace directory")
+    args = parser.parse_args()
+
+    passes, leftover = analyze(args.trace_path)
+    if not passes:
+        print("No re-evaluation pass in the trace")
+        return
+
+    if args.passes:
+        print(
+            "%-20s %8s %8s %8s %10s %10s %10s"
+            % ("End(ns)", "Changes", "Paths", "Dests", "Wait(us)", "Pass(us)",
+               "Total(us)")
+        )
+        for p in passes:
+            print(
+                "%-20u %8u %8u %8u %10u %10u %10u"
+                % (p.end, len(p.changes), p.paths, p.dests, p.wait_us(),
+                   (p.end - p.start) // 1000, p.total_us())
+            )
+            for ts, vrf, nexthop, old, new in p.changes:
+                print("    %s %s: %s -> %s us" % (vrf, nexthop, old, new))
+        print()
+
+    # from each latency change to the end of its pass
+    per_change = []
+    for p in passes:
+        per_change.extend((p.end - ts) // 1000 for ts, *_ in p.changes)
+    waits = [p.wait_us() for p in passes if p.changes]
+    lengths = [(p.end - p.start) // 1000 for p in passes]
+
+    print("%u passes, %u latency changes" % (len(passes), len(per_change)))
+    for name, values in (
+        ("change to converged", per_change),
+        ("wait before pass", waits),
+        ("pass", lengths),
+    ):
+        print(
+            "%-20s p50 %8u p90 %8u p99 %8u max %8u us"
+            % (name, percentile(values, 50), percentile(values, 90),
+               percentile(values, 99), max(values) if values else 0)
+        )
+
+    reimports = collections.Counter()
+    flips = collections.Counter()
+    latency_flips = collections.Counter()
+    for p in passes:
+        reimports.update(p.reimports)
+        flips.update(p.flips)
+        latency_flips.update(p.latency_flips)
+
+    print()
+    print("%-32s %10s %10s %14s" % ("VRF", "Reimports", "Flips",
+                                    "Latency flips"))
+    for vrf in sorted(set(reimports) | set(flips)):
+        print("%-32s %10u %10u %14u" % (vrf, reimports[vrf], flips[vrf],
+                                        latency_flips[vrf]))
+
+    if leftover:
+        print()
+        print("%u latency changes after the last pass" % len(leftover))
+
+
+if __name__ == "__main__":
+    main()
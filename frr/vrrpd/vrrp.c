@@ -25,10 +25,14 @@
 #include "vrrp_packet.h"
 #include "vrrp_zebra.h"
 
+/* Shared with bgpd and the agents, see there for the layout */
+#include "bgpd/bgp_twamp_ipc.h"
+
 #define VRRP_LOGPFX "[CORE] "
 
 DEFINE_MTYPE_STATIC(VRRPD, VRRP_IP, "VRRP IP address");
 DEFINE_MTYPE_STATIC(VRRPD, VRRP_RTR, "VRRP Router");
+DEFINE_MTYPE_STATIC(VRRPD, VRRP_LATENCY, "VRRP latency priority");
 
 /* statics */
 struct hash *vrrp_vrouters_hash;
@@ -372,6 +376,160 @@ void vrrp_set_priority(struct vrrp_vrouter *vr, uint8_t priority)
 	vr->priority = priority;
 	vr->v4->priority = priority;
 	vr->v6->priority = priority;
+
+	/* The latency goes down from the new priority */
+	if (vr->latency)
+		vrrp_latency_priority_update(vr);
+}
+
+
+/* Latency priority -------------------------------------------------------- */
+
+/* How often the measurements are looked at */
+#define VRRP_LATENCY_POLL_SEC 1
+/* A measurement older than this is no measurement */
+#define VRRP_LATENCY_STALE_SEC 60
+
+static struct twamp_shm_reader vrrp_twamp;
+
+static unsigned int vrrp_latency_count;
+static struct event *vrrp_latency_ev;
+
+/* Map whatever bgpd currently publishes, once per pass */
+static void vrrp_latency_attach(void)
+{
+	const char *why;
+
+	if (!twamp_shm_reader_attach(&vrrp_twamp, &why) && why)
+		DEBUGD(&vrrp_dbg_proto, VRRP_LOGPFX "Ignoring %s: %s",
+		       TWAMP_SHM_NAME, why);
+}
+
+/*
+ * Round trip to the upstream address of vr, UINT32_MAX if it is lost;
+ * false if there is no fresh measurement.
+ */
+static bool vrrp_latency_read(const struct vrrp_vrouter *vr,
+			      uint32_t *latency)
+{
+	const struct vrrp_latency_priority *lp = vr->latency;
+	vrf_id_t vrf_id = vr->ifp->vrf->vrf_id;
+	struct in6_addr key;
+	uint32_t vrf_ifindex, rtt, jitter;
+	uint16_t loss;
+
+	/* Measured through the VRF device, as bgpd keys its nexthops */
+	if (vrf_id == VRF_DEFAULT)
+		vrf_ifindex = 0;
+	else if (!vrf_is_backend_netns())
+		vrf_ifindex = vrf_id;
+	else
+		return false;
+
+	if (IS_IPADDR_V4(&lp->addr))
+		twamp_addr_from_ipv4(&key, lp->addr.ipaddr_v4.s_addr);
+	else
+		key = lp->addr.ipaddr_v6;
+
+	if (twamp_shm_reader_lookup(&vrrp_twamp, &key, vrf_ifindex,
+				    VRRP_LATENCY_STALE_SEC, &rtt, &jitter,
+				    &loss))
+		return false;
+
+	*latency = loss >= 1000 ? UINT32_MAX : rtt;
+	return true;
+}
+
+static void vrrp_latency_apply(struct vrrp_router *r, uint8_t priority)
+{
+	/* An owner is Master whatever the latency */
+	if (r->priority == VRRP_PRIO_MASTER || r->priority == priority)
+		return;
+
+	DEBUGD(&vrrp_dbg_proto,
+	       VRRP_LOGPFX VRRP_LOGPFX_VRID VRRP_LOGPFX_FAM
+	       "Latency priority %hhu -> %hhu",
+	       r->vr->vrid, family2str(r->family), r->priority, priority);
+	r->priority = priority;
+}
+
+static void vrrp_latency_vrouter_update(struct vrrp_vrouter *vr, bool force)
+{
+	struct vrrp_latency_priority *lp = vr->latency;
+	uint8_t high = vr->priority;
+	uint8_t low = MIN(lp->min_priority, high);
+	uint8_t priority;
+
+	lp->measured = vrrp_latency_read(vr, &lp->latency);
+
+	if (!lp->measured)
+		priority = high;
+	else if (lp->latency >= lp->max_latency)
+		priority = low;
+	else
+		priority = high - (uint64_t)(high - low) * lp->latency /
+					  lp->max_latency;
+
+	/* Small moves are noise, reaching a bound never is */
+	if (!force && priority != high && priority != low &&
+	    abs((int)priority - (int)lp->priority) < lp->hysteresis)
+		return;
+
+	lp->priority = priority;
+	vrrp_latency_apply(vr->v4, priority);
+	vrrp_latency_apply(vr->v6, priority);
+}
+
+static void vrrp_latency_poll_vrouter(struct hash_bucket *bucket, void *arg)
+{
+	struct vrrp_vrouter *vr = bucket->data;
+
+	if (vr->latency)
+		vrrp_latency_vrouter_update(vr, false);
+}
+
+static void vrrp_latency_poll(struct event *thread)
+{
+	vrrp_latency_attach();
+	hash_iterate(vrrp_vrouters_hash, vrrp_latency_poll_vrouter, NULL);
+
+	event_add_timer(master, vrrp_latency_poll, NULL,
+			VRRP_LATENCY_POLL_SEC, &vrrp_latency_ev);
+}
+
+struct vrrp_latency_priority *
+vrrp_latency_priority_enable(struct vrrp_vrouter *vr)
+{
+	if (vr->latency)
+		return vr->latency;
+
+	vr->latency = XCALLOC(MTYPE_VRRP_LATENCY, sizeof(*vr->latency));
+	vr->latency->priority = vr->priority;
+	if (vrrp_latency_count++ == 0)
+		event_add_timer(master, vrrp_latency_poll, NULL,
+				VRRP_LATENCY_POLL_SEC, &vrrp_latency_ev);
+	return vr->latency;
+}
+
+void vrrp_latency_priority_disable(struct vrrp_vrouter *vr)
+{
+	if (!vr->latency)
+		return;
+
+	XFREE(MTYPE_VRRP_LATENCY, vr->latency);
+	vrrp_latency_apply(vr->v4, vr->priority);
+	vrrp_latency_apply(vr->v6, vr->priority);
+
+	if (--vrrp_latency_count)
+		return;
+	EVENT_OFF(vrrp_latency_ev);
+	twamp_shm_reader_detach(&vrrp_twamp);
+}
+
+void vrrp_latency_priority_update(struct vrrp_vrouter *vr)
+{
+	vrrp_latency_attach();
+	vrrp_latency_vrouter_update(vr, true);
 }
 
 void vrrp_set_advertisement_interval(struct vrrp_vrouter *vr,
@@ -650,6 +808,7 @@ struct vrrp_vrouter *vrrp_vrouter_create(struct interface *ifp, uint8_t vrid,
 
 void vrrp_vrouter_destroy(struct vrrp_vrouter *vr)
 {
+	vrrp_latency_priority_disable(vr);
 	vrrp_router_destroy(vr->v4);
 	vrrp_router_destroy(vr->v6);
 	hash_release(vrrp_vrouters_hash, vr);
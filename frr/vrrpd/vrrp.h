@@ -216,6 +216,23 @@ struct vrrp_router {
  * v6 instances. This corresponds to the choice made by other industrial
  * implementations.
  */
+/*
+ * Priority following the TWAMP-measured round trip to an upstream address,
+ * see vrrp_latency_priority_enable().
+ */
+struct vrrp_latency_priority {
+	struct ipaddr addr;
+	/* Round trip at which min_priority is reached, in microseconds */
+	uint32_t max_latency;
+	uint8_t min_priority;
+	uint8_t hysteresis;
+
+	/* Last measurement, and the priority in effect from it */
+	bool measured;
+	uint32_t latency;
+	uint8_t priority;
+};
+
 struct vrrp_vrouter {
 	/* Whether this instance was automatically configured */
 	bool autoconf;
@@ -263,6 +280,9 @@ struct vrrp_vrouter {
 	 */
 	bool checksum_with_ipv4_pseudoheader;
 
+	/* Latency-driven priority, NULL if the priority is static */
+	struct vrrp_latency_priority *latency;
+
 	struct vrrp_router *v4;
 	struct vrrp_router *v6;
 };
@@ -329,6 +349,29 @@ void vrrp_check_start(struct vrrp_vrouter *vr);
  */
 void vrrp_set_priority(struct vrrp_vrouter *vr, uint8_t priority);
 
+/*
+ * Have the effective priority follow the latency to an upstream address.
+ *
+ * Once a second the round trip to the address is read from the TWAMP
+ * shared segment bgpd publishes, and the priority set from it: the
+ * configured priority at no latency, going down linearly to min_priority
+ * at max_latency and beyond, or when the address stops answering. Changes
+ * smaller than the hysteresis are not applied unless a bound is reached.
+ * Without a fresh measurement the configured priority applies. An address
+ * owner always keeps priority 255.
+ *
+ * Returns the settings for the caller to fill in, then to call
+ * vrrp_latency_priority_update() with.
+ */
+struct vrrp_latency_priority *
+vrrp_latency_priority_enable(struct vrrp_vrouter *vr);
+
+/* Go back to the configured priority */
+void vrrp_latency_priority_disable(struct vrrp_vrouter *vr);
+
+/* Apply the settings of vr->latency now, regardless of the hysteresis */
+void vrrp_latency_priority_update(struct vrrp_vrouter *vr);
+
 /*
  * Set Advertisement Interval on this Virtual Router.
  *
@@ -504,6 +504,118 @@ lib_interface_vrrp_vrrp_group_priority_modify(struct nb_cb_modify_args *args)
 	return NB_OK;
 }
 
+/*
+ * XPath: /frr-interface:lib/interface/frr-vrrpd:vrrp/vrrp-group/latency-priority
+ */
+static int lib_interface_vrrp_vrrp_group_latency_priority_create(
+	struct nb_cb_create_args *args)
+{
+	if (args->event != NB_EV_APPLY)
+		return NB_OK;
+
+	struct vrrp_vrouter *vr;
+
+	vr = nb_running_get_entry(args->dnode, NULL, true);
+	vrrp_latency_priority_enable(vr);
+
+	return NB_OK;
+}
+
+static int lib_interface_vrrp_vrrp_group_latency_priority_destroy(
+	struct nb_cb_destroy_args *args)
+{
+	if (args->event != NB_EV_APPLY)
+		return NB_OK;
+
+	struct vrrp_vrouter *vr;
+
+	vr = nb_running_get_entry(args->dnode, NULL, true);
+	vrrp_latency_priority_disable(vr);
+
+	return NB_OK;
+}
+
+static void lib_interface_vrrp_vrrp_group_latency_priority_apply_finish(
+	struct nb_cb_apply_finish_args *args)
+{
+	struct vrrp_vrouter *vr;
+
+	vr = nb_running_get_entry(args->dnode, NULL, true);
+	vrrp_latency_priority_update(vr);
+}
+
+/*
+ * XPath:
+ * /frr-interface:lib/interface/frr-vrrpd:vrrp/vrrp-group/latency-priority/address
+ */
+static int lib_interface_vrrp_vrrp_group_latency_priority_address_modify(
+	struct nb_cb_modify_args *args)
+{
+	if (args->event != NB_EV_APPLY)
+		return NB_OK;
+
+	struct vrrp_vrouter *vr;
+
+	vr = nb_running_get_entry(args->dnode, NULL, true);
+	yang_dnode_get_ip(&vr->latency->addr, args->dnode, NULL);
+
+	return NB_OK;
+}
+
+/*
+ * XPath:
+ * /frr-interface:lib/interface/frr-vrrpd:vrrp/vrrp-group/latency-priority/max-latency
+ */
+static int lib_interface_vrrp_vrrp_group_latency_priority_max_latency_modify(
+	struct nb_cb_modify_args *args)
+{
+	if (args->event != NB_EV_APPLY)
+		return NB_OK;
+
+	struct vrrp_vrouter *vr;
+
+	vr = nb_running_get_entry(args->dnode, NULL, true);
+	vr->latency->max_latency = yang_dnode_get_uint32(args->dnode, NULL);
+
+	return NB_OK;
+}
+
+/*
+ * XPath:
+ * /frr-interface:lib/interface/frr-vrrpd:vrrp/vrrp-group/latency-priority/min-priority
+ */
+static int lib_interface_vrrp_vrrp_group_latency_priority_min_priority_modify(
+	struct nb_cb_modify_args *args)
+{
+	if (args->event != NB_EV_APPLY)
+		return NB_OK;
+
+	struct vrrp_vrouter *vr;
+
+	vr = nb_running_get_entry(args->dnode, NULL, true);
+	vr->latency->min_priority = yang_dnode_get_uint8(args->dnode, NULL);
+
+	return NB_OK;
+}
+
+/*
+ * XPath:
+ * /frr-interface:lib/interface/frr-vrrpd:vrrp/vrrp-group/latency-priority/hysteresis
+ */
+static int lib_interface_vrrp_vrrp_group_latency_priority_hysteresis_modify(
+	struct nb_cb_modify_args *args)
+{
+	if (args->event != NB_EV_APPLY)
+		return NB_OK;
+
+	struct vrrp_vrouter *vr;
+
+	vr = nb_running_get_entry(args->dnode, NULL, true);
+	vr->latency->hysteresis = yang_dnode_get_uint8(args->dnode, NULL);
+
+	return NB_OK;
+}
+
 /*
  * XPath: /frr-interface:lib/interface/frr-vrrpd:vrrp/vrrp-group/preempt
  */
@@ -637,6 +749,39 @@ const struct frr_yang_module_info frr_vrrpd_info = {
 				.cli_show = cli_show_priority,
 			}
 		},
+		{
+			.xpath = "/frr-interface:lib/interface/frr-vrrpd:vrrp/vrrp-group/latency-priority",
+			.cbs = {
+				.create = lib_interface_vrrp_vrrp_group_latency_priority_create,
+				.destroy = lib_interface_vrrp_vrrp_group_latency_priority_destroy,
+				.apply_finish = lib_interface_vrrp_vrrp_group_latency_priority_apply_finish,
+				.cli_show = cli_show_latency_priority,
+			}
+		},
+		{
+			.xpath = "/frr-interface:lib/interface/frr-vrrpd:vrrp/vrrp-group/latency-priority/address",
+			.cbs = {
+				.modify = lib_interface_vrrp_vrrp_group_latency_priority_address_modify,
+			}
+		},
+		{
+			.xpath = "/frr-interface:lib/interface/frr-vrrpd:vrrp/vrrp-group/latency-priority/max-latency",
+			.cbs = {
+				.modify = lib_interface_vrrp_vrrp_group_latency_priority_max_latency_modify,
+			}
+		},
+		{
+			.xpath = "/frr-interface:lib/interface/frr-vrrpd:vrrp/vrrp-group/latency-priority/min-priority",
+			.cbs = {
+				.modify = lib_interface_vrrp_vrrp_group_latency_priority_min_priority_modify,
+			}
+		},
+		{
+			.xpath = "/frr-interface:lib/interface/frr-vrrpd:vrrp/vrrp-group/latency-priority/hysteresis",
+			.cbs = {
+				.modify = lib_interface_vrrp_vrrp_group_latency_priority_hysteresis_modify,
+			}
+		},
 		{
 			.xpath = "/frr-interface:lib/interface/frr-vrrpd:vrrp/vrrp-group/preempt",
 			.cbs = {
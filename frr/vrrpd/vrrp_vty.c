@@ -139,6 +139,82 @@ void cli_show_priority(struct vty *vty, const struct lyd_node *dnode,
 	vty_out(vty, " vrrp %s priority %s\n", vrid, prio);
 }
 
+/*
+ * XPath:
+ * /frr-interface:lib/interface/frr-vrrpd:vrrp/vrrp-group/latency-priority
+ */
+DEFPY_YANG(vrrp_priority_latency,
+      vrrp_priority_latency_cmd,
+      "vrrp (1-255)$vrid priority latency <A.B.C.D|X:X::X:X>$addr max-latency (1-10000000)$max_latency [min-priority (1-254)$min_priority] [hysteresis (1-254)$hysteresis]",
+      VRRP_STR
+      VRRP_VRID_STR
+      VRRP_PRIORITY_STR
+      "Lower the priority with the measured latency\n"
+      "Upstream IPv4 address\n"
+      "Upstream IPv6 address\n"
+      "Round trip at which the lowest priority is reached\n"
+      "Microseconds\n"
+      "Lowest priority\n"
+      "Priority value\n"
+      "Smallest change of the priority that is applied\n"
+      "Priority difference\n")
+{
+	nb_cli_enqueue_change(vty, "./latency-priority", NB_OP_CREATE, NULL);
+	nb_cli_enqueue_change(vty, "./latency-priority/address", NB_OP_MODIFY,
+			      addr_str);
+	nb_cli_enqueue_change(vty, "./latency-priority/max-latency",
+			      NB_OP_MODIFY, max_latency_str);
+	nb_cli_enqueue_change(vty, "./latency-priority/min-priority",
+			      NB_OP_MODIFY, min_priority_str);
+	nb_cli_enqueue_change(vty, "./latency-priority/hysteresis",
+			      NB_OP_MODIFY, hysteresis_str);
+
+	return nb_cli_apply_changes(vty, VRRP_XPATH_ENTRY, vrid);
+}
+
+/*
+ * XPath:
+ * /frr-interface:lib/interface/frr-vrrpd:vrrp/vrrp-group/latency-priority
+ */
+DEFPY_YANG(no_vrrp_priority_latency,
+      no_vrrp_priority_latency_cmd,
+      "no vrrp (1-255)$vrid priority latency [<A.B.C.D|X:X::X:X> max-latency (1-10000000) [min-priority (1-254)] [hysteresis (1-254)]]",
+      NO_STR
+      VRRP_STR
+      VRRP_VRID_STR
+      VRRP_PRIORITY_STR
+      "Lower the priority with the measured latency\n"
+      "Upstream IPv4 address\n"
+      "Upstream IPv6 address\n"
+      "Round trip at which the lowest priority is reached\n"
+      "Microseconds\n"
+      "Lowest priority\n"
+      "Priority value\n"
+      "Smallest change of the priority that is applied\n"
+      "Priority difference\n")
+{
+	nb_cli_enqueue_change(vty, "./latency-priority", NB_OP_DESTROY, NULL);
+
+	return nb_cli_apply_changes(vty, VRRP_XPATH_ENTRY, vrid);
+}
+
+void cli_show_latency_priority(struct vty *vty, const struct lyd_node *dnode,
+			       bool show_defaults)
+{
+	const char *vrid = yang_dnode_get_string(dnode, "../virtual-router-id");
+
+	vty_out(vty, " vrrp %s priority latency %s max-latency %s", vrid,
+		yang_dnode_get_string(dnode, "./address"),
+		yang_dnode_get_string(dnode, "./max-latency"));
+	if (show_defaults || !yang_dnode_is_default(dnode, "./min-priority"))
+		vty_out(vty, " min-priority %s",
+			yang_dnode_get_string(dnode, "./min-priority"));
+	if (show_defaults || !yang_dnode_is_default(dnode, "./hysteresis"))
+		vty_out(vty, " hysteresis %s",
+			yang_dnode_get_string(dnode, "./hysteresis"));
+	vty_out(vty, "\n");
+}
+
 /*
  * XPath:
  * /frr-interface:lib/interface/frr-vrrpd:vrrp/vrrp-group/advertisement-interval
@@ -399,6 +475,19 @@ static struct json_object *vrrp_build_json(struct vrrp_vrouter *vr)
 	json_object_int_add(j, "advertisementInterval",
 			    vr->advertisement_interval * CS2MS);
 	json_object_int_add(j, "priority", vr->priority);
+	if (vr->latency) {
+		struct json_object *lat = json_object_new_object();
+
+		json_object_string_addf(lat, "address", "%pIA",
+					&vr->latency->addr);
+		json_object_boolean_add(lat, "measured", vr->latency->measured);
+		if (vr->latency->measured &&
+		    vr->latency->latency != UINT32_MAX)
+			json_object_int_add(lat, "latencyUsec",
+					    vr->latency->latency);
+		json_object_int_add(lat, "priority", vr->latency->priority);
+		json_object_object_add(j, "latencyPriority", lat);
+	}
 	/* v4 */
 	json_object_string_add(v4, "interface",
 			       vr->v4->mvl_ifp ? vr->v4->mvl_ifp->name : "");
@@ -517,6 +606,16 @@ static void vrrp_show(struct vty *vty, struct vrrp_vrouter *vr)
 		       vr->v4->priority);
 	ttable_add_row(tt, "%s|%hhu", "Effective Priority (v6)",
 		       vr->v6->priority);
+	if (vr->latency && !vr->latency->measured)
+		ttable_add_row(tt, "%s|%pIA, not measured", "Latency Priority",
+			       &vr->latency->addr);
+	else if (vr->latency && vr->latency->latency == UINT32_MAX)
+		ttable_add_row(tt, "%s|%pIA, lost: %hhu", "Latency Priority",
+			       &vr->latency->addr, vr->latency->priority);
+	else if (vr->latency)
+		ttable_add_row(tt, "%s|%pIA, %u us: %hhu", "Latency Priority",
+			       &vr->latency->addr, vr->latency->latency,
+			       vr->latency->priority);
 	ttable_add_row(tt, "%s|%s", "Preempt Mode",
 		       vr->preempt_mode ? "Yes" : "No");
 	ttable_add_row(tt, "%s|%s", "Accept Mode",
@@ -771,6 +870,8 @@ void vrrp_vty_init(void)
 	install_element(INTERFACE_NODE, &vrrp_shutdown_cmd);
 	install_element(INTERFACE_NODE, &vrrp_priority_cmd);
 	install_element(INTERFACE_NODE, &no_vrrp_priority_cmd);
+	install_element(INTERFACE_NODE, &vrrp_priority_latency_cmd);
+	install_element(INTERFACE_NODE, &no_vrrp_priority_latency_cmd);
 	install_element(INTERFACE_NODE, &vrrp_advertisement_interval_cmd);
 	install_element(INTERFACE_NODE, &no_vrrp_advertisement_interval_cmd);
 	install_element(INTERFACE_NODE, &vrrp_ip_cmd);
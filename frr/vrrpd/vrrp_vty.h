@@ -18,6 +18,8 @@ void cli_show_shutdown(struct vty *vty, const struct lyd_node *dnode,
 		       bool show_defaults);
 void cli_show_priority(struct vty *vty, const struct lyd_node *dnode,
 		       bool show_defaults);
+void cli_show_latency_priority(struct vty *vty, const struct lyd_node *dnode,
+			       bool show_defaults);
 void cli_show_advertisement_interval(struct vty *vty,
 				     const struct lyd_node *dnode,
 				     bool show_defaults);
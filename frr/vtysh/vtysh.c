@@ -39,6 +39,7 @@
 #include "bgpd/bgp_vty.h"
 
 DEFINE_MTYPE_STATIC(MVTYSH, VTYSH_CMD, "Vtysh cmd copy");
+DEFINE_MTYPE_STATIC(MVTYSH, VTYSH_PIPE, "Vtysh pipelined commands");
 
 /* Struct VTY. */
 struct vty *vty;
@@ -49,6 +50,9 @@ char *vtysh_pager_name = NULL;
 /* VTY should add timestamp */
 bool vtysh_add_timestamp;
 
+/* Push config files pipelined */
+bool vtysh_pipelined;
+
 static bool stderr_tty;
 static bool stderr_stdout_same;
 
@@ -855,6 +859,161 @@ int vtysh_mark_file(const char *filename)
 	return 0;
 }
 
+/*
+ * Pipelined config push: the commands of a config file are written to a
+ * daemon without waiting for the reply to the one before, up to
+ * VTYSH_PIPE_DEPTH of them, and the replies matched to them in order as
+ * they come in. The daemon reads them off its socket back to back, so
+ * the round trip per line is gone. A failure is only known once its
+ * reply is in, by which time the commands after it are sent all the
+ * same; failures are reported with their line, as usual.
+ *
+ * mgmtd holds the rest of its input while a command waits on a backend,
+ * so it only ever gets one command at a time.
+ */
+#define VTYSH_PIPE_DEPTH 128
+#define VTYSH_PIPE_BUFSIZ 4096
+
+struct vtysh_pipe {
+	char *buf;
+	size_t len, size;
+
+	/* Commands sent and waiting for their reply, oldest at head */
+	unsigned int head, count;
+	struct {
+		int lineno;
+		char *line;
+	} cmds[VTYSH_PIPE_DEPTH];
+};
+
+static void vtysh_pipe_pop(struct vtysh_pipe *pipe)
+{
+	XFREE(MTYPE_VTYSH_PIPE, pipe->cmds[pipe->head].line);
+	pipe->head = (pipe->head + 1) % VTYSH_PIPE_DEPTH;
+	pipe->count--;
+}
+
+/* The connection broke: nothing outstanding will get a reply */
+static void vtysh_pipe_fail(struct vtysh_client *vclient, int *retcode)
+{
+	struct vtysh_pipe *pipe = vclient->pipe;
+
+	while (pipe->count) {
+		fprintf(stderr,
+			"line %d: Failure to communicate[%d] to %s, line: %s",
+			pipe->cmds[pipe->head].lineno, CMD_ERR_NO_DAEMON,
+			vclient->name, pipe->cmds[pipe->head].line);
+		vtysh_pipe_pop(pipe);
+	}
+	pipe->len = 0;
+	*retcode = CMD_ERR_NO_DAEMON;
+	vclient_close(vclient);
+}
+
+/* Wait for the reply to the oldest command sent to vclient */
+static bool vtysh_pipe_reply(struct vtysh_client *vclient, int *retcode)
+{
+	struct vtysh_pipe *pipe = vclient->pipe;
+	char *end;
+	ssize_t nread;
+	size_t textlen;
+	int ret;
+
+	/* Output is text, up to the 4-byte terminator with the status */
+	while (!(end = memchr(pipe->buf, '\0', pipe->len)) ||
+	       pipe->len < (size_t)(end - pipe->buf) + 4) {
+		if (pipe->len + 1 >= pipe->size) {
+			pipe->size *= 2;
+			pipe->buf = XREALLOC(MTYPE_VTYSH_PIPE, pipe->buf,
+					     pipe->size);
+		}
+		nread = vtysh_client_receive(vclient, pipe->buf + pipe->len,
+					     pipe->size - pipe->len - 1, NULL);
+		if (nread <= 0) {
+			vtysh_pipe_fail(vclient, retcode);
+			return false;
+		}
+		pipe->len += nread;
+	}
+
+	textlen = end - pipe->buf;
+	ret = end[3];
+	if (textlen && vty->of)
+		vty_out(vty, "%.*s", (int)textlen, pipe->buf);
+
+	if (ret != CMD_SUCCESS && ret != CMD_WARNING &&
+	    ret != CMD_NOT_MY_INSTANCE) {
+		fprintf(stderr,
+			"line %d: Failure to communicate[%d] to %s, line: %s",
+			pipe->cmds[pipe->head].lineno, ret, vclient->name,
+			pipe->cmds[pipe->head].line);
+		*retcode = ret;
+	}
+
+	pipe->len -= textlen + 4;
+	memmove(pipe->buf, end + 4, pipe->len);
+	vtysh_pipe_pop(pipe);
+	return true;
+}
+
+/* Send line to every instance of head_client, without waiting */
+static void vtysh_pipe_send(struct vtysh_client *head_client,
+			    const char *line, int lineno, int *retcode)
+{
+	struct vtysh_client *vclient;
+	struct vtysh_pipe *pipe;
+	unsigned int depth, tail;
+
+	for (vclient = head_client; vclient; vclient = vclient->next) {
+		if (vclient->fd < 0)
+			continue;
+
+		if (!vclient->pipe) {
+			vclient->pipe = XCALLOC(MTYPE_VTYSH_PIPE,
+						sizeof(*vclient->pipe));
+			vclient->pipe->size = VTYSH_PIPE_BUFSIZ;
+			vclient->pipe->buf = XMALLOC(MTYPE_VTYSH_PIPE,
+						     VTYSH_PIPE_BUFSIZ);
+		}
+		pipe = vclient->pipe;
+
+		depth = strmatch(vclient->name, "mgmtd") ? 1 : VTYSH_PIPE_DEPTH;
+		while (pipe->count >= depth)
+			if (!vtysh_pipe_reply(vclient, retcode))
+				break;
+		if (vclient->fd < 0)
+			continue;
+
+		if (write(vclient->fd, line, strlen(line) + 1) <= 0) {
+			vtysh_pipe_fail(vclient, retcode);
+			continue;
+		}
+
+		tail = (pipe->head + pipe->count++) % VTYSH_PIPE_DEPTH;
+		pipe->cmds[tail].lineno = lineno;
+		pipe->cmds[tail].line = XSTRDUP(MTYPE_VTYSH_PIPE, line);
+	}
+}
+
+/* Collect the replies still outstanding, at the end of the file */
+static void vtysh_pipe_drain(int *retcode)
+{
+	struct vtysh_client *vclient;
+	unsigned int i;
+
+	for (i = 0; i < array_size(vtysh_client); i++)
+		for (vclient = &vtysh_client[i]; vclient;
+		     vclient = vclient->next) {
+			if (!vclient->pipe)
+				continue;
+			while (vclient->pipe->count)
+				if (!vtysh_pipe_reply(vclient, retcode))
+					break;
+			XFREE(MTYPE_VTYSH_PIPE, vclient->pipe->buf);
+			XFREE(MTYPE_VTYSH_PIPE, vclient->pipe);
+		}
+}
+
 /* Configuration make from file. */
 int vtysh_config_from_file(struct vty *vty, FILE *fp)
 {
@@ -919,6 +1078,18 @@ int vtysh_config_from_file(struct vty *vty, FILE *fp)
 			unsigned int i;
 			int cmd_stat = CMD_SUCCESS;
 
+			if (vtysh_pipelined) {
+				for (i = 0; i < array_size(vtysh_client); i++)
+					if (cmd->daemon & vtysh_client[i].flag)
+						vtysh_pipe_send(&vtysh_client[i],
+								vty->buf,
+								lineno,
+								&retcode);
+				if (cmd->func)
+					(*cmd->func)(cmd, vty, 0, NULL);
+				break;
+			}
+
 			for (i = 0; i < array_size(vtysh_client); i++) {
 				if (cmd->daemon & vtysh_client[i].flag) {
 					cmd_stat = vtysh_client_execute(
@@ -953,6 +1124,9 @@ int vtysh_config_from_file(struct vty *vty, FILE *fp)
 		}
 	}
 
+	if (vtysh_pipelined)
+		vtysh_pipe_drain(&retcode);
+
 	XFREE(MTYPE_VTYSH_CMD, vty_buf_copy);
 
 	return (retcode);
@@ -119,6 +119,11 @@ extern int user_mode;
 
 extern bool vtysh_add_timestamp;
 
+/* Config files are pushed without waiting on each reply, see vtysh.c */
+extern bool vtysh_pipelined;
+
+struct vtysh_pipe;
+
 struct vtysh_client {
 	int fd;
 	const char *name;
@@ -129,6 +134,9 @@ struct vtysh_client {
 	struct event *log_reader;
 	int log_fd;
 	uint32_t lost_msgs;
+
+	/* Pipelined config push in progress */
+	struct vtysh_pipe *pipe;
 };
 
 extern struct vtysh_client vtysh_client[22];
@@ -179,6 +179,7 @@ static void usage(int status)
 		       "-H, --histfile           Override history file\n"
 		       "-t, --timestamp          Print a timestamp before going to shell or reading the configuration\n"
 		       "    --no-fork            Don't fork clients to handle daemons (slower for large configs)\n"
+		       "    --pipeline           Send config file lines without waiting for each reply\n"
 		       "-h, --help               Display this help and exit\n\n"
 		       "Note that multiple commands may be executed from the command\n"
 		       "line by passing multiple -c args, or by embedding linefeed\n"
@@ -193,6 +194,7 @@ static void usage(int status)
 #define OPTION_VTYSOCK 1000
 #define OPTION_CONFDIR 1001
 #define OPTION_NOFORK 1002
+#define OPTION_PIPELINE 1003
 struct option longopts[] = {
 	{"boot", no_argument, NULL, 'b'},
 	/* For compatibility with older zebra/quagga versions */
@@ -213,6 +215,7 @@ struct option longopts[] = {
 	{"user", no_argument, NULL, 'u'},
 	{"timestamp", no_argument, NULL, 't'},
 	{"no-fork", no_argument, NULL, OPTION_NOFORK},
+	{"pipeline", no_argument, NULL, OPTION_PIPELINE},
 	{0}};
 
 bool vtysh_loop_exited;
@@ -402,6 +405,9 @@ int main(int argc, char **argv, char **env)
 		case OPTION_NOFORK:
 			no_fork = true;
 			break;
+		case OPTION_PIPELINE:
+			vtysh_pipelined = true;
+			break;
 		case 'N':
 			if (strchr(optarg, '/') || strchr(optarg, '.')) {
 				fprintf(stderr,
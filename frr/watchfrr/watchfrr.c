@@ -526,6 +526,99 @@ static int run_job(struct restart_info *restart, const char *cmdtype,
 	return restart->pid;
 }
 
+/*
+ * Run one command on the vty socket of a daemon, waiting for it to finish.
+ * Returns the command's status, -1 if the daemon did not answer in time.
+ */
+static int warm_restart_cmd(struct daemon *dmn, int sock, const char *cmd)
+{
+	struct pollfd pfd = {.fd = sock, .events = POLLIN};
+	char buf[512];
+	/* Trailer of the reply: three NULs and the status */
+	unsigned int nuls = 0;
+	ssize_t rc, i;
+
+	if (write(sock, cmd, strlen(cmd) + 1) < 0) {
+		zlog_warn("%s: cannot send \"%s\": %s", dmn->name, cmd,
+			  safe_strerror(errno));
+		return -1;
+	}
+
+	while (poll(&pfd, 1, gs.timeout * 1000) > 0) {
+		rc = read(sock, buf, sizeof(buf));
+		if (rc <= 0)
+			break;
+		for (i = 0; i < rc; i++) {
+			if (nuls == 3)
+				return buf[i];
+			nuls = buf[i] ? 0 : nuls + 1;
+		}
+	}
+
+	zlog_warn("%s: no answer to \"%s\"", dmn->name, cmd);
+	return -1;
+}
+
+void watchfrr_warm_restart(struct vty *vty, const char *dname)
+{
+	struct daemon *dmn;
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	int sock, ret;
+
+	for (dmn = gs.daemons; dmn; dmn = dmn->next)
+		if (strcmp(dmn->name, dname) == 0)
+			break;
+
+	if (!dmn) {
+		vty_out(vty, "%% %s is not configured for running at the moment\n",
+			dname);
+		return;
+	}
+	if (!IS_UP(dmn) || dmn->restart.pid || gs.phase != PHASE_NONE) {
+		vty_out(vty, "%% %s is %s, or a restart is in progress\n",
+			dmn->name, state_str[dmn->state]);
+		return;
+	}
+
+	/* The daemon's own connection, not the one echos go out on */
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/%s.vty", gs.vtydir,
+		 dmn->name);
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0 || connect(sock, (struct sockaddr *)&addr,
+				sizeof(addr)) < 0) {
+		vty_out(vty, "%% cannot connect to %s: %s\n", addr.sun_path,
+			safe_strerror(errno));
+		if (sock >= 0)
+			close(sock);
+		return;
+	}
+	set_cloexec(sock);
+
+	ret = warm_restart_cmd(dmn, sock, "enable");
+	if (ret == CMD_SUCCESS)
+		ret = warm_restart_cmd(dmn, sock, "warm-restart prepare");
+	close(sock);
+
+	if (ret != CMD_SUCCESS) {
+		vty_out(vty, "%% %s did not prepare for a warm restart\n",
+			dmn->name);
+		return;
+	}
+
+	zlog_notice("%s: warm restart", dmn->name);
+
+	/* Inherited by the daemon through the restart command */
+	setenv(FRR_WARM_RESTART_ENV, "1", 1);
+	ret = run_job(&dmn->restart, "warm restart", gs.restart_command, 1, 0);
+	unsetenv(FRR_WARM_RESTART_ENV);
+
+	if (ret <= 0)
+		vty_out(vty, "%% cannot run the restart command for %s\n",
+			dmn->name);
+	else
+		vty_out(vty, "%s restarting\n", dmn->name);
+}
+
 #define SET_READ_HANDLER(DMN)                                                  \
 	do {                                                                   \
 		(DMN)->t_read = NULL;                                          \
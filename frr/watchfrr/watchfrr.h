@@ -36,4 +36,10 @@ extern bool check_all_up(void);
 
 extern void watchfrr_set_ignore_daemon(struct vty *vty, const char *dname,
 				       bool ignore);
+
+/*
+ * Tell a daemon to get ready for a warm restart and restart it, the new
+ * process started with FRR_WARM_RESTART_ENV set.
+ */
+extern void watchfrr_warm_restart(struct vty *vty, const char *dname);
 #endif /* FRR_WATCHFRR_H */
@@ -155,6 +155,18 @@ DEFPY (watchfrr_ignore_daemon,
 	return CMD_SUCCESS;
 }
 
+DEFPY (watchfrr_warm_restart_daemon,
+       watchfrr_warm_restart_daemon_cmd,
+       "watchfrr warm-restart DAEMON$dname",
+       "Watchfrr Specific sub-command\n"
+       "Restart a daemon, handing its state over to the new process\n"
+       "The daemon to restart\n")
+{
+	watchfrr_warm_restart(vty, dname);
+
+	return CMD_SUCCESS;
+}
+
 void integrated_write_sigchld(int status)
 {
 	uint8_t reply[4] = {0, 0, 0, CMD_WARNING};
@@ -191,6 +203,7 @@ void watchfrr_vty_init(void)
 	install_element(ENABLE_NODE, &show_debugging_watchfrr_cmd);
 
 	install_element(ENABLE_NODE, &watchfrr_ignore_daemon_cmd);
+	install_element(ENABLE_NODE, &watchfrr_warm_restart_daemon_cmd);
 
 	install_element(CONFIG_NODE, &show_debugging_watchfrr_cmd);
 	install_element(VIEW_NODE, &show_watchfrr_cmd);
@@ -11,6 +11,7 @@
 #endif
 
 #include "lib/libfrr.h"
+#include "lib/jhash.h"
 
 #include "zebra/debug.h"
 #include "zebra/interface.h"
@@ -28,6 +29,59 @@ static struct zd_dpdk_ctx dpdk_ctx_buf, *dpdk_ctx = &dpdk_ctx_buf;
 static struct zd_dpdk_port *zd_dpdk_port_find_by_index(int ifindex);
 
 DEFINE_MTYPE_STATIC(ZEBRA, DPDK_PORTS, "ZD DPDK port database");
+DEFINE_MTYPE_STATIC(ZEBRA, DPDK_NHG, "ZD DPDK nexthop group");
+DEFINE_MTYPE_STATIC(ZEBRA, DPDK_ROUTE, "ZD DPDK route");
+DEFINE_MTYPE_STATIC(ZEBRA, DPDK_FIB, "ZD DPDK FIB");
+
+static int zd_dpdk_nhg_ref_cmp(const struct zd_dpdk_nhg_ref *a,
+			       const struct zd_dpdk_nhg_ref *b)
+{
+	return numcmp(a->id, b->id);
+}
+
+static uint32_t zd_dpdk_nhg_ref_hash(const struct zd_dpdk_nhg_ref *ref)
+{
+	return jhash_1word(ref->id, 0);
+}
+
+DECLARE_HASH(zd_dpdk_nhg_refs, struct zd_dpdk_nhg_ref, item,
+	     zd_dpdk_nhg_ref_cmp, zd_dpdk_nhg_ref_hash);
+
+static int zd_dpdk_route_cmp(const struct zd_dpdk_route *a,
+			     const struct zd_dpdk_route *b)
+{
+	if (a->table != b->table)
+		return numcmp(a->table, b->table);
+	return prefix_cmp(&a->p, &b->p);
+}
+
+static uint32_t zd_dpdk_route_hash(const struct zd_dpdk_route *route)
+{
+	return jhash_1word(route->table, prefix_hash_key(&route->p));
+}
+
+DECLARE_HASH(zd_dpdk_routes, struct zd_dpdk_route, item, zd_dpdk_route_cmp,
+	     zd_dpdk_route_hash);
+
+static int zd_dpdk_fib_cmp(const struct zd_dpdk_fib *a,
+			   const struct zd_dpdk_fib *b)
+{
+	return numcmp(a->table, b->table);
+}
+
+static uint32_t zd_dpdk_fib_hash(const struct zd_dpdk_fib *fib)
+{
+	return jhash_1word(fib->table, 0);
+}
+
+DECLARE_HASH(zd_dpdk_fibs, struct zd_dpdk_fib, item, zd_dpdk_fib_cmp,
+	     zd_dpdk_fib_hash);
+
+/* Touched from the dataplane pthread only */
+static struct zd_dpdk_nhg_refs_head zd_dpdk_nhg_refs =
+	INIT_HASH(zd_dpdk_nhg_refs);
+static struct zd_dpdk_routes_head zd_dpdk_routes = INIT_HASH(zd_dpdk_routes);
+static struct zd_dpdk_fibs_head zd_dpdk_fibs = INIT_HASH(zd_dpdk_fibs);
 
 void zd_dpdk_stat_show(struct vty *vty)
 {
@@ -45,6 +99,11 @@ void zd_dpdk_stat_show(struct vty *vty)
 
 	ZD_DPDK_SHOW_COUNTER("PBR rule adds", dpdk_stat->rule_adds);
 	ZD_DPDK_SHOW_COUNTER("PBR rule dels", dpdk_stat->rule_dels);
+	ZD_DPDK_SHOW_COUNTER("Route adds", dpdk_stat->route_adds);
+	ZD_DPDK_SHOW_COUNTER("Route dels", dpdk_stat->route_dels);
+	ZD_DPDK_SHOW_COUNTER("NHG updates", dpdk_stat->nhg_updates);
+	ZD_DPDK_SHOW_COUNTER("NHG slots exhausted", dpdk_stat->nhg_exhausted);
+	ZD_DPDK_SHOW_COUNTER("FIB errors", dpdk_stat->fib_errors);
 	ZD_DPDK_SHOW_COUNTER("Ignored updates", dpdk_stat->ignored_updates);
 }
 
@@ -411,6 +470,361 @@ static void zd_dpdk_rule_update(struct zebra_dplane_ctx *ctx)
 }
 
 
+static bool zd_dpdk_fwd_from_nexthop(struct zd_dpdk_fwd *fwd,
+				     const struct nexthop *nh)
+{
+	struct zd_dpdk_port *dport;
+	unsigned int i;
+
+	switch (nh->type) {
+	case NEXTHOP_TYPE_BLACKHOLE:
+		fwd->flags = ZD_DPDK_FWD_BLACKHOLE;
+		return true;
+	case NEXTHOP_TYPE_IPV4:
+	case NEXTHOP_TYPE_IPV4_IFINDEX:
+		fwd->gate.ipv4 = nh->gate.ipv4;
+		break;
+	case NEXTHOP_TYPE_IPV6:
+	case NEXTHOP_TYPE_IPV6_IFINDEX:
+		fwd->flags = ZD_DPDK_FWD_V6;
+		fwd->gate.ipv6 = nh->gate.ipv6;
+		break;
+	case NEXTHOP_TYPE_IFINDEX:
+		break;
+	}
+
+	if (nh->nh_label && nh->nh_label->num_labels) {
+		if (nh->nh_label->num_labels > ZD_DPDK_FWD_LABELS)
+			return false;
+		fwd->label_num = nh->nh_label->num_labels;
+		for (i = 0; i < fwd->label_num; i++)
+			fwd->labels[i] = nh->nh_label->label[i];
+	}
+
+	dport = zd_dpdk_port_find_by_index(nh->ifindex);
+	if (!dport)
+		return false;
+	fwd->port_id = dport->port_id;
+	fwd->ifindex = nh->ifindex;
+	return true;
+}
+
+/*
+ * The buckets of a group, each nexthop taking as many as its share of
+ * the weights. A group with a nexthop not on a DPDK port is left to the
+ * kernel entire, rather than have its traffic go to the others.
+ */
+static void zd_dpdk_nhg_set_build(struct zd_dpdk_nhg_set *set,
+				  const struct nexthop_group *ng)
+{
+	uint32_t weights[ZD_DPDK_NHG_NEXTHOPS];
+	const struct nexthop *nh;
+	uint32_t total = 0, sum = 0;
+	unsigned int i, bucket = 0, end;
+
+	memset(set, 0, sizeof(*set));
+
+	for (ALL_NEXTHOPS_PTR(ng, nh)) {
+		if (CHECK_FLAG(nh->flags, NEXTHOP_FLAG_RECURSIVE) ||
+		    !CHECK_FLAG(nh->flags, NEXTHOP_FLAG_ACTIVE))
+			continue;
+
+		if (set->nexthop_num == ZD_DPDK_NHG_NEXTHOPS ||
+		    !zd_dpdk_fwd_from_nexthop(&set->nexthops[set->nexthop_num],
+					      nh)) {
+			memset(set, 0, sizeof(*set));
+			return;
+		}
+		weights[set->nexthop_num] = nh->weight ? nh->weight : 1;
+		total += weights[set->nexthop_num++];
+	}
+	if (!set->nexthop_num)
+		return;
+
+	for (i = 0; i < set->nexthop_num; i++) {
+		sum += weights[i];
+		end = (uint64_t)sum * ZD_DPDK_NHG_BUCKETS / total;
+		while (bucket < end)
+			set->buckets[bucket++] = i;
+	}
+	set->bucket_num = ZD_DPDK_NHG_BUCKETS;
+}
+
+static void zd_dpdk_nhg_update(struct zd_dpdk_nhg_ref *ref,
+			       const struct nexthop_group *ng)
+{
+	struct zd_dpdk_nhg *nhg = &dpdk_ctx->nhgs[ref->slot];
+	uint32_t gen = atomic_load_explicit(&nhg->gen, memory_order_relaxed);
+	struct zd_dpdk_nhg_set *next = &nhg->sets[(gen + 1) & 1];
+
+	zd_dpdk_nhg_set_build(next, ng);
+	if (!memcmp(next, &nhg->sets[gen & 1], sizeof(*next)))
+		return;
+
+	atomic_store_explicit(&nhg->gen, gen + 1, memory_order_release);
+	atomic_fetch_add_explicit(&dpdk_stat->nhg_updates, 1,
+				  memory_order_relaxed);
+
+	if (IS_ZEBRA_DEBUG_DPLANE_DPDK_DETAIL)
+		zlog_debug("DPDK nhg %u slot %u: %u nexthops", ref->id,
+			   ref->slot, next->nexthop_num);
+}
+
+/* The slot for group id, with the buckets for ng, referenced once more */
+static struct zd_dpdk_nhg_ref *zd_dpdk_nhg_get(uint32_t id,
+					       const struct nexthop_group *ng)
+{
+	struct zd_dpdk_nhg_ref key = {.id = id}, *ref;
+
+	ref = zd_dpdk_nhg_refs_find(&zd_dpdk_nhg_refs, &key);
+	if (!ref) {
+		if (!dpdk_ctx->nhg_free_count) {
+			atomic_fetch_add_explicit(&dpdk_stat->nhg_exhausted, 1,
+						  memory_order_relaxed);
+			return NULL;
+		}
+
+		ref = XCALLOC(MTYPE_DPDK_NHG, sizeof(*ref));
+		ref->id = id;
+		ref->slot = dpdk_ctx->nhg_free[--dpdk_ctx->nhg_free_count];
+		memset(&dpdk_ctx->nhgs[ref->slot], 0,
+		       sizeof(dpdk_ctx->nhgs[ref->slot]));
+		zd_dpdk_nhg_refs_add(&zd_dpdk_nhg_refs, ref);
+	}
+
+	ref->refcnt++;
+	zd_dpdk_nhg_update(ref, ng);
+	return ref;
+}
+
+static void zd_dpdk_nhg_put(struct zd_dpdk_nhg_ref *ref)
+{
+	if (--ref->refcnt)
+		return;
+
+	zd_dpdk_nhg_refs_del(&zd_dpdk_nhg_refs, ref);
+	dpdk_ctx->nhg_free[dpdk_ctx->nhg_free_count++] = ref->slot;
+	XFREE(MTYPE_DPDK_NHG, ref);
+}
+
+static void zd_dpdk_fib_free(struct zd_dpdk_fib *fib)
+{
+	if (fib->fib4)
+		rte_fib_free(fib->fib4);
+	if (fib->fib6)
+		rte_fib6_free(fib->fib6);
+	XFREE(MTYPE_DPDK_FIB, fib);
+}
+
+static struct zd_dpdk_fib *zd_dpdk_fib_get(uint32_t table)
+{
+	struct zd_dpdk_fib key = {.table = table}, *fib;
+	struct rte_fib_conf conf4 = {};
+	struct rte_fib6_conf conf6 = {};
+	char name[RTE_FIB_NAMESIZE];
+
+	fib = zd_dpdk_fibs_find(&zd_dpdk_fibs, &key);
+	if (fib)
+		return fib;
+
+	fib = XCALLOC(MTYPE_DPDK_FIB, sizeof(*fib));
+	fib->table = table;
+
+	conf4.type = RTE_FIB_DIR24_8;
+	conf4.default_nh = ZD_DPDK_NHG_NONE;
+	conf4.max_routes = ZD_DPDK_FIB4_ROUTES;
+	conf4.dir24_8.nh_sz = RTE_FIB_DIR24_8_4B;
+	conf4.dir24_8.num_tbl8 = ZD_DPDK_FIB4_TBL8;
+
+	conf6.type = RTE_FIB6_TRIE;
+	conf6.default_nh = ZD_DPDK_NHG_NONE;
+	conf6.max_routes = ZD_DPDK_FIB6_ROUTES;
+	conf6.trie.nh_sz = RTE_FIB6_TRIE_4B;
+	conf6.trie.num_tbl8 = ZD_DPDK_FIB6_TBL8;
+
+	frr_with_privs (&zserv_privs) {
+		snprintf(name, sizeof(name), ZD_DPDK_FIB4_NAME, table);
+		fib->fib4 = rte_fib_create(name, SOCKET_ID_ANY, &conf4);
+		snprintf(name, sizeof(name), ZD_DPDK_FIB6_NAME, table);
+		fib->fib6 = rte_fib6_create(name, SOCKET_ID_ANY, &conf6);
+	}
+
+	if (!fib->fib4 || !fib->fib6) {
+		zlog_warn("DPDK FIB create failed for table %u: %s", table,
+			  rte_strerror(rte_errno));
+		atomic_fetch_add_explicit(&dpdk_stat->fib_errors, 1,
+					  memory_order_relaxed);
+		zd_dpdk_fib_free(fib);
+		return NULL;
+	}
+
+	zd_dpdk_fibs_add(&zd_dpdk_fibs, fib);
+	return fib;
+}
+
+/* Point p at nhg's slot, or take it out with no nhg */
+static int zd_dpdk_fib_set(struct zd_dpdk_fib *fib, const struct prefix *p,
+			   const struct zd_dpdk_nhg_ref *nhg)
+{
+	uint32_t ip;
+	int rc;
+
+	if (p->family == AF_INET) {
+		ip = ntohl(p->u.prefix4.s_addr);
+		rc = nhg ? rte_fib_add(fib->fib4, ip, p->prefixlen, nhg->slot)
+			 : rte_fib_delete(fib->fib4, ip, p->prefixlen);
+	} else {
+		rc = nhg ? rte_fib6_add(fib->fib6, p->u.prefix6.s6_addr,
+					p->prefixlen, nhg->slot)
+			 : rte_fib6_delete(fib->fib6, p->u.prefix6.s6_addr,
+					   p->prefixlen);
+	}
+
+	if (rc < 0) {
+		atomic_fetch_add_explicit(&dpdk_stat->fib_errors, 1,
+					  memory_order_relaxed);
+		if (IS_ZEBRA_DEBUG_DPLANE_DPDK_DETAIL)
+			zlog_debug("DPDK FIB %s table %u %pFX failed: %s",
+				   nhg ? "add" : "delete", fib->table, p,
+				   rte_strerror(-rc));
+	}
+	return rc;
+}
+
+static void zd_dpdk_route_free(struct zd_dpdk_route *route)
+{
+	zd_dpdk_routes_del(&zd_dpdk_routes, route);
+	if (route->nhg)
+		zd_dpdk_nhg_put(route->nhg);
+	XFREE(MTYPE_DPDK_ROUTE, route);
+}
+
+static void zd_dpdk_route_update(struct zebra_dplane_ctx *ctx)
+{
+	const struct prefix *p = dplane_ctx_get_dest(ctx);
+	const struct prefix *src_p = dplane_ctx_get_src(ctx);
+	struct zd_dpdk_route key = {}, *route;
+	struct zd_dpdk_nhg_ref *nhg;
+	struct zd_dpdk_fib *fib;
+
+	if (!dpdk_ctx->nhgs || (p->family != AF_INET && p->family != AF_INET6) ||
+	    (src_p && src_p->prefixlen)) {
+		atomic_fetch_add_explicit(&dpdk_stat->ignored_updates, 1,
+					  memory_order_relaxed);
+		return;
+	}
+
+	key.table = dplane_ctx_get_table(ctx);
+	prefix_copy(&key.p, p);
+	route = zd_dpdk_routes_find(&zd_dpdk_routes, &key);
+
+	if (dplane_ctx_get_op(ctx) == DPLANE_OP_ROUTE_DELETE) {
+		atomic_fetch_add_explicit(&dpdk_stat->route_dels, 1,
+					  memory_order_relaxed);
+		if (!route)
+			return;
+		fib = zd_dpdk_fib_get(route->table);
+		if (fib)
+			zd_dpdk_fib_set(fib, &route->p, NULL);
+		zd_dpdk_route_free(route);
+		return;
+	}
+
+	atomic_fetch_add_explicit(&dpdk_stat->route_adds, 1,
+				  memory_order_relaxed);
+	fib = zd_dpdk_fib_get(key.table);
+	if (!fib)
+		return;
+
+	nhg = zd_dpdk_nhg_get(dplane_ctx_get_nhe_id(ctx),
+			      dplane_ctx_get_ng(ctx));
+	if (!route) {
+		if (!nhg)
+			return;
+		route = XCALLOC(MTYPE_DPDK_ROUTE, sizeof(*route));
+		route->table = key.table;
+		prefix_copy(&route->p, p);
+		zd_dpdk_routes_add(&zd_dpdk_routes, route);
+	}
+
+	/* Same group, its buckets brought up to date already */
+	if (nhg && nhg == route->nhg) {
+		zd_dpdk_nhg_put(nhg);
+		return;
+	}
+
+	/* Out of slots: the kernel has the route, and forwards it */
+	if (!nhg || zd_dpdk_fib_set(fib, &route->p, nhg) < 0) {
+		if (nhg)
+			zd_dpdk_nhg_put(nhg);
+		if (route->nhg)
+			zd_dpdk_fib_set(fib, &route->p, NULL);
+		zd_dpdk_route_free(route);
+		return;
+	}
+
+	if (route->nhg)
+		zd_dpdk_nhg_put(route->nhg);
+	route->nhg = nhg;
+}
+
+/* Only groups in use by routes are kept up to date */
+static void zd_dpdk_nh_update(struct zebra_dplane_ctx *ctx)
+{
+	struct zd_dpdk_nhg_ref key = {}, *ref;
+
+	key.id = dplane_ctx_get_nhe_id(ctx);
+	ref = zd_dpdk_nhg_refs_find(&zd_dpdk_nhg_refs, &key);
+	if (ref)
+		zd_dpdk_nhg_update(ref, dplane_ctx_get_nhe_ng(ctx));
+}
+
+static int zd_dpdk_nhg_init(void)
+{
+	const struct rte_memzone *zone;
+	uint32_t slot;
+
+	frr_with_privs (&zserv_privs) {
+		zone = rte_memzone_reserve(ZD_DPDK_NHG_ZONE,
+					   sizeof(struct zd_dpdk_nhg) *
+						   ZD_DPDK_NHG_MAX,
+					   SOCKET_ID_ANY, 0);
+	}
+	if (!zone) {
+		zlog_warn("DPDK nexthop group zone reserve failed %s",
+			  rte_strerror(rte_errno));
+		return -1;
+	}
+
+	memset(zone->addr, 0, zone->len);
+	dpdk_ctx->nhg_zone = zone;
+	dpdk_ctx->nhgs = zone->addr;
+
+	/* Handed out lowest first; ZD_DPDK_NHG_NONE never */
+	dpdk_ctx->nhg_free_count = 0;
+	for (slot = ZD_DPDK_NHG_MAX - 1; slot > ZD_DPDK_NHG_NONE; slot--)
+		dpdk_ctx->nhg_free[dpdk_ctx->nhg_free_count++] = slot;
+
+	return 0;
+}
+
+static void zd_dpdk_nhg_fini(void)
+{
+	struct zd_dpdk_route *route;
+	struct zd_dpdk_fib *fib;
+
+	while ((route = zd_dpdk_routes_first(&zd_dpdk_routes)))
+		zd_dpdk_route_free(route);
+	while ((fib = zd_dpdk_fibs_pop(&zd_dpdk_fibs)))
+		zd_dpdk_fib_free(fib);
+
+	if (dpdk_ctx->nhg_zone)
+		rte_memzone_free(dpdk_ctx->nhg_zone);
+	dpdk_ctx->nhg_zone = NULL;
+	dpdk_ctx->nhgs = NULL;
+}
+
+
 /* DPDK provider callback.
  */
 static void zd_dpdk_process_update(struct zebra_dplane_ctx *ctx)
@@ -422,13 +836,17 @@ static void zd_dpdk_process_update(struct zebra_dplane_ctx *ctx)
 	case DPLANE_OP_RULE_DELETE:
 		zd_dpdk_rule_update(ctx);
 		break;
-	case DPLANE_OP_NONE:
 	case DPLANE_OP_ROUTE_INSTALL:
 	case DPLANE_OP_ROUTE_UPDATE:
 	case DPLANE_OP_ROUTE_DELETE:
-	case DPLANE_OP_ROUTE_NOTIFY:
+		zd_dpdk_route_update(ctx);
+		break;
 	case DPLANE_OP_NH_INSTALL:
 	case DPLANE_OP_NH_UPDATE:
+		zd_dpdk_nh_update(ctx);
+		break;
+	case DPLANE_OP_NONE:
+	case DPLANE_OP_ROUTE_NOTIFY:
 	case DPLANE_OP_NH_DELETE:
 	case DPLANE_OP_LSP_INSTALL:
 	case DPLANE_OP_LSP_UPDATE:
@@ -655,6 +1073,9 @@ static int zd_dpdk_init(void)
 	frr_with_privs (&zserv_privs) {
 		zd_dpdk_port_init();
 	}
+
+	/* Without it routes are left to the kernel, PBR works still */
+	zd_dpdk_nhg_init();
 	return 0;
 }
 
@@ -684,6 +1105,8 @@ static int zd_dpdk_finish(struct zebra_dplane_provider *prov, bool early)
 		zlog_debug("%s finish", dplane_provider_get_name(prov));
 
 
+	zd_dpdk_nhg_fini();
+
 	frr_with_privs (&zserv_privs) {
 		rc = rte_eal_cleanup();
 	}
@@ -12,6 +12,13 @@
 #include <zebra.h>
 
 #include <rte_ethdev.h>
+#include <rte_fib.h>
+#include <rte_fib6.h>
+#include <rte_memzone.h>
+
+#include "lib/mpls.h"
+#include "lib/prefix.h"
+#include "lib/typesafe.h"
 
 #include "zebra_dplane_dpdk.h"
 
@@ -23,6 +30,91 @@
 
 #define ZD_ETH_TYPE_IP 0x800
 
+/*
+ * Routes are programmed in a DPDK FIB per table and address family, named
+ * as below, their next hop the index of a group in the ZD_DPDK_NHG_ZONE
+ * memzone. A forwarding process attached to zebra's EAL as a secondary
+ * finds both by name, hashes each flow to a bucket of the group and sends
+ * it to the nexthop the bucket is for. Buckets follow nexthop weights.
+ * Next hop ZD_DPDK_NHG_NONE, and a group without buckets, is for the
+ * kernel to forward.
+ */
+#define ZD_DPDK_FIB4_NAME "frr_fib4_%u"
+#define ZD_DPDK_FIB6_NAME "frr_fib6_%u"
+#define ZD_DPDK_FIB4_ROUTES (1 << 20)
+#define ZD_DPDK_FIB4_TBL8 (1 << 15)
+#define ZD_DPDK_FIB6_ROUTES (1 << 18)
+#define ZD_DPDK_FIB6_TBL8 (1 << 16)
+
+#define ZD_DPDK_NHG_ZONE "frr_nhg"
+#define ZD_DPDK_NHG_MAX 4096
+#define ZD_DPDK_NHG_NONE 0
+#define ZD_DPDK_NHG_NEXTHOPS 16
+#define ZD_DPDK_NHG_BUCKETS 64
+#define ZD_DPDK_FWD_LABELS 4
+
+struct zd_dpdk_fwd {
+	uint16_t port_id;
+	uint16_t flags;
+#define ZD_DPDK_FWD_V6 (1 << 0)
+#define ZD_DPDK_FWD_BLACKHOLE (1 << 1)
+	uint32_t ifindex;
+	/* Outermost first */
+	uint8_t label_num;
+	mpls_label_t labels[ZD_DPDK_FWD_LABELS];
+	/* 0 for a connected nexthop: look the destination up instead */
+	union {
+		struct in_addr ipv4;
+		struct in6_addr ipv6;
+	} gate;
+};
+
+struct zd_dpdk_nhg_set {
+	uint8_t nexthop_num;
+	uint8_t bucket_num;
+	/* Index into nexthops, for each bucket */
+	uint8_t buckets[ZD_DPDK_NHG_BUCKETS];
+	struct zd_dpdk_fwd nexthops[ZD_DPDK_NHG_NEXTHOPS];
+};
+
+/*
+ * A group is rewritten in the set not in use, then made the one in use
+ * with the generation, so readers see one set or the other entire.
+ */
+struct zd_dpdk_nhg {
+	_Atomic uint32_t gen;
+	struct zd_dpdk_nhg_set sets[2];
+};
+
+PREDECL_HASH(zd_dpdk_nhg_refs);
+PREDECL_HASH(zd_dpdk_routes);
+PREDECL_HASH(zd_dpdk_fibs);
+
+/* A zebra nexthop group routes are programmed with, and its slot */
+struct zd_dpdk_nhg_ref {
+	struct zd_dpdk_nhg_refs_item item;
+
+	uint32_t id;
+	uint32_t slot;
+	uint32_t refcnt;
+};
+
+struct zd_dpdk_route {
+	struct zd_dpdk_routes_item item;
+
+	uint32_t table;
+	struct prefix p;
+	struct zd_dpdk_nhg_ref *nhg;
+};
+
+struct zd_dpdk_fib {
+	struct zd_dpdk_fibs_item item;
+
+	uint32_t table;
+	struct rte_fib *fib4;
+	struct rte_fib6 *fib6;
+};
+
 struct zd_dpdk_port {
 	uint16_t port_id;		  /* dpdk port_id */
 	struct rte_eth_dev_info dev_info; /* PCI info + driver name */
@@ -36,6 +128,12 @@ struct zd_dpdk_stat {
 
 	_Atomic uint32_t rule_adds;
 	_Atomic uint32_t rule_dels;
+
+	_Atomic uint32_t route_adds;
+	_Atomic uint32_t route_dels;
+	_Atomic uint32_t nhg_updates;
+	_Atomic uint32_t nhg_exhausted;
+	_Atomic uint32_t fib_errors;
 };
 
 struct zd_dpdk_ctx {
@@ -43,6 +141,12 @@ struct zd_dpdk_ctx {
 	struct zd_dpdk_stat stats;
 	struct zd_dpdk_port *dpdk_ports;
 	int dpdk_logtype;
+
+	/* Groups, by slot, shared with the forwarding process */
+	const struct rte_memzone *nhg_zone;
+	struct zd_dpdk_nhg *nhgs;
+	uint32_t nhg_free[ZD_DPDK_NHG_MAX];
+	uint32_t nhg_free_count;
 };
 
 #endif
@@ -0,0 +1,876 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Zebra dataplane plugin exporting the FIB to shared memory.
+ *
+ * Runs after the kernel provider and mirrors every route it installed,
+ * with its nexthop group, into the segment described in zebra_fib_shm.h,
+ * so that other processes on the host can look routes up in place. The
+ * segment is written from the dataplane pthread only; readers never take
+ * a lock and zebra never waits for them.
+ *
+ * Load with -M dplane_fib_shm, or -M dplane_fib_shm:/name to use another
+ * segment name than FIB_SHM_NAME (one per zebra, with -N).
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h" /* Include this explicitly */
+#endif
+
+#include "lib/zebra.h"
+#include "lib/json.h"
+#include "lib/libfrr.h"
+#include "lib/frratomic.h"
+#include "lib/command.h"
+#include "lib/memory.h"
+#include "zebra/debug.h"
+#include "zebra/rib.h"
+#include "zebra/zebra_dplane.h"
+#include "zebra/zebra_fib_shm.h"
+
+DEFINE_MTYPE_STATIC(ZEBRA, FIB_SHM, "FIB shared-memory export");
+
+static const char *prov_name = "dplane_fib_shm";
+
+/*
+ * A rebuilt segment is made under the configured name with this appended
+ * and renamed over it once complete, in the directory shm_open() keeps
+ * its objects in
+ */
+#define FIB_SHM_DIR "/dev/shm"
+#define FIB_SHM_NEW_SUFFIX ".new"
+
+/*
+ * Writer-side state of one table of the segment: the slots never used are
+ * those from used up, the others freed since are stacked in free_slots.
+ * tombstones counts the removed buckets of its index, which only a
+ * rebuild clears.
+ */
+struct fib_shm_table {
+	uint32_t used;
+	uint32_t *free_slots;
+	uint32_t nfree;
+	uint32_t tombstones;
+};
+
+struct fib_shm_ctx {
+	char name[64];
+	struct fib_shm *shm;
+	size_t size;
+
+	struct fib_shm_table routes;
+	struct fib_shm_table nhgs;
+	/* Routes using each nhgs[] slot */
+	uint32_t *nhg_refcnt;
+
+	/* Something was published since gen was last bumped */
+	bool changed;
+	bool full_logged;
+
+	/* Read from the vty; only the dataplane pthread writes them */
+	struct {
+		_Atomic uint32_t routes;
+		_Atomic uint32_t nhgs;
+		_Atomic uint32_t route_capacity;
+		_Atomic uint32_t nhg_capacity;
+		_Atomic uint32_t size;
+		_Atomic uint64_t updates;
+		_Atomic uint64_t deletes;
+		_Atomic uint64_t failed_installs;
+		_Atomic uint64_t truncated;
+		_Atomic uint64_t rebuilds;
+		_Atomic uint64_t full;
+	} counters;
+};
+
+static struct fib_shm_ctx *gfsc;
+
+static struct fib_shm_route *fib_shm_routes_w(struct fib_shm *shm)
+{
+	return (struct fib_shm_route *)((char *)shm + shm->hdr.off_routes);
+}
+
+static struct fib_shm_bucket *fib_shm_route_index_w(struct fib_shm *shm)
+{
+	return (struct fib_shm_bucket *)((char *)shm + shm->hdr.off_route_index);
+}
+
+static struct fib_shm_nhg *fib_shm_nhgs_w(struct fib_shm *shm)
+{
+	return (struct fib_shm_nhg *)((char *)shm + shm->hdr.off_nhgs);
+}
+
+static struct fib_shm_bucket *fib_shm_nhg_index_w(struct fib_shm *shm)
+{
+	return (struct fib_shm_bucket *)((char *)shm + shm->hdr.off_nhg_index);
+}
+
+/*
+ * Publish val into ent under the seq counter both start with; the seq
+ * word of val is ignored. Readers copy word by word, so write the same way.
+ */
+static void fib_shm_write_entry(void *ent, const void *val, size_t size)
+{
+	uint32_t *to = ent;
+	const uint32_t *from = val;
+	uint32_t seq = to[0];
+	size_t w;
+
+	__atomic_store_n(&to[0], seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	for (w = 1; w < size / 4; w++)
+		__atomic_store_n(&to[w], from[w], __ATOMIC_RELAXED);
+	__atomic_store_n(&to[0], seq + 2, __ATOMIC_RELEASE);
+}
+
+/* Hang slot (an index) off the first free or removed bucket for tag */
+static void fib_shm_index_add(struct fib_shm_bucket *index, uint32_t hash_size,
+			      struct fib_shm_table *table, uint32_t tag,
+			      uint32_t slot)
+{
+	uint32_t mask = hash_size - 1;
+	uint32_t b = fib_shm_hash_tag(tag, hash_size);
+
+	while (index[b].slot != 0 && index[b].slot != FIB_SHM_SLOT_TOMBSTONE)
+		b = (b + 1) & mask;
+	if (index[b].slot == FIB_SHM_SLOT_TOMBSTONE)
+		table->tombstones--;
+	/* A reader seeing the slot sees the tag that goes with it */
+	__atomic_store_n(&index[b].tag, tag, __ATOMIC_RELAXED);
+	__atomic_store_n(&index[b].slot, slot + 1, __ATOMIC_RELEASE);
+}
+
+static int fib_shm_table_alloc(struct fib_shm_table *table, uint32_t capacity)
+{
+	if (table->nfree)
+		return table->free_slots[--table->nfree];
+	if (table->used < capacity)
+		return table->used++;
+	return -1;
+}
+
+/*
+ * Route and group lookups on the writer side: zebra is the only writer,
+ * so entries can be compared in place.
+ */
+static int fib_shm_route_slot(struct fib_shm *shm, uint32_t table_id,
+			      uint8_t family, uint8_t prefixlen,
+			      const struct in6_addr *prefix, uint32_t **bucket)
+{
+	struct fib_shm_bucket *index = fib_shm_route_index_w(shm);
+	struct fib_shm_route *routes = fib_shm_routes_w(shm);
+	uint32_t hash_size = shm->hdr.route_capacity * 2;
+	uint32_t mask = hash_size - 1;
+	uint32_t tag = fib_shm_route_tag(table_id, family, prefixlen, prefix);
+	uint32_t b = fib_shm_hash_tag(tag, hash_size);
+	uint32_t n;
+
+	for (n = 0; n <= mask; n++, b = (b + 1) & mask) {
+		struct fib_shm_route *route;
+
+		if (index[b].slot == 0)
+			return -1;
+		if (index[b].slot == FIB_SHM_SLOT_TOMBSTONE ||
+		    index[b].tag != tag)
+			continue;
+		route = &routes[index[b].slot - 1];
+		if (route->table_id == table_id && route->family == family &&
+		    route->prefixlen == prefixlen &&
+		    !memcmp(&route->prefix, prefix, sizeof(*prefix))) {
+			*bucket = &index[b].slot;
+			return index[b].slot - 1;
+		}
+	}
+	return -1;
+}
+
+static int fib_shm_nhg_slot(struct fib_shm *shm, uint32_t id,
+			    uint32_t **bucket)
+{
+	struct fib_shm_bucket *index = fib_shm_nhg_index_w(shm);
+	struct fib_shm_nhg *nhgs = fib_shm_nhgs_w(shm);
+	uint32_t hash_size = shm->hdr.nhg_capacity * 2;
+	uint32_t mask = hash_size - 1;
+	uint32_t tag = fib_shm_nhg_tag(id);
+	uint32_t b = fib_shm_hash_tag(tag, hash_size);
+	uint32_t n;
+
+	for (n = 0; n <= mask; n++, b = (b + 1) & mask) {
+		if (index[b].slot == 0)
+			return -1;
+		if (index[b].slot != FIB_SHM_SLOT_TOMBSTONE &&
+		    index[b].tag == tag && nhgs[index[b].slot - 1].id == id) {
+			*bucket = &index[b].slot;
+			return index[b].slot - 1;
+		}
+	}
+	return -1;
+}
+
+/* Mark the segment named name, left by an earlier zebra, and remove it */
+static void fib_shm_retire(const char *name)
+{
+	struct fib_shm *old;
+	struct stat st;
+	int fd;
+
+	fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0)
+		return;
+
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(old->hdr)) {
+		old = mmap(NULL, sizeof(old->hdr), PROT_READ | PROT_WRITE,
+			   MAP_SHARED, fd, 0);
+		if (old != MAP_FAILED) {
+			__atomic_fetch_or(&old->hdr.flags, FIB_SHM_F_SUPERSEDED,
+					  __ATOMIC_RELEASE);
+			munmap(old, sizeof(old->hdr));
+		}
+	}
+	close(fd);
+	shm_unlink(name);
+}
+
+/*
+ * Create and map an empty segment under name, which must be free. The
+ * header is left unpublished until the caller has filled it.
+ */
+static struct fib_shm *fib_shm_create(const char *name,
+				      uint32_t route_capacity,
+				      uint32_t nhg_capacity, size_t *sizep)
+{
+	struct fib_shm_hdr layout;
+	struct fib_shm *seg;
+	int fd;
+
+	fib_shm_layout(&layout, route_capacity, nhg_capacity);
+
+	fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd == -1) {
+		zlog_err("%s: failed to create %s: %s", prov_name, name,
+			 safe_strerror(errno));
+		return NULL;
+	}
+
+	/* A fresh object reads as zeroes, which is an empty table */
+	if (ftruncate(fd, layout.total_size) == -1) {
+		zlog_err("%s: failed to size %s: %s", prov_name, name,
+			 safe_strerror(errno));
+		goto fail;
+	}
+
+	seg = mmap(NULL, layout.total_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   fd, 0);
+	if (seg == MAP_FAILED) {
+		zlog_err("%s: failed to map %s: %s", prov_name, name,
+			 safe_strerror(errno));
+		goto fail;
+	}
+	close(fd);
+
+	seg->hdr = layout;
+	*sizep = layout.total_size;
+	return seg;
+
+fail:
+	close(fd);
+	shm_unlink(name);
+	return NULL;
+}
+
+static void fib_shm_publish_counts(struct fib_shm_ctx *fsc)
+{
+	struct fib_shm *shm = fsc->shm;
+
+	atomic_store_explicit(&fsc->counters.routes, shm->route_count,
+			      memory_order_relaxed);
+	atomic_store_explicit(&fsc->counters.nhgs, shm->nhg_count,
+			      memory_order_relaxed);
+}
+
+/*
+ * Move everything into a new segment with the given capacities, dropping
+ * the tombstones on the way, and retire the old one. The new segment is
+ * built aside and takes over the name in a single rename, so consumers
+ * reopening never miss it. Returns false, with the old segment still in
+ * use under its name, if the new one could not be made.
+ */
+static bool fib_shm_rebuild(struct fib_shm_ctx *fsc, uint32_t route_capacity,
+			    uint32_t nhg_capacity)
+{
+	struct fib_shm *old = fsc->shm, *seg;
+	const struct fib_shm_route *old_routes = fib_shm_routes(old);
+	const struct fib_shm_nhg *old_nhgs = fib_shm_nhgs(old);
+	struct fib_shm_table routes = {}, nhgs = {};
+	uint32_t *refcnt, *moved, n;
+	char new_name[sizeof(fsc->name) + sizeof(FIB_SHM_NEW_SUFFIX)];
+	char path[sizeof(FIB_SHM_DIR) + sizeof(new_name)];
+	char new_path[sizeof(path)];
+	size_t size;
+
+	snprintf(new_name, sizeof(new_name), "%s" FIB_SHM_NEW_SUFFIX,
+		 fsc->name);
+	/* Left over by a zebra that died while rebuilding */
+	shm_unlink(new_name);
+	seg = fib_shm_create(new_name, route_capacity, nhg_capacity, &size);
+	if (!seg)
+		return false;
+
+	refcnt = XCALLOC(MTYPE_FIB_SHM, nhg_capacity * sizeof(*refcnt));
+	moved = XCALLOC(MTYPE_FIB_SHM,
+			old->hdr.nhg_capacity * sizeof(*moved));
+	routes.free_slots = XCALLOC(MTYPE_FIB_SHM,
+				    route_capacity * sizeof(uint32_t));
+	nhgs.free_slots = XCALLOC(MTYPE_FIB_SHM,
+				  nhg_capacity * sizeof(uint32_t));
+
+	/* Nobody sees the new segment before its magic: plain copies do */
+	for (n = 0; n < fsc->nhgs.used; n++) {
+		if (!old_nhgs[n].id)
+			continue;
+		fib_shm_nhgs_w(seg)[nhgs.used] = old_nhgs[n];
+		fib_shm_nhgs_w(seg)[nhgs.used].seq = 0;
+		fib_shm_index_add(fib_shm_nhg_index_w(seg), nhg_capacity * 2,
+				  &nhgs, fib_shm_nhg_tag(old_nhgs[n].id),
+				  nhgs.used);
+		refcnt[nhgs.used] = fsc->nhg_refcnt[n];
+		moved[n] = ++nhgs.used;
+	}
+	for (n = 0; n < fsc->routes.used; n++) {
+		struct fib_shm_route *route;
+
+		if (!old_routes[n].family)
+			continue;
+		route = &fib_shm_routes_w(seg)[routes.used];
+		*route = old_routes[n];
+		route->seq = 0;
+		if (route->nhg_slot)
+			route->nhg_slot = moved[route->nhg_slot - 1];
+		fib_shm_index_add(fib_shm_route_index_w(seg),
+				  route_capacity * 2, &routes,
+				  fib_shm_route_tag(route->table_id,
+						    route->family,
+						    route->prefixlen,
+						    &route->prefix),
+				  routes.used);
+		routes.used++;
+	}
+	seg->route_count = old->route_count;
+	seg->nhg_count = old->nhg_count;
+	seg->gen = old->gen + 1;
+	memcpy(seg->plen_count, old->plen_count, sizeof(seg->plen_count));
+
+	/* The leading slash of a POSIX shm name is optional */
+	snprintf(path, sizeof(path), FIB_SHM_DIR "/%s",
+		 fsc->name + (fsc->name[0] == '/'));
+	snprintf(new_path, sizeof(new_path), FIB_SHM_DIR "/%s",
+		 new_name + (new_name[0] == '/'));
+	if (rename(new_path, path) == -1) {
+		zlog_err("%s: failed to replace %s: %s", prov_name, fsc->name,
+			 safe_strerror(errno));
+		munmap(seg, size);
+		shm_unlink(new_name);
+		XFREE(MTYPE_FIB_SHM, moved);
+		XFREE(MTYPE_FIB_SHM, refcnt);
+		XFREE(MTYPE_FIB_SHM, routes.free_slots);
+		XFREE(MTYPE_FIB_SHM, nhgs.free_slots);
+		return false;
+	}
+	__atomic_store_n(&seg->hdr.magic, FIB_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	/* Readers of the old mapping keep a consistent, frozen table */
+	__atomic_fetch_or(&old->hdr.flags, FIB_SHM_F_SUPERSEDED,
+			  __ATOMIC_RELEASE);
+	munmap(old, fsc->size);
+
+	XFREE(MTYPE_FIB_SHM, moved);
+	XFREE(MTYPE_FIB_SHM, fsc->nhg_refcnt);
+	XFREE(MTYPE_FIB_SHM, fsc->routes.free_slots);
+	XFREE(MTYPE_FIB_SHM, fsc->nhgs.free_slots);
+	fsc->shm = seg;
+	fsc->size = size;
+	fsc->routes = routes;
+	fsc->nhgs = nhgs;
+	fsc->nhg_refcnt = refcnt;
+
+	atomic_store_explicit(&fsc->counters.route_capacity, route_capacity,
+			      memory_order_relaxed);
+	atomic_store_explicit(&fsc->counters.nhg_capacity, nhg_capacity,
+			      memory_order_relaxed);
+	atomic_store_explicit(&fsc->counters.size, size, memory_order_relaxed);
+	atomic_fetch_add_explicit(&fsc->counters.rebuilds, 1,
+				  memory_order_relaxed);
+	if (IS_ZEBRA_DEBUG_DPLANE)
+		zlog_debug("%s: rebuilt %s for %u routes and %u groups",
+			   prov_name, fsc->name, route_capacity, nhg_capacity);
+	return true;
+}
+
+/*
+ * Capacity for a table holding count entries, with one more to come, once
+ * full or at three quarters of its buckets used: current if a rebuild only
+ * needs to clear tombstones, 0 if over max.
+ */
+static uint32_t fib_shm_grow(const struct fib_shm_table *table,
+			     uint32_t count, uint32_t capacity, uint32_t max)
+{
+	if (count < capacity &&
+	    (count + table->tombstones + 1) * 4 <= capacity * 2 * 3)
+		return capacity;
+	return fib_shm_capacity_for((count + 1) * 3 / 2, max);
+}
+
+/* Make room for one more route and one more group; false if there is none */
+static bool fib_shm_reserve(struct fib_shm_ctx *fsc)
+{
+	struct fib_shm *shm = fsc->shm;
+	uint32_t route_capacity, nhg_capacity;
+
+	route_capacity = fib_shm_grow(&fsc->routes, shm->route_count,
+				      shm->hdr.route_capacity,
+				      FIB_SHM_MAX_ROUTES);
+	nhg_capacity = fib_shm_grow(&fsc->nhgs, shm->nhg_count,
+				    shm->hdr.nhg_capacity, FIB_SHM_MAX_NHGS);
+	if (!route_capacity || !nhg_capacity) {
+		atomic_fetch_add_explicit(&fsc->counters.full, 1,
+					  memory_order_relaxed);
+		if (!fsc->full_logged)
+			zlog_warn("%s: %s is full, routes beyond %u or groups beyond %u are not exported",
+				  prov_name, fsc->name, FIB_SHM_MAX_ROUTES,
+				  FIB_SHM_MAX_NHGS);
+		fsc->full_logged = true;
+		return false;
+	}
+	if (route_capacity == shm->hdr.route_capacity &&
+	    nhg_capacity == shm->hdr.nhg_capacity &&
+	    shm->route_count < route_capacity && shm->nhg_count < nhg_capacity)
+		return true;
+	return fib_shm_rebuild(fsc, route_capacity, nhg_capacity);
+}
+
+/* Drop a route's reference to the group in slot (an index) */
+static void fib_shm_nhg_put(struct fib_shm_ctx *fsc, uint32_t slot)
+{
+	struct fib_shm *shm = fsc->shm;
+	struct fib_shm_nhg *nhg = &fib_shm_nhgs_w(shm)[slot];
+	struct fib_shm_nhg empty = {};
+	uint32_t *bucket;
+
+	if (--fsc->nhg_refcnt[slot])
+		return;
+
+	if (fib_shm_nhg_slot(shm, nhg->id, &bucket) >= 0) {
+		__atomic_store_n(bucket, FIB_SHM_SLOT_TOMBSTONE,
+				 __ATOMIC_RELEASE);
+		fsc->nhgs.tombstones++;
+	}
+	fib_shm_write_entry(nhg, &empty, sizeof(empty));
+	fsc->nhgs.free_slots[fsc->nhgs.nfree++] = slot;
+	shm->nhg_count--;
+}
+
+/* A group as it goes to the kernel: resolved and active nexthops only */
+static void fib_shm_nhg_from_ctx(struct fib_shm_ctx *fsc,
+				 const struct zebra_dplane_ctx *ctx,
+				 struct fib_shm_nhg *nhg)
+{
+	const struct nexthop *nexthop;
+
+	memset(nhg, 0, sizeof(*nhg));
+	nhg->id = dplane_ctx_get_nhg_id(ctx);
+
+	for (ALL_NEXTHOPS_PTR(dplane_ctx_get_ng(ctx), nexthop)) {
+		struct fib_shm_nexthop *nh;
+
+		if (CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE) ||
+		    !CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+			continue;
+		if (nhg->nexthop_total++ >= FIB_SHM_NEXTHOPS)
+			continue;
+
+		nh = &nhg->nexthops[nhg->nexthop_num++];
+		nh->type = nexthop->type;
+		nh->ifindex = nexthop->ifindex;
+		nh->vrf_id = nexthop->vrf_id;
+		nh->weight = nexthop->weight;
+		if (CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ONLINK))
+			nh->flags |= FIB_SHM_NH_ONLINK;
+		if (nexthop->nh_label && nexthop->nh_label->num_labels)
+			nh->label = nexthop->nh_label->label[0];
+
+		switch (nexthop->type) {
+		case NEXTHOP_TYPE_IPV4:
+		case NEXTHOP_TYPE_IPV4_IFINDEX:
+			nh->family = AF_INET;
+			memcpy(&nh->gate, &nexthop->gate.ipv4,
+			       sizeof(nexthop->gate.ipv4));
+			break;
+		case NEXTHOP_TYPE_IPV6:
+		case NEXTHOP_TYPE_IPV6_IFINDEX:
+			nh->family = AF_INET6;
+			nh->gate = nexthop->gate.ipv6;
+			break;
+		case NEXTHOP_TYPE_IFINDEX:
+		case NEXTHOP_TYPE_BLACKHOLE:
+			break;
+		}
+	}
+
+	if (nhg->nexthop_total > FIB_SHM_NEXTHOPS)
+		atomic_fetch_add_explicit(&fsc->counters.truncated, 1,
+					  memory_order_relaxed);
+}
+
+/*
+ * Take a reference to the group of ctx, adding or refreshing it; returns
+ * its slot (an index), or -1 for a route without nexthops. A recursive
+ * group keeps its id while what it resolves to moves, so the content is
+ * compared every time.
+ */
+static int fib_shm_nhg_get(struct fib_shm_ctx *fsc,
+			   const struct zebra_dplane_ctx *ctx)
+{
+	struct fib_shm *shm = fsc->shm;
+	struct fib_shm_nhg nhg, *ent;
+	uint32_t *bucket;
+	int slot;
+
+	fib_shm_nhg_from_ctx(fsc, ctx, &nhg);
+	if (!nhg.id || !nhg.nexthop_num)
+		return -1;
+
+	slot = fib_shm_nhg_slot(shm, nhg.id, &bucket);
+	if (slot >= 0) {
+		ent = &fib_shm_nhgs_w(shm)[slot];
+		nhg.seq = ent->seq;
+		if (memcmp(ent, &nhg, sizeof(nhg)))
+			fib_shm_write_entry(ent, &nhg, sizeof(nhg));
+		fsc->nhg_refcnt[slot]++;
+		return slot;
+	}
+
+	slot = fib_shm_table_alloc(&fsc->nhgs, shm->hdr.nhg_capacity);
+	assert(slot >= 0);
+	fib_shm_write_entry(&fib_shm_nhgs_w(shm)[slot], &nhg, sizeof(nhg));
+	fib_shm_index_add(fib_shm_nhg_index_w(shm), shm->hdr.nhg_capacity * 2,
+			  &fsc->nhgs, fib_shm_nhg_tag(nhg.id), slot);
+	fsc->nhg_refcnt[slot] = 1;
+	shm->nhg_count++;
+	return slot;
+}
+
+/* The route key of ctx; false for what the segment does not carry */
+static bool fib_shm_ctx_key(const struct zebra_dplane_ctx *ctx,
+			    struct fib_shm_route *key)
+{
+	const struct prefix *p = dplane_ctx_get_dest(ctx);
+	const struct prefix *src_p = dplane_ctx_get_src(ctx);
+
+	/* Source-specific routes have no place in a per-prefix table */
+	if (src_p && src_p->prefixlen)
+		return false;
+
+	memset(key, 0, sizeof(*key));
+	switch (p->family) {
+	case AF_INET:
+		memcpy(&key->prefix, &p->u.prefix4, sizeof(p->u.prefix4));
+		break;
+	case AF_INET6:
+		key->prefix = p->u.prefix6;
+		break;
+	default:
+		return false;
+	}
+	key->family = p->family;
+	key->prefixlen = p->prefixlen;
+	key->table_id = dplane_ctx_get_table(ctx);
+	fib_shm_apply_mask(&key->prefix, key->family, key->prefixlen);
+	return true;
+}
+
+static void fib_shm_route_delete(struct fib_shm_ctx *fsc,
+				 const struct fib_shm_route *key)
+{
+	struct fib_shm *shm = fsc->shm;
+	struct fib_shm_route *route, empty = {};
+	uint32_t *bucket, nhg_slot;
+	int slot;
+
+	slot = fib_shm_route_slot(shm, key->table_id, key->family,
+				  key->prefixlen, &key->prefix, &bucket);
+	if (slot < 0)
+		return;
+
+	route = &fib_shm_routes_w(shm)[slot];
+	nhg_slot = route->nhg_slot;
+	__atomic_store_n(bucket, FIB_SHM_SLOT_TOMBSTONE, __ATOMIC_RELEASE);
+	fsc->routes.tombstones++;
+	fib_shm_write_entry(route, &empty, sizeof(empty));
+	fsc->routes.free_slots[fsc->routes.nfree++] = slot;
+	shm->route_count--;
+	__atomic_fetch_sub(&shm->plen_count[key->family == AF_INET ? 0 : 1]
+					   [key->prefixlen],
+			   1, __ATOMIC_RELAXED);
+	if (nhg_slot)
+		fib_shm_nhg_put(fsc, nhg_slot - 1);
+	fsc->changed = true;
+}
+
+static void fib_shm_route_update(struct fib_shm_ctx *fsc,
+				 const struct zebra_dplane_ctx *ctx,
+				 struct fib_shm_route *route)
+{
+	struct fib_shm *shm;
+	struct fib_shm_route *ent;
+	uint32_t *bucket, old_nhg = 0;
+	int slot, nhg_slot;
+
+	if (!fib_shm_reserve(fsc))
+		return;
+	shm = fsc->shm;
+
+	/* The group first, so that no reader follows the route to nothing */
+	nhg_slot = fib_shm_nhg_get(fsc, ctx);
+	route->nhg_slot = nhg_slot + 1;
+	route->nhg_id = nhg_slot >= 0 ? dplane_ctx_get_nhg_id(ctx) : 0;
+	route->type = dplane_ctx_get_type(ctx);
+	route->distance = dplane_ctx_get_distance(ctx);
+	route->metric = dplane_ctx_get_metric(ctx);
+	route->vrf_id = dplane_ctx_get_vrf(ctx);
+	route->rib_version = dplane_ctx_get_rib_version(ctx);
+
+	slot = fib_shm_route_slot(shm, route->table_id, route->family,
+				  route->prefixlen, &route->prefix, &bucket);
+	if (slot >= 0) {
+		ent = &fib_shm_routes_w(shm)[slot];
+		old_nhg = ent->nhg_slot;
+		fib_shm_write_entry(ent, route, sizeof(*route));
+	} else {
+		slot = fib_shm_table_alloc(&fsc->routes,
+					   shm->hdr.route_capacity);
+		assert(slot >= 0);
+		fib_shm_write_entry(&fib_shm_routes_w(shm)[slot], route,
+				    sizeof(*route));
+		fib_shm_index_add(fib_shm_route_index_w(shm),
+				  shm->hdr.route_capacity * 2, &fsc->routes,
+				  fib_shm_route_tag(route->table_id,
+						    route->family,
+						    route->prefixlen,
+						    &route->prefix),
+				  slot);
+		shm->route_count++;
+		__atomic_fetch_add(&shm->plen_count[route->family == AF_INET
+								? 0
+								: 1]
+						   [route->prefixlen],
+				   1, __ATOMIC_RELAXED);
+	}
+	if (old_nhg)
+		fib_shm_nhg_put(fsc, old_nhg - 1);
+	fsc->changed = true;
+}
+
+static void fib_shm_handle(struct fib_shm_ctx *fsc,
+			   const struct zebra_dplane_ctx *ctx)
+{
+	struct fib_shm_route route;
+	bool ok;
+
+	switch (dplane_ctx_get_op(ctx)) {
+	case DPLANE_OP_ROUTE_INSTALL:
+	case DPLANE_OP_ROUTE_UPDATE:
+	case DPLANE_OP_ROUTE_DELETE:
+		break;
+	default:
+		return;
+	}
+	if (!fib_shm_ctx_key(ctx, &route))
+		return;
+
+	ok = dplane_ctx_get_status(ctx) == ZEBRA_DPLANE_REQUEST_SUCCESS;
+	if (dplane_ctx_get_op(ctx) != DPLANE_OP_ROUTE_DELETE && ok) {
+		fib_shm_route_update(fsc, ctx, &route);
+		atomic_fetch_add_explicit(&fsc->counters.updates, 1,
+					  memory_order_relaxed);
+		return;
+	}
+
+	/* Gone, or a failed install that left nothing in the FIB */
+	fib_shm_route_delete(fsc, &route);
+	if (ok)
+		atomic_fetch_add_explicit(&fsc->counters.deletes, 1,
+					  memory_order_relaxed);
+	else
+		atomic_fetch_add_explicit(&fsc->counters.failed_installs, 1,
+					  memory_order_relaxed);
+}
+
+static int fib_shm_process(struct zebra_dplane_provider *prov)
+{
+	struct fib_shm_ctx *fsc = dplane_provider_get_data(prov);
+	struct zebra_dplane_ctx *ctx;
+	int counter, limit;
+
+	limit = dplane_provider_get_work_limit(prov);
+	for (counter = 0; counter < limit; counter++) {
+		ctx = dplane_provider_dequeue_in_ctx(prov);
+		if (!ctx)
+			break;
+
+		/* Only watching: the kernel's result goes on untouched */
+		if (fsc->shm)
+			fib_shm_handle(fsc, ctx);
+		dplane_provider_enqueue_out_ctx(prov, ctx);
+	}
+
+	if (fsc->changed) {
+		__atomic_add_fetch(&fsc->shm->gen, 1, __ATOMIC_RELEASE);
+		fib_shm_publish_counts(fsc);
+		fsc->changed = false;
+	}
+
+	/* Ensure dataplane thread is rescheduled if we hit the work limit */
+	if (counter >= limit)
+		dplane_provider_work_ready();
+
+	return 0;
+}
+
+static int fib_shm_start(struct zebra_dplane_provider *prov)
+{
+	struct fib_shm_ctx *fsc = dplane_provider_get_data(prov);
+	uint32_t route_capacity = FIB_SHM_MIN_CAPACITY;
+	uint32_t nhg_capacity = FIB_SHM_MIN_CAPACITY;
+
+	fib_shm_retire(fsc->name);
+	fsc->shm = fib_shm_create(fsc->name, route_capacity, nhg_capacity,
+				  &fsc->size);
+	if (!fsc->shm)
+		return 0;
+
+	fsc->nhg_refcnt = XCALLOC(MTYPE_FIB_SHM,
+				  nhg_capacity * sizeof(uint32_t));
+	fsc->routes.free_slots = XCALLOC(MTYPE_FIB_SHM,
+					 route_capacity * sizeof(uint32_t));
+	fsc->nhgs.free_slots = XCALLOC(MTYPE_FIB_SHM,
+				       nhg_capacity * sizeof(uint32_t));
+	__atomic_store_n(&fsc->shm->hdr.magic, FIB_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	atomic_store_explicit(&fsc->counters.route_capacity, route_capacity,
+			      memory_order_relaxed);
+	atomic_store_explicit(&fsc->counters.nhg_capacity, nhg_capacity,
+			      memory_order_relaxed);
+	atomic_store_explicit(&fsc->counters.size, fsc->size,
+			      memory_order_relaxed);
+	return 0;
+}
+
+static int fib_shm_finish(struct zebra_dplane_provider *prov, bool early)
+{
+	struct fib_shm_ctx *fsc = dplane_provider_get_data(prov);
+
+	if (early)
+		return 0;
+
+	/* Consumers re-opening find nothing, and know zebra is gone */
+	if (fsc->shm) {
+		__atomic_fetch_or(&fsc->shm->hdr.flags, FIB_SHM_F_SUPERSEDED,
+				  __ATOMIC_RELEASE);
+		munmap(fsc->shm, fsc->size);
+		shm_unlink(fsc->name);
+		fsc->shm = NULL;
+	}
+	XFREE(MTYPE_FIB_SHM, fsc->nhg_refcnt);
+	XFREE(MTYPE_FIB_SHM, fsc->routes.free_slots);
+	XFREE(MTYPE_FIB_SHM, fsc->nhgs.free_slots);
+	return 0;
+}
+
+DEFUN(fib_shm_show_counters, fib_shm_show_counters_cmd,
+      "show fib-shm counters [json]",
+      SHOW_STR
+      "FIB shared-memory export\n"
+      "Export statistic counters\n"
+      JSON_STR)
+{
+	struct json_object *jo;
+
+#define COUNTER(counter) \
+	atomic_load_explicit(&gfsc->counters.counter, memory_order_relaxed)
+
+	if (use_json(argc, argv)) {
+		jo = json_object_new_object();
+		json_object_string_add(jo, "name", gfsc->name);
+		json_object_int_add(jo, "size", COUNTER(size));
+		json_object_int_add(jo, "routes", COUNTER(routes));
+		json_object_int_add(jo, "route-capacity",
+				    COUNTER(route_capacity));
+		json_object_int_add(jo, "nexthop-groups", COUNTER(nhgs));
+		json_object_int_add(jo, "nexthop-group-capacity",
+				    COUNTER(nhg_capacity));
+		json_object_int_add(jo, "updates", COUNTER(updates));
+		json_object_int_add(jo, "deletes", COUNTER(deletes));
+		json_object_int_add(jo, "failed-installs",
+				    COUNTER(failed_installs));
+		json_object_int_add(jo, "truncated-groups", COUNTER(truncated));
+		json_object_int_add(jo, "rebuilds", COUNTER(rebuilds));
+		json_object_int_add(jo, "full-drops", COUNTER(full));
+		vty_json(vty, jo);
+		return CMD_SUCCESS;
+	}
+
+	vty_out(vty, "%30s\n%30s\n", "FIB export counters",
+		"===================");
+	vty_out(vty, "%28s: %s\n", "Segment", gfsc->name);
+	vty_out(vty, "%28s: %u\n", "Segment size", COUNTER(size));
+	vty_out(vty, "%28s: %u of %u\n", "Routes", COUNTER(routes),
+		COUNTER(route_capacity));
+	vty_out(vty, "%28s: %u of %u\n", "Nexthop groups", COUNTER(nhgs),
+		COUNTER(nhg_capacity));
+	vty_out(vty, "%28s: %" PRIu64 "\n", "Route updates", COUNTER(updates));
+	vty_out(vty, "%28s: %" PRIu64 "\n", "Route deletes", COUNTER(deletes));
+	vty_out(vty, "%28s: %" PRIu64 "\n", "Failed installs",
+		COUNTER(failed_installs));
+	vty_out(vty, "%28s: %" PRIu64 "\n", "Truncated groups",
+		COUNTER(truncated));
+	vty_out(vty, "%28s: %" PRIu64 "\n", "Rebuilds", COUNTER(rebuilds));
+	vty_out(vty, "%28s: %" PRIu64 "\n", "Dropped when full", COUNTER(full));
+
+#undef COUNTER
+
+	return CMD_SUCCESS;
+}
+
+static int fib_shm_new(struct event_loop *tm)
+{
+	const char *name = THIS_MODULE->load_args;
+	int rv;
+
+	gfsc = XCALLOC(MTYPE_FIB_SHM, sizeof(*gfsc));
+	strlcpy(gfsc->name, name && *name ? name : FIB_SHM_NAME,
+		sizeof(gfsc->name));
+
+	rv = dplane_provider_register(prov_name, DPLANE_PRIO_POSTPROCESS,
+				      DPLANE_PROV_FLAGS_DEFAULT, fib_shm_start,
+				      fib_shm_process, fib_shm_finish, gfsc,
+				      NULL);
+
+	if (IS_ZEBRA_DEBUG_DPLANE)
+		zlog_debug("%s register status: %d", prov_name, rv);
+
+	install_element(VIEW_NODE, &fib_shm_show_counters_cmd);
+
+	return 0;
+}
+
+static int fib_shm_init(void)
+{
+	hook_register(frr_late_init, fib_shm_new);
+	return 0;
+}
+
+FRR_MODULE_SETUP(
+	.name = "dplane_fib_shm",
+	.version = "0.0.1",
+	.description = "Data plane plugin exporting the FIB to shared memory.",
+	.init = fib_shm_init,
+);
@@ -18,6 +18,9 @@
 #include <errno.h>
 #include <string.h>
 
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+
 #include "lib/zebra.h"
 #include "lib/json.h"
 #include "lib/libfrr.h"
@@ -57,6 +60,12 @@
  */
 #define FPM_HEADER_SIZE 4
 
+/*
+ * Netlink messages packed into one FPM frame, at most: servers checking
+ * frames with fpm_msg_ok() take none longer than FPM_MAX_MSG_LEN.
+ */
+#define FPM_BATCH_SIZE (FPM_MAX_MSG_LEN - FPM_HEADER_SIZE)
+
 static const char *prov_name = "dplane_fpm_nl";
 
 struct fpm_nl_ctx {
@@ -66,12 +75,40 @@ struct fpm_nl_ctx {
 	bool connecting;
 	bool use_nhg;
 	bool use_route_replace;
+	bool use_batching;
+	bool use_delta_resync;
 	struct sockaddr_storage addr;
 
 	/* data plane buffers. */
 	struct stream *ibuf;
 	struct stream *obuf;
 	pthread_mutex_t obuf_mutex;
+	/* Left of the frame at the head of obuf, when half written. */
+	uint16_t obuf_head_left;
+
+	/*
+	 * Delta resync: while the server is away, the frames it missed are
+	 * kept in the backlog (valid until it overflows) and sent ahead of
+	 * anything else once it is back, in place of replaying everything.
+	 * The server was sent all there is as of `epoch` when `synced` is
+	 * set. Guarded by obuf_mutex.
+	 */
+	struct stream *backlog;
+	bool backlog_valid;
+	bool synced;
+	uint32_t epoch;
+
+	/*
+	 * RIB versions (see rib_walk_changed_since()) of the last route
+	 * change given to obuf, of the last one written out of it, and the
+	 * one the server had all changes up to when its connection was lost,
+	 * 0 if unknown. Guarded by obuf_mutex.
+	 */
+	uint64_t rib_version_queued;
+	uint64_t rib_version_written;
+	uint64_t rib_version_resume;
+	/* The RIB walk only sends the changes after this version, if set. */
+	uint64_t rib_since;
 
 	/*
 	 * data plane context queue:
@@ -131,6 +168,28 @@ struct fpm_nl_ctx {
 
 		/* Amount of buffer full events. */
 		_Atomic uint32_t buffer_full;
+
+		/* Amount of FPM frames, of one or more messages, enqueued. */
+		_Atomic uint32_t frames;
+		/* Time spent encoding data plane contexts, microseconds. */
+		_Atomic uint64_t encode_usecs;
+		/* Longest encoding of a data plane context. */
+		_Atomic uint32_t encode_usecs_peak;
+		/* Time spent in socket writes, microseconds. */
+		_Atomic uint64_t write_usecs;
+		/* Longest socket write. */
+		_Atomic uint32_t write_usecs_peak;
+
+		/* Amount of replays of everything on connecting. */
+		_Atomic uint32_t full_resyncs;
+		/* Amount of connections resumed from the backlog. */
+		_Atomic uint32_t delta_resyncs;
+		/* Amount of connections resumed by walking RIB changes. */
+		_Atomic uint32_t rib_delta_walks;
+		/* Amount of times the backlog ran out of space. */
+		_Atomic uint32_t backlog_overflows;
+		/* Backlog current usage. */
+		_Atomic uint32_t backlog_bytes;
 	} counters;
 } *gfnc;
 
@@ -145,6 +204,8 @@ enum fpm_nl_events {
 	FNE_TOGGLE_NHG,
 	/* Reconnect request by our own code to avoid races. */
 	FNE_INTERNAL_RECONNECT,
+	/* Replay everything, under a new epoch. */
+	FNE_INTERNAL_RESYNC,
 
 	/* LSP walk finished. */
 	FNE_LSP_FINISHED,
@@ -177,6 +238,7 @@ static void fpm_rib_send(struct event *t);
 static void fpm_rib_reset(struct event *t);
 static void fpm_rmac_send(struct event *t);
 static void fpm_rmac_reset(struct event *t);
+static void fpm_sync_start(struct fpm_nl_ctx *fnc);
 
 /*
  * CLI.
@@ -302,6 +364,44 @@ DEFUN(no_fpm_use_route_replace, no_fpm_use_route_replace_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(fpm_use_batching, fpm_use_batching_cmd,
+      "fpm use-message-batching",
+      FPM_STR
+      "Pack several netlink messages into each FPM frame\n")
+{
+	gfnc->use_batching = true;
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_fpm_use_batching, no_fpm_use_batching_cmd,
+      "no fpm use-message-batching",
+      NO_STR
+      FPM_STR
+      "Pack several netlink messages into each FPM frame\n")
+{
+	gfnc->use_batching = false;
+	return CMD_SUCCESS;
+}
+
+DEFUN(fpm_use_delta_resync, fpm_use_delta_resync_cmd,
+      "fpm use-delta-resync",
+      FPM_STR
+      "Send only what changed while disconnected on reconnecting\n")
+{
+	gfnc->use_delta_resync = true;
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_fpm_use_delta_resync, no_fpm_use_delta_resync_cmd,
+      "no fpm use-delta-resync",
+      NO_STR
+      FPM_STR
+      "Send only what changed while disconnected on reconnecting\n")
+{
+	gfnc->use_delta_resync = false;
+	return CMD_SUCCESS;
+}
+
 DEFUN(fpm_reset_counters, fpm_reset_counters_cmd,
       "clear fpm counters",
       CLEAR_STR
@@ -339,6 +439,19 @@ DEFUN(fpm_show_counters, fpm_show_counters_cmd,
 	SHOW_COUNTER("Buffer full hits", gfnc->counters.buffer_full);
 	SHOW_COUNTER("User FPM configurations", gfnc->counters.user_configures);
 	SHOW_COUNTER("User FPM disable requests", gfnc->counters.user_disables);
+	SHOW_COUNTER("Frames enqueued", gfnc->counters.frames);
+	vty_out(vty, "%28s: %" PRIu64 "\n", "Encode time (usecs)",
+		(uint64_t)gfnc->counters.encode_usecs);
+	SHOW_COUNTER("Encode time peak (usecs)",
+		     gfnc->counters.encode_usecs_peak);
+	vty_out(vty, "%28s: %" PRIu64 "\n", "Write time (usecs)",
+		(uint64_t)gfnc->counters.write_usecs);
+	SHOW_COUNTER("Write time peak (usecs)", gfnc->counters.write_usecs_peak);
+	SHOW_COUNTER("Full resyncs", gfnc->counters.full_resyncs);
+	SHOW_COUNTER("Delta resyncs", gfnc->counters.delta_resyncs);
+	SHOW_COUNTER("RIB delta walks", gfnc->counters.rib_delta_walks);
+	SHOW_COUNTER("Backlog overflows", gfnc->counters.backlog_overflows);
+	SHOW_COUNTER("Backlog current size", gfnc->counters.backlog_bytes);
 
 #undef SHOW_COUNTER
 
@@ -373,6 +486,20 @@ DEFUN(fpm_show_counters_json, fpm_show_counters_json_cmd,
 	json_object_int_add(jo, "user-configures",
 			    gfnc->counters.user_configures);
 	json_object_int_add(jo, "user-disables", gfnc->counters.user_disables);
+	json_object_int_add(jo, "frames", gfnc->counters.frames);
+	json_object_int_add(jo, "encode-usecs", gfnc->counters.encode_usecs);
+	json_object_int_add(jo, "encode-usecs-peak",
+			    gfnc->counters.encode_usecs_peak);
+	json_object_int_add(jo, "write-usecs", gfnc->counters.write_usecs);
+	json_object_int_add(jo, "write-usecs-peak",
+			    gfnc->counters.write_usecs_peak);
+	json_object_int_add(jo, "full-resyncs", gfnc->counters.full_resyncs);
+	json_object_int_add(jo, "delta-resyncs", gfnc->counters.delta_resyncs);
+	json_object_int_add(jo, "rib-delta-walks",
+			    gfnc->counters.rib_delta_walks);
+	json_object_int_add(jo, "backlog-overflows",
+			    gfnc->counters.backlog_overflows);
+	json_object_int_add(jo, "backlog-bytes", gfnc->counters.backlog_bytes);
 	vty_json(vty, jo);
 
 	return CMD_SUCCESS;
@@ -421,6 +548,16 @@ static int fpm_write_config(struct vty *vty)
 		written = 1;
 	}
 
+	if (!gfnc->use_batching) {
+		vty_out(vty, "no fpm use-message-batching\n");
+		written = 1;
+	}
+
+	if (gfnc->use_delta_resync) {
+		vty_out(vty, "fpm use-delta-resync\n");
+		written = 1;
+	}
+
 	return written;
 }
 
@@ -436,9 +573,59 @@ static struct cmd_node fpm_node = {
  */
 static void fpm_connect(struct event *t);
 
-static void fpm_reconnect(struct fpm_nl_ctx *fnc)
+static void fpm_counter_peak(_Atomic uint32_t *peak, uint32_t value)
+{
+	if (atomic_load_explicit(peak, memory_order_relaxed) < value)
+		atomic_store_explicit(peak, value, memory_order_relaxed);
+}
+
+static void fpm_backlog_drop(struct fpm_nl_ctx *fnc)
+{
+	stream_reset(fnc->backlog);
+	fnc->backlog_valid = false;
+	atomic_store_explicit(&fnc->counters.backlog_bytes, 0,
+			      memory_order_relaxed);
+}
+
+/*
+ * The connection is going away with obuf still holding what it did not
+ * get: keep that in the backlog for a delta resync, if the server had
+ * everything before, and whatever was written reached it. Otherwise the
+ * next connection replays it all. Called with obuf_mutex held.
+ */
+static void fpm_backlog_keep(struct fpm_nl_ctx *fnc)
+{
+	size_t unsent = STREAM_READABLE(fnc->obuf);
+	int pending = 0;
+
+	/* Queued in the socket, not acknowledged by the peer. */
+	if (fnc->socket != -1 && !fnc->connecting &&
+	    ioctl(fnc->socket, SIOCOUTQ, &pending) == -1)
+		pending = -1;
+
+	/* Failing to connect leaves where the server was at as it was. */
+	if (fnc->socket != -1 && !fnc->connecting)
+		fnc->rib_version_resume = fnc->use_delta_resync &&
+						  fnc->synced && !pending
+					  ? fnc->rib_version_written
+					  : 0;
+
+	if (!fnc->use_delta_resync || !fnc->synced || pending ||
+	    fnc->obuf_head_left || unsent > STREAM_WRITEABLE(fnc->backlog)) {
+		fnc->synced = false;
+		fpm_backlog_drop(fnc);
+		return;
+	}
+
+	stream_write(fnc->backlog, stream_pnt(fnc->obuf), unsent);
+	fnc->backlog_valid = true;
+	atomic_store_explicit(&fnc->counters.backlog_bytes,
+			      STREAM_READABLE(fnc->backlog),
+			      memory_order_relaxed);
+}
+
+static void fpm_walks_cancel(struct fpm_nl_ctx *fnc)
 {
-	/* Cancel all zebra threads first. */
 	event_cancel_async(zrouter.master, &fnc->t_lspreset, NULL);
 	event_cancel_async(zrouter.master, &fnc->t_lspwalk, NULL);
 	event_cancel_async(zrouter.master, &fnc->t_nhgreset, NULL);
@@ -447,6 +634,23 @@ static void fpm_reconnect(struct fpm_nl_ctx *fnc)
 	event_cancel_async(zrouter.master, &fnc->t_ribwalk, NULL);
 	event_cancel_async(zrouter.master, &fnc->t_rmacreset, NULL);
 	event_cancel_async(zrouter.master, &fnc->t_rmacwalk, NULL);
+}
+
+/* Start the server over with everything, under a new epoch. */
+static void fpm_full_resync(struct fpm_nl_ctx *fnc)
+{
+	fpm_walks_cancel(fnc);
+	frr_with_mutex (&fnc->obuf_mutex) {
+		fnc->synced = false;
+		fnc->rib_version_resume = 0;
+	}
+	fpm_sync_start(fnc);
+}
+
+static void fpm_reconnect(struct fpm_nl_ctx *fnc)
+{
+	/* Cancel all zebra threads first. */
+	fpm_walks_cancel(fnc);
 
 	/*
 	 * Grab the lock to empty the streams (data plane might try to
@@ -454,6 +658,13 @@ static void fpm_reconnect(struct fpm_nl_ctx *fnc)
 	 */
 	frr_mutex_lock_autounlock(&fnc->obuf_mutex);
 
+	if (fnc->disabled) {
+		fnc->synced = false;
+		fnc->rib_version_resume = 0;
+		fpm_backlog_drop(fnc);
+	} else
+		fpm_backlog_keep(fnc);
+
 	/* Avoid calling close on `-1`. */
 	if (fnc->socket != -1) {
 		close(fnc->socket);
@@ -462,6 +673,7 @@ static void fpm_reconnect(struct fpm_nl_ctx *fnc)
 
 	stream_reset(fnc->ibuf);
 	stream_reset(fnc->obuf);
+	fnc->obuf_head_left = 0;
 	EVENT_OFF(fnc->t_read);
 	EVENT_OFF(fnc->t_write);
 
@@ -624,6 +836,21 @@ static void fpm_read(struct event *t)
 				 */
 			}
 			break;
+		case NLMSG_NOOP:
+			/*
+			 * The server tells the epoch it holds: unless that is
+			 * ours it missed more than the backlog had, replay.
+			 */
+			if (!fnc->use_delta_resync ||
+			    hdr->nlmsg_seq == fnc->epoch)
+				break;
+
+			if (IS_ZEBRA_DEBUG_FPM)
+				zlog_debug("%s: server has epoch %u, not %u",
+					   __func__, hdr->nlmsg_seq, fnc->epoch);
+
+			fpm_full_resync(fnc);
+			break;
 		default:
 			if (IS_ZEBRA_DEBUG_FPM)
 				zlog_debug(
@@ -636,6 +863,27 @@ static void fpm_read(struct event *t)
 	stream_reset(fnc->ibuf);
 }
 
+/*
+ * bytes of obuf were written out: follow the frame boundaries in them,
+ * so that a frame cut short by the connection going away is known of.
+ */
+static void fpm_obuf_consumed(struct fpm_nl_ctx *fnc, size_t bytes)
+{
+	const uint8_t *p = stream_pnt(fnc->obuf);
+	size_t step;
+
+	while (bytes) {
+		/* Frames are enqueued whole: their header is there. */
+		if (!fnc->obuf_head_left)
+			fnc->obuf_head_left = (p[2] << 8) | p[3];
+
+		step = MIN(bytes, fnc->obuf_head_left);
+		fnc->obuf_head_left -= step;
+		bytes -= step;
+		p += step;
+	}
+}
+
 static void fpm_write(struct event *t)
 {
 	struct fpm_nl_ctx *fnc = EVENT_ARG(t);
@@ -643,6 +891,8 @@ static void fpm_write(struct event *t)
 	ssize_t bwritten;
 	int rv, status;
 	size_t btotal;
+	struct timeval start;
+	int64_t usecs;
 
 	if (fnc->connecting == true) {
 		status = 0;
@@ -668,12 +918,7 @@ static void fpm_write(struct event *t)
 
 		fnc->connecting = false;
 
-		/*
-		 * Starting with LSPs walk all FPM objects, marking them
-		 * as unsent and then replaying them.
-		 */
-		event_add_timer(zrouter.master, fpm_lsp_reset, fnc, 0,
-				&fnc->t_lspreset);
+		fpm_sync_start(fnc);
 
 		/* Permit receiving messages now. */
 		event_add_read(fnc->fthread->master, fpm_read, fnc, fnc->socket,
@@ -685,6 +930,7 @@ static void fpm_write(struct event *t)
 	while (true) {
 		/* Stream is empty: reset pointers and return. */
 		if (STREAM_READABLE(fnc->obuf) == 0) {
+			fnc->rib_version_written = fnc->rib_version_queued;
 			stream_reset(fnc->obuf);
 			break;
 		}
@@ -692,7 +938,12 @@ static void fpm_write(struct event *t)
 		/* Try to write all at once. */
 		btotal = stream_get_endp(fnc->obuf) -
 			stream_get_getp(fnc->obuf);
+		monotime(&start);
 		bwritten = write(fnc->socket, stream_pnt(fnc->obuf), btotal);
+		usecs = monotime_since(&start, NULL);
+		atomic_fetch_add_explicit(&fnc->counters.write_usecs, usecs,
+					  memory_order_relaxed);
+		fpm_counter_peak(&fnc->counters.write_usecs_peak, usecs);
 		if (bwritten == 0) {
 			atomic_fetch_add_explicit(
 				&fnc->counters.connection_closes, 1,
@@ -728,6 +979,7 @@ static void fpm_write(struct event *t)
 		atomic_fetch_sub_explicit(&fnc->counters.obuf_bytes, bwritten,
 					  memory_order_relaxed);
 
+		fpm_obuf_consumed(fnc, (size_t)bwritten);
 		stream_forward_getp(fnc->obuf, (size_t)bwritten);
 	}
 
@@ -792,31 +1044,210 @@ static void fpm_connect(struct event *t)
 	event_add_write(fnc->fthread->master, fpm_write, fnc, sock,
 			&fnc->t_write);
 
+	/* If we are not connected, then delay the resync. */
+	if (!fnc->connecting)
+		fpm_sync_start(fnc);
+}
+
+/*
+ * Frame len bytes of netlink messages in buf into s.
+ *
+ * @return false when s has no room for them.
+ */
+static bool fpm_frame_put(struct stream *s, const uint8_t *buf, size_t len)
+{
+	/* We must know if someday a message goes beyond 65KiB. */
+	assert((len + FPM_HEADER_SIZE) <= UINT16_MAX);
+
+	if (STREAM_WRITEABLE(s) < (len + FPM_HEADER_SIZE))
+		return false;
+
+	/*
+	 * Fill in the FPM header information.
+	 *
+	 * See FPM_HEADER_SIZE definition for more information.
+	 */
+	stream_putc(s, 1);
+	stream_putc(s, 1);
+	stream_putw(s, len + FPM_HEADER_SIZE);
+
+	/* Write current data. */
+	stream_write(s, buf, len);
+
+	return true;
+}
+
+static void fpm_obuf_account(struct fpm_nl_ctx *fnc, size_t bytes)
+{
+	uint64_t obytes;
+
+	/* Account number of bytes waiting to be written. */
+	atomic_fetch_add_explicit(&fnc->counters.obuf_bytes, bytes,
+				  memory_order_relaxed);
+	obytes = atomic_load_explicit(&fnc->counters.obuf_bytes,
+				      memory_order_relaxed);
+	fpm_counter_peak(&fnc->counters.obuf_peak, obytes);
+
+	/* Tell the thread to start writing. */
+	event_add_write(fnc->fthread->master, fpm_write, fnc, fnc->socket,
+			&fnc->t_write);
+}
+
+/*
+ * Enqueue a frame of len bytes of netlink messages in the FPM output
+ * buffer, with obuf_mutex held.
+ *
+ * @return 0 on success or -1 on not enough space.
+ */
+static int fpm_obuf_put(struct fpm_nl_ctx *fnc, const uint8_t *buf,
+			size_t len)
+{
+	if (!fpm_frame_put(fnc->obuf, buf, len)) {
+		atomic_fetch_add_explicit(&fnc->counters.buffer_full, 1,
+					  memory_order_relaxed);
+
+		if (IS_ZEBRA_DEBUG_FPM)
+			zlog_debug(
+				"%s: buffer full: wants to write %zu but has %zu",
+				__func__, len + FPM_HEADER_SIZE,
+				STREAM_WRITEABLE(fnc->obuf));
+
+		return -1;
+	}
+
+	atomic_fetch_add_explicit(&fnc->counters.frames, 1,
+				  memory_order_relaxed);
+	fpm_obuf_account(fnc, len + FPM_HEADER_SIZE);
+
+	return 0;
+}
+
+/*
+ * Keep a frame for the server to get on reconnecting, with obuf_mutex
+ * held. Running out of room gives up on the delta resync.
+ */
+static void fpm_backlog_put(struct fpm_nl_ctx *fnc, const uint8_t *buf,
+			    size_t len)
+{
+	if (!fnc->backlog_valid)
+		return;
+
+	if (!fpm_frame_put(fnc->backlog, buf, len)) {
+		atomic_fetch_add_explicit(&fnc->counters.backlog_overflows, 1,
+					  memory_order_relaxed);
+
+		if (IS_ZEBRA_DEBUG_FPM)
+			zlog_debug("%s: backlog full, full resync needed",
+				   __func__);
+
+		fnc->synced = false;
+		fpm_backlog_drop(fnc);
+		return;
+	}
+
+	atomic_store_explicit(&fnc->counters.backlog_bytes,
+			      STREAM_READABLE(fnc->backlog),
+			      memory_order_relaxed);
+}
+
+/*
+ * Connected: start the server off. With delta resync it first gets the
+ * epoch (a NLMSG_NOOP carrying it as sequence number), then, if it had
+ * everything as of that epoch, the backlog of what changed since. Short
+ * of a backlog, the RIB walk sends only the routes changed since the
+ * version the server had them all at, if known. In every other case the
+ * epoch moves on and all objects are replayed.
+ */
+static void fpm_sync_start(struct fpm_nl_ctx *fnc)
+{
+	struct nlmsghdr hdr = {};
+	size_t delta_len = 0;
+	uint64_t since = 0;
+	bool delta;
+
+	frr_with_mutex (&fnc->obuf_mutex) {
+		delta = fnc->use_delta_resync && fnc->synced &&
+			fnc->backlog_valid;
+		if (delta)
+			delta_len = STREAM_READABLE(fnc->backlog);
+		if (delta && STREAM_WRITEABLE(fnc->obuf) <
+				     delta_len + FPM_HEADER_SIZE + sizeof(hdr))
+			delta = false;
+
+		if (!delta) {
+			if (fnc->use_delta_resync)
+				since = fnc->rib_version_resume;
+			fnc->synced = false;
+			if (!since)
+				fnc->epoch++;
+		}
+		fnc->rib_version_resume = 0;
+		fnc->rib_since = since;
+
+		if (fnc->use_delta_resync) {
+			hdr.nlmsg_len = sizeof(hdr);
+			hdr.nlmsg_type = NLMSG_NOOP;
+			hdr.nlmsg_flags = NLM_F_REQUEST;
+			hdr.nlmsg_seq = fnc->epoch;
+			(void)fpm_obuf_put(fnc, (const uint8_t *)&hdr,
+					   sizeof(hdr));
+		}
+
+		if (delta) {
+			stream_write(fnc->obuf, STREAM_DATA(fnc->backlog),
+				     delta_len);
+			fpm_obuf_account(fnc, delta_len);
+		}
+
+		fpm_backlog_drop(fnc);
+	}
+
+	if (delta) {
+		atomic_fetch_add_explicit(&fnc->counters.delta_resyncs, 1,
+					  memory_order_relaxed);
+		if (IS_ZEBRA_DEBUG_FPM)
+			zlog_debug("%s: epoch %u: resuming with %zu bytes",
+				   __func__, fnc->epoch, delta_len);
+		return;
+	}
+
+	if (since) {
+		atomic_fetch_add_explicit(&fnc->counters.rib_delta_walks, 1,
+					  memory_order_relaxed);
+		if (IS_ZEBRA_DEBUG_FPM)
+			zlog_debug("%s: epoch %u: routes changed since %" PRIu64,
+				   __func__, fnc->epoch, since);
+	} else {
+		atomic_fetch_add_explicit(&fnc->counters.full_resyncs, 1,
+					  memory_order_relaxed);
+		if (IS_ZEBRA_DEBUG_FPM)
+			zlog_debug("%s: epoch %u: replaying everything",
+				   __func__, fnc->epoch);
+	}
+
 	/*
 	 * Starting with LSPs walk all FPM objects, marking them
 	 * as unsent and then replaying them.
-	 *
-	 * If we are not connected, then delay the objects reset/send.
 	 */
-	if (!fnc->connecting)
-		event_add_timer(zrouter.master, fpm_lsp_reset, fnc, 0,
-				&fnc->t_lspreset);
+	event_add_timer(zrouter.master, fpm_lsp_reset, fnc, 0,
+			&fnc->t_lspreset);
 }
 
 /**
- * Encode data plane operation context into netlink and enqueue it in the FPM
- * output buffer.
+ * Encode data plane operation context into netlink.
  *
  * @param fnc the netlink FPM context.
  * @param ctx the data plane operation context data.
- * @return 0 on success or -1 on not enough space.
+ * @param nl_buf the buffer to encode into.
+ * @param nl_buf_size its size, NL_PKT_BUF_SIZE at least.
+ * @return the length of the messages, 0 if there are none.
  */
-static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
+static size_t fpm_nl_msg_encode(struct fpm_nl_ctx *fnc,
+				struct zebra_dplane_ctx *ctx, uint8_t *nl_buf,
+				size_t nl_buf_size)
 {
-	uint8_t nl_buf[NL_PKT_BUF_SIZE];
 	size_t nl_buf_len;
 	ssize_t rv;
-	uint64_t obytes, obytes_peak;
 	enum dplane_op_e op = dplane_ctx_get_op(ctx);
 
 	/*
@@ -830,8 +1261,6 @@ static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
 
 	nl_buf_len = 0;
 
-	frr_mutex_lock_autounlock(&fnc->obuf_mutex);
-
 	/*
 	 * If route replace is enabled then directly encode the install which
 	 * is going to use `NLM_F_REPLACE` (instead of delete/add operations).
@@ -843,7 +1272,7 @@ static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
 	case DPLANE_OP_ROUTE_UPDATE:
 	case DPLANE_OP_ROUTE_DELETE:
 		rv = netlink_route_multipath_msg_encode(RTM_DELROUTE, ctx,
-							nl_buf, sizeof(nl_buf),
+							nl_buf, nl_buf_size,
 							true, fnc->use_nhg,
 							false);
 		if (rv <= 0) {
@@ -863,7 +1292,7 @@ static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
 	case DPLANE_OP_ROUTE_INSTALL:
 		rv = netlink_route_multipath_msg_encode(RTM_NEWROUTE, ctx,
 							&nl_buf[nl_buf_len],
-							sizeof(nl_buf) -
+							nl_buf_size -
 								nl_buf_len,
 							true, fnc->use_nhg,
 							fnc->use_route_replace);
@@ -879,7 +1308,7 @@ static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
 
 	case DPLANE_OP_MAC_INSTALL:
 	case DPLANE_OP_MAC_DELETE:
-		rv = netlink_macfdb_update_ctx(ctx, nl_buf, sizeof(nl_buf));
+		rv = netlink_macfdb_update_ctx(ctx, nl_buf, nl_buf_size);
 		if (rv <= 0) {
 			zlog_err("%s: netlink_macfdb_update_ctx failed",
 				 __func__);
@@ -891,7 +1320,7 @@ static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
 
 	case DPLANE_OP_NH_DELETE:
 		rv = netlink_nexthop_msg_encode(RTM_DELNEXTHOP, ctx, nl_buf,
-						sizeof(nl_buf), true);
+						nl_buf_size, true);
 		if (rv <= 0) {
 			zlog_err("%s: netlink_nexthop_msg_encode failed",
 				 __func__);
@@ -903,7 +1332,7 @@ static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
 	case DPLANE_OP_NH_INSTALL:
 	case DPLANE_OP_NH_UPDATE:
 		rv = netlink_nexthop_msg_encode(RTM_NEWNEXTHOP, ctx, nl_buf,
-						sizeof(nl_buf), true);
+						nl_buf_size, true);
 		if (rv <= 0) {
 			zlog_err("%s: netlink_nexthop_msg_encode failed",
 				 __func__);
@@ -916,7 +1345,7 @@ static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
 	case DPLANE_OP_LSP_INSTALL:
 	case DPLANE_OP_LSP_UPDATE:
 	case DPLANE_OP_LSP_DELETE:
-		rv = netlink_lsp_msg_encoder(ctx, nl_buf, sizeof(nl_buf));
+		rv = netlink_lsp_msg_encoder(ctx, nl_buf, nl_buf_size);
 		if (rv <= 0) {
 			zlog_err("%s: netlink_lsp_msg_encoder failed",
 				 __func__);
@@ -975,56 +1404,51 @@ static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
 
 	}
 
-	/* Skip empty enqueues. */
-	if (nl_buf_len == 0)
-		return 0;
+	return nl_buf_len;
+}
 
-	/* We must know if someday a message goes beyond 65KiB. */
-	assert((nl_buf_len + FPM_HEADER_SIZE) <= UINT16_MAX);
+/* fpm_nl_msg_encode(), timed. */
+static size_t fpm_nl_encode(struct fpm_nl_ctx *fnc,
+			    struct zebra_dplane_ctx *ctx, uint8_t *nl_buf,
+			    size_t nl_buf_size)
+{
+	struct timeval start;
+	int64_t usecs;
+	size_t len;
 
-	/* Check if we have enough buffer space. */
-	if (STREAM_WRITEABLE(fnc->obuf) < (nl_buf_len + FPM_HEADER_SIZE)) {
-		atomic_fetch_add_explicit(&fnc->counters.buffer_full, 1,
-					  memory_order_relaxed);
+	monotime(&start);
+	len = fpm_nl_msg_encode(fnc, ctx, nl_buf, nl_buf_size);
+	usecs = monotime_since(&start, NULL);
 
-		if (IS_ZEBRA_DEBUG_FPM)
-			zlog_debug(
-				"%s: buffer full: wants to write %zu but has %zu",
-				__func__, nl_buf_len + FPM_HEADER_SIZE,
-				STREAM_WRITEABLE(fnc->obuf));
+	atomic_fetch_add_explicit(&fnc->counters.encode_usecs, usecs,
+				  memory_order_relaxed);
+	fpm_counter_peak(&fnc->counters.encode_usecs_peak, usecs);
 
-		return -1;
-	}
+	return len;
+}
 
-	/*
-	 * Fill in the FPM header information.
-	 *
-	 * See FPM_HEADER_SIZE definition for more information.
-	 */
-	stream_putc(fnc->obuf, 1);
-	stream_putc(fnc->obuf, 1);
-	stream_putw(fnc->obuf, nl_buf_len + FPM_HEADER_SIZE);
+/**
+ * Encode data plane operation context into netlink and enqueue it in the FPM
+ * output buffer.
+ *
+ * @param fnc the netlink FPM context.
+ * @param ctx the data plane operation context data.
+ * @return 0 on success or -1 on not enough space.
+ */
+static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
+{
+	uint8_t nl_buf[NL_PKT_BUF_SIZE];
+	size_t nl_buf_len;
 
-	/* Write current data. */
-	stream_write(fnc->obuf, nl_buf, (size_t)nl_buf_len);
+	nl_buf_len = fpm_nl_encode(fnc, ctx, nl_buf, sizeof(nl_buf));
 
-	/* Account number of bytes waiting to be written. */
-	atomic_fetch_add_explicit(&fnc->counters.obuf_bytes,
-				  nl_buf_len + FPM_HEADER_SIZE,
-				  memory_order_relaxed);
-	obytes = atomic_load_explicit(&fnc->counters.obuf_bytes,
-				      memory_order_relaxed);
-	obytes_peak = atomic_load_explicit(&fnc->counters.obuf_peak,
-					   memory_order_relaxed);
-	if (obytes_peak < obytes)
-		atomic_store_explicit(&fnc->counters.obuf_peak, obytes,
-				      memory_order_relaxed);
+	/* Skip empty enqueues. */
+	if (nl_buf_len == 0)
+		return 0;
 
-	/* Tell the thread to start writing. */
-	event_add_write(fnc->fthread->master, fpm_write, fnc, fnc->socket,
-			&fnc->t_write);
+	frr_mutex_lock_autounlock(&fnc->obuf_mutex);
 
-	return 0;
+	return fpm_obuf_put(fnc, nl_buf, nl_buf_len);
 }
 
 /*
@@ -1200,6 +1624,73 @@ static void fpm_rib_send(struct event *t)
 			&fnc->t_rmacreset);
 }
 
+/*
+ * Changed RIB routes walk, in place of fpm_rib_send() when the server
+ * only missed some.
+ */
+struct fpm_rib_changed_arg {
+	struct zebra_dplane_ctx *ctx;
+	struct fpm_nl_ctx *fnc;
+	bool complete;
+};
+
+static bool fpm_rib_send_changed_cb(rib_dest_t *dest, void *arg)
+{
+	struct fpm_rib_changed_arg *fra = arg;
+
+	dplane_ctx_reset(fra->ctx);
+	if (dest->selected_fib)
+		dplane_ctx_route_init(fra->ctx, DPLANE_OP_ROUTE_INSTALL,
+				      dest->rnode, dest->selected_fib);
+	else
+		dplane_ctx_route_init_removal(fra->ctx, dest->rnode);
+
+	if (fpm_nl_enqueue(fra->fnc, fra->ctx) == -1) {
+		fra->complete = false;
+		return false;
+	}
+
+	fra->fnc->rib_since = dest->version;
+	return true;
+}
+
+static void fpm_rib_send_changed(struct event *t)
+{
+	struct fpm_nl_ctx *fnc = EVENT_ARG(t);
+	struct fpm_rib_changed_arg fra = {
+		.fnc = fnc,
+		.complete = true,
+	};
+	bool known;
+
+	/* Allocate temporary context for all transactions. */
+	fra.ctx = dplane_ctx_alloc();
+	known = rib_walk_changed_since(fnc->rib_since, fpm_rib_send_changed_cb,
+				       &fra);
+	dplane_ctx_fini(&fra.ctx);
+
+	/* Changes that old are forgotten: everything goes again. */
+	if (!known) {
+		event_add_event(fnc->fthread->master, fpm_process_event, fnc,
+				FNE_INTERNAL_RESYNC, NULL);
+		return;
+	}
+
+	if (!fra.complete) {
+		event_add_timer(zrouter.master, fpm_rib_send_changed, fnc, 1,
+				&fnc->t_ribwalk);
+		return;
+	}
+
+	/* All changed RIB routes sent! */
+	fnc->rib_since = 0;
+	WALK_FINISH(fnc, FNE_RIB_FINISHED);
+
+	/* Schedule next event: RMAC reset. */
+	event_add_event(zrouter.master, fpm_rmac_reset, fnc, 0,
+			&fnc->t_rmacreset);
+}
+
 /*
  * The next three functions will handle RMAC enqueue.
  */
@@ -1320,6 +1811,13 @@ static void fpm_rib_reset(struct event *t)
 	struct route_table *rt;
 	rib_tables_iter_t rt_iter;
 
+	/* The server only missed some, see fpm_sync_start(). */
+	if (fnc->rib_since) {
+		event_add_event(zrouter.master, fpm_rib_send_changed, fnc, 0,
+				&fnc->t_ribwalk);
+		return;
+	}
+
 	rt_iter.state = RIB_TABLES_ITER_S_INIT;
 	while ((rt = rib_tables_iter_next(&rt_iter))) {
 		for (rn = route_top(rt); rn; rn = srcdest_route_next(rn)) {
@@ -1364,16 +1862,63 @@ static void fpm_rmac_reset(struct event *t)
 			&fnc->t_rmacwalk);
 }
 
+/*
+ * Enqueue the frame of messages batched so far: in the output buffer when
+ * connected, in the backlog otherwise.
+ */
+static void fpm_batch_flush(struct fpm_nl_ctx *fnc, bool connected,
+			    const uint8_t *batch, size_t *batch_len,
+			    uint64_t rib_version)
+{
+	if (*batch_len == 0)
+		return;
+
+	frr_with_mutex (&fnc->obuf_mutex) {
+		if (connected)
+			(void)fpm_obuf_put(fnc, batch, *batch_len);
+		else
+			fpm_backlog_put(fnc, batch, *batch_len);
+
+		if (fnc->rib_version_queued < rib_version)
+			fnc->rib_version_queued = rib_version;
+	}
+
+	*batch_len = 0;
+}
+
+/* The RIB version of a route change, as they come in order; 0 otherwise */
+static uint64_t fpm_ctx_rib_version(const struct zebra_dplane_ctx *ctx)
+{
+	enum dplane_op_e op = dplane_ctx_get_op(ctx);
+
+	if (op != DPLANE_OP_ROUTE_INSTALL && op != DPLANE_OP_ROUTE_UPDATE &&
+	    op != DPLANE_OP_ROUTE_DELETE)
+		return 0;
+
+	return dplane_ctx_get_rib_version(ctx);
+}
+
 static void fpm_process_queue(struct event *t)
 {
 	struct fpm_nl_ctx *fnc = EVENT_ARG(t);
 	struct zebra_dplane_ctx *ctx;
+	/* Only used from the FPM thread. */
+	static uint8_t batch[FPM_BATCH_SIZE];
+	uint8_t nl_buf[NL_PKT_BUF_SIZE];
+	size_t batch_len = 0, nl_buf_len;
+	uint64_t rib_version = 0;
+	bool connected = fnc->socket != -1 && fnc->connecting == false;
 	bool no_bufs = false;
 	uint64_t processed_contexts = 0;
 
 	while (true) {
-		/* No space available yet. */
-		if (STREAM_WRITEABLE(fnc->obuf) < NL_PKT_BUF_SIZE) {
+		/*
+		 * No space available yet: there must be room for the batch
+		 * and one more context.
+		 */
+		if (connected &&
+		    STREAM_WRITEABLE(fnc->obuf) <
+			    batch_len + NL_PKT_BUF_SIZE + 2 * FPM_HEADER_SIZE) {
 			no_bufs = true;
 			break;
 		}
@@ -1386,13 +1931,34 @@ static void fpm_process_queue(struct event *t)
 			break;
 
 		/*
-		 * Intentionally ignoring the return value
-		 * as that we are ensuring that we can write to
-		 * the output data in the STREAM_WRITEABLE
-		 * check above, so we can ignore the return
+		 * Return values of the enqueues are intentionally ignored
+		 * as that we are ensuring that we can write to the output
+		 * data in the STREAM_WRITEABLE check above. Not connected,
+		 * the context goes to the backlog, or nowhere as we'll walk
+		 * the RIB anyway.
 		 */
-		if (fnc->socket != -1)
-			(void)fpm_nl_enqueue(fnc, ctx);
+		if (connected || fnc->backlog_valid) {
+			nl_buf_len = fpm_nl_encode(fnc, ctx, nl_buf,
+						   sizeof(nl_buf));
+			if (batch_len + nl_buf_len > sizeof(batch))
+				fpm_batch_flush(fnc, connected, batch,
+						&batch_len, rib_version);
+
+			if (fpm_ctx_rib_version(ctx))
+				rib_version = fpm_ctx_rib_version(ctx);
+
+			if (nl_buf_len > sizeof(batch)) {
+				fpm_batch_flush(fnc, connected, nl_buf,
+						&nl_buf_len, rib_version);
+			} else if (nl_buf_len) {
+				memcpy(&batch[batch_len], nl_buf, nl_buf_len);
+				batch_len += nl_buf_len;
+				if (!fnc->use_batching)
+					fpm_batch_flush(fnc, connected, batch,
+							&batch_len,
+							rib_version);
+			}
+		}
 
 		/* Account the processed entries. */
 		processed_contexts++;
@@ -1403,6 +1969,8 @@ static void fpm_process_queue(struct event *t)
 		dplane_provider_enqueue_out_ctx(fnc->prov, ctx);
 	}
 
+	fpm_batch_flush(fnc, connected, batch, &batch_len, rib_version);
+
 	/* Update count of processed contexts */
 	atomic_fetch_add_explicit(&fnc->counters.dplane_contexts,
 				  processed_contexts, memory_order_relaxed);
@@ -1444,6 +2012,11 @@ static void fpm_process_event(struct event *t)
 	case FNE_RECONNECT:
 		zlog_info("%s: manual FPM reconnect event", __func__);
 		fnc->disabled = false;
+		/* Maybe another server: it gets everything. */
+		frr_with_mutex (&fnc->obuf_mutex) {
+			fnc->synced = false;
+			fnc->rib_version_resume = 0;
+		}
 		atomic_fetch_add_explicit(&fnc->counters.user_configures, 1,
 					  memory_order_relaxed);
 		fpm_reconnect(fnc);
@@ -1457,6 +2030,10 @@ static void fpm_process_event(struct event *t)
 	case FNE_TOGGLE_NHG:
 		zlog_info("%s: toggle next hop groups support", __func__);
 		fnc->use_nhg = !fnc->use_nhg;
+		frr_with_mutex (&fnc->obuf_mutex) {
+			fnc->synced = false;
+			fnc->rib_version_resume = 0;
+		}
 		fpm_reconnect(fnc);
 		break;
 
@@ -1464,6 +2041,11 @@ static void fpm_process_event(struct event *t)
 		fpm_reconnect(fnc);
 		break;
 
+	case FNE_INTERNAL_RESYNC:
+		if (fnc->socket != -1 && !fnc->connecting)
+			fpm_full_resync(fnc);
+		break;
+
 	case FNE_NHG_FINISHED:
 		if (IS_ZEBRA_DEBUG_FPM)
 			zlog_debug("%s: next hop groups walk finished",
@@ -1476,6 +2058,11 @@ static void fpm_process_event(struct event *t)
 	case FNE_RMAC_FINISHED:
 		if (IS_ZEBRA_DEBUG_FPM)
 			zlog_debug("%s: RMAC walk finished", __func__);
+
+		/* Last of the walks: the server has everything. */
+		frr_with_mutex (&fnc->obuf_mutex) {
+			fnc->synced = true;
+		}
 		break;
 	case FNE_LSP_FINISHED:
 		if (IS_ZEBRA_DEBUG_FPM)
@@ -1497,6 +2084,8 @@ static int fpm_nl_start(struct zebra_dplane_provider *prov)
 	fnc->ibuf = stream_new(NL_PKT_BUF_SIZE);
 	fnc->obuf = stream_new(NL_PKT_BUF_SIZE * 128);
 	pthread_mutex_init(&fnc->obuf_mutex, NULL);
+	fnc->backlog = stream_new(NL_PKT_BUF_SIZE * 128);
+	fnc->epoch = time(NULL);
 	fnc->socket = -1;
 	fnc->disabled = true;
 	fnc->prov = prov;
@@ -1506,6 +2095,7 @@ static int fpm_nl_start(struct zebra_dplane_provider *prov)
 	/* Set default values. */
 	fnc->use_nhg = true;
 	fnc->use_route_replace = true;
+	fnc->use_batching = true;
 
 	return 0;
 }
@@ -1545,6 +2135,7 @@ static int fpm_nl_finish_late(struct fpm_nl_ctx *fnc)
 	pthread_mutex_destroy(&fnc->ctxqueue_mutex);
 	stream_free(fnc->ibuf);
 	stream_free(fnc->obuf);
+	stream_free(fnc->backlog);
 	free(gfnc);
 	gfnc = NULL;
 
@@ -1578,9 +2169,10 @@ static int fpm_nl_process(struct zebra_dplane_provider *prov)
 
 		/*
 		 * Skip all notifications if not connected, we'll walk the RIB
-		 * anyway.
+		 * anyway; unless they are kept for a delta resync.
 		 */
-		if (fnc->socket != -1 && fnc->connecting == false) {
+		if ((fnc->socket != -1 && fnc->connecting == false) ||
+		    fnc->backlog_valid) {
 			/*
 			 * Update the number of queued contexts *before*
 			 * enqueueing, to ensure counter consistency.
@@ -1648,6 +2240,10 @@ static int fpm_nl_new(struct event_loop *tm)
 	install_element(CONFIG_NODE, &no_fpm_use_nhg_cmd);
 	install_element(CONFIG_NODE, &fpm_use_route_replace_cmd);
 	install_element(CONFIG_NODE, &no_fpm_use_route_replace_cmd);
+	install_element(CONFIG_NODE, &fpm_use_batching_cmd);
+	install_element(CONFIG_NODE, &no_fpm_use_batching_cmd);
+	install_element(CONFIG_NODE, &fpm_use_delta_resync_cmd);
+	install_element(CONFIG_NODE, &no_fpm_use_delta_resync_cmd);
 
 	return 0;
 }
@@ -37,6 +37,7 @@
 #include "zebra/zebra_vxlan.h"
 #include "zebra/zebra_errors.h"
 #include "zebra/zebra_evpn_mh.h"
+#include "zebra/zebra_link_delay.h"
 
 DEFINE_MTYPE_STATIC(ZEBRA, ZINFO, "Zebra Interface Information");
 
@@ -230,6 +231,7 @@ static int if_zebra_delete_hook(struct interface *ifp)
 		zebra_if_nhg_dependents_free(zebra_if);
 
 		XFREE(MTYPE_ZIF_DESC, zebra_if->desc);
+		zebra_link_delay_if_fini(zebra_if);
 
 		EVENT_OFF(zebra_if->speed_update);
 
@@ -4485,9 +4487,13 @@ DEFUN (link_params_delay,
 	}
 
 	VTY_DECLVAR_CONTEXT(interface, ifp);
-	struct if_link_params *iflp = if_link_params_get(ifp);
+	struct if_link_params *iflp;
 	uint8_t update = 0;
 
+	/* Static delays replace measured ones */
+	zebra_link_delay_disable(ifp);
+	iflp = if_link_params_get(ifp);
+
 	if (argc == 2) {
 		/*
 		 * Check new delay value against old Min and Max delays if set
@@ -4571,6 +4577,8 @@ DEFUN (no_link_params_delay,
 	if (!iflp)
 		return CMD_SUCCESS;
 
+	zebra_link_delay_disable(ifp);
+
 	/* Unset Delays */
 	iflp->av_delay = 0;
 	UNSET_PARAM(iflp, LP_DELAY);
@@ -4598,6 +4606,12 @@ DEFUN (link_params_delay_var,
 
 	value = strtoul(argv[idx_number]->arg, NULL, 10);
 
+	if (iflp && IS_PARAM_SET(iflp, LP_DELAY_MEASURED)) {
+		vty_out(vty,
+			"Delay variation is measured on this link, configure a static delay first\n");
+		return CMD_WARNING_CONFIG_FAILED;
+	}
+
 	if (!iflp)
 		iflp = if_link_params_enable(ifp);
 
@@ -5552,7 +5566,8 @@ static int link_params_config_write(struct vty *vty, struct interface *ifp)
 	if (dnode)
 		nb_cli_show_dnode_cmds(vty, dnode, false);
 
-	if (IS_PARAM_SET(iflp, LP_DELAY)) {
+	if (!zebra_link_delay_config_write(vty, ifp) &&
+	    IS_PARAM_SET(iflp, LP_DELAY)) {
 		vty_out(vty, "  delay %u", iflp->av_delay);
 		if (IS_PARAM_SET(iflp, LP_MM_DELAY)) {
 			vty_out(vty, " min %u", iflp->min_delay);
@@ -5560,7 +5575,8 @@ static int link_params_config_write(struct vty *vty, struct interface *ifp)
 		}
 		vty_out(vty, "\n");
 	}
-	if (IS_PARAM_SET(iflp, LP_DELAY_VAR))
+	if (IS_PARAM_SET(iflp, LP_DELAY_VAR) &&
+	    !IS_PARAM_SET(iflp, LP_DELAY_MEASURED))
 		vty_out(vty, "  delay-variation %u\n", iflp->delay_var);
 	if (IS_PARAM_SET(iflp, LP_PKT_LOSS))
 		vty_out(vty, "  packet-loss %g\n", iflp->pkt_loss);
@@ -5727,6 +5743,7 @@ void zebra_if_init(void)
 	install_element(LINK_PARAMS_NODE, &no_link_params_inter_as_cmd);
 	install_element(LINK_PARAMS_NODE, &link_params_delay_cmd);
 	install_element(LINK_PARAMS_NODE, &no_link_params_delay_cmd);
+	zebra_link_delay_init();
 	install_element(LINK_PARAMS_NODE, &link_params_delay_var_cmd);
 	install_element(LINK_PARAMS_NODE, &no_link_params_delay_var_cmd);
 	install_element(LINK_PARAMS_NODE, &link_params_pkt_loss_cmd);
@@ -214,6 +214,9 @@ struct zebra_if {
 
 	/* The description of the interface */
 	char *desc;
+
+	/* link-params delays from TWAMP measurements, if configured */
+	struct zebra_link_delay *link_delay;
 };
 
 DECLARE_HOOK(zebra_if_extra_info, (struct vty * vty, struct interface *ifp),
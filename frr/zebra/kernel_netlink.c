@@ -66,6 +66,25 @@
 
 #define NL_DEFAULT_BATCH_BUFSIZE (16 * NL_PKT_BUF_SIZE)
 
+/*
+ * Datagrams a listener takes per recvmmsg(), each into a buffer of the
+ * size a single receive starts out with.
+ */
+#define NL_RCV_MMSG_COUNT 16
+
+/*
+ * A listener still behind after a read doubles its receive buffer, up
+ * to this, rather than overrun it.
+ */
+#define NL_RCVBUF_GROW_MAX (128 * 1024 * 1024)
+
+struct nl_mmsg {
+	struct mmsghdr hdrs[NL_RCV_MMSG_COUNT];
+	struct iovec iovs[NL_RCV_MMSG_COUNT];
+	struct sockaddr_nl snls[NL_RCV_MMSG_COUNT];
+	uint8_t bufs[NL_RCV_MMSG_COUNT][NL_RCV_PKT_BUF_SIZE];
+};
+
 /*
  * We limit the batch's size to a number smaller than the length of the
  * underlying buffer since the last message that wouldn't fit the batch would go
@@ -76,6 +95,20 @@
  */
 #define NL_DEFAULT_BATCH_SEND_THRESHOLD (15 * NL_PKT_BUF_SIZE)
 
+/*
+ * What an ack takes of the receive buffer, sk_buff included; a batch is
+ * kept to as many messages as the buffer holds acks for, as the kernel
+ * drops what does not fit.
+ */
+#define NL_ACK_TRUESIZE 1024
+
+/* Acks read per recvmmsg(), and room for each */
+#define NL_ACK_BURST	64
+#define NL_ACK_SLOTSIZE 1024
+
+/* Our own sockets the inbound filters skip echoes from, at most */
+#define NL_FILTER_PIDS_MAX (2 + ZEBRA_DPLANE_SHARDS_MAX)
+
 static const struct message nlmsg_str[] = {{RTM_NEWROUTE, "RTM_NEWROUTE"},
 					   {RTM_DELROUTE, "RTM_DELROUTE"},
 					   {RTM_GETROUTE, "RTM_GETROUTE"},
@@ -173,8 +206,13 @@ pthread_mutex_t nlsock_mutex;
 #define NLSOCK_LOCK() pthread_mutex_lock(&nlsock_mutex)
 #define NLSOCK_UNLOCK() pthread_mutex_unlock(&nlsock_mutex)
 
-size_t nl_batch_tx_bufsize;
-char *nl_batch_tx_buf;
+#ifndef thread_local
+#define thread_local __thread
+#endif
+
+/* Per pthread, for the kernel provider shards to batch side by side */
+static thread_local size_t nl_batch_tx_bufsize;
+static thread_local char *nl_batch_tx_buf;
 
 _Atomic uint32_t nl_batch_bufsize = NL_DEFAULT_BATCH_BUFSIZE;
 _Atomic uint32_t nl_batch_send_threshold = NL_DEFAULT_BATCH_SEND_THRESHOLD;
@@ -183,12 +221,16 @@ struct nl_batch {
 	void *buf;
 	size_t bufsiz;
 	size_t limit;
+	/* Messages to send at most, for the acks to fit the socket */
+	size_t msglimit;
 
 	void *buf_head;
 	size_t curlen;
 	size_t msgcnt;
 
 	const struct zebra_dplane_info *zns;
+	/* Kernel provider shard batching, 0 for the dplane pthread itself */
+	unsigned int shard;
 
 	struct dplane_ctx_list_head ctx_list;
 
@@ -266,11 +308,11 @@ static int netlink_recvbuf(struct nlsock *nl, uint32_t newsize)
 	/* Try force option (linux >= 2.6.14) and fall back to normal set */
 	frr_with_privs(&zserv_privs) {
 		ret = setsockopt(nl->sock, SOL_SOCKET, SO_RCVBUFFORCE,
-				 &rcvbufsize, sizeof(rcvbufsize));
+				 &newsize, sizeof(newsize));
 	}
 	if (ret < 0)
-		ret = setsockopt(nl->sock, SOL_SOCKET, SO_RCVBUF, &rcvbufsize,
-				 sizeof(rcvbufsize));
+		ret = setsockopt(nl->sock, SOL_SOCKET, SO_RCVBUF, &newsize,
+				 sizeof(newsize));
 	if (ret < 0) {
 		flog_err_sys(EC_LIB_SOCKET,
 			     "Can't set %s receive buffer size: %s", nl->name,
@@ -288,6 +330,48 @@ static int netlink_recvbuf(struct nlsock *nl, uint32_t newsize)
 	return 0;
 }
 
+static void netlink_sockbuf_sizes(struct nlsock *nl)
+{
+	int size;
+	socklen_t len = sizeof(size);
+
+	nl->sndbuf = 0;
+	if (getsockopt(nl->sock, SOL_SOCKET, SO_SNDBUF, &size, &len) == 0 &&
+	    size > 0)
+		nl->sndbuf = size;
+
+	len = sizeof(size);
+	nl->rcvbuf = 0;
+	if (getsockopt(nl->sock, SOL_SOCKET, SO_RCVBUF, &size, &len) == 0 &&
+	    size > 0)
+		nl->rcvbuf = size;
+}
+
+/*
+ * A listener that read as much as it may at once and still had more
+ * waiting: double its receive buffer, so the next burst fits rather than
+ * overrunning it.
+ */
+static void netlink_recvbuf_grow(struct nlsock *nl)
+{
+	uint32_t oldsize = nl->rcvbuf;
+
+	if (!oldsize || oldsize >= NL_RCVBUF_GROW_MAX)
+		return;
+
+	/* The kernel reports twice what is set, so this doubles it */
+	if (netlink_recvbuf(nl, MIN(oldsize, NL_RCVBUF_GROW_MAX / 2)) < 0)
+		return;
+	netlink_sockbuf_sizes(nl);
+
+	if (nl->rcvbuf > oldsize)
+		zlog_info("%s falling behind, receive buffer grown from %u to %u",
+			  nl->name, oldsize, nl->rcvbuf);
+	else
+		/* Capped by the kernel; no point in trying again */
+		nl->rcvbuf = NL_RCVBUF_GROW_MAX;
+}
+
 static const char *group2str(uint32_t group)
 {
 	switch (group) {
@@ -504,6 +588,24 @@ static void kernel_read(struct event *thread)
 		       &zns->t_netlink);
 }
 
+/*
+ * Neighbor events have a listener of their own, so that a storm of them
+ * does not overrun the buffer that route events come in through.
+ */
+static void kernel_read_neigh(struct event *thread)
+{
+	struct zebra_ns *zns = (struct zebra_ns *)EVENT_ARG(thread);
+	struct zebra_dplane_info dp_info;
+
+	zebra_dplane_info_from_zns(&dp_info, zns, false);
+
+	netlink_parse_info(netlink_information_fetch, &zns->netlink_neigh,
+			   &dp_info, 5, false);
+
+	event_add_read(zrouter.master, kernel_read_neigh, zns,
+		       zns->netlink_neigh.sock, &zns->t_netlink_neigh);
+}
+
 /*
  * Called by the dplane pthread to read incoming OS messages and dispatch them.
  */
@@ -530,7 +632,8 @@ int kernel_dplane_read(struct zebra_dplane_info *info)
  * so that we only have to write one way to handle incoming
  * address add/delete and xxxNETCONF changes.
  */
-static void netlink_install_filter(int sock, uint32_t pid, uint32_t dplane_pid)
+static void netlink_install_filter(int sock, const uint32_t *pids,
+				   unsigned int count)
 {
 	/*
 	 * BPF_JUMP instructions and where you jump to are based upon
@@ -538,69 +641,66 @@ static void netlink_install_filter(int sock, uint32_t pid, uint32_t dplane_pid)
 	 * this down because every time I look at this I have to
 	 * re-remember it.
 	 */
-	struct sock_filter filter[] = {
-		/*
-		 * Logic:
-		 *   if (nlmsg_pid == pid ||
-		 *       nlmsg_pid == dplane_pid) {
-		 *       if (the incoming nlmsg_type ==
-		 *           RTM_NEWADDR || RTM_DELADDR || RTM_NEWNETCONF ||
-		 *           RTM_DELNETCONF)
-		 *           keep this message
-		 *       else
-		 *           skip this message
-		 *   } else
-		 *       keep this netlink message
-		 */
-		/*
-		 * 0: Load the nlmsg_pid into the BPF register
-		 */
-		BPF_STMT(BPF_LD | BPF_ABS | BPF_W,
-			 offsetof(struct nlmsghdr, nlmsg_pid)),
-		/*
-		 * 1: Compare to pid
-		 */
-		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(pid), 1, 0),
-		/*
-		 * 2: Compare to dplane pid
-		 */
-		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(dplane_pid), 0, 6),
-		/*
-		 * 3: Load the nlmsg_type into BPF register
-		 */
-		BPF_STMT(BPF_LD | BPF_ABS | BPF_H,
-			 offsetof(struct nlmsghdr, nlmsg_type)),
-		/*
-		 * 4: Compare to RTM_NEWADDR
-		 */
-		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_NEWADDR), 4, 0),
-		/*
-		 * 5: Compare to RTM_DELADDR
-		 */
-		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_DELADDR), 3, 0),
-		/*
-		 * 6: Compare to RTM_NEWNETCONF
-		 */
-		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_NEWNETCONF), 2,
-			 0),
-		/*
-		 * 7: Compare to RTM_DELNETCONF
-		 */
-		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_DELNETCONF), 1,
-			 0),
-		/*
-		 * 8: This is the end state of we want to skip the
-		 *    message
-		 */
-		BPF_STMT(BPF_RET | BPF_K, 0),
-		/* 9: This is the end state of we want to keep
-		 *     the message
-		 */
-		BPF_STMT(BPF_RET | BPF_K, 0xffff),
-	};
+	struct sock_filter filter[1 + NL_FILTER_PIDS_MAX + 7];
+	unsigned int i, n = 0;
+
+	/*
+	 * Logic:
+	 *   if (nlmsg_pid == pids[0] || ... ||
+	 *       nlmsg_pid == pids[count - 1]) {
+	 *       if (the incoming nlmsg_type ==
+	 *           RTM_NEWADDR || RTM_DELADDR || RTM_NEWNETCONF ||
+	 *           RTM_DELNETCONF)
+	 *           keep this message
+	 *       else
+	 *           skip this message
+	 *   } else
+	 *       keep this netlink message
+	 */
+	assert(count >= 1 && count <= NL_FILTER_PIDS_MAX);
+
+	/*
+	 * 0: Load the nlmsg_pid into the BPF register
+	 */
+	filter[n++] = (struct sock_filter)BPF_STMT(
+		BPF_LD | BPF_ABS | BPF_W, offsetof(struct nlmsghdr, nlmsg_pid));
+	/*
+	 * 1 .. count: Compare to each pid, on to the type check at count + 1
+	 * on a match; the last one skips to keeping the message otherwise.
+	 */
+	for (i = 0; i < count; i++)
+		filter[n++] = (struct sock_filter)BPF_JUMP(
+			BPF_JMP | BPF_JEQ | BPF_K, htonl(pids[i]),
+			count - 1 - i, i == count - 1 ? 6 : 0);
+	/*
+	 * count + 1: Load the nlmsg_type into BPF register
+	 */
+	filter[n++] = (struct sock_filter)BPF_STMT(
+		BPF_LD | BPF_ABS | BPF_H, offsetof(struct nlmsghdr, nlmsg_type));
+	/*
+	 * count + 2 .. count + 5: Compare to RTM_NEWADDR, RTM_DELADDR,
+	 * RTM_NEWNETCONF and RTM_DELNETCONF
+	 */
+	filter[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+						   htons(RTM_NEWADDR), 4, 0);
+	filter[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+						   htons(RTM_DELADDR), 3, 0);
+	filter[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+						   htons(RTM_NEWNETCONF), 2, 0);
+	filter[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+						   htons(RTM_DELNETCONF), 1, 0);
+	/*
+	 * count + 6: This is the end state of we want to skip the
+	 *    message
+	 */
+	filter[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);
+	/* count + 7: This is the end state of we want to keep
+	 *     the message
+	 */
+	filter[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffff);
 
 	struct sock_fprog prog = {
-		.len = array_size(filter), .filter = filter,
+		.len = n, .filter = filter,
 	};
 
 	if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog))
@@ -956,6 +1056,73 @@ static int netlink_recv_msg(struct nlsock *nl, struct msghdr *msg)
 	return status;
 }
 
+/*
+ * netlink_recv_mmsg - receive a batch of netlink datagrams from a listener,
+ * into nl->mmsg.
+ *
+ * Returns -1 on error, 0 if read would block or the number of datagrams
+ * received.
+ */
+static int netlink_recv_mmsg(struct nlsock *nl)
+{
+	struct nl_mmsg *m = nl->mmsg;
+	int status, i;
+
+	for (i = 0; i < NL_RCV_MMSG_COUNT; i++) {
+		m->iovs[i].iov_base = m->bufs[i];
+		m->iovs[i].iov_len = sizeof(m->bufs[i]);
+		memset(&m->hdrs[i], 0, sizeof(m->hdrs[i]));
+		m->hdrs[i].msg_hdr.msg_name = &m->snls[i];
+		m->hdrs[i].msg_hdr.msg_namelen = sizeof(m->snls[i]);
+		m->hdrs[i].msg_hdr.msg_iov = &m->iovs[i];
+		m->hdrs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	do {
+		status = recvmmsg(nl->sock, m->hdrs, NL_RCV_MMSG_COUNT, 0,
+				  NULL);
+	} while (status == -1 && errno == EINTR);
+
+	if (status == -1) {
+		if (errno == EWOULDBLOCK || errno == EAGAIN)
+			return 0;
+		flog_err(EC_ZEBRA_RECVMSG_OVERRUN, "%s recvmmsg overrun: %s",
+			 nl->name, safe_strerror(errno));
+		/*
+		 * In this case we are screwed. There is no good way to recover
+		 * zebra at this point.
+		 */
+		exit(-1);
+	}
+
+	for (i = 0; i < status; i++) {
+		if (m->hdrs[i].msg_len == 0) {
+			flog_err_sys(EC_LIB_SOCKET, "%s EOF", nl->name);
+			return -1;
+		}
+
+		if (m->hdrs[i].msg_hdr.msg_namelen !=
+		    sizeof(struct sockaddr_nl)) {
+			flog_err(EC_ZEBRA_NETLINK_LENGTH_ERROR,
+				 "%s sender address length error: length %d",
+				 nl->name, m->hdrs[i].msg_hdr.msg_namelen);
+			return -1;
+		}
+
+		if (IS_ZEBRA_DEBUG_KERNEL_MSGDUMP_RECV) {
+			zlog_debug("%s: << netlink message dump [recv]",
+				   __func__);
+#ifdef NETLINK_DEBUG
+			nl_dump(m->bufs[i], m->hdrs[i].msg_len);
+#else
+			zlog_hexdump(m->bufs[i], m->hdrs[i].msg_len);
+#endif /* NETLINK_DEBUG */
+		}
+	}
+
+	return status;
+}
+
 /*
  * netlink_parse_error - parse a netlink error message
  *
@@ -1045,6 +1212,98 @@ static int netlink_parse_error(const struct nlsock *nl, struct nlmsghdr *h,
 	return -1;
 }
 
+/*
+ * Hand the messages of one datagram received on nl to filter. Returns
+ * false if that ends the read, with what netlink_parse_info() is to
+ * return in *ret.
+ */
+static bool netlink_parse_datagram(int (*filter)(struct nlmsghdr *, ns_id_t,
+						 int),
+				   struct nlsock *nl,
+				   const struct zebra_dplane_info *zns,
+				   uint8_t *buf, int status, uint32_t nl_pid,
+				   int msg_flags, bool startup, int *ret)
+{
+	struct nlmsghdr *h;
+	int error;
+
+	for (h = (struct nlmsghdr *)buf;
+	     (status >= 0 && NLMSG_OK(h, (unsigned int)status));
+	     h = NLMSG_NEXT(h, status)) {
+		/* Finish of reading. */
+		if (h->nlmsg_type == NLMSG_DONE)
+			return false;
+
+		/* Error handling. */
+		if (h->nlmsg_type == NLMSG_ERROR) {
+			int err = netlink_parse_error(nl, h, zns->is_cmd,
+						      startup);
+
+			if (err == 1) {
+				if (!(h->nlmsg_flags & NLM_F_MULTI)) {
+					*ret = 0;
+					return false;
+				}
+				continue;
+			}
+
+			*ret = err;
+			return false;
+		}
+
+		/*
+		 * What is the right thing to do?  The kernel
+		 * is telling us that the dump request was interrupted
+		 * and we more than likely are out of luck and have
+		 * missed data from the kernel.  At this point in time
+		 * lets just note that this is happening.
+		 */
+		if (h->nlmsg_flags & NLM_F_DUMP_INTR)
+			flog_err(
+				EC_ZEBRA_NETLINK_BAD_SEQUENCE,
+				"netlink recvmsg: The Dump request was interrupted");
+
+		/* OK we got netlink message. */
+		if (IS_ZEBRA_DEBUG_KERNEL)
+			zlog_debug(
+				"%s: %s type %s(%u), len=%d, seq=%u, pid=%u",
+				__func__, nl->name,
+				nl_msg_type_to_str(h->nlmsg_type),
+				h->nlmsg_type, h->nlmsg_len, h->nlmsg_seq,
+				h->nlmsg_pid);
+
+		/*
+		 * Ignore messages that maybe sent from
+		 * other actors besides the kernel
+		 */
+		if (nl_pid != 0) {
+			zlog_debug("Ignoring message from pid %u", nl_pid);
+			continue;
+		}
+
+		error = (*filter)(h, zns->ns_id, startup);
+		if (error < 0) {
+			zlog_debug("%s filter function error", nl->name);
+			*ret = error;
+		}
+	}
+
+	/* After error care. */
+	if (msg_flags & MSG_TRUNC) {
+		flog_err(EC_ZEBRA_NETLINK_LENGTH_ERROR,
+			 "%s error: message truncated", nl->name);
+		return true;
+	}
+	if (status) {
+		flog_err(EC_ZEBRA_NETLINK_LENGTH_ERROR,
+			 "%s error: data remnant size %d", nl->name, status);
+		*ret = -1;
+		return false;
+	}
+
+	return true;
+}
+
 /*
  * netlink_parse_info
  *
@@ -1054,7 +1313,8 @@ static int netlink_parse_error(const struct nlsock *nl, struct nlmsghdr *h,
  * filter  -> Function to call to read the results
  * nl      -> netlink socket information
  * zns     -> The zebra namespace data
- * count   -> How many we should read in, 0 means as much as possible
+ * count   -> How many receives we should do, 0 means as much as possible;
+ *            a listener with nl->mmsg takes a batch of datagrams in each
  * startup -> Are we reading in under startup conditions? passed to
  *            the filter.
  */
@@ -1064,17 +1324,48 @@ int netlink_parse_info(int (*filter)(struct nlmsghdr *, ns_id_t, int),
 {
 	int status;
 	int ret = 0;
-	int error;
 	int read_in = 0;
+	bool full = true;
+	int i;
 
 	while (1) {
 		struct sockaddr_nl snl;
 		struct msghdr msg = {.msg_name = (void *)&snl,
 				     .msg_namelen = sizeof(snl)};
-		struct nlmsghdr *h;
 
-		if (count && read_in >= count)
+		if (count && read_in >= count) {
+			/* Still behind: make room for more next time */
+			if (!zns->is_cmd && full)
+				netlink_recvbuf_grow(nl);
 			return 0;
+		}
+
+		/*
+		 * Listeners get neither acks nor the end of a dump, so
+		 * nothing but an error stops a batch partway.
+		 */
+		if (nl->mmsg) {
+			status = netlink_recv_mmsg(nl);
+			if (status == -1)
+				return -1;
+			else if (status == 0)
+				break;
+
+			read_in++;
+			full = status == NL_RCV_MMSG_COUNT;
+			for (i = 0; i < status; i++) {
+				struct mmsghdr *hdr = &nl->mmsg->hdrs[i];
+
+				if (!netlink_parse_datagram(
+					    filter, nl, zns, nl->mmsg->bufs[i],
+					    hdr->msg_len,
+					    nl->mmsg->snls[i].nl_pid,
+					    hdr->msg_hdr.msg_flags, startup,
+					    &ret))
+					return ret;
+			}
+			continue;
+		}
 
 		status = netlink_recv_msg(nl, &msg);
 		if (status == -1)
@@ -1083,77 +1374,10 @@ int netlink_parse_info(int (*filter)(struct nlmsghdr *, ns_id_t, int),
 			break;
 
 		read_in++;
-		for (h = (struct nlmsghdr *)nl->buf;
-		     (status >= 0 && NLMSG_OK(h, (unsigned int)status));
-		     h = NLMSG_NEXT(h, status)) {
-			/* Finish of reading. */
-			if (h->nlmsg_type == NLMSG_DONE)
-				return ret;
-
-			/* Error handling. */
-			if (h->nlmsg_type == NLMSG_ERROR) {
-				int err = netlink_parse_error(
-					nl, h, zns->is_cmd, startup);
-
-				if (err == 1) {
-					if (!(h->nlmsg_flags & NLM_F_MULTI))
-						return 0;
-					continue;
-				} else
-					return err;
-			}
-
-			/*
-			 * What is the right thing to do?  The kernel
-			 * is telling us that the dump request was interrupted
-			 * and we more than likely are out of luck and have
-			 * missed data from the kernel.  At this point in time
-			 * lets just note that this is happening.
-			 */
-			if (h->nlmsg_flags & NLM_F_DUMP_INTR)
-				flog_err(
-					EC_ZEBRA_NETLINK_BAD_SEQUENCE,
-					"netlink recvmsg: The Dump request was interrupted");
-
-			/* OK we got netlink message. */
-			if (IS_ZEBRA_DEBUG_KERNEL)
-				zlog_debug(
-					"%s: %s type %s(%u), len=%d, seq=%u, pid=%u",
-					__func__, nl->name,
-					nl_msg_type_to_str(h->nlmsg_type),
-					h->nlmsg_type, h->nlmsg_len,
-					h->nlmsg_seq, h->nlmsg_pid);
-
-			/*
-			 * Ignore messages that maybe sent from
-			 * other actors besides the kernel
-			 */
-			if (snl.nl_pid != 0) {
-				zlog_debug("Ignoring message from pid %u",
-					   snl.nl_pid);
-				continue;
-			}
-
-			error = (*filter)(h, zns->ns_id, startup);
-			if (error < 0) {
-				zlog_debug("%s filter function error",
-					   nl->name);
-				ret = error;
-			}
-		}
-
-		/* After error care. */
-		if (msg.msg_flags & MSG_TRUNC) {
-			flog_err(EC_ZEBRA_NETLINK_LENGTH_ERROR,
-				 "%s error: message truncated", nl->name);
-			continue;
-		}
-		if (status) {
-			flog_err(EC_ZEBRA_NETLINK_LENGTH_ERROR,
-				 "%s error: data remnant size %d", nl->name,
-				 status);
-			return -1;
-		}
+		if (!netlink_parse_datagram(filter, nl, zns, nl->buf, status,
+					    snl.nl_pid, msg.msg_flags, startup,
+					    &ret))
+			return ret;
 	}
 	return ret;
 }
@@ -1243,24 +1467,102 @@ int netlink_request(struct nlsock *nl, void *req)
 	return 0;
 }
 
+/*
+ * Read up to NL_ACK_BURST acks in one go. Returns how many, 0 if there are
+ * none waiting and -1 on failure, as netlink_recv_msg() does.
+ */
+static int nl_batch_recv_acks(struct nlsock *nl, struct mmsghdr *mmsgs,
+			      struct sockaddr_nl *snls)
+{
+	static thread_local uint8_t slots[NL_ACK_BURST][NL_ACK_SLOTSIZE];
+	static thread_local struct iovec iovs[NL_ACK_BURST];
+	int i, count;
+
+	for (i = 0; i < NL_ACK_BURST; i++) {
+		iovs[i].iov_base = slots[i];
+		iovs[i].iov_len = sizeof(slots[i]);
+		memset(&mmsgs[i], 0, sizeof(mmsgs[i]));
+		mmsgs[i].msg_hdr.msg_name = &snls[i];
+		mmsgs[i].msg_hdr.msg_namelen = sizeof(snls[i]);
+		mmsgs[i].msg_hdr.msg_iov = &iovs[i];
+		mmsgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	do {
+		count = recvmmsg(nl->sock, mmsgs, NL_ACK_BURST, MSG_DONTWAIT,
+				 NULL);
+	} while (count == -1 && errno == EINTR);
+
+	if (count == -1) {
+		if (errno == EWOULDBLOCK || errno == EAGAIN)
+			return 0;
+		flog_err(EC_ZEBRA_RECVMSG_OVERRUN, "%s recvmmsg overrun: %s",
+			 nl->name, safe_strerror(errno));
+		/*
+		 * As in netlink_recv_msg(), there is no good way to recover
+		 * zebra at this point.
+		 */
+		exit(-1);
+	}
+
+	for (i = 0; i < count; i++) {
+		struct nlmsghdr *h = iovs[i].iov_base;
+
+		if (mmsgs[i].msg_hdr.msg_namelen != sizeof(struct sockaddr_nl)) {
+			flog_err(EC_ZEBRA_NETLINK_LENGTH_ERROR,
+				 "%s sender address length error: length %d",
+				 nl->name, mmsgs[i].msg_hdr.msg_namelen);
+			return -1;
+		}
+
+		/*
+		 * An error ack echoing a large request (without
+		 * NETLINK_CAP_ACK) comes in cut short; what is parsed is
+		 * what arrived.
+		 */
+		if (mmsgs[i].msg_len < sizeof(*h)) {
+			flog_err(EC_ZEBRA_NETLINK_LENGTH_ERROR,
+				 "%s short ack: length %u", nl->name,
+				 mmsgs[i].msg_len);
+			return -1;
+		}
+		if (h->nlmsg_len > mmsgs[i].msg_len)
+			h->nlmsg_len = mmsgs[i].msg_len;
+
+		if (IS_ZEBRA_DEBUG_KERNEL_MSGDUMP_RECV) {
+			zlog_debug("%s: << netlink message dump [recv]",
+				   __func__);
+#ifdef NETLINK_DEBUG
+			nl_dump(h, mmsgs[i].msg_len);
+#else
+			zlog_hexdump(h, mmsgs[i].msg_len);
+#endif /* NETLINK_DEBUG */
+		}
+	}
+
+	return count;
+}
+
 static int nl_batch_read_resp(struct nl_batch *bth, struct nlsock *nl)
 {
+	struct mmsghdr mmsgs[NL_ACK_BURST];
+	struct sockaddr_nl snls[NL_ACK_BURST];
 	struct nlmsghdr *h;
-	struct sockaddr_nl snl;
-	struct msghdr msg = {};
-	int status, seq;
+	int status, seq, i;
 	struct zebra_dplane_ctx *ctx;
 	bool ignore_msg;
 
-	msg.msg_name = (void *)&snl;
-	msg.msg_namelen = sizeof(snl);
-
 	/*
-	 * The responses are not batched, so we need to read and process one
-	 * message at a time.
+	 * Each message gets an ack of its own; they are taken a burst at a
+	 * time and matched up with the contexts one by one.
 	 */
+	i = 0;
+	status = 0;
 	while (true) {
-		status = netlink_recv_msg(nl, &msg);
+		if (i == status) {
+			status = nl_batch_recv_acks(nl, mmsgs, snls);
+			i = 0;
+		}
 		/*
 		 * status == -1 is a full on failure somewhere
 		 * since we don't know where the problem happened
@@ -1281,7 +1583,7 @@ static int nl_batch_read_resp(struct nl_batch *bth, struct nlsock *nl)
 			return status;
 		}
 
-		h = (struct nlmsghdr *)nl->buf;
+		h = mmsgs[i++].msg_hdr.msg_iov->iov_base;
 		ignore_msg = false;
 		seq = h->nlmsg_seq;
 		/*
@@ -1400,7 +1702,8 @@ static void nl_batch_reset(struct nl_batch *bth)
 }
 
 static void nl_batch_init(struct nl_batch *bth,
-			  struct dplane_ctx_list_head *ctx_out_q)
+			  struct dplane_ctx_list_head *ctx_out_q,
+			  unsigned int shard)
 {
 	/*
 	 * If the size of the buffer has changed, free and then allocate a new
@@ -1420,20 +1723,34 @@ static void nl_batch_init(struct nl_batch *bth,
 	bth->bufsiz = bufsize;
 	bth->limit = atomic_load_explicit(&nl_batch_send_threshold,
 					  memory_order_relaxed);
+	bth->msglimit = SIZE_MAX;
+	bth->shard = shard;
 
 	bth->ctx_out_q = ctx_out_q;
 
 	nl_batch_reset(bth);
 }
 
+/*
+ * The socket a batch goes out on: the context's dplane socket, or the
+ * shard's own socket of the same namespace.
+ */
+static struct nlsock *nl_batch_sock(const struct nl_batch *bth, int sock)
+{
+	struct nlsock *nl = kernel_netlink_nlsock_lookup(sock);
+
+	if (bth->shard && nl->shards)
+		nl = &nl->shards[bth->shard - 1];
+	return nl;
+}
+
 static void nl_batch_send(struct nl_batch *bth)
 {
 	struct zebra_dplane_ctx *ctx;
 	bool err = false;
 
 	if (bth->curlen != 0 && bth->zns != NULL) {
-		struct nlsock *nl =
-			kernel_netlink_nlsock_lookup(bth->zns->sock);
+		struct nlsock *nl = nl_batch_sock(bth, bth->zns->sock);
 
 		if (IS_ZEBRA_DEBUG_KERNEL)
 			zlog_debug("%s: %s, batch size=%zu, msg cnt=%zu",
@@ -1465,6 +1782,28 @@ static void nl_batch_send(struct nl_batch *bth)
 	nl_batch_reset(bth);
 }
 
+/*
+ * Keep a new batch to what the socket it goes out on takes in one send,
+ * and to as many messages as its receive buffer has room to ack.
+ */
+static void nl_batch_fit(struct nl_batch *bth, const struct nlsock *nl)
+{
+	size_t threshold = atomic_load_explicit(&nl_batch_send_threshold,
+						memory_order_relaxed);
+
+	bth->bufsiz = nl_batch_tx_bufsize;
+	/* netlink refuses a send within 32 bytes of the buffer size */
+	if (nl->sndbuf > 32 && nl->sndbuf - 32 < bth->bufsiz)
+		bth->bufsiz = nl->sndbuf - 32;
+	bth->limit = MIN(threshold, bth->bufsiz);
+	if (bth->bufsiz > NL_PKT_BUF_SIZE)
+		bth->limit = MIN(bth->limit, bth->bufsiz - NL_PKT_BUF_SIZE);
+
+	bth->msglimit = SIZE_MAX;
+	if (nl->rcvbuf)
+		bth->msglimit = MAX(nl->rcvbuf / NL_ACK_TRUESIZE, 1U);
+}
+
 enum netlink_msg_status netlink_batch_add_msg(
 	struct nl_batch *bth, struct zebra_dplane_ctx *ctx,
 	ssize_t (*msg_encoder)(struct zebra_dplane_ctx *, void *, size_t),
@@ -1475,6 +1814,10 @@ enum netlink_msg_status netlink_batch_add_msg(
 	struct nlmsghdr *msgh;
 	struct nlsock *nl;
 
+	nl = nl_batch_sock(bth, dplane_ctx_get_ns_sock(ctx));
+	if (!bth->zns)
+		nl_batch_fit(bth, nl);
+
 	size = (*msg_encoder)(ctx, bth->buf_head, bth->bufsiz - bth->curlen);
 
 	/*
@@ -1490,6 +1833,7 @@ enum netlink_msg_status netlink_batch_add_msg(
 	 */
 	if (size == 0) {
 		nl_batch_send(bth);
+		nl_batch_fit(bth, nl);
 		size = (*msg_encoder)(ctx, bth->buf_head,
 				      bth->bufsiz - bth->curlen);
 		/*
@@ -1501,7 +1845,6 @@ enum netlink_msg_status netlink_batch_add_msg(
 	}
 
 	seq = dplane_ctx_get_ns(ctx)->seq;
-	nl = kernel_netlink_nlsock_lookup(dplane_ctx_get_ns_sock(ctx));
 
 	if (ignore_res)
 		seq++;
@@ -1617,7 +1960,8 @@ static enum netlink_msg_status nl_put_msg(struct nl_batch *bth,
 	return FRR_NETLINK_ERROR;
 }
 
-void kernel_update_multi(struct dplane_ctx_list_head *ctx_list)
+void kernel_update_multi_shard(struct dplane_ctx_list_head *ctx_list,
+			       unsigned int shard)
 {
 	struct nl_batch batch;
 	struct zebra_dplane_ctx *ctx;
@@ -1625,7 +1969,7 @@ void kernel_update_multi(struct dplane_ctx_list_head *ctx_list)
 	enum netlink_msg_status res;
 
 	dplane_ctx_q_init(&handled_list);
-	nl_batch_init(&batch, &handled_list);
+	nl_batch_init(&batch, &handled_list, shard);
 
 	while (true) {
 		ctx = dplane_ctx_dequeue(ctx_list);
@@ -1649,7 +1993,8 @@ void kernel_update_multi(struct dplane_ctx_list_head *ctx_list)
 			dplane_ctx_set_status(ctx,
 					      ZEBRA_DPLANE_REQUEST_FAILURE);
 
-		if (batch.curlen > batch.limit)
+		if (batch.curlen > batch.limit ||
+		    batch.msgcnt >= batch.msglimit)
 			nl_batch_send(&batch);
 	}
 
@@ -1659,6 +2004,11 @@ void kernel_update_multi(struct dplane_ctx_list_head *ctx_list)
 	dplane_ctx_list_append(ctx_list, &handled_list);
 }
 
+void kernel_update_multi(struct dplane_ctx_list_head *ctx_list)
+{
+	kernel_update_multi_shard(ctx_list, 0);
+}
+
 struct nlsock *kernel_netlink_nlsock_lookup(int sock)
 {
 	struct nlsock lookup, *retval;
@@ -1708,9 +2058,66 @@ static bool kernel_netlink_nlsock_hash_equal(const void *arg1, const void *arg2)
 
 /* Exported interface function.  This function simply calls
    netlink_socket (). */
+/*
+ * The dplane_out sockets for kernel provider shards past the first, which
+ * batches on zns->netlink_dplane_out itself. They are set up like it, and
+ * hang off it for nl_batch_sock() to find.
+ */
+static void kernel_init_dplane_shards(struct zebra_ns *zns)
+{
+	struct nlsock *out = &zns->netlink_dplane_out;
+	struct nlsock *nl;
+	unsigned int i;
+#if defined SOL_NETLINK
+	int one;
+#endif
+
+	if (zrouter.dplane_shards <= 1)
+		return;
+
+	out->shards = XCALLOC(MTYPE_NL_BUF,
+			      (zrouter.dplane_shards - 1) * sizeof(*out->shards));
+
+	for (i = 0; i < zrouter.dplane_shards - 1; i++) {
+		nl = &out->shards[i];
+
+		snprintf(nl->name, sizeof(nl->name), "netlink-dp%u (NS %u)",
+			 i + 1, zns->ns_id);
+		nl->sock = -1;
+		if (netlink_socket(nl, 0, 0, 0, zns->ns_id) < 0) {
+			zlog_err("Failure to create %s socket", nl->name);
+			exit(-1);
+		}
+
+		kernel_netlink_nlsock_insert(nl);
+
+#if defined SOL_NETLINK
+		one = 1;
+		if (setsockopt(nl->sock, SOL_NETLINK, NETLINK_EXT_ACK, &one,
+			       sizeof(one)) < 0)
+			zlog_notice("Registration for extended %s ACK failed : %d %s",
+				    nl->name, errno, safe_strerror(errno));
+		one = 1;
+		setsockopt(nl->sock, SOL_NETLINK, NETLINK_CAP_ACK, &one,
+			   sizeof(one));
+#endif
+
+		if (fcntl(nl->sock, F_SETFL, O_NONBLOCK) < 0)
+			zlog_err("Can't set %s socket error: %s(%d)", nl->name,
+				 safe_strerror(errno), errno);
+
+		if (rcvbufsize)
+			netlink_recvbuf(nl, rcvbufsize);
+		netlink_sockbuf_sizes(nl);
+	}
+}
+
 void kernel_init(struct zebra_ns *zns)
 {
-	uint32_t groups, dplane_groups, ext_groups;
+	uint32_t pids[NL_FILTER_PIDS_MAX];
+	unsigned int npids = 0, i;
+
+	uint32_t groups, neigh_groups, dplane_groups, ext_groups;
 #if defined SOL_NETLINK
 	int one, ret, grp;
 #endif
@@ -1730,11 +2137,13 @@ void kernel_init(struct zebra_ns *zns)
 	 * exist.
 	 */
 	groups = RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE | RTMGRP_IPV4_MROUTE |
-		 RTMGRP_NEIGH | ((uint32_t)1 << (RTNLGRP_IPV4_RULE - 1)) |
+		 ((uint32_t)1 << (RTNLGRP_IPV4_RULE - 1)) |
 		 ((uint32_t)1 << (RTNLGRP_IPV6_RULE - 1)) |
 		 ((uint32_t)1 << (RTNLGRP_NEXTHOP - 1)) |
 		 ((uint32_t)1 << (RTNLGRP_TC - 1));
 
+	neigh_groups = RTMGRP_NEIGH;
+
 	dplane_groups = (RTMGRP_LINK            |
 			 RTMGRP_IPV4_IFADDR     |
 			 RTMGRP_IPV6_IFADDR     |
@@ -1757,6 +2166,22 @@ void kernel_init(struct zebra_ns *zns)
 
 	kernel_netlink_nlsock_insert(&zns->netlink);
 
+	snprintf(zns->netlink_neigh.name, sizeof(zns->netlink_neigh.name),
+		 "netlink-listen-neigh (NS %u)", zns->ns_id);
+	zns->netlink_neigh.sock = -1;
+	if (netlink_socket(&zns->netlink_neigh, neigh_groups, 0, 0,
+			   zns->ns_id) < 0) {
+		zlog_err("Failure to create %s socket",
+			 zns->netlink_neigh.name);
+		exit(-1);
+	}
+
+	kernel_netlink_nlsock_insert(&zns->netlink_neigh);
+
+	/* Both read by the main pthread, a batch of datagrams at a time */
+	zns->netlink.mmsg = XCALLOC(MTYPE_NL_BUF, sizeof(struct nl_mmsg));
+	zns->netlink_neigh.mmsg = XCALLOC(MTYPE_NL_BUF, sizeof(struct nl_mmsg));
+
 	snprintf(zns->netlink_cmd.name, sizeof(zns->netlink_cmd.name),
 		 "netlink-cmd (NS %u)", zns->ns_id);
 	zns->netlink_cmd.sock = -1;
@@ -1851,6 +2276,10 @@ void kernel_init(struct zebra_ns *zns)
 		flog_err_sys(EC_LIB_SOCKET, "Can't set %s socket flags: %s",
 			     zns->netlink.name, safe_strerror(errno));
 
+	if (fcntl(zns->netlink_neigh.sock, F_SETFL, O_NONBLOCK) < 0)
+		flog_err_sys(EC_LIB_SOCKET, "Can't set %s socket flags: %s",
+			     zns->netlink_neigh.name, safe_strerror(errno));
+
 	if (fcntl(zns->netlink_cmd.sock, F_SETFL, O_NONBLOCK) < 0)
 		zlog_err("Can't set %s socket error: %s(%d)",
 			 zns->netlink_cmd.name, safe_strerror(errno), errno);
@@ -1868,26 +2297,46 @@ void kernel_init(struct zebra_ns *zns)
 	/* Set receive buffer size if it's set from command line */
 	if (rcvbufsize) {
 		netlink_recvbuf(&zns->netlink, rcvbufsize);
+		netlink_recvbuf(&zns->netlink_neigh, rcvbufsize);
 		netlink_recvbuf(&zns->netlink_cmd, rcvbufsize);
 		netlink_recvbuf(&zns->netlink_dplane_out, rcvbufsize);
 		netlink_recvbuf(&zns->netlink_dplane_in, rcvbufsize);
 	}
+	netlink_sockbuf_sizes(&zns->netlink_dplane_out);
+
+	/* Where the listeners start growing their receive buffers from */
+	netlink_sockbuf_sizes(&zns->netlink);
+	netlink_sockbuf_sizes(&zns->netlink_neigh);
+	netlink_sockbuf_sizes(&zns->netlink_dplane_in);
+
+	kernel_init_dplane_shards(zns);
 
 	/* Set filter for inbound sockets, to exclude events we've generated
 	 * ourselves.
 	 */
-	netlink_install_filter(zns->netlink.sock, zns->netlink_cmd.snl.nl_pid,
-			       zns->netlink_dplane_out.snl.nl_pid);
+	pids[npids++] = zns->netlink_cmd.snl.nl_pid;
+	pids[npids++] = zns->netlink_dplane_out.snl.nl_pid;
+	if (zns->netlink_dplane_out.shards)
+		for (i = 0; i < zrouter.dplane_shards - 1; i++)
+			pids[npids++] =
+				zns->netlink_dplane_out.shards[i].snl.nl_pid;
+
+	netlink_install_filter(zns->netlink.sock, pids, npids);
 
-	netlink_install_filter(zns->netlink_dplane_in.sock,
-			       zns->netlink_cmd.snl.nl_pid,
-			       zns->netlink_dplane_out.snl.nl_pid);
+	netlink_install_filter(zns->netlink_neigh.sock, pids, npids);
+
+	netlink_install_filter(zns->netlink_dplane_in.sock, pids, npids);
 
 	zns->t_netlink = NULL;
 
 	event_add_read(zrouter.master, kernel_read, zns, zns->netlink.sock,
 		       &zns->t_netlink);
 
+	zns->t_netlink_neigh = NULL;
+
+	event_add_read(zrouter.master, kernel_read_neigh, zns,
+		       zns->netlink_neigh.sock, &zns->t_netlink_neigh);
+
 	rt_netlink_init();
 }
 
@@ -1900,15 +2349,19 @@ static void kernel_nlsock_fini(struct nlsock *nls)
 		nls->sock = -1;
 		XFREE(MTYPE_NL_BUF, nls->buf);
 		nls->buflen = 0;
+		XFREE(MTYPE_NL_BUF, nls->mmsg);
 	}
 }
 
 void kernel_terminate(struct zebra_ns *zns, bool complete)
 {
 	EVENT_OFF(zns->t_netlink);
+	EVENT_OFF(zns->t_netlink_neigh);
 
 	kernel_nlsock_fini(&zns->netlink);
 
+	kernel_nlsock_fini(&zns->netlink_neigh);
+
 	kernel_nlsock_fini(&zns->netlink_cmd);
 
 	kernel_nlsock_fini(&zns->netlink_dplane_in);
@@ -1916,8 +2369,16 @@ void kernel_terminate(struct zebra_ns *zns, bool complete)
 	/* During zebra shutdown, we need to leave the dataplane socket
 	 * around until all work is done.
 	 */
-	if (complete)
+	if (complete) {
+		if (zns->netlink_dplane_out.shards) {
+			for (unsigned int i = 0; i < zrouter.dplane_shards - 1;
+			     i++)
+				kernel_nlsock_fini(
+					&zns->netlink_dplane_out.shards[i]);
+			XFREE(MTYPE_NL_BUF, zns->netlink_dplane_out.shards);
+		}
 		kernel_nlsock_fini(&zns->netlink_dplane_out);
+	}
 }
 
 /*
@@ -1641,4 +1641,11 @@ void kernel_update_multi(struct dplane_ctx_list_head *ctx_list)
 	dplane_ctx_list_append(ctx_list, &handled_list);
 }
 
+/* There is only the one routing socket, and no shards to speak of */
+void kernel_update_multi_shard(struct dplane_ctx_list_head *ctx_list,
+			       unsigned int shard)
+{
+	kernel_update_multi(ctx_list);
+}
+
 #endif /* !HAVE_NETLINK */
@@ -45,6 +45,8 @@
 #include "zebra/zebra_srte.h"
 #include "zebra/zebra_srv6.h"
 #include "zebra/zebra_srv6_vty.h"
+#include "zebra/zebra_state_export.h"
+#include "zebra/zebra_link_delay.h"
 
 #define ZEBRA_PTM_SUPPORT
 
@@ -59,6 +61,20 @@ int retain_mode = 0;
 
 int graceful_restart;
 
+/*
+ * Kernel routes kept on a warm restart without -K, until the daemons have
+ * reconnected and sent theirs again; a bgpd restarting with it keeps its
+ * peers' routes for its restart time, 120 seconds by default.
+ */
+#define ZEBRA_WARM_RESTART_TIME 180
+
+/* The next zebra picks up the kernel routes, see frr_is_warm_restart() */
+static int zebra_warm_restart_prepare(void)
+{
+	retain_mode = 1;
+	return 0;
+}
+
 bool v6_rr_semantics = false;
 
 /* Receive buffer size for kernel control sockets */
@@ -74,6 +90,7 @@ uint32_t rt_table_main_id = RT_TABLE_MAIN;
 #define OPTION_V6_RR_SEMANTICS 2000
 #define OPTION_ASIC_OFFLOAD    2001
 #define OPTION_V6_WITH_V4_NEXTHOP 2002
+#define OPTION_DPLANE_SHARDS 2003
 
 /* Command line options. */
 const struct option longopts[] = {
@@ -89,6 +106,7 @@ const struct option longopts[] = {
 	{ "vrfwnetns", no_argument, NULL, 'n' },
 	{ "nl-bufsize", required_argument, NULL, 's' },
 	{ "v6-rr-semantics", no_argument, NULL, OPTION_V6_RR_SEMANTICS },
+	{ "dplane-shards", required_argument, NULL, OPTION_DPLANE_SHARDS },
 #endif /* HAVE_NETLINK */
 	{"routing-table", optional_argument, NULL, 'R'},
 	{ 0 }
@@ -148,6 +166,9 @@ static void sigint(void)
 
 	frr_early_fini();
 
+	zebra_state_export_finish();
+	zebra_link_delay_finish();
+
 	/* Stop the opaque module pthread */
 	zebra_opaque_stop();
 
@@ -302,6 +323,11 @@ int main(int argc, char **argv)
 	bool v6_with_v4_nexthop = false;
 	bool notify_on_ack = true;
 
+	/* the per-route objects, before anything is allocated */
+	qmem_pool_enable(MTYPE_RE);
+	qmem_pool_enable(MTYPE_NHG);
+	qmem_pool_enable(MTYPE_ROUTE_NODE);
+
 	graceful_restart = 0;
 	vrf_configure_backend(VRF_BACKEND_VRF_LITE);
 
@@ -325,6 +351,7 @@ int main(int argc, char **argv)
 		    "  -s, --nl-bufsize          Set netlink receive buffer size\n"
 		    "  -n, --vrfwnetns           Use NetNS as VRF backend\n"
 		    "      --v6-rr-semantics     Use v6 RR semantics\n"
+		    "      --dplane-shards       Program routes from this many dataplane pthreads\n"
 #else
 		    "  -s,                       Set kernel socket receive buffer size\n"
 #endif /* HAVE_NETLINK */
@@ -403,6 +430,18 @@ int main(int argc, char **argv)
 		case OPTION_V6_WITH_V4_NEXTHOP:
 			v6_with_v4_nexthop = true;
 			break;
+		case OPTION_DPLANE_SHARDS: {
+			unsigned long int shards = strtoul(optarg, NULL, 10);
+
+			if (shards == 0 || shards > ZEBRA_DPLANE_SHARDS_MAX) {
+				fprintf(stderr,
+					"Dataplane shards must be between 1 and %u\n",
+					ZEBRA_DPLANE_SHARDS_MAX);
+				return 1;
+			}
+			zrouter.dplane_shards = shards;
+			break;
+		}
 #endif /* HAVE_NETLINK */
 		default:
 			frr_help_exit(1);
@@ -410,6 +449,13 @@ int main(int argc, char **argv)
 	}
 
 	zrouter.master = frr_init();
+	hook_register(frr_warm_restart_prepare, zebra_warm_restart_prepare);
+
+	if (frr_is_warm_restart() && !graceful_restart) {
+		graceful_restart = ZEBRA_WARM_RESTART_TIME;
+		zlog_notice("Warm restart, keeping kernel routes for %d seconds",
+			    graceful_restart);
+	}
 
 	/* Zebra related initialize. */
 	zebra_router_init(asic_offload, notify_on_ack, v6_with_v4_nexthop);
@@ -492,6 +538,9 @@ int main(int argc, char **argv)
 	/* Error init */
 	zebra_error_init();
 
+	/* Paged RIB dumps for collectors */
+	zebra_state_export_init();
+
 	frr_run(zrouter.master);
 
 	/* Not reached... */
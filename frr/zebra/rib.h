@@ -32,6 +32,8 @@ DECLARE_MGROUP(ZEBRA);
 DECLARE_MTYPE(RE);
 
 PREDECL_LIST(rnh_list);
+PREDECL_HASH(rnh_rcache);
+PREDECL_DLIST(rnh_rcache_list);
 
 /* Nexthop structure. */
 struct rnh {
@@ -66,16 +68,46 @@ struct rnh {
 	struct rnh_list_item rnh_list_item;
 };
 
+/*
+ * A nexthop address recursive resolution found a route for, and the dest
+ * it was found on, kept on the dest's list to be dropped as that or a
+ * more specific route changes. See zebra_rnh_rcache_find().
+ */
+struct rnh_rcache_entry {
+	vrf_id_t vrf_id;
+	struct prefix p;
+	struct rib_dest_t_ *dest;
+
+	struct rnh_rcache_item hash_item;
+	struct rnh_rcache_list_item list_item;
+};
+
 #define DISTANCE_INFINITY  255
 #define ZEBRA_KERNEL_TABLE_MAX 252 /* support for no more than this rt tables */
 
 PREDECL_LIST(re_list);
+PREDECL_DLIST(rib_version_list);
 
 struct re_opaque {
 	uint16_t length;
 	uint8_t data[];
 };
 
+/*
+ * Nexthop groups from FIB, reflecting what is actually installed in the
+ * FIB if that differs from a route's. The 'backup' group is used when
+ * backup nexthops are present in the route's nhg. Few routes have them,
+ * so they are allocated only for those.
+ */
+struct route_entry_fib {
+	struct nexthop_group ng;
+	struct nexthop_group backup_ng;
+};
+
+/*
+ * There is one of these per route per protocol: pointers first, then the
+ * 32 bit fields, then the small ones, leaving no holes.
+ */
 struct route_entry {
 	/* Link list. */
 	struct re_list_item next;
@@ -85,12 +117,13 @@ struct route_entry {
 	 */
 	struct nhg_hash_entry *nhe;
 
-	/* Nexthop group from FIB (optional), reflecting what is actually
-	 * installed in the FIB if that differs. The 'backup' group is used
-	 * when backup nexthops are present in the route's nhg.
-	 */
-	struct nexthop_group fib_ng;
-	struct nexthop_group fib_backup_ng;
+	/* FIB nexthop groups (optional), see above */
+	struct route_entry_fib *fib;
+
+	struct re_opaque *opaque;
+
+	/* Uptime. */
+	time_t uptime;
 
 	/* Nexthop group hash entry IDs. The "installed" id is the id
 	 * used in linux/netlink, if available.
@@ -101,12 +134,6 @@ struct route_entry {
 	/* Tag */
 	route_tag_t tag;
 
-	/* Uptime. */
-	time_t uptime;
-
-	/* Type of this route. */
-	int type;
-
 	/* VRF identifier. */
 	vrf_id_t vrf_id;
 
@@ -126,8 +153,14 @@ struct route_entry {
 	 */
 	uint32_t flags;
 
+	/* Sequence value incremented for each dataplane operation */
+	uint32_t dplane_sequence;
+
+	/* Source protocol instance */
+	uint16_t instance;
+
 	/* RIB internal status */
-	uint32_t status;
+	uint16_t status;
 #define ROUTE_ENTRY_REMOVED          0x1
 /* The Route Entry has changed */
 #define ROUTE_ENTRY_CHANGED          0x2
@@ -151,16 +184,11 @@ struct route_entry {
  */
 #define ROUTE_ENTRY_ROUTE_REPLACING 0x80
 
-	/* Sequence value incremented for each dataplane operation */
-	uint32_t dplane_sequence;
-
-	/* Source protocol instance */
-	uint16_t instance;
+	/* Type of this route. */
+	uint8_t type;
 
 	/* Distance. */
 	uint8_t distance;
-
-	struct re_opaque *opaque;
 };
 
 #define RIB_SYSTEM_ROUTE(R) RSYSTEM_ROUTE((R)->type)
@@ -184,7 +212,7 @@ struct route_entry {
  * sub-queue 9: any other origin (if any) typically those that
  *              don't generate routes
  */
-#define MQ_SIZE 11
+#define MQ_SIZE 12
 
 /* For checking that an object has already queued in some sub-queue */
 #define MQ_BIT_MASK ((1 << MQ_SIZE) - 1)
@@ -226,15 +254,28 @@ typedef struct rib_dest_t_ {
 	 */
 	struct rnh_list_head nht;
 
+	/* Nexthop addresses last resolved over this route node */
+	struct rnh_rcache_list_head rcache;
+
 	/*
 	 * Linkage to put dest on the FPM processing queue.
 	 */
 	TAILQ_ENTRY(rib_dest_t_) fpm_q_entries;
 
+	/*
+	 * Version of the last change to what is installed for the prefix,
+	 * 0 if there was none, and linkage on the list of dests in version
+	 * order. See rib_walk_changed_since().
+	 */
+	uint64_t version;
+	struct rib_version_list_item version_item;
+
 } rib_dest_t;
 
 DECLARE_LIST(rnh_list, struct rnh, rnh_list_item);
+DECLARE_DLIST(rnh_rcache_list, struct rnh_rcache_entry, list_item);
 DECLARE_LIST(re_list, struct route_entry, next);
+DECLARE_DLIST(rib_version_list, rib_dest_t, version_item);
 
 #define RIB_ROUTE_QUEUED(x)	(1 << (x))
 // If MQ_SIZE is modified this value needs to be updated.
@@ -259,6 +300,18 @@ DECLARE_LIST(re_list, struct route_entry, next);
 
 #define RIB_DEST_UPDATE_LSPS   (1 << (ZEBRA_MAX_QINDEX + 3))
 
+/*
+ * The route being added only moves the installed one to other nexthops,
+ * see META_QUEUE_FAST.
+ */
+#define RIB_DEST_NEXTHOP_ONLY  (1 << (ZEBRA_MAX_QINDEX + 4))
+
+/*
+ * The dest has no routes left and is only kept to tell of their removal
+ * to rib_walk_changed_since().
+ */
+#define RIB_DEST_TOMBSTONE     (1 << (ZEBRA_MAX_QINDEX + 5))
+
 /*
  * Macro to iterate over each route for a destination (prefix).
  */
@@ -468,6 +521,20 @@ extern struct route_table *rib_table_ipv6;
 
 extern void rib_unlink(struct route_node *rn, struct route_entry *re);
 extern int rib_gc_dest(struct route_node *rn);
+
+/*
+ * Changes to what is installed, for consumers catching up on them, e.g.
+ * after losing their connection: rib_version() is the version of the
+ * last one. rib_walk_changed_since() calls cb on each dest changed after
+ * version, oldest change first, until cb returns false; a dest with no
+ * selected_fib has had its route removed. cb must not change the RIB.
+ * Returns false, without calling cb, when changes that old are no longer
+ * all known.
+ */
+extern uint64_t rib_version(void);
+extern bool rib_walk_changed_since(uint64_t version,
+				   bool (*cb)(rib_dest_t *dest, void *arg),
+				   void *arg);
 extern struct route_table *rib_tables_iter_next(rib_tables_iter_t *iter);
 
 extern uint8_t route_distance(int type);
@@ -598,13 +665,16 @@ DECLARE_HOOK(rib_shutdown, (struct route_node * rn), (rn));
  * Access installed/fib nexthops, which may be a subset of the
  * rib nexthops.
  */
+/* What a route without FIB nexthop groups has for them; never written */
+extern struct nexthop_group rib_fib_nhg_none;
+
 static inline struct nexthop_group *rib_get_fib_nhg(struct route_entry *re)
 {
 	/* If the fib set is a subset of the active rib set,
 	 * use the dedicated fib list.
 	 */
 	if (CHECK_FLAG(re->status, ROUTE_ENTRY_USE_FIB_NHG))
-		return &(re->fib_ng);
+		return re->fib ? &re->fib->ng : &rib_fib_nhg_none;
 	else
 		return &(re->nhe->nhg);
 }
@@ -616,9 +686,14 @@ static inline struct nexthop_group *rib_get_fib_nhg(struct route_entry *re)
 static inline struct nexthop_group *rib_get_fib_backup_nhg(
 	struct route_entry *re)
 {
-	return &(re->fib_backup_ng);
+	return re->fib ? &re->fib->backup_ng : &rib_fib_nhg_none;
 }
 
+/* A copy of from's FIB nexthop groups for to, which has none */
+extern void route_entry_fib_copy(struct route_entry *to,
+				 const struct route_entry *from);
+extern void route_entry_fib_free(struct route_entry *re);
+
 extern void zebra_gr_process_client(afi_t afi, vrf_id_t vrf_id, uint8_t proto,
 				    uint8_t instance);
 
@@ -111,6 +111,12 @@ extern int kernel_del_mac_nhg(uint32_t nhg_id);
  * Message batching interface.
  */
 extern void kernel_update_multi(struct dplane_ctx_list_head *ctx_list);
+/*
+ * The same from a kernel provider shard, sending on the shard's netlink
+ * sockets; shard 0 is the dplane pthread's own, as kernel_update_multi().
+ */
+extern void kernel_update_multi_shard(struct dplane_ctx_list_head *ctx_list,
+				      unsigned int shard);
 
 /*
  * Called by the dplane pthread to read incoming OS messages and dispatch them.
@@ -711,6 +711,9 @@ int zsend_nhg_notify(uint16_t type, uint16_t instance, uint32_t session_id,
 	return zserv_send_message(client, s);
 }
 
+/* Between zsend_route_notify_owner_batch_start() and _end() */
+static bool route_notify_batch;
+
 /*
  * Common utility send route notification, called from a path using a
  * route_entry and from a path using a dataplane context.
@@ -765,9 +768,22 @@ static int route_notify_internal(const struct route_node *rn, int type,
 
 	stream_putw_at(s, 0, stream_get_endp(s));
 
+	if (route_notify_batch)
+		return zserv_send_message_deferred(client, s);
 	return zserv_send_message(client, s);
 }
 
+void zsend_route_notify_owner_batch_start(void)
+{
+	route_notify_batch = true;
+}
+
+void zsend_route_notify_owner_batch_end(void)
+{
+	route_notify_batch = false;
+	zserv_send_deferred_flush();
+}
+
 int zsend_route_notify_owner(const struct route_node *rn,
 			     struct route_entry *re,
 			     enum zapi_route_notify_owner note, afi_t afi,
@@ -1161,7 +1177,6 @@ static void zread_rnh_register(ZAPI_HANDLER_ARGS)
 	uint8_t connected = 0;
 	uint8_t resolve_via_default;
 	bool exist;
-	bool flag_changed = false;
 	uint8_t orig_flags;
 	safi_t safi;
 
@@ -1224,11 +1239,12 @@ static void zread_rnh_register(ZAPI_HANDLER_ARGS)
 		if (resolve_via_default)
 			SET_FLAG(rnh->flags, ZEBRA_NHT_RESOLVE_VIA_DEFAULT);
 
-		if (orig_flags != rnh->flags)
-			flag_changed = true;
-
-		/* Anything not AF_INET/INET6 has been filtered out above */
-		if (!exist || flag_changed)
+		/*
+		 * Anything not AF_INET/INET6 has been filtered out above.
+		 * A message can carry many nexthops, only those that are new
+		 * or changed flags need to be evaluated.
+		 */
+		if (!exist || orig_flags != rnh->flags)
 			zebra_evaluate_rnh(zvrf, family2afi(p.family), 1, &p,
 					   safi);
 
@@ -1994,10 +2010,10 @@ static void zread_nhg_add(ZAPI_HANDLER_ARGS)
 
 }
 
-static void zread_route_add(ZAPI_HANDLER_ARGS)
+/* A route decoded from client, to add to zvrf's table */
+static void zapi_route_add(struct zserv *client, struct zebra_vrf *zvrf,
+			   struct zapi_route *api)
 {
-	struct stream *s;
-	struct zapi_route api;
 	afi_t afi;
 	struct prefix_ipv6 *src_p = NULL;
 	struct route_entry *re;
@@ -2005,36 +2021,28 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 	struct nhg_backup_info *bnhg = NULL;
 	int ret;
 	vrf_id_t vrf_id;
-	struct nhg_hash_entry nhe, *n = NULL;
-
-	s = msg;
-	if (zapi_route_decode(s, &api) < 0) {
-		if (IS_ZEBRA_DEBUG_RECV)
-			zlog_debug("%s: Unable to decode zapi_route sent",
-				   __func__);
-		return;
-	}
+	struct nhg_hash_entry *n = NULL;
 
 	vrf_id = zvrf_id(zvrf);
 
 	if (IS_ZEBRA_DEBUG_RECV)
 		zlog_debug("%s: p=(%u:%u)%pFX, msg flags=0x%x, flags=0x%x",
-			   __func__, vrf_id, api.tableid, &api.prefix,
-			   (int)api.message, api.flags);
+			   __func__, vrf_id, api->tableid, &api->prefix,
+			   (int)api->message, api->flags);
 
 	/* Allocate new route. */
 	re = zebra_rib_route_entry_new(
-		vrf_id, api.type, api.instance, api.flags, api.nhgid,
-		api.tableid ? api.tableid : zvrf->table_id, api.metric, api.mtu,
-		api.distance, api.tag);
+		vrf_id, api->type, api->instance, api->flags, api->nhgid,
+		api->tableid ? api->tableid : zvrf->table_id, api->metric, api->mtu,
+		api->distance, api->tag);
 
-	if (!CHECK_FLAG(api.message, ZAPI_MESSAGE_NHG)
-	    && (!CHECK_FLAG(api.message, ZAPI_MESSAGE_NEXTHOP)
-		|| api.nexthop_num == 0)) {
+	if (!CHECK_FLAG(api->message, ZAPI_MESSAGE_NHG)
+	    && (!CHECK_FLAG(api->message, ZAPI_MESSAGE_NEXTHOP)
+		|| api->nexthop_num == 0)) {
 		flog_warn(
 			EC_ZEBRA_RX_ROUTE_NO_NEXTHOPS,
 			"%s: received a route without nexthops for prefix %pFX from client %s",
-			__func__, &api.prefix,
+			__func__, &api->prefix,
 			zebra_route_string(client->proto));
 
 		XFREE(MTYPE_RE, re);
@@ -2042,23 +2050,23 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 	}
 
 	/* Report misuse of the backup flag */
-	if (CHECK_FLAG(api.message, ZAPI_MESSAGE_BACKUP_NEXTHOPS)
-	    && api.backup_nexthop_num == 0) {
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_BACKUP_NEXTHOPS)
+	    && api->backup_nexthop_num == 0) {
 		if (IS_ZEBRA_DEBUG_RECV || IS_ZEBRA_DEBUG_EVENT)
 			zlog_debug(
 				"%s: client %s: BACKUP flag set but no backup nexthops, prefix %pFX",
 				__func__, zebra_route_string(client->proto),
-				&api.prefix);
+				&api->prefix);
 	}
 
 	if (!re->nhe_id
-	    && (!zapi_read_nexthops(client, &api.prefix, api.nexthops,
-				    api.flags, api.message, api.nexthop_num,
-				    api.backup_nexthop_num, &ng, NULL)
-		|| !zapi_read_nexthops(client, &api.prefix, api.backup_nexthops,
-				       api.flags, api.message,
-				       api.backup_nexthop_num,
-				       api.backup_nexthop_num, NULL, &bnhg))) {
+	    && (!zapi_read_nexthops(client, &api->prefix, api->nexthops,
+				    api->flags, api->message, api->nexthop_num,
+				    api->backup_nexthop_num, &ng, NULL)
+		|| !zapi_read_nexthops(client, &api->prefix, api->backup_nexthops,
+				       api->flags, api->message,
+				       api->backup_nexthop_num,
+				       api->backup_nexthop_num, NULL, &bnhg))) {
 
 		nexthop_group_delete(&ng);
 		zebra_nhg_backup_free(&bnhg);
@@ -2066,16 +2074,16 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 		return;
 	}
 
-	if (CHECK_FLAG(api.message, ZAPI_MESSAGE_OPAQUE)) {
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_OPAQUE)) {
 		re->opaque =
 			XMALLOC(MTYPE_RE_OPAQUE,
-				sizeof(struct re_opaque) + api.opaque.length);
-		re->opaque->length = api.opaque.length;
-		memcpy(re->opaque->data, api.opaque.data, re->opaque->length);
+				sizeof(struct re_opaque) + api->opaque.length);
+		re->opaque->length = api->opaque.length;
+		memcpy(re->opaque->data, api->opaque.data, re->opaque->length);
 	}
 
-	afi = family2afi(api.prefix.family);
-	if (afi != AFI_IP6 && CHECK_FLAG(api.message, ZAPI_MESSAGE_SRCPFX)) {
+	afi = family2afi(api->prefix.family);
+	if (afi != AFI_IP6 && CHECK_FLAG(api->message, ZAPI_MESSAGE_SRCPFX)) {
 		flog_warn(EC_ZEBRA_RX_SRCDEST_WRONG_AFI,
 			  "%s: Received SRC Prefix but afi is not v6",
 			  __func__);
@@ -2085,13 +2093,13 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 		XFREE(MTYPE_RE, re);
 		return;
 	}
-	if (CHECK_FLAG(api.message, ZAPI_MESSAGE_SRCPFX))
-		src_p = &api.src_prefix;
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_SRCPFX))
+		src_p = &api->src_prefix;
 
-	if (api.safi != SAFI_UNICAST && api.safi != SAFI_MULTICAST) {
+	if (api->safi != SAFI_UNICAST && api->safi != SAFI_MULTICAST) {
 		flog_warn(EC_LIB_ZAPI_MISSMATCH,
 			  "%s: Received safi: %d but we can only accept UNICAST or MULTICAST",
-			  __func__, api.safi);
+			  __func__, api->safi);
 		nexthop_group_delete(&ng);
 		zebra_nhg_backup_free(&bnhg);
 		XFREE(MTYPE_RE_OPAQUE, re->opaque);
@@ -2105,17 +2113,13 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 	 *
 	 * Havent figured out how to handle backup NHs with this yet, so lets
 	 * keep that separate.
-	 * Include backup info with the route. We use a temporary nhe here;
-	 * if this is a new/unknown nhe, a new copy will be allocated
-	 * and stored.
+	 * Include backup info with the route. The nexthops just decoded move
+	 * into the nhe passed along, rather than being copied; if this is a
+	 * new/unknown nhe, a new copy will be allocated and stored.
 	 */
-	if (!re->nhe_id) {
-		zebra_nhe_init(&nhe, afi, ng->nexthop);
-		nhe.nhg.nexthop = ng->nexthop;
-		nhe.backup_info = bnhg;
-		n = zebra_nhe_copy(&nhe, 0);
-	}
-	ret = rib_add_multipath_nhe(afi, api.safi, &api.prefix, src_p, re, n,
+	if (!re->nhe_id)
+		n = zebra_nhe_take(afi, ng, &bnhg);
+	ret = rib_add_multipath_nhe(afi, api->safi, &api->prefix, src_p, re, n,
 				    false);
 
 	/*
@@ -2137,7 +2141,7 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 		zebra_nhg_backup_free(&bnhg);
 
 	/* Stats */
-	switch (api.prefix.family) {
+	switch (api->prefix.family) {
 	case AF_INET:
 		if (ret == 0)
 			client->v4_route_add_cnt++;
@@ -2153,6 +2157,52 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 	}
 }
 
+static void zread_route_add(ZAPI_HANDLER_ARGS)
+{
+	struct stream *s;
+	struct zapi_route api;
+
+	s = msg;
+	if (zapi_route_decode(s, &api) < 0) {
+		if (IS_ZEBRA_DEBUG_RECV)
+			zlog_debug("%s: Unable to decode zapi_route sent",
+				   __func__);
+		return;
+	}
+
+	zapi_route_add(client, zvrf, &api);
+}
+
+/* Routes sharing all but the prefix, one nexthop group id among it */
+static void zread_route_add_bulk(ZAPI_HANDLER_ARGS)
+{
+	struct stream *s;
+	struct zapi_route api;
+	uint16_t count;
+
+	s = msg;
+	if (zapi_route_bulk_decode(s, &api, &count) < 0) {
+		if (IS_ZEBRA_DEBUG_RECV)
+			zlog_debug("%s: Unable to decode zapi_route bulk sent",
+				   __func__);
+		return;
+	}
+
+	if (IS_ZEBRA_DEBUG_RECV)
+		zlog_debug("%s: %u routes, nhg %u", __func__, count,
+			   api.nhgid);
+
+	while (count--) {
+		if (zapi_route_bulk_decode_prefix(s, &api) < 0) {
+			if (IS_ZEBRA_DEBUG_RECV)
+				zlog_debug("%s: Unable to decode prefix, %u dropped",
+					   __func__, count + 1);
+			return;
+		}
+		zapi_route_add(client, zvrf, &api);
+	}
+}
+
 void zapi_re_opaque_free(struct re_opaque *opaque)
 {
 	XFREE(MTYPE_RE_OPAQUE, opaque);
@@ -3610,41 +3660,36 @@ stream_failure:
 	return;
 }
 
-static inline void zebra_neigh_ip_add(ZAPI_HANDLER_ARGS)
+/* A message carries any number of neighbors, see zclient_neigh_ip_send_bulk */
+static void zebra_neigh_ip_update(ZAPI_HANDLER_ARGS, enum dplane_op_e op)
 {
 	struct stream *s;
-	struct zapi_neigh_ip api = {};
-	int ret;
+	struct zapi_neigh_ip api;
 	const struct interface *ifp;
 
 	s = msg;
-	ret = zclient_neigh_ip_decode(s, &api);
-	if (ret < 0)
-		return;
-	ifp = if_lookup_by_index(api.index, zvrf_id(zvrf));
-	if (!ifp)
-		return;
-	dplane_neigh_ip_update(DPLANE_OP_NEIGH_IP_INSTALL, ifp, &api.ip_out,
-			       &api.ip_in, api.ndm_state, client->proto);
+	while (STREAM_READABLE(s)) {
+		memset(&api, 0, sizeof(api));
+		if (zclient_neigh_ip_decode(s, &api) < 0)
+			return;
+		ifp = if_lookup_by_index(api.index, zvrf_id(zvrf));
+		if (!ifp)
+			continue;
+		dplane_neigh_ip_update(op, ifp, &api.ip_out, &api.ip_in,
+				       api.ndm_state, client->proto);
+	}
 }
 
+static inline void zebra_neigh_ip_add(ZAPI_HANDLER_ARGS)
+{
+	zebra_neigh_ip_update(client, hdr, msg, zvrf,
+			      DPLANE_OP_NEIGH_IP_INSTALL);
+}
 
 static inline void zebra_neigh_ip_del(ZAPI_HANDLER_ARGS)
 {
-	struct stream *s;
-	struct zapi_neigh_ip api = {};
-	int ret;
-	struct interface *ifp;
-
-	s = msg;
-	ret = zclient_neigh_ip_decode(s, &api);
-	if (ret < 0)
-		return;
-	ifp = if_lookup_by_index(api.index, zvrf_id(zvrf));
-	if (!ifp)
-		return;
-	dplane_neigh_ip_update(DPLANE_OP_NEIGH_IP_DELETE, ifp, &api.ip_out,
-			       &api.ip_in, api.ndm_state, client->proto);
+	zebra_neigh_ip_update(client, hdr, msg, zvrf,
+			      DPLANE_OP_NEIGH_IP_DELETE);
 }
 
 
@@ -3811,6 +3856,7 @@ void (*const zserv_handlers[])(ZAPI_HANDLER_ARGS) = {
 	[ZEBRA_INTERFACE_DELETE] = zread_interface_delete,
 	[ZEBRA_INTERFACE_SET_PROTODOWN] = zread_interface_set_protodown,
 	[ZEBRA_ROUTE_ADD] = zread_route_add,
+	[ZEBRA_ROUTE_ADD_BULK] = zread_route_add_bulk,
 	[ZEBRA_ROUTE_DELETE] = zread_route_del,
 	[ZEBRA_REDISTRIBUTE_ADD] = zebra_redistribute_add,
 	[ZEBRA_REDISTRIBUTE_DELETE] = zebra_redistribute_delete,
@@ -67,6 +67,13 @@ extern int zsend_route_notify_owner(const struct route_node *rn,
 extern int zsend_route_notify_owner_ctx(const struct zebra_dplane_ctx *ctx,
 					enum zapi_route_notify_owner note);
 
+/*
+ * Route-owner notifications sent between these two wake each owner's
+ * client pthread once, at the end, rather than once per notification
+ */
+extern void zsend_route_notify_owner_batch_start(void);
+extern void zsend_route_notify_owner_batch_end(void);
+
 extern void zsend_rule_notify_owner(const struct zebra_dplane_ctx *ctx,
 				    enum zapi_rule_notify_owner note);
 
@@ -14,6 +14,7 @@
 #include "lib/debug.h"
 #include "lib/frratomic.h"
 #include "lib/frr_pthread.h"
+#include "lib/jhash.h"
 #include "lib/memory.h"
 #include "lib/zebra.h"
 #include "zebra/netconf_netlink.h"
@@ -53,6 +54,12 @@ const uint32_t DPLANE_DEFAULT_MAX_QUEUED = 200;
 /* Default value for new work per cycle */
 const uint32_t DPLANE_DEFAULT_NEW_WORK = 100;
 
+/* How far past the work limit the kernel provider goes with a backlog */
+#define KERNEL_DPLANE_BACKLOG_SCALE 16
+
+/* Shorter runs of route updates are not worth waking the shards for */
+#define KERNEL_DPLANE_SHARD_MIN_RUN 32
+
 /* Validation check macro for context blocks */
 /* #define DPLANE_DEBUG 1 */
 
@@ -125,6 +132,9 @@ struct dplane_route_info {
 
 	uint32_t zd_flags;
 
+	/* RIB version of the change, see rib_walk_changed_since() */
+	uint64_t zd_rib_version;
+
 	/* Nexthop hash entry info */
 	struct dplane_nexthop_info nhe;
 
@@ -1941,6 +1951,13 @@ uint32_t dplane_ctx_get_nh_mtu(const struct zebra_dplane_ctx *ctx)
 	return ctx->u.rinfo.zd_nexthop_mtu;
 }
 
+uint64_t dplane_ctx_get_rib_version(const struct zebra_dplane_ctx *ctx)
+{
+	DPLANE_CTX_VALID(ctx);
+
+	return ctx->u.rinfo.zd_rib_version;
+}
+
 uint8_t dplane_ctx_get_distance(const struct zebra_dplane_ctx *ctx)
 {
 	DPLANE_CTX_VALID(ctx);
@@ -3355,6 +3372,42 @@ int dplane_ctx_route_init_basic(struct zebra_dplane_ctx *ctx,
 	return AOK;
 }
 
+/*
+ * Initialize a context block for the removal of the route installed for
+ * rn, which may have no route left to go by: only the prefix and table
+ * are known.
+ */
+int dplane_ctx_route_init_removal(struct zebra_dplane_ctx *ctx,
+				  struct route_node *rn)
+{
+	const struct rib_table_info *info;
+	const struct prefix *p;
+	const struct prefix_ipv6 *src_p;
+
+	if (dplane_ctx_route_init_basic(ctx, DPLANE_OP_ROUTE_DELETE, NULL, NULL,
+					NULL, AFI_UNSPEC, SAFI_UNSPEC) != AOK)
+		return EINVAL;
+
+	srcdest_rnode_prefixes(rn, &p, (const struct prefix **)&src_p);
+	info = srcdest_rnode_table_info(rn);
+
+	prefix_copy(&(ctx->u.rinfo.zd_dest), p);
+	if (src_p)
+		prefix_copy(&(ctx->u.rinfo.zd_src), src_p);
+	else
+		memset(&(ctx->u.rinfo.zd_src), 0, sizeof(ctx->u.rinfo.zd_src));
+
+	ctx->zd_table_id = info->table_id;
+	ctx->zd_vrf_id = zvrf_id(info->zvrf);
+	ctx->u.rinfo.zd_afi = info->afi;
+	ctx->u.rinfo.zd_safi = info->safi;
+	ctx->u.rinfo.zd_rib_version = rib_dest_from_rnode(rn)->version;
+
+	dplane_ctx_ns_init(ctx, info->zvrf->zns, false);
+
+	return AOK;
+}
+
 /*
  * Initialize a context block for a route update from zebra data structs.
  * If the `rn` or `re` parameters are NULL, this function only initializes the
@@ -3400,6 +3453,8 @@ int dplane_ctx_route_init(struct zebra_dplane_ctx *ctx, enum dplane_op_e op,
 					info->safi) != AOK)
 		return ret;
 
+	ctx->u.rinfo.zd_rib_version = rib_dest_from_rnode(rn)->version;
+
 	/* Copy nexthops; recursive info is included too */
 	copy_nexthops(&(ctx->u.rinfo.zd_ng.nexthop),
 		      re->nhe->nhg.nexthop, NULL);
@@ -4269,6 +4324,12 @@ dplane_route_update_internal(struct route_node *rn,
 			return ZEBRA_DPLANE_REQUEST_SUCCESS;
 		}
 
+		if (IS_ZEBRA_DEBUG_DPLANE_DETAIL)
+			zlog_debug("%u:%pFX Dplane route ctx %p queued op %s",
+				   dplane_ctx_get_vrf(ctx),
+				   dplane_ctx_get_dest(ctx), ctx,
+				   dplane_op2str(op));
+
 		/* Enqueue context for processing */
 		ret = dplane_update_enqueue(ctx);
 	}
@@ -6207,6 +6268,11 @@ uint32_t dplane_provider_out_ctx_queue_len(struct zebra_dplane_provider *prov)
 				    memory_order_relaxed);
 }
 
+uint32_t dplane_provider_in_ctx_queue_len(struct zebra_dplane_provider *prov)
+{
+	return atomic_load_explicit(&prov->dp_in_queued, memory_order_relaxed);
+}
+
 /*
  * Enqueue and maintain associated counter
  */
@@ -6797,6 +6863,219 @@ void dplane_rib_add_multipath(afi_t afi, safi_t safi, struct prefix *p,
 	}
 }
 
+/*
+ * Kernel provider shards. With zrouter.dplane_shards > 1, a run of route
+ * updates is split by table over the dplane pthread, as shard 0, and
+ * dplane_shards - 1 workers, each sending on netlink sockets of its own.
+ * The dplane pthread waits for the workers and puts their results back
+ * together before handling them as usual. Everything else goes out from
+ * the dplane pthread between runs, in queue order, so routes still reach
+ * the kernel after the nexthop groups they refer to.
+ */
+struct kernel_shard {
+	struct frr_pthread *fpt;
+	unsigned int index;
+
+	/* What to send, then the results; the worker's while busy */
+	struct dplane_ctx_list_head work;
+	bool busy;
+};
+
+static struct {
+	pthread_mutex_t mtx;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+
+	/* Workers not done with the current run yet */
+	unsigned int pending;
+
+	unsigned int count;
+	struct kernel_shard shards[ZEBRA_DPLANE_SHARDS_MAX];
+} kshards;
+
+static bool kernel_shard_op(const struct zebra_dplane_ctx *ctx)
+{
+	enum dplane_op_e op = dplane_ctx_get_op(ctx);
+
+	return op == DPLANE_OP_ROUTE_INSTALL || op == DPLANE_OP_ROUTE_UPDATE ||
+	       op == DPLANE_OP_ROUTE_DELETE;
+}
+
+/* A table's updates all go through one shard, keeping them in order */
+static unsigned int kernel_shard_of(const struct zebra_dplane_ctx *ctx)
+{
+	return jhash_2words(dplane_ctx_get_table(ctx), dplane_ctx_get_vrf(ctx),
+			    0) %
+	       kshards.count;
+}
+
+static void kernel_update_sharded(struct dplane_ctx_list_head *run)
+{
+	struct zebra_dplane_ctx *ctx;
+	struct kernel_shard *shard;
+	unsigned int i;
+
+	while ((ctx = dplane_ctx_list_pop(run)) != NULL) {
+		shard = &kshards.shards[kernel_shard_of(ctx)];
+		dplane_ctx_list_add_tail(&shard->work, ctx);
+	}
+
+	frr_with_mutex (&kshards.mtx) {
+		for (i = 1; i < kshards.count; i++) {
+			if (!dplane_ctx_list_count(&kshards.shards[i].work))
+				continue;
+			kshards.shards[i].busy = true;
+			kshards.pending++;
+		}
+		if (kshards.pending)
+			pthread_cond_broadcast(&kshards.wake);
+	}
+
+	kernel_update_multi_shard(&kshards.shards[0].work, 0);
+
+	frr_with_mutex (&kshards.mtx) {
+		while (kshards.pending)
+			pthread_cond_wait(&kshards.done, &kshards.mtx);
+	}
+
+	for (i = 0; i < kshards.count; i++)
+		dplane_ctx_list_append(run, &kshards.shards[i].work);
+}
+
+/* kernel_update_multi(), over the shards where it pays off */
+static void kernel_dplane_update(struct dplane_ctx_list_head *work_list)
+{
+	struct dplane_ctx_list_head run, done;
+	struct zebra_dplane_ctx *ctx;
+	bool routes;
+
+	if (kshards.count <= 1) {
+		kernel_update_multi(work_list);
+		return;
+	}
+
+	dplane_ctx_list_init(&run);
+	dplane_ctx_list_init(&done);
+
+	while ((ctx = dplane_ctx_list_first(work_list)) != NULL) {
+		/* The run of route updates, or of anything else, up front */
+		routes = kernel_shard_op(ctx);
+		do {
+			dplane_ctx_list_pop(work_list);
+			dplane_ctx_list_add_tail(&run, ctx);
+			ctx = dplane_ctx_list_first(work_list);
+		} while (ctx && kernel_shard_op(ctx) == routes);
+
+		if (routes &&
+		    dplane_ctx_list_count(&run) >= KERNEL_DPLANE_SHARD_MIN_RUN)
+			kernel_update_sharded(&run);
+		else
+			kernel_update_multi(&run);
+
+		dplane_ctx_list_append(&done, &run);
+	}
+
+	dplane_ctx_list_append(work_list, &done);
+}
+
+static void *kernel_shard_run(void *arg)
+{
+	struct frr_pthread *fpt = arg;
+	struct kernel_shard *shard = fpt->data;
+
+	fpt->master->owner = pthread_self();
+
+	/* Not in an event loop, see bgp_keepalives_start() */
+	rcu_read_unlock();
+	frr_pthread_set_name(fpt);
+	frr_pthread_notify_running(fpt);
+
+	pthread_mutex_lock(&kshards.mtx);
+	while (atomic_load_explicit(&fpt->running, memory_order_relaxed)) {
+		if (!shard->busy) {
+			pthread_cond_wait(&kshards.wake, &kshards.mtx);
+			continue;
+		}
+		pthread_mutex_unlock(&kshards.mtx);
+
+		kernel_update_multi_shard(&shard->work, shard->index);
+
+		pthread_mutex_lock(&kshards.mtx);
+		shard->busy = false;
+		if (--kshards.pending == 0)
+			pthread_cond_signal(&kshards.done);
+	}
+	pthread_mutex_unlock(&kshards.mtx);
+
+	return NULL;
+}
+
+static int kernel_shard_stop(struct frr_pthread *fpt, void **result)
+{
+	frr_with_mutex (&kshards.mtx) {
+		atomic_store_explicit(&fpt->running, false,
+				      memory_order_relaxed);
+		pthread_cond_broadcast(&kshards.wake);
+	}
+
+	pthread_join(fpt->thread, result);
+	return 0;
+}
+
+static int kernel_dplane_start(struct zebra_dplane_provider *prov)
+{
+	struct frr_pthread_attr attr = {
+		.start = kernel_shard_run,
+		.stop = kernel_shard_stop,
+	};
+	struct kernel_shard *shard;
+	char name[64], os_name[16];
+	unsigned int i;
+
+	pthread_mutex_init(&kshards.mtx, NULL);
+	pthread_cond_init(&kshards.wake, NULL);
+	pthread_cond_init(&kshards.done, NULL);
+
+	kshards.count = MAX(zrouter.dplane_shards, 1U);
+	for (i = 0; i < kshards.count; i++) {
+		shard = &kshards.shards[i];
+		shard->index = i;
+		dplane_ctx_list_init(&shard->work);
+		if (!i)
+			continue;
+
+		snprintf(name, sizeof(name), "Zebra dplane shard %u", i);
+		snprintf(os_name, sizeof(os_name), "zebra_dplane%u", i);
+		shard->fpt = frr_pthread_new(&attr, name, os_name);
+		shard->fpt->data = shard;
+		frr_pthread_run(shard->fpt, NULL);
+		frr_pthread_wait_running(shard->fpt);
+	}
+
+	if (kshards.count > 1)
+		zlog_info("Kernel dplane provider on %u shards", kshards.count);
+
+	return 0;
+}
+
+static int kernel_dplane_fini(struct zebra_dplane_provider *prov, bool early)
+{
+	unsigned int i;
+
+	/* The dplane pthread, the only one to hand the shards work, is gone */
+	if (early)
+		return 0;
+
+	for (i = 1; i < kshards.count; i++) {
+		frr_pthread_stop(kshards.shards[i].fpt, NULL);
+		frr_pthread_destroy(kshards.shards[i].fpt);
+		kshards.shards[i].fpt = NULL;
+	}
+	kshards.count = 1;
+
+	return 0;
+}
+
 /*
  * Kernel provider callback
  */
@@ -6805,14 +7084,23 @@ static int kernel_dplane_process_func(struct zebra_dplane_provider *prov)
 	struct zebra_dplane_ctx *ctx;
 	struct dplane_ctx_list_head work_list;
 	int counter, limit;
+	uint32_t queued;
 
 	dplane_ctx_list_init(&work_list);
 
 	limit = dplane_provider_get_work_limit(prov);
 
+	/*
+	 * Each pass costs a sendmsg() per netlink batch, however full; with
+	 * a backlog, take more of it per pass so the batches fill up.
+	 */
+	queued = dplane_provider_in_ctx_queue_len(prov);
+	if (queued > (uint32_t)limit)
+		limit = MIN(queued, (uint32_t)limit * KERNEL_DPLANE_BACKLOG_SCALE);
+
 	if (IS_ZEBRA_DEBUG_DPLANE_DETAIL)
-		zlog_debug("dplane provider '%s': processing",
-			   dplane_provider_get_name(prov));
+		zlog_debug("dplane provider '%s': processing %d of %u",
+			   dplane_provider_get_name(prov), limit, queued);
 
 	for (counter = 0; counter < limit; counter++) {
 		ctx = dplane_provider_dequeue_in_ctx(prov);
@@ -6835,7 +7123,7 @@ static int kernel_dplane_process_func(struct zebra_dplane_provider *prov)
 			dplane_ctx_list_add_tail(&work_list, ctx);
 	}
 
-	kernel_update_multi(&work_list);
+	kernel_dplane_update(&work_list);
 
 	while ((ctx = dplane_ctx_list_pop(&work_list)) != NULL) {
 		kernel_dplane_handle_result(ctx);
@@ -6934,9 +7222,10 @@ static void dplane_provider_init(void)
 
 	ret = dplane_provider_register("Kernel",
 				       DPLANE_PRIO_KERNEL,
-				       DPLANE_PROV_FLAGS_DEFAULT, NULL,
+				       DPLANE_PROV_FLAGS_DEFAULT,
+				       kernel_dplane_start,
 				       kernel_dplane_process_func,
-				       NULL,
+				       kernel_dplane_fini,
 				       NULL, NULL);
 
 	if (ret != AOK)
@@ -502,6 +502,7 @@ uint32_t dplane_ctx_get_old_metric(const struct zebra_dplane_ctx *ctx);
 uint32_t dplane_ctx_get_mtu(const struct zebra_dplane_ctx *ctx);
 uint32_t dplane_ctx_get_nh_mtu(const struct zebra_dplane_ctx *ctx);
 uint8_t dplane_ctx_get_distance(const struct zebra_dplane_ctx *ctx);
+uint64_t dplane_ctx_get_rib_version(const struct zebra_dplane_ctx *ctx);
 void dplane_ctx_set_distance(struct zebra_dplane_ctx *ctx, uint8_t distance);
 uint8_t dplane_ctx_get_old_distance(const struct zebra_dplane_ctx *ctx);
 
@@ -1032,6 +1033,10 @@ int dplane_ctx_route_init_basic(struct zebra_dplane_ctx *ctx,
 				const struct prefix_ipv6 *src_p, afi_t afi,
 				safi_t safi);
 
+/* Encode the removal of whatever was installed for a route node. */
+int dplane_ctx_route_init_removal(struct zebra_dplane_ctx *ctx,
+				  struct route_node *rn);
+
 /* Encode next hop information into data plane context. */
 int dplane_ctx_nexthop_init(struct zebra_dplane_ctx *ctx, enum dplane_op_e op,
 			    struct nhg_hash_entry *nhe);
@@ -1157,6 +1162,9 @@ int dplane_provider_dequeue_in_list(struct zebra_dplane_provider *prov,
 /* Current completed work queue length */
 uint32_t dplane_provider_out_ctx_queue_len(struct zebra_dplane_provider *prov);
 
+/* Contexts waiting on the provider's inbound queue */
+uint32_t dplane_provider_in_ctx_queue_len(struct zebra_dplane_provider *prov);
+
 /* Enqueue completed work, maintain associated counter and locking */
 void dplane_provider_enqueue_out_ctx(struct zebra_dplane_provider *prov,
 				     struct zebra_dplane_ctx *ctx);
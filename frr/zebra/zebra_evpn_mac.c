@@ -44,6 +44,7 @@ uint32_t num_valid_macs(struct zebra_evpn *zevpn)
 	hash = zevpn->mac_table;
 	if (!hash)
 		return num_macs;
+	hash_rehash_complete(hash);
 	for (i = 0; i < hash->size; i++) {
 		for (hb = hash->index[i]; hb; hb = hb->next) {
 			mac = (struct zebra_mac *)hb->data;
@@ -68,6 +69,7 @@ uint32_t num_dup_detected_macs(struct zebra_evpn *zevpn)
 	hash = zevpn->mac_table;
 	if (!hash)
 		return num_macs;
+	hash_rehash_complete(hash);
 	for (i = 0; i < hash->size; i++) {
 		for (hb = hash->index[i]; hb; hb = hb->next) {
 			mac = (struct zebra_mac *)hb->data;
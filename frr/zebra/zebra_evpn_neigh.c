@@ -85,6 +85,7 @@ uint32_t num_dup_detected_neighs(struct zebra_evpn *zevpn)
 	hash = zevpn->neigh_table;
 	if (!hash)
 		return num_neighs;
+	hash_rehash_complete(hash);
 	for (i = 0; i < hash->size; i++) {
 		for (hb = hash->index[i]; hb; hb = hb->next) {
 			nbr = (struct zebra_neigh *)hb->data;
@@ -0,0 +1,498 @@
+#ifndef _ZEBRA_FIB_SHM_H
+#define _ZEBRA_FIB_SHM_H
+
+
+#include <stdint.h>
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Read-only export of zebra's selected routes, for processes on the same
+ * host that look routes up often enough that a vtysh or FPM session is in
+ * the way.  zebra loaded with -M dplane_fib_shm creates the segment and is
+ * its only writer; consumers shm_open() it O_RDONLY, map it PROT_READ and
+ * never write to it.  This header is self-contained, so that programs
+ * outside FRR, C or C++, can include it as is.
+ */
+#define FIB_SHM_NAME "/zebra_fib"
+
+/*
+ * The segment has two tables, each a power-of-two array of fixed-size
+ * entries with an open-addressing index twice its size in front of it.
+ * routes[] holds one entry per (table id, prefix) zebra selected for the
+ * FIB, nhgs[] one entry per nexthop group those routes use.  A route
+ * refers to its group by slot; groups are shared by every route using the
+ * same zebra nexthop group.
+ */
+#define FIB_SHM_MIN_CAPACITY 1024
+#define FIB_SHM_MAX_ROUTES (1U << 23)
+#define FIB_SHM_MAX_NHGS (1U << 20)
+#define FIB_SHM_CACHELINE 64
+
+/* Nexthops kept per group; a wider group is cut short and flagged */
+#define FIB_SHM_NEXTHOPS 16
+
+#ifdef __cplusplus
+#define FIB_SHM_STATIC_ASSERT(cond, msg) static_assert(cond, msg)
+#else
+#define FIB_SHM_STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)
+#endif
+
+/*
+ * Every segment starts with this header.  zebra fills it in last and
+ * publishes magic with a release store, so a consumer that sees the magic
+ * also sees a filled segment.  Consumers check magic, version and the
+ * record sizes, then locate everything through the offsets.  All fields
+ * are native-endian fixed-width types and, apart from flags, never change
+ * after publication.
+ *
+ * The segment never grows in place.  When a table fills up, or too many
+ * of its index buckets are tombstones, zebra builds a new segment under
+ * the same name, and then sets FIB_SHM_F_SUPERSEDED in the old one.
+ * Consumers check the flag now and then, and re-open by name when they see
+ * it; the old mapping stays readable, and correct as of the rebuild, until
+ * they unmap it.  zebra sets the flag on the way out as well.
+ */
+#define FIB_SHM_MAGIC 0x42494654U /* "TFIB" in little-endian memory */
+#define FIB_SHM_VERSION 1
+
+#define FIB_SHM_F_SUPERSEDED 0x1
+
+struct fib_shm_hdr {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t hdr_size;        /* sizeof(struct fib_shm_hdr) */
+    uint32_t route_size;      /* sizeof(struct fib_shm_route) */
+    uint32_t nhg_size;        /* sizeof(struct fib_shm_nhg) */
+    uint32_t route_capacity;  /* entries in routes[] */
+    uint32_t nhg_capacity;    /* entries in nhgs[] */
+    uint32_t off_routes;
+    uint32_t off_route_index;
+    uint32_t off_nhgs;
+    uint32_t off_nhg_index;
+    uint32_t total_size;      /* bytes the segment must be mapped with */
+    uint32_t flags;           /* FIB_SHM_F_* */
+    uint32_t reserved[4];
+};
+
+/*
+ * One nexthop, as the kernel got it: recursive nexthops are exported
+ * resolved, and inactive ones are left out.  gate is an IPv4 address in
+ * its first 4 bytes, the rest zero, when family is AF_INET; all zero for
+ * a connected or blackhole nexthop.  type is zebra's enum nexthop_types_t
+ * (1 ifindex, 2 ipv4, 3 ipv4 + ifindex, 4 ipv6, 5 ipv6 + ifindex,
+ * 6 blackhole).  label is the outermost MPLS label, 0 for none.
+ */
+#define FIB_SHM_NH_ONLINK 0x1
+
+struct fib_shm_nexthop {
+    struct in6_addr gate;
+    uint32_t ifindex;
+    uint32_t vrf_id;
+    uint32_t label;
+    uint8_t type;
+    uint8_t family;
+    uint8_t weight;
+    uint8_t flags;            /* FIB_SHM_NH_* */
+};
+
+/*
+ * A nexthop group.  id is zebra's nexthop group id ("show nexthop-group
+ * rib"), the key of the table.  nexthop_num nexthops[] are valid;
+ * nexthop_total is how many the group had before FIB_SHM_NEXTHOPS cut it
+ * short.
+ */
+struct fib_shm_nhg {
+    uint32_t seq;
+    uint32_t id;
+    uint16_t nexthop_num;
+    uint16_t nexthop_total;
+    uint32_t reserved[13];
+    struct fib_shm_nexthop nexthops[FIB_SHM_NEXTHOPS];
+};
+
+/*
+ * A selected route, keyed by kernel table id, family, prefix length and
+ * prefix.  table_id is what "ip route show table" takes: 254 for the main
+ * table, a VRF's own table otherwise.  prefix is stored and looked up
+ * with the host bits clear, an IPv4 prefix in the first 4 bytes.  A free
+ * slot has family 0.
+ *
+ * nhg_slot is the nhgs[] index plus one, 0 if the route has no nexthop.
+ * A consumer reading the group checks that its id is nhg_id: a group slot
+ * can be reassigned to another group while the consumer follows it.
+ * type and distance are zebra's (ZEBRA_ROUTE_*, admin distance).
+ * rib_version grows every time zebra changes the route.
+ */
+struct fib_shm_route {
+    uint32_t seq;
+    uint32_t table_id;
+    uint8_t family;
+    uint8_t prefixlen;
+    uint8_t type;
+    uint8_t distance;
+    uint32_t metric;
+    struct in6_addr prefix;
+    uint32_t nhg_slot;
+    uint32_t nhg_id;
+    uint32_t vrf_id;
+    uint32_t reserved;
+    uint64_t rib_version;
+    uint64_t reserved2;
+};
+
+/*
+ * slot is the entry's index plus one; 0 marks a never used bucket, which
+ * ends a probe sequence, and FIB_SHM_SLOT_TOMBSTONE a removed one, which
+ * does not.  tag is fib_shm_route_tag() or fib_shm_nhg_tag() of the key.
+ */
+#define FIB_SHM_SLOT_TOMBSTONE UINT32_MAX
+
+struct fib_shm_bucket {
+    uint32_t tag;
+    uint32_t slot;
+};
+
+/*
+ * Fixed head of the segment, followed at cache-line aligned offsets by
+ * routes[route_capacity], the route index[2 * route_capacity],
+ * nhgs[nhg_capacity] and the group index[2 * nhg_capacity].
+ *
+ * Ownership is simple: zebra writes, everyone else reads.  Each entry is
+ * published under its own seq counter, odd while zebra changes it, and
+ * entries never move within a segment.  gen is bumped once after every
+ * batch of changes, so a consumer caching lookups can tell when to drop
+ * its cache.  plen_count[0] counts IPv4 routes per prefix length,
+ * plen_count[1] IPv6 ones, over every table; longest-match lookups skip
+ * the lengths no route has.
+ */
+struct fib_shm {
+    struct fib_shm_hdr hdr;
+    uint32_t gen;
+    uint32_t route_count;
+    uint32_t nhg_count;
+    uint32_t pad;
+    uint32_t plen_count[2][129];
+};
+
+
+/* The layout is part of the ABI, pin it down */
+FIB_SHM_STATIC_ASSERT(sizeof(struct fib_shm_hdr) == 64,
+                      "fib_shm_hdr must be 64 bytes");
+FIB_SHM_STATIC_ASSERT(sizeof(struct fib_shm_nexthop) == 32,
+                      "fib_shm_nexthop must be 32 bytes");
+FIB_SHM_STATIC_ASSERT(sizeof(struct fib_shm_nhg) ==
+                          FIB_SHM_CACHELINE +
+                              FIB_SHM_NEXTHOPS * sizeof(struct fib_shm_nexthop),
+                      "fib_shm_nhg must be a header line and its nexthops");
+FIB_SHM_STATIC_ASSERT(sizeof(struct fib_shm_route) == FIB_SHM_CACHELINE,
+                      "fib_shm_route must be one cache line");
+FIB_SHM_STATIC_ASSERT(offsetof(struct fib_shm_route, table_id) == 4 &&
+                      offsetof(struct fib_shm_route, family) == 8 &&
+                      offsetof(struct fib_shm_route, prefixlen) == 9 &&
+                      offsetof(struct fib_shm_route, metric) == 12 &&
+                      offsetof(struct fib_shm_route, prefix) == 16 &&
+                      offsetof(struct fib_shm_route, nhg_slot) == 32 &&
+                      offsetof(struct fib_shm_route, nhg_id) == 36 &&
+                      offsetof(struct fib_shm_route, vrf_id) == 40 &&
+                      offsetof(struct fib_shm_route, rib_version) == 48,
+                      "fib_shm_route field offsets changed");
+FIB_SHM_STATIC_ASSERT(sizeof(struct fib_shm_bucket) == 8,
+                      "fib_shm_bucket must be 8 bytes");
+
+/* Smallest valid capacity holding at least n entries, 0 if over max */
+static inline uint32_t fib_shm_capacity_for(uint32_t n, uint32_t max)
+{
+    uint32_t cap = FIB_SHM_MIN_CAPACITY;
+
+    while (cap < n && cap < max)
+        cap <<= 1;
+    return cap >= n ? cap : 0;
+}
+
+static inline uint32_t fib_shm_align_up(uint32_t off)
+{
+    return (off + FIB_SHM_CACHELINE - 1) & ~(uint32_t)(FIB_SHM_CACHELINE - 1);
+}
+
+/*
+ * Work out the layout of a segment with the given capacities into
+ * everything but hdr->magic and hdr->flags.  Used both to build a header
+ * and, on the reading side, to check one.
+ */
+static inline void fib_shm_layout(struct fib_shm_hdr *hdr,
+                                  uint32_t route_capacity,
+                                  uint32_t nhg_capacity)
+{
+    uint32_t off;
+
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->version = FIB_SHM_VERSION;
+    hdr->hdr_size = sizeof(struct fib_shm_hdr);
+    hdr->route_size = sizeof(struct fib_shm_route);
+    hdr->nhg_size = sizeof(struct fib_shm_nhg);
+    hdr->route_capacity = route_capacity;
+    hdr->nhg_capacity = nhg_capacity;
+
+    off = fib_shm_align_up(sizeof(struct fib_shm));
+    hdr->off_routes = off;
+    off = fib_shm_align_up(off + route_capacity * sizeof(struct fib_shm_route));
+    hdr->off_route_index = off;
+    off = fib_shm_align_up(off + route_capacity * 2 *
+                                     sizeof(struct fib_shm_bucket));
+    hdr->off_nhgs = off;
+    off = fib_shm_align_up(off + nhg_capacity * sizeof(struct fib_shm_nhg));
+    hdr->off_nhg_index = off;
+    hdr->total_size = off + nhg_capacity * 2 * sizeof(struct fib_shm_bucket);
+}
+
+/*
+ * Check that a mapped segment of map_size bytes has a layout this build
+ * can use.  Returns NULL if so, otherwise a short reason.
+ */
+static inline const char *fib_shm_hdr_check(const struct fib_shm *shm,
+                                            size_t map_size)
+{
+    const struct fib_shm_hdr *hdr = &shm->hdr;
+    struct fib_shm_hdr want;
+
+    if (map_size < sizeof(struct fib_shm))
+        return "segment too small";
+    if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != FIB_SHM_MAGIC)
+        return "bad magic (not initialized or foreign endianness)";
+    if (hdr->version != FIB_SHM_VERSION)
+        return "unsupported version";
+    if (hdr->hdr_size != sizeof(struct fib_shm_hdr) ||
+        hdr->route_size != sizeof(struct fib_shm_route) ||
+        hdr->nhg_size != sizeof(struct fib_shm_nhg))
+        return "record size mismatch";
+    if (fib_shm_capacity_for(hdr->route_capacity, FIB_SHM_MAX_ROUTES) !=
+            hdr->route_capacity ||
+        fib_shm_capacity_for(hdr->nhg_capacity, FIB_SHM_MAX_NHGS) !=
+            hdr->nhg_capacity)
+        return "invalid capacity";
+
+    fib_shm_layout(&want, hdr->route_capacity, hdr->nhg_capacity);
+    if (hdr->off_routes != want.off_routes ||
+        hdr->off_route_index != want.off_route_index ||
+        hdr->off_nhgs != want.off_nhgs ||
+        hdr->off_nhg_index != want.off_nhg_index)
+        return "field offset mismatch";
+    if (hdr->total_size != want.total_size || map_size < hdr->total_size)
+        return "segment size mismatch";
+    return NULL;
+}
+
+static inline int fib_shm_superseded(const struct fib_shm *shm)
+{
+    return __atomic_load_n(&shm->hdr.flags, __ATOMIC_ACQUIRE) &
+           FIB_SHM_F_SUPERSEDED;
+}
+
+static inline const struct fib_shm_route *
+fib_shm_routes(const struct fib_shm *shm)
+{
+    return (const struct fib_shm_route *)((const char *)shm +
+                                          shm->hdr.off_routes);
+}
+
+static inline const struct fib_shm_bucket *
+fib_shm_route_index(const struct fib_shm *shm)
+{
+    return (const struct fib_shm_bucket *)((const char *)shm +
+                                           shm->hdr.off_route_index);
+}
+
+static inline const struct fib_shm_nhg *fib_shm_nhgs(const struct fib_shm *shm)
+{
+    return (const struct fib_shm_nhg *)((const char *)shm +
+                                        shm->hdr.off_nhgs);
+}
+
+static inline const struct fib_shm_bucket *
+fib_shm_nhg_index(const struct fib_shm *shm)
+{
+    return (const struct fib_shm_bucket *)((const char *)shm +
+                                           shm->hdr.off_nhg_index);
+}
+
+/* Fold a route key into the tag kept in its index bucket */
+static inline uint32_t fib_shm_route_tag(uint32_t table_id, uint8_t family,
+                                         uint8_t prefixlen,
+                                         const struct in6_addr *prefix)
+{
+    uint32_t w[4], h;
+
+    memcpy(w, prefix, sizeof(w));
+    h = (table_id * 2654435761U) ^ ((uint32_t)family << 8 | prefixlen);
+    h = (h * 2654435761U) ^ w[0];
+    h = (h * 2654435761U) ^ w[1];
+    h = (h * 2654435761U) ^ w[2];
+    return (h * 2654435761U) ^ w[3];
+}
+
+static inline uint32_t fib_shm_nhg_tag(uint32_t id)
+{
+    return id * 2654435761U ^ 0x9e3779b9U;
+}
+
+/* Fibonacci hash of a tag to one of hash_size buckets */
+static inline uint32_t fib_shm_hash_tag(uint32_t tag, uint32_t hash_size)
+{
+    return (tag * 2654435761U) >> (32 - __builtin_ctz(hash_size));
+}
+
+/*
+ * Clear the host bits of an address of the family past prefixlen, the
+ * form prefixes are stored and looked up in.
+ */
+static inline void fib_shm_apply_mask(struct in6_addr *addr, uint8_t family,
+                                      uint8_t prefixlen)
+{
+    unsigned int bits = family == AF_INET ? 32 : 128;
+    unsigned int n;
+
+    if (family == AF_INET)
+        memset(&addr->s6_addr[4], 0, 12);
+    for (n = prefixlen; n < bits; n++)
+        addr->s6_addr[n / 8] &= (uint8_t)~(0x80 >> (n % 8));
+}
+
+/*
+ * Sequence counters, the same scheme as bgpd's TWAMP segment.  Readers
+ * give up on an entry after FIB_SHM_SEQ_RETRIES busy attempts.
+ */
+#define FIB_SHM_SEQ_RETRIES 64
+
+static inline uint32_t fib_shm_seq_read_begin(const uint32_t *seq)
+{
+    return __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+}
+
+static inline int fib_shm_seq_read_retry(const uint32_t *seq, uint32_t start)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (start & 1) || __atomic_load_n(seq, __ATOMIC_RELAXED) != start;
+}
+
+/*
+ * Copy an entry out word by word under its seq counter.  Returns 0 with a
+ * consistent copy, -1 if zebra kept the entry busy throughout.
+ */
+static inline int fib_shm_read_entry(const void *ent, void *out, size_t size)
+{
+    const uint32_t *from = (const uint32_t *)ent;
+    uint32_t *to = (uint32_t *)out;
+    uint32_t start;
+    size_t w;
+    int n;
+
+    for (n = 0; n < FIB_SHM_SEQ_RETRIES; n++) {
+        start = fib_shm_seq_read_begin(&from[0]);
+        for (w = 0; w < size / 4; w++)
+            to[w] = __atomic_load_n(&from[w], __ATOMIC_RELAXED);
+        if (!fib_shm_seq_read_retry(&from[0], start))
+            return 0;
+    }
+    return -1;
+}
+
+/*
+ * Copy the route for exactly (table_id, family, prefixlen, prefix) into
+ * out.  Returns its routes[] slot, or -1 if there is no such route.  The
+ * prefix is masked here, so any address inside it will do.
+ */
+static inline int fib_shm_route_find(const struct fib_shm *shm,
+                                     uint32_t table_id, uint8_t family,
+                                     uint8_t prefixlen,
+                                     const struct in6_addr *prefix,
+                                     struct fib_shm_route *out)
+{
+    const struct fib_shm_bucket *index = fib_shm_route_index(shm);
+    const struct fib_shm_route *routes = fib_shm_routes(shm);
+    uint32_t hash_size = shm->hdr.route_capacity * 2;
+    uint32_t mask = hash_size - 1, tag, b, n, slot;
+    struct in6_addr key = *prefix;
+
+    fib_shm_apply_mask(&key, family, prefixlen);
+    tag = fib_shm_route_tag(table_id, family, prefixlen, &key);
+    b = fib_shm_hash_tag(tag, hash_size);
+    for (n = 0; n <= mask; n++, b = (b + 1) & mask) {
+        slot = __atomic_load_n(&index[b].slot, __ATOMIC_ACQUIRE);
+        if (slot == 0)
+            return -1;
+        if (slot == FIB_SHM_SLOT_TOMBSTONE ||
+            __atomic_load_n(&index[b].tag, __ATOMIC_RELAXED) != tag ||
+            slot > shm->hdr.route_capacity)
+            continue;
+        if (fib_shm_read_entry(&routes[slot - 1], out, sizeof(*out)) < 0)
+            continue;
+        if (out->table_id == table_id && out->family == family &&
+            out->prefixlen == prefixlen &&
+            memcmp(&out->prefix, &key, sizeof(key)) == 0)
+            return (int)slot - 1;
+    }
+    return -1;
+}
+
+/*
+ * Longest-prefix match of addr in table_id: copies the most specific
+ * route covering it into out and returns its slot, or -1.
+ */
+static inline int fib_shm_lookup(const struct fib_shm *shm, uint32_t table_id,
+                                 uint8_t family, const struct in6_addr *addr,
+                                 struct fib_shm_route *out)
+{
+    const uint32_t *counts = shm->plen_count[family == AF_INET ? 0 : 1];
+    int plen = family == AF_INET ? 32 : 128;
+    int slot;
+
+    for (; plen >= 0; plen--) {
+        if (!__atomic_load_n(&counts[plen], __ATOMIC_RELAXED))
+            continue;
+        slot = fib_shm_route_find(shm, table_id, family, (uint8_t)plen, addr,
+                                  out);
+        if (slot >= 0)
+            return slot;
+    }
+    return -1;
+}
+
+/*
+ * Copy the nexthop group of route into out.  Returns 0, or -1 if the route
+ * has none or the group changed under the caller; looking the route up
+ * again then gives its current group.
+ */
+static inline int fib_shm_route_nhg(const struct fib_shm *shm,
+                                    const struct fib_shm_route *route,
+                                    struct fib_shm_nhg *out)
+{
+    if (route->nhg_slot == 0 || route->nhg_slot > shm->hdr.nhg_capacity)
+        return -1;
+    if (fib_shm_read_entry(&fib_shm_nhgs(shm)[route->nhg_slot - 1], out,
+                           sizeof(*out)) < 0)
+        return -1;
+    return out->id == route->nhg_id ? 0 : -1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
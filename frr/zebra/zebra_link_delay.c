@@ -0,0 +1,329 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Zebra link-params delays from TWAMP measurements.
+ *
+ * bgpd owns the TWAMP shared segment and has the agents probe the far end
+ * of every point-to-point link whose link-params say "delay measured".
+ * zebra maps the segment read-only, takes half the round trip as the
+ * unidirectional delay and half the jitter as its variation, and hands
+ * them to the IGPs like configured link-params. A new value is only
+ * advertised when it moved by more than the threshold and the previous
+ * one is at least hold-time old, so that a noisy link does not turn into
+ * a stream of LSPs and LSAs.
+ */
+#include <zebra.h>
+
+#include "if.h"
+#include "command.h"
+#include "memory.h"
+#include "frrevent.h"
+#include "vrf.h"
+
+/* Shared with bgpd and the agents, see there for the layout */
+#include "bgpd/bgp_twamp_ipc.h"
+
+#include "zebra/zebra_router.h"
+#include "zebra/interface.h"
+#include "zebra/redistribute.h"
+#include "zebra/debug.h"
+#include "zebra/zebra_link_delay.h"
+
+DEFINE_MTYPE_STATIC(ZEBRA, LINK_DELAY, "Zebra measured link delay");
+
+/* How often the measurements are looked at */
+#define ZEBRA_LINK_DELAY_POLL_SEC 1
+/* A measurement older than this is no measurement */
+#define ZEBRA_LINK_DELAY_STALE_SEC 60
+/* Changes below this many micro-seconds are noise whatever the threshold */
+#define ZEBRA_LINK_DELAY_MIN_CHANGE 10
+
+static struct twamp_shm_reader reader;
+
+static unsigned int zebra_link_delay_count;
+static struct event *zebra_link_delay_ev;
+
+/* Map whatever bgpd currently publishes, once per pass */
+static bool zebra_link_delay_attach(void)
+{
+	const char *why;
+
+	if (twamp_shm_reader_attach(&reader, &why))
+		return true;
+	if (why && IS_ZEBRA_DEBUG_EVENT)
+		zlog_debug("Link delay: ignoring %s: %s", TWAMP_SHM_NAME, why);
+	return false;
+}
+
+/*
+ * One-way delay and delay variation to the far end of ifp, false if it
+ * has no fresh measurement.
+ */
+static bool zebra_link_delay_read(const struct interface *ifp,
+				  uint32_t *delay, uint32_t *var)
+{
+	struct in6_addr key;
+	struct in_addr peer;
+	uint32_t latency, jitter;
+	uint16_t loss;
+
+	if (!connected_get_link_peer(ifp, &peer))
+		return false;
+	twamp_addr_from_ipv4(&key, peer.s_addr);
+
+	if (twamp_shm_reader_lookup(&reader, &key, 0,
+				    ZEBRA_LINK_DELAY_STALE_SEC, &latency,
+				    &jitter, &loss))
+		return false;
+	if (latency == UINT32_MAX || loss >= 1000)
+		return false;
+
+	*delay = MIN(latency / 2, (uint32_t)TE_EXT_MASK);
+	*var = MIN(jitter / 2, (uint32_t)TE_EXT_MASK);
+	return true;
+}
+
+static void zebra_link_delay_unset(struct if_link_params *iflp)
+{
+	iflp->av_delay = 0;
+	iflp->min_delay = 0;
+	iflp->max_delay = 0;
+	iflp->delay_var = 0;
+	UNSET_PARAM(iflp, LP_DELAY);
+	UNSET_PARAM(iflp, LP_MM_DELAY);
+	UNSET_PARAM(iflp, LP_DELAY_VAR);
+}
+
+/* Min and max are the average give or take the variation */
+static void zebra_link_delay_set(struct if_link_params *iflp, uint32_t delay,
+				 uint32_t var)
+{
+	iflp->av_delay = delay;
+	iflp->min_delay = delay > var ? delay - var : 0;
+	iflp->max_delay = MIN(delay + var, (uint32_t)TE_EXT_MASK);
+	iflp->delay_var = var;
+	SET_PARAM(iflp, LP_DELAY);
+	SET_PARAM(iflp, LP_MM_DELAY);
+	SET_PARAM(iflp, LP_DELAY_VAR);
+}
+
+/* Whether a measurement moved far enough from what is advertised */
+static bool zebra_link_delay_moved(const struct zebra_link_delay *zld,
+				   const struct if_link_params *iflp,
+				   uint32_t delay)
+{
+	uint32_t diff = delay > iflp->av_delay ? delay - iflp->av_delay
+					       : iflp->av_delay - delay;
+
+	if (diff < ZEBRA_LINK_DELAY_MIN_CHANGE)
+		return false;
+	return (uint64_t)diff * 100 >=
+	       (uint64_t)zld->threshold * iflp->av_delay;
+}
+
+static void zebra_link_delay_if_update(struct interface *ifp, bool attached,
+				       time_t now)
+{
+	struct zebra_if *zif = ifp->info;
+	struct zebra_link_delay *zld = zif->link_delay;
+	struct if_link_params *iflp = ifp->link_params;
+	uint32_t delay = 0, var = 0;
+	bool measured, update = false;
+
+	if (!iflp)
+		return;
+
+	/* bgpd goes by the flag to have the link probed */
+	if (!IS_PARAM_SET(iflp, LP_DELAY_MEASURED)) {
+		SET_PARAM(iflp, LP_DELAY_MEASURED);
+		update = true;
+	}
+
+	measured = attached && if_is_operative(ifp) &&
+		   zebra_link_delay_read(ifp, &delay, &var);
+
+	if (!measured) {
+		/* Withdrawn at once, stale delays steer traffic wrong */
+		if (zld->advertised) {
+			zebra_link_delay_unset(iflp);
+			zld->advertised = false;
+			zld->last_change = now;
+			update = true;
+		}
+	} else if (!zld->advertised ||
+		   (zebra_link_delay_moved(zld, iflp, delay) &&
+		    now - zld->last_change >= zld->hold_time)) {
+		zebra_link_delay_set(iflp, delay, var);
+		zld->advertised = true;
+		zld->last_change = now;
+		update = true;
+	}
+
+	if (!update)
+		return;
+
+	if (IS_ZEBRA_DEBUG_EVENT)
+		zlog_debug("Link delay: %s %s %u us (variation %u us)",
+			   ifp->name,
+			   zld->advertised ? "advertises" : "withdraws",
+			   iflp->av_delay, iflp->delay_var);
+
+	if (if_is_operative(ifp))
+		zebra_interface_parameters_update(ifp);
+}
+
+static void zebra_link_delay_poll(struct event *thread)
+{
+	struct vrf *vrf = vrf_lookup_by_id(VRF_DEFAULT);
+	struct interface *ifp;
+	struct zebra_if *zif;
+	time_t now = monotime(NULL);
+	bool attached;
+
+	if (!zebra_link_delay_count)
+		return;
+
+	attached = zebra_link_delay_attach();
+
+	/* bgpd only probes links of the default VRF */
+	if (vrf)
+		FOR_ALL_INTERFACES (vrf, ifp) {
+			zif = ifp->info;
+			if (zif && zif->link_delay)
+				zebra_link_delay_if_update(ifp, attached, now);
+		}
+
+	event_add_timer(zrouter.master, zebra_link_delay_poll, NULL,
+			ZEBRA_LINK_DELAY_POLL_SEC, &zebra_link_delay_ev);
+}
+
+void zebra_link_delay_disable(struct interface *ifp)
+{
+	struct zebra_if *zif = ifp->info;
+	struct if_link_params *iflp = ifp->link_params;
+
+	if (!zif || !zif->link_delay)
+		return;
+
+	if (iflp) {
+		if (zif->link_delay->advertised)
+			zebra_link_delay_unset(iflp);
+		UNSET_PARAM(iflp, LP_DELAY_MEASURED);
+	}
+	zebra_link_delay_if_fini(zif);
+}
+
+void zebra_link_delay_if_fini(struct zebra_if *zif)
+{
+	if (!zif->link_delay)
+		return;
+
+	XFREE(MTYPE_LINK_DELAY, zif->link_delay);
+	if (--zebra_link_delay_count)
+		return;
+
+	EVENT_OFF(zebra_link_delay_ev);
+	twamp_shm_reader_detach(&reader);
+}
+
+bool zebra_link_delay_config_write(struct vty *vty,
+				   const struct interface *ifp)
+{
+	const struct zebra_if *zif = ifp->info;
+	const struct zebra_link_delay *zld = zif ? zif->link_delay : NULL;
+
+	if (!zld)
+		return false;
+
+	vty_out(vty, "  delay measured");
+	if (zld->threshold != ZEBRA_LINK_DELAY_THRESHOLD_DEFAULT)
+		vty_out(vty, " threshold %u", zld->threshold);
+	if (zld->hold_time != ZEBRA_LINK_DELAY_HOLD_TIME_DEFAULT)
+		vty_out(vty, " hold-time %u", zld->hold_time);
+	vty_out(vty, "\n");
+	return true;
+}
+
+#include "zebra/zebra_link_delay_clippy.c"
+
+DEFPY (link_params_delay_measured,
+       link_params_delay_measured_cmd,
+       "delay measured [threshold (1-100)$threshold] [hold-time (1-3600)$hold_time]",
+       "Unidirectional Average Link Delay\n"
+       "Take the delays from TWAMP measurements of the link\n"
+       "Smallest change that is advertised\n"
+       "Percentage of the advertised delay\n"
+       "Shortest time between two advertised changes\n"
+       "Seconds\n")
+{
+	VTY_DECLVAR_CONTEXT(interface, ifp);
+	struct zebra_if *zif = ifp->info;
+	struct if_link_params *iflp = if_link_params_get(ifp);
+	struct zebra_link_delay *zld;
+	bool update = false;
+
+	if (!iflp)
+		iflp = if_link_params_enable(ifp);
+
+	zld = zif->link_delay;
+	if (!zld) {
+		/* Static delays make way for the measured ones */
+		if (IS_PARAM_SET(iflp, LP_DELAY) ||
+		    IS_PARAM_SET(iflp, LP_DELAY_VAR)) {
+			zebra_link_delay_unset(iflp);
+			update = true;
+		}
+		zld = XCALLOC(MTYPE_LINK_DELAY, sizeof(*zld));
+		zif->link_delay = zld;
+		if (!zebra_link_delay_count++)
+			event_add_timer(zrouter.master, zebra_link_delay_poll,
+					NULL, 0, &zebra_link_delay_ev);
+	}
+
+	zld->threshold = threshold_str ? threshold
+				       : ZEBRA_LINK_DELAY_THRESHOLD_DEFAULT;
+	zld->hold_time = hold_time_str ? hold_time
+				       : ZEBRA_LINK_DELAY_HOLD_TIME_DEFAULT;
+
+	if (update && if_is_operative(ifp))
+		zebra_interface_parameters_update(ifp);
+
+	return CMD_SUCCESS;
+}
+
+DEFPY (no_link_params_delay_measured,
+       no_link_params_delay_measured_cmd,
+       "no delay measured [threshold (1-100)] [hold-time (1-3600)]",
+       NO_STR
+       "Unidirectional Average Link Delay\n"
+       "Take the delays from TWAMP measurements of the link\n"
+       "Smallest change that is advertised\n"
+       "Percentage of the advertised delay\n"
+       "Shortest time between two advertised changes\n"
+       "Seconds\n")
+{
+	VTY_DECLVAR_CONTEXT(interface, ifp);
+	struct zebra_if *zif = ifp->info;
+
+	if (!zif->link_delay)
+		return CMD_SUCCESS;
+
+	zebra_link_delay_disable(ifp);
+
+	/* Also lets bgpd stop probing the link */
+	if (if_is_operative(ifp))
+		zebra_interface_parameters_update(ifp);
+
+	return CMD_SUCCESS;
+}
+
+void zebra_link_delay_init(void)
+{
+	install_element(LINK_PARAMS_NODE, &link_params_delay_measured_cmd);
+	install_element(LINK_PARAMS_NODE, &no_link_params_delay_measured_cmd);
+}
+
+void zebra_link_delay_finish(void)
+{
+	EVENT_OFF(zebra_link_delay_ev);
+	twamp_shm_reader_detach(&reader);
+}
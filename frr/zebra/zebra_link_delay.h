@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Zebra link-params delays from TWAMP measurements.
+ */
+#ifndef _ZEBRA_LINK_DELAY_H
+#define _ZEBRA_LINK_DELAY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Smallest relative change of the delay that is advertised, in percent */
+#define ZEBRA_LINK_DELAY_THRESHOLD_DEFAULT 10
+/* Shortest time between two advertised changes of the delay, in seconds */
+#define ZEBRA_LINK_DELAY_HOLD_TIME_DEFAULT 30
+
+/* link-params "delay measured" state, hung off the zebra_if */
+struct zebra_link_delay {
+	uint8_t threshold;
+	uint16_t hold_time;
+
+	/* The link-params carry a measurement, set at last_change */
+	bool advertised;
+	time_t last_change;
+};
+
+/*
+ * Stop taking the delays of ifp from the measurements, e.g. for a static
+ * "delay" command; whatever was advertised from them is removed.
+ */
+extern void zebra_link_delay_disable(struct interface *ifp);
+extern void zebra_link_delay_if_fini(struct zebra_if *zif);
+
+/* Write "delay measured", true if the link-params delays are measured */
+extern bool zebra_link_delay_config_write(struct vty *vty,
+					  const struct interface *ifp);
+
+extern void zebra_link_delay_init(void);
+extern void zebra_link_delay_finish(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ZEBRA_LINK_DELAY_H */
@@ -1706,6 +1706,8 @@ static struct list *hash_get_sorted_list(struct hash *hash, void *cmp)
 
 	sorted_list->cmp = (int (*)(void *, void *))cmp;
 
+	/* The index is walked by hand below */
+	hash_rehash_complete(hash);
 	for (i = 0; i < hash->size; i++)
 		for (hb = hash->index[i]; hb; hb = hb->next)
 			listnode_add_sort(sorted_list, hb->data);
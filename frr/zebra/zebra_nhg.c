@@ -30,7 +30,7 @@
 #include "zebra/rib.h"
 #include "zebra/zebra_vxlan.h"
 
-DEFINE_MTYPE_STATIC(ZEBRA, NHG, "Nexthop Group Entry");
+DEFINE_MTYPE(ZEBRA, NHG, "Nexthop Group Entry");
 DEFINE_MTYPE_STATIC(ZEBRA, NHG_CONNECTED, "Nexthop Group Connected");
 DEFINE_MTYPE_STATIC(ZEBRA, NHG_CTX, "Nexthop Group Context");
 
@@ -427,6 +427,24 @@ struct nhg_hash_entry *zebra_nhe_copy(const struct nhg_hash_entry *orig,
 	return nhe;
 }
 
+struct nhg_hash_entry *zebra_nhe_take(afi_t afi, struct nexthop_group *ng,
+				      struct nhg_backup_info **bnhg)
+{
+	struct nhg_hash_entry *nhe;
+
+	nhe = zebra_nhg_alloc();
+	zebra_nhe_init(nhe, afi, ng->nexthop);
+
+	nhe->nhg.nexthop = ng->nexthop;
+	ng->nexthop = NULL;
+	nhe->backup_info = *bnhg;
+	*bnhg = NULL;
+
+	nhe->dplane_ref = zebra_router_get_next_sequence();
+
+	return nhe;
+}
+
 /* Allocation via hash handler */
 static void *zebra_nhg_hash_alloc(void *arg)
 {
@@ -2176,6 +2194,7 @@ static int nexthop_active(struct nexthop *nexthop, struct nhg_hash_entry *nhe,
 	struct in_addr local_ipv4;
 	struct in_addr *ipv4;
 	afi_t afi = AFI_IP;
+	bool cached;
 
 	/* Reset some nexthop attributes that we'll recompute if necessary */
 	if ((nexthop->type == NEXTHOP_TYPE_IPV4)
@@ -2352,7 +2371,12 @@ static int nexthop_active(struct nexthop *nexthop, struct nhg_hash_entry *nhe,
 		return 0;
 	}
 
-	rn = route_node_match(table, (struct prefix *)&p);
+	rn = zebra_rnh_rcache_find(nexthop->vrf_id, &p, top);
+	cached = !!rn;
+	if (rn)
+		route_lock_node(rn);
+	else
+		rn = route_node_match(table, (struct prefix *)&p);
 	while (rn) {
 		route_unlock_node(rn);
 
@@ -2398,6 +2422,12 @@ static int nexthop_active(struct nexthop *nexthop, struct nhg_hash_entry *nhe,
 		 * tree.
 		 */
 		if (!match) {
+			/* It went since, look for what is below it */
+			if (cached) {
+				cached = false;
+				rn = route_node_match(table, (struct prefix *)&p);
+				continue;
+			}
 			do {
 				rn = rn->parent;
 			} while (rn && rn->info == NULL);
@@ -2406,6 +2436,9 @@ static int nexthop_active(struct nexthop *nexthop, struct nhg_hash_entry *nhe,
 			continue;
 		}
 
+		if (!cached)
+			zebra_rnh_rcache_add(nexthop->vrf_id, &p, rn);
+
 		/* If the candidate match's type is considered "connected",
 		 * we consider it first.
 		 */
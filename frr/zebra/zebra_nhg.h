@@ -10,6 +10,8 @@
 #include "lib/nexthop.h"
 #include "lib/nexthop_group.h"
 
+DECLARE_MTYPE(NHG);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -256,6 +258,13 @@ void zebra_nhe_init(struct nhg_hash_entry *nhe, afi_t afi,
 struct nhg_hash_entry *zebra_nhe_copy(const struct nhg_hash_entry *orig,
 				      uint32_t id);
 
+/*
+ * New/allocated nhe taking over the nexthops of 'ng' and the backup info
+ * in '*bnhg', both left empty, where a copy is not needed.
+ */
+struct nhg_hash_entry *zebra_nhe_take(afi_t afi, struct nexthop_group *ng,
+				      struct nhg_backup_info **bnhg);
+
 /* Allocate, free backup nexthop info objects */
 struct nhg_backup_info *zebra_nhg_backup_alloc(void);
 void zebra_nhg_backup_free(struct nhg_backup_info **p);
@@ -27,6 +27,18 @@ struct nlsock {
 
 	uint8_t *buf;
 	size_t buflen;
+
+	/* Listeners read by the main pthread: datagrams taken in batches */
+	struct nl_mmsg *mmsg;
+
+	/* Socket buffer sizes, as the kernel reports them; 0 if unknown */
+	uint32_t sndbuf, rcvbuf;
+
+	/*
+	 * On a dplane_out socket with kernel provider shards, the sockets of
+	 * shards 1 and up, zrouter.dplane_shards - 1 of them.
+	 */
+	struct nlsock *shards;
 };
 #endif
 
@@ -39,6 +51,7 @@ struct zebra_ns {
 
 #ifdef HAVE_NETLINK
 	struct nlsock netlink;        /* kernel messages */
+	struct nlsock netlink_neigh;  /* kernel neighbor messages */
 	struct nlsock netlink_cmd;    /* command channel */
 
 	/* dplane system's channels: one for outgoing programming,
@@ -47,6 +60,7 @@ struct zebra_ns {
 	struct nlsock netlink_dplane_out;
 	struct nlsock netlink_dplane_in;
 	struct event *t_netlink;
+	struct event *t_netlink_neigh;
 #endif
 
 	struct route_table *if_table;
@@ -48,8 +48,10 @@
 DEFINE_MGROUP(ZEBRA, "zebra");
 
 DEFINE_MTYPE(ZEBRA, RE,       "Route Entry");
+DEFINE_MTYPE_STATIC(ZEBRA, RE_FIB,   "Route Entry FIB nexthops");
 DEFINE_MTYPE_STATIC(ZEBRA, RIB_DEST,       "RIB destination");
 DEFINE_MTYPE_STATIC(ZEBRA, RIB_UPDATE_CTX, "Rib update context object");
+DEFINE_MTYPE_STATIC(ZEBRA, RIB_RESULT_SORT, "RIB dplane result sort");
 DEFINE_MTYPE_STATIC(ZEBRA, WQ_WRAPPER, "WQ wrapper");
 
 /*
@@ -63,6 +65,19 @@ DEFINE_HOOK(rib_update, (struct route_node * rn, const char *reason),
 	    (rn, reason));
 DEFINE_HOOK(rib_shutdown, (struct route_node * rn), (rn));
 
+/*
+ * Dests in the order of the last change to what they have installed, and
+ * the ones whose routes all went, for as long as there is room for them.
+ * Changes up to rib_version_floor are no longer all known.
+ */
+#define RIB_TOMBSTONES_MAX 16384
+
+static uint64_t rib_version_last;
+static uint64_t rib_version_floor;
+static struct rib_version_list_head rib_versions = INIT_DLIST(rib_versions);
+static struct rib_version_list_head rib_tombstones =
+	INIT_DLIST(rib_tombstones);
+
 
 /*
  * Meta Q's specific names
@@ -75,6 +90,7 @@ enum meta_queue_indexes {
 	META_QUEUE_EVPN,
 	META_QUEUE_EARLY_ROUTE,
 	META_QUEUE_EARLY_LABEL,
+	META_QUEUE_FAST,
 	META_QUEUE_CONNECTED,
 	META_QUEUE_KERNEL,
 	META_QUEUE_STATIC,
@@ -244,6 +260,8 @@ static const char *subqueue2str(enum meta_queue_indexes index)
 		return "Early Route Processing";
 	case META_QUEUE_EARLY_LABEL:
 		return "Early Label Handling";
+	case META_QUEUE_FAST:
+		return "Nexthop Changes";
 	case META_QUEUE_CONNECTED:
 		return "Connected Routes";
 	case META_QUEUE_KERNEL:
@@ -450,24 +468,40 @@ int rib_handle_nhg_replace(struct nhg_hash_entry *old_entry,
 	struct zebra_router_table *zrt;
 	struct route_node *rn;
 	struct route_entry *re, *next;
+	uint32_t users;
 	int ret = 0;
 
 	if (IS_ZEBRA_DEBUG_RIB_DETAILED || IS_ZEBRA_DEBUG_NHG_DETAIL)
 		zlog_debug("%s: replacing routes nhe (%u) OLD %p NEW %p",
 			   __func__, new_entry->id, new_entry, old_entry);
 
+	/*
+	 * Every route on the old entry holds a reference to it, beside the
+	 * owner's. Once they are all moved the rest of the tables need not
+	 * be walked, and the entry may be gone by then anyway.
+	 */
+	users = old_entry->refcnt > 1 ? old_entry->refcnt - 1 : 0;
+	if (!users)
+		return 0;
+
 	/* We have to do them ALL */
 	RB_FOREACH (zrt, zebra_router_table_head, &zrouter.tables) {
 		for (rn = route_top(zrt->table); rn;
 		     rn = srcdest_route_next(rn)) {
 			RNODE_FOREACH_RE_SAFE (rn, re, next) {
-				if (re->nhe && re->nhe == old_entry)
-					ret += route_entry_update_nhe(re,
-								      new_entry);
+				if (!re->nhe || re->nhe != old_entry)
+					continue;
+				ret += route_entry_update_nhe(re, new_entry);
+				if (!--users) {
+					route_unlock_node(rn);
+					goto done;
+				}
 			}
 		}
 	}
 
+done:
+
 	/*
 	 * if ret > 0, some previous re->nhe has freed the address to which
 	 * old_entry is pointing.
@@ -650,6 +684,156 @@ int zebra_rib_labeled_unicast(struct route_entry *re)
 	return 1;
 }
 
+struct nexthop_group rib_fib_nhg_none;
+
+static struct route_entry_fib *re_fib_get(struct route_entry *re)
+{
+	if (!re->fib)
+		re->fib = XCALLOC(MTYPE_RE_FIB, sizeof(*re->fib));
+	return re->fib;
+}
+
+/* Drop the FIB primary or backup nexthops, and the rest if that was all */
+static void re_fib_ng_free(struct route_entry *re, bool backup)
+{
+	struct nexthop_group *nhg;
+
+	if (!re->fib)
+		return;
+
+	nhg = backup ? &re->fib->backup_ng : &re->fib->ng;
+	nexthops_free(nhg->nexthop);
+	nhg->nexthop = NULL;
+
+	if (!re->fib->ng.nexthop && !re->fib->backup_ng.nexthop)
+		XFREE(MTYPE_RE_FIB, re->fib);
+}
+
+void route_entry_fib_copy(struct route_entry *to,
+			  const struct route_entry *from)
+{
+	if (!from->fib)
+		return;
+
+	if (from->fib->ng.nexthop)
+		nexthop_group_copy(&re_fib_get(to)->ng, &from->fib->ng);
+	if (from->fib->backup_ng.nexthop)
+		nexthop_group_copy(&re_fib_get(to)->backup_ng,
+				   &from->fib->backup_ng);
+}
+
+void route_entry_fib_free(struct route_entry *re)
+{
+	if (!re->fib)
+		return;
+
+	nexthops_free(re->fib->ng.nexthop);
+	nexthops_free(re->fib->backup_ng.nexthop);
+	XFREE(MTYPE_RE_FIB, re->fib);
+}
+
+static void rib_dest_version_bump(rib_dest_t *dest)
+{
+	if (CHECK_FLAG(dest->flags, RIB_DEST_TOMBSTONE)) {
+		rib_version_list_del(&rib_tombstones, dest);
+		UNSET_FLAG(dest->flags, RIB_DEST_TOMBSTONE);
+	} else if (dest->version)
+		rib_version_list_del(&rib_versions, dest);
+
+	dest->version = ++rib_version_last;
+	rib_version_list_add_tail(&rib_versions, dest);
+}
+
+/* dest is being freed: no one will know of the change it was for */
+static void rib_dest_version_forget(rib_dest_t *dest)
+{
+	if (!dest->version)
+		return;
+
+	if (CHECK_FLAG(dest->flags, RIB_DEST_TOMBSTONE))
+		rib_version_list_del(&rib_tombstones, dest);
+	else
+		rib_version_list_del(&rib_versions, dest);
+	dest->version = 0;
+	rib_version_floor = rib_version_last;
+}
+
+/*
+ * dest could go, having no routes left: keep it as a tombstone if it had
+ * anything installed, making room by letting the oldest one go.
+ */
+static bool rib_dest_tombstone(rib_dest_t *dest)
+{
+	rib_dest_t *oldest;
+
+	if (CHECK_FLAG(dest->flags, RIB_DEST_TOMBSTONE))
+		return true;
+	if (!dest->version)
+		return false;
+
+	/* It is a change of its own, whatever came before. */
+	rib_version_list_del(&rib_versions, dest);
+	dest->version = ++rib_version_last;
+	SET_FLAG(dest->flags, RIB_DEST_TOMBSTONE);
+	rib_version_list_add_tail(&rib_tombstones, dest);
+
+	if (rib_version_list_count(&rib_tombstones) <= RIB_TOMBSTONES_MAX)
+		return true;
+
+	oldest = rib_version_list_pop(&rib_tombstones);
+	UNSET_FLAG(oldest->flags, RIB_DEST_TOMBSTONE);
+	rib_version_floor = oldest->version;
+	oldest->version = 0;
+	rib_gc_dest(oldest->rnode);
+
+	return true;
+}
+
+uint64_t rib_version(void)
+{
+	return rib_version_last;
+}
+
+/* The first dest in head changed after version */
+static rib_dest_t *rib_version_list_after(struct rib_version_list_head *head,
+					  uint64_t version)
+{
+	rib_dest_t *dest, *first = NULL;
+
+	for (dest = rib_version_list_last(head); dest && dest->version > version;
+	     dest = rib_version_list_prev(head, dest))
+		first = dest;
+
+	return first;
+}
+
+bool rib_walk_changed_since(uint64_t version,
+			    bool (*cb)(rib_dest_t *dest, void *arg), void *arg)
+{
+	rib_dest_t *live, *tomb, *dest;
+
+	if (version < rib_version_floor)
+		return false;
+
+	/* Both lists are in version order: merge them. */
+	live = rib_version_list_after(&rib_versions, version);
+	tomb = rib_version_list_after(&rib_tombstones, version);
+	while (live || tomb) {
+		if (!tomb || (live && live->version < tomb->version)) {
+			dest = live;
+			live = rib_version_list_next(&rib_versions, live);
+		} else {
+			dest = tomb;
+			tomb = rib_version_list_next(&rib_tombstones, tomb);
+		}
+
+		if (!cb(dest, arg))
+			break;
+	}
+
+	return true;
+}
+
 /* Update flag indicates whether this is a "replace" or not. Currently, this
  * is only used for IPv4.
  */
@@ -688,12 +872,14 @@ void rib_install_kernel(struct route_node *rn, struct route_entry *re,
 
 	/* Update fib selection */
 	dest->selected_fib = re;
+	zebra_rnh_rcache_invalidate(rn);
 
 	/*
 	 * Make sure we update the FPM any time we send new information to
 	 * the kernel.
 	 */
 	hook_call(rib_update, rn, "installing in kernel");
+	rib_dest_version_bump(dest);
 
 	/* Send add or update */
 	if (old)
@@ -711,10 +897,7 @@ void rib_install_kernel(struct route_node *rn, struct route_entry *re,
 
 			/* Free old FIB nexthop group */
 			UNSET_FLAG(old->status, ROUTE_ENTRY_USE_FIB_NHG);
-			if (old->fib_ng.nexthop) {
-				nexthops_free(old->fib_ng.nexthop);
-				old->fib_ng.nexthop = NULL;
-			}
+			re_fib_ng_free(old, false);
 		}
 
 		if (zvrf)
@@ -755,6 +938,7 @@ void rib_uninstall_kernel(struct route_node *rn, struct route_entry *re)
 	 * the dataplane.
 	 */
 	hook_call(rib_update, rn, "uninstalling from kernel");
+	rib_dest_version_bump(rib_dest_from_rnode(rn));
 
 	switch (dplane_route_delete(rn, re)) {
 	case ZEBRA_DPLANE_REQUEST_QUEUED:
@@ -813,6 +997,8 @@ void zebra_rib_evaluate_rn_nexthops(struct route_node *rn, uint32_t seq,
 	rib_dest_t *dest = rib_dest_from_rnode(rn);
 	struct rnh *rnh;
 
+	zebra_rnh_rcache_invalidate(rn);
+
 	/*
 	 * We are storing the rnh's associated withb
 	 * the tracked nexthop as a list of the rn's.
@@ -907,6 +1093,9 @@ int rib_gc_dest(struct route_node *rn)
 	if (!rib_can_delete_dest(dest))
 		return 0;
 
+	if (rib_dest_tombstone(dest))
+		return 0;
+
 	if (IS_ZEBRA_DEBUG_RIB) {
 		struct zebra_vrf *zvrf;
 
@@ -917,6 +1106,7 @@ int rib_gc_dest(struct route_node *rn)
 	zebra_rib_evaluate_rn_nexthops(rn, zebra_router_get_next_sequence(),
 				       true);
 
+	zebra_rnh_rcache_fini(rn);
 	dest->rnode = NULL;
 	rnh_list_fini(&dest->nht);
 	XFREE(MTYPE_RIB_DEST, dest);
@@ -944,6 +1134,8 @@ void zebra_rtable_node_cleanup(struct route_table *table,
 		/* Remove from update queue of FPM module */
 		hook_call(rib_shutdown, node);
 
+		rib_dest_version_forget(dest);
+		zebra_rnh_rcache_fini(node);
 		rnh_list_fini(&dest->nht);
 		XFREE(MTYPE_RIB_DEST, node->info);
 	}
@@ -1427,6 +1619,9 @@ static void rib_process(struct route_node *rn)
 		}
 	}
 
+	/* Resolution over rn may have to stop there, or go on past it */
+	zebra_rnh_rcache_invalidate(rn);
+
 	/*
 	 * Check if the dest can be deleted now.
 	 */
@@ -1701,8 +1896,8 @@ static bool rib_update_re_from_ctx(struct route_entry *re,
 	/* TODO -- this isn't testing or comparing the FIB flags; we should
 	 * do a more explicit loop, checking the incoming notification's flags.
 	 */
-	if (re->fib_ng.nexthop && ctxnhg->nexthop &&
-	    nexthop_group_equal(&re->fib_ng, ctxnhg))
+	if (re->fib && re->fib->ng.nexthop && ctxnhg->nexthop &&
+	    nexthop_group_equal(&re->fib->ng, ctxnhg))
 		matched = true;
 
 	/* If the new FIB set matches the existing FIB set, we're done. */
@@ -1721,8 +1916,7 @@ static bool rib_update_re_from_ctx(struct route_entry *re,
 			zlog_debug(
 				"%s(%u:%u):%pRN update_from_ctx(): replacing fib nhg",
 				VRF_LOGNAME(vrf), re->vrf_id, re->table, rn);
-		nexthops_free(re->fib_ng.nexthop);
-		re->fib_ng.nexthop = NULL;
+		re_fib_ng_free(re, false);
 
 		UNSET_FLAG(re->status, ROUTE_ENTRY_USE_FIB_NHG);
 
@@ -1781,8 +1975,8 @@ no_nexthops:
 	if (zrouter.asic_notification_nexthop_control) {
 		SET_FLAG(re->status, ROUTE_ENTRY_USE_FIB_NHG);
 		if (ctxnhg->nexthop)
-			copy_nexthops(&(re->fib_ng.nexthop), ctxnhg->nexthop,
-				      NULL);
+			copy_nexthops(&(re_fib_get(re)->ng.nexthop),
+				      ctxnhg->nexthop, NULL);
 	}
 
 check_backups:
@@ -1799,7 +1993,7 @@ check_backups:
 	/* First check the route's 'fib' list of backups, if it's present
 	 * from some previous event.
 	 */
-	re_nhg = &re->fib_backup_ng;
+	re_nhg = rib_get_fib_backup_nhg(re);
 	ctxnhg = dplane_ctx_get_backup_ng(ctx);
 
 	matched = false;
@@ -1814,7 +2008,7 @@ check_backups:
 				VRF_LOGNAME(vrf), re->vrf_id, rn);
 		goto done;
 
-	} else if (re->fib_backup_ng.nexthop) {
+	} else if (re_nhg->nexthop) {
 		/*
 		 * Free stale fib backup list and move on to check
 		 * the route's backups.
@@ -1823,8 +2017,7 @@ check_backups:
 			zlog_debug(
 				"%s(%u):%pRN update_from_ctx(): replacing fib backup nhg",
 				VRF_LOGNAME(vrf), re->vrf_id, rn);
-		nexthops_free(re->fib_backup_ng.nexthop);
-		re->fib_backup_ng.nexthop = NULL;
+		re_fib_ng_free(re, true);
 
 		/* Note that the installed nexthops have changed */
 		changed_p = true;
@@ -1856,8 +2049,8 @@ check_backups:
 				VRF_LOGNAME(vrf), re->vrf_id, rn,
 				(changed_p ? "true" : "false"));
 
-		copy_nexthops(&(re->fib_backup_ng.nexthop), ctxnhg->nexthop,
-			      NULL);
+		copy_nexthops(&(re_fib_get(re)->backup_ng.nexthop),
+			      ctxnhg->nexthop, NULL);
 	}
 
 done:
@@ -2227,7 +2420,7 @@ static int rib_count_installed_nh(struct route_entry *re)
 		/* The meaningful flag depends on where the installed
 		 * nexthops reside.
 		 */
-		if (nhg == &(re->fib_ng)) {
+		if (CHECK_FLAG(re->status, ROUTE_ENTRY_USE_FIB_NHG)) {
 			if (CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB))
 				count++;
 		} else {
@@ -2649,6 +2842,25 @@ static void process_subq_route(struct listnode *lnode, uint8_t qindex)
 	route_unlock_node(rnode);
 }
 
+/*
+ * One route node off the VRF at the head of the line. The VRF goes to the
+ * back of it with any left, so one with a burst of path moves does not
+ * hold up the others.
+ */
+static void process_subq_fast(struct list *subq, struct listnode *lnode)
+{
+	struct zebra_vrf *zvrf = listgetdata(lnode);
+	struct listnode *rnode = listhead(zvrf->mq_fast);
+
+	process_subq_route(rnode, META_QUEUE_FAST);
+	list_delete_node(zvrf->mq_fast, rnode);
+
+	if (listcount(zvrf->mq_fast))
+		listnode_add(subq, zvrf);
+	else
+		list_delete(&zvrf->mq_fast);
+}
+
 static void rib_re_nhg_free(struct route_entry *re)
 {
 	if (re->nhe && re->nhe_id) {
@@ -2657,7 +2869,7 @@ static void rib_re_nhg_free(struct route_entry *re)
 	} else if (re->nhe && re->nhe->nhg.nexthop)
 		nexthops_free(re->nhe->nhg.nexthop);
 
-	nexthops_free(re->fib_ng.nexthop);
+	route_entry_fib_free(re);
 }
 
 struct zebra_early_route {
@@ -2856,6 +3068,18 @@ static void process_subq_early_route_add(struct zebra_early_route *ere)
 				ere->src_p_provided ? &ere->src_p : NULL, re);
 	}
 
+	/*
+	 * Nothing but the nexthops of the installed route moving, as when a
+	 * protocol switches to a better performing path: reprogrammed ahead
+	 * of bulk changes.
+	 */
+	if (same && same == rib_dest_from_rnode(rn)->selected_fib &&
+	    CHECK_FLAG(same->status, ROUTE_ENTRY_INSTALLED) &&
+	    re->nhe != same->nhe && re->distance == same->distance &&
+	    re->metric == same->metric && re->tag == same->tag &&
+	    re->mtu == same->mtu && re->flags == same->flags)
+		SET_FLAG(rib_dest_from_rnode(rn)->flags, RIB_DEST_NEXTHOP_ONLY);
+
 	SET_FLAG(re->status, ROUTE_ENTRY_CHANGED);
 	rib_addnode(rn, re, 1);
 
@@ -3181,6 +3405,9 @@ static unsigned int process_subq(struct list *subq,
 	case META_QUEUE_EARLY_LABEL:
 		process_subq_early_label(lnode);
 		break;
+	case META_QUEUE_FAST:
+		process_subq_fast(subq, lnode);
+		break;
 	case META_QUEUE_CONNECTED:
 	case META_QUEUE_KERNEL:
 	case META_QUEUE_STATIC:
@@ -3252,12 +3479,19 @@ static wq_item_status meta_queue_process(struct work_queue *dummy, void *data)
  * doesn't have a route_entry with a better meta-queue and the
  * original metaqueue index value will win and we'll end up with
  * the route node enqueued once.
+ *
+ * A route only moving to other nexthops goes on the fast sub-queue
+ * instead, which holds the VRFs with any in round robin, each with its
+ * route nodes. One already on a sub-queue stays where it is.
  */
 static int rib_meta_queue_add(struct meta_queue *mq, void *data)
 {
 	struct route_node *rn = NULL;
 	struct route_entry *re = NULL, *curr_re = NULL;
 	uint8_t qindex = MQ_SIZE, curr_qindex = MQ_SIZE;
+	struct zebra_vrf *zvrf;
+	rib_dest_t *dest;
+	bool fast;
 
 	rn = (struct route_node *)data;
 
@@ -3274,6 +3508,10 @@ static int rib_meta_queue_add(struct meta_queue *mq, void *data)
 		return -1;
 
 	/* Invariant: at this point we always have rn->info set. */
+	dest = rib_dest_from_rnode(rn);
+	fast = CHECK_FLAG(dest->flags, RIB_DEST_NEXTHOP_ONLY);
+	UNSET_FLAG(dest->flags, RIB_DEST_NEXTHOP_ONLY);
+
 	/* A route node must only be in one sub-queue at a time. */
 	if (CHECK_FLAG(rib_dest_from_rnode(rn)->flags, MQ_BIT_MASK)) {
 		if (IS_ZEBRA_DEBUG_RIB_DETAILED) {
@@ -3297,8 +3535,19 @@ static int rib_meta_queue_add(struct meta_queue *mq, void *data)
 		return -1;
 	}
 
-	SET_FLAG(rib_dest_from_rnode(rn)->flags, RIB_ROUTE_QUEUED(qindex));
-	listnode_add(mq->subq[qindex], rn);
+	zvrf = rib_dest_vrf(dest);
+	if (fast && zvrf) {
+		qindex = META_QUEUE_FAST;
+		if (!zvrf->mq_fast) {
+			zvrf->mq_fast = list_new();
+			listnode_add(mq->subq[qindex], zvrf);
+		}
+		listnode_add(zvrf->mq_fast, rn);
+	} else {
+		listnode_add(mq->subq[qindex], rn);
+	}
+
+	SET_FLAG(dest->flags, RIB_ROUTE_QUEUED(qindex));
 	route_lock_node(rn);
 	mq->size++;
 
@@ -3794,6 +4043,27 @@ static void rib_meta_queue_free(struct meta_queue *mq, struct list *l,
 	}
 }
 
+static void fast_meta_queue_free(struct meta_queue *mq, struct list *l,
+				 struct zebra_vrf *zvrf)
+{
+	struct zebra_vrf *fast_zvrf;
+	struct route_node *rnode;
+	struct listnode *node, *nnode, *rn_node;
+
+	for (ALL_LIST_ELEMENTS(l, node, nnode, fast_zvrf)) {
+		if (zvrf && fast_zvrf != zvrf)
+			continue;
+
+		for (ALL_LIST_ELEMENTS_RO(fast_zvrf->mq_fast, rn_node, rnode)) {
+			route_unlock_node(rnode);
+			mq->size--;
+		}
+		list_delete(&fast_zvrf->mq_fast);
+		node->data = NULL;
+		list_delete_node(l, node);
+	}
+}
+
 static void early_route_meta_queue_free(struct meta_queue *mq, struct list *l,
 					struct zebra_vrf *zvrf)
 {
@@ -3847,6 +4117,9 @@ void meta_queue_free(struct meta_queue *mq, struct zebra_vrf *zvrf)
 		case META_QUEUE_EARLY_LABEL:
 			early_label_meta_queue_free(mq, mq->subq[i], zvrf);
 			break;
+		case META_QUEUE_FAST:
+			fast_meta_queue_free(mq, mq->subq[i], zvrf);
+			break;
 		case META_QUEUE_CONNECTED:
 		case META_QUEUE_KERNEL:
 		case META_QUEUE_STATIC:
@@ -3899,6 +4172,7 @@ rib_dest_t *zebra_rib_create_dest(struct route_node *rn)
 
 	dest = XCALLOC(MTYPE_RIB_DEST, sizeof(rib_dest_t));
 	rnh_list_init(&dest->nht);
+	rnh_rcache_list_init(&dest->rcache);
 	re_list_init(&dest->routes);
 	route_lock_node(rn); /* rn route table reference */
 	rn->info = dest;
@@ -4760,6 +5034,94 @@ static void handle_pw_result(struct zebra_dplane_ctx *ctx)
 	}
 }
 
+/* Route results the rib processes, as opposed to async notifications */
+static bool rib_ctx_is_route_result(const struct zebra_dplane_ctx *ctx)
+{
+	switch (dplane_ctx_get_op(ctx)) {
+	case DPLANE_OP_ROUTE_INSTALL:
+	case DPLANE_OP_ROUTE_UPDATE:
+	case DPLANE_OP_ROUTE_DELETE:
+		return dplane_ctx_get_notif_provider(ctx) == 0;
+	default:
+		return false;
+	}
+}
+
+struct rib_result_sort {
+	struct zebra_dplane_ctx *ctx;
+	uint32_t pos;
+};
+
+static int rib_result_sort_cmp(const void *a, const void *b)
+{
+	const struct rib_result_sort *ra = a, *rb = b;
+	const struct zebra_dplane_ctx *ca = ra->ctx, *cb = rb->ctx;
+	int ret;
+
+	if (dplane_ctx_get_vrf(ca) != dplane_ctx_get_vrf(cb))
+		return numcmp(dplane_ctx_get_vrf(ca), dplane_ctx_get_vrf(cb));
+	if (dplane_ctx_get_table(ca) != dplane_ctx_get_table(cb))
+		return numcmp(dplane_ctx_get_table(ca),
+			      dplane_ctx_get_table(cb));
+	if (dplane_ctx_get_afi(ca) != dplane_ctx_get_afi(cb))
+		return numcmp(dplane_ctx_get_afi(ca), dplane_ctx_get_afi(cb));
+	if (dplane_ctx_get_safi(ca) != dplane_ctx_get_safi(cb))
+		return numcmp(dplane_ctx_get_safi(ca),
+			      dplane_ctx_get_safi(cb));
+
+	ret = prefix_cmp(dplane_ctx_get_dest(ca), dplane_ctx_get_dest(cb));
+	if (ret)
+		return ret;
+
+	/* Results for the same node stay in the order they came in */
+	return numcmp(ra->pos, rb->pos);
+}
+
+/*
+ * Put each run of route results in ctxlist in route node order, leaving
+ * everything else where it is: consecutive results then land on the same
+ * table and node while they are hot, and the results for one node are
+ * handled back to back.
+ */
+static void rib_dplane_results_sort(struct dplane_ctx_list_head *ctxlist)
+{
+	struct dplane_ctx_list_head sorted;
+	struct rib_result_sort *run = NULL;
+	struct zebra_dplane_ctx *ctx;
+	uint32_t count = 0, size = 0, i;
+
+	dplane_ctx_q_init(&sorted);
+
+	do {
+		ctx = dplane_ctx_dequeue(ctxlist);
+
+		if (ctx && rib_ctx_is_route_result(ctx)) {
+			if (count == size) {
+				size = size ? size * 2 : 64;
+				run = XREALLOC(MTYPE_RIB_RESULT_SORT, run,
+					       size * sizeof(*run));
+			}
+			run[count].ctx = ctx;
+			run[count].pos = count;
+			count++;
+			continue;
+		}
+
+		if (count > 1)
+			qsort(run, count, sizeof(*run), rib_result_sort_cmp);
+		for (i = 0; i < count; i++)
+			dplane_ctx_enqueue_tail(&sorted, run[i].ctx);
+		count = 0;
+
+		if (ctx)
+			dplane_ctx_enqueue_tail(&sorted, ctx);
+	} while (ctx);
+
+	XFREE(MTYPE_RIB_RESULT_SORT, run);
+
+	dplane_ctx_list_append(ctxlist, &sorted);
+}
+
 /*
  * Handle results from the dataplane system. Dequeue update context
  * structs, dispatch to appropriate internal handlers.
@@ -4796,11 +5158,8 @@ static void rib_process_dplane_results(struct event *thread)
 			dplane_ctx_list_append(&ctxlist, &rib_dplane_q);
 		}
 
-		/* Dequeue context block */
-		ctx = dplane_ctx_dequeue(&ctxlist);
-
 		/* If we've emptied the results queue, we're done */
-		if (ctx == NULL)
+		if (dplane_ctx_get_head(&ctxlist) == NULL)
 			break;
 
 		/* If zebra is shutting down, avoid processing results,
@@ -4809,6 +5168,7 @@ static void rib_process_dplane_results(struct event *thread)
 		shut_p = atomic_load_explicit(&zrouter.in_shutdown,
 					      memory_order_relaxed);
 		if (shut_p) {
+			ctx = dplane_ctx_dequeue(&ctxlist);
 			while (ctx) {
 				dplane_ctx_fini(&ctx);
 
@@ -4818,6 +5178,12 @@ static void rib_process_dplane_results(struct event *thread)
 			continue;
 		}
 
+		rib_dplane_results_sort(&ctxlist);
+		ctx = dplane_ctx_dequeue(&ctxlist);
+
+		/* Owners are told about the whole batch with one wakeup */
+		zsend_route_notify_owner_batch_start();
+
 		while (ctx) {
 #ifdef HAVE_SCRIPTING
 			if (ret == 0)
@@ -4935,6 +5301,8 @@ static void rib_process_dplane_results(struct event *thread)
 			ctx = dplane_ctx_dequeue(&ctxlist);
 		}
 
+		zsend_route_notify_owner_batch_end();
+
 	} while (1);
 
 #ifdef HAVE_SCRIPTING
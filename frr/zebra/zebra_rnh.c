@@ -20,6 +20,7 @@
 #include "stream.h"
 #include "nexthop.h"
 #include "vrf.h"
+#include "jhash.h"
 
 #include "zebra/zebra_router.h"
 #include "zebra/rib.h"
@@ -36,6 +37,7 @@
 #include "zebra/zebra_errors.h"
 
 DEFINE_MTYPE_STATIC(ZEBRA, RNH, "Nexthop tracking object");
+DEFINE_MTYPE_STATIC(ZEBRA, RNH_RCACHE, "Nexthop resolution cache entry");
 
 /* UI controls whether to notify about changes that only involve backup
  * nexthops. Default is to notify all changes.
@@ -821,6 +823,7 @@ static void free_state(vrf_id_t vrf_id, struct route_entry *re,
 
 	/* free RE and nexthops */
 	zebra_nhg_free(re->nhe);
+	route_entry_fib_free(re);
 	XFREE(MTYPE_RE, re);
 }
 
@@ -849,10 +852,7 @@ static void copy_state(struct rnh *rnh, const struct route_entry *re,
 	/* Copy the 'fib' nexthops also, if present - we want to capture
 	 * the true installed nexthops.
 	 */
-	if (re->fib_ng.nexthop)
-		nexthop_group_copy(&state->fib_ng, &re->fib_ng);
-	if (re->fib_backup_ng.nexthop)
-		nexthop_group_copy(&state->fib_backup_ng, &re->fib_backup_ng);
+	route_entry_fib_copy(state, re);
 
 	rnh->state = state;
 }
@@ -872,7 +872,7 @@ static struct nexthop *next_valid_primary_nh(struct route_entry *re,
 	/* Fib backup ng present: some backups are installed,
 	 * and we're configured for special handling if there are backups.
 	 */
-	if (rnh_hide_backups && (re->fib_backup_ng.nexthop != NULL))
+	if (rnh_hide_backups && (rib_get_fib_backup_nhg(re)->nexthop != NULL))
 		default_path = false;
 
 	/* Default path: no special handling, just using the 'installed'
@@ -1769,3 +1769,119 @@ bool rnh_get_hide_backups(void)
 {
 	return rnh_hide_backups;
 }
+
+/*
+ * Recursive resolution cache. Many routes resolve over the same few
+ * addresses, PE loopbacks for VPN routes, and each one of them would have
+ * nexthop_active() match the address in the table and walk up from there
+ * to the route selected for it. The node that walk ended on is kept by
+ * address, on the dest for the node too: a route being selected at a node
+ * drops the entries there and in the nodes above it for addresses under
+ * its prefix, which it could now be the match for.
+ */
+#define RNH_RCACHE_MAX 8192
+
+static int rnh_rcache_cmp(const struct rnh_rcache_entry *a,
+			  const struct rnh_rcache_entry *b)
+{
+	if (a->vrf_id != b->vrf_id)
+		return numcmp(a->vrf_id, b->vrf_id);
+	return prefix_cmp(&a->p, &b->p);
+}
+
+static uint32_t rnh_rcache_hash(const struct rnh_rcache_entry *entry)
+{
+	return jhash_1word(entry->vrf_id, prefix_hash_key(&entry->p));
+}
+
+DECLARE_HASH(rnh_rcache, struct rnh_rcache_entry, hash_item, rnh_rcache_cmp,
+	     rnh_rcache_hash);
+
+static struct rnh_rcache_head rnh_rcache = INIT_HASH(rnh_rcache);
+
+static void rnh_rcache_entry_free(struct rnh_rcache_entry *entry)
+{
+	rnh_rcache_del(&rnh_rcache, entry);
+	rnh_rcache_list_del(&entry->dest->rcache, entry);
+	XFREE(MTYPE_RNH_RCACHE, entry);
+}
+
+struct route_node *zebra_rnh_rcache_find(vrf_id_t vrf_id,
+					 const struct prefix *p,
+					 const struct prefix *top)
+{
+	struct rnh_rcache_entry key = {}, *entry;
+	struct route_node *rn;
+
+	key.vrf_id = vrf_id;
+	prefix_copy(&key.p, p);
+	entry = rnh_rcache_find(&rnh_rcache, &key);
+	if (!entry)
+		return NULL;
+	rn = entry->dest->rnode;
+
+	/* The walk would have come across top, and stopped there */
+	if (top && top->family == p->family &&
+	    top->prefixlen > rn->p.prefixlen && prefix_match(top, p))
+		return NULL;
+
+	return rn;
+}
+
+void zebra_rnh_rcache_add(vrf_id_t vrf_id, const struct prefix *p,
+			  struct route_node *rn)
+{
+	struct rnh_rcache_entry key = {}, *entry;
+	rib_dest_t *dest = rib_dest_from_rnode(rn);
+
+	if (!dest)
+		return;
+
+	key.vrf_id = vrf_id;
+	prefix_copy(&key.p, p);
+	entry = rnh_rcache_find(&rnh_rcache, &key);
+	if (entry) {
+		/* Found somewhere else, the route it was on being gone */
+		if (entry->dest == dest)
+			return;
+		rnh_rcache_list_del(&entry->dest->rcache, entry);
+	} else {
+		if (rnh_rcache_count(&rnh_rcache) >= RNH_RCACHE_MAX)
+			return;
+		entry = XCALLOC(MTYPE_RNH_RCACHE, sizeof(*entry));
+		*entry = key;
+		rnh_rcache_add(&rnh_rcache, entry);
+	}
+	entry->dest = dest;
+	rnh_rcache_list_add_tail(&dest->rcache, entry);
+}
+
+void zebra_rnh_rcache_invalidate(struct route_node *rn)
+{
+	struct rnh_rcache_entry *entry;
+	struct route_node *up;
+	rib_dest_t *dest;
+
+	if (!rnh_rcache_count(&rnh_rcache))
+		return;
+
+	for (up = rn; up; up = up->parent) {
+		dest = rib_dest_from_rnode(up);
+		if (!dest)
+			continue;
+
+		frr_each_safe (rnh_rcache_list, &dest->rcache, entry)
+			if (up == rn || prefix_match(&rn->p, &entry->p))
+				rnh_rcache_entry_free(entry);
+	}
+}
+
+void zebra_rnh_rcache_fini(struct route_node *rn)
+{
+	rib_dest_t *dest = rib_dest_from_rnode(rn);
+	struct rnh_rcache_entry *entry;
+
+	while ((entry = rnh_rcache_list_first(&dest->rcache)))
+		rnh_rcache_entry_free(entry);
+	rnh_rcache_list_fini(&dest->rcache);
+}
@@ -36,6 +36,22 @@ extern void zebra_print_rnh_table(vrf_id_t vrfid, afi_t afi, safi_t safi,
 
 extern int rnh_resolve_via_default(struct zebra_vrf *zvrf, int family);
 
+/*
+ * The node recursive resolution of nexthop address p in vrf_id last ended
+ * on, found by a route_node_match() and a walk up to a selected route. NULL
+ * to look it up in the table, and _add() what was found, if the cache lacks
+ * it or resolution on behalf of route top could stop short of it.
+ */
+extern struct route_node *zebra_rnh_rcache_find(vrf_id_t vrf_id,
+						const struct prefix *p,
+						const struct prefix *top);
+extern void zebra_rnh_rcache_add(vrf_id_t vrf_id, const struct prefix *p,
+				 struct route_node *rn);
+/* The selected route at rn changed: forget what it could resolve now */
+extern void zebra_rnh_rcache_invalidate(struct route_node *rn);
+/* rn's dest is being freed */
+extern void zebra_rnh_rcache_fini(struct route_node *rn);
+
 extern bool rnh_nexthop_valid(const struct route_entry *re,
 			      const struct nexthop *nh);
 
@@ -187,6 +187,14 @@ struct zebra_router {
 
 	uint32_t multipath_num;
 
+	/*
+	 * Pthreads the kernel dplane provider spreads route updates over,
+	 * each with a netlink socket per namespace; 0 or 1 for just the
+	 * dplane pthread.
+	 */
+	uint32_t dplane_shards;
+#define ZEBRA_DPLANE_SHARDS_MAX 16
+
 	/* RPF Lookup behavior */
 	enum multicast_mode ipv4_multicast_mode;
 
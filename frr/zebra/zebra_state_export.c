@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Zebra RIB on the state export socket.
+ *
+ * A page ends on a route node boundary, and the cursor is the prefix of
+ * the last node sent. Source-specific IPv6 routes hang off the nodes of
+ * their destinations and are not exported.
+ */
+#include <zebra.h>
+
+#include "lib/state_export.h"
+
+#include "zebra/rib.h"
+#include "zebra/zebra_router.h"
+#include "zebra/zebra_vrf.h"
+#include "zebra/zebra_nhg.h"
+#include "zebra/zebra_state_export.h"
+
+DEFINE_MTYPE_STATIC(ZEBRA, STATE_EXPORT, "Zebra state export page");
+
+struct zebra_state_route {
+	Mgmtd__RibRouteState msg;
+	uint8_t prefix[STATE_EXPORT_PREFIX_LEN];
+	uint8_t nexthop[IPV6_MAX_BYTELEN];
+};
+
+static void zebra_state_route_fill(struct zebra_state_route *sr,
+				   const struct route_node *rn,
+				   const struct route_entry *re, time_t now)
+{
+	Mgmtd__RibRouteState *msg = &sr->msg;
+	const struct nexthop *nh;
+
+	mgmtd__rib_route_state__init(msg);
+	state_export_prefix(&msg->prefix, sr->prefix, &rn->p);
+
+	msg->type = re->type;
+	msg->instance = re->instance;
+	msg->distance = re->distance;
+	msg->metric = re->metric;
+	msg->flags = re->flags;
+	msg->status = re->status;
+	msg->nhe_id = re->nhe_id;
+	msg->uptime = now - re->uptime;
+
+	if (!re->nhe)
+		return;
+	msg->nexthop_num = nexthop_group_active_nexthop_num(&re->nhe->nhg);
+
+	for (ALL_NEXTHOPS(re->nhe->nhg, nh)) {
+		if (!CHECK_FLAG(nh->flags, NEXTHOP_FLAG_ACTIVE))
+			continue;
+		if (nh->type == NEXTHOP_TYPE_IPV4 ||
+		    nh->type == NEXTHOP_TYPE_IPV4_IFINDEX)
+			state_export_addr(&msg->nexthop, sr->nexthop, AF_INET,
+					  &nh->gate.ipv4);
+		else if (nh->type == NEXTHOP_TYPE_IPV6 ||
+			 nh->type == NEXTHOP_TYPE_IPV6_IFINDEX)
+			state_export_addr(&msg->nexthop, sr->nexthop, AF_INET6,
+					  &nh->gate.ipv6);
+		else
+			continue;
+		msg->has_nexthop = true;
+		break;
+	}
+}
+
+static const char *zebra_state_export_table(const Mgmtd__StateExportReq *req,
+					    struct route_table **table)
+{
+	struct zebra_vrf *zvrf;
+	afi_t afi = req->afi;
+	safi_t safi = req->safi;
+
+	zvrf = req->vrf ? zebra_vrf_lookup_by_name(req->vrf)
+			: zebra_vrf_lookup_by_id(VRF_DEFAULT);
+	if (!zvrf)
+		return "No such VRF";
+
+	if ((afi != AFI_IP && afi != AFI_IP6) ||
+	    (safi != SAFI_UNICAST && safi != SAFI_MULTICAST))
+		return "Address family not exported";
+
+	*table = zvrf->table[afi][safi];
+	if (!*table)
+		return "No such table";
+	return NULL;
+}
+
+static void zebra_state_export(struct msg_conn *conn,
+			       const Mgmtd__StateExportReq *req)
+{
+	Mgmtd__StateExportReply reply;
+	struct zebra_state_route *routes;
+	Mgmtd__RibRouteState **msgs;
+	struct route_table *table;
+	struct route_node *rn;
+	struct route_entry *re;
+	struct prefix cursor;
+	uint8_t next[STATE_EXPORT_PREFIX_LEN];
+	unsigned int max, n = 0, count, i;
+	const char *error;
+	time_t now = monotime(NULL);
+
+	if (req->table != MGMTD__STATE_TABLE__RIB_ROUTES) {
+		state_export_error(conn, req, "Table not exported by zebra");
+		return;
+	}
+	error = zebra_state_export_table(req, &table);
+	if (error) {
+		state_export_error(conn, req, error);
+		return;
+	}
+
+	mgmtd__state_export_reply__init(&reply);
+	reply.req_id = req->req_id;
+	reply.success = true;
+
+	max = state_export_page_size(req);
+	routes = XCALLOC(MTYPE_STATE_EXPORT, max * sizeof(*routes));
+
+	if (state_export_cursor(req, afi2family(req->afi), &cursor))
+		rn = route_table_get_next(table, &cursor);
+	else
+		rn = route_top(table);
+
+	for (; rn; rn = route_next(rn)) {
+		count = 0;
+		RNODE_FOREACH_RE (rn, re)
+			if (!CHECK_FLAG(re->status, ROUTE_ENTRY_REMOVED))
+				count++;
+		if (!count)
+			continue;
+
+		if (n + count > max) {
+			if (n) {
+				route_unlock_node(rn);
+				break;
+			}
+			/* More routes than a page: send them all the same */
+			routes = XREALLOC(MTYPE_STATE_EXPORT, routes,
+					  count * sizeof(*routes));
+		}
+
+		RNODE_FOREACH_RE (rn, re)
+			if (!CHECK_FLAG(re->status, ROUTE_ENTRY_REMOVED))
+				zebra_state_route_fill(&routes[n++], rn, re,
+						       now);
+		state_export_prefix(&reply.next_cursor, next, &rn->p);
+	}
+	/* Stopped short of the end */
+	reply.has_next_cursor = rn != NULL;
+
+	msgs = XCALLOC(MTYPE_STATE_EXPORT, (n ? n : 1) * sizeof(*msgs));
+	for (i = 0; i < n; i++)
+		msgs[i] = &routes[i].msg;
+	reply.n_rib_routes = n;
+	reply.rib_routes = msgs;
+
+	if (state_export_reply(conn, &reply))
+		zlog_warn("%s: failed to send a page of %u routes", __func__,
+			  n);
+
+	XFREE(MTYPE_STATE_EXPORT, msgs);
+	XFREE(MTYPE_STATE_EXPORT, routes);
+}
+
+void zebra_state_export_init(void)
+{
+	state_export_init(zrouter.master, zebra_state_export);
+}
+
+void zebra_state_export_finish(void)
+{
+	state_export_fini();
+}
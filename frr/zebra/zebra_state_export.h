@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Zebra RIB on the state export socket.
+ */
+#ifndef _ZEBRA_STATE_EXPORT_H
+#define _ZEBRA_STATE_EXPORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Paged RibRouteState dumps of the RIB tables, see lib/state_export.h */
+extern void zebra_state_export_init(void);
+extern void zebra_state_export_finish(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ZEBRA_STATE_EXPORT_H */
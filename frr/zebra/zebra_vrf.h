@@ -118,6 +118,12 @@ struct zebra_vrf {
 
 	/* MPLS processing flags */
 	uint16_t mpls_flags;
+
+	/*
+	 * Route nodes of the VRF on the meta queue's fast sub-queue, while
+	 * it has any
+	 */
+	struct list *mq_fast;
 #define MPLS_FLAG_SCHEDULE_LSPS    (1 << 0)
 
 	/*
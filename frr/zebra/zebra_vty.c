@@ -866,10 +866,11 @@ static void do_show_route_helper(struct vty *vty, struct zebra_vrf *zvrf,
 	struct route_entry *re;
 	int first = 1;
 	rib_dest_t *dest;
-	json_object *json = NULL;
+	struct vty_json_stream js;
 	json_object *json_prefix = NULL;
 	uint32_t addr;
 	char buf[BUFSIZ];
+	char pending[PREFIX_STRLEN] = "";
 
 	/*
 	 * ctx->multi indicates if we are dumping multiple tables or vrfs.
@@ -882,8 +883,12 @@ static void do_show_route_helper(struct vty *vty, struct zebra_vrf *zvrf,
 	 *   => display the VRF and table if specific
 	 */
 
+	/*
+	 * The table may be too large to hold as one json object: each
+	 * prefix's routes go out as they are built.
+	 */
 	if (use_json)
-		json = json_object_new_object();
+		vty_json_stream_open(&js, vty);
 
 	/* Show all routes. */
 	for (rn = route_top(table); rn; rn = srcdest_route_next(rn)) {
@@ -955,19 +960,28 @@ static void do_show_route_helper(struct vty *vty, struct zebra_vrf *zvrf,
 					  show_ng);
 		}
 
-		if (json_prefix) {
-			prefix2str(&rn->p, buf, sizeof(buf));
-			json_object_object_add(json, buf, json_prefix);
+		if (!use_json)
+			continue;
+
+		/*
+		 * Source-specific routes come right after their destination's
+		 * and share its key: hold the array until the key changes.
+		 */
+		prefix2str(&rn->p, buf, sizeof(buf));
+		if (pending[0] && strcmp(pending, buf)) {
+			vty_json_stream_add(&js, pending, json_prefix);
 			json_prefix = NULL;
+			pending[0] = '\0';
 		}
+		if (json_prefix)
+			strlcpy(pending, buf, sizeof(pending));
 	}
 
-	/*
-	 * This is an extremely expensive operation at scale
-	 * and non-pretty reduces memory footprint significantly.
-	 */
-	if (use_json)
-		vty_json_no_pretty(vty, json);
+	if (use_json) {
+		if (json_prefix)
+			vty_json_stream_add(&js, pending, json_prefix);
+		vty_json_stream_close(&js);
+	}
 }
 
 static void do_show_ip_route_all(struct vty *vty, struct zebra_vrf *zvrf,
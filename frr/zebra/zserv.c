@@ -558,6 +558,31 @@ int zserv_send_batch(struct zserv *client, struct stream_fifo *fifo)
 	return 0;
 }
 
+int zserv_send_message_deferred(struct zserv *client, struct stream *msg)
+{
+	frr_with_mutex (&client->obuf_mtx) {
+		stream_fifo_push(client->obuf_fifo, msg);
+	}
+
+	client->obuf_deferred = true;
+
+	return 0;
+}
+
+void zserv_send_deferred_flush(void)
+{
+	struct listnode *node;
+	struct zserv *client;
+
+	for (ALL_LIST_ELEMENTS_RO(zrouter.client_list, node, client)) {
+		if (!client->obuf_deferred)
+			continue;
+
+		client->obuf_deferred = false;
+		zserv_client_event(client, ZSERV_CLIENT_WRITE);
+	}
+}
+
 /* Hooks for client connect / disconnect */
 DEFINE_HOOK(zserv_client_connect, (struct zserv *client), (client));
 DEFINE_KOOH(zserv_client_close, (struct zserv *client), (client));
@@ -92,6 +92,8 @@ struct zserv {
 	struct stream_fifo *ibuf_fifo;
 	pthread_mutex_t obuf_mtx;
 	struct stream_fifo *obuf_fifo;
+	/* Messages queued with the write pthread not yet woken for them */
+	bool obuf_deferred;
 
 	/* Private I/O buffers */
 	struct stream *ibuf_work;
@@ -296,6 +298,26 @@ extern int zserv_send_message(struct zserv *client, struct stream *msg);
  */
 extern int zserv_send_batch(struct zserv *client, struct stream_fifo *fifo);
 
+/*
+ * Queue a message to a connected Zebra API client, in order with the
+ * others sent to it, but leave waking its pthread for the message to
+ * zserv_send_deferred_flush(). Main pthread only.
+ *
+ * client
+ *    the client to send to
+ *
+ * msg
+ *    the message to send
+ */
+extern int zserv_send_message_deferred(struct zserv *client,
+				       struct stream *msg);
+
+/*
+ * Wake the pthreads of the clients sent messages with
+ * zserv_send_message_deferred(), once each.
+ */
+extern void zserv_send_deferred_flush(void);
+
 /*
  * Retrieve a client by its protocol and instance number.
  *
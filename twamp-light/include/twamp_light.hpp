@@ -19,6 +19,12 @@
 #include <atomic>
 #include <condition_variable>
 #include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <csignal>
+#include <numeric>
+#include <memory>
+#include <algorithm>
 
 
 #if (defined(__APPLE__))
@@ -31,9 +37,16 @@
     #include <endian.h>
 #endif
 
+//CLOCK_REALTIME, the clock kernel socket timestamps are taken in
 inline uint64_t get_current_time_ns(){
     return std::chrono::duration_cast<std::chrono::nanoseconds>
-    (std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+    (std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+//monotonic milliseconds, for scheduling
+inline uint64_t get_monotonic_ms(){
+    return std::chrono::duration_cast<std::chrono::milliseconds>
+    (std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 inline std::string get_current_timestamp() {
@@ -45,38 +58,1203 @@ inline std::string get_current_timestamp() {
     return oss.str();
 }
 
+//same with microseconds, for lining up with the FRR daemons' logs
+inline std::string get_current_timestamp_us() {
+    auto now = std::chrono::system_clock::now();
+    std::time_t now_c = std::chrono::system_clock::to_time_t(now);
+    std::tm local_tm = *std::localtime(&now_c);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count() % 1000000;
+    std::ostringstream oss;
+    oss << std::put_time(&local_tm, "%F %T") << "." << std::setw(6) << std::setfill('0') << us;
+    return oss.str();
+}
+
+//kernel (sw) and NIC (hw) timestamps of one packet, 0 where not available
+struct TwampTimestamps{
+    uint64_t sw {0};
+    uint64_t hw {0};
+};
+
+/*
+ * How long after the kernel timestamped a packet a loop got to read it:
+ * the wake-up delay a user-space timestamp takes on, which busy polling
+ * and a dedicated core cut down. Mean, standard deviation (the jitter)
+ * and maximum, in microseconds.
+ */
+struct TwampWakeupStats{
+    uint64_t count {0};
+    double sum_us {0.0};
+    double sum_sq_us {0.0};
+    double max_us {0.0};
+    void add(const TwampTimestamps &rx, uint64_t read_ns) {
+        if (!rx.sw || read_ns < rx.sw)
+            return;
+        double us = (read_ns - rx.sw) / 1e3;
+        ++count;
+        sum_us += us;
+        sum_sq_us += us * us;
+        max_us = std::max(max_us, us);
+    }
+    double mean_us() const { return count ? sum_us / count : 0.0; }
+    double jitter_us() const {
+        double mean = mean_us();
+        return count > 1 ? std::sqrt(std::max(0.0, sum_sq_us / count - mean * mean)) : 0.0;
+    }
+};
+
+//what twamp_enable_timestamping() managed to turn on
+enum {
+    TWAMP_TS_NONE = 0,
+    TWAMP_TS_KERNEL_RX,     //SO_TIMESTAMPNS, receive only
+    TWAMP_TS_KERNEL_TXRX,   //SO_TIMESTAMPING, send and receive
+};
+
+int twamp_enable_timestamping(int fd, bool hardware);
+//receive timestamps only, for the reflector
+int twamp_enable_rx_timestamping(int fd);
+bool twamp_enable_hw_timestamping(int fd, const std::string &ifname);
+//marks what fd sends with dscp (0-63), v4-mapped IPv4 included on a dual-stack socket
+bool twamp_set_dscp(int fd, int family, uint8_t dscp);
+/*
+ * Reads on fd spin on the device queue for up to usec before they sleep
+ * (SO_BUSY_POLL), and the kernel is told to prefer that to interrupts
+ * where it knows SO_PREFER_BUSY_POLL. Above net.core.busy_poll it needs
+ * CAP_NET_ADMIN; false if the kernel refused.
+ */
+bool twamp_set_busy_poll(int fd, unsigned int usec);
+//fills *ts from the timestamp control messages of a received message
+void twamp_parse_timestamps(msghdr *msg, TwampTimestamps *ts);
+//recvfrom that also returns the receive timestamps; from holds from_len bytes
+ssize_t twamp_recv(int fd, void *buf, size_t len, int flags, sockaddr *from, socklen_t from_len, TwampTimestamps *rx);
+//reads one send timestamp from the error queue; false once it is empty
+bool twamp_recv_tx_timestamp(int fd, uint32_t *id, TwampTimestamps *tx);
+
+/*
+ * RTT from the best pair of timestamps taken in the same clock: NIC on both
+ * ends, else kernel on both ends, else the user-space times around
+ * sendto()/recvmsg(). Mixing domains would be meaningless (the NIC clock is
+ * not the system clock).
+ */
+inline uint64_t twamp_rtt_ns(const TwampTimestamps &tx, const TwampTimestamps &rx, uint64_t user_tx, uint64_t user_rx){
+    if (tx.hw && rx.hw && rx.hw >= tx.hw)
+        return rx.hw - tx.hw;
+    if (rx.sw && rx.sw >= (tx.sw ? tx.sw : user_tx))
+        return rx.sw - (tx.sw ? tx.sw : user_tx);
+    return user_rx - user_tx;
+}
+
+/*
+ * Wire format, big-endian: sequence number (4), sender timestamp (8),
+ * reflector receive timestamp (8), reflector transmit timestamp (8).
+ * Reflectors predating the transmit timestamp answer with the first 20
+ * bytes only; their dwell time then reads as 0.
+ */
+#define TWAMP_LIGHT_PACKET_SIZE 28
+#define TWAMP_LIGHT_MIN_PACKET_SIZE 20
+//RFC 5357 unauthenticated reflector packet size, the default probe size
+#define TWAMP_LIGHT_RFC5357_SIZE 41
+//largest probe the reflector echoes back whole (jumbo frame payload)
+#define TWAMP_LIGHT_MAX_PACKET_SIZE 9000
+
 class TwampLightPacket{
     public:
     //packet contents
     uint32_t sequence_number;
     uint64_t sender_timestamp;
     uint64_t receiver_timestamp;
+    uint64_t transmit_timestamp;
+    //field offsets on the wire
+    static constexpr size_t seq_offset = 0;
+    static constexpr size_t sender_ts_offset = 4;
+    static constexpr size_t receiver_ts_offset = 12;
+    static constexpr size_t transmit_ts_offset = 20;
     //function to serialize the packet data into byte stream
     std::vector<uint8_t> serialize() const;
-    //function to deserialize
+    /*
+     * Serializes into buf and zero-pads up to padded_size, for probes sent
+     * at a given size. Returns the bytes written, or 0 if buf is too small.
+     */
+    size_t serialize_into(uint8_t *buf, size_t buf_len, size_t padded_size = TWAMP_LIGHT_PACKET_SIZE) const;
+    //decodes a probe or reply, all zeros if it does not parse (TwampLightPacketView::parse())
     static TwampLightPacket deserialize(const uint8_t* data, size_t length);
+    //time the probe spent inside the reflector, 0 if it did not say
+    uint64_t reflector_dwell_ns() const {
+        if (!receiver_timestamp || transmit_timestamp < receiver_timestamp)
+            return 0;
+        return transmit_timestamp - receiver_timestamp;
+    }
     //constructor
-    TwampLightPacket(uint32_t seq = 0, uint64_t sender_ts = 0, uint64_t receiver_ts = 0);
+    TwampLightPacket(uint32_t seq = 0, uint64_t sender_ts = 0, uint64_t receiver_ts = 0, uint64_t transmit_ts = 0);
+};
+
+static_assert(TwampLightPacket::transmit_ts_offset + 8 == TWAMP_LIGHT_PACKET_SIZE, "TWAMP-light layout");
+
+inline uint16_t twamp_get_be16(const uint8_t *p){
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return ntohs(v);
+}
+
+inline uint32_t twamp_get_be32(const uint8_t *p){
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return ntohl(v);
+}
+
+inline uint64_t twamp_get_be64(const uint8_t *p){
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return be64toh(v);
+}
+
+/*
+ * A received probe or reply read in place, for the receive paths: nothing
+ * is copied and each field is decoded when asked for. parse() is the only
+ * way to get one and refuses anything shorter than the fields every
+ * reflector sends or longer than the largest probe, so no accessor can
+ * read past the packet whatever came off the wire. The transmit timestamp
+ * reads as 0 from reflectors predating it; whatever follows the fields
+ * (the padding of RFC 5357 sized probes and larger) is left alone.
+ */
+class TwampLightPacketView{
+    public:
+    static bool parse(const uint8_t *data, size_t length, TwampLightPacketView *view){
+        if (!data || length < TWAMP_LIGHT_MIN_PACKET_SIZE || length > TWAMP_LIGHT_MAX_PACKET_SIZE)
+            return false;
+        view->data = data;
+        view->len = length;
+        return true;
+    }
+    uint32_t sequence_number() const { return twamp_get_be32(data + TwampLightPacket::seq_offset); }
+    uint64_t sender_timestamp() const { return twamp_get_be64(data + TwampLightPacket::sender_ts_offset); }
+    uint64_t receiver_timestamp() const { return twamp_get_be64(data + TwampLightPacket::receiver_ts_offset); }
+    bool has_transmit_timestamp() const { return len >= TWAMP_LIGHT_PACKET_SIZE; }
+    uint64_t transmit_timestamp() const {
+        return has_transmit_timestamp() ? twamp_get_be64(data + TwampLightPacket::transmit_ts_offset) : 0;
+    }
+    size_t length() const { return len; }
+    //bytes past the fields
+    size_t padding() const { return has_transmit_timestamp() ? len - TWAMP_LIGHT_PACKET_SIZE : 0; }
+    //as TwampLightPacket::reflector_dwell_ns()
+    uint64_t reflector_dwell_ns() const {
+        uint64_t receiver_ts = receiver_timestamp(), transmit_ts = transmit_timestamp();
+        if (!receiver_ts || transmit_ts < receiver_ts)
+            return 0;
+        return transmit_ts - receiver_ts;
+    }
+    TwampLightPacket packet() const {
+        return TwampLightPacket(sequence_number(), sender_timestamp(), receiver_timestamp(), transmit_timestamp());
+    }
+
+    private:
+    const uint8_t *data {nullptr};
+    size_t len {0};
+};
+
+//round trip minus the reflector's dwell time, never below zero
+inline uint64_t twamp_network_rtt_ns(uint64_t rtt_ns, uint64_t dwell){
+    return dwell < rtt_ns ? rtt_ns - dwell : rtt_ns;
+}
+
+inline uint64_t twamp_network_rtt_ns(uint64_t rtt_ns, const TwampLightPacket &resp){
+    return twamp_network_rtt_ns(rtt_ns, resp.reflector_dwell_ns());
+}
+
+inline uint64_t twamp_network_rtt_ns(uint64_t rtt_ns, const TwampLightPacketView &resp){
+    return twamp_network_rtt_ns(rtt_ns, resp.reflector_dwell_ns());
+}
+
+/*
+ * STAMP (RFC 8762), unauthenticated, with the session identifier of RFC
+ * 8972. Sender packet: sequence number (4), timestamp (8), error
+ * estimate (2), SSID (2), zeros up to 44 bytes, so the reply is the same
+ * size. Reflector packet: its own sequence number (4), transmit timestamp
+ * (8), error estimate (2), SSID (2), receive timestamp (8), then the
+ * sender's sequence number (4), timestamp (8) and error estimate (2), 2
+ * zero bytes, the TTL the probe arrived with (1) and 3 zero bytes.
+ * Timestamps are NTP format (RFC 5905), or PTPv2 truncated where the Z bit
+ * of the error estimate of whoever wrote them is set.
+ *
+ * A STAMP probe is told from a TWAMP-light one by its size and error
+ * estimate: the multiplier is never 0 in STAMP, while a TWAMP-light probe
+ * has its zero receive timestamp there.
+ */
+#define TWAMP_STAMP_PACKET_SIZE 44
+
+//RFC 4656 error estimate: S (clock synchronized), Z (PTP format), 6 bits of scale, 8 of multiplier
+#define TWAMP_ERR_SYNC 0x8000
+#define TWAMP_ERR_PTP 0x4000
+
+//error estimate for a clock within error_ns of UTC, synchronized or not
+uint16_t twamp_error_estimate(bool synced, uint64_t error_ns);
+//the bound it gives, in nanoseconds
+uint64_t twamp_error_estimate_ns(uint16_t error_estimate);
+
+//NTP 32.32 fixed point from get_current_time_ns() time, and back
+uint64_t twamp_ntp_from_ns(uint64_t ns);
+uint64_t twamp_ns_from_ntp(uint64_t ntp);
+//a timestamp in the format the error estimate of its writer gives; PTP time is TAI, tai_offset_s ahead of UTC
+uint64_t twamp_ns_from_stamp(uint64_t ts, uint16_t error_estimate, int tai_offset_s);
+
+//the system clock as the kernel has it disciplined (NTP, or phc2sys from a PTP clock)
+struct TwampClockStatus{
+    bool synced {false};
+    //bound on the offset from UTC
+    uint64_t error_ns {0};
+    //TAI - UTC, 0 if the kernel was not told
+    int tai_offset_s {0};
+    //what STAMP packets carry, twamp_error_estimate() of the above
+    uint16_t error_estimate {0};
+};
+
+//read at most once a second per thread, adjtimex() being a system call
+TwampClockStatus twamp_clock_status();
+/*
+ * Take the clock as synchronized within error_ns whatever the kernel says,
+ * for PTP setups where phc2sys leaves the kernel's status alone; 0 goes
+ * back to asking the kernel.
+ */
+void twamp_clock_assume_synced(uint64_t error_ns);
+
+class TwampStampPacket{
+    public:
+    //sender packet
+    static constexpr size_t seq_offset = 0;
+    static constexpr size_t timestamp_offset = 4;
+    static constexpr size_t error_offset = 12;
+    static constexpr size_t ssid_offset = 14;
+    //reflector packet, after the fields it shares with the sender's
+    static constexpr size_t receive_ts_offset = 16;
+    static constexpr size_t sender_seq_offset = 24;
+    static constexpr size_t sender_ts_offset = 28;
+    static constexpr size_t sender_error_offset = 36;
+    static constexpr size_t sender_ttl_offset = 40;
+    //a sender packet into buf, zero-padded up to padded_size; 0 if buf is too small
+    static size_t serialize_into(uint8_t *buf, size_t buf_len, size_t padded_size, uint32_t seq, uint64_t timestamp_ns,
+                                 uint16_t error_estimate, uint16_t ssid);
+    //is the probe of length bytes a STAMP one, rather than TWAMP-light?
+    static bool is_probe(const uint8_t *data, size_t length);
+    /*
+     * Turns the STAMP probe into the reply in place, a stateless reflector
+     * answering with the probe's own sequence number. The transmit
+     * timestamp goes in with set_transmit() once it is known.
+     */
+    static void reflect(uint8_t *data, uint64_t receive_ns, uint16_t error_estimate, uint8_t ttl);
+    static void set_transmit(uint8_t *data, uint64_t transmit_ns);
+};
+
+static_assert(TwampStampPacket::sender_ttl_offset + 4 == TWAMP_STAMP_PACKET_SIZE, "STAMP layout");
+
+//a STAMP reply read in place, as TwampLightPacketView
+class TwampStampReplyView{
+    public:
+    static bool parse(const uint8_t *data, size_t length, TwampStampReplyView *view){
+        if (!data || length < TWAMP_STAMP_PACKET_SIZE || length > TWAMP_LIGHT_MAX_PACKET_SIZE)
+            return false;
+        view->data = data;
+        return true;
+    }
+    uint16_t ssid() const { return twamp_get_be16(data + TwampStampPacket::ssid_offset); }
+    uint32_t sender_sequence_number() const { return twamp_get_be32(data + TwampStampPacket::sender_seq_offset); }
+    //as the probe had it, in the sender's format
+    uint64_t sender_timestamp_raw() const { return twamp_get_be64(data + TwampStampPacket::sender_ts_offset); }
+    uint16_t error_estimate() const { return twamp_get_be16(data + TwampStampPacket::error_offset); }
+    //the reflector's clock, in get_current_time_ns() time
+    uint64_t receive_ns(int tai_offset_s) const {
+        return twamp_ns_from_stamp(twamp_get_be64(data + TwampStampPacket::receive_ts_offset), error_estimate(), tai_offset_s);
+    }
+    uint64_t transmit_ns(int tai_offset_s) const {
+        return twamp_ns_from_stamp(twamp_get_be64(data + TwampStampPacket::timestamp_offset), error_estimate(), tai_offset_s);
+    }
+    //both in the reflector's clock, the offset does not matter
+    uint64_t reflector_dwell_ns() const {
+        uint64_t rx = receive_ns(0), tx = transmit_ns(0);
+        return tx < rx ? 0 : tx - rx;
+    }
+
+    private:
+    const uint8_t *data {nullptr};
 };
 
 class TwampLightReflector{
     public:
-    TwampLightReflector(std::string ip, uint16_t port);
+    //reuseport lets several reflectors share the port, one socket each
+    //an IPv6 ip ("::" for any) gives a dual-stack socket answering both families
+    TwampLightReflector(std::string ip, uint16_t port, bool debug = false, bool reuseport = false);
+    //steer each probe to socket (receiving CPU % nr_sockets) of the reuseport group
+    bool attach_cpu_steering(unsigned int nr_sockets);
     void run();
+    //recvmmsg/sendmmsg loop, timestamps rewritten in place (Linux only)
+    void run_batched();
+    /*
+     * Reflects off PACKET_MMAP rings on ifname, bypassing the UDP socket
+     * layer; returns only if the rings cannot be set up. Reflectors with
+     * the same fanout_group (non-zero) share the probes by receiving CPU.
+     */
+    bool run_packet_ring(const std::string &ifname, uint16_t fanout_group = 0);
+    /*
+     * Busy polling, for a reflector with a core of its own: the socket
+     * spins on the device queue for up to usec, and run_batched() never
+     * sleeps in recvmmsg() but keeps asking. 0 turns it off.
+     */
+    bool set_busy_poll(unsigned int usec);
+    //log how late run_batched() reads its probes every interval_sec, 0 for never
+    void report_wakeup(unsigned int interval_sec) { wakeup_report_sec = interval_sec; }
 
     private:
     uint16_t listen_port;
     int sockfd;
     std::string ipaddr;
+    bool debug;
+    unsigned int busy_poll_us {0};
+    unsigned int wakeup_report_sec {0};
+    TwampWakeupStats wakeup;
+    uint64_t wakeup_since {0};
+#if defined(__linux__)
+    //probes taken per recvmmsg() call
+    static const unsigned int batch_size = 32;
+    //receive buffers and headers for one batch, set up once
+    std::vector<uint8_t> buffers;
+    std::vector<uint8_t> controls;
+    std::vector<sockaddr_in6> peers;
+    std::vector<iovec> iovs;
+    std::vector<mmsghdr> msgs;
+    //the well-formed subset of a batch, sent back in one sendmmsg(), and which of them are STAMP
+    std::vector<mmsghdr> replies;
+    std::vector<uint8_t> reply_stamp;
+#endif
 };
 
 class TwampLightSender{
     public:
-    TwampLightSender(const std::string& reflector_ip, uint16_t reflector_port);
+    TwampLightSender(const std::string& reflector_ip, uint16_t reflector_port, size_t packet_size = TWAMP_LIGHT_RFC5357_SIZE,
+                     uint8_t dscp = 0);
     std::unordered_map<std::string, double> run(int num_packets, int interval_ms, int timeout_interval_ms);
 
     private:
     std::string reflector_ip;
     uint16_t reflector_port;
+    size_t packet_size;
+    int sockfd;
+    int ts_mode;
+};
+
+//one source port of an ECMP sweep, see TwampLightProbeEngine::set_flows()
+struct TwampFlowResult{
+    uint16_t port {0};
+    double min_rtt_ms {0.0};
+    double avg_rtt_ms {0.0};
+    int received {0};
+};
+
+//per-peer outcome of one probe cycle
+struct TwampProbeResult{
+    double avg_rtt_ms {0.0};
+    double median_rtt_ms {0.0};
+    //nearest-rank 90th percentile
+    double p90_rtt_ms {0.0};
+    //the statistic that is published, see twamp_smooth_rtt()
+    double rtt_ms {0.0};
+    double jitter_ms {0.0};
+    double loss {100.0};
+    int received {0};
+    //with an ECMP sweep: each flow, and how far apart their minimum RTTs are
+    std::vector<TwampFlowResult> flows;
+    double spread_ms {0.0};
+    /*
+     * STAMP with both clocks synchronized: median delay towards the peer
+     * and back, from one_way of the replies, good to within clock_error_ms
+     */
+    int one_way {0};
+    double forward_ms {0.0};
+    double reverse_ms {0.0};
+    double clock_error_ms {0.0};
+    //how late the replies were read after the kernel timestamped them, over wakeups of them
+    int wakeups {0};
+    double wakeup_us {0.0};
+    double wakeup_jitter_us {0.0};
+};
+
+//which statistic of a peer's RTTs is published as its latency
+enum TwampRttStat {
+    TWAMP_RTT_MEAN = 0,
+    TWAMP_RTT_MEDIAN,
+    TWAMP_RTT_P90,
+    //EWMA across cycles of each cycle's median
+    TWAMP_RTT_EWMA,
+};
+
+//false if name is none of mean, median, p90, ewma
+bool twamp_parse_rtt_stat(const std::string &name, int *stat);
+/*
+ * Sets res.rtt_ms to the configured statistic. ewma_ms is the peer's
+ * running average, 0 until its first reply; a cycle without replies
+ * leaves it alone.
+ */
+void twamp_smooth_rtt(TwampProbeResult &res, int stat, double alpha, double &ewma_ms);
+
+/*
+ * Bounded single-producer single-consumer queue, handing work between two
+ * threads without a lock: only the producer moves tail, only the consumer
+ * head, each on a cache line of its own. Neither side ever waits; push()
+ * fails when full and pop() when empty, waking the other side is up to
+ * the caller.
+ */
+template <typename T> class TwampSpscRing{
+    public:
+    //capacity is rounded up to a power of two
+    explicit TwampSpscRing(size_t capacity): head(0), tail(0) {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+    bool push(T &&value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask)
+            return false;
+        slots[t & mask] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    bool pop(T &value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        value = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+
+    private:
+    std::vector<T> slots;
+    size_t mask;
+    std::atomic<size_t> head;
+    char head_pad[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail;
+    char tail_pad[64 - sizeof(std::atomic<size_t>)];
+};
+
+/*
+ * Probe rate limit, as a GCRA: rate_pps on average with up to burst sent
+ * back to back. Times are get_current_time_ns(); not thread-safe, one
+ * sender thread drives every engine sharing one.
+ */
+class TwampTokenBucket{
+    public:
+    explicit TwampTokenBucket(uint64_t rate_pps = 0, uint32_t burst = 1) { set(rate_pps, burst); }
+    //0 for no limit
+    void set(uint64_t rate_pps, uint32_t burst);
+    bool limited() const { return emission_ns != 0; }
+    uint64_t rate() const { return limited() ? 1000000000ULL / emission_ns : 0; }
+    //the earliest a packet may leave, not before now
+    uint64_t ready_at(uint64_t now) const { return tat > now + tolerance_ns ? tat - tolerance_ns : now; }
+    //when a whole burst may go back to back again
+    uint64_t refilled_at() const { return tat; }
+    //a packet leaves at ready_at() or later
+    void take(uint64_t at) { if (limited()) tat = std::max(tat, at) + emission_ns; }
+
+    private:
+    uint64_t emission_ns {0};
+    uint64_t tolerance_ns {0};
+    //theoretical arrival time of the next packet
+    uint64_t tat {0};
+};
+
+#if defined(TWAMP_HAVE_IO_URING)
+#include <linux/io_uring.h>
+
+/*
+ * The little of io_uring the probe engine needs, straight on the system
+ * calls: one submission and one completion ring, driven by one thread.
+ */
+class TwampUring{
+    public:
+    TwampUring(): fd(-1) {}
+    ~TwampUring();
+    //false if the kernel has no io_uring or it is not allowed here
+    bool init(unsigned int entries);
+    bool ready() const { return fd >= 0; }
+    //a zeroed submission entry, nullptr while the ring is full (submit() first)
+    io_uring_sqe *get_sqe();
+    //hands the kernel what get_sqe() gave out, waiting for wait_nr completions
+    int submit(unsigned int wait_nr = 0);
+    //the oldest completion, false if there is none; seen() once done with it
+    bool peek(io_uring_cqe **cqe);
+    void seen();
+    //successful completions can be left out (IOSQE_CQE_SKIP_SUCCESS)
+    bool can_skip_success() const { return features & IORING_FEAT_CQE_SKIP; }
+
+    private:
+    int fd;
+    uint32_t features {0};
+    uint8_t *sq_ptr {nullptr};
+    uint8_t *cq_ptr {nullptr};
+    size_t sq_size {0};
+    size_t cq_size {0};
+    io_uring_sqe *sqes {nullptr};
+    size_t sqes_size {0};
+    uint32_t *sq_head {nullptr};
+    uint32_t *sq_tail {nullptr};
+    uint32_t *sq_array {nullptr};
+    uint32_t sq_mask {0};
+    uint32_t sq_entries {0};
+    uint32_t *cq_head {nullptr};
+    uint32_t *cq_tail {nullptr};
+    uint32_t cq_mask {0};
+    io_uring_cqe *cqes {nullptr};
+    //entries handed out, and how many of them the kernel took
+    uint32_t local_tail {0};
+    uint32_t submitted {0};
+};
+#endif
+
+//probes many reflectors at once from a single non-blocking socket
+class TwampLightProbeEngine{
+    public:
+    //hw_ifname enables NIC timestamps on that interface, if it supports them
+    //packet_size pads every probe to that many bytes
+    //vrf_ifname binds the socket to a VRF device, so probes follow that VRF's routes
+    TwampLightProbeEngine(uint16_t reflector_port, const std::string& hw_ifname = "", size_t packet_size = TWAMP_LIGHT_RFC5357_SIZE,
+                          const std::string& vrf_ifname = "");
+    ~TwampLightProbeEngine();
+    std::unordered_map<std::string, TwampProbeResult> run(const std::vector<std::string>& peers, int num_packets, int interval_ms, int timeout_ms);
+    //same, results in the order of peers; IPv4 peers are given v4-mapped
+    std::vector<TwampProbeResult> run(const std::vector<in6_addr>& peers, int num_packets, int interval_ms, int timeout_ms);
+    //false if binding to the VRF device failed
+    bool bound() const { return reachable; }
+    //reflector port of the runs from now on
+    void set_port(uint16_t port) { reflector_port = port; }
+    //read and timestamp replies on a thread of their own; run() then only matches what it queued
+    bool start_rx_thread();
+    //replies the RX thread found no room for in its queue
+    uint64_t rx_dropped() const { return rx_drops.load(std::memory_order_relaxed); }
+    /*
+     * Send and receive through io_uring instead: a round goes out in one
+     * submission, replies land in receives kept posted on the socket and
+     * the pacing and timeout are kernel timers. false without io_uring,
+     * or if the RX thread already reads the socket.
+     */
+    bool start_uring();
+    /*
+     * Rate limits on the probes sent: global is shared with the other
+     * engines, engine_pps caps this one's socket, the device it is bound
+     * to, and peer_pps stretches the interval so no peer gets more. 0 is
+     * no limit. txtime hands the spacing within a burst to the qdisc
+     * (SO_TXTIME, fq or etf) instead of waking up for every probe; it
+     * needs kernel send timestamps, false without them.
+     */
+    bool set_pacing(TwampTokenBucket *global, uint64_t engine_pps, uint32_t burst, uint64_t peer_pps, bool txtime);
+    /*
+     * ECMP sweep: probe from flows sockets, each with a source port of its
+     * own, so the underlay hashes the probes onto its different paths; on
+     * IPv6 the kernel derives the flow label from the ports, so it varies
+     * along. Every round then sends one probe per flow to each peer, and
+     * the results give each flow's RTT. Before start_rx_thread() or
+     * start_uring(), which cannot serve more than one socket; false if
+     * either runs already.
+     */
+    bool set_flows(unsigned int flows);
+    size_t nr_flows() const { return flow_ports.size(); }
+    /*
+     * Traffic class of the probes, DSCP 0-63, on every flow's socket.
+     * The reflector sends the reply back with the class of the probe
+     * only if it copies it, as RFC 5357 has it; either way the RTT is
+     * that of the class at least on the way out.
+     */
+    bool set_dscp(uint8_t dscp);
+    uint8_t dscp() const { return probe_dscp; }
+    /*
+     * Send STAMP probes (RFC 8762) instead of TWAMP-light ones. Reflectors
+     * answering in STAMP say whether their clock is synchronized; where
+     * both ends' are, the results carry the one-way delay each way too.
+     * Reflectors predating STAMP echo the probe as a TWAMP-light one and
+     * are measured as before.
+     */
+    void set_stamp(bool on);
+    /*
+     * For an engine with cores to itself: reads spin on the device queue
+     * for up to usec (SO_BUSY_POLL) and the RX thread polls its sockets
+     * without ever sleeping. The RX thread is pinned to cpu (-1 to leave
+     * it) and, with a priority 1-99, scheduled SCHED_FIFO. Before
+     * start_rx_thread(); busy polling on flows added later too.
+     */
+    bool set_busy_poll(unsigned int usec);
+    void set_rx_isolation(int cpu, int fifo_priority) { rx_cpu = cpu; rx_fifo_priority = fifo_priority; }
+
+    private:
+    //a probe socket set up like the first, -1 if none can be opened; *mode is the timestamping it got
+    int open_socket(int *mode);
+    int flow_fd(size_t flow) const { return flow ? flow_fds[flow - 1] : sockfd; }
+    //true with *at when the next probe may leave under every limit: now, or
+    //with txtime up to txtime_ahead_ns later; else false with *at when to try again
+    bool pace_probe(uint64_t now, uint64_t *at);
+    //send_buffer to targets[t] from the socket of flow, to leave the qdisc at txtime_at if not 0
+    ssize_t send_probe(size_t t, size_t flow, size_t len, uint64_t txtime_at);
+    void probe_epoll(int num_packets, uint64_t interval_ns, uint64_t timeout_ns);
+    void drain(uint64_t timeout_ns);
+    void drain_tx_timestamps();
+    void handle_tx_timestamp(size_t flow, uint32_t id, const TwampTimestamps &tx);
+    void handle_reply(const uint8_t *buf, ssize_t len, const sockaddr_in6 &from, const TwampTimestamps &rx, uint64_t recv_time, uint64_t timeout_ns);
+    //the probe with seq, sent at send_time, into buf padded up to size
+    size_t build_probe(uint8_t *buf, size_t size, uint32_t seq, uint64_t send_time) const;
+    //what the RX thread read off the socket: a reply, or a send timestamp from the error queue
+    struct rx_record{
+        bool tx_timestamp;
+        uint16_t flow;
+        uint32_t tx_id;
+        ssize_t len;
+        sockaddr_in6 from;
+        TwampTimestamps ts;
+        uint64_t recv_time;
+        //the fields of either reply format, not the padding
+        uint8_t data[TWAMP_STAMP_PACKET_SIZE];
+    };
+    void rx_main();
+    std::unique_ptr<TwampSpscRing<rx_record>> rx_ring;
+    std::thread rx_thread;
+    std::atomic<bool> rx_stop {false};
+    std::atomic<uint64_t> rx_drops {0};
+    //the RX thread's own wait on the socket, and how it wakes run()
+    int rx_epfd {-1};
+    int rx_eventfd {-1};
+#if defined(TWAMP_HAVE_IO_URING)
+    void probe_uring(int num_packets, uint64_t interval_ns, uint64_t timeout_ns);
+    bool uring_post_recv(size_t slot);
+    bool uring_post_timer(uint64_t at_ns);
+    //from round_pos on; 0 once the round is out, else when the pacing lets it go on
+    uint64_t uring_send_round();
+    std::unique_ptr<TwampUring> uring;
+    //a receive kept posted on the socket
+    struct uring_recv{
+        msghdr msg;
+        iovec iov;
+        sockaddr_in6 from;
+        uint8_t data[TWAMP_STAMP_PACKET_SIZE];
+        uint8_t control[64];
+    };
+    std::vector<uring_recv> uring_recvs;
+    //one send per target and round, the buffers live until the next round
+    std::vector<msghdr> uring_send_msgs;
+    std::vector<iovec> uring_send_iovs;
+    std::vector<uint8_t> uring_send_bufs;
+    //SCM_TXTIME of each send, with txtime
+    std::vector<uint8_t> uring_send_ctrls;
+    //only the latest timer counts, older ones complete into nothing
+    uint64_t uring_timer {0};
+    //read by the kernel when the timer is submitted
+    __kernel_timespec uring_ts {};
+#endif
+    //next probe of the round being sent, the round's size between rounds
+    size_t round_pos {0};
+    TwampTokenBucket *pacer {nullptr};
+    TwampTokenBucket engine_pacer;
+    uint64_t peer_interval_ns {0};
+    //with SO_TXTIME, how far ahead of now a probe may be queued
+    uint64_t txtime_ahead_ns {0};
+    //wakes probe_epoll() when the pacing lets the next probe go
+    int pace_fd {-1};
+    uint16_t reflector_port;
+    //what every probe socket is set up with
+    std::string hw_ifname;
+    std::string vrf_ifname;
+    uint8_t probe_dscp {0};
+    unsigned int busy_poll_us {0};
+    int rx_cpu {-1};
+    int rx_fifo_priority {0};
+    //STAMP probes, the session identifier they carry, and the local clock as of this run
+    bool stamp {false};
+    uint16_t stamp_ssid {0};
+    TwampClockStatus clock;
+    //probe buffer, sized once to the padded probe size
+    std::vector<uint8_t> send_buffer;
     int sockfd;
-};
\ No newline at end of file
+    //AF_INET6 (dual-stack), or AF_INET where the host has no IPv6
+    int family;
+    int epfd;
+    //false if the socket could not be bound to its VRF: every probe is lost
+    bool reachable;
+    uint32_t next_seq;
+    int ts_mode;
+    //the sockets of flows 1 and on of an ECMP sweep, and the source port of each flow
+    std::vector<int> flow_fds;
+    std::vector<uint16_t> flow_ports;
+    //SOF_TIMESTAMPING_OPT_ID counters, per flow: one per datagram sent on its socket
+    std::vector<uint32_t> next_tx_ids;
+    //probes in flight, keyed by sequence number
+    struct pending_probe{
+        size_t target;
+        uint16_t flow;
+        uint64_t send_time;
+        TwampTimestamps tx;
+    };
+    //by flow << 32 | OPT_ID
+    std::unordered_map<uint64_t, uint32_t> tx_id_to_seq;
+    struct probe_target{
+        union {
+            sockaddr sa;
+            sockaddr_in sin;
+            sockaddr_in6 sin6;
+        } addr;
+        //0 if the socket cannot reach the peer's family
+        socklen_t addr_len;
+        std::vector<double> rtts_ms;
+        //the flow each of rtts_ms came back on
+        std::vector<uint16_t> rtt_flows;
+        //STAMP replies from a synchronized reflector: the delay each way, and the two clocks' error bound
+        std::vector<double> forward_ms;
+        std::vector<double> reverse_ms;
+        uint64_t clock_error_ns;
+        TwampWakeupStats wakeup;
+    };
+    std::unordered_map<uint32_t, pending_probe> pending;
+    std::vector<probe_target> targets;
+    bool same_peer(const probe_target &target, const sockaddr_in6 &from) const;
+};
+
+//address key of the peer table, IPv4 or IPv6 in network byte order
+struct TwampPeerKey{
+    uint8_t family {0};
+    uint8_t addr[16] {};
+    //ifindex of the VRF device the peer is reached through, 0 for the default VRF
+    uint32_t vrf {0};
+    //traffic class probed, as bgpd asks for it; a peer is measured once per class
+    uint8_t dscp {0};
+    //false if s is neither an IPv4 nor an IPv6 address
+    static bool parse(const std::string &s, TwampPeerKey *key);
+    //the key of a v4-mapped address is the plain IPv4 one
+    static TwampPeerKey from_in6(const in6_addr &addr, uint32_t vrf = 0);
+    //IPv6 form, v4-mapped for IPv4, as bgpd's segment and the engine take it
+    in6_addr to_in6() const;
+    //the address, with %vrf appended outside the default VRF and " dscp N" outside the default class
+    std::string str() const;
+    bool operator==(const TwampPeerKey &o) const {
+        return family == o.family && vrf == o.vrf && dscp == o.dscp && memcmp(addr, o.addr, sizeof(addr)) == 0;
+    }
+};
+
+//the peer table's hash, for standard containers keyed by peer
+struct TwampPeerKeyHash{
+    size_t operator()(const TwampPeerKey &key) const;
+};
+
+//per-peer state kept by the agent
+struct latency_data{
+    //published RTT of the last cycle in microseconds, 0 if nothing came back
+    uint64_t latency {0};
+    //running EWMA of the RTT in milliseconds, for TWAMP_RTT_EWMA
+    double ewma_ms {0.0};
+    //latency moved by a good part of the damping threshold last time
+    bool spike {false};
+    //probe scheduling state, see TwampProbeScheduler
+    float weight {1.0f};
+    uint32_t sched_gen {0};
+    //the bgpd slot the peer was read from, in bgpd mode
+    uint32_t shm_slot {0};
+    uint16_t shm_epoch {0};
+    //false for landmarks probed only for the aggregator, see TwampAggregator
+    bool in_shm {false};
+    //bgpd's probe profile for the peer, 0 for the agent's own setting
+    uint64_t cycle_ms {0};
+    uint8_t packet_count {0};
+};
+
+/*
+ * Flat open-addressing table of peers: linear probing over a power-of-two
+ * array, tombstones on erase, rehashed once live plus dead slots pass 3/4.
+ * Copying it is a single vector copy of plain structs, which is what the
+ * sender does to publish a snapshot.
+ */
+class TwampPeerTable{
+    public:
+    TwampPeerTable(): count(0), used(0) {}
+    latency_data *find(const TwampPeerKey &key);
+    const latency_data *find(const TwampPeerKey &key) const;
+    //the entry for key, added with default data if missing
+    latency_data &insert(const TwampPeerKey &key);
+    bool erase(const TwampPeerKey &key);
+    size_t size() const { return count; }
+    template <typename F> void for_each(F f) {
+        for (auto &s: slots)
+            if (s.state == slot_used)
+                f(s.key, s.data);
+    }
+    template <typename F> void for_each(F f) const {
+        for (const auto &s: slots)
+            if (s.state == slot_used)
+                f(s.key, s.data);
+    }
+
+    private:
+    enum : uint8_t { slot_empty = 0, slot_used, slot_dead };
+    struct slot{
+        TwampPeerKey key;
+        latency_data data;
+        uint8_t state {slot_empty};
+    };
+    size_t locate(const TwampPeerKey &key) const;
+    void rehash(size_t capacity);
+    std::vector<slot> slots;
+    size_t count;
+    //live plus tombstoned slots
+    size_t used;
+};
+
+/*
+ * Hashed timer wheel after FRR's lib/wheel.c: nr_slots buckets of tick_ms
+ * each, an entry goes into the bucket of its due tick and stays there for
+ * as many rotations as it needs. Adding is O(1), and expire() only looks at
+ * the buckets of the ticks that have passed.
+ */
+class TwampTimerWheel{
+    public:
+    struct entry{
+        TwampPeerKey key;
+        uint32_t gen;
+        float weight;
+        uint64_t due_tick;
+    };
+    TwampTimerWheel(uint64_t tick_ms, unsigned int nr_slots, uint64_t now_ms);
+    void add(const TwampPeerKey &key, uint32_t gen, float weight, uint64_t due_ms);
+    //moves every entry due by now_ms into out
+    void expire(uint64_t now_ms, std::vector<entry> &out);
+    uint64_t tick() const { return tick_ms; }
+
+    private:
+    uint64_t tick_ms;
+    //next tick expire() has not looked at yet
+    uint64_t current_tick;
+    std::vector<std::vector<entry>> slots;
+};
+
+/*
+ * Spreads the probes of every peer over the probe cycle instead of
+ * probing all of them in one burst, and adapts how often each peer is
+ * probed. Every peer has a weight in [min_weight, max_weight]: it doubles
+ * when the peer's latency moved by a quarter of the damping threshold or
+ * more, or when nothing came back; it halves otherwise. A peer's
+ * interval is cycle * mean weight / weight, so the total probe rate
+ * stays at one probe round per peer per cycle. The cycle
+ * is the peer's own when bgpd asks for one (latency_data::cycle_ms).
+ */
+class TwampProbeScheduler{
+    public:
+    TwampProbeScheduler(unsigned int cycle_sec, uint32_t damping_threshold_ms);
+    //schedule a new peer at a random point within the next cycle
+    void add(const TwampPeerKey &key, latency_data &data);
+    //the peer's cycle changed; a shorter one should not wait out the old slot
+    void reprofile(const TwampPeerKey &key, latency_data &data, uint64_t old_cycle_ms);
+    //peers of table that are due; entries of peers since removed are dropped
+    void due(TwampPeerTable &table, std::vector<TwampPeerKey> &out);
+    //record a result, adapt the peer's weight and schedule its next probe
+    void update(TwampPeerTable &table, const TwampPeerKey &key, const TwampProbeResult &res);
+    uint64_t tick_ms() const { return wheel.tick(); }
+    //new agent-wide cycle and damping threshold, for peers as they are next scheduled
+    void configure(unsigned int cycle_sec, uint64_t damping_threshold_us);
+
+    private:
+    //the peer's own probe cycle if bgpd gave it one, else the agent's
+    uint64_t peer_cycle_ms(const latency_data &data) const { return data.cycle_ms ? data.cycle_ms : cycle_ms; }
+    uint64_t interval_ms(float weight, uint64_t cycle) const;
+    uint64_t cycle_ms;
+    uint64_t threshold_us;
+    TwampTimerWheel wheel;
+    //weights of the peers on the wheel, for the mean
+    double total_weight;
+    size_t nr_peers;
+    uint32_t next_gen;
+    mutable std::mt19937 rng;
+};
+
+/*
+ * Prometheus exporter: results of each peer's last round plus running
+ * probe counters, served as text exposition format on GET /metrics from
+ * a thread of its own. The sender records after each round; a scrape only
+ * holds the lock while the page is formatted, never across a probe run.
+ */
+class TwampMetricsExporter{
+    public:
+    TwampMetricsExporter(): listen_fd(-1) {}
+    ~TwampMetricsExporter();
+    //listen on port and start serving; false if the socket cannot be set up
+    bool start(int port);
+    //one round of a peer: sent probes and what came back
+    void record(const TwampPeerKey &key, const TwampProbeResult &res, int sent);
+    //the peer is no longer probed, drop its series
+    void forget(const TwampPeerKey &key);
+
+    private:
+    struct peer_metrics{
+        //labels of the peer's series, formatted once
+        std::string labels;
+        TwampProbeResult last;
+        uint64_t rounds {0};
+        uint64_t sent {0};
+        uint64_t received {0};
+        time_t updated {0};
+    };
+    static std::string peer_labels(const TwampPeerKey &key);
+    std::string render() const;
+    void serve();
+    void answer(int fd) const;
+    mutable std::mutex lock;
+    std::unordered_map<std::string, peer_metrics> peers;
+    uint64_t rounds_total {0};
+    int listen_fd;
+};
+
+/*
+ * Latency matrix shared between agents, instead of every PE probing every
+ * other one. Agents in bgpd mode report each round to one aggregator and
+ * tell it the next-hops bgpd wants; it answers with the ones to probe
+ * themselves and sends the latency of the others as the matrix has it.
+ *
+ * A pair of agents is probed by one side only, RTT being the same both
+ * ways. With landmarks, agents probe only the landmarks (the lowest
+ * addressed agents) and next-hops that are not agents, and the latency
+ * between two other agents is composed through the landmark giving the
+ * shortest sum: O(N * landmarks) probes instead of O(N^2), for an upper
+ * bound of the latency.
+ *
+ * One TCP connection per agent, one line per message:
+ *   agent:      HELLO <own address> | NEED <address>... | RESULT <address> <rtt_us|-> <loss_permille>
+ *   aggregator: PROBE <address>...  | LATENCY <address> <rtt_us|-> <loss_permille>
+ * Only the default VRF is shared.
+ */
+class TwampAggregator{
+    public:
+    TwampAggregator(): listen_fd(-1) {}
+    ~TwampAggregator();
+    //listen on port and start serving; false if the socket cannot be set up
+    bool start(int port, unsigned int landmarks);
+
+    private:
+    struct measurement{
+        uint32_t rtt_us;
+        uint16_t loss_permille;
+        time_t updated;
+    };
+    typedef std::unordered_map<TwampPeerKey, measurement, TwampPeerKeyHash> row;
+    typedef std::unordered_map<TwampPeerKey, bool, TwampPeerKeyHash> key_set;
+    struct agent{
+        int fd;
+        std::string in;
+        std::string out;
+        //false until HELLO
+        bool known {false};
+        TwampPeerKey self;
+        std::vector<TwampPeerKey> needs;
+        key_set need_set;
+        //what the agent was last told to probe
+        std::vector<TwampPeerKey> probes;
+        key_set probe_set;
+        //what it was last told of the rest
+        row sent;
+    };
+    void serve();
+    void handle_line(agent &a, const std::string &line);
+    void drop(size_t i);
+    //PROBE sets after agents came, went or changed their needs
+    void assign();
+    //LATENCY for the shared needs whose value moved
+    void share();
+    bool is_landmark(const TwampPeerKey &key) const;
+    //the pair's RTT from either side, false if neither measured it lately
+    bool direct(const TwampPeerKey &a, const TwampPeerKey &b, measurement *m) const;
+    //direct, else through the best landmark
+    measurement estimate(const TwampPeerKey &a, const TwampPeerKey &b) const;
+    std::vector<std::unique_ptr<agent>> agents;
+    std::unordered_map<TwampPeerKey, agent *, TwampPeerKeyHash> by_self;
+    //rows by reporting agent, kept across reconnects
+    std::unordered_map<TwampPeerKey, row, TwampPeerKeyHash> matrix;
+    std::vector<TwampPeerKey> landmark_keys;
+    unsigned int nr_landmarks {0};
+    bool membership_dirty {false};
+    bool results_dirty {false};
+    int listen_fd;
+};
+
+//an agent's side of the connection to the aggregator
+class TwampAggregatorClient{
+    public:
+    struct shared{
+        TwampPeerKey key;
+        //UINT32_MAX if unmeasured
+        uint32_t rtt_us;
+        uint16_t loss_permille;
+    };
+    //server is host:port; self is the address the other agents probe this one at
+    TwampAggregatorClient(const std::string &server, const TwampPeerKey &self);
+    ~TwampAggregatorClient();
+    //what bgpd wants measured, replacing what was there
+    void need(const std::vector<TwampPeerKey> &keys);
+    //probe key here? Everything is, as long as the aggregator has not said otherwise
+    bool probes(const TwampPeerKey &key) const;
+    //peers to probe that bgpd did not ask for, the landmarks
+    std::vector<TwampPeerKey> extra_probes(const std::vector<TwampPeerKey> &bgpd_keys) const;
+    //changes whenever what probes() says does
+    uint32_t assignment_gen() const;
+    //results of a round, for the matrix
+    void report(const std::vector<TwampPeerKey> &keys, const std::vector<TwampProbeResult> &results);
+    //shared latencies that changed since the last call, or every one of them
+    std::vector<shared> take_updates(bool all);
+
+    private:
+    void run();
+    bool connect_server();
+    void handle_line(const std::string &line);
+    std::string host;
+    std::string port;
+    TwampPeerKey self;
+    mutable std::mutex lock;
+    std::vector<TwampPeerKey> wanted;
+    //empty until the aggregator assigns, and again once it is gone
+    bool assigned {false};
+    std::unordered_map<TwampPeerKey, bool, TwampPeerKeyHash> probe_set;
+    uint32_t gen {0};
+    std::unordered_map<TwampPeerKey, shared, TwampPeerKeyHash> latest;
+    std::vector<TwampPeerKey> changed;
+    std::string out;
+    int fd {-1};
+    int wake_fd {-1};
+    std::atomic<bool> stop {false};
+    std::thread worker;
+};
+
+struct twamp_shm;
+
+/*
+ * Native client of bgpd's shared-memory segment (frr/bgpd/bgp_twamp_ipc.h):
+ * reads the active next-hops it should probe and publishes their latency
+ * back, then wakes bgpd through the notification eventfd.
+ */
+class TwampShmAgent{
+    public:
+    //a next-hop slot as read from the segment
+    struct target{
+        uint32_t slot;
+        uint16_t epoch;
+        //the segment key: IPv6, or v4-mapped IPv4, in VRF device vrf_ifindex
+        in6_addr addr;
+        uint32_t vrf_ifindex;
+        //traffic class of the probes, part of the key as well
+        uint8_t dscp;
+        //bgpd's probe profile, 0 for the agent's own setting
+        uint16_t probe_cycle_sec;
+        uint8_t packet_count;
+    };
+    //bgpd's agent-wide settings, 0 (or no damping) for the agent's own
+    struct settings{
+        //changes whenever bgpd changes them
+        uint32_t gen;
+        uint16_t port;
+        uint16_t probe_cycle_sec;
+        uint8_t packet_count;
+        bool has_damping;
+        uint32_t damping_threshold_us;
+    };
+    TwampShmAgent();
+    ~TwampShmAgent();
+    //map and validate the segment; false if bgpd has not created it (yet)
+    bool attach();
+    void detach();
+    bool attached() const { return shm != nullptr; }
+    //bgpd grew the segment or was restarted: the mapping must be re-opened
+    bool stale() const;
+    //consistent snapshot of the active next-hops
+    std::vector<target> active_targets() const;
+    //changes whenever bgpd changes the set of next-hops
+    uint32_t membership_gen() const;
+    //false if not attached, or bgpd kept changing them
+    bool config(settings *cfg) const;
+    //publish the results of one cycle and notify bgpd; returns the segment's new sequence, 0 if not published
+    uint32_t publish(const std::vector<target>& targets, const std::vector<TwampProbeResult>& results);
+
+    private:
+    void connect_notify();
+    twamp_shm *shm;
+    size_t map_size;
+    //inode of the mapped segment, to notice bgpd replacing it
+    ino_t map_ino;
+    int notify_fd;
+};
+
+//bgpd's notification eventfd, -1 if bgpd does not serve it
+int twamp_notify_connect();
+
+struct twamp_egress_shm;
+
+/*
+ * Client of bgpd's egress segment: times TCP handshakes towards each
+ * destination out of the exit of its entry, by the exit's fwmark
+ * (SO_MARK, which needs CAP_NET_ADMIN). A SYN-ACK or a RST ends the
+ * handshake alike, so any host answering on port measures, whatever it
+ * runs; the connection is reset rather than closed, leaving nothing
+ * behind on either side. The destinations are sampled in turn, as many
+ * a second as a rate of handshakes allows.
+ */
+class TwampEgressProber{
+    public:
+    //handshakes per destination and round, and how long one may take
+    TwampEgressProber(uint16_t port, int packet_count, int timeout_ms);
+    ~TwampEgressProber();
+    //map and validate the segment; false if bgpd has not created it (yet)
+    bool attach();
+    void detach();
+    bool attached() const { return shm != nullptr; }
+    //bgpd replaced the segment or was restarted
+    bool stale() const;
+    //destinations in the segment as last read
+    size_t size() const { return targets.size(); }
+    //probe the next destinations for one second at up to rate handshakes a second and publish them; returns how many
+    unsigned int run(unsigned int rate);
+
+    private:
+    struct target{
+        uint32_t slot;
+        uint16_t epoch;
+        in6_addr dest;
+        uint32_t mark;
+    };
+    bool refresh_targets();
+    void probe(const std::vector<target>& batch, std::vector<TwampProbeResult>& results);
+    twamp_egress_shm *shm;
+    size_t map_size;
+    ino_t map_ino;
+    int notify_fd;
+    int epfd;
+    uint16_t port;
+    int packet_count;
+    int timeout_ms;
+    //gen of the membership in targets; odd never matches a stable one
+    uint32_t synced_gen;
+    std::vector<target> targets;
+    size_t next;
+};
+
+/*
+ * Running as a system service. The notification protocol is spoken
+ * directly on $NOTIFY_SOCKET, so there is no dependency on libsystemd;
+ * outside systemd these do nothing.
+ */
+//sd_notify(): send state, e.g. "READY=1", to the service manager; false if there is none
+bool twamp_sd_notify(const std::string& state);
+//interval the service manager expects WATCHDOG=1 at, 0 if it does not
+uint64_t twamp_sd_watchdog_usec();
+/*
+ * Switch to user, and group or else the user's own, keeping only the
+ * capabilities the agent still needs afterwards: binding the reflector
+ * port, probing from VRF devices and packet rings, NIC timestamping, busy
+ * polling and SCHED_FIFO threads. False, with the reason on stderr, if
+ * that did not fully happen.
+ */
+bool twamp_drop_privileges(const std::string& user, const std::string& group);
+/*
+ * Give the calling thread a core: pinned to cpu (-1 to leave it where it
+ * is) and, with a priority 1-99, scheduled SCHED_FIFO so that nothing
+ * but the kernel runs ahead of it there. False, with the reason on
+ * stderr, if that did not fully happen.
+ */
+bool twamp_isolate_thread(int cpu, int fifo_priority);
@@ -1,9 +1,12 @@
 #include "twamp_light.hpp"
+#include <map>
+#include <tuple>
+#include <net/if.h>
+#include <sys/eventfd.h>
 using namespace std;
 
 //flags to manage the receiver and sender threads
 atomic<bool> running {true};
-atomic<bool> peers_updated {false};
 
 //signal handler
 void signal_handler(int signal) {
@@ -25,79 +28,711 @@ struct probe_config_struct {
     int timeout_ms = 100;
     int probe_cycle_sec = 60;
     int port = 862;
+    //per-packet reflector logging
+    bool debug = false;
+    //reflector threads, each pinned to a core with its own SO_REUSEPORT socket
+    int reflector_threads = 1;
+    //steer probes to the reflector on the CPU that received them
+    bool cpu_steering = false;
+    //reflect off PACKET_MMAP rings on this interface instead of the UDP socket
+    std::string ring_ifname;
+    //probe through io_uring rather than an RX thread and epoll
+    bool io_uring = false;
+    //take the peers from bgpd's shared-memory segment and publish to it
+    bool bgpd_shm = false;
+    //bgpd's import latency damping threshold, peers near it get probed more often
+    int damping_threshold_ms = 50;
+    //probe size on the wire, padded with zeros
+    int packet_size = TWAMP_LIGHT_RFC5357_SIZE;
+    //interface to take NIC timestamps on, kernel timestamps if empty
+    std::string hw_ifname;
+    //statistic published as the latency, TwampRttStat
+    int rtt_stat = TWAMP_RTT_MEDIAN;
+    //weight of the newest cycle in the EWMA
+    double ewma_alpha = 0.25;
+    //serve Prometheus metrics on this TCP port, 0 for none
+    int metrics_port = 0;
+    //probes per second over every engine, sent in bursts of up to pace_burst; 0 for no limit
+    int pace_pps = 0;
+    int pace_burst = 32;
+    //the same per VRF device, each with an engine of its own
+    int interface_pps = 0;
+    //per peer, stretching the interval between its probes
+    int peer_pps = 0;
+    //leave the spacing within a burst to the qdisc (SO_TXTIME)
+    bool txtime = false;
+    //source ports to probe every peer from, to cover the underlay's ECMP paths
+    int ecmp_flows = 1;
+    //DSCP of the probes to peers bgpd asks no traffic class for
+    int dscp = 0;
+    //STAMP probes, one-way delay from synchronized reflectors
+    bool stamp = false;
+    //busy poll the sockets for up to this many microseconds instead of sleeping in them, 0 for not
+    int busy_poll_us = 0;
+    //SCHED_FIFO priority of the threads taking timestamps, 0 for none
+    int fifo_priority = 0;
+    //CPUs the reflector threads, and the sender's RX threads, are pinned to in turn
+    std::vector<int> reflector_cpus;
+    std::vector<int> sender_cpus;
+    //serve the shared latency matrix on this TCP port, 0 for none
+    int aggregator_port = 0;
+    //agents the aggregator makes landmarks, 0 to only share each pair's probes
+    int landmarks = 0;
+    //host:port of the aggregator to share measurements through, in bgpd mode
+    std::string aggregator;
+    //address the other agents probe this one at
+    std::string self_addr;
+    //TCP handshakes per second towards bgpd's internet destinations, 0 for none; and their port
+    int egress_rate = 0;
+    int egress_port = 443;
+    //--reflector only reflects, --daemon only probes for bgpd
+    bool run_reflector = true;
+    bool run_sender = true;
+    //-u user[:group] to run as, with only the network capabilities kept
+    std::string user;
+    std::string group;
 };
 
-//map and struct to store peer IPs and their latency data
-struct latency_data{
-    uint64_t latency {0};
-    bool spike {false};
+//probe results for scraping, fed by whichever sender loop runs
+TwampMetricsExporter metrics;
+//shared by every probe engine, set from pace_pps
+TwampTokenBucket probe_pacer;
+//the latency matrix, with aggregator_port
+TwampAggregator aggregator_service;
+
+//reflector and sender still setting up their sockets; READY=1 goes to systemd after the last
+atomic<int> starting {0};
+//when the sender last went round its loop, for the systemd watchdog
+atomic<uint64_t> sender_alive_ms {0};
+
+static void started(){
+    if (--starting == 0)
+        twamp_sd_notify("READY=1");
+}
+
+/*
+ * Peers and their latency. add_peer()/del_peer() only queue the change;
+ * the sender owns the table, applies the queue at the start of each cycle
+ * and publishes a read-only copy after it, which readers pick up with one
+ * atomic load and never lock (RCU style).
+ */
+struct peer_change{
+    TwampPeerKey key;
+    bool add;
 };
-unordered_map<string,latency_data> latency_db;
+vector<peer_change> peer_changes;
+shared_ptr<const TwampPeerTable> latency_db = make_shared<const TwampPeerTable>();
 
-//protect latency_db
+//protect peer_changes
 mutex latency_db_mutex; 
 //condition variable to track when peers are added to an empty vector
 condition_variable latency_db_cv;
 
-//add peers to the shared vector
-void add_peer(const string &peer_ip_add) {
+static void queue_peer_change(const string &peer_ip, bool add) {
+    peer_change change;
+    if (!TwampPeerKey::parse(peer_ip, &change.key)) {
+        cerr << get_current_timestamp() << " Ignoring invalid peer address " << peer_ip << endl;
+        return;
+    }
+    change.add = add;
     unique_lock<mutex> lock(latency_db_mutex);
-    latency_data data;
-    latency_db[peer_ip_add] = data;
-    peers_updated = true;
+    peer_changes.push_back(change);
     latency_db_cv.notify_one();
 }
 
-//delete peers from the shared vector
+//add peers to the shared table
+void add_peer(const string &peer_ip_add) {
+    queue_peer_change(peer_ip_add, true);
+}
+
+//delete peers from the shared table
 void del_peer(const string &peer_ip_del) {
-    unique_lock<mutex> lock(latency_db_mutex);
-    latency_db.erase(peer_ip_del);
-    peers_updated = true;
-    latency_db_cv.notify_one();
+    queue_peer_change(peer_ip_del, false);
+}
+
+//latency of a peer in microseconds as of the last cycle; false if unknown
+bool get_peer_latency(const string &peer_ip, uint64_t *latency) {
+    TwampPeerKey key;
+    if (!TwampPeerKey::parse(peer_ip, &key))
+        return false;
+    shared_ptr<const TwampPeerTable> snapshot = atomic_load(&latency_db);
+    const latency_data *data = snapshot->find(key);
+    if (!data)
+        return false;
+    *latency = data->latency;
+    return true;
+}
+
+//"2,4-7" into its CPUs; false if it is not such a list
+static bool parse_cpu_list(const string &list, vector<int> *cpus){
+    cpus->clear();
+    stringstream in(list);
+    string range;
+    while (getline(in, range, ',')) {
+        int first, last;
+        char dash;
+        stringstream r(range);
+        if (!(r >> first) || first < 0)
+            return false;
+        last = first;
+        if (r >> dash && (dash != '-' || !(r >> last) || last < first))
+            return false;
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus->push_back(cpu);
+    }
+    return !cpus->empty();
+}
+
+//asked for the lowest timestamp noise: report how late the timestamping threads read
+static bool isolating(const probe_config_struct &probe_config){
+    return probe_config.busy_poll_us || probe_config.fifo_priority || !probe_config.reflector_cpus.empty() ||
+           !probe_config.sender_cpus.empty();
+}
+
+//a reflector with the sockets options asked for
+static TwampLightReflector *new_reflector(const probe_config_struct &probe_config, bool reuseport){
+    TwampLightReflector *reflector = new TwampLightReflector("::", probe_config.port, probe_config.debug, reuseport);
+    if (probe_config.busy_poll_us && !reflector->set_busy_poll(probe_config.busy_poll_us))
+        cerr << get_current_timestamp() << " Cannot busy poll the reflector socket: " << strerror(errno) << endl;
+    if (isolating(probe_config) || probe_config.debug)
+        reflector->report_wakeup(60);
+    return reflector;
+}
+
+//one reflector's loop: off the packet rings if asked and they can be set up, else the UDP socket
+static void reflect(TwampLightReflector &reflector, const probe_config_struct &probe_config, uint16_t fanout_group){
+    if (!probe_config.ring_ifname.empty() && !reflector.run_packet_ring(probe_config.ring_ifname, fanout_group))
+        cerr << get_current_timestamp() << " Packet rings unavailable on " << probe_config.ring_ifname << ", reflecting off the socket" << endl;
+    reflector.run_batched();
 }
 
 //Reflector function
-void reflector_main(const int &port){
+void reflector_main(const probe_config_struct &probe_config){
+    int nr_threads = max(1, probe_config.reflector_threads);
     //initialziing the reflector to start responding to the peer on port 862
-    TwampLightReflector reflector("0.0.0.0", port);
-    reflector.run();
+    const vector<int> &cpus = probe_config.reflector_cpus;
+    if (nr_threads == 1) {
+        unique_ptr<TwampLightReflector> reflector(new_reflector(probe_config, false));
+        started();
+        if (!cpus.empty() || probe_config.fifo_priority)
+            twamp_isolate_thread(cpus.empty() ? -1 : cpus[0], probe_config.fifo_priority);
+        reflect(*reflector, probe_config, 0);
+        cout << "Reflector thread exiting" << endl;
+        return;
+    }
+    //bind all sockets here, in order, so socket i of the group is reflector i
+    vector<unique_ptr<TwampLightReflector>> reflectors;
+    for (int i = 0; i < nr_threads; ++i)
+        reflectors.emplace_back(new_reflector(probe_config, true));
+    if (probe_config.cpu_steering)
+        reflectors[0]->attach_cpu_steering(nr_threads);
+    started();
+    unsigned int nr_cores = max(1u, thread::hardware_concurrency());
+    //the rings of all reflectors share probes by CPU, as cpu_steering does for the sockets
+    uint16_t fanout_group = uint16_t(getpid()) | 1;
+    vector<thread> threads;
+    for (int i = 0; i < nr_threads; ++i) {
+        threads.emplace_back([&reflectors, &probe_config, &cpus, i, nr_cores, fanout_group]{
+            twamp_isolate_thread(cpus.empty() ? int(i % nr_cores) : cpus[i % cpus.size()], probe_config.fifo_priority);
+            reflect(*reflectors[i], probe_config, fanout_group);
+        });
+    }
+    for (auto &t: threads)
+        t.join();
     cout << "Reflector thread exiting" << endl;
 }
 
+//a finished round, handed from the sender to the publisher
+struct publish_job{
+    vector<TwampPeerKey> keys;
+    vector<TwampProbeResult> results;
+    //probes sent to each peer
+    vector<int> sent;
+    //where the results go in bgpd's segment, empty when not probing for bgpd
+    vector<TwampShmAgent::target> targets;
+    //what goes there: of the peers probed, then of those shared through the aggregator
+    vector<TwampProbeResult> shm_results;
+    //peers no longer probed, done before the round
+    vector<TwampPeerKey> forget;
+};
+
+/*
+ * Logs, exports and publishes the rounds the sender finished, on a thread
+ * of its own: formatting the log, the metrics lock and the segment's
+ * writer lock then never delay the next round going out. The two threads
+ * hand off through a lock-free ring and an eventfd; a publisher that far
+ * behind makes the sender wait rather than lose rounds.
+ */
+class result_publisher{
+    public:
+    result_publisher(const probe_config_struct &probe_config, TwampShmAgent *agent = nullptr, TwampAggregatorClient *aggregator = nullptr):
+        config(probe_config), agent(agent), aggregator(aggregator), queue(64), queued(0), done(0), stop(false) {
+        wake_fd = eventfd(0, EFD_CLOEXEC);
+        worker = thread(&result_publisher::run, this);
+    }
+    ~result_publisher() {
+        stop = true;
+        wake();
+        worker.join();
+        close(wake_fd);
+    }
+    void push(unique_ptr<publish_job> job) {
+        while (!queue.push(std::move(job)))
+            this_thread::sleep_for(chrono::milliseconds(1));
+        queued.fetch_add(1, memory_order_release);
+        wake();
+    }
+    //wait for every queued round to be done, e.g. before the agent detaches
+    void flush() {
+        while (done.load(memory_order_acquire) != queued.load(memory_order_relaxed))
+            this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    private:
+    void wake() {
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) < 0)
+            perror("wake publisher");
+    }
+    void run() {
+        unique_ptr<publish_job> job;
+        while (true) {
+            while (queue.pop(job)) {
+                publish(*job);
+                job.reset();
+                done.fetch_add(1, memory_order_release);
+            }
+            if (stop)
+                return;
+            uint64_t count;
+            if (read(wake_fd, &count, sizeof(count)) < 0 && errno != EINTR)
+                perror("publisher wakeup");
+        }
+    }
+    void publish(const publish_job &job) {
+        for (const auto &key: job.forget)
+            metrics.forget(key);
+        for (size_t t = 0; t < job.keys.size(); ++t) {
+            const TwampProbeResult &res = job.results[t];
+            if (config.metrics_port)
+                metrics.record(job.keys[t], res, job.sent[t]);
+            if (!config.debug)
+                continue;
+            cout << get_current_timestamp() << " " << job.keys[t].str() << " RTT: " << res.rtt_ms << " ms (mean " << res.avg_rtt_ms << " median " << res.median_rtt_ms
+                 << " p90 " << res.p90_rtt_ms << ") Jitter: " << res.jitter_ms << " ms Loss: " << res.loss << "%";
+            if (!res.flows.empty())
+                cout << " ECMP spread: " << res.spread_ms << " ms over " << res.flows.size() << " flows";
+            if (res.one_way)
+                cout << " Forward: " << res.forward_ms << " ms Reverse: " << res.reverse_ms << " ms (+/- " << res.clock_error_ms << " ms)";
+            if (res.wakeups)
+                cout << " Wake-up: " << res.wakeup_us << " us (jitter " << res.wakeup_jitter_us << " us)";
+            cout << endl;
+            for (const auto &flow: res.flows)
+                cout << "    source port " << flow.port << ": " << flow.received << " replies, min " << flow.min_rtt_ms
+                     << " ms mean " << flow.avg_rtt_ms << " ms" << endl;
+        }
+        if (aggregator && !job.keys.empty())
+            aggregator->report(job.keys, job.results);
+        if (!agent || job.targets.empty())
+            return;
+        uint32_t sequence = agent->publish(job.targets, job.shm_results);
+        if (config.debug && sequence)
+            cout << get_current_timestamp_us() << " Published seq " << sequence << " for " << job.targets.size() << " peers" << endl;
+    }
+    const probe_config_struct &config;
+    TwampShmAgent *agent;
+    TwampAggregatorClient *aggregator;
+    TwampSpscRing<unique_ptr<publish_job>> queue;
+    int wake_fd;
+    atomic<uint64_t> queued;
+    atomic<uint64_t> done;
+    atomic<bool> stop;
+    thread worker;
+};
+
+/*
+ * Probe engines by VRF device ifindex and traffic class. The default VRF
+ * and class have the sender's own engine; one bound to the VRF device and
+ * sending with the DSCP is made the first time a peer of another VRF or
+ * class is due, and again while the device cannot be bound to (it may not
+ * exist yet). The same peer address in two VRFs, or in two classes, is two
+ * peers.
+ */
+//hands the engine's socket to io_uring (-U) or to an RX thread of its own, under the probe rate limits
+static void start_engine_io(const probe_config_struct &probe_config, TwampLightProbeEngine &engine){
+    //the engines' RX threads take the sender CPUs in the order they start
+    static size_t next_cpu = 0;
+    const vector<int> &cpus = probe_config.sender_cpus;
+    if (!engine.set_flows(probe_config.ecmp_flows))
+        cerr << get_current_timestamp() << " Probing from " << engine.nr_flows() << " of " << probe_config.ecmp_flows << " flows" << endl;
+    if (!engine.set_pacing(&probe_pacer, probe_config.interface_pps, probe_config.pace_burst, probe_config.peer_pps, probe_config.txtime))
+        cerr << get_current_timestamp() << " SO_TXTIME unavailable, pacing every probe from user space" << endl;
+    if (probe_config.busy_poll_us && !engine.set_busy_poll(probe_config.busy_poll_us))
+        cerr << get_current_timestamp() << " Cannot busy poll the probe sockets: " << strerror(errno) << endl;
+    if (probe_config.io_uring) {
+        //the sender thread reaps the replies itself then
+        if (engine.start_uring()) {
+            if (!cpus.empty() || probe_config.fifo_priority)
+                twamp_isolate_thread(cpus.empty() ? -1 : cpus[0], probe_config.fifo_priority);
+            return;
+        }
+        cerr << get_current_timestamp() << " io_uring unavailable, receiving on a thread" << endl;
+    }
+    engine.set_rx_isolation(cpus.empty() ? -1 : cpus[next_cpu++ % cpus.size()], probe_config.fifo_priority);
+    engine.start_rx_thread();
+}
+
+struct probe_engines{
+    TwampLightProbeEngine &main;
+    map<pair<uint32_t, uint8_t>, unique_ptr<TwampLightProbeEngine>> others;
+    explicit probe_engines(TwampLightProbeEngine &engine): main(engine) {}
+    void set_port(uint16_t port) {
+        main.set_port(port);
+        for (auto &other: others)
+            if (other.second)
+                other.second->set_port(port);
+    }
+    TwampLightProbeEngine &get(const probe_config_struct &probe_config, uint32_t vrf, uint8_t dscp) {
+        if (!vrf && !dscp)
+            return main;
+        unique_ptr<TwampLightProbeEngine> &engine = others[make_pair(vrf, dscp)];
+        if (!engine || !engine->bound()) {
+            char ifname[IF_NAMESIZE];
+            //a device that is not there fails to bind, and its peers read as unreachable
+            string name = !vrf ? string() : if_indextoname(vrf, ifname) ? string(ifname) : to_string(vrf);
+            engine.reset(new TwampLightProbeEngine(probe_config.port, probe_config.hw_ifname, probe_config.packet_size, name));
+            engine->set_dscp(dscp ? dscp : probe_config.dscp);
+            engine->set_stamp(probe_config.stamp);
+            start_engine_io(probe_config, *engine);
+        }
+        return *engine;
+    }
+};
+
+//probe the peers of table that are due, feeding the results back into the scheduler
+static size_t probe_due_peers(const probe_config_struct &probe_config, probe_engines &engines, TwampProbeScheduler &scheduler,
+                              TwampPeerTable &table, publish_job &job){
+    vector<TwampPeerKey> &keys = job.keys;
+    vector<TwampProbeResult> &results = job.results;
+    scheduler.due(table, keys);
+    if (keys.empty())
+        return 0;
+    //one run per VRF, class and packet count, every peer of a run probed in parallel
+    map<tuple<uint32_t, uint8_t, int>, vector<size_t>> runs;
+    job.sent.resize(keys.size());
+    for (size_t t = 0; t < keys.size(); ++t) {
+        const latency_data *data = table.find(keys[t]);
+        int packets = data && data->packet_count ? data->packet_count : probe_config.packet_count;
+        job.sent[t] = packets * probe_config.ecmp_flows;
+        runs[make_tuple(keys[t].vrf, keys[t].dscp, packets)].push_back(t);
+    }
+    results.assign(keys.size(), TwampProbeResult());
+    for (const auto &run: runs) {
+        vector<in6_addr> peers;
+        for (size_t t: run.second)
+            peers.push_back(keys[t].to_in6());
+        vector<TwampProbeResult> got = engines.get(probe_config, get<0>(run.first), get<1>(run.first))
+                                           .run(peers, get<2>(run.first), probe_config.interval_ms, probe_config.timeout_ms);
+        for (size_t i = 0; i < run.second.size(); ++i)
+            results[run.second[i]] = got[i];
+    }
+    for (size_t t = 0; t < keys.size(); ++t) {
+        TwampProbeResult &res = results[t];
+        latency_data *data = table.find(keys[t]);
+        if (data)
+            twamp_smooth_rtt(res, probe_config.rtt_stat, probe_config.ewma_alpha, data->ewma_ms);
+        scheduler.update(table, keys[t], res);
+    }
+    return keys.size();
+}
+
+//sleep for one scheduler tick, waking early on shutdown or when pred() holds
+template <typename Pred> static void wait_tick(const TwampProbeScheduler &scheduler, Pred pred){
+    unique_lock<mutex> lock(latency_db_mutex);
+    latency_db_cv.wait_for(lock, chrono::milliseconds(scheduler.tick_ms()), [&]{ return !running || pred(); });
+}
+
+//next-hops the aggregator measures for us, and where they go in the segment
+typedef unordered_map<TwampPeerKey, TwampShmAgent::target, TwampPeerKeyHash> shared_slots;
+
+/*
+ * Bring the table in line with bgpd's next-hops, scheduling new ones.
+ * With an aggregator, only what it leaves to this agent is probed, the
+ * landmarks included, and the rest goes into shared.
+ */
+static void sync_shm_peers(const vector<TwampShmAgent::target> &targets, TwampAggregatorClient *aggregator, TwampPeerTable &table,
+                           TwampProbeScheduler &scheduler, vector<TwampPeerKey> &forget, shared_slots &shared){
+    TwampPeerTable current;
+    vector<TwampPeerKey> asked;
+    shared.clear();
+    for (const auto &t: targets) {
+        TwampPeerKey key = TwampPeerKey::from_in6(t.addr, t.vrf_ifindex);
+        key.dscp = t.dscp;
+        asked.push_back(key);
+        if (aggregator && !aggregator->probes(key)) {
+            shared[key] = t;
+            continue;
+        }
+        current.insert(key);
+        bool fresh = !table.find(key);
+        latency_data &data = table.insert(key);
+        data.shm_slot = t.slot;
+        data.shm_epoch = t.epoch;
+        data.in_shm = true;
+        uint64_t old_cycle_ms = data.cycle_ms;
+        data.cycle_ms = t.probe_cycle_sec * 1000ULL;
+        data.packet_count = t.packet_count;
+        if (fresh)
+            scheduler.add(key, data);
+        else
+            scheduler.reprofile(key, data, old_cycle_ms);
+    }
+    if (aggregator) {
+        aggregator->need(asked);
+        for (const auto &key: aggregator->extra_probes(asked)) {
+            current.insert(key);
+            bool fresh = !table.find(key);
+            latency_data &data = table.insert(key);
+            data.in_shm = false;
+            uint64_t old_cycle_ms = data.cycle_ms;
+            data.cycle_ms = 0;
+            data.packet_count = 0;
+            if (fresh)
+                scheduler.add(key, data);
+            else
+                scheduler.reprofile(key, data, old_cycle_ms);
+        }
+    }
+    vector<TwampPeerKey> gone;
+    table.for_each([&](const TwampPeerKey &key, const latency_data &) {
+        if (!current.find(key))
+            gone.push_back(key);
+    });
+    for (const auto &key: gone) {
+        table.erase(key);
+        forget.push_back(key);
+    }
+}
+
+/*
+ * bgpd's settings on top of the command line: what bgpd does not set
+ * falls back to the agent's own, so dropping a setting in bgpd undoes it.
+ */
+static void apply_shm_config(const TwampShmAgent::settings &cfg, const probe_config_struct &base, probe_config_struct &config,
+                             probe_engines &engines, TwampProbeScheduler &scheduler){
+    config = base;
+    uint64_t damping_threshold_us = base.damping_threshold_ms * 1000ULL;
+    bool pushed = cfg.port || cfg.probe_cycle_sec || cfg.packet_count || cfg.has_damping;
+    if (cfg.port)
+        config.port = cfg.port;
+    if (cfg.probe_cycle_sec)
+        config.probe_cycle_sec = cfg.probe_cycle_sec;
+    if (cfg.packet_count)
+        config.packet_count = cfg.packet_count;
+    if (cfg.has_damping)
+        damping_threshold_us = cfg.damping_threshold_us;
+    engines.set_port(config.port);
+    scheduler.configure(config.probe_cycle_sec, damping_threshold_us);
+    cout << get_current_timestamp() << " Probe settings: " << config.probe_cycle_sec << " s cycle, "
+         << config.packet_count << " packets, port " << config.port << ", damping threshold "
+         << damping_threshold_us << " us" << (pushed ? " (from bgpd)" : "") << endl;
+}
+
+//Sender loop against bgpd: peers come from, and latencies go to, the segment
+void sender_shm_main(const probe_config_struct &base_config, TwampLightProbeEngine &engine){
+    //the command line, with what bgpd pushes through the segment on top
+    probe_config_struct probe_config = base_config;
+    TwampShmAgent agent;
+    probe_engines engines(engine);
+    TwampProbeScheduler scheduler(probe_config.probe_cycle_sec, probe_config.damping_threshold_ms);
+    TwampPeerTable peers;
+    unique_ptr<TwampAggregatorClient> aggregator;
+    if (!base_config.aggregator.empty()) {
+        TwampPeerKey self;
+        if (TwampPeerKey::parse(base_config.self_addr, &self))
+            aggregator.reset(new TwampAggregatorClient(base_config.aggregator, self));
+        else
+            cerr << get_current_timestamp() << " Not sharing measurements: -g needs this agent's address (-o)" << endl;
+    }
+    result_publisher publisher(base_config, &agent, aggregator.get());
+    vector<TwampPeerKey> forget;
+    //bgpd's next-hops as last read, and those of them the aggregator measures
+    vector<TwampShmAgent::target> bgpd_targets;
+    shared_slots shared;
+    bool waiting = false;
+    //nh_gen of the membership in peers; odd never matches a stable one
+    uint32_t synced_gen = 1;
+    //gen of the settings applied, the same way
+    uint32_t config_gen = 1;
+    //the aggregator's assignment that peers follows
+    uint32_t assigned_gen = 0;
+    while (running){
+        sender_alive_ms = get_monotonic_ms();
+        if (agent.stale()) {
+            cout << get_current_timestamp() << " bgpd replaced the segment, re-attaching" << endl;
+            publisher.flush();
+            agent.detach();
+        }
+        if (!agent.attached()) {
+            if (!agent.attach()) {
+                if (!waiting) {
+                    cout << get_current_timestamp() << " Waiting for bgpd to create " << "the TWAMP shared-memory segment" << endl;
+                    twamp_sd_notify("STATUS=Waiting for bgpd's shared-memory segment");
+                }
+                waiting = true;
+                unique_lock<mutex> lock(latency_db_mutex);
+                latency_db_cv.wait_for(lock, chrono::seconds(1), [&]{ return !running; });
+                continue;
+            }
+            //slots may have moved in the new segment
+            synced_gen = 1;
+            config_gen = 1;
+            bgpd_targets.clear();
+        }
+        waiting = false;
+        TwampShmAgent::settings cfg;
+        if (agent.config(&cfg) && cfg.gen != config_gen) {
+            apply_shm_config(cfg, base_config, probe_config, engines, scheduler);
+            config_gen = cfg.gen;
+        }
+        //resync once bgpd is done changing the membership, not half-way through
+        uint32_t gen = agent.membership_gen();
+        bool resync = false;
+        if (gen != synced_gen && !(gen & 1)) {
+            vector<TwampShmAgent::target> targets = agent.active_targets();
+            if (agent.membership_gen() == gen) {
+                bgpd_targets.swap(targets);
+                synced_gen = gen;
+                resync = true;
+            }
+        }
+        if (aggregator && aggregator->assignment_gen() != assigned_gen) {
+            assigned_gen = aggregator->assignment_gen();
+            resync = true;
+        }
+        if (resync) {
+            sync_shm_peers(bgpd_targets, aggregator.get(), peers, scheduler, forget, shared);
+            twamp_sd_notify("STATUS=Probing " + to_string(peers.size()) + " of bgpd's " + to_string(bgpd_targets.size()) + " next-hops");
+        }
+        unique_ptr<publish_job> job(new publish_job);
+        job->forget.swap(forget);
+        if (probe_due_peers(probe_config, engines, scheduler, peers, *job)) {
+            for (size_t k = 0; k < job->keys.size(); ++k) {
+                const latency_data *data = peers.find(job->keys[k]);
+                if (!data->in_shm)
+                    continue;
+                TwampShmAgent::target t;
+                t.slot = data->shm_slot;
+                t.epoch = data->shm_epoch;
+                t.addr = job->keys[k].to_in6();
+                t.vrf_ifindex = job->keys[k].vrf;
+                t.dscp = job->keys[k].dscp;
+                t.probe_cycle_sec = 0;
+                t.packet_count = 0;
+                job->targets.push_back(t);
+                job->shm_results.push_back(job->results[k]);
+            }
+        }
+        //what the others measured goes to bgpd as if probed here; all of it after a resync
+        if (aggregator) {
+            for (const auto &update: aggregator->take_updates(resync)) {
+                auto slot = shared.find(update.key);
+                if (slot == shared.end())
+                    continue;
+                TwampProbeResult res;
+                if (update.rtt_us != UINT32_MAX) {
+                    res.rtt_ms = res.median_rtt_ms = res.avg_rtt_ms = update.rtt_us / 1000.0;
+                    res.received = 1;
+                }
+                res.loss = update.loss_permille / 10.0;
+                job->targets.push_back(slot->second);
+                job->shm_results.push_back(res);
+            }
+        }
+        if (!job->keys.empty() || !job->forget.empty() || !job->targets.empty())
+            publisher.push(std::move(job));
+        wait_tick(scheduler, []{ return false; });
+    }
+}
+
 //Sender function
 void sender_main(const probe_config_struct &probe_config){ 
-    // Local Cache 
-    unordered_map<string,latency_data> local_latency_db;
+    // The sender's own table, published to latency_db after each probe batch
+    TwampPeerTable local_latency_db;
+    // Probes every peer in parallel from one socket, read by a thread of its own or io_uring
+    TwampLightProbeEngine engine(probe_config.port, probe_config.hw_ifname, probe_config.packet_size);
+    if (probe_config.dscp && !engine.set_dscp(probe_config.dscp))
+        cerr << get_current_timestamp() << " Cannot mark probes with DSCP " << probe_config.dscp << ": " << strerror(errno) << endl;
+    engine.set_stamp(probe_config.stamp);
+    start_engine_io(probe_config, engine);
+    started();
+    if (probe_config.bgpd_shm) {
+        sender_shm_main(probe_config, engine);
+        cout << "Sender thread exiting" << endl;
+        return;
+    }
+    TwampProbeScheduler scheduler(probe_config.probe_cycle_sec, probe_config.damping_threshold_ms);
+    probe_engines engines(engine);
+    result_publisher publisher(probe_config);
     while (running){
+        sender_alive_ms = get_monotonic_ms();
+        vector<peer_change> changes;
         {
             unique_lock<mutex> lock(latency_db_mutex);
             // wait while empty and running
-            while (latency_db.size() == 0 && running){
+            while (peer_changes.empty() && local_latency_db.size() == 0 && running){
                 cout << "No peers to probe, waiting..." << endl;
                 latency_db_cv.wait_for(lock, chrono::seconds(1), 
-                    [&]{ return latency_db.size() > 0 || !running;});
+                    [&]{ return !peer_changes.empty() || !running;});
+                sender_alive_ms = get_monotonic_ms();
             }
             if (!running) break;
-            if (latency_db.size() > 0) cout << "Peers available, starting probes..." << endl;
+            //take the queued changes; the cost is the number of changes, not peers
+            changes.swap(peer_changes);
         }
-        if (peers_updated){
-                peers_updated = false;
-                local_latency_db = latency_db;
+        unique_ptr<publish_job> job(new publish_job);
+        if (!changes.empty()){
+                for (const auto &change: changes) {
+                    if (!change.add) {
+                        local_latency_db.erase(change.key);
+                        job->forget.push_back(change.key);
+                    } else if (!local_latency_db.find(change.key))
+                        scheduler.add(change.key, local_latency_db.insert(change.key));
+                }
                 cout << "Updated the peer table" << endl;
         }
-        if (local_latency_db.size() > 0){
-            if (!running) break;
-            //run the probes and write it
-            for (const auto &items: local_latency_db)
-            {
-                //TODO
-            }
-            this_thread::sleep_for(chrono::seconds(probe_config.probe_cycle_sec));
-        }
+        if (probe_due_peers(probe_config, engines, scheduler, local_latency_db, *job))
+            atomic_store(&latency_db, shared_ptr<const TwampPeerTable>(make_shared<const TwampPeerTable>(local_latency_db)));
+        if (!job->keys.empty() || !job->forget.empty())
+            publisher.push(std::move(job));
+        // sleep one tick, waking early on shutdown or for peer changes
+        wait_tick(scheduler, [&]{ return !peer_changes.empty(); });
     }
     cout << "Sender thread exiting" << endl;
 }
 
+//Internet egress loop: bgpd's (prefix, exit) pairs, a share of them each second
+void egress_main(const probe_config_struct &probe_config){
+    TwampEgressProber prober(probe_config.egress_port, probe_config.packet_count, 1000);
+    bool waiting = false;
+    while (running){
+        if (prober.stale()) {
+            cout << get_current_timestamp() << " bgpd replaced the egress segment, re-attaching" << endl;
+            prober.detach();
+        }
+        if (!prober.attached() && !prober.attach()) {
+            if (!waiting)
+                cout << get_current_timestamp() << " Waiting for bgpd to create the egress segment" << endl;
+            waiting = true;
+            this_thread::sleep_for(chrono::seconds(1));
+            continue;
+        }
+        waiting = false;
+        prober.run(probe_config.egress_rate);
+    }
+    cout << "Egress thread exiting" << endl;
+}
+
 int main(int argc, char* argv[]) {
     
     //registering signal handler
@@ -117,23 +752,107 @@ int main(int argc, char* argv[]) {
                 else if (arg == "-t" && i < argc) probe_config.timeout_ms = std::stoi(argv[i++]);
                 else if (arg == "-p" && i < argc) probe_config.port = std::stoi(argv[i++]);
                 else if (arg == "-f" && i < argc) probe_config.probe_cycle_sec = std::stoi(argv[i++]);
+                else if (arg == "-H" && i < argc) probe_config.hw_ifname = argv[i++];
+                else if (arg == "-s" && i < argc) probe_config.packet_size = std::stoi(argv[i++]);
+                else if (arg == "-d") probe_config.debug = true;
+                else if (arg == "-r" && i < argc) probe_config.reflector_threads = std::stoi(argv[i++]);
+                else if (arg == "-R") probe_config.cpu_steering = true;
+                else if (arg == "-X" && i < argc) probe_config.ring_ifname = argv[i++];
+                else if (arg == "-U") probe_config.io_uring = true;
+                else if (arg == "-b") probe_config.bgpd_shm = true;
+                else if (arg == "-D" && i < argc) probe_config.damping_threshold_ms = std::stoi(argv[i++]);
+                else if (arg == "-S" && i < argc) {
+                    std::string stat = argv[i++];
+                    if (!twamp_parse_rtt_stat(stat, &probe_config.rtt_stat))
+                        cerr << "Unknown RTT statistic " << stat << ", using median" << endl;
+                }
+                else if (arg == "-a" && i < argc) probe_config.ewma_alpha = std::min(1.0, std::max(0.01, std::stod(argv[i++])));
+                else if (arg == "-m" && i < argc) probe_config.metrics_port = std::stoi(argv[i++]);
+                else if (arg == "-P" && i < argc) probe_config.pace_pps = std::max(0, std::stoi(argv[i++]));
+                else if (arg == "-B" && i < argc) probe_config.pace_burst = std::max(1, std::stoi(argv[i++]));
+                else if (arg == "-I" && i < argc) probe_config.interface_pps = std::max(0, std::stoi(argv[i++]));
+                else if (arg == "-e" && i < argc) probe_config.peer_pps = std::max(0, std::stoi(argv[i++]));
+                else if (arg == "-T") probe_config.txtime = true;
+                else if (arg == "-E" && i < argc) probe_config.ecmp_flows = std::max(1, std::stoi(argv[i++]));
+                else if (arg == "-Q" && i < argc) probe_config.dscp = std::min(63, std::max(0, std::stoi(argv[i++])));
+                else if (arg == "-Z") probe_config.stamp = true;
+                else if (arg == "--busy-poll" && i < argc) probe_config.busy_poll_us = std::max(0, std::stoi(argv[i++]));
+                else if (arg == "--fifo" && i < argc) probe_config.fifo_priority = std::min(99, std::max(0, std::stoi(argv[i++])));
+                else if ((arg == "--reflector-cpus" || arg == "--sender-cpus") && i < argc) {
+                    std::string list = argv[i++];
+                    if (!parse_cpu_list(list, arg == "--reflector-cpus" ? &probe_config.reflector_cpus : &probe_config.sender_cpus))
+                        cerr << "Invalid CPU list " << list << ", not pinning" << endl;
+                }
+                //a clock kept by PTP, which adjtimex does not see: treat it as synchronized to within this
+                else if (arg == "-Y" && i < argc) twamp_clock_assume_synced(uint64_t(std::max(1, std::stoi(argv[i++]))) * 1000);
+                else if (arg == "-A" && i < argc) probe_config.aggregator_port = std::stoi(argv[i++]);
+                else if (arg == "-k" && i < argc) probe_config.landmarks = std::max(0, std::stoi(argv[i++]));
+                else if (arg == "-g" && i < argc) probe_config.aggregator = argv[i++];
+                else if (arg == "-o" && i < argc) probe_config.self_addr = argv[i++];
+                else if (arg == "--egress" && i < argc) probe_config.egress_rate = std::max(0, std::stoi(argv[i++]));
+                else if (arg == "--egress-port" && i < argc) probe_config.egress_port = std::stoi(argv[i++]);
+                else if (arg == "--reflector") probe_config.run_sender = false;
+                //what twamp_daemon.py did: probe bgpd's next-hops, leave reflecting to another instance
+                else if (arg == "--daemon") {
+                    probe_config.run_reflector = false;
+                    probe_config.bgpd_shm = true;
+                }
+                else if (arg == "-u" && i < argc) {
+                    std::string user = argv[i++];
+                    size_t colon = user.find(':');
+                    probe_config.user = user.substr(0, colon);
+                    if (colon != std::string::npos)
+                        probe_config.group = user.substr(colon + 1);
+                }
         }
     }
+    if (!probe_config.run_reflector && !probe_config.run_sender) {
+        cerr << "--daemon and --reflector leave nothing to run" << endl;
+        return 1;
+    }
+    //a spinning SCHED_FIFO thread never gives a shared core back, not even to the kernel's own threads
+    if (probe_config.busy_poll_us && probe_config.fifo_priority &&
+        ((probe_config.run_reflector && probe_config.reflector_cpus.empty()) || (probe_config.run_sender && probe_config.sender_cpus.empty())))
+        cerr << "Busy polling at SCHED_FIFO without --reflector-cpus and --sender-cpus can lock up a core" << endl;
+    //before any thread starts, so they all run as the user
+    if (!probe_config.user.empty() && !twamp_drop_privileges(probe_config.user, probe_config.group))
+        return 1;
+    probe_pacer.set(probe_config.pace_pps, probe_config.pace_burst);
+
+    if (probe_config.metrics_port && !metrics.start(probe_config.metrics_port))
+        probe_config.metrics_port = 0;
+    if (probe_config.aggregator_port)
+        aggregator_service.start(probe_config.aggregator_port, probe_config.landmarks);
 
     cout << "Starting the TWAMP-Light Agent..." << endl;
-    cout<<"starting the reflector thread" <<endl;
-    // To start the reflector in a separate thread
-    thread reflector_thread(reflector_main, probe_config.port);
-    reflector_thread.detach();
-    cout<<"starting the sended thread" <<endl;
-    // To start the controller in a separate thread
-    thread sender_thread(sender_main, probe_config);
-    sender_thread.detach();
-
-    //holding the main thread
+    starting = int(probe_config.run_reflector) + int(probe_config.run_sender);
+    if (probe_config.run_reflector) {
+        cout<<"starting the reflector thread" <<endl;
+        // To start the reflector in a separate thread
+        thread reflector_thread(reflector_main, probe_config);
+        reflector_thread.detach();
+    }
+    if (probe_config.run_sender) {
+        cout<<"starting the sended thread" <<endl;
+        // To start the controller in a separate thread
+        thread sender_thread(sender_main, probe_config);
+        sender_thread.detach();
+    }
+    if (probe_config.egress_rate && probe_config.run_sender && probe_config.bgpd_shm) {
+        cout<<"starting the egress thread" <<endl;
+        thread egress_thread(egress_main, probe_config);
+        egress_thread.detach();
+    } else if (probe_config.egress_rate)
+        cerr << "--egress probes for bgpd and needs -b or --daemon" << endl;
+
+    //holding the main thread, and telling systemd's watchdog the sender still goes round
+    uint64_t watchdog_ms = twamp_sd_watchdog_usec() / 1000;
     while (running) {
-        this_thread::sleep_for(chrono::seconds(1));
+        this_thread::sleep_for(chrono::milliseconds(watchdog_ms ? min<uint64_t>(1000, watchdog_ms / 2) : 1000));
+        if (watchdog_ms && !starting && (!probe_config.run_sender || get_monotonic_ms() - sender_alive_ms < watchdog_ms))
+            twamp_sd_notify("WATCHDOG=1");
     }
+    twamp_sd_notify("STOPPING=1");
     cout << "Shutting down..." << endl;
     // Wake up sender if waiting
     latency_db_cv.notify_all();
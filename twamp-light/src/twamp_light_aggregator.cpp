@@ -0,0 +1,510 @@
+#include "twamp_light.hpp"
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+
+//measurements older than this are left out of the matrix
+static const time_t TWAMP_AGGREGATE_MAX_AGE = 300;
+//LATENCY goes out at most this often, and at least this often to age the matrix
+static const uint64_t TWAMP_SHARE_MIN_MS = 1000;
+static const uint64_t TWAMP_SHARE_MAX_MS = 60000;
+//how long the client waits before connecting again
+static const int TWAMP_AGGREGATOR_RETRY_MS = 5000;
+
+//address order, the lowest addressed agents being the landmarks
+static bool key_less(const TwampPeerKey &a, const TwampPeerKey &b){
+    if (a.family != b.family)
+        return a.family < b.family;
+    return memcmp(a.addr, b.addr, sizeof(a.addr)) < 0;
+}
+
+static std::string format_rtt(uint32_t rtt_us){
+    return rtt_us == UINT32_MAX ? std::string("-") : std::to_string(rtt_us);
+}
+
+//"<address> <rtt_us|-> <loss_permille>", false if malformed
+static bool parse_latency(std::istringstream &in, TwampPeerKey *key, uint32_t *rtt_us, uint16_t *loss_permille){
+    std::string addr, rtt;
+    unsigned int loss;
+    if (!(in >> addr >> rtt >> loss) || !TwampPeerKey::parse(addr, key))
+        return false;
+    if (rtt == "-") {
+        *rtt_us = UINT32_MAX;
+    } else {
+        char *end;
+        unsigned long value = strtoul(rtt.c_str(), &end, 10);
+        if (*end)
+            return false;
+        *rtt_us = uint32_t(std::min(value, (unsigned long)UINT32_MAX - 1));
+    }
+    *loss_permille = uint16_t(std::min(loss, 1000u));
+    return true;
+}
+
+//complete lines off the front of buf, leaving a partial one there
+template <typename F> static void take_lines(std::string &buf, F f){
+    size_t start = 0, end;
+    while ((end = buf.find('\n', start)) != std::string::npos) {
+        f(buf.substr(start, end - start));
+        start = end + 1;
+    }
+    buf.erase(0, start);
+}
+
+//false once the peer hung up or the socket failed
+static bool read_into(int fd, std::string &buf){
+    char chunk[4096];
+    while (true) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+        if (n > 0) {
+            buf.append(chunk, n);
+            continue;
+        }
+        if (n == 0)
+            return false;
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+}
+
+static bool write_from(int fd, std::string &buf){
+    while (!buf.empty()) {
+        ssize_t n = send(fd, buf.data(), buf.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        buf.erase(0, n);
+    }
+    return true;
+}
+
+TwampAggregator::~TwampAggregator() {
+    if (listen_fd >= 0)
+        close(listen_fd);
+}
+
+bool TwampAggregator::start(int port, unsigned int landmarks) {
+    sockaddr_in6 addr{};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(port);
+    listen_fd = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        perror("aggregator socket");
+        return false;
+    }
+    int on = 1, off = 0;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    //agents may connect over IPv4 as well
+    setsockopt(listen_fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    if (bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 64) < 0) {
+        perror("aggregator bind");
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    nr_landmarks = landmarks;
+    std::thread([this]{ serve(); }).detach();
+    std::cout << get_current_timestamp() << " Aggregating latency on port " << port;
+    if (landmarks)
+        std::cout << ", " << landmarks << " landmarks";
+    std::cout << std::endl;
+    return true;
+}
+
+void TwampAggregator::drop(size_t i) {
+    agent &a = *agents[i];
+    if (a.known) {
+        by_self.erase(a.self);
+        std::cout << get_current_timestamp() << " Agent " << a.self.str() << " left the aggregator" << std::endl;
+    }
+    close(a.fd);
+    agents.erase(agents.begin() + i);
+    membership_dirty = true;
+}
+
+void TwampAggregator::serve() {
+    uint64_t last_share = 0;
+    std::vector<pollfd> fds;
+    while (true) {
+        fds.assign(1, pollfd{listen_fd, POLLIN, 0});
+        for (const auto &a: agents)
+            fds.push_back(pollfd{a->fd, short(POLLIN | (a->out.empty() ? 0 : POLLOUT)), 0});
+        if (poll(fds.data(), fds.size(), TWAMP_SHARE_MIN_MS) < 0 && errno != EINTR) {
+            perror("aggregator poll");
+            return;
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                std::unique_ptr<agent> a(new agent);
+                a->fd = fd;
+                agents.push_back(std::move(a));
+            }
+        }
+        //agents accepted above have no entry in fds yet
+        for (size_t i = fds.size() - 1; i > 0; --i) {
+            agent &a = *agents[i - 1];
+            bool ok = !(fds[i].revents & (POLLERR | POLLNVAL));
+            if (ok && (fds[i].revents & (POLLIN | POLLHUP))) {
+                ok = read_into(a.fd, a.in);
+                take_lines(a.in, [&](const std::string &line) { handle_line(a, line); });
+            }
+            if (!ok)
+                drop(i - 1);
+        }
+        if (membership_dirty)
+            assign();
+        uint64_t now = get_monotonic_ms();
+        if ((results_dirty && now - last_share >= TWAMP_SHARE_MIN_MS) || now - last_share >= TWAMP_SHARE_MAX_MS) {
+            share();
+            last_share = now;
+        }
+        for (size_t i = agents.size(); i > 0; --i)
+            if (!write_from(agents[i - 1]->fd, agents[i - 1]->out))
+                drop(i - 1);
+    }
+}
+
+void TwampAggregator::handle_line(agent &a, const std::string &line) {
+    std::istringstream in(line);
+    std::string verb, addr;
+    in >> verb;
+    if (verb == "HELLO") {
+        TwampPeerKey self;
+        if (!(in >> addr) || !TwampPeerKey::parse(addr, &self) || by_self.count(self))
+            return;
+        if (a.known)
+            by_self.erase(a.self);
+        a.self = self;
+        a.known = true;
+        by_self[self] = &a;
+        membership_dirty = true;
+        std::cout << get_current_timestamp() << " Agent " << self.str() << " joined the aggregator" << std::endl;
+        return;
+    }
+    if (!a.known)
+        return;
+    if (verb == "NEED") {
+        a.needs.clear();
+        a.need_set.clear();
+        TwampPeerKey key;
+        while (in >> addr)
+            if (TwampPeerKey::parse(addr, &key) && !(key == a.self) && a.need_set.emplace(key, true).second)
+                a.needs.push_back(key);
+        membership_dirty = true;
+    } else if (verb == "RESULT") {
+        TwampPeerKey key;
+        measurement m;
+        if (!parse_latency(in, &key, &m.rtt_us, &m.loss_permille))
+            return;
+        m.updated = time(nullptr);
+        matrix[a.self][key] = m;
+        results_dirty = true;
+    }
+}
+
+bool TwampAggregator::is_landmark(const TwampPeerKey &key) const {
+    for (const auto &l: landmark_keys)
+        if (l == key)
+            return true;
+    return false;
+}
+
+/*
+ * Of two agents needing each other, the lower addressed one probes. With
+ * landmarks, every agent probes the landmarks and whatever it needs that
+ * is not an agent, and no other agent.
+ */
+void TwampAggregator::assign() {
+    landmark_keys.clear();
+    for (const auto &a: agents)
+        if (a->known)
+            landmark_keys.push_back(a->self);
+    std::sort(landmark_keys.begin(), landmark_keys.end(), key_less);
+    if (landmark_keys.size() > nr_landmarks)
+        landmark_keys.resize(nr_landmarks);
+
+    for (auto &ap: agents) {
+        agent &a = *ap;
+        if (!a.known)
+            continue;
+        std::vector<TwampPeerKey> probes;
+        for (const auto &t: a.needs) {
+            auto other = by_self.find(t);
+            bool probe;
+            if (other == by_self.end() || is_landmark(t))
+                probe = true;
+            else if (nr_landmarks)
+                probe = false;
+            else
+                probe = !other->second->need_set.count(a.self) || key_less(a.self, t);
+            if (probe)
+                probes.push_back(t);
+        }
+        for (const auto &l: landmark_keys)
+            if (!(l == a.self) && !a.need_set.count(l))
+                probes.push_back(l);
+        if (probes == a.probes)
+            continue;
+        a.probes = probes;
+        a.probe_set.clear();
+        a.out += "PROBE";
+        for (const auto &t: probes) {
+            a.probe_set[t] = true;
+            a.out += " " + t.str();
+        }
+        a.out += "\n";
+    }
+    membership_dirty = false;
+    results_dirty = true;
+}
+
+bool TwampAggregator::direct(const TwampPeerKey &a, const TwampPeerKey &b, measurement *m) const {
+    time_t oldest = time(nullptr) - TWAMP_AGGREGATE_MAX_AGE;
+    for (int side = 0; side < 2; ++side) {
+        auto r = matrix.find(side ? b : a);
+        if (r == matrix.end())
+            continue;
+        auto e = r->second.find(side ? a : b);
+        if (e != r->second.end() && e->second.updated >= oldest) {
+            *m = e->second;
+            return true;
+        }
+    }
+    return false;
+}
+
+TwampAggregator::measurement TwampAggregator::estimate(const TwampPeerKey &a, const TwampPeerKey &b) const {
+    measurement best{UINT32_MAX, 1000, 0};
+    if (direct(a, b, &best))
+        return best;
+    for (const auto &l: landmark_keys) {
+        measurement x, y;
+        if (l == a || l == b || !direct(a, l, &x) || !direct(l, b, &y) || x.rtt_us == UINT32_MAX || y.rtt_us == UINT32_MAX)
+            continue;
+        uint64_t rtt = uint64_t(x.rtt_us) + y.rtt_us;
+        if (rtt >= best.rtt_us)
+            continue;
+        best.rtt_us = uint32_t(std::min(rtt, uint64_t(UINT32_MAX) - 1));
+        //lost on either leg
+        best.loss_permille = uint16_t(1000 - (1000 - x.loss_permille) * (1000 - y.loss_permille) / 1000);
+        best.updated = std::min(x.updated, y.updated);
+    }
+    return best;
+}
+
+void TwampAggregator::share() {
+    for (auto &ap: agents) {
+        agent &a = *ap;
+        if (!a.known)
+            continue;
+        for (const auto &t: a.needs) {
+            if (a.probe_set.count(t))
+                continue;
+            measurement m = estimate(a.self, t);
+            auto sent = a.sent.find(t);
+            if (sent != a.sent.end() && sent->second.rtt_us == m.rtt_us && sent->second.loss_permille == m.loss_permille)
+                continue;
+            a.sent[t] = m;
+            a.out += "LATENCY " + t.str() + " " + format_rtt(m.rtt_us) + " " + std::to_string(m.loss_permille) + "\n";
+        }
+    }
+    results_dirty = false;
+}
+
+TwampAggregatorClient::TwampAggregatorClient(const std::string &server, const TwampPeerKey &self): self(self) {
+    //host:port, [v6 address]:port
+    size_t colon = server.rfind(':');
+    host = server.substr(0, colon);
+    port = colon == std::string::npos ? std::string("8620") : server.substr(colon + 1);
+    if (host.size() > 1 && host.front() == '[' && host.back() == ']')
+        host = host.substr(1, host.size() - 2);
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    worker = std::thread(&TwampAggregatorClient::run, this);
+}
+
+TwampAggregatorClient::~TwampAggregatorClient() {
+    stop = true;
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0)
+        perror("wake aggregator client");
+    worker.join();
+    if (fd >= 0)
+        close(fd);
+    close(wake_fd);
+}
+
+bool TwampAggregatorClient::connect_server() {
+    addrinfo hints{}, *res;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0)
+        return false;
+    int sock = -1;
+    for (addrinfo *ai = res; ai; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (sock < 0)
+            continue;
+        if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    if (sock < 0)
+        return false;
+
+    std::lock_guard<std::mutex> guard(lock);
+    fd = sock;
+    out = "HELLO " + self.str() + "\nNEED";
+    for (const auto &key: wanted)
+        out += " " + key.str();
+    out += "\n";
+    std::cout << get_current_timestamp() << " Sharing measurements through the aggregator " << host << " port " << port << std::endl;
+    return true;
+}
+
+void TwampAggregatorClient::run() {
+    std::string in;
+    while (!stop) {
+        if (fd < 0 && !connect_server()) {
+            pollfd wait{wake_fd, POLLIN, 0};
+            poll(&wait, 1, TWAMP_AGGREGATOR_RETRY_MS);
+            uint64_t count;
+            if (read(wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+                perror("aggregator client wakeup");
+            continue;
+        }
+        bool pending;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            pending = !out.empty();
+        }
+        pollfd fds[2] = {{fd, short(POLLIN | (pending ? POLLOUT : 0)), 0}, {wake_fd, POLLIN, 0}};
+        if (poll(fds, 2, 1000) < 0 && errno != EINTR)
+            break;
+        if (fds[1].revents & POLLIN) {
+            uint64_t count;
+            if (read(wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+                perror("aggregator client wakeup");
+        }
+        bool ok = !(fds[0].revents & (POLLERR | POLLNVAL));
+        if (ok && (fds[0].revents & (POLLIN | POLLHUP))) {
+            ok = read_into(fd, in);
+            take_lines(in, [this](const std::string &line) { handle_line(line); });
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        if (ok)
+            ok = write_from(fd, out);
+        if (ok)
+            continue;
+        //probe everything ourselves again until it is back
+        std::cerr << get_current_timestamp() << " Lost the aggregator, probing every next-hop" << std::endl;
+        close(fd);
+        fd = -1;
+        in.clear();
+        out.clear();
+        if (assigned) {
+            assigned = false;
+            probe_set.clear();
+            ++gen;
+        }
+    }
+}
+
+void TwampAggregatorClient::handle_line(const std::string &line) {
+    std::istringstream in(line);
+    std::string verb, addr;
+    in >> verb;
+    std::lock_guard<std::mutex> guard(lock);
+    if (verb == "PROBE") {
+        probe_set.clear();
+        TwampPeerKey key;
+        while (in >> addr)
+            if (TwampPeerKey::parse(addr, &key))
+                probe_set[key] = true;
+        assigned = true;
+        ++gen;
+    } else if (verb == "LATENCY") {
+        shared s;
+        if (!parse_latency(in, &s.key, &s.rtt_us, &s.loss_permille))
+            return;
+        latest[s.key] = s;
+        changed.push_back(s.key);
+    }
+}
+
+void TwampAggregatorClient::need(const std::vector<TwampPeerKey> &keys) {
+    std::vector<TwampPeerKey> shareable;
+    for (const auto &key: keys)
+        if (!key.vrf && !key.dscp)
+            shareable.push_back(key);
+    std::lock_guard<std::mutex> guard(lock);
+    if (shareable == wanted)
+        return;
+    wanted.swap(shareable);
+    if (fd < 0)
+        return;
+    out += "NEED";
+    for (const auto &key: wanted)
+        out += " " + key.str();
+    out += "\n";
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0)
+        perror("wake aggregator client");
+}
+
+bool TwampAggregatorClient::probes(const TwampPeerKey &key) const {
+    std::lock_guard<std::mutex> guard(lock);
+    return !assigned || key.vrf || key.dscp || probe_set.count(key);
+}
+
+std::vector<TwampPeerKey> TwampAggregatorClient::extra_probes(const std::vector<TwampPeerKey> &bgpd_keys) const {
+    std::unordered_map<TwampPeerKey, bool, TwampPeerKeyHash> asked;
+    for (const auto &key: bgpd_keys)
+        asked[key] = true;
+    std::vector<TwampPeerKey> extra;
+    std::lock_guard<std::mutex> guard(lock);
+    if (!assigned)
+        return extra;
+    for (const auto &p: probe_set)
+        if (!asked.count(p.first))
+            extra.push_back(p.first);
+    return extra;
+}
+
+uint32_t TwampAggregatorClient::assignment_gen() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return gen;
+}
+
+void TwampAggregatorClient::report(const std::vector<TwampPeerKey> &keys, const std::vector<TwampProbeResult> &results) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (fd < 0)
+        return;
+    for (size_t t = 0; t < keys.size() && t < results.size(); ++t) {
+        if (keys[t].vrf || keys[t].dscp)
+            continue;
+        const TwampProbeResult &res = results[t];
+        uint32_t rtt_us = res.received ? uint32_t(std::min(llround(res.rtt_ms * 1000), (long long)UINT32_MAX - 1)) : UINT32_MAX;
+        out += "RESULT " + keys[t].str() + " " + format_rtt(rtt_us) + " " + std::to_string(llround(res.loss * 10)) + "\n";
+    }
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0)
+        perror("wake aggregator client");
+}
+
+std::vector<TwampAggregatorClient::shared> TwampAggregatorClient::take_updates(bool all) {
+    std::vector<shared> updates;
+    std::lock_guard<std::mutex> guard(lock);
+    if (all) {
+        for (const auto &l: latest)
+            updates.push_back(l.second);
+    } else {
+        std::unordered_map<TwampPeerKey, bool, TwampPeerKeyHash> seen;
+        for (const auto &key: changed)
+            if (seen.emplace(key, true).second)
+                updates.push_back(latest[key]);
+    }
+    changed.clear();
+    return updates;
+}
@@ -0,0 +1,224 @@
+/*
+ * Load test of the probe engine against a local reflector.
+ *
+ * Every synthetic reflector is the same TwampLightReflector on loopback,
+ * seen by the engine as one more peer: each has its own probes, sequence
+ * numbers and RTT samples, so a cycle costs the engine what the same
+ * number of remote reflectors would. They all share one address: the
+ * engine matches replies on their source, and a reflector on a wildcard
+ * socket answers from whichever address the kernel picks.
+ *
+ * Per cycle it reports how long the engine took to complete it and the
+ * reflector's CPU time; at the end the reflector's CPU per thousand
+ * probes per second and the distribution of the RTTs measured. The true
+ * RTT over loopback is a few microseconds, so that distribution is the
+ * timestamping error floor of the host. The jitter of the delay between
+ * the kernel's receive timestamp and the engine reading the reply is
+ * what user-space timestamps would add on top; -b and -F show how much
+ * busy polling and SCHED_FIFO take out of it.
+ */
+#include "twamp_light.hpp"
+#include <pthread.h>
+using namespace std;
+
+struct bench_config_struct {
+    int peers = 1000;
+    int packet_count = 3;
+    int interval_ms = 10;
+    int timeout_ms = 100;
+    int cycles = 10;
+    int port = 18620;
+    int packet_size = TWAMP_LIGHT_RFC5357_SIZE;
+    string address = "127.0.0.1";
+    //reflector threads, each with its own SO_REUSEPORT socket
+    int reflector_threads = 1;
+    //replies read by the engine's RX thread, as in the agent
+    bool rx_thread = false;
+    //probe through io_uring (-U)
+    bool io_uring = false;
+    //probe rate limit and burst, 0 for none; SO_TXTIME for the spacing within a burst
+    int pace_pps = 0;
+    int pace_burst = 32;
+    bool txtime = false;
+    //busy poll the sockets for up to this many microseconds, 0 to sleep
+    int busy_poll_us = 0;
+    //SCHED_FIFO priority of the reflector and RX threads, 0 for none
+    int fifo_priority = 0;
+};
+
+static uint64_t cpu_ns(clockid_t clock) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//nearest-rank percentile of sorted values
+static double percentile(const vector<double> &sorted, double p) {
+    if (sorted.empty())
+        return 0.0;
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+    return sorted[min(sorted.size(), max<size_t>(rank, 1)) - 1];
+}
+
+static void print_distribution(const char *what, vector<double> &values_ms) {
+    sort(values_ms.begin(), values_ms.end());
+    cout << "  " << left << setw(22) << what << right << fixed << setprecision(1)
+         << " p50 " << setw(8) << percentile(values_ms, 50) * 1000
+         << " us  p90 " << setw(8) << percentile(values_ms, 90) * 1000
+         << " us  p99 " << setw(8) << percentile(values_ms, 99) * 1000
+         << " us  max " << setw(8) << (values_ms.empty() ? 0.0 : values_ms.back() * 1000)
+         << " us" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    bench_config_struct config;
+
+    int i = 1;
+    while (i < argc) {
+        std::string arg = argv[i++];
+        if (arg == "-n" && i < argc) config.peers = std::stoi(argv[i++]);
+        else if (arg == "-c" && i < argc) config.packet_count = std::stoi(argv[i++]);
+        else if (arg == "-i" && i < argc) config.interval_ms = std::stoi(argv[i++]);
+        else if (arg == "-t" && i < argc) config.timeout_ms = std::stoi(argv[i++]);
+        else if (arg == "-k" && i < argc) config.cycles = std::stoi(argv[i++]);
+        else if (arg == "-p" && i < argc) config.port = std::stoi(argv[i++]);
+        else if (arg == "-s" && i < argc) config.packet_size = std::stoi(argv[i++]);
+        else if (arg == "-A" && i < argc) config.address = argv[i++];
+        else if (arg == "-r" && i < argc) config.reflector_threads = std::stoi(argv[i++]);
+        else if (arg == "-T") config.rx_thread = true;
+        else if (arg == "-U") config.io_uring = true;
+        else if (arg == "-P" && i < argc) config.pace_pps = std::max(0, std::stoi(argv[i++]));
+        else if (arg == "-B" && i < argc) config.pace_burst = std::max(1, std::stoi(argv[i++]));
+        else if (arg == "-X") config.txtime = true;
+        else if (arg == "-b" && i < argc) config.busy_poll_us = std::max(0, std::stoi(argv[i++]));
+        else if (arg == "-F" && i < argc) config.fifo_priority = std::max(0, std::stoi(argv[i++]));
+        else {
+            cerr << "usage: " << argv[0] << " [-n peers] [-c packets] [-i interval_ms] [-t timeout_ms]"
+                 << " [-k cycles] [-p port] [-s packet_size] [-A address] [-r reflector_threads] [-T] [-U]"
+                 << " [-P pps] [-B burst] [-X] [-b busy_poll_us] [-F fifo_priority]" << endl;
+            return 1;
+        }
+    }
+    config.peers = max(1, config.peers);
+    config.reflector_threads = max(1, config.reflector_threads);
+
+    TwampPeerKey key;
+    if (!TwampPeerKey::parse(config.address, &key)) {
+        cerr << "Invalid address " << config.address << endl;
+        return 1;
+    }
+
+    //the reflectors run until the process exits, only their CPU clocks are kept
+    bool reuseport = config.reflector_threads > 1;
+    vector<clockid_t> reflector_clocks;
+    for (int r = 0; r < config.reflector_threads; ++r) {
+        TwampLightReflector *reflector = new TwampLightReflector(key.family == AF_INET6 ? "::" : "0.0.0.0", config.port, false, reuseport);
+        if (config.busy_poll_us && !reflector->set_busy_poll(config.busy_poll_us))
+            cerr << "SO_BUSY_POLL unavailable on the reflector: " << strerror(errno) << endl;
+        int fifo_priority = config.fifo_priority;
+        thread t([reflector, fifo_priority]{
+            if (fifo_priority)
+                twamp_isolate_thread(-1, fifo_priority);
+            reflector->run_batched();
+        });
+        clockid_t clock;
+        if (pthread_getcpuclockid(t.native_handle(), &clock) == 0)
+            reflector_clocks.push_back(clock);
+        t.detach();
+    }
+    //let the reflectors get to their first recvmmsg()
+    this_thread::sleep_for(chrono::milliseconds(100));
+
+    TwampLightProbeEngine engine(config.port, "", config.packet_size);
+    if (config.busy_poll_us && !engine.set_busy_poll(config.busy_poll_us))
+        cerr << "SO_BUSY_POLL unavailable on the engine: " << strerror(errno) << endl;
+    engine.set_rx_isolation(-1, config.fifo_priority);
+    TwampTokenBucket pacer(config.pace_pps, config.pace_burst);
+    if (!engine.set_pacing(&pacer, 0, config.pace_burst, 0, config.txtime)) {
+        cerr << "SO_TXTIME unavailable" << endl;
+        return 1;
+    }
+    if (config.io_uring && !engine.start_uring()) {
+        cerr << "io_uring unavailable" << endl;
+        return 1;
+    }
+    if (config.rx_thread)
+        engine.start_rx_thread();
+    vector<in6_addr> peers(config.peers, key.to_in6());
+    //the schedule alone, what a cycle takes with every reply immediate
+    double schedule_ms = max(0, config.packet_count - 1) * config.interval_ms;
+
+    cout << "Probing " << config.peers << " peers on " << config.address << ":" << config.port
+         << ", " << config.packet_count << " packets " << config.interval_ms << " ms apart, "
+         << config.reflector_threads << " reflector thread(s)" << (config.rx_thread ? ", RX thread" : "")
+         << (config.io_uring ? ", io_uring" : "")
+         << (config.busy_poll_us ? ", busy polling" : "") << (config.fifo_priority ? ", SCHED_FIFO" : "");
+    if (config.pace_pps)
+        cout << ", paced at " << config.pace_pps << " pps in bursts of " << config.pace_burst << (config.txtime ? " (SO_TXTIME)" : "");
+    cout << endl;
+
+    //the thread running the engine, sends and (without -T) receives
+    clockid_t engine_clock;
+    pthread_getcpuclockid(pthread_self(), &engine_clock);
+    vector<double> rtts_ms, jitters_ms, cycle_ms, wakeup_jitters_ms;
+    uint64_t total_sent = 0, total_received = 0, total_cpu_ns = 0, total_engine_ns = 0;
+    double total_wall_ms = 0.0;
+    for (int cycle = 1; cycle <= config.cycles; ++cycle) {
+        uint64_t cpu_start = 0;
+        for (auto clock: reflector_clocks)
+            cpu_start += cpu_ns(clock);
+        uint64_t engine_start = cpu_ns(engine_clock);
+        auto start = chrono::steady_clock::now();
+
+        vector<TwampProbeResult> results = engine.run(peers, config.packet_count, config.interval_ms, config.timeout_ms);
+
+        double wall_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        uint64_t cpu = 0;
+        for (auto clock: reflector_clocks)
+            cpu += cpu_ns(clock);
+        cpu -= cpu_start;
+        uint64_t engine_cpu = cpu_ns(engine_clock) - engine_start;
+
+        uint64_t received = 0;
+        for (const auto &res: results) {
+            received += res.received;
+            if (!res.received)
+                continue;
+            rtts_ms.push_back(res.median_rtt_ms);
+            jitters_ms.push_back(res.jitter_ms);
+            if (res.wakeups)
+                wakeup_jitters_ms.push_back(res.wakeup_jitter_us / 1000);
+        }
+        uint64_t sent = (uint64_t)config.peers * config.packet_count;
+        total_sent += sent;
+        total_received += received;
+        total_cpu_ns += cpu;
+        total_engine_ns += engine_cpu;
+        total_wall_ms += wall_ms;
+        cycle_ms.push_back(wall_ms);
+
+        cout << "cycle " << setw(3) << cycle << ": completed in " << fixed << setprecision(1) << setw(8) << wall_ms
+             << " ms (" << showpos << wall_ms - schedule_ms << noshowpos << " ms over the schedule), "
+             << received << "/" << sent << " replies, reflector CPU "
+             << setprecision(2) << cpu / 1e6 << " ms, engine CPU " << engine_cpu / 1e6 << " ms" << endl;
+    }
+
+    double pps = total_wall_ms > 0 ? total_sent / (total_wall_ms / 1000.0) : 0.0;
+    double cpu_pct = total_wall_ms > 0 ? 100.0 * (total_cpu_ns / 1e6) / total_wall_ms : 0.0;
+    cout << fixed << setprecision(2);
+    cout << "Summary over " << config.cycles << " cycles:" << endl;
+    sort(cycle_ms.begin(), cycle_ms.end());
+    cout << "  cycle completion       p50 " << percentile(cycle_ms, 50) << " ms  max "
+         << (cycle_ms.empty() ? 0.0 : cycle_ms.back()) << " ms" << endl;
+    cout << "  offered load           " << pps / 1000 << " kpps, "
+         << (total_sent ? 100.0 * (total_sent - total_received) / total_sent : 0.0) << "% lost" << endl;
+    cout << "  reflector CPU          " << cpu_pct << "% of a core, "
+         << (pps > 0 ? cpu_pct / (pps / 1000) : 0.0) << "% per kpps" << endl;
+    cout << "  engine CPU             "
+         << (total_wall_ms > 0 ? 100.0 * (total_engine_ns / 1e6) / total_wall_ms : 0.0) << "% of a core" << endl;
+    print_distribution("per-peer median RTT", rtts_ms);
+    print_distribution("per-peer jitter", jitters_ms);
+    print_distribution("per-peer wake-up jitter", wakeup_jitters_ms);
+
+    return 0;
+}
@@ -0,0 +1,251 @@
+#include "twamp_light.hpp"
+#include "bgp_twamp_ipc.h"
+#include <sys/epoll.h>
+#include <fcntl.h>
+
+//handshakes open at once, well under the usual limit on open files
+#define TWAMP_EGRESS_INFLIGHT 256
+
+TwampEgressProber::TwampEgressProber(uint16_t port, int packet_count, int timeout_ms):
+    shm(nullptr), map_size(0), map_ino(0), notify_fd(-1), port(port),
+    packet_count(std::max(1, packet_count)), timeout_ms(std::max(1, timeout_ms)), synced_gen(1), next(0) {
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+}
+
+TwampEgressProber::~TwampEgressProber() {
+    detach();
+    if (notify_fd >= 0)
+        close(notify_fd);
+    if (epfd >= 0)
+        close(epfd);
+}
+
+bool TwampEgressProber::attach() {
+    int fd = shm_open(TWAMP_EGRESS_SHM_NAME, O_RDWR, 0);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || size_t(st.st_size) < sizeof(twamp_egress_shm)) {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return false;
+    }
+    const char *why = twamp_egress_hdr_check(static_cast<twamp_egress_shm*>(map), st.st_size);
+    if (why) {
+        std::cerr << get_current_timestamp() << " Ignoring " << TWAMP_EGRESS_SHM_NAME << ": " << why << std::endl;
+        munmap(map, st.st_size);
+        return false;
+    }
+    shm = static_cast<twamp_egress_shm*>(map);
+    map_size = st.st_size;
+    map_ino = st.st_ino;
+    synced_gen = 1;
+    targets.clear();
+    next = 0;
+    std::cout << get_current_timestamp() << " Attached to " << TWAMP_EGRESS_SHM_NAME << " (" << shm->hdr.capacity << " slots)" << std::endl;
+    if (notify_fd >= 0)
+        close(notify_fd);
+    notify_fd = twamp_notify_connect();
+    return true;
+}
+
+void TwampEgressProber::detach() {
+    if (shm)
+        munmap(shm, map_size);
+    shm = nullptr;
+    map_size = 0;
+    targets.clear();
+}
+
+bool TwampEgressProber::stale() const {
+    if (!shm)
+        return false;
+    if (__atomic_load_n(&shm->hdr.flags, __ATOMIC_ACQUIRE) & TWAMP_SHM_F_SUPERSEDED)
+        return true;
+    struct stat st;
+    int fd = shm_open(TWAMP_EGRESS_SHM_NAME, O_RDONLY, 0);
+    if (fd < 0)
+        return true;
+    bool moved = fstat(fd, &st) < 0 || st.st_ino != map_ino;
+    close(fd);
+    return moved;
+}
+
+//re-read the destinations once bgpd is done changing them; false if there are none to probe
+bool TwampEgressProber::refresh_targets() {
+    uint32_t gen = twamp_seq_read_begin(&shm->gen);
+    if (gen == synced_gen || (gen & 1))
+        return !targets.empty();
+    const twamp_egress *entries = twamp_egress_entries_c(shm);
+    std::vector<target> read;
+    uint32_t count = std::min(__atomic_load_n(&shm->count, __ATOMIC_RELAXED), shm->hdr.capacity);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!__atomic_load_n(&entries[i].active, __ATOMIC_RELAXED))
+            continue;
+        target t;
+        t.slot = i;
+        t.epoch = __atomic_load_n(&entries[i].epoch, __ATOMIC_RELAXED);
+        twamp_addr_load(&entries[i].dest, &t.dest);
+        t.mark = __atomic_load_n(&entries[i].mark, __ATOMIC_RELAXED);
+        read.push_back(t);
+    }
+    //raced with bgpd: keep probing the old set until the next round
+    if (twamp_seq_read_retry(&shm->gen, gen))
+        return !targets.empty();
+    targets.swap(read);
+    synced_gen = gen;
+    next = targets.empty() ? 0 : next % targets.size();
+    return !targets.empty();
+}
+
+/*
+ * Every destination of batch gets packet_count handshakes, started one
+ * after the other over the second and at most TWAMP_EGRESS_INFLIGHT at
+ * a time. A handshake is over when the socket turns writable, connected
+ * or refused; anything else, or no answer within timeout_ms, is a loss.
+ */
+void TwampEgressProber::probe(const std::vector<target>& batch, std::vector<TwampProbeResult>& results) {
+    struct attempt{
+        size_t t;
+        int fd;
+        uint64_t start_ns;
+    };
+    std::vector<std::vector<double>> rtts(batch.size());
+    std::vector<int> answered(batch.size(), 0);
+    std::vector<attempt> inflight;
+    size_t total = batch.size() * packet_count, started = 0;
+    uint64_t spacing_ns = total ? 1000000000ULL / total : 0;
+
+    auto steady_ns = []{
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    };
+    uint64_t begin_ns = steady_ns();
+    auto finish = [&](size_t n, bool ok, uint64_t now_ns) {
+        if (ok) {
+            rtts[inflight[n].t].push_back((now_ns - inflight[n].start_ns) / 1e6);
+            answered[inflight[n].t]++;
+        }
+        //closing drops it from the epoll set as well
+        close(inflight[n].fd);
+        inflight[n] = inflight.back();
+        inflight.pop_back();
+    };
+
+    while (started < total || !inflight.empty()) {
+        uint64_t now_ns = steady_ns();
+        while (started < total && inflight.size() < TWAMP_EGRESS_INFLIGHT && now_ns >= begin_ns + started * spacing_ns) {
+            const target &t = batch[started % batch.size()];
+            size_t idx = started % batch.size();
+            started++;
+            bool v4 = twamp_addr_is_ipv4(&t.dest);
+            int fd = socket(v4 ? AF_INET : AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0)
+                continue;
+            //out of the exit; a reset on close leaves no TIME_WAIT here nor half-open state there
+            if (t.mark)
+                setsockopt(fd, SOL_SOCKET, SO_MARK, &t.mark, sizeof(t.mark));
+            linger lin{1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+            sockaddr_storage ss{};
+            socklen_t len;
+            if (v4) {
+                sockaddr_in *sin = reinterpret_cast<sockaddr_in*>(&ss);
+                sin->sin_family = AF_INET;
+                sin->sin_port = htons(port);
+                memcpy(&sin->sin_addr, &t.dest.s6_addr[12], 4);
+                len = sizeof(*sin);
+            } else {
+                sockaddr_in6 *sin6 = reinterpret_cast<sockaddr_in6*>(&ss);
+                sin6->sin6_family = AF_INET6;
+                sin6->sin6_port = htons(port);
+                sin6->sin6_addr = t.dest;
+                len = sizeof(*sin6);
+            }
+            inflight.push_back({idx, fd, steady_ns()});
+            if (connect(fd, reinterpret_cast<sockaddr*>(&ss), len) == 0 || errno == ECONNREFUSED) {
+                finish(inflight.size() - 1, true, steady_ns());
+                continue;
+            }
+            epoll_event ev{};
+            ev.events = EPOLLOUT;
+            ev.data.fd = fd;
+            if (errno != EINPROGRESS || epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+                finish(inflight.size() - 1, false, 0);
+        }
+
+        epoll_event events[64];
+        int n = epoll_wait(epfd, events, 64, 1);
+        now_ns = steady_ns();
+        for (int e = 0; e < n; ++e) {
+            for (size_t k = 0; k < inflight.size(); ++k) {
+                if (inflight[k].fd != events[e].data.fd)
+                    continue;
+                int err = 0;
+                socklen_t elen = sizeof(err);
+                getsockopt(inflight[k].fd, SOL_SOCKET, SO_ERROR, &err, &elen);
+                finish(k, err == 0 || err == ECONNREFUSED, now_ns);
+                break;
+            }
+        }
+        for (size_t k = 0; k < inflight.size();) {
+            if (now_ns - inflight[k].start_ns >= uint64_t(timeout_ms) * 1000000ULL)
+                finish(k, false, 0);
+            else
+                ++k;
+        }
+    }
+
+    results.assign(batch.size(), TwampProbeResult());
+    for (size_t t = 0; t < batch.size(); ++t) {
+        TwampProbeResult &res = results[t];
+        res.received = answered[t];
+        res.loss = 100.0 * (packet_count - answered[t]) / packet_count;
+        if (rtts[t].empty())
+            continue;
+        std::vector<double> &sorted = rtts[t];
+        std::sort(sorted.begin(), sorted.end());
+        size_t mid = sorted.size() / 2;
+        res.median_rtt_ms = sorted.size() % 2 ? sorted[mid] : (sorted[mid - 1] + sorted[mid]) / 2;
+        res.avg_rtt_ms = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+        res.rtt_ms = res.median_rtt_ms;
+    }
+}
+
+unsigned int TwampEgressProber::run(unsigned int rate) {
+    uint64_t deadline = get_monotonic_ms() + 1000;
+    unsigned int probed = 0;
+    if (shm && refresh_targets()) {
+        //sampled: a round covers what the rate allows, the next one carries on from there
+        size_t want = std::min(targets.size(), size_t(std::max(1U, rate / packet_count)));
+        std::vector<target> batch;
+        for (size_t k = 0; k < want; ++k)
+            batch.push_back(targets[(next + k) % targets.size()]);
+        next = (next + want) % targets.size();
+
+        std::vector<TwampProbeResult> results;
+        probe(batch, results);
+        int64_t now = time(nullptr);
+        for (size_t t = 0; t < batch.size(); ++t) {
+            const TwampProbeResult &res = results[t];
+            uint32_t rtt_us = res.received ? uint32_t(std::min<long long>(llround(res.rtt_ms * 1000), UINT32_MAX - 1)) : UINT32_MAX;
+            twamp_egress_publish(shm, batch[t].slot, batch[t].epoch, rtt_us, uint16_t(llround(res.loss * 10)), res.received ? 1 : 0, now);
+        }
+        __atomic_add_fetch(&shm->sequence, 1, __ATOMIC_RELEASE);
+        if (notify_fd >= 0) {
+            uint64_t one = 1;
+            if (write(notify_fd, &one, sizeof(one)) < 0)
+                perror("notify bgpd");
+        }
+        probed = batch.size();
+    }
+    uint64_t now_ms = get_monotonic_ms();
+    if (now_ms < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(deadline - now_ms));
+    return probed;
+}
@@ -0,0 +1,954 @@
+#include "twamp_light.hpp"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <fcntl.h>
+#include <linux/net_tstamp.h>
+
+//replies the RX thread can hold before run() gets to them
+#define TWAMP_RX_RING_SIZE 8192
+//socket buffer for a round of replies from every peer, arriving in one burst
+#define TWAMP_ENGINE_RCVBUF (4 * 1024 * 1024)
+//probes queued ahead with SO_TXTIME, well under fq's per-flow limit of 100
+#define TWAMP_TXTIME_AHEAD_PACKETS 64
+#define TWAMP_TXTIME_AHEAD_NS 1000000
+//IPv6 and UDP headers, counted in the kernel's pacing rate
+#define TWAMP_PROBE_OVERHEAD 48
+//source ports of an ECMP sweep, far more than any underlay has paths
+#define TWAMP_MAX_FLOWS 64
+
+void TwampTokenBucket::set(uint64_t rate_pps, uint32_t burst) {
+    emission_ns = rate_pps ? std::max<uint64_t>(1, 1000000000ULL / rate_pps) : 0;
+    tolerance_ns = emission_ns * (std::max<uint32_t>(burst, 1) - 1);
+}
+
+//SCM_TXTIME into msg's control buffer, at_ns taken from get_current_time_ns()
+static void twamp_set_txtime(msghdr *msg, uint64_t at_ns) {
+    timespec mono;
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    uint64_t txtime = uint64_t(mono.tv_sec) * 1000000000ULL + mono.tv_nsec + (int64_t(at_ns) - int64_t(get_current_time_ns()));
+    cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_TXTIME;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(txtime));
+    memcpy(CMSG_DATA(cmsg), &txtime, sizeof(txtime));
+}
+
+bool twamp_set_dscp(int fd, int family, uint8_t dscp) {
+    int tos = (dscp & 0x3f) << 2;
+    bool ok = setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) == 0;
+    if (family == AF_INET6)
+        ok = setsockopt(fd, IPPROTO_IPV6, IPV6_TCLASS, &tos, sizeof(tos)) == 0 && ok;
+    return ok;
+}
+
+//constructor
+TwampLightProbeEngine::TwampLightProbeEngine(uint16_t port, const std::string& hw_ifname, size_t packet_size, const std::string& vrf_ifname):
+    reflector_port(port), hw_ifname(hw_ifname), vrf_ifname(vrf_ifname), reachable(true), flow_ports(1, 0), next_tx_ids(1, 0) {
+    send_buffer.resize(std::min(std::max(packet_size, size_t(TWAMP_LIGHT_PACKET_SIZE)), size_t(TWAMP_LIGHT_MAX_PACKET_SIZE)));
+    //one dual-stack socket for both families: IPv4 peers go out v4-mapped
+    family = AF_INET6;
+    sockfd = open_socket(&ts_mode);
+    if (sockfd < 0) {
+        family = AF_INET;
+        sockfd = open_socket(&ts_mode);
+    }
+    if (sockfd < 0) {
+        perror("socket");
+        exit(1);
+    }
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        exit(1);
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = sockfd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &ev) < 0) {
+        perror("epoll_ctl");
+        exit(1);
+    }
+    std::random_device rd;
+    next_seq = rd();
+}
+
+int TwampLightProbeEngine::open_socket(int *mode) {
+    int fd = socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    int off = 0;
+    if (family == AF_INET6 && setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off)) < 0) {
+        close(fd);
+        return -1;
+    }
+    //needs CAP_NET_RAW; a VRF that cannot be entered has every probe lost rather than sent via the default VRF
+    if (!vrf_ifname.empty() && setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, vrf_ifname.c_str(), vrf_ifname.size()) < 0) {
+        if (reachable)
+            std::cerr << get_current_timestamp() << " Cannot bind probes to VRF " << vrf_ifname << ": " << strerror(errno) << std::endl;
+        reachable = false;
+    }
+    //capped at net.core.rmem_max, a smaller buffer only drops replies sooner
+    int rcvbuf = TWAMP_ENGINE_RCVBUF;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    bool hw = !hw_ifname.empty() && twamp_enable_hw_timestamping(fd, hw_ifname);
+    *mode = twamp_enable_timestamping(fd, hw);
+    if (probe_dscp)
+        twamp_set_dscp(fd, family, probe_dscp);
+    if (busy_poll_us)
+        twamp_set_busy_poll(fd, busy_poll_us);
+    return fd;
+}
+
+void TwampLightProbeEngine::set_stamp(bool on) {
+    stamp = on;
+    if (stamp && send_buffer.size() < TWAMP_STAMP_PACKET_SIZE)
+        send_buffer.resize(TWAMP_STAMP_PACKET_SIZE);
+    //told apart from the sessions of other senders to the same reflector
+    while (stamp && !stamp_ssid)
+        stamp_ssid = uint16_t(std::random_device()());
+}
+
+size_t TwampLightProbeEngine::build_probe(uint8_t *buf, size_t size, uint32_t seq, uint64_t send_time) const {
+    if (stamp)
+        return TwampStampPacket::serialize_into(buf, size, size, seq, send_time, clock.error_estimate, stamp_ssid);
+    return TwampLightPacket(seq, send_time).serialize_into(buf, size, size);
+}
+
+bool TwampLightProbeEngine::set_busy_poll(unsigned int usec) {
+    busy_poll_us = usec;
+    bool ok = true;
+    for (size_t f = 0; f < nr_flows(); ++f)
+        ok = twamp_set_busy_poll(flow_fd(f), busy_poll_us) && ok;
+    return ok;
+}
+
+bool TwampLightProbeEngine::set_dscp(uint8_t dscp) {
+    probe_dscp = dscp & 0x3f;
+    bool ok = true;
+    for (size_t f = 0; f < nr_flows(); ++f)
+        ok = twamp_set_dscp(flow_fd(f), family, probe_dscp) && ok;
+    return ok;
+}
+
+/*
+ * The sockets are bound right away rather than on their first probe, so
+ * each flow's source port is known: the ephemeral ports differ, and so
+ * does where the underlay's hash puts the flows.
+ */
+bool TwampLightProbeEngine::set_flows(unsigned int flows) {
+    flows = std::min(std::max(flows, 1u), unsigned(TWAMP_MAX_FLOWS));
+    if (rx_thread.joinable())
+        return flows == nr_flows();
+#if defined(TWAMP_HAVE_IO_URING)
+    if (uring)
+        return flows == nr_flows();
+#endif
+    while (nr_flows() < flows) {
+        int mode;
+        int fd = open_socket(&mode);
+        if (fd < 0) {
+            perror("flow socket");
+            break;
+        }
+        //a flow timestamped less well than the others would skew its RTTs: all make do with the least
+        ts_mode = std::min(ts_mode, mode);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        flow_fds.push_back(fd);
+        flow_ports.push_back(0);
+        next_tx_ids.push_back(0);
+    }
+    for (size_t f = 0; f < nr_flows(); ++f) {
+        sockaddr_in6 addr{};
+        socklen_t len = sizeof(addr);
+        if (getsockname(flow_fd(f), (sockaddr*)&addr, &len) == 0 && !addr.sin6_port) {
+            //sin_port is where sin6_port is
+            addr = sockaddr_in6();
+            addr.sin6_family = family;
+            len = family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+            if (bind(flow_fd(f), (sockaddr*)&addr, len) < 0)
+                perror("flow bind");
+            len = sizeof(addr);
+            getsockname(flow_fd(f), (sockaddr*)&addr, &len);
+        }
+        flow_ports[f] = ntohs(addr.sin6_port);
+    }
+    return nr_flows() == flows;
+}
+
+TwampLightProbeEngine::~TwampLightProbeEngine() {
+    if (rx_thread.joinable()) {
+        rx_stop = true;
+        rx_thread.join();
+        close(rx_epfd);
+        close(rx_eventfd);
+    }
+    if (pace_fd >= 0)
+        close(pace_fd);
+    close(epfd);
+    close(sockfd);
+    for (int fd: flow_fds)
+        close(fd);
+}
+
+/*
+ * From now on the socket is only read by the RX thread, which takes the
+ * receive timestamps and queues the replies as they come in; run() waits
+ * on the thread's eventfd instead of the socket. Stats, logging or a slow
+ * publish in the sending thread then never delay a reply being read.
+ */
+bool TwampLightProbeEngine::start_rx_thread() {
+    if (rx_thread.joinable())
+        return true;
+    rx_epfd = epoll_create1(EPOLL_CLOEXEC);
+    rx_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (rx_epfd < 0 || rx_eventfd < 0) {
+        perror("rx thread");
+        if (rx_epfd >= 0)
+            close(rx_epfd);
+        if (rx_eventfd >= 0)
+            close(rx_eventfd);
+        rx_epfd = rx_eventfd = -1;
+        return false;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    for (size_t f = 0; f < nr_flows(); ++f) {
+        ev.data.fd = flow_fd(f);
+        epoll_ctl(epfd, EPOLL_CTL_DEL, ev.data.fd, nullptr);
+        epoll_ctl(rx_epfd, EPOLL_CTL_ADD, ev.data.fd, &ev);
+    }
+    ev.data.fd = rx_eventfd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, rx_eventfd, &ev);
+    rx_ring.reset(new TwampSpscRing<rx_record>(TWAMP_RX_RING_SIZE));
+    rx_thread = std::thread(&TwampLightProbeEngine::rx_main, this);
+    return true;
+}
+
+void TwampLightProbeEngine::rx_main() {
+    if (rx_cpu >= 0 || rx_fifo_priority > 0)
+        twamp_isolate_thread(rx_cpu, rx_fifo_priority);
+    while (!rx_stop) {
+        epoll_event ev;
+        //wake up now and then to notice the engine going away; busy polling never sleeps
+        int ready = epoll_wait(rx_epfd, &ev, 1, busy_poll_us ? 0 : 100);
+        if (ready < 0 || (!ready && !busy_poll_us))
+            continue;
+        bool queued = false;
+        rx_record rec;
+        for (size_t f = 0; f < nr_flows(); ++f) {
+            int fd = flow_fd(f);
+            rec.flow = f;
+            if (ts_mode == TWAMP_TS_KERNEL_TXRX) {
+                rec.tx_timestamp = true;
+                while (twamp_recv_tx_timestamp(fd, &rec.tx_id, &rec.ts)) {
+                    if (!rx_ring->push(std::move(rec)))
+                        rx_drops.fetch_add(1, std::memory_order_relaxed);
+                    else
+                        queued = true;
+                    rec.ts = TwampTimestamps();
+                }
+            }
+            rec.tx_timestamp = false;
+            while (true) {
+                rec.ts = TwampTimestamps();
+                rec.from = sockaddr_in6();
+                rec.len = twamp_recv(fd, rec.data, sizeof(rec.data), 0, (sockaddr*)&rec.from, sizeof(rec.from), &rec.ts);
+                rec.recv_time = get_current_time_ns();
+                if (rec.len < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    if (errno != EAGAIN && errno != EWOULDBLOCK)
+                        perror("recvfrom error");
+                    break;
+                }
+                if (rec.len < TWAMP_LIGHT_MIN_PACKET_SIZE)
+                    continue;
+                if (!rx_ring->push(std::move(rec)))
+                    rx_drops.fetch_add(1, std::memory_order_relaxed);
+                else
+                    queued = true;
+            }
+        }
+        if (queued) {
+            uint64_t one = 1;
+            if (write(rx_eventfd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+                perror("rx thread wakeup");
+        }
+    }
+}
+
+bool TwampLightProbeEngine::set_pacing(TwampTokenBucket *global, uint64_t engine_pps, uint32_t burst, uint64_t peer_pps, bool txtime) {
+    pacer = global && global->limited() ? global : nullptr;
+    engine_pacer.set(engine_pps, burst);
+    peer_interval_ns = peer_pps ? 1000000000ULL / peer_pps : 0;
+    //the kernel's own cap, which with fq also spreads out what the pacer lets go in a burst
+    if (engine_pps) {
+        unsigned int rate = std::min<uint64_t>(engine_pps * (send_buffer.size() + TWAMP_PROBE_OVERHEAD), ~0U - 1);
+        for (size_t f = 0; f < nr_flows(); ++f)
+            setsockopt(flow_fd(f), SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate));
+    }
+    txtime_ahead_ns = 0;
+    if (!pacer && !engine_pacer.limited())
+        return true;
+    if (pace_fd < 0) {
+        pace_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = pace_fd;
+        if (pace_fd >= 0 && epoll_ctl(epfd, EPOLL_CTL_ADD, pace_fd, &ev) < 0) {
+            close(pace_fd);
+            pace_fd = -1;
+        }
+    }
+    if (!txtime)
+        return true;
+    //the probes then leave after we take their send time: only the kernel's is right
+    if (ts_mode != TWAMP_TS_KERNEL_TXRX)
+        return false;
+    //fq takes departure times in CLOCK_MONOTONIC
+    sock_txtime cfg{};
+    cfg.clockid = CLOCK_MONOTONIC;
+    for (size_t f = 0; f < nr_flows(); ++f)
+        if (setsockopt(flow_fd(f), SOL_SOCKET, SO_TXTIME, &cfg, sizeof(cfg)) < 0)
+            return false;
+    uint64_t rate = pacer ? pacer->rate() : engine_pacer.rate();
+    if (pacer && engine_pacer.limited())
+        rate = std::min(rate, engine_pacer.rate());
+    txtime_ahead_ns = std::min<uint64_t>(TWAMP_TXTIME_AHEAD_NS, TWAMP_TXTIME_AHEAD_PACKETS * 1000000000ULL / std::max<uint64_t>(rate, 1));
+    return true;
+}
+
+bool TwampLightProbeEngine::pace_probe(uint64_t now, uint64_t *at) {
+    *at = engine_pacer.ready_at(now);
+    if (pacer)
+        *at = std::max(*at, pacer->ready_at(now));
+    if (*at > now + txtime_ahead_ns) {
+        //back for a burst's worth rather than for every token
+        uint64_t full = engine_pacer.refilled_at();
+        if (pacer)
+            full = std::max(full, pacer->refilled_at());
+        *at = std::max(*at - txtime_ahead_ns, full - txtime_ahead_ns / 2);
+        return false;
+    }
+    if (pacer)
+        pacer->take(*at);
+    engine_pacer.take(*at);
+    return true;
+}
+
+ssize_t TwampLightProbeEngine::send_probe(size_t t, size_t flow, size_t len, uint64_t txtime_at) {
+    iovec iov{send_buffer.data(), len};
+    msghdr msg{};
+    msg.msg_name = &targets[t].addr.sa;
+    msg.msg_namelen = targets[t].addr_len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    alignas(cmsghdr) uint8_t control[CMSG_SPACE(sizeof(uint64_t))];
+    if (txtime_at) {
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        twamp_set_txtime(&msg, txtime_at);
+    }
+    return sendmsg(flow_fd(flow), &msg, 0);
+}
+
+//software and hardware stamps may come as separate messages
+void TwampLightProbeEngine::handle_tx_timestamp(size_t flow, uint32_t id, const TwampTimestamps &tx) {
+    auto it = tx_id_to_seq.find(uint64_t(flow) << 32 | id);
+    if (it == tx_id_to_seq.end())
+        return;
+    auto probe = pending.find(it->second);
+    if (probe == pending.end())
+        return;
+    if (tx.sw)
+        probe->second.tx.sw = tx.sw;
+    if (tx.hw)
+        probe->second.tx.hw = tx.hw;
+}
+
+//attach send timestamps from the error queue to their probes
+void TwampLightProbeEngine::drain_tx_timestamps() {
+    uint32_t id;
+    TwampTimestamps tx;
+    for (size_t f = 0; f < nr_flows(); ++f)
+        while (twamp_recv_tx_timestamp(flow_fd(f), &id, &tx))
+            handle_tx_timestamp(f, id, tx);
+}
+
+//from is where a reply came from, as returned for the engine's socket
+bool TwampLightProbeEngine::same_peer(const probe_target &target, const sockaddr_in6 &from) const {
+    if (family == AF_INET6)
+        return from.sin6_port == target.addr.sin6.sin6_port &&
+               memcmp(&from.sin6_addr, &target.addr.sin6.sin6_addr, sizeof(in6_addr)) == 0;
+    const sockaddr_in &from4 = reinterpret_cast<const sockaddr_in&>(from);
+    return from4.sin_port == target.addr.sin.sin_port && from4.sin_addr.s_addr == target.addr.sin.sin_addr.s_addr;
+}
+
+/*
+ * Match a reply to its probe by sequence number. A STAMP reply is the one
+ * quoting our session and the probe's own timestamp; anything else is read
+ * as TWAMP-light, which is also what an older reflector makes of a STAMP
+ * probe.
+ */
+void TwampLightProbeEngine::handle_reply(const uint8_t *buf, ssize_t len, const sockaddr_in6 &from, const TwampTimestamps &rx, uint64_t recv_time, uint64_t timeout_ns) {
+    TwampLightPacketView resp;
+    TwampStampReplyView stamp_resp;
+    if (len < 0 || !TwampLightPacketView::parse(buf, len, &resp))
+        return;
+    auto it = pending.end();
+    bool stamped = false;
+    if (stamp && TwampStampReplyView::parse(buf, len, &stamp_resp) && stamp_resp.ssid() == stamp_ssid) {
+        it = pending.find(stamp_resp.sender_sequence_number());
+        stamped = it != pending.end() && stamp_resp.sender_timestamp_raw() == twamp_ntp_from_ns(it->second.send_time);
+    }
+    if (!stamped)
+        it = pending.find(resp.sequence_number());
+    if (it == pending.end())
+        return;
+    probe_target &target = targets[it->second.target];
+    //a reply with our sequence number from someone else is not an answer
+    if (!same_peer(target, from))
+        return;
+    target.wakeup.add(rx, recv_time);
+    uint64_t rtt_ns = twamp_rtt_ns(it->second.tx, rx, it->second.send_time, recv_time);
+    rtt_ns = twamp_network_rtt_ns(rtt_ns, stamped ? stamp_resp.reflector_dwell_ns() : resp.reflector_dwell_ns());
+    if (rtt_ns <= timeout_ns) {
+        target.rtts_ms.push_back(rtt_ns / 1e6);
+        target.rtt_flows.push_back(it->second.flow);
+        //NIC clocks are not the system clock the reflector stamps with: kernel or user-space times only
+        if (stamped && clock.synced && (stamp_resp.error_estimate() & TWAMP_ERR_SYNC)) {
+            uint64_t sent = it->second.tx.sw ? it->second.tx.sw : it->second.send_time;
+            uint64_t received = rx.sw ? rx.sw : recv_time;
+            target.forward_ms.push_back((int64_t(stamp_resp.receive_ns(clock.tai_offset_s)) - int64_t(sent)) / 1e6);
+            target.reverse_ms.push_back((int64_t(received) - int64_t(stamp_resp.transmit_ns(clock.tai_offset_s))) / 1e6);
+            target.clock_error_ns = std::max(target.clock_error_ns, clock.error_ns + twamp_error_estimate_ns(stamp_resp.error_estimate()));
+        }
+    }
+    pending.erase(it);
+}
+
+//take every reply queued on the socket, or by the RX thread
+void TwampLightProbeEngine::drain(uint64_t timeout_ns) {
+    if (rx_ring) {
+        uint64_t count;
+        if (read(rx_eventfd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+            perror("rx thread wakeup");
+        rx_record rec;
+        while (rx_ring->pop(rec)) {
+            if (rec.tx_timestamp)
+                handle_tx_timestamp(rec.flow, rec.tx_id, rec.ts);
+            else
+                handle_reply(rec.data, rec.len, rec.from, rec.ts, rec.recv_time, timeout_ns);
+        }
+        return;
+    }
+    if (ts_mode == TWAMP_TS_KERNEL_TXRX)
+        drain_tx_timestamps();
+    for (size_t f = 0; f < nr_flows(); ++f) {
+        while (true) {
+            uint8_t recv_buffer[TWAMP_STAMP_PACKET_SIZE];
+            sockaddr_in6 from_addr{};
+            TwampTimestamps rx;
+            ssize_t len = twamp_recv(flow_fd(f), recv_buffer, sizeof(recv_buffer), 0, (sockaddr*)&from_addr, sizeof(from_addr), &rx);
+            uint64_t recv_time = get_current_time_ns();
+            if (len < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    perror("recvfrom error");
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            if (len < TWAMP_LIGHT_MIN_PACKET_SIZE)
+                continue;
+            handle_reply(recv_buffer, len, from_addr, rx, recv_time, timeout_ns);
+        }
+    }
+}
+
+//run() below for IPv4 or IPv6 peers, skipping any that do not parse
+std::unordered_map<std::string, TwampProbeResult> TwampLightProbeEngine::run(const std::vector<std::string>& peers, int num_packets, int interval_ms, int timeout_ms) {
+    std::unordered_map<std::string, TwampProbeResult> results;
+    std::vector<std::string> names;
+    std::vector<in6_addr> addrs;
+    for (const auto &peer: peers) {
+        TwampPeerKey key;
+        if (!TwampPeerKey::parse(peer, &key)) {
+            std::cerr << get_current_timestamp() << " Skipping invalid peer address " << peer << std::endl;
+            continue;
+        }
+        addrs.push_back(key.to_in6());
+        names.push_back(peer);
+    }
+    std::vector<TwampProbeResult> by_addr = run(addrs, num_packets, interval_ms, timeout_ms);
+    for (size_t t = 0; t < names.size(); ++t)
+        results[names[t]] = by_addr[t];
+    return results;
+}
+
+/*
+ * Sends the rounds from this thread and waits for the replies in epoll.
+ * A round the pacing holds back goes on from where it stopped once
+ * pace_fd fires. With an ECMP sweep a round is a probe to every target
+ * from each flow in turn.
+ */
+void TwampLightProbeEngine::probe_epoll(int num_packets, uint64_t interval_ns, uint64_t timeout_ns) {
+    const size_t round_size = targets.size() * nr_flows();
+    uint64_t next_send = get_current_time_ns();
+    uint64_t deadline = next_send;
+    uint64_t resume = 0;
+    int round = 0;
+    round_pos = round_size;
+
+    while (!targets.empty()) {
+        uint64_t now = get_current_time_ns();
+        if (round_pos == round_size && round < num_packets && now >= next_send)
+            round_pos = 0;
+        if (round_pos < round_size && now >= resume) {
+            for (; round_pos < round_size; ++round_pos) {
+                size_t t = round_pos % targets.size(), flow = round_pos / targets.size();
+                //an IPv6 peer without IPv6 on this host: all its probes are lost
+                if (!targets[t].addr_len)
+                    continue;
+                uint64_t at;
+                if (!pace_probe(get_current_time_ns(), &at)) {
+                    resume = at;
+                    break;
+                }
+                uint32_t seq = next_seq++;
+                uint64_t send_time = get_current_time_ns(), txtime_at = 0;
+                if (at > send_time)
+                    send_time = txtime_at = at;
+                size_t len = build_probe(send_buffer.data(), send_buffer.size(), seq, send_time);
+                ssize_t sent = send_probe(t, flow, len, txtime_at);
+                //a probe the kernel would not take counts as lost
+                if (sent < 0)
+                    continue;
+                pending[seq] = {t, uint16_t(flow), send_time, TwampTimestamps()};
+                if (ts_mode == TWAMP_TS_KERNEL_TXRX)
+                    tx_id_to_seq[uint64_t(flow) << 32 | next_tx_ids[flow]++] = seq;
+                deadline = send_time + timeout_ns;
+            }
+            if (round_pos == round_size) {
+                ++round;
+                next_send += interval_ns;
+            }
+            continue;
+        }
+        if (round >= num_packets && (pending.empty() || now >= deadline))
+            break;
+        uint64_t wake;
+        if (round_pos < round_size) {
+            wake = resume;
+            //epoll_wait() only has milliseconds
+            if (pace_fd >= 0) {
+                itimerspec its{};
+                its.it_value.tv_sec = resume / 1000000000;
+                its.it_value.tv_nsec = resume % 1000000000;
+                timerfd_settime(pace_fd, TFD_TIMER_ABSTIME, &its, nullptr);
+            }
+        } else
+            wake = (round < num_packets) ? next_send : deadline;
+        int wait_ms = wake > now ? int((wake - now + 999999) / 1000000) : 0;
+        epoll_event evs[2];
+        int n = epoll_wait(epfd, evs, 2, wait_ms);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        bool replies = false;
+        for (int e = 0; e < n; ++e) {
+            if (evs[e].data.fd == pace_fd) {
+                uint64_t expirations;
+                if (read(pace_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                    perror("pacing timer");
+            } else
+                replies = true;
+        }
+        if (replies)
+            drain(timeout_ns);
+    }
+}
+
+#if defined(TWAMP_HAVE_IO_URING)
+//receives kept posted on the socket, and sends queued before each submission
+#define TWAMP_URING_RECVS 256
+#define TWAMP_URING_SEND_BATCH 64
+
+//what a completion is for, in the top byte of its user_data
+#define TWAMP_URING_RECV 1
+#define TWAMP_URING_SEND 2
+#define TWAMP_URING_TIMER 3
+#define TWAMP_URING_ID_MASK ((uint64_t(1) << 56) - 1)
+#define TWAMP_URING_TAG(kind, id) ((uint64_t(kind) << 56) | ((id) & TWAMP_URING_ID_MASK))
+
+//an entry to fill, submitting what is queued while the ring is full
+static io_uring_sqe *twamp_uring_next_sqe(TwampUring &uring) {
+    io_uring_sqe *sqe;
+    while (!(sqe = uring.get_sqe()))
+        if (uring.submit() < 0 && errno != EINTR)
+            return nullptr;
+    return sqe;
+}
+
+bool TwampLightProbeEngine::start_uring() {
+    if (uring)
+        return true;
+    if (rx_thread.joinable() || nr_flows() > 1)
+        return false;
+    std::unique_ptr<TwampUring> ring(new TwampUring());
+    if (!ring->init(4096))
+        return false;
+    //io_uring completes a receive on a non-blocking socket at once with EAGAIN instead of arming it
+    int flags = fcntl(sockfd, F_GETFL);
+    if (flags < 0 || fcntl(sockfd, F_SETFL, flags & ~O_NONBLOCK) < 0)
+        return false;
+    uring = std::move(ring);
+    uring_recvs.resize(TWAMP_URING_RECVS);
+    for (size_t slot = 0; slot < uring_recvs.size(); ++slot)
+        uring_post_recv(slot);
+    if (uring->submit() < 0) {
+        perror("io_uring_enter");
+        uring.reset();
+        uring_recvs.clear();
+        fcntl(sockfd, F_SETFL, flags);
+        return false;
+    }
+    return true;
+}
+
+bool TwampLightProbeEngine::uring_post_recv(size_t slot) {
+    io_uring_sqe *sqe = twamp_uring_next_sqe(*uring);
+    if (!sqe)
+        return false;
+    uring_recv &r = uring_recvs[slot];
+    r.iov.iov_base = r.data;
+    r.iov.iov_len = sizeof(r.data);
+    r.msg = msghdr();
+    r.msg.msg_name = &r.from;
+    r.msg.msg_namelen = sizeof(r.from);
+    r.msg.msg_iov = &r.iov;
+    r.msg.msg_iovlen = 1;
+    r.msg.msg_control = r.control;
+    r.msg.msg_controllen = sizeof(r.control);
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = sockfd;
+    sqe->addr = uint64_t(uintptr_t(&r.msg));
+    sqe->len = 1;
+    sqe->user_data = TWAMP_URING_TAG(TWAMP_URING_RECV, slot);
+    return true;
+}
+
+//at_ns on the same clock as get_current_time_ns(); replaces any earlier timer
+bool TwampLightProbeEngine::uring_post_timer(uint64_t at_ns) {
+    io_uring_sqe *sqe = twamp_uring_next_sqe(*uring);
+    if (!sqe)
+        return false;
+    uring_ts.tv_sec = at_ns / 1000000000;
+    uring_ts.tv_nsec = at_ns % 1000000000;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = uint64_t(uintptr_t(&uring_ts));
+    sqe->len = 1;
+    sqe->timeout_flags = IORING_TIMEOUT_ABS | IORING_TIMEOUT_REALTIME;
+    sqe->user_data = TWAMP_URING_TAG(TWAMP_URING_TIMER, ++uring_timer);
+    return true;
+}
+
+/*
+ * A probe to every target, submitted every TWAMP_URING_SEND_BATCH so a
+ * probe's send time is never far from when the kernel gets it.
+ */
+uint64_t TwampLightProbeEngine::uring_send_round() {
+    const size_t size = send_buffer.size();
+    const size_t ctrl_size = CMSG_SPACE(sizeof(uint64_t));
+    size_t queued = 0;
+    uint64_t resume = 0;
+    for (; round_pos < targets.size(); ++round_pos) {
+        size_t t = round_pos;
+        //an IPv6 peer without IPv6 on this host: all its probes are lost
+        if (!targets[t].addr_len)
+            continue;
+        uint64_t at;
+        if (!pace_probe(get_current_time_ns(), &at)) {
+            resume = at;
+            break;
+        }
+        io_uring_sqe *sqe = twamp_uring_next_sqe(*uring);
+        if (!sqe) {
+            perror("io_uring_enter");
+            round_pos = targets.size();
+            break;
+        }
+        uint8_t *buf = &uring_send_bufs[t * size];
+        uint32_t seq = next_seq++;
+        uint64_t send_time = get_current_time_ns(), txtime_at = 0;
+        if (at > send_time)
+            send_time = txtime_at = at;
+        uring_send_iovs[t].iov_base = buf;
+        uring_send_iovs[t].iov_len = build_probe(buf, size, seq, send_time);
+        msghdr &msg = uring_send_msgs[t];
+        msg = msghdr();
+        msg.msg_name = &targets[t].addr.sa;
+        msg.msg_namelen = targets[t].addr_len;
+        msg.msg_iov = &uring_send_iovs[t];
+        msg.msg_iovlen = 1;
+        if (txtime_at) {
+            msg.msg_control = &uring_send_ctrls[t * ctrl_size];
+            msg.msg_controllen = ctrl_size;
+            twamp_set_txtime(&msg, txtime_at);
+        }
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = sockfd;
+        sqe->addr = uint64_t(uintptr_t(&msg));
+        sqe->len = 1;
+        //only a failed send needs an answer
+        if (uring->can_skip_success())
+            sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+        sqe->user_data = TWAMP_URING_TAG(TWAMP_URING_SEND, seq);
+        pending[seq] = {t, 0, send_time, TwampTimestamps()};
+        if (ts_mode == TWAMP_TS_KERNEL_TXRX)
+            tx_id_to_seq[next_tx_ids[0]++] = seq;
+        if (++queued % TWAMP_URING_SEND_BATCH == 0 && uring->submit() < 0 && errno != EINTR)
+            perror("io_uring_enter");
+    }
+    return resume;
+}
+
+/*
+ * The same cycle as probe_epoll(), with one io_uring_enter() per wakeup
+ * doing the sends, the waiting and the receiving: a timer paces the rounds
+ * and, after the last, ends the cycle at its timeout.
+ */
+void TwampLightProbeEngine::probe_uring(int num_packets, uint64_t interval_ns, uint64_t timeout_ns) {
+    uring_send_msgs.resize(targets.size());
+    uring_send_iovs.resize(targets.size());
+    uring_send_bufs.resize(targets.size() * send_buffer.size());
+    if (txtime_ahead_ns)
+        uring_send_ctrls.resize(targets.size() * CMSG_SPACE(sizeof(uint64_t)));
+    uint64_t next_send = get_current_time_ns();
+    int round = 0;
+    bool timer_fired = true;
+    round_pos = targets.size();
+
+    while (!targets.empty()) {
+        if (timer_fired) {
+            timer_fired = false;
+            if (round_pos == targets.size()) {
+                //the last round has timed out
+                if (round >= num_packets)
+                    break;
+                round_pos = 0;
+            }
+            //a round held back by the pacing goes on at its timer
+            uint64_t wake = uring_send_round();
+            if (!wake) {
+                ++round;
+                next_send += interval_ns;
+                wake = (round < num_packets) ? next_send : get_current_time_ns() + timeout_ns;
+            }
+            if (!uring_post_timer(wake)) {
+                perror("io_uring_enter");
+                break;
+            }
+        }
+        if (round >= num_packets && pending.empty())
+            break;
+        if (uring->submit(1) < 0 && errno != EINTR) {
+            perror("io_uring_enter");
+            break;
+        }
+        //send timestamps first, for the replies about to be matched
+        if (ts_mode == TWAMP_TS_KERNEL_TXRX)
+            drain_tx_timestamps();
+        io_uring_cqe *cqe;
+        while (uring->peek(&cqe)) {
+            uint64_t data = cqe->user_data;
+            int res = cqe->res;
+            uring->seen();
+            switch (data >> 56) {
+            case TWAMP_URING_RECV: {
+                uring_recv &r = uring_recvs[data & TWAMP_URING_ID_MASK];
+                if (res >= TWAMP_LIGHT_MIN_PACKET_SIZE) {
+                    uint64_t recv_time = get_current_time_ns();
+                    TwampTimestamps rx;
+                    twamp_parse_timestamps(&r.msg, &rx);
+                    handle_reply(r.data, res, r.from, rx, recv_time, timeout_ns);
+                } else if (res < 0 && res != -EINTR && res != -EAGAIN) {
+                    errno = -res;
+                    perror("recvmsg error");
+                }
+                uring_post_recv(data & TWAMP_URING_ID_MASK);
+                break;
+            }
+            case TWAMP_URING_SEND:
+                //a probe the kernel would not take counts as lost
+                if (res < 0)
+                    pending.erase(uint32_t(data));
+                break;
+            case TWAMP_URING_TIMER:
+                //timers of an earlier round or cycle only complete
+                if ((data & TWAMP_URING_ID_MASK) == (uring_timer & TWAMP_URING_ID_MASK))
+                    timer_fired = true;
+                break;
+            }
+        }
+    }
+}
+#else
+bool TwampLightProbeEngine::start_uring() {
+    return false;
+}
+#endif
+
+/*
+ * Runs one probe cycle against all peers at once: every interval_ms one probe
+ * goes out to each peer, and replies are collected as they arrive. The cycle
+ * ends once every probe is answered or the last one has timed out, so it takes
+ * about (num_packets - 1) * interval_ms + timeout_ms however many peers there are.
+ * With an ECMP sweep every peer gets num_packets probes from each flow.
+ */
+std::vector<TwampProbeResult> TwampLightProbeEngine::run(const std::vector<in6_addr>& peers, int num_packets, int interval_ms, int timeout_ms) {
+    std::vector<TwampProbeResult> results(peers.size());
+    if (!reachable)
+        return results;
+    targets.clear();
+    pending.clear();
+    tx_id_to_seq.clear();
+    if (stamp)
+        clock = twamp_clock_status();
+    for (const auto &peer: peers) {
+        probe_target target{};
+        if (family == AF_INET6) {
+            target.addr.sin6.sin6_family = AF_INET6;
+            target.addr.sin6.sin6_port = htons(reflector_port);
+            target.addr.sin6.sin6_addr = peer;
+            target.addr_len = sizeof(sockaddr_in6);
+        } else if (IN6_IS_ADDR_V4MAPPED(&peer)) {
+            target.addr.sin.sin_family = AF_INET;
+            target.addr.sin.sin_port = htons(reflector_port);
+            memcpy(&target.addr.sin.sin_addr, &peer.s6_addr[12], sizeof(in_addr));
+            target.addr_len = sizeof(sockaddr_in);
+        }
+        targets.push_back(target);
+    }
+
+    //no peer probed faster than its cap
+    const uint64_t interval_ns = std::max(uint64_t(interval_ms) * 1000000, peer_interval_ns);
+    const uint64_t timeout_ns = uint64_t(timeout_ms) * 1000000;
+#if defined(TWAMP_HAVE_IO_URING)
+    if (uring)
+        probe_uring(num_packets, interval_ns, timeout_ns);
+    else
+#endif
+        probe_epoll(num_packets, interval_ns, timeout_ns);
+
+    for (size_t t = 0; t < targets.size(); ++t) {
+        const std::vector<double> &rtts_ms = targets[t].rtts_ms;
+        const std::vector<uint16_t> &rtt_flows = targets[t].rtt_flows;
+        TwampProbeResult &res = results[t];
+        res.received = rtts_ms.size();
+        if (rtts_ms.empty())
+            continue;
+        res.avg_rtt_ms = std::accumulate(rtts_ms.begin(), rtts_ms.end(), 0.0) / rtts_ms.size();
+        std::vector<double> sorted(rtts_ms);
+        std::sort(sorted.begin(), sorted.end());
+        size_t mid = sorted.size() / 2;
+        res.median_rtt_ms = sorted.size() % 2 ? sorted[mid] : (sorted[mid - 1] + sorted[mid]) / 2;
+        res.p90_rtt_ms = sorted[size_t(std::ceil(0.9 * sorted.size())) - 1];
+        res.rtt_ms = res.median_rtt_ms;
+        res.loss = 100.0 - (static_cast<double>(rtts_ms.size()) / (num_packets * nr_flows())) * 100;
+        //between replies of the same flow: the flows' paths differing is not jitter
+        std::vector<double> last(nr_flows(), -1.0);
+        double sum = 0.0;
+        size_t pairs = 0;
+        for (size_t i = 0; i < rtts_ms.size(); ++i) {
+            double &prev = last[rtt_flows[i]];
+            if (prev >= 0) {
+                sum += std::abs(rtts_ms[i] - prev);
+                ++pairs;
+            }
+            prev = rtts_ms[i];
+        }
+        if (pairs)
+            res.jitter_ms = sum / pairs;
+        if (nr_flows() == 1)
+            continue;
+        res.flows.resize(nr_flows());
+        for (size_t f = 0; f < nr_flows(); ++f)
+            res.flows[f].port = flow_ports[f];
+        for (size_t i = 0; i < rtts_ms.size(); ++i) {
+            TwampFlowResult &flow = res.flows[rtt_flows[i]];
+            if (!flow.received || rtts_ms[i] < flow.min_rtt_ms)
+                flow.min_rtt_ms = rtts_ms[i];
+            flow.avg_rtt_ms += rtts_ms[i];
+            ++flow.received;
+        }
+        double lowest = 0, highest = 0;
+        bool any = false;
+        for (auto &flow: res.flows) {
+            if (!flow.received)
+                continue;
+            flow.avg_rtt_ms /= flow.received;
+            lowest = any ? std::min(lowest, flow.min_rtt_ms) : flow.min_rtt_ms;
+            highest = any ? std::max(highest, flow.min_rtt_ms) : flow.min_rtt_ms;
+            any = true;
+        }
+        res.spread_ms = highest - lowest;
+    }
+    for (size_t t = 0; t < targets.size(); ++t) {
+        TwampProbeResult &res = results[t];
+        const TwampWakeupStats &wakeup = targets[t].wakeup;
+        res.wakeups = wakeup.count;
+        res.wakeup_us = wakeup.mean_us();
+        res.wakeup_jitter_us = wakeup.jitter_us();
+        std::vector<double> &forward = targets[t].forward_ms, &reverse = targets[t].reverse_ms;
+        res.one_way = forward.size();
+        if (forward.empty())
+            continue;
+        std::sort(forward.begin(), forward.end());
+        std::sort(reverse.begin(), reverse.end());
+        size_t mid = forward.size() / 2;
+        res.forward_ms = forward.size() % 2 ? forward[mid] : (forward[mid - 1] + forward[mid]) / 2;
+        res.reverse_ms = reverse.size() % 2 ? reverse[mid] : (reverse[mid - 1] + reverse[mid]) / 2;
+        res.clock_error_ms = targets[t].clock_error_ns / 1e6;
+    }
+    pending.clear();
+    tx_id_to_seq.clear();
+    return results;
+}
+
+bool twamp_parse_rtt_stat(const std::string &name, int *stat) {
+    static const char *const names[] = {"mean", "median", "p90", "ewma"};
+    for (int i = 0; i < int(sizeof(names) / sizeof(names[0])); ++i) {
+        if (name == names[i]) {
+            *stat = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void twamp_smooth_rtt(TwampProbeResult &res, int stat, double alpha, double &ewma_ms) {
+    if (!res.received)
+        return;
+    switch (stat) {
+    case TWAMP_RTT_MEAN:
+        res.rtt_ms = res.avg_rtt_ms;
+        break;
+    case TWAMP_RTT_P90:
+        res.rtt_ms = res.p90_rtt_ms;
+        break;
+    case TWAMP_RTT_EWMA:
+        //the median keeps one delayed probe from dragging the average along
+        ewma_ms = ewma_ms > 0 ? alpha * res.median_rtt_ms + (1 - alpha) * ewma_ms : res.median_rtt_ms;
+        res.rtt_ms = ewma_ms;
+        break;
+    default:
+        res.rtt_ms = res.median_rtt_ms;
+        break;
+    }
+}
@@ -0,0 +1,182 @@
+#include "twamp_light.hpp"
+#include <functional>
+
+TwampMetricsExporter::~TwampMetricsExporter() {
+    if (listen_fd >= 0)
+        close(listen_fd);
+}
+
+bool TwampMetricsExporter::start(int port) {
+    sockaddr_in6 addr{};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(port);
+    listen_fd = socket(AF_INET6, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("metrics socket");
+        return false;
+    }
+    int on = 1, off = 0;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    //answer scrapes over IPv4 as well
+    setsockopt(listen_fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    if (bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 16) < 0) {
+        perror("metrics bind");
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    std::thread([this]{ serve(); }).detach();
+    std::cout << get_current_timestamp() << " Serving metrics on port " << port << std::endl;
+    return true;
+}
+
+//peer="<address>",vrf="<ifindex>",dscp="<class>"; the address without the suffixes of str()
+std::string TwampMetricsExporter::peer_labels(const TwampPeerKey &key) {
+    char buf[INET6_ADDRSTRLEN];
+    if (!inet_ntop(key.family, key.addr, buf, sizeof(buf)))
+        buf[0] = '\0';
+    return std::string("peer=\"") + buf + "\",vrf=\"" + std::to_string(key.vrf) + "\",dscp=\"" + std::to_string(key.dscp) + "\"";
+}
+
+void TwampMetricsExporter::record(const TwampPeerKey &key, const TwampProbeResult &res, int sent) {
+    std::string labels = peer_labels(key);
+    std::lock_guard<std::mutex> guard(lock);
+    peer_metrics &m = peers[labels];
+    m.labels = labels;
+    m.last = res;
+    ++m.rounds;
+    m.sent += sent;
+    m.received += res.received;
+    m.updated = time(nullptr);
+    ++rounds_total;
+}
+
+void TwampMetricsExporter::forget(const TwampPeerKey &key) {
+    std::string labels = peer_labels(key);
+    std::lock_guard<std::mutex> guard(lock);
+    peers.erase(labels);
+}
+
+std::string TwampMetricsExporter::render() const {
+    std::ostringstream out;
+    std::lock_guard<std::mutex> guard(lock);
+    out << "# HELP twamp_peers Peers being probed\n"
+        << "# TYPE twamp_peers gauge\n"
+        << "twamp_peers " << peers.size() << "\n"
+        << "# HELP twamp_rounds_total Probe rounds run, all peers\n"
+        << "# TYPE twamp_rounds_total counter\n"
+        << "twamp_rounds_total " << rounds_total << "\n";
+    //one family at a time, as the exposition format wants them grouped
+    struct family{
+        const char *name, *type, *help;
+        std::function<void(std::ostream&, const peer_metrics&)> value;
+    };
+    const family families[] = {
+        {"twamp_peer_rtt_seconds", "gauge", "Published round trip time of the last round",
+         [](std::ostream &o, const peer_metrics &m) { o << m.last.rtt_ms / 1000; }},
+        {"twamp_peer_rtt_median_seconds", "gauge", "Median round trip time of the last round",
+         [](std::ostream &o, const peer_metrics &m) { o << m.last.median_rtt_ms / 1000; }},
+        {"twamp_peer_rtt_p90_seconds", "gauge", "90th percentile round trip time of the last round",
+         [](std::ostream &o, const peer_metrics &m) { o << m.last.p90_rtt_ms / 1000; }},
+        {"twamp_peer_jitter_seconds", "gauge", "Jitter of the last round",
+         [](std::ostream &o, const peer_metrics &m) { o << m.last.jitter_ms / 1000; }},
+        {"twamp_peer_loss_ratio", "gauge", "Share of the last round's probes that got no reply",
+         [](std::ostream &o, const peer_metrics &m) { o << m.last.loss / 100; }},
+        {"twamp_peer_reachable", "gauge", "1 if the last round got any reply",
+         [](std::ostream &o, const peer_metrics &m) { o << (m.last.received ? 1 : 0); }},
+        {"twamp_peer_rounds_total", "counter", "Probe rounds run",
+         [](std::ostream &o, const peer_metrics &m) { o << m.rounds; }},
+        {"twamp_peer_probes_sent_total", "counter", "Probes sent",
+         [](std::ostream &o, const peer_metrics &m) { o << m.sent; }},
+        {"twamp_peer_probes_received_total", "counter", "Replies received",
+         [](std::ostream &o, const peer_metrics &m) { o << m.received; }},
+        {"twamp_peer_last_round_timestamp_seconds", "gauge", "Time of the last round",
+         [](std::ostream &o, const peer_metrics &m) { o << m.updated; }},
+        {"twamp_peer_ecmp_spread_seconds", "gauge", "Between the lowest and highest minimum RTT of the ECMP sweep's flows",
+         [](std::ostream &o, const peer_metrics &m) { o << m.last.spread_ms / 1000; }},
+        {"twamp_peer_forward_delay_seconds", "gauge", "One-way delay towards the peer, from STAMP with both clocks synchronized",
+         [](std::ostream &o, const peer_metrics &m) { o << m.last.forward_ms / 1000; }},
+        {"twamp_peer_reverse_delay_seconds", "gauge", "One-way delay back from the peer, from STAMP with both clocks synchronized",
+         [](std::ostream &o, const peer_metrics &m) { o << m.last.reverse_ms / 1000; }},
+        {"twamp_peer_clock_error_seconds", "gauge", "Bound on the error of the one-way delays, from both clocks' estimates",
+         [](std::ostream &o, const peer_metrics &m) { o << m.last.clock_error_ms / 1000; }},
+        {"twamp_peer_rx_wakeup_seconds", "gauge", "Mean delay between the kernel timestamping a reply and the agent reading it",
+         [](std::ostream &o, const peer_metrics &m) { o << m.last.wakeup_us / 1e6; }},
+        {"twamp_peer_rx_wakeup_jitter_seconds", "gauge", "Standard deviation of that delay, the noise user-space timestamps would add",
+         [](std::ostream &o, const peer_metrics &m) { o << m.last.wakeup_jitter_us / 1e6; }},
+    };
+    for (const auto &f: families) {
+        out << "# HELP " << f.name << " " << f.help << "\n# TYPE " << f.name << " " << f.type << "\n";
+        for (const auto &p: peers) {
+            out << f.name << "{" << p.second.labels << "} ";
+            f.value(out, p.second);
+            out << "\n";
+        }
+    }
+    //the sweep's flows, by source port; nothing without a sweep
+    struct flow_family{
+        const char *name, *help;
+        double TwampFlowResult::*value;
+    };
+    const flow_family flow_families[] = {
+        {"twamp_flow_rtt_min_seconds", "Minimum RTT of the last round from one source port", &TwampFlowResult::min_rtt_ms},
+        {"twamp_flow_rtt_mean_seconds", "Mean RTT of the last round from one source port", &TwampFlowResult::avg_rtt_ms},
+    };
+    for (const auto &f: flow_families) {
+        out << "# HELP " << f.name << " " << f.help << "\n# TYPE " << f.name << " gauge\n";
+        for (const auto &p: peers)
+            for (const auto &flow: p.second.last.flows)
+                if (flow.received)
+                    out << f.name << "{" << p.second.labels << ",sport=\"" << flow.port << "\"} " << flow.*f.value / 1000 << "\n";
+    }
+    return out.str();
+}
+
+//one request per connection; anything but GET /metrics is a 404
+void TwampMetricsExporter::answer(int fd) const {
+    //a client that never finishes its request does not hold up the next scrape
+    timeval tv{1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    char req[1024];
+    ssize_t n = recv(fd, req, sizeof(req) - 1, 0);
+    if (n <= 0)
+        return;
+    req[n] = '\0';
+    std::string head(req, strcspn(req, "\r\n"));
+    std::string status = "200 OK", body;
+    if (head.compare(0, 13, "GET /metrics ") == 0 || head == "GET /metrics")
+        body = render();
+    else {
+        status = "404 Not Found";
+        body = "Not found, try /metrics\n";
+    }
+    std::string reply = "HTTP/1.0 " + status + "\r\n"
+                        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                        "Connection: close\r\n\r\n" + body;
+    size_t off = 0;
+    while (off < reply.size()) {
+        ssize_t w = send(fd, reply.data() + off, reply.size() - off, MSG_NOSIGNAL);
+        if (w <= 0)
+            return;
+        off += w;
+    }
+}
+
+void TwampMetricsExporter::serve() {
+    while (true) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            //EBADF: closed on the way out
+            if (errno != EBADF)
+                perror("metrics accept");
+            return;
+        }
+        answer(fd);
+        close(fd);
+    }
+}
@@ -1,38 +1,153 @@
 #include "twamp_light.hpp"
 
+constexpr size_t TwampLightPacket::seq_offset;
+constexpr size_t TwampLightPacket::sender_ts_offset;
+constexpr size_t TwampLightPacket::receiver_ts_offset;
+constexpr size_t TwampLightPacket::transmit_ts_offset;
+
 //constructor definiton
-TwampLightPacket::TwampLightPacket(uint32_t seq, uint64_t sender_ts, uint64_t receiver_ts)
+TwampLightPacket::TwampLightPacket(uint32_t seq, uint64_t sender_ts, uint64_t receiver_ts, uint64_t transmit_ts)
 {
     sequence_number = seq;
     sender_timestamp = sender_ts;
     receiver_timestamp = receiver_ts;
+    transmit_timestamp = transmit_ts;
 }
-//serialize definiton
-std::vector<uint8_t> TwampLightPacket::serialize() const {
-    //vector of 20 bytes
+//serialize into a caller buffer
+size_t TwampLightPacket::serialize_into(uint8_t *buf, size_t buf_len, size_t padded_size) const {
+    //28 bytes of header
     //4 for the sequence number
     //8 for the sender timestamp
-    //8 for the receiver timestamp.
-    std::vector<uint8_t> buffer(20);
+    //8 for the receiver timestamp
+    //8 for the transmit timestamp
+    //then zeros up to padded_size.
+    size_t len = padded_size > TWAMP_LIGHT_PACKET_SIZE ? padded_size : TWAMP_LIGHT_PACKET_SIZE;
+    if (len > buf_len)
+        return 0;
     //interges to big endian byte order
     uint32_t seq_net = htobe32(sequence_number);
     uint64_t sender_ts_net = htobe64(sender_timestamp);
     uint64_t receiver_ts_net = htobe64(receiver_timestamp);
+    uint64_t transmit_ts_net = htobe64(transmit_timestamp);
     //copy the byte stream to buffer
-    memcpy(buffer.data(), &seq_net, 4);
-    memcpy(buffer.data() + 4, &sender_ts_net, 8);
-    memcpy(buffer.data() + 12, &receiver_ts_net, 8);
+    memcpy(buf + seq_offset, &seq_net, 4);
+    memcpy(buf + sender_ts_offset, &sender_ts_net, 8);
+    memcpy(buf + receiver_ts_offset, &receiver_ts_net, 8);
+    memcpy(buf + transmit_ts_offset, &transmit_ts_net, 8);
+    memset(buf + TWAMP_LIGHT_PACKET_SIZE, 0, len - TWAMP_LIGHT_PACKET_SIZE);
+    return len;
+}
+//serialize definiton
+std::vector<uint8_t> TwampLightPacket::serialize() const {
+    std::vector<uint8_t> buffer(TWAMP_LIGHT_PACKET_SIZE);
+    serialize_into(buffer.data(), buffer.size());
     return buffer;
 }
 //derialize definiton
 TwampLightPacket TwampLightPacket::deserialize(const uint8_t* data, size_t length) {
-    uint32_t seq_net;
-    uint64_t sender_ts_net, receiver_ts_net;
-    memcpy(&seq_net, data, 4);
-    memcpy(&sender_ts_net, data + 4, 8);
-    memcpy(&receiver_ts_net, data + 12, 8);
-    uint32_t seq = ntohl(seq_net);
-    uint64_t sender_ts = be64toh(sender_ts_net);
-    uint64_t receiver_ts = be64toh(receiver_ts_net);
-    return TwampLightPacket(seq, sender_ts, receiver_ts);
-}
\ No newline at end of file
+    TwampLightPacketView view;
+    if (!TwampLightPacketView::parse(data, length, &view))
+        return TwampLightPacket();
+    return view.packet();
+}
+constexpr size_t TwampStampPacket::seq_offset;
+constexpr size_t TwampStampPacket::timestamp_offset;
+constexpr size_t TwampStampPacket::error_offset;
+constexpr size_t TwampStampPacket::ssid_offset;
+constexpr size_t TwampStampPacket::receive_ts_offset;
+constexpr size_t TwampStampPacket::sender_seq_offset;
+constexpr size_t TwampStampPacket::sender_ts_offset;
+constexpr size_t TwampStampPacket::sender_error_offset;
+constexpr size_t TwampStampPacket::sender_ttl_offset;
+
+//seconds from 1900, the NTP era, to 1970
+#define TWAMP_NTP_UNIX_OFFSET 2208988800ULL
+
+static inline void put_be16(uint8_t *p, uint16_t v){
+    v = htobe16(v);
+    memcpy(p, &v, 2);
+}
+
+static inline void put_be32(uint8_t *p, uint32_t v){
+    v = htobe32(v);
+    memcpy(p, &v, 4);
+}
+
+static inline void put_be64(uint8_t *p, uint64_t v){
+    v = htobe64(v);
+    memcpy(p, &v, 8);
+}
+
+//error = multiplier * 2^(scale - 32) seconds, rounded up so it stays a bound
+uint16_t twamp_error_estimate(bool synced, uint64_t error_ns){
+    //in units of 2^-32 s
+    uint64_t units = error_ns ? (error_ns * 4294967296.0) / 1e9 + 1 : 1;
+    unsigned int scale = 0;
+    while (units > 0xff && scale < 0x3f) {
+        units = (units + 1) / 2;
+        ++scale;
+    }
+    return (synced ? TWAMP_ERR_SYNC : 0) | (scale << 8) | std::min<uint64_t>(units, 0xff);
+}
+
+uint64_t twamp_error_estimate_ns(uint16_t error_estimate){
+    unsigned int scale = (error_estimate >> 8) & 0x3f;
+    double seconds = std::ldexp(double(error_estimate & 0xff), int(scale) - 32);
+    return uint64_t(std::min(seconds * 1e9, 1e18));
+}
+
+uint64_t twamp_ntp_from_ns(uint64_t ns){
+    uint64_t sec = ns / 1000000000ULL + TWAMP_NTP_UNIX_OFFSET;
+    uint64_t frac = ((ns % 1000000000ULL) << 32) / 1000000000ULL;
+    return sec << 32 | frac;
+}
+
+uint64_t twamp_ns_from_ntp(uint64_t ntp){
+    uint64_t sec = ntp >> 32;
+    if (sec < TWAMP_NTP_UNIX_OFFSET)
+        return 0;
+    return (sec - TWAMP_NTP_UNIX_OFFSET) * 1000000000ULL + (((ntp & 0xffffffffULL) * 1000000000ULL) >> 32);
+}
+
+uint64_t twamp_ns_from_stamp(uint64_t ts, uint16_t error_estimate, int tai_offset_s){
+    if (!(error_estimate & TWAMP_ERR_PTP))
+        return twamp_ns_from_ntp(ts);
+    //PTPv2 truncated: 32 bits of seconds, 32 of nanoseconds
+    int64_t sec = int64_t(ts >> 32) - tai_offset_s;
+    uint64_t nsec = ts & 0xffffffffULL;
+    if (sec < 0 || nsec >= 1000000000ULL)
+        return 0;
+    return uint64_t(sec) * 1000000000ULL + nsec;
+}
+
+size_t TwampStampPacket::serialize_into(uint8_t *buf, size_t buf_len, size_t padded_size, uint32_t seq, uint64_t timestamp_ns,
+                                        uint16_t error_estimate, uint16_t ssid){
+    size_t len = std::max(padded_size, size_t(TWAMP_STAMP_PACKET_SIZE));
+    if (len > buf_len)
+        return 0;
+    memset(buf, 0, len);
+    put_be32(buf + seq_offset, seq);
+    put_be64(buf + timestamp_offset, twamp_ntp_from_ns(timestamp_ns));
+    put_be16(buf + error_offset, error_estimate);
+    put_be16(buf + ssid_offset, ssid);
+    return len;
+}
+
+bool TwampStampPacket::is_probe(const uint8_t *data, size_t length){
+    return data && length >= TWAMP_STAMP_PACKET_SIZE && length <= TWAMP_LIGHT_MAX_PACKET_SIZE && data[error_offset + 1] != 0;
+}
+
+void TwampStampPacket::reflect(uint8_t *data, uint64_t receive_ns, uint16_t error_estimate, uint8_t ttl){
+    uint8_t sender[sender_ts_offset - sender_seq_offset + 8 + 2];
+    //the sender's sequence number, timestamp and error estimate, in that order
+    memcpy(sender, data + seq_offset, 4 + 8 + 2);
+    memset(data + receive_ts_offset, 0, TWAMP_STAMP_PACKET_SIZE - receive_ts_offset);
+    memcpy(data + sender_seq_offset, sender, sizeof(sender));
+    data[sender_ttl_offset] = ttl;
+    put_be16(data + error_offset, error_estimate);
+    put_be64(data + receive_ts_offset, twamp_ntp_from_ns(receive_ns));
+}
+
+void TwampStampPacket::set_transmit(uint8_t *data, uint64_t transmit_ns){
+    put_be64(data + timestamp_offset, twamp_ntp_from_ns(transmit_ns));
+}
@@ -0,0 +1,103 @@
+/*
+ * Throughput of the packet parser, the per-probe work of the receive
+ * paths: a pool of probes of the sizes seen on the wire (legacy 20 byte,
+ * 28 byte, RFC 5357 41 byte, jumbo) mixed with malformed ones (truncated,
+ * empty, oversized), parsed over and over. Reported in millions of
+ * packets per second, for the zero-copy view and for deserialize(),
+ * which decodes every field into a TwampLightPacket.
+ *
+ * Usage: twamp_light_packet_bench [-n packets] [-k rounds]
+ */
+#include "twamp_light.hpp"
+using namespace std;
+
+//keeps the compiler from dropping the decoded fields
+static volatile uint64_t sink;
+
+static uint64_t mono_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct probe {
+    size_t offset;
+    size_t len;
+};
+
+int main(int argc, char* argv[]) {
+    size_t packets = 1 << 16;
+    int rounds = 50;
+
+    int i = 1;
+    while (i < argc) {
+        std::string arg = argv[i++];
+        if (arg == "-n" && i < argc) packets = std::stoul(argv[i++]);
+        else if (arg == "-k" && i < argc) rounds = std::stoi(argv[i++]);
+        else {
+            cerr << "Usage: " << argv[0] << " [-n packets] [-k rounds]" << endl;
+            return 1;
+        }
+    }
+    if (!packets || rounds < 1) {
+        cerr << "Need at least one packet and one round" << endl;
+        return 1;
+    }
+
+    //one in eight malformed, the rest mostly RFC 5357 sized
+    static const size_t sizes[] = {
+        TWAMP_LIGHT_RFC5357_SIZE, TWAMP_LIGHT_RFC5357_SIZE, TWAMP_LIGHT_RFC5357_SIZE,
+        TWAMP_LIGHT_PACKET_SIZE, TWAMP_LIGHT_MIN_PACKET_SIZE, 1472,
+        TWAMP_LIGHT_RFC5357_SIZE, 12,
+    };
+    mt19937_64 rng(1);
+    vector<probe> probes(packets);
+    size_t total = 0;
+    for (size_t n = 0; n < packets; ++n) {
+        probes[n].offset = total;
+        probes[n].len = sizes[n % (sizeof(sizes) / sizeof(sizes[0]))];
+        total += probes[n].len;
+    }
+    //the oversized one claims more than the largest probe, past the pool
+    vector<uint8_t> pool(total + TWAMP_LIGHT_MAX_PACKET_SIZE + 1);
+    for (size_t n = 0; n < packets; ++n) {
+        TwampLightPacket pkt(uint32_t(n), rng(), rng(), rng());
+        if (probes[n].len >= TWAMP_LIGHT_PACKET_SIZE)
+            pkt.serialize_into(pool.data() + probes[n].offset, probes[n].len, probes[n].len);
+        else
+            for (size_t b = 0; b < probes[n].len; ++b)
+                pool[probes[n].offset + b] = uint8_t(rng());
+    }
+    probes.push_back({0, TWAMP_LIGHT_MAX_PACKET_SIZE + 1});
+    probes.push_back({0, 0});
+
+    cout << "Parsing " << probes.size() << " packets (" << total / 1024 << " KiB) x " << rounds << " rounds" << endl;
+
+    uint64_t start = mono_ns(), acc = 0, parsed = 0;
+    for (int r = 0; r < rounds; ++r)
+        for (const auto &p: probes) {
+            TwampLightPacketView view;
+            if (!TwampLightPacketView::parse(pool.data() + p.offset, p.len, &view))
+                continue;
+            acc += view.sequence_number() + view.sender_timestamp() + view.reflector_dwell_ns();
+            ++parsed;
+        }
+    uint64_t view_ns = mono_ns() - start;
+    sink = acc;
+
+    start = mono_ns();
+    acc = 0;
+    for (int r = 0; r < rounds; ++r)
+        for (const auto &p: probes) {
+            TwampLightPacket pkt = TwampLightPacket::deserialize(pool.data() + p.offset, p.len);
+            acc += pkt.sequence_number + pkt.sender_timestamp + pkt.reflector_dwell_ns();
+        }
+    uint64_t copy_ns = mono_ns() - start;
+    sink = acc;
+
+    double n = double(probes.size()) * rounds;
+    cout << fixed << setprecision(1)
+         << "  view         " << setw(8) << n * 1e3 / view_ns << " Mpps " << setw(6) << view_ns / n << " ns/packet, "
+         << parsed / rounds << " of " << probes.size() << " valid" << endl
+         << "  deserialize  " << setw(8) << n * 1e3 / copy_ns << " Mpps " << setw(6) << copy_ns / n << " ns/packet" << endl;
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "twamp_light.hpp"
+#include <net/if.h>
+
+bool TwampPeerKey::parse(const std::string &s, TwampPeerKey *key){
+    *key = TwampPeerKey();
+    if (inet_pton(AF_INET, s.c_str(), key->addr) == 1) {
+        key->family = AF_INET;
+        return true;
+    }
+    in6_addr addr;
+    if (inet_pton(AF_INET6, s.c_str(), &addr) == 1) {
+        //::ffff:a.b.c.d is the same peer as a.b.c.d
+        *key = from_in6(addr);
+        return true;
+    }
+    return false;
+}
+
+TwampPeerKey TwampPeerKey::from_in6(const in6_addr &addr, uint32_t vrf){
+    TwampPeerKey key;
+    key.vrf = vrf;
+    if (IN6_IS_ADDR_V4MAPPED(&addr)) {
+        key.family = AF_INET;
+        memcpy(key.addr, &addr.s6_addr[12], 4);
+    } else {
+        key.family = AF_INET6;
+        memcpy(key.addr, &addr, sizeof(addr));
+    }
+    return key;
+}
+
+in6_addr TwampPeerKey::to_in6() const {
+    in6_addr addr{};
+    if (family == AF_INET) {
+        addr.s6_addr[10] = 0xff;
+        addr.s6_addr[11] = 0xff;
+        memcpy(&addr.s6_addr[12], this->addr, 4);
+    } else {
+        memcpy(&addr, this->addr, sizeof(addr));
+    }
+    return addr;
+}
+
+std::string TwampPeerKey::str() const {
+    char buf[INET6_ADDRSTRLEN];
+    if (!inet_ntop(family, addr, buf, sizeof(buf)))
+        return "?";
+    std::string s(buf);
+    char ifname[IF_NAMESIZE];
+    if (vrf)
+        s += "%" + (if_indextoname(vrf, ifname) ? std::string(ifname) : std::to_string(vrf));
+    if (dscp)
+        s += " dscp " + std::to_string(dscp);
+    return s;
+}
+
+static size_t peer_key_hash(const TwampPeerKey &key){
+    uint64_t w[2];
+    memcpy(w, key.addr, sizeof(w));
+    uint64_t h = (w[0] ^ (w[1] * 0x9e3779b97f4a7c15ULL) ^ key.family ^ (uint64_t(key.vrf) << 8) ^ (uint64_t(key.dscp) << 40)) * 0x9e3779b97f4a7c15ULL;
+    return size_t(h ^ (h >> 32));
+}
+
+size_t TwampPeerKeyHash::operator()(const TwampPeerKey &key) const {
+    return peer_key_hash(key);
+}
+
+//slot holding key, or slots.size() if it is not in the table
+size_t TwampPeerTable::locate(const TwampPeerKey &key) const {
+    if (slots.empty())
+        return slots.size();
+    size_t mask = slots.size() - 1;
+    for (size_t i = peer_key_hash(key) & mask, n = 0; n < slots.size(); i = (i + 1) & mask, ++n) {
+        if (slots[i].state == slot_empty)
+            break;
+        if (slots[i].state == slot_used && slots[i].key == key)
+            return i;
+    }
+    return slots.size();
+}
+
+latency_data *TwampPeerTable::find(const TwampPeerKey &key) {
+    size_t i = locate(key);
+    return i < slots.size() ? &slots[i].data : nullptr;
+}
+
+const latency_data *TwampPeerTable::find(const TwampPeerKey &key) const {
+    size_t i = locate(key);
+    return i < slots.size() ? &slots[i].data : nullptr;
+}
+
+void TwampPeerTable::rehash(size_t capacity) {
+    std::vector<slot> old;
+    old.swap(slots);
+    slots.resize(capacity);
+    count = used = 0;
+    for (const auto &s: old)
+        if (s.state == slot_used)
+            insert(s.key) = s.data;
+}
+
+latency_data &TwampPeerTable::insert(const TwampPeerKey &key) {
+    size_t i = locate(key);
+    if (i < slots.size())
+        return slots[i].data;
+    if ((used + 1) * 4 > slots.size() * 3) {
+        //mostly tombstones: the same size is enough
+        size_t capacity = slots.empty() ? 16 : slots.size();
+        if ((count + 1) * 2 > capacity)
+            capacity *= 2;
+        rehash(capacity);
+    }
+    size_t mask = slots.size() - 1;
+    for (i = peer_key_hash(key) & mask; slots[i].state == slot_used; i = (i + 1) & mask)
+        ;
+    if (slots[i].state == slot_empty)
+        ++used;
+    slots[i].key = key;
+    slots[i].data = latency_data();
+    slots[i].state = slot_used;
+    ++count;
+    return slots[i].data;
+}
+
+bool TwampPeerTable::erase(const TwampPeerKey &key) {
+    size_t i = locate(key);
+    if (i == slots.size())
+        return false;
+    slots[i].state = slot_dead;
+    --count;
+    return true;
+}
@@ -1,45 +1,518 @@
 #include "twamp_light.hpp"
 
+#if defined(__linux__)
+    #include <linux/filter.h>
+    #include <linux/if_packet.h>
+    #include <net/ethernet.h>
+    #include <net/if.h>
+    #include <net/if_arp.h>
+    #include <netinet/ip.h>
+    #include <netinet/ip6.h>
+    #include <netinet/udp.h>
+    #include <sys/ioctl.h>
+    #include <sys/mman.h>
+    #include <poll.h>
+#endif
+
+#if defined(__linux__)
+//room for one SCM_TIMESTAMPING message, the larger of the two we ask for
+static const size_t control_size = CMSG_SPACE(3 * sizeof(timespec));
+#endif
+
+static inline void put_be64(uint8_t *p, uint64_t v){
+    v = htobe64(v);
+    memcpy(p, &v, 8);
+}
+
+//printable source address of a probe, either family
+static std::string peer_str(const sockaddr_in6 &peer){
+    char buf[INET6_ADDRSTRLEN];
+    const void *addr = &peer.sin6_addr;
+    if (peer.sin6_family == AF_INET)
+        addr = &reinterpret_cast<const sockaddr_in&>(peer).sin_addr;
+    if (!inet_ntop(peer.sin6_family, addr, buf, sizeof(buf)))
+        return "?";
+    //v4-mapped peers of a dual-stack socket read as plain IPv4
+    if (peer.sin6_family == AF_INET6 && IN6_IS_ADDR_V4MAPPED(&peer.sin6_addr))
+        inet_ntop(AF_INET, &peer.sin6_addr.s6_addr[12], buf, sizeof(buf));
+    return buf;
+}
+
 //constructor
-TwampLightReflector::TwampLightReflector(std::string ip, uint16_t port): ipaddr(ip), listen_port(port){
-    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+TwampLightReflector::TwampLightReflector(std::string ip, uint16_t port, bool debug, bool reuseport): listen_port(port), ipaddr(ip), debug(debug){
+    union {
+        sockaddr sa;
+        sockaddr_in sin;
+        sockaddr_in6 sin6;
+    } addr{};
+    socklen_t addr_len;
+    if (inet_pton(AF_INET6, ipaddr.c_str(), &addr.sin6.sin6_addr) == 1) {
+        addr.sin6.sin6_family = AF_INET6;
+        addr.sin6.sin6_port = htons(listen_port);
+        addr_len = sizeof(addr.sin6);
+        sockfd = socket(AF_INET6, SOCK_DGRAM, 0);
+        //no IPv6 on this host: the wildcard still answers IPv4
+        if (sockfd < 0 && errno == EAFNOSUPPORT && IN6_IS_ADDR_UNSPECIFIED(&addr.sin6.sin6_addr)) {
+            ipaddr = "0.0.0.0";
+            addr = {};
+        }
+    }
+    if (addr.sa.sa_family != AF_INET6) {
+        addr.sin.sin_family = AF_INET;
+        addr.sin.sin_addr.s_addr = inet_addr(ipaddr.c_str());
+        addr.sin.sin_port = htons(listen_port);
+        addr_len = sizeof(addr.sin);
+        sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    }
     if (sockfd < 0) {
         perror("socket");
         exit(1);
     }
-    sockaddr_in addr{};
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = inet_addr(ipaddr.c_str());
-    addr.sin_port = htons(listen_port);
-    if (bind(sockfd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    int on = 1, off = 0;
+    if (addr.sa.sa_family == AF_INET6)
+        setsockopt(sockfd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    if (reuseport && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+        perror("SO_REUSEPORT");
+        close(sockfd);
+        exit(1);
+    }
+    if (bind(sockfd, &addr.sa, addr_len) < 0) {
         perror("bind");
         close(sockfd);
         exit(1);
     }
+    //take the receive timestamp when the packet hit the socket, not when we got to it
+    twamp_enable_rx_timestamping(sockfd);
+#if defined(__linux__)
+    //the batch buffers are allocated here once and reused for every packet
+    buffers.resize(batch_size * TWAMP_LIGHT_MAX_PACKET_SIZE);
+    controls.resize(batch_size * control_size);
+    peers.resize(batch_size);
+    iovs.resize(batch_size);
+    msgs.resize(batch_size);
+    replies.resize(batch_size);
+    reply_stamp.resize(batch_size);
+    for (unsigned int i = 0; i < batch_size; ++i) {
+        iovs[i].iov_base = buffers.data() + i * TWAMP_LIGHT_MAX_PACKET_SIZE;
+        msgs[i].msg_hdr.msg_name = &peers[i];
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_control = controls.data() + i * control_size;
+    }
+#endif
+}
+
+/*
+ * Socket i of a reuseport group is the i-th one bound, so with reflector
+ * i pinned to CPU i this keeps every probe on the CPU that took its
+ * interrupt. Without it the kernel spreads probes by a hash of the 4-tuple.
+ */
+bool TwampLightReflector::attach_cpu_steering(unsigned int nr_sockets) {
+#if defined(__linux__)
+    sock_filter code[] = {
+        //A = current CPU
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, uint32_t(SKF_AD_OFF + SKF_AD_CPU) },
+        //A = A % nr_sockets
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, nr_sockets },
+        //return A as the socket index
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    sock_fprog prog{};
+    prog.len = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0)
+        return true;
+    perror("SO_ATTACH_REUSEPORT_CBPF");
+#else
+    (void)nr_sockets;
+#endif
+    return false;
+}
+
+bool TwampLightReflector::set_busy_poll(unsigned int usec) {
+    busy_poll_us = usec;
+    return twamp_set_busy_poll(sockfd, usec);
 }
 
 void TwampLightReflector::run() {
     std::cout << "Reflector listening on " << ipaddr << ":" << listen_port << "\n" << std::endl;
+    //the largest probe echoed whole, as run_batched() does
+    std::vector<uint8_t> buffer(TWAMP_LIGHT_MAX_PACKET_SIZE);
     while (true) {
-        uint8_t buffer[20];
-        sockaddr_in client_addr{};
-        socklen_t client_len = sizeof(client_addr);
-        ssize_t len = recvfrom(sockfd, buffer, sizeof(buffer), 0, (sockaddr*)&client_addr, &client_len);
+        sockaddr_in6 client_addr{};
+        TwampTimestamps rx;
+        ssize_t len = twamp_recv(sockfd, buffer.data(), buffer.size(), 0, (sockaddr*)&client_addr, sizeof(client_addr), &rx);
+        uint64_t recv_time = rx.sw ? rx.sw : get_current_time_ns();
         //for-logging
-        char sip_str[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &(client_addr.sin_addr), sip_str, INET_ADDRSTRLEN);
-        if (len < 0 || len < 20) {
+        std::string sip_str = peer_str(client_addr);
+        TwampLightPacketView probe;
+        if (len < 0 || !TwampLightPacketView::parse(buffer.data(), len, &probe)) {
             std::cerr << get_current_timestamp() << " Malformed TWAMP packet: undersized (received " << len << " bytes, expected 20) from " << sip_str << "\n" << std::endl;
             continue;
         }
         std::cout << get_current_timestamp() << " Packet received from " << sip_str << std::endl;
-        TwampLightPacket pkt = TwampLightPacket::deserialize(buffer, len);
-        pkt.receiver_timestamp = get_current_time_ns();
-        std::vector<uint8_t> send_buffer = pkt.serialize();
-        sendto(sockfd, send_buffer.data(), send_buffer.size(), 0, (sockaddr*)&client_addr, client_len);
+        //echo exactly what came in, padding included
+        bool stamp = TwampStampPacket::is_probe(buffer.data(), len);
+        if (stamp) {
+            //the TTL is not known on the socket path
+            TwampStampPacket::reflect(buffer.data(), recv_time, twamp_clock_status().error_estimate, 0);
+            TwampStampPacket::set_transmit(buffer.data(), get_current_time_ns());
+        } else {
+            put_be64(buffer.data() + TwampLightPacket::receiver_ts_offset, recv_time);
+            if (probe.has_transmit_timestamp())
+                put_be64(buffer.data() + TwampLightPacket::transmit_ts_offset, get_current_time_ns());
+        }
+        sendto(sockfd, buffer.data(), len, 0, (sockaddr*)&client_addr, client_addr.sin6_family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in));
+
+        std::cout << get_current_timestamp() << " Responded to " << sip_str << " (" << len << " bytes" << (stamp ? ", STAMP" : "") << ")\n" << std::endl;
+        if (!stamp)
+            std::cout << get_current_timestamp() << " Seq: "  << probe.sequence_number() << " Sender TS: " << probe.sender_timestamp() << " Receiver TS: " << probe.receiver_timestamp() << " Transmit TS: " << probe.transmit_timestamp() << "\n" << std::endl;
+    }
+}
+
+/*
+ * Takes up to batch_size probes per recvmmsg(), writes the receive and
+ * transmit timestamps straight into the receive buffers and sends the
+ * whole batch back with one sendmmsg(). Nothing is allocated and nothing
+ * is logged per packet unless debug is set.
+ */
+void TwampLightReflector::run_batched() {
+#if defined(__linux__)
+    std::cout << "Reflector listening on " << ipaddr << ":" << listen_port << " (batched)\n" << std::endl;
+    while (true) {
+        for (unsigned int i = 0; i < batch_size; ++i) {
+            iovs[i].iov_len = TWAMP_LIGHT_MAX_PACKET_SIZE;
+            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in6);
+            msgs[i].msg_hdr.msg_controllen = control_size;
+            msgs[i].msg_hdr.msg_flags = 0;
+        }
+        //blocks for the first probe, then takes whatever else is queued; busy polling keeps asking instead
+        int n = recvmmsg(sockfd, msgs.data(), batch_size, busy_poll_us ? MSG_DONTWAIT : MSG_WAITFORONE, nullptr);
+        if (n < 0) {
+            if (errno != EINTR && errno != EAGAIN)
+                perror("recvmmsg");
+            continue;
+        }
+        uint64_t now = get_current_time_ns();
+        uint16_t error_estimate = twamp_clock_status().error_estimate;
+        unsigned int out = 0;
+        for (int i = 0; i < n; ++i) {
+            msghdr &hdr = msgs[i].msg_hdr;
+            unsigned int len = msgs[i].msg_len;
+            if (len < TWAMP_LIGHT_MIN_PACKET_SIZE) {
+                if (debug)
+                    std::cerr << get_current_timestamp() << " Malformed TWAMP packet: undersized (received " << len << " bytes, expected 20)" << std::endl;
+                continue;
+            }
+            TwampTimestamps rx;
+            twamp_parse_timestamps(&hdr, &rx);
+            wakeup.add(rx, now);
+            uint8_t *probe = static_cast<uint8_t*>(iovs[i].iov_base);
+            reply_stamp[out] = TwampStampPacket::is_probe(probe, len);
+            if (reply_stamp[out])
+                TwampStampPacket::reflect(probe, rx.sw ? rx.sw : now, error_estimate, 0);
+            else
+                put_be64(probe + TwampLightPacket::receiver_ts_offset, rx.sw ? rx.sw : now);
+            //echo exactly what came in, padding included
+            iovs[i].iov_len = len;
+            replies[out].msg_hdr = hdr;
+            replies[out].msg_hdr.msg_control = nullptr;
+            replies[out].msg_hdr.msg_controllen = 0;
+            replies[out].msg_hdr.msg_flags = 0;
+            ++out;
+        }
+        uint64_t tx_time = get_current_time_ns();
+        for (unsigned int i = 0; i < out; ++i) {
+            iovec *iov = replies[i].msg_hdr.msg_iov;
+            if (reply_stamp[i])
+                TwampStampPacket::set_transmit(static_cast<uint8_t*>(iov->iov_base), tx_time);
+            else if (iov->iov_len >= TWAMP_LIGHT_PACKET_SIZE)
+                put_be64(static_cast<uint8_t*>(iov->iov_base) + TwampLightPacket::transmit_ts_offset, tx_time);
+        }
+        unsigned int sent = 0;
+        while (sent < out) {
+            int r = sendmmsg(sockfd, replies.data() + sent, out - sent, 0);
+            if (r < 0) {
+                if (errno == EINTR)
+                    continue;
+                //the first pending reply failed: drop it and carry on with the rest
+                if (debug)
+                    perror("sendmmsg");
+                r = 1;
+            }
+            sent += r;
+        }
+        if (debug) {
+            for (unsigned int i = 0; i < out; ++i) {
+                const sockaddr_in6 *peer = static_cast<const sockaddr_in6*>(replies[i].msg_hdr.msg_name);
+                std::cout << get_current_timestamp() << " Responded to " << peer_str(*peer) << " (" << replies[i].msg_hdr.msg_iov->iov_len << " bytes)" << std::endl;
+            }
+        }
+        if (!wakeup_since)
+            wakeup_since = now;
+        if (wakeup_report_sec && now - wakeup_since >= wakeup_report_sec * 1000000000ULL) {
+            if (wakeup.count)
+                std::cout << get_current_timestamp() << " Reflector on port " << listen_port << " read " << wakeup.count << " probes "
+                          << wakeup.mean_us() << " us after the kernel timestamped them (jitter " << wakeup.jitter_us() << " us, max "
+                          << wakeup.max_us << " us)" << std::endl;
+            wakeup = TwampWakeupStats();
+            wakeup_since = now;
+        }
+    }
+#else
+    run();
+#endif
+}
+
+#if defined(__linux__)
+//bytes of the packet rings, each way
+#define TWAMP_RING_SIZE (4u << 20)
+#define TWAMP_RING_BLOCK_SIZE (1u << 16)
+
+static uint32_t csum_add(uint32_t sum, const uint8_t *p, size_t len){
+    for (; len > 1; p += 2, len -= 2)
+        sum += (p[0] << 8) | p[1];
+    if (len)
+        sum += p[0] << 8;
+    return sum;
+}
+
+static uint16_t csum_fold(uint32_t sum){
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return htons(uint16_t(~sum));
+}
+
+//UDP checksum over the pseudo-header; addr holds the two addresses, addr_len bytes
+static uint16_t udp_checksum(const uint8_t *addr, size_t addr_len, const uint8_t *udp, size_t udp_len){
+    uint32_t sum = csum_add(0, addr, addr_len);
+    sum += IPPROTO_UDP + udp_len;
+    sum = csum_add(sum, udp, udp_len);
+    uint16_t csum = csum_fold(sum);
+    //0 means no checksum over IPv4 and is not allowed over IPv6
+    return csum ? csum : 0xffff;
+}
+
+/*
+ * Turns the frame probe (len bytes) around in place: MACs, addresses and
+ * ports swapped, TTL 255 as RFC 5357 has reflectors send, the TWAMP
+ * timestamps written and the checksums redone. A STAMP probe is answered
+ * in STAMP, with the TTL it arrived with. false if it is not a well-formed
+ * probe to port.
+ */
+static bool reflect_frame(uint8_t *frame, size_t len, uint16_t port, uint64_t rx_time, uint16_t error_estimate){
+    if (len < sizeof(ether_header))
+        return false;
+    ether_header *eth = reinterpret_cast<ether_header*>(frame);
+    uint8_t *l3 = frame + sizeof(ether_header);
+    size_t l3_len = len - sizeof(ether_header);
+    udphdr *udp;
+    const uint8_t *addrs;
+    size_t addrs_len;
+    uint8_t ttl;
+    if (ntohs(eth->ether_type) == ETHERTYPE_IP) {
+        if (l3_len < sizeof(iphdr))
+            return false;
+        iphdr *ip = reinterpret_cast<iphdr*>(l3);
+        size_t ihl = ip->ihl * 4;
+        if (ip->protocol != IPPROTO_UDP || ihl < sizeof(iphdr) || ntohs(ip->tot_len) > l3_len ||
+            ntohs(ip->tot_len) < ihl + sizeof(udphdr) || (ntohs(ip->frag_off) & 0x3fff))
+            return false;
+        std::swap(ip->saddr, ip->daddr);
+        ttl = ip->ttl;
+        ip->ttl = 255;
+        ip->check = 0;
+        ip->check = csum_fold(csum_add(0, l3, ihl));
+        udp = reinterpret_cast<udphdr*>(l3 + ihl);
+        addrs = reinterpret_cast<const uint8_t*>(&ip->saddr);
+        addrs_len = 2 * sizeof(ip->saddr);
+        l3_len = ntohs(ip->tot_len) - ihl;
+    } else if (ntohs(eth->ether_type) == ETHERTYPE_IPV6) {
+        if (l3_len < sizeof(ip6_hdr) + sizeof(udphdr))
+            return false;
+        ip6_hdr *ip6 = reinterpret_cast<ip6_hdr*>(l3);
+        if (ip6->ip6_nxt != IPPROTO_UDP || ntohs(ip6->ip6_plen) > l3_len - sizeof(ip6_hdr))
+            return false;
+        std::swap(ip6->ip6_src, ip6->ip6_dst);
+        ttl = ip6->ip6_hlim;
+        ip6->ip6_hlim = 255;
+        udp = reinterpret_cast<udphdr*>(l3 + sizeof(ip6_hdr));
+        addrs = reinterpret_cast<const uint8_t*>(&ip6->ip6_src);
+        addrs_len = 2 * sizeof(in6_addr);
+        l3_len = ntohs(ip6->ip6_plen);
+    } else
+        return false;
 
-        std::cout << get_current_timestamp() << " Responded to " << sip_str << "\n" << std::endl;
-        std::cout << get_current_timestamp() << " Seq: "  << pkt.sequence_number << " Sender TS: " << pkt.sender_timestamp << " Receiver TS: " << pkt.receiver_timestamp << "\n" << std::endl;
+    size_t udp_len = ntohs(udp->len);
+    if (ntohs(udp->dest) != port || udp_len > l3_len || udp_len < sizeof(udphdr) + TWAMP_LIGHT_MIN_PACKET_SIZE)
+        return false;
+    uint8_t mac[ETH_ALEN];
+    memcpy(mac, eth->ether_dhost, ETH_ALEN);
+    memcpy(eth->ether_dhost, eth->ether_shost, ETH_ALEN);
+    memcpy(eth->ether_shost, mac, ETH_ALEN);
+    std::swap(udp->source, udp->dest);
+
+    uint8_t *payload = reinterpret_cast<uint8_t*>(udp) + sizeof(udphdr);
+    if (TwampStampPacket::is_probe(payload, udp_len - sizeof(udphdr))) {
+        TwampStampPacket::reflect(payload, rx_time, error_estimate, ttl);
+        TwampStampPacket::set_transmit(payload, get_current_time_ns());
+    } else {
+        put_be64(payload + TwampLightPacket::receiver_ts_offset, rx_time);
+        if (udp_len >= sizeof(udphdr) + TWAMP_LIGHT_PACKET_SIZE)
+            put_be64(payload + TwampLightPacket::transmit_ts_offset, get_current_time_ns());
     }
+    udp->check = 0;
+    udp->check = udp_checksum(addrs, addrs_len, reinterpret_cast<uint8_t*>(udp), udp_len);
+    return true;
+}
+
+//frame status words are shared with the kernel
+static inline uint32_t ring_status(const tpacket2_hdr *hdr){
+    return __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+}
+
+static inline void ring_release(tpacket2_hdr *hdr, uint32_t status){
+    __atomic_store_n(&hdr->tp_status, status, __ATOMIC_RELEASE);
 }
 
+//frames of each ring, big enough for the interface's MTU
+static bool ring_request(int fd, int mtu, tpacket_req *req){
+    unsigned int frame = 2048;
+    while (frame < TPACKET_ALIGN(TPACKET2_HDRLEN) + ETH_HLEN + 4 + unsigned(mtu))
+        frame <<= 1;
+    req->tp_block_size = std::max(frame, unsigned(TWAMP_RING_BLOCK_SIZE));
+    req->tp_block_nr = std::max(1u, TWAMP_RING_SIZE / req->tp_block_size);
+    req->tp_frame_size = frame;
+    req->tp_frame_nr = req->tp_block_nr * (req->tp_block_size / frame);
+    return setsockopt(fd, SOL_PACKET, PACKET_RX_RING, req, sizeof(*req)) == 0 &&
+           setsockopt(fd, SOL_PACKET, PACKET_TX_RING, req, sizeof(*req)) == 0;
+}
+
+/*
+ * The UDP socket stays bound so the kernel does not answer the probes with
+ * port unreachables, but drops everything it would queue there: the probes
+ * are taken off the RX ring straight from the device, turned around in
+ * place and put on the TX ring, one send() flushing what a wakeup found.
+ * Nothing goes through a socket queue, and there is no system call per
+ * probe. The receive timestamp is the one the ring stamps each frame with.
+ */
+bool TwampLightReflector::run_packet_ring(const std::string &ifname, uint16_t fanout_group) {
+    int fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, htons(ETH_P_ALL));
+    if (fd < 0) {
+        perror("packet socket");
+        return false;
+    }
+    ifreq ifr{};
+    strncpy(ifr.ifr_name, ifname.c_str(), IFNAMSIZ - 1);
+    if (ioctl(fd, SIOCGIFHWADDR, &ifr) < 0 || ifr.ifr_hwaddr.sa_family != ARPHRD_ETHER) {
+        std::cerr << get_current_timestamp() << " Cannot reflect off " << ifname << ": not an Ethernet interface" << std::endl;
+        close(fd);
+        return false;
+    }
+    int mtu = ioctl(fd, SIOCGIFMTU, &ifr) == 0 ? ifr.ifr_mtu : 1500;
+
+    //IPv4 or IPv6 UDP to the port, without IP fragments or IPv6 extension headers
+    uint16_t port = listen_port;
+    sock_filter code[] = {
+        { BPF_LD | BPF_H | BPF_ABS, 0, 0, 12 },
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 7, ETHERTYPE_IP },
+        { BPF_LD | BPF_B | BPF_ABS, 0, 0, 23 },
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 11, IPPROTO_UDP },
+        { BPF_LD | BPF_H | BPF_ABS, 0, 0, 20 },
+        { BPF_JMP | BPF_JSET | BPF_K, 9, 0, 0x3fff },
+        { BPF_LDX | BPF_B | BPF_MSH, 0, 0, 14 },
+        { BPF_LD | BPF_H | BPF_IND, 0, 0, 16 },
+        { BPF_JMP | BPF_JEQ | BPF_K, 5, 6, port },
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 5, ETHERTYPE_IPV6 },
+        { BPF_LD | BPF_B | BPF_ABS, 0, 0, 20 },
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 3, IPPROTO_UDP },
+        { BPF_LD | BPF_H | BPF_ABS, 0, 0, 56 },
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 1, port },
+        { BPF_RET | BPF_K, 0, 0, 0xffff },
+        { BPF_RET | BPF_K, 0, 0, 0 },
+    };
+    sock_fprog prog{};
+    prog.len = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+    int version = TPACKET_V2;
+    tpacket_req req{};
+    sockaddr_ll sll{};
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = if_nametoindex(ifname.c_str());
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0 ||
+        setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0 ||
+        !ring_request(fd, mtu, &req) || bind(fd, reinterpret_cast<sockaddr*>(&sll), sizeof(sll)) < 0) {
+        perror("packet ring");
+        close(fd);
+        return false;
+    }
+    if (fanout_group) {
+        int fanout = fanout_group | (PACKET_FANOUT_CPU << 16);
+        if (setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout)) < 0)
+            perror("PACKET_FANOUT");
+    }
+    size_t ring_bytes = size_t(req.tp_block_size) * req.tp_block_nr;
+    void *map = mmap(nullptr, 2 * ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("packet ring mmap");
+        close(fd);
+        return false;
+    }
+    uint8_t *rx_ring = static_cast<uint8_t*>(map);
+    uint8_t *tx_ring = rx_ring + ring_bytes;
+
+    //what the kernel would queue on the UDP socket is dropped at its filter
+    sock_filter drop[] = { { BPF_RET | BPF_K, 0, 0, 0 } };
+    sock_fprog drop_prog{};
+    drop_prog.len = 1;
+    drop_prog.filter = drop;
+    setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &drop_prog, sizeof(drop_prog));
+
+    std::cout << "Reflector listening on " << ifname << " port " << listen_port << " (packet ring)\n" << std::endl;
+    unsigned int rx_next = 0, tx_next = 0;
+    const size_t tx_data = TPACKET2_HDRLEN - sizeof(sockaddr_ll);
+    while (true) {
+        pollfd pfd{fd, POLLIN, 0};
+        tpacket2_hdr *hdr = reinterpret_cast<tpacket2_hdr*>(rx_ring + size_t(rx_next) * req.tp_frame_size);
+        if (!(ring_status(hdr) & TP_STATUS_USER) && poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        unsigned int queued = 0;
+        while (ring_status(hdr) & TP_STATUS_USER) {
+            const sockaddr_ll *from = reinterpret_cast<const sockaddr_ll*>(reinterpret_cast<uint8_t*>(hdr) + TPACKET_ALIGN(sizeof(tpacket2_hdr)));
+            tpacket2_hdr *tx = reinterpret_cast<tpacket2_hdr*>(tx_ring + size_t(tx_next) * req.tp_frame_size);
+            size_t len = hdr->tp_snaplen;
+            //a full TX ring drops the probe, like a full socket buffer would
+            if (from->sll_pkttype == PACKET_HOST && ring_status(tx) == TP_STATUS_AVAILABLE &&
+                len <= req.tp_frame_size - tx_data) {
+                uint8_t *out = reinterpret_cast<uint8_t*>(tx) + tx_data;
+                memcpy(out, reinterpret_cast<uint8_t*>(hdr) + hdr->tp_mac, len);
+                uint64_t rx_time = uint64_t(hdr->tp_sec) * 1000000000ULL + hdr->tp_nsec;
+                if (reflect_frame(out, len, listen_port, rx_time ? rx_time : get_current_time_ns(), twamp_clock_status().error_estimate)) {
+                    tx->tp_len = len;
+                    ring_release(tx, TP_STATUS_SEND_REQUEST);
+                    tx_next = (tx_next + 1) % req.tp_frame_nr;
+                    ++queued;
+                } else if (debug)
+                    std::cerr << get_current_timestamp() << " Malformed TWAMP packet on " << ifname << " (" << len << " bytes)" << std::endl;
+            }
+            ring_release(hdr, TP_STATUS_KERNEL);
+            rx_next = (rx_next + 1) % req.tp_frame_nr;
+            hdr = reinterpret_cast<tpacket2_hdr*>(rx_ring + size_t(rx_next) * req.tp_frame_size);
+        }
+        if (queued && send(fd, nullptr, 0, MSG_DONTWAIT) < 0 && errno != EAGAIN && debug)
+            perror("packet ring send");
+        if (debug && queued)
+            std::cout << get_current_timestamp() << " Reflected " << queued << " probes" << std::endl;
+    }
+    munmap(map, 2 * ring_bytes);
+    close(fd);
+    return false;
+}
+#else
+bool TwampLightReflector::run_packet_ring(const std::string &, uint16_t) {
+    return false;
+}
+#endif
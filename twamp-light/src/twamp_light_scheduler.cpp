@@ -0,0 +1,112 @@
+#include "twamp_light.hpp"
+
+static const float min_weight = 0.25f;
+static const float max_weight = 4.0f;
+//interval jitter, +-10%
+static const double jitter = 0.1;
+
+//constructor
+TwampTimerWheel::TwampTimerWheel(uint64_t tick, unsigned int nr_slots, uint64_t now_ms):
+    tick_ms(tick), current_tick(now_ms / tick), slots(nr_slots) {
+}
+
+void TwampTimerWheel::add(const TwampPeerKey &key, uint32_t gen, float weight, uint64_t due_ms) {
+    //anything already overdue goes out with the next tick
+    uint64_t due_tick = std::max(due_ms / tick_ms, current_tick);
+    entry e;
+    e.key = key;
+    e.gen = gen;
+    e.weight = weight;
+    e.due_tick = due_tick;
+    slots[due_tick % slots.size()].push_back(e);
+}
+
+void TwampTimerWheel::expire(uint64_t now_ms, std::vector<entry> &out) {
+    uint64_t now_tick = now_ms / tick_ms;
+    if (now_tick < current_tick)
+        return;
+    //after a long stall one full turn of the wheel covers every bucket
+    uint64_t ticks = std::min(now_tick - current_tick + 1, uint64_t(slots.size()));
+    for (uint64_t t = current_tick; t < current_tick + ticks; ++t) {
+        std::vector<entry> &slot = slots[t % slots.size()];
+        size_t keep = 0;
+        for (size_t i = 0; i < slot.size(); ++i) {
+            if (slot[i].due_tick <= now_tick)
+                out.push_back(slot[i]);
+            else
+                slot[keep++] = slot[i];
+        }
+        slot.resize(keep);
+    }
+    current_tick = now_tick + 1;
+}
+
+//constructor
+TwampProbeScheduler::TwampProbeScheduler(unsigned int cycle_sec, uint32_t damping_threshold_ms):
+    cycle_ms(std::max(1u, cycle_sec) * 1000ULL), threshold_us(damping_threshold_ms * 1000ULL),
+    wheel(100, 1024, get_monotonic_ms()), total_weight(0), nr_peers(0), next_gen(1), rng(std::random_device()()) {
+}
+
+void TwampProbeScheduler::configure(unsigned int cycle_sec, uint64_t damping_threshold_us) {
+    cycle_ms = std::max(1u, cycle_sec) * 1000ULL;
+    threshold_us = damping_threshold_us;
+}
+
+uint64_t TwampProbeScheduler::interval_ms(float weight, uint64_t cycle) const {
+    double mean = nr_peers ? total_weight / nr_peers : 1.0;
+    double interval = cycle * mean / weight;
+    std::uniform_real_distribution<double> spread(1.0 - jitter, 1.0 + jitter);
+    interval *= spread(rng);
+    //never faster than a second, never slower than four cycles
+    interval = std::max(interval, 1000.0);
+    interval = std::min(interval, 4.0 * cycle);
+    return uint64_t(interval);
+}
+
+void TwampProbeScheduler::add(const TwampPeerKey &key, latency_data &data) {
+    data.weight = 1.0f;
+    data.sched_gen = next_gen++;
+    total_weight += data.weight;
+    ++nr_peers;
+    std::uniform_int_distribution<uint64_t> first(0, peer_cycle_ms(data) - 1);
+    wheel.add(key, data.sched_gen, data.weight, get_monotonic_ms() + first(rng));
+}
+
+void TwampProbeScheduler::reprofile(const TwampPeerKey &key, latency_data &data, uint64_t old_cycle_ms) {
+    //bgpd stopped trusting its estimate for this nexthop: probe it again soon
+    if (peer_cycle_ms(data) < (old_cycle_ms ? old_cycle_ms : cycle_ms))
+        add(key, data);
+}
+
+void TwampProbeScheduler::due(TwampPeerTable &table, std::vector<TwampPeerKey> &out) {
+    std::vector<TwampTimerWheel::entry> expired;
+    wheel.expire(get_monotonic_ms(), expired);
+    for (const auto &e: expired) {
+        const latency_data *data = table.find(e.key);
+        if (!data || data->sched_gen != e.gen) {
+            //the peer went away (or came back and was scheduled afresh)
+            total_weight -= e.weight;
+            --nr_peers;
+            continue;
+        }
+        out.push_back(e.key);
+    }
+}
+
+void TwampProbeScheduler::update(TwampPeerTable &table, const TwampPeerKey &key, const TwampProbeResult &res) {
+    latency_data *data = table.find(key);
+    if (!data)
+        return;
+    uint64_t latency = res.received ? uint64_t(llround(res.rtt_ms * 1000)) : 0;
+    bool busy = !res.received;
+    if (res.received && data->latency) {
+        uint64_t delta = latency > data->latency ? latency - data->latency : data->latency - latency;
+        data->spike = delta * 4 >= threshold_us;
+        busy = busy || data->spike;
+    }
+    data->latency = latency;
+    float weight = busy ? std::min(data->weight * 2, max_weight) : std::max(data->weight / 2, min_weight);
+    total_weight += weight - data->weight;
+    data->weight = weight;
+    wheel.add(key, data->sched_gen, weight, get_monotonic_ms() + interval_ms(weight, peer_cycle_ms(*data)));
+}
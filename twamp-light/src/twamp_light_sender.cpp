@@ -1,12 +1,16 @@
 #include "twamp_light.hpp"
 
 //constructor
-TwampLightSender::TwampLightSender(const std::string& ip, uint16_t port): reflector_ip(ip), reflector_port(port) {
+TwampLightSender::TwampLightSender(const std::string& ip, uint16_t port, size_t size, uint8_t dscp): reflector_ip(ip), reflector_port(port),
+    packet_size(std::min(std::max(size, size_t(TWAMP_LIGHT_PACKET_SIZE)), size_t(TWAMP_LIGHT_MAX_PACKET_SIZE))) {
     sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd < 0) {
         perror("socket");
         exit(1);
     }
+    ts_mode = twamp_enable_timestamping(sockfd, false);
+    if (dscp && !twamp_set_dscp(sockfd, AF_INET, dscp))
+        perror("IP_TOS");
 }
 
 std::unordered_map<std::string, double> TwampLightSender::run(int num_packets = 3, int interval_ms = 10, int timeout_interval_ms = 1000) {
@@ -19,19 +23,22 @@ std::unordered_map<std::string, double> TwampLightSender::run(int num_packets =
     std::mt19937 gen(rd());
     std::uniform_int_distribution<uint32_t> dis(0, UINT32_MAX);
     std::vector<double> rtts_ms;
+    uint32_t tx_id = 0;
     
     for (int i = 0; i < num_packets; ++i) {
         uint32_t seq = dis(gen);
         uint64_t send_time = get_current_time_ns();
         TwampLightPacket pkt(seq, send_time, 0);
-        std::vector<uint8_t> buffer = pkt.serialize();
+        uint8_t buffer[TWAMP_LIGHT_MAX_PACKET_SIZE];
+        size_t buffer_len = pkt.serialize_into(buffer, sizeof(buffer), packet_size);
         char dip_str[INET_ADDRSTRLEN];
         inet_ntop(AF_INET, &(reflector_addr.sin_addr), dip_str, INET_ADDRSTRLEN);
-        ssize_t sent = sendto(sockfd, buffer.data(), buffer.size(), 0, (sockaddr*)&reflector_addr, sizeof(reflector_addr));
+        ssize_t sent = sendto(sockfd, buffer, buffer_len, 0, (sockaddr*)&reflector_addr, sizeof(reflector_addr));
         if (sent < 0) {
             std::cout << get_current_timestamp() <<" Error Sending " << dip_str << "\n" << std::endl;
             continue;
         }
+        uint32_t this_tx_id = tx_id++;
         std::cout << get_current_timestamp() << " Packet sent to " << dip_str << std::endl;
         // Wait for response
         struct timeval tv;
@@ -39,10 +46,10 @@ std::unordered_map<std::string, double> TwampLightSender::run(int num_packets =
         tv.tv_usec = (timeout_interval_ms % 1000) * 1000; // microseconds
         setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof tv);
         // Parsing the response
-        uint8_t recv_buffer[20];
+        uint8_t recv_buffer[TWAMP_LIGHT_PACKET_SIZE];
         sockaddr_in from_addr{};
-        socklen_t from_len = sizeof(from_addr);
-        ssize_t len = recvfrom(sockfd, recv_buffer, sizeof(recv_buffer), 0, (sockaddr*)&from_addr, &from_len);
+        TwampTimestamps rx;
+        ssize_t len = twamp_recv(sockfd, recv_buffer, sizeof(recv_buffer), 0, (sockaddr*)&from_addr, sizeof(from_addr), &rx);
         uint64_t recv_time = get_current_time_ns();
         if (len < 0) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
@@ -53,16 +60,24 @@ std::unordered_map<std::string, double> TwampLightSender::run(int num_packets =
                 continue;
             }
         }
-        if (len < 20) {
+        TwampLightPacketView resp;
+        if (!TwampLightPacketView::parse(recv_buffer, len, &resp)) {
             std::cout << get_current_timestamp() << " Malformed TWAMP packet: undersized (received " << len << " bytes, expected 20) from " << dip_str << "\n"  << std::endl;
             // Handle as malformed packet (increment malformed counter, log, etc.)
             continue;
         }
         std::cout << get_current_timestamp() << " Received response fron " << dip_str << "\n" << std::endl;
-        // Deserialize and compute RTT
-        TwampLightPacket resp = TwampLightPacket::deserialize(recv_buffer, len);
-        double rtt_ms = (recv_time - resp.sender_timestamp) / 1e6;
-        std::cout << get_current_timestamp() << " Seq: "  << resp.sequence_number << " Sender TS: " << resp.sender_timestamp << " Receiver TS: " << resp.receiver_timestamp << " RTT: " << rtt_ms << " ms" << "\n" << std::endl;
+        //the send timestamp is queued long before the reply can arrive
+        TwampTimestamps tx;
+        if (ts_mode == TWAMP_TS_KERNEL_TXRX) {
+            uint32_t id;
+            TwampTimestamps stamp;
+            while (twamp_recv_tx_timestamp(sockfd, &id, &stamp))
+                if (id == this_tx_id)
+                    tx = stamp;
+        }
+        double rtt_ms = twamp_network_rtt_ns(twamp_rtt_ns(tx, rx, resp.sender_timestamp(), recv_time), resp) / 1e6;
+        std::cout << get_current_timestamp() << " Seq: "  << resp.sequence_number() << " Sender TS: " << resp.sender_timestamp() << " Receiver TS: " << resp.receiver_timestamp() << " Dwell: " << resp.reflector_dwell_ns() / 1e3 << " us RTT: " << rtt_ms << " ms" << "\n" << std::endl;
         rtts_ms.push_back(rtt_ms);
         //Adding delay
         if (i+1 != num_packets)
@@ -0,0 +1,125 @@
+#include "twamp_light.hpp"
+#include <grp.h>
+#include <pwd.h>
+#include <sys/un.h>
+#include <pthread.h>
+#include <sched.h>
+#if defined(__linux__)
+    #include <linux/capability.h>
+    #include <sys/prctl.h>
+    #include <sys/syscall.h>
+#endif
+
+bool twamp_sd_notify(const std::string& state){
+    const char *path = getenv("NOTIFY_SOCKET");
+    if (!path || !*path)
+        return false;
+    sockaddr_un addr{};
+    size_t path_len = strlen(path);
+    if ((path[0] != '/' && path[0] != '@') || path_len >= sizeof(addr.sun_path))
+        return false;
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, path_len);
+    //'@' for an abstract socket, whose name starts with a NUL instead
+    if (addr.sun_path[0] == '@')
+        addr.sun_path[0] = '\0';
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+    socklen_t addr_len = offsetof(sockaddr_un, sun_path) + path_len;
+    bool sent = sendto(fd, state.data(), state.size(), MSG_NOSIGNAL, reinterpret_cast<sockaddr*>(&addr), addr_len) ==
+                ssize_t(state.size());
+    close(fd);
+    return sent;
+}
+
+uint64_t twamp_sd_watchdog_usec(){
+    const char *usec = getenv("WATCHDOG_USEC");
+    if (!usec)
+        return 0;
+    //meant for another process if WATCHDOG_PID says so
+    const char *pid = getenv("WATCHDOG_PID");
+    if (pid && strtol(pid, nullptr, 10) != getpid())
+        return 0;
+    return strtoull(usec, nullptr, 10);
+}
+
+#if defined(__linux__)
+//capabilities of this process, there is no glibc wrapper
+static bool set_capabilities(uint64_t caps){
+    __user_cap_header_struct hdr{};
+    __user_cap_data_struct data[2]{};
+    hdr.version = _LINUX_CAPABILITY_VERSION_3;
+    for (int i = 0; i < 2; ++i)
+        data[i].effective = data[i].permitted = uint32_t(caps >> (32 * i));
+    return syscall(SYS_capset, &hdr, data) == 0;
+}
+#endif
+
+bool twamp_drop_privileges(const std::string& user, const std::string& group){
+    passwd *pw = getpwnam(user.c_str());
+    if (!pw) {
+        std::cerr << "Unknown user " << user << std::endl;
+        return false;
+    }
+    gid_t gid = pw->pw_gid;
+    if (!group.empty()) {
+        struct group *gr = getgrnam(group.c_str());
+        if (!gr) {
+            std::cerr << "Unknown group " << group << std::endl;
+            return false;
+        }
+        gid = gr->gr_gid;
+    }
+    if (getuid() == pw->pw_uid && geteuid() == pw->pw_uid && getgid() == gid)
+        return true;
+#if defined(__linux__)
+    //keep the permitted set over setuid, then cut it down to what is still needed
+    if (prctl(PR_SET_KEEPCAPS, 1, 0, 0, 0) < 0) {
+        perror("PR_SET_KEEPCAPS");
+        return false;
+    }
+#endif
+    if (initgroups(pw->pw_name, gid) < 0 || setgid(gid) < 0 || setuid(pw->pw_uid) < 0) {
+        std::cerr << "Cannot switch to " << user << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+#if defined(__linux__)
+    prctl(PR_SET_KEEPCAPS, 0, 0, 0, 0);
+    uint64_t keep = (1ULL << CAP_NET_BIND_SERVICE) | (1ULL << CAP_NET_RAW) | (1ULL << CAP_NET_ADMIN) | (1ULL << CAP_SYS_NICE);
+    if (!set_capabilities(keep)) {
+        std::cerr << "Cannot keep the network capabilities as " << user << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+#endif
+    return true;
+}
+
+bool twamp_isolate_thread(int cpu, int fifo_priority){
+    bool ok = true;
+#if defined(__linux__)
+    if (cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (err) {
+            std::cerr << "Cannot pin thread to CPU " << cpu << ": " << strerror(err) << std::endl;
+            ok = false;
+        }
+    }
+    if (fifo_priority > 0) {
+        sched_param param{};
+        param.sched_priority = std::min(fifo_priority, sched_get_priority_max(SCHED_FIFO));
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err) {
+            std::cerr << "Cannot schedule thread SCHED_FIFO " << param.sched_priority << ": " << strerror(err) << std::endl;
+            ok = false;
+        }
+    }
+#else
+    (void)cpu;
+    ok = fifo_priority <= 0;
+#endif
+    return ok;
+}
@@ -0,0 +1,199 @@
+#include "twamp_light.hpp"
+#include "bgp_twamp_ipc.h"
+#include <sys/un.h>
+
+//the segment's latency_us; UINT32_MAX means unmeasured, so stay below it
+static uint32_t twamp_latency_us(double rtt_ms) {
+    return uint32_t(std::min(llround(rtt_ms * 1000), (long long)UINT32_MAX - 1));
+}
+
+//constructor
+TwampShmAgent::TwampShmAgent(): shm(nullptr), map_size(0), map_ino(0), notify_fd(-1) {
+}
+
+TwampShmAgent::~TwampShmAgent() {
+    detach();
+    if (notify_fd >= 0)
+        close(notify_fd);
+}
+
+bool TwampShmAgent::attach() {
+    int fd = shm_open(TWAMP_SHM_NAME, O_RDWR, 0);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || size_t(st.st_size) < sizeof(twamp_shm)) {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return false;
+    }
+    const char *why = twamp_shm_hdr_check(static_cast<twamp_shm*>(map), st.st_size);
+    if (why) {
+        std::cerr << get_current_timestamp() << " Ignoring " << TWAMP_SHM_NAME << ": " << why << std::endl;
+        munmap(map, st.st_size);
+        return false;
+    }
+    shm = static_cast<twamp_shm*>(map);
+    map_size = st.st_size;
+    map_ino = st.st_ino;
+    std::cout << get_current_timestamp() << " Attached to " << TWAMP_SHM_NAME << " (v" << shm->hdr.version << ", " << shm->hdr.capacity << " slots)" << std::endl;
+    //a new segment may come from a restarted bgpd with a new eventfd
+    if (notify_fd >= 0)
+        close(notify_fd);
+    notify_fd = -1;
+    connect_notify();
+    return true;
+}
+
+void TwampShmAgent::detach() {
+    if (shm)
+        munmap(shm, map_size);
+    shm = nullptr;
+    map_size = 0;
+}
+
+bool TwampShmAgent::stale() const {
+    if (!shm)
+        return false;
+    if (twamp_shm_superseded(shm))
+        return true;
+    //bgpd restarted: the name now points at another segment, or at none
+    struct stat st;
+    int fd = shm_open(TWAMP_SHM_NAME, O_RDONLY, 0);
+    if (fd < 0)
+        return true;
+    bool moved = fstat(fd, &st) < 0 || st.st_ino != map_ino;
+    close(fd);
+    return moved;
+}
+
+//fetch bgpd's eventfd; without it bgpd just polls the dirty bitmap slowly
+void TwampShmAgent::connect_notify() {
+    notify_fd = twamp_notify_connect();
+}
+
+int twamp_notify_connect() {
+    int notify_fd = -1;
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+        return -1;
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    //abstract namespace: leading NUL, no terminator
+    memcpy(addr.sun_path + 1, TWAMP_NOTIFY_SOCK, strlen(TWAMP_NOTIFY_SOCK));
+    socklen_t addr_len = offsetof(sockaddr_un, sun_path) + 1 + strlen(TWAMP_NOTIFY_SOCK);
+    if (connect(sock, (sockaddr*)&addr, addr_len) < 0) {
+        std::cerr << get_current_timestamp() << " No bgpd notification channel, bgpd will poll" << std::endl;
+        close(sock);
+        return -1;
+    }
+    char byte;
+    iovec iov{&byte, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) > 0) {
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+                memcpy(&notify_fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    close(sock);
+    return notify_fd;
+}
+
+/*
+ * Membership belongs to bgpd and is read under its nh_gen counter, so
+ * every address comes with the epoch of the slot it was read from.
+ */
+std::vector<TwampShmAgent::target> TwampShmAgent::active_targets() const {
+    std::vector<target> targets;
+    if (!shm)
+        return targets;
+    const twamp_nexthop *nexthops = twamp_shm_nexthops_c(shm);
+    for (int n = 0; n < TWAMP_SEQ_RETRIES; ++n) {
+        uint32_t start = twamp_seq_read_begin(&shm->nh_gen);
+        uint32_t count = std::min(__atomic_load_n(&shm->nh_count, __ATOMIC_RELAXED), shm->hdr.capacity);
+        targets.clear();
+        for (uint32_t i = 0; i < count; ++i) {
+            const twamp_nexthop &nh = nexthops[i];
+            if (!__atomic_load_n(&nh.active, __ATOMIC_RELAXED))
+                continue;
+            target t;
+            t.slot = i;
+            t.epoch = __atomic_load_n(&nh.epoch, __ATOMIC_RELAXED);
+            twamp_addr_load(&nh.addr, &t.addr);
+            t.vrf_ifindex = __atomic_load_n(&nh.vrf_ifindex, __ATOMIC_RELAXED);
+            t.dscp = __atomic_load_n(&nh.dscp, __ATOMIC_RELAXED);
+            t.probe_cycle_sec = __atomic_load_n(&nh.probe_cycle_sec, __ATOMIC_RELAXED);
+            t.packet_count = __atomic_load_n(&nh.packet_count, __ATOMIC_RELAXED);
+            targets.push_back(t);
+        }
+        if (!twamp_seq_read_retry(&shm->nh_gen, start))
+            return targets;
+        std::this_thread::yield();
+    }
+    //bgpd kept changing the set; try again next cycle
+    targets.clear();
+    return targets;
+}
+
+uint32_t TwampShmAgent::membership_gen() const {
+    return shm ? twamp_seq_read_begin(&shm->nh_gen) : 0;
+}
+
+bool TwampShmAgent::config(settings *cfg) const {
+    twamp_shm_config c;
+    if (!shm || twamp_shm_config_read(shm, &c) != 0)
+        return false;
+    cfg->gen = c.gen;
+    cfg->port = (c.present & TWAMP_CFG_PORT) ? c.port : 0;
+    cfg->probe_cycle_sec = (c.present & TWAMP_CFG_PROBE_CYCLE) ? c.probe_cycle_sec : 0;
+    cfg->packet_count = (c.present & TWAMP_CFG_PACKET_COUNT) ? c.packet_count : 0;
+    cfg->has_damping = c.present & TWAMP_CFG_DAMPING;
+    cfg->damping_threshold_us = cfg->has_damping ? c.damping_threshold_us : 0;
+    return true;
+}
+
+uint32_t TwampShmAgent::publish(const std::vector<target>& targets, const std::vector<TwampProbeResult>& results) {
+    if (!shm)
+        return 0;
+    if (twamp_shm_writer_lock(shm) != 0) {
+        std::cerr << get_current_timestamp() << " Cannot take the shared-memory writer lock" << std::endl;
+        return 0;
+    }
+    int64_t now = time(nullptr);
+    const twamp_nexthop *nexthops = twamp_shm_nexthops_c(shm);
+    for (size_t t = 0; t < targets.size() && t < results.size(); ++t) {
+        const TwampProbeResult &res = results[t];
+        if (res.received) {
+            //0 is "not measured one way", so a delay within the clocks' error still counts as measured
+            uint32_t forward_us = res.one_way ? uint32_t(std::max(1LL, std::min<long long>(llround(res.forward_ms * 1000), UINT32_MAX - 1))) : 0;
+            twamp_shm_publish(shm, targets[t].slot, targets[t].epoch, twamp_latency_us(res.rtt_ms),
+                              uint32_t(llround(res.jitter_ms * 1000)), uint16_t(llround(res.loss * 10)), forward_us, 1, now);
+            continue;
+        }
+        //unreachable: unmeasured, but keep the time of the last good measurement
+        uint32_t latency_us;
+        uint8_t measured;
+        int64_t last_updated = 0;
+        twamp_nexthop_read(&nexthops[targets[t].slot], &latency_us, &measured, &last_updated);
+        twamp_shm_publish(shm, targets[t].slot, targets[t].epoch, UINT32_MAX, 0, 1000, 0, 0, last_updated);
+    }
+    uint32_t sequence = __atomic_add_fetch(&shm->sequence, 1, __ATOMIC_RELEASE);
+    twamp_shm_writer_unlock(shm);
+    if (notify_fd >= 0) {
+        uint64_t one = 1;
+        if (write(notify_fd, &one, sizeof(one)) < 0)
+            perror("notify bgpd");
+    }
+    return sequence;
+}
@@ -0,0 +1,193 @@
+#include "twamp_light.hpp"
+#if defined(__linux__)
+    #include <linux/net_tstamp.h>
+    #include <linux/errqueue.h>
+    #include <linux/sockios.h>
+    #include <net/if.h>
+    #include <sys/ioctl.h>
+    #include <sys/timex.h>
+#endif
+
+#if defined(__linux__)
+static uint64_t timespec_ns(const timespec &ts){
+    return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+//pull the SCM_TIMESTAMPING / SCM_TIMESTAMPNS timestamps out of a received message
+void twamp_parse_timestamps(msghdr *msg, TwampTimestamps *ts){
+#if defined(__linux__)
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET)
+            continue;
+        if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+            //ts[0] is software, ts[2] raw hardware
+            timespec stamps[3];
+            memcpy(stamps, CMSG_DATA(cmsg), sizeof(stamps));
+            ts->sw = timespec_ns(stamps[0]);
+            ts->hw = timespec_ns(stamps[2]);
+        }
+        else if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            timespec stamp;
+            memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+            ts->sw = timespec_ns(stamp);
+        }
+    }
+#else
+    (void)msg;
+    (void)ts;
+#endif
+}
+
+int twamp_enable_timestamping(int fd, bool hardware){
+#if defined(__linux__)
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE |
+                SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+    if (hardware)
+        flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0)
+        return TWAMP_TS_KERNEL_TXRX;
+    //older kernels: receive timestamps only
+    int on = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == 0)
+        return TWAMP_TS_KERNEL_RX;
+#else
+    (void)fd;
+    (void)hardware;
+#endif
+    return TWAMP_TS_NONE;
+}
+
+int twamp_enable_rx_timestamping(int fd){
+#if defined(__linux__)
+    int on = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == 0)
+        return TWAMP_TS_KERNEL_RX;
+#else
+    (void)fd;
+#endif
+    return TWAMP_TS_NONE;
+}
+
+bool twamp_set_busy_poll(int fd, unsigned int usec){
+#if defined(__linux__) && defined(SO_BUSY_POLL)
+    int val = int(std::min(usec, unsigned(INT32_MAX)));
+    if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)) < 0)
+        return false;
+#if defined(SO_PREFER_BUSY_POLL)
+    //older kernels busy poll all the same, only they let interrupts in too
+    int prefer = usec ? 1 : 0;
+    setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer));
+#endif
+    return true;
+#else
+    (void)fd;
+    return !usec;
+#endif
+}
+
+bool twamp_enable_hw_timestamping(int fd, const std::string &ifname){
+#if defined(__linux__)
+    hwtstamp_config cfg{};
+    cfg.tx_type = HWTSTAMP_TX_ON;
+    cfg.rx_filter = HWTSTAMP_FILTER_ALL;
+    ifreq ifr{};
+    strncpy(ifr.ifr_name, ifname.c_str(), IFNAMSIZ - 1);
+    ifr.ifr_data = reinterpret_cast<char*>(&cfg);
+    if (ioctl(fd, SIOCSHWTSTAMP, &ifr) == 0)
+        return true;
+    perror("SIOCSHWTSTAMP");
+#else
+    (void)fd;
+    (void)ifname;
+#endif
+    return false;
+}
+
+ssize_t twamp_recv(int fd, void *buf, size_t len, int flags, sockaddr *from, socklen_t from_len, TwampTimestamps *rx){
+    *rx = TwampTimestamps();
+#if defined(__linux__)
+    iovec iov{buf, len};
+    alignas(cmsghdr) char control[256];
+    msghdr msg{};
+    msg.msg_name = from;
+    msg.msg_namelen = from_len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n = recvmsg(fd, &msg, flags);
+    if (n >= 0)
+        twamp_parse_timestamps(&msg, rx);
+    return n;
+#else
+    return recvfrom(fd, buf, len, flags, from, &from_len);
+#endif
+}
+
+bool twamp_recv_tx_timestamp(int fd, uint32_t *id, TwampTimestamps *tx){
+    *tx = TwampTimestamps();
+#if defined(__linux__)
+    alignas(cmsghdr) char control[256];
+    msghdr msg{};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        return false;
+    bool have_id = false;
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if ((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+            (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+            sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+            if (err.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+                *id = err.ee_data;
+                have_id = true;
+            }
+        }
+    }
+    twamp_parse_timestamps(&msg, tx);
+    //not a timestamp (e.g. an ICMP error): report an empty one so callers keep draining
+    if (!have_id)
+        *id = UINT32_MAX;
+    return true;
+#else
+    (void)fd;
+    (void)id;
+    return false;
+#endif
+}
+
+static std::atomic<uint64_t> assumed_error_ns {0};
+
+void twamp_clock_assume_synced(uint64_t error_ns){
+    assumed_error_ns.store(error_ns, std::memory_order_relaxed);
+}
+
+TwampClockStatus twamp_clock_status(){
+    thread_local TwampClockStatus status;
+    thread_local uint64_t next_ms = 0;
+    uint64_t now = get_monotonic_ms();
+    if (now < next_ms)
+        return status;
+    next_ms = now + 1000;
+#if defined(__linux__)
+    timex tx{};
+    int state = adjtimex(&tx);
+    status.synced = state >= 0 && state != TIME_ERROR && !(tx.status & STA_UNSYNC);
+    //microseconds, the estimate while synchronized and the worst case otherwise
+    status.error_ns = uint64_t(std::max<long>(status.synced ? tx.esterror : tx.maxerror, 0)) * 1000;
+    status.tai_offset_s = state >= 0 ? tx.tai : 0;
+#else
+    status.synced = false;
+    status.error_ns = 0;
+    status.tai_offset_s = 0;
+#endif
+    uint64_t assumed = assumed_error_ns.load(std::memory_order_relaxed);
+    if (assumed) {
+        status.synced = true;
+        status.error_ns = assumed;
+    }
+    status.error_estimate = twamp_error_estimate(status.synced, status.error_ns);
+    return status;
+}
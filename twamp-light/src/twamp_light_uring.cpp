@@ -0,0 +1,100 @@
+#include "twamp_light.hpp"
+
+#if defined(TWAMP_HAVE_IO_URING)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+TwampUring::~TwampUring() {
+    if (fd < 0)
+        return;
+    munmap(sqes, sqes_size);
+    if (cq_ptr != sq_ptr)
+        munmap(cq_ptr, cq_size);
+    munmap(sq_ptr, sq_size);
+    close(fd);
+}
+
+bool TwampUring::init(unsigned int entries) {
+    io_uring_params p{};
+    //replies keep coming while a round is being sent: room for both
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = entries * 4;
+    fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0)
+        return false;
+    features = p.features;
+    sq_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if (features & IORING_FEAT_SINGLE_MMAP)
+        sq_size = cq_size = std::max(sq_size, cq_size);
+    sq_ptr = static_cast<uint8_t*>(mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING));
+    if (sq_ptr == MAP_FAILED) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    cq_ptr = sq_ptr;
+    if (!(features & IORING_FEAT_SINGLE_MMAP)) {
+        cq_ptr = static_cast<uint8_t*>(mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING));
+        if (cq_ptr == MAP_FAILED) {
+            munmap(sq_ptr, sq_size);
+            close(fd);
+            fd = -1;
+            return false;
+        }
+    }
+    sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED) {
+        if (cq_ptr != sq_ptr)
+            munmap(cq_ptr, cq_size);
+        munmap(sq_ptr, sq_size);
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    sq_head = reinterpret_cast<uint32_t*>(sq_ptr + p.sq_off.head);
+    sq_tail = reinterpret_cast<uint32_t*>(sq_ptr + p.sq_off.tail);
+    sq_array = reinterpret_cast<uint32_t*>(sq_ptr + p.sq_off.array);
+    sq_mask = *reinterpret_cast<uint32_t*>(sq_ptr + p.sq_off.ring_mask);
+    sq_entries = p.sq_entries;
+    cq_head = reinterpret_cast<uint32_t*>(cq_ptr + p.cq_off.head);
+    cq_tail = reinterpret_cast<uint32_t*>(cq_ptr + p.cq_off.tail);
+    cq_mask = *reinterpret_cast<uint32_t*>(cq_ptr + p.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq_ptr + p.cq_off.cqes);
+    local_tail = *sq_tail;
+    submitted = local_tail;
+    return true;
+}
+
+io_uring_sqe *TwampUring::get_sqe() {
+    if (local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries)
+        return nullptr;
+    uint32_t idx = local_tail & sq_mask;
+    sq_array[idx] = idx;
+    ++local_tail;
+    memset(&sqes[idx], 0, sizeof(sqes[idx]));
+    return &sqes[idx];
+}
+
+int TwampUring::submit(unsigned int wait_nr) {
+    __atomic_store_n(sq_tail, local_tail, __ATOMIC_RELEASE);
+    unsigned int to_submit = local_tail - submitted;
+    int ret = syscall(__NR_io_uring_enter, fd, to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+    if (ret > 0)
+        submitted += ret;
+    return ret;
+}
+
+bool TwampUring::peek(io_uring_cqe **cqe) {
+    uint32_t head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+        return false;
+    *cqe = &cqes[head & cq_mask];
+    return true;
+}
+
+void TwampUring::seen() {
+    __atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+}
+#endif